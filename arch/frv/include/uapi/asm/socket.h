@@ -105,5 +105,9 @@
 
 #define SO_ZEROCOPY		60
 
+#define SO_BUSY_POLL_BUDGET	61
+
+#define SO_RX_LATENCY		62
+
 #endif /* _ASM_SOCKET_H */
 
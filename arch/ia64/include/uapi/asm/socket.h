@@ -114,4 +114,8 @@
 
 #define SO_ZEROCOPY		60
 
+#define SO_BUSY_POLL_BUDGET	61
+
+#define SO_RX_LATENCY		62
+
 #endif /* _ASM_IA64_SOCKET_H */
@@ -104,4 +104,8 @@
 
 #define SO_ZEROCOPY		0x4035
 
+#define SO_BUSY_POLL_BUDGET	0x4036
+
+#define SO_RX_LATENCY		0x4037
+
 #endif /* _UAPI_ASM_SOCKET_H */
@@ -101,6 +101,10 @@
 
 #define SO_ZEROCOPY		0x003e
 
+#define SO_BUSY_POLL_BUDGET	0x003f
+
+#define SO_RX_LATENCY		0x0040
+
 /* Security levels - as per NRL IPv6 - don't actually do anything */
 #define SO_SECURITY_AUTHENTICATION		0x5001
 #define SO_SECURITY_ENCRYPTION_TRANSPORT	0x5002
@@ -13,10 +13,12 @@
 #include <linux/blk-cgroup.h>
 #include <linux/blk-crypto.h>
 #include <linux/crypto.h>
+#include <linux/debugfs.h>
 #include <linux/keyslot-manager.h>
 #include <linux/mempool.h>
 #include <linux/module.h>
 #include <linux/random.h>
+#include <linux/seq_file.h>
 
 #include "blk-crypto-internal.h"
 
@@ -35,6 +37,55 @@ module_param(num_prealloc_fallback_crypt_ctxs, uint, 0);
 MODULE_PARM_DESC(num_prealloc_crypt_fallback_ctxs,
 		 "Number of preallocated bio fallback crypto contexts for blk-crypto to use during crypto API fallback");
 
+static unsigned int num_prealloc_cipher_batches = 16;
+module_param(num_prealloc_cipher_batches, uint, 0);
+MODULE_PARM_DESC(num_prealloc_cipher_batches,
+		 "Number of preallocated skcipher request batches per crypto mode for the blk-crypto crypto API fallback");
+
+/* Bios handed to the fallback; each one missed the inline encryption hw */
+static atomic_long_t blk_crypto_fallback_write_bios = ATOMIC_LONG_INIT(0);
+static atomic_long_t blk_crypto_fallback_read_bios = ATOMIC_LONG_INIT(0);
+
+static int blk_crypto_fallback_get_count(char *buffer,
+					 const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%ld\n", atomic_long_read(kp->arg));
+}
+
+static const struct kernel_param_ops blk_crypto_fallback_count_ops = {
+	.get = blk_crypto_fallback_get_count,
+};
+
+module_param_cb(write_bios, &blk_crypto_fallback_count_ops,
+		&blk_crypto_fallback_write_bios, 0444);
+MODULE_PARM_DESC(write_bios,
+		 "Number of write bios encrypted by the blk-crypto crypto API fallback");
+module_param_cb(read_bios, &blk_crypto_fallback_count_ops,
+		&blk_crypto_fallback_read_bios, 0444);
+MODULE_PARM_DESC(read_bios,
+		 "Number of read bios decrypted by the blk-crypto crypto API fallback");
+
+/* Per mode usage of the fallback, shown in debugfs */
+struct blk_crypto_fallback_stats {
+	atomic64_t bios[2];
+	atomic64_t bytes[2];
+	atomic64_t nsecs[2];
+};
+
+static struct blk_crypto_fallback_stats
+	blk_crypto_fallback_stats[BLK_ENCRYPTION_MODE_MAX];
+
+static void blk_crypto_fallback_account(enum blk_crypto_mode_num mode_num,
+					int rw, unsigned int bytes, u64 start)
+{
+	struct blk_crypto_fallback_stats *stats =
+		&blk_crypto_fallback_stats[mode_num];
+
+	atomic64_inc(&stats->bios[rw]);
+	atomic64_add(bytes, &stats->bytes[rw]);
+	atomic64_add(ktime_get_ns() - start, &stats->nsecs[rw]);
+}
+
 struct bio_fallback_crypt_ctx {
 	struct bio_crypt_ctx crypt_ctx;
 	/*
@@ -63,6 +114,41 @@ static mempool_t *bio_fallback_crypt_ctx_pool;
 static DEFINE_MUTEX(tfms_init_lock);
 static bool tfms_inited[BLK_ENCRYPTION_MODE_MAX];
 
+/*
+ * Data units are en/decrypted BLK_CRYPTO_FALLBACK_BATCH at a time, each with
+ * its own request, so that an asynchronous implementation has several of
+ * them in flight across the segments of a bio. A synchronous one completes
+ * every request as it is submitted. The requests of a batch are carved out
+ * of a single preallocated element of the mode's pool, so the I/O path
+ * never has to allocate them.
+ */
+#define BLK_CRYPTO_FALLBACK_BATCH	8
+
+union blk_crypto_iv {
+	__le64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	u8 bytes[BLK_CRYPTO_MAX_IV_SIZE];
+};
+
+struct blk_crypto_fallback_unit {
+	struct skcipher_request *req;
+	struct crypto_wait wait;
+	union blk_crypto_iv iv;
+	struct scatterlist src;
+	struct scatterlist dst;
+	/* return value of the last submission */
+	int err;
+};
+
+struct blk_crypto_fallback_batch {
+	enum blk_crypto_mode_num crypto_mode;
+	unsigned int next;
+	struct blk_crypto_fallback_unit units[BLK_CRYPTO_FALLBACK_BATCH];
+};
+
+static mempool_t *blk_crypto_batch_pools[BLK_ENCRYPTION_MODE_MAX];
+static unsigned int blk_crypto_req_sizes[BLK_ENCRYPTION_MODE_MAX];
+static const char *blk_crypto_driver_names[BLK_ENCRYPTION_MODE_MAX];
+
 struct blk_crypto_decrypt_work {
 	struct work_struct work;
 	struct bio *bio;
@@ -197,27 +283,87 @@ static struct bio *blk_crypto_clone_bio(struct bio *bio_src)
 	return bio;
 }
 
-static int blk_crypto_alloc_cipher_req(struct bio *src_bio,
-				       struct skcipher_request **ciph_req_ret,
-				       struct crypto_wait *wait)
+static size_t blk_crypto_batch_size(enum blk_crypto_mode_num mode_num)
 {
-	struct skcipher_request *ciph_req;
-	const struct blk_crypto_keyslot *slotp;
+	return ALIGN(sizeof(struct blk_crypto_fallback_batch), CRYPTO_MINALIGN) +
+		BLK_CRYPTO_FALLBACK_BATCH * blk_crypto_req_sizes[mode_num];
+}
 
-	slotp = &blk_crypto_keyslots[src_bio->bi_crypt_context->bc_keyslot];
-	ciph_req = skcipher_request_alloc(slotp->tfms[slotp->crypto_mode],
-					  GFP_NOIO);
-	if (!ciph_req) {
-		src_bio->bi_status = BLK_STS_RESOURCE;
-		return -ENOMEM;
+/*
+ * Get a batch of requests for the tfm of the keyslot @bc holds. Backed by
+ * a mempool, so this can't fail.
+ */
+static struct blk_crypto_fallback_batch *
+blk_crypto_get_batch(const struct bio_crypt_ctx *bc)
+{
+	const struct blk_crypto_keyslot *slotp =
+		&blk_crypto_keyslots[bc->bc_keyslot];
+	enum blk_crypto_mode_num mode_num = slotp->crypto_mode;
+	struct blk_crypto_fallback_batch *batch;
+	struct blk_crypto_fallback_unit *unit;
+	char *reqs;
+	int i;
+
+	batch = mempool_alloc(blk_crypto_batch_pools[mode_num], GFP_NOIO);
+	reqs = (char *)batch +
+		ALIGN(sizeof(struct blk_crypto_fallback_batch), CRYPTO_MINALIGN);
+
+	batch->crypto_mode = mode_num;
+	batch->next = 0;
+	for (i = 0; i < BLK_CRYPTO_FALLBACK_BATCH; i++) {
+		unit = &batch->units[i];
+		unit->req = (struct skcipher_request *)
+			(reqs + i * blk_crypto_req_sizes[mode_num]);
+		skcipher_request_set_tfm(unit->req, slotp->tfms[mode_num]);
+		crypto_init_wait(&unit->wait);
+		skcipher_request_set_callback(unit->req,
+					      CRYPTO_TFM_REQ_MAY_BACKLOG |
+					      CRYPTO_TFM_REQ_MAY_SLEEP,
+					      crypto_req_done, &unit->wait);
+		sg_init_table(&unit->src, 1);
+		sg_init_table(&unit->dst, 1);
+		unit->err = 0;
 	}
+	return batch;
+}
 
-	skcipher_request_set_callback(ciph_req,
-				      CRYPTO_TFM_REQ_MAY_BACKLOG |
-				      CRYPTO_TFM_REQ_MAY_SLEEP,
-				      crypto_req_done, wait);
-	*ciph_req_ret = ciph_req;
-	return 0;
+/*
+ * Return the next free unit of @batch, waiting for the oldest request in
+ * flight if needed. On error, *err is set and the unit must not be used.
+ */
+static struct blk_crypto_fallback_unit *
+blk_crypto_next_unit(struct blk_crypto_fallback_batch *batch, int *err)
+{
+	struct blk_crypto_fallback_unit *unit;
+
+	unit = &batch->units[batch->next++ % BLK_CRYPTO_FALLBACK_BATCH];
+	*err = crypto_wait_req(unit->err, &unit->wait);
+	unit->err = 0;
+	return unit;
+}
+
+/* Wait for every request of @batch, return the first error if any */
+static int blk_crypto_drain_batch(struct blk_crypto_fallback_batch *batch)
+{
+	int i, ret, err = 0;
+
+	for (i = 0; i < BLK_CRYPTO_FALLBACK_BATCH; i++) {
+		ret = crypto_wait_req(batch->units[i].err,
+				      &batch->units[i].wait);
+		batch->units[i].err = 0;
+		if (ret && !err)
+			err = ret;
+	}
+	return err;
+}
+
+static void blk_crypto_put_batch(struct blk_crypto_fallback_batch *batch)
+{
+	int i;
+
+	for (i = 0; i < BLK_CRYPTO_FALLBACK_BATCH; i++)
+		skcipher_request_zero(batch->units[i].req);
+	mempool_free(batch, blk_crypto_batch_pools[batch->crypto_mode]);
 }
 
 static int blk_crypto_split_bio_if_needed(struct bio **bio_ptr)
@@ -248,11 +394,6 @@ static int blk_crypto_split_bio_if_needed(struct bio **bio_ptr)
 	return 0;
 }
 
-union blk_crypto_iv {
-	__le64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	u8 bytes[BLK_CRYPTO_MAX_IV_SIZE];
-};
-
 static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 				 union blk_crypto_iv *iv)
 {
@@ -271,11 +412,10 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 {
 	struct bio *src_bio;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
+	struct blk_crypto_fallback_batch *batch;
+	struct blk_crypto_fallback_unit *unit;
 	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist src, dst;
+	u64 start = ktime_get_ns();
 	struct bio *enc_bio;
 	unsigned int i, j;
 	int data_unit_size;
@@ -308,17 +448,10 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 		goto out_put_enc_bio;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	err = blk_crypto_alloc_cipher_req(src_bio, &ciph_req, &wait);
-	if (err)
-		goto out_release_keyslot;
+	/* and then get a batch of skcipher_requests for it */
+	batch = blk_crypto_get_batch(bc);
 
 	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&src, 1);
-	sg_init_table(&dst, 1);
-
-	skcipher_request_set_crypt(ciph_req, &src, &dst, data_unit_size,
-				   iv.bytes);
 
 	/* Encrypt each page in the bounce bio */
 	for (i = 0; i < enc_bio->bi_vcnt; i++) {
@@ -335,42 +468,51 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 			goto out_free_bounce_pages;
 		}
 
-		sg_set_page(&src, plaintext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-		sg_set_page(&dst, ciphertext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-
-		/* Encrypt each data unit in this page */
+		/* Queue each data unit in this page */
 		for (j = 0; j < enc_bvec->bv_len; j += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			err = crypto_wait_req(crypto_skcipher_encrypt(ciph_req),
-					      &wait);
+			unit = blk_crypto_next_unit(batch, &err);
 			if (err) {
 				i++;
 				src_bio->bi_status = BLK_STS_RESOURCE;
 				goto out_free_bounce_pages;
 			}
+			sg_set_page(&unit->src, plaintext_page, data_unit_size,
+				    enc_bvec->bv_offset + j);
+			sg_set_page(&unit->dst, ciphertext_page, data_unit_size,
+				    enc_bvec->bv_offset + j);
+			blk_crypto_dun_to_iv(curr_dun, &unit->iv);
+			skcipher_request_set_crypt(unit->req, &unit->src,
+						   &unit->dst, data_unit_size,
+						   unit->iv.bytes);
+			unit->err = crypto_skcipher_encrypt(unit->req);
 			bio_crypt_dun_increment(curr_dun, 1);
-			src.offset += data_unit_size;
-			dst.offset += data_unit_size;
 		}
 	}
 
+	err = blk_crypto_drain_batch(batch);
+	if (err) {
+		src_bio->bi_status = BLK_STS_RESOURCE;
+		goto out_free_bounce_pages;
+	}
+
+	blk_crypto_fallback_account(batch->crypto_mode, WRITE,
+				    src_bio->bi_iter.bi_size, start);
 	enc_bio->bi_private = src_bio;
 	enc_bio->bi_end_io = blk_crypto_encrypt_endio;
 	*bio_ptr = enc_bio;
 
 	enc_bio = NULL;
 	err = 0;
-	goto out_free_ciph_req;
+	goto out_put_batch;
 
 out_free_bounce_pages:
+	/* nothing may still be writing into the bounce pages */
+	blk_crypto_drain_batch(batch);
 	while (i > 0)
 		mempool_free(enc_bio->bi_io_vec[--i].bv_page,
 			     blk_crypto_bounce_page_pool);
-out_free_ciph_req:
-	skcipher_request_free(ciph_req);
-out_release_keyslot:
+out_put_batch:
+	blk_crypto_put_batch(batch);
 	bio_crypt_ctx_release_keyslot(bc);
 out_put_enc_bio:
 	if (enc_bio)
@@ -397,19 +539,18 @@ static void blk_crypto_decrypt_bio(struct work_struct *work)
 	struct blk_crypto_decrypt_work *decrypt_work =
 		container_of(work, struct blk_crypto_decrypt_work, work);
 	struct bio *bio = decrypt_work->bio;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
+	struct blk_crypto_fallback_batch *batch;
+	struct blk_crypto_fallback_unit *unit;
 	struct bio_vec bv;
 	struct bvec_iter iter;
 	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist sg;
+	u64 start = ktime_get_ns();
 	struct bio_crypt_ctx *bc = bio->bi_crypt_context;
 	struct bio_fallback_crypt_ctx *f_ctx =
 		container_of(bc, struct bio_fallback_crypt_ctx, crypt_ctx);
 	const int data_unit_size = bc->bc_key->data_unit_size;
 	unsigned int i;
-	int err;
+	int err = 0;
 
 	/*
 	 * Use the crypto API fallback keyslot manager to get a crypto_skcipher
@@ -420,37 +561,37 @@ static void blk_crypto_decrypt_bio(struct work_struct *work)
 		goto out_no_keyslot;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	err = blk_crypto_alloc_cipher_req(bio, &ciph_req, &wait);
-	if (err)
-		goto out;
+	/* and then get a batch of skcipher_requests for it */
+	batch = blk_crypto_get_batch(bc);
 
 	memcpy(curr_dun, f_ctx->fallback_dun, sizeof(curr_dun));
-	sg_init_table(&sg, 1);
-	skcipher_request_set_crypt(ciph_req, &sg, &sg, data_unit_size,
-				   iv.bytes);
 
-	/* Decrypt each segment in the bio */
+	/* Queue each data unit of each segment in the bio */
 	__bio_for_each_segment(bv, bio, iter, f_ctx->crypt_iter) {
 		struct page *page = bv.bv_page;
 
-		sg_set_page(&sg, page, data_unit_size, bv.bv_offset);
-
-		/* Decrypt each data unit in the segment */
 		for (i = 0; i < bv.bv_len; i += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_decrypt(ciph_req),
-					    &wait)) {
-				bio->bi_status = BLK_STS_IOERR;
+			unit = blk_crypto_next_unit(batch, &err);
+			if (err)
 				goto out;
-			}
+			sg_set_page(&unit->src, page, data_unit_size,
+				    bv.bv_offset + i);
+			blk_crypto_dun_to_iv(curr_dun, &unit->iv);
+			skcipher_request_set_crypt(unit->req, &unit->src,
+						   &unit->src, data_unit_size,
+						   unit->iv.bytes);
+			unit->err = crypto_skcipher_decrypt(unit->req);
 			bio_crypt_dun_increment(curr_dun, 1);
-			sg.offset += data_unit_size;
 		}
 	}
 
 out:
-	skcipher_request_free(ciph_req);
+	if (blk_crypto_drain_batch(batch) || err)
+		bio->bi_status = BLK_STS_IOERR;
+	else
+		blk_crypto_fallback_account(batch->crypto_mode, READ,
+					    f_ctx->crypt_iter.bi_size, start);
+	blk_crypto_put_batch(batch);
 	bio_crypt_ctx_release_keyslot(bc);
 out_no_keyslot:
 	kmem_cache_free(blk_crypto_decrypt_work_cache, decrypt_work);
@@ -495,6 +636,7 @@ int blk_crypto_fallback_start_using_mode(enum blk_crypto_mode_num mode_num)
 {
 	const char *cipher_str = blk_crypto_modes[mode_num].cipher_str;
 	struct blk_crypto_keyslot *slotp;
+	struct crypto_skcipher *tfm;
 	unsigned int i;
 	int err = 0;
 
@@ -528,6 +670,24 @@ int blk_crypto_fallback_start_using_mode(enum blk_crypto_mode_num mode_num)
 					  CRYPTO_TFM_REQ_WEAK_KEY);
 	}
 
+	/*
+	 * Every keyslot got the highest priority implementation, e.g. the
+	 * NEON one on arm64 if it is built, so they all share one reqsize.
+	 */
+	tfm = blk_crypto_keyslots[0].tfms[mode_num];
+	blk_crypto_req_sizes[mode_num] =
+		ALIGN(sizeof(struct skcipher_request) +
+		      crypto_skcipher_reqsize(tfm), CRYPTO_MINALIGN);
+	blk_crypto_batch_pools[mode_num] =
+		mempool_create_kmalloc_pool(num_prealloc_cipher_batches,
+					    blk_crypto_batch_size(mode_num));
+	if (!blk_crypto_batch_pools[mode_num]) {
+		err = -ENOMEM;
+		goto out_free_tfms;
+	}
+	blk_crypto_driver_names[mode_num] = crypto_skcipher_driver_name(tfm);
+	pr_info("%s using %s\n", cipher_str, blk_crypto_driver_names[mode_num]);
+
 	/*
 	 * Ensure that updates to blk_crypto_keyslots[i].tfms[mode_num]
 	 * for each i are visible before we set tfms_inited[mode_num].
@@ -568,8 +728,12 @@ int blk_crypto_fallback_submit_bio(struct bio **bio_ptr)
 		return -EIO;
 	}
 
-	if (bio_data_dir(bio) == WRITE)
+	if (bio_data_dir(bio) == WRITE) {
+		atomic_long_inc(&blk_crypto_fallback_write_bios);
 		return blk_crypto_encrypt_bio(bio_ptr);
+	}
+
+	atomic_long_inc(&blk_crypto_fallback_read_bios);
 
 	/*
 	 * Mark bio as fallback crypted and replace the bio_crypt_ctx with
@@ -588,6 +752,43 @@ int blk_crypto_fallback_submit_bio(struct bio **bio_ptr)
 	return 0;
 }
 
+static int blk_crypto_fallback_stats_show(struct seq_file *m, void *v)
+{
+	struct blk_crypto_fallback_stats *stats;
+	int i;
+
+	for (i = 0; i < BLK_ENCRYPTION_MODE_MAX; i++) {
+		/* pairs with the release in blk_crypto_fallback_start_using_mode */
+		if (!smp_load_acquire(&tfms_inited[i]))
+			continue;
+
+		stats = &blk_crypto_fallback_stats[i];
+		seq_printf(m, "%s %s write_bios=%lld write_bytes=%lld write_us=%lld read_bios=%lld read_bytes=%lld read_us=%lld\n",
+			   blk_crypto_modes[i].cipher_str,
+			   blk_crypto_driver_names[i],
+			   (s64)atomic64_read(&stats->bios[WRITE]),
+			   (s64)atomic64_read(&stats->bytes[WRITE]),
+			   (s64)atomic64_read(&stats->nsecs[WRITE]) / NSEC_PER_USEC,
+			   (s64)atomic64_read(&stats->bios[READ]),
+			   (s64)atomic64_read(&stats->bytes[READ]),
+			   (s64)atomic64_read(&stats->nsecs[READ]) / NSEC_PER_USEC);
+	}
+	return 0;
+}
+
+static int blk_crypto_fallback_stats_open(struct inode *inode,
+					  struct file *file)
+{
+	return single_open(file, blk_crypto_fallback_stats_show, NULL);
+}
+
+static const struct file_operations blk_crypto_fallback_stats_fops = {
+	.open		= blk_crypto_fallback_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int __init blk_crypto_fallback_init(void)
 {
 	int i;
@@ -639,5 +840,8 @@ int __init blk_crypto_fallback_init(void)
 	if (!bio_fallback_crypt_ctx_pool)
 		return -ENOMEM;
 
+	debugfs_create_file("blk_crypto_fallback", 0444, NULL, NULL,
+			    &blk_crypto_fallback_stats_fops);
+
 	return 0;
 }
@@ -304,3 +304,75 @@ int blk_crypto_evict_key(struct request_queue *q,
 	return blk_crypto_fallback_evict_key(key);
 }
 EXPORT_SYMBOL_GPL(blk_crypto_evict_key);
+
+/**
+ * blk_crypto_prefetch_key() - Program a key ahead of its first I/O
+ * @q: The request queue the key is about to be used on
+ * @key: The key that is about to be used
+ *
+ * Upper layers may call this when they know @key will be used soon, e.g. when
+ * a file encrypted with it has just been opened, so that the inline
+ * encryption hardware is programmed in the background rather than when the
+ * first bio arrives. It is only a hint and does nothing if @q has no keyslot
+ * manager supporting the key.
+ *
+ * Context: Process context.
+ */
+void blk_crypto_prefetch_key(struct request_queue *q,
+			     const struct blk_crypto_key *key)
+{
+	if (blk_crypto_key_supported_by_hw(q, key))
+		keyslot_manager_prefetch_key(q->ksm, key);
+}
+EXPORT_SYMBOL_GPL(blk_crypto_prefetch_key);
+
+/**
+ * blk_crypto_key_supported_by_hw() - Check for inline encryption of a key
+ * @q: The request queue the key will be used on
+ * @key: The key
+ *
+ * Return: true if bios using @key on @q are handled by the inline encryption
+ *	   hardware rather than by blk-crypto-fallback.
+ */
+bool blk_crypto_key_supported_by_hw(struct request_queue *q,
+				    const struct blk_crypto_key *key)
+{
+	return q->ksm &&
+	       keyslot_manager_crypto_mode_supported(q->ksm, key->crypto_mode,
+						     blk_crypto_key_dun_bytes(key),
+						     key->data_unit_size,
+						     key->is_hw_wrapped);
+}
+EXPORT_SYMBOL_GPL(blk_crypto_key_supported_by_hw);
+
+/**
+ * blk_crypto_pin_key() - Reserve a hardware keyslot for a key
+ * @q: The request queue the key will be used on
+ * @key: The key
+ *
+ * Program @key into the inline encryption hardware of @q and keep it there,
+ * so that it is never evicted to make room for other keys.  Meant for keys
+ * that are used for the lifetime of a device, like the metadata encryption
+ * key.  Undo with blk_crypto_unpin_key() before evicting the key.
+ *
+ * Context: Process context.
+ * Return: 0 on success, -EOPNOTSUPP if @q can't hold @key in hardware, or
+ *	   another -errno code.
+ */
+int blk_crypto_pin_key(struct request_queue *q,
+		       const struct blk_crypto_key *key)
+{
+	if (!blk_crypto_key_supported_by_hw(q, key))
+		return -EOPNOTSUPP;
+
+	return keyslot_manager_pin_key(q->ksm, key);
+}
+EXPORT_SYMBOL_GPL(blk_crypto_pin_key);
+
+void blk_crypto_unpin_key(struct request_queue *q,
+			  const struct blk_crypto_key *key)
+{
+	if (blk_crypto_key_supported_by_hw(q, key))
+		keyslot_manager_unpin_key(q->ksm, key);
+}
+EXPORT_SYMBOL_GPL(blk_crypto_unpin_key);
@@ -11,6 +11,7 @@
 #include <linux/blktrace_api.h>
 #include <linux/blk-mq.h>
 #include <linux/blk-cgroup.h>
+#include <linux/keyslot-manager.h>
 
 #include "blk.h"
 #include "blk-mq.h"
@@ -469,6 +470,31 @@ static ssize_t queue_wb_lat_store(struct request_queue *q, const char *page,
 	return count;
 }
 
+static ssize_t queue_wb_class_show(struct request_queue *q, char *page)
+{
+	if (!q->rq_wb)
+		return -EINVAL;
+
+	return wbt_class_policy_show(q->rq_wb, page);
+}
+
+static ssize_t queue_wb_class_store(struct request_queue *q, const char *page,
+				    size_t count)
+{
+	char buf[32];
+	int ret;
+
+	if (!q->rq_wb)
+		return -EINVAL;
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	memcpy(buf, page, count);
+	buf[count] = '\0';
+	ret = wbt_class_policy_store(q->rq_wb, buf);
+	return ret ? ret : count;
+}
+
 static ssize_t queue_wc_show(struct request_queue *q, char *page)
 {
 	if (test_bit(QUEUE_FLAG_WC, &q->queue_flags))
@@ -680,6 +706,24 @@ static struct queue_sysfs_entry queue_wb_lat_entry = {
 	.store = queue_wb_lat_store,
 };
 
+static struct queue_sysfs_entry queue_wb_class_entry = {
+	.attr = {.name = "wbt_class_policy", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_wb_class_show,
+	.store = queue_wb_class_store,
+};
+
+#ifdef CONFIG_BLK_INLINE_ENCRYPTION
+static ssize_t queue_keyslot_stats_show(struct request_queue *q, char *page)
+{
+	return keyslot_manager_stats_show(q->ksm, page);
+}
+
+static struct queue_sysfs_entry queue_keyslot_stats_entry = {
+	.attr = {.name = "crypto_keyslot_stats", .mode = S_IRUGO },
+	.show = queue_keyslot_stats_show,
+};
+#endif
+
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 static struct queue_sysfs_entry throtl_sample_time_entry = {
 	.attr = {.name = "throttle_sample_time", .mode = S_IRUGO | S_IWUSR },
@@ -720,7 +764,11 @@ static struct attribute *default_attrs[] = {
 	&queue_wc_entry.attr,
 	&queue_dax_entry.attr,
 	&queue_wb_lat_entry.attr,
+	&queue_wb_class_entry.attr,
 	&queue_poll_delay_entry.attr,
+#ifdef CONFIG_BLK_INLINE_ENCRYPTION
+	&queue_keyslot_stats_entry.attr,
+#endif
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 	&throtl_sample_time_entry.attr,
 #endif
@@ -53,6 +53,30 @@ enum {
 	RWB_UNKNOWN_BUMP	= 5,
 };
 
+static const char *const wbt_class_name[] = {
+	[BIO_WB_USER]		= "user",
+	[BIO_WB_GC]		= "gc",
+	[BIO_WB_CHECKPOINT]	= "checkpoint",
+	[BIO_WB_SWAP]		= "swap",
+};
+
+static const char *const wbt_policy_name[] = {
+	[WBT_POLICY_AUTO]	= "auto",
+	[WBT_POLICY_YIELD]	= "yield",
+	[WBT_POLICY_MAX]	= "max",
+};
+
+/*
+ * GC and swap writeback come in bursts that reads should not have to queue
+ * behind, so they yield by default.
+ */
+static const unsigned char wbt_default_class_policy[] = {
+	[BIO_WB_USER]		= WBT_POLICY_AUTO,
+	[BIO_WB_GC]		= WBT_POLICY_YIELD,
+	[BIO_WB_CHECKPOINT]	= WBT_POLICY_AUTO,
+	[BIO_WB_SWAP]		= WBT_POLICY_YIELD,
+};
+
 static inline bool rwb_enabled(struct rq_wb *rwb)
 {
 	return rwb && rwb->wb_normal != 0;
@@ -476,10 +500,20 @@ static bool close_io(struct rq_wb *rwb)
 
 #define REQ_HIPRIO	(REQ_SYNC | REQ_META | REQ_PRIO)
 
-static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw)
+static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw,
+				     unsigned int wb_class)
 {
 	unsigned int limit;
 
+	switch (rwb->class_policy[wb_class]) {
+	case WBT_POLICY_MAX:
+		return rwb->wb_max;
+	case WBT_POLICY_YIELD:
+		if ((rw & REQ_BACKGROUND) || close_io(rwb))
+			return rwb->wb_background;
+		return rwb->wb_normal;
+	}
+
 	/*
 	 * At this point we know it's a buffered write. If this is
 	 * kswapd trying to free memory, or REQ_SYNC is set, set, then
@@ -503,7 +537,8 @@ static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw)
 }
 
 static inline bool may_queue(struct rq_wb *rwb, struct rq_wait *rqw,
-			     wait_queue_entry_t *wait, unsigned long rw)
+			     wait_queue_entry_t *wait, unsigned long rw,
+			     unsigned int wb_class)
 {
 	/*
 	 * inc it here even if disabled, since we'll dec it at completion.
@@ -523,28 +558,29 @@ static inline bool may_queue(struct rq_wb *rwb, struct rq_wait *rqw,
 	    rqw->wait.head.next != &wait->entry)
 		return false;
 
-	return atomic_inc_below(&rqw->inflight, get_limit(rwb, rw));
+	return atomic_inc_below(&rqw->inflight, get_limit(rwb, rw, wb_class));
 }
 
 /*
  * Block if we will exceed our limit, or if we are currently waiting for
- * the timer to kick off queuing again.
+ * the timer to kick off queuing again. Returns true if we had to wait.
  */
-static void __wbt_wait(struct rq_wb *rwb, unsigned long rw, spinlock_t *lock)
+static bool __wbt_wait(struct rq_wb *rwb, unsigned long rw,
+		       unsigned int wb_class, spinlock_t *lock)
 	__releases(lock)
 	__acquires(lock)
 {
 	struct rq_wait *rqw = get_rq_wait(rwb, current_is_kswapd());
 	DEFINE_WAIT(wait);
 
-	if (may_queue(rwb, rqw, &wait, rw))
-		return;
+	if (may_queue(rwb, rqw, &wait, rw, wb_class))
+		return false;
 
 	do {
 		prepare_to_wait_exclusive(&rqw->wait, &wait,
 						TASK_UNINTERRUPTIBLE);
 
-		if (may_queue(rwb, rqw, &wait, rw))
+		if (may_queue(rwb, rqw, &wait, rw, wb_class))
 			break;
 
 		if (lock) {
@@ -556,6 +592,7 @@ static void __wbt_wait(struct rq_wb *rwb, unsigned long rw, spinlock_t *lock)
 	} while (1);
 
 	finish_wait(&rqw->wait, &wait);
+	return true;
 }
 
 static inline bool wbt_should_throttle(struct rq_wb *rwb, struct bio *bio)
@@ -585,7 +622,9 @@ static inline bool wbt_should_throttle(struct rq_wb *rwb, struct bio *bio)
  */
 enum wbt_flags wbt_wait(struct rq_wb *rwb, struct bio *bio, spinlock_t *lock)
 {
+	unsigned int wb_class = bio->bi_wb_class;
 	unsigned int ret = 0;
+	bool waited;
 
 	if (!rwb_enabled(rwb))
 		return 0;
@@ -599,7 +638,15 @@ enum wbt_flags wbt_wait(struct rq_wb *rwb, struct bio *bio, spinlock_t *lock)
 		return ret;
 	}
 
-	__wbt_wait(rwb, bio->bi_opf, lock);
+	if (WARN_ON_ONCE(wb_class >= BIO_WB_NR_CLASSES))
+		wb_class = BIO_WB_USER;
+
+	waited = __wbt_wait(rwb, bio->bi_opf, wb_class, lock);
+
+	trace_wbt_throttle(rwb->queue->backing_dev_info, wb_class,
+			   rwb->class_policy[wb_class],
+			   get_limit(rwb, bio->bi_opf, wb_class),
+			   wbt_inflight(rwb), waited);
 
 	if (!blk_stat_is_active(rwb->cb))
 		rwb_arm_timer(rwb);
@@ -684,6 +731,46 @@ void wbt_enable_default(struct request_queue *q)
 }
 EXPORT_SYMBOL_GPL(wbt_enable_default);
 
+ssize_t wbt_class_policy_show(struct rq_wb *rwb, char *page)
+{
+	ssize_t ret = 0;
+	int i;
+
+	for (i = 0; i < BIO_WB_NR_CLASSES; i++)
+		ret += sprintf(page + ret, "%s%s=%s", i ? " " : "",
+			       wbt_class_name[i],
+			       wbt_policy_name[rwb->class_policy[i]]);
+	ret += sprintf(page + ret, "\n");
+	return ret;
+}
+
+/*
+ * Takes "<class>=<policy>", e.g. "swap=max". The class policy is only read
+ * when a tracked write is queued, so a plain store is good enough.
+ */
+int wbt_class_policy_store(struct rq_wb *rwb, char *buf)
+{
+	char *policy;
+	int class, i;
+
+	buf = strstrip(buf);
+	policy = strchr(buf, '=');
+	if (!policy)
+		return -EINVAL;
+	*policy++ = '\0';
+
+	class = match_string(wbt_class_name, BIO_WB_NR_CLASSES, buf);
+	if (class < 0)
+		return class;
+	i = match_string(wbt_policy_name, WBT_NR_POLICIES, policy);
+	if (i < 0)
+		return i;
+
+	WRITE_ONCE(rwb->class_policy[class], i);
+	rwb_wake_all(rwb);
+	return 0;
+}
+
 u64 wbt_default_latency_nsec(struct request_queue *q)
 {
 	/*
@@ -737,6 +824,8 @@ int wbt_init(struct request_queue *q)
 	rwb->queue = q;
 	rwb->win_nsec = RWB_WINDOW_NSEC;
 	rwb->enable_state = WBT_STATE_ON_DEFAULT;
+	memcpy(rwb->class_policy, wbt_default_class_policy,
+	       sizeof(rwb->class_policy));
 	wbt_update_limits(rwb);
 
 	/*
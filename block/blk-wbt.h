@@ -31,6 +31,19 @@ enum {
 	WBT_STATE_ON_MANUAL	= 2,
 };
 
+/*
+ * Throttling policy per writeback class (enum bio_wb_class). "auto" picks
+ * the limit from the usual heuristics, "yield" drops to the background limit
+ * while other IO is active and never goes above the normal limit, "max"
+ * always uses the max throughput limit.
+ */
+enum {
+	WBT_POLICY_AUTO,
+	WBT_POLICY_YIELD,
+	WBT_POLICY_MAX,
+	WBT_NR_POLICIES,
+};
+
 static inline void wbt_clear_state(struct blk_issue_stat *stat)
 {
 	stat->stat &= ~BLK_STAT_RES_MASK;
@@ -93,6 +106,7 @@ struct rq_wb {
 	unsigned long last_issue;		/* last non-throttled issue */
 	unsigned long last_comp;		/* last non-throttled comp */
 	unsigned long min_lat_nsec;
+	unsigned char class_policy[BIO_WB_NR_CLASSES];	/* WBT_POLICY_* */
 	struct request_queue *queue;
 	struct rq_wait rq_wait[WBT_NUM_RWQ];
 };
@@ -125,6 +139,9 @@ void wbt_set_write_cache(struct rq_wb *, bool);
 
 u64 wbt_default_latency_nsec(struct request_queue *);
 
+ssize_t wbt_class_policy_show(struct rq_wb *, char *);
+int wbt_class_policy_store(struct rq_wb *, char *);
+
 #else
 
 static inline void __wbt_done(struct rq_wb *rwb, enum wbt_flags flags)
@@ -170,6 +187,14 @@ static inline u64 wbt_default_latency_nsec(struct request_queue *q)
 {
 	return 0;
 }
+static inline ssize_t wbt_class_policy_show(struct rq_wb *rwb, char *page)
+{
+	return -EINVAL;
+}
+static inline int wbt_class_policy_store(struct rq_wb *rwb, char *buf)
+{
+	return -EINVAL;
+}
 
 #endif /* CONFIG_BLK_WBT */
 
@@ -21,6 +21,7 @@
 #include <linux/log2.h>
 #include <linux/pm_runtime.h>
 #include <linux/badblocks.h>
+#include <linux/jank_snapshot.h>
 
 #include "blk.h"
 
@@ -1325,10 +1326,42 @@ static const struct file_operations proc_diskstats_operations = {
 	.release	= seq_release,
 };
 
+/* Disks with requests in flight, for jank snapshots */
+static void disk_jank_show(struct seq_file *m, void *priv)
+{
+	struct class_dev_iter iter;
+	unsigned int inflight[2];
+	struct device *dev;
+
+	class_dev_iter_init(&iter, &block_class, NULL, &disk_type);
+	while ((dev = class_dev_iter_next(&iter))) {
+		struct gendisk *disk = dev_to_disk(dev);
+		char buf[BDEVNAME_SIZE];
+
+		if (!disk->queue)
+			continue;
+
+		part_in_flight_rw(disk->queue, &disk->part0, inflight);
+		if (!inflight[0] && !inflight[1])
+			continue;
+
+		seq_printf(m, "%s read=%u write=%u nr_requests=%lu\n",
+			   disk_name(disk, 0, buf), inflight[0], inflight[1],
+			   disk->queue->nr_requests);
+	}
+	class_dev_iter_exit(&iter);
+}
+
+static struct jank_snapshot_source disk_jank_src = {
+	.name = "block",
+	.show = disk_jank_show,
+};
+
 static int __init proc_genhd_init(void)
 {
 	proc_create("diskstats", 0, NULL, &proc_diskstats_operations);
 	proc_create("partitions", 0, NULL, &proc_partitions_operations);
+	jank_snapshot_register(&disk_jank_src);
 	return 0;
 }
 module_init(proc_genhd_init);
@@ -24,6 +24,14 @@
  *
  * Upper layers will call keyslot_manager_get_slot_for_key() to program a
  * key into some slot in the inline encryption hardware.
+ *
+ * When every slot is programmed, the slot to reuse is the least frequently
+ * used of the few least recently used idle slots, so that a key used by a
+ * lot of I/O isn't evicted by a burst of one-off keys.  Upper layers that
+ * know a key is about to be used (e.g. a file was just opened) can call
+ * keyslot_manager_prefetch_key() to have it programmed in the background.
+ * A key that must never be evicted, e.g. the one used for all filesystem
+ * metadata, can be pinned into a slot with keyslot_manager_pin_key().
  */
 #include <crypto/algapi.h>
 #include <linux/keyslot-manager.h>
@@ -31,10 +39,20 @@
 #include <linux/mutex.h>
 #include <linux/wait.h>
 #include <linux/blkdev.h>
+#include <linux/ktime.h>
 #include <linux/overflow.h>
+#include <linux/workqueue.h>
+
+/* Number of least recently used idle slots considered for reuse */
+#define KSM_EVICT_SCAN		4
+/* Saturation value of the per-slot use count */
+#define KSM_MAX_HITS		(1 << 16)
+/* Keys that may be waiting to be programmed ahead of their I/O */
+#define KSM_MAX_PREFETCH	4
 
 struct keyslot {
 	atomic_t slot_refs;
+	atomic_t hits;
 	struct list_head idle_slot_node;
 	struct hlist_node hash_node;
 	struct blk_crypto_key key;
@@ -65,6 +83,28 @@ struct keyslot_manager {
 	struct hlist_head *slot_hashtable;
 	unsigned int slot_hashtable_size;
 
+	/*
+	 * Keys queued by keyslot_manager_prefetch_key().  The mutex is held
+	 * by the worker while it programs a key, so that evicting that key
+	 * can't race with it being programmed again.
+	 */
+	struct work_struct prefetch_work;
+	struct mutex prefetch_lock;
+	unsigned int nr_prefetch;
+	struct blk_crypto_key prefetch_keys[KSM_MAX_PREFETCH];
+
+	/* Slots held by keyslot_manager_pin_key(), protected by 'lock' */
+	unsigned int nr_pinned;
+
+	/* Statistics; everything except 'hits' is protected by 'lock' */
+	atomic64_t hits;
+	u64 misses;
+	u64 waits;
+	u64 evictions;
+	u64 prefetched;
+	u64 miss_ns_total;
+	u64 miss_ns_max;
+
 	/* Per-keyslot data */
 	struct keyslot slots[];
 };
@@ -74,6 +114,8 @@ static inline bool keyslot_manager_is_passthrough(struct keyslot_manager *ksm)
 	return ksm->num_slots == 0;
 }
 
+static void keyslot_manager_prefetch_work(struct work_struct *work);
+
 /**
  * keyslot_manager_create() - Create a keyslot manager
  * @num_slots: The number of key slots to manage.
@@ -139,6 +181,9 @@ struct keyslot_manager *keyslot_manager_create(unsigned int num_slots,
 
 	spin_lock_init(&ksm->idle_slots_lock);
 
+	INIT_WORK(&ksm->prefetch_work, keyslot_manager_prefetch_work);
+	mutex_init(&ksm->prefetch_lock);
+
 	ksm->slot_hashtable_size = roundup_pow_of_two(num_slots);
 	ksm->slot_hashtable = kvmalloc_array(ksm->slot_hashtable_size,
 					     sizeof(ksm->slot_hashtable[0]),
@@ -180,6 +225,16 @@ static void remove_slot_from_lru_list(struct keyslot_manager *ksm, int slot)
 	spin_unlock_irqrestore(&ksm->idle_slots_lock, flags);
 }
 
+static inline bool blk_crypto_keys_equal(const struct blk_crypto_key *a,
+					 const struct blk_crypto_key *b)
+{
+	return a->hash == b->hash &&
+	       a->crypto_mode == b->crypto_mode &&
+	       a->size == b->size &&
+	       a->data_unit_size == b->data_unit_size &&
+	       !crypto_memneq(a->raw, b->raw, a->size);
+}
+
 static int find_keyslot(struct keyslot_manager *ksm,
 			const struct blk_crypto_key *key)
 {
@@ -187,11 +242,7 @@ static int find_keyslot(struct keyslot_manager *ksm,
 	const struct keyslot *slotp;
 
 	hlist_for_each_entry(slotp, head, hash_node) {
-		if (slotp->key.hash == key->hash &&
-		    slotp->key.crypto_mode == key->crypto_mode &&
-		    slotp->key.size == key->size &&
-		    slotp->key.data_unit_size == key->data_unit_size &&
-		    !crypto_memneq(slotp->key.raw, key->raw, key->size))
+		if (blk_crypto_keys_equal(&slotp->key, key))
 			return slotp - ksm->slots;
 	}
 	return -ENOKEY;
@@ -205,6 +256,7 @@ static int find_and_grab_keyslot(struct keyslot_manager *ksm,
 	slot = find_keyslot(ksm, key);
 	if (slot < 0)
 		return slot;
+	atomic_add_unless(&ksm->slots[slot].hits, 1, KSM_MAX_HITS);
 	if (atomic_inc_return(&ksm->slots[slot].slot_refs) == 1) {
 		/* Took first reference to this slot; remove it from LRU list */
 		remove_slot_from_lru_list(ksm, slot);
@@ -212,40 +264,65 @@ static int find_and_grab_keyslot(struct keyslot_manager *ksm,
 	return slot;
 }
 
-/**
- * keyslot_manager_get_slot_for_key() - Program a key into a keyslot.
- * @ksm: The keyslot manager to program the key into.
- * @key: Pointer to the key object to program, including the raw key, crypto
- *	 mode, and data unit size.
- *
- * Get a keyslot that's been programmed with the specified key.  If one already
- * exists, return it with incremented refcount.  Otherwise, wait for a keyslot
- * to become idle and program it.
- *
- * Context: Process context. Takes and releases ksm->lock.
- * Return: The keyslot on success, else a -errno value.
+/*
+ * Pick the idle slot to program next: an empty slot if there is one near the
+ * front of the LRU list (evicted slots are moved there), else the least
+ * frequently used of the KSM_EVICT_SCAN least recently used idle slots.  The
+ * use count of the slots that were considered is halved, so that a key which
+ * stops being used ages out.  Called with ksm->lock held for write, so no
+ * idle slot can be grabbed concurrently.
  */
-int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
-				     const struct blk_crypto_key *key)
+static struct keyslot *pick_idle_slot(struct keyslot_manager *ksm)
+{
+	struct keyslot *slotp, *victim = NULL;
+	unsigned int scanned = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ksm->idle_slots_lock, flags);
+	list_for_each_entry(slotp, &ksm->idle_slots, idle_slot_node) {
+		int hits = atomic_read(&slotp->hits);
+
+		if (slotp->key.crypto_mode == BLK_ENCRYPTION_MODE_INVALID) {
+			victim = slotp;
+			break;
+		}
+		if (!victim || hits < atomic_read(&victim->hits))
+			victim = slotp;
+		atomic_set(&slotp->hits, hits >> 1);
+		if (++scanned == KSM_EVICT_SCAN)
+			break;
+	}
+	spin_unlock_irqrestore(&ksm->idle_slots_lock, flags);
+
+	return victim;
+}
+
+static int __keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
+					      const struct blk_crypto_key *key,
+					      bool prefetch)
 {
 	int slot;
 	int err;
 	struct keyslot *idle_slot;
-
-	if (keyslot_manager_is_passthrough(ksm))
-		return 0;
+	u64 start, lat;
 
 	down_read(&ksm->lock);
 	slot = find_and_grab_keyslot(ksm, key);
 	up_read(&ksm->lock);
-	if (slot != -ENOKEY)
+	if (slot != -ENOKEY) {
+		if (!prefetch)
+			atomic64_inc(&ksm->hits);
 		return slot;
+	}
 
+	start = ktime_get_ns();
 	for (;;) {
 		down_write(&ksm->lock);
 		slot = find_and_grab_keyslot(ksm, key);
 		if (slot != -ENOKEY) {
 			up_write(&ksm->lock);
+			if (!prefetch)
+				atomic64_inc(&ksm->hits);
 			return slot;
 		}
 
@@ -256,13 +333,17 @@ int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
 		if (!list_empty(&ksm->idle_slots))
 			break;
 
+		if (!prefetch)
+			ksm->waits++;
 		up_write(&ksm->lock);
+		/* Prefetching never waits an in-use slot out */
+		if (prefetch)
+			return -EBUSY;
 		wait_event(ksm->idle_slots_wait_queue,
 			   !list_empty(&ksm->idle_slots));
 	}
 
-	idle_slot = list_first_entry(&ksm->idle_slots, struct keyslot,
-					     idle_slot_node);
+	idle_slot = pick_idle_slot(ksm);
 	slot = idle_slot - ksm->slots;
 
 	err = ksm->ksm_ll_ops.keyslot_program(ksm, key, slot);
@@ -273,19 +354,236 @@ int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
 	}
 
 	/* Move this slot to the hash list for the new key. */
-	if (idle_slot->key.crypto_mode != BLK_ENCRYPTION_MODE_INVALID)
+	if (idle_slot->key.crypto_mode != BLK_ENCRYPTION_MODE_INVALID) {
 		hlist_del(&idle_slot->hash_node);
+		ksm->evictions++;
+	}
 	hlist_add_head(&idle_slot->hash_node, hash_bucket_for_key(ksm, key));
 
 	atomic_set(&idle_slot->slot_refs, 1);
+	atomic_set(&idle_slot->hits, 0);
 	idle_slot->key = *key;
 
 	remove_slot_from_lru_list(ksm, slot);
 
+	if (prefetch) {
+		ksm->prefetched++;
+	} else {
+		lat = ktime_get_ns() - start;
+		ksm->misses++;
+		ksm->miss_ns_total += lat;
+		ksm->miss_ns_max = max(ksm->miss_ns_max, lat);
+	}
+
 	up_write(&ksm->lock);
 	return slot;
 }
 
+/**
+ * keyslot_manager_get_slot_for_key() - Program a key into a keyslot.
+ * @ksm: The keyslot manager to program the key into.
+ * @key: Pointer to the key object to program, including the raw key, crypto
+ *	 mode, and data unit size.
+ *
+ * Get a keyslot that's been programmed with the specified key.  If one already
+ * exists, return it with incremented refcount.  Otherwise, wait for a keyslot
+ * to become idle and program it.
+ *
+ * Context: Process context. Takes and releases ksm->lock.
+ * Return: The keyslot on success, else a -errno value.
+ */
+int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
+				     const struct blk_crypto_key *key)
+{
+	if (keyslot_manager_is_passthrough(ksm))
+		return 0;
+
+	return __keyslot_manager_get_slot_for_key(ksm, key, false);
+}
+
+static void keyslot_manager_prefetch_work(struct work_struct *work)
+{
+	struct keyslot_manager *ksm =
+		container_of(work, struct keyslot_manager, prefetch_work);
+	struct blk_crypto_key *key;
+	int slot;
+
+	mutex_lock(&ksm->prefetch_lock);
+	while (ksm->nr_prefetch) {
+		key = &ksm->prefetch_keys[--ksm->nr_prefetch];
+		slot = __keyslot_manager_get_slot_for_key(ksm, key, true);
+		if (slot >= 0)
+			keyslot_manager_put_slot(ksm, slot);
+		memzero_explicit(key, sizeof(*key));
+	}
+	mutex_unlock(&ksm->prefetch_lock);
+}
+
+/**
+ * keyslot_manager_prefetch_key() - Program a key ahead of its first I/O
+ * @ksm: The keyslot manager to program the key into.
+ * @key: The key that is about to be used.
+ *
+ * Queue @key to be programmed into an idle keyslot in the background, so
+ * that the first bio using it doesn't wait for the slot to be programmed.
+ * This is only a hint: nothing is done if the key is already in a slot,
+ * if too many keys are already queued, or if no slot is idle by the time
+ * the worker runs.  The key is copied, so @key may be freed on return.
+ *
+ * Context: Process context. Takes and releases ksm->lock.
+ */
+void keyslot_manager_prefetch_key(struct keyslot_manager *ksm,
+				  const struct blk_crypto_key *key)
+{
+	unsigned int i;
+	int slot;
+
+	if (keyslot_manager_is_passthrough(ksm))
+		return;
+
+	down_read(&ksm->lock);
+	slot = find_keyslot(ksm, key);
+	up_read(&ksm->lock);
+	if (slot >= 0)
+		return;
+
+	mutex_lock(&ksm->prefetch_lock);
+	for (i = 0; i < ksm->nr_prefetch; i++) {
+		if (blk_crypto_keys_equal(&ksm->prefetch_keys[i], key))
+			goto out_unlock;
+	}
+	if (ksm->nr_prefetch < KSM_MAX_PREFETCH) {
+		ksm->prefetch_keys[ksm->nr_prefetch++] = *key;
+		kblockd_schedule_work(&ksm->prefetch_work);
+	}
+out_unlock:
+	mutex_unlock(&ksm->prefetch_lock);
+}
+
+/**
+ * keyslot_manager_pin_key() - Keep a key programmed until it is unpinned
+ * @ksm: The keyslot manager to program the key into.
+ * @key: The key to pin.
+ *
+ * Program @key into a keyslot and hold a reference to that slot, so that it
+ * never becomes idle and is never picked for reuse.  At least one slot is
+ * always left unpinned for other keys.  Each successful call must be
+ * balanced by keyslot_manager_unpin_key().
+ *
+ * Context: Process context. Takes and releases ksm->lock.
+ * Return: 0 on success, -EOPNOTSUPP for a passthrough keyslot manager,
+ *	   -ENOSPC if no more slots may be pinned, or another -errno value.
+ */
+int keyslot_manager_pin_key(struct keyslot_manager *ksm,
+			    const struct blk_crypto_key *key)
+{
+	int slot;
+
+	if (keyslot_manager_is_passthrough(ksm))
+		return -EOPNOTSUPP;
+
+	down_write(&ksm->lock);
+	if (ksm->nr_pinned + 1 >= ksm->num_slots) {
+		up_write(&ksm->lock);
+		return -ENOSPC;
+	}
+	ksm->nr_pinned++;
+	up_write(&ksm->lock);
+
+	slot = __keyslot_manager_get_slot_for_key(ksm, key, false);
+	if (slot >= 0)
+		return 0;
+
+	down_write(&ksm->lock);
+	ksm->nr_pinned--;
+	up_write(&ksm->lock);
+	return slot;
+}
+
+/**
+ * keyslot_manager_unpin_key() - Undo keyslot_manager_pin_key()
+ * @ksm: The keyslot manager the key was pinned in.
+ * @key: The pinned key.
+ *
+ * The key stays programmed, but its slot may be reused once idle.
+ *
+ * Context: Process context. Takes and releases ksm->lock.
+ */
+void keyslot_manager_unpin_key(struct keyslot_manager *ksm,
+			       const struct blk_crypto_key *key)
+{
+	int slot;
+
+	if (keyslot_manager_is_passthrough(ksm))
+		return;
+
+	down_write(&ksm->lock);
+	slot = find_keyslot(ksm, key);
+	if (!WARN_ON(slot < 0 || !ksm->nr_pinned))
+		ksm->nr_pinned--;
+	up_write(&ksm->lock);
+
+	if (slot >= 0)
+		keyslot_manager_put_slot(ksm, slot);
+}
+
+/* Drop @key from the prefetch queue.  Called with prefetch_lock held. */
+static void keyslot_manager_unqueue_prefetch(struct keyslot_manager *ksm,
+					     const struct blk_crypto_key *key)
+{
+	unsigned int i = 0;
+
+	while (i < ksm->nr_prefetch) {
+		struct blk_crypto_key *pkey = &ksm->prefetch_keys[i];
+
+		if (!blk_crypto_keys_equal(pkey, key)) {
+			i++;
+			continue;
+		}
+		*pkey = ksm->prefetch_keys[--ksm->nr_prefetch];
+		memzero_explicit(&ksm->prefetch_keys[ksm->nr_prefetch],
+				 sizeof(*pkey));
+	}
+}
+
+/**
+ * keyslot_manager_stats_show() - Format the keyslot usage statistics
+ * @ksm: The keyslot manager, or NULL
+ * @page: sysfs buffer
+ *
+ * Print, on one line, the number of lookups that found their key already in a
+ * slot, the number that had to program a slot, how many of those evicted
+ * another key, the number of keys programmed by prefetching, the average
+ * and maximum time in nanoseconds a slot miss waited to be programmed, the
+ * number of times a lookup had to wait for a slot to become idle, and the
+ * number of pinned slots.
+ *
+ * Return: Number of bytes written.
+ */
+ssize_t keyslot_manager_stats_show(struct keyslot_manager *ksm, char *page)
+{
+	u64 misses, evictions, prefetched, total, max, waits;
+	unsigned int pinned;
+
+	if (!ksm || keyslot_manager_is_passthrough(ksm))
+		return sprintf(page, "none\n");
+
+	down_read(&ksm->lock);
+	misses = ksm->misses;
+	evictions = ksm->evictions;
+	prefetched = ksm->prefetched;
+	total = ksm->miss_ns_total;
+	max = ksm->miss_ns_max;
+	waits = ksm->waits;
+	pinned = ksm->nr_pinned;
+	up_read(&ksm->lock);
+
+	return sprintf(page, "%llu %llu %llu %llu %llu %llu %llu %u\n",
+		       (u64)atomic64_read(&ksm->hits), misses, evictions,
+		       prefetched, misses ? div64_u64(total, misses) : 0, max,
+		       waits, pinned);
+}
+
 /**
  * keyslot_manager_get_slot() - Increment the refcount on the specified slot.
  * @ksm: The keyslot manager that we want to modify.
@@ -405,6 +703,10 @@ int keyslot_manager_evict_key(struct keyslot_manager *ksm,
 		return 0;
 	}
 
+	/* Also keeps a prefetch of this key from programming it again */
+	mutex_lock(&ksm->prefetch_lock);
+	keyslot_manager_unqueue_prefetch(ksm, key);
+
 	down_write(&ksm->lock);
 	slot = find_keyslot(ksm, key);
 	if (slot < 0) {
@@ -423,9 +725,15 @@ int keyslot_manager_evict_key(struct keyslot_manager *ksm,
 
 	hlist_del(&slotp->hash_node);
 	memzero_explicit(&slotp->key, sizeof(slotp->key));
+	atomic_set(&slotp->hits, 0);
+	/* Reuse empty slots before evicting anything */
+	spin_lock_irq(&ksm->idle_slots_lock);
+	list_move(&slotp->idle_slot_node, &ksm->idle_slots);
+	spin_unlock_irq(&ksm->idle_slots_lock);
 	err = 0;
 out_unlock:
 	up_write(&ksm->lock);
+	mutex_unlock(&ksm->prefetch_lock);
 	return err;
 }
 
@@ -475,6 +783,8 @@ EXPORT_SYMBOL_GPL(keyslot_manager_private);
 void keyslot_manager_destroy(struct keyslot_manager *ksm)
 {
 	if (ksm) {
+		if (!keyslot_manager_is_passthrough(ksm))
+			cancel_work_sync(&ksm->prefetch_work);
 		kvfree(ksm->slot_hashtable);
 		memzero_explicit(ksm, struct_size(ksm, slots, ksm->num_slots));
 		kvfree(ksm);
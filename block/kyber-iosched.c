@@ -20,7 +20,9 @@
 #include <linux/kernel.h>
 #include <linux/blkdev.h>
 #include <linux/blk-mq.h>
+#include <linux/blk-cgroup.h>
 #include <linux/elevator.h>
+#include <linux/ioprio.h>
 #include <linux/module.h>
 #include <linux/sbitmap.h>
 
@@ -39,6 +41,32 @@ enum {
 	KYBER_NUM_DOMAINS,
 };
 
+/*
+ * Scheduling classes. These are orthogonal to the domains: each class has its
+ * own latency target and a cap on the scheduler tags it may allocate, which is
+ * lowered for the looser classes when a tighter class misses its target.
+ */
+enum {
+	KYBER_TOP_APP,
+	KYBER_FOREGROUND,
+	KYBER_BACKGROUND,
+	KYBER_NUM_CLASSES,
+	KYBER_CLASS_UNSET = KYBER_NUM_CLASSES,
+};
+
+static const char * const kyber_class_name[] = {
+	[KYBER_TOP_APP] = "top-app",
+	[KYBER_FOREGROUND] = "foreground",
+	[KYBER_BACKGROUND] = "background",
+};
+
+/* Default per-class target latencies in nanoseconds. */
+static const u64 kyber_class_lat[] = {
+	[KYBER_TOP_APP] = 2000000ULL,
+	[KYBER_FOREGROUND] = 10000000ULL,
+	[KYBER_BACKGROUND] = 100000000ULL,
+};
+
 enum {
 	KYBER_MIN_DEPTH = 256,
 
@@ -92,6 +120,18 @@ struct kyber_queue_data {
 
 	/* Target latencies in nanoseconds. */
 	u64 read_lat_nsec, write_lat_nsec;
+
+	/*
+	 * Per-class latency statistics, targets and scheduler tag limits. The
+	 * limits are per-word depths like async_depth; word_depth means the
+	 * class is not limited.
+	 */
+	struct blk_stat_callback *class_cb;
+	u64 class_lat_nsec[KYBER_NUM_CLASSES];
+	unsigned int class_depth[KYBER_NUM_CLASSES];
+	unsigned int class_min_depth[KYBER_NUM_CLASSES];
+	unsigned int class_max_depth[KYBER_NUM_CLASSES];
+	unsigned int word_depth;
 };
 
 struct kyber_hctx_data {
@@ -115,6 +155,86 @@ static int rq_sched_domain(const struct request *rq)
 		return KYBER_OTHER;
 }
 
+#ifdef CONFIG_BLK_CGROUP
+/*
+ * Per blkio cgroup class, set through blkio.kyber.class by the platform for
+ * its top-app, foreground and background groups.
+ */
+struct kyber_blkcg_data {
+	struct blkcg_policy_data cpd;
+	int sched_class;
+};
+
+static struct blkcg_policy blkcg_policy_kyber;
+static bool kyber_blkcg_registered;
+
+static inline struct kyber_blkcg_data *
+cpd_to_kyber(struct blkcg_policy_data *cpd)
+{
+	return cpd ? container_of(cpd, struct kyber_blkcg_data, cpd) : NULL;
+}
+
+static int kyber_blkcg_class(struct bio *bio)
+{
+	struct kyber_blkcg_data *kcd;
+	int sched_class = KYBER_CLASS_UNSET;
+
+	if (!kyber_blkcg_registered)
+		return sched_class;
+
+	rcu_read_lock();
+	kcd = cpd_to_kyber(blkcg_to_cpd(bio_blkcg(bio), &blkcg_policy_kyber));
+	if (kcd)
+		sched_class = READ_ONCE(kcd->sched_class);
+	rcu_read_unlock();
+
+	return sched_class;
+}
+#else
+static inline int kyber_blkcg_class(struct bio *bio)
+{
+	return KYBER_CLASS_UNSET;
+}
+#endif
+
+/*
+ * Classify an allocation. @bio may be NULL, in which case the submitting task
+ * decides.
+ */
+static int kyber_sched_class(unsigned int op, struct bio *bio)
+{
+	struct io_context *ioc;
+	int sched_class;
+	int ioprio;
+
+	if (op & REQ_BACKGROUND)
+		return KYBER_BACKGROUND;
+
+	ioprio = bio ? bio_prio(bio) : 0;
+	if (!ioprio_valid(ioprio)) {
+		ioc = rq_ioc(bio);
+		if (ioc)
+			ioprio = ioc->ioprio;
+	}
+	if (IOPRIO_PRIO_CLASS(ioprio) == IOPRIO_CLASS_IDLE)
+		return KYBER_BACKGROUND;
+
+	sched_class = kyber_blkcg_class(bio);
+	if (sched_class != KYBER_CLASS_UNSET)
+		return sched_class;
+
+	if (IOPRIO_PRIO_CLASS(ioprio) == IOPRIO_CLASS_RT)
+		return KYBER_TOP_APP;
+	return KYBER_FOREGROUND;
+}
+
+static int rq_sched_class(const struct request *rq)
+{
+	if (!(rq->rq_flags & RQF_ELVPRIV))
+		return -1;
+	return (long)rq->elv.priv[1];
+}
+
 enum {
 	NONE = 0,
 	GOOD = 1,
@@ -271,6 +391,82 @@ static void kyber_stat_timer_fn(struct blk_stat_callback *cb)
 		blk_stat_activate_msecs(kqd->cb, 100);
 }
 
+/*
+ * Lower the tag limit of @sched_class given the status of a tighter class.
+ * Returns false if the class is already at its floor, so that the caller can
+ * move on to the next class up.
+ */
+static bool kyber_shrink_class_depth(struct kyber_queue_data *kqd,
+				     int sched_class, int status)
+{
+	unsigned int orig_depth, depth;
+
+	orig_depth = depth = kqd->class_depth[sched_class];
+	if (depth <= kqd->class_min_depth[sched_class])
+		return false;
+
+	if (status == AWFUL)
+		depth /= 2;
+	else
+		depth -= max(depth / 4, 1U);
+
+	depth = max(depth, kqd->class_min_depth[sched_class]);
+	if (depth != orig_depth)
+		WRITE_ONCE(kqd->class_depth[sched_class], depth);
+	return true;
+}
+
+static bool kyber_grow_class_depth(struct kyber_queue_data *kqd,
+				   int sched_class)
+{
+	unsigned int depth = kqd->class_depth[sched_class];
+
+	if (depth >= kqd->class_max_depth[sched_class])
+		return false;
+
+	WRITE_ONCE(kqd->class_depth[sched_class], depth + 1);
+	return true;
+}
+
+/*
+ * Throttle the classes below one that misses its target, background first.
+ * Background is only spared while it is itself way past its (loose) target,
+ * in which case foreground gives up tags instead. Once top-app and foreground
+ * are within target, tags are given back, foreground first.
+ */
+static void kyber_class_timer_fn(struct blk_stat_callback *cb)
+{
+	struct kyber_queue_data *kqd = cb->data;
+	int status[KYBER_NUM_CLASSES];
+	int i;
+
+	for (i = 0; i < KYBER_NUM_CLASSES; i++)
+		status[i] = kyber_lat_status(cb, i, kqd->class_lat_nsec[i]);
+
+	if (IS_BAD(status[KYBER_TOP_APP])) {
+		if (status[KYBER_BACKGROUND] == AWFUL ||
+		    !kyber_shrink_class_depth(kqd, KYBER_BACKGROUND,
+					      status[KYBER_TOP_APP]))
+			kyber_shrink_class_depth(kqd, KYBER_FOREGROUND,
+						 status[KYBER_TOP_APP]);
+	} else if (IS_BAD(status[KYBER_FOREGROUND])) {
+		if (status[KYBER_BACKGROUND] != AWFUL)
+			kyber_shrink_class_depth(kqd, KYBER_BACKGROUND,
+						 status[KYBER_FOREGROUND]);
+	} else if (!kyber_grow_class_depth(kqd, KYBER_FOREGROUND)) {
+		kyber_grow_class_depth(kqd, KYBER_BACKGROUND);
+	}
+
+	/* Keep monitoring until the targets are met and nothing is throttled. */
+	if (!blk_stat_is_active(kqd->class_cb) &&
+	    (IS_BAD(status[KYBER_TOP_APP]) || IS_BAD(status[KYBER_FOREGROUND]) ||
+	     kqd->class_depth[KYBER_FOREGROUND] <
+		kqd->class_max_depth[KYBER_FOREGROUND] ||
+	     kqd->class_depth[KYBER_BACKGROUND] <
+		kqd->class_max_depth[KYBER_BACKGROUND]))
+		blk_stat_activate_msecs(kqd->class_cb, 100);
+}
+
 static unsigned int kyber_sched_tags_shift(struct kyber_queue_data *kqd)
 {
 	/*
@@ -298,6 +494,12 @@ static struct kyber_queue_data *kyber_queue_data_alloc(struct request_queue *q)
 	if (!kqd->cb)
 		goto err_kqd;
 
+	kqd->class_cb = blk_stat_alloc_callback(kyber_class_timer_fn,
+						rq_sched_class,
+						KYBER_NUM_CLASSES, kqd);
+	if (!kqd->class_cb)
+		goto err_cb;
+
 	/*
 	 * The maximum number of tokens for any scheduling domain is at least
 	 * the queue depth of a single hardware queue. If the hardware doesn't
@@ -314,7 +516,7 @@ static struct kyber_queue_data *kyber_queue_data_alloc(struct request_queue *q)
 		if (ret) {
 			while (--i >= 0)
 				sbitmap_queue_free(&kqd->domain_tokens[i]);
-			goto err_cb;
+			goto err_class_cb;
 		}
 		sbitmap_queue_resize(&kqd->domain_tokens[i], kyber_depth[i]);
 	}
@@ -325,8 +527,26 @@ static struct kyber_queue_data *kyber_queue_data_alloc(struct request_queue *q)
 	kqd->read_lat_nsec = 2000000ULL;
 	kqd->write_lat_nsec = 10000000ULL;
 
+	/*
+	 * Top-app is never limited and foreground keeps at least a quarter of
+	 * the tags. Background starts out with the async share.
+	 */
+	kqd->word_depth = 1U << shift;
+	kqd->class_min_depth[KYBER_TOP_APP] = kqd->word_depth;
+	kqd->class_max_depth[KYBER_TOP_APP] = kqd->word_depth;
+	kqd->class_min_depth[KYBER_FOREGROUND] = max(kqd->word_depth / 4, 1U);
+	kqd->class_max_depth[KYBER_FOREGROUND] = kqd->word_depth;
+	kqd->class_min_depth[KYBER_BACKGROUND] = 1;
+	kqd->class_max_depth[KYBER_BACKGROUND] = max(kqd->async_depth, 1U);
+	for (i = 0; i < KYBER_NUM_CLASSES; i++) {
+		kqd->class_lat_nsec[i] = kyber_class_lat[i];
+		kqd->class_depth[i] = kqd->class_max_depth[i];
+	}
+
 	return kqd;
 
+err_class_cb:
+	blk_stat_free_callback(kqd->class_cb);
 err_cb:
 	blk_stat_free_callback(kqd->cb);
 err_kqd:
@@ -354,6 +574,7 @@ static int kyber_init_sched(struct request_queue *q, struct elevator_type *e)
 	q->elevator = eq;
 
 	blk_stat_add_callback(q, kqd->cb);
+	blk_stat_add_callback(q, kqd->class_cb);
 
 	return 0;
 }
@@ -364,10 +585,12 @@ static void kyber_exit_sched(struct elevator_queue *e)
 	struct request_queue *q = kqd->q;
 	int i;
 
+	blk_stat_remove_callback(q, kqd->class_cb);
 	blk_stat_remove_callback(q, kqd->cb);
 
 	for (i = 0; i < KYBER_NUM_DOMAINS; i++)
 		sbitmap_queue_free(&kqd->domain_tokens[i]);
+	blk_stat_free_callback(kqd->class_cb);
 	blk_stat_free_callback(kqd->cb);
 	kfree(kqd);
 }
@@ -428,20 +651,25 @@ static void rq_clear_domain_token(struct kyber_queue_data *kqd,
 
 static void kyber_limit_depth(unsigned int op, struct blk_mq_alloc_data *data)
 {
+	struct kyber_queue_data *kqd = data->q->elevator->elevator_data;
+	int sched_class = kyber_sched_class(op, NULL);
+	unsigned int depth = READ_ONCE(kqd->class_depth[sched_class]);
+
 	/*
 	 * We use the scheduler tags as per-hardware queue queueing tokens.
-	 * Async requests can be limited at this stage.
+	 * Async requests and throttled classes can be limited at this stage.
 	 */
-	if (!op_is_sync(op)) {
-		struct kyber_queue_data *kqd = data->q->elevator->elevator_data;
+	if (!op_is_sync(op))
+		depth = min(depth, kqd->async_depth);
 
-		data->shallow_depth = kqd->async_depth;
-	}
+	if (depth < kqd->word_depth)
+		data->shallow_depth = depth;
 }
 
 static void kyber_prepare_request(struct request *rq, struct bio *bio)
 {
 	rq_set_domain_token(rq, -1);
+	rq->elv.priv[1] = (void *)(long)kyber_sched_class(rq->cmd_flags, bio);
 }
 
 static void kyber_finish_request(struct request *rq)
@@ -456,10 +684,11 @@ static void kyber_completed_request(struct request *rq)
 	struct request_queue *q = rq->q;
 	struct kyber_queue_data *kqd = q->elevator->elevator_data;
 	unsigned int sched_domain;
+	int sched_class;
 	u64 now, latency, target;
 
 	/*
-	 * Check if this request met our latency goal. If not, quickly gather
+	 * Check if this request met our latency goals. If not, quickly gather
 	 * some statistics and start throttling.
 	 */
 	sched_domain = rq_sched_domain(rq);
@@ -471,11 +700,17 @@ static void kyber_completed_request(struct request *rq)
 		target = kqd->write_lat_nsec;
 		break;
 	default:
-		return;
+		target = 0;
+		break;
 	}
+	sched_class = rq_sched_class(rq);
 
 	/* If we are already monitoring latencies, don't check again. */
 	if (blk_stat_is_active(kqd->cb))
+		target = 0;
+	if (sched_class >= 0 && blk_stat_is_active(kqd->class_cb))
+		sched_class = -1;
+	if (!target && sched_class < 0)
 		return;
 
 	now = __blk_stat_time(ktime_to_ns(ktime_get()));
@@ -484,8 +719,10 @@ static void kyber_completed_request(struct request *rq)
 
 	latency = now - blk_stat_time(&rq->issue_stat);
 
-	if (latency > target)
+	if (target && latency > target)
 		blk_stat_activate_msecs(kqd->cb, 10);
+	if (sched_class >= 0 && latency > kqd->class_lat_nsec[sched_class])
+		blk_stat_activate_msecs(kqd->class_cb, 10);
 }
 
 static void kyber_flush_busy_ctxs(struct kyber_hctx_data *khd,
@@ -672,10 +909,42 @@ KYBER_LAT_SHOW_STORE(read);
 KYBER_LAT_SHOW_STORE(write);
 #undef KYBER_LAT_SHOW_STORE
 
+#define KYBER_CLASS_LAT_SHOW_STORE(class, name)				\
+static ssize_t kyber_##name##_lat_show(struct elevator_queue *e,	\
+				       char *page)			\
+{									\
+	struct kyber_queue_data *kqd = e->elevator_data;		\
+									\
+	return sprintf(page, "%llu\n", kqd->class_lat_nsec[class]);	\
+}									\
+									\
+static ssize_t kyber_##name##_lat_store(struct elevator_queue *e,	\
+					const char *page, size_t count)	\
+{									\
+	struct kyber_queue_data *kqd = e->elevator_data;		\
+	unsigned long long nsec;					\
+	int ret;							\
+									\
+	ret = kstrtoull(page, 10, &nsec);				\
+	if (ret)							\
+		return ret;						\
+									\
+	kqd->class_lat_nsec[class] = nsec;				\
+									\
+	return count;							\
+}
+KYBER_CLASS_LAT_SHOW_STORE(KYBER_TOP_APP, top_app);
+KYBER_CLASS_LAT_SHOW_STORE(KYBER_FOREGROUND, foreground);
+KYBER_CLASS_LAT_SHOW_STORE(KYBER_BACKGROUND, background);
+#undef KYBER_CLASS_LAT_SHOW_STORE
+
 #define KYBER_LAT_ATTR(op) __ATTR(op##_lat_nsec, 0644, kyber_##op##_lat_show, kyber_##op##_lat_store)
 static struct elv_fs_entry kyber_sched_attrs[] = {
 	KYBER_LAT_ATTR(read),
 	KYBER_LAT_ATTR(write),
+	KYBER_LAT_ATTR(top_app),
+	KYBER_LAT_ATTR(foreground),
+	KYBER_LAT_ATTR(background),
 	__ATTR_NULL
 };
 #undef KYBER_LAT_ATTR
@@ -749,6 +1018,18 @@ static int kyber_async_depth_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int kyber_class_depth_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct kyber_queue_data *kqd = q->elevator->elevator_data;
+	int i;
+
+	for (i = 0; i < KYBER_NUM_CLASSES; i++)
+		seq_printf(m, "%s: %u/%u\n", kyber_class_name[i],
+			   READ_ONCE(kqd->class_depth[i]), kqd->word_depth);
+	return 0;
+}
+
 static int kyber_cur_domain_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_hw_ctx *hctx = data;
@@ -787,6 +1068,7 @@ static const struct blk_mq_debugfs_attr kyber_queue_debugfs_attrs[] = {
 	KYBER_QUEUE_DOMAIN_ATTRS(sync_write),
 	KYBER_QUEUE_DOMAIN_ATTRS(other),
 	{"async_depth", 0400, kyber_async_depth_show},
+	{"class_depth", 0400, kyber_class_depth_show},
 	{},
 };
 #undef KYBER_QUEUE_DOMAIN_ATTRS
@@ -805,6 +1087,119 @@ static const struct blk_mq_debugfs_attr kyber_hctx_debugfs_attrs[] = {
 #undef KYBER_HCTX_DOMAIN_ATTRS
 #endif
 
+#ifdef CONFIG_BLK_CGROUP
+static struct blkcg_policy_data *kyber_cpd_alloc(gfp_t gfp)
+{
+	struct kyber_blkcg_data *kcd;
+
+	kcd = kzalloc(sizeof(*kcd), gfp);
+	if (!kcd)
+		return NULL;
+	return &kcd->cpd;
+}
+
+static void kyber_cpd_init(struct blkcg_policy_data *cpd)
+{
+	cpd_to_kyber(cpd)->sched_class = KYBER_CLASS_UNSET;
+}
+
+static void kyber_cpd_free(struct blkcg_policy_data *cpd)
+{
+	kfree(cpd_to_kyber(cpd));
+}
+
+static int kyber_class_show(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+	struct kyber_blkcg_data *kcd;
+	int sched_class;
+
+	kcd = cpd_to_kyber(blkcg_to_cpd(blkcg, &blkcg_policy_kyber));
+	sched_class = kcd ? READ_ONCE(kcd->sched_class) : KYBER_CLASS_UNSET;
+	seq_printf(sf, "%s\n", sched_class < KYBER_NUM_CLASSES ?
+		   kyber_class_name[sched_class] : "none");
+	return 0;
+}
+
+static ssize_t kyber_class_write(struct kernfs_open_file *of, char *buf,
+				 size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct kyber_blkcg_data *kcd;
+	int sched_class;
+
+	buf = strstrip(buf);
+	if (!strcmp(buf, "none")) {
+		sched_class = KYBER_CLASS_UNSET;
+	} else {
+		for (sched_class = 0; sched_class < KYBER_NUM_CLASSES;
+		     sched_class++)
+			if (!strcmp(buf, kyber_class_name[sched_class]))
+				break;
+		if (sched_class == KYBER_NUM_CLASSES)
+			return -EINVAL;
+	}
+
+	kcd = cpd_to_kyber(blkcg_to_cpd(blkcg, &blkcg_policy_kyber));
+	if (!kcd)
+		return -ENODEV;
+	WRITE_ONCE(kcd->sched_class, sched_class);
+
+	return nbytes;
+}
+
+static struct cftype kyber_blkcg_legacy_files[] = {
+	{
+		.name = "kyber.class",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = kyber_class_show,
+		.write = kyber_class_write,
+	},
+	{ }	/* terminate */
+};
+
+static struct cftype kyber_blkcg_files[] = {
+	{
+		.name = "kyber.class",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = kyber_class_show,
+		.write = kyber_class_write,
+	},
+	{ }	/* terminate */
+};
+
+static struct blkcg_policy blkcg_policy_kyber = {
+	.dfl_cftypes		= kyber_blkcg_files,
+	.legacy_cftypes		= kyber_blkcg_legacy_files,
+
+	.cpd_alloc_fn		= kyber_cpd_alloc,
+	.cpd_init_fn		= kyber_cpd_init,
+	.cpd_free_fn		= kyber_cpd_free,
+};
+
+static void kyber_blkcg_register(void)
+{
+	int ret;
+
+	/* Without a policy slot, classes still follow ioprio. */
+	ret = blkcg_policy_register(&blkcg_policy_kyber);
+	if (ret) {
+		pr_warn("kyber: blkcg policy unavailable (%d)\n", ret);
+		return;
+	}
+	kyber_blkcg_registered = true;
+}
+
+static void kyber_blkcg_unregister(void)
+{
+	if (kyber_blkcg_registered)
+		blkcg_policy_unregister(&blkcg_policy_kyber);
+}
+#else
+static inline void kyber_blkcg_register(void) { }
+static inline void kyber_blkcg_unregister(void) { }
+#endif
+
 static struct elevator_type kyber_sched = {
 	.ops.mq = {
 		.init_sched = kyber_init_sched,
@@ -831,12 +1226,19 @@ static struct elevator_type kyber_sched = {
 
 static int __init kyber_init(void)
 {
-	return elv_register(&kyber_sched);
+	int ret;
+
+	kyber_blkcg_register();
+	ret = elv_register(&kyber_sched);
+	if (ret)
+		kyber_blkcg_unregister();
+	return ret;
 }
 
 static void __exit kyber_exit(void)
 {
 	elv_unregister(&kyber_sched);
+	kyber_blkcg_unregister();
 }
 
 module_init(kyber_init);
@@ -16,6 +16,8 @@
 #include <linux/compiler.h>
 #include <linux/rbtree.h>
 #include <linux/sbitmap.h>
+#include <linux/ioprio.h>
+#include <linux/blk-cgroup.h>
 
 #include "blk.h"
 #include "blk-mq.h"
@@ -31,12 +33,38 @@ static const int write_expire = 5 * HZ; /* ditto for writes, these limits are SO
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+static const int aging_expire = 10 * HZ; /* max time a lower class waits past its
+				     deadline before it preempts higher ones */
 
-struct deadline_data {
-	/*
-	 * run time data
-	 */
+/*
+ * Requests are sorted into classes by the app state of their submitter, so
+ * that I/O of the app in front of the user is not stuck behind background
+ * writeback, dexopt or filesystem GC. Lower values are served first.
+ */
+enum dd_class {
+	DD_CLASS_TOP_APP	= 0,
+	DD_CLASS_FOREGROUND	= 1,
+	DD_CLASS_BACKGROUND	= 2,
+	DD_CLASS_COUNT,
+	DD_CLASS_UNSET		= DD_CLASS_COUNT,
+};
 
+static const char *const dd_class_name[DD_CLASS_COUNT] = {
+	[DD_CLASS_TOP_APP]	= "top-app",
+	[DD_CLASS_FOREGROUND]	= "foreground",
+	[DD_CLASS_BACKGROUND]	= "background",
+};
+
+struct dd_class_stats {
+	u32 inserted;
+	u32 merged;
+	u32 dispatched;
+	atomic64_t completed;
+	atomic64_t total_lat_ns;
+	atomic64_t max_lat_ns;
+};
+
+struct dd_per_class {
 	/*
 	 * requests (deadline_rq s) are present on both sort_list and fifo_list
 	 */
@@ -50,6 +78,15 @@ struct deadline_data {
 	unsigned int batching;		/* number of sequential requests made */
 	unsigned int starved;		/* times reads have starved writes */
 
+	struct dd_class_stats stats;
+};
+
+struct deadline_data {
+	/*
+	 * run time data
+	 */
+	struct dd_per_class per_class[DD_CLASS_COUNT];
+
 	/*
 	 * settings that change how the i/o scheduler behaves
 	 */
@@ -57,15 +94,108 @@ struct deadline_data {
 	int fifo_batch;
 	int writes_starved;
 	int front_merges;
+	int aging_expire;
+	int fast_read;
 
 	spinlock_t lock;
 	struct list_head dispatch;
 };
 
+/*
+ * The class and allocation time of a request are stashed in elv.priv by
+ * dd_prepare_request(). Requests that never went through it (flushes) are
+ * treated as foreground.
+ */
+static inline enum dd_class dd_rq_class(struct request *rq)
+{
+	if (!(rq->rq_flags & RQF_ELVPRIV))
+		return DD_CLASS_FOREGROUND;
+	return (enum dd_class)(unsigned long)rq->elv.priv[0];
+}
+
+static inline struct dd_per_class *
+dd_rq_per_class(struct deadline_data *dd, struct request *rq)
+{
+	return &dd->per_class[dd_rq_class(rq)];
+}
+
 static inline struct rb_root *
 deadline_rb_root(struct deadline_data *dd, struct request *rq)
 {
-	return &dd->sort_list[rq_data_dir(rq)];
+	return &dd_rq_per_class(dd, rq)->sort_list[rq_data_dir(rq)];
+}
+
+#ifdef CONFIG_BLK_CGROUP
+/*
+ * Per blkio cgroup class, set through blkio.deadline.class by the platform
+ * for its top-app, foreground and background groups.
+ */
+struct dd_blkcg_data {
+	struct blkcg_policy_data cpd;
+	enum dd_class class;
+};
+
+static struct blkcg_policy blkcg_policy_dd;
+static bool dd_blkcg_registered;
+
+static inline struct dd_blkcg_data *cpd_to_ddcd(struct blkcg_policy_data *cpd)
+{
+	return cpd ? container_of(cpd, struct dd_blkcg_data, cpd) : NULL;
+}
+
+static enum dd_class dd_blkcg_class(struct bio *bio)
+{
+	enum dd_class class = DD_CLASS_UNSET;
+	struct dd_blkcg_data *ddcd;
+
+	if (!dd_blkcg_registered)
+		return class;
+
+	rcu_read_lock();
+	ddcd = cpd_to_ddcd(blkcg_to_cpd(bio_blkcg(bio), &blkcg_policy_dd));
+	if (ddcd)
+		class = READ_ONCE(ddcd->class);
+	rcu_read_unlock();
+
+	return class;
+}
+#else
+static inline enum dd_class dd_blkcg_class(struct bio *bio)
+{
+	return DD_CLASS_UNSET;
+}
+#endif
+
+/*
+ * Background writeback and idle-class I/O always go to the background
+ * class. Otherwise the cgroup decides, and without a cgroup setting the
+ * I/O priority class of the submitter does.
+ */
+static enum dd_class dd_bio_class(struct bio *bio)
+{
+	struct io_context *ioc;
+	enum dd_class class;
+	int ioprio;
+
+	if (bio && (bio->bi_opf & REQ_BACKGROUND))
+		return DD_CLASS_BACKGROUND;
+
+	ioprio = bio ? bio_prio(bio) : 0;
+	if (!ioprio_valid(ioprio)) {
+		ioc = rq_ioc(bio);
+		if (ioc)
+			ioprio = ioc->ioprio;
+	}
+	if (IOPRIO_PRIO_CLASS(ioprio) == IOPRIO_CLASS_IDLE)
+		return DD_CLASS_BACKGROUND;
+
+	class = dd_blkcg_class(bio);
+	if (class != DD_CLASS_UNSET)
+		return class;
+
+	if (IOPRIO_PRIO_CLASS(ioprio) == IOPRIO_CLASS_RT)
+		return DD_CLASS_TOP_APP;
+	return DD_CLASS_FOREGROUND;
 }
 
 /*
@@ -93,10 +223,11 @@ deadline_add_rq_rb(struct deadline_data *dd, struct request *rq)
 static inline void
 deadline_del_rq_rb(struct deadline_data *dd, struct request *rq)
 {
+	struct dd_per_class *dc = dd_rq_per_class(dd, rq);
 	const int data_dir = rq_data_dir(rq);
 
-	if (dd->next_rq[data_dir] == rq)
-		dd->next_rq[data_dir] = deadline_latter_request(rq);
+	if (dc->next_rq[data_dir] == rq)
+		dc->next_rq[data_dir] = deadline_latter_request(rq);
 
 	elv_rb_del(deadline_rb_root(dd, rq), rq);
 }
@@ -138,11 +269,17 @@ static void dd_request_merged(struct request_queue *q, struct request *req,
 static void dd_merged_requests(struct request_queue *q, struct request *req,
 			       struct request *next)
 {
+	struct deadline_data *dd = q->elevator->elevator_data;
+
+	dd_rq_per_class(dd, next)->stats.merged++;
+
 	/*
 	 * if next expires before rq, assign its expire time to rq
-	 * and move into next position (next will be deleted) in fifo
+	 * and move into next position (next will be deleted) in fifo.
+	 * Only within a class, fifo lists are per class.
 	 */
-	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    dd_rq_class(req) == dd_rq_class(next)) {
 		if (time_before((unsigned long)next->fifo_time,
 				(unsigned long)req->fifo_time)) {
 			list_move(&req->queuelist, &next->queuelist);
@@ -162,11 +299,13 @@ static void dd_merged_requests(struct request_queue *q, struct request *req,
 static void
 deadline_move_request(struct deadline_data *dd, struct request *rq)
 {
+	struct dd_per_class *dc = dd_rq_per_class(dd, rq);
 	const int data_dir = rq_data_dir(rq);
 
-	dd->next_rq[READ] = NULL;
-	dd->next_rq[WRITE] = NULL;
-	dd->next_rq[data_dir] = deadline_latter_request(rq);
+	dc->next_rq[READ] = NULL;
+	dc->next_rq[WRITE] = NULL;
+	dc->next_rq[data_dir] = deadline_latter_request(rq);
+	dc->stats.dispatched++;
 
 	/*
 	 * take it off the sort and fifo list
@@ -176,50 +315,74 @@ deadline_move_request(struct deadline_data *dd, struct request *rq)
 
 /*
  * deadline_check_fifo returns 0 if there are no expired requests on the fifo,
- * 1 otherwise. Requires !list_empty(&dd->fifo_list[data_dir])
+ * 1 otherwise. Requires !list_empty(&dc->fifo_list[data_dir])
  */
-static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
+static inline int deadline_check_fifo(struct dd_per_class *dc, int ddir,
+				      unsigned long slack)
 {
-	struct request *rq = rq_entry_fifo(dd->fifo_list[ddir].next);
+	struct request *rq = rq_entry_fifo(dc->fifo_list[ddir].next);
 
 	/*
 	 * rq is expired!
 	 */
-	if (time_after_eq(jiffies, (unsigned long)rq->fifo_time))
+	if (time_after_eq(jiffies, (unsigned long)rq->fifo_time + slack))
 		return 1;
 
 	return 0;
 }
 
 /*
- * deadline_dispatch_requests selects the best request according to
- * read/write expire, fifo_batch, etc
+ * Pick the next request of @dc, starting a new batch at the fifo head if
+ * its deadline expired or the batch ran out of higher-sectored requests.
  */
-static struct request *__dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
+static struct request *
+deadline_find_request(struct deadline_data *dd, struct dd_per_class *dc,
+		      int data_dir)
 {
-	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
 	struct request *rq;
-	bool reads, writes;
-	int data_dir;
 
-	if (!list_empty(&dd->dispatch)) {
-		rq = list_first_entry(&dd->dispatch, struct request, queuelist);
-		list_del_init(&rq->queuelist);
-		goto done;
+	if (deadline_check_fifo(dc, data_dir, 0) || !dc->next_rq[data_dir]) {
+		/*
+		 * A deadline has expired, the last request was in the other
+		 * direction, or we have run out of higher-sectored requests.
+		 * Start again from the request with the earliest expiry time.
+		 */
+		rq = rq_entry_fifo(dc->fifo_list[data_dir].next);
+	} else {
+		/*
+		 * The last req was the same dir and we have a next request in
+		 * sort order. No expired requests so continue on from here.
+		 */
+		rq = dc->next_rq[data_dir];
 	}
 
-	reads = !list_empty(&dd->fifo_list[READ]);
-	writes = !list_empty(&dd->fifo_list[WRITE]);
+	dc->batching = 0;
+	return rq;
+}
+
+/*
+ * deadline_dispatch_class selects the best request of one class according
+ * to read/write expire, fifo_batch, etc
+ */
+static struct request *
+deadline_dispatch_class(struct deadline_data *dd, struct dd_per_class *dc)
+{
+	struct request *rq;
+	bool reads, writes;
+	int data_dir;
+
+	reads = !list_empty(&dc->fifo_list[READ]);
+	writes = !list_empty(&dc->fifo_list[WRITE]);
 
 	/*
 	 * batches are currently reads XOR writes
 	 */
-	if (dd->next_rq[WRITE])
-		rq = dd->next_rq[WRITE];
+	if (dc->next_rq[WRITE])
+		rq = dc->next_rq[WRITE];
 	else
-		rq = dd->next_rq[READ];
+		rq = dc->next_rq[READ];
 
-	if (rq && dd->batching < dd->fifo_batch)
+	if (rq && dc->batching < dd->fifo_batch)
 		/* we have a next request are still entitled to batch */
 		goto dispatch_request;
 
@@ -229,9 +392,9 @@ static struct request *__dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 	 */
 
 	if (reads) {
-		BUG_ON(RB_EMPTY_ROOT(&dd->sort_list[READ]));
+		BUG_ON(RB_EMPTY_ROOT(&dc->sort_list[READ]));
 
-		if (writes && (dd->starved++ >= dd->writes_starved))
+		if (writes && (dc->starved++ >= dd->writes_starved))
 			goto dispatch_writes;
 
 		data_dir = READ;
@@ -245,9 +408,9 @@ static struct request *__dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 
 	if (writes) {
 dispatch_writes:
-		BUG_ON(RB_EMPTY_ROOT(&dd->sort_list[WRITE]));
+		BUG_ON(RB_EMPTY_ROOT(&dc->sort_list[WRITE]));
 
-		dd->starved = 0;
+		dc->starved = 0;
 
 		data_dir = WRITE;
 
@@ -260,29 +423,99 @@ dispatch_find_request:
 	/*
 	 * we are not running a batch, find best request for selected data_dir
 	 */
-	if (deadline_check_fifo(dd, data_dir) || !dd->next_rq[data_dir]) {
-		/*
-		 * A deadline has expired, the last request was in the other
-		 * direction, or we have run out of higher-sectored requests.
-		 * Start again from the request with the earliest expiry time.
-		 */
-		rq = rq_entry_fifo(dd->fifo_list[data_dir].next);
-	} else {
-		/*
-		 * The last req was the same dir and we have a next request in
-		 * sort order. No expired requests so continue on from here.
-		 */
-		rq = dd->next_rq[data_dir];
-	}
-
-	dd->batching = 0;
+	rq = deadline_find_request(dd, dc, data_dir);
 
 dispatch_request:
 	/*
 	 * rq is the selected appropriate request.
 	 */
-	dd->batching++;
+	dc->batching++;
+	deadline_move_request(dd, rq);
+	return rq;
+}
+
+/*
+ * Top-app reads are what an app launch waits on: serve them ahead of any
+ * batch in progress, unless top-app writes are already past their deadline.
+ */
+static struct request *deadline_dispatch_fast_read(struct deadline_data *dd)
+{
+	struct dd_per_class *dc = &dd->per_class[DD_CLASS_TOP_APP];
+	struct request *rq;
+
+	if (!dd->fast_read || list_empty(&dc->fifo_list[READ]))
+		return NULL;
+
+	if (!list_empty(&dc->fifo_list[WRITE]) &&
+	    deadline_check_fifo(dc, WRITE, 0))
+		return NULL;
+
+	rq = dc->next_rq[READ];
+	if (!rq || dc->batching >= dd->fifo_batch)
+		rq = deadline_find_request(dd, dc, READ);
+
+	dc->batching++;
 	deadline_move_request(dd, rq);
+	return rq;
+}
+
+/*
+ * Keep lower classes from being starved for good: once the oldest request
+ * of a class is aging_expire past its deadline, it goes before everything
+ * but the dispatch list.
+ */
+static struct request *deadline_dispatch_aged(struct deadline_data *dd)
+{
+	unsigned long slack = dd->aging_expire;
+	struct dd_per_class *dc;
+	int class, data_dir;
+
+	for (class = DD_CLASS_COUNT - 1; class > DD_CLASS_TOP_APP; class--) {
+		dc = &dd->per_class[class];
+		for (data_dir = READ; data_dir <= WRITE; data_dir++) {
+			struct request *rq;
+
+			if (list_empty(&dc->fifo_list[data_dir]) ||
+			    !deadline_check_fifo(dc, data_dir, slack))
+				continue;
+
+			rq = rq_entry_fifo(dc->fifo_list[data_dir].next);
+			dc->batching = 1;
+			deadline_move_request(dd, rq);
+			return rq;
+		}
+	}
+
+	return NULL;
+}
+
+static struct request *__dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
+{
+	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct request *rq;
+	int class;
+
+	if (!list_empty(&dd->dispatch)) {
+		rq = list_first_entry(&dd->dispatch, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		goto done;
+	}
+
+	rq = deadline_dispatch_aged(dd);
+	if (rq)
+		goto done;
+
+	rq = deadline_dispatch_fast_read(dd);
+	if (rq)
+		goto done;
+
+	for (class = 0; class < DD_CLASS_COUNT; class++) {
+		rq = deadline_dispatch_class(dd, &dd->per_class[class]);
+		if (rq)
+			goto done;
+	}
+
+	return NULL;
 done:
 	rq->rq_flags |= RQF_STARTED;
 	return rq;
@@ -303,9 +536,12 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 static void dd_exit_queue(struct elevator_queue *e)
 {
 	struct deadline_data *dd = e->elevator_data;
+	int class;
 
-	BUG_ON(!list_empty(&dd->fifo_list[READ]));
-	BUG_ON(!list_empty(&dd->fifo_list[WRITE]));
+	for (class = 0; class < DD_CLASS_COUNT; class++) {
+		BUG_ON(!list_empty(&dd->per_class[class].fifo_list[READ]));
+		BUG_ON(!list_empty(&dd->per_class[class].fifo_list[WRITE]));
+	}
 
 	kfree(dd);
 }
@@ -317,6 +553,7 @@ static int dd_init_queue(struct request_queue *q, struct elevator_type *e)
 {
 	struct deadline_data *dd;
 	struct elevator_queue *eq;
+	int class;
 
 	eq = elevator_alloc(q, e);
 	if (!eq)
@@ -329,15 +566,21 @@ static int dd_init_queue(struct request_queue *q, struct elevator_type *e)
 	}
 	eq->elevator_data = dd;
 
-	INIT_LIST_HEAD(&dd->fifo_list[READ]);
-	INIT_LIST_HEAD(&dd->fifo_list[WRITE]);
-	dd->sort_list[READ] = RB_ROOT;
-	dd->sort_list[WRITE] = RB_ROOT;
+	for (class = 0; class < DD_CLASS_COUNT; class++) {
+		struct dd_per_class *dc = &dd->per_class[class];
+
+		INIT_LIST_HEAD(&dc->fifo_list[READ]);
+		INIT_LIST_HEAD(&dc->fifo_list[WRITE]);
+		dc->sort_list[READ] = RB_ROOT;
+		dc->sort_list[WRITE] = RB_ROOT;
+	}
 	dd->fifo_expire[READ] = read_expire;
 	dd->fifo_expire[WRITE] = write_expire;
 	dd->writes_starved = writes_starved;
 	dd->front_merges = 1;
 	dd->fifo_batch = fifo_batch;
+	dd->aging_expire = aging_expire;
+	dd->fast_read = 1;
 	spin_lock_init(&dd->lock);
 	INIT_LIST_HEAD(&dd->dispatch);
 
@@ -350,12 +593,14 @@ static int dd_request_merge(struct request_queue *q, struct request **rq,
 {
 	struct deadline_data *dd = q->elevator->elevator_data;
 	sector_t sector = bio_end_sector(bio);
+	struct dd_per_class *dc;
 	struct request *__rq;
 
 	if (!dd->front_merges)
 		return ELEVATOR_NO_MERGE;
 
-	__rq = elv_rb_find(&dd->sort_list[bio_data_dir(bio)], sector);
+	dc = &dd->per_class[dd_bio_class(bio)];
+	__rq = elv_rb_find(&dc->sort_list[bio_data_dir(bio)], sector);
 	if (__rq) {
 		BUG_ON(sector != blk_rq_pos(__rq));
 
@@ -399,6 +644,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		return;
 
 	blk_mq_sched_request_inserted(rq);
+	dd_rq_per_class(dd, rq)->stats.inserted++;
 
 	if (at_head || blk_rq_is_passthrough(rq)) {
 		if (at_head)
@@ -418,7 +664,8 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		 * set expire time and add to fifo list
 		 */
 		rq->fifo_time = jiffies + dd->fifo_expire[data_dir];
-		list_add_tail(&rq->queuelist, &dd->fifo_list[data_dir]);
+		list_add_tail(&rq->queuelist,
+			      &dd_rq_per_class(dd, rq)->fifo_list[data_dir]);
 	}
 }
 
@@ -442,10 +689,51 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	int class;
+
+	if (!list_empty_careful(&dd->dispatch))
+		return true;
+
+	for (class = 0; class < DD_CLASS_COUNT; class++) {
+		struct dd_per_class *dc = &dd->per_class[class];
 
-	return !list_empty_careful(&dd->dispatch) ||
-		!list_empty_careful(&dd->fifo_list[0]) ||
-		!list_empty_careful(&dd->fifo_list[1]);
+		if (!list_empty_careful(&dc->fifo_list[READ]) ||
+		    !list_empty_careful(&dc->fifo_list[WRITE]))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Runs in the context of the submitter, which is what the class is about.
+ */
+static void dd_prepare_request(struct request *rq, struct bio *bio)
+{
+	rq->elv.priv[0] = (void *)(unsigned long)dd_bio_class(bio);
+	rq->elv.priv[1] = (void *)(unsigned long)ktime_get_ns();
+}
+
+static void dd_finish_request(struct request *rq)
+{
+	struct deadline_data *dd = rq->q->elevator->elevator_data;
+	struct dd_class_stats *stats = &dd_rq_per_class(dd, rq)->stats;
+	unsigned long start = (unsigned long)rq->elv.priv[1];
+	s64 lat, max;
+
+	/* Wraps on 32 bit after ~4s, fine for a latency estimate */
+	lat = (unsigned long)ktime_get_ns() - start;
+	atomic64_inc(&stats->completed);
+	atomic64_add(lat, &stats->total_lat_ns);
+
+	max = atomic64_read(&stats->max_lat_ns);
+	while (lat > max) {
+		s64 old = atomic64_cmpxchg(&stats->max_lat_ns, max, lat);
+
+		if (old == max)
+			break;
+		max = old;
+	}
 }
 
 /*
@@ -479,6 +767,8 @@ SHOW_FUNCTION(deadline_write_expire_show, dd->fifo_expire[WRITE], 1);
 SHOW_FUNCTION(deadline_writes_starved_show, dd->writes_starved, 0);
 SHOW_FUNCTION(deadline_front_merges_show, dd->front_merges, 0);
 SHOW_FUNCTION(deadline_fifo_batch_show, dd->fifo_batch, 0);
+SHOW_FUNCTION(deadline_aging_expire_show, dd->aging_expire, 1);
+SHOW_FUNCTION(deadline_fast_read_show, dd->fast_read, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -502,6 +792,8 @@ STORE_FUNCTION(deadline_write_expire_store, &dd->fifo_expire[WRITE], 0, INT_MAX,
 STORE_FUNCTION(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX, 0);
 STORE_FUNCTION(deadline_front_merges_store, &dd->front_merges, 0, 1, 0);
 STORE_FUNCTION(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(deadline_aging_expire_store, &dd->aging_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(deadline_fast_read_store, &dd->fast_read, 0, 1, 0);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -514,20 +806,23 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(writes_starved),
 	DD_ATTR(front_merges),
 	DD_ATTR(fifo_batch),
+	DD_ATTR(aging_expire),
+	DD_ATTR(fast_read),
 	__ATTR_NULL
 };
 
 #ifdef CONFIG_BLK_DEBUG_FS
-#define DEADLINE_DEBUGFS_DDIR_ATTRS(ddir, name)				\
+#define DEADLINE_DEBUGFS_DDIR_ATTRS(class, ddir, name)			\
 static void *deadline_##name##_fifo_start(struct seq_file *m,		\
 					  loff_t *pos)			\
 	__acquires(&dd->lock)						\
 {									\
 	struct request_queue *q = m->private;				\
 	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct dd_per_class *dc = &dd->per_class[class];		\
 									\
 	spin_lock(&dd->lock);						\
-	return seq_list_start(&dd->fifo_list[ddir], *pos);		\
+	return seq_list_start(&dc->fifo_list[ddir], *pos);		\
 }									\
 									\
 static void *deadline_##name##_fifo_next(struct seq_file *m, void *v,	\
@@ -535,8 +830,9 @@ static void *deadline_##name##_fifo_next(struct seq_file *m, void *v,	\
 {									\
 	struct request_queue *q = m->private;				\
 	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct dd_per_class *dc = &dd->per_class[class];		\
 									\
-	return seq_list_next(v, &dd->fifo_list[ddir], pos);		\
+	return seq_list_next(v, &dc->fifo_list[ddir], pos);		\
 }									\
 									\
 static void deadline_##name##_fifo_stop(struct seq_file *m, void *v)	\
@@ -560,22 +856,30 @@ static int deadline_##name##_next_rq_show(void *data,			\
 {									\
 	struct request_queue *q = data;					\
 	struct deadline_data *dd = q->elevator->elevator_data;		\
-	struct request *rq = dd->next_rq[ddir];				\
+	struct dd_per_class *dc = &dd->per_class[class];		\
+	struct request *rq = dc->next_rq[ddir];				\
 									\
 	if (rq)								\
 		__blk_mq_debugfs_rq_show(m, rq);			\
 	return 0;							\
 }
-DEADLINE_DEBUGFS_DDIR_ATTRS(READ, read)
-DEADLINE_DEBUGFS_DDIR_ATTRS(WRITE, write)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_CLASS_TOP_APP, READ, read0)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_CLASS_TOP_APP, WRITE, write0)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_CLASS_FOREGROUND, READ, read1)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_CLASS_FOREGROUND, WRITE, write1)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_CLASS_BACKGROUND, READ, read2)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_CLASS_BACKGROUND, WRITE, write2)
 #undef DEADLINE_DEBUGFS_DDIR_ATTRS
 
 static int deadline_batching_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
 	struct deadline_data *dd = q->elevator->elevator_data;
+	int class;
 
-	seq_printf(m, "%u\n", dd->batching);
+	for (class = 0; class < DD_CLASS_COUNT; class++)
+		seq_printf(m, "%s: %u\n", dd_class_name[class],
+			   dd->per_class[class].batching);
 	return 0;
 }
 
@@ -583,8 +887,33 @@ static int deadline_starved_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
 	struct deadline_data *dd = q->elevator->elevator_data;
+	int class;
+
+	for (class = 0; class < DD_CLASS_COUNT; class++)
+		seq_printf(m, "%s: %u\n", dd_class_name[class],
+			   dd->per_class[class].starved);
+	return 0;
+}
 
-	seq_printf(m, "%u\n", dd->starved);
+static int deadline_class_stats_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+	int class;
+
+	for (class = 0; class < DD_CLASS_COUNT; class++) {
+		struct dd_class_stats *stats = &dd->per_class[class].stats;
+		u64 completed = atomic64_read(&stats->completed);
+		u64 total = atomic64_read(&stats->total_lat_ns);
+
+		seq_printf(m, "%s: inserted %u merged %u dispatched %u completed %llu lat_avg_us %llu lat_max_us %llu\n",
+			   dd_class_name[class], stats->inserted,
+			   stats->merged, stats->dispatched, completed,
+			   completed ? div64_u64(total, completed) /
+				       NSEC_PER_USEC : 0,
+			   (u64)atomic64_read(&stats->max_lat_ns) /
+				NSEC_PER_USEC);
+	}
 	return 0;
 }
 
@@ -626,16 +955,136 @@ static const struct seq_operations deadline_dispatch_seq_ops = {
 	{#name "_fifo_list", 0400, .seq_ops = &deadline_##name##_fifo_seq_ops},	\
 	{#name "_next_rq", 0400, deadline_##name##_next_rq_show}
 static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
-	DEADLINE_QUEUE_DDIR_ATTRS(read),
-	DEADLINE_QUEUE_DDIR_ATTRS(write),
+	DEADLINE_QUEUE_DDIR_ATTRS(read0),
+	DEADLINE_QUEUE_DDIR_ATTRS(write0),
+	DEADLINE_QUEUE_DDIR_ATTRS(read1),
+	DEADLINE_QUEUE_DDIR_ATTRS(write1),
+	DEADLINE_QUEUE_DDIR_ATTRS(read2),
+	DEADLINE_QUEUE_DDIR_ATTRS(write2),
 	{"batching", 0400, deadline_batching_show},
 	{"starved", 0400, deadline_starved_show},
+	{"class_stats", 0400, deadline_class_stats_show},
 	{"dispatch", 0400, .seq_ops = &deadline_dispatch_seq_ops},
 	{},
 };
 #undef DEADLINE_QUEUE_DDIR_ATTRS
 #endif
 
+#ifdef CONFIG_BLK_CGROUP
+static struct blkcg_policy_data *dd_cpd_alloc(gfp_t gfp)
+{
+	struct dd_blkcg_data *ddcd;
+
+	ddcd = kzalloc(sizeof(*ddcd), gfp);
+	if (!ddcd)
+		return NULL;
+	return &ddcd->cpd;
+}
+
+static void dd_cpd_init(struct blkcg_policy_data *cpd)
+{
+	cpd_to_ddcd(cpd)->class = DD_CLASS_UNSET;
+}
+
+static void dd_cpd_free(struct blkcg_policy_data *cpd)
+{
+	kfree(cpd_to_ddcd(cpd));
+}
+
+static int dd_class_show(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+	struct dd_blkcg_data *ddcd;
+	enum dd_class class;
+
+	ddcd = cpd_to_ddcd(blkcg_to_cpd(blkcg, &blkcg_policy_dd));
+	class = ddcd ? READ_ONCE(ddcd->class) : DD_CLASS_UNSET;
+	seq_printf(sf, "%s\n",
+		   class < DD_CLASS_COUNT ? dd_class_name[class] : "none");
+	return 0;
+}
+
+static ssize_t dd_class_write(struct kernfs_open_file *of, char *buf,
+			      size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct dd_blkcg_data *ddcd;
+	enum dd_class class;
+
+	buf = strstrip(buf);
+	if (!strcmp(buf, "none")) {
+		class = DD_CLASS_UNSET;
+	} else {
+		for (class = 0; class < DD_CLASS_COUNT; class++)
+			if (!strcmp(buf, dd_class_name[class]))
+				break;
+		if (class == DD_CLASS_COUNT)
+			return -EINVAL;
+	}
+
+	ddcd = cpd_to_ddcd(blkcg_to_cpd(blkcg, &blkcg_policy_dd));
+	if (!ddcd)
+		return -ENODEV;
+	WRITE_ONCE(ddcd->class, class);
+
+	return nbytes;
+}
+
+static struct cftype dd_blkcg_legacy_files[] = {
+	{
+		.name = "deadline.class",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = dd_class_show,
+		.write = dd_class_write,
+	},
+	{ }	/* terminate */
+};
+
+static struct cftype dd_blkcg_files[] = {
+	{
+		.name = "deadline.class",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = dd_class_show,
+		.write = dd_class_write,
+	},
+	{ }	/* terminate */
+};
+
+static struct blkcg_policy blkcg_policy_dd = {
+	.dfl_cftypes		= dd_blkcg_files,
+	.legacy_cftypes		= dd_blkcg_legacy_files,
+
+	.cpd_alloc_fn		= dd_cpd_alloc,
+	.cpd_init_fn		= dd_cpd_init,
+	.cpd_free_fn		= dd_cpd_free,
+};
+
+static void dd_blkcg_register(void)
+{
+	int ret;
+
+	/*
+	 * Classification by cgroup is optional: without a free policy
+	 * slot requests are still classified by ioprio and REQ_BACKGROUND.
+	 */
+	ret = blkcg_policy_register(&blkcg_policy_dd);
+	if (ret) {
+		pr_warn("mq-deadline: blkcg policy unavailable (%d)\n", ret);
+		return;
+	}
+	dd_blkcg_registered = true;
+}
+
+static void dd_blkcg_unregister(void)
+{
+	if (dd_blkcg_registered)
+		blkcg_policy_unregister(&blkcg_policy_dd);
+}
+#else
+static inline void dd_blkcg_register(void) { }
+static inline void dd_blkcg_unregister(void) { }
+#endif
+
 static struct elevator_type mq_deadline = {
 	.ops.mq = {
 		.insert_requests	= dd_insert_requests,
@@ -647,6 +1096,8 @@ static struct elevator_type mq_deadline = {
 		.requests_merged	= dd_merged_requests,
 		.request_merged		= dd_request_merged,
 		.has_work		= dd_has_work,
+		.prepare_request	= dd_prepare_request,
+		.finish_request		= dd_finish_request,
 		.init_sched		= dd_init_queue,
 		.exit_sched		= dd_exit_queue,
 	},
@@ -663,12 +1114,19 @@ MODULE_ALIAS("mq-deadline-iosched");
 
 static int __init deadline_init(void)
 {
-	return elv_register(&mq_deadline);
+	int ret;
+
+	dd_blkcg_register();
+	ret = elv_register(&mq_deadline);
+	if (ret)
+		dd_blkcg_unregister();
+	return ret;
 }
 
 static void __exit deadline_exit(void)
 {
 	elv_unregister(&mq_deadline);
+	dd_blkcg_unregister();
 }
 
 module_init(deadline_init);
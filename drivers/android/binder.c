@@ -56,6 +56,9 @@
 #include <linux/file.h>
 #include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/hashtable.h>
+#include <linux/jump_label.h>
+#include <linux/lat_hist.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
@@ -64,6 +67,7 @@
 #include <linux/poll.h>
 #include <linux/debugfs.h>
 #include <linux/rbtree.h>
+#include <linux/sched/clock.h>
 #include <linux/sched/signal.h>
 #include <linux/sched/mm.h>
 #include <linux/seq_file.h>
@@ -72,6 +76,7 @@
 #include <linux/security.h>
 #include <linux/spinlock.h>
 #include <linux/ratelimit.h>
+#include <linux/topology.h>
 
 #include <uapi/linux/android/binder.h>
 #include <uapi/linux/sched/types.h>
@@ -147,6 +152,18 @@ static int binder_set_stop_on_user_error(const char *val,
 module_param_call(stop_on_user_error, binder_set_stop_on_user_error,
 	param_get_int, &binder_stop_on_user_error, 0644);
 
+/* Prefer waiting threads that last ran near the caller */
+static bool binder_affine_wakeup = true;
+module_param_named(affine_wakeup, binder_affine_wakeup, bool, 0644);
+
+/* Let the handling thread inherit the caller's per-task boost */
+static bool binder_inherit_boost = true;
+module_param_named(inherit_boost, binder_inherit_boost, bool, 0644);
+
+/* Smallest BINDER_BUFFER_FLAG_ZERO_COPY buffer that is mapped, 0 = never */
+static unsigned int binder_zero_copy_min = 64 * SZ_1K;
+module_param_named(zero_copy_min, binder_zero_copy_min, uint, 0644);
+
 #define binder_debug(mask, x...) \
 	do { \
 		if (binder_debug_mask & mask) \
@@ -232,6 +249,131 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	return e;
 }
 
+/*
+ * Transaction latency histograms, aggregated per (caller, callee) process
+ * pair. Bucket n counts latencies in [2^(n-1), 2^n) us, bucket 0 counts
+ * those under 1us and the last bucket everything above. Recording is
+ * behind a static key, so it costs a patched-out branch while disabled.
+ */
+enum binder_latency_stage {
+	BINDER_LATENCY_QUEUE,	/* enqueue until a target thread reads it */
+	BINDER_LATENCY_HANDLE,	/* target thread read until BC_REPLY */
+	BINDER_LATENCY_REPLY,	/* BC_REPLY until the caller reads BR_REPLY */
+	BINDER_LATENCY_STAGE_COUNT
+};
+
+static const char * const binder_latency_stage_strings[] = {
+	"queue",
+	"handle",
+	"reply",
+};
+
+#define BINDER_LATENCY_BUCKETS		20
+#define BINDER_LATENCY_HASH_BITS	6
+#define BINDER_LATENCY_MAX_PAIRS	512
+
+struct binder_latency_hist {
+	u32 bucket[BINDER_LATENCY_BUCKETS];
+	u32 count;
+	u64 total_us;
+	u64 max_us;
+};
+
+struct binder_latency_pair {
+	struct hlist_node hnode;
+	int caller;
+	int callee;
+	struct binder_latency_hist hist[BINDER_LATENCY_STAGE_COUNT];
+};
+
+static DEFINE_STATIC_KEY_FALSE(binder_latency_key);
+static DEFINE_HASHTABLE(binder_latency_table, BINDER_LATENCY_HASH_BITS);
+static DEFINE_SPINLOCK(binder_latency_lock);
+static int binder_latency_pairs;
+static unsigned long binder_latency_dropped;
+static bool binder_latency_enabled;
+
+static void binder_latency_reset(void)
+{
+	struct binder_latency_pair *pair;
+	struct hlist_node *tmp;
+	int bkt;
+
+	spin_lock(&binder_latency_lock);
+	hash_for_each_safe(binder_latency_table, bkt, tmp, pair, hnode) {
+		hash_del(&pair->hnode);
+		kfree(pair);
+	}
+	binder_latency_pairs = 0;
+	binder_latency_dropped = 0;
+	spin_unlock(&binder_latency_lock);
+}
+
+/*
+ * Enabling latency_stats starts a fresh collection; disabling it stops
+ * recording but leaves the collected histograms readable.
+ */
+static int binder_set_latency_stats(const char *val,
+				    const struct kernel_param *kp)
+{
+	bool was_enabled = binder_latency_enabled;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret || binder_latency_enabled == was_enabled)
+		return ret;
+
+	if (binder_latency_enabled) {
+		binder_latency_reset();
+		static_branch_enable(&binder_latency_key);
+	} else {
+		static_branch_disable(&binder_latency_key);
+	}
+	return 0;
+}
+module_param_call(latency_stats, binder_set_latency_stats,
+	param_get_bool, &binder_latency_enabled, 0644);
+
+static void binder_latency_record(int caller, int callee,
+				  enum binder_latency_stage stage,
+				  ktime_t start, ktime_t end)
+{
+	struct binder_latency_pair *pair;
+	struct binder_latency_hist *hist;
+	u64 key = ((u64)(u32)caller << 32) | (u32)callee;
+	s64 delta = ktime_us_delta(end, start);
+	u64 us = delta > 0 ? delta : 0;
+
+	spin_lock(&binder_latency_lock);
+	hash_for_each_possible(binder_latency_table, pair, hnode, key) {
+		if (pair->caller == caller && pair->callee == callee)
+			goto found;
+	}
+	if (binder_latency_pairs >= BINDER_LATENCY_MAX_PAIRS) {
+		binder_latency_dropped++;
+		goto out;
+	}
+	pair = kzalloc(sizeof(*pair), GFP_ATOMIC | __GFP_NOWARN);
+	if (!pair) {
+		binder_latency_dropped++;
+		goto out;
+	}
+	pair->caller = caller;
+	pair->callee = callee;
+	hash_add(binder_latency_table, &pair->hnode, key);
+	binder_latency_pairs++;
+found:
+	hist = &pair->hist[stage];
+	hist->bucket[min_t(unsigned int, fls64(us),
+			   BINDER_LATENCY_BUCKETS - 1)]++;
+	hist->count++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+out:
+	spin_unlock(&binder_latency_lock);
+}
+
 /**
  * struct binder_work - work enqueued on a worklist
  * @entry:             node enqueued on list
@@ -643,6 +785,18 @@ struct binder_transaction {
 	bool    set_priority_called;
 	kuid_t	sender_euid;
 	binder_uintptr_t security_ctx;
+	/* latency_stats state, only set while binder_latency_key is on */
+	ktime_t enqueue_ts;
+	ktime_t pickup_ts;
+	int lat_caller;
+	int lat_callee;
+	/* caller's per-task boost, and the handler's to restore on reply */
+	int boost;
+	u64 boost_period;
+	u64 boost_expires;
+	int saved_boost;
+	u64 saved_boost_period;
+	u64 saved_boost_expires;
 	/**
 	 * @lock:  protects @from, @to_proc, and @to_thread
 	 *
@@ -1114,6 +1268,56 @@ static void binder_wakeup_thread_ilocked(struct binder_proc *proc,
 	binder_wakeup_poll_threads_ilocked(proc, sync);
 }
 
+#define BINDER_AFFINE_SCAN_MAX	8
+
+/**
+ * binder_select_affine_thread_ilocked() - select a thread close to the caller
+ * @proc:	process to select a thread from
+ * @sync:	%true for a synchronous transaction
+ *
+ * Like binder_select_thread_ilocked(), but looks at the first few waiting
+ * threads for one that last ran on the calling CPU (synchronous calls,
+ * where the caller is about to sleep) or, failing that, in the caller's
+ * cluster. Oneway callers keep running, so for those a cluster sibling
+ * other than the calling CPU is preferred. waiting_threads is LIFO, so
+ * ties go to the most recently idle, cache hot thread.
+ *
+ * Return:	the selected thread or NULL if none is waiting.
+ */
+static struct binder_thread *
+binder_select_affine_thread_ilocked(struct binder_proc *proc, bool sync)
+{
+	struct binder_thread *thread, *best = NULL;
+	int cpu = raw_smp_processor_id();
+	int best_score = -1;
+	int scanned = 0;
+
+	assert_spin_locked(&proc->inner_lock);
+	if (!binder_affine_wakeup)
+		return binder_select_thread_ilocked(proc);
+
+	list_for_each_entry(thread, &proc->waiting_threads,
+			    waiting_thread_node) {
+		int tcpu = task_cpu(thread->task);
+		int score = 0;
+
+		if (cpumask_test_cpu(tcpu, topology_core_cpumask(cpu)))
+			score = (sync == (tcpu == cpu)) ? 2 : 1;
+
+		if (score > best_score) {
+			best = thread;
+			best_score = score;
+		}
+		if (best_score == 2 || ++scanned >= BINDER_AFFINE_SCAN_MAX)
+			break;
+	}
+
+	if (best)
+		list_del_init(&best->waiting_thread_node);
+
+	return best;
+}
+
 static void binder_wakeup_proc_ilocked(struct binder_proc *proc)
 {
 	struct binder_thread *thread = binder_select_thread_ilocked(proc);
@@ -1262,6 +1466,32 @@ static void binder_transaction_priority(struct task_struct *task,
 	binder_set_priority(task, desired_prio);
 }
 
+/*
+ * Propagate the caller's per-task boost (see set_task_boost()) to the
+ * thread handling a synchronous transaction, so the handler is placed
+ * like the caller for as long as the caller's boost lasts. Only ever
+ * applied to and restored on current.
+ */
+static void binder_transaction_boost(struct binder_transaction *t)
+{
+	t->saved_boost = current->boost;
+	t->saved_boost_period = current->boost_period;
+	t->saved_boost_expires = current->boost_expires;
+
+	if (t->boost > current->boost) {
+		current->boost = t->boost;
+		current->boost_period = t->boost_period;
+		current->boost_expires = t->boost_expires;
+	}
+}
+
+static void binder_restore_boost(struct binder_transaction *t)
+{
+	current->boost = t->saved_boost;
+	current->boost_period = t->saved_boost_period;
+	current->boost_expires = t->saved_boost_expires;
+}
+
 static struct binder_node *binder_get_node_ilocked(struct binder_proc *proc,
 						   binder_uintptr_t ptr)
 {
@@ -2837,6 +3067,12 @@ static int binder_fixup_parent(struct binder_transaction *t,
 		return -EINVAL;
 	}
 
+	if (parent->flags & BINDER_BUFFER_FLAG_ZERO_COPY) {
+		binder_user_error("%d:%d got transaction with fixup in zero-copy buffer\n",
+				  proc->pid, thread->pid);
+		return -EINVAL;
+	}
+
 	if (!binder_validate_fixup(target_proc, b, off_start_offset,
 				   parent_offset, bp->parent_offset,
 				   last_fixup_obj_off,
@@ -2918,7 +3154,7 @@ static int binder_proc_transaction(struct binder_transaction *t,
 	}
 
 	if (!thread && !pending_async)
-		thread = binder_select_thread_ilocked(proc);
+		thread = binder_select_affine_thread_ilocked(proc, !oneway);
 
 	if (thread) {
 		binder_transaction_priority(thread->task, t, node_prio,
@@ -3000,11 +3236,15 @@ static void binder_set_txn_from_error(struct binder_transaction *t, int id,
 	binder_thread_dec_tmpref(from);
 }
 
+/* time to copy and queue a transaction, successful ones only */
+static DEFINE_LAT_HIST(binder_transaction_hist, "binder_transaction");
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply,
 			       binder_size_t extra_buffers_size)
 {
+	u64 lat_start = lat_hist_start();
 	int ret;
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
@@ -3239,6 +3479,12 @@ static void binder_transaction(struct binder_proc *proc,
 	else
 		t->from = NULL;
 	t->sender_euid = task_euid(proc->tsk);
+	if (binder_inherit_boost && !reply && !(tr->flags & TF_ONE_WAY) &&
+	    current->boost && sched_clock() < current->boost_expires) {
+		t->boost = current->boost;
+		t->boost_period = current->boost_period;
+		t->boost_expires = current->boost_expires;
+	}
 	t->to_proc = target_proc;
 	t->to_thread = target_thread;
 	t->code = tr->code;
@@ -3481,6 +3727,14 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error_line = __LINE__;
 				goto err_bad_parent;
 			}
+			if (parent->flags & BINDER_BUFFER_FLAG_ZERO_COPY) {
+				binder_user_error("%d:%d got transaction with fd array in zero-copy buffer\n",
+						  proc->pid, thread->pid);
+				return_error = BR_FAILED_REPLY;
+				return_error_param = -EINVAL;
+				return_error_line = __LINE__;
+				goto err_bad_parent;
+			}
 			if (!binder_validate_fixup(target_proc, t->buffer,
 						   off_start_offset,
 						   parent_offset,
@@ -3511,6 +3765,8 @@ static void binder_transaction(struct binder_proc *proc,
 				to_binder_buffer_object(hdr);
 			size_t buf_left = sg_buf_end_offset - sg_buf_offset;
 			size_t num_valid;
+			bool zero_copy = false;
+			unsigned long left;
 
 			if (bp->length > buf_left) {
 				binder_user_error("%d:%d got transaction with too large buffer\n",
@@ -3520,13 +3776,41 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error_line = __LINE__;
 				goto err_bad_offset;
 			}
-			if (binder_alloc_copy_user_to_buffer(
+			if ((bp->flags & BINDER_BUFFER_FLAG_ZERO_COPY) &&
+			    binder_zero_copy_min &&
+			    bp->length >= binder_zero_copy_min &&
+			    PAGE_ALIGNED(bp->buffer)) {
+				/*
+				 * Page align the target too, if the sender
+				 * left room for it, so whole pages line up.
+				 */
+				size_t pad = PAGE_ALIGN((uintptr_t)
+					t->buffer->user_data + sg_buf_offset) -
+					((uintptr_t)t->buffer->user_data +
+					 sg_buf_offset);
+
+				if (bp->length + pad <= buf_left) {
+					sg_buf_offset += pad;
+					zero_copy = true;
+				}
+			}
+			if (zero_copy)
+				left = binder_alloc_map_user_to_buffer(
+						&target_proc->alloc,
+						t->buffer,
+						sg_buf_offset,
+						(const void __user *)
+							(uintptr_t)bp->buffer,
+						bp->length);
+			else
+				left = binder_alloc_copy_user_to_buffer(
 						&target_proc->alloc,
 						t->buffer,
 						sg_buf_offset,
 						(const void __user *)
 							(uintptr_t)bp->buffer,
-						bp->length)) {
+						bp->length);
+			if (left) {
 				binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
 						  proc->pid, thread->pid);
 				return_error_param = -EFAULT;
@@ -3573,6 +3857,23 @@ static void binder_transaction(struct binder_proc *proc,
 		tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	t->work.type = BINDER_WORK_TRANSACTION;
 
+	if (static_branch_unlikely(&binder_latency_key)) {
+		t->enqueue_ts = ktime_get();
+		if (reply) {
+			t->lat_caller = target_proc->pid;
+			t->lat_callee = proc->pid;
+			if (in_reply_to->pickup_ts)
+				binder_latency_record(in_reply_to->lat_caller,
+						      in_reply_to->lat_callee,
+						      BINDER_LATENCY_HANDLE,
+						      in_reply_to->pickup_ts,
+						      t->enqueue_ts);
+		} else {
+			t->lat_caller = proc->pid;
+			t->lat_callee = target_proc->pid;
+		}
+	}
+
 	if (reply) {
 		binder_enqueue_thread_work(thread, tcomplete);
 		binder_inner_proc_lock(target_proc);
@@ -3588,6 +3889,7 @@ static void binder_transaction(struct binder_proc *proc,
 		binder_inner_proc_unlock(target_proc);
 		wake_up_interruptible_sync(&target_thread->wait);
 		binder_restore_priority(current, in_reply_to->saved_priority);
+		binder_restore_boost(in_reply_to);
 		binder_free_transaction(in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -3631,6 +3933,7 @@ static void binder_transaction(struct binder_proc *proc,
 	 */
 	smp_wmb();
 	WRITE_ONCE(e->debug_id_done, t_debug_id);
+	lat_hist_end(&binder_transaction_hist, lat_start);
 	return;
 
 err_dead_proc_or_thread:
@@ -3699,6 +4002,7 @@ err_invalid_target_handle:
 	BUG_ON(thread->return_error.cmd != BR_OK);
 	if (in_reply_to) {
 		binder_restore_priority(current, in_reply_to->saved_priority);
+		binder_restore_boost(in_reply_to);
 		binder_set_txn_from_error(in_reply_to, t_debug_id,
 				return_error, return_error_param);
 		thread->return_error.cmd = BR_TRANSACTION_COMPLETE;
@@ -4575,6 +4879,16 @@ retry:
 		}
 		ptr += trsize;
 
+		if (static_branch_unlikely(&binder_latency_key) &&
+		    t->enqueue_ts) {
+			t->pickup_ts = ktime_get();
+			binder_latency_record(t->lat_caller, t->lat_callee,
+					      cmd == BR_REPLY ?
+					      BINDER_LATENCY_REPLY :
+					      BINDER_LATENCY_QUEUE,
+					      t->enqueue_ts, t->pickup_ts);
+		}
+
 		trace_binder_transaction_received(t);
 		binder_stat_br(proc, thread, cmd);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
@@ -4593,6 +4907,7 @@ retry:
 			binder_thread_dec_tmpref(t_from);
 		t->buffer->allow_user_free = 1;
 		if (cmd != BR_REPLY && !(t->flags & TF_ONE_WAY)) {
+			binder_transaction_boost(t);
 			binder_inner_proc_lock(thread->proc);
 			t->to_parent = thread->transaction_stack;
 			t->to_thread = thread;
@@ -5182,6 +5497,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			proc->pid, current->pid, cmd, arg);*/
 
 	binder_selftest_alloc(&proc->alloc);
+	binder_alloc_bench(&proc->alloc);
 
 	trace_binder_ioctl(cmd, arg);
 
@@ -6315,6 +6631,42 @@ static int proc_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_latency_pair *pair;
+	struct binder_latency_hist *hist;
+	int bkt, stage, i, last;
+
+	seq_printf(m, "binder latency (%s, log2 us buckets):\n",
+		   binder_latency_enabled ? "enabled" : "disabled");
+
+	spin_lock(&binder_latency_lock);
+	hash_for_each(binder_latency_table, bkt, pair, hnode) {
+		for (stage = 0; stage < BINDER_LATENCY_STAGE_COUNT; stage++) {
+			hist = &pair->hist[stage];
+			if (!hist->count)
+				continue;
+			seq_printf(m, "  %d -> %d %s: count %u avg %llu max %llu:",
+				   pair->caller, pair->callee,
+				   binder_latency_stage_strings[stage],
+				   hist->count,
+				   div_u64(hist->total_us, hist->count),
+				   hist->max_us);
+			for (last = BINDER_LATENCY_BUCKETS - 1; last > 0; last--)
+				if (hist->bucket[last])
+					break;
+			for (i = 0; i <= last; i++)
+				seq_printf(m, " %u", hist->bucket[i]);
+			seq_puts(m, "\n");
+		}
+	}
+	if (binder_latency_dropped)
+		seq_printf(m, "  dropped: %lu\n", binder_latency_dropped);
+	spin_unlock(&binder_latency_lock);
+
+	return 0;
+}
+
 static void print_binder_transaction_log_entry(struct seq_file *m,
 					struct binder_transaction_log_entry *e)
 {
@@ -6448,6 +6800,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    0444,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
 
 	if (!IS_ENABLED(CONFIG_ANDROID_BINDERFS) &&
@@ -6474,6 +6831,7 @@ static int __init binder_init(void)
 	if (ret)
 		goto err_init_binder_device_failed;
 
+	lat_hist_register(&binder_transaction_hist);
 	return ret;
 
 err_init_binder_device_failed:
@@ -55,6 +55,14 @@ module_param_named(debug_mask, binder_alloc_debug_mask,
 			pr_info_ratelimited(x); \
 	} while (0)
 
+/* Serve buffers of up to a page from per size class free lists */
+static bool binder_alloc_size_classes = true;
+module_param_named(size_classes, binder_alloc_size_classes, bool, 0644);
+
+/* Maximum number of freed buffers parked on each size class list */
+static unsigned int binder_alloc_class_limit = 8;
+module_param_named(class_limit, binder_alloc_class_limit, uint, 0644);
+
 static struct binder_buffer *binder_buffer_next(struct binder_buffer *buffer)
 {
 	return list_entry(buffer->entry.next, struct binder_buffer, entry);
@@ -73,6 +81,64 @@ static size_t binder_alloc_buffer_size(struct binder_alloc *alloc,
 	return binder_buffer_next(buffer)->user_data - buffer->user_data;
 }
 
+static int binder_alloc_size_class(size_t size)
+{
+	if (size > PAGE_SIZE)
+		return -1;
+	size = max_t(size_t, size, 1 << BINDER_ALLOC_CLASS_MIN_SHIFT);
+	return order_base_2(size) - BINDER_ALLOC_CLASS_MIN_SHIFT;
+}
+
+static size_t binder_alloc_class_size(int class)
+{
+	return (size_t)1 << (class + BINDER_ALLOC_CLASS_MIN_SHIFT);
+}
+
+static struct binder_buffer *binder_alloc_class_get(struct binder_alloc *alloc,
+						    int class)
+{
+	struct binder_buffer *buffer;
+
+	buffer = list_first_entry_or_null(&alloc->class_free[class],
+					  struct binder_buffer, class_entry);
+	if (!buffer)
+		return NULL;
+
+	BUG_ON(!buffer->cached);
+	list_del_init(&buffer->class_entry);
+	buffer->cached = 0;
+	alloc->class_count[class]--;
+	return buffer;
+}
+
+/*
+ * Park a freed buffer on its size class list instead of returning it to
+ * the free_buffers tree. The buffer keeps free == 0 so that neighbours
+ * never merge with it, and its pages stay mapped and off the lru so the
+ * next allocation of that class needs neither a tree search nor a page
+ * range update.
+ */
+static bool binder_alloc_class_put(struct binder_alloc *alloc,
+				   struct binder_buffer *buffer,
+				   size_t buffer_size)
+{
+	int class;
+
+	if (!alloc->size_classes)
+		return false;
+
+	class = binder_alloc_size_class(buffer_size);
+	if (class < 0 || buffer_size != binder_alloc_class_size(class))
+		return false;
+	if (alloc->class_count[class] >= READ_ONCE(binder_alloc_class_limit))
+		return false;
+
+	buffer->cached = 1;
+	list_add(&buffer->class_entry, &alloc->class_free[class]);
+	alloc->class_count[class]++;
+	return true;
+}
+
 static void binder_insert_free_buffer(struct binder_alloc *alloc,
 				      struct binder_buffer *new_buffer)
 {
@@ -244,6 +310,7 @@ static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
 
 			on_lru = list_lru_del(&binder_alloc_lru, &page->lru);
 			WARN_ON(!on_lru);
+			alloc->page_lru_hits++;
 
 			trace_binder_alloc_lru_end(alloc, index);
 			continue;
@@ -274,6 +341,7 @@ static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
 
 		if (index + 1 > alloc->pages_high)
 			alloc->pages_high = index + 1;
+		alloc->page_maps++;
 
 		trace_binder_alloc_page_end(alloc, index);
 		/* vm_insert_page does not seem to increment the refcount */
@@ -294,8 +362,12 @@ free_range:
 
 		trace_binder_free_lru_start(alloc, index);
 
-		ret = list_lru_add(&binder_alloc_lru, &page->lru);
-		WARN_ON(!ret);
+		/* Borrowed sender pages are dropped, not put on the lru */
+		if (page->page_ptr) {
+			ret = list_lru_add(&binder_alloc_lru, &page->lru);
+			WARN_ON(!ret);
+			alloc->page_lru_puts++;
+		}
 
 		trace_binder_free_lru_end(alloc, index);
 		if (page_addr == start)
@@ -389,6 +461,8 @@ static bool debug_low_async_space_locked(struct binder_alloc *alloc, int pid)
 	return false;
 }
 
+static int binder_alloc_drain_classes(struct binder_alloc *alloc);
+
 static struct binder_buffer *binder_alloc_new_buf_locked(
 				struct binder_alloc *alloc,
 				size_t data_size,
@@ -397,13 +471,14 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				int is_async,
 				int pid)
 {
-	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	struct rb_node *best_fit = NULL;
 	void __user *has_page_addr;
 	void __user *end_page_addr;
 	size_t size, data_offsets_size;
+	int class = -1;
 	int ret;
 
 	if (!binder_alloc_get_vma(alloc)) {
@@ -429,6 +504,17 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				alloc->pid, extra_buffers_size);
 		return ERR_PTR(-EINVAL);
 	}
+
+	/* Pad 0-size buffers so they get assigned unique addresses */
+	size = max(size, sizeof(void *));
+
+	/* Round small buffers up to their size class so they can be reused */
+	if (alloc->size_classes) {
+		class = binder_alloc_size_class(size);
+		if (class >= 0)
+			size = binder_alloc_class_size(class);
+	}
+
 	if (is_async &&
 	    alloc->free_async_space < size + sizeof(struct binder_buffer)) {
 		binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
@@ -440,9 +526,20 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 		return ERR_PTR(-ENOSPC);
 	}
 
-	/* Pad 0-size buffers so they get assigned unique addresses */
-	size = max(size, sizeof(void *));
+	if (class >= 0) {
+		buffer = binder_alloc_class_get(alloc, class);
+		if (buffer) {
+			alloc->class_hits++;
+			binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
+				     "%d: binder_alloc_buf size %zd reused cached %pK\n",
+				      alloc->pid, size, buffer);
+			goto setup_buffer;
+		}
+		alloc->class_misses++;
+	}
 
+retry:
+	n = alloc->free_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -458,6 +555,8 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 			break;
 		}
 	}
+	if (best_fit == NULL && binder_alloc_drain_classes(alloc))
+		goto retry;
 	if (best_fit == NULL) {
 		size_t allocated_buffers = 0;
 		size_t largest_alloc_size = 0;
@@ -531,6 +630,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	}
 
 	rb_erase(best_fit, &alloc->free_buffers);
+setup_buffer:
 	buffer->free = 0;
 	buffer->allow_user_free = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
@@ -659,6 +759,84 @@ static void binder_delete_free_buffer(struct binder_alloc *alloc,
 	kfree(buffer);
 }
 
+/**
+ * binder_alloc_return_pages() - drop sender pages mapped into a buffer
+ * @alloc:	binder_alloc for this proc
+ * @buffer:	buffer being freed
+ * @buffer_size: size of @buffer
+ *
+ * Unmap every borrowed page in @buffer and release the reference taken
+ * when it was pinned. The slots are left unpopulated, so the next
+ * allocation covering them gets fresh, zeroed binder pages.
+ */
+static void binder_alloc_return_pages(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer,
+				      size_t buffer_size)
+{
+	void __user *page_addr;
+	void __user *end;
+	struct vm_area_struct *vma = NULL;
+	struct mm_struct *mm = NULL;
+
+	if (mmget_not_zero(alloc->vma_vm_mm)) {
+		mm = alloc->vma_vm_mm;
+		down_read(&mm->mmap_sem);
+		vma = alloc->vma;
+	}
+
+	page_addr = (void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data);
+	end = (void __user *)(((uintptr_t)buffer->user_data + buffer_size) &
+			      PAGE_MASK);
+	for (; page_addr < end; page_addr += PAGE_SIZE) {
+		struct binder_lru_page *page;
+
+		page = &alloc->pages[(page_addr - alloc->buffer) / PAGE_SIZE];
+		if (!page->borrowed)
+			continue;
+
+		if (vma)
+			zap_page_range(vma, (uintptr_t)page_addr, PAGE_SIZE);
+		put_page(page->page_ptr);
+		page->page_ptr = NULL;
+		page->borrowed = false;
+	}
+
+	if (mm) {
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+}
+
+static void binder_release_buf_locked(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer,
+				      size_t buffer_size)
+{
+	binder_update_page_range(alloc, 0,
+		(void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data),
+		(void __user *)(((uintptr_t)
+			  buffer->user_data + buffer_size) & PAGE_MASK));
+
+	buffer->free = 1;
+	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
+		struct binder_buffer *next = binder_buffer_next(buffer);
+
+		if (next->free) {
+			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_delete_free_buffer(alloc, next);
+		}
+	}
+	if (alloc->buffers.next != &buffer->entry) {
+		struct binder_buffer *prev = binder_buffer_prev(buffer);
+
+		if (prev->free) {
+			binder_delete_free_buffer(alloc, buffer);
+			rb_erase(&prev->rb_node, &alloc->free_buffers);
+			buffer = prev;
+		}
+	}
+	binder_insert_free_buffer(alloc, buffer);
+}
+
 static void binder_free_buf_locked(struct binder_alloc *alloc,
 				   struct binder_buffer *buffer)
 {
@@ -675,6 +853,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 		      alloc->pid, buffer, size, buffer_size);
 
 	BUG_ON(buffer->free);
+	BUG_ON(buffer->cached);
 	BUG_ON(size > buffer_size);
 	BUG_ON(buffer->transaction != NULL);
 	BUG_ON(buffer->user_data < alloc->buffer);
@@ -688,31 +867,55 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 			      alloc->pid, size, alloc->free_async_space);
 	}
 
-	binder_update_page_range(alloc, 0,
-		(void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data),
-		(void __user *)(((uintptr_t)
-			  buffer->user_data + buffer_size) & PAGE_MASK));
-
 	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
-	buffer->free = 1;
-	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
-		struct binder_buffer *next = binder_buffer_next(buffer);
-
-		if (next->free) {
-			rb_erase(&next->rb_node, &alloc->free_buffers);
-			binder_delete_free_buffer(alloc, next);
-		}
+	if (buffer->has_borrowed) {
+		/* Returned slots are unpopulated, so never cache the buffer */
+		binder_alloc_return_pages(alloc, buffer, buffer_size);
+		buffer->has_borrowed = 0;
+	} else if (binder_alloc_class_put(alloc, buffer, buffer_size)) {
+		return;
 	}
-	if (alloc->buffers.next != &buffer->entry) {
-		struct binder_buffer *prev = binder_buffer_prev(buffer);
 
-		if (prev->free) {
-			binder_delete_free_buffer(alloc, buffer);
-			rb_erase(&prev->rb_node, &alloc->free_buffers);
-			buffer = prev;
+	binder_release_buf_locked(alloc, buffer, buffer_size);
+}
+
+/**
+ * binder_alloc_drain_classes() - return cached buffers to the free tree
+ * @alloc:	binder_alloc for this proc
+ *
+ * Release every buffer parked on the size class lists so its pages go
+ * back on the lru and its space can be merged with its neighbours.
+ *
+ * Return:	number of buffers released
+ */
+static int binder_alloc_drain_classes(struct binder_alloc *alloc)
+{
+	struct binder_buffer *buffer;
+	int class, count = 0;
+
+	for (class = 0; class < BINDER_ALLOC_NR_CLASSES; class++) {
+		while ((buffer = binder_alloc_class_get(alloc, class))) {
+			binder_release_buf_locked(alloc, buffer,
+				binder_alloc_buffer_size(alloc, buffer));
+			count++;
 		}
 	}
-	binder_insert_free_buffer(alloc, buffer);
+	return count;
+}
+
+/**
+ * binder_alloc_disable_size_classes() - stop using size class lists
+ * @alloc:	binder_alloc for this proc
+ *
+ * Drain the size class lists and serve all further allocations from the
+ * free_buffers tree. Used by the selftest, which checks exact page layout.
+ */
+void binder_alloc_disable_size_classes(struct binder_alloc *alloc)
+{
+	mutex_lock(&alloc->mutex);
+	alloc->size_classes = false;
+	binder_alloc_drain_classes(alloc);
+	mutex_unlock(&alloc->mutex);
 }
 
 static void binder_alloc_clear_buf(struct binder_alloc *alloc,
@@ -827,6 +1030,9 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 	mutex_lock(&alloc->mutex);
 	BUG_ON(alloc->vma);
 
+	alloc->size_classes = false;
+	binder_alloc_drain_classes(alloc);
+
 	while ((n = rb_first(&alloc->allocated_buffers))) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 
@@ -899,17 +1105,51 @@ static void print_binder_buffer(struct seq_file *m, const char *prefix,
  * @alloc: binder_alloc for this proc
  *
  * Prints information about every buffer associated with
- * the binder_alloc state to the given seq_file
+ * the binder_alloc state to the given seq_file, followed by
+ * free space fragmentation and size class counters
  */
 void binder_alloc_print_allocated(struct seq_file *m,
 				  struct binder_alloc *alloc)
 {
+	struct binder_buffer *buffer;
 	struct rb_node *n;
+	size_t buffer_size;
+	size_t total_free_size = 0;
+	size_t largest_free_size = 0;
+	size_t cached_size = 0;
+	int free_buffers = 0;
+	int class;
 
 	mutex_lock(&alloc->mutex);
 	for (n = rb_first(&alloc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+
+	for (n = rb_first(&alloc->free_buffers); n != NULL; n = rb_next(n)) {
+		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		buffer_size = binder_alloc_buffer_size(alloc, buffer);
+		free_buffers++;
+		total_free_size += buffer_size;
+		if (buffer_size > largest_free_size)
+			largest_free_size = buffer_size;
+	}
+	for (class = 0; class < BINDER_ALLOC_NR_CLASSES; class++)
+		cached_size += alloc->class_count[class] *
+			binder_alloc_class_size(class);
+
+	if (total_free_size)
+		seq_printf(m, "  free: %zd (num: %d largest: %zd frag: %zu%%)\n",
+			   total_free_size, free_buffers, largest_free_size,
+			   100 - largest_free_size * 100 / total_free_size);
+	seq_printf(m, "  size classes: %zd cached, hits %llu misses %llu\n",
+		   cached_size, alloc->class_hits, alloc->class_misses);
+	for (class = 0; class < BINDER_ALLOC_NR_CLASSES; class++) {
+		if (!alloc->class_count[class])
+			continue;
+		seq_printf(m, "    class %zd: %u\n",
+			   binder_alloc_class_size(class),
+			   alloc->class_count[class]);
+	}
 	mutex_unlock(&alloc->mutex);
 }
 
@@ -1031,6 +1271,7 @@ enum lru_status binder_alloc_free_page(struct list_head *item,
 
 	__free_page(page->page_ptr);
 	page->page_ptr = NULL;
+	alloc->page_unmaps++;
 
 	trace_binder_unmap_kernel_end(alloc, index);
 
@@ -1079,9 +1320,14 @@ static struct shrinker binder_shrinker = {
  */
 void binder_alloc_init(struct binder_alloc *alloc)
 {
+	int class;
+
 	alloc->pid = current->group_leader->pid;
 	mutex_init(&alloc->mutex);
 	INIT_LIST_HEAD(&alloc->buffers);
+	for (class = 0; class < BINDER_ALLOC_NR_CLASSES; class++)
+		INIT_LIST_HEAD(&alloc->class_free[class]);
+	alloc->size_classes = binder_alloc_size_classes;
 }
 
 int binder_alloc_shrinker_init(void)
@@ -1163,6 +1409,16 @@ static struct page *binder_alloc_get_page(struct binder_alloc *alloc,
 	return lru_page->page_ptr;
 }
 
+static bool binder_alloc_page_borrowed(struct binder_alloc *alloc,
+				       struct binder_buffer *buffer,
+				       binder_size_t buffer_offset)
+{
+	binder_size_t buffer_space_offset = buffer_offset +
+		(buffer->user_data - alloc->buffer);
+
+	return alloc->pages[buffer_space_offset >> PAGE_SHIFT].borrowed;
+}
+
 /**
  * binder_alloc_clear_buf() - zero out buffer
  * @alloc: binder_alloc for this proc
@@ -1185,9 +1441,12 @@ static void binder_alloc_clear_buf(struct binder_alloc *alloc,
 		page = binder_alloc_get_page(alloc, buffer,
 					     buffer_offset, &pgoff);
 		size = min_t(size_t, bytes, PAGE_SIZE - pgoff);
-		kptr = kmap(page) + pgoff;
-		memset(kptr, 0, size);
-		kunmap(page);
+		/* Never scribble over pages still owned by the sender */
+		if (!binder_alloc_page_borrowed(alloc, buffer, buffer_offset)) {
+			kptr = kmap(page) + pgoff;
+			memset(kptr, 0, size);
+			kunmap(page);
+		}
 		bytes -= size;
 		buffer_offset += size;
 	}
@@ -1237,6 +1496,154 @@ binder_alloc_copy_user_to_buffer(struct binder_alloc *alloc,
 	return 0;
 }
 
+#define BINDER_MAP_BATCH	16
+
+/*
+ * Replace the binder page backing @index with @page. The slot lies fully
+ * inside a buffer that is being built, so nobody else can be using it.
+ */
+static bool binder_alloc_borrow_page(struct binder_alloc *alloc,
+				     struct vm_area_struct *vma,
+				     size_t index, struct page *page)
+{
+	struct binder_lru_page *lru_page = &alloc->pages[index];
+	unsigned long addr = (uintptr_t)alloc->buffer + index * PAGE_SIZE;
+
+	/* vm_insert_page() cannot map anonymous pages */
+	if (PageAnon(page) || PageCompound(page))
+		return false;
+	if (WARN_ON(!lru_page->page_ptr || lru_page->borrowed))
+		return false;
+
+	zap_page_range(vma, addr, PAGE_SIZE);
+	if (vm_insert_page(vma, addr, page)) {
+		WARN_ON_ONCE(vm_insert_page(vma, addr, lru_page->page_ptr));
+		return false;
+	}
+	__free_page(lru_page->page_ptr);
+	lru_page->page_ptr = page;
+	lru_page->borrowed = true;
+	return true;
+}
+
+/*
+ * Map up to BINDER_MAP_BATCH whole pages of @from into @buffer and copy
+ * the ones that cannot be mapped. Pages are pinned before and copied after
+ * the target's mmap_sem is held, so a proc sending to itself never nests
+ * its own mmap_sem.
+ */
+static unsigned long binder_alloc_map_pages(struct binder_alloc *alloc,
+					    struct binder_buffer *buffer,
+					    binder_size_t buffer_offset,
+					    const void __user *from,
+					    int nr_pages)
+{
+	struct page *pages[BINDER_MAP_BATCH];
+	DECLARE_BITMAP(mapped, BINDER_MAP_BATCH);
+	struct vm_area_struct *vma = NULL;
+	struct mm_struct *mm = NULL;
+	size_t index;
+	int pinned, i;
+
+	bitmap_zero(mapped, BINDER_MAP_BATCH);
+	pinned = get_user_pages_fast((uintptr_t)from, nr_pages, 0, pages);
+	if (pinned < 0)
+		pinned = 0;
+
+	index = (buffer->user_data + buffer_offset - alloc->buffer) / PAGE_SIZE;
+	mutex_lock(&alloc->mutex);
+	if (pinned && mmget_not_zero(alloc->vma_vm_mm)) {
+		mm = alloc->vma_vm_mm;
+		down_read(&mm->mmap_sem);
+		vma = binder_alloc_get_vma(alloc);
+	}
+	for (i = 0; i < pinned; i++) {
+		if (vma && binder_alloc_borrow_page(alloc, vma, index + i,
+						    pages[i])) {
+			set_bit(i, mapped);
+			buffer->has_borrowed = 1;
+		} else {
+			put_page(pages[i]);
+		}
+	}
+	if (mm) {
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+	mutex_unlock(&alloc->mutex);
+
+	for (i = 0; i < nr_pages; i++) {
+		unsigned long ret;
+
+		if (test_bit(i, mapped))
+			continue;
+		ret = binder_alloc_copy_user_to_buffer(alloc, buffer,
+				buffer_offset + i * PAGE_SIZE,
+				from + i * PAGE_SIZE, PAGE_SIZE);
+		if (ret)
+			return (nr_pages - i) * PAGE_SIZE - PAGE_SIZE + ret;
+	}
+	return 0;
+}
+
+/**
+ * binder_alloc_map_user_to_buffer() - map src user pages into tgt buffer
+ * @alloc: binder_alloc for this proc
+ * @buffer: binder buffer to be accessed
+ * @buffer_offset: offset into @buffer data
+ * @from: userspace pointer to source buffer
+ * @bytes: bytes to transfer
+ *
+ * Like binder_alloc_copy_user_to_buffer(), but whole pages of @from that
+ * line up with pages of @buffer and belong to a shared file mapping are
+ * mapped into the target rather than copied. Everything else is copied.
+ *
+ * Return: bytes remaining to be transferred
+ */
+unsigned long
+binder_alloc_map_user_to_buffer(struct binder_alloc *alloc,
+				struct binder_buffer *buffer,
+				binder_size_t buffer_offset,
+				const void __user *from,
+				size_t bytes)
+{
+	void __user *to = buffer->user_data + buffer_offset;
+	unsigned long ret;
+	size_t size;
+
+	if (!check_buffer(alloc, buffer, buffer_offset, bytes))
+		return bytes;
+	if (((uintptr_t)to ^ (uintptr_t)from) & ~PAGE_MASK)
+		return binder_alloc_copy_user_to_buffer(alloc, buffer,
+							buffer_offset,
+							from, bytes);
+
+	size = min_t(size_t, bytes,
+		     PAGE_ALIGN((uintptr_t)from) - (uintptr_t)from);
+	while (bytes) {
+		if (size)
+			ret = binder_alloc_copy_user_to_buffer(alloc, buffer,
+							       buffer_offset,
+							       from, size);
+		else {
+			int nr_pages = min_t(size_t, bytes >> PAGE_SHIFT,
+					     BINDER_MAP_BATCH);
+
+			size = (size_t)nr_pages << PAGE_SHIFT;
+			ret = binder_alloc_map_pages(alloc, buffer,
+						     buffer_offset, from,
+						     nr_pages);
+		}
+		if (ret)
+			return bytes - size + ret;
+		bytes -= size;
+		from += size;
+		buffer_offset += size;
+		size = bytes < PAGE_SIZE ? bytes : 0;
+	}
+	return 0;
+}
+
 static void binder_alloc_do_buffer_copy(struct binder_alloc *alloc,
 					bool to_buffer,
 					struct binder_buffer *buffer,
@@ -1257,6 +1664,10 @@ static void binder_alloc_do_buffer_copy(struct binder_alloc *alloc,
 		page = binder_alloc_get_page(alloc, buffer,
 					     buffer_offset, &pgoff);
 		size = min_t(size_t, bytes, PAGE_SIZE - pgoff);
+		/* binder.c refuses fixups into zero-copy buffers */
+		WARN_ON_ONCE(to_buffer &&
+			     binder_alloc_page_borrowed(alloc, buffer,
+							buffer_offset));
 		base_ptr = kmap_atomic(page);
 		tmpptr = base_ptr + pgoff;
 		if (to_buffer)
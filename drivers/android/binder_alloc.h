@@ -27,6 +27,13 @@
 extern struct list_lru binder_alloc_lru;
 struct binder_transaction;
 
+/*
+ * Small buffers (up to a page) are rounded up to a power of two size class
+ * starting at 1 << BINDER_ALLOC_CLASS_MIN_SHIFT bytes.
+ */
+#define BINDER_ALLOC_CLASS_MIN_SHIFT	7
+#define BINDER_ALLOC_NR_CLASSES	(PAGE_SHIFT - BINDER_ALLOC_CLASS_MIN_SHIFT + 1)
+
 /**
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
@@ -38,6 +45,9 @@ struct binder_transaction;
  * @oneway_spam_suspect: %true if total async allocate size just exceed
  * spamming detect threshold
  * @debug_id:           unique ID for debugging
+ * @cached:             %true if buffer is parked on a size-class free list
+ * @has_borrowed:       %true if some of its pages were mapped from the sender
+ * @class_entry:        entry in binder_alloc->class_free while @cached
  * @transaction:        pointer to associated struct binder_transaction
  * @target_node:        struct binder_node associated with this buffer
  * @data_size:          size of @transaction data
@@ -58,6 +68,9 @@ struct binder_buffer {
 	unsigned async_transaction:1;
 	unsigned oneway_spam_suspect:1;
 	unsigned debug_id:27;
+	unsigned cached:1;
+	unsigned has_borrowed:1;
+	struct list_head class_entry;
 
 	struct binder_transaction *transaction;
 
@@ -74,11 +87,14 @@ struct binder_buffer {
  * @page_ptr: pointer to physical page in mmap'd space
  * @lru:      entry in binder_alloc_lru
  * @alloc:    binder_alloc for a proc
+ * @borrowed: %true if @page_ptr is a sender page mapped in by
+ *            binder_alloc_map_user_to_buffer() rather than a binder page
  */
 struct binder_lru_page {
 	struct list_head lru;
 	struct page *page_ptr;
 	struct binder_alloc *alloc;
+	bool borrowed;
 };
 
 /**
@@ -101,6 +117,16 @@ struct binder_lru_page {
  * @pages_high:         high watermark of offset in @pages
  * @oneway_spam_detected: %true if oneway spam detection fired, clear that
  * flag once the async buffer has returned to a healthy state
+ * @size_classes:       %true if small buffers are served from @class_free
+ * @class_free:         per size class lists of freed buffers whose pages are
+ *                      kept mapped for reuse
+ * @class_count:        number of buffers on each @class_free list
+ * @class_hits:         small allocations served from @class_free
+ * @class_misses:       small allocations that fell back to @free_buffers
+ * @page_maps:          pages allocated and mapped into userspace
+ * @page_lru_hits:      pages taken back off the lru while still mapped
+ * @page_lru_puts:      pages put on the lru when their buffers were freed
+ * @page_unmaps:        lru pages unmapped and freed by the shrinker
  *
  * Bookkeeping structure for per-proc address space management for binder
  * buffers. It is normally initialized during binder_init() and binder_mmap()
@@ -122,6 +148,15 @@ struct binder_alloc {
 	int pid;
 	size_t pages_high;
 	bool oneway_spam_detected;
+	bool size_classes;
+	struct list_head class_free[BINDER_ALLOC_NR_CLASSES];
+	unsigned int class_count[BINDER_ALLOC_NR_CLASSES];
+	u64 class_hits;
+	u64 class_misses;
+	u64 page_maps;
+	u64 page_lru_hits;
+	u64 page_lru_puts;
+	u64 page_unmaps;
 };
 
 #ifdef CONFIG_ANDROID_BINDER_IPC_SELFTEST
@@ -129,6 +164,11 @@ void binder_selftest_alloc(struct binder_alloc *alloc);
 #else
 static inline void binder_selftest_alloc(struct binder_alloc *alloc) {}
 #endif
+#ifdef CONFIG_ANDROID_BINDER_ALLOC_BENCH
+void binder_alloc_bench(struct binder_alloc *alloc);
+#else
+static inline void binder_alloc_bench(struct binder_alloc *alloc) {}
+#endif
 enum lru_status binder_alloc_free_page(struct list_head *item,
 				       struct list_lru_one *lru,
 				       spinlock_t *lock, void *cb_arg);
@@ -142,6 +182,7 @@ extern void binder_alloc_init(struct binder_alloc *alloc);
 extern int binder_alloc_shrinker_init(void);
 extern void binder_alloc_shrinker_exit(void);
 extern void binder_alloc_vma_close(struct binder_alloc *alloc);
+extern void binder_alloc_disable_size_classes(struct binder_alloc *alloc);
 extern struct binder_buffer *
 binder_alloc_prepare_to_free(struct binder_alloc *alloc,
 			     uintptr_t user_ptr);
@@ -180,6 +221,13 @@ binder_alloc_copy_user_to_buffer(struct binder_alloc *alloc,
 				 const void __user *from,
 				 size_t bytes);
 
+unsigned long
+binder_alloc_map_user_to_buffer(struct binder_alloc *alloc,
+				struct binder_buffer *buffer,
+				binder_size_t buffer_offset,
+				const void __user *from,
+				size_t bytes);
+
 void binder_alloc_copy_to_buffer(struct binder_alloc *alloc,
 				 struct binder_buffer *buffer,
 				 binder_size_t buffer_offset,
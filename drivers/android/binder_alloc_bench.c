@@ -0,0 +1,296 @@
+/* binder_alloc_bench.c
+ *
+ * Android IPC Subsystem
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/completion.h>
+#include <linux/err.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include "binder_alloc.h"
+
+/*
+ * Each bucket covers 1/BENCH_SUB of a power of two of nanoseconds, which
+ * bounds the error of the reported percentiles to 12.5%.
+ */
+#define BENCH_SUB_SHIFT	3
+#define BENCH_SUB	(1 << BENCH_SUB_SHIFT)
+#define BENCH_BUCKETS	(64 * BENCH_SUB)
+#define BENCH_MAX_LIVE	1024
+#define BENCH_MAX_THREADS	16
+
+enum bench_dist {
+	BENCH_DIST_FIXED,	/* always size_min */
+	BENCH_DIST_UNIFORM,	/* uniform in [size_min, size_max] */
+	BENCH_DIST_LOG,		/* log uniform, mostly small like real IPC */
+};
+
+enum bench_free_order {
+	BENCH_FREE_FIFO,	/* oldest first */
+	BENCH_FREE_LIFO,	/* newest first */
+	BENCH_FREE_RANDOM,	/* fragments the address space */
+};
+
+/*
+ * Setting run makes the next binder ioctl of a process that has mapped
+ * its binder buffer run the benchmark on that buffer.
+ */
+static bool run;
+module_param(run, bool, 0644);
+static unsigned int dist = BENCH_DIST_LOG;
+module_param(dist, uint, 0644);
+static unsigned int size_min = 128;
+module_param(size_min, uint, 0644);
+static unsigned int size_max = 16384;
+module_param(size_max, uint, 0644);
+static unsigned int threads = 1;
+module_param(threads, uint, 0644);
+static unsigned int ops = 100000;
+module_param(ops, uint, 0644);
+/* buffers each thread keeps allocated at most */
+static unsigned int live = 16;
+module_param(live, uint, 0644);
+static unsigned int free_order = BENCH_FREE_RANDOM;
+module_param(free_order, uint, 0644);
+static bool async;
+module_param(async, bool, 0644);
+
+static DEFINE_MUTEX(binder_bench_lock);
+
+struct bench_thread {
+	struct binder_alloc *alloc;
+	struct completion done;
+	struct rnd_state rnd;
+	struct binder_buffer *bufs[BENCH_MAX_LIVE];
+	unsigned int nr_live;
+	unsigned int failures;
+	u32 alloc_hist[BENCH_BUCKETS];
+	u32 free_hist[BENCH_BUCKETS];
+};
+
+static unsigned int bench_bucket(u64 ns)
+{
+	unsigned int shift;
+
+	if (ns < BENCH_SUB)
+		return ns;
+
+	shift = fls64(ns) - 1 - BENCH_SUB_SHIFT;
+	return min_t(unsigned int, (shift + 1) * BENCH_SUB +
+		     ((ns >> shift) & (BENCH_SUB - 1)), BENCH_BUCKETS - 1);
+}
+
+/* Lower bound of the values counted in bucket @b */
+static u64 bench_bucket_ns(unsigned int b)
+{
+	unsigned int shift;
+
+	if (b < BENCH_SUB)
+		return b;
+
+	shift = b / BENCH_SUB - 1;
+	return (u64)(BENCH_SUB + b % BENCH_SUB) << shift;
+}
+
+static size_t bench_size(struct rnd_state *rnd)
+{
+	unsigned int lo = max(size_min, 8U), hi = max(size_max, lo);
+	unsigned int r = prandom_u32_state(rnd);
+
+	switch (dist) {
+	case BENCH_DIST_FIXED:
+		return lo;
+	case BENCH_DIST_UNIFORM:
+		return lo + r % (hi - lo + 1);
+	default:
+		/* pick a power of two octave, then a size inside it */
+		lo = min(lo << (r % (ilog2(hi / lo) + 1)), hi);
+		r = prandom_u32_state(rnd);
+		return lo + r % (min(lo * 2, hi) - lo + 1);
+	}
+}
+
+static void bench_free_one(struct bench_thread *t)
+{
+	struct binder_buffer *buf;
+	unsigned int i;
+	u64 start;
+
+	switch (free_order) {
+	case BENCH_FREE_FIFO:
+		i = 0;
+		break;
+	case BENCH_FREE_LIFO:
+		i = t->nr_live - 1;
+		break;
+	default:
+		i = prandom_u32_state(&t->rnd) % t->nr_live;
+		break;
+	}
+
+	buf = t->bufs[i];
+	memmove(&t->bufs[i], &t->bufs[i + 1],
+		(t->nr_live - i - 1) * sizeof(*t->bufs));
+	t->nr_live--;
+
+	start = ktime_get_ns();
+	binder_alloc_free_buf(t->alloc, buf);
+	t->free_hist[bench_bucket(ktime_get_ns() - start)]++;
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	struct binder_buffer *buf;
+	unsigned int i, max_live = clamp(live, 1U, (unsigned int)BENCH_MAX_LIVE);
+	size_t size;
+	u64 start;
+
+	for (i = 0; i < ops; i++) {
+		/* keep between one and max_live buffers allocated */
+		if (t->nr_live == max_live ||
+		    (t->nr_live && prandom_u32_state(&t->rnd) & 1)) {
+			bench_free_one(t);
+			continue;
+		}
+
+		size = bench_size(&t->rnd);
+		start = ktime_get_ns();
+		buf = binder_alloc_new_buf(t->alloc, size, 0, 0, async, 0);
+		t->alloc_hist[bench_bucket(ktime_get_ns() - start)]++;
+		if (IS_ERR(buf)) {
+			t->failures++;
+			continue;
+		}
+		t->bufs[t->nr_live++] = buf;
+
+		if (!(i % 256))
+			cond_resched();
+	}
+
+	while (t->nr_live)
+		bench_free_one(t);
+
+	complete(&t->done);
+	return 0;
+}
+
+static void bench_report(const char *name, u32 *hist)
+{
+	static const unsigned int pct[] = { 500, 900, 990, 999 };
+	u64 total = 0, seen = 0, val[ARRAY_SIZE(pct)] = { 0 }, max = 0;
+	unsigned int b, p = 0;
+
+	for (b = 0; b < BENCH_BUCKETS; b++)
+		total += hist[b];
+	if (!total)
+		return;
+
+	for (b = 0; b < BENCH_BUCKETS; b++) {
+		if (!hist[b])
+			continue;
+		seen += hist[b];
+		while (p < ARRAY_SIZE(pct) && seen * 1000 >= total * pct[p])
+			val[p++] = bench_bucket_ns(b);
+		max = bench_bucket_ns(b);
+	}
+
+	pr_info("%s: n=%llu p50=%lluns p90=%lluns p99=%lluns p99.9=%lluns max>=%lluns\n",
+		name, total, val[0], val[1], val[2], val[3], max);
+}
+
+/**
+ * binder_alloc_bench() - Benchmark allocation and free of buffers.
+ * @alloc: Pointer to alloc struct.
+ *
+ * When requested through the run parameter, start threads that each
+ * do ops allocations and frees of buffers with sizes from dist, keeping
+ * up to live buffers and freeing them in free_order. Report the latency
+ * percentiles of both operations and the page map, lru and unmap counts
+ * of the run.
+ */
+void binder_alloc_bench(struct binder_alloc *alloc)
+{
+	struct bench_thread *t;
+	struct task_struct *tsk;
+	u64 maps, lru_hits, lru_puts, unmaps, hits, misses;
+	unsigned int i, nr, failures = 0;
+
+	if (!READ_ONCE(run))
+		return;
+	mutex_lock(&binder_bench_lock);
+	if (!run || !alloc->vma)
+		goto done;
+	run = false;
+
+	nr = clamp(threads, 1U, (unsigned int)BENCH_MAX_THREADS);
+	t = vzalloc(nr * sizeof(*t));
+	if (!t)
+		goto done;
+
+	mutex_lock(&alloc->mutex);
+	maps = alloc->page_maps;
+	lru_hits = alloc->page_lru_hits;
+	lru_puts = alloc->page_lru_puts;
+	unmaps = alloc->page_unmaps;
+	hits = alloc->class_hits;
+	misses = alloc->class_misses;
+	mutex_unlock(&alloc->mutex);
+
+	pr_info("STARTED threads=%u ops=%u dist=%u size=%u-%u live=%u free_order=%u%s\n",
+		nr, ops, dist, size_min, size_max, live, free_order,
+		async ? " async" : "");
+
+	for (i = 0; i < nr; i++) {
+		t[i].alloc = alloc;
+		init_completion(&t[i].done);
+		prandom_seed_state(&t[i].rnd, 0x62696e64 + i);
+		tsk = kthread_run(bench_thread_fn, &t[i], "binder_bench/%u", i);
+		if (IS_ERR(tsk))
+			complete(&t[i].done);
+	}
+
+	for (i = 0; i < nr; i++) {
+		wait_for_completion(&t[i].done);
+		failures += t[i].failures;
+		if (i) {
+			unsigned int b;
+
+			for (b = 0; b < BENCH_BUCKETS; b++) {
+				t[0].alloc_hist[b] += t[i].alloc_hist[b];
+				t[0].free_hist[b] += t[i].free_hist[b];
+			}
+		}
+	}
+
+	bench_report("alloc", t[0].alloc_hist);
+	bench_report("free", t[0].free_hist);
+
+	mutex_lock(&alloc->mutex);
+	pr_info("pages: mapped=%llu lru_hits=%llu lru_puts=%llu unmapped=%llu class hits=%llu misses=%llu failures=%u\n",
+		alloc->page_maps - maps, alloc->page_lru_hits - lru_hits,
+		alloc->page_lru_puts - lru_puts, alloc->page_unmaps - unmaps,
+		alloc->class_hits - hits, alloc->class_misses - misses,
+		failures);
+	mutex_unlock(&alloc->mutex);
+
+	vfree(t);
+done:
+	mutex_unlock(&binder_bench_lock);
+}
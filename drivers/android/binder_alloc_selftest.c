@@ -299,6 +299,8 @@ void binder_selftest_alloc(struct binder_alloc *alloc)
 	if (!binder_selftest_run || !alloc->vma)
 		goto done;
 	pr_info("STARTED\n");
+	/* Size class rounding would defeat the page alignment cases below */
+	binder_alloc_disable_size_classes(alloc);
 	binder_selftest_alloc_offset(alloc, end_offset, 0);
 	binder_selftest_run = false;
 	if (binder_selftest_failures > 0)
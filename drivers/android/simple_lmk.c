@@ -11,11 +11,14 @@
 #include <linux/mmu_notifier.h>
 #include <linux/moduleparam.h>
 #include <linux/oom.h>
+#include <linux/psi.h>
 #include <linux/ratelimit.h>
 #include <linux/sched/mm.h>
 #include <linux/sort.h>
+#include <linux/topology.h>
 #include <linux/vmpressure.h>
 #include <uapi/linux/sched/types.h>
+#include <trace/events/oom.h>
 
 /* The minimum number of pages to free per reclaim */
 #define MIN_FREE_PAGES (CONFIG_ANDROID_SIMPLE_LMK_MINFREE * SZ_1M / PAGE_SIZE)
@@ -26,14 +29,24 @@
 /* Timeout in jiffies for each reclaim */
 #define RECLAIM_EXPIRES msecs_to_jiffies(CONFIG_ANDROID_SIMPLE_LMK_TIMEOUT_MSEC)
 
+/* Number of threads reaping victims in parallel */
+#define NR_REAPERS CONFIG_ANDROID_SIMPLE_LMK_REAPERS
+
 struct victim_info {
 	struct task_struct *tsk;
 	struct mm_struct *mm;
 	unsigned long size;
+	pid_t pid;
+	/* Set once a reaper thread has taken this victim */
+	bool claimed;
 };
 
+/* simple_lmk_adj value for tasks that aren't tracked in a bucket */
+#define ADJ_UNTRACKED (OOM_SCORE_ADJ_MIN - 1)
+
 static struct victim_info victims[MAX_VICTIMS] __cacheline_aligned_in_smp;
-static struct task_struct *task_bucket[SHRT_MAX + 1] __cacheline_aligned;
+static struct hlist_head adj_buckets[OOM_SCORE_ADJ_MAX + 1] __cacheline_aligned;
+static __cacheline_aligned_in_smp DEFINE_SPINLOCK(bucket_lock);
 static DECLARE_WAIT_QUEUE_HEAD(oom_waitq);
 static DECLARE_WAIT_QUEUE_HEAD(reaper_waitq);
 static DECLARE_COMPLETION(reclaim_done);
@@ -41,7 +54,7 @@ static __cacheline_aligned_in_smp DEFINE_RWLOCK(mm_free_lock);
 static int nr_victims;
 static bool reclaim_active;
 static atomic_t needs_reclaim = ATOMIC_INIT(0);
-static atomic_t needs_reap = ATOMIC_INIT(0);
+static atomic_t reap_seq = ATOMIC_INIT(0);
 static atomic_t nr_killed = ATOMIC_INIT(0);
 
 static int victim_cmp(const void *lhs_ptr, const void *rhs_ptr)
@@ -73,57 +86,36 @@ static unsigned long get_total_mm_pages(struct mm_struct *mm)
 
 static unsigned long find_victims(int *vindex)
 {
-	short i, min_adj = SHRT_MAX, max_adj = 0;
 	unsigned long pages_found = 0;
 	struct task_struct *tsk;
+	short i;
 
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct signal_struct *sig;
-		short adj;
-
-		/*
-		 * Search for suitable tasks with a positive adj (importance).
-		 * Since only tasks with a positive adj can be targeted, that
-		 * naturally excludes tasks which shouldn't be killed, like init
-		 * and kthreads. Although oom_score_adj can still be changed
-		 * while this code runs, it doesn't really matter; we just need
-		 * a snapshot of the task's adj.
-		 */
-		sig = tsk->signal;
-		adj = READ_ONCE(sig->oom_score_adj);
-		if (adj < 0 ||
-		    sig->flags & (SIGNAL_GROUP_EXIT | SIGNAL_GROUP_COREDUMP) ||
-		    (thread_group_empty(tsk) && tsk->flags & PF_EXITING))
-			continue;
-
-		/* Store the task in a linked-list bucket based on its adj */
-		tsk->simple_lmk_next = task_bucket[adj];
-		task_bucket[adj] = tsk;
-
-		/* Track the min and max adjs to speed up the loop below */
-		if (adj > max_adj)
-			max_adj = adj;
-		if (adj < min_adj)
-			min_adj = adj;
-	}
-
-	/* Start searching for victims from the highest adj (least important) */
-	for (i = max_adj; i >= min_adj; i--) {
+	/*
+	 * Thread group leaders are kept in buckets by adj (importance), so
+	 * only the buckets needed to satisfy the reclaim target are visited.
+	 * Only tasks with a positive adj are bucketed, which naturally excludes
+	 * tasks which shouldn't be killed, like init and kthreads. Start
+	 * searching for victims from the highest adj (least important).
+	 */
+	spin_lock(&bucket_lock);
+	for (i = OOM_SCORE_ADJ_MAX; i >= 0; i--) {
 		int old_vindex;
 
-		tsk = task_bucket[i];
-		if (!tsk)
+		if (hlist_empty(&adj_buckets[i]))
 			continue;
 
-		/* Clear out this bucket for the next time reclaim is done */
-		task_bucket[i] = NULL;
-
 		/* Iterate through every task with this adj */
 		old_vindex = *vindex;
-		do {
+		hlist_for_each_entry(tsk, &adj_buckets[i], simple_lmk_node) {
+			struct signal_struct *sig = tsk->signal;
 			struct task_struct *vtsk;
 
+			if (sig->flags & (SIGNAL_GROUP_EXIT |
+					  SIGNAL_GROUP_COREDUMP) ||
+			    (thread_group_empty(tsk) &&
+			     tsk->flags & PF_EXITING))
+				continue;
+
 			vtsk = find_lock_task_mm(tsk);
 			if (!vtsk)
 				continue;
@@ -139,7 +131,7 @@ static unsigned long find_victims(int *vindex)
 			/* Make sure there's space left in the victim array */
 			if (++*vindex == MAX_VICTIMS)
 				break;
-		} while ((tsk = tsk->simple_lmk_next));
+		}
 
 		/* Go to the next bucket if nothing was found */
 		if (*vindex == old_vindex)
@@ -153,15 +145,10 @@ static unsigned long find_victims(int *vindex)
 		     sizeof(*victims), victim_cmp, victim_swap);
 
 		/* Stop when we are out of space or have enough pages found */
-		if (*vindex == MAX_VICTIMS || pages_found >= MIN_FREE_PAGES) {
-			/* Zero out any remaining buckets we didn't touch */
-			if (i > min_adj)
-				memset(&task_bucket[min_adj], 0,
-				       (i - min_adj) * sizeof(*task_bucket));
+		if (*vindex == MAX_VICTIMS || pages_found >= MIN_FREE_PAGES)
 			break;
-		}
 	}
-	rcu_read_unlock();
+	spin_unlock(&bucket_lock);
 
 	return pages_found;
 }
@@ -206,7 +193,7 @@ static void scan_and_kill(void)
 	unsigned long pages_found;
 
 	/*
-	 * Reset nr_victims so the reaper thread and simple_lmk_mm_freed() are
+	 * Reset nr_victims so the reaper threads and simple_lmk_mm_freed() are
 	 * aware that the victims array is no longer valid.
 	 */
 	write_lock(&mm_free_lock);
@@ -291,6 +278,8 @@ static void scan_and_kill(void)
 
 		/* Store the number of anon pages to sort victims for reaping */
 		victim->size = get_mm_counter(mm, MM_ANONPAGES);
+		victim->pid = task_tgid_nr(vtsk);
+		victim->claimed = false;
 
 		/* Finally release the victim's task lock acquired earlier */
 		task_unlock(vtsk);
@@ -299,21 +288,21 @@ static void scan_and_kill(void)
 	/*
 	 * Sort the victims by descending order of anonymous pages so the reaper
 	 * thread can prioritize reaping the victims with the most anonymous
-	 * pages first. Then wake the reaper thread if it's asleep. The lock
-	 * orders the needs_reap store before waitqueue_active().
+	 * pages first. Then wake all reaper threads that are asleep. The lock
+	 * orders the reap_seq store before waitqueue_active().
 	 */
 	write_lock(&mm_free_lock);
 	sort(victims, nr_to_kill, sizeof(*victims), victim_cmp, victim_swap);
-	atomic_set(&needs_reap, 1);
+	atomic_inc(&reap_seq);
 	write_unlock(&mm_free_lock);
 	if (waitqueue_active(&reaper_waitq))
-		wake_up(&reaper_waitq);
+		wake_up_all(&reaper_waitq);
 
 	/* Wait until all the victims die or until the timeout is reached */
 	if (!wait_for_completion_timeout(&reclaim_done, RECLAIM_EXPIRES))
 		pr_info("Timeout hit waiting for victims to die, proceeding\n");
 
-	/* Clean up for future reclaims but let the reaper thread keep going */
+	/* Clean up for future reclaims but let the reaper threads keep going */
 	write_lock(&mm_free_lock);
 	reinit_completion(&reclaim_done);
 	reclaim_active = false;
@@ -336,7 +325,7 @@ static int simple_lmk_reclaim_thread(void *data)
 	return 0;
 }
 
-static struct mm_struct *next_reap_victim(void)
+static struct mm_struct *next_reap_victim(pid_t *pid)
 {
 	struct mm_struct *mm = NULL;
 	bool should_retry = false;
@@ -345,9 +334,13 @@ static struct mm_struct *next_reap_victim(void)
 	/* Take a write lock so no victim's mm can be freed while scanning */
 	write_lock(&mm_free_lock);
 	for (i = 0; i < nr_victims; i++, mm = NULL) {
-		/* Check if this victim is alive and hasn't been reaped yet */
+		/*
+		 * Check if this victim is alive, hasn't been reaped yet and
+		 * isn't being reaped by another reaper thread.
+		 */
 		mm = victims[i].mm;
-		if (!mm || test_bit(MMF_OOM_SKIP, &mm->flags))
+		if (!mm || victims[i].claimed ||
+		    test_bit(MMF_OOM_SKIP, &mm->flags))
 			continue;
 
 		/* Do a trylock so the reaper thread doesn't sleep */
@@ -372,8 +365,11 @@ static struct mm_struct *next_reap_victim(void)
 		 * victim mm can enter exit_mmap(). Therefore, an mmap read lock
 		 * is sufficient to keep the mm struct itself from being freed.
 		 */
-		if (!test_bit(MMF_OOM_SKIP, &mm->flags))
+		if (!test_bit(MMF_OOM_SKIP, &mm->flags)) {
+			victims[i].claimed = true;
+			*pid = victims[i].pid;
 			break;
+		}
 		up_read(&mm->mmap_sem);
 	}
 
@@ -397,8 +393,11 @@ static struct mm_struct *next_reap_victim(void)
 static void reap_victims(void)
 {
 	struct mm_struct *mm;
+	unsigned long pages;
+	ktime_t start;
+	pid_t pid;
 
-	while ((mm = next_reap_victim())) {
+	while ((mm = next_reap_victim(&pid))) {
 		if (IS_ERR(mm)) {
 			/* Wait one jiffy before trying to reap again */
 			schedule_timeout_uninterruptible(1);
@@ -409,28 +408,141 @@ static void reap_victims(void)
 		 * Reap the victim, then unflag the mm for exit_mmap() reaping
 		 * and mark it as reaped with MMF_OOM_SKIP.
 		 */
+		start = ktime_get();
+		pages = get_total_mm_pages(mm);
 		__oom_reap_task_mm(mm);
+		pages -= min(pages, get_total_mm_pages(mm));
 		clear_bit(MMF_OOM_VICTIM, &mm->flags);
 		set_bit(MMF_OOM_SKIP, &mm->flags);
 		up_read(&mm->mmap_sem);
+		trace_simple_lmk_reap(pid, pages,
+				      ktime_us_delta(ktime_get(), start));
 	}
 }
 
 static int simple_lmk_reaper_thread(void *data)
 {
+	int seq = atomic_read(&reap_seq);
+
 	/* Use a lower priority than the reclaim thread */
 	set_task_rt_prio(current, MAX_RT_PRIO - 2);
 	set_freezable();
 
 	while (1) {
 		wait_event_freezable(reaper_waitq,
-				     atomic_cmpxchg_relaxed(&needs_reap, 1, 0));
+				     atomic_read(&reap_seq) != seq);
+		seq = atomic_read(&reap_seq);
 		reap_victims();
 	}
 
 	return 0;
 }
 
+/*
+ * Keep the reapers off the highest capacity CPUs, which are left to the
+ * foreground workload that is waiting for the memory to be freed.
+ */
+static void simple_lmk_reaper_cpus(struct cpumask *mask)
+{
+	cpumask_copy(mask, cpu_possible_mask);
+#ifdef arch_scale_cpu_capacity
+	{
+		unsigned long cap, max_cap = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu)
+			max_cap = max(max_cap, arch_scale_cpu_capacity(NULL, cpu));
+
+		for_each_possible_cpu(cpu) {
+			cap = arch_scale_cpu_capacity(NULL, cpu);
+			if (cap == max_cap)
+				cpumask_clear_cpu(cpu, mask);
+		}
+
+		if (cpumask_empty(mask))
+			cpumask_copy(mask, cpu_possible_mask);
+	}
+#endif
+}
+
+static void simple_lmk_start_reapers(void)
+{
+	struct task_struct *thread;
+	cpumask_t mask;
+	int i;
+
+	simple_lmk_reaper_cpus(&mask);
+	for (i = 0; i < NR_REAPERS; i++) {
+		thread = kthread_create(simple_lmk_reaper_thread, NULL,
+					"simple_lmkd_reaper/%d", i);
+		BUG_ON(IS_ERR(thread));
+		set_cpus_allowed_ptr(thread, &mask);
+		wake_up_process(thread);
+	}
+}
+
+/* Must be called with bucket_lock held */
+static void bucket_insert(struct task_struct *tsk)
+{
+	short adj = READ_ONCE(tsk->signal->oom_score_adj);
+
+	tsk->simple_lmk_adj = adj;
+	if (adj >= 0)
+		hlist_add_head(&tsk->simple_lmk_node, &adj_buckets[adj]);
+}
+
+/* Called at the end of fork for every new task */
+void simple_lmk_task_add(struct task_struct *tsk)
+{
+	INIT_HLIST_NODE(&tsk->simple_lmk_node);
+	tsk->simple_lmk_adj = ADJ_UNTRACKED;
+
+	if (!thread_group_leader(tsk) || tsk->flags & PF_KTHREAD)
+		return;
+
+	spin_lock(&bucket_lock);
+	bucket_insert(tsk);
+	spin_unlock(&bucket_lock);
+}
+
+void simple_lmk_task_release(struct task_struct *tsk)
+{
+	/* Only group leaders are tracked; skip the lock for everyone else */
+	if (tsk->simple_lmk_adj == ADJ_UNTRACKED)
+		return;
+
+	spin_lock(&bucket_lock);
+	hlist_del_init(&tsk->simple_lmk_node);
+	tsk->simple_lmk_adj = ADJ_UNTRACKED;
+	spin_unlock(&bucket_lock);
+}
+
+/* A non-leader thread took over the thread group in exec */
+void simple_lmk_task_replace(struct task_struct *old, struct task_struct *new)
+{
+	if (old->simple_lmk_adj == ADJ_UNTRACKED)
+		return;
+
+	spin_lock(&bucket_lock);
+	hlist_del_init(&old->simple_lmk_node);
+	old->simple_lmk_adj = ADJ_UNTRACKED;
+	bucket_insert(new);
+	spin_unlock(&bucket_lock);
+}
+
+void simple_lmk_adj_changed(struct task_struct *tsk)
+{
+	struct task_struct *leader = tsk->group_leader;
+
+	spin_lock(&bucket_lock);
+	if (leader->simple_lmk_adj != ADJ_UNTRACKED &&
+	    leader->simple_lmk_adj != READ_ONCE(leader->signal->oom_score_adj)) {
+		hlist_del_init(&leader->simple_lmk_node);
+		bucket_insert(leader);
+	}
+	spin_unlock(&bucket_lock);
+}
+
 void simple_lmk_mm_freed(struct mm_struct *mm)
 {
 	int i;
@@ -449,7 +561,7 @@ void simple_lmk_mm_freed(struct mm_struct *mm)
 			 * Clear out this victim from the victims array and only
 			 * increment nr_killed if reclaim is active. If reclaim
 			 * isn't active, then clearing out the victim is done
-			 * solely for the reaper thread to avoid freed victims.
+			 * solely for the reaper threads to avoid freed victims.
 			 */
 			victims[i].mm = NULL;
 			if (reclaim_active &&
@@ -461,15 +573,156 @@ void simple_lmk_mm_freed(struct mm_struct *mm)
 	read_unlock(&mm_free_lock);
 }
 
+static void simple_lmk_trigger_reclaim(void)
+{
+	atomic_set(&needs_reclaim, 1);
+	smp_mb__after_atomic();
+	if (waitqueue_active(&oom_waitq))
+		wake_up(&oom_waitq);
+}
+
+#ifdef CONFIG_PSI
+/*
+ * Memory stall triggers. A trigger fires when tasks spent more than the
+ * threshold stalled on memory within the window; "full" means all non-idle
+ * tasks were stalled at once, "some" means at least one was. A threshold
+ * of 0 disables the trigger. While any PSI trigger is armed, vmpressure is
+ * ignored and only serves as a fallback.
+ */
+static unsigned int psi_window_ms = 1000;
+static unsigned int psi_full_threshold_ms = 70;
+static unsigned int psi_some_threshold_ms;
+
+enum { LMK_PSI_FULL, LMK_PSI_SOME, LMK_PSI_NR };
+
+static DEFINE_MUTEX(psi_lock);
+static struct psi_trigger *psi_triggers[LMK_PSI_NR];
+static struct wait_queue_entry psi_waits[LMK_PSI_NR];
+static bool psi_armed;
+static bool psi_ready;
+
+/* Runs from the PSI poll worker when a trigger fires or is destroyed */
+static int simple_lmk_psi_wake(struct wait_queue_entry *wait, unsigned int mode,
+			       int sync, void *key)
+{
+	struct psi_trigger *t = wait->private;
+
+	if (xchg(&t->event, 0))
+		simple_lmk_trigger_reclaim();
+
+	return 0;
+}
+
+static void simple_lmk_psi_disarm(void)
+{
+	int i;
+
+	WRITE_ONCE(psi_armed, false);
+	for (i = 0; i < LMK_PSI_NR; i++) {
+		if (!psi_triggers[i])
+			continue;
+
+		remove_wait_queue(&psi_triggers[i]->event_wait, &psi_waits[i]);
+		psi_kernel_trigger_destroy(psi_triggers[i]);
+		psi_triggers[i] = NULL;
+	}
+}
+
+static void simple_lmk_psi_arm(void)
+{
+	static const enum psi_states states[LMK_PSI_NR] = {
+		[LMK_PSI_FULL] = PSI_MEM_FULL,
+		[LMK_PSI_SOME] = PSI_MEM_SOME,
+	};
+	unsigned int thresholds[LMK_PSI_NR] = {
+		[LMK_PSI_FULL] = psi_full_threshold_ms,
+		[LMK_PSI_SOME] = psi_some_threshold_ms,
+	};
+	struct psi_trigger *t;
+	bool armed = false;
+	int i;
+
+	lockdep_assert_held(&psi_lock);
+
+	simple_lmk_psi_disarm();
+
+	for (i = 0; i < LMK_PSI_NR; i++) {
+		if (!thresholds[i])
+			continue;
+
+		t = psi_kernel_trigger_create(states[i],
+					      thresholds[i] * USEC_PER_MSEC,
+					      psi_window_ms * USEC_PER_MSEC);
+		if (IS_ERR(t)) {
+			pr_err("Failed to create PSI trigger, err=%ld\n",
+			       PTR_ERR(t));
+			continue;
+		}
+
+		init_waitqueue_func_entry(&psi_waits[i], simple_lmk_psi_wake);
+		psi_waits[i].private = t;
+		add_wait_queue(&t->event_wait, &psi_waits[i]);
+		psi_triggers[i] = t;
+		armed = true;
+	}
+
+	WRITE_ONCE(psi_armed, armed);
+	if (!armed)
+		pr_info("No PSI trigger armed, using vmpressure\n");
+}
+
+static void simple_lmk_psi_init(void)
+{
+	mutex_lock(&psi_lock);
+	psi_ready = true;
+	simple_lmk_psi_arm();
+	mutex_unlock(&psi_lock);
+}
+
+static int simple_lmk_psi_param_set(const char *val,
+				    const struct kernel_param *kp)
+{
+	int ret;
+
+	mutex_lock(&psi_lock);
+	ret = param_set_uint(val, kp);
+	if (!ret && psi_ready)
+		simple_lmk_psi_arm();
+	mutex_unlock(&psi_lock);
+
+	return ret;
+}
+
+static const struct kernel_param_ops simple_lmk_psi_param_ops = {
+	.set = simple_lmk_psi_param_set,
+	.get = param_get_uint,
+};
+
+module_param_cb(psi_window_ms, &simple_lmk_psi_param_ops, &psi_window_ms,
+		0644);
+module_param_cb(psi_full_threshold_ms, &simple_lmk_psi_param_ops,
+		&psi_full_threshold_ms, 0644);
+module_param_cb(psi_some_threshold_ms, &simple_lmk_psi_param_ops,
+		&psi_some_threshold_ms, 0644);
+
+static inline bool simple_lmk_psi_armed(void)
+{
+	return READ_ONCE(psi_armed);
+}
+#else
+static inline void simple_lmk_psi_init(void) { }
+
+static inline bool simple_lmk_psi_armed(void)
+{
+	return false;
+}
+#endif
+
 static int simple_lmk_vmpressure_cb(struct notifier_block *nb,
 				    unsigned long pressure, void *data)
 {
-	if (pressure == 100) {
-		atomic_set(&needs_reclaim, 1);
-		smp_mb__after_atomic();
-		if (waitqueue_active(&oom_waitq))
-			wake_up(&oom_waitq);
-	}
+	if (pressure == 100 && !simple_lmk_psi_armed())
+		simple_lmk_trigger_reclaim();
 
 	return NOTIFY_OK;
 }
@@ -486,13 +739,12 @@ static int simple_lmk_init_set(const char *val, const struct kernel_param *kp)
 	struct task_struct *thread;
 
 	if (!atomic_cmpxchg(&init_done, 0, 1)) {
-		thread = kthread_run(simple_lmk_reaper_thread, NULL,
-				     "simple_lmkd_reaper");
-		BUG_ON(IS_ERR(thread));
+		simple_lmk_start_reapers();
 		thread = kthread_run(simple_lmk_reclaim_thread, NULL,
 				     "simple_lmkd");
 		BUG_ON(IS_ERR(thread));
 		BUG_ON(vmpressure_notifier_register(&vmpressure_notif));
+		simple_lmk_psi_init();
 	}
 
 	return 0;
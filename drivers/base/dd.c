@@ -28,6 +28,9 @@
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
 #include <linux/platform_device.h>
+#include <linux/of.h>
+#include <linux/of_platform.h>
+#include <soc/qcom/boot_stats.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -376,12 +379,52 @@ EXPORT_SYMBOL_GPL(device_bind_driver);
 static atomic_t probe_count = ATOMIC_INIT(0);
 static DECLARE_WAIT_QUEUE_HEAD(probe_waitqueue);
 
+/*
+ * Platform devices listing other devices in "probe-after" are linked to them
+ * as consumers, so that they only probe once all of those are bound. This
+ * keeps drivers probed asynchronously in dependency order without relying on
+ * initcall order. Returns -EPROBE_DEFER while a listed device is not created.
+ */
+static int device_links_add_probe_after(struct device *dev)
+{
+	struct platform_device *pdev;
+	struct device_node *np;
+	struct device_link *link;
+	int i, ret = 0;
+
+	if (!IS_ENABLED(CONFIG_OF) || !dev->of_node)
+		return 0;
+
+	for (i = 0; (np = of_parse_phandle(dev->of_node, "probe-after", i));
+	     i++) {
+		pdev = of_find_device_by_node(np);
+		of_node_put(np);
+		if (!pdev) {
+			dev_dbg(dev, "probe-after %d not created yet\n", i);
+			ret = -EPROBE_DEFER;
+			break;
+		}
+
+		link = device_link_add(dev, &pdev->dev, DL_FLAG_AUTOREMOVE);
+		put_device(&pdev->dev);
+		if (!link) {
+			dev_warn(dev, "failed to link to %s\n",
+				 dev_name(&pdev->dev));
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	return ret;
+}
+
 static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = -EPROBE_DEFER;
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
 	bool test_remove = IS_ENABLED(CONFIG_DEBUG_TEST_DRIVER_REMOVE) &&
 			   !drv->suppress_bind_attrs;
+	ktime_t calltime;
 
 	if (defer_all_probes) {
 		/*
@@ -394,7 +437,15 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		return ret;
 	}
 
-	ret = device_links_check_suppliers(dev);
+	ret = device_links_add_probe_after(dev);
+	if (!ret)
+		ret = device_links_check_suppliers(dev);
+	if (ret == -EPROBE_DEFER) {
+		/* Retried once the missing supplier binds */
+		driver_deferred_probe_add(dev);
+		if (local_trigger_count != atomic_read(&deferred_trigger_count))
+			driver_deferred_probe_trigger();
+	}
 	if (ret)
 		return ret;
 
@@ -430,15 +481,17 @@ re_probe:
 			goto probe_failed;
 	}
 
-	if (dev->bus->probe) {
+	calltime = ktime_get();
+	if (dev->bus->probe)
 		ret = dev->bus->probe(dev);
-		if (ret)
-			goto probe_failed;
-	} else if (drv->probe) {
+	else if (drv->probe)
 		ret = drv->probe(dev);
-		if (ret)
-			goto probe_failed;
-	}
+	if (system_state < SYSTEM_RUNNING)
+		boot_stats_add_probe(drv->name, dev_name(dev),
+				     ktime_to_ns(ktime_sub(ktime_get(), calltime)),
+				     ret);
+	if (ret)
+		goto probe_failed;
 
 	if (test_remove) {
 		test_remove = false;
@@ -586,10 +639,14 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 
 static inline bool cmdline_requested_async_probing(const char *drv_name)
 {
-	return parse_option_str(async_probe_drv_names, drv_name);
+	return parse_option_str(async_probe_drv_names, drv_name) ||
+	       parse_option_str(async_probe_drv_names, "*");
 }
 
-/* The option format is "driver_async_probe=drv_name1,drv_name2,..." */
+/*
+ * The option format is "driver_async_probe=drv_name1,drv_name2,..." where
+ * "*" selects every driver that does not force synchronous probing.
+ */
 static int __init save_async_options(char *buf)
 {
 	if (strlen(buf) >= ASYNC_DRV_NAMES_MAX_LEN)
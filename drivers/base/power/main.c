@@ -34,6 +34,9 @@
 #include <linux/cpufreq.h>
 #include <linux/timer.h>
 #include <linux/wakeup_reason.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 
 #include "../base.h"
 #include "power.h"
@@ -200,18 +203,94 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
-static ktime_t initcall_debug_start(struct device *dev)
+/*
+ * Every suspend and resume callback is timed into a histogram of its phase,
+ * and the slowest callbacks of the last transition are kept, both shown in
+ * debugfs suspend_callbacks. Unlike pm_print_times this is always on, so
+ * slow drivers show up without reproducing the problem.
+ */
+enum dpm_cb_phase {
+	DPM_CB_SUSPEND,
+	DPM_CB_SUSPEND_LATE,
+	DPM_CB_SUSPEND_NOIRQ,
+	DPM_CB_RESUME_NOIRQ,
+	DPM_CB_RESUME_EARLY,
+	DPM_CB_RESUME,
+	DPM_CB_NR_PHASES,
+};
+
+static const char * const dpm_cb_phase_names[DPM_CB_NR_PHASES] = {
+	"suspend", "suspend_late", "suspend_noirq",
+	"resume_noirq", "resume_early", "resume",
+};
+
+/* bucket b counts callbacks of less than 2^b usecs */
+#define DPM_CB_BUCKETS		24
+#define DPM_CB_SLOWEST		10
+
+struct dpm_cb_stats {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u32 hist[DPM_CB_BUCKETS];
+};
+
+struct dpm_cb_slow {
+	char dev[32];
+	enum dpm_cb_phase phase;
+	u64 ns;
+};
+
+static DEFINE_SPINLOCK(dpm_cb_lock);
+static enum dpm_cb_phase dpm_cb_phase;
+static struct dpm_cb_stats dpm_cb_stats[DPM_CB_NR_PHASES];
+static struct dpm_cb_slow dpm_cb_slowest[DPM_CB_SLOWEST];
+
+static void dpm_cb_account(struct device *dev, u64 nsecs)
+{
+	struct dpm_cb_stats *st = &dpm_cb_stats[dpm_cb_phase];
+	unsigned int b = min_t(unsigned int, fls64(nsecs >> 10),
+			       DPM_CB_BUCKETS - 1);
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&dpm_cb_lock, flags);
+	st->count++;
+	st->total_ns += nsecs;
+	st->max_ns = max(st->max_ns, nsecs);
+	st->hist[b]++;
+
+	/* dpm_cb_slowest is sorted, slowest first */
+	i = DPM_CB_SLOWEST - 1;
+	if (nsecs > dpm_cb_slowest[i].ns) {
+		for (; i > 0 && nsecs > dpm_cb_slowest[i - 1].ns; i--)
+			dpm_cb_slowest[i] = dpm_cb_slowest[i - 1];
+		strlcpy(dpm_cb_slowest[i].dev, dev_name(dev),
+			sizeof(dpm_cb_slowest[i].dev));
+		dpm_cb_slowest[i].phase = dpm_cb_phase;
+		dpm_cb_slowest[i].ns = nsecs;
+	}
+	spin_unlock_irqrestore(&dpm_cb_lock, flags);
+}
+
+static void dpm_cb_start_transition(void)
 {
-	ktime_t calltime = 0;
+	unsigned long flags;
 
+	spin_lock_irqsave(&dpm_cb_lock, flags);
+	memset(dpm_cb_slowest, 0, sizeof(dpm_cb_slowest));
+	spin_unlock_irqrestore(&dpm_cb_lock, flags);
+}
+
+static ktime_t initcall_debug_start(struct device *dev)
+{
 	if (pm_print_times_enabled) {
 		pr_info("calling  %s+ @ %i, parent: %s\n",
 			dev_name(dev), task_pid_nr(current),
 			dev->parent ? dev_name(dev->parent) : "none");
-		calltime = ktime_get();
 	}
 
-	return calltime;
+	return ktime_get();
 }
 
 static void initcall_debug_report(struct device *dev, ktime_t calltime,
@@ -223,6 +302,7 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 
 	rettime = ktime_get();
 	nsecs = (s64) ktime_to_ns(ktime_sub(rettime, calltime));
+	dpm_cb_account(dev, nsecs);
 
 	if (pm_print_times_enabled) {
 		pr_info("call %s+ returned %d after %Ld usecs\n", dev_name(dev),
@@ -643,6 +723,7 @@ void dpm_noirq_resume_devices(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_resume_noirq"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cb_phase = DPM_CB_RESUME_NOIRQ;
 
 	/*
 	 * Advanced the async threads upfront,
@@ -783,6 +864,7 @@ void dpm_resume_early(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_resume_early"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cb_phase = DPM_CB_RESUME_EARLY;
 
 	/*
 	 * Advanced the async threads upfront,
@@ -959,6 +1041,7 @@ void dpm_resume(pm_message_t state)
 
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cb_phase = DPM_CB_RESUME;
 	async_error = 0;
 
 	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
@@ -1225,6 +1308,7 @@ int dpm_noirq_suspend_devices(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_suspend_noirq"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cb_phase = DPM_CB_SUSPEND_NOIRQ;
 	async_error = 0;
 
 	while (!list_empty(&dpm_late_early_list)) {
@@ -1386,6 +1470,7 @@ int dpm_suspend_late(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_suspend_late"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cb_phase = DPM_CB_SUSPEND_LATE;
 	async_error = 0;
 
 	while (!list_empty(&dpm_suspended_list)) {
@@ -1666,6 +1751,7 @@ int dpm_suspend(pm_message_t state)
 
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
+	dpm_cb_phase = DPM_CB_SUSPEND;
 	async_error = 0;
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
@@ -1782,6 +1868,7 @@ int dpm_prepare(pm_message_t state)
 
 	trace_suspend_resume(TPS("dpm_prepare"), state.event, true);
 	might_sleep();
+	dpm_cb_start_transition();
 
 	/*
 	 * Give a chance for the known devices to complete their probes, before
@@ -1925,3 +2012,70 @@ void device_pm_check_callbacks(struct device *dev)
 		 !dev->driver->suspend && !dev->driver->resume));
 	spin_unlock_irq(&dev->power.lock);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int dpm_cb_stats_show(struct seq_file *s, void *unused)
+{
+	struct dpm_cb_stats *st;
+	struct dpm_cb_slow *slow;
+	unsigned long flags;
+	int i, b;
+
+	st = kmalloc(sizeof(dpm_cb_stats), GFP_KERNEL);
+	slow = kmalloc(sizeof(dpm_cb_slowest), GFP_KERNEL);
+	if (!st || !slow) {
+		kfree(st);
+		kfree(slow);
+		return -ENOMEM;
+	}
+
+	spin_lock_irqsave(&dpm_cb_lock, flags);
+	memcpy(st, dpm_cb_stats, sizeof(dpm_cb_stats));
+	memcpy(slow, dpm_cb_slowest, sizeof(dpm_cb_slowest));
+	spin_unlock_irqrestore(&dpm_cb_lock, flags);
+
+	seq_printf(s, "%-14s %10s %12s %10s  histogram (<2^n us: count)\n",
+		   "phase", "count", "avg_us", "max_us");
+	for (i = 0; i < DPM_CB_NR_PHASES; i++) {
+		seq_printf(s, "%-14s %10llu %12llu %10llu ",
+			   dpm_cb_phase_names[i], st[i].count,
+			   st[i].count ?
+			   div64_u64(st[i].total_ns, st[i].count * NSEC_PER_USEC) : 0,
+			   div_u64(st[i].max_ns, NSEC_PER_USEC));
+		for (b = 0; b < DPM_CB_BUCKETS; b++)
+			if (st[i].hist[b])
+				seq_printf(s, " %d:%u", b, st[i].hist[b]);
+		seq_putc(s, '\n');
+	}
+
+	seq_puts(s, "\nslowest callbacks of the last transition:\n");
+	for (i = 0; i < DPM_CB_SLOWEST && slow[i].ns; i++)
+		seq_printf(s, "%-32s %-14s %10llu us\n", slow[i].dev,
+			   dpm_cb_phase_names[slow[i].phase],
+			   div_u64(slow[i].ns, NSEC_PER_USEC));
+
+	kfree(st);
+	kfree(slow);
+	return 0;
+}
+
+static int dpm_cb_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_cb_stats_show, NULL);
+}
+
+static const struct file_operations dpm_cb_stats_fops = {
+	.open		= dpm_cb_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_cb_debugfs_init(void)
+{
+	debugfs_create_file("suspend_callbacks", 0444, NULL, NULL,
+			    &dpm_cb_stats_fops);
+	return 0;
+}
+late_initcall(dpm_cb_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
@@ -8,6 +8,7 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/string.h>
 #include <linux/err.h>
 #include <linux/slab.h>
@@ -15,9 +16,18 @@
 #include <linux/sched.h>
 #include <linux/cpu.h>
 #include <linux/crypto.h>
+#include <crypto/acompress.h>
 
 #include "zcomp.h"
 
+/*
+ * Batch writes through an asynchronous implementation of the algorithm,
+ * such as a hardware engine, when one is registered. Decompression stays
+ * on the CPU: reads run under the slot lock and can't wait for an engine.
+ */
+static bool zcomp_use_acomp = true;
+module_param_named(acomp, zcomp_use_acomp, bool, 0644);
+
 static const char * const backends[] = {
 	"lzo",
 #if IS_ENABLED(CONFIG_CRYPTO_LZ4)
@@ -161,6 +171,78 @@ int zcomp_decompress(struct zcomp_strm *zstrm,
 			dst, &dst_len);
 }
 
+/*
+ * Returns a batch context if the device compresses through an asynchronous
+ * implementation, NULL otherwise. The context is not pinned to the CPU and
+ * the caller may sleep until zcomp_batch_put().
+ */
+struct zcomp_batch *zcomp_batch_get(struct zcomp *comp)
+{
+	struct zcomp_batch *batch;
+
+	if (!comp->acomp)
+		return NULL;
+
+	batch = *raw_cpu_ptr(comp->batch);
+	mutex_lock(&batch->lock);
+	return batch;
+}
+
+void zcomp_batch_put(struct zcomp_batch *batch)
+{
+	mutex_unlock(&batch->lock);
+}
+
+static void zcomp_batch_done(struct crypto_async_request *areq, int err)
+{
+	struct zcomp_batch_req *r = areq->data;
+	struct zcomp_batch *batch = r->batch;
+
+	/* a backlogged request was moved to the engine queue */
+	if (err == -EINPROGRESS)
+		return;
+
+	r->err = err;
+	r->len = err ? 0 : r->req->dlen;
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+/*
+ * Compress @nr full pages into batch->reqs[0..nr-1]. All requests are
+ * queued before waiting, and the caller picks up ->err, ->len and
+ * ->buffer of each one afterwards.
+ */
+void zcomp_compress_batch(struct zcomp_batch *batch,
+		struct page **pages, int nr)
+{
+	struct zcomp_batch_req *r;
+	int i, ret;
+
+	/* one extra reference so that nothing completes before all is queued */
+	atomic_set(&batch->pending, nr + 1);
+	reinit_completion(&batch->done);
+
+	for (i = 0; i < nr; i++) {
+		r = &batch->reqs[i];
+		sg_init_table(&r->src, 1);
+		sg_set_page(&r->src, pages[i], PAGE_SIZE, 0);
+		sg_init_one(&r->dst, r->buffer, PAGE_SIZE * 2);
+		acomp_request_set_params(r->req, &r->src, &r->dst,
+					 PAGE_SIZE, PAGE_SIZE * 2);
+		acomp_request_set_callback(r->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   zcomp_batch_done, r);
+
+		ret = crypto_acomp_compress(r->req);
+		/* the callback is only called for queued requests */
+		if (ret != -EINPROGRESS && ret != -EBUSY)
+			zcomp_batch_done(&r->req->base, ret);
+	}
+
+	if (!atomic_dec_and_test(&batch->pending))
+		wait_for_completion(&batch->done);
+}
+
 int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node)
 {
 	struct zcomp *comp = hlist_entry(node, struct zcomp, node);
@@ -190,6 +272,104 @@ int zcomp_cpu_dead(unsigned int cpu, struct hlist_node *node)
 	return 0;
 }
 
+static void zcomp_batch_free(struct zcomp_batch *batch)
+{
+	int i;
+
+	for (i = 0; i < ZCOMP_BATCH_MAX; i++) {
+		if (batch->reqs[i].req)
+			acomp_request_free(batch->reqs[i].req);
+		free_pages((unsigned long)batch->reqs[i].buffer, 1);
+	}
+	kfree(batch);
+}
+
+static struct zcomp_batch *zcomp_batch_alloc(struct zcomp *comp)
+{
+	struct zcomp_batch *batch;
+	int i;
+
+	batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return NULL;
+
+	mutex_init(&batch->lock);
+	init_completion(&batch->done);
+	for (i = 0; i < ZCOMP_BATCH_MAX; i++) {
+		struct zcomp_batch_req *r = &batch->reqs[i];
+
+		r->batch = batch;
+		r->req = acomp_request_alloc(comp->acomp);
+		r->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+		if (!r->req || !r->buffer) {
+			zcomp_batch_free(batch);
+			return NULL;
+		}
+	}
+	return batch;
+}
+
+static void zcomp_acomp_destroy(struct zcomp *comp)
+{
+	int cpu;
+
+	if (!comp->acomp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct zcomp_batch *batch = *per_cpu_ptr(comp->batch, cpu);
+
+		if (batch)
+			zcomp_batch_free(batch);
+	}
+	free_percpu(comp->batch);
+	crypto_free_acomp(comp->acomp);
+	comp->acomp = NULL;
+}
+
+/*
+ * Batch contexts exist for every possible CPU, not just the online ones:
+ * a writer may be migrated while it holds one, and so must never find it
+ * freed by CPU hotplug.
+ */
+static void zcomp_acomp_init(struct zcomp *comp)
+{
+	struct crypto_acomp *acomp;
+	int cpu;
+
+	if (!zcomp_use_acomp ||
+	    crypto_has_acomp(comp->name, CRYPTO_ALG_ASYNC, CRYPTO_ALG_ASYNC) != 1)
+		return;
+
+	acomp = crypto_alloc_acomp(comp->name, CRYPTO_ALG_ASYNC,
+				   CRYPTO_ALG_ASYNC);
+	if (IS_ERR(acomp))
+		return;
+
+	comp->acomp = acomp;
+	comp->batch = alloc_percpu(struct zcomp_batch *);
+	if (!comp->batch) {
+		crypto_free_acomp(acomp);
+		comp->acomp = NULL;
+		return;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct zcomp_batch *batch = zcomp_batch_alloc(comp);
+
+		if (!batch) {
+			pr_warn("Can't allocate %s batches, compressing on the CPU\n",
+				comp->name);
+			zcomp_acomp_destroy(comp);
+			return;
+		}
+		*per_cpu_ptr(comp->batch, cpu) = batch;
+	}
+
+	pr_info("%s: batching writes through %s\n", comp->name,
+		crypto_tfm_alg_driver_name(crypto_acomp_tfm(acomp)));
+}
+
 static int zcomp_init(struct zcomp *comp)
 {
 	int ret;
@@ -201,6 +381,8 @@ static int zcomp_init(struct zcomp *comp)
 	ret = cpuhp_state_add_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
 	if (ret < 0)
 		goto cleanup;
+
+	zcomp_acomp_init(comp);
 	return 0;
 
 cleanup:
@@ -210,6 +392,7 @@ cleanup:
 
 void zcomp_destroy(struct zcomp *comp)
 {
+	zcomp_acomp_destroy(comp);
 	cpuhp_state_remove_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
 	free_percpu(comp->stream);
 	kfree(comp);
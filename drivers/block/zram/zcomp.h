@@ -10,15 +10,47 @@
 #ifndef _ZCOMP_H_
 #define _ZCOMP_H_
 
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/scatterlist.h>
+
 struct zcomp_strm {
 	/* compression/decompression buffer */
 	void *buffer;
 	struct crypto_comp *tfm;
 };
 
+/*
+ * Pages compressed together by an asynchronous (offload) implementation of
+ * the algorithm. Every page has its own request and output buffer, so the
+ * whole run is submitted to the engine before any of it is waited for.
+ */
+#define ZCOMP_BATCH_MAX		16
+
+struct zcomp_batch_req {
+	struct zcomp_batch *batch;
+	struct acomp_req *req;
+	struct scatterlist src;
+	struct scatterlist dst;
+	/* 2 pages, see zcomp_compress() */
+	void *buffer;
+	unsigned int len;
+	int err;
+};
+
+struct zcomp_batch {
+	struct mutex lock;
+	atomic_t pending;
+	struct completion done;
+	struct zcomp_batch_req reqs[ZCOMP_BATCH_MAX];
+};
+
 /* dynamic per-device compression frontend */
 struct zcomp {
 	struct zcomp_strm * __percpu *stream;
+	/* set if writes are batched through an async implementation */
+	struct crypto_acomp *acomp;
+	struct zcomp_batch * __percpu *batch;
 	const char *name;
 	struct hlist_node node;
 };
@@ -40,5 +72,10 @@ int zcomp_compress(struct zcomp_strm *zstrm,
 int zcomp_decompress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int src_len, void *dst);
 
+struct zcomp_batch *zcomp_batch_get(struct zcomp *comp);
+void zcomp_batch_put(struct zcomp_batch *batch);
+void zcomp_compress_batch(struct zcomp_batch *batch,
+		struct page **pages, int nr);
+
 bool zcomp_set_max_streams(struct zcomp *comp, int num_strm);
 #endif /* _ZCOMP_H_ */
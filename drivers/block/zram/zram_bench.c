@@ -0,0 +1,443 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * zram benchmark on a page corpus
+ *
+ * Synthetic data says little about how an algorithm does on the anonymous
+ * memory of a real device, so this runs a corpus of pages captured from
+ * one, a plain file of whole pages, through each compressor and through a
+ * zram device. For every algorithm it reports the compression ratio, the
+ * throughput and the latency percentiles of compression and decompression,
+ * then the same for writes and reads of an initialised zram device.
+ *
+ *   echo /data/local/tmp/anon.pages > /sys/module/zram/parameters/bench_corpus
+ *   echo lzo,lz4 > /sys/module/zram/parameters/bench_algs
+ *   echo 1 > /sys/module/zram/parameters/bench_run
+ *
+ * The zram phase overwrites the first pages of bench_device and discards
+ * them afterwards, so the device must not be in use.
+ */
+
+#define pr_fmt(fmt) "zram_bench: " fmt
+
+#include <linux/completion.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zcomp.h"
+#include "zram_drv.h"
+
+/* Same log-linear buckets as the binder_alloc benchmark: 12.5% error */
+#define BENCH_SUB_SHIFT	3
+#define BENCH_SUB	(1 << BENCH_SUB_SHIFT)
+#define BENCH_BUCKETS	(64 * BENCH_SUB)
+#define BENCH_MAX_THREADS	16
+
+static char *bench_corpus;
+module_param(bench_corpus, charp, 0644);
+MODULE_PARM_DESC(bench_corpus, "File of captured pages to benchmark with");
+static char *bench_algs = "lzo,lz4";
+module_param(bench_algs, charp, 0644);
+MODULE_PARM_DESC(bench_algs, "Comma separated compressors to benchmark");
+static unsigned int bench_threads = 1;
+module_param(bench_threads, uint, 0644);
+static unsigned int bench_max_mb = 256;
+module_param(bench_max_mb, uint, 0644);
+MODULE_PARM_DESC(bench_max_mb, "Largest corpus read, in MB");
+static int bench_device = -1;
+module_param(bench_device, int, 0644);
+MODULE_PARM_DESC(bench_device, "zram device to benchmark, -1 for none");
+
+static DEFINE_MUTEX(zram_bench_lock);
+
+struct bench_corpus {
+	void *data;
+	unsigned long nr_pages;
+};
+
+struct bench_thread {
+	const struct bench_corpus *corpus;
+	unsigned int id, nr;
+	struct zcomp *comp;
+	struct zram *zram;
+	unsigned long zram_pages;
+	struct completion done;
+	void *cbuf;
+	void *dbuf;
+	struct page *page;
+	u64 comp_bytes;
+	unsigned long errors;
+	u64 ns[2];		/* time spent in each operation */
+	u32 hist[2][BENCH_BUCKETS];
+};
+
+static unsigned int bench_bucket(u64 ns)
+{
+	unsigned int shift;
+
+	if (ns < BENCH_SUB)
+		return ns;
+
+	shift = fls64(ns) - 1 - BENCH_SUB_SHIFT;
+	return min_t(unsigned int, (shift + 1) * BENCH_SUB +
+		     ((ns >> shift) & (BENCH_SUB - 1)), BENCH_BUCKETS - 1);
+}
+
+static u64 bench_bucket_ns(unsigned int b)
+{
+	unsigned int shift;
+
+	if (b < BENCH_SUB)
+		return b;
+
+	shift = b / BENCH_SUB - 1;
+	return (u64)(BENCH_SUB + b % BENCH_SUB) << shift;
+}
+
+static inline void bench_account(struct bench_thread *t, int op, u64 start)
+{
+	u64 ns = ktime_get_ns() - start;
+
+	t->ns[op] += ns;
+	t->hist[op][bench_bucket(ns)]++;
+}
+
+static int bench_zcomp_fn(void *data)
+{
+	struct bench_thread *t = data;
+	size_t huge = zram_bench_huge_size();
+	struct zcomp_strm *zstrm;
+	unsigned long i;
+	unsigned int clen;
+	void *src;
+	u64 start;
+	int ret;
+
+	for (i = t->id; i < t->corpus->nr_pages; i += t->nr) {
+		src = t->corpus->data + i * PAGE_SIZE;
+
+		start = ktime_get_ns();
+		zstrm = zcomp_stream_get(t->comp);
+		ret = zcomp_compress(zstrm, src, &clen);
+		if (!ret && clen < huge)
+			memcpy(t->cbuf, zstrm->buffer, clen);
+		zcomp_stream_put(t->comp);
+		bench_account(t, 0, start);
+
+		if (ret) {
+			t->errors++;
+			continue;
+		}
+
+		/* zram stores pages that do not shrink enough as they are */
+		if (clen >= huge) {
+			t->comp_bytes += PAGE_SIZE;
+			continue;
+		}
+		t->comp_bytes += clen;
+
+		start = ktime_get_ns();
+		zstrm = zcomp_stream_get(t->comp);
+		ret = zcomp_decompress(zstrm, t->cbuf, clen, t->dbuf);
+		zcomp_stream_put(t->comp);
+		bench_account(t, 1, start);
+
+		if (ret || memcmp(src, t->dbuf, PAGE_SIZE))
+			t->errors++;
+
+		if (!(i % 64))
+			cond_resched();
+	}
+
+	complete(&t->done);
+	return 0;
+}
+
+static int bench_zram_fn(void *data)
+{
+	struct bench_thread *t = data;
+	unsigned long i, nr = min(t->corpus->nr_pages, t->zram_pages);
+	void *buf = page_address(t->page);
+	u64 start;
+
+	for (i = t->id; i < nr; i += t->nr) {
+		memcpy(buf, t->corpus->data + i * PAGE_SIZE, PAGE_SIZE);
+		start = ktime_get_ns();
+		if (zram_bench_rw(t->zram, t->page, i, true) < 0)
+			t->errors++;
+		bench_account(t, 0, start);
+
+		if (!(i % 64))
+			cond_resched();
+	}
+
+	for (i = t->id; i < nr; i += t->nr) {
+		start = ktime_get_ns();
+		if (zram_bench_rw(t->zram, t->page, i, false) < 0 ||
+		    memcmp(buf, t->corpus->data + i * PAGE_SIZE, PAGE_SIZE))
+			t->errors++;
+		bench_account(t, 1, start);
+
+		if (!(i % 64))
+			cond_resched();
+	}
+
+	complete(&t->done);
+	return 0;
+}
+
+static void bench_report(const char *name, const char *op, u32 *hist, u64 ns)
+{
+	static const unsigned int pct[] = { 500, 990 };
+	u64 total = 0, seen = 0, val[ARRAY_SIZE(pct)] = { 0 };
+	unsigned int b, p = 0;
+
+	for (b = 0; b < BENCH_BUCKETS; b++)
+		total += hist[b];
+	if (!total)
+		return;
+
+	for (b = 0; b < BENCH_BUCKETS && p < ARRAY_SIZE(pct); b++) {
+		seen += hist[b];
+		while (p < ARRAY_SIZE(pct) && seen * 1000 >= total * pct[p])
+			val[p++] = bench_bucket_ns(b);
+	}
+
+	/* every op is one page, ns is summed over the threads: MB/s/thread */
+	pr_info("%s %s: n=%llu %llu MB/s p50=%lluns p99=%lluns\n",
+		name, op, total,
+		div64_u64(total * PAGE_SIZE * NSEC_PER_SEC,
+			  max_t(u64, ns, 1) * SZ_1M),
+		val[0], val[1]);
+}
+
+/* Start nr threads of fn on t and fold their results into t[0] */
+static unsigned long bench_run_threads(struct bench_thread *t, unsigned int nr,
+				       int (*fn)(void *))
+{
+	struct task_struct *tsk;
+	unsigned long errors = 0;
+	unsigned int i, op, b;
+
+	for (i = 0; i < nr; i++) {
+		init_completion(&t[i].done);
+		tsk = kthread_run(fn, &t[i], "zram_bench/%u", i);
+		if (IS_ERR(tsk)) {
+			t[i].errors++;
+			complete(&t[i].done);
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		wait_for_completion(&t[i].done);
+		errors += t[i].errors;
+		if (!i)
+			continue;
+		t[0].comp_bytes += t[i].comp_bytes;
+		for (op = 0; op < 2; op++) {
+			t[0].ns[op] += t[i].ns[op];
+			for (b = 0; b < BENCH_BUCKETS; b++)
+				t[0].hist[op][b] += t[i].hist[op][b];
+		}
+	}
+
+	return errors;
+}
+
+static void bench_reset_threads(struct bench_thread *t, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		t[i].comp_bytes = 0;
+		t[i].errors = 0;
+		memset(t[i].ns, 0, sizeof(t[i].ns));
+		memset(t[i].hist, 0, sizeof(t[i].hist));
+	}
+}
+
+static void bench_zcomp(struct bench_thread *t, unsigned int nr,
+			const char *alg)
+{
+	u64 bytes = (u64)t->corpus->nr_pages * PAGE_SIZE;
+	unsigned long errors;
+	struct zcomp *comp;
+	unsigned int i;
+
+	if (!zcomp_available_algorithm(alg)) {
+		pr_warn("%s: not available\n", alg);
+		return;
+	}
+
+	comp = zcomp_create(alg);
+	if (IS_ERR(comp)) {
+		pr_warn("%s: cannot create: %ld\n", alg, PTR_ERR(comp));
+		return;
+	}
+
+	bench_reset_threads(t, nr);
+	for (i = 0; i < nr; i++)
+		t[i].comp = comp;
+	errors = bench_run_threads(t, nr, bench_zcomp_fn);
+	zcomp_destroy(comp);
+
+	pr_info("%s: %lu pages, ratio %llu.%02llu, %lu errors\n", alg,
+		t->corpus->nr_pages,
+		div64_u64(bytes, max_t(u64, t->comp_bytes, 1)),
+		div64_u64(bytes * 100, max_t(u64, t->comp_bytes, 1)) % 100,
+		errors);
+	bench_report(alg, "compress", t->hist[0], t->ns[0]);
+	bench_report(alg, "decompress", t->hist[1], t->ns[1]);
+}
+
+static void bench_zram(struct bench_thread *t, unsigned int nr)
+{
+	unsigned long i, pages, errors;
+	struct zram *zram;
+	u64 stored;
+
+	zram = zram_bench_get(bench_device);
+	if (IS_ERR(zram)) {
+		pr_warn("zram%d: cannot claim: %ld\n", bench_device,
+			PTR_ERR(zram));
+		return;
+	}
+
+	pages = min(t->corpus->nr_pages, zram_bench_pages(zram));
+	bench_reset_threads(t, nr);
+	for (i = 0; i < nr; i++) {
+		t[i].zram = zram;
+		t[i].zram_pages = pages;
+	}
+
+	errors = bench_run_threads(t, nr, bench_zram_fn);
+	stored = atomic64_read(&zram->stats.compr_data_size);
+
+	for (i = 0; i < pages; i++)
+		zram_bench_discard(zram, i);
+
+	pr_info("zram%d %s: %lu pages, %llu bytes stored, %lu errors\n",
+		bench_device, zram->compressor, pages, stored, errors);
+	bench_report(zram->compressor, "write", t->hist[0], t->ns[0]);
+	bench_report(zram->compressor, "read", t->hist[1], t->ns[1]);
+
+	zram_bench_put(zram);
+}
+
+static int bench_load_corpus(struct bench_corpus *corpus)
+{
+	loff_t size;
+	int ret;
+
+	if (!bench_corpus || !*bench_corpus)
+		return -EINVAL;
+
+	corpus->data = NULL;
+	ret = kernel_read_file_from_path(bench_corpus, &corpus->data, &size,
+					 (loff_t)bench_max_mb * SZ_1M,
+					 READING_UNKNOWN);
+	if (ret)
+		return ret;
+
+	/* a trailing partial page is ignored */
+	corpus->nr_pages = size >> PAGE_SHIFT;
+	if (!corpus->nr_pages) {
+		vfree(corpus->data);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int zram_bench(void)
+{
+	struct bench_corpus corpus;
+	struct bench_thread *t;
+	char *algs, *list, *alg;
+	unsigned int i, nr;
+	int ret;
+
+	ret = bench_load_corpus(&corpus);
+	if (ret) {
+		pr_warn("cannot read corpus %s: %d\n",
+			bench_corpus ? bench_corpus : "(none)", ret);
+		return ret;
+	}
+
+	nr = clamp(bench_threads, 1U, (unsigned int)BENCH_MAX_THREADS);
+	ret = -ENOMEM;
+	t = vzalloc(nr * sizeof(*t));
+	if (!t)
+		goto out_corpus;
+
+	for (i = 0; i < nr; i++) {
+		t[i].corpus = &corpus;
+		t[i].id = i;
+		t[i].nr = nr;
+		t[i].cbuf = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+		t[i].dbuf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		t[i].page = alloc_page(GFP_KERNEL);
+		if (!t[i].cbuf || !t[i].dbuf || !t[i].page)
+			goto out_threads;
+	}
+
+	algs = kstrdup(bench_algs, GFP_KERNEL);
+	if (!algs)
+		goto out_threads;
+
+	pr_info("STARTED corpus=%s pages=%lu threads=%u\n", bench_corpus,
+		corpus.nr_pages, nr);
+
+	list = algs;
+	while ((alg = strsep(&list, ",")) != NULL) {
+		alg = strim(alg);
+		if (*alg)
+			bench_zcomp(t, nr, alg);
+	}
+	kfree(algs);
+
+	if (bench_device >= 0)
+		bench_zram(t, nr);
+	ret = 0;
+
+out_threads:
+	for (i = 0; i < nr; i++) {
+		if (t[i].page)
+			__free_page(t[i].page);
+		kfree(t[i].dbuf);
+		kfree(t[i].cbuf);
+	}
+	vfree(t);
+out_corpus:
+	vfree(corpus.data);
+	return ret;
+}
+
+static int bench_run_set(const char *val, const struct kernel_param *kp)
+{
+	bool run;
+	int ret;
+
+	ret = strtobool(val, &run);
+	if (ret || !run)
+		return ret;
+
+	mutex_lock(&zram_bench_lock);
+	ret = zram_bench();
+	mutex_unlock(&zram_bench_lock);
+
+	return ret;
+}
+
+static const struct kernel_param_ops bench_run_ops = {
+	.set = bench_run_set,
+};
+module_param_cb(bench_run, &bench_run_ops, NULL, 0200);
+MODULE_PARM_DESC(bench_run, "Write 1 to run the benchmark");
@@ -10,6 +10,7 @@
 #include <linux/vmalloc.h>
 #include <linux/jhash.h>
 #include <linux/highmem.h>
+#include <linux/sched/clock.h>
 
 #include "zram_drv.h"
 
@@ -18,6 +19,24 @@
 #define ZRAM_HASH_SIZE_MIN	(1 << 10)
 #define ZRAM_HASH_SIZE_MAX	(1 << 31)
 
+/*
+ * The fingerprint only covers a few cache lines spread over the page.
+ * A false match costs a decompression and a memcmp in zram_dedup_match(),
+ * so the number of candidates tried per lookup is bounded.
+ */
+#define ZRAM_DEDUP_SAMPLES	8
+#define ZRAM_DEDUP_SAMPLE_SIZE	64
+#define ZRAM_DEDUP_MAX_CANDIDATES	4
+
+/*
+ * In adaptive mode the hit rate is sampled over ZRAM_DEDUP_WINDOW lookups.
+ * If fewer than ZRAM_DEDUP_MIN_HITS of them found a duplicate, lookups
+ * and indexing are skipped for the next ZRAM_DEDUP_BACKOFF writes.
+ */
+#define ZRAM_DEDUP_WINDOW	4096
+#define ZRAM_DEDUP_MIN_HITS	(ZRAM_DEDUP_WINDOW / 32)
+#define ZRAM_DEDUP_BACKOFF	(16 * ZRAM_DEDUP_WINDOW)
+
 u64 zram_dedup_dup_size(struct zram *zram)
 {
 	return (u64)atomic64_read(&zram->stats.dup_data_size);
@@ -30,7 +49,52 @@ u64 zram_dedup_meta_size(struct zram *zram)
 
 static u32 zram_dedup_checksum(unsigned char *mem)
 {
-	return jhash(mem, PAGE_SIZE, 0);
+	u32 checksum = 0;
+	int i;
+
+	for (i = 0; i < ZRAM_DEDUP_SAMPLES; i++)
+		checksum = jhash2((u32 *)(mem + i * (PAGE_SIZE /
+					ZRAM_DEDUP_SAMPLES)),
+				ZRAM_DEDUP_SAMPLE_SIZE / sizeof(u32), checksum);
+
+	/* 0 is reserved for pages that were not looked up */
+	return checksum ?: 1;
+}
+
+static bool zram_dedup_paused(struct zram *zram)
+{
+	if (!zram->dedup_adaptive || atomic_read(&zram->dedup_skip) <= 0)
+		return false;
+
+	atomic_dec(&zram->dedup_skip);
+	return true;
+}
+
+static void zram_dedup_sample(struct zram *zram, bool hit)
+{
+	int lookups;
+
+	if (hit)
+		atomic64_inc(&zram->stats.dedup_hits);
+	else
+		atomic64_inc(&zram->stats.dedup_misses);
+
+	if (!zram->dedup_adaptive)
+		return;
+
+	if (hit)
+		atomic_inc(&zram->dedup_window_hits);
+
+	lookups = atomic_inc_return(&zram->dedup_window);
+	if (lookups < ZRAM_DEDUP_WINDOW)
+		return;
+
+	/* only one writer closes the window */
+	if (atomic_cmpxchg(&zram->dedup_window, lookups, 0) != lookups)
+		return;
+
+	if (atomic_xchg(&zram->dedup_window_hits, 0) < ZRAM_DEDUP_MIN_HITS)
+		atomic_set(&zram->dedup_skip, ZRAM_DEDUP_BACKOFF);
 }
 
 void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
@@ -41,7 +105,7 @@ void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
 	struct rb_node **rb_node, *parent = NULL;
 	struct zram_entry *entry;
 
-	if (!zram_dedup_enabled(zram))
+	if (!zram_dedup_enabled(zram) || !checksum)
 		return;
 
 	new->checksum = checksum;
@@ -100,8 +164,10 @@ static unsigned long zram_dedup_put(struct zram *zram,
 	spin_lock(&hash->lock);
 
 	val = --entry->refcount;
-	if (!entry->refcount)
-		rb_erase(&entry->rb_node, &hash->rb_root);
+	if (!entry->refcount) {
+		if (!RB_EMPTY_NODE(&entry->rb_node))
+			rb_erase(&entry->rb_node, &hash->rb_root);
+	}
 	else
 		atomic64_sub(entry->len, &zram->stats.dup_data_size);
 
@@ -116,6 +182,7 @@ static struct zram_entry *__zram_dedup_get(struct zram *zram,
 {
 	struct zram_entry *tmp, *prev = NULL;
 	struct rb_node *rb_node;
+	int candidates = 0;
 
 	/* find left-most entry with same checksum */
 	while ((rb_node = rb_prev(&entry->rb_node))) {
@@ -143,7 +210,8 @@ again:
 	if (rb_node)
 		tmp = rb_entry(rb_node, struct zram_entry, rb_node);
 
-	if (tmp && (tmp->checksum == entry->checksum)) {
+	if (tmp && (tmp->checksum == entry->checksum) &&
+			++candidates < ZRAM_DEDUP_MAX_CANDIDATES) {
 		prev = entry;
 		entry = tmp;
 		goto again;
@@ -186,16 +254,25 @@ struct zram_entry *zram_dedup_find(struct zram *zram, struct page *page,
 {
 	void *mem;
 	struct zram_entry *entry;
+	u64 start;
 
 	if (!zram_dedup_enabled(zram))
 		return NULL;
 
+	*checksum = 0;
+	if (zram_dedup_paused(zram))
+		return NULL;
+
+	start = local_clock();
 	mem = kmap_atomic(page);
 	*checksum = zram_dedup_checksum(mem);
 
 	entry = zram_dedup_get(zram, mem, *checksum);
 	kunmap_atomic(mem);
 
+	zram_dedup_sample(zram, entry);
+	atomic64_add(local_clock() - start, &zram->stats.dedup_time);
+
 	return entry;
 }
 
@@ -208,6 +285,8 @@ void zram_dedup_init_entry(struct zram *zram, struct zram_entry *entry,
 	entry->handle = handle;
 	entry->refcount = 1;
 	entry->len = len;
+	/* not indexed until zram_dedup_insert() */
+	RB_CLEAR_NODE(&entry->rb_node);
 }
 
 bool zram_dedup_put_entry(struct zram *zram, struct zram_entry *entry)
@@ -244,6 +323,10 @@ int zram_dedup_init(struct zram *zram, size_t num_pages)
 		hash->rb_root = RB_ROOT;
 	}
 
+	atomic_set(&zram->dedup_window, 0);
+	atomic_set(&zram->dedup_window_hits, 0);
+	atomic_set(&zram->dedup_skip, 0);
+
 	return 0;
 }
 
@@ -33,6 +33,7 @@
 #include <linux/sysfs.h>
 #include <linux/debugfs.h>
 #include <linux/cpuhotplug.h>
+#include <linux/lat_hist.h>
 
 #include "zram_drv.h"
 
@@ -142,6 +143,16 @@ static inline bool zram_allocated(struct zram *zram, u32 index)
 			zram_test_flag(zram, index, ZRAM_WB);
 }
 
+/* Algorithm that has to be used to decompress the slot */
+static struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram_test_flag(zram, index, ZRAM_COMP_PRIORITY))
+		return zram->recomp;
+#endif
+	return zram->comp;
+}
+
 #if PAGE_SIZE != 4096
 static inline bool is_partial_io(struct bio_vec *bvec)
 {
@@ -399,13 +410,33 @@ static ssize_t writeback_limit_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
 
+static void zram_ra_free(struct zram *zram)
+{
+	int i;
+
+	for (i = 0; i < ZRAM_RA_PAGES; i++) {
+		if (zram->ra_pages[i])
+			__free_page(zram->ra_pages[i]);
+		zram->ra_pages[i] = NULL;
+	}
+	zram->ra_nr = 0;
+}
+
 static void reset_bdev(struct zram *zram)
 {
 	struct block_device *bdev;
+	bool busy;
 
 	if (!zram->backing_dev)
 		return;
 
+	spin_lock_irq(&zram->ra_lock);
+	busy = zram->ra_busy;
+	spin_unlock_irq(&zram->ra_lock);
+	if (busy)
+		wait_for_completion(&zram->ra_done);
+	zram_ra_free(zram);
+
 	bdev = zram->bdev;
 	if (zram->old_block_size)
 		set_blocksize(bdev, zram->old_block_size);
@@ -461,7 +492,7 @@ static ssize_t backing_dev_store(struct device *dev,
 	unsigned int bitmap_sz, old_block_size = 0;
 	unsigned long nr_pages, *bitmap = NULL;
 	struct block_device *bdev = NULL;
-	int err;
+	int err, i;
 	struct zram *zram = dev_to_zram(dev);
 
 	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
@@ -519,6 +550,15 @@ static ssize_t backing_dev_store(struct device *dev,
 
 	reset_bdev(zram);
 
+	for (i = 0; i < ZRAM_RA_PAGES; i++) {
+		zram->ra_pages[i] = alloc_page(GFP_KERNEL);
+		if (!zram->ra_pages[i]) {
+			zram_ra_free(zram);
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+
 	zram->old_block_size = old_block_size;
 	zram->bdev = bdev;
 	zram->backing_dev = backing_dev;
@@ -563,10 +603,62 @@ retry:
 	return blk_idx;
 }
 
+/*
+ * Allocate up to *nr contiguous blocks so that a writeback batch goes
+ * out as a single bio. The run is halved until a free area is found and
+ * *nr is updated to the number of blocks actually allocated.
+ */
+static unsigned long alloc_blocks_bdev(struct zram *zram, unsigned int *nr)
+{
+	unsigned long blk_idx;
+	unsigned int i, want = *nr;
+
+	while (want > 1) {
+		/* skip 0 bit to confuse zram.handle = 0 */
+		blk_idx = bitmap_find_next_zero_area(zram->bitmap,
+					zram->nr_pages, 1, want, 0);
+		if (blk_idx + want > zram->nr_pages) {
+			want >>= 1;
+			continue;
+		}
+
+		for (i = 0; i < want; i++)
+			if (test_and_set_bit(blk_idx + i, zram->bitmap))
+				break;
+
+		if (i == want) {
+			atomic64_add(want, &zram->stats.bd_count);
+			*nr = want;
+			return blk_idx;
+		}
+
+		/* raced with another allocator, give back what we took */
+		while (i--)
+			clear_bit(blk_idx + i, zram->bitmap);
+	}
+
+	*nr = 1;
+	return alloc_block_bdev(zram);
+}
+
+static void zram_ra_invalidate(struct zram *zram, unsigned long blk_idx)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&zram->ra_lock, flags);
+	if (blk_idx >= zram->ra_start &&
+			blk_idx < zram->ra_start + ZRAM_RA_PAGES) {
+		zram->ra_nr = 0;
+		zram->ra_gen++;
+	}
+	spin_unlock_irqrestore(&zram->ra_lock, flags);
+}
+
 static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
 {
 	int was_set;
 
+	zram_ra_invalidate(zram, blk_idx);
 	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
 	WARN_ON_ONCE(!was_set);
 	atomic64_dec(&zram->stats.bd_count);
@@ -612,79 +704,153 @@ static int read_from_bdev_async(struct zram *zram, struct bio_vec *bvec,
 	return 1;
 }
 
-#define HUGE_WRITEBACK 1
-#define IDLE_WRITEBACK 2
+/*
+ * Serve a read of @blk_idx from the readahead window. Returns true if
+ * the block was found there and copied into @page.
+ */
+static bool zram_ra_read(struct zram *zram, unsigned long blk_idx,
+			struct page *page)
+{
+	unsigned long flags;
+	bool hit = false;
 
-static ssize_t writeback_store(struct device *dev,
-		struct device_attribute *attr, const char *buf, size_t len)
+	spin_lock_irqsave(&zram->ra_lock, flags);
+	if (!zram->ra_busy && zram->ra_nr && blk_idx >= zram->ra_start &&
+			blk_idx < zram->ra_start + zram->ra_nr) {
+		void *src, *dst;
+
+		src = kmap_atomic(zram->ra_pages[blk_idx - zram->ra_start]);
+		dst = kmap_atomic(page);
+		memcpy(dst, src, PAGE_SIZE);
+		kunmap_atomic(dst);
+		kunmap_atomic(src);
+		hit = true;
+	}
+	spin_unlock_irqrestore(&zram->ra_lock, flags);
+
+	if (hit)
+		atomic64_inc(&zram->stats.bd_ra_hits);
+
+	return hit;
+}
+
+static void zram_ra_end_io(struct bio *bio)
 {
-	struct zram *zram = dev_to_zram(dev);
-	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
-	unsigned long index;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct page *page;
-	ssize_t ret, sz;
-	char mode_buf[8];
-	int mode = -1;
-	unsigned long blk_idx = 0;
+	struct zram *zram = bio->bi_private;
+	unsigned long flags;
 
-	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
-	if (sz <= 0)
-		return -EINVAL;
+	spin_lock_irqsave(&zram->ra_lock, flags);
+	/* a block of the window was freed while the read was in flight */
+	if (!bio->bi_status && zram->ra_issue_gen == zram->ra_gen)
+		zram->ra_nr = zram->ra_pending;
+	zram->ra_busy = false;
+	complete(&zram->ra_done);
+	spin_unlock_irqrestore(&zram->ra_lock, flags);
 
-	/* ignore trailing newline */
-	if (mode_buf[sz - 1] == '\n')
-		mode_buf[sz - 1] = 0x00;
+	bio_put(bio);
+}
 
-	if (!strcmp(mode_buf, "idle"))
-		mode = IDLE_WRITEBACK;
-	else if (!strcmp(mode_buf, "huge"))
-		mode = HUGE_WRITEBACK;
+/*
+ * Read the written back blocks following @blk_idx into the readahead
+ * window. Writeback stores neighbouring slots in contiguous blocks, so
+ * this turns the swap readahead of those slots into memory copies.
+ */
+static void zram_ra_start(struct zram *zram, unsigned long blk_idx)
+{
+	struct bio *bio;
+	unsigned int i, nr = 0;
 
-	if (mode == -1)
-		return -EINVAL;
+	while (nr < ZRAM_RA_PAGES && blk_idx + 1 + nr < zram->nr_pages &&
+			test_bit(blk_idx + 1 + nr, zram->bitmap))
+		nr++;
+	if (!nr)
+		return;
 
-	down_read(&zram->init_lock);
-	if (!init_done(zram)) {
-		ret = -EINVAL;
-		goto release_init_lock;
+	spin_lock_irq(&zram->ra_lock);
+	if (zram->ra_busy || (zram->ra_nr && blk_idx + 1 >= zram->ra_start &&
+			blk_idx + 1 + nr <= zram->ra_start + zram->ra_nr)) {
+		spin_unlock_irq(&zram->ra_lock);
+		return;
 	}
+	zram->ra_busy = true;
+	zram->ra_start = blk_idx + 1;
+	zram->ra_nr = 0;
+	zram->ra_pending = nr;
+	zram->ra_issue_gen = zram->ra_gen;
+	reinit_completion(&zram->ra_done);
+	spin_unlock_irq(&zram->ra_lock);
 
-	if (!zram->backing_dev) {
-		ret = -ENODEV;
-		goto release_init_lock;
+	bio = bio_alloc(GFP_ATOMIC, nr);
+	if (!bio)
+		goto fail;
+
+	bio->bi_iter.bi_sector = (blk_idx + 1) * (PAGE_SIZE >> 9);
+	bio_set_dev(bio, zram->bdev);
+	bio->bi_opf = REQ_OP_READ | REQ_RAHEAD;
+	bio->bi_end_io = zram_ra_end_io;
+	bio->bi_private = zram;
+	for (i = 0; i < nr; i++) {
+		if (!bio_add_page(bio, zram->ra_pages[i], PAGE_SIZE, 0)) {
+			bio_put(bio);
+			goto fail;
+		}
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
-		ret = -ENOMEM;
-		goto release_init_lock;
+	atomic64_add(nr, &zram->stats.bd_ra_reads);
+	submit_bio(bio);
+	return;
+
+fail:
+	spin_lock_irq(&zram->ra_lock);
+	zram->ra_busy = false;
+	complete(&zram->ra_done);
+	spin_unlock_irq(&zram->ra_lock);
+}
+
+#define HUGE_WRITEBACK 1
+#define IDLE_WRITEBACK 2
+
+struct zram_wb_req {
+	struct bio *bio;
+	unsigned long blk_idx;		/* first block of the batch */
+	unsigned int nr;		/* slots in the batch */
+	u32 index[ZRAM_WB_BATCH];
+	struct page *pages[ZRAM_WB_BATCH];
+	struct completion done;
+};
+
+/* Number of pages the writeback limit still allows, at most a batch */
+static unsigned int zram_wb_budget(struct zram *zram, unsigned int inflight)
+{
+	u64 budget = ZRAM_WB_BATCH;
+
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable) {
+		u64 pages = zram->bd_wb_limit >> (PAGE_SHIFT - 12);
+
+		pages = pages > inflight ? pages - inflight : 0;
+		budget = min(budget, pages);
 	}
+	spin_unlock(&zram->wb_limit_lock);
 
-	for (index = 0; index < nr_pages; index++) {
+	return budget;
+}
+
+/*
+ * Pick up to @max slots from @index on and read them into the batch
+ * pages. Returns the index the next batch should start from.
+ */
+static unsigned long zram_wb_collect(struct zram *zram,
+			struct zram_wb_req *req, unsigned long index,
+			unsigned long nr_pages, unsigned int max, int mode)
+{
+	for (; index < nr_pages && req->nr < max; index++) {
 		struct bio_vec bvec;
 
-		bvec.bv_page = page;
+		bvec.bv_page = req->pages[req->nr];
 		bvec.bv_len = PAGE_SIZE;
 		bvec.bv_offset = 0;
 
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && !zram->bd_wb_limit) {
-			spin_unlock(&zram->wb_limit_lock);
-			ret = -EIO;
-			break;
-		}
-		spin_unlock(&zram->wb_limit_lock);
-
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
-				ret = -ENOSPC;
-				break;
-			}
-		}
-
 		zram_slot_lock(zram, index);
 		if (!zram_allocated(zram, index))
 			goto next;
@@ -710,8 +876,8 @@ static ssize_t writeback_store(struct device *dev,
 		 * to prevent race window between writing the huge page and
 		 * populating new allocated hugepage in the same slot.
 		 * In that case, new slot will not have ZRAM_IDLE bit so
-		 * we could prevent the race.  Please find the detail below
-		 * comments.
+		 * we could prevent the race.  Please find the detail in
+		 * zram_wb_complete.
 		 */
 		zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
@@ -723,27 +889,60 @@ static ssize_t writeback_store(struct device *dev,
 			continue;
 		}
 
-		bio_init(&bio, &bio_vec, 1);
-		bio_set_dev(&bio, zram->bdev);
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
-		bio.bi_opf = REQ_OP_WRITE | REQ_SYNC;
+		req->index[req->nr++] = index;
+		continue;
+next:
+		zram_slot_unlock(zram, index);
+	}
+
+	return index;
+}
 
-		bio_add_page(&bio, bvec.bv_page, bvec.bv_len,
-				bvec.bv_offset);
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		ret = submit_bio_wait(&bio);
-		if (ret) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
-		}
+static void zram_wb_end_io(struct bio *bio)
+{
+	struct zram_wb_req *req = bio->bi_private;
+
+	complete(&req->done);
+}
+
+static void zram_wb_submit(struct zram *zram, struct zram_wb_req *req)
+{
+	struct bio *bio;
+	unsigned int i;
+
+	/* can't fail, bio_alloc() waits on the mempool for GFP_KERNEL */
+	bio = bio_alloc(GFP_KERNEL, req->nr);
+	bio_set_dev(bio, zram->bdev);
+	bio->bi_iter.bi_sector = req->blk_idx * (PAGE_SIZE >> 9);
+	bio->bi_opf = REQ_OP_WRITE | REQ_SYNC;
+	bio_set_wb_class(bio, BIO_WB_SWAP);
+	bio->bi_end_io = zram_wb_end_io;
+	bio->bi_private = req;
+	for (i = 0; i < req->nr; i++)
+		bio_add_page(bio, req->pages[i], PAGE_SIZE, 0);
+
+	req->bio = bio;
+	reinit_completion(&req->done);
+	submit_bio(bio);
+}
+
+static void zram_wb_complete(struct zram *zram, struct zram_wb_req *req)
+{
+	unsigned int i;
+	int err;
+
+	wait_for_completion(&req->done);
+	err = blk_status_to_errno(req->bio->bi_status);
+	bio_put(req->bio);
+	req->bio = NULL;
+
+	if (!err)
+		atomic64_add(req->nr, &zram->stats.bd_writes);
+
+	for (i = 0; i < req->nr; i++) {
+		u32 index = req->index[i];
+		unsigned long blk_idx = req->blk_idx + i;
 
-		atomic64_inc(&zram->stats.bd_writes);
 		/*
 		 * We released zram_slot_lock so need to verify if the slot was
 		 * changed under us. If slot was freed, we can catch it by
@@ -757,31 +956,134 @@ static ssize_t writeback_store(struct device *dev,
 		 * by checking ZRAM_IDLE bit.
 		 */
 		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
+		if (err || !zram_allocated(zram, index) ||
 			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
 			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
 			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
+			zram_slot_unlock(zram, index);
+			free_block_bdev(zram, blk_idx);
+			continue;
 		}
 
 		zram_free_page(zram, index);
 		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
 		zram_set_flag(zram, index, ZRAM_WB);
 		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
 		atomic64_inc(&zram->stats.pages_stored);
 		spin_lock(&zram->wb_limit_lock);
 		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
 			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
 		spin_unlock(&zram->wb_limit_lock);
-next:
 		zram_slot_unlock(zram, index);
 	}
+}
+
+static void zram_wb_free_reqs(struct zram_wb_req *reqs, int nr_reqs)
+{
+	int i, j;
+
+	for (i = 0; i < nr_reqs; i++)
+		for (j = 0; j < ZRAM_WB_BATCH; j++)
+			if (reqs[i].pages[j])
+				__free_page(reqs[i].pages[j]);
+	kfree(reqs);
+}
+
+/*
+ * Writeback keeps two batches going: while one bio is in flight, the next
+ * batch is collected and read out of zsmalloc.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index = 0;
+	struct zram_wb_req *reqs, *cur, *inflight = NULL;
+	ssize_t ret, sz;
+	char mode_buf[8];
+	int mode = -1;
+	int i, j;
+
+	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
+	if (sz <= 0)
+		return -EINVAL;
+
+	/* ignore trailing newline */
+	if (mode_buf[sz - 1] == '\n')
+		mode_buf[sz - 1] = 0x00;
+
+	if (!strcmp(mode_buf, "idle"))
+		mode = IDLE_WRITEBACK;
+	else if (!strcmp(mode_buf, "huge"))
+		mode = HUGE_WRITEBACK;
+
+	if (mode == -1)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	reqs = kcalloc(2, sizeof(*reqs), GFP_KERNEL);
+	if (!reqs) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	for (i = 0; i < 2; i++) {
+		init_completion(&reqs[i].done);
+		for (j = 0; j < ZRAM_WB_BATCH; j++) {
+			reqs[i].pages[j] = alloc_page(GFP_KERNEL);
+			if (!reqs[i].pages[j]) {
+				zram_wb_free_reqs(reqs, 2);
+				ret = -ENOMEM;
+				goto release_init_lock;
+			}
+		}
+	}
+
+	cur = &reqs[0];
+	while (index < nr_pages) {
+		unsigned int nr;
+
+		nr = zram_wb_budget(zram, inflight ? inflight->nr : 0);
+		if (!nr)
+			break;
+
+		cur->blk_idx = alloc_blocks_bdev(zram, &nr);
+		if (!cur->blk_idx)
+			break;
+
+		cur->nr = 0;
+		index = zram_wb_collect(zram, cur, index, nr_pages, nr, mode);
+
+		/* give back the blocks the batch didn't fill */
+		for (i = cur->nr; i < nr; i++)
+			free_block_bdev(zram, cur->blk_idx + i);
+
+		if (cur->nr)
+			zram_wb_submit(zram, cur);
+
+		if (inflight)
+			zram_wb_complete(zram, inflight);
+
+		inflight = cur->nr ? cur : NULL;
+		cur = (cur == &reqs[0]) ? &reqs[1] : &reqs[0];
+	}
+
+	if (inflight)
+		zram_wb_complete(zram, inflight);
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
+	zram_wb_free_reqs(reqs, 2);
 	ret = len;
-	__free_page(page);
 release_init_lock:
 	up_read(&zram->init_lock);
 
@@ -856,6 +1158,12 @@ static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 }
 
 static void free_block_bdev(struct zram *zram, unsigned long blk_idx) {};
+static inline bool zram_ra_read(struct zram *zram, unsigned long blk_idx,
+			struct page *page)
+{
+	return false;
+}
+static inline void zram_ra_start(struct zram *zram, unsigned long blk_idx) {};
 #endif
 
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
@@ -1028,56 +1336,102 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
-static ssize_t use_dedup_show(struct device *dev,
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static ssize_t recomp_algorithm_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	bool val;
+	size_t sz;
 	struct zram *zram = dev_to_zram(dev);
 
 	down_read(&zram->init_lock);
-	val = zram->use_dedup;
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
 	up_read(&zram->init_lock);
 
-	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+	return sz;
 }
 
-#ifdef CONFIG_ZRAM_DEDUP
-static ssize_t use_dedup_store(struct device *dev,
+static ssize_t recomp_algorithm_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
-	int val;
 	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_algorithm)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
 
-	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+	/* an empty string disables recompression */
+	if (compressor[0] && !zcomp_available_algorithm(compressor))
 		return -EINVAL;
 
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
 		up_write(&zram->init_lock);
-		pr_info("Can't change dedup usage for initialized device\n");
+		pr_info("Can't change algorithm for initialized device\n");
 		return -EBUSY;
 	}
-	zram->use_dedup = val;
+
+	strcpy(zram->recomp_algorithm, compressor);
 	up_write(&zram->init_lock);
 	return len;
 }
 #endif
 
-static ssize_t compact_store(struct device *dev,
-		struct device_attribute *attr, const char *buf, size_t len)
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
 {
+	int val;
 	struct zram *zram = dev_to_zram(dev);
 
 	down_read(&zram->init_lock);
-	if (!init_done(zram)) {
-		up_read(&zram->init_lock);
-		return -EINVAL;
-	}
-
-	zs_compact(zram->mem_pool);
+	val = zram->use_dedup ? 1 + zram->dedup_adaptive : 0;
 	up_read(&zram->init_lock);
 
-	return len;
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	/* 2 selects adaptive dedup */
+	if (kstrtoint(buf, 10, &val) || val < 0 || val > 2)
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	zram->dedup_adaptive = val == 2;
+	up_write(&zram->init_lock);
+	return len;
+}
+#endif
+
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	zs_compact(zram->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
 }
 
 static ssize_t io_stat_show(struct device *dev,
@@ -1119,7 +1473,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -1129,7 +1483,11 @@ static ssize_t mm_stat_show(struct device *dev,
 			pool_stats.pages_compacted,
 			zram_dedup_dup_size(zram),
 			zram_dedup_meta_size(zram),
-			(u64)atomic64_read(&zram->stats.huge_pages));
+			(u64)atomic64_read(&zram->stats.huge_pages),
+			(u64)atomic64_read(&zram->stats.dedup_hits),
+			(u64)atomic64_read(&zram->stats.dedup_misses),
+			div_u64(atomic64_read(&zram->stats.dedup_time),
+				NSEC_PER_USEC));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1145,10 +1503,47 @@ static ssize_t bd_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-		"%8llu %8llu %8llu\n",
+		"%8llu %8llu %8llu %8llu %8llu\n",
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_count)),
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_reads)),
-			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)));
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_ra_reads)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_ra_hits)));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
+static ssize_t batch_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret = 0;
+	int i;
+
+	down_read(&zram->init_lock);
+	for (i = 0; i < ZRAM_BATCH_HIST; i++)
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "%8llu ",
+			(u64)atomic64_read(&zram->stats.batch_hist[i]));
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "\n");
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static ssize_t recomp_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+		"%8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.num_recompressed),
+			(u64)atomic64_read(&zram->stats.recomp_saved_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1178,6 +1573,10 @@ static DEVICE_ATTR_RO(mm_stat);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RO(bd_stat);
 #endif
+static DEVICE_ATTR_RO(batch_stat);
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static DEVICE_ATTR_RO(recomp_stat);
+#endif
 static DEVICE_ATTR_RO(debug_stat);
 
 static unsigned long zram_entry_handle(struct zram *zram,
@@ -1286,6 +1685,9 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (zram_test_flag(zram, index, ZRAM_IDLE))
 		zram_clear_flag(zram, index, ZRAM_IDLE);
 
+	zram_clear_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+	zram_clear_flag(zram, index, ZRAM_COMP_PRIORITY);
+
 	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
 		zram_clear_flag(zram, index, ZRAM_HUGE);
 		atomic64_dec(&zram->stats.huge_pages);
@@ -1336,15 +1738,20 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		zram_accessed(zram, index);
 	if (zram_test_flag(zram, index, ZRAM_WB)) {
 		struct bio_vec bvec;
+		unsigned long blk_idx = zram_get_element(zram, index);
 
 		zram_slot_unlock(zram, index);
 
+		if (zram_ra_read(zram, blk_idx, page))
+			return 0;
+
 		bvec.bv_page = page;
 		bvec.bv_len = PAGE_SIZE;
 		bvec.bv_offset = 0;
-		return read_from_bdev(zram, &bvec,
-				zram_get_element(zram, index),
-				bio, partial_io);
+		ret = read_from_bdev(zram, &bvec, blk_idx, bio, partial_io);
+		if (ret >= 0)
+			zram_ra_start(zram, blk_idx);
+		return ret;
 	}
 
 	entry = zram_get_entry(zram, index);
@@ -1370,12 +1777,13 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram_slot_comp(zram, index);
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
 
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, zram_entry_handle(zram, entry));
 	zram_slot_unlock(zram, index);
@@ -1420,6 +1828,35 @@ out:
 	return ret;
 }
 
+/*
+ * Free memory associated with this sector before overwriting unused
+ * sectors, then point the slot at the new data.
+ */
+static void zram_install_slot(struct zram *zram, u32 index,
+			struct zram_entry *entry, unsigned int comp_len,
+			enum zram_pageflags flags, unsigned long element)
+{
+	zram_slot_lock(zram, index);
+	zram_free_page(zram, index);
+
+	if (comp_len == PAGE_SIZE) {
+		zram_set_flag(zram, index, ZRAM_HUGE);
+		atomic64_inc(&zram->stats.huge_pages);
+	}
+
+	if (flags) {
+		zram_set_flag(zram, index, flags);
+		zram_set_element(zram, index, element);
+	}  else {
+		zram_set_entry(zram, index, entry);
+		zram_set_obj_size(zram, index, comp_len);
+	}
+	zram_slot_unlock(zram, index);
+
+	/* Update stats */
+	atomic64_inc(&zram->stats.pages_stored);
+}
+
 static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 				u32 index, struct bio *bio)
 {
@@ -1430,7 +1867,7 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	void *src, *dst, *mem;
 	struct zcomp_strm *zstrm;
 	struct page *page = bvec->bv_page;
-	u32 checksum;
+	u32 checksum = 0;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
 
@@ -1521,29 +1958,221 @@ compress_again:
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
 	zram_dedup_insert(zram, entry, checksum);
 out:
+	zram_install_slot(zram, index, entry, comp_len, flags, element);
+	return ret;
+}
+
+/*
+ * Install the first @done pages of a batch in ascending slot order. A NULL
+ * entry stands for a same filled page. On error nothing is installed and
+ * the entries are freed.
+ */
+static int zram_install_batch(struct zram *zram, u32 index, int done,
+			      struct zram_entry **entries, unsigned int *lens,
+			      unsigned long *elements)
+{
+	unsigned long alloced_pages;
+	int i;
+
+	alloced_pages = zs_get_total_pages(zram->mem_pool);
+	update_used_max(zram, alloced_pages);
+
+	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
+		for (i = 0; i < done; i++)
+			if (entries[i])
+				zram_entry_free(zram, entries[i]);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < done; i++) {
+		if (entries[i]) {
+			atomic64_add(lens[i], &zram->stats.compr_data_size);
+			zram_install_slot(zram, index + i, entries[i],
+					  lens[i], 0, 0);
+		} else {
+			atomic64_inc(&zram->stats.same_pages);
+			zram_install_slot(zram, index + i, NULL, 0,
+					  ZRAM_SAME, elements[i]);
+		}
+	}
+	atomic64_inc(&zram->stats.batch_hist[ilog2(done)]);
+
+	return done;
+}
+
+/*
+ * zram_write_batch() through an asynchronous compression engine. The pages
+ * that aren't same filled are all queued on the engine and waited for
+ * together. Only the batch mutex is held meanwhile, so entries may be
+ * allocated with direct reclaim and no page is ever compressed twice.
+ */
+static int zram_write_batch_async(struct zram *zram, struct zcomp_batch *batch,
+				  struct page **pages, u32 index, int nr)
+{
+	struct zram_entry *entries[ZRAM_BATCH_PAGES] = { NULL };
+	unsigned long elements[ZRAM_BATCH_PAGES];
+	unsigned int lens[ZRAM_BATCH_PAGES];
+	struct page *comp_pages[ZRAM_BATCH_PAGES];
+	u8 slot[ZRAM_BATCH_PAGES];
+	int i, j, n = 0, ret = 0;
+	void *src, *dst;
+
+	BUILD_BUG_ON(ZRAM_BATCH_PAGES > ZCOMP_BATCH_MAX);
+
+	for (i = 0; i < nr; i++) {
+		src = kmap_atomic(pages[i]);
+		if (!page_same_filled(src, &elements[i])) {
+			comp_pages[n] = pages[i];
+			slot[n++] = i;
+		}
+		kunmap_atomic(src);
+	}
+
+	if (n)
+		zcomp_compress_batch(batch, comp_pages, n);
+
+	for (j = 0; j < n; j++) {
+		struct zcomp_batch_req *r = &batch->reqs[j];
+		unsigned int comp_len = r->len;
+
+		i = slot[j];
+		if (unlikely(r->err)) {
+			pr_err("Compression failed! err=%d\n", r->err);
+			ret = r->err;
+			break;
+		}
+
+		if (comp_len >= huge_class_size)
+			comp_len = PAGE_SIZE;
+
+		entries[i] = zram_entry_alloc(zram, comp_len,
+				GFP_NOIO | __GFP_HIGHMEM |
+				__GFP_MOVABLE | __GFP_CMA);
+		if (!entries[i]) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		dst = zs_map_object(zram->mem_pool,
+				    zram_entry_handle(zram, entries[i]),
+				    ZS_MM_WO);
+		if (comp_len == PAGE_SIZE) {
+			src = kmap_atomic(pages[i]);
+			memcpy(dst, src, PAGE_SIZE);
+			kunmap_atomic(src);
+		} else {
+			memcpy(dst, r->buffer, comp_len);
+		}
+		zs_unmap_object(zram->mem_pool,
+				zram_entry_handle(zram, entries[i]));
+		lens[i] = comp_len;
+	}
+	zcomp_batch_put(batch);
+
+	if (unlikely(ret)) {
+		for (i = 0; i < nr; i++)
+			if (entries[i])
+				zram_entry_free(zram, entries[i]);
+		return ret;
+	}
+
+	return zram_install_batch(zram, index, nr, entries, lens, elements);
+}
+
+/*
+ * Compress a run of full pages starting at @index back to back with a
+ * single per-cpu stream, then install them in ascending slot order.
+ * Returns the number of pages written, which may be less than @nr if the
+ * non-blocking allocation failed part way, or a negative error.
+ */
+static int zram_write_batch(struct zram *zram, struct page **pages,
+				u32 index, int nr, struct bio *bio)
+{
+	struct zram_entry *entries[ZRAM_BATCH_PAGES];
+	unsigned long elements[ZRAM_BATCH_PAGES];
+	unsigned int lens[ZRAM_BATCH_PAGES];
+	struct zcomp_batch *batch;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int i, done, ret = 0;
+
+	batch = zcomp_batch_get(zram->comp);
+	if (batch)
+		return zram_write_batch_async(zram, batch, pages, index, nr);
+
+	zstrm = zcomp_stream_get(zram->comp);
+	for (i = 0; i < nr; i++) {
+		unsigned int comp_len;
+
+		entries[i] = NULL;
+		lens[i] = 0;
+		src = kmap_atomic(pages[i]);
+		if (page_same_filled(src, &elements[i])) {
+			kunmap_atomic(src);
+			continue;
+		}
+
+		ret = zcomp_compress(zstrm, src, &comp_len);
+		kunmap_atomic(src);
+		if (unlikely(ret)) {
+			pr_err("Compression failed! err=%d\n", ret);
+			break;
+		}
+
+		if (comp_len >= huge_class_size)
+			comp_len = PAGE_SIZE;
+
+		/* The stream is held, so only the fast path is allowed here */
+		entries[i] = zram_entry_alloc(zram, comp_len,
+				__GFP_KSWAPD_RECLAIM |
+				__GFP_NOWARN |
+				__GFP_HIGHMEM |
+				__GFP_MOVABLE |
+				__GFP_CMA);
+		if (!entries[i])
+			break;
+
+		dst = zs_map_object(zram->mem_pool,
+				    zram_entry_handle(zram, entries[i]),
+				    ZS_MM_WO);
+		if (comp_len == PAGE_SIZE) {
+			src = kmap_atomic(pages[i]);
+			memcpy(dst, src, PAGE_SIZE);
+			kunmap_atomic(src);
+		} else {
+			memcpy(dst, zstrm->buffer, comp_len);
+		}
+		zs_unmap_object(zram->mem_pool,
+				zram_entry_handle(zram, entries[i]));
+		lens[i] = comp_len;
+	}
+	zcomp_stream_put(zram->comp);
+	done = i;
+
+	if (unlikely(ret))
+		goto free_entries;
+
 	/*
-	 * Free memory associated with this sector
-	 * before overwriting unused sectors.
+	 * Nothing could be allocated without blocking: write the first page
+	 * on its own so it goes through the slow path of __zram_bvec_write.
 	 */
-	zram_slot_lock(zram, index);
-	zram_free_page(zram, index);
+	if (!done) {
+		struct bio_vec bvec = {
+			.bv_page = pages[0],
+			.bv_len = PAGE_SIZE,
+			.bv_offset = 0,
+		};
 
-	if (comp_len == PAGE_SIZE) {
-		zram_set_flag(zram, index, ZRAM_HUGE);
-		atomic64_inc(&zram->stats.huge_pages);
+		ret = __zram_bvec_write(zram, &bvec, index, bio);
+		return ret ? ret : 1;
 	}
 
-	if (flags) {
-		zram_set_flag(zram, index, flags);
-		zram_set_element(zram, index, element);
-	}  else {
-		zram_set_entry(zram, index, entry);
-		zram_set_obj_size(zram, index, comp_len);
-	}
-	zram_slot_unlock(zram, index);
+	return zram_install_batch(zram, index, done, entries, lens, elements);
 
-	/* Update stats */
-	atomic64_inc(&zram->stats.pages_stored);
+free_entries:
+	for (i = 0; i < done; i++)
+		if (entries[i])
+			zram_entry_free(zram, entries[i]);
 	return ret;
 }
 
@@ -1588,6 +2217,193 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_MULTI_COMP
+#define HUGE_RECOMPRESS 1
+#define IDLE_RECOMPRESS 2
+
+/*
+ * Re-encode a slot with the secondary algorithm. Caller holds the slot
+ * lock; @page is scratch space for the decompressed data. The slot is
+ * only replaced if the secondary algorithm actually shrinks it, otherwise
+ * it is marked ZRAM_INCOMPRESSIBLE so later passes skip it.
+ */
+static int zram_recompress_slot(struct zram *zram, u32 index,
+				struct page *page)
+{
+	struct zram_entry *entry, *new_entry;
+	unsigned int size, comp_len;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	bool idle;
+	int ret = 0;
+
+	entry = zram_get_entry(zram, index);
+	size = zram_get_obj_size(zram, index);
+
+	src = zs_map_object(zram->mem_pool,
+			    zram_entry_handle(zram, entry), ZS_MM_RO);
+	dst = kmap_atomic(page);
+	if (size == PAGE_SIZE) {
+		memcpy(dst, src, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		ret = zcomp_decompress(zstrm, src, size, dst);
+		zcomp_stream_put(zram->comp);
+	}
+	kunmap_atomic(dst);
+	zs_unmap_object(zram->mem_pool, zram_entry_handle(zram, entry));
+	if (unlikely(ret)) {
+		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
+		return ret;
+	}
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len);
+	kunmap_atomic(src);
+	if (unlikely(ret)) {
+		zcomp_stream_put(zram->recomp);
+		pr_err("Recompression failed! err=%d\n", ret);
+		return ret;
+	}
+
+	if (comp_len >= size || comp_len >= huge_class_size) {
+		zcomp_stream_put(zram->recomp);
+		zram_set_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+		return 0;
+	}
+
+	/* We hold the slot lock and a per-cpu stream, so we can't sleep */
+	new_entry = zram_entry_alloc(zram, comp_len,
+				__GFP_KSWAPD_RECLAIM |
+				__GFP_NOWARN |
+				__GFP_HIGHMEM |
+				__GFP_MOVABLE |
+				__GFP_CMA);
+	if (!new_entry) {
+		zcomp_stream_put(zram->recomp);
+		return -ENOMEM;
+	}
+
+	dst = zs_map_object(zram->mem_pool,
+			    zram_entry_handle(zram, new_entry), ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len);
+	zcomp_stream_put(zram->recomp);
+	zs_unmap_object(zram->mem_pool, zram_entry_handle(zram, new_entry));
+
+	idle = zram_test_flag(zram, index, ZRAM_IDLE);
+	zram_free_page(zram, index);
+	zram_set_entry(zram, index, new_entry);
+	zram_set_obj_size(zram, index, comp_len);
+	zram_set_flag(zram, index, ZRAM_COMP_PRIORITY);
+	/* keep the page visible to a following idle writeback */
+	if (idle)
+		zram_set_flag(zram, index, ZRAM_IDLE);
+
+	atomic64_add(comp_len, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+	atomic64_inc(&zram->stats.num_recompressed);
+	atomic64_add(size - comp_len, &zram->stats.recomp_saved_size);
+
+	return 0;
+}
+
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+	struct page *page;
+	ssize_t ret, sz;
+	char mode_buf[8];
+	int mode = -1;
+	int err;
+
+	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
+	if (sz <= 0)
+		return -EINVAL;
+
+	/* ignore trailing newline */
+	if (mode_buf[sz - 1] == '\n')
+		mode_buf[sz - 1] = 0x00;
+
+	if (!strcmp(mode_buf, "idle"))
+		mode = IDLE_RECOMPRESS;
+	else if (!strcmp(mode_buf, "huge"))
+		mode = HUGE_RECOMPRESS;
+
+	if (mode == -1)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->recomp) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	/*
+	 * Dedup entries are shared between slots and matched against new
+	 * pages with the primary algorithm, so they can't be re-encoded
+	 * behind the back of the other owners.
+	 */
+	if (zram_dedup_enabled(zram)) {
+		ret = -EOPNOTSUPP;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	ret = len;
+	for (index = 0; index < nr_pages; index++) {
+		err = 0;
+
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index))
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_WB) ||
+				zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE) ||
+				zram_test_flag(zram, index, ZRAM_COMP_PRIORITY))
+			goto next;
+
+		if (mode == IDLE_RECOMPRESS &&
+			  !zram_test_flag(zram, index, ZRAM_IDLE))
+			goto next;
+		if (mode == HUGE_RECOMPRESS &&
+			  !zram_test_flag(zram, index, ZRAM_HUGE))
+			goto next;
+
+		err = zram_recompress_slot(zram, index, page);
+next:
+		zram_slot_unlock(zram, index);
+		if (err == -ENOMEM) {
+			ret = err;
+			break;
+		}
+
+		cond_resched();
+	}
+
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -1631,12 +2447,16 @@ static void zram_bio_discard(struct zram *zram, u32 index,
  * Returns 0 if IO request was done synchronously
  * Returns 1 if IO request was successfully submitted.
  */
+static DEFINE_LAT_HIST(zram_read_hist, "zram_read");
+static DEFINE_LAT_HIST(zram_write_hist, "zram_write");
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, bool is_write, struct bio *bio)
 {
 	unsigned long start_time = jiffies;
 	int rw_acct = is_write ? REQ_OP_WRITE : REQ_OP_READ;
 	struct request_queue *q = zram->disk->queue;
+	u64 lat_start = lat_hist_start();
 	int ret;
 
 	generic_start_io_acct(q, rw_acct, bvec->bv_len >> SECTOR_SHIFT,
@@ -1652,6 +2472,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	}
 
 	generic_end_io_acct(q, rw_acct, &zram->disk->part0, start_time);
+	lat_hist_end(is_write ? &zram_write_hist : &zram_read_hist, lat_start);
 
 	if (unlikely(ret < 0)) {
 		if (!is_write)
@@ -1663,12 +2484,45 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+static int zram_bvec_write_batch(struct zram *zram, struct page **pages,
+				u32 index, int nr, struct bio *bio)
+{
+	unsigned long start_time = jiffies;
+	struct request_queue *q = zram->disk->queue;
+	int ret = 0;
+
+	generic_start_io_acct(q, REQ_OP_WRITE, nr << SECTORS_PER_PAGE_SHIFT,
+			&zram->disk->part0);
+	atomic64_add(nr, &zram->stats.num_writes);
+
+	while (nr) {
+		ret = zram_write_batch(zram, pages, index, nr, bio);
+		if (unlikely(ret < 0)) {
+			atomic64_inc(&zram->stats.failed_writes);
+			break;
+		}
+
+		pages += ret;
+		index += ret;
+		nr -= ret;
+		ret = 0;
+	}
+
+	generic_end_io_acct(q, REQ_OP_WRITE, &zram->disk->part0, start_time);
+
+	return ret;
+}
+
 static void __zram_make_request(struct zram *zram, struct bio *bio)
 {
 	int offset;
 	u32 index;
 	struct bio_vec bvec;
 	struct bvec_iter iter;
+	struct page *batch[ZRAM_BATCH_PAGES];
+	int nr_batch = 0;
+	u32 batch_index = 0;
+	bool can_batch;
 
 	index = bio->bi_iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
 	offset = (bio->bi_iter.bi_sector &
@@ -1684,10 +2538,39 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 		break;
 	}
 
+	/*
+	 * Dedup lookups take the compression stream themselves, so batching
+	 * is only done for plain devices.
+	 */
+	can_batch = op_is_write(bio_op(bio)) && !zram_dedup_enabled(zram);
+
 	bio_for_each_segment(bvec, bio, iter) {
 		struct bio_vec bv = bvec;
 		unsigned int unwritten = bvec.bv_len;
 
+		if (can_batch && !offset && !bvec.bv_offset &&
+				bvec.bv_len == PAGE_SIZE) {
+			if (!nr_batch)
+				batch_index = index;
+			batch[nr_batch++] = bvec.bv_page;
+			index++;
+			if (nr_batch == ZRAM_BATCH_PAGES) {
+				if (zram_bvec_write_batch(zram, batch,
+						batch_index, nr_batch, bio) < 0)
+					goto out;
+				nr_batch = 0;
+			}
+			continue;
+		}
+
+		/* flush pending pages first to keep the writes in bio order */
+		if (nr_batch) {
+			if (zram_bvec_write_batch(zram, batch, batch_index,
+						  nr_batch, bio) < 0)
+				goto out;
+			nr_batch = 0;
+		}
+
 		do {
 			bv.bv_len = min_t(unsigned int, PAGE_SIZE - offset,
 							unwritten);
@@ -1702,6 +2585,10 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 		} while (unwritten);
 	}
 
+	if (nr_batch && zram_bvec_write_batch(zram, batch, batch_index,
+					      nr_batch, bio) < 0)
+		goto out;
+
 	bio_endio(bio);
 	return;
 
@@ -1801,6 +2688,9 @@ out:
 static void zram_reset_device(struct zram *zram)
 {
 	struct zcomp *comp;
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	struct zcomp *recomp;
+#endif
 	u64 disksize;
 
 	down_write(&zram->init_lock);
@@ -1813,6 +2703,10 @@ static void zram_reset_device(struct zram *zram)
 	}
 
 	comp = zram->comp;
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	recomp = zram->recomp;
+	zram->recomp = NULL;
+#endif
 	disksize = zram->disksize;
 	zram->disksize = 0;
 
@@ -1824,6 +2718,10 @@ static void zram_reset_device(struct zram *zram)
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (recomp)
+		zcomp_destroy(recomp);
+#endif
 	reset_bdev(zram);
 }
 
@@ -1860,6 +2758,21 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram->recomp_algorithm[0]) {
+		struct zcomp *recomp = zcomp_create(zram->recomp_algorithm);
+
+		if (IS_ERR(recomp)) {
+			pr_err("Cannot initialise %s recompressing backend\n",
+					zram->recomp_algorithm);
+			err = PTR_ERR(recomp);
+			zcomp_destroy(comp);
+			goto out_free_meta;
+		}
+		zram->recomp = recomp;
+	}
+#endif
+
 	zram->comp = comp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
@@ -1921,6 +2834,89 @@ static ssize_t reset_store(struct device *dev,
 	return len;
 }
 
+#ifdef CONFIG_ZRAM_BENCH
+/*
+ * Claim initialised device @dev_id for zram_bench.c like reset_store()
+ * does, so it can't be opened or reset while the benchmark uses it.
+ */
+struct zram *zram_bench_get(int dev_id)
+{
+	struct block_device *bdev;
+	struct zram *zram;
+	int ret = 0;
+
+	mutex_lock(&zram_index_mutex);
+	zram = idr_find(&zram_index_idr, dev_id);
+	if (!zram) {
+		mutex_unlock(&zram_index_mutex);
+		return ERR_PTR(-ENODEV);
+	}
+
+	bdev = bdget_disk(zram->disk, 0);
+	if (!bdev) {
+		mutex_unlock(&zram_index_mutex);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	mutex_lock(&bdev->bd_mutex);
+	if (bdev->bd_openers || zram->claim)
+		ret = -EBUSY;
+	else if (!init_done(zram))
+		ret = -ENXIO;
+	else
+		zram->claim = true;
+	mutex_unlock(&bdev->bd_mutex);
+	bdput(bdev);
+	mutex_unlock(&zram_index_mutex);
+
+	return ret ? ERR_PTR(ret) : zram;
+}
+
+void zram_bench_put(struct zram *zram)
+{
+	struct block_device *bdev = bdget_disk(zram->disk, 0);
+
+	if (bdev)
+		mutex_lock(&bdev->bd_mutex);
+	zram->claim = false;
+	if (bdev) {
+		mutex_unlock(&bdev->bd_mutex);
+		bdput(bdev);
+	}
+}
+
+unsigned long zram_bench_pages(struct zram *zram)
+{
+	return zram->disksize >> PAGE_SHIFT;
+}
+
+/* Threshold above which zram stores a page uncompressed */
+size_t zram_bench_huge_size(void)
+{
+	return huge_class_size ?: PAGE_SIZE;
+}
+
+/* Synchronous page I/O through the same path as a bio */
+int zram_bench_rw(struct zram *zram, struct page *page, u32 index,
+		  bool is_write)
+{
+	struct bio_vec bv = {
+		.bv_page = page,
+		.bv_len = PAGE_SIZE,
+		.bv_offset = 0,
+	};
+
+	return zram_bvec_rw(zram, &bv, index, 0, is_write, NULL);
+}
+
+void zram_bench_discard(struct zram *zram, u32 index)
+{
+	zram_slot_lock(zram, index);
+	zram_free_page(zram, index);
+	zram_slot_unlock(zram, index);
+}
+#endif
+
 static int zram_open(struct block_device *bdev, fmode_t mode)
 {
 	int ret = 0;
@@ -1952,6 +2948,10 @@ static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_WO(idle);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(recompress);
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
 static DEVICE_ATTR_WO(writeback);
@@ -1974,6 +2974,10 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_idle.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
 	&dev_attr_writeback.attr,
@@ -1985,6 +2989,10 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mm_stat.attr,
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_bd_stat.attr,
+#endif
+	&dev_attr_batch_stat.attr,
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	&dev_attr_recomp_stat.attr,
 #endif
 	&dev_attr_debug_stat.attr,
 	NULL,
@@ -2021,6 +3029,8 @@ static int zram_add(void)
 	init_rwsem(&zram->init_lock);
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
+	spin_lock_init(&zram->ra_lock);
+	init_completion(&zram->ra_done);
 #endif
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -2251,6 +3261,8 @@ static int __init zram_init(void)
 		num_devices--;
 	}
 
+	lat_hist_register(&zram_read_hist);
+	lat_hist_register(&zram_write_hist);
 	return 0;
 
 out_error:
@@ -2261,6 +3273,8 @@ out_error:
 static void __exit zram_exit(void)
 {
 	destroy_devices();
+	lat_hist_unregister(&zram_read_hist);
+	lat_hist_unregister(&zram_write_hist);
 }
 
 module_init(zram_init);
@@ -19,6 +19,7 @@
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
 #include <linux/spinlock.h>
+#include <linux/completion.h>
 
 #include "zcomp.h"
 #include "zram_dedup.h"
@@ -53,10 +54,38 @@ enum zram_pageflags {
 	ZRAM_UNDER_WB,	/* page is under writeback */
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
+	ZRAM_INCOMPRESSIBLE, /* secondary algorithm could not shrink the page */
+	ZRAM_COMP_PRIORITY, /* page is stored by the secondary algorithm */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
+/*
+ * Full pages of a write bio are compressed in runs of up to
+ * ZRAM_BATCH_PAGES with a single per-cpu stream, or queued together on an
+ * asynchronous engine; batch sizes are accounted in log2 buckets.
+ */
+#define ZRAM_BATCH_SHIFT	4
+#define ZRAM_BATCH_PAGES	(1 << ZRAM_BATCH_SHIFT)
+#define ZRAM_BATCH_HIST		(ZRAM_BATCH_SHIFT + 1)
+
+/*
+ * Writeback batches up to ZRAM_WB_BATCH slots into a single bio over
+ * contiguous backing blocks. A read fault on a written back slot reads
+ * up to ZRAM_RA_PAGES following blocks into a per-device buffer.
+ */
+#define ZRAM_WB_BATCH		32
+#define ZRAM_RA_PAGES		8
+
+/*
+ * Compression algorithm priorities. Pages are always written with the
+ * primary algorithm; the secondary one is only used to recompress idle
+ * or huge pages on request, and the per-slot ZRAM_COMP_PRIORITY flag
+ * records which of the two has to be used to decompress the slot.
+ */
+#define ZRAM_PRIMARY_COMP	0
+#define ZRAM_SECONDARY_COMP	1
+
 /*-- Data structures */
 
 struct zram_entry {
@@ -97,11 +126,21 @@ struct zram_stats {
 					 * duplicated
 					 */
 	atomic64_t meta_data_size;	/* size of zram_entries */
+	atomic64_t dedup_hits;		/* no. of dedup lookups that hit */
+	atomic64_t dedup_misses;	/* no. of dedup lookups that missed */
+	atomic64_t dedup_time;		/* ns spent in dedup lookups */
 	atomic64_t miss_free;		/* no. of missed free */
+	atomic64_t batch_hist[ZRAM_BATCH_HIST]; /* write batches by log2 size */
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	atomic64_t num_recompressed;	/* no. of recompressed pages */
+	atomic64_t recomp_saved_size;	/* bytes saved by recompression */
+#endif
 #ifdef	CONFIG_ZRAM_WRITEBACK
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
 	atomic64_t bd_writes;		/* no. of writes from backing device */
+	atomic64_t bd_ra_reads;		/* no. of blocks read ahead */
+	atomic64_t bd_ra_hits;		/* no. of reads served by readahead */
 #endif
 };
 
@@ -131,11 +170,20 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	/* Secondary (recompression) algorithm, disabled if empty */
+	struct zcomp *recomp;
+	char recomp_algorithm[CRYPTO_MAX_ALG_NAME];
+#endif
 	/*
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by bdev->bd_mutex */
 	bool use_dedup;
+	bool dedup_adaptive;
+	atomic_t dedup_window;		/* lookups in the sample window */
+	atomic_t dedup_window_hits;	/* hits in the sample window */
+	atomic_t dedup_skip;		/* writes left before lookups resume */
 	struct file *backing_dev;
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spinlock_t wb_limit_lock;
@@ -145,6 +193,16 @@ struct zram {
 	unsigned int old_block_size;
 	unsigned long *bitmap;
 	unsigned long nr_pages;
+	/* bdev readahead window, protected by ra_lock */
+	spinlock_t ra_lock;
+	unsigned long ra_start;		/* first block of the window */
+	unsigned int ra_nr;		/* valid blocks, 0 if empty */
+	unsigned int ra_pending;	/* blocks of the read in flight */
+	unsigned int ra_gen;		/* bumped when the window is stale */
+	unsigned int ra_issue_gen;
+	bool ra_busy;			/* read in flight */
+	struct completion ra_done;
+	struct page *ra_pages[ZRAM_RA_PAGES];
 #endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
@@ -161,4 +219,14 @@ static inline bool zram_dedup_enabled(struct zram *zram)
 }
 
 void zram_entry_free(struct zram *zram, struct zram_entry *entry);
+
+#ifdef CONFIG_ZRAM_BENCH
+struct zram *zram_bench_get(int dev_id);
+void zram_bench_put(struct zram *zram);
+unsigned long zram_bench_pages(struct zram *zram);
+size_t zram_bench_huge_size(void);
+int zram_bench_rw(struct zram *zram, struct page *page, u32 index,
+		  bool is_write);
+void zram_bench_discard(struct zram *zram, u32 index);
+#endif
 #endif
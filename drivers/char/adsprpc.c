@@ -15,6 +15,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
 #include <linux/completion.h>
+#include <linux/lat_hist.h>
 #include <linux/pagemap.h>
 #include <linux/mm.h>
 #include <linux/fs.h>
@@ -23,6 +24,7 @@
 #include <linux/cdev.h>
 #include <linux/list.h>
 #include <linux/hash.h>
+#include <linux/log2.h>
 #include <linux/msm_ion.h>
 #include <soc/qcom/secure_buffer.h>
 #include <linux/rpmsg.h>
@@ -61,7 +63,7 @@
 #define FASTRPC_ENOSUCH 39
 #define VMID_SSC_Q6     5
 #define VMID_ADSP_Q6    6
-#define DEBUGFS_SIZE 3072
+#define DEBUGFS_SIZE 6144
 #define UL_SIZE 25
 #define PID_SIZE 10
 
@@ -111,6 +113,10 @@
 #define INIT_FILELEN_MAX (2*1024*1024)
 #define INIT_MEMLEN_MAX  (8*1024*1024)
 #define MAX_CACHE_BUF_SIZE (8*1024*1024)
+#define MAX_MAP_CACHE_SIZE (64*1024*1024)
+#define MAX_POLL_TIMEOUT_US 5000
+#define FASTRPC_LAT_METHODS 32
+#define FASTRPC_LAT_BUCKETS 12
 
 #define PERF_END (void)0
 
@@ -337,6 +343,7 @@ struct fastrpc_mmap {
 	int uncached;
 	int secure;
 	uintptr_t attr;
+	struct list_head lru;
 };
 
 enum fastrpc_perfkeys {
@@ -372,6 +379,18 @@ struct fastrpc_file {
 	struct hlist_head maps;
 	struct hlist_head cached_bufs;
 	struct hlist_head remote_bufs;
+	/* unused SMMU mappings kept for later invokes, most recent first */
+	struct list_head map_cache;
+	size_t map_cache_size;
+	uint64_t map_cache_hits;
+	uint64_t map_cache_misses;
+	uint64_t map_cache_evictions;
+	/* time(in us) to poll for invoke responses, 0 to always sleep */
+	uint32_t poll_timeout;
+	uint64_t poll_hits;
+	uint64_t poll_misses;
+	/* invoke latency per method, bucket i ends at 16us << i */
+	uint32_t lat_hist[FASTRPC_LAT_METHODS][FASTRPC_LAT_BUCKETS];
 	struct fastrpc_ctx_lst clst;
 	struct fastrpc_session_ctx *sctx;
 	struct fastrpc_buf *init_mem;
@@ -461,6 +480,11 @@ static struct fastrpc_channel_ctx gcinfo[NUM_CHANNELS] = {
 static int hlosvm[1] = {VMID_HLOS};
 static int hlosvmperm[1] = {PERM_READ | PERM_WRITE | PERM_EXEC};
 
+static uint map_cache_max = MAX_MAP_CACHE_SIZE;
+module_param(map_cache_max, uint, 0644);
+MODULE_PARM_DESC(map_cache_max,
+	"Max bytes of unused buffer mappings cached per client, 0 disables");
+
 static inline void fastrpc_pm_awake(struct fastrpc_file *fl, int channel_type);
 
 static inline int64_t getnstimediff(struct timespec64 *start)
@@ -725,6 +749,8 @@ static int fastrpc_mmap_remove(struct fastrpc_file *fl, uintptr_t va,
 	return -ENOTTY;
 }
 
+static bool fastrpc_map_cache_add(struct fastrpc_mmap *map);
+
 static void fastrpc_mmap_free(struct fastrpc_mmap *map, uint32_t flags)
 {
 	struct fastrpc_apps *me = &gfa;
@@ -761,6 +787,8 @@ static void fastrpc_mmap_free(struct fastrpc_mmap *map, uint32_t flags)
 			hlist_del_init(&map->hn);
 		if (map->refs > 0 && !flags)
 			return;
+		if (!map->refs && !flags && fastrpc_map_cache_add(map))
+			return;
 	}
 	if (map->flags == ADSP_MMAP_HEAP_ADDR ||
 				map->flags == ADSP_MMAP_REMOTE_HEAP_ADDR) {
@@ -809,6 +837,95 @@ static void fastrpc_mmap_free(struct fastrpc_mmap *map, uint32_t flags)
 	kfree(map);
 }
 
+static void fastrpc_map_cache_evict(struct fastrpc_mmap *map)
+{
+	struct fastrpc_file *fl = map->fl;
+
+	list_del_init(&map->lru);
+	fl->map_cache_size -= map->size;
+	/* cached maps hold no refs, give it back the one being dropped */
+	map->refs = 1;
+	fastrpc_mmap_free(map, 1);
+}
+
+static void fastrpc_map_cache_free(struct fastrpc_file *fl)
+{
+	struct fastrpc_mmap *map, *n;
+
+	list_for_each_entry_safe(map, n, &fl->map_cache, lru)
+		fastrpc_map_cache_evict(map);
+}
+
+/*
+ * Park a regular buffer mapping whose last ref is gone, so the next invoke
+ * with the same dma-buf skips the attach, SMMU map and hyp assign
+ */
+static bool fastrpc_map_cache_add(struct fastrpc_mmap *map)
+{
+	struct fastrpc_file *fl = map->fl;
+	struct fastrpc_mmap *victim, *n;
+
+	if (!fl || fl->file_close || map->flags || map->raddr ||
+		(map->attr & FASTRPC_ATTR_KEEP_MAP) ||
+		IS_ERR_OR_NULL(map->table) || map->size > map_cache_max)
+		return false;
+
+	/* the cache holds the last ref of buffers the client has freed */
+	list_for_each_entry_safe(victim, n, &fl->map_cache, lru) {
+		if (file_count(victim->buf->file) == 1)
+			fastrpc_map_cache_evict(victim);
+	}
+
+	while (fl->map_cache_size + map->size > map_cache_max &&
+		!list_empty(&fl->map_cache)) {
+		victim = list_last_entry(&fl->map_cache, struct fastrpc_mmap,
+			lru);
+		fastrpc_map_cache_evict(victim);
+		fl->map_cache_evictions++;
+	}
+
+	list_add(&map->lru, &fl->map_cache);
+	fl->map_cache_size += map->size;
+	return true;
+}
+
+static int fastrpc_map_cache_find(struct fastrpc_file *fl, int fd,
+	unsigned int attr, uintptr_t va, size_t len,
+	struct fastrpc_mmap **ppmap)
+{
+	struct fastrpc_mmap *match = NULL, *map;
+	struct dma_buf *buf;
+
+	if (!list_empty(&fl->map_cache)) {
+		buf = dma_buf_get(fd);
+		if (IS_ERR_OR_NULL(buf))
+			return -ENOTTY;
+		list_for_each_entry(map, &fl->map_cache, lru) {
+			if (map->buf == buf && map->attr == attr &&
+				len <= map->size) {
+				match = map;
+				break;
+			}
+		}
+		dma_buf_put(buf);
+	}
+	if (!match) {
+		fl->map_cache_misses++;
+		return -ENOTTY;
+	}
+
+	list_del_init(&match->lru);
+	fl->map_cache_size -= match->size;
+	fl->map_cache_hits++;
+	match->fd = fd;
+	match->va = va;
+	match->len = len;
+	match->refs = 1;
+	fastrpc_mmap_add(match);
+	*ppmap = match;
+	return 0;
+}
+
 static int fastrpc_session_alloc(struct fastrpc_channel_ctx *chan, int secure,
 					struct fastrpc_session_ctx **session);
 
@@ -836,11 +953,14 @@ static int fastrpc_mmap_create(struct fastrpc_file *fl, int fd,
 	chan = &apps->channel[cid];
 	if (!fastrpc_mmap_find(fl, fd, va, len, mflags, 1, ppmap))
 		return 0;
+	if (!mflags && !fastrpc_map_cache_find(fl, fd, attr, va, len, ppmap))
+		return 0;
 	map = kzalloc(sizeof(*map), GFP_KERNEL);
 	VERIFY(err, !IS_ERR_OR_NULL(map));
 	if (err)
 		goto bail;
 	INIT_HLIST_NODE(&map->hn);
+	INIT_LIST_HEAD(&map->lru);
 	map->flags = mflags;
 	map->refs = 1;
 	map->fl = fl;
@@ -1000,7 +1120,7 @@ static int fastrpc_mmap_create(struct fastrpc_file *fl, int fd,
 
 bail:
 	if (err && map)
-		fastrpc_mmap_free(map, 0);
+		fastrpc_mmap_free(map, 1);
 	return err;
 }
 
@@ -1942,6 +2062,60 @@ static inline void fastrpc_pm_awake(struct fastrpc_file *fl, int channel_type)
 	pm_wakeup_ws_event(wake_source, fl->ws_timeout, true);
 }
 
+/*
+ * Short DSP calls finish in less time than it takes to sleep and wake up,
+ * spin on the response first if the client asked for it
+ */
+static bool fastrpc_poll_response(struct smq_invoke_ctx *ctx)
+{
+	struct fastrpc_file *fl = ctx->fl;
+	ktime_t end;
+	bool done = false;
+
+	if (!fl->poll_timeout)
+		return false;
+
+	end = ktime_add_us(ktime_get(), fl->poll_timeout);
+	do {
+		if (try_wait_for_completion(&ctx->work)) {
+			done = true;
+			break;
+		}
+		if (need_resched() || signal_pending(current))
+			break;
+		cpu_relax();
+	} while (ktime_before(ktime_get(), end));
+
+	spin_lock(&fl->hlock);
+	if (done)
+		fl->poll_hits++;
+	else
+		fl->poll_misses++;
+	spin_unlock(&fl->hlock);
+
+	return done;
+}
+
+/* successful invocations of all processes, in lat_hist/fastrpc_invoke */
+static DEFINE_LAT_HIST(fastrpc_invoke_hist, "fastrpc_invoke");
+
+static void fastrpc_update_lat_hist(struct fastrpc_file *fl, uint32_t sc,
+				    ktime_t start)
+{
+	ktime_t now = ktime_get();
+	int64_t us = ktime_us_delta(now, start);
+	int bucket = 0;
+
+	lat_hist_add(&fastrpc_invoke_hist, ktime_to_ns(ktime_sub(now, start)));
+
+	if (us >= 16)
+		bucket = min_t(int, ilog2(us) - 3, FASTRPC_LAT_BUCKETS - 1);
+
+	spin_lock(&fl->hlock);
+	fl->lat_hist[REMOTE_SCALARS_METHOD(sc)][bucket]++;
+	spin_unlock(&fl->hlock);
+}
+
 static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 				   uint32_t kernel,
 				   struct fastrpc_ioctl_invoke_crc *inv)
@@ -1951,6 +2125,7 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 	int err = 0, cid = -1, interrupted = 0;
 	struct timespec64 invoket = {0};
 	int64_t *perf_counter = NULL;
+	ktime_t start = ktime_get();
 
 	cid = fl->cid;
 	VERIFY(err, cid >= ADSP_DOMAIN_ID && cid < NUM_CHANNELS);
@@ -2014,10 +2189,13 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 	if (err)
 		goto bail;
  wait:
-	if (kernel)
-		wait_for_completion(&ctx->work);
-	else
-		interrupted = wait_for_completion_interruptible(&ctx->work);
+	if (!fastrpc_poll_response(ctx)) {
+		if (kernel)
+			wait_for_completion(&ctx->work);
+		else
+			interrupted = wait_for_completion_interruptible(
+								&ctx->work);
+	}
 
 	VERIFY(err, 0 == (err = interrupted));
 	if (err)
@@ -2045,6 +2223,9 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 	if (fl->ssrcount != fl->apps->channel[cid].ssrcount)
 		err = ECONNRESET;
 
+	if (!err && !interrupted)
+		fastrpc_update_lat_hist(fl, invoke->sc, start);
+
 	if (fl->profile && !interrupted) {
 		if (invoke->handle != FASTRPC_STATIC_HANDLE_LISTENER) {
 			int64_t *count = GET_COUNTER(perf_counter, PERF_INVOKE);
@@ -3035,6 +3216,7 @@ static int fastrpc_file_free(struct fastrpc_file *fl)
 		}
 		fastrpc_mmap_free(lmap, 1);
 	} while (lmap);
+	fastrpc_map_cache_free(fl);
 	mutex_unlock(&fl->map_mutex);
 
 	if (fl->sctx)
@@ -3204,6 +3386,24 @@ static ssize_t fastrpc_debugfs_read(struct file *filp, char __user *buffer,
 		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
 			"%s %5s %d\n", "smmu.faults", ":",
 			fl->sctx->smmu.faults);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %2s %zu\n", "map_cache.size", ":",
+			fl->map_cache_size);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %2s %llu\n", "map_cache.hits", ":",
+			fl->map_cache_hits);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %1s %llu\n", "map_cache.misses", ":",
+			fl->map_cache_misses);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %s %llu\n", "map_cache.evictions", ":",
+			fl->map_cache_evictions);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %4s %u\n", "poll_timeout", ":", fl->poll_timeout);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %7s %llu\n", "poll_hits", ":", fl->poll_hits);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %5s %llu\n", "poll_misses", ":", fl->poll_misses);
 
 		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
 			"\n=======%s %s %s======\n", title,
@@ -3294,6 +3494,32 @@ static ssize_t fastrpc_debugfs_read(struct file *filp, char __user *buffer,
 			ictx->sc, ictx->pid, ictx->tgid,
 			ictx->used, ictx->ctxid);
 		}
+
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"\n%s %s %s\n", title,
+			" INVOKE LATENCY (us) ", title);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%-6s", "method");
+		for (j = 0; j < FASTRPC_LAT_BUCKETS - 1; j++)
+			len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+				"|<%-6d", 16 << j);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"|>=%-5d\n", 16 << (j - 1));
+		for (i = 0; i < FASTRPC_LAT_METHODS; i++) {
+			for (j = 0; j < FASTRPC_LAT_BUCKETS; j++)
+				if (fl->lat_hist[i][j])
+					break;
+			if (j == FASTRPC_LAT_BUCKETS)
+				continue;
+			len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+				"%-6d", i);
+			for (j = 0; j < FASTRPC_LAT_BUCKETS; j++)
+				len += scnprintf(fileinfo + len,
+					DEBUGFS_SIZE - len, "|%-7u",
+					fl->lat_hist[i][j]);
+			len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+				"\n");
+		}
 		spin_unlock(&fl->hlock);
 	}
 	if (len > DEBUGFS_SIZE)
@@ -3409,6 +3635,7 @@ static int fastrpc_device_open(struct inode *inode, struct file *filp)
 	INIT_HLIST_HEAD(&fl->perf);
 	INIT_HLIST_HEAD(&fl->cached_bufs);
 	INIT_HLIST_HEAD(&fl->remote_bufs);
+	INIT_LIST_HEAD(&fl->map_cache);
 	INIT_HLIST_NODE(&fl->hn);
 	fl->sessionid = 0;
 	fl->apps = me;
@@ -3557,6 +3784,14 @@ static int fastrpc_internal_control(struct fastrpc_file *fl,
 			fl->ws_timeout = cp->pm.timeout;
 		fastrpc_pm_awake(fl, gcinfo[fl->cid].secure);
 			break;
+	case FASTRPC_CONTROL_POLL:
+		if (!cp->poll.enable)
+			fl->poll_timeout = 0;
+		else if (cp->poll.timeout > MAX_POLL_TIMEOUT_US)
+			fl->poll_timeout = MAX_POLL_TIMEOUT_US;
+		else
+			fl->poll_timeout = cp->poll.timeout;
+		break;
 	default:
 		err = -EBADRQC;
 		break;
@@ -4567,6 +4802,7 @@ static int __init fastrpc_device_init(void)
 		goto device_create_bail;
 	}
 	me->rpmsg_register = 1;
+	lat_hist_register(&fastrpc_invoke_hist);
 
 	return 0;
 device_create_bail:
@@ -4597,6 +4833,7 @@ static void __exit fastrpc_device_exit(void)
 	struct fastrpc_apps *me = &gfa;
 	int i;
 
+	lat_hist_unregister(&fastrpc_invoke_hist);
 	fastrpc_file_list_dtor(me);
 	fastrpc_deinit();
 	for (i = 0; i < NUM_CHANNELS; i++) {
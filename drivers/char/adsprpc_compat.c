@@ -145,6 +145,11 @@ struct compat_fastrpc_ctrl_pm {
 	compat_uint_t timeout; /* timeout(in ms) for PM to keep system awake */
 };
 
+struct compat_fastrpc_ctrl_poll {
+	compat_uint_t enable; /* poll for invoke responses */
+	compat_uint_t timeout; /* time(in us) to poll before sleeping */
+};
+
 
 struct compat_fastrpc_ioctl_control {
 	compat_uint_t req;
@@ -153,6 +158,7 @@ struct compat_fastrpc_ioctl_control {
 		struct compat_fastrpc_ctrl_kalloc kalloc;
 		struct compat_fastrpc_ctrl_wakelock wp;
 		struct compat_fastrpc_ctrl_pm pm;
+		struct compat_fastrpc_ctrl_poll poll;
 	};
 };
 
@@ -355,6 +361,11 @@ static int compat_get_fastrpc_ioctl_control(
 	} else if (p == FASTRPC_CONTROL_PM) {
 		err |= get_user(p, &ctrl32->pm.timeout);
 		err |= put_user(p, &ctrl->pm.timeout);
+	} else if (p == FASTRPC_CONTROL_POLL) {
+		err |= get_user(p, &ctrl32->poll.enable);
+		err |= put_user(p, &ctrl->poll.enable);
+		err |= get_user(p, &ctrl32->poll.timeout);
+		err |= put_user(p, &ctrl->poll.timeout);
 	}
 
 	return err;
@@ -88,6 +88,9 @@
 					REMOTE_SCALARS_INHANDLES(sc) +\
 					REMOTE_SCALARS_OUTHANDLES(sc))
 
+/* Retrives the method index from the scalars parameter */
+#define REMOTE_SCALARS_METHOD(sc)        (((sc) >> 24) & 0x1f)
+
 #define REMOTE_SCALARS_MAKEX(attr, method, in, out, oin, oout) \
 		((((uint32_t)   (attr) & 0x7) << 29) | \
 		(((uint32_t) (method) & 0x1f) << 24) | \
@@ -247,6 +250,7 @@ enum fastrpc_control_type {
 	FASTRPC_CONTROL_KALLOC		=	3,
 	FASTRPC_CONTROL_WAKELOCK	=	4,
 	FASTRPC_CONTROL_PM			=	5,
+	FASTRPC_CONTROL_POLL		=	6,
 };
 
 struct fastrpc_ctrl_latency {
@@ -266,6 +270,11 @@ struct fastrpc_ctrl_pm {
 	uint32_t timeout;	/* wakelock control enable */
 };
 
+struct fastrpc_ctrl_poll {
+	uint32_t enable;	/* poll for invoke responses */
+	uint32_t timeout;	/* time(in us) to poll before sleeping */
+};
+
 struct fastrpc_ioctl_control {
 	uint32_t req;
 	union {
@@ -273,6 +282,7 @@ struct fastrpc_ioctl_control {
 		struct fastrpc_ctrl_kalloc kalloc;
 		struct fastrpc_ctrl_wakelock wp;
 		struct fastrpc_ctrl_pm pm;
+		struct fastrpc_ctrl_poll poll;
 	};
 };
 
@@ -604,6 +604,9 @@ static ssize_t diag_dbgfs_read_socketinfo(struct file *file, char __user *ubuf,
 				"read pending\t:\t%d\n"
 				"bytes read\t:\t%lu\n"
 				"bytes written\t:\t%lu\n"
+				"zero copy bytes\t:\t%lu\n"
+				"dropped bytes\t:\t%lu\n"
+				"read stalls\t:\t%lu\n"
 				"fwd inited\t:\t%d\n"
 				"fwd opened\t:\t%d\n"
 				"fwd ch_open\t:\t%d\n\n",
@@ -622,6 +625,9 @@ static ssize_t diag_dbgfs_read_socketinfo(struct file *file, char __user *ubuf,
 				work_pending(&info->read_work),
 				(fwd_ctxt) ? fwd_ctxt->read_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->write_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->zero_copy_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->drop_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->read_stall_cnt : 0,
 				(fwd_ctxt) ? fwd_ctxt->inited : -1,
 				(fwd_ctxt) ?
 				atomic_read(&fwd_ctxt->opened) : -1,
@@ -707,6 +713,9 @@ static ssize_t diag_dbgfs_read_rpmsginfo(struct file *file, char __user *ubuf,
 				"read pending\t:\t%d\n"
 				"bytes read\t:\t%lu\n"
 				"bytes written\t:\t%lu\n"
+				"zero copy bytes\t:\t%lu\n"
+				"dropped bytes\t:\t%lu\n"
+				"read stalls\t:\t%lu\n"
 				"fwd inited\t:\t%d\n"
 				"fwd opened\t:\t%d\n"
 				"fwd ch_open\t:\t%d\n\n",
@@ -725,6 +734,9 @@ static ssize_t diag_dbgfs_read_rpmsginfo(struct file *file, char __user *ubuf,
 				work_pending(&info->read_work),
 				(fwd_ctxt) ? fwd_ctxt->read_bytes : 0,
 				(fwd_ctxt) ? fwd_ctxt->write_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->zero_copy_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->drop_bytes : 0,
+				(fwd_ctxt) ? fwd_ctxt->read_stall_cnt : 0,
 				(fwd_ctxt) ? fwd_ctxt->inited : -1,
 				(fwd_ctxt) ?
 				atomic_read(&fwd_ctxt->opened) : -1,
@@ -148,6 +148,49 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 	src_desc->state = state;
 }
 
+/*
+ * Encode a complete packet, its CRC and the terminator in one pass. The
+ * caller guarantees DIAG_HDLC_MAX_ENC_LEN(len) bytes at dest, so runs of
+ * bytes that need no escaping are copied without per byte bounds checks.
+ */
+int diag_hdlc_encode_pkt(uint8_t *dest, const uint8_t *src, int len)
+{
+	uint8_t *start = dest;
+	const uint8_t *end = src + len;
+	const uint8_t *run;
+	uint16_t crc;
+	uint8_t crc_byte;
+	int i;
+
+	crc = ~crc_ccitt(CRC_16_L_SEED, src, len);
+
+	while (src < end) {
+		run = src;
+		while (src < end && *src != CONTROL_CHAR && *src != ESC_CHAR)
+			src++;
+		memcpy(dest, run, src - run);
+		dest += src - run;
+		if (src < end) {
+			*dest++ = ESC_CHAR;
+			*dest++ = *src++ ^ ESC_MASK;
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		crc_byte = crc & 0xFF;
+		crc >>= 8;
+		if (crc_byte == CONTROL_CHAR || crc_byte == ESC_CHAR) {
+			*dest++ = ESC_CHAR;
+			*dest++ = crc_byte ^ ESC_MASK;
+		} else {
+			*dest++ = crc_byte;
+		}
+	}
+	*dest++ = CONTROL_CHAR;
+
+	return dest - start;
+}
+
 
 int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 {
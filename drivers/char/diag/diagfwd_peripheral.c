@@ -158,25 +158,32 @@ static int diag_add_hdlc_encoding(unsigned char *dest_buf, int *dest_len,
 			break;
 		}
 
-		/* Prepare for encoding the data */
-		send.state = DIAG_STATE_START;
-		send.pkt = payload;
-		send.last = (void *)(payload + header->length - 1);
-		send.terminate = 1;
-
-		enc.dest = temp_encode_buf;
-		enc.dest_last = (void *)(temp_encode_buf + max_size);
-		enc.crc = 0;
-		diag_hdlc_encode(&send, &enc);
+		if (bytes_remaining >= DIAG_HDLC_MAX_ENC_LEN(header->length)) {
+			/* Room for the worst case, skip the bounded encoder */
+			encoded_pkt_length = diag_hdlc_encode_pkt(
+				temp_encode_buf, payload, header->length);
+		} else {
+			/* Prepare for encoding the data */
+			send.state = DIAG_STATE_START;
+			send.pkt = payload;
+			send.last = (void *)(payload + header->length - 1);
+			send.terminate = 1;
+
+			enc.dest = temp_encode_buf;
+			enc.dest_last = (void *)(temp_encode_buf + max_size);
+			enc.crc = 0;
+			diag_hdlc_encode(&send, &enc);
+			encoded_pkt_length = (uint8_t *)enc.dest -
+				temp_encode_buf;
+		}
 
 		/* Prepare for next packet */
 		src_pkt_len = (header_size + header->length + 1);
 		total_processed += src_pkt_len;
 		temp_buf += src_pkt_len;
 
-		encoded_pkt_length = (uint8_t *)enc.dest - temp_encode_buf;
 		bytes_remaining -= encoded_pkt_length;
-		temp_encode_buf = enc.dest;
+		temp_encode_buf += encoded_pkt_length;
 	}
 
 	*dest_len = (int)(temp_encode_buf - dest_buf);
@@ -321,6 +328,7 @@ static void diagfwd_data_process_done(struct diagfwd_info *fwd_info,
 	int write_len = 0, peripheral = 0;
 	unsigned char *write_buf = NULL;
 	uint8_t hdlc_disabled = 0;
+	bool zero_copy = false;
 
 	if (!fwd_info || !buf || len <= 0) {
 		diag_ws_release();
@@ -373,6 +381,7 @@ static void diagfwd_data_process_done(struct diagfwd_info *fwd_info,
 		if (write_len <= 0)
 			goto end;
 		write_buf = buf->data_raw;
+		zero_copy = true;
 	} else {
 		if (!buf) {
 			pr_err("diag: In %s, no match for non encode buffer %pK, peripheral %d, type: %d\n",
@@ -405,6 +414,8 @@ static void diagfwd_data_process_done(struct diagfwd_info *fwd_info,
 					   __func__, err);
 			goto end_write;
 		}
+		if (zero_copy)
+			fwd_info->zero_copy_bytes += write_len;
 	}
 
 	diagfwd_queue_read(fwd_info);
@@ -414,6 +425,7 @@ end:
 	mutex_unlock(&fwd_info->data_mutex);
 	mutex_unlock(&driver->hdlc_disable_mutex);
 end_write:
+	fwd_info->drop_bytes += len;
 	diag_ws_release();
 	if (buf) {
 		DIAG_LOG(DIAG_DEBUG_PERIPHERALS,
@@ -634,6 +646,7 @@ static void diagfwd_data_read_done(struct diagfwd_info *fwd_info,
 	unsigned char *write_buf = NULL, *buf_offset = NULL;
 	struct diagfwd_buf_t *temp_buf = NULL;
 	uint8_t hdlc_disabled = 0;
+	bool zero_copy = false;
 
 	if (!fwd_info || !buf || len <= 0) {
 		diag_ws_release();
@@ -681,6 +694,7 @@ static void diagfwd_data_read_done(struct diagfwd_info *fwd_info,
 			goto end;
 		}
 		write_len = len;
+		zero_copy = true;
 	} else if (hdlc_disabled) {
 		/* The data is raw and and on APPS side HDLC is disabled */
 		if (fwd_info->buf_1 && fwd_info->buf_1->data_raw == buf) {
@@ -702,6 +716,7 @@ static void diagfwd_data_read_done(struct diagfwd_info *fwd_info,
 		}
 		write_len = len;
 		write_buf = buf;
+		zero_copy = true;
 	} else {
 		if (fwd_info->buf_1 && fwd_info->buf_1->data_raw == buf) {
 			temp_buf = fwd_info->buf_1;
@@ -738,6 +753,8 @@ static void diagfwd_data_read_done(struct diagfwd_info *fwd_info,
 					   __func__, err);
 			goto end_write;
 		}
+		if (zero_copy)
+			fwd_info->zero_copy_bytes += write_len;
 	}
 	diagfwd_queue_read(fwd_info);
 	return;
@@ -746,6 +763,7 @@ end:
 	mutex_unlock(&fwd_info->data_mutex);
 	mutex_unlock(&driver->hdlc_disable_mutex);
 end_write:
+	fwd_info->drop_bytes += len;
 	diag_ws_release();
 	if (temp_buf) {
 		DIAG_LOG(DIAG_DEBUG_PERIPHERALS,
@@ -883,6 +901,9 @@ int diagfwd_peripheral_init(void)
 			fwd_info->inited = 1;
 			fwd_info->read_bytes = 0;
 			fwd_info->write_bytes = 0;
+			fwd_info->zero_copy_bytes = 0;
+			fwd_info->drop_bytes = 0;
+			fwd_info->read_stall_cnt = 0;
 			fwd_info->cpd_len_1 = 0;
 			fwd_info->cpd_len_2 = 0;
 			fwd_info->num_pd = 0;
@@ -910,6 +931,9 @@ int diagfwd_peripheral_init(void)
 			fwd_info->ch_open = 0;
 			fwd_info->read_bytes = 0;
 			fwd_info->write_bytes = 0;
+			fwd_info->zero_copy_bytes = 0;
+			fwd_info->drop_bytes = 0;
+			fwd_info->read_stall_cnt = 0;
 			fwd_info->num_pd = 0;
 			fwd_info->cpd_len_1 = 0;
 			fwd_info->cpd_len_2 = 0;
@@ -1602,6 +1626,7 @@ void diagfwd_channel_read(struct diagfwd_info *fwd_info)
 			atomic_set(&temp_buf->in_busy, 1);
 		}
 	} else {
+		fwd_info->read_stall_cnt++;
 		pr_debug("diag: In %s, both buffers are empty for p: %d, t: %d\n",
 			 __func__, fwd_info->peripheral, fwd_info->type);
 	}
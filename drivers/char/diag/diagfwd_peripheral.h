@@ -84,6 +84,9 @@ struct diagfwd_info {
 	atomic_t opened;
 	unsigned long read_bytes;
 	unsigned long write_bytes;
+	unsigned long zero_copy_bytes;
+	unsigned long drop_bytes;
+	unsigned long read_stall_cnt;
 	struct mutex buf_mutex;
 	struct mutex data_mutex;
 	void *ctxt;
@@ -22,7 +22,12 @@
 #include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/input.h>
+#include <linux/input/touch_hint.h>
+#include <linux/hrtimer.h>
+#include <linux/msm_drm_notify.h>
 #include <linux/time.h>
+#include <linux/sched/cpufreq.h>
+#include <linux/sched/boost_arbiter.h>
 #include <uapi/linux/sched/types.h>
 
 #include <linux/sched/rt.h>
@@ -32,11 +37,13 @@ struct cpu_sync {
 	unsigned int input_boost_min;
 	unsigned int input_boost_freq;
 	unsigned int powerkey_input_boost_freq;
+	unsigned int fp_input_boost_freq;
 };
 
 enum input_boost_type {
 	default_input_boost,
-	powerkey_input_boost
+	powerkey_input_boost,
+	fp_input_boost
 };
 
 static DEFINE_PER_CPU(struct cpu_sync, sync_info);
@@ -45,6 +52,8 @@ static struct kthread_work input_boost_work;
 
 static struct kthread_work powerkey_input_boost_work;
 
+static struct kthread_work fp_input_boost_work;
+
 static bool input_boost_enabled;
 
 static unsigned int input_boost_ms = 40;
@@ -59,7 +68,60 @@ module_param(sched_boost_on_input, uint, 0644);
 static bool sched_boost_on_powerkey_input = true;
 module_param(sched_boost_on_powerkey_input, bool, 0644);
 
-static bool sched_boost_active;
+static unsigned int fp_input_boost_ms = 200;
+module_param(fp_input_boost_ms, uint, 0644);
+
+static unsigned int sched_boost_on_fp_input;
+module_param(sched_boost_on_fp_input, uint, 0644);
+
+/* Comma separated list of input device names handled as fingerprint */
+static char fp_input_dev_names[128] = "uinput-egis,uinput-fpc,uinput-goodix";
+module_param_string(fp_input_dev_names, fp_input_dev_names,
+		    sizeof(fp_input_dev_names), 0644);
+
+/*
+ * Apply the boost frequency as a schedutil floor straight from the input
+ * event handler, ahead of the policy min update done by the kthread.
+ */
+static bool input_boost_fast_path = true;
+module_param(input_boost_fast_path, bool, 0644);
+
+/*
+ * Touch gesture hints: a fling keeps the input boost for longer the
+ * faster it is, up to fling_boost_max_ms, while a tap drops the boost as
+ * soon as the finger lifts.
+ */
+static bool touch_hint_boost = true;
+module_param(touch_hint_boost, bool, 0644);
+
+/* pixels per second from which a release is a fling */
+static unsigned int fling_velocity = 1000;
+module_param(fling_velocity, uint, 0644);
+
+static unsigned int fling_boost_max_ms = 500;
+module_param(fling_boost_max_ms, uint, 0644);
+
+/* Duration of the next default boost when set by a fling */
+static unsigned int fling_boost_ms;
+static bool touch_boost_active;
+
+/*
+ * Display pre-boost: floor the CPUs at vsync_boost_freq (kHz, clamped to
+ * each policy) from vsync_boost_lead_us before the next frame of the
+ * primary display is due until vsync_boost_hold_us after it. 0 disables.
+ */
+static unsigned int vsync_boost_freq;
+module_param(vsync_boost_freq, uint, 0644);
+
+static unsigned int vsync_boost_lead_us = 2000;
+module_param(vsync_boost_lead_us, uint, 0644);
+
+static unsigned int vsync_boost_hold_us = 4000;
+module_param(vsync_boost_hold_us, uint, 0644);
+
+static struct hrtimer vsync_boost_timer;
+
+static struct boost_req sched_boost_req;
 
 static struct delayed_work input_boost_rem;
 static u64 last_input_time;
@@ -86,6 +148,8 @@ static int set_input_boost_freq(const char *buf, const struct kernel_param *kp)
 	if (strnstr(kp->name, "powerkey_input_boost_freq",
 			MAX_NAME_LENGTH))
 		type = powerkey_input_boost;
+	if (strnstr(kp->name, "fp_input_boost_freq", MAX_NAME_LENGTH))
+		type = fp_input_boost;
 
 	while ((cp = strpbrk(cp + 1, " :")))
 		ntokens++;
@@ -99,6 +163,8 @@ static int set_input_boost_freq(const char *buf, const struct kernel_param *kp)
 				per_cpu(sync_info, i).input_boost_freq = val;
 			else if (type == powerkey_input_boost)
 				per_cpu(sync_info, i).powerkey_input_boost_freq = val;
+			else if (type == fp_input_boost)
+				per_cpu(sync_info, i).fp_input_boost_freq = val;
 		}
 		goto check_enable;
 	}
@@ -118,6 +184,8 @@ static int set_input_boost_freq(const char *buf, const struct kernel_param *kp)
 			per_cpu(sync_info, cpu).input_boost_freq = val;
 		else if (type == powerkey_input_boost)
 			per_cpu(sync_info, cpu).powerkey_input_boost_freq = val;
+		else if (type == fp_input_boost)
+			per_cpu(sync_info, cpu).fp_input_boost_freq = val;
 		cp = strnchr(cp, PAGE_SIZE - (cp - buf), ' ');
 		cp++;
 	}
@@ -125,7 +193,8 @@ static int set_input_boost_freq(const char *buf, const struct kernel_param *kp)
 check_enable:
 	for_each_possible_cpu(i) {
 		if (per_cpu(sync_info, i).input_boost_freq
-			|| per_cpu(sync_info, i).powerkey_input_boost_freq) {
+			|| per_cpu(sync_info, i).powerkey_input_boost_freq
+			|| per_cpu(sync_info, i).fp_input_boost_freq) {
 			enabled = true;
 			break;
 		}
@@ -146,6 +215,8 @@ static int get_input_boost_freq(char *buf, const struct kernel_param *kp)
 		type = default_input_boost;
 	if (strnstr(kp->name, "powerkey_input_boost_freq", MAX_NAME_LENGTH))
 		type = powerkey_input_boost;
+	if (strnstr(kp->name, "fp_input_boost_freq", MAX_NAME_LENGTH))
+		type = fp_input_boost;
 
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
@@ -153,6 +224,8 @@ static int get_input_boost_freq(char *buf, const struct kernel_param *kp)
 			boost_freq = s->input_boost_freq;
 		else if(type == powerkey_input_boost)
 			boost_freq = s->powerkey_input_boost_freq;
+		else if (type == fp_input_boost)
+			boost_freq = s->fp_input_boost_freq;
 		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
 				"%d:%u ", cpu, boost_freq);
 	}
@@ -168,6 +241,33 @@ module_param_cb(input_boost_freq, &param_ops_input_boost_freq, NULL, 0644);
 
 module_param_cb(powerkey_input_boost_freq, &param_ops_input_boost_freq, NULL, 0644);
 
+module_param_cb(fp_input_boost_freq, &param_ops_input_boost_freq, NULL, 0644);
+
+static unsigned int input_boost_freq_of(struct cpu_sync *s,
+					enum input_boost_type type)
+{
+	switch (type) {
+	case powerkey_input_boost:
+		return s->powerkey_input_boost_freq;
+	case fp_input_boost:
+		return s->fp_input_boost_freq;
+	default:
+		return s->input_boost_freq;
+	}
+}
+
+static unsigned int input_boost_ms_of(enum input_boost_type type)
+{
+	switch (type) {
+	case powerkey_input_boost:
+		return powerkey_input_boost_ms;
+	case fp_input_boost:
+		return fp_input_boost_ms;
+	default:
+		return input_boost_ms;
+	}
+}
+
 /*
  * The CPUFREQ_ADJUST notifier is used to override the current policy min to
  * make sure policy min >= boost_min. The cpufreq framework then does the job
@@ -232,6 +332,8 @@ static void do_input_boost_rem(struct work_struct *work)
 	unsigned int i, ret;
 	struct cpu_sync *i_sync_info;
 
+	touch_boost_active = false;
+
 	/* Reset the input_boost_min for all CPUs in the system */
 	pr_debug("Resetting input boost min for all CPUs\n");
 	for_each_possible_cpu(i) {
@@ -242,24 +344,19 @@ static void do_input_boost_rem(struct work_struct *work)
 	/* Update policies for all online CPUs */
 	update_policy_online();
 
-	if (sched_boost_active) {
-		ret = sched_set_boost(0);
-		if (ret)
-			pr_err("cpu-boost: sched boost disable failed\n");
-		sched_boost_active = false;
-	}
+	ret = boost_req_update(&sched_boost_req, 0, 0);
+	if (ret)
+		pr_err("cpu-boost: sched boost disable failed\n");
 }
 
 static void do_input_boost(struct kthread_work *work)
 {
 	unsigned int i, ret;
 	struct cpu_sync *i_sync_info;
+	unsigned int boost_ms = xchg(&fling_boost_ms, 0) ?: input_boost_ms;
 
 	cancel_delayed_work_sync(&input_boost_rem);
-	if (sched_boost_active) {
-		sched_set_boost(0);
-		sched_boost_active = false;
-	}
+	touch_boost_active = true;
 
 	/* Set the input_boost_min for all CPUs in the system */
 	pr_debug("Setting input boost min for all CPUs\n");
@@ -272,15 +369,12 @@ static void do_input_boost(struct kthread_work *work)
 	update_policy_online();
 
 	/* Enable scheduler boost to migrate tasks to big cluster */
-	if (sched_boost_on_input > 0) {
-		ret = sched_set_boost(sched_boost_on_input);
-		if (ret)
-			pr_err("cpu-boost: sched boost enable failed\n");
-		else
-			sched_boost_active = true;
-	}
+	ret = boost_req_update(&sched_boost_req, sched_boost_on_input,
+			       boost_ms);
+	if (ret)
+		pr_err("cpu-boost: sched boost enable failed\n");
 
-	schedule_delayed_work(&input_boost_rem, msecs_to_jiffies(input_boost_ms));
+	schedule_delayed_work(&input_boost_rem, msecs_to_jiffies(boost_ms));
 }
 
 static void do_powerkey_input_boost(struct kthread_work *work)
@@ -289,10 +383,7 @@ static void do_powerkey_input_boost(struct kthread_work *work)
 	unsigned int i, ret;
 	struct cpu_sync *i_sync_info;
 	cancel_delayed_work_sync(&input_boost_rem);
-	if (sched_boost_active) {
-		sched_set_boost(0);
-		sched_boost_active = false;
-	}
+	touch_boost_active = false;
 
 	/* Set the powerkey_input_boost_min for all CPUs in the system */
 	pr_debug("Setting powerkey input boost min for all CPUs\n");
@@ -305,26 +396,77 @@ static void do_powerkey_input_boost(struct kthread_work *work)
 	update_policy_online();
 
 	/* Enable scheduler boost to migrate tasks to big cluster */
-	if (sched_boost_on_powerkey_input) {
-		ret = sched_set_boost(1);
-		if (ret)
-			pr_err("cpu-boost: HMP boost enable failed\n");
-		else
-			sched_boost_active = true;
-	}
+	ret = boost_req_update(&sched_boost_req,
+			       sched_boost_on_powerkey_input ? 1 : 0,
+			       powerkey_input_boost_ms);
+	if (ret)
+		pr_err("cpu-boost: HMP boost enable failed\n");
 
 	schedule_delayed_work(&input_boost_rem,
 				msecs_to_jiffies(powerkey_input_boost_ms));
 }
 
+static void do_fp_input_boost(struct kthread_work *work)
+{
+	unsigned int i, ret;
+	struct cpu_sync *i_sync_info;
+
+	cancel_delayed_work_sync(&input_boost_rem);
+	touch_boost_active = false;
+
+	pr_debug("Setting fingerprint input boost min for all CPUs\n");
+	for_each_possible_cpu(i) {
+		i_sync_info = &per_cpu(sync_info, i);
+		i_sync_info->input_boost_min = i_sync_info->fp_input_boost_freq;
+	}
+
+	update_policy_online();
+
+	ret = boost_req_update(&sched_boost_req, sched_boost_on_fp_input,
+			       fp_input_boost_ms);
+	if (ret)
+		pr_err("cpu-boost: sched boost enable failed\n");
+
+	schedule_delayed_work(&input_boost_rem,
+				msecs_to_jiffies(fp_input_boost_ms));
+}
+
+/*
+ * Raise the frequency floor of every CPU right away. This only needs
+ * per-CPU stores and is safe under the input core's event lock; the
+ * kthread work then makes the boost stick through the policy min.
+ */
+static void input_boost_fast(enum input_boost_type type, unsigned int ms)
+{
+	unsigned int cpu, freq;
+	unsigned int duration_us = ms * USEC_PER_MSEC;
+
+	for_each_online_cpu(cpu) {
+		freq = input_boost_freq_of(&per_cpu(sync_info, cpu), type);
+		if (freq)
+			sched_set_cpufreq_floor(cpu, freq, duration_us);
+	}
+}
+
 static void cpuboost_input_event(struct input_handle *handle,
 		unsigned int type, unsigned int code, int value)
 {
 	u64 now;
+	enum input_boost_type boost_type = default_input_boost;
+	struct kthread_work *work = &input_boost_work;
 
 	if (!input_boost_enabled)
 		return;
 
+	if (handle->private) {
+		boost_type = fp_input_boost;
+		work = &fp_input_boost_work;
+	} else if ((type == EV_KEY && code == KEY_POWER) ||
+		(type == EV_KEY && code == KEY_WAKEUP)) {
+		boost_type = powerkey_input_boost;
+		work = &powerkey_input_boost_work;
+	}
+
 	now = ktime_to_us(ktime_get());
 	if (now - last_input_time < MIN_INPUT_INTERVAL)
 		return;
@@ -332,15 +474,109 @@ static void cpuboost_input_event(struct input_handle *handle,
 	if (queuing_blocked(&cpu_boost_worker, &input_boost_work))
 		return;
 
-	if ((type == EV_KEY && code == KEY_POWER) ||
-		(type == EV_KEY && code == KEY_WAKEUP)) {
-		kthread_queue_work(&cpu_boost_worker, &powerkey_input_boost_work);
-	} else
-		kthread_queue_work(&cpu_boost_worker, &input_boost_work);
+	if (input_boost_fast_path)
+		input_boost_fast(boost_type, input_boost_ms_of(boost_type));
+
+	kthread_queue_work(&cpu_boost_worker, work);
 
 	last_input_time = ktime_to_us(ktime_get());
 }
 
+static int cpuboost_touch_hint(struct notifier_block *nb, unsigned long event,
+			       void *data)
+{
+	struct touch_hint *hint = data;
+	unsigned int cpu, ms;
+
+	if (!input_boost_enabled || !touch_hint_boost || event != TOUCH_HINT_UP)
+		return NOTIFY_DONE;
+
+	if (hint->velocity < fling_velocity) {
+		/* A tap, the app has already been woken up by the down */
+		if (!touch_boost_active)
+			return NOTIFY_OK;
+
+		for_each_online_cpu(cpu)
+			sched_set_cpufreq_floor(cpu, 0, 0);
+		mod_delayed_work(system_wq, &input_boost_rem, 0);
+		return NOTIFY_OK;
+	}
+
+	ms = div_u64((u64)input_boost_ms * hint->velocity, fling_velocity);
+	ms = clamp(ms, input_boost_ms, max(fling_boost_max_ms, input_boost_ms));
+	WRITE_ONCE(fling_boost_ms, ms);
+
+	if (input_boost_fast_path)
+		input_boost_fast(default_input_boost, ms);
+
+	kthread_queue_work(&cpu_boost_worker, &input_boost_work);
+	last_input_time = ktime_to_us(ktime_get());
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpuboost_touch_hint_nb = {
+	.notifier_call = cpuboost_touch_hint,
+};
+
+static enum hrtimer_restart cpuboost_vsync_timer(struct hrtimer *timer)
+{
+	unsigned int cpu, freq = READ_ONCE(vsync_boost_freq);
+	unsigned int us = vsync_boost_lead_us + vsync_boost_hold_us;
+
+	/* an input boost in force already floors higher and for longer */
+	if (!freq || touch_boost_active)
+		return HRTIMER_NORESTART;
+
+	for_each_online_cpu(cpu)
+		sched_set_cpufreq_floor(cpu, freq, us);
+
+	return HRTIMER_NORESTART;
+}
+
+static int cpuboost_vsync(struct notifier_block *nb, unsigned long event,
+			  void *data)
+{
+	struct msm_drm_vsync *vsync = data;
+
+	if (!READ_ONCE(vsync_boost_freq) ||
+	    vsync->id != MSM_DRM_PRIMARY_DISPLAY)
+		return NOTIFY_DONE;
+
+	hrtimer_start(&vsync_boost_timer,
+		      ktime_sub_us(vsync->deadline, vsync_boost_lead_us),
+		      HRTIMER_MODE_ABS);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpuboost_vsync_nb = {
+	.notifier_call = cpuboost_vsync,
+};
+
+static bool cpuboost_is_fp_dev(struct input_dev *dev)
+{
+	const char *names = fp_input_dev_names;
+	size_t len;
+
+	if (!dev->name)
+		return false;
+
+	len = strlen(dev->name);
+	while (*names) {
+		size_t tok = strcspn(names, ",");
+
+		if (tok == len && !strncmp(names, dev->name, len))
+			return true;
+
+		names += tok;
+		if (*names == ',')
+			names++;
+	}
+
+	return false;
+}
+
 static int cpuboost_input_connect(struct input_handler *handler,
 		struct input_dev *dev, const struct input_device_id *id)
 {
@@ -354,6 +590,8 @@ static int cpuboost_input_connect(struct input_handler *handler,
 	handle->dev = dev;
 	handle->handler = handler;
 	handle->name = "cpufreq";
+	/* Non-NULL private marks a fingerprint sensor */
+	handle->private = cpuboost_is_fp_dev(dev) ? handler : NULL;
 
 	error = input_register_handle(handle);
 	if (error)
@@ -459,15 +697,21 @@ static int cpu_boost_init(void)
 
 	kthread_init_work(&input_boost_work, do_input_boost);
 	kthread_init_work(&powerkey_input_boost_work, do_powerkey_input_boost);
+	kthread_init_work(&fp_input_boost_work, do_fp_input_boost);
 	INIT_DELAYED_WORK(&input_boost_rem, do_input_boost_rem);
+	hrtimer_init(&vsync_boost_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	vsync_boost_timer.function = cpuboost_vsync_timer;
 
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
 		s->cpu = cpu;
 	}
 	cpufreq_register_notifier(&boost_adjust_nb, CPUFREQ_POLICY_NOTIFIER);
+	boost_req_add(&sched_boost_req, "cpu-boost", BOOST_REQ_SCHED_BOOST, -1);
 
 	ret = input_register_handler(&cpuboost_input_handler);
+	touch_hint_register_notifier(&cpuboost_touch_hint_nb);
+	msm_drm_register_vsync_client(&cpuboost_vsync_nb);
 	return 0;
 }
 late_initcall(cpu_boost_init);
@@ -15,23 +15,64 @@
 
 #include <linux/cpufreq.h>
 #include <linux/cpufreq_times.h>
+#include <linux/hash.h>
 #include <linux/hashtable.h>
 #include <linux/init.h>
 #include <linux/jiffies.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/threads.h>
+#include <uapi/linux/uid_cpupower.h>
 
 #define UID_HASH_BITS 10
 
 static DECLARE_HASHTABLE(uid_hash_table, UID_HASH_BITS);
 
-static DEFINE_SPINLOCK(task_time_in_state_lock); /* task->time_in_state */
+/*
+ * task->time_in_state is only ever written by the accounting of the task
+ * itself. The lock keeps readers from seeing it reallocated or freed.
+ */
+static DEFINE_SPINLOCK(task_time_in_state_lock);
 static DEFINE_SPINLOCK(uid_lock); /* uid_hash_table */
 
+/*
+ * Per uid times are first added up per CPU, in a small cache keyed by uid
+ * and counter, so that the tick only takes a lock of its own CPU. An entry
+ * is folded into uid_hash_table when its slot is needed by another key,
+ * and all of them are folded before the table is read.
+ */
+#define UID_CACHE_BITS		6
+
+enum {
+	UID_TIME_FREQ,		/* index is a time_in_state state */
+	UID_TIME_ACTIVE,	/* index is the number of active cpus - 1 */
+	UID_TIME_POLICY,	/* index is first policy cpu + active - 1 */
+};
+
+#define UID_TIME_KEY(kind, index)	(((kind) << 16) | (index))
+#define UID_TIME_KIND(key)		((key) >> 16)
+#define UID_TIME_INDEX(key)		((key) & 0xffff)
+
+struct uid_time_delta {
+	uid_t uid;
+	unsigned int key;
+	u64 time;		/* 0 if the slot is free */
+};
+
+struct uid_time_cache {
+	spinlock_t lock;
+	struct uid_time_delta deltas[1 << UID_CACHE_BITS];
+};
+
+static DEFINE_PER_CPU(struct uid_time_cache, uid_time_cache);
+
+/* Bumped under uid_lock by every change folded into uid_hash_table */
+static u64 uid_times_seq;
+
 struct concurrent_times {
 	atomic64_t active[NR_CPUS];
 	atomic64_t policy[NR_CPUS];
@@ -40,6 +81,8 @@ struct concurrent_times {
 struct uid_entry {
 	uid_t uid;
 	unsigned int max_state;
+	/* uid_times_seq of the last change, for /proc/uid_cpupower/times */
+	u64 seq;
 	struct hlist_node hash;
 	struct rcu_head rcu;
 	struct concurrent_times *concurrent_times;
@@ -137,6 +180,88 @@ static struct uid_entry *find_or_register_uid_locked(uid_t uid)
 	return uid_entry;
 }
 
+/* Caller must hold uid lock */
+static void uid_time_fold_locked(const struct uid_time_delta *d)
+{
+	struct uid_entry *uid_entry = find_or_register_uid_locked(d->uid);
+	unsigned int index = UID_TIME_INDEX(d->key);
+
+	if (!uid_entry)
+		return;
+
+	uid_entry->seq = ++uid_times_seq;
+	switch (UID_TIME_KIND(d->key)) {
+	case UID_TIME_FREQ:
+		if (index < uid_entry->max_state)
+			uid_entry->time_in_state[index] += d->time;
+		break;
+	case UID_TIME_ACTIVE:
+		atomic64_add(d->time,
+			     &uid_entry->concurrent_times->active[index]);
+		break;
+	case UID_TIME_POLICY:
+		atomic64_add(d->time,
+			     &uid_entry->concurrent_times->policy[index]);
+		break;
+	}
+}
+
+static void uid_time_add(uid_t uid, unsigned int key, u64 time)
+{
+	struct uid_time_cache *cache;
+	struct uid_time_delta *d, victim = { 0 };
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(&uid_time_cache);
+	d = &cache->deltas[hash_32(uid ^ (key * GOLDEN_RATIO_32),
+				   UID_CACHE_BITS)];
+
+	spin_lock(&cache->lock);
+	if (d->time && (d->uid != uid || d->key != key)) {
+		victim = *d;
+		d->time = 0;
+	}
+	if (!d->time) {
+		d->uid = uid;
+		d->key = key;
+	}
+	d->time += time;
+	spin_unlock(&cache->lock);
+
+	if (victim.time) {
+		spin_lock(&uid_lock);
+		uid_time_fold_locked(&victim);
+		spin_unlock(&uid_lock);
+	}
+	local_irq_restore(flags);
+}
+
+/* Fold the per-CPU caches into uid_hash_table before it is read */
+static void uid_time_fold_all(void)
+{
+	struct uid_time_cache *cache;
+	struct uid_time_delta *d;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(&uid_time_cache, cpu);
+
+		spin_lock_irqsave(&cache->lock, flags);
+		spin_lock(&uid_lock);
+		for (d = cache->deltas;
+		     d < cache->deltas + ARRAY_SIZE(cache->deltas); d++) {
+			if (!d->time)
+				continue;
+			uid_time_fold_locked(d);
+			d->time = 0;
+		}
+		spin_unlock(&uid_lock);
+		spin_unlock_irqrestore(&cache->lock, flags);
+	}
+}
+
 static int single_uid_time_in_state_show(struct seq_file *m, void *ptr)
 {
 	struct uid_entry *uid_entry;
@@ -146,6 +271,7 @@ static int single_uid_time_in_state_show(struct seq_file *m, void *ptr)
 	if (uid == overflowuid)
 		return -EINVAL;
 
+	uid_time_fold_all();
 	rcu_read_lock();
 
 	uid_entry = find_uid_entry_rcu(uid);
@@ -169,6 +295,9 @@ static void *uid_seq_start(struct seq_file *seq, loff_t *pos)
 	if (*pos >= HASH_SIZE(uid_hash_table))
 		return NULL;
 
+	if (!*pos)
+		uid_time_fold_all();
+
 	return &uid_hash_table[*pos];
 }
 
@@ -355,6 +484,175 @@ static int time_in_state_seq_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+/*
+ * The concurrent times of uid_cpupower are arrays of u32's too, with the
+ * same entries as the text files:
+ * active: [n, uid0, time0[0], ..., time0[n - 1], uid1, ...]
+ * policy: [n, p, cpus of policy 0, ..., cpus of policy p - 1,
+ *          uid0, time0[0], ..., time0[n - 1], uid1, ...]
+ * where n is the number of possible cpus.
+ */
+static int concurrent_time_bin_seq_show(struct seq_file *m, void *v,
+	atomic64_t *(*get_times)(struct concurrent_times *))
+{
+	struct uid_entry *uid_entry;
+	int i, num_possible_cpus = num_possible_cpus();
+	u32 uid, time;
+
+	rcu_read_lock();
+
+	hlist_for_each_entry_rcu(uid_entry, (struct hlist_head *)v, hash) {
+		atomic64_t *times = get_times(uid_entry->concurrent_times);
+
+		uid = (u32)uid_entry->uid;
+		seq_write(m, &uid, sizeof(uid));
+
+		for (i = 0; i < num_possible_cpus; ++i) {
+			time = nsec_to_clock_t(atomic64_read(&times[i]));
+			seq_write(m, &time, sizeof(time));
+		}
+	}
+
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int concurrent_active_time_bin_seq_show(struct seq_file *m, void *v)
+{
+	u32 cnt = num_possible_cpus();
+
+	if (v == uid_hash_table)
+		seq_write(m, &cnt, sizeof(cnt));
+
+	return concurrent_time_bin_seq_show(m, v, get_active_times);
+}
+
+static int concurrent_policy_time_bin_seq_show(struct seq_file *m, void *v)
+{
+	struct cpu_freqs *freqs, *last_freqs = NULL;
+	u32 cnt = num_possible_cpus(), nr_policies = 0;
+	u32 cpus[NR_CPUS];
+	int i;
+
+	if (v == uid_hash_table) {
+		for_each_possible_cpu(i) {
+			freqs = all_freqs[i];
+			if (!freqs)
+				continue;
+			if (freqs != last_freqs) {
+				cpus[nr_policies++] = 0;
+				last_freqs = freqs;
+			}
+			cpus[nr_policies - 1]++;
+		}
+		seq_write(m, &cnt, sizeof(cnt));
+		seq_write(m, &nr_policies, sizeof(nr_policies));
+		seq_write(m, cpus, nr_policies * sizeof(cpus[0]));
+	}
+
+	return concurrent_time_bin_seq_show(m, v, get_policy_times);
+}
+
+/* Per open file state of /proc/uid_cpupower/times */
+struct uid_times_iter {
+	u64 since;
+	u64 seq;
+	unsigned int nr_states;
+	/* the previous pass was read to the end */
+	bool done;
+};
+
+static void *uid_times_seq_start(struct seq_file *m, loff_t *pos)
+{
+	struct uid_times_iter *it = m->private;
+
+	if (*pos >= HASH_SIZE(uid_hash_table)) {
+		it->done = true;
+		return NULL;
+	}
+
+	if (!*pos) {
+		if (it->done) {
+			it->since = it->seq;
+			it->done = false;
+		}
+		uid_time_fold_all();
+		spin_lock_irq(&uid_lock);
+		it->seq = uid_times_seq;
+		spin_unlock_irq(&uid_lock);
+		it->nr_states = READ_ONCE(next_offset);
+	}
+
+	return &uid_hash_table[*pos];
+}
+
+static void *uid_times_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct uid_times_iter *it = m->private;
+	void *next = uid_seq_next(m, v, pos);
+
+	if (!next)
+		it->done = true;
+	return next;
+}
+
+static int uid_times_seq_show(struct seq_file *m, void *v)
+{
+	struct uid_times_iter *it = m->private;
+	struct concurrent_times *ctimes;
+	struct uid_times_record rec = { 0 };
+	struct uid_entry *uid_entry;
+	unsigned int i, nr_cpus = num_possible_cpus();
+	u64 time;
+
+	if (v == uid_hash_table) {
+		struct uid_times_header hdr = {
+			.version = UID_TIMES_VERSION,
+			.header_size = sizeof(hdr),
+			.record_size = sizeof(rec) +
+				(it->nr_states + 2 * nr_cpus) * sizeof(time),
+			.nr_states = it->nr_states,
+			.nr_cpus = nr_cpus,
+			.seq = it->seq,
+			.since = it->since,
+		};
+
+		seq_write(m, &hdr, sizeof(hdr));
+	}
+
+	rcu_read_lock();
+
+	hlist_for_each_entry_rcu(uid_entry, (struct hlist_head *)v, hash) {
+		if (uid_entry->seq <= it->since)
+			continue;
+
+		rec.uid = uid_entry->uid;
+		rec.seq = uid_entry->seq;
+		seq_write(m, &rec, sizeof(rec));
+
+		for (i = 0; i < it->nr_states; i++) {
+			time = i < uid_entry->max_state ?
+				uid_entry->time_in_state[i] : 0;
+			seq_write(m, &time, sizeof(time));
+		}
+
+		ctimes = uid_entry->concurrent_times;
+		for (i = 0; i < nr_cpus; i++) {
+			time = atomic64_read(&ctimes->active[i]);
+			seq_write(m, &time, sizeof(time));
+		}
+		for (i = 0; i < nr_cpus; i++) {
+			time = atomic64_read(&ctimes->policy[i]);
+			seq_write(m, &time, sizeof(time));
+		}
+	}
+
+	rcu_read_unlock();
+
+	return 0;
+}
+
 void cpufreq_task_times_init(struct task_struct *p)
 {
 	unsigned long flags;
@@ -450,7 +748,6 @@ void cpufreq_acct_update_power(struct task_struct *p, u64 cputime)
 	unsigned int active_cpu_cnt = 0;
 	unsigned int policy_cpu_cnt = 0;
 	unsigned int policy_first_cpu;
-	struct uid_entry *uid_entry;
 	struct cpu_freqs *freqs = all_freqs[task_cpu(p)];
 	struct cpufreq_policy *policy;
 	uid_t uid = from_kuid_munged(current_user_ns(), task_uid(p));
@@ -461,31 +758,26 @@ void cpufreq_acct_update_power(struct task_struct *p, u64 cputime)
 
 	state = freqs->offset + READ_ONCE(freqs->last_index);
 
-	spin_lock_irqsave(&task_time_in_state_lock, flags);
-	if ((state < p->max_state || !cpufreq_task_times_realloc_locked(p)) &&
-	    p->time_in_state)
+	/* Only growing the array needs the lock, see task_time_in_state_lock */
+	if (likely(state < p->max_state && p->time_in_state)) {
 		p->time_in_state[state] += cputime;
-	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
-
-	spin_lock_irqsave(&uid_lock, flags);
-	uid_entry = find_or_register_uid_locked(uid);
-	if (uid_entry && state < uid_entry->max_state)
-		uid_entry->time_in_state[state] += cputime;
-	spin_unlock_irqrestore(&uid_lock, flags);
-
-	rcu_read_lock();
-	uid_entry = find_uid_entry_rcu(uid);
-	if (!uid_entry) {
-		rcu_read_unlock();
-		return;
+	} else {
+		spin_lock_irqsave(&task_time_in_state_lock, flags);
+		if ((state < p->max_state ||
+		     !cpufreq_task_times_realloc_locked(p)) &&
+		    p->time_in_state)
+			p->time_in_state[state] += cputime;
+		spin_unlock_irqrestore(&task_time_in_state_lock, flags);
 	}
 
+	uid_time_add(uid, UID_TIME_KEY(UID_TIME_FREQ, state), cputime);
+
 	for_each_possible_cpu(cpu)
 		if (!idle_cpu(cpu))
 			++active_cpu_cnt;
 
-	atomic64_add(cputime,
-		     &uid_entry->concurrent_times->active[active_cpu_cnt - 1]);
+	uid_time_add(uid, UID_TIME_KEY(UID_TIME_ACTIVE, active_cpu_cnt - 1),
+		     cputime);
 
 	policy = cpufreq_cpu_get(task_cpu(p));
 	if (!policy) {
@@ -493,7 +785,6 @@ void cpufreq_acct_update_power(struct task_struct *p, u64 cputime)
 		 * This CPU may have just come up and not have a cpufreq policy
 		 * yet.
 		 */
-		rcu_read_unlock();
 		return;
 	}
 
@@ -504,10 +795,9 @@ void cpufreq_acct_update_power(struct task_struct *p, u64 cputime)
 	policy_first_cpu = cpumask_first(policy->related_cpus);
 	cpufreq_cpu_put(policy);
 
-	atomic64_add(cputime,
-		     &uid_entry->concurrent_times->policy[policy_first_cpu +
-							  policy_cpu_cnt - 1]);
-	rcu_read_unlock();
+	uid_time_add(uid, UID_TIME_KEY(UID_TIME_POLICY,
+				       policy_first_cpu + policy_cpu_cnt - 1),
+		     cputime);
 }
 
 static int cpufreq_times_get_index(struct cpu_freqs *freqs, unsigned int freq)
@@ -573,6 +863,9 @@ void cpufreq_task_times_remove_uids(uid_t uid_start, uid_t uid_end)
 	struct hlist_node *tmp;
 	unsigned long flags;
 
+	/* so that no cached time brings the uids back after removal */
+	uid_time_fold_all();
+
 	spin_lock_irqsave(&uid_lock, flags);
 
 	for (; uid_start <= uid_end; uid_start++) {
@@ -683,9 +976,73 @@ const struct file_operations time_in_state_fops = {
 	.release	= seq_release,
 };
 
+static const struct seq_operations concurrent_active_time_bin_seq_ops = {
+	.start = uid_seq_start,
+	.next = uid_seq_next,
+	.stop = uid_seq_stop,
+	.show = concurrent_active_time_bin_seq_show,
+};
+
+static int concurrent_active_time_bin_open(struct inode *inode,
+					   struct file *file)
+{
+	return seq_open(file, &concurrent_active_time_bin_seq_ops);
+}
+
+static const struct file_operations concurrent_active_time_bin_fops = {
+	.open		= concurrent_active_time_bin_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static const struct seq_operations concurrent_policy_time_bin_seq_ops = {
+	.start = uid_seq_start,
+	.next = uid_seq_next,
+	.stop = uid_seq_stop,
+	.show = concurrent_policy_time_bin_seq_show,
+};
+
+static int concurrent_policy_time_bin_open(struct inode *inode,
+					   struct file *file)
+{
+	return seq_open(file, &concurrent_policy_time_bin_seq_ops);
+}
+
+static const struct file_operations concurrent_policy_time_bin_fops = {
+	.open		= concurrent_policy_time_bin_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static const struct seq_operations uid_times_seq_ops = {
+	.start = uid_times_seq_start,
+	.next = uid_times_seq_next,
+	.stop = uid_seq_stop,
+	.show = uid_times_seq_show,
+};
+
+static int uid_times_open(struct inode *inode, struct file *file)
+{
+	return seq_open_private(file, &uid_times_seq_ops,
+				sizeof(struct uid_times_iter));
+}
+
+static const struct file_operations uid_times_fops = {
+	.open		= uid_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release_private,
+};
+
 static int __init cpufreq_times_init(void)
 {
 	struct proc_dir_entry *uid_cpupower;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(uid_time_cache, cpu).lock);
 
 	proc_create_data("uid_time_in_state", 0444, NULL,
 			 &uid_time_in_state_fops, NULL);
@@ -703,6 +1060,12 @@ static int __init cpufreq_times_init(void)
 	} else {
 		proc_create_data("time_in_state", 0444, uid_cpupower,
 				 &time_in_state_fops, NULL);
+		proc_create_data("concurrent_active_time", 0444, uid_cpupower,
+				 &concurrent_active_time_bin_fops, NULL);
+		proc_create_data("concurrent_policy_time", 0444, uid_cpupower,
+				 &concurrent_policy_time_bin_fops, NULL);
+		proc_create_data("times", 0444, uid_cpupower,
+				 &uid_times_fops, NULL);
 	}
 
 	return 0;
@@ -71,6 +71,17 @@ module_param_named(lpm_prediction, lpm_prediction, bool, 0664);
 static bool lpm_ipi_prediction = true;
 module_param_named(lpm_ipi_prediction, lpm_ipi_prediction, bool, 0664);
 
+/*
+ * Blend the scheduler's expected wakeup into the sleep length estimate.
+ * lpm_sched_hint_weight is the weight (in percent) given to the hint when
+ * the residency history also produced a prediction.
+ */
+static bool lpm_sched_hint;
+module_param_named(lpm_sched_hint, lpm_sched_hint, bool, 0664);
+
+static unsigned int lpm_sched_hint_weight = 50;
+module_param_named(lpm_sched_hint_weight, lpm_sched_hint_weight, uint, 0664);
+
 struct lpm_history {
 	uint32_t resi[MAXSAMPLES];
 	int mode[MAXSAMPLES];
@@ -600,6 +611,33 @@ static void clear_predict_history(void)
 
 static void update_history(struct cpuidle_device *dev, int idx);
 
+static uint32_t lpm_sched_hint_us(int cpu)
+{
+	u64 hint, now;
+
+	if (!lpm_sched_hint)
+		return 0;
+
+	hint = sched_lpm_wakeup_hint(cpu);
+	now = ktime_get_ns();
+	if (hint <= now)
+		return 0;
+
+	return (uint32_t)min_t(u64, div_u64(hint - now, NSEC_PER_USEC),
+			       UINT_MAX);
+}
+
+static uint64_t lpm_blend_sched_hint(uint64_t predicted, uint32_t hint_us)
+{
+	unsigned int weight = min(lpm_sched_hint_weight, 100U);
+
+	if (!predicted || !hint_us)
+		return predicted;
+
+	return div_u64(predicted * (100 - weight) + (u64)hint_us * weight,
+		       100);
+}
+
 static inline bool lpm_disallowed(s64 sleep_us, int cpu, struct lpm_cpu *pm_cpu)
 {
 	uint64_t bias_time = 0;
@@ -639,11 +677,14 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	uint32_t htime = 0, idx_restrict_time = 0, ipi_predicted = 0;
 	uint32_t next_wakeup_us = (uint32_t)sleep_us;
 	uint32_t min_residency, max_residency;
+	uint32_t hint_us;
 	struct power_params *pwr_params;
 
 	if (lpm_disallowed(sleep_us, dev->cpu, cpu))
 		goto done_select;
 
+	hint_us = lpm_sched_hint_us(dev->cpu);
+
 	idx_restrict = cpu->nlevels + 1;
 	next_event_us = (uint32_t)(ktime_to_us(get_next_event_time(dev->cpu)));
 
@@ -668,6 +709,9 @@ static int cpu_power_select(struct cpuidle_device *dev,
 				next_wakeup_us = next_event_us - lvl_latency_us;
 		}
 
+		if (hint_us && hint_us < next_wakeup_us)
+			next_wakeup_us = hint_us;
+
 		if (!i && !cpu_isolated(dev->cpu)) {
 			/*
 			 * If the next_wake_us itself is not sufficient for
@@ -679,6 +723,8 @@ static int cpu_power_select(struct cpuidle_device *dev,
 					&idx_restrict,
 					&idx_restrict_time, &ipi_predicted) == 1) ? 0 :
 						(max_residency >> 1);
+				predicted = lpm_blend_sched_hint(predicted,
+								 hint_us);
 				if (predicted && (predicted < min_residency))
 					predicted = min_residency;
 			} else
@@ -780,6 +826,13 @@ static uint64_t get_cluster_sleep_time(struct lpm_cluster *cluster,
 		if (*next_event_c < next_event)
 			next_event = *next_event_c;
 
+		if (lpm_sched_hint) {
+			u64 hint = sched_lpm_wakeup_hint(cpu);
+
+			if (hint && ns_to_ktime(hint) < next_event)
+				next_event = ns_to_ktime(hint);
+		}
+
 		if (from_idle && lpm_prediction && cluster->lpm_prediction) {
 			history = &per_cpu(hist, cpu);
 			if (history->stime && (history->stime < prediction))
@@ -1177,6 +1230,34 @@ failed:
 		cluster->stats->sleep_time = 0;
 }
 
+/*
+ * A level was too deep if we left it before its minimum residency and
+ * too shallow if we stayed long enough to have paid off the next deeper
+ * level.
+ */
+static void cluster_check_mispredict(struct lpm_cluster *cluster, int idx,
+				     uint64_t residency_us)
+{
+	if (residency_us < cluster->levels[idx].pwr.min_residency)
+		lpm_stats_cluster_mispredict(cluster->stats, idx, true);
+	else if (idx + 1 < cluster->nlevels && residency_us >
+			cluster->levels[idx + 1].pwr.min_residency)
+		lpm_stats_cluster_mispredict(cluster->stats, idx, false);
+}
+
+static void cpu_check_mispredict(struct cpuidle_device *dev,
+				 struct lpm_cpu *cpu, int idx)
+{
+	uint32_t residency_us = dev->last_residency;
+
+	if (residency_us < cpu->levels[idx].pwr.min_residency)
+		lpm_stats_cpu_mispredict(idx, true);
+	else if (idx + 1 < cpu->nlevels &&
+			lpm_cpu_mode_allow(dev->cpu, idx + 1, true) &&
+			residency_us > cpu->levels[idx + 1].pwr.min_residency)
+		lpm_stats_cpu_mispredict(idx, false);
+}
+
 static void cluster_unprepare(struct lpm_cluster *cluster,
 		const struct cpumask *cpu, int child_idx, bool from_idle,
 		int64_t end_time, bool success)
@@ -1213,9 +1294,14 @@ static void cluster_unprepare(struct lpm_cluster *cluster,
 	if (!first_cpu || cluster->last_level == cluster->default_level)
 		goto unlock_return;
 
-	if (!IS_ERR_OR_NULL(cluster->stats) && cluster->stats->sleep_time)
+	if (!IS_ERR_OR_NULL(cluster->stats) && cluster->stats->sleep_time) {
 		cluster->stats->sleep_time = end_time -
 			cluster->stats->sleep_time;
+		if (from_idle && success)
+			cluster_check_mispredict(cluster, cluster->last_level,
+				div_u64(cluster->stats->sleep_time,
+					NSEC_PER_USEC));
+	}
 	lpm_stats_cluster_exit(cluster->stats, cluster->last_level, success);
 
 	level = &cluster->levels[cluster->last_level];
@@ -1437,6 +1523,8 @@ exit:
 	cluster_unprepare(cpu->parent, cpumask, idx, true, end_time, success);
 	cpu_unprepare(cpu, idx, true);
 	dev->last_residency = ktime_us_delta(ktime_get(), start);
+	if (success)
+		cpu_check_mispredict(dev, cpu, idx);
 	update_history(dev, idx);
 	trace_cpu_idle_exit(idx, success);
 	if (lpm_prediction && cpu->lpm_prediction) {
@@ -17,7 +17,10 @@
 #include <linux/export.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/irq_work.h>
 #include <linux/kernel.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
@@ -28,6 +31,49 @@
 
 static const struct file_operations sync_file_fops;
 
+/*
+ * Poll wakeups are handed to a per-CPU irq_work rather than run from the
+ * fence callback, which the signaller calls with the fence lock held and
+ * interrupts off. A producer signalling many polled fences from its irq
+ * handler then only queues them, and the waiters are woken in one batch
+ * once it returns.
+ */
+struct sync_file_wake_list {
+	struct llist_head	list;
+	struct irq_work		work;
+};
+
+static DEFINE_PER_CPU(struct sync_file_wake_list, sync_file_wakes);
+
+static void sync_file_wake_work(struct irq_work *work)
+{
+	struct sync_file_wake_list *wakes = container_of(work,
+					struct sync_file_wake_list, work);
+	struct llist_node *list = llist_del_all(&wakes->list);
+	struct sync_file *sync_file, *next;
+
+	llist_for_each_entry_safe(sync_file, next, list, wake_node) {
+		wake_up_all(&sync_file->wq);
+		/* the sync_file may be released as soon as this is clear */
+		clear_bit_unlock(POLL_WAKE_QUEUED, &sync_file->flags);
+	}
+}
+
+static int __init sync_file_wake_init(void)
+{
+	struct sync_file_wake_list *wakes;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		wakes = per_cpu_ptr(&sync_file_wakes, cpu);
+		init_llist_head(&wakes->list);
+		init_irq_work(&wakes->work, sync_file_wake_work);
+	}
+
+	return 0;
+}
+core_initcall(sync_file_wake_init);
+
 static struct sync_file *sync_file_alloc(void)
 {
 	struct sync_file *sync_file;
@@ -55,10 +101,17 @@ err:
 static void fence_check_cb_func(struct dma_fence *f, struct dma_fence_cb *cb)
 {
 	struct sync_file *sync_file;
+	struct sync_file_wake_list *wakes;
 
 	sync_file = container_of(cb, struct sync_file, cb);
 
-	wake_up_all(&sync_file->wq);
+	if (test_and_set_bit(POLL_WAKE_QUEUED, &sync_file->flags))
+		return;
+
+	/* called under the fence lock, so we can't migrate */
+	wakes = this_cpu_ptr(&sync_file_wakes);
+	if (llist_add(&sync_file->wake_node, &wakes->list))
+		irq_work_queue(&wakes->work);
 }
 
 /**
@@ -277,6 +330,30 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 	if (i == 0)
 		fences[i++] = dma_fence_get(a_fences[0]);
 
+	/*
+	 * When everything one side adds is already signaled or superseded
+	 * by the other, the merge is the other side itself. Share its fence
+	 * instead of building an identical fence array.
+	 */
+	if (i > 1) {
+		struct dma_fence *same = NULL;
+
+		if (i == a_num_fences &&
+		    !memcmp(fences, a_fences, i * sizeof(*fences)))
+			same = a->fence;
+		else if (i == b_num_fences &&
+			 !memcmp(fences, b_fences, i * sizeof(*fences)))
+			same = b->fence;
+
+		if (same) {
+			while (i--)
+				dma_fence_put(fences[i]);
+			kfree(fences);
+			sync_file->fence = dma_fence_get(same);
+			goto out;
+		}
+	}
+
 	if (num_fences > i) {
 		nfences = krealloc(fences, i * sizeof(*fences),
 				  GFP_KERNEL);
@@ -291,6 +368,7 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 		goto err;
 	}
 
+out:
 	strlcpy(sync_file->user_name, name, sizeof(sync_file->user_name));
 	return sync_file;
 
@@ -306,6 +384,9 @@ static int sync_file_release(struct inode *inode, struct file *file)
 
 	if (test_bit(POLL_ENABLED, &sync_file->flags))
 		dma_fence_remove_callback(sync_file->fence, &sync_file->cb);
+	/* a wakeup already queued by the callback still references us */
+	while (test_bit(POLL_WAKE_QUEUED, &sync_file->flags))
+		cpu_relax();
 	dma_fence_put(sync_file->fence);
 	kfree(sync_file);
 
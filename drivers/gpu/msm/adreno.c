@@ -4055,6 +4055,8 @@ static const struct kgsl_functable adreno_functable = {
 	.waittimestamp = adreno_waittimestamp,
 	.readtimestamp = adreno_readtimestamp,
 	.queue_cmds = adreno_dispatcher_queue_cmds,
+	.queue_cmds_deferred = adreno_dispatcher_queue_cmds_deferred,
+	.submit_pending = adreno_dispatcher_submit_pending,
 	.ioctl = adreno_ioctl,
 	.compat_ioctl = adreno_compat_ioctl,
 	.power_stats = adreno_power_stats,
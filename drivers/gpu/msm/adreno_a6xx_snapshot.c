@@ -1552,18 +1552,26 @@ void a6xx_snapshot(struct adreno_device *adreno_dev,
 	bool sptprac_on, gx_on = true;
 	unsigned int i, roq_size;
 
-	/* GMU TCM data dumped through AHB */
-	if (GMU_DEV_OP_VALID(gmu_dev_ops, snapshot))
-		gmu_dev_ops->snapshot(adreno_dev, snapshot);
-
 	/*
-	 * Dump debugbus data here to capture it for both
-	 * GMU and GPU snapshot. Debugbus data can be accessed
-	 * even if the gx headswitch or sptprac is off. If gx
-	 * headswitch is off, data for gx blocks will show as
-	 * 0x5c00bd00.
+	 * A minimal snapshot skips everything that is read one register
+	 * at a time through the GMU, the debug buses and the indexed
+	 * apertures. What is left is the crash dumper register dump plus
+	 * the few registers it cannot capture.
 	 */
-	a6xx_snapshot_debugbus(adreno_dev, snapshot);
+	if (!snapshot->minimal) {
+		/* GMU TCM data dumped through AHB */
+		if (GMU_DEV_OP_VALID(gmu_dev_ops, snapshot))
+			gmu_dev_ops->snapshot(adreno_dev, snapshot);
+
+		/*
+		 * Dump debugbus data here to capture it for both
+		 * GMU and GPU snapshot. Debugbus data can be accessed
+		 * even if the gx headswitch or sptprac is off. If gx
+		 * headswitch is off, data for gx blocks will show as
+		 * 0x5c00bd00.
+		 */
+		a6xx_snapshot_debugbus(adreno_dev, snapshot);
+	}
 
 	sptprac_on = gpudev->sptprac_is_on(adreno_dev);
 
@@ -1602,6 +1610,16 @@ void a6xx_snapshot(struct adreno_device *adreno_dev,
 			snapshot, a6xx_snapshot_registers, &a6xx_reg_list[i]);
 	}
 
+	if (snapshot->minimal) {
+		/* CP_SQE indexed registers */
+		kgsl_snapshot_indexed_registers(device, snapshot,
+			A6XX_CP_SQE_STAT_ADDR, A6XX_CP_SQE_STAT_DATA, 0, 0x33);
+
+		kgsl_snapshot_add_section(device, KGSL_SNAPSHOT_SECTION_DEBUG,
+			snapshot, a6xx_snapshot_sqe, NULL);
+		return;
+	}
+
 	if (adreno_is_a615_family(adreno_dev) || adreno_is_a630(adreno_dev))
 		adreno_snapshot_registers(device, snapshot,
 			a630_rscc_snapshot_registers,
@@ -16,6 +16,7 @@
 #include <linux/sched.h>
 #include <linux/jiffies.h>
 #include <linux/err.h>
+#include <linux/seq_file.h>
 
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
@@ -35,6 +36,17 @@ static unsigned int _context_queue_wait = 10000;
 /* Number of drawobjs sent at a time from a single context */
 static unsigned int _context_drawobj_burst = 5;
 
+/*
+ * GPU time fair share between the contexts of a priority band. Over each
+ * budget window (in milliseconds) a context is entitled to its weight's
+ * share of the window; once it has used that up while other contexts of
+ * its band are active it may only keep _context_throttle_inflight commands
+ * in the ringbuffer, leaving room for the others.
+ */
+static unsigned int _context_fair_share = 1;
+static unsigned int _context_budget_window = 100;
+static unsigned int _context_throttle_inflight = 1;
+
 /*
  * GFT throttle parameters. If GFT recovered more than
  * X times in Y ms invalidate the context and do not attempt recovery.
@@ -522,6 +534,114 @@ static void  dispatcher_queue_context(struct adreno_device *adreno_dev,
 	spin_unlock(&dispatcher->plist_lock);
 }
 
+static unsigned int _context_band(struct adreno_context *drawctxt)
+{
+	return min_t(unsigned int, drawctxt->base.priority,
+		ADRENO_CONTEXT_PRIORITY_BANDS - 1);
+}
+
+/* Start a new budget window once the current one has run out */
+static void _budget_window_update(struct adreno_dispatcher *dispatcher)
+{
+	u64 now = ktime_get_ns();
+
+	if (now - dispatcher->budget_start <
+			(u64) _context_budget_window * NSEC_PER_MSEC)
+		return;
+
+	dispatcher->budget_gen++;
+	dispatcher->budget_start = now;
+	memset(dispatcher->band_weight, 0, sizeof(dispatcher->band_weight));
+}
+
+/* Account the context as competing in its band for this window */
+static void _budget_window_join(struct adreno_dispatcher *dispatcher,
+		struct adreno_context *drawctxt)
+{
+	if (drawctxt->budget_gen == dispatcher->budget_gen)
+		return;
+
+	drawctxt->budget_gen = dispatcher->budget_gen;
+	drawctxt->budget_time = 0;
+	dispatcher->band_weight[_context_band(drawctxt)] += drawctxt->weight;
+}
+
+/* GPU time used in this window, normalized by the context weight */
+static u64 _context_vtime(struct adreno_context *drawctxt)
+{
+	return div_u64(drawctxt->budget_time * ADRENO_CONTEXT_WEIGHT,
+		drawctxt->weight);
+}
+
+static bool _context_over_budget(struct adreno_dispatcher *dispatcher,
+		struct adreno_context *drawctxt)
+{
+	unsigned int band_weight =
+		dispatcher->band_weight[_context_band(drawctxt)];
+
+	if (!_context_fair_share ||
+		drawctxt->budget_gen != dispatcher->budget_gen)
+		return false;
+
+	/* Alone in its band, the context may use all of the GPU */
+	if (band_weight <= drawctxt->weight)
+		return false;
+
+	return drawctxt->budget_time >
+		div_u64((u64) _context_budget_window * NSEC_PER_MSEC *
+			drawctxt->weight, band_weight);
+}
+
+/* Number of commands of the context in its ringbuffer */
+static unsigned int _context_inflight(struct adreno_context *drawctxt)
+{
+	struct adreno_dispatcher_drawqueue *dispatch_q =
+		&drawctxt->rb->dispatch_q;
+	unsigned int i, count = 0;
+
+	for (i = dispatch_q->head; i != dispatch_q->tail;
+		i = DRAWQUEUE_NEXT(i, ADRENO_DISPATCH_DRAWQUEUE_SIZE)) {
+		struct kgsl_drawobj_cmd *cmdobj = dispatch_q->cmd_q[i];
+
+		if (cmdobj && DRAWOBJ(cmdobj)->context == &drawctxt->base)
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * Pick the context of the highest pending priority that used the least
+ * weighted GPU time in the current budget window. Called with the plist
+ * lock held.
+ */
+static struct adreno_context *_next_fair_context(
+		struct adreno_dispatcher *dispatcher)
+{
+	struct adreno_context *first, *drawctxt, *pick;
+
+	first = plist_first_entry(&dispatcher->pending,
+		struct adreno_context, pending);
+
+	if (!_context_fair_share)
+		return first;
+
+	pick = first;
+	plist_for_each_entry(drawctxt, &dispatcher->pending, pending) {
+		if (drawctxt->pending.prio != first->pending.prio)
+			break;
+
+		/* Contexts new to the window have used nothing yet */
+		if (drawctxt->budget_gen != dispatcher->budget_gen)
+			return drawctxt;
+
+		if (_context_vtime(drawctxt) < _context_vtime(pick))
+			pick = drawctxt;
+	}
+
+	return pick;
+}
+
 /**
  * sendcmd() - Send a drawobj to the GPU hardware
  * @dispatcher: Pointer to the adreno dispatcher struct
@@ -569,6 +689,10 @@ static int sendcmd(struct adreno_device *adreno_dev,
 		set_bit(ADRENO_DISPATCHER_POWER, &dispatcher->priv);
 	}
 
+	if (cmdobj->deadline_ns)
+		kgsl_pwrscale_frame_deadline(device, drawctxt->frame_cycles_avg,
+			cmdobj->deadline_ns);
+
 	if (test_bit(ADRENO_DEVICE_DRAWOBJ_PROFILE, &adreno_dev->priv)) {
 		set_bit(CMDOBJ_PROFILE, &cmdobj->priv);
 		cmdobj->profile_index = adreno_dev->profile_index;
@@ -655,6 +779,11 @@ static int sendcmd(struct adreno_device *adreno_dev,
 		time.ticks, (unsigned long) secs, nsecs / 1000, drawctxt->rb,
 		adreno_get_rptr(drawctxt->rb));
 
+	trace_adreno_cmdbatch_sched(drawobj,
+		ktime_us_delta(ktime_get(), cmdobj->queued),
+		drawctxt->gpu_time, drawctxt->budget_time,
+		_context_over_budget(dispatcher, drawctxt));
+
 	mutex_unlock(&device->mutex);
 
 	cmdobj->submit_ticks = time.ticks;
@@ -771,11 +900,18 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	int ret = 0;
 	int inflight = _drawqueue_inflight(dispatch_q);
 	unsigned int timestamp;
+	unsigned int ctx_inflight = 0;
+	bool throttled;
 
 	if (drawctxt->base.flags & KGSL_CONTEXT_SPARSE)
 		return _process_drawqueue_sparse(drawctxt);
 
-	if (dispatch_q->inflight >= inflight) {
+	throttled = _context_over_budget(&adreno_dev->dispatcher, drawctxt);
+	if (throttled)
+		ctx_inflight = _context_inflight(drawctxt);
+
+	if (dispatch_q->inflight >= inflight ||
+		(throttled && ctx_inflight >= _context_throttle_inflight)) {
 		spin_lock(&drawctxt->lock);
 		_process_drawqueue_get_next_drawobj(drawctxt);
 		spin_unlock(&drawctxt->lock);
@@ -786,7 +922,8 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	 * Each context can send a specific number of drawobjs per cycle
 	 */
 	while ((count < _context_drawobj_burst) &&
-		(dispatch_q->inflight < inflight)) {
+		(dispatch_q->inflight < inflight) &&
+		(!throttled || ctx_inflight < _context_throttle_inflight)) {
 		struct kgsl_drawobj *drawobj;
 		struct kgsl_drawobj_cmd *cmdobj;
 
@@ -842,6 +979,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 		drawctxt->submitted_timestamp = timestamp;
 
 		count++;
+		ctx_inflight++;
 	}
 
 	/*
@@ -880,6 +1018,8 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 	plist_head_init(&requeue);
 	plist_head_init(&busy_list);
 
+	_budget_window_update(dispatcher);
+
 	/* Try to fill the ringbuffers as much as possible */
 	while (1) {
 
@@ -898,8 +1038,7 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 		}
 
 		/* Get the next entry on the list */
-		drawctxt = plist_first_entry(&dispatcher->pending,
-			struct adreno_context, pending);
+		drawctxt = _next_fair_context(dispatcher);
 
 		plist_del(&drawctxt->pending, &dispatcher->pending);
 
@@ -911,6 +1050,8 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 			continue;
 		}
 
+		_budget_window_join(dispatcher, drawctxt);
+
 		ret = dispatcher_context_sendcmds(adreno_dev, drawctxt);
 
 		/* Don't bother requeuing on -ENOENT - context is detached */
@@ -1326,6 +1467,7 @@ static int _queue_cmdobj(struct adreno_device *adreno_dev,
 	drawctxt->queued_timestamp = *timestamp;
 	_set_ft_policy(adreno_dev, drawctxt, cmdobj);
 	_cmdobj_set_flags(drawctxt, cmdobj);
+	cmdobj->queued = ktime_get();
 
 	_queue_drawobj(drawctxt, drawobj);
 
@@ -1343,21 +1485,9 @@ static void _queue_syncobj(struct adreno_context *drawctxt,
 	_queue_drawobj(drawctxt, drawobj);
 }
 
-/**
- * adreno_dispactcher_queue_cmds() - Queue a new draw object in the context
- * @dev_priv: Pointer to the device private struct
- * @context: Pointer to the kgsl draw context
- * @drawobj: Pointer to the array of drawobj's being submitted
- * @count: Number of drawobj's being submitted
- * @timestamp: Pointer to the requested timestamp
- *
- * Queue a command in the context - if there isn't any room in the queue, then
- * block until there is
- */
-int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
+static int _queue_cmds(struct kgsl_device_private *dev_priv,
 		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
-		uint32_t count, uint32_t *timestamp)
-
+		uint32_t count, uint32_t *timestamp, bool issue)
 {
 	struct kgsl_device *device = dev_priv->device;
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
@@ -1459,6 +1589,13 @@ int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 
 	_track_context(adreno_dev, dispatch_q, drawctxt);
 
+	/*
+	 * Deferred submissions still have to drain a context that is filling
+	 * up, or the next one would sleep on a queue nobody is emptying
+	 */
+	if (drawctxt->queued >= _context_drawqueue_size / 2)
+		issue = true;
+
 	spin_unlock(&drawctxt->lock);
 
 	if (device->pwrctrl.l2pc_update_queue)
@@ -1477,7 +1614,7 @@ int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 	 * queue will try to schedule new commands anyway.
 	 */
 
-	if (dispatch_q->inflight < _context_drawobj_burst)
+	if (issue && dispatch_q->inflight < _context_drawobj_burst)
 		adreno_dispatcher_issuecmds(adreno_dev);
 done:
 	if (test_and_clear_bit(ADRENO_CONTEXT_FAULT, &context->priv))
@@ -1486,6 +1623,54 @@ done:
 	return 0;
 }
 
+/**
+ * adreno_dispactcher_queue_cmds() - Queue a new draw object in the context
+ * @dev_priv: Pointer to the device private struct
+ * @context: Pointer to the kgsl draw context
+ * @drawobj: Pointer to the array of drawobj's being submitted
+ * @count: Number of drawobj's being submitted
+ * @timestamp: Pointer to the requested timestamp
+ *
+ * Queue a command in the context - if there isn't any room in the queue, then
+ * block until there is
+ */
+int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
+		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
+		uint32_t count, uint32_t *timestamp)
+{
+	return _queue_cmds(dev_priv, context, drawobj, count, timestamp, true);
+}
+
+/**
+ * adreno_dispatcher_queue_cmds_deferred() - Queue draw objects without
+ * issuing them
+ * @dev_priv: Pointer to the device private struct
+ * @context: Pointer to the kgsl draw context
+ * @drawobj: Pointer to the array of drawobj's being submitted
+ * @count: Number of drawobj's being submitted
+ * @timestamp: Pointer to the requested timestamp
+ *
+ * Like adreno_dispatcher_queue_cmds() but leave the context on the pending
+ * list for a later adreno_dispatcher_submit_pending(), so that a batch of
+ * submissions only goes through the dispatcher once.
+ */
+int adreno_dispatcher_queue_cmds_deferred(struct kgsl_device_private *dev_priv,
+		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
+		uint32_t count, uint32_t *timestamp)
+{
+	return _queue_cmds(dev_priv, context, drawobj, count, timestamp, false);
+}
+
+/**
+ * adreno_dispatcher_submit_pending() - Issue commands queued with
+ * adreno_dispatcher_queue_cmds_deferred()
+ * @device: Pointer to the KGSL device
+ */
+void adreno_dispatcher_submit_pending(struct kgsl_device *device)
+{
+	adreno_dispatcher_issuecmds(ADRENO_DEVICE(device));
+}
+
 static int _mark_context(int id, void *ptr, void *data)
 {
 	unsigned int guilty = *((unsigned int *) data);
@@ -2358,6 +2543,28 @@ static void retire_cmdobj(struct adreno_device *adreno_dev,
 	drawctxt->submit_retire_ticks[drawctxt->ticks_index] =
 		end - cmdobj->submit_ticks;
 
+	if (end > start) {
+		u64 ns = div_u64((end - start) * NSEC_PER_SEC,
+			KGSL_XO_CLK_FREQ);
+
+		drawctxt->gpu_time += ns;
+		if (drawctxt->budget_gen == dispatcher->budget_gen)
+			drawctxt->budget_time += ns;
+
+		/* Convert the time on the GPU to cycles at the current level */
+		drawctxt->frame_cycles += div_u64((end - start) *
+			kgsl_pwrctrl_active_freq(&KGSL_DEVICE(adreno_dev)->pwrctrl),
+			KGSL_XO_CLK_FREQ);
+	}
+
+	if (cmdobj->deadline_ns) {
+		drawctxt->frame_cycles_avg = drawctxt->frame_cycles_avg ?
+			(3 * drawctxt->frame_cycles_avg +
+			 drawctxt->frame_cycles) >> 2 :
+			drawctxt->frame_cycles;
+		drawctxt->frame_cycles = 0;
+	}
+
 	drawctxt->ticks_index = (drawctxt->ticks_index + 1) %
 		SUBMIT_RETIRE_TICKS_SIZE;
 
@@ -2695,6 +2902,7 @@ void adreno_dispatcher_close(struct adreno_device *adreno_dev)
 
 	mutex_unlock(&dispatcher->mutex);
 
+	jank_snapshot_unregister(&dispatcher->jank_src);
 	kobject_put(&dispatcher->kobj);
 }
 
@@ -2740,6 +2948,22 @@ static ssize_t _store_uint(struct adreno_dispatcher *dispatcher,
 	return size;
 }
 
+/* Like _store_uint but for on/off switches where 0 is valid */
+static ssize_t _store_bool(struct adreno_dispatcher *dispatcher,
+		struct dispatcher_attribute *attr,
+		const char *buf, size_t size)
+{
+	unsigned int val = 0;
+	int ret;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	*((unsigned int *) attr->value) = val ? 1 : 0;
+	return size;
+}
+
 static ssize_t _show_uint(struct adreno_dispatcher *dispatcher,
 		struct dispatcher_attribute *attr,
 		char *buf)
@@ -2772,6 +2996,16 @@ static DISPATCHER_UINT_ATTR(fault_throttle_time, 0644, 0,
 	_fault_throttle_time);
 static DISPATCHER_UINT_ATTR(fault_throttle_burst, 0644, 0,
 	_fault_throttle_burst);
+static struct dispatcher_attribute dispatcher_attr_context_fair_share = {
+	.attr = { .name = "context_fair_share", .mode = 0644 },
+	.show = _show_uint,
+	.store = _store_bool,
+	.value = &_context_fair_share,
+};
+static DISPATCHER_UINT_ATTR(context_budget_window, 0644, 0,
+	_context_budget_window);
+static DISPATCHER_UINT_ATTR(context_throttle_inflight, 0644,
+	ADRENO_DISPATCH_DRAWQUEUE_SIZE, _context_throttle_inflight);
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
@@ -2783,6 +3017,9 @@ static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_fault_detect_interval.attr,
 	&dispatcher_attr_fault_throttle_time.attr,
 	&dispatcher_attr_fault_throttle_burst.attr,
+	&dispatcher_attr_context_fair_share.attr,
+	&dispatcher_attr_context_budget_window.attr,
+	&dispatcher_attr_context_throttle_inflight.attr,
 	NULL,
 };
 
@@ -2823,6 +3060,40 @@ static struct kobj_type ktype_dispatcher = {
 	.default_attrs = dispatcher_attrs,
 };
 
+static void adreno_dispatcher_jank_show(struct seq_file *m, void *priv)
+{
+	struct adreno_device *adreno_dev = priv;
+	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
+	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct adreno_context *drawctxt;
+	struct adreno_ringbuffer *rb;
+	unsigned int level = READ_ONCE(pwr->active_pwrlevel);
+	int i, pending = 0, queued = 0;
+
+	spin_lock(&dispatcher->plist_lock);
+	plist_for_each_entry(drawctxt, &dispatcher->pending, pending) {
+		pending++;
+		queued += drawctxt->queued;
+	}
+	spin_unlock(&dispatcher->plist_lock);
+
+	seq_printf(m, "state=%s pwrlevel=%u freq=%u min=%u max=%u thermal=%u\n",
+		kgsl_pwrstate_to_str(device->state), level,
+		pwr->pwrlevels[level].gpu_freq, pwr->min_pwrlevel,
+		pwr->max_pwrlevel, pwr->thermal_pwrlevel);
+	seq_printf(m, "inflight=%u pending_contexts=%d queued=%d fault=%d\n",
+		dispatcher->inflight, pending, queued,
+		atomic_read(&dispatcher->fault));
+
+	FOR_EACH_RINGBUFFER(adreno_dev, rb, i)
+		seq_printf(m, "rb%d inflight=%u queued=%u\n", i,
+			rb->dispatch_q.inflight,
+			(rb->dispatch_q.tail - rb->dispatch_q.head +
+			 ADRENO_DISPATCH_DRAWQUEUE_SIZE) %
+			ADRENO_DISPATCH_DRAWQUEUE_SIZE);
+}
+
 /**
  * adreno_dispatcher_init() - Initialize the dispatcher
  * @adreno_dev: pointer to the adreno device structure
@@ -2855,8 +3126,15 @@ int adreno_dispatcher_init(struct adreno_device *adreno_dev)
 
 	ret = kobject_init_and_add(&dispatcher->kobj, &ktype_dispatcher,
 		&device->dev->kobj, "dispatch");
+	if (ret)
+		return ret;
 
-	return ret;
+	dispatcher->jank_src.name = "kgsl";
+	dispatcher->jank_src.show = adreno_dispatcher_jank_show;
+	dispatcher->jank_src.priv = adreno_dev;
+	jank_snapshot_register(&dispatcher->jank_src);
+
+	return 0;
 }
 
 void adreno_dispatcher_halt(struct kgsl_device *device)
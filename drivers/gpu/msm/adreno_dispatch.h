@@ -14,6 +14,8 @@
 #ifndef ____ADRENO_DISPATCHER_H
 #define ____ADRENO_DISPATCHER_H
 
+#include <linux/jank_snapshot.h>
+
 extern unsigned int adreno_drawobj_timeout;
 
 /*
@@ -26,6 +28,23 @@ extern unsigned int adreno_drawobj_timeout;
 
 #define DRAWQUEUE_NEXT(_i, _s) (((_i) + 1) % (_s))
 
+/* Context priorities, each is a band for GPU time fair share */
+#define ADRENO_CONTEXT_PRIORITY_BANDS 16
+
+/* Fair share weight of a context created at nice 0 */
+#define ADRENO_CONTEXT_WEIGHT 1024
+
+/*
+ * Weight of a context by the nice value of its creator, halving or
+ * doubling every 5 nice levels
+ */
+static inline unsigned int adreno_context_weight(int nice)
+{
+	if (nice >= 0)
+		return ADRENO_CONTEXT_WEIGHT >> (nice / 5);
+	return ADRENO_CONTEXT_WEIGHT << (-nice / 5);
+}
+
 /**
  * struct adreno_dispatcher_drawqueue - List of commands for a RB level
  * @cmd_q: List of command obj's submitted to dispatcher
@@ -56,6 +75,10 @@ struct adreno_dispatcher_drawqueue {
  * @work: work_struct to put the dispatcher in a work queue
  * @kobj: kobject for the dispatcher directory in the device sysfs node
  * @idle_gate: Gate to wait on for dispatcher to idle
+ * @budget_gen: Generation of the current GPU time budget window
+ * @budget_start: Start of the current budget window in ns
+ * @band_weight: Sum of the weights of the contexts of each priority that
+ * submitted in the current budget window * @jank_src: GPU frequency and queue state source for jank snapshots
  */
 struct adreno_dispatcher {
 	struct mutex mutex;
@@ -69,6 +92,10 @@ struct adreno_dispatcher {
 	struct kthread_work work;
 	struct kobject kobj;
 	struct completion idle_gate;
+	unsigned int budget_gen;
+	u64 budget_start;
+	unsigned int band_weight[ADRENO_CONTEXT_PRIORITY_BANDS];
+	struct jank_snapshot_source jank_src;
 };
 
 enum adreno_dispatcher_flags {
@@ -89,6 +116,10 @@ void adreno_dispatcher_stop_fault_timer(struct kgsl_device *device);
 int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
 		uint32_t count, uint32_t *timestamp);
+int adreno_dispatcher_queue_cmds_deferred(struct kgsl_device_private *dev_priv,
+		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
+		uint32_t count, uint32_t *timestamp);
+void adreno_dispatcher_submit_pending(struct kgsl_device *device);
 
 void adreno_dispatcher_schedule(struct kgsl_device *device);
 void adreno_dispatcher_pause(struct adreno_device *adreno_dev);
@@ -403,6 +403,7 @@ adreno_drawctxt_create(struct kgsl_device_private *dev_priv,
 
 	/* Set the context priority */
 	_set_context_priority(drawctxt);
+	drawctxt->weight = adreno_context_weight(task_nice(current));
 	/* set the context ringbuffer */
 	drawctxt->rb = adreno_ctx_get_rb(adreno_dev, drawctxt);
 
@@ -53,6 +53,14 @@ struct kgsl_context;
  *		 be written.
  * @active_node: Linkage for nodes in active_list
  * @active_time: Time when this context last seen
+ * @frame_cycles: GPU cycles retired so far in the current frame
+ * @frame_cycles_avg: Running average of GPU cycles per completed frame, used
+ *		 to predict the cost of frames submitted with a deadline
+ * @weight: Fair share weight of the context within its priority band
+ * @gpu_time: Total GPU time of retired commands in ns
+ * @budget_time: GPU time in ns used in the current budget window
+ * @budget_gen: Budget window the context last submitted in
+ * @profile_submits: Submissions since the last one sampled by the profiler
  */
 struct adreno_context {
 	struct kgsl_context base;
@@ -82,6 +90,13 @@ struct adreno_context {
 
 	struct list_head active_node;
 	unsigned long active_time;
+	uint64_t frame_cycles;
+	uint64_t frame_cycles_avg;
+	unsigned int weight;
+	uint64_t gpu_time;
+	uint64_t budget_time;
+	unsigned int budget_gen;
+	unsigned int profile_submits;
 };
 
 /* Flag definitions for flag field in adreno_context */
@@ -18,7 +18,9 @@
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
 #include <linux/debugfs.h>
+#include <linux/poll.h>
 #include <linux/sched/signal.h>
+#include <linux/kgsl_profile.h>
 
 #include "adreno.h"
 #include "adreno_profile.h"
@@ -393,6 +395,69 @@ static bool results_available(struct adreno_device *adreno_dev,
 	return true;
 }
 
+#ifdef CONFIG_QCOM_KGSL_PROFILE_SAMPLING
+/*
+ * Append the shared buffer entry at @data to sample_fifo as a struct
+ * kgsl_profile_sample, or count it as dropped if it does not fit.
+ */
+static void _sample_push(struct adreno_profile *profile, unsigned int *data)
+{
+	struct adreno_profile_assigns_list *entry;
+	struct kgsl_profile_sample sample;
+	struct kgsl_profile_value value;
+	unsigned int i, *cntr;
+
+	if (!profile->sampling)
+		return;
+
+	sample.count = data[1];
+	sample.size = sizeof(sample) + sample.count * sizeof(value);
+	if (kfifo_avail(&profile->sample_fifo) < sample.size) {
+		profile->sample_dropped++;
+		return;
+	}
+
+	sample.timestamp = data[0];
+	sample.context_id = data[2];
+	sample.pid = data[3];
+	sample.tid = data[4];
+	sample.type = data[5];
+	sample.dropped = profile->sample_dropped;
+	profile->sample_dropped = 0;
+	kfifo_in(&profile->sample_fifo, &sample, sizeof(sample));
+
+	/* offset, lo and hi before the IBs, then lo and hi after them */
+	for (i = 0, cntr = data + 6; i < sample.count; i++, cntr += 5) {
+		entry = _find_assignment_by_offset(profile, cntr[0]);
+		value.groupid = entry ? entry->groupid : -1;
+		value.countable = entry ? entry->countable : -1;
+		value.delta = (((uint64_t)cntr[4] << 32) | cntr[3]) -
+			(((uint64_t)cntr[2] << 32) | cntr[1]);
+		kfifo_in(&profile->sample_fifo, &value, sizeof(value));
+	}
+}
+
+static void _sample_wake(struct adreno_profile *profile)
+{
+	if (profile->sampling && !kfifo_is_empty(&profile->sample_fifo))
+		wake_up_interruptible(&profile->sample_wait);
+}
+
+static inline bool _sampling(struct adreno_profile *profile)
+{
+	return profile->sampling;
+}
+#else
+static inline bool _sampling(struct adreno_profile *profile)
+{
+	return false;
+}
+
+static inline void _sample_push(struct adreno_profile *profile,
+		unsigned int *data) { }
+static inline void _sample_wake(struct adreno_profile *profile) { }
+#endif
+
 static void transfer_results(struct adreno_profile *profile,
 		unsigned int shared_buf_tail)
 {
@@ -405,8 +470,6 @@ static void transfer_results(struct adreno_profile *profile,
 
 	log_ptr = profile->log_head;
 	log_base = profile->log_buffer;
-	if (log_ptr == NULL)
-		return;
 
 	/*
 	 * go through counter buffers and format for write into log_buffer
@@ -427,6 +490,12 @@ static void transfer_results(struct adreno_profile *profile,
 		tid = *(ptr + buf_off++);
 		client_type = *(ptr + buf_off++);
 
+		_sample_push(profile, ptr + profile->shared_tail);
+
+		/* the debugfs log is only kept while it is enabled there */
+		if (log_ptr == NULL)
+			goto next;
+
 		/*
 		 * if entry overwrites the tail of log_buffer then adjust tail
 		 * ptr to make room for the new entry, discarding old entry
@@ -483,6 +552,7 @@ static void transfer_results(struct adreno_profile *profile,
 
 		}
 
+next:
 		tmp_tail = profile->shared_tail;
 		shared_buf_inc(profile->shared_size,
 				&profile->shared_tail,
@@ -497,6 +567,7 @@ static void transfer_results(struct adreno_profile *profile,
 
 	}
 	profile->log_head = log_ptr;
+	_sample_wake(profile);
 	return;
 err:
 	/* reset head/tail to same on error in hopes we work correctly later */
@@ -523,6 +594,12 @@ static int profile_enable_set(void *data, u64 val)
 
 	mutex_lock(&device->mutex);
 
+	/* /dev/kgsl-profile owns the assignments while it samples */
+	if (_sampling(profile)) {
+		mutex_unlock(&device->mutex);
+		return -EBUSY;
+	}
+
 	if (val && profile->log_buffer == NULL) {
 		/* allocate profile_log_buffer the first time enabled */
 		profile->log_buffer = vmalloc(ADRENO_PROFILE_LOG_BUF_SIZE);
@@ -1048,6 +1125,258 @@ DEFINE_SIMPLE_ATTRIBUTE(profile_enable_fops,
 			profile_enable_get,
 			profile_enable_set, "%llu\n");
 
+#ifdef CONFIG_QCOM_KGSL_PROFILE_SAMPLING
+static struct adreno_device *_sample_adreno_dev(struct file *filep)
+{
+	struct adreno_profile *profile = container_of(filep->private_data,
+			struct adreno_profile, sample_dev);
+
+	return container_of(profile, struct adreno_device, profile);
+}
+
+/* Caller must hold the device mutex */
+static int _sample_stop(struct adreno_device *adreno_dev)
+{
+	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
+	struct adreno_profile *profile = &adreno_dev->profile;
+	struct adreno_profile_assigns_list *entry, *tmp;
+	int ret;
+
+	if (!profile->sampling)
+		return 0;
+
+	ret = adreno_perfcntr_active_oob_get(adreno_dev);
+	if (ret)
+		return ret;
+
+	/* let the sampled submissions retire so their entries can be freed */
+	if (adreno_idle(device)) {
+		adreno_perfcntr_active_oob_put(adreno_dev);
+		return -ETIMEDOUT;
+	}
+	adreno_profile_process_results(adreno_dev);
+
+	profile->enabled = false;
+	profile->sampling = false;
+	profile->sample_owner = NULL;
+
+	list_for_each_entry_safe(entry, tmp, &profile->assignments_list, list) {
+		list_del(&entry->list);
+		profile->assignment_count--;
+		adreno_perfcounter_put(adreno_dev, entry->groupid,
+				entry->countable, PERFCOUNTER_FLAG_KERNEL);
+		kfree(entry);
+	}
+
+	adreno_perfcntr_active_oob_put(adreno_dev);
+	return 0;
+}
+
+static long _sample_config(struct file *filep,
+		struct kgsl_profile_config __user *uarg)
+{
+	struct adreno_device *adreno_dev = _sample_adreno_dev(filep);
+	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
+	struct adreno_profile *profile = &adreno_dev->profile;
+	struct kgsl_profile_counter *counters = NULL;
+	struct kgsl_profile_config cfg;
+	unsigned int i;
+	long ret;
+
+	if (copy_from_user(&cfg, uarg, sizeof(cfg)))
+		return -EFAULT;
+
+	if (cfg.count > KGSL_PROFILE_MAX_COUNTERS)
+		return -EINVAL;
+
+	if (cfg.count) {
+		counters = memdup_user(u64_to_user_ptr(cfg.counters),
+				cfg.count * sizeof(*counters));
+		if (IS_ERR(counters))
+			return PTR_ERR(counters);
+	}
+
+	mutex_lock(&device->mutex);
+
+	/* the debugfs interface owns the assignments while it is enabled */
+	if (profile->enabled && !profile->sampling) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = _sample_stop(adreno_dev);
+	if (ret || !cfg.count)
+		goto out;
+
+	if (!kfifo_initialized(&profile->sample_fifo)) {
+		ret = kfifo_alloc(&profile->sample_fifo,
+				ADRENO_PROFILE_SAMPLE_FIFO_SIZE, GFP_KERNEL);
+		if (ret)
+			goto out;
+	}
+	kfifo_reset(&profile->sample_fifo);
+	profile->sample_dropped = 0;
+
+	ret = adreno_perfcntr_active_oob_get(adreno_dev);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < cfg.count; i++)
+		_add_assignment(adreno_dev, counters[i].groupid,
+				counters[i].countable);
+
+	adreno_perfcntr_active_oob_put(adreno_dev);
+
+	cfg.assigned = profile->assignment_count;
+	if (cfg.assigned) {
+		profile->sample_interval = max(cfg.interval, 1U);
+		profile->sample_owner = filep;
+		profile->sampling = true;
+		profile->enabled = true;
+	}
+
+	if (put_user(cfg.assigned, &uarg->assigned))
+		ret = -EFAULT;
+out:
+	mutex_unlock(&device->mutex);
+	kfree(counters);
+	return ret;
+}
+
+static long profile_sample_ioctl(struct file *filep, unsigned int cmd,
+		unsigned long arg)
+{
+	switch (cmd) {
+	case KGSL_PROFILE_IOC_CONFIG:
+		return _sample_config(filep, (void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+/* Copy whole samples to @ubuf, caller must hold the device mutex */
+static ssize_t _sample_copy(struct adreno_profile *profile,
+		char __user *ubuf, size_t max)
+{
+	unsigned int size, copied;
+	ssize_t len = 0;
+
+	while (kfifo_out_peek(&profile->sample_fifo, &size, sizeof(size)) ==
+			sizeof(size)) {
+		if (size > max - len) {
+			/* report a sample that can never fit */
+			if (!len)
+				return -EINVAL;
+			break;
+		}
+
+		if (kfifo_to_user(&profile->sample_fifo, ubuf + len, size,
+					&copied)) {
+			/* a partly copied sample would desync the stream */
+			kfifo_reset_out(&profile->sample_fifo);
+			return len ? len : -EFAULT;
+		}
+		len += copied;
+	}
+
+	return len;
+}
+
+static ssize_t profile_sample_read(struct file *filep, char __user *ubuf,
+		size_t max, loff_t *ppos)
+{
+	struct adreno_device *adreno_dev = _sample_adreno_dev(filep);
+	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
+	struct adreno_profile *profile = &adreno_dev->profile;
+	ssize_t ret;
+
+	for (;;) {
+		mutex_lock(&device->mutex);
+		if (!kfifo_initialized(&profile->sample_fifo)) {
+			ret = -ENODATA;
+		} else {
+			adreno_profile_process_results(adreno_dev);
+			ret = _sample_copy(profile, ubuf, max);
+		}
+		mutex_unlock(&device->mutex);
+
+		if (ret)
+			return ret;
+
+		if (filep->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		/* samples arrive as later submissions collect results */
+		ret = wait_event_interruptible(profile->sample_wait,
+				!kfifo_is_empty(&profile->sample_fifo));
+		if (ret)
+			return ret;
+	}
+}
+
+static unsigned int profile_sample_poll(struct file *filep,
+		struct poll_table_struct *wait)
+{
+	struct adreno_device *adreno_dev = _sample_adreno_dev(filep);
+	struct adreno_profile *profile = &adreno_dev->profile;
+
+	poll_wait(filep, &profile->sample_wait, wait);
+
+	if (kfifo_initialized(&profile->sample_fifo) &&
+			!kfifo_is_empty(&profile->sample_fifo))
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
+static int profile_sample_release(struct inode *inode, struct file *filep)
+{
+	struct adreno_device *adreno_dev = _sample_adreno_dev(filep);
+	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
+
+	/* counters are not left assigned after the profiler goes away */
+	mutex_lock(&device->mutex);
+	if (adreno_dev->profile.sample_owner == filep)
+		_sample_stop(adreno_dev);
+	mutex_unlock(&device->mutex);
+
+	return 0;
+}
+
+static const struct file_operations profile_sample_fops = {
+	.owner = THIS_MODULE,
+	.read = profile_sample_read,
+	.poll = profile_sample_poll,
+	.unlocked_ioctl = profile_sample_ioctl,
+	.compat_ioctl = profile_sample_ioctl,
+	.release = profile_sample_release,
+	.llseek = noop_llseek,
+};
+
+static void _sample_init(struct adreno_profile *profile)
+{
+	init_waitqueue_head(&profile->sample_wait);
+
+	profile->sample_dev.minor = MISC_DYNAMIC_MINOR;
+	profile->sample_dev.name = "kgsl-profile";
+	profile->sample_dev.fops = &profile_sample_fops;
+	if (misc_register(&profile->sample_dev))
+		profile->sample_dev.fops = NULL;
+}
+
+static void _sample_close(struct adreno_profile *profile)
+{
+	if (profile->sample_dev.fops)
+		misc_deregister(&profile->sample_dev);
+	profile->sample_dev.fops = NULL;
+	profile->sampling = false;
+	kfifo_free(&profile->sample_fifo);
+}
+#else
+static inline void _sample_init(struct adreno_profile *profile) { }
+static inline void _sample_close(struct adreno_profile *profile) { }
+#endif
+
 void adreno_profile_init(struct adreno_device *adreno_dev)
 {
 	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
@@ -1070,6 +1399,8 @@ void adreno_profile_init(struct adreno_device *adreno_dev)
 
 	INIT_LIST_HEAD(&profile->assignments_list);
 
+	_sample_init(profile);
+
 	/* Create perf counter debugfs */
 	profile_dir = debugfs_create_dir("profiling", device->d_debugfs);
 	if (IS_ERR(profile_dir))
@@ -1090,6 +1421,7 @@ void adreno_profile_close(struct adreno_device *adreno_dev)
 	struct adreno_profile *profile = &adreno_dev->profile;
 	struct adreno_profile_assigns_list *entry, *tmp;
 
+	_sample_close(profile);
 	profile->enabled = false;
 	vfree(profile->log_buffer);
 	profile->log_buffer = NULL;
@@ -1143,6 +1475,14 @@ void adreno_profile_preib_processing(struct adreno_device *adreno_dev,
 	if (!adreno_profile_assignments_ready(profile))
 		goto done;
 
+#ifdef CONFIG_QCOM_KGSL_PROFILE_SAMPLING
+	/* sample one in sample_interval submissions of each context */
+	if (profile->sampling &&
+			++drawctxt->profile_submits < profile->sample_interval)
+		goto done;
+	drawctxt->profile_submits = 0;
+#endif
+
 	/*
 	 * check if space available, include the post_ib in space available
 	 * check so don't have to handle trying to undo the pre_ib insertion in
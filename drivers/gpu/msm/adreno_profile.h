@@ -13,6 +13,9 @@
 #ifndef __ADRENO_PROFILE_H
 #define __ADRENO_PROFILE_H
 #include <linux/seq_file.h>
+#include <linux/kfifo.h>
+#include <linux/miscdevice.h>
+#include <linux/wait.h>
 
 /**
  * struct adreno_profile_assigns_list: linked list for assigned perf counters
@@ -52,6 +55,16 @@ struct adreno_profile {
 	unsigned int shared_head;
 	unsigned int shared_tail;
 	unsigned int shared_size;
+#ifdef CONFIG_QCOM_KGSL_PROFILE_SAMPLING
+	/* binary samples for /dev/kgsl-profile, under the device mutex */
+	struct miscdevice sample_dev;
+	struct kfifo sample_fifo;
+	wait_queue_head_t sample_wait;
+	struct file *sample_owner;
+	unsigned int sample_interval;
+	unsigned int sample_dropped;
+	bool sampling;
+#endif
 };
 
 #define ADRENO_PROFILE_SHARED_BUF_SIZE_DWORDS (48 * 4096 / sizeof(uint))
@@ -62,7 +75,10 @@ struct adreno_profile {
 #define ADRENO_PROFILE_LOG_BUF_SIZE_DWORDS  (ADRENO_PROFILE_LOG_BUF_SIZE / \
 						sizeof(unsigned int))
 
-#ifdef CONFIG_DEBUG_FS
+/* Holds about 2000 samples of 16 counters for /dev/kgsl-profile */
+#define ADRENO_PROFILE_SAMPLE_FIFO_SIZE  (256 * 1024)
+
+#ifdef CONFIG_QCOM_KGSL_PROFILE
 void adreno_profile_init(struct adreno_device *adreno_dev);
 void adreno_profile_close(struct adreno_device *adreno_dev);
 int adreno_profile_process_results(struct  adreno_device *adreno_dev);
@@ -465,7 +465,7 @@ static size_t snapshot_rb(struct kgsl_device *device, u8 *buf,
 	header->gpuaddr = rb->buffer_desc.gpuaddr;
 	header->id = rb->id;
 
-	if (rb == adreno_dev->cur_rb)
+	if (rb == adreno_dev->cur_rb && !snapshot->minimal)
 		snapshot_rb_ibs(device, rb, snapshot);
 
 	/* Just copy the ringbuffer, there are no active IBs */
@@ -912,6 +912,14 @@ void adreno_snapshot(struct kgsl_device *device, struct kgsl_snapshot *snapshot,
 	kgsl_snapshot_add_section(device, KGSL_SNAPSHOT_SECTION_GPU_OBJECT_V2,
 			snapshot, snapshot_global, &device->memstore);
 
+	/*
+	 * A minimal snapshot stops at the fault registers, the ringbuffers
+	 * and the memstore timestamps. The IB1/IB2 base and size are in the
+	 * register dump; the IBs and the other GPU buffers are not parsed.
+	 */
+	if (snapshot->minimal)
+		goto done;
+
 	kgsl_snapshot_add_section(device, KGSL_SNAPSHOT_SECTION_GPU_OBJECT_V2,
 			snapshot, snapshot_global,
 			&adreno_dev->pwron_fixup);
@@ -997,6 +1005,7 @@ void adreno_snapshot(struct kgsl_device *device, struct kgsl_snapshot *snapshot,
 		KGSL_CORE_ERR("GPU snapshot froze %zdKb of GPU buffers\n",
 			snapshot_frozen_objsize / 1024);
 
+done:
 	if (device->pwrctrl.ahbpath_pcl)
 		msm_bus_scale_client_update_request(device->pwrctrl.ahbpath_pcl,
 			KGSL_AHB_PATH_LOW);
@@ -52,6 +52,36 @@ TRACE_EVENT(adreno_cmdbatch_queued,
 	)
 );
 
+TRACE_EVENT(adreno_cmdbatch_sched,
+	TP_PROTO(struct kgsl_drawobj *drawobj, s64 delay,
+		uint64_t gpu_time, uint64_t budget_time, bool throttled),
+	TP_ARGS(drawobj, delay, gpu_time, budget_time, throttled),
+	TP_STRUCT__entry(
+		__field(unsigned int, id)
+		__field(unsigned int, timestamp)
+		__field(unsigned int, prio)
+		__field(s64, delay)
+		__field(uint64_t, gpu_time)
+		__field(uint64_t, budget_time)
+		__field(bool, throttled)
+	),
+	TP_fast_assign(
+		__entry->id = drawobj->context->id;
+		__entry->timestamp = drawobj->timestamp;
+		__entry->prio = drawobj->context->priority;
+		__entry->delay = delay;
+		__entry->gpu_time = div_u64(gpu_time, NSEC_PER_USEC);
+		__entry->budget_time = div_u64(budget_time, NSEC_PER_USEC);
+		__entry->throttled = throttled;
+	),
+	TP_printk(
+		"ctx=%u ctx_prio=%u ts=%u queue_delay_us=%lld gpu_time_us=%llu budget_used_us=%llu throttled=%d",
+			__entry->id, __entry->prio, __entry->timestamp,
+			__entry->delay, __entry->gpu_time,
+			__entry->budget_time, __entry->throttled
+	)
+);
+
 TRACE_EVENT(adreno_cmdbatch_submitted,
 	TP_PROTO(struct kgsl_drawobj *drawobj, int inflight, uint64_t ticks,
 		unsigned long secs, unsigned long usecs,
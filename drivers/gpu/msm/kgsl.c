@@ -16,6 +16,7 @@
 #include <linux/fs.h>
 #include <linux/fdtable.h>
 #include <linux/list.h>
+#include <linux/lat_hist.h>
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
 #include <linux/interrupt.h>
@@ -106,6 +107,9 @@ static inline struct kgsl_pagetable *_get_memdesc_pagetable(
 }
 
 static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry);
+static void kgsl_mem_entry_remove_id(struct kgsl_mem_entry *entry);
+static void _kgsl_mem_entry_free(struct kgsl_mem_entry *entry,
+		unsigned int memtype);
 
 static const struct file_operations kgsl_fops;
 
@@ -356,6 +360,100 @@ static void kgsl_destroy_ion(struct kgsl_dma_buf_meta *meta)
 }
 #endif
 
+/*
+ * Freed buffers are unmapped in batches so that a burst of frees, like a
+ * game tearing down a level, pays for one TLB invalidate per pagetable
+ * instead of one per buffer. A buffer waits at most KGSL_UNMAP_DELAY_MS
+ * before it is unmapped, or less once KGSL_UNMAP_BATCH of them are pending.
+ * The pages and the GPU address are only given back after the invalidate.
+ */
+#define KGSL_UNMAP_BATCH 64
+#define KGSL_UNMAP_DELAY_MS 4
+
+static void _kgsl_unmap_work(struct work_struct *work);
+
+static struct {
+	struct llist_head list;
+	atomic_t pending;
+	struct delayed_work work;
+} kgsl_unmap_queue = {
+	.work = __DELAYED_WORK_INITIALIZER(kgsl_unmap_queue.work,
+		_kgsl_unmap_work, 0),
+};
+
+static void _kgsl_unmap_work(struct work_struct *work)
+{
+	struct llist_node *list;
+	struct kgsl_mem_entry *entry, *tmp;
+	struct kgsl_pagetable *pagetable = NULL;
+
+	list = llist_reverse_order(llist_del_all(&kgsl_unmap_queue.list));
+
+	llist_for_each_entry(entry, list, unmap_node) {
+		struct kgsl_process_private *private = entry->priv;
+		u64 start = ktime_get_ns();
+
+		atomic_dec(&kgsl_unmap_queue.pending);
+
+		/* Pagetables without deferred invalidates unmap right away */
+		if (kgsl_mmu_unmap_deferred(entry->memdesc.pagetable,
+					&entry->memdesc) == -EOPNOTSUPP)
+			kgsl_mmu_put_gpuaddr(&entry->memdesc);
+
+		trace_kgsl_mem_iommu_map(entry, true,
+			kgsl_process_account_time(
+				&private->memstats.unmap_count,
+				&private->memstats.unmap_ns, start));
+	}
+
+	/* Entries of one process are usually next to each other */
+	llist_for_each_entry(entry, list, unmap_node) {
+		if (entry->memdesc.pagetable &&
+			entry->memdesc.pagetable != pagetable) {
+			pagetable = entry->memdesc.pagetable;
+			kgsl_mmu_tlb_sync(pagetable);
+		}
+	}
+
+	llist_for_each_entry_safe(entry, tmp, list, unmap_node) {
+		kgsl_mmu_put_gpuaddr_deferred(&entry->memdesc);
+
+		kgsl_process_private_put(entry->priv);
+		entry->priv = NULL;
+
+		_kgsl_mem_entry_free(entry,
+			kgsl_memdesc_usermem_type(&entry->memdesc));
+	}
+}
+
+/* Queue a released entry for batched unmapping if it can be */
+static bool kgsl_mem_entry_defer_unmap(struct kgsl_mem_entry *entry)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+
+	if (entry->priv == NULL || memdesc->gpuaddr == 0 ||
+		kgsl_memdesc_is_global(memdesc) ||
+		kgsl_memdesc_is_secured(memdesc) ||
+		!(memdesc->priv & KGSL_MEMDESC_MAPPED) ||
+		(memdesc->flags & (KGSL_MEMFLAGS_SPARSE_VIRT |
+				KGSL_MEMFLAGS_SPARSE_PHYS)))
+		return false;
+
+	kgsl_mem_entry_remove_id(entry);
+
+	llist_add(&entry->unmap_node, &kgsl_unmap_queue.list);
+
+	if (atomic_inc_return(&kgsl_unmap_queue.pending) >= KGSL_UNMAP_BATCH)
+		mod_delayed_work(kgsl_driver.mem_workqueue,
+			&kgsl_unmap_queue.work, 0);
+	else
+		queue_delayed_work(kgsl_driver.mem_workqueue,
+			&kgsl_unmap_queue.work,
+			msecs_to_jiffies(KGSL_UNMAP_DELAY_MS));
+
+	return true;
+}
+
 void
 kgsl_mem_entry_destroy(struct kref *kref)
 {
@@ -374,9 +472,19 @@ kgsl_mem_entry_destroy(struct kref *kref)
 		kgsl_process_sub_stats(entry->priv, memtype,
 			entry->memdesc.size);
 
+	if (kgsl_mem_entry_defer_unmap(entry))
+		return;
+
 	/* Detach from process list */
 	kgsl_mem_entry_detach_process(entry);
 
+	_kgsl_mem_entry_free(entry, memtype);
+}
+
+/* Free an entry that has been detached from its process */
+static void _kgsl_mem_entry_free(struct kgsl_mem_entry *entry,
+		unsigned int memtype)
+{
 	if (memtype != KGSL_MEM_ENTRY_KERNEL)
 		atomic_long_sub(entry->memdesc.size,
 			&kgsl_driver.stats.mapped);
@@ -500,9 +608,18 @@ static int kgsl_mem_entry_attach_process(struct kgsl_device *device,
 				entry->memdesc.pagetable,
 				&entry->memdesc, 0,
 				kgsl_memdesc_footprint(&entry->memdesc));
-		else if (entry->memdesc.gpuaddr)
+		else if (entry->memdesc.gpuaddr) {
+			u64 start = ktime_get_ns();
+
 			ret = kgsl_mmu_map(entry->memdesc.pagetable,
 					&entry->memdesc);
+			if (!ret)
+				trace_kgsl_mem_iommu_map(entry, false,
+					kgsl_process_account_time(
+						&process->memstats.map_count,
+						&process->memstats.map_ns,
+						start));
+		}
 
 		if (ret)
 			kgsl_mem_entry_detach_process(entry);
@@ -514,12 +631,9 @@ static int kgsl_mem_entry_attach_process(struct kgsl_device *device,
 	return ret;
 }
 
-/* Detach a memory entry from a process and unmap it from the MMU */
-static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
+/* Remove a memory entry from the mem_idr of its process */
+static void kgsl_mem_entry_remove_id(struct kgsl_mem_entry *entry)
 {
-	if (entry == NULL)
-		return;
-
 	/*
 	 * First remove the entry from mem_idr list
 	 * so that no one can operate on obsolete values
@@ -533,8 +647,26 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 			&entry->priv->gpumem_mapped);
 
 	spin_unlock(&entry->priv->mem_lock);
+}
+
+/* Detach a memory entry from a process and unmap it from the MMU */
+static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
+{
+	if (entry == NULL)
+		return;
+
+	kgsl_mem_entry_remove_id(entry);
 
-	kgsl_mmu_put_gpuaddr(&entry->memdesc);
+	if (entry->memdesc.gpuaddr) {
+		u64 start = ktime_get_ns();
+
+		kgsl_mmu_put_gpuaddr(&entry->memdesc);
+		trace_kgsl_mem_iommu_map(entry, true,
+			kgsl_process_account_time(
+				&entry->priv->memstats.unmap_count,
+				&entry->priv->memstats.unmap_ns, start));
+	} else
+		kgsl_mmu_put_gpuaddr(&entry->memdesc);
 
 	kgsl_process_private_put(entry->priv);
 
@@ -1886,47 +2018,32 @@ done:
 	return result;
 }
 
-long kgsl_ioctl_gpu_command(struct kgsl_device_private *dev_priv,
-		unsigned int cmd, void *data)
+/*
+ * Create the sync and command objects described by a kgsl_gpu_command and
+ * append them to drawobj. On failure the objects created so far are left in
+ * drawobj for the caller to destroy.
+ */
+static long _gpu_command_create(struct kgsl_device *device,
+		struct kgsl_context *context, struct kgsl_gpu_command *param,
+		unsigned int type, struct kgsl_drawobj *drawobj[],
+		unsigned int *count)
 {
-	struct kgsl_gpu_command *param = data;
-	struct kgsl_device *device = dev_priv->device;
-	struct kgsl_context *context;
-	struct kgsl_drawobj *drawobj[2];
-	unsigned int type;
 	long result;
-	unsigned int i = 0;
-
-	type = _process_command_input(device, param->flags, param->numcmds,
-			param->numobjs, param->numsyncs);
-	if (!type)
-		return -EINVAL;
-
-	context = kgsl_context_get_owner(dev_priv, param->context_id);
-	if (context == NULL)
-		return -EINVAL;
-
-	if (_check_context_is_sparse(context, param->flags)) {
-		kgsl_context_put(context);
-		return -EINVAL;
-	}
 
 	if (type & SYNCOBJ_TYPE) {
 		struct kgsl_drawobj_sync *syncobj =
 				kgsl_drawobj_sync_create(device, context);
 
-		if (IS_ERR(syncobj)) {
-			result = PTR_ERR(syncobj);
-			goto done;
-		}
+		if (IS_ERR(syncobj))
+			return PTR_ERR(syncobj);
 
-		drawobj[i++] = DRAWOBJ(syncobj);
+		drawobj[(*count)++] = DRAWOBJ(syncobj);
 
 		result = kgsl_drawobj_sync_add_synclist(device, syncobj,
 				to_user_ptr(param->synclist),
 				param->syncsize, param->numsyncs);
 		if (result)
-			goto done;
+			return result;
 	}
 
 	if (type & (CMDOBJ_TYPE | MARKEROBJ_TYPE)) {
@@ -1934,24 +2051,22 @@ long kgsl_ioctl_gpu_command(struct kgsl_device_private *dev_priv,
 				kgsl_drawobj_cmd_create(device,
 					context, param->flags, type);
 
-		if (IS_ERR(cmdobj)) {
-			result = PTR_ERR(cmdobj);
-			goto done;
-		}
+		if (IS_ERR(cmdobj))
+			return PTR_ERR(cmdobj);
 
-		drawobj[i++] = DRAWOBJ(cmdobj);
+		drawobj[(*count)++] = DRAWOBJ(cmdobj);
 
 		result = kgsl_drawobj_cmd_add_cmdlist(device, cmdobj,
 			to_user_ptr(param->cmdlist),
 			param->cmdsize, param->numcmds);
 		if (result)
-			goto done;
+			return result;
 
 		result = kgsl_drawobj_cmd_add_memlist(device, cmdobj,
 			to_user_ptr(param->objlist),
 			param->objsize, param->numobjs);
 		if (result)
-			goto done;
+			return result;
 
 		/* If no profiling buffer was specified, clear the flag */
 		if (cmdobj->profiling_buf_entry == NULL)
@@ -1959,6 +2074,42 @@ long kgsl_ioctl_gpu_command(struct kgsl_device_private *dev_priv,
 				~(unsigned long)KGSL_DRAWOBJ_PROFILING;
 	}
 
+	return 0;
+}
+
+/* time to create and queue the objects of a submission */
+static DEFINE_LAT_HIST(kgsl_submit_hist, "kgsl_submit");
+
+long kgsl_ioctl_gpu_command(struct kgsl_device_private *dev_priv,
+		unsigned int cmd, void *data)
+{
+	struct kgsl_gpu_command *param = data;
+	struct kgsl_device *device = dev_priv->device;
+	struct kgsl_context *context;
+	struct kgsl_drawobj *drawobj[2];
+	unsigned int type;
+	long result;
+	unsigned int i = 0;
+	u64 lat_start = lat_hist_start();
+
+	type = _process_command_input(device, param->flags, param->numcmds,
+			param->numobjs, param->numsyncs);
+	if (!type)
+		return -EINVAL;
+
+	context = kgsl_context_get_owner(dev_priv, param->context_id);
+	if (context == NULL)
+		return -EINVAL;
+
+	if (_check_context_is_sparse(context, param->flags)) {
+		kgsl_context_put(context);
+		return -EINVAL;
+	}
+
+	result = _gpu_command_create(device, context, param, type, drawobj, &i);
+	if (result)
+		goto done;
+
 	result = device->ftbl->queue_cmds(dev_priv, context, drawobj,
 				i, &param->timestamp);
 
@@ -1970,11 +2121,162 @@ done:
 	if (result && result != -EPROTO)
 		while (i--)
 			kgsl_drawobj_destroy(drawobj[i]);
+	else
+		lat_hist_end(&kgsl_submit_hist, lat_start);
 
 	kgsl_context_put(context);
 	return result;
 }
 
+/* Queue one entry of a command batch */
+static long _gpu_command_batch_queue(struct kgsl_device_private *dev_priv,
+		struct kgsl_context *context,
+		struct kgsl_gpu_command_batch *batch,
+		struct kgsl_gpu_command *param, unsigned int type, bool first)
+{
+	struct kgsl_device *device = dev_priv->device;
+	struct kgsl_drawobj *drawobj[3];
+	unsigned int i = 0;
+	long result = 0;
+
+	/*
+	 * The shared syncpoints gate the first command of each context in
+	 * the batch; the commands after it are ordered behind it anyway.
+	 */
+	if (first && batch->numsyncs) {
+		struct kgsl_drawobj_sync *syncobj =
+				kgsl_drawobj_sync_create(device, context);
+
+		if (IS_ERR(syncobj))
+			return PTR_ERR(syncobj);
+
+		drawobj[i++] = DRAWOBJ(syncobj);
+
+		result = kgsl_drawobj_sync_add_synclist(device, syncobj,
+				to_user_ptr(batch->synclist),
+				batch->syncsize, batch->numsyncs);
+		if (result)
+			goto done;
+	}
+
+	result = _gpu_command_create(device, context, param, type, drawobj, &i);
+	if (result)
+		goto done;
+
+	if (device->ftbl->queue_cmds_deferred)
+		result = device->ftbl->queue_cmds_deferred(dev_priv, context,
+				drawobj, i, &param->timestamp);
+	else
+		result = device->ftbl->queue_cmds(dev_priv, context,
+				drawobj, i, &param->timestamp);
+
+done:
+	if (result && result != -EPROTO)
+		while (i--)
+			kgsl_drawobj_destroy(drawobj[i]);
+
+	return result;
+}
+
+long kgsl_ioctl_gpu_command_batch(struct kgsl_device_private *dev_priv,
+		unsigned int cmd, void *data)
+{
+	struct kgsl_gpu_command_batch *param = data;
+	struct kgsl_device *device = dev_priv->device;
+	struct kgsl_context *context = NULL;
+	struct kgsl_gpu_command __user *ptr = to_user_ptr(param->cmdlist);
+	unsigned int *seen;
+	unsigned int i, j, nseen = 0;
+	long result = 0;
+	bool faulted = false;
+
+	param->count = 0;
+
+	if (param->flags || !param->numcmds ||
+		param->numcmds > KGSL_GPU_COMMAND_BATCH_MAX ||
+		param->numsyncs > KGSL_MAX_SYNCPOINTS ||
+		param->cmdsize < sizeof(struct kgsl_gpu_command))
+		return -EINVAL;
+
+	seen = kcalloc(param->numcmds, sizeof(*seen), GFP_KERNEL);
+	if (seen == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < param->numcmds; i++) {
+		struct kgsl_gpu_command gpucmd;
+		unsigned int type;
+		bool first = true;
+
+		result = kgsl_copy_from_user(&gpucmd, ptr, sizeof(gpucmd),
+				param->cmdsize);
+		if (result)
+			break;
+
+		type = _process_command_input(device, gpucmd.flags,
+				gpucmd.numcmds, gpucmd.numobjs, gpucmd.numsyncs);
+		if (!type) {
+			result = -EINVAL;
+			break;
+		}
+
+		/* Batches usually hit one context back to back */
+		if (context == NULL || context->id != gpucmd.context_id) {
+			kgsl_context_put(context);
+			context = kgsl_context_get_owner(dev_priv,
+				gpucmd.context_id);
+			if (context == NULL) {
+				result = -EINVAL;
+				break;
+			}
+		}
+
+		if (_check_context_is_sparse(context, gpucmd.flags)) {
+			result = -EINVAL;
+			break;
+		}
+
+		for (j = 0; j < nseen; j++) {
+			if (seen[j] == gpucmd.context_id) {
+				first = false;
+				break;
+			}
+		}
+
+		result = _gpu_command_batch_queue(dev_priv, context, param,
+				&gpucmd, type, first);
+		if (result == -EPROTO) {
+			faulted = true;
+			result = 0;
+		} else if (result)
+			break;
+
+		if (first)
+			seen[nseen++] = gpucmd.context_id;
+
+		param->count++;
+
+		if (put_user(gpucmd.timestamp, &ptr->timestamp)) {
+			result = -EFAULT;
+			break;
+		}
+
+		ptr = (void __user *) ptr + param->cmdsize;
+	}
+
+	kgsl_context_put(context);
+	kfree(seen);
+
+	/* One trip through the dispatcher for the whole batch */
+	if (param->count && device->ftbl->queue_cmds_deferred &&
+		device->ftbl->submit_pending)
+		device->ftbl->submit_pending(device);
+
+	if (!result && faulted)
+		result = -EPROTO;
+
+	return result;
+}
+
 long kgsl_ioctl_cmdstream_readtimestamp_ctxtid(struct kgsl_device_private
 						*dev_priv, unsigned int cmd,
 						void *data)
@@ -3314,6 +3616,7 @@ struct kgsl_mem_entry *gpumem_alloc_entry(
 	struct kgsl_mem_entry *entry;
 	struct kgsl_mmu *mmu = &dev_priv->device->mmu;
 	unsigned int align;
+	u64 start, delta;
 
 	flags &= KGSL_MEMFLAGS_GPUREADONLY
 		| KGSL_CACHEMODE_MASK
@@ -3354,11 +3657,15 @@ struct kgsl_mem_entry *gpumem_alloc_entry(
 	if (entry == NULL)
 		return ERR_PTR(-ENOMEM);
 
+	start = ktime_get_ns();
+
 	ret = kgsl_allocate_user(dev_priv->device, &entry->memdesc,
 		size, flags);
 	if (ret != 0)
 		goto err;
 
+	delta = ktime_get_ns() - start;
+
 	ret = kgsl_mem_entry_attach_process(dev_priv->device, private, entry);
 	if (ret != 0) {
 		kgsl_sharedmem_free(&entry->memdesc);
@@ -3368,7 +3675,9 @@ struct kgsl_mem_entry *gpumem_alloc_entry(
 	kgsl_process_add_stats(private,
 			kgsl_memdesc_usermem_type(&entry->memdesc),
 			entry->memdesc.size);
+	kgsl_process_add_page_stats(private, &entry->memdesc, delta);
 	trace_kgsl_mem_alloc(entry);
+	trace_kgsl_mem_alloc_pages(entry, delta);
 
 	kgsl_mem_entry_commit_process(entry);
 	return entry;
@@ -4377,15 +4686,24 @@ kgsl_gpumem_vm_fault(struct vm_fault *vmf)
 {
 	struct kgsl_mem_entry *entry = vmf->vma->vm_private_data;
 	int ret;
+	u64 start;
 
 	if (!entry)
 		return VM_FAULT_SIGBUS;
 	if (!entry->memdesc.ops || !entry->memdesc.ops->vmfault)
 		return VM_FAULT_SIGBUS;
 
+	start = ktime_get_ns();
+
 	ret = entry->memdesc.ops->vmfault(&entry->memdesc, vmf->vma, vmf);
-	if ((ret == 0) || (ret == VM_FAULT_NOPAGE))
+	if ((ret == 0) || (ret == VM_FAULT_NOPAGE)) {
 		atomic64_add(PAGE_SIZE, &entry->priv->gpumem_mapped);
+		trace_kgsl_mem_vmfault(entry,
+			vmf->address - vmf->vma->vm_start,
+			kgsl_process_account_time(
+				&entry->priv->memstats.fault_pages,
+				&entry->priv->memstats.fault_ns, start));
+	}
 
 	return ret;
 }
@@ -4469,6 +4787,7 @@ static unsigned long _gpu_set_svm_region(struct kgsl_process_private *private,
 		unsigned long size)
 {
 	int ret;
+	u64 start;
 
 	ret = kgsl_mmu_set_svm_region(private->pagetable, (uint64_t) addr,
 		(uint64_t) size);
@@ -4479,12 +4798,18 @@ static unsigned long _gpu_set_svm_region(struct kgsl_process_private *private,
 	entry->memdesc.gpuaddr = (uint64_t) addr;
 	entry->memdesc.pagetable = private->pagetable;
 
+	start = ktime_get_ns();
+
 	ret = kgsl_mmu_map(private->pagetable, &entry->memdesc);
 	if (ret) {
 		kgsl_mmu_put_gpuaddr(&entry->memdesc);
 		return ret;
 	}
 
+	trace_kgsl_mem_iommu_map(entry, false,
+		kgsl_process_account_time(&private->memstats.map_count,
+			&private->memstats.map_ns, start));
+
 	kgsl_memfree_purge(private->pagetable, entry->memdesc.gpuaddr,
 		entry->memdesc.size);
 
@@ -5096,6 +5421,7 @@ EXPORT_SYMBOL(kgsl_device_platform_remove);
 
 static void kgsl_core_exit(void)
 {
+	lat_hist_unregister(&kgsl_submit_hist);
 	kgsl_events_exit();
 	kgsl_core_debugfs_close();
 
@@ -5115,6 +5441,8 @@ static void kgsl_core_exit(void)
 		kgsl_driver.class = NULL;
 	}
 
+	flush_delayed_work(&kgsl_unmap_queue.work);
+
 	kgsl_drawobjs_cache_exit();
 
 	kgsl_memfree_exit();
@@ -5213,6 +5541,7 @@ static int __init kgsl_core_init(void)
 		goto err;
 
 	kgsl_memfree_init();
+	lat_hist_register(&kgsl_submit_hist);
 
 	place_marker("M - DRIVER KGSL Ready");
 
@@ -26,6 +26,7 @@
 #include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/kthread.h>
+#include <linux/llist.h>
 #include <asm/cacheflush.h>
 #include <linux/compat.h>
 
@@ -214,6 +215,7 @@ struct kgsl_memdesc_ops {
  * @attrs: dma attributes for this memory
  * @pages: An array of pointers to allocated pages
  * @page_count: Total number of pages allocated
+ * @pool_pages: Number of the allocated pages that came from the kgsl pools
  * @cur_bindings: Number of sparse pages actively bound
  */
 struct kgsl_memdesc {
@@ -234,6 +236,7 @@ struct kgsl_memdesc {
 	unsigned long attrs;
 	struct page **pages;
 	unsigned int page_count;
+	unsigned int pool_pages;
 	unsigned int cur_bindings;
 };
 
@@ -270,6 +273,7 @@ struct kgsl_memdesc {
  * @work: Work struct used to schedule a kgsl_mem_entry_put in atomic contexts
  * @bind_lock: Lock for sparse memory bindings
  * @bind_tree: RB Tree for sparse memory bindings
+ * @unmap_node: Node in the deferred unmap queue once the entry is released
  */
 struct kgsl_mem_entry {
 	struct kref refcount;
@@ -283,6 +287,7 @@ struct kgsl_mem_entry {
 	struct work_struct work;
 	spinlock_t bind_lock;
 	struct rb_root bind_tree;
+	struct llist_node unmap_node;
 };
 
 struct kgsl_device_private;
@@ -440,6 +445,8 @@ long kgsl_ioctl_sparse_unbind(struct kgsl_device_private *dev_priv,
 					unsigned int cmd, void *data);
 long kgsl_ioctl_gpu_sparse_command(struct kgsl_device_private *dev_priv,
 					unsigned int cmd, void *data);
+long kgsl_ioctl_gpu_command_batch(struct kgsl_device_private *dev_priv,
+					unsigned int cmd, void *data);
 
 void kgsl_mem_entry_destroy(struct kref *kref);
 
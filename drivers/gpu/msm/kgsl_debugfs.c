@@ -361,6 +361,73 @@ static const struct file_operations process_sparse_mem_fops = {
 	.release = process_mem_release,
 };
 
+static int process_memstats_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_process_private *private = s->private;
+	struct kgsl_process_memstats *stats = &private->memstats;
+	u64 pool = atomic64_read(&stats->pool_pages);
+	u64 system = atomic64_read(&stats->system_pages);
+	static const struct {
+		int type;
+		const char *name;
+	} types[] = {
+		{ KGSL_MEM_ENTRY_KERNEL, "kernel" },
+		{ KGSL_MEM_ENTRY_USER, "user" },
+		{ KGSL_MEM_ENTRY_ION, "ion" },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(types); i++)
+		seq_printf(s, "%-16s %llu (max %llu)\n", types[i].name,
+			(u64) atomic64_read(&private->stats[types[i].type].cur),
+			(u64) atomic64_read(&private->stats[types[i].type].max));
+
+	seq_printf(s, "%-16s %llu\n", "mapped",
+		(u64) atomic64_read(&private->gpumem_mapped));
+	seq_printf(s, "%-16s %llu\n", "pool_pages", pool);
+	seq_printf(s, "%-16s %llu\n", "system_pages", system);
+	seq_printf(s, "%-16s %llu%%\n", "pool_hit",
+		(pool + system) ? div64_u64(pool * 100, pool + system) : 0);
+	seq_printf(s, "%-16s %llu\n", "alloc_us",
+		div_u64(atomic64_read(&stats->alloc_ns), NSEC_PER_USEC));
+	seq_printf(s, "%-16s %llu (%llu us)\n", "iommu_map",
+		(u64) atomic64_read(&stats->map_count),
+		div_u64(atomic64_read(&stats->map_ns), NSEC_PER_USEC));
+	seq_printf(s, "%-16s %llu (%llu us)\n", "iommu_unmap",
+		(u64) atomic64_read(&stats->unmap_count),
+		div_u64(atomic64_read(&stats->unmap_ns), NSEC_PER_USEC));
+	seq_printf(s, "%-16s %llu (%llu us)\n", "fault_pages",
+		(u64) atomic64_read(&stats->fault_pages),
+		div_u64(atomic64_read(&stats->fault_ns), NSEC_PER_USEC));
+
+	return 0;
+}
+
+static int process_memstats_open(struct inode *inode, struct file *file)
+{
+	int ret;
+	pid_t pid = (pid_t) (unsigned long) inode->i_private;
+	struct kgsl_process_private *private = NULL;
+
+	private = kgsl_process_private_find(pid);
+
+	if (!private)
+		return -ENODEV;
+
+	ret = single_open(file, process_memstats_print, private);
+	if (ret)
+		kgsl_process_private_put(private);
+
+	return ret;
+}
+
+static const struct file_operations process_memstats_fops = {
+	.open = process_memstats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = process_mem_release,
+};
+
 static int globals_print(struct seq_file *s, void *unused)
 {
 	kgsl_print_global_pt_entries(s);
@@ -432,6 +499,13 @@ void kgsl_process_init_debugfs(struct kgsl_process_private *private)
 		WARN((dentry == NULL),
 			"Unable to create 'sparse_mem' file for %s\n", name);
 
+	dentry = debugfs_create_file("memstats", 0444, private->debug_root,
+		(void *) ((unsigned long) private->pid),
+		&process_memstats_fops);
+
+	if (IS_ERR_OR_NULL(dentry))
+		WARN((dentry == NULL),
+			"Unable to create 'memstats' file for %s\n", name);
 }
 
 void kgsl_core_debugfs_init(void)
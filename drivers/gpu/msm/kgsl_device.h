@@ -165,6 +165,10 @@ struct kgsl_functable {
 						uint32_t *flags);
 	void (*drawctxt_detach)(struct kgsl_context *context);
 	void (*drawctxt_destroy)(struct kgsl_context *context);
+	int (*queue_cmds_deferred)(struct kgsl_device_private *dev_priv,
+		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
+		uint32_t count, uint32_t *timestamp);
+	void (*submit_pending)(struct kgsl_device *device);
 	void (*drawctxt_dump)(struct kgsl_device *device,
 		struct kgsl_context *context);
 	long (*ioctl)(struct kgsl_device_private *dev_priv,
@@ -314,6 +318,8 @@ struct kgsl_device {
 	bool snapshot_crashdumper;
 	/* Use HOST side register reads to get GPU snapshot*/
 	bool snapshot_legacy;
+	/* Capture only the fault state, not the GPU memory and debug dumps */
+	bool snapshot_minimal;
 
 	struct kobject snapshot_kobj;
 
@@ -441,6 +447,30 @@ struct kgsl_context {
 		_context_comm((_c)), \
 		(_c)->proc_priv->pid, ##args)
 
+/**
+ * struct kgsl_process_memstats - Costs of the GPU memory of a process
+ * @pool_pages: Pages allocated from the kgsl page pools
+ * @system_pages: Pages that had to come from the page allocator
+ * @alloc_ns: Time spent allocating pages
+ * @map_count: Number of IOMMU map operations
+ * @map_ns: Time spent mapping into the IOMMU
+ * @unmap_count: Number of IOMMU unmap operations
+ * @unmap_ns: Time spent unmapping from the IOMMU
+ * @fault_pages: Pages mapped into userspace lazily on CPU faults
+ * @fault_ns: Time spent handling those faults
+ */
+struct kgsl_process_memstats {
+	atomic64_t pool_pages;
+	atomic64_t system_pages;
+	atomic64_t alloc_ns;
+	atomic64_t map_count;
+	atomic64_t map_ns;
+	atomic64_t unmap_count;
+	atomic64_t unmap_ns;
+	atomic64_t fault_pages;
+	atomic64_t fault_ns;
+};
+
 /**
  * struct kgsl_process_private -  Private structure for a KGSL process (across
  * all devices)
@@ -454,6 +484,7 @@ struct kgsl_context {
  * @kobj: Pointer to a kobj for the sysfs directory for this process
  * @debug_root: Pointer to the debugfs root for this process
  * @stats: Memory allocation statistics for this process
+ * @memstats: Allocation, IOMMU mapping and CPU fault costs for this process
  * @gpumem_mapped: KGSL memory mapped in the process address space
  * @syncsource_idr: sync sources created by this process
  * @syncsource_lock: Spinlock to protect the syncsource idr
@@ -476,6 +507,7 @@ struct kgsl_process_private {
 		atomic64_t cur;
 		atomic64_t max;
 	} stats[KGSL_MEM_ENTRY_MAX];
+	struct kgsl_process_memstats memstats;
 	atomic64_t gpumem_mapped;
 	struct idr syncsource_idr;
 	spinlock_t syncsource_lock;
@@ -545,6 +577,7 @@ struct kgsl_snapshot {
 	bool first_read;
 	bool gmu_fault;
 	bool recovered;
+	bool minimal;
 };
 
 /**
@@ -577,6 +610,28 @@ static inline void kgsl_process_add_stats(struct kgsl_process_private *priv,
 	add_mm_counter(current->mm, MM_UNRECLAIMABLE, (size >> PAGE_SHIFT));
 }
 
+/* Account where the pages of a new allocation came from */
+static inline void kgsl_process_add_page_stats(
+	struct kgsl_process_private *priv, struct kgsl_memdesc *memdesc,
+	u64 delta)
+{
+	atomic64_add(memdesc->pool_pages, &priv->memstats.pool_pages);
+	atomic64_add((memdesc->size >> PAGE_SHIFT) - memdesc->pool_pages,
+		&priv->memstats.system_pages);
+	atomic64_add(delta, &priv->memstats.alloc_ns);
+}
+
+/* Account one timed operation and return how long it took */
+static inline u64 kgsl_process_account_time(atomic64_t *count,
+	atomic64_t *total, u64 start)
+{
+	u64 delta = ktime_get_ns() - start;
+
+	atomic64_inc(count);
+	atomic64_add(delta, total);
+	return delta;
+}
+
 static inline void kgsl_process_sub_stats(struct kgsl_process_private *priv,
 	unsigned int type, uint64_t size)
 {
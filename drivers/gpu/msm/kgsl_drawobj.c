@@ -1098,6 +1098,12 @@ int kgsl_drawobj_cmd_add_memlist(struct kgsl_device *device,
 		if (ret)
 			return ret;
 
+		if (obj.flags & KGSL_OBJLIST_DEADLINE) {
+			cmdobj->deadline_ns = obj.offset;
+			ptr += sizeof(obj);
+			continue;
+		}
+
 		if (!(obj.flags & KGSL_OBJLIST_MEMOBJ)) {
 			KGSL_DRV_ERR(device,
 				"invalid memobj ctxt %d flags %d id %d offset %lld addr %lld size %lld\n",
@@ -68,6 +68,9 @@ struct kgsl_drawobj {
  * buffer
  * @submit_ticks: Variable to hold ticks at the time of
  *     command obj submit.
+ * @deadline_ns: CLOCK_MONOTONIC deadline of the frame this command ends, 0
+ *     if userspace gave no deadline
+ * @queued: Time the command was queued to its context
 
  */
 struct kgsl_drawobj_cmd {
@@ -83,6 +86,8 @@ struct kgsl_drawobj_cmd {
 	uint64_t profiling_buffer_gpuaddr;
 	unsigned int profile_index;
 	uint64_t submit_ticks;
+	uint64_t deadline_ns;
+	ktime_t queued;
 };
 
 /**
@@ -97,6 +97,8 @@ static const struct kgsl_ioctl kgsl_ioctl_funcs[] = {
 			kgsl_ioctl_sparse_bind),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPU_SPARSE_COMMAND,
 			kgsl_ioctl_gpu_sparse_command),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPU_COMMAND_BATCH,
+			kgsl_ioctl_gpu_command_batch),
 };
 
 long kgsl_ioctl_copy_in(unsigned int kernel_cmd, unsigned int user_cmd,
@@ -172,7 +174,8 @@ long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
 	long ret;
 
-	if (cmd == IOCTL_KGSL_GPU_COMMAND &&
+	if ((cmd == IOCTL_KGSL_GPU_COMMAND ||
+		cmd == IOCTL_KGSL_GPU_COMMAND_BATCH) &&
 	    READ_ONCE(device->state) != KGSL_STATE_ACTIVE)
 		kgsl_schedule_work(&adreno_dev->pwr_on_work);
 
@@ -1383,6 +1383,7 @@ static int _init_per_process_pt(struct kgsl_mmu *mmu, struct kgsl_pagetable *pt)
 	struct kgsl_iommu *iommu = _IOMMU_PRIV(mmu);
 	struct kgsl_iommu_context *ctx = &iommu->ctx[KGSL_IOMMU_CONTEXT_USER];
 	int dynamic = 1;
+	int defer = 1;
 	unsigned int cb_num = ctx->cb_num;
 
 	iommu_pt = _alloc_pt(ctx->dev, mmu, pt);
@@ -1410,6 +1411,11 @@ static int _init_per_process_pt(struct kgsl_mmu *mmu, struct kgsl_pagetable *pt)
 		goto done;
 	}
 
+	/* Let freed buffers share one TLB invalidate - see kgsl_mmu_tlb_sync */
+	if (!iommu_domain_set_attr(iommu_pt->domain,
+				DOMAIN_ATTR_DEFER_TLB_FLUSH, &defer))
+		iommu_pt->defer_tlbi = true;
+
 	_enable_gpuhtw_llc(mmu, iommu_pt);
 
 	ret = _attach_pt(iommu_pt, ctx);
@@ -1795,6 +1801,53 @@ kgsl_iommu_unmap(struct kgsl_pagetable *pt, struct kgsl_memdesc *memdesc)
 			kgsl_memdesc_footprint(memdesc));
 }
 
+/* Unmap without invalidating the TLB, kgsl_iommu_tlb_sync() does that */
+static int
+kgsl_iommu_unmap_deferred(struct kgsl_pagetable *pt,
+		struct kgsl_memdesc *memdesc)
+{
+	struct kgsl_iommu_pt *iommu_pt = pt->priv;
+	uint64_t addr = PAGE_ALIGN(memdesc->gpuaddr);
+	uint64_t size = kgsl_memdesc_footprint(memdesc);
+	size_t unmapped;
+
+	if (!iommu_pt->defer_tlbi)
+		return -EOPNOTSUPP;
+
+	if (memdesc->size == 0 || addr == 0)
+		return -EINVAL;
+
+	_iommu_sync_mmu_pc(true);
+	unmapped = iommu_unmap_fast(iommu_pt->domain, addr, size);
+	_iommu_sync_mmu_pc(false);
+
+	if (unmapped != size) {
+		KGSL_CORE_ERR("unmap err: 0x%016llx, 0x%llx, %zd\n",
+			addr, size, unmapped);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
+static void kgsl_iommu_tlb_sync(struct kgsl_pagetable *pt)
+{
+	struct kgsl_iommu_pt *iommu_pt = pt->priv;
+	struct kgsl_iommu *iommu = _IOMMU_PRIV(pt->mmu);
+
+	if (!iommu_pt->defer_tlbi)
+		return;
+
+	/* Nothing is cached while CX is collapsed, same as the unmap path */
+	if (iommu->vddcx_regulator &&
+			(!regulator_is_enabled(iommu->vddcx_regulator)))
+		return;
+
+	_iommu_sync_mmu_pc(true);
+	iommu_tlb_sync(iommu_pt->domain);
+	_iommu_sync_mmu_pc(false);
+}
+
 /**
  * _iommu_map_guard_page - Map iommu guard page
  * @pt - Pointer to kgsl pagetable structure
@@ -2887,6 +2940,8 @@ struct kgsl_mmu_ops kgsl_iommu_ops = {
 static struct kgsl_mmu_pt_ops iommu_pt_ops = {
 	.mmu_map = kgsl_iommu_map,
 	.mmu_unmap = kgsl_iommu_unmap,
+	.mmu_unmap_deferred = kgsl_iommu_unmap_deferred,
+	.mmu_tlb_sync = kgsl_iommu_tlb_sync,
 	.mmu_destroy_pagetable = kgsl_iommu_destroy_pagetable,
 	.get_ttbr0 = kgsl_iommu_get_ttbr0,
 	.get_contextidr = kgsl_iommu_get_contextidr,
@@ -170,6 +170,7 @@ struct kgsl_iommu_pt {
 	u64 ttbr0;
 	u32 contextidr;
 	bool attached;
+	bool defer_tlbi;
 
 	struct rb_root rbtree;
 
@@ -426,21 +426,9 @@ kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 }
 EXPORT_SYMBOL(kgsl_mmu_map);
 
-/**
- * kgsl_mmu_put_gpuaddr() - Remove a GPU address from a pagetable
- * @pagetable: Pagetable to release the memory from
- * @memdesc: Memory descriptor containing the GPU address to free
- */
-void kgsl_mmu_put_gpuaddr(struct kgsl_memdesc *memdesc)
+static void _put_gpuaddr(struct kgsl_memdesc *memdesc, int unmap_fail)
 {
 	struct kgsl_pagetable *pagetable = memdesc->pagetable;
-	int unmap_fail = 0;
-
-	if (memdesc->size == 0 || memdesc->gpuaddr == 0)
-		return;
-
-	if (!kgsl_memdesc_is_global(memdesc))
-		unmap_fail = kgsl_mmu_unmap(pagetable, memdesc);
 
 	/*
 	 * Do not free the gpuaddr/size if unmap fails. Because if we
@@ -455,8 +443,44 @@ void kgsl_mmu_put_gpuaddr(struct kgsl_memdesc *memdesc)
 
 	memdesc->pagetable = NULL;
 }
+
+/**
+ * kgsl_mmu_put_gpuaddr() - Remove a GPU address from a pagetable
+ * @pagetable: Pagetable to release the memory from
+ * @memdesc: Memory descriptor containing the GPU address to free
+ */
+void kgsl_mmu_put_gpuaddr(struct kgsl_memdesc *memdesc)
+{
+	int unmap_fail = 0;
+
+	if (memdesc->size == 0 || memdesc->gpuaddr == 0)
+		return;
+
+	if (!kgsl_memdesc_is_global(memdesc))
+		unmap_fail = kgsl_mmu_unmap(memdesc->pagetable, memdesc);
+
+	_put_gpuaddr(memdesc, unmap_fail);
+}
 EXPORT_SYMBOL(kgsl_mmu_put_gpuaddr);
 
+/**
+ * kgsl_mmu_put_gpuaddr_deferred() - Release a GPU address unmapped with
+ * kgsl_mmu_unmap_deferred()
+ * @memdesc: Memory descriptor containing the GPU address to free
+ *
+ * Must only be called after kgsl_mmu_tlb_sync() on the pagetable, so that
+ * the address range can't be reused while stale translations for it are
+ * still in the TLB. The range is leaked if the unmap failed.
+ */
+void kgsl_mmu_put_gpuaddr_deferred(struct kgsl_memdesc *memdesc)
+{
+	if (memdesc->size == 0 || memdesc->gpuaddr == 0)
+		return;
+
+	_put_gpuaddr(memdesc, (memdesc->priv & KGSL_MEMDESC_MAPPED) ? -EIO : 0);
+}
+EXPORT_SYMBOL(kgsl_mmu_put_gpuaddr_deferred);
+
 /**
  * kgsl_mmu_svm_range() - Return the range for SVM (if applicable)
  * @pagetable: Pagetable to query the range from
@@ -509,6 +533,54 @@ kgsl_mmu_unmap(struct kgsl_pagetable *pagetable,
 }
 EXPORT_SYMBOL(kgsl_mmu_unmap);
 
+/**
+ * kgsl_mmu_unmap_deferred() - Unmap a memdesc without invalidating the TLB
+ * @pagetable: Pagetable the memdesc is mapped in
+ * @memdesc: Memory descriptor to unmap
+ *
+ * Return -EOPNOTSUPP if the pagetable can't defer its TLB invalidation, the
+ * caller then has to use kgsl_mmu_put_gpuaddr(). Otherwise the TLB must be
+ * invalidated with kgsl_mmu_tlb_sync() before the pages or the GPU address
+ * are reused. KGSL_MEMDESC_MAPPED is left set if the unmap fails.
+ */
+int kgsl_mmu_unmap_deferred(struct kgsl_pagetable *pagetable,
+		struct kgsl_memdesc *memdesc)
+{
+	uint64_t size;
+	int ret;
+
+	if (memdesc->size == 0 || kgsl_memdesc_is_global(memdesc) ||
+		!(KGSL_MEMDESC_MAPPED & memdesc->priv) ||
+		!PT_OP_VALID(pagetable, mmu_unmap_deferred))
+		return -EOPNOTSUPP;
+
+	size = kgsl_memdesc_footprint(memdesc);
+
+	ret = pagetable->pt_ops->mmu_unmap_deferred(pagetable, memdesc);
+	if (ret == -EOPNOTSUPP)
+		return ret;
+
+	atomic_dec(&pagetable->stats.entries);
+	atomic_long_sub(size, &pagetable->stats.mapped);
+
+	if (!ret)
+		memdesc->priv &= ~KGSL_MEMDESC_MAPPED;
+
+	return ret;
+}
+EXPORT_SYMBOL(kgsl_mmu_unmap_deferred);
+
+/**
+ * kgsl_mmu_tlb_sync() - Invalidate the TLB after kgsl_mmu_unmap_deferred()
+ * @pagetable: Pagetable to invalidate
+ */
+void kgsl_mmu_tlb_sync(struct kgsl_pagetable *pagetable)
+{
+	if (PT_OP_VALID(pagetable, mmu_tlb_sync))
+		pagetable->pt_ops->mmu_tlb_sync(pagetable);
+}
+EXPORT_SYMBOL(kgsl_mmu_tlb_sync);
+
 int kgsl_mmu_map_offset(struct kgsl_pagetable *pagetable,
 			uint64_t virtaddr, uint64_t virtoffset,
 			struct kgsl_memdesc *memdesc, uint64_t physoffset,
@@ -13,11 +13,16 @@
 
 #include <linux/vmalloc.h>
 #include <asm/cacheflush.h>
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/highmem.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
 
 #include "kgsl.h"
+#include "kgsl_debugfs.h"
 #include "kgsl_device.h"
 #include "kgsl_pool.h"
 
@@ -25,15 +30,40 @@
 #define KGSL_MAX_POOL_ORDER 8
 #define KGSL_MAX_RESERVED_PAGES 4096
 
+/*
+ * Per-cpu magazines sit in front of each pool's page list. They are only
+ * touched by the local CPU with preemption disabled, so the common
+ * allocation needs no lock; the list lock is taken once per refill of
+ * the magazine. Every magazine holds at most KGSL_POOL_MAG_BYTES.
+ */
+#define KGSL_POOL_MAG_MAX 16
+#define KGSL_POOL_MAG_BYTES SZ_64K
+
+/* Don't refill the pools for this long after the shrinker ran */
+#define KGSL_POOL_REFILL_BACKOFF (5 * HZ)
+
+/* Allocation latency buckets, bucket n counts allocations < 2^n us */
+#define KGSL_POOL_LAT_BUCKETS 16
+
+struct kgsl_pool_magazine {
+	unsigned int count;
+	struct page *pages[KGSL_POOL_MAG_MAX];
+};
+
 /**
  * struct kgsl_page_pool - Structure to hold information for the pool
  * @pool_order: Page order describing the size of the page
- * @page_count: Number of pages currently present in the pool
- * @reserved_pages: Number of pages reserved at init for the pool
+ * @page_count: Number of zeroed pages currently present in the pool
+ * @reserved_pages: Number of pages reserved at init for the pool, the
+ * refill worker keeps the pool at this level
  * @allocation_allowed: Tells if reserved pool gets exhausted, can we allocate
  * from system memory
  * @list_lock: Spinlock for page list in the pool
- * @page_list: List of pages held/reserved in this pool
+ * @page_list: List of zeroed pages held/reserved in this pool
+ * @dirty_count: Number of freed pages waiting to be zeroed
+ * @dirty_list: List of freed pages waiting to be zeroed
+ * @mags: Per-cpu magazines of zeroed pages
+ * @mag_size: Number of pages a magazine may hold, 0 if magazines are unused
  */
 struct kgsl_page_pool {
 	unsigned int pool_order;
@@ -42,12 +72,38 @@ struct kgsl_page_pool {
 	bool allocation_allowed;
 	spinlock_t list_lock;
 	struct list_head page_list;
+	int dirty_count;
+	struct list_head dirty_list;
+	struct kgsl_pool_magazine __percpu *mags;
+	unsigned int mag_size;
 };
 
 static struct kgsl_page_pool kgsl_pools[KGSL_MAX_POOLS];
 static int kgsl_num_pools;
 static int kgsl_pool_max_pages;
 
+static struct workqueue_struct *kgsl_pool_wq;
+static struct work_struct kgsl_pool_work;
+static unsigned long kgsl_pool_last_shrink;
+
+/**
+ * struct kgsl_pool_alloc_stats - Allocation statistics for a page order
+ * @lat: Latency histogram of kgsl_pool_alloc_page()
+ * @mag: Allocations served from a per-cpu magazine
+ * @list: Allocations served from the zeroed page list
+ * @dirty: Allocations that had to zero a freed page inline
+ * @system: Allocations that had to go to the page allocator
+ */
+struct kgsl_pool_alloc_stats {
+	atomic_t lat[KGSL_POOL_LAT_BUCKETS];
+	atomic_t mag;
+	atomic_t list;
+	atomic_t dirty;
+	atomic_t system;
+};
+
+static struct kgsl_pool_alloc_stats kgsl_pool_stats[KGSL_MAX_POOL_ORDER + 1];
+
 
 /* Returns KGSL pool corresponding to input page order*/
 static struct kgsl_page_pool *
@@ -79,7 +135,7 @@ _kgsl_pool_zero_page(struct page *p, unsigned int pool_order)
 	}
 }
 
-/* Add a page to specified pool */
+/* Add a zeroed page to specified pool */
 static void
 _kgsl_pool_add_page(struct kgsl_page_pool *pool, struct page *p)
 {
@@ -93,20 +149,64 @@ _kgsl_pool_add_page(struct kgsl_page_pool *pool, struct page *p)
 				(1 << pool->pool_order));
 }
 
-/* Returns a page from specified pool */
+/* Add a freed page to specified pool, the pool worker zeroes it later */
+static void
+_kgsl_pool_add_dirty_page(struct kgsl_page_pool *pool, struct page *p)
+{
+	spin_lock(&pool->list_lock);
+	list_add_tail(&p->lru, &pool->dirty_list);
+	pool->dirty_count++;
+	spin_unlock(&pool->list_lock);
+	mod_node_page_state(page_pgdat(p), NR_KERNEL_MISC_RECLAIMABLE,
+				(1 << pool->pool_order));
+
+	queue_work(kgsl_pool_wq, &kgsl_pool_work);
+}
+
+/* Returns a dirty page from specified pool, or NULL */
 static struct page *
-_kgsl_pool_get_page(struct kgsl_page_pool *pool)
+_kgsl_pool_get_dirty_page(struct kgsl_page_pool *pool)
 {
 	struct page *p = NULL;
 
 	spin_lock(&pool->list_lock);
-	if (pool->page_count) {
-		p = list_first_entry(&pool->page_list, struct page, lru);
-		pool->page_count--;
+	if (pool->dirty_count) {
+		p = list_first_entry(&pool->dirty_list, struct page, lru);
+		pool->dirty_count--;
 		list_del(&p->lru);
 	}
 	spin_unlock(&pool->list_lock);
 
+	return p;
+}
+
+/* Takes a zeroed page off the page list, called with the list lock held */
+static struct page *
+__kgsl_pool_take_listed(struct kgsl_page_pool *pool)
+{
+	struct page *p;
+
+	if (!pool->page_count)
+		return NULL;
+
+	p = list_first_entry(&pool->page_list, struct page, lru);
+	pool->page_count--;
+	list_del(&p->lru);
+	return p;
+}
+
+/* Returns a page from specified pool, dirty pages first */
+static struct page *
+_kgsl_pool_get_page(struct kgsl_page_pool *pool)
+{
+	struct page *p = _kgsl_pool_get_dirty_page(pool);
+
+	if (p == NULL) {
+		spin_lock(&pool->list_lock);
+		p = __kgsl_pool_take_listed(pool);
+		spin_unlock(&pool->list_lock);
+	}
+
 	if (p != NULL)
 		mod_node_page_state(page_pgdat(p),
 				NR_KERNEL_MISC_RECLAIMABLE,
@@ -114,14 +214,74 @@ _kgsl_pool_get_page(struct kgsl_page_pool *pool)
 	return p;
 }
 
-/* Returns the number of pages in specified pool */
+/*
+ * Returns a zeroed page for an allocation: from the local magazine, from
+ * the page list while refilling the magazine in the same lock hold, or
+ * from the dirty list zeroing it inline.
+ */
+static struct page *
+_kgsl_pool_take_page(struct kgsl_page_pool *pool)
+{
+	struct kgsl_pool_alloc_stats *stats =
+		&kgsl_pool_stats[pool->pool_order];
+	struct kgsl_pool_magazine *mag = NULL;
+	struct page *p;
+
+	if (pool->mags) {
+		mag = get_cpu_ptr(pool->mags);
+		if (mag->count) {
+			p = mag->pages[--mag->count];
+			put_cpu_ptr(pool->mags);
+			atomic_inc(&stats->mag);
+			goto out;
+		}
+	}
+
+	spin_lock(&pool->list_lock);
+	p = __kgsl_pool_take_listed(pool);
+	if (p != NULL && mag != NULL) {
+		while (mag->count < pool->mag_size) {
+			struct page *next = __kgsl_pool_take_listed(pool);
+
+			if (next == NULL)
+				break;
+			mag->pages[mag->count++] = next;
+		}
+	}
+	spin_unlock(&pool->list_lock);
+
+	if (mag != NULL)
+		put_cpu_ptr(pool->mags);
+
+	if (p != NULL) {
+		atomic_inc(&stats->list);
+	} else {
+		p = _kgsl_pool_get_dirty_page(pool);
+		if (p == NULL)
+			return NULL;
+		_kgsl_pool_zero_page(p, pool->pool_order);
+		atomic_inc(&stats->dirty);
+	}
+
+out:
+	mod_node_page_state(page_pgdat(p), NR_KERNEL_MISC_RECLAIMABLE,
+				-(1 << pool->pool_order));
+	return p;
+}
+
+/*
+ * Returns the number of pages in specified pool. Pages in the per-cpu
+ * magazines are not counted: they can't be taken by the shrinker and are
+ * bounded by KGSL_POOL_MAG_BYTES per CPU.
+ */
 static int
 kgsl_pool_size(struct kgsl_page_pool *kgsl_pool)
 {
 	int size;
 
 	spin_lock(&kgsl_pool->list_lock);
-	size = kgsl_pool->page_count * (1 << kgsl_pool->pool_order);
+	size = (kgsl_pool->page_count + kgsl_pool->dirty_count) *
+		(1 << kgsl_pool->pool_order);
 	spin_unlock(&kgsl_pool->list_lock);
 
 	return size;
@@ -305,17 +465,43 @@ static int kgsl_pool_get_retry_order(unsigned int order)
 	return 0;
 }
 
+static void kgsl_pool_account_latency(unsigned int order, u64 start)
+{
+	u64 us = div_u64(ktime_get_ns() - start, NSEC_PER_USEC);
+	int bucket = us ? min_t(int, fls64(us), KGSL_POOL_LAT_BUCKETS - 1) : 0;
+
+	if (order <= KGSL_MAX_POOL_ORDER)
+		atomic_inc(&kgsl_pool_stats[order].lat[bucket]);
+}
+
+static void kgsl_pool_account_system(unsigned int order)
+{
+	if (order <= KGSL_MAX_POOL_ORDER)
+		atomic_inc(&kgsl_pool_stats[order].system);
+}
+
+/* Kick the pool worker if the pool dropped below its reserved level */
+static void kgsl_pool_check_reserve(struct kgsl_page_pool *pool)
+{
+	if (pool->reserved_pages && READ_ONCE(pool->page_count) +
+			READ_ONCE(pool->dirty_count) < pool->reserved_pages)
+		queue_work(kgsl_pool_wq, &kgsl_pool_work);
+}
+
 /**
  * kgsl_pool_alloc_page() - Allocate a page of requested size
  * @page_size: Size of the page to be allocated
  * @pages: pointer to hold list of pages, should be big enough to hold
  * requested page
  * @len: Length of array pages.
+ * @pooled: If not NULL, incremented by the number of pages that came from
+ * a pool rather than the page allocator
  *
  * Return total page count on success and negative value on failure
  */
 int kgsl_pool_alloc_page(int *page_size, struct page **pages,
-			unsigned int pages_len, unsigned int *align)
+			unsigned int pages_len, unsigned int *align,
+			unsigned int *pooled)
 {
 	int j;
 	int pcount = 0;
@@ -325,6 +511,8 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 	int order = get_order(*page_size);
 	int pool_idx;
 	size_t size = 0;
+	u64 start = ktime_get_ns();
+	bool from_pool = false;
 
 	if ((pages == NULL) || pages_len < (*page_size >> PAGE_SHIFT))
 		return -EINVAL;
@@ -344,6 +532,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 				return -ENOMEM;
 		}
 		_kgsl_pool_zero_page(page, order);
+		kgsl_pool_account_system(order);
 		goto done;
 	}
 
@@ -364,12 +553,15 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			if (page == NULL)
 				return -ENOMEM;
 			_kgsl_pool_zero_page(page, order);
+			kgsl_pool_account_system(order);
 			goto done;
 		}
 	}
 
 	pool_idx = kgsl_pool_idx_lookup(order);
-	page = _kgsl_pool_get_page(pool);
+	page = _kgsl_pool_take_page(pool);
+	kgsl_pool_check_reserve(pool);
+	from_pool = (page != NULL);
 
 	/* Allocate a new page if not allocated from pool */
 	if (page == NULL) {
@@ -395,6 +587,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 		}
 
 		_kgsl_pool_zero_page(page, order);
+		kgsl_pool_account_system(order);
 	}
 
 done:
@@ -406,6 +599,11 @@ done:
 
 	mod_node_page_state(page_pgdat(page), NR_UNRECLAIMABLE_PAGES,
 					(1 << order));
+	kgsl_pool_account_latency(order, start);
+
+	if (from_pool && pooled)
+		*pooled += pcount;
+
 	return pcount;
 
 eagain:
@@ -432,7 +630,7 @@ void kgsl_pool_free_page(struct page *page)
 			(kgsl_pool_size_total() < kgsl_pool_max_pages)) {
 		pool = _kgsl_get_pool_from_order(page_order);
 		if (pool != NULL) {
-			_kgsl_pool_add_page(pool, page);
+			_kgsl_pool_add_dirty_page(pool, page);
 			return;
 		}
 	}
@@ -490,6 +688,9 @@ kgsl_pool_shrink_scan_objects(struct shrinker *shrinker,
 	/* Target pages represents new  pool size */
 	int target_pages = (nr > total_pages) ? 0 : (total_pages - nr);
 
+	/* Hold off the pool worker's refill while under pressure */
+	WRITE_ONCE(kgsl_pool_last_shrink, jiffies);
+
 	/* Reduce pool size to target_pages */
 	return kgsl_pool_reduce(target_pages, false);
 }
@@ -510,9 +711,130 @@ static struct shrinker kgsl_pool_shrinker = {
 	.batch = 0,
 };
 
+/* Zero the freed pages of a pool */
+static void kgsl_pool_zero_dirty(struct kgsl_page_pool *pool)
+{
+	struct page *p;
+
+	while ((p = _kgsl_pool_get_dirty_page(pool)) != NULL) {
+		_kgsl_pool_zero_page(p, pool->pool_order);
+
+		spin_lock(&pool->list_lock);
+		list_add_tail(&p->lru, &pool->page_list);
+		pool->page_count++;
+		spin_unlock(&pool->list_lock);
+		cond_resched();
+	}
+}
+
+/* Top a pool up to its reserved level without entering direct reclaim */
+static void kgsl_pool_refill(struct kgsl_page_pool *pool)
+{
+	int order = pool->pool_order;
+	gfp_t gfp_mask = (kgsl_gfp_mask(order) | __GFP_NORETRY |
+			__GFP_NOWARN) & ~__GFP_RECLAIM;
+	struct page *page;
+
+	while (READ_ONCE(pool->page_count) < pool->reserved_pages) {
+		if (time_before(jiffies, READ_ONCE(kgsl_pool_last_shrink) +
+				KGSL_POOL_REFILL_BACKOFF))
+			return;
+
+		if (kgsl_pool_max_pages &&
+				kgsl_pool_size_total() >= kgsl_pool_max_pages)
+			return;
+
+		page = alloc_pages(gfp_mask, order);
+		if (page == NULL)
+			return;
+
+		_kgsl_pool_add_page(pool, page);
+		cond_resched();
+	}
+}
+
+static void kgsl_pool_worker(struct work_struct *work)
+{
+	int i;
+
+	for (i = 0; i < kgsl_num_pools; i++) {
+		kgsl_pool_zero_dirty(&kgsl_pools[i]);
+		kgsl_pool_refill(&kgsl_pools[i]);
+	}
+}
+
+/* Give the pages held in the per-cpu magazines back to the system */
+static void kgsl_pool_drain_magazines(void)
+{
+	int i, cpu;
+
+	for (i = 0; i < kgsl_num_pools; i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		if (!pool->mags)
+			continue;
+
+		for_each_possible_cpu(cpu) {
+			struct kgsl_pool_magazine *mag =
+				per_cpu_ptr(pool->mags, cpu);
+
+			while (mag->count) {
+				struct page *p = mag->pages[--mag->count];
+
+				mod_node_page_state(page_pgdat(p),
+					NR_KERNEL_MISC_RECLAIMABLE,
+					-(1 << pool->pool_order));
+				__free_pages(p, pool->pool_order);
+			}
+		}
+
+		free_percpu(pool->mags);
+		pool->mags = NULL;
+	}
+}
+
+static int kgsl_pool_stats_show(struct seq_file *s, void *unused)
+{
+	int order, i;
+
+	/* Latency columns are in us, each counts allocations below its bound */
+	seq_puts(s, "order      mag     list    dirty   system");
+	for (i = 0; i < KGSL_POOL_LAT_BUCKETS - 1; i++)
+		seq_printf(s, " %8u", 1U << i);
+	seq_printf(s, " %8s\n", "inf");
+
+	for (order = 0; order <= KGSL_MAX_POOL_ORDER; order++) {
+		struct kgsl_pool_alloc_stats *stats = &kgsl_pool_stats[order];
+
+		seq_printf(s, "%5d %8d %8d %8d %8d", order,
+			atomic_read(&stats->mag), atomic_read(&stats->list),
+			atomic_read(&stats->dirty),
+			atomic_read(&stats->system));
+		for (i = 0; i < KGSL_POOL_LAT_BUCKETS; i++)
+			seq_printf(s, " %8d", atomic_read(&stats->lat[i]));
+		seq_putc(s, '\n');
+	}
+
+	return 0;
+}
+
+static int kgsl_pool_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kgsl_pool_stats_show, NULL);
+}
+
+static const struct file_operations kgsl_pool_stats_fops = {
+	.open = kgsl_pool_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void kgsl_pool_config(unsigned int order, unsigned int reserved_pages,
 		bool allocation_allowed)
 {
+	struct kgsl_page_pool *pool;
+
 #ifdef CONFIG_ALLOC_BUFFERS_IN_4K_CHUNKS
 	if (order > 0) {
 		pr_info("%s: Pool order:%d not supprted.!!\n", __func__, order);
@@ -523,11 +845,18 @@ static void kgsl_pool_config(unsigned int order, unsigned int reserved_pages,
 			(reserved_pages > KGSL_MAX_RESERVED_PAGES))
 		return;
 
-	kgsl_pools[kgsl_num_pools].pool_order = order;
-	kgsl_pools[kgsl_num_pools].reserved_pages = reserved_pages;
-	kgsl_pools[kgsl_num_pools].allocation_allowed = allocation_allowed;
-	spin_lock_init(&kgsl_pools[kgsl_num_pools].list_lock);
-	INIT_LIST_HEAD(&kgsl_pools[kgsl_num_pools].page_list);
+	pool = &kgsl_pools[kgsl_num_pools];
+	pool->pool_order = order;
+	pool->reserved_pages = reserved_pages;
+	pool->allocation_allowed = allocation_allowed;
+	spin_lock_init(&pool->list_lock);
+	INIT_LIST_HEAD(&pool->page_list);
+	INIT_LIST_HEAD(&pool->dirty_list);
+
+	pool->mag_size = min_t(unsigned int, KGSL_POOL_MAG_MAX,
+			KGSL_POOL_MAG_BYTES >> (PAGE_SHIFT + order));
+	if (pool->mag_size)
+		pool->mags = alloc_percpu(struct kgsl_pool_magazine);
 	kgsl_num_pools++;
 }
 
@@ -576,6 +905,13 @@ static void kgsl_of_get_mempools(struct device_node *parent)
 
 void kgsl_init_page_pools(struct platform_device *pdev)
 {
+	/* Zeroes freed pages and refills the pools off the allocation path */
+	kgsl_pool_wq = alloc_workqueue("kgsl-pool",
+		WQ_UNBOUND | WQ_FREEZABLE, 1);
+	if (kgsl_pool_wq == NULL)
+		kgsl_pool_wq = system_unbound_wq;
+	INIT_WORK(&kgsl_pool_work, kgsl_pool_worker);
+	kgsl_pool_last_shrink = jiffies - KGSL_POOL_REFILL_BACKOFF;
 
 	/* Get GPU mempools data and configure pools */
 	kgsl_of_get_mempools(pdev->dev.of_node);
@@ -585,11 +921,19 @@ void kgsl_init_page_pools(struct platform_device *pdev)
 
 	/* Initialize shrinker */
 	register_shrinker(&kgsl_pool_shrinker);
+
+	debugfs_create_file("pool_alloc_stats", 0444, kgsl_get_debugfs_dir(),
+		NULL, &kgsl_pool_stats_fops);
 }
 
 void kgsl_exit_page_pools(void)
 {
+	cancel_work_sync(&kgsl_pool_work);
+	if (kgsl_pool_wq != system_unbound_wq)
+		destroy_workqueue(kgsl_pool_wq);
+
 	/* Release all pages in pools, if any.*/
+	kgsl_pool_drain_magazines();
 	kgsl_pool_reduce(0, true);
 
 	/* Unregister shrinker */
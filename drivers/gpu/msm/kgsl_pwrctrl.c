@@ -1343,6 +1343,148 @@ static ssize_t kgsl_popp_show(struct device *dev,
 		test_bit(POPP_ON, &device->pwrscale.popp_state));
 }
 
+static ssize_t kgsl_frame_dcvs_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val = 0;
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	int ret;
+
+	if (device == NULL)
+		return 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&device->mutex);
+	device->pwrscale.frame_dcvs_enable = !!val;
+	device->pwrscale.frame_dcvs_hold = 0;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+static ssize_t kgsl_frame_dcvs_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+
+	if (device == NULL)
+		return 0;
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+		device->pwrscale.frame_dcvs_enable);
+}
+
+static ssize_t kgsl_frame_dcvs_margin_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val = 0;
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	int ret;
+
+	if (device == NULL)
+		return 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	if (val > 100)
+		return -EINVAL;
+
+	mutex_lock(&device->mutex);
+	device->pwrscale.frame_dcvs_margin = val;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+static ssize_t kgsl_frame_dcvs_margin_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+
+	if (device == NULL)
+		return 0;
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+		device->pwrscale.frame_dcvs_margin);
+}
+
+static ssize_t kgsl_touch_boost_ms_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val = 0;
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	int ret;
+
+	if (device == NULL)
+		return 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&device->mutex);
+	device->pwrscale.touch_boost_ms = val;
+	device->pwrscale.touch_hold = 0;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+static ssize_t kgsl_touch_boost_ms_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+
+	if (device == NULL)
+		return 0;
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+		device->pwrscale.touch_boost_ms);
+}
+
+static ssize_t kgsl_vsync_boost_us_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val = 0;
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	int ret;
+
+	if (device == NULL)
+		return 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&device->mutex);
+	device->pwrscale.vsync_boost_us = val;
+	device->pwrscale.vsync_hold = 0;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+static ssize_t kgsl_vsync_boost_us_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+
+	if (device == NULL)
+		return 0;
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+		device->pwrscale.vsync_boost_us);
+}
+
 static ssize_t kgsl_pwrctrl_gpu_model_show(struct device *dev,
 					struct device_attribute *attr,
 					char *buf)
@@ -1619,6 +1761,14 @@ static DEVICE_ATTR(default_pwrlevel, 0644,
 	kgsl_pwrctrl_default_pwrlevel_show,
 	kgsl_pwrctrl_default_pwrlevel_store);
 static DEVICE_ATTR(popp, 0644, kgsl_popp_show, kgsl_popp_store);
+static DEVICE_ATTR(frame_dcvs, 0644, kgsl_frame_dcvs_show,
+	kgsl_frame_dcvs_store);
+static DEVICE_ATTR(frame_dcvs_margin, 0644, kgsl_frame_dcvs_margin_show,
+	kgsl_frame_dcvs_margin_store);
+static DEVICE_ATTR(touch_boost_ms, 0644, kgsl_touch_boost_ms_show,
+	kgsl_touch_boost_ms_store);
+static DEVICE_ATTR(vsync_boost_us, 0644, kgsl_vsync_boost_us_show,
+	kgsl_vsync_boost_us_store);
 static DEVICE_ATTR(force_no_nap, 0644,
 	kgsl_pwrctrl_force_no_nap_show,
 	kgsl_pwrctrl_force_no_nap_store);
@@ -1656,6 +1806,10 @@ static const struct device_attribute *pwrctrl_attr_list[] = {
 	&dev_attr_bus_split,
 	&dev_attr_default_pwrlevel,
 	&dev_attr_popp,
+	&dev_attr_frame_dcvs,
+	&dev_attr_frame_dcvs_margin,
+	&dev_attr_touch_boost_ms,
+	&dev_attr_vsync_boost_us,
 	&dev_attr_gpu_model,
 	&dev_attr_gpu_busy_percentage,
 	&dev_attr_min_clock_mhz,
@@ -16,6 +16,8 @@
 #include <linux/hrtimer.h>
 #include <linux/devfreq_cooling.h>
 #include <linux/pm_opp.h>
+#include <linux/input/touch_hint.h>
+#include <linux/msm_drm_notify.h>
 
 #include "kgsl.h"
 #include "kgsl_pwrscale.h"
@@ -253,6 +255,153 @@ static enum hrtimer_restart kgsl_pwrscale_midframe_timer(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
+/**
+ * kgsl_pwrscale_frame_deadline() - vote for a frame with a deadline
+ * @device: The device
+ * @cycles: Predicted GPU cycles of the frame
+ * @deadline_ns: CLOCK_MONOTONIC time by which the frame should retire
+ *
+ * Pick the lowest power level that retires @cycles (plus the configured
+ * margin) before @deadline_ns and hold it against the devfreq governor
+ * until shortly after the deadline. This function must be called with the
+ * device mutex locked.
+ */
+void kgsl_pwrscale_frame_deadline(struct kgsl_device *device, u64 cycles,
+		u64 deadline_ns)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct kgsl_pwrscale *psc = &device->pwrscale;
+	u64 now = ktime_get_ns();
+	unsigned int level = pwr->max_pwrlevel;
+	int i;
+
+	if (WARN_ON(!mutex_is_locked(&device->mutex)))
+		return;
+
+	if (!psc->enabled || !psc->frame_dcvs_enable || !cycles)
+		return;
+
+	if (deadline_ns > now) {
+		u64 need = div_u64(cycles * (100 + psc->frame_dcvs_margin), 100);
+
+		need = min_t(u64, need, U64_MAX / NSEC_PER_SEC);
+		need = div64_u64(need * NSEC_PER_SEC, deadline_ns - now);
+
+		for (i = pwr->min_pwrlevel; i >= (int)pwr->max_pwrlevel; i--) {
+			if (pwr->pwrlevels[i].gpu_freq >= need) {
+				level = i;
+				break;
+			}
+		}
+	}
+
+	psc->frame_dcvs_hold = ktime_add_us(ns_to_ktime(deadline_ns),
+			KGSL_FRAME_DCVS_HOLD);
+
+	if (level != pwr->active_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, level);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame_deadline);
+
+static bool _frame_dcvs_active(struct kgsl_pwrscale *psc)
+{
+	return psc->frame_dcvs_enable &&
+		ktime_compare(ktime_get(), psc->frame_dcvs_hold) < 0;
+}
+
+static bool _touch_hint_active(struct kgsl_pwrscale *psc)
+{
+	return psc->touch_boost_ms &&
+		ktime_compare(ktime_get(), READ_ONCE(psc->touch_hold)) < 0;
+}
+
+/*
+ * Touch gesture hints hold a power level floor that rises with the speed
+ * of the contact, for touch_boost_ms after the last hint and up to twice
+ * that after a fling. A tap releases the floor. Called in atomic context,
+ * the floor is applied by the next devfreq update.
+ */
+static int kgsl_pwrscale_touch_hint(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	struct kgsl_pwrscale *psc = container_of(nb, struct kgsl_pwrscale,
+			touch_nb);
+	struct kgsl_device *device = container_of(psc, struct kgsl_device,
+			pwrscale);
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct touch_hint *hint = data;
+	unsigned int ms = READ_ONCE(psc->touch_boost_ms);
+	unsigned int v, range;
+
+	if (!psc->enabled || !ms || event == TOUCH_HINT_DOWN)
+		return NOTIFY_DONE;
+
+	if (event == TOUCH_HINT_UP && hint->velocity < KGSL_TOUCH_VELOCITY_MIN) {
+		WRITE_ONCE(psc->touch_hold, 0);
+		return NOTIFY_OK;
+	}
+
+	v = min_t(unsigned int, hint->velocity, KGSL_TOUCH_VELOCITY_MAX);
+	range = pwr->min_pwrlevel - pwr->max_pwrlevel;
+	WRITE_ONCE(psc->touch_floor_level, pwr->min_pwrlevel -
+			DIV_ROUND_UP(range * v, KGSL_TOUCH_VELOCITY_MAX));
+
+	if (event == TOUCH_HINT_UP)
+		ms += ms * v / KGSL_TOUCH_VELOCITY_MAX;
+	WRITE_ONCE(psc->touch_hold, ktime_add_ms(hint->time, ms));
+
+	if (device->state != KGSL_STATE_SLUMBER)
+		queue_work(psc->devfreq_wq, &psc->devfreq_notify_ws);
+
+	return NOTIFY_OK;
+}
+
+static bool _vsync_boost_active(struct kgsl_pwrscale *psc)
+{
+	return psc->vsync_boost_us &&
+		ktime_compare(ktime_get(), READ_ONCE(psc->vsync_hold)) < 0;
+}
+
+static enum hrtimer_restart kgsl_pwrscale_vsync_timer(struct hrtimer *timer)
+{
+	struct kgsl_pwrscale *psc = container_of(timer, struct kgsl_pwrscale,
+			vsync_timer);
+	struct kgsl_device *device = container_of(psc, struct kgsl_device,
+			pwrscale);
+
+	WRITE_ONCE(psc->vsync_hold,
+		ktime_add_us(ktime_get(), 2 * psc->vsync_boost_us));
+
+	if (device->state != KGSL_STATE_SLUMBER)
+		queue_work(psc->devfreq_wq, &psc->devfreq_notify_ws);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Each vsync or queued commit of the primary display arms a timer for
+ * vsync_boost_us before the next frame is due. From then until as long
+ * after it, the GPU runs at least at its default power level, so that
+ * composition does not start at a level the governor lowered during the
+ * idle part of the previous frame. Called in atomic context.
+ */
+static int kgsl_pwrscale_vsync(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	struct kgsl_pwrscale *psc = container_of(nb, struct kgsl_pwrscale,
+			vsync_nb);
+	struct msm_drm_vsync *vsync = data;
+	unsigned int us = READ_ONCE(psc->vsync_boost_us);
+
+	if (!psc->enabled || !us || vsync->id != MSM_DRM_PRIMARY_DISPLAY)
+		return NOTIFY_DONE;
+
+	hrtimer_start(&psc->vsync_timer, ktime_sub_us(vsync->deadline, us),
+			HRTIMER_MODE_ABS);
+
+	return NOTIFY_OK;
+}
+
 /*
  * kgsl_pwrscale_disable - temporarily disable the governor
  * @device: The device
@@ -556,6 +705,14 @@ int kgsl_devfreq_target(struct device *dev, unsigned long *freq, u32 flags)
 	rec_freq = *freq;
 
 	mutex_lock(&device->mutex);
+
+	/* A frame deadline vote is in charge until it expires */
+	if (_frame_dcvs_active(&device->pwrscale)) {
+		*freq = kgsl_pwrctrl_active_freq(pwr);
+		mutex_unlock(&device->mutex);
+		return 0;
+	}
+
 	cur_freq = kgsl_pwrctrl_active_freq(pwr);
 	level = pwr->active_pwrlevel;
 	pwr_level = &pwr->pwrlevels[level];
@@ -582,6 +739,23 @@ int kgsl_devfreq_target(struct device *dev, unsigned long *freq, u32 flags)
 		popp_trans1(device);
 	}
 
+	/* A touch gesture hint keeps the level at or above its floor */
+	if (_touch_hint_active(&device->pwrscale)) {
+		level = max_t(unsigned int,
+				READ_ONCE(device->pwrscale.touch_floor_level),
+				pwr->max_pwrlevel);
+		if (level < pwr->active_pwrlevel)
+			kgsl_pwrctrl_pwrlevel_change(device, level);
+	}
+
+	/* Ahead of a display frame the level is at least the default one */
+	if (_vsync_boost_active(&device->pwrscale)) {
+		level = max_t(unsigned int, pwr->default_pwrlevel,
+				pwr->max_pwrlevel);
+		if (level < pwr->active_pwrlevel)
+			kgsl_pwrctrl_pwrlevel_change(device, level);
+	}
+
 	*freq = kgsl_pwrctrl_active_freq(pwr);
 
 	mutex_unlock(&device->mutex);
@@ -1017,6 +1191,14 @@ int kgsl_pwrscale_init(struct device *dev, const char *governor)
 	pwrscale->next_governor_call = ktime_add_us(ktime_get(),
 			KGSL_GOVERNOR_CALL_INTERVAL);
 
+	pwrscale->touch_nb.notifier_call = kgsl_pwrscale_touch_hint;
+	touch_hint_register_notifier(&pwrscale->touch_nb);
+
+	hrtimer_init(&pwrscale->vsync_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	pwrscale->vsync_timer.function = kgsl_pwrscale_vsync_timer;
+	pwrscale->vsync_nb.notifier_call = kgsl_pwrscale_vsync;
+	msm_drm_register_vsync_client(&pwrscale->vsync_nb);
+
 	/* history tracking */
 	for (i = 0; i < KGSL_PWREVENT_MAX; i++) {
 		pwrscale->history[i].events = kcalloc(
@@ -1056,6 +1238,9 @@ void kgsl_pwrscale_close(struct kgsl_device *device)
 	if (pwrscale->cooling_dev)
 		devfreq_cooling_unregister(pwrscale->cooling_dev);
 
+	touch_hint_unregister_notifier(&pwrscale->touch_nb);
+	msm_drm_unregister_vsync_client(&pwrscale->vsync_nb);
+	hrtimer_cancel(&pwrscale->vsync_timer);
 	kgsl_pwrscale_midframe_timer_cancel(device);
 	flush_workqueue(pwrscale->devfreq_wq);
 	destroy_workqueue(pwrscale->devfreq_wq);
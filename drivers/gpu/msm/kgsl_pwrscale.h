@@ -21,6 +21,16 @@
 /* devfreq governor call window in usec */
 #define KGSL_GOVERNOR_CALL_INTERVAL 10000
 
+/* How long a frame deadline vote outlives its deadline in usec */
+#define KGSL_FRAME_DCVS_HOLD 20000
+
+/*
+ * Touch contact speeds in pixels per second: below MIN a release is a tap,
+ * from MAX a touch hint floors the GPU at max_pwrlevel
+ */
+#define KGSL_TOUCH_VELOCITY_MIN 1000
+#define KGSL_TOUCH_VELOCITY_MAX 8000
+
 /* Power events to be tracked with history */
 #define KGSL_PWREVENT_STATE	0
 #define KGSL_PWREVENT_GPU_FREQ	1
@@ -96,6 +106,20 @@ struct kgsl_pwr_history {
  * ctxt aware power level jump
  * @ctxt_aware_target_pwrlevel - pwrlevel to jump on in case of ctxt aware
  * power level jump
+ * @frame_dcvs_enable - Whether frame deadline hints drive the power level
+ * @frame_dcvs_margin - Headroom in percent added to the predicted frame cycles
+ * @frame_dcvs_hold - Time until which the last frame deadline vote overrides
+ * the devfreq governor
+ * @touch_nb - Touch gesture hint notifier
+ * @touch_boost_ms - How long a touch hint holds its power level floor, 0 to
+ * ignore touch hints
+ * @touch_floor_level - Power level floor of the last touch hint
+ * @touch_hold - Time until which the touch hint floor applies
+ * @vsync_nb - Display vsync timing notifier
+ * @vsync_timer - Fires vsync_boost_us before the next frame is due
+ * @vsync_boost_us - How long before a frame is due the GPU is floored at
+ * its default power level, and for how long after, 0 to disable
+ * @vsync_hold - Time until which the vsync floor applies
  */
 struct kgsl_pwrscale {
 	struct devfreq *devfreqptr;
@@ -121,6 +145,17 @@ struct kgsl_pwrscale {
 	bool ctxt_aware_enable;
 	unsigned int ctxt_aware_target_pwrlevel;
 	unsigned int ctxt_aware_busy_penalty;
+	bool frame_dcvs_enable;
+	unsigned int frame_dcvs_margin;
+	ktime_t frame_dcvs_hold;
+	struct notifier_block touch_nb;
+	unsigned int touch_boost_ms;
+	unsigned int touch_floor_level;
+	ktime_t touch_hold;
+	struct notifier_block vsync_nb;
+	struct hrtimer vsync_timer;
+	unsigned int vsync_boost_us;
+	ktime_t vsync_hold;
 };
 
 int kgsl_pwrscale_init(struct device *dev, const char *governor);
@@ -135,6 +170,9 @@ void kgsl_pwrscale_wake(struct kgsl_device *device);
 void kgsl_pwrscale_midframe_timer_restart(struct kgsl_device *device);
 void kgsl_pwrscale_midframe_timer_cancel(struct kgsl_device *device);
 
+void kgsl_pwrscale_frame_deadline(struct kgsl_device *device, u64 cycles,
+		u64 deadline_ns);
+
 void kgsl_pwrscale_enable(struct kgsl_device *device);
 void kgsl_pwrscale_disable(struct kgsl_device *device, bool turbo);
 
@@ -153,6 +191,8 @@ bool kgsl_popp_check(struct kgsl_device *device);
 
 #define KGSL_PWRSCALE_INIT(_priv_data) { \
 	.enabled = true, \
+	.frame_dcvs_margin = 10, \
+	.touch_boost_ms = 100, \
 	.gpu_profile = { \
 		.private_data = _priv_data, \
 		.profile = { \
@@ -919,6 +919,7 @@ kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 
 	memdesc->pages = kgsl_malloc(len_alloc * sizeof(struct page *));
 	memdesc->page_count = 0;
+	memdesc->pool_pages = 0;
 	memdesc->size = 0;
 
 	if (memdesc->pages == NULL) {
@@ -934,7 +935,7 @@ kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 		page_count = kgsl_pool_alloc_page(&page_size,
 					memdesc->pages + pcount,
 					len_alloc - pcount,
-					&align);
+					&align, &memdesc->pool_pages);
 		if (page_count <= 0) {
 			if (page_count == -EAGAIN)
 				continue;
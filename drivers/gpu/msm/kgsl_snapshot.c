@@ -12,6 +12,7 @@
 
 #include <linux/export.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
 #include <linux/sysfs.h>
 #include <linux/utsname.h>
 #include <linux/sched.h>
@@ -643,6 +644,7 @@ void kgsl_device_snapshot(struct kgsl_device *device,
 	struct kgsl_snapshot *snapshot;
 	struct timespec boot;
 	phys_addr_t pa;
+	ktime_t start;
 
 	if (device->snapshot_memory.ptr == NULL) {
 		KGSL_DRV_ERR(device,
@@ -699,6 +701,8 @@ void kgsl_device_snapshot(struct kgsl_device *device,
 	snapshot->recovered = false;
 	snapshot->first_read = true;
 	snapshot->sysfs_read = 0;
+	snapshot->minimal = device->snapshot_minimal;
+	start = ktime_get();
 
 	header = (struct kgsl_snapshot_header *) snapshot->ptr;
 
@@ -738,8 +742,10 @@ void kgsl_device_snapshot(struct kgsl_device *device,
 
 	/* log buffer info to aid in ramdump fault tolerance */
 	pa = __pa(device->snapshot_memory.ptr);
-	KGSL_DRV_ERR(device, "%s snapshot created at pa %pa++0x%zx\n",
-			gmu_fault ? "GMU" : "GPU", &pa, snapshot->size);
+	KGSL_DRV_ERR(device, "%s%s snapshot created at pa %pa++0x%zx in %lldus\n",
+			gmu_fault ? "GMU" : "GPU",
+			snapshot->minimal ? " minimal" : "", &pa,
+			snapshot->size, ktime_us_delta(ktime_get(), start));
 
 	sysfs_notify(&device->snapshot_kobj, NULL, "timestamp");
 
@@ -1034,6 +1040,25 @@ static ssize_t snapshot_legacy_store(struct kgsl_device *device,
 	return (ssize_t) ret < 0 ? ret : count;
 }
 
+static ssize_t snapshot_minimal_show(struct kgsl_device *device, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", device->snapshot_minimal);
+}
+
+static ssize_t snapshot_minimal_store(struct kgsl_device *device,
+	const char *buf, size_t count)
+{
+	unsigned int val = 0;
+	int ret;
+
+	ret = kgsl_sysfs_store(buf, &val);
+
+	if (!ret && device)
+		device->snapshot_minimal = (bool)val;
+
+	return (ssize_t) ret < 0 ? ret : count;
+}
+
 static struct bin_attribute snapshot_attr = {
 	.attr.name = "dump",
 	.attr.mode = 0444,
@@ -1057,6 +1082,8 @@ static SNAPSHOT_ATTR(snapshot_crashdumper, 0644, snapshot_crashdumper_show,
 	snapshot_crashdumper_store);
 static SNAPSHOT_ATTR(snapshot_legacy, 0644, snapshot_legacy_show,
 	snapshot_legacy_store);
+static SNAPSHOT_ATTR(snapshot_minimal, 0644, snapshot_minimal_show,
+	snapshot_minimal_store);
 
 static ssize_t snapshot_sysfs_show(struct kobject *kobj,
 	struct attribute *attr, char *buf)
@@ -1139,6 +1166,7 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 	device->force_panic = 0;
 	device->snapshot_crashdumper = 1;
 	device->snapshot_legacy = 0;
+	device->snapshot_minimal = 0;
 
 	/*
 	 * Set this to false so that we only ever keep the first snapshot around
@@ -1181,6 +1209,11 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 
 	ret  = sysfs_create_file(&device->snapshot_kobj,
 			&attr_snapshot_legacy.attr);
+	if (ret)
+		goto done;
+
+	ret  = sysfs_create_file(&device->snapshot_kobj,
+			&attr_snapshot_minimal.attr);
 
 done:
 	return ret;
@@ -430,6 +430,96 @@ TRACE_EVENT(kgsl_mem_alloc,
 	)
 );
 
+TRACE_EVENT(kgsl_mem_alloc_pages,
+
+	TP_PROTO(struct kgsl_mem_entry *mem_entry, u64 delta),
+
+	TP_ARGS(mem_entry, delta),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, tgid)
+		__field(unsigned int, id)
+		__field(uint64_t, size)
+		__field(unsigned int, pool_pages)
+		__field(unsigned int, system_pages)
+		__field(uint64_t, delta)
+	),
+
+	TP_fast_assign(
+		__entry->tgid = mem_entry->priv->pid;
+		__entry->id = mem_entry->id;
+		__entry->size = mem_entry->memdesc.size;
+		__entry->pool_pages = mem_entry->memdesc.pool_pages;
+		__entry->system_pages = (mem_entry->memdesc.size >>
+			PAGE_SHIFT) - mem_entry->memdesc.pool_pages;
+		__entry->delta = div_u64(delta, NSEC_PER_USEC);
+	),
+
+	TP_printk(
+		"tgid=%u id=%u size=%llu pool_pages=%u system_pages=%u time_us=%llu",
+		__entry->tgid, __entry->id, __entry->size,
+		__entry->pool_pages, __entry->system_pages, __entry->delta
+	)
+);
+
+TRACE_EVENT(kgsl_mem_iommu_map,
+
+	TP_PROTO(struct kgsl_mem_entry *mem_entry, bool unmap, u64 delta),
+
+	TP_ARGS(mem_entry, unmap, delta),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, tgid)
+		__field(unsigned int, id)
+		__field(uint64_t, gpuaddr)
+		__field(uint64_t, size)
+		__field(bool, unmap)
+		__field(uint64_t, delta)
+	),
+
+	TP_fast_assign(
+		__entry->tgid = mem_entry->priv->pid;
+		__entry->id = mem_entry->id;
+		__entry->gpuaddr = mem_entry->memdesc.gpuaddr;
+		__entry->size = mem_entry->memdesc.size;
+		__entry->unmap = unmap;
+		__entry->delta = div_u64(delta, NSEC_PER_USEC);
+	),
+
+	TP_printk(
+		"tgid=%u id=%u gpuaddr=0x%llx size=%llu op=%s time_us=%llu",
+		__entry->tgid, __entry->id, __entry->gpuaddr, __entry->size,
+		__entry->unmap ? "unmap" : "map", __entry->delta
+	)
+);
+
+TRACE_EVENT(kgsl_mem_vmfault,
+
+	TP_PROTO(struct kgsl_mem_entry *mem_entry, unsigned long offset,
+		u64 delta),
+
+	TP_ARGS(mem_entry, offset, delta),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, tgid)
+		__field(unsigned int, id)
+		__field(unsigned long, offset)
+		__field(uint64_t, delta)
+	),
+
+	TP_fast_assign(
+		__entry->tgid = mem_entry->priv->pid;
+		__entry->id = mem_entry->id;
+		__entry->offset = offset;
+		__entry->delta = delta;
+	),
+
+	TP_printk(
+		"tgid=%u id=%u offset=0x%lx time_ns=%llu",
+		__entry->tgid, __entry->id, __entry->offset, __entry->delta
+	)
+);
+
 TRACE_EVENT(kgsl_mem_mmap,
 
 	TP_PROTO(struct kgsl_mem_entry *mem_entry),
@@ -20,6 +20,7 @@
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/platform_device.h>
@@ -27,9 +28,11 @@
 #include <linux/qpnp/qpnp-misc.h>
 #include <linux/regmap.h>
 #include <linux/regulator/consumer.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
+#include <linux/workqueue.h>
 
 enum actutor_type {
 	ACT_LRA,
@@ -176,6 +179,15 @@ enum haptics_custom_effect_param {
 #define REG_HAP_SEC_ACCESS		0xD0
 #define REG_HAP_PERPH_RESET_CTL3	0xDA
 
+/*
+ * Configuration registers from EN_CTL1 to the last WF_Sx sample are only
+ * changed by this driver, so their last written values are shadowed and
+ * writes that would not change them are skipped.
+ */
+#define HAP_SHADOW_START		REG_HAP_EN_CTL1
+#define HAP_SHADOW_LEN			(REG_HAP_WF_S1 + \
+		HAP_WAVEFORM_BUFFER_MAX - HAP_SHADOW_START)
+
 struct qti_hap_effect {
 	int			id;
 	u8			*pattern;
@@ -198,6 +210,22 @@ struct qti_hap_play_info {
 	bool			playing_pattern;
 };
 
+struct qti_hap_latency {
+	u64			count;
+	u64			total_us;
+	u32			last_us;
+	u32			max_us;
+};
+
+struct qti_hap_stats {
+	struct qti_hap_latency	load;
+	struct qti_hap_latency	trigger;
+	struct qti_hap_latency	upload_to_play;
+	u64			bus_writes;
+	u64			skipped_writes;
+	u64			preloads;
+};
+
 struct qti_hap_config {
 	enum actutor_type	act_type;
 	enum lra_res_sig_shape	lra_shape;
@@ -224,8 +252,16 @@ struct qti_hap_chip {
 	struct hrtimer			hap_disable_timer;
 	struct dentry			*hap_debugfs;
 	struct notifier_block		twm_nb;
+	struct work_struct		preload_work;
+	struct mutex			wf_lock;
+	struct qti_hap_stats		stats;
 	spinlock_t			bus_lock;
 	ktime_t				last_sc_time;
+	ktime_t				upload_time;
+	u8				shadow[HAP_SHADOW_LEN];
+	DECLARE_BITMAP(shadow_valid, HAP_SHADOW_LEN);
+	int				preload_idx;
+	u16				preload_vmax_mv;
 	int				play_irq;
 	int				sc_irq;
 	int				effects_count;
@@ -236,6 +272,7 @@ struct qti_hap_chip {
 	bool				vdd_enabled;
 	bool				twm_state;
 	bool				haptics_ext_pin_twm;
+	bool				effect_uploaded;
 };
 
 struct hap_addr_val {
@@ -265,11 +302,111 @@ module_param_named(
 	haptics_twm, twm_sys_enable, int, 0600
 );
 
+/*
+ * Keep the last played predefined effect loaded in the waveform registers
+ * while no effect is uploaded, so that uploading it again costs no bus
+ * write and playing it is a single PLAY write.
+ */
+static bool preload_en = true;
+module_param_named(
+	preload, preload_en, bool, 0600
+);
+
 static inline bool is_secure(u8 addr)
 {
 	return ((addr & 0xFF) > 0xD0);
 }
 
+static inline bool is_shadowed(u8 addr, int len)
+{
+	if (addr <= REG_HAP_SC_CLR && addr + len > REG_HAP_SC_CLR)
+		return false;
+
+	return addr >= HAP_SHADOW_START &&
+		addr + len <= HAP_SHADOW_START + HAP_SHADOW_LEN;
+}
+
+/* Called with bus_lock held */
+static bool qti_haptics_shadow_match(struct qti_hap_chip *chip,
+		u8 addr, u8 *val, int len)
+{
+	int i, off = addr - HAP_SHADOW_START;
+
+	for (i = 0; i < len; i++)
+		if (!test_bit(off + i, chip->shadow_valid) ||
+				chip->shadow[off + i] != val[i])
+			return false;
+
+	return true;
+}
+
+/* Called with bus_lock held */
+static void qti_haptics_shadow_update(struct qti_hap_chip *chip,
+		u8 addr, u8 *val, int len)
+{
+	int off = addr - HAP_SHADOW_START;
+
+	memcpy(&chip->shadow[off], val, len);
+	bitmap_set(chip->shadow_valid, off, len);
+}
+
+static void qti_haptics_shadow_invalidate(struct qti_hap_chip *chip,
+		u8 addr, int len)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&chip->bus_lock, flags);
+	bitmap_clear(chip->shadow_valid, addr - HAP_SHADOW_START, len);
+	spin_unlock_irqrestore(&chip->bus_lock, flags);
+}
+
+/* Called with bus_lock held */
+static int qti_haptics_shadow_update_bits(struct qti_hap_chip *chip,
+		u8 addr, u8 mask, u8 val)
+{
+	int rc, off = addr - HAP_SHADOW_START;
+	unsigned int tmp;
+	u8 new;
+
+	if (!test_bit(off, chip->shadow_valid)) {
+		rc = regmap_read(chip->regmap, chip->reg_base + addr, &tmp);
+		if (rc < 0)
+			return rc;
+
+		chip->shadow[off] = tmp;
+		__set_bit(off, chip->shadow_valid);
+	}
+
+	new = (chip->shadow[off] & ~mask) | (val & mask);
+	if (new == chip->shadow[off]) {
+		chip->stats.skipped_writes++;
+		return 0;
+	}
+
+	rc = regmap_write(chip->regmap, chip->reg_base + addr, new);
+	if (rc < 0) {
+		__clear_bit(off, chip->shadow_valid);
+		return rc;
+	}
+
+	chip->shadow[off] = new;
+	chip->stats.bus_writes++;
+
+	return 0;
+}
+
+static void qti_haptics_latency_add(struct qti_hap_latency *lat,
+		ktime_t start)
+{
+	u32 us = ktime_us_delta(ktime_get(), start);
+
+	lat->count++;
+	lat->total_us += us;
+	lat->last_us = us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
 static int qti_haptics_read(struct qti_hap_chip *chip,
 			u8 addr, u8 *val, int len)
 {
@@ -314,6 +451,12 @@ static int qti_haptics_write(struct qti_hap_chip *chip,
 			}
 		}
 	} else {
+		if (is_shadowed(addr, len) &&
+				qti_haptics_shadow_match(chip, addr, val, len)) {
+			chip->stats.skipped_writes++;
+			goto unlock;
+		}
+
 		if (len > 1)
 			rc = regmap_bulk_write(chip->regmap,
 					chip->reg_base + addr, val, len);
@@ -321,9 +464,18 @@ static int qti_haptics_write(struct qti_hap_chip *chip,
 			rc = regmap_write(chip->regmap,
 					chip->reg_base + addr, *val);
 
+		if (rc < 0)
+			dev_err(chip->dev, "write addr 0x%x failed, rc=%d\n",
+					addr, rc);
+
+		if (is_shadowed(addr, len)) {
 			if (rc < 0)
-				dev_err(chip->dev, "write addr 0x%x failed, rc=%d\n",
-						addr, rc);
+				bitmap_clear(chip->shadow_valid,
+					addr - HAP_SHADOW_START, len);
+			else
+				qti_haptics_shadow_update(chip, addr, val, len);
+		}
+		chip->stats.bus_writes++;
 	}
 
 	for (i = 0; i < len; i++)
@@ -353,7 +505,11 @@ static int qti_haptics_masked_write(struct qti_hap_chip *chip, u8 addr,
 		}
 	}
 
-	rc = regmap_update_bits(chip->regmap, chip->reg_base + addr, mask, val);
+	if (!is_secure(addr) && is_shadowed(addr, 1))
+		rc = qti_haptics_shadow_update_bits(chip, addr, mask, val);
+	else
+		rc = regmap_update_bits(chip->regmap, chip->reg_base + addr,
+				mask, val);
 	if (rc < 0)
 		dev_err(chip->dev, "Update addr 0x%x to val 0x%x with mask 0x%x failed, rc=%d\n",
 				addr, val, mask, rc);
@@ -788,6 +944,9 @@ static irqreturn_t qti_haptics_play_irq_handler(int irq, void *data)
 	if (rc < 0)
 		goto handled;
 
+	/* The samples are consumed by the hardware, always refill them */
+	qti_haptics_shadow_invalidate(chip, REG_HAP_WF_S1,
+			HAP_WAVEFORM_BUFFER_MAX);
 	rc = qti_haptics_config_wf_buffer(chip);
 	if (rc < 0)
 		goto handled;
@@ -838,6 +997,8 @@ static irqreturn_t qti_haptics_sc_irq_handler(int irq, void *data)
 			goto handled;
 
 		dev_crit(chip->dev, "Short circuit persists, disable haptics\n");
+		qti_haptics_shadow_invalidate(chip, HAP_SHADOW_START,
+				HAP_SHADOW_LEN);
 		chip->perm_disable = true;
 	}
 
@@ -860,7 +1021,7 @@ static inline void get_play_length(struct qti_hap_play_info *play,
 	*length_us = tmp;
 }
 
-static int qti_haptics_upload_effect(struct input_dev *dev,
+static int __qti_haptics_upload_effect(struct input_dev *dev,
 		struct ff_effect *effect, struct ff_effect *old)
 {
 	struct qti_hap_chip *chip = input_get_drvdata(dev);
@@ -933,6 +1094,9 @@ static int qti_haptics_upload_effect(struct input_dev *dev,
 			return rc;
 		}
 
+		chip->preload_idx = i;
+		chip->preload_vmax_mv = play->vmax_mv;
+
 		get_play_length(play, &play->length_us);
 		data[CUSTOM_DATA_TIMEOUT_SEC_IDX] =
 			play->length_us / USEC_PER_SEC;
@@ -968,10 +1132,30 @@ static int qti_haptics_upload_effect(struct input_dev *dev,
 	return 0;
 }
 
+static int qti_haptics_upload_effect(struct input_dev *dev,
+		struct ff_effect *effect, struct ff_effect *old)
+{
+	struct qti_hap_chip *chip = input_get_drvdata(dev);
+	ktime_t start = ktime_get();
+	int rc;
+
+	mutex_lock(&chip->wf_lock);
+	chip->effect_uploaded = true;
+	rc = __qti_haptics_upload_effect(dev, effect, old);
+	if (!rc) {
+		qti_haptics_latency_add(&chip->stats.load, start);
+		chip->upload_time = start;
+	}
+	mutex_unlock(&chip->wf_lock);
+
+	return rc;
+}
+
 static int qti_haptics_playback(struct input_dev *dev, int effect_id, int val)
 {
 	struct qti_hap_chip *chip = input_get_drvdata(dev);
 	struct qti_hap_play_info *play = &chip->play;
+	ktime_t start = ktime_get();
 	s64 secs;
 	unsigned long nsecs;
 	int rc = 0;
@@ -986,6 +1170,13 @@ static int qti_haptics_playback(struct input_dev *dev, int effect_id, int val)
 		if (rc < 0)
 			return rc;
 
+		qti_haptics_latency_add(&chip->stats.trigger, start);
+		if (chip->upload_time) {
+			qti_haptics_latency_add(&chip->stats.upload_to_play,
+					chip->upload_time);
+			chip->upload_time = 0;
+		}
+
 		if (play->playing_pattern) {
 			if (!chip->play_irq_en) {
 				enable_irq(chip->play_irq);
@@ -1022,12 +1213,13 @@ static int qti_haptics_erase(struct input_dev *dev, int effect_id)
 	struct qti_hap_chip *chip = input_get_drvdata(dev);
 	int delay_us, rc = 0;
 
+	mutex_lock(&chip->wf_lock);
 	if (chip->vdd_supply && chip->vdd_enabled) {
 		rc = regulator_disable(chip->vdd_supply);
 		if (rc < 0) {
 			dev_err(chip->dev, "Disable VDD supply failed, rc=%d\n",
 					rc);
-			return rc;
+			goto unlock;
 		}
 		chip->vdd_enabled = false;
 	}
@@ -1035,8 +1227,9 @@ static int qti_haptics_erase(struct input_dev *dev, int effect_id)
 	rc = qti_haptics_clear_settings(chip);
 	if (rc < 0) {
 		dev_err(chip->dev, "clear setting failed, rc=%d\n", rc);
-		return rc;
+		goto unlock;
 	}
+	chip->effect_uploaded = false;
 
 	if (chip->play.effect)
 		delay_us = chip->play.effect->play_rate_us;
@@ -1047,7 +1240,8 @@ static int qti_haptics_erase(struct input_dev *dev, int effect_id)
 	hrtimer_start(&chip->hap_disable_timer,
 			ktime_set(0, delay_us * NSEC_PER_USEC),
 			HRTIMER_MODE_REL);
-
+unlock:
+	mutex_unlock(&chip->wf_lock);
 	return rc;
 }
 
@@ -1222,9 +1416,50 @@ static enum hrtimer_restart qti_hap_disable_timer(struct hrtimer *timer)
 		dev_err(chip->dev, "Disable haptics module failed, rc=%d\n",
 				rc);
 
+	/* The clear sequence is done, load the waveform back */
+	if (preload_en && !chip->effect_uploaded)
+		schedule_work(&chip->preload_work);
+
 	return HRTIMER_NORESTART;
 }
 
+/* Called with wf_lock held */
+static int qti_haptics_preload(struct qti_hap_chip *chip)
+{
+	struct qti_hap_play_info *play = &chip->play;
+	int rc;
+
+	if (!preload_en || chip->effects_count == 0 || chip->perm_disable)
+		return 0;
+
+	play->vmax_mv = chip->preload_vmax_mv;
+	rc = qti_haptics_load_predefined_effect(chip, chip->preload_idx);
+	if (rc < 0)
+		return rc;
+
+	get_play_length(play, &play->length_us);
+	chip->stats.preloads++;
+
+	return 0;
+}
+
+static void qti_haptics_preload_work(struct work_struct *work)
+{
+	struct qti_hap_chip *chip = container_of(work, struct qti_hap_chip,
+			preload_work);
+	int rc;
+
+	mutex_lock(&chip->wf_lock);
+	/* Never overwrite an effect uploaded in the meantime */
+	if (!chip->effect_uploaded) {
+		rc = qti_haptics_preload(chip);
+		if (rc < 0)
+			dev_err(chip->dev, "Preload effect %d failed, rc=%d\n",
+					chip->preload_idx, rc);
+	}
+	mutex_unlock(&chip->wf_lock);
+}
+
 static void verify_brake_setting(struct qti_hap_effect *effect)
 {
 	int i = effect->brake_pattern_length - 1;
@@ -1878,6 +2113,42 @@ static int create_effect_debug_files(struct qti_hap_effect *effect,
 	return 0;
 }
 
+static void latency_show(struct seq_file *m, const char *name,
+		struct qti_hap_latency *lat)
+{
+	seq_printf(m, "%s: count=%llu last_us=%u max_us=%u avg_us=%llu\n",
+			name, lat->count, lat->last_us, lat->max_us,
+			lat->count ? div64_u64(lat->total_us, lat->count) : 0);
+}
+
+static int stats_dbgfs_show(struct seq_file *m, void *unused)
+{
+	struct qti_hap_chip *chip = m->private;
+	struct qti_hap_stats *stats = &chip->stats;
+
+	latency_show(m, "load", &stats->load);
+	latency_show(m, "trigger", &stats->trigger);
+	latency_show(m, "upload_to_play", &stats->upload_to_play);
+	seq_printf(m, "bus_writes=%llu skipped_writes=%llu preloads=%llu\n",
+			stats->bus_writes, stats->skipped_writes,
+			stats->preloads);
+
+	return 0;
+}
+
+static int stats_dbgfs_open(struct inode *inode, struct file *filep)
+{
+	return single_open(filep, stats_dbgfs_show, inode->i_private);
+}
+
+static const struct file_operations stats_dbgfs_ops = {
+	.open = stats_dbgfs_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+	.owner = THIS_MODULE,
+};
+
 static int qti_haptics_add_debugfs(struct qti_hap_chip *chip)
 {
 	struct dentry *hap_dir, *effect_dir;
@@ -1890,6 +2161,13 @@ static int qti_haptics_add_debugfs(struct qti_hap_chip *chip)
 		return -ENOMEM;
 	}
 
+	if (!debugfs_create_file("stats", 0444, hap_dir, chip,
+				&stats_dbgfs_ops)) {
+		pr_err("create stats debugfs node failed\n");
+		rc = -ENOMEM;
+		goto cleanup;
+	}
+
 	for (i = 0; i < chip->effects_count; i++) {
 		snprintf(str, ARRAY_SIZE(str), "effect%d", i);
 		effect_dir = debugfs_create_dir(str, hap_dir);
@@ -1946,6 +2224,8 @@ static int qti_haptics_probe(struct platform_device *pdev)
 	}
 
 	spin_lock_init(&chip->bus_lock);
+	mutex_init(&chip->wf_lock);
+	INIT_WORK(&chip->preload_work, qti_haptics_preload_work);
 
 	rc = qti_haptics_hw_init(chip);
 	if (rc < 0) {
@@ -1953,6 +2233,14 @@ static int qti_haptics_probe(struct platform_device *pdev)
 		return rc;
 	}
 
+	if (chip->effects_count != 0) {
+		chip->preload_vmax_mv = chip->predefined[0].vmax_mv;
+		rc = qti_haptics_preload(chip);
+		if (rc < 0)
+			dev_err(chip->dev, "Preload effect failed, rc=%d\n",
+					rc);
+	}
+
 	rc = devm_request_threaded_irq(chip->dev, chip->play_irq, NULL,
 			qti_haptics_play_irq_handler,
 			IRQF_ONESHOT, "hap_play_irq", chip);
@@ -2038,6 +2326,8 @@ static int qti_haptics_remove(struct platform_device *pdev)
 #ifdef CONFIG_DEBUG_FS
 	debugfs_remove_recursive(chip->hap_debugfs);
 #endif
+	hrtimer_cancel(&chip->hap_disable_timer);
+	cancel_work_sync(&chip->preload_work);
 	input_ff_destroy(chip->input_dev);
 	qpnp_misc_twm_notifier_unregister(&chip->twm_nb);
 	dev_set_drvdata(chip->dev, NULL);
@@ -2071,6 +2361,32 @@ static void qti_haptics_shutdown(struct platform_device *pdev)
 	}
 }
 
+#ifdef CONFIG_PM_SLEEP
+static int qti_haptics_suspend(struct device *dev)
+{
+	struct qti_hap_chip *chip = dev_get_drvdata(dev);
+
+	cancel_work_sync(&chip->preload_work);
+
+	return 0;
+}
+
+static int qti_haptics_resume(struct device *dev)
+{
+	struct qti_hap_chip *chip = dev_get_drvdata(dev);
+
+	/* Do not trust the shadow across a suspend, reload from scratch */
+	qti_haptics_shadow_invalidate(chip, HAP_SHADOW_START, HAP_SHADOW_LEN);
+	if (preload_en)
+		schedule_work(&chip->preload_work);
+
+	return 0;
+}
+#endif
+
+static SIMPLE_DEV_PM_OPS(qti_haptics_pm_ops, qti_haptics_suspend,
+		qti_haptics_resume);
+
 static const struct of_device_id haptics_match_table[] = {
 	{ .compatible = "qcom,haptics" },
 	{ .compatible = "qcom,pm660-haptics" },
@@ -2083,6 +2399,7 @@ static struct platform_driver qti_haptics_driver = {
 		.name = "qcom,haptics",
 		.owner = THIS_MODULE,
 		.of_match_table = haptics_match_table,
+		.pm = &qti_haptics_pm_ops,
 	},
 	.probe		= qti_haptics_probe,
 	.remove		= qti_haptics_remove,
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Touch gesture hints
+ *
+ * Input handlers such as cpu-boost only see individual events, and react
+ * to a tap exactly as to a fling. Touchscreen drivers report the primary
+ * contact of every frame here instead, and the gesture is published as
+ * down, rate limited move and up hints carrying the contact speed. The
+ * speed at up is the fling velocity, zero or close to it for a tap.
+ */
+
+#define pr_fmt(fmt) "touch_hint: " fmt
+
+#include <linux/input/touch_hint.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/spinlock.h>
+
+static unsigned int move_interval_ms = 16;
+module_param(move_interval_ms, uint, 0644);
+
+static ATOMIC_NOTIFIER_HEAD(touch_hint_chain);
+static DEFINE_SPINLOCK(touch_hint_lock);
+
+static struct {
+	bool down;
+	int x;
+	int y;
+	ktime_t last;
+	ktime_t last_move;
+	struct touch_hint hint;
+} th;
+
+int touch_hint_register_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&touch_hint_chain, nb);
+}
+EXPORT_SYMBOL_GPL(touch_hint_register_notifier);
+
+int touch_hint_unregister_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&touch_hint_chain, nb);
+}
+EXPORT_SYMBOL_GPL(touch_hint_unregister_notifier);
+
+/* Speed over the last frame, averaged with the previous estimate */
+static void touch_hint_track(int x, int y, ktime_t time)
+{
+	s64 dt = ktime_us_delta(time, th.last);
+	unsigned long dx = abs(x - th.x), dy = abs(y - th.y);
+	u64 v;
+
+	if (dt <= 0)
+		return;
+
+	v = div64_u64((u64)int_sqrt(dx * dx + dy * dy) * USEC_PER_SEC, dt);
+	th.hint.velocity = min_t(u64, (th.hint.velocity + v) / 2, UINT_MAX);
+}
+
+/**
+ * touch_hint_report() - Report the primary contact of a touch frame
+ * @x: X position of the primary contact
+ * @y: Y position of the primary contact
+ * @fingers: Number of contacts down, 0 once all are lifted
+ * @time: Time the frame was sensed, typically the interrupt time
+ *
+ * Called by touchscreen drivers once per frame, in sleepable or atomic
+ * context. @x and @y are ignored when @fingers is 0.
+ */
+void touch_hint_report(int x, int y, unsigned int fingers, ktime_t time)
+{
+	struct touch_hint hint;
+	unsigned long flags;
+	int event = -1;
+
+	spin_lock_irqsave(&touch_hint_lock, flags);
+	if (fingers && !th.down) {
+		th.down = true;
+		th.hint.velocity = 0;
+		th.hint.down_time = time;
+		th.last_move = time;
+		event = TOUCH_HINT_DOWN;
+	} else if (fingers) {
+		touch_hint_track(x, y, time);
+		if (ktime_ms_delta(time, th.last_move) >= move_interval_ms) {
+			th.last_move = time;
+			event = TOUCH_HINT_MOVE;
+		}
+	} else if (th.down) {
+		th.down = false;
+		event = TOUCH_HINT_UP;
+	}
+
+	if (fingers) {
+		th.x = x;
+		th.y = y;
+		th.last = time;
+	}
+	th.hint.fingers = fingers;
+	th.hint.time = time;
+	hint = th.hint;
+	spin_unlock_irqrestore(&touch_hint_lock, flags);
+
+	if (event >= 0)
+		atomic_notifier_call_chain(&touch_hint_chain, event, &hint);
+}
+EXPORT_SYMBOL_GPL(touch_hint_report);
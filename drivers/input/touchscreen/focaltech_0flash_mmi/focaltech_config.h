@@ -224,6 +224,15 @@
  */
 #define FTS_USB_DETECT_EN                       1
 
+/*
+ * Low latency touch reporting: events are timestamped in the hard irq
+ * (MSC_TIMESTAMP), the irq thread runs at top RT priority on the cpu
+ * given by "focaltech,irq-cpu" and irq to input_sync latency is kept
+ * in fts_latency
+ * 1: enable, 0: disable
+ */
+#define FTS_LOW_LATENCY_EN                      1
+
 /*
  * module_id: mean vendor_id generally, also maybe gpio or lcm_id...
  * If means vendor_id, the FTS_MODULE_ID = PANEL_ID << 8 + VENDOR_ID
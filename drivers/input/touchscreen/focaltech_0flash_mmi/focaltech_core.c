@@ -37,6 +37,7 @@
 #include <linux/of_device.h>
 #include <linux/of_gpio.h>
 #include <linux/of_irq.h>
+#include <linux/input/touch_hint.h>
 
 #ifdef CONFIG_DRM
 	#include <linux/msm_drm_notify.h>
@@ -388,6 +389,7 @@ void fts_release_all_finger(void)
 #endif
     input_report_key(input_dev, BTN_TOUCH, 0);
     input_sync(input_dev);
+    touch_hint_report(0, 0, 0, ktime_get());
 
     fts_data->touchs = 0;
     fts_data->key_state = 0;
@@ -437,6 +439,30 @@ static int fts_input_report_key(struct fts_ts_data *data, int index)
     return -EINVAL;
 }
 
+#ifdef CONFIG_INPUT_TOUCH_HINT
+/* Publish the gesture phase with the first contact down as primary */
+static void fts_report_touch_hint(struct fts_ts_data *data, u32 touchs)
+{
+    struct ts_event *events = data->events;
+    int i = 0;
+#if FTS_LOW_LATENCY_EN
+    ktime_t time = data->irq_time;
+#else
+    ktime_t time = ktime_get();
+#endif
+
+    for (i = 0; i < data->touch_point; i++) {
+        if (EVENT_DOWN(events[i].flag) && (touchs & BIT(events[i].id)))
+            break;
+    }
+
+    if (i < data->touch_point)
+        touch_hint_report(events[i].x, events[i].y, hweight32(touchs), time);
+    else
+        touch_hint_report(0, 0, 0, time);
+}
+#endif
+
 #if FTS_MT_PROTOCOL_B_EN
 static int fts_input_report_b(struct fts_ts_data *data)
 {
@@ -517,6 +543,13 @@ static int fts_input_report_b(struct fts_ts_data *data)
         }
     }
 
+#ifdef CONFIG_INPUT_TOUCH_HINT
+    fts_report_touch_hint(data, touchs);
+#endif
+#if FTS_LOW_LATENCY_EN
+    input_event(data->input_dev, EV_MSC, MSC_TIMESTAMP,
+                (u32)ktime_to_us(data->irq_time));
+#endif
     input_sync(data->input_dev);
     return 0;
 }
@@ -808,11 +841,41 @@ void fts_cable_detect_func(bool force_renew)
 }
 #endif
 
+#if FTS_LOW_LATENCY_EN
+static void fts_latency_update(struct fts_ts_data *ts_data)
+{
+    u32 us = (u32)ktime_us_delta(ktime_get(), ts_data->irq_time);
+
+    ts_data->lat_last_us = us;
+    ts_data->lat_sum_us += us;
+    ts_data->lat_count++;
+    if (us > ts_data->lat_max_us)
+        ts_data->lat_max_us = us;
+}
+
+/* The irq thread is created by the irq core, raise it on its first run */
+static void fts_irq_thread_setup(struct fts_ts_data *ts_data)
+{
+    struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
+
+    if (likely(ts_data->irq_thread_rt))
+        return;
+
+    ts_data->irq_thread_rt = true;
+    if (sched_setscheduler_nocheck(current, SCHED_FIFO, &param))
+        FTS_ERROR("set irq thread priority fail");
+}
+#endif
+
 static void fts_irq_read_report(void)
 {
     int ret = 0;
     struct fts_ts_data *ts_data = fts_data;
 
+#if FTS_LOW_LATENCY_EN
+    fts_irq_thread_setup(ts_data);
+#endif
+
 #if FTS_USB_DETECT_EN
 	fts_cable_detect_func(false);
 #endif
@@ -832,6 +895,9 @@ static void fts_irq_read_report(void)
         fts_input_report_b(ts_data);
 #else
         fts_input_report_a(ts_data);
+#endif
+#if FTS_LOW_LATENCY_EN
+        fts_latency_update(ts_data);
 #endif
         mutex_unlock(&ts_data->report_mutex);
     }
@@ -842,6 +908,16 @@ static void fts_irq_read_report(void)
 
 }
 
+#if FTS_LOW_LATENCY_EN
+static irqreturn_t fts_irq_hardirq(int irq, void *data)
+{
+    struct fts_ts_data *ts_data = data;
+
+    ts_data->irq_time = ktime_get();
+    return IRQ_WAKE_THREAD;
+}
+#endif
+
 static irqreturn_t fts_irq_handler(int irq, void *data)
 {
     fts_irq_read_report();
@@ -856,9 +932,20 @@ static int fts_irq_registration(struct fts_ts_data *ts_data)
     ts_data->irq = gpio_to_irq(pdata->irq_gpio);
     pdata->irq_gpio_flags = IRQF_TRIGGER_FALLING | IRQF_ONESHOT;
     FTS_INFO("irq:%d, flag:%x", ts_data->irq, pdata->irq_gpio_flags);
+#if FTS_LOW_LATENCY_EN
+    ret = request_threaded_irq(ts_data->irq, fts_irq_hardirq, fts_irq_handler,
+                               pdata->irq_gpio_flags,
+                               FTS_DRIVER_NAME, ts_data);
+    /* the irq thread follows the irq affinity */
+    if (!ret && (pdata->irq_cpu >= 0) && cpu_possible(pdata->irq_cpu)) {
+        if (irq_set_affinity_hint(ts_data->irq, cpumask_of(pdata->irq_cpu)))
+            FTS_ERROR("set irq affinity to cpu%d fail", pdata->irq_cpu);
+    }
+#else
     ret = request_threaded_irq(ts_data->irq, NULL, fts_irq_handler,
                                pdata->irq_gpio_flags,
                                FTS_DRIVER_NAME, ts_data);
+#endif
 
     return ret;
 }
@@ -888,6 +975,9 @@ static int fts_input_init(struct fts_ts_data *ts_data)
     __set_bit(EV_SYN, input_dev->evbit);
     __set_bit(EV_ABS, input_dev->evbit);
     __set_bit(EV_KEY, input_dev->evbit);
+#if FTS_LOW_LATENCY_EN
+    input_set_capability(input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
     __set_bit(BTN_TOUCH, input_dev->keybit);
     __set_bit(INPUT_PROP_DIRECT, input_dev->propbit);
 
@@ -1554,6 +1644,13 @@ static int fts_parse_dt(struct device *dev, struct fts_ts_platform_data *pdata)
     FTS_INFO("max touch number:%d, irq gpio:%d, reset gpio:%d",
              pdata->max_touch_number, pdata->irq_gpio, pdata->reset_gpio);
 
+    pdata->irq_cpu = -1;
+    ret = of_property_read_u32(np, "focaltech,irq-cpu", &temp_val);
+    if (ret == 0) {
+        pdata->irq_cpu = temp_val;
+        FTS_INFO("irq cpu:%d", pdata->irq_cpu);
+    }
+
 	ret = of_property_read_string(np, "focaltech,panel-supplier",
 		&ts_data->panel_supplier);
 	if (ret < 0) {
@@ -1745,6 +1842,9 @@ static int fts_reboot(struct notifier_block *nb,
 #endif
 
 	fts_irq_disable();
+#if FTS_LOW_LATENCY_EN
+	irq_set_affinity_hint(ts_data->irq, NULL);
+#endif
 	free_irq(ts_data->irq, ts_data);
 
 	if (gpio_is_valid(ts_data->pdata->reset_gpio)) {
@@ -2038,6 +2138,9 @@ static int fts_ts_remove_entry(struct fts_ts_data *ts_data)
 
     fts_bus_exit(ts_data);
 
+#if FTS_LOW_LATENCY_EN
+    irq_set_affinity_hint(ts_data->irq, NULL);
+#endif
     free_irq(ts_data->irq, ts_data);
     input_unregister_device(ts_data->input_dev);
 
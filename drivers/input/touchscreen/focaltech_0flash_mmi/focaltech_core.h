@@ -61,6 +61,7 @@
 #include <linux/sched.h>
 #include <linux/kthread.h>
 #include <linux/dma-mapping.h>
+#include <uapi/linux/sched/types.h>
 #include "focaltech_common.h"
 #ifdef FTS_USB_DETECT_EN
 #include <linux/power_supply.h>
@@ -150,6 +151,7 @@ struct fts_ts_platform_data {
     u32 x_min;
     u32 y_min;
     u32 max_touch_number;
+    int irq_cpu;
 };
 
 struct ts_event {
@@ -239,6 +241,15 @@ struct fts_ts_data {
 #endif
 	struct notifier_block fts_reboot;
 
+#if FTS_LOW_LATENCY_EN
+    ktime_t irq_time;
+    bool irq_thread_rt;
+    u64 lat_count;
+    u64 lat_sum_us;
+    u32 lat_max_us;
+    u32 lat_last_us;
+#endif
+
 #ifdef FOCALTECH_SENSOR_EN
     bool wakeable;
     bool should_enable_gesture;
@@ -585,6 +585,43 @@ static ssize_t fts_irq_store(
     return count;
 }
 
+#if FTS_LOW_LATENCY_EN
+/* irq to input_sync latency of reported frames, write to reset */
+static ssize_t fts_latency_show(
+    struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct fts_ts_data *ts_data = fts_data;
+    ssize_t count = 0;
+
+    mutex_lock(&ts_data->report_mutex);
+    count = snprintf(buf, PAGE_SIZE,
+                     "count:%llu avg_us:%llu max_us:%u last_us:%u\n",
+                     ts_data->lat_count,
+                     ts_data->lat_count ?
+                     div64_u64(ts_data->lat_sum_us, ts_data->lat_count) : 0,
+                     ts_data->lat_max_us, ts_data->lat_last_us);
+    mutex_unlock(&ts_data->report_mutex);
+
+    return count;
+}
+
+static ssize_t fts_latency_store(
+    struct device *dev,
+    struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct fts_ts_data *ts_data = fts_data;
+
+    mutex_lock(&ts_data->report_mutex);
+    ts_data->lat_count = 0;
+    ts_data->lat_sum_us = 0;
+    ts_data->lat_max_us = 0;
+    ts_data->lat_last_us = 0;
+    mutex_unlock(&ts_data->report_mutex);
+
+    return count;
+}
+#endif
+
 static ssize_t drv_irq_show(
     struct device *dev, struct device_attribute *attr, char *buf)
 {
@@ -1308,6 +1345,9 @@ static DEVICE_ATTR(fts_boot_mode, S_IRUGO | S_IWUSR, fts_bootmode_show, fts_boot
 static DEVICE_ATTR(fts_touch_point, S_IRUGO | S_IWUSR, fts_tpbuf_show, fts_tpbuf_store);
 static DEVICE_ATTR(fts_log_level, S_IRUGO | S_IWUSR, fts_log_level_show, fts_log_level_store);
 static DEVICE_ATTR(drv_irq, S_IRUGO | S_IWUSR, drv_irq_show, drv_irq_store);
+#if FTS_LOW_LATENCY_EN
+static DEVICE_ATTR(fts_latency, S_IRUGO | S_IWUSR, fts_latency_show, fts_latency_store);
+#endif
 static DEVICE_ATTR(reset, S_IWUSR | S_IWGRP, NULL, reset_store);
 static DEVICE_ATTR(buildid, S_IRUGO, buildid_show, NULL);
 static DEVICE_ATTR(forcereflash, S_IWUSR | S_IWGRP, NULL, forcereflash_store);
@@ -1331,6 +1371,9 @@ static struct attribute *fts_attributes[] = {
     &dev_attr_fts_touch_point.attr,
     &dev_attr_fts_log_level.attr,
     &dev_attr_drv_irq.attr,
+#if FTS_LOW_LATENCY_EN
+    &dev_attr_fts_latency.attr,
+#endif
     &dev_attr_reset.attr,
     &dev_attr_buildid.attr,
     &dev_attr_forcereflash.attr,
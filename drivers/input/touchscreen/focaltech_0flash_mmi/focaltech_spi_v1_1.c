@@ -399,8 +399,8 @@ int fts_read(u8 *cmd, u32 cmdlen, u8 *data, u32 datalen)
         } else {
             txbuf = ts_data->bus_tx_buf;
             rxbuf = ts_data->bus_rx_buf;
-            memset(txbuf, 0x00, SPI_BUF_LENGTH);
-            memset(rxbuf, 0x00, SPI_BUF_LENGTH);
+            /* rx is fully overwritten by the transfer */
+            memset(txbuf, 0x00, datalen + SPI_HEADER_LENGTH);
         }
 
         txbuf[0] = DATA_PACKAGE;
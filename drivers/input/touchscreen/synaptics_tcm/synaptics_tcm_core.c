@@ -3337,6 +3337,7 @@ static int syna_tcm_probe(struct platform_device *pdev)
 	atomic_set(&tcm_hcd->helper.task, HELP_NONE);
 
 	device_init_wakeup(&pdev->dev, 1);
+	device_enable_async_suspend(&pdev->dev);
 
 	init_waitqueue_head(&tcm_hcd->hdl_wq);
 
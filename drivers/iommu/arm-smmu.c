@@ -2200,6 +2200,8 @@ static int arm_smmu_init_domain_context(struct iommu_domain *domain,
 		quirks |= IO_PGTABLE_QUIRK_NO_DMA;
 	if (smmu_domain->attributes & (1 << DOMAIN_ATTR_USE_LLC_NWA))
 		quirks |= IO_PGTABLE_QUIRK_QCOM_USE_LLC_NWA;
+	if (smmu_domain->attributes & (1 << DOMAIN_ATTR_DEFER_TLB_FLUSH))
+		quirks |= IO_PGTABLE_QUIRK_DEFER_TLBI;
 	if (((quirks & IO_PGTABLE_QUIRK_QCOM_USE_UPSTREAM_HINT) ||
 	     (quirks & IO_PGTABLE_QUIRK_QCOM_USE_LLC_NWA)) &&
 		(smmu->model == QCOM_SMMUV500))
@@ -3071,6 +3073,26 @@ static size_t arm_smmu_unmap(struct iommu_domain *domain, unsigned long iova,
 	return ret;
 }
 
+/*
+ * Unmaps on domains with DOMAIN_ATTR_DEFER_TLB_FLUSH leave the TLB alone,
+ * invalidate it here once for everything unmapped since the last sync.
+ */
+static void arm_smmu_iotlb_sync(struct iommu_domain *domain)
+{
+	struct arm_smmu_domain *smmu_domain = to_smmu_domain(domain);
+
+	if (!smmu_domain->smmu || !smmu_domain->pgtbl_ops ||
+		!(smmu_domain->attributes & (1 << DOMAIN_ATTR_DEFER_TLB_FLUSH)))
+		return;
+
+	if (arm_smmu_domain_power_on(domain, smmu_domain->smmu))
+		return;
+
+	smmu_domain->pgtbl_cfg.tlb->tlb_flush_all(smmu_domain);
+
+	arm_smmu_domain_power_off(domain, smmu_domain->smmu);
+}
+
 #define MAX_MAP_SG_BATCH_SIZE (SZ_4M)
 static size_t arm_smmu_map_sg(struct iommu_domain *domain, unsigned long iova,
 			   struct scatterlist *sg, unsigned int nents, int prot)
@@ -3132,6 +3154,7 @@ out:
 
 	if (size_to_unmap) {
 		arm_smmu_unmap(domain, __saved_iova_start, size_to_unmap);
+		arm_smmu_iotlb_sync(domain);
 		iova = __saved_iova_start;
 	}
 	arm_smmu_secure_domain_unlock(smmu_domain);
@@ -3598,6 +3621,11 @@ static int arm_smmu_domain_get_attr(struct iommu_domain *domain,
 				   (1 << DOMAIN_ATTR_USE_LLC_NWA));
 		ret = 0;
 		break;
+	case DOMAIN_ATTR_DEFER_TLB_FLUSH:
+		*((int *)data) = !!(smmu_domain->attributes &
+				   (1 << DOMAIN_ATTR_DEFER_TLB_FLUSH));
+		ret = 0;
+		break;
 	case DOMAIN_ATTR_EARLY_MAP:
 		*((int *)data) = !!(smmu_domain->attributes
 				    & (1 << DOMAIN_ATTR_EARLY_MAP));
@@ -3796,6 +3824,17 @@ static int arm_smmu_domain_set_attr(struct iommu_domain *domain,
 				1 << DOMAIN_ATTR_USE_LLC_NWA;
 		ret = 0;
 		break;
+	case DOMAIN_ATTR_DEFER_TLB_FLUSH:
+		/* can't be changed while attached */
+		if (smmu_domain->smmu != NULL) {
+			ret = -EBUSY;
+			break;
+		}
+		if (*((int *)data))
+			smmu_domain->attributes |=
+				1 << DOMAIN_ATTR_DEFER_TLB_FLUSH;
+		ret = 0;
+		break;
 	case DOMAIN_ATTR_EARLY_MAP: {
 		int early_map = *((int *)data);
 
@@ -4091,6 +4130,7 @@ static struct iommu_ops arm_smmu_ops = {
 	.detach_dev		= arm_smmu_detach_dev,
 	.map			= arm_smmu_map,
 	.unmap			= arm_smmu_unmap,
+	.iotlb_sync		= arm_smmu_iotlb_sync,
 	.map_sg			= arm_smmu_map_sg,
 	.iova_to_phys		= arm_smmu_iova_to_phys,
 	.iova_to_phys_hard	= arm_smmu_iova_to_phys_hard,
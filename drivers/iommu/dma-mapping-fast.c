@@ -10,10 +10,13 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/debugfs.h>
 #include <linux/dma-contiguous.h>
 #include <linux/dma-mapping.h>
 #include <linux/dma-mapping-fast.h>
 #include <linux/io-pgtable-fast.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
 #include <linux/vmalloc.h>
 #include <asm/cacheflush.h>
 #include <asm/dma-iommu.h>
@@ -31,6 +34,36 @@
 #define FAST_PAGE_SIZE (1UL << FAST_PAGE_SHIFT)
 #define FAST_PAGE_MASK (~(PAGE_SIZE - 1))
 
+/*
+ * Per-CPU caches of freed iovas, one per power of two size below
+ * FAST_IOVA_CACHE_ORDERS pages, sitting in front of the bitmap allocator.
+ * Cached iovas stay set in the bitmap, so the bitmap and its stale TLB
+ * tracking never see them.  Their ptes are unmapped but the TLB may still
+ * hold them, so frees go into a "dirty" magazine which can only be
+ * allocated from once a full TLB invalidation has been issued after its
+ * last free.
+ */
+#define FAST_IOVA_CACHE_ORDERS	4
+#define FAST_IOVA_MAG_SIZE	32
+
+struct fast_iova_magazine {
+	unsigned int	count;
+	unsigned long	tlbi_gen;
+	dma_addr_t	iova[FAST_IOVA_MAG_SIZE];
+};
+
+struct fast_iova_cache {
+	struct fast_iova_magazine *clean[FAST_IOVA_CACHE_ORDERS];
+	struct fast_iova_magazine *dirty[FAST_IOVA_CACHE_ORDERS];
+	struct fast_iova_magazine mags[2 * FAST_IOVA_CACHE_ORDERS];
+};
+
+static bool fast_smmu_iova_cache_enable = true;
+static atomic_t fast_smmu_iova_cache_hit;
+static atomic_t fast_smmu_iova_cache_miss;
+static atomic_t fast_smmu_iova_cache_tlbi;
+static atomic_t fast_smmu_lock_contended;
+
 static pgprot_t __get_dma_pgprot(unsigned long attrs, pgprot_t prot,
 				 bool coherent)
 {
@@ -125,6 +158,37 @@ static bool __bit_covered_stale(unsigned long upcoming_stale,
 	return true;
 }
 
+static void __fast_smmu_lock(struct dma_fast_smmu_mapping *mapping)
+{
+	if (spin_trylock(&mapping->lock))
+		return;
+
+	atomic_inc(&fast_smmu_lock_contended);
+	spin_lock(&mapping->lock);
+}
+
+static void fast_smmu_lock(struct dma_fast_smmu_mapping *mapping,
+			   unsigned long *flags)
+{
+	local_irq_save(*flags);
+	__fast_smmu_lock(mapping);
+}
+
+/* Must be called with mapping->lock held */
+static void __fast_smmu_tlbiall(struct dma_fast_smmu_mapping *mapping,
+				bool skip_sync)
+{
+	iommu_tlbiall(mapping->domain);
+	mapping->have_stale_tlbs = false;
+	av8l_fast_clear_stale_ptes(mapping->pgtbl_ops,
+			mapping->domain->geometry.aperture_start,
+			mapping->base,
+			mapping->base + mapping->size - 1,
+			skip_sync);
+	/* only bumped once the invalidation has completed */
+	smp_store_release(&mapping->tlbi_gen, mapping->tlbi_gen + 1);
+}
+
 static dma_addr_t __fast_smmu_alloc_iova(struct dma_fast_smmu_mapping *mapping,
 					 unsigned long attrs,
 					 size_t size)
@@ -171,13 +235,7 @@ static dma_addr_t __fast_smmu_alloc_iova(struct dma_fast_smmu_mapping *mapping,
 				bit + nbits - 1)) {
 		bool skip_sync = (attrs & DMA_ATTR_SKIP_CPU_SYNC);
 
-		iommu_tlbiall(mapping->domain);
-		mapping->have_stale_tlbs = false;
-		av8l_fast_clear_stale_ptes(mapping->pgtbl_ops,
-				mapping->domain->geometry.aperture_start,
-				mapping->base,
-				mapping->base + mapping->size - 1,
-				skip_sync);
+		__fast_smmu_tlbiall(mapping, skip_sync);
 	}
 
 	iova =  (bit << FAST_PAGE_SHIFT) + mapping->base;
@@ -308,6 +366,130 @@ static void __fast_smmu_free_iova(struct dma_fast_smmu_mapping *mapping,
 	mapping->have_stale_tlbs = true;
 }
 
+static struct fast_iova_cache __percpu *fast_iova_cache_alloc(void)
+{
+	struct fast_iova_cache __percpu *caches;
+	struct fast_iova_cache *cache;
+	int cpu, i;
+
+	caches = alloc_percpu(struct fast_iova_cache);
+	if (!caches)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(caches, cpu);
+		for (i = 0; i < FAST_IOVA_CACHE_ORDERS; i++) {
+			cache->clean[i] = &cache->mags[2 * i];
+			cache->dirty[i] = &cache->mags[2 * i + 1];
+		}
+	}
+	return caches;
+}
+
+/* Returns the cache order for @size, or -1 if it isn't cached */
+static int fast_iova_cache_order(struct dma_fast_smmu_mapping *mapping,
+				 size_t size)
+{
+	unsigned long nbits = size >> FAST_PAGE_SHIFT;
+
+	/* guard pages are sized per allocation, so entries aren't reusable */
+	if (!mapping->iova_cache || mapping->min_iova_align ||
+	    !fast_smmu_iova_cache_enable)
+		return -1;
+
+	if (!is_power_of_2(nbits) || ilog2(nbits) >= FAST_IOVA_CACHE_ORDERS)
+		return -1;
+
+	return ilog2(nbits);
+}
+
+static dma_addr_t fast_iova_cache_get(struct dma_fast_smmu_mapping *mapping,
+				      size_t size)
+{
+	struct fast_iova_cache *cache;
+	struct fast_iova_magazine *clean, *dirty;
+	dma_addr_t iova = DMA_ERROR_CODE;
+	unsigned long flags;
+	int order = fast_iova_cache_order(mapping, size);
+
+	if (order < 0)
+		return DMA_ERROR_CODE;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(mapping->iova_cache);
+	clean = cache->clean[order];
+	dirty = cache->dirty[order];
+
+	/*
+	 * Invalidations are serialized by mapping->lock and tlbi_gen is
+	 * bumped as each one completes.  An invalidation in flight when the
+	 * last free was tagged may have finished before its ptes were
+	 * unmapped, so the magazine is only clean after two bumps.
+	 */
+	if (!clean->count && dirty->count &&
+	    smp_load_acquire(&mapping->tlbi_gen) - dirty->tlbi_gen >= 2) {
+		cache->clean[order] = dirty;
+		cache->dirty[order] = clean;
+		clean = dirty;
+	}
+
+	if (clean->count)
+		iova = clean->iova[--clean->count];
+	local_irq_restore(flags);
+
+	if (iova == DMA_ERROR_CODE)
+		atomic_inc(&fast_smmu_iova_cache_miss);
+	else
+		atomic_inc(&fast_smmu_iova_cache_hit);
+
+	return iova;
+}
+
+/*
+ * Puts an iova whose ptes have already been unmapped in the cache.
+ * Returns false if the caller needs to free it to the bitmap instead.
+ */
+static bool fast_iova_cache_put(struct dma_fast_smmu_mapping *mapping,
+				dma_addr_t iova, size_t size)
+{
+	struct fast_iova_cache *cache;
+	struct fast_iova_magazine *dirty;
+	unsigned long flags;
+	int order = fast_iova_cache_order(mapping, size);
+
+	if (order < 0)
+		return false;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(mapping->iova_cache);
+	dirty = cache->dirty[order];
+
+	if (dirty->count == FAST_IOVA_MAG_SIZE) {
+		if (cache->clean[order]->count) {
+			local_irq_restore(flags);
+			return false;
+		}
+
+		/* one invalidation recycles the whole magazine */
+		__fast_smmu_lock(mapping);
+		__fast_smmu_tlbiall(mapping, false);
+		spin_unlock(&mapping->lock);
+		atomic_inc(&fast_smmu_iova_cache_tlbi);
+
+		cache->dirty[order] = cache->clean[order];
+		cache->clean[order] = dirty;
+		dirty = cache->dirty[order];
+	}
+
+	/* order the pte unmap before sampling the generation */
+	smp_mb();
+	dirty->iova[dirty->count++] = iova;
+	dirty->tlbi_gen = READ_ONCE(mapping->tlbi_gen);
+	local_irq_restore(flags);
+
+	return true;
+}
+
 
 static void __fast_dma_page_cpu_to_dev(struct page *page, unsigned long off,
 				       size_t size, enum dma_data_direction dir)
@@ -364,7 +546,18 @@ static dma_addr_t fast_smmu_map_page(struct device *dev, struct page *page,
 		__fast_dma_page_cpu_to_dev(phys_to_page(phys_to_map),
 					   offset_from_phys_to_map, size, dir);
 
-	spin_lock_irqsave(&mapping->lock, flags);
+	iova = fast_iova_cache_get(mapping, len);
+	if (iova != DMA_ERROR_CODE) {
+		/* nobody else can touch the ptes of a cached iova */
+		if (likely(!av8l_fast_map_public(mapping->pgtbl_ops, iova,
+						 phys_to_map, len, prot)))
+			goto out;
+
+		fast_smmu_lock(mapping, &flags);
+		goto fail_free_iova;
+	}
+
+	fast_smmu_lock(mapping, &flags);
 
 	iova = __fast_smmu_alloc_iova(mapping, attrs, len);
 
@@ -377,6 +570,7 @@ static dma_addr_t fast_smmu_map_page(struct device *dev, struct page *page,
 
 	spin_unlock_irqrestore(&mapping->lock, flags);
 
+out:
 	trace_map(mapping->domain, iova, phys_to_map, len, prot);
 	return iova + offset_from_phys_to_map;
 
@@ -397,6 +591,7 @@ static void fast_smmu_unmap_page(struct device *dev, dma_addr_t iova,
 	size_t len = ALIGN(size + offset, FAST_PAGE_SIZE);
 	bool skip_sync = (attrs & DMA_ATTR_SKIP_CPU_SYNC);
 	bool is_coherent = is_dma_coherent(dev, attrs);
+	bool cached = fast_iova_cache_order(mapping, len) >= 0;
 
 	if (!skip_sync && !is_coherent) {
 		phys_addr_t phys;
@@ -408,11 +603,20 @@ static void fast_smmu_unmap_page(struct device *dev, dma_addr_t iova,
 						size, dir);
 	}
 
-	spin_lock_irqsave(&mapping->lock, flags);
-	av8l_fast_unmap_public(mapping->pgtbl_ops, iova, len);
+	if (cached) {
+		/* the iova is still reserved, so its ptes are ours alone */
+		av8l_fast_unmap_public(mapping->pgtbl_ops, iova, len);
+		if (fast_iova_cache_put(mapping, iova - offset, len))
+			goto out;
+	}
+
+	fast_smmu_lock(mapping, &flags);
+	if (!cached)
+		av8l_fast_unmap_public(mapping->pgtbl_ops, iova, len);
 	__fast_smmu_free_iova(mapping, iova - offset, len);
 	spin_unlock_irqrestore(&mapping->lock, flags);
 
+out:
 	trace_unmap(mapping->domain, iova - offset, len, len);
 }
 
@@ -568,7 +772,7 @@ static void *fast_smmu_alloc(struct device *dev, size_t size,
 		sg_miter_stop(&miter);
 	}
 
-	spin_lock_irqsave(&mapping->lock, flags);
+	fast_smmu_lock(mapping, &flags);
 	dma_addr = __fast_smmu_alloc_iova(mapping, attrs, size);
 	if (dma_addr == DMA_ERROR_CODE) {
 		dev_err(dev, "no iova\n");
@@ -605,7 +809,7 @@ static void *fast_smmu_alloc(struct device *dev, size_t size,
 
 out_unmap:
 	/* need to take the lock again for page tables and iova */
-	spin_lock_irqsave(&mapping->lock, flags);
+	fast_smmu_lock(mapping, &flags);
 	av8l_fast_unmap_public(mapping->pgtbl_ops, dma_addr, size);
 out_free_iova:
 	__fast_smmu_free_iova(mapping, dma_addr, size);
@@ -635,7 +839,7 @@ static void fast_smmu_free(struct device *dev, size_t size,
 
 	pages = area->pages;
 	dma_common_free_remap(vaddr, size, VM_USERMAP, false);
-	spin_lock_irqsave(&mapping->lock, flags);
+	fast_smmu_lock(mapping, &flags);
 	av8l_fast_unmap_public(mapping->pgtbl_ops, dma_handle, size);
 	__fast_smmu_free_iova(mapping, dma_handle, size);
 	spin_unlock_irqrestore(&mapping->lock, flags);
@@ -697,7 +901,7 @@ static dma_addr_t fast_smmu_dma_map_resource(
 	int prot;
 	unsigned long flags;
 
-	spin_lock_irqsave(&mapping->lock, flags);
+	fast_smmu_lock(mapping, &flags);
 	dma_addr = __fast_smmu_alloc_iova(mapping, attrs, len);
 	spin_unlock_irqrestore(&mapping->lock, flags);
 
@@ -709,7 +913,7 @@ static dma_addr_t fast_smmu_dma_map_resource(
 
 	if (iommu_map(mapping->domain, dma_addr, phys_addr - offset,
 			len, prot)) {
-		spin_lock_irqsave(&mapping->lock, flags);
+		fast_smmu_lock(mapping, &flags);
 		__fast_smmu_free_iova(mapping, dma_addr, len);
 		spin_unlock_irqrestore(&mapping->lock, flags);
 		return DMA_ERROR_CODE;
@@ -728,7 +932,7 @@ static void fast_smmu_dma_unmap_resource(
 	unsigned long flags;
 
 	iommu_unmap(mapping->domain, addr - offset, len);
-	spin_lock_irqsave(&mapping->lock, flags);
+	fast_smmu_lock(mapping, &flags);
 	__fast_smmu_free_iova(mapping, addr - offset, len);
 	spin_unlock_irqrestore(&mapping->lock, flags);
 }
@@ -830,6 +1034,10 @@ static struct dma_fast_smmu_mapping *__fast_smmu_create_mapping_sized(
 
 	spin_lock_init(&fast->lock);
 
+	/* stale ptes are only tracked through the bitmap */
+	if (!IS_ENABLED(CONFIG_IOMMU_IO_PGTABLE_FAST_PROVE_TLB))
+		fast->iova_cache = fast_iova_cache_alloc();
+
 	return fast;
 err2:
 	kfree(fast);
@@ -954,6 +1162,7 @@ int fast_smmu_init_mapping(struct device *dev,
 	return 0;
 
 release_mapping:
+	free_percpu(mapping->fast->iova_cache);
 	kfree(mapping->fast->bitmap);
 	kfree(mapping->fast);
 	return err;
@@ -970,8 +1179,32 @@ void fast_smmu_release_mapping(struct kref *kref)
 	struct dma_iommu_mapping *mapping =
 		container_of(kref, struct dma_iommu_mapping, kref);
 
+	free_percpu(mapping->fast->iova_cache);
 	kvfree(mapping->fast->bitmap);
 	kfree(mapping->fast);
 	iommu_domain_free(mapping->domain);
 	kfree(mapping);
 }
+
+static int __init fast_smmu_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("dma-mapping-fast", iommu_debugfs_top);
+	if (IS_ERR_OR_NULL(dir))
+		return 0;
+
+	debugfs_create_bool("iova_cache", 0600, dir,
+			    &fast_smmu_iova_cache_enable);
+	debugfs_create_atomic_t("iova_cache_hit", 0400, dir,
+				&fast_smmu_iova_cache_hit);
+	debugfs_create_atomic_t("iova_cache_miss", 0400, dir,
+				&fast_smmu_iova_cache_miss);
+	debugfs_create_atomic_t("iova_cache_tlbi", 0400, dir,
+				&fast_smmu_iova_cache_tlbi);
+	debugfs_create_atomic_t("lock_contended", 0400, dir,
+				&fast_smmu_lock_contended);
+
+	return 0;
+}
+late_initcall(fast_smmu_debugfs_init);
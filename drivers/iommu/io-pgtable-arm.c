@@ -910,7 +910,7 @@ static size_t arm_lpae_unmap(struct io_pgtable_ops *ops, unsigned long iova,
 		unmapped += ret;
 		iova += ret;
 	}
-	if (unmapped)
+	if (unmapped && !(data->iop.cfg.quirks & IO_PGTABLE_QUIRK_DEFER_TLBI))
 		io_pgtable_tlb_flush_all(&data->iop);
 
 	return unmapped;
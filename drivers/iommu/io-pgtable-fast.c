@@ -22,6 +22,8 @@
 #include <linux/mm.h>
 #include <asm/cacheflush.h>
 #include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/atomic.h>
 
 #include "io-pgtable.h"
 
@@ -59,6 +61,7 @@ struct av8l_fast_io_pgtable {
 
 #define AV8L_FAST_PTE_NSTABLE		(((av8l_fast_iopte)1) << 63)
 #define AV8L_FAST_PTE_XN		(((av8l_fast_iopte)3) << 53)
+#define AV8L_FAST_PTE_CONT		(((av8l_fast_iopte)1) << 52)
 #define AV8L_FAST_PTE_AF		(((av8l_fast_iopte)1) << 10)
 #define AV8L_FAST_PTE_SH_NS		(((av8l_fast_iopte)0) << 8)
 #define AV8L_FAST_PTE_SH_OS		(((av8l_fast_iopte)2) << 8)
@@ -149,6 +152,14 @@ struct av8l_fast_io_pgtable {
 
 #define AV8L_FAST_PAGE_SHIFT		12
 
+/* 16 ptes with the contiguous hint make one 64K TLB entry */
+#define AV8L_FAST_CONT_SIZE		SZ_64K
+#define AV8L_FAST_CONT_PTES		(AV8L_FAST_CONT_SIZE >> AV8L_FAST_PAGE_SHIFT)
+
+static bool av8l_fast_cont_hint = true;
+static atomic_t av8l_fast_mapped_4k;
+static atomic_t av8l_fast_mapped_64k;
+
 #define PTE_MAIR_IDX(pte)				\
 	((pte >> AV8L_FAST_PTE_ATTRINDX_SHIFT) &	\
 	 AV8L_FAST_PTE_ATTRINDX_MASK)
@@ -248,17 +259,39 @@ static int av8l_fast_map(struct io_pgtable_ops *ops, unsigned long iova,
 {
 	struct av8l_fast_io_pgtable *data = iof_pgtable_ops_to_data(ops);
 	av8l_fast_iopte *ptep = iopte_pmd_offset(data->pmds, data->base, iova);
-	unsigned long i, nptes = size >> AV8L_FAST_PAGE_SHIFT;
-	av8l_fast_iopte pte;
+	unsigned long i, j, n, nptes = size >> AV8L_FAST_PAGE_SHIFT;
+	unsigned long nr_cont = 0;
+	av8l_fast_iopte pte, cont;
 
 	pte = av8l_fast_prot_to_pte(data, prot);
 	paddr &= AV8L_FAST_PTE_ADDR_MASK;
-	for (i = 0; i < nptes; i++, paddr += SZ_4K) {
-		__av8l_check_for_stale_tlb(ptep + i);
-		*(ptep + i) = pte | paddr;
+	for (i = 0; i < nptes; i += n) {
+		/*
+		 * Runs of 16 ptes whose iova and output are both 64K aligned
+		 * get the contiguous hint; the whole run is always mapped and
+		 * unmapped together as it lies within this one mapping.
+		 */
+		if (av8l_fast_cont_hint && nptes - i >= AV8L_FAST_CONT_PTES &&
+		    IS_ALIGNED(iova | paddr, AV8L_FAST_CONT_SIZE)) {
+			n = AV8L_FAST_CONT_PTES;
+			cont = AV8L_FAST_PTE_CONT;
+			nr_cont++;
+		} else {
+			n = 1;
+			cont = 0;
+		}
+
+		for (j = 0; j < n; j++, iova += SZ_4K, paddr += SZ_4K) {
+			__av8l_check_for_stale_tlb(ptep + i + j);
+			*(ptep + i + j) = pte | cont | paddr;
+		}
 	}
 	av8l_clean_range(ops, ptep, ptep + nptes);
 
+	atomic_add(nptes - nr_cont * AV8L_FAST_CONT_PTES,
+		   &av8l_fast_mapped_4k);
+	atomic_add(nr_cont, &av8l_fast_mapped_64k);
+
 	return 0;
 }
 
@@ -355,7 +388,27 @@ static int av8l_fast_map_sg(struct io_pgtable_ops *ops, unsigned long iova,
 			    struct scatterlist *sg, unsigned int nents,
 			    int prot, size_t *size)
 {
-	return -ENODEV;
+	struct scatterlist *s;
+	size_t mapped = 0;
+	phys_addr_t phys;
+	int i;
+
+	for_each_sg(sg, s, nents, i) {
+		phys = page_to_phys(sg_page(s)) + s->offset;
+		if (!IS_ALIGNED(phys | s->length, SZ_4K))
+			goto out_err;
+
+		av8l_fast_map(ops, iova, phys, s->length, prot);
+		iova += s->length;
+		mapped += s->length;
+	}
+
+	return mapped;
+
+out_err:
+	/* Return the size of the partial mapping so that they can be undone */
+	*size = mapped;
+	return 0;
 }
 
 static bool av8l_fast_iova_coherent(struct io_pgtable_ops *ops,
@@ -632,6 +685,23 @@ struct io_pgtable_init_fns io_pgtable_av8l_fast_init_fns = {
 };
 
 
+static int __init av8l_fast_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("io-pgtable-fast", iommu_debugfs_top);
+	if (IS_ERR_OR_NULL(dir))
+		return 0;
+
+	debugfs_create_bool("cont_hint", 0600, dir, &av8l_fast_cont_hint);
+	debugfs_create_atomic_t("mapped_4k", 0400, dir, &av8l_fast_mapped_4k);
+	debugfs_create_atomic_t("mapped_64k", 0400, dir,
+				&av8l_fast_mapped_64k);
+
+	return 0;
+}
+late_initcall(av8l_fast_debugfs_init);
+
 #ifdef CONFIG_IOMMU_IO_PGTABLE_FAST_SELFTEST
 
 #include <linux/dma-contiguous.h>
@@ -99,6 +99,10 @@ struct io_pgtable_cfg {
 	 *	set in TCR for the page table walker with Write-Back,
 	 *	no Write-Allocate cacheable encoding.
 	 *
+	 * IO_PGTABLE_QUIRK_DEFER_TLBI: Don't invalidate the TLB at the end
+	 *	of an unmap. The owner of the page table invalidates it
+	 *	itself, possibly once for a batch of unmaps.
+	 *
 	 */
 	#define IO_PGTABLE_QUIRK_ARM_NS		BIT(0)
 	#define IO_PGTABLE_QUIRK_NO_PERMS	BIT(1)
@@ -108,6 +112,7 @@ struct io_pgtable_cfg {
 	#define IO_PGTABLE_QUIRK_QSMMUV500_NON_SHAREABLE BIT(5)
 	#define IO_PGTABLE_QUIRK_QCOM_USE_UPSTREAM_HINT	BIT(6)
 	#define IO_PGTABLE_QUIRK_QCOM_USE_LLC_NWA	BIT(7)
+	#define IO_PGTABLE_QUIRK_DEFER_TLBI	BIT(8)
 	unsigned long			quirks;
 	unsigned long			pgsize_bitmap;
 	unsigned int			ias;
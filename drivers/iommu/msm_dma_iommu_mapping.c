@@ -14,9 +14,13 @@
 #include <linux/kernel.h>
 #include <linux/kref.h>
 #include <linux/slab.h>
-#include <linux/rbtree.h>
+#include <linux/hashtable.h>
+#include <linux/rculist.h>
 #include <linux/mutex.h>
 #include <linux/err.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/iommu.h>
 #include <asm/barrier.h>
 
 #include <linux/msm_dma_iommu_mapping.h>
@@ -32,6 +36,7 @@
  * @ref - for reference counting this mapping
  * @attrs - dma mapping attributes
  * @buf_start_addr - address of start of buffer
+ * @stat - lazy map counters of the device
  *
  * Represents a mapping of one dma_buf buffer to a particular device
  * and address range. There may exist other mappings of this buffer in
@@ -39,7 +44,6 @@
  */
 struct msm_iommu_map {
 	struct list_head lnode;
-	struct rb_node node;
 	struct device *dev;
 	struct scatterlist *sgl;
 	unsigned int nents;
@@ -48,63 +52,92 @@ struct msm_iommu_map {
 	struct kref ref;
 	unsigned long attrs;
 	dma_addr_t buf_start_addr;
+	struct msm_iommu_dev_stat *stat;
 };
 
+/*
+ * Metas are added and removed under msm_iommu_map_mutex, but looked up
+ * under RCU so that re-mapping an already mapped buffer never takes the
+ * global mutex. A meta whose last reference is being dropped stays in the
+ * hash until its release runs, lookups skip it.
+ */
 struct msm_iommu_meta {
-	struct rb_node node;
+	struct hlist_node node;
 	struct list_head iommu_maps;
 	struct kref ref;
 	struct mutex lock;
 	void *buffer;
+	struct rcu_head rcu;
+};
+
+/**
+ * struct msm_iommu_dev_stat - lazy map counters of one device
+ * @node - entry in msm_iommu_dev_stats
+ * @dev - the device, only used as a key
+ * @name - name of the device when it first mapped a buffer
+ * @hits - map calls served from an existing lazy mapping
+ * @misses - map calls which had to create the mapping
+ */
+struct msm_iommu_dev_stat {
+	struct list_head node;
+	struct device *dev;
+	const char *name;
+	atomic64_t hits;
+	atomic64_t misses;
 };
 
-static struct rb_root iommu_root;
+#define MSM_IOMMU_META_HASH_BITS	8
+
+static DEFINE_HASHTABLE(iommu_meta_hash, MSM_IOMMU_META_HASH_BITS);
 static DEFINE_MUTEX(msm_iommu_map_mutex);
+static LIST_HEAD(msm_iommu_dev_stats);
+static DEFINE_MUTEX(msm_iommu_dev_stats_mutex);
 
 static void msm_iommu_meta_add(struct msm_iommu_meta *meta)
 {
-	struct rb_root *root = &iommu_root;
-	struct rb_node **p = &root->rb_node;
-	struct rb_node *parent = NULL;
+	hash_add_rcu(iommu_meta_hash, &meta->node,
+		     (unsigned long)meta->buffer);
+}
+
+/* Returns the meta of @buffer with a reference taken, or NULL */
+static struct msm_iommu_meta *msm_iommu_meta_lookup(void *buffer)
+{
 	struct msm_iommu_meta *entry;
 
-	while (*p) {
-		parent = *p;
-		entry = rb_entry(parent, struct msm_iommu_meta, node);
-
-		if (meta->buffer < entry->buffer)
-			p = &(*p)->rb_left;
-		else if (meta->buffer > entry->buffer)
-			p = &(*p)->rb_right;
-		else
-			pr_err("%s: dma_buf %p already exists\n", __func__,
-			       entry->buffer);
+	rcu_read_lock();
+	hash_for_each_possible_rcu(iommu_meta_hash, entry, node,
+				   (unsigned long)buffer) {
+		if (entry->buffer == buffer &&
+		    kref_get_unless_zero(&entry->ref)) {
+			rcu_read_unlock();
+			return entry;
+		}
 	}
+	rcu_read_unlock();
 
-	rb_link_node(&meta->node, parent, p);
-	rb_insert_color(&meta->node, root);
+	return NULL;
 }
 
-static struct msm_iommu_meta *msm_iommu_meta_lookup(void *buffer)
+static struct msm_iommu_dev_stat *msm_iommu_dev_stat_get(struct device *dev)
 {
-	struct rb_root *root = &iommu_root;
-	struct rb_node **p = &root->rb_node;
-	struct rb_node *parent = NULL;
-	struct msm_iommu_meta *entry = NULL;
-
-	while (*p) {
-		parent = *p;
-		entry = rb_entry(parent, struct msm_iommu_meta, node);
-
-		if (buffer < entry->buffer)
-			p = &(*p)->rb_left;
-		else if (buffer > entry->buffer)
-			p = &(*p)->rb_right;
-		else
-			return entry;
+	struct msm_iommu_dev_stat *stat;
+
+	mutex_lock(&msm_iommu_dev_stats_mutex);
+	list_for_each_entry(stat, &msm_iommu_dev_stats, node) {
+		if (stat->dev == dev)
+			goto out;
 	}
 
-	return NULL;
+	stat = kzalloc(sizeof(*stat), GFP_KERNEL);
+	if (!stat)
+		goto out;
+
+	stat->dev = dev;
+	stat->name = kstrdup_const(dev_name(dev), GFP_KERNEL);
+	list_add_tail(&stat->node, &msm_iommu_dev_stats);
+out:
+	mutex_unlock(&msm_iommu_dev_stats_mutex);
+	return stat;
 }
 
 static void msm_iommu_add(struct msm_iommu_meta *meta,
@@ -175,27 +208,28 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 	bool extra_meta_ref_taken = false;
 	int late_unmap = !(attrs & DMA_ATTR_NO_DELAYED_UNMAP);
 
-	mutex_lock(&msm_iommu_map_mutex);
 	iommu_meta = msm_iommu_meta_lookup(dma_buf->priv);
 
 	if (!iommu_meta) {
-		iommu_meta = msm_iommu_meta_create(dma_buf);
-
-		if (IS_ERR(iommu_meta)) {
-			mutex_unlock(&msm_iommu_map_mutex);
-			ret = PTR_ERR(iommu_meta);
-			goto out;
-		}
-		if (late_unmap) {
-			kref_get(&iommu_meta->ref);
-			extra_meta_ref_taken = true;
+		mutex_lock(&msm_iommu_map_mutex);
+		/* lost a race against another first map of the buffer */
+		iommu_meta = msm_iommu_meta_lookup(dma_buf->priv);
+		if (!iommu_meta) {
+			iommu_meta = msm_iommu_meta_create(dma_buf);
+
+			if (IS_ERR(iommu_meta)) {
+				mutex_unlock(&msm_iommu_map_mutex);
+				ret = PTR_ERR(iommu_meta);
+				goto out;
+			}
+			if (late_unmap) {
+				kref_get(&iommu_meta->ref);
+				extra_meta_ref_taken = true;
+			}
 		}
-	} else {
-		kref_get(&iommu_meta->ref);
+		mutex_unlock(&msm_iommu_map_mutex);
 	}
 
-	mutex_unlock(&msm_iommu_map_mutex);
-
 	mutex_lock(&iommu_meta->lock);
 	iommu_map = msm_iommu_lookup(iommu_meta, dev);
 	if (!iommu_map) {
@@ -223,6 +257,9 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 		iommu_map->dir = dir;
 		iommu_map->attrs = attrs;
 		iommu_map->buf_start_addr = sg_phys(sg);
+		iommu_map->stat = msm_iommu_dev_stat_get(dev);
+		if (iommu_map->stat)
+			atomic64_inc(&iommu_map->stat->misses);
 
 		kref_init(&iommu_map->ref);
 		if (late_unmap)
@@ -252,6 +289,8 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 			}
 
 			kref_get(&iommu_map->ref);
+			if (iommu_map->stat)
+				atomic64_inc(&iommu_map->stat->hits);
 
 			if ((attrs & DMA_ATTR_SKIP_CPU_SYNC) == 0)
 				dma_sync_sg_for_device(dev, iommu_map->sgl,
@@ -327,6 +366,7 @@ int msm_dma_map_sg_attrs(struct device *dev, struct scatterlist *sg, int nents,
 }
 EXPORT_SYMBOL(msm_dma_map_sg_attrs);
 
+/* Called with msm_iommu_map_mutex held, drops it */
 static void msm_iommu_meta_destroy(struct kref *kref)
 {
 	struct msm_iommu_meta *meta = container_of(kref, struct msm_iommu_meta,
@@ -336,18 +376,19 @@ static void msm_iommu_meta_destroy(struct kref *kref)
 		WARN(1, "%s: DMA Buffer %p being destroyed with outstanding iommu mappins!\n",
 		     __func__, meta->buffer);
 	}
-	rb_erase(&meta->node, &iommu_root);
-	kfree(meta);
+	hash_del_rcu(&meta->node);
+	mutex_unlock(&msm_iommu_map_mutex);
+	kfree_rcu(meta, rcu);
 }
 
 static void msm_iommu_meta_put(struct msm_iommu_meta *meta)
 {
 	/*
-	 * Need to lock here to prevent race against map/unmap
+	 * The mutex is only needed for the final put, to serialize the
+	 * removal against other updates of the hash.
 	 */
-	mutex_lock(&msm_iommu_map_mutex);
-	kref_put(&meta->ref, msm_iommu_meta_destroy);
-	mutex_unlock(&msm_iommu_map_mutex);
+	kref_put_mutex(&meta->ref, msm_iommu_meta_destroy,
+		       &msm_iommu_map_mutex);
 }
 
 static void msm_iommu_map_release(struct kref *kref)
@@ -376,15 +417,12 @@ void msm_dma_unmap_sg_attrs(struct device *dev, struct scatterlist *sgl,
 	struct msm_iommu_map *iommu_map;
 	struct msm_iommu_meta *meta;
 
-	mutex_lock(&msm_iommu_map_mutex);
 	meta = msm_iommu_meta_lookup(dma_buf->priv);
 	if (!meta) {
 		WARN(1, "%s: (%p) was never mapped\n", __func__, dma_buf);
-		mutex_unlock(&msm_iommu_map_mutex);
 		goto out;
 
 	}
-	mutex_unlock(&msm_iommu_map_mutex);
 
 	mutex_lock(&meta->lock);
 	iommu_map = msm_iommu_lookup(meta, dev);
@@ -393,7 +431,7 @@ void msm_dma_unmap_sg_attrs(struct device *dev, struct scatterlist *sgl,
 		WARN(1, "%s: (%p) was never mapped for device  %p\n", __func__,
 				dma_buf, dev);
 		mutex_unlock(&meta->lock);
-		goto out;
+		goto out_put;
 	}
 
 	if (dir != iommu_map->dir)
@@ -408,7 +446,9 @@ void msm_dma_unmap_sg_attrs(struct device *dev, struct scatterlist *sgl,
 	mutex_unlock(&meta->lock);
 
 	msm_iommu_meta_put(meta);
-
+out_put:
+	/* the lookup reference */
+	msm_iommu_meta_put(meta);
 out:
 	return;
 }
@@ -418,17 +458,13 @@ int msm_dma_unmap_all_for_dev(struct device *dev)
 {
 	int ret = 0;
 	struct msm_iommu_meta *meta;
-	struct rb_root *root;
-	struct rb_node *meta_node;
+	int bkt;
 
 	mutex_lock(&msm_iommu_map_mutex);
-	root = &iommu_root;
-	meta_node = rb_first(root);
-	while (meta_node) {
+	hash_for_each(iommu_meta_hash, bkt, meta, node) {
 		struct msm_iommu_map *iommu_map;
 		struct msm_iommu_map *iommu_map_next;
 
-		meta = rb_entry(meta_node, struct msm_iommu_meta, node);
 		mutex_lock(&meta->lock);
 		list_for_each_entry_safe(iommu_map, iommu_map_next,
 						&meta->iommu_maps, lnode)
@@ -438,7 +474,6 @@ int msm_dma_unmap_all_for_dev(struct device *dev)
 					ret = -EINVAL;
 
 		mutex_unlock(&meta->lock);
-		meta_node = rb_next(meta_node);
 	}
 	mutex_unlock(&msm_iommu_map_mutex);
 
@@ -454,14 +489,11 @@ void msm_dma_buf_freed(void *buffer)
 	struct msm_iommu_map *iommu_map_next;
 	struct msm_iommu_meta *meta;
 
-	mutex_lock(&msm_iommu_map_mutex);
 	meta = msm_iommu_meta_lookup(buffer);
 	if (!meta) {
 		/* Already unmapped (assuming no late unmapping) */
-		mutex_unlock(&msm_iommu_map_mutex);
 		return;
 	}
-	mutex_unlock(&msm_iommu_map_mutex);
 
 	mutex_lock(&meta->lock);
 
@@ -478,4 +510,42 @@ void msm_dma_buf_freed(void *buffer)
 	mutex_unlock(&meta->lock);
 
 	msm_iommu_meta_put(meta);
+	/* the lookup reference */
+	msm_iommu_meta_put(meta);
+}
+
+static int msm_iommu_dev_stats_show(struct seq_file *s, void *unused)
+{
+	struct msm_iommu_dev_stat *stat;
+
+	seq_printf(s, "%-32s %12s %12s\n", "device", "hits", "misses");
+	mutex_lock(&msm_iommu_dev_stats_mutex);
+	list_for_each_entry(stat, &msm_iommu_dev_stats, node)
+		seq_printf(s, "%-32s %12lld %12lld\n",
+			   stat->name ? stat->name : "?",
+			   (long long)atomic64_read(&stat->hits),
+			   (long long)atomic64_read(&stat->misses));
+	mutex_unlock(&msm_iommu_dev_stats_mutex);
+
+	return 0;
+}
+
+static int msm_iommu_dev_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_iommu_dev_stats_show, NULL);
+}
+
+static const struct file_operations msm_iommu_dev_stats_fops = {
+	.open = msm_iommu_dev_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_dma_iommu_mapping_debugfs_init(void)
+{
+	debugfs_create_file("lazy_map_stats", 0400, iommu_debugfs_top, NULL,
+			    &msm_iommu_dev_stats_fops);
+	return 0;
 }
+late_initcall(msm_dma_iommu_mapping_debugfs_init);
@@ -41,6 +41,14 @@ static const struct dm_default_key_cipher {
  * @sector_bits: log2(sector_size)
  * @key: the encryption key to use
  * @max_dun: the maximum DUN that may be used (computed from other params)
+ * @pin_keyslot: keep @key in a reserved keyslot of @dev's inline encryption
+ *		 hardware for as long as the target exists
+ * @key_pinned: @key is currently pinned
+ * @hw_crypto: bios mapped to @dev are en/decrypted by inline encryption
+ *	       hardware rather than by blk-crypto-fallback
+ * @bios: number of bios given an encryption context
+ * @bytes: number of bytes in those bios
+ * @fallback_bios: number of those bios left to blk-crypto-fallback
  */
 struct default_key_c {
 	struct dm_dev *dev;
@@ -53,6 +61,12 @@ struct default_key_c {
 	bool is_hw_wrapped;
 	u64 max_dun;
 	bool set_dun;
+	bool pin_keyslot;
+	bool key_pinned;
+	bool hw_crypto;
+	atomic64_t bios;
+	atomic64_t bytes;
+	atomic64_t fallback_bios;
 };
 
 static const struct dm_default_key_cipher *
@@ -73,6 +87,9 @@ static void default_key_dtr(struct dm_target *ti)
 	int err;
 
 	if (dkc->dev) {
+		if (dkc->key_pinned)
+			blk_crypto_unpin_key(dkc->dev->bdev->bd_queue,
+					     &dkc->key);
 		err = blk_crypto_evict_key(dkc->dev->bdev->bd_queue, &dkc->key);
 		if (err && err != -ENOKEY)
 			DMWARN("Failed to evict crypto key: %d", err);
@@ -88,7 +105,7 @@ static int default_key_ctr_optional(struct dm_target *ti,
 	struct default_key_c *dkc = ti->private;
 	struct dm_arg_set as;
 	static const struct dm_arg _args[] = {
-		{0, 4, "Invalid number of feature args"},
+		{0, 5, "Invalid number of feature args"},
 	};
 	unsigned int opt_params;
 	const char *opt_string;
@@ -125,6 +142,8 @@ static int default_key_ctr_optional(struct dm_target *ti,
 			dkc->is_hw_wrapped = true;
 		} else if (!strcmp(opt_string, "set_dun")) {
 			dkc->set_dun = true;
+		} else if (!strcmp(opt_string, "pin_keyslot")) {
+			dkc->pin_keyslot = true;
 		} else {
 			ti->error = "Invalid feature arguments";
 			return -EINVAL;
@@ -313,6 +332,26 @@ static int default_key_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	dkc->hw_crypto = blk_crypto_key_supported_by_hw(dkc->dev->bdev->bd_queue,
+							&dkc->key);
+	if (!dkc->hw_crypto)
+		DMWARN("%s: no inline encryption support, using blk-crypto-fallback",
+		       dkc->dev->name);
+
+	/*
+	 * The whole device is about to be read with this key.  Pinning is
+	 * best effort: without it the key is just programmed on demand.
+	 */
+	if (dkc->pin_keyslot && dkc->hw_crypto) {
+		err = blk_crypto_pin_key(dkc->dev->bdev->bd_queue, &dkc->key);
+		if (err)
+			DMWARN("%s: failed to pin keyslot: %d",
+			       dkc->dev->name, err);
+		dkc->key_pinned = !err;
+	}
+	if (!dkc->key_pinned)
+		blk_crypto_prefetch_key(dkc->dev->bdev->bd_queue, &dkc->key);
+
 	ti->num_flush_bios = 1;
 
 	ti->may_passthrough_inline_crypto = true;
@@ -329,7 +368,7 @@ out:
 
 static int default_key_map(struct dm_target *ti, struct bio *bio)
 {
-	const struct default_key_c *dkc = ti->private;
+	struct default_key_c *dkc = ti->private;
 	sector_t sector_in_target;
 	u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE] = { 0 };
 
@@ -376,6 +415,11 @@ static int default_key_map(struct dm_target *ti, struct bio *bio)
 
 	bio_crypt_set_ctx(bio, &dkc->key, dun, GFP_NOIO);
 
+	atomic64_inc(&dkc->bios);
+	atomic64_add(bio->bi_iter.bi_size, &dkc->bytes);
+	if (!dkc->hw_crypto)
+		atomic64_inc(&dkc->fallback_bios);
+
 	return DM_MAPIO_REMAPPED;
 }
 
@@ -389,7 +433,12 @@ static void default_key_status(struct dm_target *ti, status_type_t type,
 
 	switch (type) {
 	case STATUSTYPE_INFO:
-		result[0] = '\0';
+		/* <bios> <bytes> <fallback bios> <keyslot pinned> */
+		DMEMIT("%llu %llu %llu %d",
+		       (unsigned long long)atomic64_read(&dkc->bios),
+		       (unsigned long long)atomic64_read(&dkc->bytes),
+		       (unsigned long long)atomic64_read(&dkc->fallback_bios),
+		       dkc->key_pinned);
 		break;
 
 	case STATUSTYPE_TABLE:
@@ -402,6 +451,8 @@ static void default_key_status(struct dm_target *ti, status_type_t type,
 			num_feature_args += 2;
 		if (dkc->is_hw_wrapped)
 			num_feature_args += 1;
+		if (dkc->pin_keyslot)
+			num_feature_args += 1;
 		if (num_feature_args != 0) {
 			DMEMIT(" %d", num_feature_args);
 			if (ti->num_discard_bios)
@@ -412,6 +463,8 @@ static void default_key_status(struct dm_target *ti, status_type_t type,
 			}
 			if (dkc->is_hw_wrapped)
 				DMEMIT(" wrappedkey_v0");
+			if (dkc->pin_keyslot)
+				DMEMIT(" pin_keyslot");
 		}
 		break;
 	}
@@ -457,7 +510,7 @@ static void default_key_io_hints(struct dm_target *ti,
 
 static struct target_type default_key_target = {
 	.name			= "default-key",
-	.version		= {2, 1, 0},
+	.version		= {2, 2, 0},
 	.module			= THIS_MODULE,
 	.ctr			= default_key_ctr,
 	.dtr			= default_key_dtr,
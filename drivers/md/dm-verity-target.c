@@ -12,6 +12,22 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * "/sys/module/dm_verity/parameters/check_at_most_once" selects whether new
+ * devices keep a bitmap of data blocks that already passed verification, as
+ * if the "check_at_most_once" option had been given.  The bitmap is cleared
+ * whenever a corrupted block is found.
+ *
+ * Reads of up to "inline_blocks" data blocks are verified directly in the
+ * bio completion when the level 0 hash block they need is pinned in the
+ * per-device inline cache, skipping the trip through the verify workqueue.
+ * Anything else, including every mismatch, is handed to the workqueue.
+ * "inline_hits" counts the reads completed this way; 0 disables it.
+ *
+ * "warm_hash_bytes" caps how much of the hash tree above level 0 each device
+ * keeps held in dm-bufio once verified, root level first, so that those
+ * blocks survive memory pressure.  Hash blocks for the following window are
+ * prefetched too when a read is readahead or continues the previous one.
  */
 
 #include "dm-verity.h"
@@ -27,6 +43,11 @@
 
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
 
+#define DM_VERITY_DEFAULT_INLINE_BLOCKS	1
+#define DM_VERITY_INLINE_SLOTS		32	/* power of 2 */
+
+#define DM_VERITY_DEFAULT_WARM_HASH_BYTES	(1024 * 1024)
+
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
 #define DM_VERITY_OPT_LOGGING		"ignore_corruption"
@@ -40,6 +61,43 @@ static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static bool dm_verity_at_most_once =
+	IS_ENABLED(CONFIG_DM_ANDROID_VERITY_AT_MOST_ONCE_DEFAULT_ENABLED);
+
+module_param_named(check_at_most_once, dm_verity_at_most_once, bool, S_IRUGO | S_IWUSR);
+
+static unsigned dm_verity_inline_blocks = DM_VERITY_DEFAULT_INLINE_BLOCKS;
+
+module_param_named(inline_blocks, dm_verity_inline_blocks, uint, S_IRUGO | S_IWUSR);
+
+static atomic_long_t dm_verity_inline_hits = ATOMIC_LONG_INIT(0);
+
+static int dm_verity_get_inline_hits(char *buffer,
+				     const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%ld\n", atomic_long_read(&dm_verity_inline_hits));
+}
+
+static const struct kernel_param_ops dm_verity_inline_hits_ops = {
+	.get = dm_verity_get_inline_hits,
+};
+
+module_param_cb(inline_hits, &dm_verity_inline_hits_ops, NULL, S_IRUGO);
+
+static unsigned long dm_verity_warm_hash_bytes = DM_VERITY_DEFAULT_WARM_HASH_BYTES;
+
+module_param_named(warm_hash_bytes, dm_verity_warm_hash_bytes, ulong, S_IRUGO | S_IWUSR);
+
+/*
+ * A verified level 0 hash block held in dm-bufio so that its digests can be
+ * read from the bio completion, where the bufio client lock can't be taken.
+ * Slots are only replaced from process context, under v->inline_lock.
+ */
+struct dm_verity_inline_slot {
+	sector_t hash_block;
+	struct dm_buffer *buf;
+};
+
 struct dm_verity_prefetch_work {
 	struct work_struct work;
 	struct dm_verity *v;
@@ -209,12 +267,61 @@ out:
 	return r;
 }
 
+/*
+ * Synchronous hashing, used whenever a shash implementation of the algorithm
+ * exists.  The state after the version 1 salt is precomputed in the
+ * constructor, so starting a block is a single import.
+ */
+static int verity_shash_init(struct dm_verity *v, struct shash_desc *desc)
+{
+	desc->tfm = v->shash_tfm;
+	desc->flags = 0;
+
+	return crypto_shash_import(desc, v->initial_hashstate);
+}
+
+static int verity_shash_final(struct dm_verity *v, struct shash_desc *desc,
+			      u8 *digest)
+{
+	int r;
+
+	if (unlikely(v->salt_size && (!v->version))) {
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (unlikely(r < 0))
+			return r;
+	}
+
+	return crypto_shash_final(desc, digest);
+}
+
+static int verity_shash(struct dm_verity *v, const u8 *data, size_t len,
+			u8 *digest)
+{
+	SHASH_DESC_ON_STACK(desc, v->shash_tfm);
+	int r;
+
+	r = verity_shash_init(v, desc);
+	if (likely(!r))
+		r = crypto_shash_update(desc, data, len);
+	if (likely(!r))
+		r = verity_shash_final(v, desc, digest);
+
+	shash_desc_zero(desc);
+	if (unlikely(r < 0))
+		DMERR("verity_shash failed: %d", r);
+
+	return r;
+}
+
 int verity_hash(struct dm_verity *v, struct ahash_request *req,
 		const u8 *data, size_t len, u8 *digest)
 {
 	int r;
 	struct verity_result res;
 
+	if (v->shash_tfm)
+		return verity_shash(v, data, len, digest);
+
 	r = verity_hash_init(v, req, &res);
 	if (unlikely(r < 0))
 		goto out;
@@ -261,6 +368,13 @@ static int verity_handle_err(struct dm_verity *v, enum verity_block_type type,
 	/* Corruption should be visible in device status in all modes */
 	v->hash_failed = 1;
 
+	/*
+	 * Blocks verified earlier may have been modified since, so stop
+	 * trusting the bitmap once the device is known to be tampered with.
+	 */
+	if (v->validated_blocks)
+		bitmap_zero(v->validated_blocks, v->data_blocks);
+
 	if (v->corrupted_errs >= DM_VERITY_MAX_CORRUPTED_ERRS)
 		goto out;
 
@@ -302,6 +416,112 @@ out:
 	return 1;
 }
 
+static struct dm_verity_inline_slot *
+verity_inline_slot(struct dm_verity *v, sector_t hash_block)
+{
+	return &v->inline_slots[(unsigned)hash_block &
+				(DM_VERITY_INLINE_SLOTS - 1)];
+}
+
+/*
+ * Keep a verified level 0 hash block held for the completion fast path,
+ * releasing whichever block used the slot before.
+ */
+static void verity_inline_pin(struct dm_verity *v, sector_t hash_block)
+{
+	struct dm_verity_inline_slot *slot = verity_inline_slot(v, hash_block);
+	struct dm_buffer *buf, *old;
+	bool pinned;
+
+	spin_lock_irq(&v->inline_lock);
+	pinned = slot->buf && slot->hash_block == hash_block;
+	spin_unlock_irq(&v->inline_lock);
+
+	if (pinned)
+		return;
+
+	if (IS_ERR_OR_NULL(dm_bufio_get(v->bufio, hash_block, &buf)))
+		return;
+
+	spin_lock_irq(&v->inline_lock);
+	old = slot->buf;
+	if (old && slot->hash_block == hash_block) {
+		old = buf;
+	} else {
+		slot->hash_block = hash_block;
+		slot->buf = buf;
+	}
+	spin_unlock_irq(&v->inline_lock);
+
+	if (old)
+		dm_bufio_release(old);
+}
+
+static void verity_inline_unpin_all(struct dm_verity *v)
+{
+	unsigned i;
+
+	for (i = 0; i < DM_VERITY_INLINE_SLOTS; i++)
+		if (v->inline_slots[i].buf)
+			dm_bufio_release(v->inline_slots[i].buf);
+}
+
+/*
+ * Hold a verified hash block above level 0 until the device is destroyed.
+ * The upper levels are contiguous from hash_start, root first, so the first
+ * n_warm of them are the ones closest to the root.
+ */
+static void verity_warm_pin(struct dm_verity *v, sector_t hash_block)
+{
+	struct dm_buffer **slot = &v->warm_bufs[hash_block - v->hash_start];
+	struct dm_buffer *buf;
+
+	if (READ_ONCE(*slot))
+		return;
+
+	if (IS_ERR_OR_NULL(dm_bufio_get(v->bufio, hash_block, &buf)))
+		return;
+
+	if (cmpxchg(slot, NULL, buf))
+		dm_bufio_release(buf);
+}
+
+static void verity_warm_unpin_all(struct dm_verity *v)
+{
+	unsigned i;
+
+	for (i = 0; i < v->n_warm; i++)
+		if (v->warm_bufs[i])
+			dm_bufio_release(v->warm_bufs[i]);
+}
+
+/*
+ * Copy the digest of data block "block" from the inline cache, if its hash
+ * block is pinned there.  Safe in any context.
+ */
+static bool verity_inline_want_digest(struct dm_verity *v, sector_t block,
+				      u8 *digest)
+{
+	struct dm_verity_inline_slot *slot;
+	sector_t hash_block;
+	unsigned long flags;
+	unsigned offset;
+	bool found = false;
+
+	verity_hash_at_level(v, block, 0, &hash_block, &offset);
+	slot = verity_inline_slot(v, hash_block);
+
+	spin_lock_irqsave(&v->inline_lock, flags);
+	if (slot->buf && slot->hash_block == hash_block) {
+		memcpy(digest, (u8 *)dm_bufio_get_block_data(slot->buf) + offset,
+		       v->digest_size);
+		found = true;
+	}
+	spin_unlock_irqrestore(&v->inline_lock, flags);
+
+	return found;
+}
+
 /*
  * Verify hash of a metadata block pertaining to the specified data block
  * ("block" argument) at a specified level ("level" argument).
@@ -359,6 +579,12 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 		}
 	}
 
+	if (!level && aux->hash_verified && v->inline_slots)
+		verity_inline_pin(v, hash_block);
+	else if (level && aux->hash_verified &&
+		 hash_block - v->hash_start < v->n_warm)
+		verity_warm_pin(v, hash_block);
+
 	data += offset;
 	memcpy(want_digest, data, v->digest_size);
 	r = 0;
@@ -449,6 +675,52 @@ int verity_for_io_block(struct dm_verity *v, struct dm_verity_io *io,
 	return 0;
 }
 
+/*
+ * Calculates the digest of the data block at iter with the synchronous
+ * hash, mapping each bio_vec in turn.
+ */
+static int verity_shash_io_block(struct dm_verity *v, struct dm_verity_io *io,
+				 struct bvec_iter *iter, u8 *digest)
+{
+	SHASH_DESC_ON_STACK(desc, v->shash_tfm);
+	unsigned int todo = 1 << v->data_dev_block_bits;
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_io_data_size);
+	int r;
+
+	r = verity_shash_init(v, desc);
+	if (unlikely(r < 0))
+		goto out;
+
+	do {
+		u8 *page;
+		unsigned int len;
+		struct bio_vec bv = bio_iter_iovec(bio, *iter);
+
+		len = bv.bv_len;
+
+		if (likely(len >= todo))
+			len = todo;
+
+		page = kmap_atomic(bv.bv_page);
+		r = crypto_shash_update(desc, page + bv.bv_offset, len);
+		kunmap_atomic(page);
+
+		if (unlikely(r < 0))
+			goto out;
+
+		bio_advance_iter(bio, iter, len);
+		todo -= len;
+	} while (todo);
+
+	r = verity_shash_final(v, desc, digest);
+out:
+	shash_desc_zero(desc);
+	if (unlikely(r < 0))
+		DMERR("verity_shash_io_block crypto op failed: %d", r);
+
+	return r;
+}
+
 /*
  * Calls function process for 1 << v->data_dev_block_bits bytes in the bio_vec
  * starting from iter.
@@ -520,7 +792,6 @@ static int verity_verify_io(struct dm_verity_io *io)
 	for (b = 0; b < io->n_blocks; b++) {
 		int r;
 		sector_t cur_block = io->block + b;
-		struct ahash_request *req = verity_io_hash_req(v, io);
 
 		if (v->validated_blocks &&
 		    likely(test_bit(cur_block, v->validated_blocks))) {
@@ -547,19 +818,29 @@ static int verity_verify_io(struct dm_verity_io *io)
 			continue;
 		}
 
-		r = verity_hash_init(v, req, &res);
-		if (unlikely(r < 0))
-			return r;
-
 		start = io->iter;
-		r = verity_for_io_block(v, io, &io->iter, &res);
-		if (unlikely(r < 0))
-			return r;
+		if (v->shash_tfm) {
+			r = verity_shash_io_block(v, io, &io->iter,
+						  verity_io_real_digest(v, io));
+			if (unlikely(r < 0))
+				return r;
+		} else {
+			struct ahash_request *req = verity_io_hash_req(v, io);
 
-		r = verity_hash_final(v, req, verity_io_real_digest(v, io),
-					&res);
-		if (unlikely(r < 0))
-			return r;
+			r = verity_hash_init(v, req, &res);
+			if (unlikely(r < 0))
+				return r;
+
+			r = verity_for_io_block(v, io, &io->iter, &res);
+			if (unlikely(r < 0))
+				return r;
+
+			r = verity_hash_final(v, req,
+					      verity_io_real_digest(v, io),
+					      &res);
+			if (unlikely(r < 0))
+				return r;
+		}
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
@@ -578,6 +859,57 @@ static int verity_verify_io(struct dm_verity_io *io)
 	return 0;
 }
 
+/*
+ * Try to verify a small "dm_verity_io" from the bio completion.  Only blocks
+ * whose hash is in the inline cache are handled and nothing here may sleep,
+ * so on any miss or mismatch false is returned and the io is verified again
+ * from the start by verity_work(), which also does error handling and FEC.
+ */
+static bool verity_verify_io_inline(struct dm_verity_io *io)
+{
+	struct dm_verity *v = io->v;
+	struct bvec_iter iter = io->iter;
+	unsigned b;
+
+	if (!v->inline_slots || !v->shash_tfm ||
+	    io->n_blocks > READ_ONCE(dm_verity_inline_blocks))
+		return false;
+
+	for (b = 0; b < io->n_blocks; b++) {
+		sector_t cur_block = io->block + b;
+
+		if (v->validated_blocks &&
+		    likely(test_bit(cur_block, v->validated_blocks))) {
+			verity_bv_skip_block(v, io, &iter);
+			continue;
+		}
+
+		if (!verity_inline_want_digest(v, cur_block,
+					       verity_io_want_digest(v, io)))
+			return false;
+
+		if (v->zero_digest &&
+		    !memcmp(v->zero_digest, verity_io_want_digest(v, io),
+			    v->digest_size)) {
+			verity_for_bv_block(v, io, &iter, verity_bv_zero);
+			continue;
+		}
+
+		if (verity_shash_io_block(v, io, &iter,
+					  verity_io_real_digest(v, io)) < 0)
+			return false;
+
+		if (memcmp(verity_io_real_digest(v, io),
+			   verity_io_want_digest(v, io), v->digest_size))
+			return false;
+
+		if (v->validated_blocks)
+			set_bit(cur_block, v->validated_blocks);
+	}
+
+	return true;
+}
+
 /*
  * End one "io" structure with a given error.
  */
@@ -610,6 +942,12 @@ static void verity_end_io(struct bio *bio)
 		return;
 	}
 
+	if (!bio->bi_status && verity_verify_io_inline(io)) {
+		atomic_long_inc(&dm_verity_inline_hits);
+		verity_finish_io(io, BLK_STS_OK);
+		return;
+	}
+
 	INIT_WORK(&io->work, verity_work);
 	queue_work(io->v->verify_wq, &io->work);
 }
@@ -656,7 +994,18 @@ no_prefetch_cluster:
 
 static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 {
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_io_data_size);
 	struct dm_verity_prefetch_work *pw;
+	unsigned n_blocks = io->n_blocks;
+
+	/*
+	 * Readahead and sequential reads are usually followed by the next
+	 * window of the same size, so fetch the hash blocks for it as well.
+	 */
+	if ((bio->bi_opf & REQ_RAHEAD) || io->block == READ_ONCE(v->next_block))
+		n_blocks += min_t(sector_t, io->n_blocks,
+				  v->data_blocks - (io->block + io->n_blocks));
+	WRITE_ONCE(v->next_block, io->block + io->n_blocks);
 
 	pw = kmalloc(sizeof(struct dm_verity_prefetch_work),
 		GFP_NOIO | __GFP_NORETRY | __GFP_NOMEMALLOC | __GFP_NOWARN);
@@ -667,7 +1016,7 @@ static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 	INIT_WORK(&pw->work, verity_prefetch_io);
 	pw->v = v;
 	pw->block = io->block;
-	pw->n_blocks = io->n_blocks;
+	pw->n_blocks = n_blocks;
 	queue_work(v->verify_wq, &pw->work);
 }
 
@@ -830,6 +1179,16 @@ void verity_dtr(struct dm_target *ti)
 	if (v->verify_wq)
 		destroy_workqueue(v->verify_wq);
 
+	if (v->inline_slots) {
+		verity_inline_unpin_all(v);
+		kfree(v->inline_slots);
+	}
+
+	if (v->warm_bufs) {
+		verity_warm_unpin_all(v);
+		kfree(v->warm_bufs);
+	}
+
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
@@ -838,6 +1197,10 @@ void verity_dtr(struct dm_target *ti)
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
 
+	kfree(v->initial_hashstate);
+	if (v->shash_tfm)
+		crypto_free_shash(v->shash_tfm);
+
 	if (v->tfm)
 		crypto_free_ahash(v->tfm);
 
@@ -875,6 +1238,67 @@ static int verity_alloc_most_once(struct dm_verity *v)
 	return 0;
 }
 
+static int verity_export_hashstate(struct dm_verity *v,
+				   struct crypto_shash *tfm)
+{
+	SHASH_DESC_ON_STACK(desc, tfm);
+	int r;
+
+	desc->tfm = tfm;
+	desc->flags = 0;
+
+	r = crypto_shash_init(desc);
+	if (!r && v->salt_size && (v->version >= 1))
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+	if (!r)
+		r = crypto_shash_export(desc, v->initial_hashstate);
+
+	shash_desc_zero(desc);
+
+	return r;
+}
+
+/*
+ * Use a synchronous implementation of the hash for the per-block work if
+ * one is available.  Data blocks are small and hashed from a workqueue, so
+ * the ahash request setup and completion round trip is pure overhead there.
+ * Failing to set it up is not fatal, the ahash path is used instead.
+ */
+static int verity_alloc_shash(struct dm_verity *v)
+{
+	struct crypto_shash *tfm;
+	int r;
+
+	tfm = crypto_alloc_shash(v->alg_name, 0, 0);
+	if (IS_ERR(tfm))
+		return 0;
+
+	if (crypto_shash_digestsize(tfm) != v->digest_size) {
+		crypto_free_shash(tfm);
+		return 0;
+	}
+
+	v->initial_hashstate = kmalloc(crypto_shash_statesize(tfm), GFP_KERNEL);
+	if (!v->initial_hashstate) {
+		crypto_free_shash(tfm);
+		return -ENOMEM;
+	}
+
+	r = verity_export_hashstate(v, tfm);
+	if (r) {
+		kfree(v->initial_hashstate);
+		v->initial_hashstate = NULL;
+		crypto_free_shash(tfm);
+		return 0;
+	}
+
+	v->shash_tfm = tfm;
+	DMINFO("%s using synchronous implementation \"%s\"", v->alg_name,
+	       crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm)));
+
+	return 0;
+}
+
 static int verity_alloc_zero_digest(struct dm_verity *v)
 {
 	int r = -ENOMEM;
@@ -1138,6 +1562,12 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	r = verity_alloc_shash(v);
+	if (r) {
+		ti->error = "Cannot allocate hash state";
+		goto bad;
+	}
+
 	argv += 10;
 	argc -= 10;
 
@@ -1151,13 +1581,11 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 			goto bad;
 	}
 
-#ifdef CONFIG_DM_ANDROID_VERITY_AT_MOST_ONCE_DEFAULT_ENABLED
-	if (!v->validated_blocks) {
+	if (dm_verity_at_most_once && !v->validated_blocks) {
 		r = verity_alloc_most_once(v);
 		if (r)
 			goto bad;
 	}
-#endif
 
 	v->hash_per_block_bits =
 		__fls((1 << v->hash_dev_block_bits) / v->digest_size);
@@ -1206,6 +1634,30 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	spin_lock_init(&v->inline_lock);
+	if (v->levels) {
+		v->inline_slots = kcalloc(DM_VERITY_INLINE_SLOTS,
+					  sizeof(*v->inline_slots), GFP_KERNEL);
+		if (!v->inline_slots) {
+			ti->error = "Cannot allocate inline hash cache";
+			r = -ENOMEM;
+			goto bad;
+		}
+
+		v->n_warm = min_t(sector_t, v->hash_level_block[0] - v->hash_start,
+				  READ_ONCE(dm_verity_warm_hash_bytes) >>
+				  v->hash_dev_block_bits);
+		if (v->n_warm) {
+			v->warm_bufs = kcalloc(v->n_warm, sizeof(*v->warm_bufs),
+					       GFP_KERNEL);
+			if (!v->warm_bufs) {
+				ti->error = "Cannot allocate warm hash blocks";
+				r = -ENOMEM;
+				goto bad;
+			}
+		}
+	}
+
 	/* WQ_UNBOUND greatly improves performance when running on ramdisk */
 	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_UNBOUND, num_online_cpus());
 	if (!v->verify_wq) {
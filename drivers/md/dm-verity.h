@@ -30,6 +30,7 @@ enum verity_block_type {
 };
 
 struct dm_verity_fec;
+struct dm_verity_inline_slot;
 
 struct dm_verity {
 	struct dm_dev *data_dev;
@@ -38,6 +39,8 @@ struct dm_verity {
 	struct dm_bufio_client *bufio;
 	char *alg_name;
 	struct crypto_ahash *tfm;
+	struct crypto_shash *shash_tfm;	/* synchronous hash, if available */
+	u8 *initial_hashstate;	/* shash state after the version 1 salt */
 	u8 *root_digest;	/* digest of the root block */
 	u8 *salt;		/* salt: its size is salt_size */
 	u8 *zero_digest;	/* digest for a zero block */
@@ -64,6 +67,16 @@ struct dm_verity {
 
 	struct dm_verity_fec *fec;	/* forward error correction */
 	unsigned long *validated_blocks; /* bitset blocks validated */
+
+	/* pinned level 0 hash blocks for verification in bio completion */
+	spinlock_t inline_lock;
+	struct dm_verity_inline_slot *inline_slots;
+
+	/* verified hash blocks above level 0, root first, held until dtr */
+	struct dm_buffer **warm_bufs;
+	unsigned n_warm;
+
+	sector_t next_block;	/* block after the last read, for prefetch */
 };
 
 struct dm_verity_io {
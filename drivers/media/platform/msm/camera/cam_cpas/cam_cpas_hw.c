@@ -114,20 +114,6 @@ static int cam_cpas_util_vote_bus_client_bw(
 		return -EINVAL;
 	}
 
-	mutex_lock(&bus_client->lock);
-
-	if (bus_client->curr_vote_level > 1) {
-		CAM_ERR(CAM_CPAS, "curr_vote_level %d cannot be greater than 1",
-			bus_client->curr_vote_level);
-		mutex_unlock(&bus_client->lock);
-		return -EINVAL;
-	}
-
-	idx = bus_client->curr_vote_level;
-	idx = 1 - idx;
-	bus_client->curr_vote_level = idx;
-	mutex_unlock(&bus_client->lock);
-
 	if (camnoc_bw == true) {
 		if ((ab > 0) && (ab < CAM_CPAS_AXI_MIN_CAMNOC_AB_BW))
 			ab = CAM_CPAS_AXI_MIN_CAMNOC_AB_BW;
@@ -142,6 +128,26 @@ static int cam_cpas_util_vote_bus_client_bw(
 			ib = CAM_CPAS_AXI_MIN_MNOC_IB_BW;
 	}
 
+	if (bus_client->mm_client) {
+		CAM_DBG(CAM_CPAS, "Bus client=[%s] :ab[%llu] ib[%llu] shared",
+			bus_client->name, ab, ib);
+		return msm_bus_mm_update_bw(bus_client->mm_client, ab, ib);
+	}
+
+	mutex_lock(&bus_client->lock);
+
+	if (bus_client->curr_vote_level > 1) {
+		CAM_ERR(CAM_CPAS, "curr_vote_level %d cannot be greater than 1",
+			bus_client->curr_vote_level);
+		mutex_unlock(&bus_client->lock);
+		return -EINVAL;
+	}
+
+	idx = bus_client->curr_vote_level;
+	idx = 1 - idx;
+	bus_client->curr_vote_level = idx;
+	mutex_unlock(&bus_client->lock);
+
 	pdata = bus_client->pdata;
 	path = &(pdata->usecase[idx]);
 	path->vectors[0].ab = ab;
@@ -206,6 +212,19 @@ static int cam_cpas_util_register_bus_client(
 	bus_client->name = pdata->name;
 	mutex_init(&bus_client->lock);
 
+	/* Vote through the path shared with the other multimedia cores */
+	if (bus_client->dyn_vote && of_property_read_bool(dev_node,
+		"qcom,msm-bus-mm-aggr")) {
+		bus_client->mm_client = msm_bus_mm_register(bus_client->src,
+			bus_client->dst, bus_client->name);
+		if (IS_ERR(bus_client->mm_client)) {
+			CAM_WARN(CAM_CPAS, "No shared path for %s rc %ld",
+				bus_client->name,
+				PTR_ERR(bus_client->mm_client));
+			bus_client->mm_client = NULL;
+		}
+	}
+
 	CAM_DBG(CAM_CPAS, "Bus Client=[%d][%s] : src=%d, dst=%d",
 		bus_client->client_id, bus_client->name,
 		bus_client->src, bus_client->dst);
@@ -229,6 +248,8 @@ static int cam_cpas_util_unregister_bus_client(
 	else
 		cam_cpas_util_vote_bus_client_level(bus_client, 0);
 
+	msm_bus_mm_unregister(bus_client->mm_client);
+	bus_client->mm_client = NULL;
 	msm_bus_scale_unregister_client(bus_client->client_id);
 	bus_client->valid = false;
 
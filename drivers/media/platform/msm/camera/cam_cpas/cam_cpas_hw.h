@@ -124,6 +124,7 @@ struct cam_cpas_client {
  * @lock: Mutex lock used while voting on this client
  * @valid: Whether bus client is valid
  * @name: Name of the bus client
+ * @mm_client: Shared multimedia path client, if voting through one
  *
  */
 struct cam_cpas_bus_client {
@@ -138,6 +139,7 @@ struct cam_cpas_bus_client {
 	struct mutex lock;
 	bool valid;
 	const char *name;
+	struct msm_bus_mm_client *mm_client;
 };
 
 /**
@@ -62,6 +62,17 @@ struct hfi_mem_info {
  */
 int hfi_write_cmd(void *cmd_ptr);
 
+/**
+ * hfi_write_cmd_batch() - write several commands with one interrupt
+ * @cmd_ptrs: array of pointers to command data for hfi write
+ * @num_cmds: number of commands in @cmd_ptrs
+ *
+ * Either all commands are queued, in order, or none is.
+ *
+ * Returns success(zero)/failure(non zero)
+ */
+int hfi_write_cmd_batch(void **cmd_ptrs, uint32_t num_cmds);
+
 /**
  * hfi_read_message() - function for hfi read
  * @pmsg: buffer to place read message for hfi queue
@@ -11,7 +11,10 @@
  */
 
 #include <linux/io.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/random.h>
 #include <asm/errno.h>
@@ -45,10 +48,47 @@
 #define HFI_MAX_PC_POLL_TRY 150
 #define HFI_POLL_TRY_SLEEP 1
 
+#define HFI_CMD_LAT_BUCKETS 16
+#define HFI_CMD_MAX_PENDING 32
+
+/**
+ * struct hfi_cmd_stats
+ * @writes: Command queue writes, each raising one interrupt
+ * @pkts: Packets written, more than @writes when batched
+ * @q_full: Writes rejected for lack of queue space
+ * @written: Words written since the queue was set up
+ * @consumed: Words the firmware has read since the queue was set up
+ * @last_read_idx: Firmware read index when last looked at
+ * @head: Next free slot of @pending
+ * @tail: Oldest write in @pending
+ * @pending: End of each write in @written words and when it was made
+ * @lat_hist: Time writes spent in the queue, bucket n counts < 2^n us
+ * @lat_max_us: Longest time a write spent in the queue
+ */
+struct hfi_cmd_stats {
+	uint64_t writes;
+	uint64_t pkts;
+	uint64_t q_full;
+	uint64_t written;
+	uint64_t consumed;
+	uint32_t last_read_idx;
+	uint32_t head;
+	uint32_t tail;
+	struct {
+		uint64_t end;
+		ktime_t time;
+	} pending[HFI_CMD_MAX_PENDING];
+	uint64_t lat_hist[HFI_CMD_LAT_BUCKETS];
+	uint64_t lat_max_us;
+};
+
 static struct hfi_info *g_hfi;
 unsigned int g_icp_mmu_hdl;
 static DEFINE_MUTEX(hfi_cmd_q_mutex);
 static DEFINE_MUTEX(hfi_msg_q_mutex);
+/* protected by hfi_cmd_q_mutex */
+static struct hfi_cmd_stats hfi_cmd_stats;
+static struct dentry *hfi_debugfs;
 
 void cam_hfi_queue_dump(void)
 {
@@ -97,19 +137,87 @@ void cam_hfi_queue_dump(void)
 	CAM_DBG(CAM_HFI, "MSG Q END");
 }
 
-int hfi_write_cmd(void *cmd_ptr)
+/*
+ * Account the words the firmware has read from the command queue and
+ * retire the writes it has fully consumed. The firmware is only seen to
+ * have read a write on the next write or message read, so the recorded
+ * queue time is an upper bound. Called with hfi_cmd_q_mutex held.
+ */
+static void hfi_cmd_q_retire(struct hfi_q_hdr *q)
 {
-	uint32_t size_in_words, empty_space, new_write_idx, read_idx, temp;
-	uint32_t *write_q, *write_ptr;
+	struct hfi_cmd_stats *st = &hfi_cmd_stats;
+	uint32_t read_idx = q->qhdr_read_idx;
+	uint32_t slot;
+	ktime_t now;
+	uint64_t us;
+
+	if (read_idx >= q->qhdr_q_size)
+		return;
+
+	st->consumed += (read_idx + q->qhdr_q_size - st->last_read_idx) %
+		q->qhdr_q_size;
+	st->last_read_idx = read_idx;
+
+	now = ktime_get();
+	while (st->tail != st->head) {
+		slot = st->tail % HFI_CMD_MAX_PENDING;
+		if (st->pending[slot].end > st->consumed)
+			break;
+
+		us = ktime_us_delta(now, st->pending[slot].time);
+		st->lat_hist[min_t(uint32_t, fls64(us),
+			HFI_CMD_LAT_BUCKETS - 1)]++;
+		if (us > st->lat_max_us)
+			st->lat_max_us = us;
+		st->tail++;
+	}
+}
+
+static uint32_t hfi_copy_cmd(uint32_t *write_q, uint32_t q_size,
+	uint32_t write_idx, void *cmd_ptr, uint32_t size_in_words)
+{
+	uint32_t new_write_idx, temp;
+	uint32_t *write_ptr;
+
+	new_write_idx = write_idx + size_in_words;
+	write_ptr = (uint32_t *)(write_q + write_idx);
+
+	if (new_write_idx < q_size) {
+		memcpy(write_ptr, (uint8_t *)cmd_ptr,
+			size_in_words << BYTE_WORD_SHIFT);
+	} else {
+		new_write_idx -= q_size;
+		temp = (size_in_words - new_write_idx) << BYTE_WORD_SHIFT;
+		memcpy(write_ptr, (uint8_t *)cmd_ptr, temp);
+		memcpy(write_q, (uint8_t *)cmd_ptr + temp,
+			new_write_idx << BYTE_WORD_SHIFT);
+	}
+
+	return new_write_idx;
+}
+
+int hfi_write_cmd_batch(void **cmd_ptrs, uint32_t num_cmds)
+{
+	uint32_t size_in_words, total_words = 0, empty_space;
+	uint32_t write_idx, read_idx, slot, i;
+	uint32_t *write_q;
 	struct hfi_qtbl *q_tbl;
 	struct hfi_q_hdr *q;
+	struct hfi_cmd_stats *st = &hfi_cmd_stats;
 	int rc = 0;
 
-	if (!cmd_ptr) {
+	if (!cmd_ptrs || !num_cmds) {
 		CAM_ERR(CAM_HFI, "command is null");
 		return -EINVAL;
 	}
 
+	for (i = 0; i < num_cmds; i++) {
+		if (!cmd_ptrs[i]) {
+			CAM_ERR(CAM_HFI, "command %u is null", i);
+			return -EINVAL;
+		}
+	}
+
 	mutex_lock(&hfi_cmd_q_mutex);
 	if (!g_hfi) {
 		CAM_ERR(CAM_HFI, "HFI interface not setup");
@@ -130,36 +238,36 @@ int hfi_write_cmd(void *cmd_ptr)
 
 	write_q = (uint32_t *)g_hfi->map.cmd_q.kva;
 
-	size_in_words = (*(uint32_t *)cmd_ptr) >> BYTE_WORD_SHIFT;
-	if (!size_in_words) {
-		CAM_DBG(CAM_HFI, "failed");
-		rc = -EINVAL;
-		goto err;
+	for (i = 0; i < num_cmds; i++) {
+		size_in_words = (*(uint32_t *)cmd_ptrs[i]) >> BYTE_WORD_SHIFT;
+		if (!size_in_words) {
+			CAM_DBG(CAM_HFI, "failed");
+			rc = -EINVAL;
+			goto err;
+		}
+		total_words += size_in_words;
 	}
 
+	hfi_cmd_q_retire(q);
+
+	/* a batch goes in whole or not at all */
 	read_idx = q->qhdr_read_idx;
 	empty_space = (q->qhdr_write_idx >= read_idx) ?
 		(q->qhdr_q_size - (q->qhdr_write_idx - read_idx)) :
 		(read_idx - q->qhdr_write_idx);
-	if (empty_space <= size_in_words) {
+	if (empty_space <= total_words) {
 		CAM_ERR(CAM_HFI, "failed: empty space %u, size_in_words %u",
-			empty_space, size_in_words);
+			empty_space, total_words);
+		st->q_full++;
 		rc = -EIO;
 		goto err;
 	}
 
-	new_write_idx = q->qhdr_write_idx + size_in_words;
-	write_ptr = (uint32_t *)(write_q + q->qhdr_write_idx);
-
-	if (new_write_idx < q->qhdr_q_size) {
-		memcpy(write_ptr, (uint8_t *)cmd_ptr,
-			size_in_words << BYTE_WORD_SHIFT);
-	} else {
-		new_write_idx -= q->qhdr_q_size;
-		temp = (size_in_words - new_write_idx) << BYTE_WORD_SHIFT;
-		memcpy(write_ptr, (uint8_t *)cmd_ptr, temp);
-		memcpy(write_q, (uint8_t *)cmd_ptr + temp,
-			new_write_idx << BYTE_WORD_SHIFT);
+	write_idx = q->qhdr_write_idx;
+	for (i = 0; i < num_cmds; i++) {
+		size_in_words = (*(uint32_t *)cmd_ptrs[i]) >> BYTE_WORD_SHIFT;
+		write_idx = hfi_copy_cmd(write_q, q->qhdr_q_size, write_idx,
+			cmd_ptrs[i], size_in_words);
 	}
 
 	/*
@@ -168,7 +276,7 @@ int hfi_write_cmd(void *cmd_ptr)
 	 */
 	wmb();
 
-	q->qhdr_write_idx = new_write_idx;
+	q->qhdr_write_idx = write_idx;
 
 	/*
 	 * Before raising interrupt make sure command data is ready for
@@ -177,11 +285,25 @@ int hfi_write_cmd(void *cmd_ptr)
 	wmb();
 	cam_io_w_mb((uint32_t)INTR_ENABLE,
 		g_hfi->csr_base + HFI_REG_A5_CSR_HOST2ICPINT);
+
+	st->writes++;
+	st->pkts += num_cmds;
+	st->written += total_words;
+	if (st->head - st->tail == HFI_CMD_MAX_PENDING)
+		st->tail++;
+	slot = st->head++ % HFI_CMD_MAX_PENDING;
+	st->pending[slot].end = st->written;
+	st->pending[slot].time = ktime_get();
 err:
 	mutex_unlock(&hfi_cmd_q_mutex);
 	return rc;
 }
 
+int hfi_write_cmd(void *cmd_ptr)
+{
+	return hfi_write_cmd_batch(&cmd_ptr, 1);
+}
+
 int hfi_read_message(uint32_t *pmsg, uint8_t q_id,
 	uint32_t *words_read)
 {
@@ -277,6 +399,12 @@ int hfi_read_message(uint32_t *pmsg, uint8_t q_id,
 	 * queue parameters are updated after read
 	 */
 	wmb();
+
+	/* an ack means the firmware has likely read some commands */
+	if (q_id == Q_MSG && mutex_trylock(&hfi_cmd_q_mutex)) {
+		hfi_cmd_q_retire(&q_tbl_ptr->q_hdr[Q_CMD]);
+		mutex_unlock(&hfi_cmd_q_mutex);
+	}
 err:
 	mutex_unlock(&hfi_msg_q_mutex);
 	return rc;
@@ -645,6 +773,59 @@ int cam_hfi_resume(struct hfi_mem_info *hfi_mem,
 	return rc;
 }
 
+static int hfi_cmd_stats_show(struct seq_file *s, void *unused)
+{
+	struct hfi_cmd_stats st;
+	int i;
+
+	mutex_lock(&hfi_cmd_q_mutex);
+	st = hfi_cmd_stats;
+	mutex_unlock(&hfi_cmd_q_mutex);
+
+	seq_printf(s, "writes: %llu\n", st.writes);
+	seq_printf(s, "packets: %llu\n", st.pkts);
+	seq_printf(s, "queue full: %llu\n", st.q_full);
+	seq_printf(s, "max queue time us: %llu\n", st.lat_max_us);
+	seq_puts(s, "queue time us:\n");
+	for (i = 0; i < HFI_CMD_LAT_BUCKETS; i++) {
+		if (!st.lat_hist[i])
+			continue;
+		if (i == HFI_CMD_LAT_BUCKETS - 1)
+			seq_printf(s, "  >= %u: %llu\n", 1U << (i - 1),
+				st.lat_hist[i]);
+		else
+			seq_printf(s, "  < %u: %llu\n", 1U << i,
+				st.lat_hist[i]);
+	}
+
+	return 0;
+}
+
+static int hfi_cmd_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hfi_cmd_stats_show, NULL);
+}
+
+static const struct file_operations hfi_cmd_stats_fops = {
+	.open = hfi_cmd_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void hfi_create_debugfs(void)
+{
+	hfi_debugfs = debugfs_create_dir("camera_hfi", NULL);
+	if (IS_ERR_OR_NULL(hfi_debugfs)) {
+		CAM_ERR(CAM_HFI, "Failed to create hfi dir");
+		return;
+	}
+
+	if (!debugfs_create_file("cmd_q_stats", 0444, hfi_debugfs,
+		NULL, &hfi_cmd_stats_fops))
+		CAM_ERR(CAM_HFI, "failed to create cmd_q_stats entry");
+}
+
 int cam_hfi_init(uint8_t event_driven_mode, struct hfi_mem_info *hfi_mem,
 		void __iomem *icp_base, bool debug)
 {
@@ -715,6 +896,10 @@ int cam_hfi_init(uint8_t event_driven_mode, struct hfi_mem_info *hfi_mem,
 	cmd_q_hdr->qhdr_pkt_drop_cnt = RESET;
 	cmd_q_hdr->qhdr_read_idx = RESET;
 	cmd_q_hdr->qhdr_write_idx = RESET;
+	hfi_cmd_stats.written = 0;
+	hfi_cmd_stats.consumed = 0;
+	hfi_cmd_stats.last_read_idx = 0;
+	hfi_cmd_stats.tail = hfi_cmd_stats.head;
 
 	/* setup firmware-to-Host message queue */
 	msg_q_hdr = &qtbl->q_hdr[Q_MSG];
@@ -878,6 +1063,9 @@ int cam_hfi_init(uint8_t event_driven_mode, struct hfi_mem_info *hfi_mem,
 	cam_io_w_mb((uint32_t)(INTR_ENABLE|INTR_ENABLE_WD0),
 		icp_base + HFI_REG_A5_CSR_A2HOSTINTEN);
 
+	if (!hfi_debugfs)
+		hfi_create_debugfs();
+
 	mutex_unlock(&hfi_cmd_q_mutex);
 	mutex_unlock(&hfi_msg_q_mutex);
 
@@ -16,6 +16,9 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/file.h>
+#include <linux/sync_file.h>
 #include "cam_sync_util.h"
 #include "cam_debug_util.h"
 #include "cam_common_util.h"
@@ -49,22 +52,18 @@ int cam_sync_create(int32_t *sync_obj, const char *name)
 {
 	int rc;
 	long idx;
-	bool bit;
 
-	do {
-		idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
-		if (idx >= CAM_SYNC_MAX_OBJS) {
-			CAM_ERR(CAM_SYNC,
-				"Error: Unable to Create Sync Idx = %d Reached Max!!",
-				idx);
-			sync_dev->err_cnt++;
-			if (sync_dev->err_cnt == 1)
-				cam_sync_print_fence_table();
-			return -ENOMEM;
-		}
-		CAM_DBG(CAM_SYNC, "Index location available at idx: %ld", idx);
-		bit = test_and_set_bit(idx, sync_dev->bitmap);
-	} while (bit);
+	rc = cam_sync_util_find_and_set_empty_row(sync_dev, &idx);
+	if (rc) {
+		CAM_ERR(CAM_SYNC,
+			"Error: Unable to Create Sync Idx = %ld Reached Max!!",
+			idx);
+		sync_dev->err_cnt++;
+		if (sync_dev->err_cnt == 1)
+			cam_sync_print_fence_table();
+		return rc;
+	}
+	CAM_DBG(CAM_SYNC, "Index location available at idx: %ld", idx);
 
 	spin_lock_bh(&sync_dev->row_spinlocks[idx]);
 	rc = cam_sync_init_row(sync_dev->sync_table, idx, name,
@@ -129,6 +128,7 @@ int cam_sync_register_callback(sync_callback cb_func,
 			INIT_WORK(&sync_cb->cb_dispatch_work,
 				cam_sync_util_cb_dispatch);
 			sync_cb->status = row->state;
+			sync_cb->signal_ts = ktime_get();
 			CAM_DBG(CAM_SYNC, "Enqueue callback for sync object:%d",
 				sync_cb->sync_obj);
 			queue_work(sync_dev->work_queue,
@@ -185,7 +185,8 @@ int cam_sync_deregister_callback(sync_callback cb_func,
 	return found ? 0 : -ENOENT;
 }
 
-int cam_sync_signal(int32_t sync_obj, uint32_t status)
+static int __cam_sync_signal(int32_t sync_obj, uint32_t status,
+	struct list_head *cb_list)
 {
 	struct sync_table_row *row = NULL;
 	struct sync_table_row *parent_row = NULL;
@@ -239,7 +240,7 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status)
 	}
 
 	row->state = status;
-	cam_sync_util_dispatch_signaled_cb(sync_obj, status);
+	cam_sync_util_dispatch_signaled_cb(sync_obj, status, cb_list);
 
 	/* copy parent list to local and release child lock */
 	INIT_LIST_HEAD(&parents_list);
@@ -275,7 +276,8 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status)
 
 		if (!parent_row->remaining)
 			cam_sync_util_dispatch_signaled_cb(
-				parent_info->sync_id, parent_row->state);
+				parent_info->sync_id, parent_row->state,
+				cb_list);
 
 		spin_unlock_bh(&sync_dev->row_spinlocks[parent_info->sync_id]);
 		list_del_init(&parent_info->list);
@@ -285,11 +287,43 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status)
 	return 0;
 }
 
+int cam_sync_signal(int32_t sync_obj, uint32_t status)
+{
+	struct list_head cb_list;
+	int rc;
+
+	INIT_LIST_HEAD(&cb_list);
+	rc = __cam_sync_signal(sync_obj, status, &cb_list);
+	cam_sync_util_dispatch_cb_list(&cb_list);
+
+	return rc;
+}
+
+int cam_sync_signal_batch(int32_t *sync_objs, uint32_t num_objs,
+	uint32_t status)
+{
+	struct list_head cb_list;
+	uint32_t i;
+	int rc, first_rc = 0;
+
+	if (!sync_objs || !num_objs)
+		return -EINVAL;
+
+	INIT_LIST_HEAD(&cb_list);
+	for (i = 0; i < num_objs; i++) {
+		rc = __cam_sync_signal(sync_objs[i], status, &cb_list);
+		if (rc && !first_rc)
+			first_rc = rc;
+	}
+	cam_sync_util_dispatch_cb_list(&cb_list);
+
+	return first_rc;
+}
+
 int cam_sync_merge(int32_t *sync_obj, uint32_t num_objs, int32_t *merged_obj)
 {
 	int rc;
 	long idx = 0;
-	bool bit;
 	int i = 0;
 
 	if (!sync_obj || !merged_obj) {
@@ -316,12 +350,9 @@ int cam_sync_merge(int32_t *sync_obj, uint32_t num_objs, int32_t *merged_obj)
 			return rc;
 		}
 	}
-	do {
-		idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
-		if (idx >= CAM_SYNC_MAX_OBJS)
-			return -ENOMEM;
-		bit = test_and_set_bit(idx, sync_dev->bitmap);
-	} while (bit);
+	rc = cam_sync_util_find_and_set_empty_row(sync_dev, &idx);
+	if (rc)
+		return rc;
 
 	spin_lock_bh(&sync_dev->row_spinlocks[idx]);
 	rc = cam_sync_init_group_object(sync_dev->sync_table,
@@ -570,6 +601,92 @@ static int cam_sync_handle_merge(struct cam_private_ioctl_arg *k_ioctl)
 	return result;
 }
 
+static int cam_sync_handle_export_fence(struct cam_private_ioctl_arg *k_ioctl)
+{
+	struct cam_sync_fence_info fence_info;
+	struct dma_fence *fence;
+	struct sync_file *sync_file;
+	int fd;
+	int rc;
+
+	if (k_ioctl->size != sizeof(struct cam_sync_fence_info))
+		return -EINVAL;
+
+	if (!k_ioctl->ioctl_ptr)
+		return -EINVAL;
+
+	if (copy_from_user(&fence_info,
+		u64_to_user_ptr(k_ioctl->ioctl_ptr),
+		k_ioctl->size))
+		return -EFAULT;
+
+	rc = cam_sync_export_dma_fence(fence_info.sync_obj, &fence);
+	if (rc)
+		return rc;
+
+	sync_file = sync_file_create(fence);
+	dma_fence_put(fence);
+	if (!sync_file)
+		return -ENOMEM;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		fput(sync_file->file);
+		return fd;
+	}
+
+	fence_info.fence_fd = fd;
+	if (copy_to_user(
+		u64_to_user_ptr(k_ioctl->ioctl_ptr),
+		&fence_info,
+		k_ioctl->size)) {
+		put_unused_fd(fd);
+		fput(sync_file->file);
+		return -EFAULT;
+	}
+
+	fd_install(fd, sync_file->file);
+
+	return 0;
+}
+
+static int cam_sync_handle_import_fence(struct cam_private_ioctl_arg *k_ioctl)
+{
+	struct cam_sync_fence_info fence_info;
+	struct dma_fence *fence;
+	int rc;
+
+	if (k_ioctl->size != sizeof(struct cam_sync_fence_info))
+		return -EINVAL;
+
+	if (!k_ioctl->ioctl_ptr)
+		return -EINVAL;
+
+	if (copy_from_user(&fence_info,
+		u64_to_user_ptr(k_ioctl->ioctl_ptr),
+		k_ioctl->size))
+		return -EFAULT;
+
+	fence = sync_file_get_fence(fence_info.fence_fd);
+	if (!fence)
+		return -EINVAL;
+
+	rc = cam_sync_import_dma_fence(fence, &fence_info.sync_obj);
+	dma_fence_put(fence);
+	if (rc)
+		return rc;
+
+	if (copy_to_user(
+		u64_to_user_ptr(k_ioctl->ioctl_ptr),
+		&fence_info,
+		k_ioctl->size)) {
+		cam_sync_destroy(fence_info.sync_obj);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
 static int cam_sync_handle_wait(struct cam_private_ioctl_arg *k_ioctl)
 {
 	struct cam_sync_wait sync_wait;
@@ -782,6 +899,12 @@ static long cam_sync_dev_ioctl(struct file *filep, void *fh,
 	case CAM_SYNC_MERGE:
 		rc = cam_sync_handle_merge(&k_ioctl);
 		break;
+	case CAM_SYNC_EXPORT_FENCE:
+		rc = cam_sync_handle_export_fence(&k_ioctl);
+		break;
+	case CAM_SYNC_IMPORT_FENCE:
+		rc = cam_sync_handle_import_fence(&k_ioctl);
+		break;
 	case CAM_SYNC_WAIT:
 		rc = cam_sync_handle_wait(&k_ioctl);
 		((struct cam_private_ioctl_arg *)arg)->result =
@@ -847,6 +970,7 @@ static int cam_sync_close(struct file *filep)
 	int rc = 0;
 	int i;
 	struct sync_device *sync_dev = video_drvdata(filep);
+	struct list_head cb_list;
 
 	if (!sync_dev) {
 		CAM_ERR(CAM_SYNC, "Sync device NULL");
@@ -857,6 +981,7 @@ static int cam_sync_close(struct file *filep)
 	mutex_lock(&sync_dev->table_lock);
 	sync_dev->open_cnt--;
 	if (!sync_dev->open_cnt) {
+		INIT_LIST_HEAD(&cb_list);
 		for (i = 1; i < CAM_SYNC_MAX_OBJS; i++) {
 			struct sync_table_row *row =
 			sync_dev->sync_table + i;
@@ -867,14 +992,16 @@ static int cam_sync_close(struct file *filep)
 			 * it.
 			 */
 			if (row->state == CAM_SYNC_STATE_ACTIVE) {
-				rc = cam_sync_signal(i,
-					CAM_SYNC_STATE_SIGNALED_ERROR);
+				rc = __cam_sync_signal(i,
+					CAM_SYNC_STATE_SIGNALED_ERROR,
+					&cb_list);
 				if (rc < 0)
 					CAM_ERR(CAM_SYNC,
 					  "Cleanup signal fail idx:%d\n",
 					  i);
 			}
 		}
+		cam_sync_util_dispatch_cb_list(&cb_list);
 
 		/*
 		 * Flush the work queue to wait for pending signal callbacks to
@@ -1002,6 +1129,35 @@ static void cam_sync_init_entity(struct sync_device *sync_dev)
 }
 #endif
 
+static int cam_sync_cb_latency_show(struct seq_file *s, void *unused)
+{
+	uint64_t cnt, sum, max;
+
+	spin_lock_bh(&sync_dev->cb_stats_lock);
+	cnt = sync_dev->cb_cnt;
+	sum = sync_dev->cb_latency_sum;
+	max = sync_dev->cb_latency_max;
+	spin_unlock_bh(&sync_dev->cb_stats_lock);
+
+	seq_printf(s, "callbacks: %llu\n", cnt);
+	seq_printf(s, "avg latency us: %llu\n", cnt ? div64_u64(sum, cnt) : 0);
+	seq_printf(s, "max latency us: %llu\n", max);
+
+	return 0;
+}
+
+static int cam_sync_cb_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cam_sync_cb_latency_show, NULL);
+}
+
+static const struct file_operations cam_sync_cb_latency_fops = {
+	.open = cam_sync_cb_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int cam_sync_create_debugfs(void)
 {
 	sync_dev->dentry = debugfs_create_dir("camera_sync", NULL);
@@ -1019,6 +1175,12 @@ static int cam_sync_create_debugfs(void)
 		return -ENOMEM;
 	}
 
+	if (!debugfs_create_file("cb_latency", 0444, sync_dev->dentry,
+		NULL, &cam_sync_cb_latency_fops)) {
+		CAM_ERR(CAM_SYNC, "failed to create cb_latency entry");
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -1034,6 +1196,8 @@ static int cam_sync_probe(struct platform_device *pdev)
 	sync_dev->err_cnt = 0;
 	mutex_init(&sync_dev->table_lock);
 	spin_lock_init(&sync_dev->cam_sync_eventq_lock);
+	spin_lock_init(&sync_dev->cb_stats_lock);
+	atomic_set(&sync_dev->next_idx, 1);
 
 	for (idx = 0; idx < CAM_SYNC_MAX_OBJS; idx++)
 		spin_lock_init(&sync_dev->row_spinlocks[idx]);
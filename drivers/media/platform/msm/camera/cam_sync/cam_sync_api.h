@@ -20,6 +20,9 @@
 #include <uapi/media/cam_sync.h>
 
 #define SYNC_DEBUG_NAME_LEN 63
+
+struct dma_fence;
+
 typedef void (*sync_callback)(int32_t sync_obj, int status, void *data);
 
 /* Kernel APIs */
@@ -88,6 +91,52 @@ int cam_sync_deregister_callback(sync_callback cb_func,
  */
 int cam_sync_signal(int32_t sync_obj, uint32_t status);
 
+/**
+ * @brief: Signals a block of sync objects with the same status.
+ *
+ * Behaves like calling cam_sync_signal() on each object in turn, except that
+ * the kernel callbacks made ready by the whole block are handed to the
+ * dispatch work queue at once. A failure on one object does not stop the
+ * remaining objects from being signaled.
+ *
+ * @param sync_objs: pointer to a block of ints to be signaled
+ * @param num_objs: Number of ints in the block
+ * @param status: Status of the signaling. Can be either SYNC_SIGNAL_ERROR or
+ * SYNC_SIGNAL_SUCCESS.
+ *
+ * @return Status of operation. First error encountered, zero otherwise.
+ */
+int cam_sync_signal_batch(int32_t *sync_objs, uint32_t num_objs,
+	uint32_t status);
+
+/**
+ * @brief: Exports a sync object as a dma_fence
+ *
+ * The returned fence signals when the sync object is signaled, with an error
+ * set if the object is signaled with error or destroyed before signaling.
+ * Each call returns a new fence.
+ *
+ * @param sync_obj: int referencing the sync object.
+ * @param fence: Pointer to the returned fence, owned by the caller.
+ *
+ * @return Status of operation. Negative in case of error. Zero otherwise.
+ */
+int cam_sync_export_dma_fence(int32_t sync_obj, struct dma_fence **fence);
+
+/**
+ * @brief: Imports a dma_fence as a new sync object
+ *
+ * The returned sync object is signaled when the fence signals, so it can be
+ * merged with camera sync objects through cam_sync_merge(). The caller owns
+ * the sync object and destroys it as usual.
+ *
+ * @param fence: The dma_fence to import. A reference is taken internally.
+ * @param sync_obj: Pointer to int referencing the new sync object.
+ *
+ * @return Status of operation. Negative in case of error. Zero otherwise.
+ */
+int cam_sync_import_dma_fence(struct dma_fence *fence, int32_t *sync_obj);
+
 /**
  * @brief: Merges multiple sync objects
  *
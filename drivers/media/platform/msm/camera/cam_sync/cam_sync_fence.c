@@ -0,0 +1,220 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/slab.h>
+#include <linux/dma-fence.h>
+#include "cam_sync_util.h"
+#include "cam_debug_util.h"
+
+#define CAM_SYNC_FENCE_DRIVER_NAME "cam_sync"
+
+/**
+ * struct cam_sync_dma_fence - dma_fence exported for a sync object
+ *
+ * @base     : Base dma_fence, must be first so the default release frees us
+ * @lock     : Lock handed to the dma_fence core
+ * @sync_obj : Sync object the fence follows
+ */
+struct cam_sync_dma_fence {
+	struct dma_fence base;
+	spinlock_t lock;
+	int32_t sync_obj;
+};
+
+/**
+ * struct cam_sync_fence_import - dma_fence driving an imported sync object
+ *
+ * @cb       : Callback registered on the dma_fence
+ * @work     : Work signaling the sync object, the fence callback may run in
+ *             hard irq context
+ * @fence    : Imported fence, a reference is held until the work has run
+ * @sync_obj : Sync object signaled by the fence
+ */
+struct cam_sync_fence_import {
+	struct dma_fence_cb cb;
+	struct work_struct work;
+	struct dma_fence *fence;
+	int32_t sync_obj;
+};
+
+static const char *cam_sync_fence_get_driver_name(struct dma_fence *fence)
+{
+	return CAM_SYNC_FENCE_DRIVER_NAME;
+}
+
+static const char *cam_sync_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return CAM_SYNC_FENCE_DRIVER_NAME;
+}
+
+static bool cam_sync_fence_enable_signaling(struct dma_fence *fence)
+{
+	return true;
+}
+
+static const struct dma_fence_ops cam_sync_dma_fence_ops = {
+	.get_driver_name = cam_sync_fence_get_driver_name,
+	.get_timeline_name = cam_sync_fence_get_timeline_name,
+	.enable_signaling = cam_sync_fence_enable_signaling,
+	.wait = dma_fence_default_wait,
+};
+
+void cam_sync_fence_export_cb(int32_t sync_obj, int status, void *data)
+{
+	struct dma_fence *fence = data;
+
+	if (status != CAM_SYNC_STATE_SIGNALED_SUCCESS)
+		dma_fence_set_error(fence, -EIO);
+
+	CAM_DBG(CAM_SYNC, "sync_obj:%d signal dma_fence status:%d",
+		sync_obj, status);
+	dma_fence_signal(fence);
+	dma_fence_put(fence);
+}
+
+int cam_sync_export_dma_fence(int32_t sync_obj, struct dma_fence **fence)
+{
+	struct cam_sync_dma_fence *sync_fence;
+	int rc;
+
+	if (!fence)
+		return -EINVAL;
+
+	sync_fence = kzalloc(sizeof(*sync_fence), GFP_KERNEL);
+	if (!sync_fence)
+		return -ENOMEM;
+
+	spin_lock_init(&sync_fence->lock);
+	sync_fence->sync_obj = sync_obj;
+
+	/*
+	 * Sync objects signal in any order, so each fence gets a context of
+	 * its own; sharing one would let sync_file merges drop fences based on
+	 * seqno ordering that does not exist.
+	 */
+	dma_fence_init(&sync_fence->base, &cam_sync_dma_fence_ops,
+		&sync_fence->lock, dma_fence_context_alloc(1), 1);
+
+	/* Reference owned by the callback, dropped once the object signals */
+	dma_fence_get(&sync_fence->base);
+	rc = cam_sync_register_callback(cam_sync_fence_export_cb,
+		&sync_fence->base, sync_obj);
+	if (rc) {
+		CAM_ERR(CAM_SYNC, "Unable to export sync obj %d rc %d",
+			sync_obj, rc);
+		dma_fence_put(&sync_fence->base);
+		dma_fence_put(&sync_fence->base);
+		return rc;
+	}
+
+	*fence = &sync_fence->base;
+
+	return 0;
+}
+
+static void cam_sync_fence_import_work(struct work_struct *work)
+{
+	struct cam_sync_fence_import *import = container_of(work,
+		struct cam_sync_fence_import, work);
+	struct sync_table_row *row = sync_dev->sync_table + import->sync_obj;
+	uint32_t status;
+	bool stale;
+	int rc;
+
+	/*
+	 * The sync object may have been destroyed, and its row reused, before
+	 * the fence signaled; the row only points at our fence while the
+	 * import is still live.
+	 */
+	spin_lock_bh(&sync_dev->row_spinlocks[import->sync_obj]);
+	stale = row->ext_fence != import->fence;
+	if (!stale)
+		row->ext_fence = NULL;
+	spin_unlock_bh(&sync_dev->row_spinlocks[import->sync_obj]);
+
+	if (!stale) {
+		status = dma_fence_get_status(import->fence) < 0 ?
+			CAM_SYNC_STATE_SIGNALED_ERROR :
+			CAM_SYNC_STATE_SIGNALED_SUCCESS;
+		rc = cam_sync_signal(import->sync_obj, status);
+		if (rc)
+			CAM_ERR(CAM_SYNC,
+				"Unable to signal imported sync obj %d rc %d",
+				import->sync_obj, rc);
+	}
+
+	dma_fence_put(import->fence);
+	kfree(import);
+}
+
+static void cam_sync_fence_import_cb(struct dma_fence *fence,
+	struct dma_fence_cb *cb)
+{
+	struct cam_sync_fence_import *import = container_of(cb,
+		struct cam_sync_fence_import, cb);
+
+	queue_work(sync_dev->work_queue, &import->work);
+}
+
+int cam_sync_import_dma_fence(struct dma_fence *fence, int32_t *sync_obj)
+{
+	struct cam_sync_fence_import *import;
+	struct sync_table_row *row;
+	int rc;
+
+	if (!fence || !sync_obj)
+		return -EINVAL;
+
+	import = kzalloc(sizeof(*import), GFP_KERNEL);
+	if (!import)
+		return -ENOMEM;
+
+	rc = cam_sync_create(&import->sync_obj, "dma_fence");
+	if (rc)
+		goto free_import;
+
+	/* Reference consumed when the fence signals the object */
+	rc = cam_sync_get_obj_ref(import->sync_obj);
+	if (rc)
+		goto destroy_obj;
+
+	import->fence = dma_fence_get(fence);
+	INIT_WORK(&import->work, cam_sync_fence_import_work);
+
+	row = sync_dev->sync_table + import->sync_obj;
+	spin_lock_bh(&sync_dev->row_spinlocks[import->sync_obj]);
+	row->ext_fence = fence;
+	spin_unlock_bh(&sync_dev->row_spinlocks[import->sync_obj]);
+
+	*sync_obj = import->sync_obj;
+
+	rc = dma_fence_add_callback(fence, &import->cb,
+		cam_sync_fence_import_cb);
+	if (rc == -ENOENT) {
+		/* Already signaled */
+		queue_work(sync_dev->work_queue, &import->work);
+	} else if (rc) {
+		CAM_ERR(CAM_SYNC, "Unable to add fence callback rc %d", rc);
+		dma_fence_put(import->fence);
+		goto destroy_obj;
+	}
+
+	CAM_DBG(CAM_SYNC, "Imported dma_fence as sync obj %d", *sync_obj);
+
+	return 0;
+
+destroy_obj:
+	cam_sync_destroy(import->sync_obj);
+free_import:
+	kfree(import);
+	return rc;
+}
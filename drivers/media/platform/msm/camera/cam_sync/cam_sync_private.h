@@ -18,6 +18,7 @@
 #include <linux/workqueue.h>
 #include <linux/interrupt.h>
 #include <linux/debugfs.h>
+#include <linux/dma-fence.h>
 #include <media/v4l2-fh.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-subdev.h>
@@ -100,6 +101,7 @@ struct sync_child_info {
  * @cb_data          : Callback data, registered by client driver
  * @status........   : Status with which callback will be invoked in client
  * @sync_obj         : Sync id of the object for which callback is registered
+ * @signal_ts        : Time the sync object got signaled
  * @cb_dispatch_work : Work representing the call dispatch
  * @list             : List member used to append this node to a linked list
  */
@@ -108,10 +110,23 @@ struct sync_callback_info {
 	void *cb_data;
 	int status;
 	int32_t sync_obj;
+	ktime_t signal_ts;
 	struct work_struct cb_dispatch_work;
 	struct list_head list;
 };
 
+/**
+ * struct sync_callback_batch - Kernel callbacks made ready by one signal call,
+ * dispatched together from a single work
+ *
+ * @work      : Work dispatching the callbacks
+ * @callbacks : Linked list of sync_callback_info to invoke
+ */
+struct sync_callback_batch {
+	struct work_struct work;
+	struct list_head callbacks;
+};
+
 /**
  * struct sync_user_payload - Single node of information about a user space
  * payload registered from user space
@@ -140,6 +155,7 @@ struct sync_user_payload {
  * @callback_list     : Linked list of kernel callbacks registered
  * @user_payload_list : LInked list of user space payloads registered
  * @ref_cnt           : ref count of the number of usage of the fence.
+ * @ext_fence         : dma_fence this object was imported from, if any
  */
 struct sync_table_row {
 	char name[CAM_SYNC_OBJ_NAME_LEN];
@@ -155,6 +171,7 @@ struct sync_table_row {
 	struct list_head callback_list;
 	struct list_head user_payload_list;
 	atomic_t ref_cnt;
+	struct dma_fence *ext_fence;
 };
 
 /**
@@ -185,7 +202,12 @@ struct cam_signalable_info {
  * @cam_sync_eventq_exists : Event queue exists to dispatch user payloads
  *                           to user space
  * @bitmap          : Bitmap representation of all sync objects
+ * @next_idx        : Row the search for a free sync object starts from
  * @err_cnt         : Error counter to dump fence table
+ * @cb_stats_lock   : Spinlock protecting the callback latency statistics
+ * @cb_cnt          : Count of kernel callbacks dispatched
+ * @cb_latency_sum  : Sum of signal to callback latencies, in usec
+ * @cb_latency_max  : Largest signal to callback latency, in usec
  */
 struct sync_device {
 	struct video_device *vdev;
@@ -199,7 +221,12 @@ struct sync_device {
 	bool cam_sync_eventq_exists;
 	spinlock_t cam_sync_eventq_lock;
 	DECLARE_BITMAP(bitmap, CAM_SYNC_MAX_OBJS);
+	atomic_t next_idx;
 	int err_cnt;
+	spinlock_t cb_stats_lock;
+	uint64_t cb_cnt;
+	uint64_t cb_latency_sum;
+	uint64_t cb_latency_max;
 };
 
 
@@ -15,20 +15,32 @@
 int cam_sync_util_find_and_set_empty_row(struct sync_device *sync_dev,
 	long *idx)
 {
-	int rc = 0;
-
-	mutex_lock(&sync_dev->table_lock);
-
-	*idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
+	long start = atomic_read(&sync_dev->next_idx);
+	bool wrapped = false;
+
+	if (start <= 0 || start >= CAM_SYNC_MAX_OBJS)
+		start = 1;
+
+	for (;;) {
+		*idx = find_next_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS,
+			start);
+		if (*idx >= CAM_SYNC_MAX_OBJS) {
+			if (wrapped)
+				return -ENOMEM;
+			wrapped = true;
+			start = 1;
+			continue;
+		}
 
-	if (*idx < CAM_SYNC_MAX_OBJS)
-		set_bit(*idx, sync_dev->bitmap);
-	else
-		rc = -1;
+		/* Lost the race for this row, keep searching past it */
+		if (!test_and_set_bit(*idx, sync_dev->bitmap))
+			break;
+		start = *idx + 1;
+	}
 
-	mutex_unlock(&sync_dev->table_lock);
+	atomic_set(&sync_dev->next_idx, *idx + 1);
 
-	return rc;
+	return 0;
 }
 
 int cam_sync_init_row(struct sync_table_row *table,
@@ -276,6 +288,14 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 	list_for_each_entry_safe(sync_cb, temp_cb,
 			&row->callback_list, list) {
 		list_del_init(&sync_cb->list);
+		/* An exported dma_fence must still signal, fail it */
+		if (sync_cb->callback_func == cam_sync_fence_export_cb) {
+			sync_cb->status = CAM_SYNC_STATE_SIGNALED_ERROR;
+			sync_cb->signal_ts = ktime_get();
+			queue_work(sync_dev->work_queue,
+				&sync_cb->cb_dispatch_work);
+			continue;
+		}
 		kfree(sync_cb);
 	}
 
@@ -291,11 +311,21 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 	return 0;
 }
 
-void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work)
+static void cam_sync_util_cb_invoke(struct sync_callback_info *cb_info)
 {
-	struct sync_callback_info *cb_info = container_of(cb_dispatch_work,
-		struct sync_callback_info,
-		cb_dispatch_work);
+	uint64_t latency;
+
+	latency = ktime_us_delta(ktime_get(), cb_info->signal_ts);
+
+	spin_lock_bh(&sync_dev->cb_stats_lock);
+	sync_dev->cb_cnt++;
+	sync_dev->cb_latency_sum += latency;
+	if (latency > sync_dev->cb_latency_max)
+		sync_dev->cb_latency_max = latency;
+	spin_unlock_bh(&sync_dev->cb_stats_lock);
+
+	CAM_DBG(CAM_SYNC, "sync_obj:%d status:%d signal to cb latency:%llu us",
+		cb_info->sync_obj, cb_info->status, latency);
 
 	cb_info->callback_func(cb_info->sync_obj,
 		cb_info->status,
@@ -304,14 +334,67 @@ void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work)
 	kfree(cb_info);
 }
 
+void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work)
+{
+	struct sync_callback_info *cb_info = container_of(cb_dispatch_work,
+		struct sync_callback_info,
+		cb_dispatch_work);
+
+	cam_sync_util_cb_invoke(cb_info);
+}
+
+void cam_sync_util_cb_batch_dispatch(struct work_struct *work)
+{
+	struct sync_callback_batch *batch = container_of(work,
+		struct sync_callback_batch, work);
+	struct sync_callback_info *cb_info, *temp;
+
+	list_for_each_entry_safe(cb_info, temp, &batch->callbacks, list) {
+		list_del_init(&cb_info->list);
+		cam_sync_util_cb_invoke(cb_info);
+	}
+
+	kfree(batch);
+}
+
+void cam_sync_util_dispatch_cb_list(struct list_head *cb_list)
+{
+	struct sync_callback_batch *batch;
+	struct sync_callback_info *sync_cb, *temp;
+
+	if (list_empty(cb_list))
+		return;
+
+	/* A single callback needs no batch, it carries its own work */
+	if (list_is_singular(cb_list))
+		goto queue_each;
+
+	batch = kzalloc(sizeof(*batch), GFP_ATOMIC);
+	if (!batch)
+		goto queue_each;
+
+	INIT_WORK(&batch->work, cam_sync_util_cb_batch_dispatch);
+	INIT_LIST_HEAD(&batch->callbacks);
+	list_splice_init(cb_list, &batch->callbacks);
+	queue_work(sync_dev->work_queue, &batch->work);
+	return;
+
+queue_each:
+	list_for_each_entry_safe(sync_cb, temp, cb_list, list) {
+		list_del_init(&sync_cb->list);
+		queue_work(sync_dev->work_queue, &sync_cb->cb_dispatch_work);
+	}
+}
+
 void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
-	uint32_t status)
+	uint32_t status, struct list_head *cb_list)
 {
 	struct sync_callback_info  *sync_cb;
 	struct sync_user_payload   *payload_info;
 	struct sync_callback_info  *temp_sync_cb;
 	struct sync_table_row      *signalable_row;
 	struct sync_user_payload   *temp_payload_info;
+	ktime_t                     signal_ts = ktime_get();
 
 	signalable_row = sync_dev->sync_table + sync_obj;
 	if (signalable_row->state == CAM_SYNC_STATE_INVALID) {
@@ -320,13 +403,13 @@ void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
 		return;
 	}
 
-	/* Dispatch kernel callbacks if any were registered earlier */
+	/* Collect kernel callbacks if any were registered earlier */
 	list_for_each_entry_safe(sync_cb,
 		temp_sync_cb, &signalable_row->callback_list, list) {
 		sync_cb->status = status;
+		sync_cb->signal_ts = signal_ts;
 		list_del_init(&sync_cb->list);
-		queue_work(sync_dev->work_queue,
-			&sync_cb->cb_dispatch_work);
+		list_add_tail(&sync_cb->list, cb_list);
 	}
 
 	/* Dispatch user payloads if any were registered earlier */
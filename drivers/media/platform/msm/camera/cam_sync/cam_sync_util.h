@@ -22,7 +22,8 @@ extern struct sync_device *sync_dev;
 
 /**
  * @brief: Finds an empty row in the sync table and sets its corresponding bit
- * in the bit array
+ * in the bit array. Lock free; the search starts after the most recently
+ * allocated row so that freed handles are not immediately reused.
  *
  * @param sync_dev : Pointer to the sync device instance
  * @param idx      : Pointer to an long containing the index found in the bit
@@ -87,15 +88,48 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx);
 void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work);
 
 /**
- * @brief: Function to dispatch callbacks for a signaled sync object
+ * @brief: Function to dispatch a batch of kernel callbacks
+ *
+ * @param work : Pointer to the work_struct of a sync_callback_batch
+ *
+ * @return None
+ */
+void cam_sync_util_cb_batch_dispatch(struct work_struct *work);
+
+/**
+ * @brief: Function to dispatch callbacks for a signaled sync object. Must be
+ *         called with the row spinlock of the sync object held.
  *
  * @sync_obj : Sync object that is signaled
  * @status   : Status of the signaled object
+ * @cb_list  : List the kernel callbacks of the object are moved to, to be
+ *             queued later through cam_sync_util_dispatch_cb_list()
  *
  * @return None
  */
 void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
-	uint32_t status);
+	uint32_t status, struct list_head *cb_list);
+
+/**
+ * @brief: Function to queue kernel callbacks collected by
+ *         cam_sync_util_dispatch_signaled_cb() onto the sync work queue
+ *
+ * @cb_list : List of sync_callback_info, empty on return
+ *
+ * @return None
+ */
+void cam_sync_util_dispatch_cb_list(struct list_head *cb_list);
+
+/**
+ * @brief: Sync callback signaling a dma_fence exported for a sync object
+ *
+ * @sync_obj : Sync object that is signaled
+ * @status   : Status of the signaled object
+ * @data     : The exported dma_fence, whose reference is dropped
+ *
+ * @return None
+ */
+void cam_sync_fence_export_cb(int32_t sync_obj, int status, void *data);
 
 /**
  * @brief: Function to send V4L event to user space
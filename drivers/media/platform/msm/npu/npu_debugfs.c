@@ -17,6 +17,7 @@
  * -------------------------------------------------------------------------
  */
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "npu_hw.h"
 #include "npu_hw_access.h"
@@ -46,6 +47,7 @@ static ssize_t npu_debug_log_read(struct file *file,
 		char __user *user_buf, size_t count, loff_t *ppos);
 static ssize_t npu_debug_ctrl_write(struct file *file,
 		const char __user *user_buf, size_t count, loff_t *ppos);
+static int npu_debug_networks_open(struct inode *inode, struct file *file);
 
 /* -------------------------------------------------------------------------
  * Variables
@@ -80,6 +82,13 @@ static const struct file_operations npu_ctrl_fops = {
 	.write = npu_debug_ctrl_write,
 };
 
+static const struct file_operations npu_networks_fops = {
+	.open = npu_debug_networks_open,
+	.release = single_release,
+	.read = seq_read,
+	.llseek = seq_lseek,
+};
+
 /* -------------------------------------------------------------------------
  * Function Implementations
  * -------------------------------------------------------------------------
@@ -192,6 +201,49 @@ static ssize_t npu_debug_reg_read(struct file *file,
 	return len;
 }
 
+/* -------------------------------------------------------------------------
+ * Function Implementations - Networks
+ * -------------------------------------------------------------------------
+ */
+static int npu_debug_networks_show(struct seq_file *s, void *unused)
+{
+	struct npu_device *npu_dev = s->private;
+	struct npu_host_ctx *host_ctx = &npu_dev->host_ctx;
+	struct npu_network *network;
+	int i;
+
+	mutex_lock(&host_ctx->lock);
+	seq_printf(s, "cache: num %d size %u budget %u idle_ms %u\n",
+		host_ctx->nw_cache_num, host_ctx->nw_cache_size,
+		host_ctx->nw_cache_budget, host_ctx->nw_cache_idle_ms);
+	seq_printf(s, "cache: hits %u misses %u evictions %u\n",
+		host_ctx->nw_cache_hits, host_ctx->nw_cache_misses,
+		host_ctx->nw_cache_evictions);
+
+	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
+		network = &host_ctx->networks[i];
+		if (!network->is_valid)
+			continue;
+
+		seq_printf(s, "network %lld hdl %x size %u %s load_us %llu exec %u avg_us %llu max_us %llu\n",
+			network->id, network->network_hdl, network->size,
+			network->is_cached ? "cached" :
+			network->cacheable ? "cacheable" : "-",
+			network->load_time_us, network->exec_cnt,
+			network->exec_cnt ? div_u64(network->exec_time_sum_us,
+				network->exec_cnt) : 0,
+			network->exec_time_max_us);
+	}
+	mutex_unlock(&host_ctx->lock);
+
+	return 0;
+}
+
+static int npu_debug_networks_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, npu_debug_networks_show, inode->i_private);
+}
+
 /* -------------------------------------------------------------------------
  * Function Implementations - Offset Read/Write
  * -------------------------------------------------------------------------
@@ -435,6 +487,24 @@ int npu_debugfs_init(struct npu_device *npu_dev)
 		goto err;
 	}
 
+	if (!debugfs_create_file("networks", 0444, debugfs->root,
+		npu_dev, &npu_networks_fops)) {
+		pr_err("debugfs_create_file networks fail\n");
+		goto err;
+	}
+
+	if (!debugfs_create_u32("nw_cache_budget", 0644,
+		debugfs->root, &(host_ctx->nw_cache_budget))) {
+		pr_err("debugfs_create_u32 fail for nw_cache_budget\n");
+		goto err;
+	}
+
+	if (!debugfs_create_u32("nw_cache_idle_ms", 0644,
+		debugfs->root, &(host_ctx->nw_cache_idle_ms))) {
+		pr_err("debugfs_create_u32 fail for nw_cache_idle_ms\n");
+		goto err;
+	}
+
 	debugfs->log_num_bytes_buffered = 0;
 	debugfs->log_read_index = 0;
 	debugfs->log_write_index = 0;
@@ -112,6 +112,8 @@ static int npu_exec_network(struct npu_client *client,
 	unsigned long arg);
 static int npu_exec_network_v2(struct npu_client *client,
 	unsigned long arg);
+static int npu_submit_exec(struct npu_client *client,
+	unsigned long arg);
 static int npu_receive_event(struct npu_client *client,
 	unsigned long arg);
 static int npu_set_fw_state(struct npu_client *client, uint32_t enable);
@@ -1570,6 +1572,58 @@ static int npu_exec_network_v2(struct npu_client *client,
 	return ret;
 }
 
+static int npu_submit_exec(struct npu_client *client,
+	unsigned long arg)
+{
+	struct msm_npu_submit_exec_ioctl req;
+	void __user *argp = (void __user *)arg;
+	struct msm_npu_patch_buf_info *patch_buf_info = NULL;
+	int ret;
+
+	ret = copy_from_user(&req, argp, sizeof(req));
+	if (ret) {
+		pr_err("fail to copy from user\n");
+		return -EFAULT;
+	}
+
+	if ((req.patch_buf_info_num > NPU_MAX_PATCH_NUM) ||
+		(req.patch_buf_info_num == 0)) {
+		pr_err("Invalid patch buf info num %d[max:%d]\n",
+			req.patch_buf_info_num, NPU_MAX_PATCH_NUM);
+		return -EINVAL;
+	}
+
+	patch_buf_info = kmalloc_array(req.patch_buf_info_num,
+		sizeof(*patch_buf_info), GFP_KERNEL);
+	if (!patch_buf_info)
+		return -ENOMEM;
+
+	ret = copy_from_user(patch_buf_info,
+		(void __user *)req.patch_buf_info,
+		req.patch_buf_info_num * sizeof(*patch_buf_info));
+	if (ret) {
+		pr_err("fail to copy patch buf info\n");
+		kfree(patch_buf_info);
+		return -EFAULT;
+	}
+
+	ret = npu_host_submit_exec(client, &req, patch_buf_info);
+
+	kfree(patch_buf_info);
+	if (ret) {
+		pr_err("npu_host_submit_exec failed %d\n", ret);
+		return ret;
+	}
+
+	ret = copy_to_user(argp, &req, sizeof(req));
+	if (ret) {
+		pr_err("fail to copy to user\n");
+		ret = -EFAULT;
+	}
+
+	return ret;
+}
+
 static int npu_process_kevent(struct npu_kevent *kevt)
 {
 	int ret = 0;
@@ -1772,6 +1826,9 @@ static long npu_ioctl(struct file *file, unsigned int cmd,
 	case MSM_NPU_EXEC_NETWORK_V2:
 		ret = npu_exec_network_v2(client, arg);
 		break;
+	case MSM_NPU_SUBMIT_EXEC:
+		ret = npu_submit_exec(client, arg);
+		break;
 	case MSM_NPU_RECEIVE_EVENT:
 		ret = npu_receive_event(client, arg);
 		break;
@@ -20,6 +20,7 @@
 #include <soc/qcom/subsystem_restart.h>
 #include <linux/device.h>
 #include <linux/platform_device.h>
+#include <linux/jhash.h>
 
 #include "npu_hw_access.h"
 #include "npu_common.h"
@@ -282,22 +283,41 @@ static struct npu_ion_buf *npu_get_npu_ion_buffer(struct npu_client
 	return ret_val;
 }
 
-static void npu_free_npu_ion_buffer(struct npu_client
-	*client, int buf_hdl)
+struct npu_ion_buf *npu_mem_detach_buf(struct npu_client *client,
+	int buf_hdl)
 {
 	struct list_head *pos = NULL;
-	struct npu_ion_buf *npu_ion_buf = NULL;
+	struct npu_ion_buf *ret_val = NULL, *tmp;
 
 	mutex_lock(&client->list_lock);
 	list_for_each(pos, &(client->mapped_buffer_list)) {
-		npu_ion_buf = list_entry(pos, struct npu_ion_buf, list);
-		if (npu_ion_buf->fd == buf_hdl) {
-			list_del(&npu_ion_buf->list);
-			kfree(npu_ion_buf);
+		tmp = list_entry(pos, struct npu_ion_buf, list);
+		if (tmp->fd == buf_hdl) {
+			list_del_init(&tmp->list);
+			ret_val = tmp;
 			break;
 		}
 	}
 	mutex_unlock(&client->list_lock);
+
+	return ret_val;
+}
+
+void npu_mem_release_buf(struct npu_device *npu_dev,
+	struct npu_ion_buf *ion_buf)
+{
+	if (ion_buf->table)
+		dma_buf_unmap_attachment(ion_buf->attachment, ion_buf->table,
+			DMA_BIDIRECTIONAL);
+	if (ion_buf->dma_buf && ion_buf->attachment)
+		dma_buf_detach(ion_buf->dma_buf, ion_buf->attachment);
+	if (ion_buf->dma_buf)
+		dma_buf_put(ion_buf->dma_buf);
+	npu_dev->smmu_ctx.attach_cnt--;
+
+	pr_debug("unmapped mem addr:0x%llx size:0x%x\n", ion_buf->iova,
+		ion_buf->size);
+	kfree(ion_buf);
 }
 
 int npu_mem_map(struct npu_client *client, int buf_hdl, uint32_t size,
@@ -397,7 +417,7 @@ void npu_mem_unmap(struct npu_client *client, int buf_hdl,  uint64_t addr)
 	struct npu_ion_buf *ion_buf = 0;
 
 	/* clear entry and retrieve the corresponding buffer */
-	ion_buf = npu_get_npu_ion_buffer(client, buf_hdl);
+	ion_buf = npu_mem_detach_buf(client, buf_hdl);
 	if (!ion_buf) {
 		pr_err("%s could not find buffer\n", __func__);
 		return;
@@ -407,18 +427,50 @@ void npu_mem_unmap(struct npu_client *client, int buf_hdl,  uint64_t addr)
 		pr_warn("unmap address %llu doesn't match %llu\n", addr,
 			ion_buf->iova);
 
-	if (ion_buf->table)
-		dma_buf_unmap_attachment(ion_buf->attachment, ion_buf->table,
-			DMA_BIDIRECTIONAL);
-	if (ion_buf->dma_buf && ion_buf->attachment)
-		dma_buf_detach(ion_buf->dma_buf, ion_buf->attachment);
-	if (ion_buf->dma_buf)
-		dma_buf_put(ion_buf->dma_buf);
-	npu_dev->smmu_ctx.attach_cnt--;
+	npu_mem_release_buf(npu_dev, ion_buf);
+}
 
-	pr_debug("unmapped mem addr:0x%llx size:0x%x\n", ion_buf->iova,
-		ion_buf->size);
-	npu_free_npu_ion_buffer(client, buf_hdl);
+int npu_mem_hash_buf(struct npu_client *client, uint64_t addr, uint32_t size,
+	uint64_t *hash)
+{
+	struct npu_ion_buf *ion_buf = NULL, *tmp;
+	struct list_head *pos = NULL;
+	void *vaddr;
+	int ret;
+
+	mutex_lock(&client->list_lock);
+	list_for_each(pos, &(client->mapped_buffer_list)) {
+		tmp = list_entry(pos, struct npu_ion_buf, list);
+		if (tmp->iova == addr) {
+			ion_buf = tmp;
+			break;
+		}
+	}
+
+	if (!ion_buf || !size || size > ion_buf->size) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	ret = dma_buf_begin_cpu_access(ion_buf->dma_buf, DMA_FROM_DEVICE);
+	if (ret)
+		goto unlock;
+
+	vaddr = dma_buf_vmap(ion_buf->dma_buf);
+	if (!vaddr) {
+		ret = -ENOMEM;
+	} else {
+		/* two independently seeded 32 bit hashes */
+		*hash = ((uint64_t)jhash(vaddr, size, 0) << 32) |
+			jhash(vaddr, size, size);
+		dma_buf_vunmap(ion_buf->dma_buf, vaddr);
+	}
+
+	dma_buf_end_cpu_access(ion_buf->dma_buf, DMA_FROM_DEVICE);
+unlock:
+	mutex_unlock(&client->list_lock);
+
+	return ret;
 }
 
 /* -------------------------------------------------------------------------
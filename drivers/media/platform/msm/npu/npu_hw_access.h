@@ -72,6 +72,12 @@ int npu_mem_map(struct npu_client *client, int buf_hdl, uint32_t size,
 void npu_mem_unmap(struct npu_client *client, int buf_hdl, uint64_t addr);
 void npu_mem_invalidate(struct npu_client *client, int buf_hdl);
 bool npu_mem_verify_addr(struct npu_client *client, uint64_t addr);
+int npu_mem_hash_buf(struct npu_client *client, uint64_t addr, uint32_t size,
+	uint64_t *hash);
+struct npu_ion_buf *npu_mem_detach_buf(struct npu_client *client,
+	int buf_hdl);
+void npu_mem_release_buf(struct npu_device *npu_dev,
+	struct npu_ion_buf *ion_buf);
 
 void *npu_ipc_addr(void);
 void npu_interrupt_ack(struct npu_device *npu_dev, uint32_t intr_num);
@@ -16,6 +16,8 @@
  * Includes
  * -------------------------------------------------------------------------
  */
+#include <linux/file.h>
+#include <linux/sync_file.h>
 #include "npu_hw_access.h"
 #include "npu_mgr.h"
 #include "npu_firmware.h"
@@ -68,6 +70,16 @@ static int npu_notify_dsp(struct npu_device *npu_dev, bool pwr_up);
 static int npu_notify_aop(struct npu_device *npu_dev, bool on);
 static int update_dcvs_activity(struct npu_device *npu_dev, uint32_t activity);
 static void npu_destroy_wq(struct npu_host_ctx *host_ctx);
+static void nw_cache_wq(struct work_struct *work);
+static void exec_queue_wq(struct work_struct *work);
+static void exec_queue_kick(struct npu_host_ctx *host_ctx,
+	struct npu_network *network);
+static void exec_queue_done(struct npu_host_ctx *host_ctx,
+	struct npu_network *network, int status);
+static void exec_queue_flush(struct npu_host_ctx *host_ctx,
+	struct npu_network *network, int status, bool in_flight);
+static bool nw_cache_adopt_buf(struct npu_host_ctx *host_ctx,
+	struct npu_client *client, int buf_hdl, uint64_t addr);
 static struct workqueue_struct *npu_create_wq(struct npu_host_ctx *host_ctx,
 	const char *name);
 
@@ -305,6 +317,10 @@ int npu_host_init(struct npu_device *npu_dev)
 	mutex_init(&host_ctx->lock);
 	atomic_set(&host_ctx->ipc_trans_id, 1);
 	host_ctx->npu_dev = npu_dev;
+	host_ctx->nw_cache_budget = NW_CACHE_DEFAULT_BUDGET;
+	host_ctx->nw_cache_idle_ms = NW_CACHE_DEFAULT_IDLE_MS;
+	INIT_DELAYED_WORK(&host_ctx->nw_cache_work, nw_cache_wq);
+	INIT_WORK(&host_ctx->exec_queue_work, exec_queue_wq);
 
 	host_ctx->wq = npu_create_wq(host_ctx, "npu_wq");
 	if (!host_ctx->wq)
@@ -322,6 +338,7 @@ void npu_host_deinit(struct npu_device *npu_dev)
 {
 	struct npu_host_ctx *host_ctx = &npu_dev->host_ctx;
 
+	cancel_delayed_work_sync(&host_ctx->nw_cache_work);
 	kfree(host_ctx->prop_buf);
 	npu_destroy_wq(host_ctx);
 	mutex_destroy(&host_ctx->lock);
@@ -373,6 +390,9 @@ static int host_error_hdlr(struct npu_device *npu_dev, bool force)
 	mutex_lock(&host_ctx->lock);
 	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
 		network = &host_ctx->networks[i];
+		if (network->is_valid && network->fw_error)
+			exec_queue_flush(host_ctx, network, -EIO, true);
+
 		if (network->is_valid && network->cmd_pending &&
 			network->fw_error) {
 			if (network->cmd_async) {
@@ -390,6 +410,10 @@ static int host_error_hdlr(struct npu_device *npu_dev, bool force)
 		}
 	}
 	complete_all(&host_ctx->loopback_done);
+
+	/* cached networks are gone with the fw, drop them */
+	if (host_ctx->nw_cache_num)
+		mod_delayed_work(system_wq, &host_ctx->nw_cache_work, 0);
 	mutex_unlock(&host_ctx->lock);
 
 	return 1;
@@ -588,6 +612,17 @@ static int network_get(struct npu_network *network)
 	return atomic_inc_return(&network->ref_cnt);
 }
 
+static void network_update_exec_stats(struct npu_network *network)
+{
+	uint64_t exec_time_us = ktime_us_delta(ktime_get(),
+		network->cmd_start);
+
+	network->exec_cnt++;
+	network->exec_time_sum_us += exec_time_us;
+	if (exec_time_us > network->exec_time_max_us)
+		network->exec_time_max_us = exec_time_us;
+}
+
 static struct npu_network *alloc_network(struct npu_host_ctx *ctx,
 	struct npu_client *client)
 {
@@ -611,6 +646,8 @@ static struct npu_network *alloc_network(struct npu_host_ctx *ctx,
 	memset(network, 0, sizeof(struct npu_network));
 	network->id = i + 1;
 	init_completion(&network->cmd_done);
+	INIT_LIST_HEAD(&network->exec_queue);
+	network->fence_context = dma_fence_context_alloc(1);
 	network->is_valid = true;
 	network->client = client;
 	network->stats_buf = kzalloc(NPU_MAX_STATS_BUF_SIZE,
@@ -690,6 +727,9 @@ static void free_network(struct npu_host_ctx *ctx, struct npu_client *client,
 	if (network) {
 		network_put(network);
 		if (atomic_read(&network->ref_cnt) == 0) {
+			if (network->cache_buf)
+				npu_mem_release_buf(ctx->npu_dev,
+					network->cache_buf);
 			kfree(network->stats_buf);
 			memset(network, 0, sizeof(struct npu_network));
 			ctx->network_num--;
@@ -767,6 +807,7 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 
 		network->cmd_pending = false;
 		network->cmd_ret_status = exe_rsp_pkt->header.status;
+		network_update_exec_stats(network);
 
 		if (!network->cmd_async) {
 			complete(&network->cmd_done);
@@ -780,6 +821,7 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 			if (npu_queue_event(network->client, &kevt))
 				pr_err("queue npu event failed\n");
 		}
+		exec_queue_kick(host_ctx, network);
 		network_put(network);
 
 		break;
@@ -823,8 +865,12 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 		network->stats_buf_size = stats_size;
 		network->cmd_pending = false;
 		network->cmd_ret_status = exe_rsp_pkt->header.status;
+		network_update_exec_stats(network);
 
-		if (network->cmd_async) {
+		if (network->exec_req) {
+			exec_queue_done(host_ctx, network,
+				exe_rsp_pkt->header.status ? -EIO : 0);
+		} else if (network->cmd_async) {
 			pr_debug("async cmd, queue event\n");
 			kevt.evt.type = MSM_NPU_EVENT_TYPE_EXEC_V2_DONE;
 			kevt.evt.u.exec_v2_done.network_hdl =
@@ -839,6 +885,7 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 		} else {
 			complete(&network->cmd_done);
 		}
+		exec_queue_kick(host_ctx, network);
 		network_put(network);
 		break;
 	}
@@ -882,6 +929,8 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 		network->network_hdl = load_rsp_pkt->network_hdl;
 		network->cmd_pending = false;
 		network->cmd_ret_status = load_rsp_pkt->header.status;
+		network->load_time_us = ktime_us_delta(ktime_get(),
+			network->cmd_start);
 
 		complete(&network->cmd_done);
 		network_put(network);
@@ -1123,8 +1172,10 @@ int32_t npu_host_unmap_buf(struct npu_client *client,
 		pr_warn("npu: wait for fw_deinit_done time out\n");
 
 	mutex_lock(&host_ctx->lock);
-	npu_mem_unmap(client, unmap_ioctl->buf_ion_hdl,
-		unmap_ioctl->npu_phys_addr);
+	if (!nw_cache_adopt_buf(host_ctx, client, unmap_ioctl->buf_ion_hdl,
+		unmap_ioctl->npu_phys_addr))
+		npu_mem_unmap(client, unmap_ioctl->buf_ion_hdl,
+			unmap_ioctl->npu_phys_addr);
 	mutex_unlock(&host_ctx->lock);
 	return 0;
 }
@@ -1150,6 +1201,7 @@ static int npu_send_network_cmd(struct npu_device *npu_dev,
 		network->cmd_ret_status = 0;
 		network->cmd_pending = true;
 		network->trans_id = atomic_read(&host_ctx->ipc_trans_id);
+		network->cmd_start = ktime_get();
 		ret = npu_host_ipc_send_cmd(npu_dev,
 			IPC_QUEUE_APPS_EXEC, cmd_ptr);
 		if (ret)
@@ -1229,13 +1281,13 @@ static uint32_t find_networks_perf_mode(struct npu_host_ctx *host_ctx)
 
 	network = host_ctx->networks;
 
-	if (!host_ctx->network_num) {
-		/* if no network exists, set to the lowest level */
+	if (host_ctx->network_num == host_ctx->nw_cache_num) {
+		/* if no network is in use, set to the lowest level */
 		max_perf_mode = 1;
 	} else {
 		/* find the max level among all the networks */
 		for (i = 0; i < MAX_LOADED_NETWORK; i++) {
-			if ((network->id != 0) &&
+			if ((network->id != 0) && !network->is_cached &&
 				(network->cur_perf_mode != 0) &&
 				(network->cur_perf_mode > max_perf_mode))
 				max_perf_mode = network->cur_perf_mode;
@@ -1430,6 +1482,233 @@ get_prop_exit:
 	return ret;
 }
 
+/* -------------------------------------------------------------------------
+ * Function Definitions - Network Cache
+ *
+ * Networks loaded through NPU_IPC_CMD_LOAD only reference their own ACO
+ * buffer, so on unload they can be kept loaded in fw instead, keyed by a
+ * hash of the buffer content. A later load of the same content by the same
+ * user is handed the cached network without another LOAD round trip, also
+ * across client sessions. Cached networks keep their fw reference and are
+ * unloaded once idle for nw_cache_idle_ms or when nw_cache_budget is
+ * exceeded. When the owning client unmaps the ACO buffer of a cached
+ * network, the cache takes over the mapping as fw still references it.
+ * -------------------------------------------------------------------------
+ */
+static void nw_cache_evict(struct npu_host_ctx *host_ctx,
+	struct npu_network *network)
+{
+	struct npu_device *npu_dev = host_ctx->npu_dev;
+	struct ipc_cmd_unload_pkt unload_packet;
+	int ret;
+
+	WARN_ON(!mutex_is_locked(&host_ctx->lock));
+
+	network->is_cached = false;
+	host_ctx->nw_cache_num--;
+	host_ctx->nw_cache_size -= network->size;
+	host_ctx->nw_cache_evictions++;
+	network_get(network);
+
+	pr_debug("Evict cached network %lld\n", network->id);
+	if (!network->fw_error) {
+		unload_packet.header.cmd_type = NPU_IPC_CMD_UNLOAD;
+		unload_packet.header.size = sizeof(struct ipc_cmd_unload_pkt);
+		unload_packet.header.trans_id =
+			atomic_add_return(1, &host_ctx->ipc_trans_id);
+		unload_packet.header.flags = 0;
+		unload_packet.network_hdl = (uint32_t)network->network_hdl;
+
+		reinit_completion(&network->cmd_done);
+		ret = npu_send_network_cmd(npu_dev, network, &unload_packet,
+			false);
+		if (!ret) {
+			mutex_unlock(&host_ctx->lock);
+			ret = wait_for_completion_timeout(&network->cmd_done,
+				NW_CMD_TIMEOUT);
+			mutex_lock(&host_ctx->lock);
+			if (!ret) {
+				pr_err_ratelimited("npu: cached network unload time out\n");
+				network->cmd_pending = false;
+			}
+		}
+	}
+
+	network_put(network);
+	free_network(host_ctx, NULL, network->id);
+
+	if (npu_dev->pwrctrl.cur_dcvs_activity)
+		set_perf_mode(npu_dev);
+
+	/* drop the fw reference held by the cached network */
+	atomic_inc(&host_ctx->fw_deinit_work_cnt);
+	queue_delayed_work(host_ctx->wq, &host_ctx->fw_deinit_work,
+		msecs_to_jiffies(host_ctx->fw_unload_delay_ms));
+}
+
+static struct npu_network *nw_cache_lru(struct npu_host_ctx *host_ctx)
+{
+	struct npu_network *network, *lru = NULL;
+	int i;
+
+	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
+		network = &host_ctx->networks[i];
+		if (!network->is_valid || !network->is_cached)
+			continue;
+
+		if (!lru || time_before(network->cache_ts, lru->cache_ts))
+			lru = network;
+	}
+
+	return lru;
+}
+
+static struct npu_network *nw_cache_find_victim(struct npu_host_ctx *host_ctx,
+	unsigned long *next_expiry)
+{
+	struct npu_network *network;
+	unsigned long idle = msecs_to_jiffies(host_ctx->nw_cache_idle_ms);
+	int i;
+
+	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
+		network = &host_ctx->networks[i];
+		if (!network->is_valid || !network->is_cached)
+			continue;
+
+		if (network->fw_error ||
+			time_after_eq(jiffies, network->cache_ts + idle))
+			return network;
+	}
+
+	network = nw_cache_lru(host_ctx);
+	if (network && (host_ctx->nw_cache_size > host_ctx->nw_cache_budget))
+		return network;
+
+	if (network)
+		*next_expiry = network->cache_ts + idle;
+
+	return NULL;
+}
+
+static void nw_cache_wq(struct work_struct *work)
+{
+	struct npu_host_ctx *host_ctx;
+	struct npu_network *network;
+	unsigned long next_expiry = jiffies;
+
+	host_ctx = container_of(work, struct npu_host_ctx,
+		nw_cache_work.work);
+
+	mutex_lock(&host_ctx->lock);
+	while ((network = nw_cache_find_victim(host_ctx, &next_expiry)))
+		nw_cache_evict(host_ctx, network);
+
+	if (host_ctx->nw_cache_num)
+		queue_delayed_work(system_wq, &host_ctx->nw_cache_work,
+			time_after(next_expiry, jiffies) ?
+			next_expiry - jiffies : 0);
+	mutex_unlock(&host_ctx->lock);
+}
+
+static bool nw_cache_park(struct npu_host_ctx *host_ctx,
+	struct npu_network *network)
+{
+	WARN_ON(!mutex_is_locked(&host_ctx->lock));
+
+	if (!network->cacheable || !host_ctx->nw_cache_budget ||
+		(network->size > host_ctx->nw_cache_budget) ||
+		network->fw_error || host_ctx->fw_error ||
+		network->cmd_pending)
+		return false;
+
+	/* fw keeps referencing the ACO buffer, it has to stay mapped */
+	if (!network->cache_buf &&
+		!npu_mem_verify_addr(network->buf_client, network->phy_add))
+		return false;
+
+	pr_debug("Cache network %lld\n", network->id);
+	network->is_cached = true;
+	network->client = NULL;
+	network->cache_ts = jiffies;
+	host_ctx->nw_cache_num++;
+	host_ctx->nw_cache_size += network->size;
+
+	if (host_ctx->nw_cache_size > host_ctx->nw_cache_budget)
+		mod_delayed_work(system_wq, &host_ctx->nw_cache_work, 0);
+	else
+		queue_delayed_work(system_wq, &host_ctx->nw_cache_work,
+			msecs_to_jiffies(host_ctx->nw_cache_idle_ms));
+
+	return true;
+}
+
+static struct npu_network *nw_cache_lookup(struct npu_host_ctx *host_ctx,
+	uint64_t content_hash, struct msm_npu_load_network_ioctl *load_ioctl)
+{
+	struct npu_network *network;
+	int i;
+
+	WARN_ON(!mutex_is_locked(&host_ctx->lock));
+
+	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
+		network = &host_ctx->networks[i];
+		if (network->is_valid && network->is_cached &&
+			!network->fw_error &&
+			(network->content_hash == content_hash) &&
+			(network->size == load_ioctl->buf_size) &&
+			(network->first_block_size ==
+				load_ioctl->first_block_size) &&
+			uid_eq(network->owner_uid, current_euid()))
+			return network;
+	}
+
+	return NULL;
+}
+
+/* find the cacheable network backed by a client buffer, if any */
+static struct npu_network *nw_cache_find_buf(struct npu_host_ctx *host_ctx,
+	struct npu_client *client, uint64_t addr)
+{
+	struct npu_network *network;
+	int i;
+
+	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
+		network = &host_ctx->networks[i];
+		if (network->is_valid && network->cacheable &&
+			(network->buf_client == client) &&
+			(network->phy_add == addr))
+			return network;
+	}
+
+	return NULL;
+}
+
+static bool nw_cache_adopt_buf(struct npu_host_ctx *host_ctx,
+	struct npu_client *client, int buf_hdl, uint64_t addr)
+{
+	struct npu_network *network;
+
+	WARN_ON(!mutex_is_locked(&host_ctx->lock));
+
+	network = nw_cache_find_buf(host_ctx, client, addr);
+	if (!network)
+		return false;
+
+	/* still in use by the client giving the buffer up */
+	if (!network->is_cached && (network->client == client))
+		return false;
+
+	network->cache_buf = npu_mem_detach_buf(client, buf_hdl);
+	if (!network->cache_buf)
+		return false;
+
+	pr_debug("Cache takes over ACO buffer of network %lld\n",
+		network->id);
+	network->buf_client = NULL;
+
+	return true;
+}
+
 int32_t npu_host_load_network(struct npu_client *client,
 			struct msm_npu_load_network_ioctl *load_ioctl)
 {
@@ -1439,12 +1718,54 @@ int32_t npu_host_load_network(struct npu_client *client,
 	struct npu_network *network;
 	struct ipc_cmd_load_pkt load_packet;
 	struct npu_host_ctx *host_ctx = &npu_dev->host_ctx;
+	uint64_t content_hash = 0;
+	bool hashed, cacheable = false;
 
 	ret = fw_init(npu_dev);
 	if (ret)
 		return ret;
 
+	hashed = host_ctx->nw_cache_budget &&
+		!npu_mem_hash_buf(client, load_ioctl->buf_phys_addr,
+			load_ioctl->buf_size, &content_hash);
+
 	mutex_lock(&host_ctx->lock);
+	if (hashed && host_ctx->nw_cache_budget) {
+		network = nw_cache_lookup(host_ctx, content_hash, load_ioctl);
+		if (network) {
+			pr_debug("Network cache hit %lld\n", network->id);
+			network->is_cached = false;
+			host_ctx->nw_cache_num--;
+			host_ctx->nw_cache_size -= network->size;
+			host_ctx->nw_cache_hits++;
+			network->client = client;
+			network->priority = load_ioctl->priority;
+			network->cur_perf_mode = network->init_perf_mode =
+				(load_ioctl->perf_mode == PERF_MODE_DEFAULT) ?
+					pwr->num_pwrlevels :
+					load_ioctl->perf_mode;
+			load_ioctl->network_hdl = network->network_hdl;
+			set_perf_mode(npu_dev);
+			mutex_unlock(&host_ctx->lock);
+
+			/* the cached network already holds a fw reference */
+			fw_deinit(npu_dev, false, true);
+			return 0;
+		}
+
+		host_ctx->nw_cache_misses++;
+		/* one cached network per ACO buffer */
+		cacheable = !nw_cache_find_buf(host_ctx, client,
+			load_ioctl->buf_phys_addr);
+	}
+
+	/* make room by dropping the least recently used cached network */
+	if (host_ctx->network_num >= MAX_LOADED_NETWORK) {
+		network = nw_cache_lru(host_ctx);
+		if (network)
+			nw_cache_evict(host_ctx, network);
+	}
+
 	network = alloc_network(host_ctx, client);
 	if (!network) {
 		ret = -ENOMEM;
@@ -1516,6 +1837,10 @@ int32_t npu_host_load_network(struct npu_client *client,
 
 	load_ioctl->network_hdl = network->network_hdl;
 	network->is_active = true;
+	network->cacheable = cacheable;
+	network->content_hash = content_hash;
+	network->owner_uid = current_euid();
+	network->buf_client = client;
 	network_put(network);
 
 	mutex_unlock(&host_ctx->lock);
@@ -1680,11 +2005,29 @@ int32_t npu_host_unload_network(struct npu_client *client,
 		return -EINVAL;
 	}
 
+	/* drop queued executions, a running one has to finish first */
+	exec_queue_flush(host_ctx, network, -ECANCELED, network->fw_error);
+	if (network->exec_req) {
+		pr_err("Network is running, retry later\n");
+		network_put(network);
+		mutex_unlock(&host_ctx->lock);
+		return -EBUSY;
+	}
+
 	if (network->fw_error) {
 		pr_err("fw in error state, skip unload network in fw\n");
 		goto free_network;
 	}
 
+	/* keep the network loaded in fw for a later load of it */
+	if (nw_cache_park(host_ctx, network)) {
+		network_put(network);
+		if (npu_dev->pwrctrl.cur_dcvs_activity)
+			set_perf_mode(npu_dev);
+		mutex_unlock(&host_ctx->lock);
+		return 0;
+	}
+
 	pr_debug("Unload network %lld\n", network->id);
 	/* prepare IPC packet for UNLOAD */
 	unload_packet.header.cmd_type = NPU_IPC_CMD_UNLOAD;
@@ -2056,6 +2399,320 @@ exec_v2_done:
 	return ret;
 }
 
+/* -------------------------------------------------------------------------
+ * Function Definitions - Exec Queue
+ * -------------------------------------------------------------------------
+ */
+static const char *npu_exec_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "npu";
+}
+
+static const char *npu_exec_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "npu_exec";
+}
+
+static bool npu_exec_fence_enable_signaling(struct dma_fence *fence)
+{
+	return true;
+}
+
+static const struct dma_fence_ops npu_exec_fence_ops = {
+	.get_driver_name = npu_exec_fence_get_driver_name,
+	.get_timeline_name = npu_exec_fence_get_timeline_name,
+	.enable_signaling = npu_exec_fence_enable_signaling,
+	.wait = dma_fence_default_wait,
+};
+
+/* signal a request already taken off its queue and drop the queue ref */
+static void exec_req_complete(struct npu_exec_req *req, int status)
+{
+	kfree(req->exec_packet);
+	req->exec_packet = NULL;
+	if (req->in_fence) {
+		dma_fence_put(req->in_fence);
+		req->in_fence = NULL;
+	}
+
+	if (status)
+		dma_fence_set_error(&req->fence, status);
+	dma_fence_signal(&req->fence);
+	dma_fence_put(&req->fence);
+}
+
+static void exec_queue_done(struct npu_host_ctx *host_ctx,
+	struct npu_network *network, int status)
+{
+	struct npu_exec_req *req = network->exec_req;
+
+	pr_debug("exec req done on network %lld status %d\n", network->id,
+		status);
+	network->exec_req = NULL;
+	network->cmd_pending = false;
+	exec_req_complete(req, status);
+
+	if (atomic_dec_return(&host_ctx->network_execute_cnt) == 0)
+		npu_notify_cdsprm_cxlimit_activity(host_ctx->npu_dev, false);
+}
+
+/*
+ * The fw runs one command per network at a time, so the next queued
+ * request is sent from the completion of the previous one instead of
+ * waiting for a round trip through user space.
+ */
+static void exec_queue_kick(struct npu_host_ctx *host_ctx,
+	struct npu_network *network)
+{
+	struct npu_device *npu_dev = host_ctx->npu_dev;
+	struct ipc_cmd_execute_pkt_v2 *exec_packet;
+	struct npu_exec_req *req;
+	int ret;
+
+	WARN_ON(!mutex_is_locked(&host_ctx->lock));
+
+	while (!network->cmd_pending && !list_empty(&network->exec_queue)) {
+		req = list_first_entry(&network->exec_queue,
+			struct npu_exec_req, list);
+		if (req->in_fence && !atomic_read(&req->in_signaled))
+			break;
+
+		list_del_init(&req->list);
+		if (req->in_fence && dma_fence_get_status(req->in_fence) < 0) {
+			pr_debug("in fence failed, skip exec on network %lld\n",
+				network->id);
+			exec_req_complete(req, -ECANCELED);
+			continue;
+		}
+
+		exec_packet = req->exec_packet;
+		exec_packet->header.trans_id =
+			atomic_add_return(1, &host_ctx->ipc_trans_id);
+		/* stats are not reported for queued executions */
+		network->stats_buf_size = 0;
+
+		ret = npu_send_network_cmd(npu_dev, network, exec_packet, true);
+		if (ret) {
+			pr_err("NPU_IPC_CMD_EXECUTE_V2 sent failed: %d\n", ret);
+			exec_req_complete(req, ret);
+			continue;
+		}
+
+		network->exec_req = req;
+		if (atomic_inc_return(&host_ctx->network_execute_cnt) == 1)
+			npu_notify_cdsprm_cxlimit_activity(npu_dev, true);
+	}
+}
+
+static void exec_queue_flush(struct npu_host_ctx *host_ctx,
+	struct npu_network *network, int status, bool in_flight)
+{
+	struct npu_exec_req *req, *tmp;
+
+	WARN_ON(!mutex_is_locked(&host_ctx->lock));
+
+	/* fences of a network must signal in submission order */
+	if (in_flight && network->exec_req)
+		exec_queue_done(host_ctx, network, status);
+
+	list_for_each_entry_safe(req, tmp, &network->exec_queue, list) {
+		list_del_init(&req->list);
+		if (req->in_fence &&
+			dma_fence_remove_callback(req->in_fence, &req->in_cb))
+			dma_fence_put(&req->fence);
+		exec_req_complete(req, status);
+	}
+}
+
+static void exec_queue_drain(struct npu_host_ctx *host_ctx,
+	struct npu_network *network)
+{
+	struct dma_fence *fence = NULL;
+
+	mutex_lock(&host_ctx->lock);
+	if (network->is_valid) {
+		exec_queue_flush(host_ctx, network, -ECANCELED, false);
+		if (network->exec_req)
+			fence = dma_fence_get(&network->exec_req->fence);
+	}
+	mutex_unlock(&host_ctx->lock);
+
+	if (!fence)
+		return;
+
+	if (!dma_fence_wait_timeout(fence, false,
+		(host_ctx->fw_dbg_mode & FW_DBG_MODE_INC_TIMEOUT) ?
+		NW_DEBUG_TIMEOUT : NW_CMD_TIMEOUT))
+		pr_err_ratelimited("npu: queued execution time out\n");
+	dma_fence_put(fence);
+}
+
+static void exec_req_in_fence_cb(struct dma_fence *fence,
+	struct dma_fence_cb *cb)
+{
+	struct npu_exec_req *req = container_of(cb, struct npu_exec_req,
+		in_cb);
+	struct npu_host_ctx *host_ctx = req->host_ctx;
+
+	/* may run in hard irq context, leave sending the cmd to the work */
+	atomic_set(&req->in_signaled, 1);
+	queue_work(host_ctx->wq, &host_ctx->exec_queue_work);
+	dma_fence_put(&req->fence);
+}
+
+static void exec_queue_wq(struct work_struct *work)
+{
+	struct npu_host_ctx *host_ctx;
+	struct npu_network *network;
+	int i;
+
+	host_ctx = container_of(work, struct npu_host_ctx, exec_queue_work);
+
+	mutex_lock(&host_ctx->lock);
+	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
+		network = &host_ctx->networks[i];
+		if (network->is_valid && !list_empty(&network->exec_queue))
+			exec_queue_kick(host_ctx, network);
+	}
+	mutex_unlock(&host_ctx->lock);
+}
+
+int32_t npu_host_submit_exec(struct npu_client *client,
+	struct msm_npu_submit_exec_ioctl *submit_ioctl,
+	struct msm_npu_patch_buf_info *patch_buf_info)
+{
+	struct npu_device *npu_dev = client->npu_dev;
+	struct npu_host_ctx *host_ctx = &npu_dev->host_ctx;
+	struct ipc_cmd_execute_pkt_v2 *exec_packet;
+	struct npu_network *network;
+	struct npu_exec_req *req;
+	struct sync_file *sync_file;
+	uint32_t num_patch_params, pkt_size;
+	int32_t ret;
+	int fd, i;
+
+	num_patch_params = submit_ioctl->patch_buf_info_num;
+	pkt_size = num_patch_params * sizeof(struct npu_patch_params_v2) +
+		sizeof(*exec_packet);
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	exec_packet = kzalloc(pkt_size, GFP_KERNEL);
+	if (!req || !exec_packet) {
+		ret = -ENOMEM;
+		goto free_req;
+	}
+
+	if (submit_ioctl->in_fence_fd >= 0) {
+		req->in_fence = sync_file_get_fence(submit_ioctl->in_fence_fd);
+		if (!req->in_fence) {
+			pr_err("invalid in fence fd %d\n",
+				submit_ioctl->in_fence_fd);
+			ret = -EINVAL;
+			goto free_req;
+		}
+	}
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		ret = fd;
+		goto put_in_fence;
+	}
+
+	mutex_lock(&host_ctx->lock);
+	network = get_network_by_hdl(host_ctx, client,
+		submit_ioctl->network_hdl);
+	if (!network) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	if (!network->is_active) {
+		pr_err("network is not active\n");
+		ret = -EINVAL;
+		goto put_network;
+	}
+
+	if (network->fw_error) {
+		pr_err("fw is in error state\n");
+		ret = -EIO;
+		goto put_network;
+	}
+
+	for (i = 0; i < num_patch_params; i++) {
+		exec_packet->patch_params[i].id = patch_buf_info[i].buf_id;
+		exec_packet->patch_params[i].value =
+			patch_buf_info[i].buf_phys_addr;
+
+		/* verify mapped physical address */
+		if (!npu_mem_verify_addr(client,
+			patch_buf_info[i].buf_phys_addr)) {
+			pr_err("Invalid patch value\n");
+			ret = -EINVAL;
+			goto put_network;
+		}
+	}
+
+	exec_packet->header.cmd_type = NPU_IPC_CMD_EXECUTE_V2;
+	exec_packet->header.size = pkt_size;
+	exec_packet->header.flags = host_ctx->exec_flags_override > 0 ?
+		host_ctx->exec_flags_override : submit_ioctl->flags;
+	exec_packet->network_hdl = network->network_hdl;
+	exec_packet->num_patch_params = num_patch_params;
+
+	spin_lock_init(&req->lock);
+	INIT_LIST_HEAD(&req->list);
+	req->host_ctx = host_ctx;
+	req->exec_packet = exec_packet;
+	/* the initial reference belongs to the queue */
+	dma_fence_init(&req->fence, &npu_exec_fence_ops, &req->lock,
+		network->fence_context, ++network->fence_seqno);
+
+	sync_file = sync_file_create(&req->fence);
+	if (!sync_file) {
+		exec_req_complete(req, -ENOMEM);
+		network_put(network);
+		mutex_unlock(&host_ctx->lock);
+		put_unused_fd(fd);
+		return -ENOMEM;
+	}
+
+	if (req->in_fence) {
+		/* reference dropped by the callback */
+		dma_fence_get(&req->fence);
+		if (dma_fence_add_callback(req->in_fence, &req->in_cb,
+			exec_req_in_fence_cb)) {
+			atomic_set(&req->in_signaled, 1);
+			dma_fence_put(&req->fence);
+		}
+	}
+
+	pr_debug("queue exec on network %lld seqno %d\n", network->id,
+		network->fence_seqno);
+	list_add_tail(&req->list, &network->exec_queue);
+	exec_queue_kick(host_ctx, network);
+
+	network_put(network);
+	mutex_unlock(&host_ctx->lock);
+
+	fd_install(fd, sync_file->file);
+	submit_ioctl->out_fence_fd = fd;
+
+	return 0;
+
+put_network:
+	network_put(network);
+unlock:
+	mutex_unlock(&host_ctx->lock);
+	put_unused_fd(fd);
+put_in_fence:
+	if (req->in_fence)
+		dma_fence_put(req->in_fence);
+free_req:
+	kfree(exec_packet);
+	kfree(req);
+	return ret;
+}
+
 int32_t npu_host_loopback_test(struct npu_device *npu_dev)
 {
 	struct ipc_cmd_loopback_pkt loopback_packet;
@@ -2114,6 +2771,7 @@ void npu_host_cleanup_networks(struct npu_client *client)
 		if (network->client == client) {
 			pr_warn("network %d is not unloaded before close\n",
 				network->network_hdl);
+			exec_queue_drain(host_ctx, network);
 			unload_req.network_hdl = network->network_hdl;
 			npu_host_unload_network(client, &unload_req);
 		}
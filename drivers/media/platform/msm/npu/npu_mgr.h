@@ -18,6 +18,9 @@
  * -------------------------------------------------------------------------
  */
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/uidgid.h>
+#include <linux/dma-fence.h>
 #include "npu_hw_access.h"
 #include "npu_common.h"
 
@@ -32,6 +35,8 @@
 #define FIRMWARE_VERSION 0x00001000
 #define MAX_LOADED_NETWORK 32
 #define NPU_IPC_BUF_LENGTH 512
+#define NW_CACHE_DEFAULT_BUDGET (32 * 1024 * 1024)
+#define NW_CACHE_DEFAULT_IDLE_MS 5000
 
 #define FW_DBG_MODE_PAUSE        (1 << 0)
 #define FW_DBG_MODE_INC_TIMEOUT  (1 << 1)
@@ -41,6 +46,24 @@
  * Data Structures
  * -------------------------------------------------------------------------
  */
+struct npu_ion_buf;
+struct npu_host_ctx;
+
+/*
+ * Execution request queued on a network, the fence must stay first as the
+ * default dma_fence release frees the whole request
+ */
+struct npu_exec_req {
+	struct dma_fence fence;
+	spinlock_t lock;
+	struct list_head list;
+	struct dma_fence *in_fence;
+	struct dma_fence_cb in_cb;
+	atomic_t in_signaled;
+	struct npu_host_ctx *host_ctx;
+	void *exec_packet;
+};
+
 struct npu_network {
 	uint64_t id;
 	int buf_hdl;
@@ -65,6 +88,28 @@ struct npu_network {
 	int cmd_ret_status;
 	struct completion cmd_done;
 	struct npu_client *client;
+
+	/* network cache */
+	bool cacheable;
+	bool is_cached;
+	uint64_t content_hash;
+	kuid_t owner_uid;
+	unsigned long cache_ts;
+	struct npu_client *buf_client;
+	struct npu_ion_buf *cache_buf;
+
+	/* latency stats */
+	ktime_t cmd_start;
+	uint64_t load_time_us;
+	uint32_t exec_cnt;
+	uint64_t exec_time_sum_us;
+	uint64_t exec_time_max_us;
+
+	/* exec queue */
+	struct list_head exec_queue;
+	struct npu_exec_req *exec_req;
+	uint64_t fence_context;
+	uint32_t fence_seqno;
 };
 
 enum fw_state {
@@ -101,6 +146,17 @@ struct npu_host_ctx {
 	uint32_t err_irq_sts;
 	uint32_t wdg_irq_sts;
 	bool fw_error;
+
+	struct delayed_work nw_cache_work;
+	uint32_t nw_cache_budget;
+	uint32_t nw_cache_idle_ms;
+	uint32_t nw_cache_size;
+	int32_t nw_cache_num;
+	uint32_t nw_cache_hits;
+	uint32_t nw_cache_misses;
+	uint32_t nw_cache_evictions;
+
+	struct work_struct exec_queue_work;
 };
 
 struct npu_device;
@@ -139,6 +195,9 @@ int32_t npu_host_exec_network(struct npu_client *client,
 int32_t npu_host_exec_network_v2(struct npu_client *client,
 	struct msm_npu_exec_network_ioctl_v2 *exec_ioctl,
 	struct msm_npu_patch_buf_info *patch_buf_info);
+int32_t npu_host_submit_exec(struct npu_client *client,
+	struct msm_npu_submit_exec_ioctl *submit_ioctl,
+	struct msm_npu_patch_buf_info *patch_buf_info);
 int32_t npu_host_loopback_test(struct npu_device *npu_dev);
 int32_t npu_host_set_fw_property(struct npu_device *npu_dev,
 			struct msm_npu_property *property);
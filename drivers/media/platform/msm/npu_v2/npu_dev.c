@@ -2263,6 +2263,7 @@ static int npu_probe(struct platform_device *pdev)
 	mutex_init(&npu_dev->dev_lock);
 
 	dev_set_drvdata(&pdev->dev, npu_dev);
+	device_enable_async_suspend(&pdev->dev);
 	res = platform_get_resource_byname(pdev,
 		IORESOURCE_MEM, "core");
 	if (!res) {
@@ -1552,9 +1552,11 @@ static void sde_rotator_commit_handler(struct kthread_work *work)
 {
 	struct sde_rot_entry *entry;
 	struct sde_rot_entry_container *request;
-	struct sde_rot_hw_resource *hw;
+	struct sde_rot_hw_resource *hw = NULL;
 	struct sde_rot_mgr *mgr;
+	struct sde_rot_data_type *mdata = sde_rot_get_mdata();
 	struct sched_param param = { .sched_priority = 5 };
+	bool premap;
 	int ret;
 
 	entry = container_of(work, struct sde_rot_entry, commit_work);
@@ -1594,9 +1596,34 @@ static void sde_rotator_commit_handler(struct kthread_work *work)
 
 	sde_rot_mgr_lock(mgr);
 
+	/*
+	 * Map the buffers before waiting for the hw, so the setup of this
+	 * entry overlaps the rotation of the one ahead of it. Secure entries
+	 * may switch the secure session and are mapped once the hw is theirs.
+	 */
+	premap = mgr->pipelined_map && !mdata->sec_cam_en &&
+		!(entry->item.flags &
+			(SDE_ROTATION_SECURE | SDE_ROTATION_SECURE_CAMERA));
+	if (premap) {
+		ret = sde_smmu_ctrl(1);
+		if (ret < 0) {
+			SDEROT_ERR("IOMMU attach failed\n");
+			goto smmu_error;
+		}
+
+		ret = sde_rotator_map_and_check_data(entry);
+		if (ret) {
+			SDEROT_ERR("fail to prepare input/output data %d\n",
+					ret);
+			goto error;
+		}
+	}
+
 	hw = sde_rotator_get_hw_resource(entry->commitq, entry);
 	if (!hw) {
 		SDEROT_ERR("no hw for the queue\n");
+		if (premap)
+			goto error;
 		goto get_hw_res_err;
 	}
 
@@ -1615,18 +1642,21 @@ static void sde_rotator_commit_handler(struct kthread_work *work)
 		entry->item.dst_rect.x, entry->item.dst_rect.y,
 		entry->item.dst_rect.w, entry->item.dst_rect.h);
 
-	ATRACE_INT("sde_smmu_ctrl", 0);
-	ret = sde_smmu_ctrl(1);
-	if (ret < 0) {
-		SDEROT_ERR("IOMMU attach failed\n");
-		goto smmu_error;
-	}
-	ATRACE_INT("sde_smmu_ctrl", 1);
+	if (!premap) {
+		ATRACE_INT("sde_smmu_ctrl", 0);
+		ret = sde_smmu_ctrl(1);
+		if (ret < 0) {
+			SDEROT_ERR("IOMMU attach failed\n");
+			goto smmu_error;
+		}
+		ATRACE_INT("sde_smmu_ctrl", 1);
 
-	ret = sde_rotator_map_and_check_data(entry);
-	if (ret) {
-		SDEROT_ERR("fail to prepare input/output data %d\n", ret);
-		goto error;
+		ret = sde_rotator_map_and_check_data(entry);
+		if (ret) {
+			SDEROT_ERR("fail to prepare input/output data %d\n",
+					ret);
+			goto error;
+		}
 	}
 
 	ret = mgr->ops_config_hw(hw, entry);
@@ -1672,7 +1702,8 @@ kickoff_error:
 error:
 	sde_smmu_ctrl(0);
 smmu_error:
-	sde_rotator_put_hw_resource(entry->commitq, entry, hw);
+	if (hw)
+		sde_rotator_put_hw_resource(entry->commitq, entry, hw);
 get_hw_res_err:
 	sde_rotator_signal_output(entry);
 	sde_rotator_release_entry(mgr, entry);
@@ -3108,6 +3139,7 @@ int sde_rotator_core_init(struct sde_rot_mgr **pmgr,
 	mgr->pending_close_bw_vote = 0;
 	mgr->enable_bw_vote = ROT_ENABLE_BW_VOTE;
 	mgr->hwacquire_timeout = ROT_HW_ACQUIRE_TIMEOUT_IN_MS;
+	mgr->pipelined_map = 1;
 	mgr->queue_count = 1;
 	mgr->pixel_per_clk.numer = ROT_PIXEL_PER_CLK_NUMERATOR;
 	mgr->pixel_per_clk.denom = ROT_PIXEL_PER_CLK_DENOMINATOR;
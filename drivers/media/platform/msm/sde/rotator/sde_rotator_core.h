@@ -399,6 +399,7 @@ struct sde_rot_bus_data_type {
  * @rdot_limit: current read OT limit
  * @wrot_limit: current write OT limit
  * @hwacquire_timeout: maximum wait time for hardware availability in msec
+ * @pipelined_map: map buffers of a commit before waiting for the hardware
  * @pixel_per_clk: rotator hardware performance in pixel for clock
  * @fudge_factor: fudge factor for clock calculation
  * @overhead: software overhead for offline rotation in msec
@@ -447,6 +448,7 @@ struct sde_rot_mgr {
 	u32 wrot_limit;
 
 	u32 hwacquire_timeout;
+	u32 pipelined_map;
 	struct sde_mult_factor pixel_per_clk;
 	struct sde_mult_factor fudge_factor;
 	struct sde_mult_factor overhead;
@@ -941,6 +941,12 @@ static int sde_rotator_core_create_debugfs(
 		return -EINVAL;
 	}
 
+	if (!debugfs_create_u32("pipelined_map", 0644,
+			debugfs_root, &mgr->pipelined_map)) {
+		SDEROT_WARN("failed to create debugfs pipelined map\n");
+		return -EINVAL;
+	}
+
 	if (!debugfs_create_u32("ppc_numer", 0644,
 			debugfs_root, &mgr->pixel_per_clk.numer)) {
 		SDEROT_WARN("failed to create debugfs ppc numerator\n");
@@ -21,6 +21,13 @@
 static bool debug;
 module_param(debug, bool, 0644);
 
+static bool feedback;
+module_param(feedback, bool, 0644);
+
+/* headroom in percent added to the estimate in feedback mode */
+static unsigned int feedback_margin = 10;
+module_param(feedback_margin, uint, 0644);
+
 enum governor_mode {
 	GOVERNOR_DDR,
 	GOVERNOR_LLCC,
@@ -29,6 +36,9 @@ enum governor_mode {
 struct governor {
 	enum governor_mode mode;
 	struct devfreq_governor devfreq_gov;
+	/* last estimate and the vote derived from it, in kbps */
+	unsigned long estimate;
+	unsigned long vote;
 };
 
 /*
@@ -914,6 +924,33 @@ static unsigned long __calculate(struct vidc_bus_vote_data *d,
 }
 
 
+/*
+ * The session inputs follow the content: the compression ratios and
+ * complexity reported by firmware and the measured bitrate change from
+ * frame to frame. In feedback mode a rising estimate is voted at once plus
+ * a margin. A falling estimate lowers the vote by a quarter of the gap on
+ * each update, so a single easy frame does not drop the bus under the
+ * next hard one.
+ */
+static unsigned long __feedback(struct governor *gov, unsigned long ab_kbps)
+{
+	unsigned long target;
+
+	gov->estimate = ab_kbps;
+	if (!feedback) {
+		gov->vote = ab_kbps;
+		return ab_kbps;
+	}
+
+	target = ab_kbps + ab_kbps * feedback_margin / 100;
+	if (target >= gov->vote)
+		gov->vote = target;
+	else
+		gov->vote -= (gov->vote - target) / 4;
+
+	return gov->vote;
+}
+
 static int __get_target_freq(struct devfreq *dev, unsigned long *freq)
 {
 	unsigned long ab_kbps = 0, c = 0;
@@ -929,8 +966,10 @@ static int __get_target_freq(struct devfreq *dev, unsigned long *freq)
 	dev->profile->get_dev_status(dev->dev.parent, &stats);
 	vidc_data = (struct msm_vidc_gov_data *)stats.private_data;
 
-	if (!vidc_data || !vidc_data->data_count)
+	if (!vidc_data || !vidc_data->data_count) {
+		gov->estimate = gov->vote = 0;
 		goto exit;
+	}
 
 	for (c = 0; c < vidc_data->data_count; ++c) {
 		if (vidc_data->data->power_mode == VIDC_POWER_TURBO) {
@@ -942,6 +981,7 @@ static int __get_target_freq(struct devfreq *dev, unsigned long *freq)
 	for (c = 0; c < vidc_data->data_count; ++c)
 		ab_kbps += __calculate(&vidc_data->data[c], gov->mode);
 
+	ab_kbps = __feedback(gov, ab_kbps);
 exit:
 	*freq = clamp(ab_kbps, dev->min_freq, dev->max_freq ?: UINT_MAX);
 	trace_msm_vidc_perf_bus_vote(gov->devfreq_gov.name, *freq);
@@ -986,6 +1026,14 @@ static struct governor governors[] = {
 	},
 };
 
+module_param_named(ddr_estimate_kbps, governors[GOVERNOR_DDR].estimate,
+		ulong, 0444);
+module_param_named(ddr_vote_kbps, governors[GOVERNOR_DDR].vote, ulong, 0444);
+module_param_named(llcc_estimate_kbps, governors[GOVERNOR_LLCC].estimate,
+		ulong, 0444);
+module_param_named(llcc_vote_kbps, governors[GOVERNOR_LLCC].vote, ulong,
+		0444);
+
 static int __init msm_vidc_bw_gov_init(void)
 {
 	int c = 0, rc = 0;
@@ -53,6 +53,7 @@
 #include <linux/compat.h>
 #include "compat_qseecom.h"
 #include <linux/kthread.h>
+#include <linux/seq_file.h>
 
 #define QSEECOM_DEV			"qseecom"
 #define QSEOS_VERSION_14		0x14
@@ -98,6 +99,9 @@
 
 #define PHY_ADDR_4G	(1ULL<<32)
 
+/* log2 microsecond buckets of the per-TA latency histograms */
+#define QSEECOM_LAT_BUCKETS	20
+
 #define QSEECOM_STATE_NOT_READY         0
 #define QSEECOM_STATE_SUSPEND           1
 #define QSEECOM_STATE_READY             2
@@ -241,6 +245,9 @@ struct qseecom_registered_app_list {
 	bool app_blocked;
 	u32  check_block;
 	u32  blocked_on_listener_id;
+	u64  calls;
+	u32  wait_hist[QSEECOM_LAT_BUCKETS];
+	u32  call_hist[QSEECOM_LAT_BUCKETS];
 };
 
 struct qseecom_registered_kclient_list {
@@ -334,6 +341,8 @@ struct qseecom_control {
 	struct task_struct *unload_app_kthread_task;
 	wait_queue_head_t unload_app_kthread_wq;
 	atomic_t unload_app_kthread_state;
+
+	struct dentry *debugfs_root;
 };
 
 struct qseecom_unload_app_pending_list {
@@ -367,6 +376,7 @@ struct qseecom_client_handle {
 	struct qseecom_sec_buf_fd_info sec_buf_fd[MAX_ION_FD];
 	bool from_smcinvoke;
 	bool unload_pending;
+	u64  queued_ns;
 };
 
 struct qseecom_listener_handle {
@@ -455,6 +465,51 @@ static int get_qseecom_keymaster_status(char *str)
 __setup("androidboot.keymaster=", get_qseecom_keymaster_status);
 
 
+/*
+ * Send command requests of TAs whose names start with one of prio_apps,
+ * the biometric and authentication ones by default, take app_access_lock
+ * ahead of the others: the others wait while any of them is queued. QSEE
+ * still runs one call at a time, the priority only decides who goes next.
+ */
+static char prio_apps[128] = "gatekeep,fpc,goodix,fingerpr,egis";
+module_param_string(prio_apps, prio_apps, sizeof(prio_apps), 0644);
+
+static atomic_t qseecom_prio_queued = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(qseecom_prio_wq);
+
+static bool __qseecom_app_is_prio(const char *app_name)
+{
+	const char *p = prio_apps, *end;
+
+	while (*p) {
+		end = strchrnul(p, ',');
+		if (end > p && !strncmp(app_name, p, end - p))
+			return true;
+		p = *end ? end + 1 : end;
+	}
+	return false;
+}
+
+static void __qseecom_app_lock(struct qseecom_dev_handle *data)
+{
+	data->client.queued_ns = ktime_get_ns();
+	if (__qseecom_app_is_prio(data->client.app_name)) {
+		atomic_inc(&qseecom_prio_queued);
+		mutex_lock(&app_access_lock);
+		if (atomic_dec_and_test(&qseecom_prio_queued))
+			wake_up_all(&qseecom_prio_wq);
+	} else {
+		wait_event(qseecom_prio_wq,
+			!atomic_read(&qseecom_prio_queued));
+		mutex_lock(&app_access_lock);
+	}
+}
+
+static void __qseecom_lat_add(u32 *hist, u64 ns)
+{
+	hist[min_t(u32, fls64(ns / NSEC_PER_USEC), QSEECOM_LAT_BUCKETS - 1)]++;
+}
+
 #define QSEECOM_SCM_EBUSY_WAIT_MS 30
 #define QSEECOM_SCM_EBUSY_MAX_RETRY 67
 
@@ -3588,6 +3643,7 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 	void *cmd_buf = NULL;
 	size_t cmd_len;
 	struct sglist_info *table = data->sglistinfo_ptr;
+	u64 start;
 
 	reqd_len_sb_in = req->cmd_req_len + req->resp_len;
 	/* find app_id & img_name from list */
@@ -3675,6 +3731,13 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 		}
 	}
 
+	start = ktime_get_ns();
+	if (data->client.queued_ns) {
+		__qseecom_lat_add(ptr_app->wait_hist,
+				start - data->client.queued_ns);
+		data->client.queued_ns = 0;
+	}
+
 	__qseecom_reentrancy_check_if_this_app_blocked(ptr_app);
 
 	ret = qseecom_scm_call(SCM_SVC_TZSCHEDULER, 1,
@@ -3716,6 +3779,8 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 		}
 	}
 exit:
+	ptr_app->calls++;
+	__qseecom_lat_add(ptr_app->call_hist, ktime_get_ns() - start);
 	return ret;
 }
 
@@ -5140,7 +5205,7 @@ int qseecom_send_command(struct qseecom_handle *handle, void *send_buf,
 	if (__validate_send_cmd_inputs(data, &req))
 		return -EINVAL;
 
-	mutex_lock(&app_access_lock);
+	__qseecom_app_lock(data);
 	if (qseecom.support_bus_scaling) {
 		ret = qseecom_scale_bus_bandwidth_timer(INACTIVE);
 		if (ret) {
@@ -7533,7 +7598,7 @@ static long qseecom_ioctl(struct file *file,
 			break;
 		}
 		/* Only one client allowed here at a time */
-		mutex_lock(&app_access_lock);
+		__qseecom_app_lock(data);
 		if (qseecom.support_bus_scaling) {
 			/* register bus bw in case the client doesn't do it */
 			if (!data->mode) {
@@ -7595,7 +7660,7 @@ static long qseecom_ioctl(struct file *file,
 			break;
 		}
 		/* Only one client allowed here at a time */
-		mutex_lock(&app_access_lock);
+		__qseecom_app_lock(data);
 		if (qseecom.support_bus_scaling) {
 			if (!data->mode) {
 				mutex_lock(&qsee_bw_mutex);
@@ -9045,6 +9110,48 @@ static int qseecom_check_whitelist_feature(void)
 	return version >= MAKE_WHITELIST_VERSION(1, 0, 0);
 }
 
+static void qseecom_show_hist(struct seq_file *s, const char *name,
+				const u32 *hist)
+{
+	int i;
+
+	seq_printf(s, "  %s:", name);
+	for (i = 0; i < QSEECOM_LAT_BUCKETS; i++)
+		seq_printf(s, " %u", hist[i]);
+	seq_putc(s, '\n');
+}
+
+/* Per-TA send command counts and wait/call latency, log2 us buckets */
+static int qseecom_app_latency_show(struct seq_file *s, void *unused)
+{
+	struct qseecom_registered_app_list *entry;
+	unsigned long flags;
+
+	spin_lock_irqsave(&qseecom.registered_app_list_lock, flags);
+	list_for_each_entry(entry, &qseecom.registered_app_list_head, list) {
+		seq_printf(s, "%s id=%u prio=%d calls=%llu\n",
+			entry->app_name, entry->app_id,
+			__qseecom_app_is_prio(entry->app_name), entry->calls);
+		qseecom_show_hist(s, "wait", entry->wait_hist);
+		qseecom_show_hist(s, "call", entry->call_hist);
+	}
+	spin_unlock_irqrestore(&qseecom.registered_app_list_lock, flags);
+
+	return 0;
+}
+
+static int qseecom_app_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qseecom_app_latency_show, NULL);
+}
+
+static const struct file_operations qseecom_app_latency_fops = {
+	.open		= qseecom_app_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int qseecom_probe(struct platform_device *pdev)
 {
 	int rc;
@@ -9351,6 +9458,10 @@ static int qseecom_probe(struct platform_device *pdev)
 	if (!qseecom.qsee_perf_client)
 		pr_err("Unable to register bus client\n");
 
+	qseecom.debugfs_root = debugfs_create_dir("qseecom", NULL);
+	debugfs_create_file("app_latency", 0400, qseecom.debugfs_root, NULL,
+			&qseecom_app_latency_fops);
+
 	atomic_set(&qseecom.qseecom_state, QSEECOM_STATE_READY);
 	return 0;
 
@@ -9467,6 +9578,8 @@ static int qseecom_remove(struct platform_device *pdev)
 			__qseecom_deinit_clk(CLK_CE_DRV);
 	}
 
+	debugfs_remove_recursive(qseecom.debugfs_root);
+
 	kthread_stop(qseecom.unload_app_kthread_task);
 
 	kthread_stop(qseecom.unregister_lsnr_kthread_task);
@@ -150,6 +150,18 @@ static DEFINE_MUTEX(open_lock);
 module_param(perdev_minors, int, 0444);
 MODULE_PARM_DESC(perdev_minors, "Minors numbers to allocate per device");
 
+/*
+ * Small reads that recently completed within this many microseconds are
+ * polled for by the issuing cmdq thread instead of waiting for the
+ * completion interrupt and softirq.
+ */
+static unsigned int cmdq_poll_thresh_us = 200;
+module_param(cmdq_poll_thresh_us, uint, 0644);
+MODULE_PARM_DESC(cmdq_poll_thresh_us, "Poll for cmdq reads expected to complete within this many us, 0=off");
+
+/* Only reads up to this size are sampled and polled for */
+#define MMC_CMDQ_POLL_MAX_SECTORS	32
+
 static inline int mmc_blk_part_switch(struct mmc_card *card,
 				      unsigned int part_type);
 static int mmc_blk_cmdq_switch(struct mmc_card *card,
@@ -1769,7 +1781,10 @@ static void mmc_blk_issue_drv_op(struct mmc_queue *mq, struct request *req)
 		break;
 	}
 	mq_rq->drv_op_result = ret;
-	blk_end_request_all(req, ret ? BLK_STS_IOERR : BLK_STS_OK);
+	if (req->q->mq_ops)
+		blk_mq_end_request(req, ret ? BLK_STS_IOERR : BLK_STS_OK);
+	else
+		blk_end_request_all(req, ret ? BLK_STS_IOERR : BLK_STS_OK);
 }
 
 static void mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
@@ -2437,7 +2452,7 @@ static int mmc_blk_cmdq_issue_discard_rq(struct mmc_queue *mq,
 
 	if (!mmc_can_erase(card)) {
 		err = -EOPNOTSUPP;
-		blk_end_request(req, err, blk_rq_bytes(req));
+		blk_mq_end_request(req, BLK_STS_NOTSUPP);
 		goto out;
 	}
 
@@ -2468,7 +2483,7 @@ static int mmc_blk_cmdq_issue_discard_rq(struct mmc_queue *mq,
 clear_dcmd:
 	if (err != -EAGAIN) {
 		mmc_host_clk_hold(card->host);
-		blk_complete_request(req);
+		blk_mq_complete_request(req);
 	} else {
 		pr_err("%s: err(%d) handled by cmdq-error handler\n",
 			__func__, err);
@@ -2488,7 +2503,7 @@ static int mmc_blk_cmdq_issue_secdiscard_rq(struct mmc_queue *mq,
 
 	if (!(mmc_can_secure_erase_trim(card))) {
 		err = -EOPNOTSUPP;
-		blk_end_request(req, err, blk_rq_bytes(req));
+		blk_mq_end_request(req, BLK_STS_NOTSUPP);
 		goto out;
 	}
 
@@ -2536,7 +2551,7 @@ static int mmc_blk_cmdq_issue_secdiscard_rq(struct mmc_queue *mq,
 clear_dcmd:
 	if (err != -EAGAIN) {
 		mmc_host_clk_hold(card->host);
-		blk_complete_request(req);
+		blk_mq_complete_request(req);
 	} else {
 		pr_err("%s: err(%d) handled by cmdq-error handler\n",
 			__func__, err);
@@ -2642,11 +2657,46 @@ static struct mmc_cmdq_req *mmc_blk_cmdq_rw_prep(
 static void mmc_blk_cmdq_requeue_rw_rq(struct mmc_queue *mq,
 				struct request *req)
 {
-	struct request_queue *q = req->q;
+	blk_mq_requeue_request(req, true);
+}
+
+static bool mmc_blk_cmdq_poll_candidate(struct mmc_queue *mq,
+					struct request *req)
+{
+	return READ_ONCE(cmdq_poll_thresh_us) &&
+		mq->card->host->cmdq_ops->poll &&
+		rq_data_dir(req) == READ &&
+		blk_rq_sectors(req) <= MMC_CMDQ_POLL_MAX_SECTORS;
+}
+
+/* Called at hardware completion of a request sampled at issue */
+static void mmc_blk_cmdq_poll_account(struct mmc_queue *mq,
+				      struct mmc_queue_req *mq_rq)
+{
+	u64 lat = ktime_get_ns() - mq_rq->poll_issue_ns;
+	u64 avg = READ_ONCE(mq->poll_lat_ns);
+
+	mq_rq->poll_issue_ns = 0;
+	/* 1/8 weight for the new sample, like the blk-mq poll estimate */
+	avg = avg ? avg - (avg >> 3) + (lat >> 3) : lat;
+	WRITE_ONCE(mq->poll_lat_ns, avg);
+}
+
+/*
+ * Spin for the request just issued on @tag if small reads have recently
+ * been completing within cmdq_poll_thresh_us. The budget is twice the
+ * average, so that a slow request falls back to the interrupt quickly.
+ */
+static void mmc_blk_cmdq_poll(struct mmc_queue *mq, unsigned int tag)
+{
+	struct mmc_host *host = mq->card->host;
+	u64 thresh = (u64)READ_ONCE(cmdq_poll_thresh_us) * NSEC_PER_USEC;
+	u64 avg = READ_ONCE(mq->poll_lat_ns);
+
+	if (!avg || avg > thresh)
+		return;
 
-	spin_lock_irq(q->queue_lock);
-	blk_requeue_request(q, req);
-	spin_unlock_irq(q->queue_lock);
+	host->cmdq_ops->poll(host, tag, min(2 * avg, thresh));
 }
 
 static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
@@ -2657,6 +2707,8 @@ static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 	struct mmc_cmdq_context_info *ctx = &host->cmdq_ctx;
 	struct mmc_cmdq_req *mc_rq;
 	u8 active_small_sector_read = 0;
+	unsigned int tag = req->tag;
+	bool poll;
 	int ret = 0;
 
 	mmc_cmdq_up_rwsem(host);
@@ -2682,9 +2734,16 @@ static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		    && (rq_data_dir(req) == READ))
 			active_small_sector_read = 1;
 	}
+
+	/* req may be completed and gone by the time start_req returns */
+	poll = mmc_blk_cmdq_poll_candidate(mq, req);
+	active_mqrq->poll_issue_ns = poll ? ktime_get_ns() : 0;
+
 	ret = mmc_blk_cmdq_start_req(card->host, mc_rq);
 	if (!ret && active_small_sector_read)
 		host->cmdq_ctx.active_small_sector_read_reqs++;
+	if (!ret && poll)
+		mmc_blk_cmdq_poll(mq, tag);
 	/*
 	 * When in SVS2 on low load scenario and there are lots of requests
 	 * queued for CMDQ we need to wait till the queue is empty to scale
@@ -2713,6 +2772,7 @@ static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 	}
 
 	if (ret) {
+		active_mqrq->poll_issue_ns = 0;
 		/* clear pending request */
 		WARN_ON(!test_and_clear_bit(req->tag,
 				&host->cmdq_ctx.data_active_reqs));
@@ -2808,11 +2868,12 @@ out:
 static struct mmc_cmdq_req *get_cmdq_req_by_tag(struct request_queue *q,
 						int tag)
 {
+	struct mmc_queue *mq = q->queuedata;
 	struct request *req;
 	struct mmc_queue_req *mq_rq;
 	struct mmc_cmdq_req *cmdq_req = NULL;
 
-	req = blk_queue_find_tag(q, tag);
+	req = blk_mq_tag_to_rq(mq->tag_set.tags[0], tag);
 	if (WARN_ON(!req))
 		goto out;
 	mq_rq = req->special;
@@ -2823,6 +2884,13 @@ out:
 	return cmdq_req;
 }
 
+static void mmc_blk_cmdq_requeue_busy(struct request *req, void *data,
+				      bool reserved)
+{
+	if (blk_mq_request_started(req))
+		blk_mq_requeue_request(req, false);
+}
+
 /**
  * mmc_blk_cmdq_reset_all - Reset everything for CMDQ block request.
  * @host:	mmc_host pointer.
@@ -2839,6 +2907,7 @@ static void mmc_blk_cmdq_reset_all(struct mmc_host *host, int err)
 	struct mmc_card *card = host->card;
 	struct mmc_cmdq_context_info *ctx_info = &host->cmdq_ctx;
 	struct request_queue *q;
+	struct mmc_queue *mq;
 	int itag = 0;
 	struct mmc_cmdq_req *cmdq_req = NULL;
 	struct mmc_request *dcmd_mrq;
@@ -2890,9 +2959,10 @@ static void mmc_blk_cmdq_reset_all(struct mmc_host *host, int err)
 		mmc_put_card(card);
 	}
 
-	spin_lock_irq(q->queue_lock);
-	blk_queue_invalidate_tags(q);
-	spin_unlock_irq(q->queue_lock);
+	/* requeue every started request, including any still being issued */
+	mq = q->queuedata;
+	blk_mq_tagset_busy_iter(&mq->tag_set, mmc_blk_cmdq_requeue_busy, NULL);
+	blk_mq_kick_requeue_list(q);
 }
 
 static void mmc_blk_cmdq_shutdown(struct mmc_queue *mq)
@@ -3075,7 +3145,6 @@ reset:
 		mmc_hostname(host), __func__, host->claim_cnt, host->claimed,
 		host->claimer->comm);
 #endif
-	sched_show_task(mq->thread);
 	if (host->claimed && host->claimer)
 		sched_show_task(host->claimer);
 #ifdef CONFIG_MMC_CLKGATE
@@ -3146,22 +3215,27 @@ void mmc_blk_cmdq_complete_rq(struct request *rq)
 		mmc_cmdq_post_req(host, cmdq_req->tag, err);
 	if (cmdq_req->cmdq_req_flags & DCMD) {
 		clear_bit(CMDQ_STATE_DCMD_ACTIVE, &ctx_info->curr_state);
-		blk_end_request_all(rq, err);
+		blk_mq_end_request(rq, errno_to_blk_status(err));
 		goto out;
 	}
 	/*
 	 * In case of error, cmdq_req->data.bytes_xfered is set to 0.
-	 * If we call blk_end_request() with nr_bytes as 0 then the request
-	 * never gets completed. So in case of error, to complete a request
-	 * with error we should use blk_end_request_all().
+	 * If we call blk_update_request() with nr_bytes as 0 then the
+	 * request never gets completed. So in case of error, to complete
+	 * a request with error we should use blk_mq_end_request().
 	 */
 	if (err && cmdq_req->skip_err_handling) {
 		cmdq_req->skip_err_handling = false;
-		blk_end_request_all(rq, err);
+		blk_mq_end_request(rq, errno_to_blk_status(err));
 		goto out;
 	}
 
-	blk_end_request(rq, err, cmdq_req->data.bytes_xfered);
+	/* a partial transfer gets the remainder issued again */
+	if (blk_update_request(rq, errno_to_blk_status(err),
+			       cmdq_req->data.bytes_xfered))
+		blk_mq_requeue_request(rq, true);
+	else
+		__blk_mq_end_request(rq, errno_to_blk_status(err));
 
 out:
 
@@ -3176,7 +3250,7 @@ out:
 	if (!ctx_info->active_reqs)
 		wake_up_interruptible(&host->cmdq_ctx.queue_empty_wq);
 
-	if (blk_queue_stopped(mq->queue) && !ctx_info->active_reqs)
+	if (blk_queue_dying(mq->queue) && !ctx_info->active_reqs)
 		complete(&mq->cmdq_shutdown_complete);
 
 	if (err_rwsem)
@@ -3191,8 +3265,12 @@ out:
 void mmc_blk_cmdq_req_done(struct mmc_request *mrq)
 {
 	struct request *req = mrq->req;
+	struct mmc_queue_req *mq_rq = req_to_mmc_queue_req(req);
+
+	if (mq_rq->poll_issue_ns)
+		mmc_blk_cmdq_poll_account(req->q->queuedata, mq_rq);
 
-	blk_complete_request(req);
+	blk_mq_complete_request(req);
 }
 EXPORT_SYMBOL(mmc_blk_cmdq_req_done);
 
@@ -3528,7 +3606,7 @@ static int mmc_blk_cmdq_issue_drv_op(struct mmc_card *card,
 	if (ret) {
 		pr_err("%s: failed to halt on empty queue\n",
 						mmc_hostname(card->host));
-		blk_end_request_all(req, ret);
+		blk_mq_end_request(req, errno_to_blk_status(ret));
 		mmc_put_card(card);
 		return ret;
 	}
@@ -3642,7 +3720,7 @@ static int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
 
 out:
 	if (req)
-		blk_end_request_all(req, ret);
+		blk_mq_end_request(req, errno_to_blk_status(ret));
 	mmc_put_card(card);
 
 	return ret;
@@ -33,6 +33,7 @@
 #include <linux/pm.h>
 #include <linux/jiffies.h>
 #include <linux/sched/debug.h>
+#include <linux/blk-mq.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -146,7 +147,8 @@ int mmc_cmdq_down_rwsem(struct mmc_host *host, struct request *rq)
 	struct mmc_cmdq_context_info *ctx = &host->cmdq_ctx;
 
 	down_read(&ctx->err_rwsem);
-	if (rq && !(rq->rq_flags & RQF_QUEUED))
+	/* requeued by the error handler while the lock was dropped */
+	if (rq && !blk_mq_request_started(rq))
 		return -EINVAL;
 	else
 		return 0;
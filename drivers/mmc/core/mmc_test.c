@@ -12,6 +12,7 @@
 #include <linux/mmc/host.h>
 #include <linux/mmc/mmc.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
 
 #include <linux/scatterlist.h>
 #include <linux/swap.h>		/* For nr_free_buffer_pages() */
@@ -44,6 +45,18 @@
  */
 #define TEST_AREA_MAX_SIZE (128 * 1024 * 1024)
 
+/*
+ * Latency histogram for the 4K random I/O tests. Each power of two of
+ * nanoseconds is split in TEST_LAT_SUB buckets, so a percentile is reported
+ * within 12.5% of its true value.
+ */
+#define TEST_LAT_SUB_SHIFT	3
+#define TEST_LAT_SUB		(1 << TEST_LAT_SUB_SHIFT)
+#define TEST_LAT_BUCKETS	(64 * TEST_LAT_SUB)
+
+/* Length of each 4K random I/O test, in seconds */
+#define TEST_RND_4K_SECS	10
+
 /**
  * struct mmc_test_pages - pages allocated by 'alloc_pages()'.
  * @page: first page in the allocation
@@ -1993,6 +2006,263 @@ static int mmc_test_random_write_perf(struct mmc_test_card *test)
 	return mmc_test_random_perf(test, 1);
 }
 
+/**
+ * struct mmc_test_lat - latency histogram of one kind of request.
+ * @name: printed with the percentiles
+ * @cnt: number of requests
+ * @max: longest request in ns
+ * @hist: number of requests by latency bucket
+ */
+struct mmc_test_lat {
+	const char *name;
+	unsigned int cnt;
+	u64 max;
+	unsigned int hist[TEST_LAT_BUCKETS];
+};
+
+static void mmc_test_lat_add(struct mmc_test_lat *lat, u64 ns)
+{
+	unsigned int b, shift;
+
+	if (ns < TEST_LAT_SUB) {
+		b = ns;
+	} else {
+		shift = fls64(ns) - 1 - TEST_LAT_SUB_SHIFT;
+		b = min_t(unsigned int, (shift + 1) * TEST_LAT_SUB +
+			  ((ns >> shift) & (TEST_LAT_SUB - 1)),
+			  TEST_LAT_BUCKETS - 1);
+	}
+
+	lat->hist[b]++;
+	lat->cnt++;
+	lat->max = max(lat->max, ns);
+}
+
+/* Lower bound, in us, of the latencies counted in bucket b */
+static unsigned int mmc_test_lat_us(unsigned int b)
+{
+	u64 ns = b;
+
+	if (b >= TEST_LAT_SUB)
+		ns = (u64)(TEST_LAT_SUB + b % TEST_LAT_SUB) <<
+		     (b / TEST_LAT_SUB - 1);
+
+	return div_u64(ns, NSEC_PER_USEC);
+}
+
+/*
+ * Print the latency percentiles.
+ */
+static void mmc_test_print_lat(struct mmc_test_card *test,
+			       struct mmc_test_lat *lat)
+{
+	static const unsigned int pct[] = { 500, 900, 990, 999 };
+	unsigned int val[ARRAY_SIZE(pct)] = { 0 };
+	unsigned int b, p = 0;
+	u64 seen = 0;
+
+	if (!lat->cnt)
+		return;
+
+	for (b = 0; b < TEST_LAT_BUCKETS && p < ARRAY_SIZE(pct); b++) {
+		seen += lat->hist[b];
+		while (p < ARRAY_SIZE(pct) &&
+		       seen * 1000 >= (u64)lat->cnt * pct[p])
+			val[p++] = mmc_test_lat_us(b);
+	}
+
+	pr_info("%s: %s latency of %u requests: p50 %u us, p90 %u us, "
+		"p99 %u us, p99.9 %u us, max %llu us\n",
+		mmc_hostname(test->card->host), lat->name, lat->cnt,
+		val[0], val[1], val[2], val[3],
+		div_u64(lat->max, NSEC_PER_USEC));
+}
+
+/*
+ * Random 4K aligned address in the last three quarters of the card, as
+ * mmc_test_rnd_perf() uses.
+ */
+static unsigned int mmc_test_rnd_4k_addr(struct mmc_test_card *test)
+{
+	unsigned int rnd_addr = mmc_test_capacity(test->card) / 4;
+
+	return rnd_addr + 8 * mmc_test_rnd_num(rnd_addr * 3 / 8);
+}
+
+/*
+ * Blocking 4K random transfers for TEST_RND_4K_SECS. With mixed set, 30% of
+ * the transfers are writes and the cache is flushed after every 16 writes,
+ * the way fsync() heavy Android workloads use the card.
+ */
+static int mmc_test_rnd_4k(struct mmc_test_card *test, int write, bool mixed)
+{
+	struct mmc_test_lat *lat;
+	struct timespec ts1, ts2;
+	unsigned int cnt = 0, writes = 0;
+	u64 start, deadline;
+	int is_write, ret;
+
+	lat = kcalloc(3, sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
+	lat[0].name = "read";
+	lat[1].name = "write";
+	lat[2].name = "cache flush";
+
+	ret = mmc_test_area_map(test, 4096, 0, 0);
+	if (ret)
+		goto out;
+
+	getnstimeofday(&ts1);
+	deadline = ktime_get_ns() + TEST_RND_4K_SECS * NSEC_PER_SEC;
+	while (ktime_get_ns() < deadline) {
+		is_write = mixed ? mmc_test_rnd_num(10) < 3 : write;
+
+		start = ktime_get_ns();
+		ret = mmc_test_area_transfer(test, mmc_test_rnd_4k_addr(test),
+					     is_write);
+		if (ret)
+			goto out;
+		mmc_test_lat_add(&lat[is_write], ktime_get_ns() - start);
+		cnt++;
+
+		if (mixed && is_write && !(++writes % 16)) {
+			start = ktime_get_ns();
+			ret = mmc_flush_cache(test->card);
+			if (ret)
+				goto out;
+			mmc_test_lat_add(&lat[2], ktime_get_ns() - start);
+		}
+	}
+	getnstimeofday(&ts2);
+
+	mmc_test_print_avg_rate(test, 4096, cnt, &ts1, &ts2);
+	mmc_test_print_lat(test, &lat[0]);
+	mmc_test_print_lat(test, &lat[1]);
+	mmc_test_print_lat(test, &lat[2]);
+out:
+	kfree(lat);
+	return ret;
+}
+
+/*
+ * Non-blocking 4K random transfers for TEST_RND_4K_SECS. The next request
+ * is prepared while the host runs the current one, so two are outstanding.
+ * The latency of a request runs from its submission to its completion.
+ */
+static int mmc_test_rnd_4k_nonblock(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_test_req *rq[2] = { NULL, NULL };
+	struct mmc_test_async_req test_areq[2];
+	struct mmc_async_req *done_areq;
+	enum mmc_blk_status status;
+	struct mmc_test_lat *lat;
+	struct timespec ts1, ts2;
+	u64 start[2], deadline;
+	unsigned int cnt = 0;
+	int i, cur = 0, ret;
+
+	lat = kzalloc(sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
+	lat->name = write ? "write" : "read";
+
+	ret = mmc_test_area_map(test, 4096, 0, 0);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < 2; i++) {
+		rq[i] = mmc_test_req_alloc();
+		if (!rq[i]) {
+			ret = RESULT_FAIL;
+			goto out;
+		}
+		test_areq[i].test = test;
+		test_areq[i].areq.mrq = &rq[i]->mrq;
+		test_areq[i].areq.err_check = mmc_test_check_result_async;
+	}
+
+	getnstimeofday(&ts1);
+	deadline = ktime_get_ns() + TEST_RND_4K_SECS * NSEC_PER_SEC;
+	do {
+		mmc_test_prepare_mrq(test, &rq[cur]->mrq, t->sg, t->sg_len,
+				     mmc_test_rnd_4k_addr(test), t->blocks,
+				     512, write);
+		start[cur] = ktime_get_ns();
+		done_areq = mmc_start_areq(test->card->host,
+					   &test_areq[cur].areq, &status);
+		if (status != MMC_BLK_SUCCESS || (!done_areq && cnt)) {
+			ret = RESULT_FAIL;
+			goto out;
+		}
+
+		if (done_areq) {
+			mmc_test_lat_add(lat, ktime_get_ns() - start[!cur]);
+			mmc_test_req_reset(rq[!cur]);
+		}
+
+		cur = !cur;
+		cnt++;
+	} while (ktime_get_ns() < deadline);
+
+	done_areq = mmc_start_areq(test->card->host, NULL, &status);
+	if (status != MMC_BLK_SUCCESS) {
+		ret = RESULT_FAIL;
+		goto out;
+	}
+	mmc_test_lat_add(lat, ktime_get_ns() - start[!cur]);
+	getnstimeofday(&ts2);
+
+	mmc_test_print_avg_rate(test, 4096, cnt, &ts1, &ts2);
+	mmc_test_print_lat(test, lat);
+out:
+	kfree(rq[0]);
+	kfree(rq[1]);
+	kfree(lat);
+	return ret;
+}
+
+/*
+ * 4K random read latency.
+ */
+static int mmc_test_rnd_4k_read_lat(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_4k(test, 0, false);
+}
+
+/*
+ * 4K random write latency.
+ */
+static int mmc_test_rnd_4k_write_lat(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_4k(test, 1, false);
+}
+
+/*
+ * 4K random read latency with two requests outstanding.
+ */
+static int mmc_test_rnd_4k_read_nonblock_lat(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_4k_nonblock(test, 0);
+}
+
+/*
+ * 4K random write latency with two requests outstanding.
+ */
+static int mmc_test_rnd_4k_write_nonblock_lat(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_4k_nonblock(test, 1);
+}
+
+/*
+ * Mixed 4K random read and write latency with cache flushes.
+ */
+static int mmc_test_rnd_4k_mixed_lat(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_4k(test, 0, true);
+}
+
 static int mmc_test_seq_perf(struct mmc_test_card *test, int write,
 			     unsigned int tot_sz, int max_scatter)
 {
@@ -2935,6 +3205,41 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.run = mmc_test_cmds_during_write_cmd23_nonblock,
 		.cleanup = mmc_test_area_cleanup,
 	},
+
+	{
+		.name = "4K random read latency",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_read_lat,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "4K random write latency",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_write_lat,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "4K random non-blocking read latency",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_read_nonblock_lat,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "4K random non-blocking write latency",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_write_nonblock_lat,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "4K random mixed read/write latency with cache flushes",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_mixed_lat,
+		.cleanup = mmc_test_area_cleanup,
+	},
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
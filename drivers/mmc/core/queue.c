@@ -18,6 +18,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/bitops.h>
 #include <linux/delay.h>
+#include <linux/interrupt.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -45,69 +46,50 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
-static struct request *mmc_peek_request(struct mmc_queue *mq)
-{
-	struct request_queue *q = mq->queue;
-
-	mq->cmdq_req_peeked = NULL;
-
-	spin_lock_irq(q->queue_lock);
-	if (!blk_queue_stopped(q))
-		mq->cmdq_req_peeked = blk_peek_request(q);
-	spin_unlock_irq(q->queue_lock);
-
-	return mq->cmdq_req_peeked;
-}
-
-static bool mmc_check_blk_queue_start_tag(struct request_queue *q,
-					  struct request *req)
-{
-	int ret;
-
-	spin_lock_irq(q->queue_lock);
-	ret = blk_queue_start_tag(q, req);
-	spin_unlock_irq(q->queue_lock);
-
-	return !!ret;
-}
-
-static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
-					struct mmc_queue *mq)
+static inline bool mmc_cmdq_ready(struct mmc_host *host, struct request *req)
 {
 	struct mmc_cmdq_context_info *ctx = &host->cmdq_ctx;
-	struct request_queue *q = mq->queue;
+	struct mmc_card *card = host->card;
 
 	/*
-	 * Wait until all of the following conditions are true:
-	 * 1. There is a request pending in the block layer queue
-	 *    to be processed.
-	 * 2. If the peeked request is flush/discard then there shouldn't
+	 * A request may be issued only when all of the following are true:
+	 * 1. If the request is flush/discard then there shouldn't
 	 *    be any other direct command active.
-	 * 3. cmdq state should be unhalted.
-	 * 4. cmdq state shouldn't be in error state.
-	 * 5. There is no outstanding RPMB request pending.
-	 * 6. free tag available to process the new request.
-	 *    (This must be the last condtion to check)
+	 * 2. cmdq state should be unhalted.
+	 * 3. cmdq state shouldn't be in error state.
+	 * 4. There is no outstanding RPMB request pending.
+	 * A free slot is guaranteed by the depth of the tag set.
 	 */
-	wait_event(ctx->wait, kthread_should_stop()
-		|| (mmc_peek_request(mq) &&
-		!(((req_op(mq->cmdq_req_peeked) == REQ_OP_FLUSH) ||
-		   (req_op(mq->cmdq_req_peeked) == REQ_OP_DISCARD) ||
-		   (req_op(mq->cmdq_req_peeked) == REQ_OP_SECURE_ERASE))
-		  && test_bit(CMDQ_STATE_DCMD_ACTIVE, &ctx->curr_state))
-		&& !(!host->card->part_curr && !mmc_card_suspended(host->card)
-		     && mmc_host_halt(host))
-		&& !(!host->card->part_curr && mmc_host_cq_disable(host) &&
-			!mmc_card_suspended(host->card))
-		&& !test_bit(CMDQ_STATE_ERR, &ctx->curr_state)
-		&& !atomic_read(&host->rpmb_req_pending)
-		&& !mmc_check_blk_queue_start_tag(q, mq->cmdq_req_peeked)));
+	if (((req_op(req) == REQ_OP_FLUSH) ||
+	     (req_op(req) == REQ_OP_DISCARD) ||
+	     (req_op(req) == REQ_OP_SECURE_ERASE)) &&
+	    test_bit(CMDQ_STATE_DCMD_ACTIVE, &ctx->curr_state))
+		return false;
+
+	if (!card->part_curr && !mmc_card_suspended(card) &&
+	    (mmc_host_halt(host) || mmc_host_cq_disable(host)))
+		return false;
+
+	return !test_bit(CMDQ_STATE_ERR, &ctx->curr_state) &&
+		!atomic_read(&host->rpmb_req_pending);
 }
 
 static void mmc_cmdq_softirq_done(struct request *rq)
 {
 	struct mmc_queue *mq = rq->q->queuedata;
 
+	/*
+	 * blk-mq calls ->complete from the context that completed the
+	 * request, which for the CQE is its hard irq (or the poller with
+	 * the host lock held). The completion path claims and releases the
+	 * host and takes bh locks, so bounce it through BLOCK_SOFTIRQ as
+	 * the legacy queue did.
+	 */
+	if (in_irq() || !in_serving_softirq()) {
+		__blk_complete_request(rq);
+		return;
+	}
+
 	mq->cmdq_complete_fn(rq);
 }
 
@@ -119,7 +101,8 @@ static void mmc_cmdq_error_work(struct work_struct *work)
 	mq->cmdq_error_fn(mq);
 }
 
-enum blk_eh_timer_return mmc_cmdq_rq_timed_out(struct request *req)
+static enum blk_eh_timer_return mmc_cmdq_rq_timed_out(struct request *req,
+						      bool reserved)
 {
 	struct mmc_queue *mq = req->q->queuedata;
 
@@ -128,50 +111,51 @@ enum blk_eh_timer_return mmc_cmdq_rq_timed_out(struct request *req)
 
 	return mq->cmdq_req_timed_out(req);
 }
-//#endif
 
-static int mmc_cmdq_thread(void *d)
+/*
+ * Everything that used to wake the mmc-cmdqd thread (unhalt, end of error
+ * recovery, dcmd or rpmb completion) still wakes cmdq_ctx.wait; rerun the
+ * hardware queue from there so that requests bounced with
+ * BLK_STS_RESOURCE get dispatched again.
+ */
+static int mmc_cmdq_wake(struct wait_queue_entry *wait, unsigned int mode,
+			 int sync, void *key)
 {
-	struct mmc_queue *mq = d;
-	struct mmc_card *card = mq->card;
-
-	struct mmc_host *host = card->host;
-
-	current->flags |= PF_MEMALLOC;
-	if (card->host->wakeup_on_idle)
-		set_wake_up_idle(true);
-
-	while (1) {
-		int ret = 0;
-
-		mmc_cmdq_ready_wait(host, mq);
-		if (kthread_should_stop())
-			break;
-
-		ret = mmc_cmdq_down_rwsem(host, mq->cmdq_req_peeked);
-		if (ret) {
-			mmc_cmdq_up_rwsem(host);
-			continue;
-		}
-		ret = mq->cmdq_issue_fn(mq, mq->cmdq_req_peeked);
-		mmc_cmdq_up_rwsem(host);
-
-		/*
-		 * Don't requeue if issue_fn fails.
-		 * Recovery will be come by completion softirq
-		 * Also we end the request if there is a partition switch
-		 * error, so we should not requeue the request here.
-		 */
-	} /* loop */
+	struct mmc_queue *mq = container_of(wait, struct mmc_queue, cmdq_wake);
 
+	blk_mq_run_hw_queues(mq->queue, true);
 	return 0;
 }
 
-static void mmc_cmdq_dispatch_req(struct request_queue *q)
+static blk_status_t mmc_cmdq_queue_rq(struct blk_mq_hw_ctx *hctx,
+				      const struct blk_mq_queue_data *bd)
 {
+	struct request *req = bd->rq;
+	struct request_queue *q = req->q;
 	struct mmc_queue *mq = q->queuedata;
+	struct mmc_host *host = mq->card->host;
+
+	/* pairs with the barrier in mmc_queue_suspend() */
+	mq->cmdq_req_peeked = req;
+	smp_mb();
+	if (blk_queue_quiesced(q) || !mmc_cmdq_ready(host, req)) {
+		mq->cmdq_req_peeked = NULL;
+		return BLK_STS_RESOURCE;
+	}
 
-	wake_up(&mq->card->host->cmdq_ctx.wait);
+	mmc_cmdq_down_rwsem(host, NULL);
+	blk_mq_start_request(req);
+	mq->cmdq_issue_fn(mq, req);
+	mmc_cmdq_up_rwsem(host);
+	mq->cmdq_req_peeked = NULL;
+
+	/*
+	 * Don't requeue if issue_fn fails.
+	 * Recovery will be come by completion softirq
+	 * Also we end the request if there is a partition switch
+	 * error, so we should not requeue the request here.
+	 */
+	return BLK_STS_OK;
 }
 
 static void mmc_queue_setup_discard(struct request_queue *q,
@@ -232,43 +216,33 @@ static struct scatterlist *mmc_alloc_sg(int sg_len, gfp_t gfp)
 
 int mmc_cmdq_init(struct mmc_queue *mq, struct mmc_card *card)
 {
-	int ret = 0;
-	/* one slot is reserved for dcmd requests */
-	int q_depth = card->ext_csd.cmdq_depth - 1;
+	struct mmc_host *host = card->host;
 
 	card->cmdq_init = false;
-	if (!(card->host->caps2 & MMC_CAP2_CMD_QUEUE)) {
+	if (!(host->caps2 & MMC_CAP2_CMD_QUEUE)) {
 		return -ENOTSUPP;
 	}
 
-	init_waitqueue_head(&card->host->cmdq_ctx.queue_empty_wq);
-	init_waitqueue_head(&card->host->cmdq_ctx.wait);
-	init_rwsem(&card->host->cmdq_ctx.err_rwsem);
+	init_waitqueue_head(&host->cmdq_ctx.queue_empty_wq);
+	init_waitqueue_head(&host->cmdq_ctx.wait);
+	init_rwsem(&host->cmdq_ctx.err_rwsem);
 
-	ret = blk_queue_init_tags(mq->queue, q_depth, NULL, BLK_TAG_ALLOC_FIFO);
-	if (ret) {
-		pr_warn("%s: unable to allocate cmdq tags %d\n",
-				mmc_card_name(card), q_depth);
-		return ret;
-	}
+	init_waitqueue_func_entry(&mq->cmdq_wake, mmc_cmdq_wake);
+	add_wait_queue(&host->cmdq_ctx.wait, &mq->cmdq_wake);
 
-	blk_queue_softirq_done(mq->queue, mmc_cmdq_softirq_done);
 	INIT_WORK(&mq->cmdq_err_work, mmc_cmdq_error_work);
 	init_completion(&mq->cmdq_shutdown_complete);
 	init_completion(&mq->cmdq_pending_req_done);
 
-	blk_queue_rq_timed_out(mq->queue, mmc_cmdq_rq_timed_out);
 	blk_queue_rq_timeout(mq->queue, 120 * HZ);
 	card->cmdq_init = true;
 
-	return ret;
+	return 0;
 }
 
 void mmc_cmdq_clean(struct mmc_queue *mq, struct mmc_card *card)
 {
-	blk_free_tags(mq->queue->queue_tags);
-	mq->queue->queue_tags = NULL;
-	blk_queue_free_tags(mq->queue);
+	remove_wait_queue(&card->host->cmdq_ctx.wait, &mq->cmdq_wake);
 }
 
 static int mmc_queue_thread(void *d)
@@ -356,17 +330,10 @@ static void mmc_request_fn(struct request_queue *q)
 		wake_up_process(mq->thread);
 }
 
-/**
- * mmc_init_request() - initialize the MMC-specific per-request data
- * @q: the request queue
- * @req: the request
- * @gfp: memory allocation policy
- */
-static int mmc_init_request(struct request_queue *q, struct request *req,
-			    gfp_t gfp)
+static int __mmc_init_request(struct mmc_queue *mq, struct request *req,
+			      gfp_t gfp)
 {
 	struct mmc_queue_req *mq_rq = req_to_mmc_queue_req(req);
-	struct mmc_queue *mq = q->queuedata;
 	struct mmc_host *host;
 
 	if (!mq)
@@ -377,10 +344,23 @@ static int mmc_init_request(struct request_queue *q, struct request *req,
 	mq_rq->sg = mmc_alloc_sg(host->max_segs, gfp);
 	if (!mq_rq->sg)
 		return -ENOMEM;
+	mq_rq->poll_issue_ns = 0;
 
 	return 0;
 }
 
+/**
+ * mmc_init_request() - initialize the MMC-specific per-request data
+ * @q: the request queue
+ * @req: the request
+ * @gfp: memory allocation policy
+ */
+static int mmc_init_request(struct request_queue *q, struct request *req,
+			    gfp_t gfp)
+{
+	return __mmc_init_request(q->queuedata, req, gfp);
+}
+
 static void mmc_exit_request(struct request_queue *q, struct request *req)
 {
 	struct mmc_queue_req *mq_rq = req_to_mmc_queue_req(req);
@@ -389,6 +369,65 @@ static void mmc_exit_request(struct request_queue *q, struct request *req)
 	mq_rq->sg = NULL;
 }
 
+static int mmc_mq_init_request(struct blk_mq_tag_set *set, struct request *req,
+			       unsigned int hctx_idx, unsigned int numa_node)
+{
+	return __mmc_init_request(set->driver_data, req, GFP_KERNEL);
+}
+
+static void mmc_mq_exit_request(struct blk_mq_tag_set *set, struct request *req,
+				unsigned int hctx_idx)
+{
+	struct mmc_queue *mq = set->driver_data;
+
+	mmc_exit_request(mq->queue, req);
+}
+
+static const struct blk_mq_ops mmc_cmdq_mq_ops = {
+	.queue_rq	= mmc_cmdq_queue_rq,
+	.init_request	= mmc_mq_init_request,
+	.exit_request	= mmc_mq_exit_request,
+	.complete	= mmc_cmdq_softirq_done,
+	.timeout	= mmc_cmdq_rq_timed_out,
+};
+
+static int mmc_cmdq_alloc_queue(struct mmc_queue *mq, struct mmc_card *card)
+{
+	int ret;
+
+	memset(&mq->tag_set, 0, sizeof(mq->tag_set));
+	mq->tag_set.ops = &mmc_cmdq_mq_ops;
+	/*
+	 * The CQE has a single task doorbell so there is one hardware
+	 * queue, fed from the per-cpu software queues. One slot is reserved
+	 * for dcmd requests. Issuing claims the host and may sleep.
+	 */
+	mq->tag_set.nr_hw_queues = 1;
+	mq->tag_set.queue_depth = card->ext_csd.cmdq_depth - 1;
+	mq->tag_set.numa_node = NUMA_NO_NODE;
+	mq->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_BLOCKING;
+	mq->tag_set.cmd_size = sizeof(struct mmc_queue_req);
+	mq->tag_set.driver_data = mq;
+
+	ret = blk_mq_alloc_tag_set(&mq->tag_set);
+	if (ret) {
+		pr_warn("%s: unable to allocate cmdq tags %d\n",
+			mmc_card_name(card), mq->tag_set.queue_depth);
+		return ret;
+	}
+
+	mq->queue = blk_mq_init_queue(&mq->tag_set);
+	if (IS_ERR(mq->queue)) {
+		ret = PTR_ERR(mq->queue);
+		mq->queue = NULL;
+		blk_mq_free_tag_set(&mq->tag_set);
+		return ret;
+	}
+	mq->queue->queuedata = mq;
+
+	return 0;
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
@@ -411,21 +450,9 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->card = card;
 	if (card->ext_csd.cmdq_support &&
 	    (area_type == MMC_BLK_DATA_AREA_MAIN)) {
-		mq->queue = blk_alloc_queue(GFP_KERNEL);
-		if (!mq->queue)
-			return -ENOMEM;
-		if (lock)
-			mq->queue->queue_lock = lock;
-		mq->queue->request_fn = mmc_cmdq_dispatch_req;
-		mq->queue->init_rq_fn = mmc_init_request;
-		mq->queue->exit_rq_fn = mmc_exit_request;
-		mq->queue->cmd_size = sizeof(struct mmc_queue_req);
-		mq->queue->queuedata = mq;
-		ret = blk_init_allocated_queue(mq->queue);
-		if (ret) {
-			blk_cleanup_queue(mq->queue);
+		ret = mmc_cmdq_alloc_queue(mq, card);
+		if (ret)
 			return ret;
-		}
 
 		mmc_cmdq_setup_queue(mq, card);
 		ret = mmc_cmdq_init(mq, card);
@@ -433,25 +460,15 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 			pr_err("%s: %d: cmdq: unable to set-up\n",
 			       mmc_hostname(card->host), ret);
 			blk_cleanup_queue(mq->queue);
+			blk_mq_free_tag_set(&mq->tag_set);
 		} else {
-			sema_init(&mq->thread_sem, 1);
 			/* hook for pm qos cmdq init */
 			if (card->host->cmdq_ops->init)
 				card->host->cmdq_ops->init(card->host);
 			if (host->cmdq_ops->cqe_crypto_update_queue)
 				host->cmdq_ops->cqe_crypto_update_queue(host,
 								mq->queue);
-			mq->thread = kthread_run(mmc_cmdq_thread, mq,
-						 "mmc-cmdqd/%d%s",
-						 host->index,
-						 subname ? subname : "");
-			if (IS_ERR(mq->thread)) {
-				pr_err("%s: %d: cmdq: failed to start mmc-cmdqd thread\n",
-					mmc_hostname(card->host), ret);
-				ret = PTR_ERR(mq->thread);
-			}
-
-			return ret;
+			return 0;
 		}
 	}
 
@@ -510,6 +527,14 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
 
+	if (q->mq_ops) {
+		if (likely(!blk_queue_dead(q)))
+			blk_cleanup_queue(q);
+		blk_mq_free_tag_set(&mq->tag_set);
+		mq->card = NULL;
+		return;
+	}
+
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
 
@@ -541,9 +566,8 @@ int mmc_queue_suspend(struct mmc_queue *mq, int wait)
 	unsigned long flags;
 	int rc = 0;
 	struct mmc_card *card = mq->card;
-	struct request *req;
 
-	if (card->cmdq_init && blk_queue_tagged(q)) {
+	if (q->mq_ops) {
 		struct mmc_host *host = card->host;
 
 		if (test_and_set_bit(MMC_QUEUE_SUSPENDED, &mq->flags))
@@ -553,30 +577,25 @@ int mmc_queue_suspend(struct mmc_queue *mq, int wait)
 
 			/*
 			 * After blk_cleanup_queue is called, wait for all
-			 * active_reqs to complete.
-			 * Then wait for cmdq thread to exit before calling
-			 * cmdq shutdown to avoid race between issuing
-			 * requests and shutdown of cmdq.
+			 * active_reqs to complete. blk_cleanup_queue also
+			 * waits for any ->queue_rq in progress, so nothing
+			 * races with the shutdown of cmdq.
 			 */
 			blk_cleanup_queue(q);
 
 			if (host->cmdq_ctx.active_reqs)
 				wait_for_completion(
 						&mq->cmdq_shutdown_complete);
-			kthread_stop(mq->thread);
 			mq->cmdq_shutdown(mq);
 		} else {
-			spin_lock_irqsave(q->queue_lock, flags);
-			blk_stop_queue(q);
-			wake_up(&host->cmdq_ctx.wait);
-			req = blk_peek_request(q);
-			if (req || mq->cmdq_req_peeked ||
-			    host->cmdq_ctx.active_reqs) {
+			blk_mq_quiesce_queue_nowait(q);
+			/* pairs with the barrier in mmc_cmdq_queue_rq() */
+			smp_mb();
+			if (mq->cmdq_req_peeked || host->cmdq_ctx.active_reqs) {
 				clear_bit(MMC_QUEUE_SUSPENDED, &mq->flags);
-				blk_start_queue(q);
+				blk_mq_unquiesce_queue(q);
 				rc = -EBUSY;
 			}
-			spin_unlock_irqrestore(q->queue_lock, flags);
 		}
 
 		goto out;
@@ -620,13 +639,17 @@ out:
 void mmc_queue_resume(struct mmc_queue *mq)
 {
 	struct request_queue *q = mq->queue;
-	struct mmc_card *card = mq->card;
 	unsigned long flags;
 
 	if (test_and_clear_bit(MMC_QUEUE_SUSPENDED, &mq->flags)) {
 
-		if (!(card->cmdq_init && blk_queue_tagged(q)))
-			up(&mq->thread_sem);
+		if (q->mq_ops) {
+			if (blk_queue_quiesced(q))
+				blk_mq_unquiesce_queue(q);
+			return;
+		}
+
+		up(&mq->thread_sem);
 
 		spin_lock_irqsave(q->queue_lock, flags);
 		blk_start_queue(q);
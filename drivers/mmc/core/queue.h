@@ -56,6 +56,7 @@ struct mmc_queue_req {
 	void			*drv_op_data;
 	unsigned int		ioc_count;
 	struct mmc_cmdq_req	cmdq_req;
+	u64			poll_issue_ns;	/* issue time, if sampled */
 };
 
 struct mmc_queue {
@@ -74,11 +75,13 @@ struct mmc_queue {
 	bool			asleep;
 	struct mmc_blk_data	*blkdata;
 	struct request_queue	*queue;
+	struct blk_mq_tag_set	tag_set;	/* cmdq queue only */
+	struct wait_queue_entry	cmdq_wake;
 	struct work_struct	cmdq_err_work;
 
 	struct completion	cmdq_pending_req_done;
 	struct completion	cmdq_shutdown_complete;
-	struct request		*cmdq_req_peeked;
+	struct request		*cmdq_req_peeked;	/* in ->queue_rq */
 	void (*cmdq_shutdown)(struct mmc_queue *);
 	/*
 	 * FIXME: this counter is not a very reliable way of keeping
@@ -87,6 +90,8 @@ struct mmc_queue {
 	 * associated mmc_queue_req data.
 	 */
 	int			qcnt;
+	/* moving average of small read completion latency, for cmdq polling */
+	u64			poll_lat_ns;
 #ifdef CONFIG_MMC_SIMULATE_MAX_SPEED
 	atomic_t max_write_speed;
 	atomic_t max_read_speed;
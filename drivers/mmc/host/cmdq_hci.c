@@ -12,6 +12,8 @@
 
 #include <linux/delay.h>
 #include <linux/highmem.h>
+#include <linux/interrupt.h>
+#include <linux/ktime.h>
 #include <linux/io.h>
 #include <linux/module.h>
 #include <linux/dma-mapping.h>
@@ -151,6 +153,24 @@ static void cmdq_clear_set_irqs(struct cmdq_host *cq_host, u32 clear, u32 set)
 	mb();
 }
 
+/*
+ * Only the signal enable is touched, so that completions keep being latched
+ * in CQIS/CQTCN and raise the interrupt as soon as signalling is restored.
+ */
+static void cmdq_set_tcc_signal(struct cmdq_host *cq_host, bool enable)
+{
+	u32 ier;
+
+	ier = cmdq_readl(cq_host, CQISGE);
+	if (enable)
+		ier |= CQIS_TCC;
+	else
+		ier &= ~CQIS_TCC;
+	cmdq_writel(cq_host, ier, CQISGE);
+	/* ensure the write is done */
+	mb();
+}
+
 static int cmdq_clear_task_poll(struct cmdq_host *cq_host, unsigned int tag)
 {
 	int retries = 100;
@@ -1174,6 +1194,55 @@ hac:
 }
 EXPORT_SYMBOL(cmdq_irq);
 
+/*
+ * Spin on the doorbell of @tag with the completion interrupt masked. The
+ * doorbell bit drops before the task shows up in CQTCN, so this also notices
+ * a completion that an interrupt on another CPU got to first. Anything other
+ * than a task completion (errors, halt) is left to the interrupt handler.
+ */
+static bool cmdq_poll(struct mmc_host *mmc, unsigned int tag, u64 timeout_ns)
+{
+	struct cmdq_host *cq_host = (struct cmdq_host *)mmc_cmdq_private(mmc);
+	struct sdhci_host *host = mmc_priv(mmc);
+	unsigned long flags;
+	bool done = false;
+	u64 end;
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (!cq_host->enabled || mmc_host_halt(mmc) ||
+	    mmc_host_cq_disable(mmc)) {
+		spin_unlock_irqrestore(&host->lock, flags);
+		return false;
+	}
+	cmdq_set_tcc_signal(cq_host, false);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	end = ktime_get_ns() + timeout_ns;
+	do {
+		if (cmdq_readl(cq_host, CQIS) & ~CQIS_TCC)
+			break;
+		if (!(cmdq_readl(cq_host, CQTDBR) & (1 << tag))) {
+			done = true;
+			break;
+		}
+		cpu_relax();
+	} while (ktime_get_ns() < end && !need_resched());
+
+	/*
+	 * With bottom halves off the block softirq raised by the completion
+	 * runs right here from local_bh_enable() instead of in ksoftirqd.
+	 */
+	local_bh_disable();
+	spin_lock_irqsave(&host->lock, flags);
+	if (done)
+		cmdq_irq(mmc, 0);
+	cmdq_set_tcc_signal(cq_host, true);
+	spin_unlock_irqrestore(&host->lock, flags);
+	local_bh_enable();
+
+	return done;
+}
+
 /* cmdq_halt_poll - Halting CQE using polling method.
  * @mmc: struct mmc_host
  * @halt: bool halt
@@ -1359,6 +1428,7 @@ static const struct mmc_cmdq_host_ops cmdq_host_ops = {
 	.halt = cmdq_halt,
 	.reset	= cmdq_reset,
 	.dumpstate = cmdq_dumpstate,
+	.poll = cmdq_poll,
 	.cqe_crypto_update_queue = cqhci_crypto_update_queue,
 };
 
@@ -220,6 +220,14 @@ static void wil_print_sring(struct seq_file *s, struct wil6210_priv *wil,
 	seq_printf(s, "  desc_rdy_pol   = %d\n", sring->desc_rdy_pol);
 	seq_printf(s, "  invalid_buff_id_cnt   = %d\n",
 		   sring->invalid_buff_id_cnt);
+	if (sring->is_rx) {
+		seq_printf(s, "  rx_napi   = %d\n",
+			   sring_idx % max_t(int, wil->num_rx_napi, 1));
+		seq_printf(s, "  rx_packets   = %lu\n", sring->rx_packets);
+		seq_printf(s, "  rx_polls   = %lu\n", sring->rx_polls);
+		seq_printf(s, "  rx_budget_exhausted   = %lu\n",
+			   sring->rx_budget_exhausted);
+	}
 
 	if (sring->va && (sring->size <= (1 << WIL_RING_SIZE_ORDER_MAX))) {
 		uint i;
@@ -1728,7 +1736,7 @@ has_keys:
 }
 
 static int wil_sta_debugfs_show(struct seq_file *s, void *data)
-__acquires(&p->tid_rx_lock) __releases(&p->tid_rx_lock)
+__acquires(&p->tid_rx_lock[tid]) __releases(&p->tid_rx_lock[tid])
 {
 	struct wil6210_priv *wil = s->private;
 	int i, tid, mcs;
@@ -1769,22 +1777,23 @@ __acquires(&p->tid_rx_lock) __releases(&p->tid_rx_lock)
 				   p->addr, status, mid, aid);
 
 		if (p->status == wil_sta_connected) {
-			spin_lock_bh(&p->tid_rx_lock);
 			for (tid = 0; tid < WIL_STA_TID_NUM; tid++) {
-				struct wil_tid_ampdu_rx *r = p->tid_rx[tid];
+				struct wil_tid_ampdu_rx *r;
 				struct wil_tid_crypto_rx *c =
 						&p->tid_crypto_rx[tid];
 
+				spin_lock_bh(&p->tid_rx_lock[tid]);
+				r = p->tid_rx[tid];
 				if (r) {
 					seq_printf(s, "  [%2d] ", tid);
 					wil_print_rxtid(s, r);
 				}
 
 				wil_print_rxtid_crypto(s, tid, c);
+				spin_unlock_bh(&p->tid_rx_lock[tid]);
 			}
 			wil_print_rxtid_crypto(s, WIL_STA_TID_NUM,
 					       &p->group_crypto_rx);
-			spin_unlock_bh(&p->tid_rx_lock);
 			seq_printf(s,
 				   "Rx invalid frame: non-data %lu, short %lu, large %lu, replay %lu\n",
 				   p->stats.rx_non_data_frame,
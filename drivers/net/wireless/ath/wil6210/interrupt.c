@@ -383,7 +383,7 @@ static irqreturn_t wil6210_irq_rx_edma(int irq, void *cookie)
 			if (likely(test_bit(wil_status_napi_en, wil->status))) {
 				wil_dbg_txrx(wil, "NAPI(Rx) schedule\n");
 				need_unmask = false;
-				napi_schedule(&wil->napi_rx);
+				wil_rx_napi_schedule_edma(wil);
 			} else {
 				wil_err(wil,
 					"Got Rx interrupt while stopping interface\n");
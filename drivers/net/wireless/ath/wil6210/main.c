@@ -252,7 +252,7 @@ static bool wil_vif_is_connected(struct wil6210_priv *wil, u8 mid)
 
 static void wil_disconnect_cid_complete(struct wil6210_vif *vif, int cid,
 					u16 reason_code)
-__acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
+__acquires(&sta->tid_rx_lock[i]) __releases(&sta->tid_rx_lock[i])
 {
 	uint i;
 	struct wil6210_priv *wil = vif_to_wil(vif);
@@ -289,13 +289,13 @@ __acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
 	for (i = 0; i < WIL_STA_TID_NUM; i++) {
 		struct wil_tid_ampdu_rx *r;
 
-		spin_lock_bh(&sta->tid_rx_lock);
+		spin_lock_bh(&sta->tid_rx_lock[i]);
 
 		r = sta->tid_rx[i];
 		sta->tid_rx[i] = NULL;
 		wil_tid_ampdu_rx_free(wil, r);
 
-		spin_unlock_bh(&sta->tid_rx_lock);
+		spin_unlock_bh(&sta->tid_rx_lock[i]);
 	}
 	/* crypto context */
 	memset(sta->tid_crypto_rx, 0, sizeof(sta->tid_crypto_rx));
@@ -713,7 +713,10 @@ int wil_priv_init(struct wil6210_priv *wil)
 
 	memset(wil->sta, 0, sizeof(wil->sta));
 	for (i = 0; i < WIL6210_MAX_CID; i++) {
-		spin_lock_init(&wil->sta[i].tid_rx_lock);
+		int tid;
+
+		for (tid = 0; tid < WIL_STA_TID_NUM; tid++)
+			spin_lock_init(&wil->sta[i].tid_rx_lock[tid]);
 		wil->sta[i].mid = U8_MAX;
 	}
 
@@ -739,6 +742,7 @@ int wil_priv_init(struct wil6210_priv *wil)
 	INIT_LIST_HEAD(&wil->pending_wmi_ev);
 	spin_lock_init(&wil->wmi_ev_lock);
 	spin_lock_init(&wil->net_queue_lock);
+	spin_lock_init(&wil->rx_buff_lock);
 	init_waitqueue_head(&wil->wq);
 	init_rwsem(&wil->mem_lock);
 
@@ -1902,7 +1906,7 @@ int __wil_up(struct wil6210_priv *wil)
 	wmi_set_mac_address(wil, ndev->dev_addr);
 
 	wil_dbg_misc(wil, "NAPI enable\n");
-	napi_enable(&wil->napi_rx);
+	wil_rx_napi_enable(wil);
 	napi_enable(&wil->napi_tx);
 	set_bit(wil_status_napi_en, wil->status);
 
@@ -1935,7 +1939,7 @@ int __wil_down(struct wil6210_priv *wil)
 
 	wil_disable_irq(wil);
 	if (test_and_clear_bit(wil_status_napi_en, wil->status)) {
-		napi_disable(&wil->napi_rx);
+		wil_rx_napi_disable(wil);
 		napi_disable(&wil->napi_tx);
 		wil_dbg_misc(wil, "NAPI disable\n");
 	}
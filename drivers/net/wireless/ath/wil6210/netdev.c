@@ -133,19 +133,36 @@ static int wil6210_netdev_poll_rx(struct napi_struct *napi, int budget)
 	return done;
 }
 
+static bool rx_napi_per_sring = true;
+module_param(rx_napi_per_sring, bool, 0644);
+MODULE_PARM_DESC(rx_napi_per_sring,
+		 " poll each RX status ring from its own NAPI (eDMA only)");
+
+static struct napi_struct *wil_rx_napi(struct wil6210_priv *wil, int i)
+{
+	return i ? &wil->napi_rx_sring[i - 1] : &wil->napi_rx;
+}
+
 static int wil6210_netdev_poll_rx_edma(struct napi_struct *napi, int budget)
 {
-	struct wil6210_priv *wil = container_of(napi, struct wil6210_priv,
-						napi_rx);
+	struct wil6210_priv *wil = container_of(napi->dev,
+						struct wil6210_priv, napi_ndev);
+	int idx = napi == &wil->napi_rx ? 0 :
+		  napi - wil->napi_rx_sring + 1;
 	int quota = budget;
 	int done;
 
-	wil_rx_handle_edma(wil, &quota);
+	/* GRO has to go through the NAPI being polled */
+	this_cpu_write(wil_rx_napi_cur, napi);
+	wil_rx_handle_edma(wil, idx, &quota);
+	this_cpu_write(wil_rx_napi_cur, NULL);
 	done = budget - quota;
 
 	if (done < budget) {
 		napi_complete_done(napi, done);
-		wil6210_unmask_irq_rx_edma(wil);
+		/* the last RX NAPI to finish re-enables the interrupt */
+		if (atomic_dec_and_test(&wil->rx_napi_active))
+			wil6210_unmask_irq_rx_edma(wil);
 		wil_dbg_txrx(wil, "NAPI RX complete\n");
 	}
 
@@ -154,6 +171,45 @@ static int wil6210_netdev_poll_rx_edma(struct napi_struct *napi, int budget)
 	return done;
 }
 
+void wil_rx_napi_enable(struct wil6210_priv *wil)
+{
+	int i;
+
+	wil->num_rx_napi = 1;
+	if (wil->use_enhanced_dma_hw && rx_napi_per_sring)
+		wil->num_rx_napi = max_t(u8, wil->num_rx_status_rings, 1);
+	atomic_set(&wil->rx_napi_active, 0);
+
+	for (i = 0; i < wil->num_rx_napi; i++)
+		napi_enable(wil_rx_napi(wil, i));
+}
+
+void wil_rx_napi_disable(struct wil6210_priv *wil)
+{
+	int i;
+
+	for (i = 0; i < wil->num_rx_napi; i++)
+		napi_disable(wil_rx_napi(wil, i));
+}
+
+void wil_rx_napi_synchronize(struct wil6210_priv *wil)
+{
+	int i;
+
+	for (i = 0; i < wil->num_rx_napi; i++)
+		napi_synchronize(wil_rx_napi(wil, i));
+}
+
+/* Called from the RX interrupt, which stays masked until all are done */
+void wil_rx_napi_schedule_edma(struct wil6210_priv *wil)
+{
+	int i;
+
+	atomic_set(&wil->rx_napi_active, wil->num_rx_napi);
+	for (i = 0; i < wil->num_rx_napi; i++)
+		napi_schedule(wil_rx_napi(wil, i));
+}
+
 static int wil6210_netdev_poll_tx(struct napi_struct *napi, int budget)
 {
 	struct wil6210_priv *wil = container_of(napi, struct wil6210_priv,
@@ -479,10 +535,17 @@ int wil_if_add(struct wil6210_priv *wil)
 	}
 
 	init_dummy_netdev(&wil->napi_ndev);
+	wil->num_rx_napi = 1;
 	if (wil->use_enhanced_dma_hw) {
+		int i;
+
 		netif_napi_add(&wil->napi_ndev, &wil->napi_rx,
 			       wil6210_netdev_poll_rx_edma,
 			       WIL6210_NAPI_BUDGET);
+		for (i = 0; i < ARRAY_SIZE(wil->napi_rx_sring); i++)
+			netif_napi_add(&wil->napi_ndev, &wil->napi_rx_sring[i],
+				       wil6210_netdev_poll_rx_edma,
+				       WIL6210_NAPI_BUDGET);
 		netif_tx_napi_add(&wil->napi_ndev,
 				  &wil->napi_tx, wil6210_netdev_poll_tx_edma,
 				  WIL6210_NAPI_BUDGET);
@@ -547,7 +610,7 @@ void wil_vif_remove(struct wil6210_priv *wil, u8 mid)
 	/* ensure NAPI code will see the NULL VIF */
 	wmb();
 	if (test_bit(wil_status_napi_en, wil->status)) {
-		napi_synchronize(&wil->napi_rx);
+		wil_rx_napi_synchronize(wil);
 		napi_synchronize(&wil->napi_tx);
 	}
 	mutex_unlock(&wil->vif_mutex);
@@ -576,6 +639,12 @@ void wil_if_remove(struct wil6210_priv *wil)
 
 	netif_napi_del(&wil->napi_tx);
 	netif_napi_del(&wil->napi_rx);
+	if (wil->use_enhanced_dma_hw) {
+		int i;
+
+		for (i = 0; i < ARRAY_SIZE(wil->napi_rx_sring); i++)
+			netif_napi_del(&wil->napi_rx_sring[i]);
+	}
 
 	wiphy_unregister(wdev->wiphy);
 }
@@ -317,7 +317,7 @@ void wil_pci_linkdown_recovery_worker(struct work_struct *work)
 	up_write(&wil->mem_lock);
 
 	if (test_and_clear_bit(wil_status_napi_en, wil->status)) {
-		napi_disable(&wil->napi_rx);
+		wil_rx_napi_disable(wil);
 		napi_disable(&wil->napi_tx);
 	}
 
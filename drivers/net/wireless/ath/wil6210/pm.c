@@ -255,7 +255,7 @@ static int wil_suspend_keep_radio_on(struct wil6210_priv *wil)
 				goto resume_after_fail;
 			}
 			wil_dbg_ratelimited(wil, "rx vring is not empty -> NAPI\n");
-			napi_synchronize(&wil->napi_rx);
+			wil_rx_napi_synchronize(wil);
 			msleep(20);
 		}
 	}
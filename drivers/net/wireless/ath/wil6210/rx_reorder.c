@@ -91,7 +91,7 @@ static void wil_reorder_release(struct net_device *ndev,
 
 /* called in NAPI context */
 void wil_rx_reorder(struct wil6210_priv *wil, struct sk_buff *skb)
-__acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
+__acquires(&sta->tid_rx_lock[tid]) __releases(&sta->tid_rx_lock[tid])
 {
 	struct wil6210_vif *vif;
 	struct net_device *ndev;
@@ -117,7 +117,10 @@ __acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
 	}
 	ndev = vif_to_ndev(vif);
 
-	spin_lock(&sta->tid_rx_lock);
+	/* A TID only ever arrives on one RX status ring, so unlike a per
+	 * station lock this is not contended between the RX NAPIs
+	 */
+	spin_lock(&sta->tid_rx_lock[tid]);
 
 	r = sta->tid_rx[tid];
 	if (!r) {
@@ -218,7 +221,7 @@ __acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
 	wil_reorder_release(ndev, r);
 
 out:
-	spin_unlock(&sta->tid_rx_lock);
+	spin_unlock(&sta->tid_rx_lock[tid]);
 }
 
 /* process BAR frame, called in NAPI context */
@@ -229,7 +232,7 @@ void wil_rx_bar(struct wil6210_priv *wil, struct wil6210_vif *vif,
 	struct net_device *ndev = vif_to_ndev(vif);
 	struct wil_tid_ampdu_rx *r;
 
-	spin_lock(&sta->tid_rx_lock);
+	spin_lock(&sta->tid_rx_lock[tid]);
 
 	r = sta->tid_rx[tid];
 	if (!r) {
@@ -246,7 +249,7 @@ void wil_rx_bar(struct wil6210_priv *wil, struct wil6210_vif *vif,
 	wil_release_reorder_frames(ndev, r, seq);
 
 out:
-	spin_unlock(&sta->tid_rx_lock);
+	spin_unlock(&sta->tid_rx_lock[tid]);
 }
 
 struct wil_tid_ampdu_rx *wil_tid_ampdu_rx_alloc(struct wil6210_priv *wil,
@@ -310,7 +313,7 @@ static u16 wil_agg_size(struct wil6210_priv *wil, u16 req_agg_wsize)
 int wil_addba_rx_request(struct wil6210_priv *wil, u8 mid,
 			 u8 cidxtid, u8 dialog_token, __le16 ba_param_set,
 			 __le16 ba_timeout, __le16 ba_seq_ctrl)
-__acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
+__acquires(&sta->tid_rx_lock[tid]) __releases(&sta->tid_rx_lock[tid])
 {
 	u16 param_set = le16_to_cpu(ba_param_set);
 	u16 agg_timeout = le16_to_cpu(ba_timeout);
@@ -384,10 +387,10 @@ __acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
 	/* apply */
 	if (!wil->use_rx_hw_reordering) {
 		r = wil_tid_ampdu_rx_alloc(wil, agg_wsize, ssn);
-		spin_lock_bh(&sta->tid_rx_lock);
+		spin_lock_bh(&sta->tid_rx_lock[tid]);
 		wil_tid_ampdu_rx_free(wil, sta->tid_rx[tid]);
 		sta->tid_rx[tid] = r;
-		spin_unlock_bh(&sta->tid_rx_lock);
+		spin_unlock_bh(&sta->tid_rx_lock[tid]);
 	}
 
 out:
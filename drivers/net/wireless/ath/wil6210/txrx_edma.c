@@ -231,11 +231,14 @@ static inline void wil_sring_advance_swhead(struct wil_status_ring *sring)
 		sring->desc_rdy_pol = 1 - sring->desc_rdy_pol;
 }
 
+/* The descriptor ring is shared by all RX status rings and their NAPIs */
 static int wil_rx_refill_edma(struct wil6210_priv *wil)
 {
 	struct wil_ring *ring = &wil->ring_rx;
 	u32 next_head;
 	int rc = 0;
+
+	spin_lock_bh(&wil->rx_buff_lock);
 	ring->swtail = *ring->edma_rx_swtail.va;
 
 	for (; next_head = wil_ring_next_head(ring),
@@ -259,6 +262,7 @@ static int wil_rx_refill_edma(struct wil6210_priv *wil)
 	wmb();
 
 	wil_w(wil, ring->hwtail, ring->swhead);
+	spin_unlock_bh(&wil->rx_buff_lock);
 
 	return rc;
 }
@@ -937,8 +941,10 @@ again:
 		wil_err(wil, "No Rx skb at buff_id %d\n", buff_id);
 		wil_rx_status_reset_buff_id(sring);
 		/* Move the buffer from the active list to the free list */
+		spin_lock(&wil->rx_buff_lock);
 		list_move_tail(&wil->rx_buff_mgmt.buff_arr[buff_id].list,
 			       &wil->rx_buff_mgmt.free);
+		spin_unlock(&wil->rx_buff_lock);
 		wil_sring_advance_swhead(sring);
 		sring->invalid_buff_id_cnt++;
 		goto again;
@@ -961,8 +967,10 @@ again:
 			  sizeof(struct wil_rx_status_extended), false);
 
 	/* Move the buffer from the active list to the free list */
+	spin_lock(&wil->rx_buff_lock);
 	list_move_tail(&wil->rx_buff_mgmt.buff_arr[buff_id].list,
 		       &wil->rx_buff_mgmt.free);
+	spin_unlock(&wil->rx_buff_lock);
 
 	eop = wil_rx_status_get_eop(msg);
 
@@ -1072,7 +1080,8 @@ skipping:
 	return skb;
 }
 
-void wil_rx_handle_edma(struct wil6210_priv *wil, int *quota)
+/* Reap the RX status rings served by RX NAPI @napi_idx */
+void wil_rx_handle_edma(struct wil6210_priv *wil, int napi_idx, int *quota)
 {
 	struct net_device *ndev;
 	struct wil_ring *ring = &wil->ring_rx;
@@ -1086,7 +1095,8 @@ void wil_rx_handle_edma(struct wil6210_priv *wil, int *quota)
 	}
 	wil_dbg_txrx(wil, "rx_handle\n");
 
-	for (i = 0; i < wil->num_rx_status_rings; i++) {
+	for (i = napi_idx; i < wil->num_rx_status_rings;
+	     i += wil->num_rx_napi) {
 		sring = &wil->srings[i];
 		if (unlikely(!sring->va)) {
 			wil_err(wil,
@@ -1095,10 +1105,12 @@ void wil_rx_handle_edma(struct wil6210_priv *wil, int *quota)
 			continue;
 		}
 
+		sring->rx_polls++;
 		while ((*quota > 0) &&
 		       (NULL != (skb =
 			wil_sring_reap_rx_edma(wil, sring)))) {
 			(*quota)--;
+			sring->rx_packets++;
 			if (wil->use_rx_hw_reordering) {
 				void *msg = wil_skb_rxstatus(skb);
 				int mid = wil_rx_status_get_mid(msg);
@@ -1118,6 +1130,9 @@ void wil_rx_handle_edma(struct wil6210_priv *wil, int *quota)
 			}
 		}
 
+		if (*quota <= 0)
+			sring->rx_budget_exhausted++;
+
 		wil_w(wil, sring->hwtail, (sring->swhead - 1) % sring->size);
 	}
 
@@ -568,6 +568,10 @@ struct wil_status_ring {
 	u8 desc_rdy_pol; /* Expected descriptor ready bit polarity */
 	struct wil_ring_rx_data rx_data;
 	u32 invalid_buff_id_cnt; /* relevant only for RX */
+	/* RX only: frames reaped and NAPI polls that served this ring */
+	unsigned long rx_packets;
+	unsigned long rx_polls;
+	unsigned long rx_budget_exhausted;
 };
 
 #define WIL_STA_TID_NUM (16)
@@ -756,7 +760,7 @@ struct wil_sta_info {
 	struct wmi_link_stats_basic fw_stats_basic;
 	/* Rx BACK */
 	struct wil_tid_ampdu_rx *tid_rx[WIL_STA_TID_NUM];
-	spinlock_t tid_rx_lock; /* guarding tid_rx array */
+	spinlock_t tid_rx_lock[WIL_STA_TID_NUM]; /* guarding tid_rx[tid] */
 	unsigned long tid_rx_timer_expired[BITS_TO_LONGS(WIL_STA_TID_NUM)];
 	unsigned long tid_rx_stop_requested[BITS_TO_LONGS(WIL_STA_TID_NUM)];
 	struct wil_tid_crypto_rx tid_crypto_rx[WIL_STA_TID_NUM];
@@ -980,6 +984,13 @@ struct wil6210_priv {
 	struct napi_struct napi_rx;
 	struct napi_struct napi_tx;
 	struct net_device napi_ndev; /* dummy net_device serving all VIFs */
+	/* eDMA: RX status ring i is polled by RX NAPI i % num_rx_napi,
+	 * RX NAPI 0 being napi_rx
+	 */
+	struct napi_struct napi_rx_sring[WIL6210_MAX_STATUS_RINGS - 1];
+	u8 num_rx_napi;
+	atomic_t rx_napi_active; /* RX IRQ is unmasked when it drops to 0 */
+	spinlock_t rx_buff_lock; /* eDMA RX buffer lists and ring refill */
 
 	/* DMA related */
 	struct wil_ring ring_rx;
@@ -1392,6 +1403,10 @@ void wil6210_unmask_irq_tx_edma(struct wil6210_priv *wil);
 void wil_rx_handle(struct wil6210_priv *wil, int *quota);
 void wil6210_unmask_irq_rx(struct wil6210_priv *wil);
 void wil6210_unmask_irq_rx_edma(struct wil6210_priv *wil);
+void wil_rx_napi_enable(struct wil6210_priv *wil);
+void wil_rx_napi_disable(struct wil6210_priv *wil);
+void wil_rx_napi_synchronize(struct wil6210_priv *wil);
+void wil_rx_napi_schedule_edma(struct wil6210_priv *wil);
 void wil_set_crypto_rx(u8 key_index, enum wmi_key_usage key_usage,
 		       struct wil_sta_info *cs,
 		       struct key_params *params);
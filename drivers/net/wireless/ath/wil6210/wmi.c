@@ -1300,7 +1300,7 @@ static void wmi_evt_addba_rx_req(struct wil6210_vif *vif, int id,
 }
 
 static void wmi_evt_delba(struct wil6210_vif *vif, int id, void *d, int len)
-__acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
+__acquires(&sta->tid_rx_lock[tid]) __releases(&sta->tid_rx_lock[tid])
 {
 	struct wil6210_priv *wil = vif_to_wil(vif);
 	struct wmi_delba_event *evt = d;
@@ -1339,13 +1339,13 @@ __acquires(&sta->tid_rx_lock) __releases(&sta->tid_rx_lock)
 
 	sta = &wil->sta[cid];
 
-	spin_lock_bh(&sta->tid_rx_lock);
+	spin_lock_bh(&sta->tid_rx_lock[tid]);
 
 	r = sta->tid_rx[tid];
 	sta->tid_rx[tid] = NULL;
 	wil_tid_ampdu_rx_free(wil, r);
 
-	spin_unlock_bh(&sta->tid_rx_lock);
+	spin_unlock_bh(&sta->tid_rx_lock[tid]);
 }
 
 static void wmi_evt_aoa_meas(struct wil6210_vif *vif, int id, void *d, int len)
@@ -10,6 +10,8 @@
  * GNU General Public License for more details.
  */
 #include <linux/module.h>
+#include <linux/hashtable.h>
+#include <linux/log2.h>
 #include <linux/slab.h>
 #include <linux/seq_file.h>
 #include <linux/err.h>
@@ -32,10 +34,19 @@ static DEFINE_SPINLOCK(alloc_lock);
 
 static struct dentry *debug_base;
 
+/* Slots come in power of two size classes from 8 Kb to 128 Kb */
+#define WCNSS_PREALLOC_MIN_SHIFT	13
+#define WCNSS_PREALLOC_CLASSES		5
+
 struct wcnss_prealloc {
 	int occupied;
 	size_t size;
 	void *ptr;
+	/* on the free list of its class while not occupied */
+	struct list_head node;
+	/* in wcnss_prealloc_hash by ptr */
+	struct hlist_node hnode;
+	int class;
 #ifdef CONFIG_SLUB_DEBUG
 	unsigned long stack_trace[WCNSS_MAX_STACK_TRACE];
 	struct stack_trace trace;
@@ -170,15 +181,62 @@ static struct wcnss_prealloc wcnss_allocs[] = {
 };
 #endif
 
+struct wcnss_prealloc_class {
+	struct list_head free;
+	unsigned int nr_slots;
+	unsigned int used;
+	unsigned int max_used;
+	/* requests of this class served by a larger one */
+	unsigned long promoted;
+	/* requests of this class left to kmalloc, pool exhausted */
+	unsigned long fallback;
+};
+
+static struct wcnss_prealloc_class wcnss_classes[WCNSS_PREALLOC_CLASSES];
+/* requests larger than the largest class */
+static unsigned long wcnss_prealloc_oversize;
+static DEFINE_HASHTABLE(wcnss_prealloc_hash, 7);
+
+static int wcnss_prealloc_class(size_t size)
+{
+	if (size <= (1UL << WCNSS_PREALLOC_MIN_SHIFT))
+		return 0;
+
+	return order_base_2(size) - WCNSS_PREALLOC_MIN_SHIFT;
+}
+
+/* Called with alloc_lock held */
+static void wcnss_prealloc_free_slot(struct wcnss_prealloc *entry)
+{
+	entry->occupied = 0;
+	list_add(&entry->node, &wcnss_classes[entry->class].free);
+	wcnss_classes[entry->class].used--;
+}
+
 int wcnss_prealloc_init(void)
 {
-	int i;
+	int i, class;
+
+	for (i = 0; i < WCNSS_PREALLOC_CLASSES; i++)
+		INIT_LIST_HEAD(&wcnss_classes[i].free);
 
 	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
+		class = wcnss_prealloc_class(wcnss_allocs[i].size);
+		if (WARN_ON(class >= WCNSS_PREALLOC_CLASSES ||
+			    wcnss_allocs[i].size != (8192UL << class)))
+			return -EINVAL;
+
 		wcnss_allocs[i].occupied = 0;
 		wcnss_allocs[i].ptr = kmalloc(wcnss_allocs[i].size, GFP_KERNEL);
 		if (!wcnss_allocs[i].ptr)
 			return -ENOMEM;
+
+		wcnss_allocs[i].class = class;
+		list_add_tail(&wcnss_allocs[i].node,
+			      &wcnss_classes[class].free);
+		wcnss_classes[class].nr_slots++;
+		hash_add(wcnss_prealloc_hash, &wcnss_allocs[i].hnode,
+			 (unsigned long)wcnss_allocs[i].ptr);
 	}
 
 	return 0;
@@ -189,6 +247,8 @@ void wcnss_prealloc_deinit(void)
 	int i = 0;
 
 	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
+		if (wcnss_allocs[i].ptr)
+			hash_del(&wcnss_allocs[i].hnode);
 		kfree(wcnss_allocs[i].ptr);
 		wcnss_allocs[i].ptr = NULL;
 	}
@@ -212,24 +272,46 @@ static inline
 void wcnss_prealloc_save_stack_trace(struct wcnss_prealloc *entry) {}
 #endif
 
+/*
+ * Take a slot of the smallest size class that fits @size, or of the next
+ * larger class with a free slot, as the old first fit over the sorted
+ * table did.
+ */
 void *wcnss_prealloc_get(size_t size)
 {
-	int i = 0;
+	struct wcnss_prealloc *entry;
+	struct wcnss_prealloc_class *c;
 	unsigned long flags;
+	int class, i;
+
+	class = wcnss_prealloc_class(size);
 
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].occupied)
+	if (class >= WCNSS_PREALLOC_CLASSES) {
+		wcnss_prealloc_oversize++;
+		goto out_unlock;
+	}
+
+	for (i = class; i < WCNSS_PREALLOC_CLASSES; i++) {
+		c = &wcnss_classes[i];
+		entry = list_first_entry_or_null(&c->free,
+						 struct wcnss_prealloc, node);
+		if (!entry)
 			continue;
 
-		if (wcnss_allocs[i].size >= size) {
-			/* we found the slot */
-			wcnss_allocs[i].occupied = 1;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			wcnss_prealloc_save_stack_trace(&wcnss_allocs[i]);
-			return wcnss_allocs[i].ptr;
-		}
+		/* we found the slot */
+		list_del(&entry->node);
+		entry->occupied = 1;
+		c->used++;
+		c->max_used = max(c->max_used, c->used);
+		if (i != class)
+			wcnss_classes[class].promoted++;
+		spin_unlock_irqrestore(&alloc_lock, flags);
+		wcnss_prealloc_save_stack_trace(entry);
+		return entry->ptr;
 	}
+	wcnss_classes[class].fallback++;
+out_unlock:
 	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	return NULL;
@@ -238,13 +320,15 @@ EXPORT_SYMBOL(wcnss_prealloc_get);
 
 int wcnss_prealloc_put(void *ptr)
 {
-	int i = 0;
+	struct wcnss_prealloc *entry;
 	unsigned long flags;
 
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].ptr == ptr) {
-			wcnss_allocs[i].occupied = 0;
+	hash_for_each_possible(wcnss_prealloc_hash, entry, hnode,
+			       (unsigned long)ptr) {
+		if (entry->ptr == ptr) {
+			if (entry->occupied)
+				wcnss_prealloc_free_slot(entry);
 			spin_unlock_irqrestore(&alloc_lock, flags);
 			return 1;
 		}
@@ -281,15 +365,18 @@ EXPORT_SYMBOL(wcnss_prealloc_check_memory_leak);
 
 int wcnss_pre_alloc_reset(void)
 {
+	unsigned long flags;
 	int i, n = 0;
 
+	spin_lock_irqsave(&alloc_lock, flags);
 	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
 		if (!wcnss_allocs[i].occupied)
 			continue;
 
-		wcnss_allocs[i].occupied = 0;
+		wcnss_prealloc_free_slot(&wcnss_allocs[i]);
 		n++;
 	}
+	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	return n;
 }
@@ -297,34 +384,31 @@ EXPORT_SYMBOL(wcnss_pre_alloc_reset);
 
 static int prealloc_memory_stats_show(struct seq_file *fp, void *data)
 {
-	int i = 0;
-	int used_slots = 0, free_slots = 0;
-	unsigned int tsize = 0, tused = 0, size = 0;
+	struct wcnss_prealloc_class classes[WCNSS_PREALLOC_CLASSES];
+	unsigned long oversize, flags;
+	unsigned int tsize = 0, tused = 0, size;
+	int i;
 
-	seq_puts(fp, "\nSlot_Size(Kb)\t\t[Used : Free]\n");
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		tsize += wcnss_allocs[i].size;
-		if (size != wcnss_allocs[i].size) {
-			if (size) {
-				seq_printf(
-					fp, "[%d : %d]\n",
-					used_slots, free_slots);
-			}
-
-			size = wcnss_allocs[i].size;
-			used_slots = 0;
-			free_slots = 0;
-			seq_printf(fp, "%d Kb\t\t\t", size / 1024);
-		}
+	spin_lock_irqsave(&alloc_lock, flags);
+	memcpy(classes, wcnss_classes, sizeof(classes));
+	oversize = wcnss_prealloc_oversize;
+	spin_unlock_irqrestore(&alloc_lock, flags);
 
-		if (wcnss_allocs[i].occupied) {
-			tused += wcnss_allocs[i].size;
-			++used_slots;
-		} else {
-			++free_slots;
-		}
+	seq_puts(fp, "\nSlot_Size(Kb)\t\t[Used : Free]\tMax_Used\tPromoted\tFallback\n");
+	for (i = 0; i < WCNSS_PREALLOC_CLASSES; i++) {
+		if (!classes[i].nr_slots && !classes[i].fallback)
+			continue;
+
+		size = 8192U << i;
+		tsize += size * classes[i].nr_slots;
+		tused += size * classes[i].used;
+		seq_printf(fp, "%d Kb\t\t\t[%d : %d]\t%u\t\t%lu\t\t%lu\n",
+			   size / 1024, classes[i].used,
+			   classes[i].nr_slots - classes[i].used,
+			   classes[i].max_used, classes[i].promoted,
+			   classes[i].fallback);
 	}
-	seq_printf(fp, "[%d : %d]\n", used_slots, free_slots);
+	seq_printf(fp, "Oversize: %lu\n", oversize);
 
 	/* Convert byte to Kb */
 	if (tsize)
@@ -1221,23 +1221,72 @@ static ssize_t ipa3_read_odlstats(struct file *file, char __user *ubuf,
 static ssize_t ipa3_read_page_recycle_stats(struct file *file,
 		char __user *ubuf, size_t count, loff_t *ppos)
 {
+	struct ipa3_page_recycle_stats *coal =
+		&ipa3_ctx->stats.page_recycle_stats[0];
+	struct ipa3_page_recycle_stats *def =
+		&ipa3_ctx->stats.page_recycle_stats[1];
 	int nbytes;
 	int cnt = 0;
 
 	nbytes = scnprintf(dbg_buff, IPA_MAX_MSG_LEN,
 			"COAL : Total number of packets replenished =%llu\n"
 			"COAL : Number of tmp alloc packets  =%llu\n"
+			"COAL : Number of look-ahead recycles =%llu\n"
+			"COAL : Number of pool empty events =%llu\n"
+			"COAL : Refill latency last/max (us) =%llu/%llu\n"
 			"DEF  : Total number of packets replenished =%llu\n"
-			"DEF  : Number of tmp alloc packets  =%llu\n",
-			ipa3_ctx->stats.page_recycle_stats[0].total_replenished,
-			ipa3_ctx->stats.page_recycle_stats[0].tmp_alloc,
-			ipa3_ctx->stats.page_recycle_stats[1].total_replenished,
-			ipa3_ctx->stats.page_recycle_stats[1].tmp_alloc);
+			"DEF  : Number of tmp alloc packets  =%llu\n"
+			"DEF  : Number of look-ahead recycles =%llu\n"
+			"DEF  : Number of pool empty events =%llu\n"
+			"DEF  : Refill latency last/max (us) =%llu/%llu\n",
+			coal->total_replenished,
+			coal->tmp_alloc,
+			coal->lookahead_hit,
+			coal->pool_empty,
+			coal->refill_lat_last_us,
+			coal->refill_lat_max_us,
+			def->total_replenished,
+			def->tmp_alloc,
+			def->lookahead_hit,
+			def->pool_empty,
+			def->refill_lat_last_us,
+			def->refill_lat_max_us);
 
 	cnt += nbytes;
 
 	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
 }
+static ssize_t ipa3_read_tx_db_batch(struct file *file,
+		char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct ipa3_sys_context *sys;
+	int nbytes;
+	int cnt = 0;
+	int i;
+
+	nbytes = scnprintf(dbg_buff, IPA_MAX_MSG_LEN,
+		"%-24s %10s %10s %10s %10s %10s %10s\n", "client",
+		"1", "2", "3-4", "5-8", "9-16", "17+");
+	cnt += nbytes;
+
+	for (i = 0; i < ipa3_ctx->ipa_num_pipes; i++) {
+		sys = ipa3_ctx->ep[i].sys;
+		if (!ipa3_ctx->ep[i].valid || !sys ||
+		    !IPA_CLIENT_IS_PROD(ipa3_ctx->ep[i].client))
+			continue;
+
+		nbytes = scnprintf(dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
+			"%-24s %10u %10u %10u %10u %10u %10u\n",
+			ipa_clients_strings[ipa3_ctx->ep[i].client],
+			sys->db_batch_hist[0], sys->db_batch_hist[1],
+			sys->db_batch_hist[2], sys->db_batch_hist[3],
+			sys->db_batch_hist[4], sys->db_batch_hist[5]);
+		cnt += nbytes;
+	}
+
+	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
+}
+
 static ssize_t ipa3_read_wstats(struct file *file, char __user *ubuf,
 		size_t count, loff_t *ppos)
 {
@@ -2127,6 +2176,21 @@ bail:
 	return 0;
 }
 
+static ssize_t ipa3_read_nat_age(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	int cnt;
+
+	cnt = ipa3_nat_age_show(&ipa3_ctx->nat_mem.dev,
+		dbg_buff, IPA_MAX_MSG_LEN);
+
+	if (ipa3_ctx->ipa_hw_type >= IPA_HW_v4_0)
+		cnt += ipa3_nat_age_show(&ipa3_ctx->ipv6ct_mem.dev,
+			dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt);
+
+	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
+}
+
 static ssize_t ipa3_rm_read_stats(struct file *file, char __user *ubuf,
 		size_t count, loff_t *ppos)
 {
@@ -2860,6 +2924,10 @@ static const struct ipa3_debugfs_file debugfs_files[] = {
 		"page_recycle_stats", IPA_READ_ONLY_MODE, NULL, {
 			.read = ipa3_read_page_recycle_stats,
 		}
+	}, {
+		"tx_db_batch", IPA_READ_ONLY_MODE, NULL, {
+			.read = ipa3_read_tx_db_batch,
+		}
 	}, {
 		"wdi", IPA_READ_ONLY_MODE, NULL, {
 			.read = ipa3_read_wdi,
@@ -2885,6 +2953,10 @@ static const struct ipa3_debugfs_file debugfs_files[] = {
 		"ipv6ct", IPA_READ_ONLY_MODE, NULL, {
 			.read = ipa3_read_ipv6ct,
 		}
+	}, {
+		"nat_age", IPA_READ_ONLY_MODE, NULL, {
+			.read = ipa3_read_nat_age,
+		}
 	}, {
 		"rm_stats", IPA_READ_ONLY_MODE, NULL, {
 			.read = ipa3_rm_read_stats,
@@ -13,9 +13,12 @@
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/dmapool.h>
+#include <linux/lat_hist.h>
 #include <linux/list.h>
+#include <linux/moduleparam.h>
 #include <linux/netdevice.h>
 #include <linux/msm_gsi.h>
+#include <linux/skb_latency.h>
 #include <net/sock.h>
 #include "ipa_i.h"
 #include "ipa_trace.h"
@@ -32,6 +35,9 @@
 #define POLLING_INACTIVITY_TX 40
 #define POLLING_MIN_SLEEP_TX 400
 #define POLLING_MAX_SLEEP_TX 500
+/* shortest poll sleep and idle time used by the adaptive RX policy */
+#define POLLING_ADAPT_MIN_SLEEP_RX 100
+#define POLLING_ADAPT_IDLE_RX_US 2000
 #define SUSPEND_MIN_SLEEP_RX 1000
 #define SUSPEND_MAX_SLEEP_RX 1005
 /* 8K less 1 nominal MTU (1500 bytes) rounded to units of KB */
@@ -81,8 +87,15 @@
 #define IPA_DEFAULT_SYS_YELLOW_WM 32
 #define IPA_REPL_XFER_THRESH 20
 #define IPA_REPL_XFER_MAX 36
+/*
+ * How many recycle ring slots past a busy page are searched for an idle
+ * one before the replenish path falls back to a temporary page.
+ */
+#define IPA_PAGE_RECYCLE_LOOKAHEAD 16
 
 #define IPA_TX_SEND_COMPL_NOP_DELAY_NS (2 * 1000 * 1000)
+/* doorbell deferred by xmit_more is rung by a NOP at the latest after this */
+#define IPA_TX_SEND_DB_FLUSH_DELAY_NS (100 * 1000)
 
 #define IPA_APPS_BW_FOR_PM 700
 
@@ -92,6 +105,30 @@
 
 #define IPA_QMAP_ID_BYTE 0
 
+/*
+ * Latency target for RX consumer pipes, in usec. When non-zero, each pipe
+ * derives its polling interval, how long it keeps polling once idle, and
+ * the GSI event ring interrupt moderation from its observed completion
+ * rate so that a completion is not held back longer than the target.
+ * Zero keeps the static defaults.
+ */
+static unsigned int rx_latency_target_us;
+module_param(rx_latency_target_us, uint, 0644);
+MODULE_PARM_DESC(rx_latency_target_us,
+	"Adaptive RX poll/interrupt latency target in usec, 0 to disable");
+
+/*
+ * Maximum number of packets whose doorbell may be held back while the
+ * network stack signals more packets are coming (skb->xmit_more) on an
+ * apps TX pipe. 0 or 1 rings the doorbell for every packet.
+ */
+static unsigned int tx_db_batch_max = 16;
+module_param(tx_db_batch_max, uint, 0644);
+MODULE_PARM_DESC(tx_db_batch_max,
+	"Maximum packets per TX doorbell under xmit_more, 0/1 to disable");
+
+static int __ipa3_send(struct ipa3_sys_context *sys, u32 num_desc,
+		struct ipa3_desc *desc, bool in_atomic, bool xmit_more);
 static struct sk_buff *ipa3_get_skb_ipa_rx(unsigned int len, gfp_t flags);
 static void ipa3_replenish_wlan_rx_cache(struct ipa3_sys_context *sys);
 static void ipa3_replenish_rx_cache(struct ipa3_sys_context *sys);
@@ -236,6 +273,17 @@ static void ipa3_tasklet_write_done(unsigned long data)
 }
 
 
+/* must be called with sys->spinlock held, after the doorbell was rung */
+static void ipa3_tx_db_account(struct ipa3_sys_context *sys, u32 num)
+{
+	u32 bucket = num <= 1 ? 0 : fls(num - 1);
+
+	if (bucket >= IPA_TX_DB_BATCH_BUCKETS)
+		bucket = IPA_TX_DB_BATCH_BUCKETS - 1;
+	sys->db_batch_hist[bucket]++;
+	sys->db_deferred = 0;
+}
+
 static void ipa3_send_nop_desc(struct work_struct *work)
 {
 	struct ipa3_sys_context *sys = container_of(work,
@@ -278,6 +326,9 @@ static void ipa3_send_nop_desc(struct work_struct *work)
 		queue_work(sys->wq, &sys->work);
 		return;
 	}
+	/* the NOP doorbell also covers descriptors deferred by xmit_more */
+	if (sys->db_deferred)
+		ipa3_tx_db_account(sys, sys->db_deferred);
 	spin_unlock_bh(&sys->spinlock);
 
 	/* make sure TAG process is sent before clocks are gated */
@@ -307,6 +358,29 @@ int ipa3_send(struct ipa3_sys_context *sys,
 		u32 num_desc,
 		struct ipa3_desc *desc,
 		bool in_atomic)
+{
+	return __ipa3_send(sys, num_desc, desc, in_atomic, false);
+}
+
+/**
+ * __ipa3_send() - ipa3_send() with doorbell batching
+ * @sys: system pipe context
+ * @num_desc: number of packets
+ * @desc: packets to send (may be immediate command or data)
+ * @in_atomic:  whether caller is in atomic context
+ * @xmit_more: caller will send another packet right after this one
+ *
+ * When @xmit_more is set on a pipe whose completions are already coalesced
+ * through NOP descriptors (apps TX pipes on the common event ring), the
+ * transfer is queued without ringing the doorbell, up to tx_db_batch_max
+ * packets in a row. The next regular send, or a NOP descriptor armed with
+ * a short timer, rings it for the whole batch.
+ */
+static int __ipa3_send(struct ipa3_sys_context *sys,
+		u32 num_desc,
+		struct ipa3_desc *desc,
+		bool in_atomic,
+		bool xmit_more)
 {
 	struct ipa3_tx_pkt_wrapper *tx_pkt, *tx_pkt_first = NULL;
 	struct ipahal_imm_cmd_pyld *tag_pyld_ret = NULL;
@@ -318,6 +392,7 @@ int ipa3_send(struct ipa3_sys_context *sys,
 	u32 mem_flag = GFP_ATOMIC;
 	const struct ipa_gsi_ep_config *gsi_ep_cfg;
 	bool send_nop = false;
+	bool ring_db = true;
 	unsigned int max_desc;
 
 	if (unlikely(!in_atomic))
@@ -353,6 +428,11 @@ int ipa3_send(struct ipa3_sys_context *sys,
 
 	spin_lock_bh(&sys->spinlock);
 
+	if (xmit_more && sys->use_comm_evt_ring &&
+	    sys->policy == IPA_POLICY_INTR_MODE &&
+	    sys->db_deferred + 1 < READ_ONCE(tx_db_batch_max))
+		ring_db = false;
+
 	for (i = 0; i < num_desc; i++) {
 		tx_pkt = kmem_cache_zalloc(ipa3_ctx->tx_pkt_wrapper_cache,
 					   GFP_ATOMIC);
@@ -461,7 +541,7 @@ int ipa3_send(struct ipa3_sys_context *sys,
 
 	IPADBG_LOW("ch:%lu queue xfer\n", sys->ep->gsi_chan_hdl);
 	result = gsi_queue_xfer(sys->ep->gsi_chan_hdl, num_desc,
-			gsi_xfer, true);
+			gsi_xfer, ring_db);
 	if (result != GSI_STATUS_SUCCESS) {
 		IPAERR("GSI xfer failed.\n");
 		result = -EFAULT;
@@ -473,6 +553,13 @@ int ipa3_send(struct ipa3_sys_context *sys,
 	else
 		send_nop = false;
 
+	if (ring_db) {
+		ipa3_tx_db_account(sys, sys->db_deferred + 1);
+	} else {
+		sys->db_deferred++;
+		sys->nop_pending = true;
+	}
+
 	sys->pkt_sent++;
 	spin_unlock_bh(&sys->spinlock);
 
@@ -486,6 +573,12 @@ int ipa3_send(struct ipa3_sys_context *sys,
 		hrtimer_start(&sys->db_timer, time, HRTIMER_MODE_REL);
 	}
 
+	/* bound how long a deferred doorbell can be held back */
+	if (!ring_db)
+		hrtimer_start(&sys->db_timer,
+			ktime_set(0, IPA_TX_SEND_DB_FLUSH_DELAY_NS),
+			HRTIMER_MODE_REL);
+
 	/* make sure TAG process is sent before clocks are gated */
 	ipa3_ctx->tag_process_before_gating = true;
 
@@ -795,6 +888,114 @@ static void __ipa3_update_curr_poll_state(enum ipa_client_type client,
 									state);
 }
 
+static void ipa3_rx_adapt_work_func(struct work_struct *work)
+{
+	struct ipa3_rx_adapt *adapt = container_of(work,
+		struct ipa3_rx_adapt, work);
+	struct ipa3_sys_context *sys = container_of(adapt,
+		struct ipa3_sys_context, adapt);
+	struct gsi_evt_ring_props props;
+	union __packed gsi_evt_scratch scratch;
+	u16 modt = READ_ONCE(adapt->modt);
+	u8 modc = READ_ONCE(adapt->modc);
+	int ret;
+
+	if (modt == adapt->hw_modt && modc == adapt->hw_modc)
+		return;
+
+	ret = gsi_get_evt_ring_cfg(sys->ep->gsi_evt_ring_hdl, &props,
+		&scratch);
+	if (ret != GSI_STATUS_SUCCESS)
+		return;
+
+	props.int_modt = modt;
+	props.int_modc = modc;
+	ret = gsi_set_evt_ring_cfg(sys->ep->gsi_evt_ring_hdl, &props,
+		&scratch);
+	if (ret != GSI_STATUS_SUCCESS) {
+		IPAERR_RL("client %d moderation update failed %d\n",
+			sys->ep->client, ret);
+		return;
+	}
+
+	adapt->hw_modt = modt;
+	adapt->hw_modc = modc;
+	IPADBG_LOW("client=%d rate=%u/ms moderation cycles=%u cnt=%u\n",
+		sys->ep->client, adapt->rate, modt, modc);
+}
+
+static void ipa3_rx_adapt_init(struct ipa3_sys_context *sys)
+{
+	struct ipa3_rx_adapt *adapt = &sys->adapt;
+
+	adapt->window_start = ktime_get();
+	adapt->events = 0;
+	adapt->rate = 0;
+	adapt->poll_sleep_us = POLLING_MIN_SLEEP_RX;
+	adapt->poll_inactivity = POLLING_INACTIVITY_RX;
+	INIT_WORK(&adapt->work, ipa3_rx_adapt_work_func);
+}
+
+/**
+ * ipa3_rx_adapt_update() - re-tune RX polling for the observed traffic
+ * @sys: consumer pipe about to return to interrupt mode
+ *
+ * The number of completions expected within the latency target decides the
+ * count moderation: sparse, latency sensitive traffic interrupts on every
+ * completion and stops polling early, while bulk traffic batches up to the
+ * static moderation and keeps polling for as long as the default policy.
+ */
+static void ipa3_rx_adapt_update(struct ipa3_sys_context *sys)
+{
+	struct ipa3_rx_adapt *adapt = &sys->adapt;
+	unsigned int target = READ_ONCE(rx_latency_target_us);
+	ktime_t now = ktime_get();
+	s64 elapsed;
+	u32 expected;
+	u32 idle_us;
+	u16 modt;
+	u8 modc;
+
+	elapsed = ktime_us_delta(now, adapt->window_start);
+	if (elapsed >= USEC_PER_MSEC) {
+		expected = div64_u64((u64)adapt->events * USEC_PER_MSEC,
+			elapsed);
+		adapt->rate = (3 * adapt->rate + expected) / 4;
+		adapt->events = 0;
+		adapt->window_start = now;
+	}
+
+	if (!target) {
+		adapt->poll_sleep_us = POLLING_MIN_SLEEP_RX;
+		adapt->poll_inactivity = POLLING_INACTIVITY_RX;
+		modt = IPA_GSI_EVT_RING_INT_MODT;
+		modc = sys->napi_obj ? IPA_GSI_EVT_RING_INT_MODC : 1;
+	} else {
+		expected = adapt->rate * target / USEC_PER_MSEC;
+		modc = clamp_t(u32, expected, 1, sys->napi_obj ?
+			IPA_GSI_EVT_RING_INT_MODC : 1);
+		modt = clamp_t(u32, target * 32 / USEC_PER_MSEC, 1,
+			IPA_GSI_EVT_RING_INT_MODT);
+
+		adapt->poll_sleep_us = clamp_t(u32, target / 2,
+			POLLING_ADAPT_MIN_SLEEP_RX, POLLING_MIN_SLEEP_RX);
+		idle_us = expected > 1 ?
+			POLLING_INACTIVITY_RX * POLLING_MIN_SLEEP_RX :
+			POLLING_ADAPT_IDLE_RX_US;
+		adapt->poll_inactivity = idle_us / adapt->poll_sleep_us;
+	}
+
+	/* pipes sharing the common event ring keep its shared settings */
+	if (sys->use_comm_evt_ring)
+		return;
+
+	if (modt != adapt->hw_modt || modc != adapt->hw_modc) {
+		WRITE_ONCE(adapt->modt, modt);
+		WRITE_ONCE(adapt->modc, modc);
+		queue_work(sys->wq, &adapt->work);
+	}
+}
+
 /**
  * ipa3_rx_switch_to_intr_mode() - Operate the Rx data path in interrupt mode
  */
@@ -802,6 +1003,7 @@ static int ipa3_rx_switch_to_intr_mode(struct ipa3_sys_context *sys)
 {
 	int ret;
 
+	ipa3_rx_adapt_update(sys);
 	atomic_set(&sys->curr_polling_state, 0);
 	__ipa3_update_curr_poll_state(sys->ep->client, 0);
 #ifdef IPA_WAKELOCKS
@@ -852,9 +1054,12 @@ start_poll:
 			inactive_cycles++;
 		else
 			inactive_cycles = 0;
+		sys->adapt.events += cnt;
 
 		trace_idle_sleep_enter3(sys->ep->client);
-		usleep_range(POLLING_MIN_SLEEP_RX, POLLING_MAX_SLEEP_RX);
+		usleep_range(sys->adapt.poll_sleep_us,
+			sys->adapt.poll_sleep_us +
+			POLLING_MAX_SLEEP_RX - POLLING_MIN_SLEEP_RX);
 		trace_idle_sleep_exit3(sys->ep->client);
 
 		/*
@@ -865,7 +1070,7 @@ start_poll:
 		if (sys->len == 0)
 			break;
 
-	} while (inactive_cycles <= POLLING_INACTIVITY_RX);
+	} while (inactive_cycles <= sys->adapt.poll_inactivity);
 
 	trace_poll_to_intr3(sys->ep->client);
 	ret = ipa3_rx_switch_to_intr_mode(sys);
@@ -1047,6 +1252,7 @@ int ipa3_setup_sys_pipe(struct ipa_sys_connect_params *sys_in, u32 *clnt_hdl)
 		hrtimer_init(&ep->sys->db_timer, CLOCK_MONOTONIC,
 			HRTIMER_MODE_REL);
 		ep->sys->db_timer.function = ipa3_ring_doorbell_timer_fn;
+		ipa3_rx_adapt_init(ep->sys);
 
 		/* create IPA PM resources for handling polling mode */
 		if (sys_in->client == IPA_CLIENT_APPS_WAN_CONS &&
@@ -1709,7 +1915,8 @@ int ipa3_tx_dp(enum ipa_client_type dst, struct sk_buff *skb,
 			desc[skb_idx].callback = NULL;
 		}
 
-		if (ipa3_send(sys, num_frags + data_idx, desc, true)) {
+		if (__ipa3_send(sys, num_frags + data_idx, desc, true,
+				skb->xmit_more)) {
 			IPAERR("fail to send skb %pK num_frags %u SWP\n",
 				skb, num_frags);
 			goto fail_send;
@@ -1740,7 +1947,8 @@ int ipa3_tx_dp(enum ipa_client_type dst, struct sk_buff *skb,
 			desc[data_idx].dma_address = meta->dma_address;
 		}
 		if (num_frags == 0) {
-			if (ipa3_send(sys, data_idx + 1, desc, true)) {
+			if (__ipa3_send(sys, data_idx + 1, desc, true,
+					skb->xmit_more)) {
 				IPAERR("fail to send skb %pK HWP\n", skb);
 				goto fail_mem;
 			}
@@ -1759,8 +1967,8 @@ int ipa3_tx_dp(enum ipa_client_type dst, struct sk_buff *skb,
 			desc[data_idx+f].user2 = desc[data_idx].user2;
 			desc[data_idx].callback = NULL;
 
-			if (ipa3_send(sys, num_frags + data_idx + 1,
-				desc, true)) {
+			if (__ipa3_send(sys, num_frags + data_idx + 1,
+				desc, true, skb->xmit_more)) {
 				IPAERR("fail to send skb %pK num_frags %u\n",
 					skb, num_frags);
 				goto fail_mem;
@@ -1797,6 +2005,7 @@ static void ipa3_wq_handle_rx(struct work_struct *work)
 			IPA_ACTIVE_CLIENTS_INC_SPECIAL("NAPI");
 		else
 			ipa_pm_activate_sync(sys->pm_hdl);
+		atomic_set(&sys->napi_voted, 1);
 		napi_schedule(sys->napi_obj);
 		IPA_STATS_INC_CNT(sys->napi_sch_cnt);
 	} else
@@ -1935,18 +2144,32 @@ static void ipa3_wq_page_repl(struct work_struct *work)
 {
 	struct ipa3_sys_context *sys;
 	struct ipa3_rx_pkt_wrapper *rx_pkt;
+	struct ipa3_page_recycle_stats *stats;
 	u32 next;
 	u32 curr;
+	u64 lat;
 
 	sys = container_of(work, struct ipa3_sys_context, repl_work);
 	atomic_set(&sys->repl->pending, 0);
 	curr = atomic_read(&sys->repl->tail_idx);
+	stats = &ipa3_ctx->stats.page_recycle_stats[
+		(sys->ep->client == IPA_CLIENT_APPS_WAN_COAL_CONS) ? 0 : 1];
 
 begin:
 	while (1) {
 		next = (curr + 1) % sys->repl->capacity;
-		if (unlikely(next == atomic_read(&sys->repl->head_idx)))
+		if (unlikely(next == atomic_read(&sys->repl->head_idx))) {
+			/* time from the refill request until the ring is full */
+			if (sys->repl->queued_ts) {
+				lat = ktime_us_delta(ktime_get(),
+					sys->repl->queued_ts);
+				sys->repl->queued_ts = 0;
+				stats->refill_lat_last_us = lat;
+				if (lat > stats->refill_lat_max_us)
+					stats->refill_lat_max_us = lat;
+			}
 			goto fail_kmem_cache_alloc;
+		}
 		rx_pkt = ipa3_alloc_rx_pkt_page(GFP_KERNEL, true);
 		if (unlikely(!rx_pkt)) {
 			IPAERR("ipa3_alloc_rx_pkt_page fails\n");
@@ -1988,6 +2211,7 @@ static inline void __trigger_repl_work(struct ipa3_sys_context *sys)
 
 	if (avail < sys->repl->capacity / 4) {
 		atomic_set(&sys->repl->pending, 1);
+		sys->repl->queued_ts = ktime_get();
 		queue_work(sys->repl_wq, &sys->repl_work);
 	}
 }
@@ -1999,9 +2223,13 @@ static void ipa3_replenish_rx_page_recycle(struct ipa3_sys_context *sys)
 	int ret;
 	int rx_len_cached = 0;
 	struct gsi_xfer_elem gsi_xfer_elem_array[IPA_REPL_XFER_MAX];
+	struct ipa3_rx_pkt_wrapper **cache;
+	u32 capacity;
 	u32 curr;
 	u32 curr_wq;
+	u32 next;
 	int idx = 0;
+	int i;
 	struct page *cur_page;
 	u32 stats_i = 0;
 
@@ -2014,22 +2242,47 @@ static void ipa3_replenish_rx_page_recycle(struct ipa3_sys_context *sys)
 	rx_len_cached = sys->len;
 	curr = atomic_read(&sys->page_recycle_repl->head_idx);
 	curr_wq = atomic_read(&sys->repl->head_idx);
+	cache = sys->page_recycle_repl->cache;
+	capacity = sys->page_recycle_repl->capacity;
 
 	while (rx_len_cached < sys->rx_pool_sz) {
-		cur_page = sys->page_recycle_repl->cache[curr]->page_data.page;
+		cur_page = cache[curr]->page_data.page;
+		if (page_ref_count(cur_page) != 1) {
+			/*
+			 * The page at curr is still held by the stack. Rather
+			 * than stall on it, look a little further ahead and
+			 * swap the first idle page found into this slot; the
+			 * busy one gets another chance on a later pass. The
+			 * cached wrappers keep their DMA mapping either way.
+			 */
+			next = curr;
+			for (i = 0; i < IPA_PAGE_RECYCLE_LOOKAHEAD; i++) {
+				next = (next + 1 == capacity) ? 0 : next + 1;
+				if (page_ref_count(
+					cache[next]->page_data.page) == 1) {
+					swap(cache[curr], cache[next]);
+					cur_page = cache[curr]->page_data.page;
+					ipa3_ctx->stats.page_recycle_stats[
+						stats_i].lookahead_hit++;
+					break;
+				}
+			}
+		}
 		/* Found an idle page that can be used */
 		if (page_ref_count(cur_page) == 1) {
 			page_ref_inc(cur_page);
-			rx_pkt = sys->page_recycle_repl->cache[curr];
-			curr = (++curr == sys->page_recycle_repl->capacity) ?
-								0 : curr;
+			rx_pkt = cache[curr];
+			curr = (++curr == capacity) ? 0 : curr;
 		} else {
 			/*
-			 * Could not find idle page at curr index.
+			 * Could not find idle page near curr index.
 			 * Allocate a new one.
 			 */
-			if (curr_wq == atomic_read(&sys->repl->tail_idx))
+			if (curr_wq == atomic_read(&sys->repl->tail_idx)) {
+				ipa3_ctx->stats.page_recycle_stats[
+					stats_i].pool_empty++;
 				break;
+			}
 			ipa3_ctx->stats.page_recycle_stats[stats_i].tmp_alloc++;
 			rx_pkt = sys->repl->cache[curr_wq];
 			curr_wq = (++curr_wq == sys->repl->capacity) ?
@@ -3348,6 +3601,7 @@ static struct sk_buff *handle_skb_completion(struct gsi_chan_xfer_notify
 	} else {
 		return NULL;
 	}
+	skb_lat_stamp(rx_skb, SKB_LAT_DRIVER);
 	return rx_skb;
 }
 
@@ -3445,6 +3699,7 @@ static struct sk_buff *handle_page_completion(struct gsi_chan_xfer_notify
 	} else {
 		return NULL;
 	}
+	skb_lat_stamp(rx_skb, SKB_LAT_DRIVER);
 	return rx_skb;
 }
 
@@ -4365,6 +4620,7 @@ void __ipa_gsi_irq_rx_scedule_poll(struct ipa3_sys_context *sys)
 	if (ipa3_ctx->use_ipa_pm) {
 		clk_off = ipa_pm_activate(sys->pm_hdl);
 		if (!clk_off && sys->napi_obj) {
+			atomic_set(&sys->napi_voted, 1);
 			napi_schedule(sys->napi_obj);
 			IPA_STATS_INC_CNT(sys->napi_sch_cnt);
 			return;
@@ -4380,6 +4636,7 @@ void __ipa_gsi_irq_rx_scedule_poll(struct ipa3_sys_context *sys)
 		clk_off = ipa3_inc_client_enable_clks_no_block(
 			&log);
 		if (!clk_off) {
+			atomic_set(&sys->napi_voted, 1);
 			napi_schedule(sys->napi_obj);
 			return;
 		}
@@ -4618,6 +4875,8 @@ static int ipa_gsi_setup_event_ring(struct ipa3_ep_context *ep,
 		ep->client,
 		gsi_evt_ring_props.int_modt,
 		gsi_evt_ring_props.int_modc);
+	ep->sys->adapt.hw_modt = gsi_evt_ring_props.int_modt;
+	ep->sys->adapt.hw_modc = gsi_evt_ring_props.int_modc;
 	gsi_evt_ring_props.rp_update_addr = 0;
 	gsi_evt_ring_props.exclusive = true;
 	gsi_evt_ring_props.err_cb = ipa_gsi_evt_ring_err_cb;
@@ -4889,21 +5148,20 @@ static int ipa_poll_gsi_n_pkt(struct ipa3_sys_context *sys,
 	return ret;
 }
 
-/**
- * ipa3_rx_poll() - Poll the rx packets from IPA HW. This
- * function is exectued in the softirq context
- *
- * if input budget is zero, the driver switches back to
- * interrupt mode.
- *
- * return number of polled packets, on error 0(zero)
- */
-int ipa3_rx_poll(u32 clnt_hdl, int weight)
+static DEFINE_LAT_HIST(ipa3_rx_poll_hist, "ipa_rx_poll");
+
+void ipa3_rx_poll_hist_init(void)
+{
+	lat_hist_register(&ipa3_rx_poll_hist);
+}
+
+static int __ipa3_rx_poll(u32 clnt_hdl, int weight)
 {
 	struct ipa3_ep_context *ep;
 	int ret;
 	int cnt = 0;
 	int num = 0;
+	int aggr_weight;
 	int remain_aggr_weight;
 	struct ipa_active_client_logging_info log;
 	struct gsi_chan_xfer_notify notify[IPA_WAN_NAPI_MAX_FRAMES];
@@ -4916,16 +5174,29 @@ int ipa3_rx_poll(u32 clnt_hdl, int weight)
 		return cnt;
 	}
 
-	remain_aggr_weight = weight / IPA_WAN_AGGR_PKT_CNT;
+	/* busy polling budgets may be smaller than one aggregated frame */
+	aggr_weight = DIV_ROUND_UP(weight, IPA_WAN_AGGR_PKT_CNT);
 
-	if (remain_aggr_weight > IPA_WAN_NAPI_MAX_FRAMES) {
+	if (aggr_weight > IPA_WAN_NAPI_MAX_FRAMES) {
 		IPAERR("NAPI weight is higher than expected\n");
 		IPAERR("expected %d got %d\n",
-			IPA_WAN_NAPI_MAX_FRAMES, remain_aggr_weight);
+			IPA_WAN_NAPI_MAX_FRAMES, aggr_weight);
 		return -EINVAL;
 	}
 
 	ep = &ipa3_ctx->ep[clnt_hdl];
+
+	/*
+	 * A busy polling socket may poll the pipe before the interrupt path
+	 * took the clock vote for it. IPA can't be touched then, and neither
+	 * the mode switch nor the vote are this poll's to undo.
+	 */
+	if (!atomic_read(&ep->sys->napi_voted)) {
+		napi_complete(ep->sys->napi_obj);
+		return 0;
+	}
+
+	remain_aggr_weight = aggr_weight;
 start_poll:
 	while (remain_aggr_weight > 0 &&
 			atomic_read(&ep->sys->curr_polling_state)) {
@@ -4943,6 +5214,7 @@ start_poll:
 		trace_ipa3_rx_poll_num(num);
 		ipa3_rx_napi_chain(ep->sys, notify, num);
 		remain_aggr_weight -= num;
+		ep->sys->adapt.events += num;
 
 		trace_ipa3_rx_poll_cnt(ep->sys->len);
 		if (ep->sys->len == 0) {
@@ -4951,7 +5223,8 @@ start_poll:
 			break;
 		}
 	}
-	cnt += weight - remain_aggr_weight * IPA_WAN_AGGR_PKT_CNT;
+	cnt += min(weight,
+		(aggr_weight - remain_aggr_weight) * IPA_WAN_AGGR_PKT_CNT);
 	/* call repl_hdlr before napi_reschedule / napi_complete */
 	ep->sys->repl_hdlr(ep->sys);
 
@@ -4959,12 +5232,23 @@ start_poll:
 	 * until minimum number descripotrs to replish.
 	 */
 	if (cnt < weight && ep->sys->len > IPA_DEFAULT_SYS_YELLOW_WM) {
-		napi_complete(ep->sys->napi_obj);
+		/*
+		 * A busy polling socket owns the NAPI and polls again
+		 * before letting go, stay in polling mode until then
+		 */
+		if (!napi_complete(ep->sys->napi_obj))
+			return cnt;
 		IPA_STATS_INC_CNT(ep->sys->napi_comp_cnt);
+		/* the next interrupt takes a vote of its own */
+		atomic_set(&ep->sys->napi_voted, 0);
 		ret = ipa3_rx_switch_to_intr_mode(ep->sys);
-		if (ret == -GSI_STATUS_PENDING_IRQ &&
-				napi_reschedule(ep->sys->napi_obj))
-			goto start_poll;
+		if (ret == -GSI_STATUS_PENDING_IRQ) {
+			atomic_set(&ep->sys->napi_voted, 1);
+			if (napi_reschedule(ep->sys->napi_obj))
+				goto start_poll;
+			/* busy polled, the owner completes with our vote */
+			return cnt;
+		}
 
 		if (ipa3_ctx->use_ipa_pm)
 			ipa_pm_deferred_deactivate(ep->sys->pm_hdl);
@@ -4979,6 +5263,26 @@ start_poll:
 	return cnt;
 }
 
+/**
+ * ipa3_rx_poll() - Poll the rx packets from IPA HW. This
+ * function is exectued in the softirq context
+ *
+ * if input budget is zero, the driver switches back to
+ * interrupt mode.
+ *
+ * return number of polled packets, on error 0(zero)
+ */
+int ipa3_rx_poll(u32 clnt_hdl, int weight)
+{
+	u64 start = lat_hist_start();
+	int cnt;
+
+	cnt = __ipa3_rx_poll(clnt_hdl, weight);
+	lat_hist_end(&ipa3_rx_poll_hist, start);
+
+	return cnt;
+}
+
 static unsigned long tag_to_pointer_wa(uint64_t tag)
 {
 	return 0xFFFF000000000000 | (unsigned long) tag;
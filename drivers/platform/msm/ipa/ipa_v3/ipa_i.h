@@ -1007,6 +1007,36 @@ struct ipa3_repl_ctx {
 	atomic_t tail_idx;
 	u32 capacity;
 	atomic_t pending;
+	ktime_t queued_ts;
+};
+
+/* TX doorbell batch size buckets: 1, 2, 3-4, 5-8, 9-16, 17+ descs */
+#define IPA_TX_DB_BATCH_BUCKETS 6
+
+/**
+ * struct ipa3_rx_adapt - adaptive polling / interrupt moderation state
+ * @window_start: start of the current completion rate sample
+ * @events: completions seen since @window_start
+ * @rate: smoothed completion rate, in events per millisecond
+ * @poll_sleep_us: sleep between polls of the workqueue polling loop
+ * @poll_inactivity: idle polls before falling back to interrupt mode
+ * @modt: event ring timer moderation wanted, in 32KHz cycles
+ * @modc: event ring packet count moderation wanted
+ * @hw_modt: timer moderation currently programmed in the event ring
+ * @hw_modc: count moderation currently programmed in the event ring
+ * @work: reprograms the event ring moderation from process context
+ */
+struct ipa3_rx_adapt {
+	ktime_t window_start;
+	u32 events;
+	u32 rate;
+	u32 poll_sleep_us;
+	u32 poll_inactivity;
+	u16 modt;
+	u8 modc;
+	u16 hw_modt;
+	u8 hw_modc;
+	struct work_struct work;
 };
 
 /**
@@ -1017,12 +1047,14 @@ struct ipa3_repl_ctx {
  * @ep: IPA EP context
  * @xmit_eot_cnt: count of pending eot for tasklet to process
  * @tasklet: tasklet for eot write_done handle (tx_complete)
+ * @napi_voted: NAPI polling of the pipe holds an IPA clock vote
  *
  * IPA context specific to the GPI pipes a.k.a LAN IN/OUT and WAN
  */
 struct ipa3_sys_context {
 	u32 len;
 	atomic_t curr_polling_state;
+	atomic_t napi_voted;
 	atomic_t workqueue_flushed;
 	struct delayed_work switch_to_intr_work;
 	enum ipa3_sys_pipe_policy policy;
@@ -1052,6 +1084,9 @@ struct ipa3_sys_context {
 	struct tasklet_struct tasklet;
 	bool skip_eot;
 	u32 eob_drop_cnt;
+	struct ipa3_rx_adapt adapt;
+	u32 db_deferred;
+	u32 db_batch_hist[IPA_TX_DB_BATCH_BUCKETS];
 
 	/* ordering is important - mutable fields go above */
 	struct ipa3_ep_context *ep;
@@ -1199,6 +1234,70 @@ struct ipa3_nat_ipv6ct_tmp_mem {
 	dma_addr_t dma_handle;
 };
 
+#define IPA_NAT_AGE_REPORT_MAX 16
+
+/**
+ * struct ipa3_nat_flow - aging shadow of one NAT/IPv6CT table entry
+ * @time_stamp: H/W time stamp seen on the previous scan
+ * @last_hit: jiffies when @time_stamp was last seen changing
+ * @hits: decaying count of scans that found the entry hit
+ * @valid: entry held a valid flow on the previous scan
+ */
+struct ipa3_nat_flow {
+	u32 time_stamp;
+	unsigned long last_hit;
+	u16 hits;
+	bool valid;
+};
+
+/**
+ * struct ipa3_nat_age - incremental aging and hit telemetry of a table
+ * @work: scans the next batch of entries
+ * @flows: one shadow per base and expansion table entry
+ * @num_flows: number of entries in @flows
+ * @nmi: memory the table lived in when @flows was set up
+ * @next: next entry to scan
+ * @scan_active: valid entries seen so far in the pass in progress
+ * @scan_hot: entries at or above nat_hot_hits in the pass in progress
+ * @scan_aged: idle entries seen so far in the pass in progress
+ * @scan_hot_idx: hottest entries of the pass in progress
+ * @scan_num_hot: number of valid slots in @scan_hot_idx
+ * @scan_aged_idx: first idle entries of the pass in progress
+ * @scan_num_aged: number of valid slots in @scan_aged_idx
+ * @active: valid entries found by the last complete pass
+ * @hot: hot entries found by the last complete pass
+ * @aged: entries idle for longer than nat_age_timeout_ms in the last pass
+ * @passes: number of complete passes over the table
+ * @hot_idx: hottest entries of the last complete pass
+ * @num_hot: number of valid slots in @hot_idx
+ * @aged_idx: first idle entries of the last complete pass
+ * @num_aged: number of valid slots in @aged_idx
+ */
+struct ipa3_nat_age {
+	struct delayed_work   work;
+	struct ipa3_nat_flow *flows;
+	u32                   num_flows;
+	enum ipa3_nat_mem_in  nmi;
+	u32                   next;
+
+	u32                   scan_active;
+	u32                   scan_hot;
+	u32                   scan_aged;
+	u32                   scan_hot_idx[IPA_NAT_AGE_REPORT_MAX];
+	u32                   scan_num_hot;
+	u32                   scan_aged_idx[IPA_NAT_AGE_REPORT_MAX];
+	u32                   scan_num_aged;
+
+	u32                   active;
+	u32                   hot;
+	u32                   aged;
+	u64                   passes;
+	u32                   hot_idx[IPA_NAT_AGE_REPORT_MAX];
+	u32                   num_hot;
+	u32                   aged_idx[IPA_NAT_AGE_REPORT_MAX];
+	u32                   num_aged;
+};
+
 /**
  * struct ipa3_nat_ipv6ct_common_mem - IPA NAT/IPv6CT memory device
  * @name: the device name
@@ -1223,6 +1322,7 @@ struct ipa3_nat_ipv6ct_tmp_mem {
  * @table_entries: num of entries in the base table
  * @expn_table_entries: num of entries in the expansion table
  * @tmp_mem: temporary memory used to always provide HW with a legal memory
+ * @age: kernel side flow aging and hit telemetry
  */
 struct ipa3_nat_ipv6ct_common_mem {
 	char           name[IPA_DEV_NAME_MAX_LEN];
@@ -1252,6 +1352,8 @@ struct ipa3_nat_ipv6ct_common_mem {
 	u32            expn_table_entries;
 
 	struct ipa3_nat_ipv6ct_tmp_mem *tmp_mem;
+
+	struct ipa3_nat_age age;
 };
 
 /**
@@ -1370,6 +1472,10 @@ enum ipa3_config_this_ep {
 struct ipa3_page_recycle_stats {
 	u64 total_replenished;
 	u64 tmp_alloc;
+	u64 lookahead_hit;
+	u64 pool_empty;
+	u64 refill_lat_last_us;
+	u64 refill_lat_max_us;
 };
 struct ipa3_stats {
 	u32 tx_sw_pkts;
@@ -2553,6 +2659,8 @@ int ipa3_nat_init_cmd(struct ipa_ioc_v4_nat_init *init);
 int ipa3_ipv6ct_init_cmd(struct ipa_ioc_ipv6ct_init *init);
 
 int ipa3_table_dma_cmd(struct ipa_ioc_nat_dma_cmd *dma);
+int ipa3_nat_age_show(struct ipa3_nat_ipv6ct_common_mem *dev,
+	char *buf, int size);
 int ipa3_nat_dma_cmd(struct ipa_ioc_nat_dma_cmd *dma);
 
 int ipa3_nat_del_cmd(struct ipa_ioc_v4_nat_del *del);
@@ -3115,6 +3223,7 @@ int ipa3_register_ipa_ready_cb(void (*ipa_ready_cb)(void *), void *user_data);
 const char *ipa_hw_error_str(enum ipa3_hw_errors err_type);
 int ipa_gsi_ch20_wa(void);
 int ipa3_rx_poll(u32 clnt_hdl, int budget);
+void ipa3_rx_poll_hist_init(void);
 int ipa3_smmu_map_peer_reg(phys_addr_t phys_addr, bool map,
 	enum ipa_smmu_cb_type cb_type);
 int ipa3_smmu_map_peer_buff(u64 iova, u32 size, bool map, struct sg_table *sgt,
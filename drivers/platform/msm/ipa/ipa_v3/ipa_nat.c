@@ -16,6 +16,7 @@
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include "ipa_i.h"
 #include "ipahal/ipahal.h"
 #include "ipahal/ipahal_nat.h"
@@ -37,7 +38,11 @@
 
 #define IPA_NAT_MAX_NUM_OF_INIT_CMD_DESC 4
 #define IPA_IPV6CT_MAX_NUM_OF_INIT_CMD_DESC 3
-#define IPA_MAX_NUM_OF_TABLE_DMA_CMD_DESC 5
+/*
+ * A whole batch of table updates goes to H/W as one IC list, bounded by
+ * the descriptors a single GSI transfer may carry
+ */
+#define IPA_MAX_NUM_OF_TABLE_DMA_CMD_DESC 20
 
 /*
  * The base table max entries is limited by index into table 13 bits number.
@@ -60,6 +65,32 @@ enum ipa_nat_ipv6ct_table_type {
 
 static bool sram_compatible;
 
+/*
+ * Kernel side aging of NAT/IPv6CT entries. Every nat_age_scan_ms the next
+ * nat_age_batch entries are compared against the time stamp H/W refreshed
+ * on their last hit, so a whole table is covered incrementally without
+ * userspace polling. 0 disables the scan.
+ */
+static unsigned int nat_age_scan_ms = 1000;
+module_param(nat_age_scan_ms, uint, 0644);
+MODULE_PARM_DESC(nat_age_scan_ms,
+	"NAT/IPv6CT aging scan interval in msec, 0 to disable");
+
+static unsigned int nat_age_batch = 256;
+module_param(nat_age_batch, uint, 0644);
+MODULE_PARM_DESC(nat_age_batch,
+	"NAT/IPv6CT entries checked per aging scan");
+
+static unsigned int nat_age_timeout_ms = 30000;
+module_param(nat_age_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(nat_age_timeout_ms,
+	"Idle time in msec after which a NAT/IPv6CT entry is reported aged");
+
+static unsigned int nat_hot_hits = 4;
+module_param(nat_hot_hits, uint, 0644);
+MODULE_PARM_DESC(nat_hot_hits,
+	"Decayed hit count at which a NAT/IPv6CT entry is reported hot");
+
 static int ipa3_nat_ipv6ct_vma_fault_remap(struct vm_fault *vmf)
 {
 	vmf->page = NULL;
@@ -336,6 +367,303 @@ bail_tmp_mem:
 	return NULL;
 }
 
+/*
+ * Keep the IPA_NAT_AGE_REPORT_MAX hottest entries of a pass, replacing
+ * the coldest reported one once the report is full
+ */
+static void ipa3_nat_age_report_hot(
+	struct ipa3_nat_age *age,
+	u32 idx)
+{
+	u32 i, coldest = 0;
+
+	if (age->scan_num_hot < IPA_NAT_AGE_REPORT_MAX) {
+		age->scan_hot_idx[age->scan_num_hot++] = idx;
+		return;
+	}
+
+	for (i = 1; i < age->scan_num_hot; ++i)
+		if (age->flows[age->scan_hot_idx[i]].hits <
+			age->flows[age->scan_hot_idx[coldest]].hits)
+			coldest = i;
+
+	if (age->flows[idx].hits > age->flows[age->scan_hot_idx[coldest]].hits)
+		age->scan_hot_idx[coldest] = idx;
+}
+
+static void ipa3_nat_age_end_pass(
+	struct ipa3_nat_age *age)
+{
+	age->active   = age->scan_active;
+	age->hot      = age->scan_hot;
+	age->aged     = age->scan_aged;
+	age->num_hot  = age->scan_num_hot;
+	age->num_aged = age->scan_num_aged;
+
+	memcpy(age->hot_idx, age->scan_hot_idx, sizeof(age->hot_idx));
+	memcpy(age->aged_idx, age->scan_aged_idx, sizeof(age->aged_idx));
+
+	age->scan_active   = 0;
+	age->scan_hot      = 0;
+	age->scan_aged     = 0;
+	age->scan_num_hot  = 0;
+	age->scan_num_aged = 0;
+
+	age->next = 0;
+	age->passes++;
+}
+
+/*
+ * Returns the address of an entry, numbering the expansion table entries
+ * after the base table ones
+ */
+static char *ipa3_nat_age_entry(
+	struct ipa3_nat_ipv6ct_common_mem *dev,
+	u32 idx,
+	size_t entry_size)
+{
+	char *base_table_addr, *expansion_table_addr;
+	u32 base_entries;
+
+	if (dev->is_nat_mem) {
+		struct ipa3_nat_mem *nm_ptr = (struct ipa3_nat_mem *) dev;
+		struct ipa3_nat_mem_loc_data *mld_ptr =
+			&nm_ptr->mem_loc[dev->age.nmi];
+
+		base_table_addr      = mld_ptr->base_table_addr;
+		expansion_table_addr = mld_ptr->expansion_table_addr;
+		base_entries         = mld_ptr->table_entries + 1;
+	} else {
+		base_table_addr      = dev->base_table_addr;
+		expansion_table_addr = dev->expansion_table_addr;
+		base_entries         = dev->table_entries + 1;
+	}
+
+	if (idx < base_entries)
+		return base_table_addr + idx * entry_size;
+
+	return expansion_table_addr + (idx - base_entries) * entry_size;
+}
+
+static void ipa3_nat_age_scan(
+	struct ipa3_nat_ipv6ct_common_mem *dev)
+{
+	struct ipa3_nat_age *age = &dev->age;
+	enum ipahal_nat_type nat_type =
+		dev->is_nat_mem ? IPAHAL_NAT_IPV4 : IPAHAL_NAT_IPV6CT;
+	unsigned long timeout = msecs_to_jiffies(nat_age_timeout_ms);
+	unsigned long now = jiffies;
+	size_t entry_size;
+	u32 end;
+
+	if (ipahal_nat_entry_size(nat_type, &entry_size))
+		return;
+
+	end = min_t(u32, age->next + max_t(u32, nat_age_batch, 1),
+		age->num_flows);
+
+	for (; age->next < end; ++age->next) {
+		struct ipa3_nat_flow *flow = &age->flows[age->next];
+		char *entry = ipa3_nat_age_entry(dev, age->next, entry_size);
+		bool entry_zeroed, entry_valid = false;
+		u32 time_stamp;
+
+		if (ipahal_nat_is_entry_zeroed(nat_type, entry, &entry_zeroed))
+			return;
+
+		if (!entry_zeroed &&
+			ipahal_nat_is_entry_valid(nat_type, entry, &entry_valid))
+			return;
+
+		if (!entry_valid) {
+			flow->valid = false;
+			continue;
+		}
+
+		if (ipahal_nat_entry_timestamp(nat_type, entry, &time_stamp))
+			return;
+
+		if (!flow->valid) {
+			/* new flow; the time stamp is its setup, not a hit */
+			flow->valid      = true;
+			flow->time_stamp = time_stamp;
+			flow->last_hit   = now;
+			flow->hits       = 0;
+		} else if (flow->time_stamp != time_stamp) {
+			flow->time_stamp = time_stamp;
+			flow->last_hit   = now;
+			if (flow->hits < U16_MAX)
+				flow->hits++;
+		} else {
+			flow->hits >>= 1;
+		}
+
+		age->scan_active++;
+
+		if (nat_hot_hits && flow->hits >= nat_hot_hits) {
+			age->scan_hot++;
+			ipa3_nat_age_report_hot(age, age->next);
+		}
+
+		if (time_after(now, flow->last_hit + timeout)) {
+			if (age->scan_num_aged < IPA_NAT_AGE_REPORT_MAX)
+				age->scan_aged_idx[age->scan_num_aged++] =
+					age->next;
+			age->scan_aged++;
+		}
+	}
+
+	if (age->next >= age->num_flows)
+		ipa3_nat_age_end_pass(age);
+}
+
+static void ipa3_nat_age_work(struct work_struct *work)
+{
+	struct ipa3_nat_age *age =
+		container_of(to_delayed_work(work), struct ipa3_nat_age, work);
+	struct ipa3_nat_ipv6ct_common_mem *dev =
+		container_of(age, struct ipa3_nat_ipv6ct_common_mem, age);
+	struct ipa_active_client_logging_info log_info;
+	bool clk_on = false;
+
+	mutex_lock(&dev->lock);
+
+	if (!dev->is_hw_init || !age->flows) {
+		mutex_unlock(&dev->lock);
+		return;
+	}
+
+	/*
+	 * A table in SRAM can only be read with IPA clocked. Don't wake IPA
+	 * up for it: without clocks nothing hits the table either.
+	 */
+	if (age->nmi == IPA_NAT_MEM_IN_SRAM) {
+		IPA_ACTIVE_CLIENTS_PREP_SPECIAL(log_info, "NAT_AGE");
+		clk_on = !ipa3_inc_client_enable_clks_no_block(&log_info);
+		if (!clk_on)
+			goto resched;
+	}
+
+	ipa3_nat_age_scan(dev);
+
+	if (clk_on)
+		ipa3_dec_client_disable_clks(&log_info);
+
+resched:
+	if (nat_age_scan_ms)
+		queue_delayed_work(system_power_efficient_wq, &age->work,
+			msecs_to_jiffies(nat_age_scan_ms));
+
+	mutex_unlock(&dev->lock);
+}
+
+/*
+ * Must be called without dev->lock held, the aging work takes it
+ */
+static void ipa3_nat_age_stop(
+	struct ipa3_nat_ipv6ct_common_mem *dev)
+{
+	cancel_delayed_work_sync(&dev->age.work);
+}
+
+/*
+ * (Re)starts aging over the table H/W was just initialized with. Hit
+ * history of a previous table does not carry over.
+ */
+static void ipa3_nat_age_start(
+	struct ipa3_nat_ipv6ct_common_mem *dev,
+	enum ipa3_nat_mem_in nmi,
+	u32 table_entries,
+	u32 expn_table_entries)
+{
+	struct ipa3_nat_age *age = &dev->age;
+	struct ipa3_nat_flow *flows;
+	u32 num_flows = table_entries + 1 + expn_table_entries;
+
+	ipa3_nat_age_stop(dev);
+
+	flows = vzalloc(num_flows * sizeof(*flows));
+	if (!flows)
+		IPAERR("%s: no memory to age %u entries\n",
+			dev->name, num_flows);
+
+	mutex_lock(&dev->lock);
+
+	/* everything past the work itself is per table state */
+	vfree(age->flows);
+	memset(&age->flows, 0,
+		sizeof(*age) - offsetof(struct ipa3_nat_age, flows));
+
+	age->flows = flows;
+	age->num_flows = flows ? num_flows : 0;
+	age->nmi = nmi;
+
+	if (flows && nat_age_scan_ms)
+		queue_delayed_work(system_power_efficient_wq, &age->work,
+			msecs_to_jiffies(nat_age_scan_ms));
+
+	mutex_unlock(&dev->lock);
+}
+
+/*
+ * Must be called with dev->lock held
+ */
+static void ipa3_nat_age_free(
+	struct ipa3_nat_ipv6ct_common_mem *dev)
+{
+	vfree(dev->age.flows);
+	dev->age.flows = NULL;
+	dev->age.num_flows = 0;
+}
+
+/**
+ * ipa3_nat_age_show() - Prints the aging and hit telemetry of a table
+ * @dev:	[in] NAT or IPv6CT device
+ * @buf:	[out] output buffer
+ * @size:	[in] size of @buf
+ *
+ * Entry indices follow the rule ids of the ip4_nat/ipv6ct debugfs dumps:
+ * base table entries first, expansion table entries after them.
+ *
+ * Returns:	number of bytes written to @buf
+ */
+int ipa3_nat_age_show(
+	struct ipa3_nat_ipv6ct_common_mem *dev,
+	char *buf,
+	int size)
+{
+	struct ipa3_nat_age *age = &dev->age;
+	int cnt = 0;
+	u32 i;
+
+	if (!dev->is_dev_init)
+		return 0;
+
+	mutex_lock(&dev->lock);
+
+	cnt += scnprintf(buf + cnt, size - cnt,
+		"%s: entries=%u passes=%llu active=%u hot=%u aged=%u\n",
+		dev->name, age->num_flows, age->passes,
+		age->active, age->hot, age->aged);
+
+	cnt += scnprintf(buf + cnt, size - cnt, "  hot:");
+	for (i = 0; i < age->num_hot; ++i)
+		cnt += scnprintf(buf + cnt, size - cnt, " %u/%u",
+			age->hot_idx[i], age->flows ?
+			age->flows[age->hot_idx[i]].hits : 0);
+
+	cnt += scnprintf(buf + cnt, size - cnt, "\n  aged:");
+	for (i = 0; i < age->num_aged; ++i)
+		cnt += scnprintf(buf + cnt, size - cnt, " %u",
+			age->aged_idx[i]);
+
+	cnt += scnprintf(buf + cnt, size - cnt, "\n");
+
+	mutex_unlock(&dev->lock);
+
+	return cnt;
+}
+
 static int ipa3_nat_ipv6ct_init_device(
 	struct ipa3_nat_ipv6ct_common_mem *dev,
 	const char                        *name,
@@ -348,6 +676,7 @@ static int ipa3_nat_ipv6ct_init_device(
 	IPADBG("In: Init of %s\n", name);
 
 	mutex_init(&dev->lock);
+	INIT_DELAYED_WORK(&dev->age.work, ipa3_nat_age_work);
 
 	dev->is_nat_mem    = IS_NAT_MEM_DEV(dev);
 	dev->is_ipv6ct_mem = IS_IPV6CT_MEM_DEV(dev);
@@ -432,8 +761,12 @@ static void ipa3_nat_ipv6ct_destroy_device(
 {
 	IPADBG("In\n");
 
+	ipa3_nat_age_stop(dev);
+
 	mutex_lock(&dev->lock);
 
+	ipa3_nat_age_free(dev);
+
 	if (dev->tmp_mem) {
 		if (ipa3_ctx->nat_mem.is_tmp_mem_allocated) {
 			dma_free_coherent(
@@ -1416,6 +1749,8 @@ int ipa3_nat_init_cmd(
 
 	nmi = init->mem_type;
 
+	ipa3_nat_age_stop(dev);
+
 	IPADBG("tbl_index(%d) table_entries(%u)\n",
 			  init->tbl_index,
 			  init->table_entries);
@@ -1566,6 +1901,9 @@ int ipa3_nat_init_cmd(
 
 	dev->is_hw_init = true;
 
+	ipa3_nat_age_start(dev, nmi,
+		init->table_entries, init->expn_table_entries);
+
 bail:
 	IPADBG("Out\n");
 
@@ -1598,6 +1936,8 @@ int ipa3_ipv6ct_init_cmd(
 		return -EPERM;
 	}
 
+	ipa3_nat_age_stop(dev);
+
 	if (!IPA_VALID_TBL_INDEX(init->tbl_index)) {
 		IPAERR_RL("Unsupported table index %d\n", init->tbl_index);
 		return -EPERM;
@@ -1670,6 +2010,9 @@ int ipa3_ipv6ct_init_cmd(
 
 	dev->is_hw_init = true;
 
+	ipa3_nat_age_start(dev, IPA_NAT_MEM_IN_DDR,
+		init->table_entries, init->expn_table_entries);
+
 	IPADBG("Out\n");
 
 	return 0;
@@ -1930,8 +2273,8 @@ int ipa3_table_dma_cmd(
 	enum ipahal_imm_cmd_name cmd_name = IPA_IMM_CMD_NAT_DMA;
 
 	struct ipahal_imm_cmd_table_dma cmd;
-	struct ipahal_imm_cmd_pyld *cmd_pyld[IPA_MAX_NUM_OF_TABLE_DMA_CMD_DESC];
-	struct ipa3_desc desc[IPA_MAX_NUM_OF_TABLE_DMA_CMD_DESC];
+	struct ipahal_imm_cmd_pyld **cmd_pyld = NULL;
+	struct ipa3_desc *desc = NULL;
 
 	uint8_t cnt, num_cmd = 0;
 
@@ -1947,8 +2290,6 @@ int ipa3_table_dma_cmd(
 		dma->mem_type = 0;
 
 	memset(&cmd, 0, sizeof(cmd));
-	memset(desc, 0, sizeof(desc));
-	memset(cmd_pyld, 0, sizeof(cmd_pyld));
 
 	if (!dev->is_dev_init) {
 		IPAERR_RL("NAT hasn't been initialized\n");
@@ -1993,6 +2334,15 @@ int ipa3_table_dma_cmd(
 		}
 	}
 
+	desc = kcalloc(IPA_MAX_NUM_OF_TABLE_DMA_CMD_DESC, sizeof(*desc),
+		GFP_KERNEL);
+	cmd_pyld = kcalloc(IPA_MAX_NUM_OF_TABLE_DMA_CMD_DESC,
+		sizeof(*cmd_pyld), GFP_KERNEL);
+	if (!desc || !cmd_pyld) {
+		result = -ENOMEM;
+		goto free_desc;
+	}
+
 	/*
 	 * IC to close the coal frame before HPS Clear if coal is enabled
 	 */
@@ -2069,6 +2419,10 @@ destroy_imm_cmd:
 	for (cnt = 0; cnt < num_cmd; ++cnt)
 		ipahal_destroy_imm_cmd(cmd_pyld[cnt]);
 
+free_desc:
+	kfree(cmd_pyld);
+	kfree(desc);
+
 bail:
 	IPADBG("Out\n");
 
@@ -2364,6 +2718,8 @@ int ipa3_del_nat_table(
 
 	mld_ptr = &nm_ptr->mem_loc[nmi];
 
+	ipa3_nat_age_stop(dev);
+
 	mutex_lock(&dev->lock);
 
 	if (dev->is_hw_init) {
@@ -2399,6 +2755,8 @@ int ipa3_del_nat_table(
 		pdn_mem_ptr->base = NULL;
 	}
 
+	ipa3_nat_age_free(dev);
+
 	ipa3_nat_ipv6ct_free_mem(dev);
 
 unlock:
@@ -2442,6 +2800,8 @@ int ipa3_del_ipv6ct_table(
 		goto bail;
 	}
 
+	ipa3_nat_age_stop(dev);
+
 	mutex_lock(&dev->lock);
 
 	if (dev->is_hw_init) {
@@ -2453,6 +2813,8 @@ int ipa3_del_ipv6ct_table(
 		}
 	}
 
+	ipa3_nat_age_free(dev);
+
 	ipa3_nat_ipv6ct_free_mem(&ipa3_ctx->ipv6ct_mem.dev);
 
 unlock:
@@ -107,6 +107,20 @@ static bool ipa_nat_ipv6ct_is_entry_valid_v_4_0(const void *entry)
 		hw_entry->protocol != IPAHAL_NAT_INVALID_PROTOCOL;
 }
 
+static u32 ipa_nat_ipv4_get_timestamp_v_3_0(const void *entry)
+{
+	const struct ipa_nat_hw_ipv4_entry *hw_entry = entry;
+
+	return hw_entry->time_stamp;
+}
+
+static u32 ipa_nat_ipv6ct_get_timestamp_v_4_0(const void *entry)
+{
+	const struct ipa_nat_hw_ipv6ct_entry *hw_entry = entry;
+
+	return hw_entry->time_stamp;
+}
+
 static int ipa_nat_ipv4_stringify_entry_v_3_0(const void *entry,
 	char *buff, size_t buff_size)
 {
@@ -303,6 +317,7 @@ static void ipa_nat_ipv4_pdn_parse_entry_v_4_0(void *fields,
  * @stringify_entry - CB to create string that represents an entry
  * @construct_entry - CB to create NAT entry using the given fields
  * @parse_entry - CB to parse NAT entry to the given fields structure
+ * @get_timestamp - CB to read the time stamp H/W updates on every hit
  */
 struct ipahal_nat_obj {
 	size_t (*entry_size)(void);
@@ -311,6 +326,7 @@ struct ipahal_nat_obj {
 	int (*stringify_entry)(const void *entry, char *buff, size_t buff_size);
 	void (*construct_entry)(const void *fields, u32 *address);
 	void (*parse_entry)(void *fields, const u32 *address);
+	u32 (*get_timestamp)(const void *entry);
 };
 
 /*
@@ -328,7 +344,8 @@ static struct ipahal_nat_obj ipahal_nat_objs[IPA_HW_MAX][IPA_NAT_MAX] = {
 			ipa_nat_ipv4_entry_size_v_3_0,
 			ipa_nat_ipv4_is_entry_zeroed_v_3_0,
 			ipa_nat_ipv4_is_entry_valid_v_3_0,
-			ipa_nat_ipv4_stringify_entry_v_3_0
+			ipa_nat_ipv4_stringify_entry_v_3_0,
+			.get_timestamp = ipa_nat_ipv4_get_timestamp_v_3_0
 		},
 	[IPA_HW_v3_0][IPAHAL_NAT_IPV4_INDEX] = {
 			ipa_nat_ipv4_index_entry_size_v_3_0,
@@ -342,7 +359,8 @@ static struct ipahal_nat_obj ipahal_nat_objs[IPA_HW_MAX][IPA_NAT_MAX] = {
 			ipa_nat_ipv4_entry_size_v_3_0,
 			ipa_nat_ipv4_is_entry_zeroed_v_3_0,
 			ipa_nat_ipv4_is_entry_valid_v_3_0,
-			ipa_nat_ipv4_stringify_entry_v_4_0
+			ipa_nat_ipv4_stringify_entry_v_4_0,
+			.get_timestamp = ipa_nat_ipv4_get_timestamp_v_3_0
 		},
 	[IPA_HW_v4_0][IPAHAL_NAT_IPV4_PDN] = {
 			ipa_nat_ipv4_pdn_entry_size_v_4_0,
@@ -356,7 +374,8 @@ static struct ipahal_nat_obj ipahal_nat_objs[IPA_HW_MAX][IPA_NAT_MAX] = {
 			ipa_nat_ipv6ct_entry_size_v_4_0,
 			ipa_nat_ipv6ct_is_entry_zeroed_v_4_0,
 			ipa_nat_ipv6ct_is_entry_valid_v_4_0,
-			ipa_nat_ipv6ct_stringify_entry_v_4_0
+			ipa_nat_ipv6ct_stringify_entry_v_4_0,
+			.get_timestamp = ipa_nat_ipv6ct_get_timestamp_v_4_0
 		},
 
 	/* IPAv4.5 */
@@ -364,13 +383,15 @@ static struct ipahal_nat_obj ipahal_nat_objs[IPA_HW_MAX][IPA_NAT_MAX] = {
 			ipa_nat_ipv4_entry_size_v_3_0,
 			ipa_nat_ipv4_is_entry_zeroed_v_3_0,
 			ipa_nat_ipv4_is_entry_valid_v_3_0,
-			ipa_nat_ipv4_stringify_entry_v_4_5
+			ipa_nat_ipv4_stringify_entry_v_4_5,
+			.get_timestamp = ipa_nat_ipv4_get_timestamp_v_3_0
 		},
 	[IPA_HW_v4_5][IPAHAL_NAT_IPV6CT] = {
 			ipa_nat_ipv6ct_entry_size_v_4_0,
 			ipa_nat_ipv6ct_is_entry_zeroed_v_4_0,
 			ipa_nat_ipv6ct_is_entry_valid_v_4_0,
-			ipa_nat_ipv6ct_stringify_entry_v_4_5
+			ipa_nat_ipv6ct_stringify_entry_v_4_5,
+			.get_timestamp = ipa_nat_ipv6ct_get_timestamp_v_4_0
 		}
 };
 
@@ -496,6 +517,27 @@ int ipahal_nat_is_entry_valid(enum ipahal_nat_type nat_type, void *entry,
 	return 0;
 }
 
+int ipahal_nat_entry_timestamp(enum ipahal_nat_type nat_type,
+	const void *entry, u32 *time_stamp)
+{
+	struct ipahal_nat_obj *nat_obj;
+
+	if (WARN(entry == NULL || time_stamp == NULL,
+		"NULL pointer received\n"))
+		return -EINVAL;
+	if (WARN(nat_type < 0 || nat_type >= IPA_NAT_MAX,
+		"requested NAT type %d is invalid\n", nat_type))
+		return -EINVAL;
+
+	nat_obj = &ipahal_nat_objs[ipahal_ctx->hw_type][nat_type];
+	if (!nat_obj->get_timestamp)
+		return -EPERM;
+
+	*time_stamp = nat_obj->get_timestamp(entry);
+
+	return 0;
+}
+
 int ipahal_nat_stringify_entry(enum ipahal_nat_type nat_type, void *entry,
 	char *buff, size_t buff_size)
 {
@@ -76,6 +76,17 @@ int ipahal_nat_is_entry_zeroed(enum ipahal_nat_type nat_type, void *entry,
 int ipahal_nat_is_entry_valid(enum ipahal_nat_type nat_type, void *entry,
 	bool *entry_valid);
 
+/*
+ * ipahal_nat_entry_timestamp() - Reads the time stamp of HW NAT entry
+ *  H/W refreshes the time stamp whenever a packet hits the entry, so a
+ *  change between two reads means the flow carried traffic.
+ * @nat_type: [in] The type of the NAT entry
+ * @entry: [in] The NAT entry
+ * @time_stamp: [out] The entry's time stamp
+ */
+int ipahal_nat_entry_timestamp(enum ipahal_nat_type nat_type,
+	const void *entry, u32 *time_stamp);
+
 /*
  * ipahal_nat_stringify_entry() - Creates a string for HW NAT entry
  * @nat_type: [in] The type of the NAT entry
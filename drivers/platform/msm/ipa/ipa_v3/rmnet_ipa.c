@@ -25,8 +25,11 @@
 #include <linux/of_device.h>
 #include <linux/string.h>
 #include <linux/skbuff.h>
+#include <linux/smp.h>
 #include <linux/version.h>
 #include <linux/workqueue.h>
+#include <net/busy_poll.h>
+#include <net/flow_dissector.h>
 #include <net/pkt_sched.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
@@ -57,6 +60,16 @@ static unsigned int outstanding_low = OUTSTANDING_LOW_DEFAULT;
 module_param(outstanding_low, uint, 0644);
 MODULE_PARM_DESC(outstanding_low, "Outstanding low");
 
+static int ipa3_wwan_rx_queue_stats_get(char *buffer,
+				       const struct kernel_param *kp);
+
+static const struct kernel_param_ops rx_queue_stats_ops = {
+	.get = ipa3_wwan_rx_queue_stats_get,
+};
+module_param_cb(rx_queue_stats, &rx_queue_stats_ops, NULL, 0444);
+MODULE_PARM_DESC(rx_queue_stats,
+	"Per downlink fan-out queue: cpu packets bytes drops kicks");
+
 #define WWAN_METADATA_SHFT 24
 #define WWAN_METADATA_MASK 0xFF000000
 #define WWAN_DATA_LEN 9216
@@ -114,6 +127,38 @@ struct ipa3_rmnet_plat_drv_res {
 	bool ipa_advertise_sg_support;
 	bool ipa_napi_enable;
 	u32 wan_rx_desc_size;
+	u32 napi_rx_cpumask;
+};
+
+#define IPA_WWAN_MAX_RX_QUEUES 8
+
+/**
+ * struct ipa3_wwan_rx_queue - downlink fan-out queue
+ * @skbs: MAP frames waiting to be handed to the stack on @cpu
+ * @napi: NAPI context polling @skbs
+ * @csd: IPI used to schedule @napi on @cpu
+ * @kick_pending: @csd is in flight
+ * @cpu: CPU the queue is processed on
+ * @packets: frames queued
+ * @bytes: bytes queued
+ * @drops: frames dropped because @skbs was full or the stack refused them
+ * @kicks: IPIs sent to schedule @napi
+ *
+ * With qcom,ipa-napi-rx-cpumask set, the WAN NAPI poll only splits what IPA
+ * delivers into MAP frames and spreads them over one such queue per CPU in
+ * the mask, by flow hash, so that MAP deaggregation, checksum offload and GRO
+ * for different flows run in parallel.
+ */
+struct ipa3_wwan_rx_queue {
+	struct sk_buff_head skbs;
+	struct napi_struct napi;
+	call_single_data_t csd;
+	unsigned long kick_pending;
+	int cpu;
+	u64 packets;
+	u64 bytes;
+	u64 drops;
+	u64 kicks;
 };
 
 /**
@@ -136,6 +181,8 @@ struct ipa3_wwan_private {
 	struct completion resource_granted_completion;
 	enum ipa3_wwan_device_status device_status;
 	struct napi_struct napi;
+	unsigned int nr_rx_queues;
+	struct ipa3_wwan_rx_queue rx_queues[IPA_WWAN_MAX_RX_QUEUES];
 };
 
 struct rmnet_ipa3_context {
@@ -1132,6 +1179,228 @@ int ipa3_wwan_update_mux_channel_prop(void)
 #define reinit_completion(x) INIT_COMPLETION(*(x))
 #endif /* INIT_COMPLETION */
 
+static int ipa3_wwan_rx_queue_poll(struct napi_struct *napi, int budget)
+{
+	struct ipa3_wwan_rx_queue *q =
+		container_of(napi, struct ipa3_wwan_rx_queue, napi);
+	struct sk_buff *skb;
+	int done = 0;
+
+	while (done < budget && (skb = skb_dequeue(&q->skbs))) {
+		if (netif_receive_skb(skb))
+			q->drops++;
+		done++;
+	}
+
+	if (done < budget && napi_complete_done(napi, done) &&
+	    !skb_queue_empty(&q->skbs))
+		napi_schedule(napi);
+
+	return done;
+}
+
+/* Runs on q->cpu, so that the NAPI softirq is raised there */
+static void ipa3_wwan_rx_queue_kick(void *data)
+{
+	struct ipa3_wwan_rx_queue *q = data;
+
+	clear_bit(0, &q->kick_pending);
+	napi_schedule(&q->napi);
+}
+
+static void ipa3_wwan_rx_queues_init(struct ipa3_wwan_private *wwan_ptr)
+{
+	struct net_device *dev = wwan_ptr->net;
+	unsigned long mask = ipa3_rmnet_res.napi_rx_cpumask;
+	int cpu;
+
+	for_each_set_bit(cpu, &mask, BITS_PER_LONG) {
+		struct ipa3_wwan_rx_queue *q;
+
+		if (wwan_ptr->nr_rx_queues == IPA_WWAN_MAX_RX_QUEUES)
+			break;
+		if (cpu >= nr_cpu_ids)
+			break;
+
+		q = &wwan_ptr->rx_queues[wwan_ptr->nr_rx_queues++];
+		skb_queue_head_init(&q->skbs);
+		q->cpu = cpu;
+		q->csd.func = ipa3_wwan_rx_queue_kick;
+		q->csd.info = q;
+		netif_napi_add(dev, &q->napi, ipa3_wwan_rx_queue_poll,
+			       NAPI_WEIGHT);
+	}
+}
+
+static void ipa3_wwan_rx_queues_del(struct ipa3_wwan_private *wwan_ptr)
+{
+	unsigned int i;
+
+	for (i = 0; i < wwan_ptr->nr_rx_queues; i++)
+		netif_napi_del(&wwan_ptr->rx_queues[i].napi);
+	wwan_ptr->nr_rx_queues = 0;
+}
+
+static void ipa3_wwan_rx_queues_enable(struct ipa3_wwan_private *wwan_ptr)
+{
+	unsigned int i;
+
+	for (i = 0; i < wwan_ptr->nr_rx_queues; i++)
+		napi_enable(&wwan_ptr->rx_queues[i].napi);
+}
+
+static void ipa3_wwan_rx_queues_disable(struct ipa3_wwan_private *wwan_ptr)
+{
+	unsigned int i;
+
+	for (i = 0; i < wwan_ptr->nr_rx_queues; i++) {
+		napi_disable(&wwan_ptr->rx_queues[i].napi);
+		skb_queue_purge(&wwan_ptr->rx_queues[i].skbs);
+	}
+}
+
+/*
+ * Flow hash of the packet in the MAP frame at @off.  All segments of a
+ * coalesced frame belong to one flow, so hashing its first IP header is
+ * enough.  Commands and frames with MAPv5 headers, whose layout isn't parsed
+ * here, are keyed by mux id: that still keeps every flow on a single queue.
+ */
+static u32 ipa3_wwan_rx_flow_hash(struct sk_buff *skb, int off,
+				  bool qmap)
+{
+	struct rmnet_map_header_s _map, *map = NULL;
+	struct flow_keys keys;
+	u8 _ver, *ver;
+	__be16 proto;
+
+	if (qmap) {
+		map = skb_header_pointer(skb, off, sizeof(_map), &_map);
+		if (!map)
+			return 0;
+		if (map->cd_bit || map->reserved_bit)
+			return map->mux_id;
+		off += sizeof(*map);
+	}
+
+	ver = skb_header_pointer(skb, off, sizeof(_ver), &_ver);
+	if (!ver)
+		goto no_flow;
+	switch (*ver >> 4) {
+	case 4:
+		proto = htons(ETH_P_IP);
+		break;
+	case 6:
+		proto = htons(ETH_P_IPV6);
+		break;
+	default:
+		goto no_flow;
+	}
+
+	memset(&keys, 0, sizeof(keys));
+	if (!__skb_flow_dissect(skb, &flow_keys_dissector, &keys, skb->data,
+				proto, off, skb_headlen(skb), 0))
+		goto no_flow;
+
+	return flow_hash_from_keys(&keys);
+
+no_flow:
+	return map ? map->mux_id : 0;
+}
+
+static void ipa3_wwan_rx_enqueue(struct ipa3_wwan_private *wwan_ptr,
+				 struct sk_buff *skb, u32 hash)
+{
+	struct ipa3_wwan_rx_queue *q =
+		&wwan_ptr->rx_queues[reciprocal_scale(hash,
+						      wwan_ptr->nr_rx_queues)];
+
+	if (skb_queue_len(&q->skbs) >= netdev_max_backlog) {
+		q->drops++;
+		kfree_skb(skb);
+		return;
+	}
+
+	q->packets++;
+	q->bytes += skb->len;
+	skb_queue_tail(&q->skbs, skb);
+
+	/* A running poll rechecks the queue after napi_complete_done() */
+	if (test_bit(NAPI_STATE_SCHED, &q->napi.state) ||
+	    test_and_set_bit(0, &q->kick_pending))
+		return;
+
+	q->kicks++;
+	if (smp_call_function_single_async(q->cpu, &q->csd)) {
+		/* CPU went offline, process the queue here instead */
+		clear_bit(0, &q->kick_pending);
+		napi_schedule(&q->napi);
+	}
+}
+
+/*
+ * Split an IPA buffer into its MAP frames and queue each of them to the
+ * fan-out queue of its flow.  Called from the WAN NAPI poll.
+ */
+static void ipa3_wwan_rx_fanout(struct ipa3_wwan_private *wwan_ptr,
+				struct sk_buff *skb)
+{
+	bool qmap = !rmnet_ipa3_ctx->no_qmap_config;
+	struct rmnet_map_header_s _map, *map;
+	unsigned int off = 0, len;
+	struct sk_buff *frame;
+
+	if (!qmap) {
+		ipa3_wwan_rx_enqueue(wwan_ptr, skb,
+				     ipa3_wwan_rx_flow_hash(skb, 0, false));
+		return;
+	}
+
+	while (off < skb->len) {
+		map = skb_header_pointer(skb, off, sizeof(_map), &_map);
+		if (!map)
+			break;
+		len = sizeof(*map) + ntohs(map->pkt_len);
+		if (len > skb->len - off)
+			break;
+
+		if (!off && len == skb->len) {
+			/* Single frame, no need to split */
+			ipa3_wwan_rx_enqueue(wwan_ptr, skb,
+				ipa3_wwan_rx_flow_hash(skb, 0, true));
+			return;
+		}
+
+		if (!skb_is_nonlinear(skb)) {
+			frame = skb_clone(skb, GFP_ATOMIC);
+			if (frame) {
+				skb_pull(frame, off);
+				skb_trim(frame, len);
+			}
+		} else {
+			frame = netdev_alloc_skb(skb->dev, len);
+			if (frame)
+				skb_copy_bits(skb, off, skb_put(frame, len),
+					      len);
+		}
+
+		if (frame) {
+			frame->dev = skb->dev;
+			frame->protocol = skb->protocol;
+			ipa3_wwan_rx_enqueue(wwan_ptr, frame,
+				ipa3_wwan_rx_flow_hash(frame, 0, true));
+		} else {
+			wwan_ptr->rx_queues[0].drops++;
+		}
+
+		off += len;
+	}
+
+	if (off < skb->len)
+		pr_err_ratelimited(DEV_NAME " malformed MAP frame at %u/%u\n",
+				   off, skb->len);
+	consume_skb(skb);
+}
+
 static int __ipa_wwan_open(struct net_device *dev)
 {
 	struct ipa3_wwan_private *wwan_ptr = netdev_priv(dev);
@@ -1141,8 +1410,10 @@ static int __ipa_wwan_open(struct net_device *dev)
 		reinit_completion(&wwan_ptr->resource_granted_completion);
 	wwan_ptr->device_status = WWAN_DEVICE_ACTIVE;
 
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
 		napi_enable(&(wwan_ptr->napi));
+		ipa3_wwan_rx_queues_enable(wwan_ptr);
+	}
 	return 0;
 }
 
@@ -1207,8 +1478,10 @@ static int ipa3_wwan_stop(struct net_device *dev)
 
 	IPAWANDBG("[%s]\n", dev->name);
 	__ipa_wwan_close(dev);
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
 		napi_disable(&(wwan_ptr->napi));
+		ipa3_wwan_rx_queues_disable(wwan_ptr);
+	}
 	netif_stop_queue(dev);
 	return 0;
 }
@@ -1460,7 +1733,15 @@ static void apps_ipa_packet_receive_notify(void *priv,
 		if (!rmnet_ipa3_ctx->no_qmap_config)
 			skb->protocol = htons(ETH_P_MAP);
 
-		if (ipa3_rmnet_res.ipa_napi_enable) {
+		/* lets sockets fed by the WAN pipe busy poll it */
+		if (ipa3_rmnet_res.ipa_napi_enable)
+			skb_mark_napi_id(skb, &rmnet_ipa3_ctx->wwan_priv->napi);
+
+		if (ipa3_rmnet_res.ipa_napi_enable &&
+		    rmnet_ipa3_ctx->wwan_priv->nr_rx_queues) {
+			ipa3_wwan_rx_fanout(rmnet_ipa3_ctx->wwan_priv, skb);
+			result = 0;
+		} else if (ipa3_rmnet_res.ipa_napi_enable) {
 			trace_rmnet_ipa_netif_rcv_skb3(dev->stats.rx_packets);
 			result = netif_receive_skb(skb);
 		} else {
@@ -2558,6 +2839,15 @@ static int get_ipa_rmnet_dts_configuration(struct platform_device *pdev,
 	pr_info("IPA Napi Enable = %s\n",
 		ipa_rmnet_drv_res->ipa_napi_enable ? "True" : "False");
 
+	/* CPUs to spread WAN downlink processing over, none by default */
+	ipa_rmnet_drv_res->napi_rx_cpumask = 0;
+	if (ipa_rmnet_drv_res->ipa_napi_enable)
+		of_property_read_u32(pdev->dev.of_node,
+				     "qcom,ipa-napi-rx-cpumask",
+				     &ipa_rmnet_drv_res->napi_rx_cpumask);
+	pr_info("IPA Napi rx cpumask = 0x%x\n",
+		ipa_rmnet_drv_res->napi_rx_cpumask);
+
 	/* Get IPA WAN RX desc fifo size */
 	result = of_property_read_u32(pdev->dev.of_node,
 			"qcom,wan-rx-desc-size",
@@ -2842,9 +3132,11 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 	if (ipa3_rmnet_res.ipa_advertise_sg_support)
 		dev->hw_features |= NETIF_F_SG;
 
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
 		netif_napi_add(dev, &(rmnet_ipa3_ctx->wwan_priv->napi),
 		       ipa3_rmnet_poll, NAPI_WEIGHT);
+		ipa3_wwan_rx_queues_init(rmnet_ipa3_ctx->wwan_priv);
+	}
 	ret = register_netdev(dev);
 	if (ret) {
 		IPAWANERR("unable to register ipa_netdev %d rc=%d\n",
@@ -2880,8 +3172,10 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 	IPAWANERR("rmnet_ipa completed initialization\n");
 	return 0;
 config_err:
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
 		netif_napi_del(&(rmnet_ipa3_ctx->wwan_priv->napi));
+		ipa3_wwan_rx_queues_del(rmnet_ipa3_ctx->wwan_priv);
+	}
 	unregister_netdev(dev);
 set_perf_err:
 	if (ipa3_ctx->use_ipa_pm)
@@ -2923,8 +3217,10 @@ static int ipa3_wwan_remove(struct platform_device *pdev)
 		IPAWANERR("Failed to teardown APPS->IPA pipe\n");
 	else
 		rmnet_ipa3_ctx->apps_to_ipa3_hdl = -1;
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
 		netif_napi_del(&(rmnet_ipa3_ctx->wwan_priv->napi));
+		ipa3_wwan_rx_queues_del(rmnet_ipa3_ctx->wwan_priv);
+	}
 	mutex_unlock(&rmnet_ipa3_ctx->pipe_handle_guard);
 	IPAWANINFO("rmnet_ipa unregister_netdev\n");
 	unregister_netdev(IPA_NETDEV());
@@ -5008,12 +5304,35 @@ static void ipa3_wwan_msg_free_cb(void *buff, u32 len, u32 type)
 	kfree(buff);
 }
 
+static int ipa3_wwan_rx_queue_stats_get(char *buffer,
+				       const struct kernel_param *kp)
+{
+	struct ipa3_wwan_private *wwan_ptr;
+	int len = 0;
+	unsigned int i;
+
+	if (!rmnet_ipa3_ctx || !rmnet_ipa3_ctx->wwan_priv)
+		return 0;
+
+	wwan_ptr = rmnet_ipa3_ctx->wwan_priv;
+	for (i = 0; i < wwan_ptr->nr_rx_queues; i++) {
+		struct ipa3_wwan_rx_queue *q = &wwan_ptr->rx_queues[i];
+
+		len += scnprintf(buffer + len, PAGE_SIZE - len,
+				 "%d %llu %llu %llu %llu\n", q->cpu,
+				 q->packets, q->bytes, q->drops, q->kicks);
+	}
+
+	return len;
+}
+
 static int ipa3_rmnet_poll(struct napi_struct *napi, int budget)
 {
 	int rcvd_pkts = 0;
 
+	/* budget is below NAPI_WEIGHT only when a socket busy polls */
 	rcvd_pkts = ipa_rx_poll(rmnet_ipa3_ctx->ipa3_to_apps_hdl,
-					NAPI_WEIGHT);
+					min(budget, NAPI_WEIGHT));
 	IPAWANDBG_LOW("rcvd packets: %d\n", rcvd_pkts);
 	return rcvd_pkts;
 }
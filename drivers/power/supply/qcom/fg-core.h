@@ -428,6 +428,22 @@ struct fg_memif {
 	u8			num_bytes_per_word;
 };
 
+/*
+ * Snapshot of the SRAM words holding the frequently read FG outputs,
+ * refreshed in one read once older than *max_age_ms or invalidated.
+ */
+struct fg_sram_cache {
+	struct mutex		lock;
+	u8			*buf;
+	u16			start;
+	u16			end;
+	int			*max_age_ms;
+	bool			valid;
+	ktime_t			stamp;
+	unsigned long		hits;
+	unsigned long		refreshes;
+};
+
 struct fg_dev {
 	struct thermal_zone_device	*tz_dev;
 	struct device		*dev;
@@ -446,6 +462,9 @@ struct fg_dev {
 	struct votable		*batt_miss_irq_en_votable;
 	struct fg_sram_param	*sp;
 	struct fg_memif		sram;
+	struct fg_sram_cache	sram_cache;
+	atomic_long_t		bus_reads;
+	atomic_long_t		bus_writes;
 	struct fg_alg_flag	*alg_flags;
 	int			*debug_mask;
 	struct fg_batt_props	bp;
@@ -575,6 +594,11 @@ extern int fg_sram_write(struct fg_dev *fg, u16 address, u8 offset,
 			u8 *val, int len, int flags);
 extern int fg_sram_read(struct fg_dev *fg, u16 address, u8 offset,
 			u8 *val, int len, int flags);
+extern int fg_sram_cached_read(struct fg_dev *fg, u16 address, u8 offset,
+			u8 *val, int len);
+extern int fg_sram_cache_init(struct fg_dev *fg,
+			const enum fg_sram_param_id *ids, int num_ids);
+extern void fg_sram_cache_invalidate(struct fg_dev *fg);
 extern int fg_sram_masked_write(struct fg_dev *fg, u16 address, u8 offset,
 			u8 mask, u8 val, int flags);
 extern int fg_interleaved_mem_read(struct fg_dev *fg, u16 address,
@@ -12,6 +12,7 @@
 
 #include <linux/of.h>
 #include <linux/of_irq.h>
+#include <linux/seq_file.h>
 #include <linux/sort.h>
 #include "fg-core.h"
 #include "fg-reg.h"
@@ -198,8 +199,8 @@ int fg_get_sram_prop(struct fg_dev *fg, enum fg_sram_param_id id,
 	if (fg->battery_missing)
 		return 0;
 
-	rc = fg_sram_read(fg, fg->sp[id].addr_word, fg->sp[id].addr_byte,
-		buf, fg->sp[id].len, FG_IMA_DEFAULT);
+	rc = fg_sram_cached_read(fg, fg->sp[id].addr_word, fg->sp[id].addr_byte,
+		buf, fg->sp[id].len);
 	if (rc < 0) {
 		pr_err("Error reading address %d[%d] rc=%d\n",
 			fg->sp[id].addr_word, fg->sp[id].addr_byte, rc);
@@ -629,6 +630,12 @@ out:
 	mutex_unlock(&fg->sram_rw_lock);
 	if (!(flags & FG_IMA_NO_WLOCK))
 		vote(fg->awake_votable, SRAM_WRITE, false, 0);
+
+	if (fg->sram_cache.buf && address <= fg->sram_cache.end &&
+	    address + DIV_ROUND_UP(offset + len, fg->sram.num_bytes_per_word) >
+	    fg->sram_cache.start)
+		fg_sram_cache_invalidate(fg);
+
 	return rc;
 }
 
@@ -666,6 +673,96 @@ int fg_sram_read(struct fg_dev *fg, u16 address, u8 offset,
 	return rc;
 }
 
+/*
+ * Serve a read from the SRAM cache if it covers it, refreshing the whole
+ * cache first when it is stale. Anything else goes straight to SRAM.
+ */
+int fg_sram_cached_read(struct fg_dev *fg, u16 address, u8 offset,
+			u8 *val, int len)
+{
+	struct fg_sram_cache *cache = &fg->sram_cache;
+	int bpw = fg->sram.num_bytes_per_word;
+	int max_age_ms, rc = 0;
+
+	max_age_ms = cache->max_age_ms ? READ_ONCE(*cache->max_age_ms) : 0;
+	if (!cache->buf || max_age_ms <= 0 || fg->battery_missing ||
+	    address < cache->start ||
+	    address * bpw + offset + len > (cache->end + 1) * bpw)
+		return fg_sram_read(fg, address, offset, val, len,
+				FG_IMA_DEFAULT);
+
+	mutex_lock(&cache->lock);
+	if (!cache->valid ||
+	    ktime_ms_delta(ktime_get(), cache->stamp) >= max_age_ms) {
+		rc = fg_sram_read(fg, cache->start, 0, cache->buf,
+				(cache->end - cache->start + 1) * bpw,
+				FG_IMA_DEFAULT);
+		if (rc < 0) {
+			cache->valid = false;
+			goto out;
+		}
+		cache->valid = true;
+		cache->stamp = ktime_get();
+		cache->refreshes++;
+	} else {
+		cache->hits++;
+	}
+
+	memcpy(val, cache->buf + (address - cache->start) * bpw + offset, len);
+out:
+	mutex_unlock(&cache->lock);
+	return rc;
+}
+
+void fg_sram_cache_invalidate(struct fg_dev *fg)
+{
+	if (!fg->sram_cache.buf)
+		return;
+
+	mutex_lock(&fg->sram_cache.lock);
+	fg->sram_cache.valid = false;
+	mutex_unlock(&fg->sram_cache.lock);
+}
+
+/*
+ * Cover the SRAM words of the given parameters with a cache. Must be
+ * called once fg->sp and fg->sram are set up.
+ */
+int fg_sram_cache_init(struct fg_dev *fg, const enum fg_sram_param_id *ids,
+			int num_ids)
+{
+	struct fg_sram_cache *cache = &fg->sram_cache;
+	int bpw = fg->sram.num_bytes_per_word;
+	u16 start = U16_MAX, end = 0, last;
+	int i;
+
+	for (i = 0; i < num_ids; i++) {
+		if (!fg->sp[ids[i]].len)
+			continue;
+
+		last = fg->sp[ids[i]].addr_word +
+			DIV_ROUND_UP(fg->sp[ids[i]].addr_byte +
+				fg->sp[ids[i]].len, bpw) - 1;
+		start = min(start, fg->sp[ids[i]].addr_word);
+		end = max(end, last);
+	}
+
+	if (start > end || !fg_sram_address_valid(fg, start,
+			(end - start + 1) * bpw))
+		return -EINVAL;
+
+	cache->buf = devm_kzalloc(fg->dev, (end - start + 1) * bpw,
+				GFP_KERNEL);
+	if (!cache->buf)
+		return -ENOMEM;
+
+	mutex_init(&cache->lock);
+	cache->start = start;
+	cache->end = end;
+
+	return 0;
+}
+
 int fg_sram_masked_write(struct fg_dev *fg, u16 address, u8 offset,
 			u8 mask, u8 val, int flags)
 {
@@ -701,6 +798,7 @@ int fg_read(struct fg_dev *fg, int addr, u8 *val, int len)
 		return -ENXIO;
 
 	rc = regmap_bulk_read(fg->regmap, addr, val, len);
+	atomic_long_inc(&fg->bus_reads);
 
 	if (rc < 0) {
 		dev_err(fg->dev, "regmap_read failed for address %04x rc=%d\n",
@@ -746,6 +844,7 @@ int fg_write(struct fg_dev *fg, int addr, u8 *val, int len)
 		rc = regmap_bulk_write(fg->regmap, addr, val, len);
 	else
 		rc = regmap_write(fg->regmap, addr, *val);
+	atomic_long_inc(&fg->bus_writes);
 
 	if (rc < 0) {
 		dev_err(fg->dev, "regmap_write failed for address %04x rc=%d\n",
@@ -781,6 +880,7 @@ int fg_masked_write(struct fg_dev *fg, int addr, u8 mask, u8 val)
 	}
 
 	rc = regmap_update_bits(fg->regmap, addr, mask, val);
+	atomic_long_inc(&fg->bus_writes);
 	if (rc < 0) {
 		dev_err(fg->dev, "regmap_update_bits failed for address %04x rc=%d\n",
 			addr, rc);
@@ -867,6 +967,7 @@ wait:
 		goto out;
 	}
 out:
+	fg_sram_cache_invalidate(fg);
 	fg->fg_restarting = false;
 	return rc;
 }
@@ -1643,6 +1744,36 @@ static const struct file_operations fg_alg_flags_fops = {
 	.read = fg_alg_flags_read,
 };
 
+static int fg_sram_cache_show(struct seq_file *s, void *unused)
+{
+	struct fg_dev *fg = s->private;
+	struct fg_sram_cache *cache = &fg->sram_cache;
+
+	mutex_lock(&cache->lock);
+	seq_printf(s, "words: %u-%u\nmax_age_ms: %d\nhits: %lu\nrefreshes: %lu\n",
+		cache->start, cache->end,
+		cache->max_age_ms ? *cache->max_age_ms : 0,
+		cache->hits, cache->refreshes);
+	mutex_unlock(&cache->lock);
+	seq_printf(s, "bus_reads: %ld\nbus_writes: %ld\n",
+		atomic_long_read(&fg->bus_reads),
+		atomic_long_read(&fg->bus_writes));
+
+	return 0;
+}
+
+static int fg_sram_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fg_sram_cache_show, inode->i_private);
+}
+
+static const struct file_operations fg_sram_cache_fops = {
+	.open = fg_sram_cache_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 /*
  * fg_debugfs_create: adds new fg_sram debugfs entry
  * @return zero on success
@@ -1676,6 +1807,14 @@ int fg_debugfs_create(struct fg_dev *fg)
 		}
 	}
 
+	if (fg->sram_cache.buf) {
+		if (!debugfs_create_file("sram_cache", 0400, fg->dfs_root, fg,
+					 &fg_sram_cache_fops)) {
+			pr_err("failed to create sram_cache file\n");
+			goto err_remove_fs;
+		}
+	}
+
 	return 0;
 
 err_remove_fs:
@@ -57,6 +57,15 @@ struct votable {
 	struct dentry		*force_val_ent;
 	bool			force_active;
 	struct dentry		*force_active_ent;
+	/* what the callback was last given, and whether it took it */
+	bool			cb_valid;
+	int			cb_result;
+	const char		*cb_client;
+	int			batch_depth;
+	bool			batch_pending;
+	unsigned long		num_votes;
+	unsigned long		num_callbacks;
+	unsigned long		num_skipped;
 };
 
 /**
@@ -179,6 +188,37 @@ static char *get_client_str(struct votable *votable, int client_id)
 	return votable->client_strs[client_id];
 }
 
+/*
+ * Run the callback unless it already applied this very result for this
+ * client, as the hardware is then already set up for it.
+ *
+ * Context:
+ *	Must be called with the votable->lock held
+ */
+static int votable_callback(struct votable *votable, int effective_result,
+				const char *effective_client)
+{
+	int rc;
+
+	if (!votable->callback)
+		return 0;
+
+	if (votable->cb_valid && votable->cb_result == effective_result &&
+			votable->cb_client == effective_client) {
+		votable->num_skipped++;
+		return 0;
+	}
+
+	rc = votable->callback(votable, votable->data, effective_result,
+				effective_client);
+	votable->num_callbacks++;
+	votable->cb_valid = rc >= 0;
+	votable->cb_result = effective_result;
+	votable->cb_client = effective_client;
+
+	return rc;
+}
+
 void lock_votable(struct votable *votable)
 {
 	mutex_lock(&votable->vote_lock);
@@ -456,6 +496,7 @@ int vote(struct votable *votable, const char *client_str, bool enabled, int val)
 
 	votable->votes[client_id].enabled = enabled;
 	votable->votes[client_id].value = val;
+	votable->num_votes++;
 
 	if (similar_vote && votable->voted_on) {
 		pr_debug("%s: %s,%d Ignoring similar vote %s of val=%d\n",
@@ -494,10 +535,11 @@ int vote(struct votable *votable, const char *client_str, bool enabled, int val)
 			votable->name, effective_result,
 			get_client_str(votable, effective_id),
 			effective_id);
-		if (votable->callback && !votable->force_active
+		if (votable->batch_depth)
+			votable->batch_pending = true;
+		else if (!votable->force_active
 				&& (votable->override_result == -EINVAL))
-			rc = votable->callback(votable, votable->data,
-					effective_result,
+			rc = votable_callback(votable, effective_result,
 					get_client_str(votable, effective_id));
 	}
 
@@ -548,15 +590,13 @@ int vote_override(struct votable *votable, const char *override_client,
 	}
 
 	if (enabled) {
-		rc = votable->callback(votable, votable->data,
-					val, override_client);
+		rc = votable_callback(votable, val, override_client);
 		if (!rc) {
 			votable->override_client = override_client;
 			votable->override_result = val;
 		}
 	} else {
-		rc = votable->callback(votable, votable->data,
-			votable->effective_result,
+		rc = votable_callback(votable, votable->effective_result,
 			get_client_str(votable, votable->effective_client_id));
 		votable->override_result = -EINVAL;
 	}
@@ -566,6 +606,54 @@ out:
 	return rc;
 }
 
+/**
+ * vote_batch_begin() -
+ * vote_batch_end() -
+ *		Hold back the callback of a votable across a series of votes.
+ *
+ * @votable:	the votable object
+ *
+ * Votes cast on the votable between the two, by any client, update the
+ * election but the callback only runs from vote_batch_end(), once, with
+ * the final result and only if it differs from what it last applied.
+ * Batches nest.
+ *
+ * Returns:
+ *	vote_batch_end() returns the return of the callback, or zero.
+ */
+void vote_batch_begin(struct votable *votable)
+{
+	if (!votable)
+		return;
+
+	lock_votable(votable);
+	votable->batch_depth++;
+	unlock_votable(votable);
+}
+
+int vote_batch_end(struct votable *votable)
+{
+	int rc = 0;
+
+	if (!votable)
+		return -EINVAL;
+
+	lock_votable(votable);
+	if (WARN_ON(!votable->batch_depth))
+		goto out;
+
+	if (--votable->batch_depth || !votable->batch_pending)
+		goto out;
+
+	votable->batch_pending = false;
+	if (!votable->force_active && (votable->override_result == -EINVAL))
+		rc = votable_callback(votable, votable->effective_result,
+			get_client_str(votable, votable->effective_client_id));
+out:
+	unlock_votable(votable);
+	return rc;
+}
+
 int rerun_election(struct votable *votable)
 {
 	int rc = 0;
@@ -576,11 +664,18 @@ int rerun_election(struct votable *votable)
 
 	lock_votable(votable);
 	effective_result = get_effective_result_locked(votable);
-	if (votable->callback)
+	/* Reapplies the result on purpose, so bypass votable_callback() */
+	if (votable->callback) {
 		rc = votable->callback(votable,
 			votable->data,
 			effective_result,
 			get_client_str(votable, votable->effective_client_id));
+		votable->num_callbacks++;
+		votable->cb_valid = rc >= 0;
+		votable->cb_result = effective_result;
+		votable->cb_client = get_client_str(votable,
+					votable->effective_client_id);
+	}
 	unlock_votable(votable);
 	return rc;
 }
@@ -637,6 +732,9 @@ static int force_active_set(void *data, u64 val)
 	if (!votable->callback)
 		goto out;
 
+	/* Let the next vote apply its result whatever is forced here */
+	votable->cb_valid = false;
+
 	if (votable->force_active) {
 		rc = votable->callback(votable, votable->data,
 			votable->force_val,
@@ -697,6 +795,9 @@ static int show_votable_clients(struct seq_file *m, void *data)
 			effective_client_str ? effective_client_str : "none",
 			type_str,
 			get_effective_result_locked(votable));
+	seq_printf(m, "%s: votes=%lu callbacks=%lu skipped=%lu\n",
+			votable->name, votable->num_votes,
+			votable->num_callbacks, votable->num_skipped);
 	unlock_votable(votable);
 
 	return 0;
@@ -717,6 +818,34 @@ static const struct file_operations votable_status_ops = {
 	.release	= single_release,
 };
 
+static int show_votable_stats(struct seq_file *m, void *data)
+{
+	unsigned long flags;
+	struct votable *v;
+
+	seq_puts(m, "votable votes callbacks skipped\n");
+	spin_lock_irqsave(&votable_list_slock, flags);
+	list_for_each_entry(v, &votable_list, list)
+		seq_printf(m, "%s %lu %lu %lu\n", v->name, v->num_votes,
+				v->num_callbacks, v->num_skipped);
+	spin_unlock_irqrestore(&votable_list_slock, flags);
+
+	return 0;
+}
+
+static int votable_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_votable_stats, NULL);
+}
+
+static const struct file_operations votable_stats_ops = {
+	.owner		= THIS_MODULE,
+	.open		= votable_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 struct votable *create_votable(const char *name,
 				int votable_type,
 				int (*callback)(struct votable *votable,
@@ -741,6 +870,8 @@ struct votable *create_votable(const char *name,
 			pr_err("Couldn't create debug dir\n");
 			return ERR_PTR(-ENOMEM);
 		}
+		debugfs_create_file("stats", 0444, debug_root, NULL,
+				&votable_stats_ops);
 	}
 
 	if (votable_type >= NUM_VOTABLE_TYPES) {
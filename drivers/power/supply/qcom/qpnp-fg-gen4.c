@@ -347,6 +347,28 @@ module_param_named(
 	sram_dump_period_ms, fg_sram_dump_period_ms, int, 0600
 );
 
+static int fg_sram_cache_ms = 500;
+module_param_named(
+	sram_cache_ms, fg_sram_cache_ms, int, 0600
+);
+
+/* FG outputs polled through power_supply, read as one SRAM snapshot */
+static const enum fg_sram_param_id fg_gen4_cached_params[] = {
+	FG_SRAM_IBAT_FINAL,
+	FG_SRAM_VBAT_FINAL,
+	FG_SRAM_IBAT_FLT,
+	FG_SRAM_VBAT_FLT,
+	FG_SRAM_ESR_ACT,
+	FG_SRAM_RSLOW,
+	FG_SRAM_OCV,
+	FG_SRAM_VOLTAGE_PRED,
+	FG_SRAM_BATT_SOC,
+	FG_SRAM_FULL_SOC,
+	FG_SRAM_CC_SOC_SW,
+	FG_SRAM_CC_SOC,
+	FG_SRAM_MONOTONIC_SOC,
+};
+
 static int fg_restart_mp;
 static bool fg_sram_dump;
 static bool fg_esr_fast_cal_en;
@@ -740,8 +762,8 @@ static int fg_gen4_get_battery_temp(struct fg_dev *fg, int *val)
 	int rc = 0;
 	u16 buf;
 
-	rc = fg_sram_read(fg, BATT_TEMP_WORD, BATT_TEMP_OFFSET, (u8 *)&buf,
-			2, FG_IMA_DEFAULT);
+	rc = fg_sram_cached_read(fg, BATT_TEMP_WORD, BATT_TEMP_OFFSET,
+			(u8 *)&buf, 2);
 	if (rc < 0) {
 		pr_err("Failed to read BATT_TEMP_WORD rc=%d\n", rc);
 		return rc;
@@ -3519,6 +3541,7 @@ static irqreturn_t fg_delta_batt_temp_irq_handler(int irq, void *data)
 	struct fg_gen4_chip *chip = container_of(fg, struct fg_gen4_chip, fg);
 	int rc, batt_temp;
 
+	fg_sram_cache_invalidate(fg);
 	rc = fg_gen4_get_battery_temp(fg, &batt_temp);
 	if (rc < 0) {
 		pr_err("Error in getting batt_temp\n");
@@ -3563,6 +3586,7 @@ static irqreturn_t fg_soc_update_irq_handler(int irq, void *data)
 	struct fg_dev *fg = data;
 
 	fg_dbg(fg, FG_IRQ, "irq %d triggered\n", irq);
+	fg_sram_cache_invalidate(fg);
 	complete_all(&fg->soc_update);
 	return IRQ_HANDLED;
 }
@@ -3573,6 +3597,7 @@ static irqreturn_t fg_delta_bsoc_irq_handler(int irq, void *data)
 	int rc;
 
 	fg_dbg(fg, FG_IRQ, "irq %d triggered\n", irq);
+	fg_sram_cache_invalidate(fg);
 
 	rc = fg_gen4_charge_full_update(fg);
 	if (rc < 0)
@@ -3590,6 +3615,7 @@ static irqreturn_t fg_delta_msoc_irq_handler(int irq, void *data)
 	bool input_present = is_input_present(fg);
 	u32 batt_soc_cp;
 
+	fg_sram_cache_invalidate(fg);
 	rc = fg_get_msoc_raw(fg, &msoc_raw);
 	if (!rc)
 		fg_dbg(fg, FG_IRQ, "irq %d triggered msoc_raw: %d\n", irq,
@@ -6145,6 +6171,12 @@ static int fg_gen4_probe(struct platform_device *pdev)
 		goto exit;
 	}
 
+	fg->sram_cache.max_age_ms = &fg_sram_cache_ms;
+	rc = fg_sram_cache_init(fg, fg_gen4_cached_params,
+				ARRAY_SIZE(fg_gen4_cached_params));
+	if (rc < 0)
+		dev_warn(fg->dev, "SRAM cache unavailable, rc:%d\n", rc);
+
 	platform_set_drvdata(pdev, chip);
 	rc = fg_gen4_hw_init(chip);
 	if (rc < 0) {
@@ -6222,6 +6254,7 @@ static int fg_gen4_probe(struct platform_device *pdev)
 	}
 
 	device_init_wakeup(fg->dev, true);
+	device_enable_async_suspend(fg->dev);
 	if (!fg->battery_missing)
 		schedule_delayed_work(&fg->profile_load_work, 0);
 
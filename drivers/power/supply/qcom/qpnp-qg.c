@@ -4547,6 +4547,7 @@ static int qpnp_qg_probe(struct platform_device *pdev)
 		| QG_DEBUG_IRQ | QG_DEBUG_PM | QG_DEBUG_ESR;
 	chip->debug_mask = &qg_debug_mask;
 	platform_set_drvdata(pdev, chip);
+	device_enable_async_suspend(&pdev->dev);
 	INIT_WORK(&chip->udata_work, process_udata_work);
 	INIT_WORK(&chip->qg_status_change_work, qg_status_change_work);
 	INIT_DELAYED_WORK(&chip->qg_sleep_exit_work, qg_sleep_exit_work);
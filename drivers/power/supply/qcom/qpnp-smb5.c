@@ -25,6 +25,7 @@
 #include <linux/regulator/driver.h>
 #include <linux/regulator/of_regulator.h>
 #include <linux/regulator/machine.h>
+#include <linux/seq_file.h>
 #include <linux/iio/consumer.h>
 #include <linux/pmic-voter.h>
 #include "smb5-reg.h"
@@ -3891,6 +3892,31 @@ static int register_dump_read(void *data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(register_dump_ops, register_dump_read,
 			NULL, "%llu\n");
 
+static int heartbeat_stats_show(struct seq_file *m, void *unused)
+{
+	struct smb_charger *chg = m->private;
+	struct mmi_params *mmi = &chg->mmi;
+
+	seq_printf(m, "runs: %lu\nkicks: %ld\ncoalesced: %ld\nalarm_wakeups: %lu\n",
+		   mmi->hb_runs, atomic_long_read(&mmi->hb_kicks),
+		   atomic_long_read(&mmi->hb_coalesced),
+		   mmi->hb_alarm_wakeups);
+
+	return 0;
+}
+
+static int heartbeat_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, heartbeat_stats_show, inode->i_private);
+}
+
+static const struct file_operations heartbeat_stats_ops = {
+	.open		= heartbeat_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void smb5_create_debugfs(struct smb5 *chip)
 {
 	struct dentry *file;
@@ -3926,6 +3952,12 @@ static void smb5_create_debugfs(struct smb5 *chip)
 	if (IS_ERR_OR_NULL(file))
 		pr_err("Couldn't create register_dump file rc=%ld\n",
 			(long)file);
+
+	file = debugfs_create_file("heartbeat_stats", 0444,
+			    chip->dfs_root, &chip->chg, &heartbeat_stats_ops);
+	if (IS_ERR_OR_NULL(file))
+		pr_err("Couldn't create heartbeat_stats file rc=%ld\n",
+			(long)file);
 }
 
 #else
@@ -4192,6 +4224,7 @@ static int smb5_probe(struct platform_device *pdev)
 	}
 
 	device_init_wakeup(chg->dev, true);
+	device_enable_async_suspend(chg->dev);
 
 	schedule_delayed_work(&chg->mmi.heartbeat_work,
 			      msecs_to_jiffies(0));
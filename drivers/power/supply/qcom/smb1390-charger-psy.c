@@ -2097,6 +2097,7 @@ static int smb1390_probe(struct platform_device *pdev)
 	}
 
 	platform_set_drvdata(pdev, chip);
+	device_enable_async_suspend(&pdev->dev);
 	chip->cp_role = (long)of_device_get_match_data(chip->dev);
 	switch (chip->cp_role) {
 	case CP_MASTER:
@@ -69,6 +69,40 @@ static void update_sw_icl_max(struct smb_charger *chg, int pst);
 #endif
 static int smblib_get_prop_typec_mode(struct smb_charger *chg);
 
+/* Shortest spacing of event driven heartbeats */
+static int hb_tick_ms = 100;
+module_param(hb_tick_ms, int, 0644);
+
+/*
+ * Ask for a heartbeat within @delay_ms. A request is folded into a
+ * heartbeat already due no later, and one that follows the last run by
+ * less than hb_tick_ms is pushed out to the tick, so a burst of
+ * interrupts and notifications costs a single evaluation.
+ */
+static void mmi_kick_heartbeat(struct smb_charger *chg,
+			       unsigned int delay_ms)
+{
+	struct mmi_params *mmi = &chg->mmi;
+	int tick_ms = READ_ONCE(hb_tick_ms);
+	s64 since_ms;
+
+	atomic_long_inc(&mmi->hb_kicks);
+
+	since_ms = ktime_ms_delta(ktime_get(), mmi->hb_last_run);
+	if (since_ms >= 0 && since_ms < tick_ms)
+		delay_ms = max_t(unsigned int, delay_ms, tick_ms - since_ms);
+
+	if (delayed_work_pending(&mmi->heartbeat_work) &&
+	    time_before_eq(mmi->heartbeat_work.timer.expires,
+			   jiffies + msecs_to_jiffies(delay_ms))) {
+		atomic_long_inc(&mmi->hb_coalesced);
+		return;
+	}
+
+	mod_delayed_work(system_wq, &mmi->heartbeat_work,
+			 msecs_to_jiffies(delay_ms));
+}
+
 int smblib_read(struct smb_charger *chg, u16 addr, u8 *val)
 {
 	unsigned int value;
@@ -1365,6 +1399,7 @@ static void smblib_uusb_removal(struct smb_charger *chg)
 	/* reset both usbin current and voltage votes */
 	vote(chg->pl_enable_votable_indirect, USBIN_I_VOTER, false, 0);
 	vote(chg->pl_enable_votable_indirect, USBIN_V_VOTER, false, 0);
+	vote_batch_begin(chg->usb_icl_votable);
 #ifdef QCOM_BASE
 	vote(chg->usb_icl_votable, SW_ICL_MAX_VOTER, true,
 			is_flash_active(chg) ? SDP_CURRENT_UA : SDP_100_MA);
@@ -1375,6 +1410,7 @@ static void smblib_uusb_removal(struct smb_charger *chg)
 	vote(chg->usb_icl_votable, HVDCP2_ICL_VOTER, false, 0);
 	vote(chg->usb_icl_votable, CHG_TERMINATION_VOTER, false, 0);
 	vote(chg->usb_icl_votable, THERMAL_THROTTLE_VOTER, false, 0);
+	vote_batch_end(chg->usb_icl_votable);
 	vote(chg->limited_irq_disable_votable, CHARGER_TYPE_VOTER,
 			true, 0);
 	vote(chg->hdc_irq_disable_votable, CHARGER_TYPE_VOTER, true, 0);
@@ -2114,9 +2150,7 @@ int smblib_vbus_regulator_disable(struct regulator_dev *rdev)
 	mutex_unlock(&chg->otg_lock);
 
 	if (chg->mmi.ebchg_state != EB_DISCONN) {
-		cancel_delayed_work(&chg->mmi.heartbeat_work);
-		schedule_delayed_work(&chg->mmi.heartbeat_work,
-				      msecs_to_jiffies(0));
+		mmi_kick_heartbeat(chg, 0);
 	}
 
 	if (chg->usb_psy)
@@ -5382,9 +5416,7 @@ irqreturn_t smblib_handle_usbin_collapse(int irq, void *data)
 	}
 
 	if (val.intval && !chg->reverse_boost) {
-		cancel_delayed_work(&chg->mmi.heartbeat_work);
-		schedule_delayed_work(&chg->mmi.heartbeat_work,
-				      msecs_to_jiffies(100));
+		mmi_kick_heartbeat(chg, 100);
 	}
 	smblib_dbg(chg, PR_INTERRUPT, "IRQ: %s\n", irq_data->name);
 	return IRQ_HANDLED;
@@ -5810,9 +5842,7 @@ void smblib_usb_plugin_locked(struct smb_charger *chg)
 		dual_role_instance_changed(chg->dual_role);
 
 	__pm_stay_awake(&chg->mmi.smblib_mmi_hb_wake_source);
-	cancel_delayed_work(&chg->mmi.heartbeat_work);
-	schedule_delayed_work(&chg->mmi.heartbeat_work,
-			      msecs_to_jiffies(0));
+	mmi_kick_heartbeat(chg, 0);
 	smblib_dbg(chg, PR_INTERRUPT, "IRQ: usbin-plugin %s\n",
 					vbus_rising ? "attached" : "detached");
 }
@@ -6091,9 +6121,7 @@ irqreturn_t usb_source_change_irq_handler(int irq, void *data)
 	smblib_dbg(chg, PR_INTERRUPT, "APSD_STATUS = 0x%02x\n", stat);
 
 	vote(chg->awake_votable, HEARTBEAT_VOTER, true, true);
-	cancel_delayed_work(&chg->mmi.heartbeat_work);
-	schedule_delayed_work(&chg->mmi.heartbeat_work,
-			      msecs_to_jiffies(0));
+	mmi_kick_heartbeat(chg, 0);
 	return IRQ_HANDLED;
 }
 
@@ -6301,6 +6329,7 @@ static void typec_src_removal(struct smb_charger *chg)
 	cancel_delayed_work_sync(&chg->pl_enable_work);
 
 	/* reset input current limit voters */
+	vote_batch_begin(chg->usb_icl_votable);
 #ifdef QCOM_BASE
 	vote(chg->usb_icl_votable, SW_ICL_MAX_VOTER, true,
 			is_flash_active(chg) ? SDP_CURRENT_UA : SDP_100_MA);
@@ -6316,6 +6345,7 @@ static void typec_src_removal(struct smb_charger *chg)
 	vote(chg->usb_icl_votable, CHG_TERMINATION_VOTER, false, 0);
 	vote(chg->usb_icl_votable, THERMAL_THROTTLE_VOTER, false, 0);
 	vote(chg->usb_icl_votable, ICL_LIMIT_VOTER, false, 0);
+	vote_batch_end(chg->usb_icl_votable);
 
 	rc = smblib_get_prop_usb_present(chg, &val);
 	if (rc < 0) {
@@ -6432,9 +6462,7 @@ static void typec_src_removal(struct smb_charger *chg)
 	chg->mmi.charging_limit_modes = CHARGING_LIMIT_OFF;
 	chg->mmi.hvdcp3_con = false;
 	vote(chg->awake_votable, HEARTBEAT_VOTER, true, true);
-	cancel_delayed_work(&chg->mmi.heartbeat_work);
-	schedule_delayed_work(&chg->mmi.heartbeat_work,
-			      msecs_to_jiffies(0));
+	mmi_kick_heartbeat(chg, 0);
 }
 
 static void typec_mode_unattached(struct smb_charger *chg)
@@ -6575,9 +6603,7 @@ irqreturn_t typec_state_change_irq_handler(int irq, void *data)
 			vote(chg->usb_icl_votable, HEARTBEAT_VOTER,
 			     true, 500000);
 		vote(chg->awake_votable, HEARTBEAT_VOTER, true, true);
-		cancel_delayed_work(&chg->mmi.heartbeat_work);
-		schedule_delayed_work(&chg->mmi.heartbeat_work,
-				      msecs_to_jiffies(0));
+		mmi_kick_heartbeat(chg, 0);
 	}
 
 	smblib_dbg(chg, PR_INTERRUPT, "IRQ: cc-state-change; Type-C %s detected\n",
@@ -6977,9 +7003,7 @@ irqreturn_t switcher_power_ok_irq_handler(int irq, void *data)
 		} else if (stat) {
 			smblib_err(chg, "USB Present, Disable Power OK IRQ\n");
 			disable_irq_nosync(pok_irq);
-			cancel_delayed_work(&chg->mmi.heartbeat_work);
-			schedule_delayed_work(&chg->mmi.heartbeat_work,
-					      msecs_to_jiffies(100));
+			mmi_kick_heartbeat(chg, 100);
 			return IRQ_HANDLED;
 		}
 		/* This could be a weak charger reduce ICL */
@@ -7295,8 +7319,7 @@ static void smblib_pd_contract_work(struct work_struct *work)
 	if (rc < 0)
 		smblib_err(chg, "Error setting %d uA rc=%d\n", max_ua, rc);
 
-	cancel_delayed_work(&chg->mmi.heartbeat_work);
-	schedule_delayed_work(&chg->mmi.heartbeat_work, 0);
+	mmi_kick_heartbeat(chg, 0);
 
 }
 
@@ -9411,9 +9434,7 @@ static int mmi_psy_notifier_call(struct notifier_block *nb, unsigned long val,
 	if ((val == PSY_EVENT_PROP_ADDED) ||
 	    (val == PSY_EVENT_PROP_REMOVED)) {
 		smblib_dbg(chip, PR_MISC, "PSY Added/Removed run HB!\n");
-		cancel_delayed_work(&chip->mmi.heartbeat_work);
-		schedule_delayed_work(&chip->mmi.heartbeat_work,
-				      msecs_to_jiffies(0));
+		mmi_kick_heartbeat(chip, 0);
 		return NOTIFY_OK;
 	}
 
@@ -9424,9 +9445,7 @@ static int mmi_psy_notifier_call(struct notifier_block *nb, unsigned long val,
 	    (strcmp(psy->desc->name,
 		    (char *)chip->mmi.eb_pwr_psy_name) == 0)) {
 		smblib_dbg(chip, PR_MISC, "PSY changed on PTP\n");
-		cancel_delayed_work(&chip->mmi.heartbeat_work);
-		schedule_delayed_work(&chip->mmi.heartbeat_work,
-				      msecs_to_jiffies(100));
+		mmi_kick_heartbeat(chip, 100);
 		return NOTIFY_OK;
 	}
 
@@ -9696,6 +9715,9 @@ static void mmi_heartbeat_work(struct work_struct *work)
 
 	alarm_try_to_cancel(&chip->mmi.heartbeat_alarm);
 
+	mmi->hb_last_run = ktime_get();
+	mmi->hb_runs++;
+
 	/* Collect External Battery Information */
 	eb_soc = get_eb_prop(chip, POWER_SUPPLY_PROP_CAPACITY);
 	pwr_ext = get_eb_pwr_prop(chip, POWER_SUPPLY_PROP_PTP_EXTERNAL);
@@ -11372,11 +11394,10 @@ static enum alarmtimer_restart mmi_heartbeat_alarm_cb(struct alarm *alarm,
 
 	smblib_dbg(chip, PR_MOTO, "SMB: HB alarm fired\n");
 
+	chip->mmi.hb_alarm_wakeups++;
 	__pm_stay_awake(&chip->mmi.smblib_mmi_hb_wake_source);
-	cancel_delayed_work(&chip->mmi.heartbeat_work);
 	/* Delay by 500 ms to allow devices to resume. */
-	schedule_delayed_work(&chip->mmi.heartbeat_work,
-			      msecs_to_jiffies(500));
+	mmi_kick_heartbeat(chip, 500);
 
 	return ALARMTIMER_NORESTART;
 }
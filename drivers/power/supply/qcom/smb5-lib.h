@@ -494,6 +494,11 @@ struct mmi_params {
 	atomic_t		hb_ready;
 	struct alarm		heartbeat_alarm;
 	struct delayed_work	heartbeat_work;
+	ktime_t			hb_last_run;
+	unsigned long		hb_runs;
+	unsigned long		hb_alarm_wakeups;
+	atomic_long_t		hb_kicks;
+	atomic_long_t		hb_coalesced;
 	struct power_supply	*wls_psy;
 	struct power_supply	*usbeb_psy;
 	struct pinctrl		*smb_pinctrl;
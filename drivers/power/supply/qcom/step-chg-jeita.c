@@ -89,6 +89,8 @@ static struct step_chg_info *the_chip;
 #define GET_CONFIG_DELAY_MS		2000
 #define GET_CONFIG_RETRY_COUNT		50
 #define WAIT_BATT_ID_READY_MS		200
+/* battery and usb changes within this window share one evaluation */
+#define STATUS_CHANGE_DELAY_MS		100
 
 static bool is_batt_available(struct step_chg_info *chip)
 {
@@ -807,7 +809,8 @@ static int step_chg_notifier_call(struct notifier_block *nb,
 	if ((strcmp(psy->desc->name, "battery") == 0)
 			|| (strcmp(psy->desc->name, "usb") == 0)) {
 		__pm_stay_awake(chip->step_chg_ws);
-		schedule_delayed_work(&chip->status_change_work, 0);
+		schedule_delayed_work(&chip->status_change_work,
+				msecs_to_jiffies(STATUS_CHANGE_DELAY_MS));
 	}
 
 	if ((strcmp(psy->desc->name, "bms") == 0)) {
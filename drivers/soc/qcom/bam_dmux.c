@@ -70,6 +70,10 @@ static int bam_adaptive_timer_enabled;
 module_param_named(adaptive_timer_enabled,
 			bam_adaptive_timer_enabled,
 		   int, 0664);
+/* rx descriptors taken off the pipe and delivered as one batch */
+static int bam_rx_batch = 32;
+module_param_named(rx_batch, bam_rx_batch,
+		   int, 0664);
 
 static struct bam_ops_if bam_default_ops = {
 	/* smsm */
@@ -109,6 +113,9 @@ static uint32_t bam_dmux_tx_stall_cnt;
 static atomic_t bam_dmux_ack_out_cnt = ATOMIC_INIT(0);
 static atomic_t bam_dmux_ack_in_cnt = ATOMIC_INIT(0);
 static atomic_t bam_dmux_a2_pwr_cntl_in_cnt = ATOMIC_INIT(0);
+static unsigned long bam_dmux_rx_batches;
+static int bam_dmux_rx_batch_max;
+static unsigned long bam_dmux_tx_done_coalesced;
 
 #define DBG(x...) do {		                 \
 		if (msm_bam_dmux_debug_enable)  \
@@ -172,6 +179,12 @@ struct bam_ch_info {
 	char name[BAM_DMUX_CH_NAME_MAX_LEN];
 	int num_tx_pkts;
 	int use_wm;
+	unsigned long rx_pkts;
+	unsigned long rx_bytes;
+	unsigned long rx_drops;
+	unsigned long tx_pkts;
+	unsigned long tx_bytes;
+	unsigned long tx_errs;
 };
 
 #define A2_NUM_PIPES		6
@@ -218,17 +231,19 @@ static DEFINE_MUTEX(bam_rx_pool_mutexlock);
 static int bam_rx_pool_len;
 static LIST_HEAD(bam_tx_pool);
 static DEFINE_SPINLOCK(bam_tx_pool_spinlock);
+/* tx packets the BAM is done with, protected by bam_tx_pool_spinlock */
+static LIST_HEAD(bam_tx_done);
 static DEFINE_MUTEX(bam_pdev_mutexlock);
 
 static void notify_all(int event, unsigned long data);
 static void bam_mux_write_done(struct work_struct *work);
-static void handle_bam_mux_cmd(struct work_struct *work);
 static void rx_timer_work_func(struct work_struct *work);
 static void queue_rx_work_func(struct work_struct *work);
 static int ssrestart_check(void);
 
 static DECLARE_WORK(rx_timer_work, rx_timer_work_func);
 static DECLARE_WORK(queue_rx_work, queue_rx_work_func);
+static DECLARE_WORK(tx_done_work, bam_mux_write_done);
 
 static struct workqueue_struct *bam_mux_rx_workqueue;
 static struct workqueue_struct *bam_mux_tx_workqueue;
@@ -419,8 +434,6 @@ static void __queue_rx(gfp_t alloc_flags)
 
 		info->len = current_buffer_size;
 
-		INIT_WORK(&info->work, handle_bam_mux_cmd);
-
 		info->skb = __dev_alloc_skb(info->len, alloc_flags);
 		if (info->skb == NULL) {
 			DMUX_LOG_KERR(
@@ -538,8 +551,6 @@ static void bam_mux_process_data(struct sk_buff *rx_skb)
 	rx_hdr = (struct bam_mux_hdr *)rx_skb->data;
 	ch_id = rx_hdr->ch_id;
 
-	process_dynamic_mtu(rx_hdr->signal & DYNAMIC_MTU_MASK);
-
 	rx_skb->data = (unsigned char *)(rx_hdr + 1);
 	skb_set_tail_pointer(rx_skb, rx_hdr->pkt_len);
 	rx_skb->len = rx_hdr->pkt_len;
@@ -553,14 +564,16 @@ static void bam_mux_process_data(struct sk_buff *rx_skb)
 	if (bam_ch[ch_id].notify) {
 		notify = bam_ch[ch_id].notify;
 		priv = bam_ch[ch_id].priv;
+		bam_ch[ch_id].rx_pkts++;
+		bam_ch[ch_id].rx_bytes += rx_hdr->pkt_len;
+	} else {
+		bam_ch[ch_id].rx_drops++;
 	}
 	spin_unlock_irqrestore(&bam_ch[ch_id].lock, flags);
 	if (notify)
 		notify(priv, BAM_DMUX_RECEIVE, event_data);
 	else
 		dev_kfree_skb_any(rx_skb);
-
-	queue_rx();
 }
 
 /**
@@ -631,7 +644,6 @@ static inline void handle_bam_mux_cmd_open(struct bam_mux_hdr *rx_hdr)
 		BAM_DMUX_LOG("%s: open cid %d aborted due to ssr\n",
 				__func__, rx_hdr->ch_id);
 		mutex_unlock(&bam_pdev_mutexlock);
-		queue_rx();
 		return;
 	}
 	if (rx_hdr->signal & DYNAMIC_MTU_MASK) {
@@ -660,21 +672,20 @@ static inline void handle_bam_mux_cmd_open(struct bam_mux_hdr *rx_hdr)
 		pr_err("%s: platform_device_add() error: %d\n",
 				__func__, ret);
 	mutex_unlock(&bam_pdev_mutexlock);
-	queue_rx();
 }
 
-static void handle_bam_mux_cmd(struct work_struct *work)
+/*
+ * Handle one received buffer, already unmapped. The caller refills the rx
+ * pool once it is done with its batch.
+ */
+static void handle_bam_mux_cmd(struct rx_pkt_info *info)
 {
 	unsigned long flags;
 	struct bam_mux_hdr *rx_hdr;
-	struct rx_pkt_info *info;
 	struct sk_buff *rx_skb;
 	uint16_t sps_size;
 
-	info = container_of(work, struct rx_pkt_info, work);
 	rx_skb = info->skb;
-	dma_unmap_single(dma_dev, info->dma_address, info->len,
-			bam_ops->dma_from);
 	sps_size = info->sps_size;
 	kfree(info);
 
@@ -691,7 +702,6 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			rx_hdr->cmd, rx_hdr->pad_len, rx_hdr->ch_id,
 			rx_hdr->pkt_len);
 		dev_kfree_skb_any(rx_skb);
-		queue_rx();
 		return;
 	}
 
@@ -701,7 +711,6 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			__func__, rx_hdr->ch_id, rx_hdr->signal, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
 		dev_kfree_skb_any(rx_skb);
-		queue_rx();
 		return;
 	}
 
@@ -752,7 +761,6 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			pr_err("%s: platform_device_alloc failed\n", __func__);
 		mutex_unlock(&bam_pdev_mutexlock);
 		dev_kfree_skb_any(rx_skb);
-		queue_rx();
 		break;
 	default:
 		DMUX_LOG_KERR(
@@ -761,7 +769,6 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			rx_hdr->cmd, rx_hdr->pad_len, rx_hdr->ch_id,
 			rx_hdr->pkt_len);
 		dev_kfree_skb_any(rx_skb);
-		queue_rx();
 		return;
 	}
 }
@@ -792,7 +799,6 @@ static int bam_mux_write_cmd(void *data, uint32_t len)
 	pkt->dma_address = dma_address;
 	pkt->is_cmd = 1;
 	set_tx_timestamp(pkt);
-	INIT_WORK(&pkt->work, bam_mux_write_done);
 	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
 	list_add_tail(&pkt->list_node, &bam_tx_pool);
 	rc = bam_ops->sps_transfer_one_ptr(bam_tx_pipe, dma_address, len,
@@ -815,20 +821,14 @@ static int bam_mux_write_cmd(void *data, uint32_t len)
 	return rc;
 }
 
-static void bam_mux_write_done(struct work_struct *work)
+static void bam_mux_tx_complete(struct tx_pkt_info *info)
 {
 	struct sk_buff *skb;
 	struct bam_mux_hdr *hdr;
-	struct tx_pkt_info *info;
 	struct tx_pkt_info *info_expected;
 	unsigned long event_data;
 	unsigned long flags;
 
-	if (in_global_reset)
-		return;
-
-	info = container_of(work, struct tx_pkt_info, work);
-
 	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
 	info_expected = list_first_entry(&bam_tx_pool,
 			struct tx_pkt_info, list_node);
@@ -870,6 +870,8 @@ static void bam_mux_write_done(struct work_struct *work)
 	event_data = (unsigned long)(skb);
 	spin_lock_irqsave(&bam_ch[hdr->ch_id].lock, flags);
 	bam_ch[hdr->ch_id].num_tx_pkts--;
+	bam_ch[hdr->ch_id].tx_pkts++;
+	bam_ch[hdr->ch_id].tx_bytes += skb->len;
 	spin_unlock_irqrestore(&bam_ch[hdr->ch_id].lock, flags);
 	if (bam_ch[hdr->ch_id].notify)
 		bam_ch[hdr->ch_id].notify(
@@ -879,6 +881,34 @@ static void bam_mux_write_done(struct work_struct *work)
 		dev_kfree_skb_any(skb);
 }
 
+/*
+ * Completes every tx packet the BAM has reported done since the last run,
+ * whichever channels they belong to, so a burst of EOTs costs one work.
+ */
+static void bam_mux_write_done(struct work_struct *work)
+{
+	struct tx_pkt_info *info;
+	unsigned long flags;
+	unsigned long n = 0;
+
+	while (!in_global_reset) {
+		spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
+		info = list_first_entry_or_null(&bam_tx_done,
+				struct tx_pkt_info, done_node);
+		if (info)
+			list_del(&info->done_node);
+		spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
+		if (!info)
+			break;
+
+		bam_mux_tx_complete(info);
+		n++;
+	}
+
+	if (n > 1)
+		bam_dmux_tx_done_coalesced += n - 1;
+}
+
 int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
 {
 	int rc = 0;
@@ -985,7 +1015,6 @@ int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
 	pkt->dma_address = dma_address;
 	pkt->is_cmd = 0;
 	set_tx_timestamp(pkt);
-	INIT_WORK(&pkt->work, bam_mux_write_done);
 	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
 	list_add_tail(&pkt->list_node, &bam_tx_pool);
 	rc = bam_ops->sps_transfer_one_ptr(bam_tx_pipe, dma_address, skb->len,
@@ -995,6 +1024,7 @@ int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
 			__func__, rc);
 		list_del(&pkt->list_node);
 		DBG_INC_TX_SPS_FAILURE_CNT();
+		bam_ch[id].tx_errs++;
 		spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
 		dma_unmap_single(dma_dev, pkt->dma_address,
 					pkt->skb->len,	bam_ops->dma_to);
@@ -1261,11 +1291,102 @@ int msm_bam_dmux_is_ch_low(uint32_t id)
 	return ret;
 }
 
+/*
+ * Take up to @budget completed descriptors off the rx pipe under a single
+ * hold of the pool lock, then hand them out in order. Runs of data packets
+ * are delivered with bottom halves disabled, so the netif_rx() backlog the
+ * clients feed is processed once per run instead of once per packet, and
+ * the rx pool is refilled once per batch. Commands may sleep and are
+ * handled with bottom halves enabled. Returns the descriptors taken.
+ */
+static int bam_rx_poll(int budget)
+{
+	struct rx_pkt_info *info, *tmp;
+	struct bam_mux_hdr *rx_hdr;
+	struct sps_iovec iov;
+	LIST_HEAD(batch);
+	bool bh_off = false;
+	bool data;
+	int n = 0;
+	int ret;
+
+	mutex_lock(&bam_rx_pool_mutexlock);
+	while (n < budget) {
+		ret = bam_ops->sps_get_iovec_ptr(bam_rx_pipe, &iov);
+		if (ret) {
+			DMUX_LOG_KERR("%s: sps_get_iovec failed %d\n",
+					__func__, ret);
+			break;
+		}
+		if (iov.addr == 0)
+			break;
+		n++;
+
+		if (unlikely(list_empty(&bam_rx_pool))) {
+			DMUX_LOG_KERR("%s: have iovec %p but rx pool empty\n",
+				__func__, (void *)(uintptr_t)iov.addr);
+			continue;
+		}
+		info = list_first_entry(&bam_rx_pool, struct rx_pkt_info,
+							list_node);
+		if (info->dma_address != iov.addr) {
+			DMUX_LOG_KERR("%s: iovec %p != dma %p\n",
+				__func__,
+				(void *)(uintptr_t)iov.addr,
+				(void *)(uintptr_t)info->dma_address);
+			list_for_each_entry(info, &bam_rx_pool, list_node) {
+				DMUX_LOG_KERR("%s: dma %p\n", __func__,
+					(void *)(uintptr_t)info->dma_address);
+				if (iov.addr == info->dma_address)
+					break;
+			}
+		}
+		WARN_ON(info->dma_address != iov.addr);
+		list_move_tail(&info->list_node, &batch);
+		--bam_rx_pool_len;
+		info->sps_size = iov.size;
+	}
+	mutex_unlock(&bam_rx_pool_mutexlock);
+
+	list_for_each_entry_safe(info, tmp, &batch, list_node) {
+		list_del(&info->list_node);
+		dma_unmap_single(dma_dev, info->dma_address, info->len,
+				bam_ops->dma_from);
+
+		rx_hdr = (struct bam_mux_hdr *)info->skb->data;
+		data = rx_hdr->magic_num == BAM_MUX_HDR_MAGIC_NO &&
+			rx_hdr->ch_id < BAM_DMUX_NUM_CHANNELS &&
+			rx_hdr->cmd == BAM_MUX_HDR_CMD_DATA;
+		if (data) {
+			/* may sleep, so ahead of disabling bottom halves */
+			process_dynamic_mtu(rx_hdr->signal & DYNAMIC_MTU_MASK);
+			if (!bh_off) {
+				local_bh_disable();
+				bh_off = true;
+			}
+		} else if (bh_off) {
+			local_bh_enable();
+			bh_off = false;
+		}
+
+		handle_bam_mux_cmd(info);
+	}
+	if (bh_off)
+		local_bh_enable();
+
+	if (n) {
+		queue_rx();
+		bam_dmux_rx_batches++;
+		if (n > bam_dmux_rx_batch_max)
+			bam_dmux_rx_batch_max = n;
+	}
+
+	return n;
+}
+
 static void rx_switch_to_interrupt_mode(void)
 {
 	struct sps_connect cur_rx_conn;
-	struct sps_iovec iov;
-	struct rx_pkt_info *info;
 	int ret;
 
 	/*
@@ -1298,42 +1419,8 @@ static void rx_switch_to_interrupt_mode(void)
 
 	/* handle any rx packets before interrupt was enabled */
 	while (bam_connection_is_active && !polling_mode) {
-		ret = bam_ops->sps_get_iovec_ptr(bam_rx_pipe, &iov);
-		if (ret) {
-			pr_err("%s: sps_get_iovec failed %d\n",
-					__func__, ret);
+		if (bam_rx_poll(max(bam_rx_batch, 1)) == 0)
 			break;
-		}
-		if (iov.addr == 0)
-			break;
-
-		mutex_lock(&bam_rx_pool_mutexlock);
-		if (unlikely(list_empty(&bam_rx_pool))) {
-			DMUX_LOG_KERR("%s: have iovec %p but rx pool empty\n",
-				__func__, (void *)(uintptr_t)iov.addr);
-			mutex_unlock(&bam_rx_pool_mutexlock);
-			continue;
-		}
-		info = list_first_entry(&bam_rx_pool, struct rx_pkt_info,
-							list_node);
-		if (info->dma_address != iov.addr) {
-			DMUX_LOG_KERR("%s: iovec %p != dma %p\n",
-				__func__,
-				(void *)(uintptr_t)iov.addr,
-				(void *)(uintptr_t)info->dma_address);
-			list_for_each_entry(info, &bam_rx_pool, list_node) {
-				DMUX_LOG_KERR("%s: dma %p\n", __func__,
-					(void *)(uintptr_t)info->dma_address);
-				if (iov.addr == info->dma_address)
-					break;
-			}
-		}
-		WARN_ON(info->dma_address != iov.addr);
-		list_del(&info->list_node);
-		--bam_rx_pool_len;
-		mutex_unlock(&bam_rx_pool_mutexlock);
-		info->sps_size = iov.size;
-		handle_bam_mux_cmd(&info->work);
 	}
 	return;
 
@@ -1370,8 +1457,6 @@ static void log_rx_timestamp(void)
 
 static void rx_timer_work_func(struct work_struct *work)
 {
-	struct sps_iovec iov;
-	struct rx_pkt_info *info;
 	int inactive_cycles = 0;
 	int ret;
 	u32 buffs_unused, buffs_used;
@@ -1387,46 +1472,10 @@ static void rx_timer_work_func(struct work_struct *work)
 				return;
 			}
 
-			ret = bam_ops->sps_get_iovec_ptr(bam_rx_pipe, &iov);
-			if (ret) {
-				DMUX_LOG_KERR("%s: sps_get_iovec failed %d\n",
-						__func__, ret);
-				break;
-			}
-			if (iov.addr == 0)
+			if (bam_rx_poll(max(bam_rx_batch, 1)) == 0)
 				break;
 			store_rx_timestamp();
 			inactive_cycles = 0;
-			mutex_lock(&bam_rx_pool_mutexlock);
-			if (unlikely(list_empty(&bam_rx_pool))) {
-				DMUX_LOG_KERR(
-					"%s: have iovec %p but rx pool empty\n",
-					__func__, (void *)(uintptr_t)iov.addr);
-				mutex_unlock(&bam_rx_pool_mutexlock);
-				continue;
-			}
-			info = list_first_entry(&bam_rx_pool,
-					struct rx_pkt_info,	list_node);
-			if (info->dma_address != iov.addr) {
-				DMUX_LOG_KERR("%s: iovec %p != dma %p\n",
-					__func__,
-					(void *)(uintptr_t)iov.addr,
-					(void *)(uintptr_t)info->dma_address);
-				list_for_each_entry(info, &bam_rx_pool,
-						list_node) {
-					DMUX_LOG_KERR("%s: dma %p\n", __func__,
-						(void *)(uintptr_t)
-							info->dma_address);
-					if (iov.addr == info->dma_address)
-						break;
-				}
-			}
-			WARN_ON(info->dma_address != iov.addr);
-			list_del(&info->list_node);
-			--bam_rx_pool_len;
-			mutex_unlock(&bam_rx_pool_mutexlock);
-			info->sps_size = iov.size;
-			handle_bam_mux_cmd(&info->work);
 		}
 
 		if (inactive_cycles >= POLLING_INACTIVITY) {
@@ -1495,7 +1544,10 @@ static void bam_mux_tx_notify(struct sps_event_notify *notify)
 			dma_unmap_single(dma_dev, pkt->dma_address,
 						pkt->len,
 						bam_ops->dma_to);
-		queue_work(bam_mux_tx_workqueue, &pkt->work);
+		spin_lock(&bam_tx_pool_spinlock);
+		list_add_tail(&pkt->done_node, &bam_tx_done);
+		spin_unlock(&bam_tx_pool_spinlock);
+		queue_work(bam_mux_tx_workqueue, &tx_done_work);
 		break;
 	default:
 		pr_err("%s: received unexpected event id %d\n", __func__,
@@ -1600,7 +1652,10 @@ static int debug_stats(char *buf, int max)
 			"rx queue len:    %d\n"
 			"a2 ack out cnt:  %d\n"
 			"a2 ack in cnt:   %d\n"
-			"a2 pwr cntl in:  %d\n",
+			"a2 pwr cntl in:  %d\n"
+			"rx batches:      %lu\n"
+			"rx batch max:    %d\n"
+			"tx done merged:  %lu\n",
 			bam_dmux_read_cnt,
 			bam_dmux_write_cnt,
 			bam_dmux_write_cpy_cnt,
@@ -1610,12 +1665,35 @@ static int debug_stats(char *buf, int max)
 			bam_rx_pool_len,
 			atomic_read(&bam_dmux_ack_out_cnt),
 			atomic_read(&bam_dmux_ack_in_cnt),
-			atomic_read(&bam_dmux_a2_pwr_cntl_in_cnt)
+			atomic_read(&bam_dmux_a2_pwr_cntl_in_cnt),
+			bam_dmux_rx_batches,
+			bam_dmux_rx_batch_max,
+			bam_dmux_tx_done_coalesced
 			);
 
 	return i;
 }
 
+static int debug_ch_stats(char *buf, int max)
+{
+	unsigned long flags;
+	int i = 0;
+	int j;
+
+	for (j = 0; j < BAM_DMUX_NUM_CHANNELS; ++j) {
+		spin_lock_irqsave(&bam_ch[j].lock, flags);
+		i += scnprintf(buf + i, max - i,
+			"ch%02d  rx %lu/%lu drop %lu  tx %lu/%lu err %lu  inflight %d\n",
+			j, bam_ch[j].rx_pkts, bam_ch[j].rx_bytes,
+			bam_ch[j].rx_drops, bam_ch[j].tx_pkts,
+			bam_ch[j].tx_bytes, bam_ch[j].tx_errs,
+			bam_ch[j].num_tx_pkts);
+		spin_unlock_irqrestore(&bam_ch[j].lock, flags);
+	}
+
+	return i;
+}
+
 #define DEBUG_BUFMAX 4096
 static char debug_buffer[DEBUG_BUFMAX];
 
@@ -2264,6 +2342,7 @@ static int restart_notifier_cb(struct notifier_block *this,
 
 	/* Cleanup pending UL data */
 	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
+	INIT_LIST_HEAD(&bam_tx_done);
 	while (!list_empty(&bam_tx_pool)) {
 		node = bam_tx_pool.next;
 		list_del(node);
@@ -2913,6 +2992,7 @@ static int __init bam_dmux_init(void)
 		debug_create("tbl", 0444, dent, debug_tbl);
 		debug_create("ul_pkt_cnt", 0444, dent, debug_ul_pkt_cnt);
 		debug_create("stats", 0444, dent, debug_stats);
+		debug_create("ch_stats", 0444, dent, debug_ch_stats);
 	}
 #endif
 
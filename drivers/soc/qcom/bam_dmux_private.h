@@ -139,7 +139,6 @@ struct bam_mux_hdr {
  * struct rx_pkt_info - struct describing an rx packet
  * @skb: socket buffer containing the packet
  * @dma_address: dma mapped address of the packet
- * @work: work_struct for processing the packet
  * @list_node: list_head for placing this on a list
  * @sps_size: size of the sps_iovec for this packet
  * @len: total length of the buffer containing this packet
@@ -147,7 +146,6 @@ struct bam_mux_hdr {
 struct rx_pkt_info {
 	struct sk_buff *skb;
 	dma_addr_t dma_address;
-	struct work_struct work;
 	struct list_head list_node;
 	uint16_t sps_size;
 	uint16_t len;
@@ -159,8 +157,8 @@ struct rx_pkt_info {
  * @dma_address: dma mapped address of the packet
  * @is_cmd: signifies whether this is a command or data packet
  * @len: length og the packet
- * @work: work_struct for processing this packet
  * @list_node: list_head for placing this on a list
+ * @done_node: list_head for the list of completed packets
  * @ts_sec: seconds portion of the timestamp
  * @ts_nsec: nanoseconds portion of the timestamp
  *
@@ -170,8 +168,8 @@ struct tx_pkt_info {
 	dma_addr_t dma_address;
 	char is_cmd;
 	uint32_t len;
-	struct work_struct work;
 	struct list_head list_node;
+	struct list_head done_node;
 	unsigned int ts_sec;
 	unsigned long ts_nsec;
 };
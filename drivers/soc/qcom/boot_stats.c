@@ -22,13 +22,34 @@
 #include <linux/sched.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
 #include <soc/qcom/boot_stats.h>
 
+/* Slowest driver probes of the boot, kept for the KPI log */
+#define BOOT_PROBE_MAX		32
+
+struct boot_probe {
+	char drv[32];
+	char dev[48];
+	u64 ns;
+	int ret;
+};
+
 static void __iomem *mpm_counter_base;
 static phys_addr_t mpm_counter_pa;
 static uint32_t mpm_counter_freq;
 struct boot_stats __iomem *boot_stats;
 
+static struct boot_probe boot_probes[BOOT_PROBE_MAX];
+static int boot_nr_probes;
+static unsigned long boot_probe_count;
+static u64 boot_probe_total_ns;
+static DEFINE_SPINLOCK(boot_probe_lock);
+
 static int mpm_parse_dt(void)
 {
 	struct device_node *np;
@@ -123,6 +144,129 @@ phys_addr_t msm_timer_get_pa(void)
 	return mpm_counter_pa;
 }
 
+/*
+ * Called by the driver core for every probe until init is started. Probes
+ * run concurrently once asynchronous probing is in use.
+ */
+void boot_stats_add_probe(const char *drv, const char *dev, u64 ns, int ret)
+{
+	struct boot_probe *bp;
+	unsigned long flags;
+	int i, min = 0;
+
+	spin_lock_irqsave(&boot_probe_lock, flags);
+	boot_probe_count++;
+	boot_probe_total_ns += ns;
+
+	if (boot_nr_probes < BOOT_PROBE_MAX) {
+		bp = &boot_probes[boot_nr_probes++];
+	} else {
+		for (i = 1; i < BOOT_PROBE_MAX; i++)
+			if (boot_probes[i].ns < boot_probes[min].ns)
+				min = i;
+		if (boot_probes[min].ns >= ns)
+			goto unlock;
+		bp = &boot_probes[min];
+	}
+
+	strlcpy(bp->drv, drv, sizeof(bp->drv));
+	strlcpy(bp->dev, dev, sizeof(bp->dev));
+	bp->ns = ns;
+	bp->ret = ret;
+unlock:
+	spin_unlock_irqrestore(&boot_probe_lock, flags);
+}
+
+static int boot_probe_cmp(const void *a, const void *b)
+{
+	const struct boot_probe *pa = a, *pb = b;
+
+	if (pa->ns == pb->ns)
+		return 0;
+
+	return pa->ns < pb->ns ? 1 : -1;
+}
+
+/* Snapshot of the slowest probes, slowest first */
+static int boot_probes_get(struct boot_probe *bp, unsigned long *count,
+			   u64 *total_ns)
+{
+	unsigned long flags;
+	int nr;
+
+	spin_lock_irqsave(&boot_probe_lock, flags);
+	nr = boot_nr_probes;
+	memcpy(bp, boot_probes, nr * sizeof(*bp));
+	*count = boot_probe_count;
+	*total_ns = boot_probe_total_ns;
+	spin_unlock_irqrestore(&boot_probe_lock, flags);
+
+	sort(bp, nr, sizeof(*bp), boot_probe_cmp, NULL);
+
+	return nr;
+}
+
+static int boot_probes_show(struct seq_file *m, void *v)
+{
+	struct boot_probe *bp;
+	unsigned long count;
+	u64 total_ns;
+	int nr, i;
+
+	bp = kmalloc_array(BOOT_PROBE_MAX, sizeof(*bp), GFP_KERNEL);
+	if (!bp)
+		return -ENOMEM;
+
+	nr = boot_probes_get(bp, &count, &total_ns);
+	seq_printf(m, "probes: %lu total_us: %llu\n", count,
+		   div_u64(total_ns, NSEC_PER_USEC));
+	for (i = 0; i < nr; i++)
+		seq_printf(m, "%8llu us %-32s %s%s\n",
+			   div_u64(bp[i].ns, NSEC_PER_USEC), bp[i].drv,
+			   bp[i].dev, bp[i].ret ? " (failed)" : "");
+	kfree(bp);
+
+	return 0;
+}
+
+static int boot_probes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boot_probes_show, NULL);
+}
+
+static const struct file_operations boot_probes_fops = {
+	.open		= boot_probes_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init boot_probes_report(void)
+{
+	struct boot_probe *bp;
+	unsigned long count;
+	u64 total_ns;
+	int nr, i;
+
+	debugfs_create_file("boot_probes", 0444, NULL, NULL,
+			    &boot_probes_fops);
+
+	bp = kmalloc_array(BOOT_PROBE_MAX, sizeof(*bp), GFP_KERNEL);
+	if (!bp)
+		return 0;
+
+	nr = boot_probes_get(bp, &count, &total_ns);
+	pr_info("KPI: Driver probes = %lu, total = %llu us\n", count,
+		div_u64(total_ns, NSEC_PER_USEC));
+	for (i = 0; i < min(nr, 10); i++)
+		pr_info("KPI: Probe %s %s = %llu us\n", bp[i].drv, bp[i].dev,
+			div_u64(bp[i].ns, NSEC_PER_USEC));
+	kfree(bp);
+
+	return 0;
+}
+late_initcall_sync(boot_probes_report);
+
 int boot_stats_init(void)
 {
 	int ret;
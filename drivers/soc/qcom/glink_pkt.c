@@ -26,6 +26,8 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/termios.h>
+#include <linux/uio.h>
+#include <linux/ktime.h>
 
 /* Define IPC Logging Macros */
 #define GLINK_PKT_IPC_LOG_PAGE_CNT 2
@@ -88,6 +90,9 @@ do { \
 #define GLINK_PKT_IOCTL_QUEUE_RX_INTENT \
 	_IOW(GLINK_PKT_IOCTL_MAGIC, 0, unsigned int)
 
+/* Writes up to this size are staged in the per device buffer */
+#define GLINK_PKT_TX_BUF_SIZE	SZ_4K
+
 #define MODULE_NAME "glink_pkt"
 static dev_t glink_pkt_major;
 static struct class *glink_pkt_class;
@@ -112,6 +117,8 @@ static DEFINE_IDA(glink_pkt_minor_ida);
  * @ch_name:	glink channel to match to
  * @edge:	glink edge to match to
  * @open_tout:	timeout for open syscall, configurable in sysfs
+ * @tx_buf:	staging buffer for writes, protected by @lock
+ * @stats:	traffic counters, tx under @lock and rx under @queue_lock
  */
 struct glink_pkt_device {
 	struct device dev;
@@ -132,6 +139,20 @@ struct glink_pkt_device {
 	const char *ch_name;
 	const char *edge;
 	int open_tout;
+
+	void *tx_buf;
+	struct {
+		u64 tx_pkts;
+		u64 tx_bytes;
+		u64 tx_ns;
+		u64 tx_max_ns;
+		u64 rx_pkts;
+		u64 rx_bytes;
+		u64 rx_drops;
+		u64 rx_wait_ns;
+		u64 rx_max_wait_ns;
+		u32 rx_max_queued;
+	} stats;
 };
 
 #define dev_to_gpdev(_dev) container_of(_dev, struct glink_pkt_device, dev)
@@ -199,13 +220,20 @@ static int glink_pkt_rpdev_cb(struct rpmsg_device *rpdev, void *buf, int len,
 	struct sk_buff *skb;
 
 	skb = alloc_skb(len, GFP_ATOMIC);
-	if (!skb)
+	if (!skb) {
+		spin_lock_irqsave(&gpdev->queue_lock, flags);
+		gpdev->stats.rx_drops++;
+		spin_unlock_irqrestore(&gpdev->queue_lock, flags);
 		return -ENOMEM;
+	}
 
 	skb_put_data(skb, buf, len);
+	skb->tstamp = ktime_get();
 
 	spin_lock_irqsave(&gpdev->queue_lock, flags);
 	skb_queue_tail(&gpdev->queue, skb);
+	gpdev->stats.rx_max_queued = max(gpdev->stats.rx_max_queued,
+					 skb_queue_len(&gpdev->queue));
 	spin_unlock_irqrestore(&gpdev->queue_lock, flags);
 
 	/* wake up any blocking processes, waiting for new data */
@@ -328,22 +356,23 @@ int glink_pkt_release(struct inode *inode, struct file *file)
 }
 
 /**
- * glink_pkt_read() - read() syscall for the glink_pkt device
- * file:	Pointer to the file structure.
- * buf:		Pointer to the userspace buffer.
- * count:	Number bytes to read from the file.
- * ppos:	Pointer to the position into the file.
+ * glink_pkt_read_iter() - read() and readv() syscalls for the glink_pkt device
+ * iocb:	Pointer to the kiocb of the file.
+ * to:		Destination iovecs in userspace.
  *
  * This function is used to Read the data from glink pkt device when
- * userspace client do a read() system call. All input arguments are
+ * userspace client do a read() or readv() system call. Each call returns
+ * one packet, scattered over the iovecs, so that a client can receive a
+ * header and its payload into separate buffers. All input arguments are
  * validated by the virtual file system before calling this function.
  */
-ssize_t glink_pkt_read(struct file *file, char __user *buf,
-		       size_t count, loff_t *ppos)
+static ssize_t glink_pkt_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
+	struct file *file = iocb->ki_filp;
 	struct glink_pkt_device *gpdev = file->private_data;
 	unsigned long flags;
 	struct sk_buff *skb;
+	u64 wait;
 	int use;
 
 	if (!gpdev || refcount_read(&gpdev->refcount) == 1) {
@@ -382,12 +411,20 @@ ssize_t glink_pkt_read(struct file *file, char __user *buf,
 	}
 
 	skb = skb_dequeue(&gpdev->queue);
+	if (skb) {
+		wait = ktime_to_ns(ktime_sub(ktime_get(), skb->tstamp));
+		gpdev->stats.rx_pkts++;
+		gpdev->stats.rx_bytes += skb->len;
+		gpdev->stats.rx_wait_ns += wait;
+		gpdev->stats.rx_max_wait_ns = max(gpdev->stats.rx_max_wait_ns,
+						  wait);
+	}
 	spin_unlock_irqrestore(&gpdev->queue_lock, flags);
 	if (!skb)
 		return -EFAULT;
 
-	use = min_t(size_t, count, skb->len);
-	if (copy_to_user(buf, skb->data, use))
+	use = min_t(size_t, iov_iter_count(to), skb->len);
+	if (copy_to_iter(skb->data, use, to) != use)
 		use = -EFAULT;
 
 	kfree_skb(skb);
@@ -399,33 +436,43 @@ ssize_t glink_pkt_read(struct file *file, char __user *buf,
 }
 
 /**
- * glink_pkt_write() - write() syscall for the glink_pkt device
- * file:	Pointer to the file structure.
- * buf:		Pointer to the userspace buffer.
- * count:	Number bytes to read from the file.
- * ppos:	Pointer to the position into the file.
+ * glink_pkt_write_iter() - write() and writev() syscalls for the glink_pkt
+ * device
+ * iocb:	Pointer to the kiocb of the file.
+ * from:	Source iovecs in userspace.
  *
  * This function is used to write the data to glink pkt device when
- * userspace client do a write() system call. All input arguments are
- * validated by the virtual file system before calling this function.
+ * userspace client do a write() or writev() system call. The iovecs are
+ * gathered into a single packet and a single rpmsg transfer. Packets up to
+ * GLINK_PKT_TX_BUF_SIZE are staged in a per device buffer instead of a
+ * fresh allocation. All input arguments are validated by the virtual file
+ * system before calling this function.
  */
-ssize_t glink_pkt_write(struct file *file, const char __user *buf,
-			size_t count, loff_t *ppos)
+static ssize_t glink_pkt_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
+	struct file *file = iocb->ki_filp;
 	struct glink_pkt_device *gpdev = file->private_data;
-	void *kbuf;
+	size_t count = iov_iter_count(from);
+	void *kbuf = NULL;
+	ktime_t start;
+	u64 delta;
 	int ret;
 
-	gpdev = file->private_data;
 	if (!gpdev || refcount_read(&gpdev->refcount) == 1) {
 		GLINK_PKT_ERR("invalid device handle\n");
 		return -EINVAL;
 	}
 
 	GLINK_PKT_INFO("begin to %s buffer_size %zu\n", gpdev->ch_name, count);
-	kbuf = memdup_user(buf, count);
-	if (IS_ERR(kbuf))
-		return PTR_ERR(kbuf);
+	if (count > GLINK_PKT_TX_BUF_SIZE || !gpdev->tx_buf) {
+		kbuf = kmalloc(count, GFP_KERNEL);
+		if (!kbuf)
+			return -ENOMEM;
+		if (!copy_from_iter_full(kbuf, count, from)) {
+			ret = -EFAULT;
+			goto free_kbuf;
+		}
+	}
 
 	if (mutex_lock_interruptible(&gpdev->lock)) {
 		ret = -ERESTARTSYS;
@@ -437,10 +484,25 @@ ssize_t glink_pkt_write(struct file *file, const char __user *buf,
 		goto unlock_ch;
 	}
 
+	if (!kbuf && !copy_from_iter_full(gpdev->tx_buf, count, from)) {
+		ret = -EFAULT;
+		goto unlock_ch;
+	}
+
+	start = ktime_get();
 	if (file->f_flags & O_NONBLOCK)
-		ret = rpmsg_trysend(gpdev->rpdev->ept, kbuf, count);
+		ret = rpmsg_trysend(gpdev->rpdev->ept, kbuf ?: gpdev->tx_buf,
+				    count);
 	else
-		ret = rpmsg_send(gpdev->rpdev->ept, kbuf, count);
+		ret = rpmsg_send(gpdev->rpdev->ept, kbuf ?: gpdev->tx_buf,
+				 count);
+	if (!ret) {
+		delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+		gpdev->stats.tx_pkts++;
+		gpdev->stats.tx_bytes += count;
+		gpdev->stats.tx_ns += delta;
+		gpdev->stats.tx_max_ns = max(gpdev->stats.tx_max_ns, delta);
+	}
 
 unlock_ch:
 	mutex_unlock(&gpdev->lock);
@@ -609,8 +671,8 @@ static const struct file_operations glink_pkt_fops = {
 	.owner = THIS_MODULE,
 	.open = glink_pkt_open,
 	.release = glink_pkt_release,
-	.read = glink_pkt_read,
-	.write = glink_pkt_write,
+	.read_iter = glink_pkt_read_iter,
+	.write_iter = glink_pkt_write_iter,
 	.poll = glink_pkt_poll,
 	.unlocked_ioctl = glink_pkt_ioctl,
 	.compat_ioctl = glink_pkt_ioctl,
@@ -625,8 +687,42 @@ static ssize_t name_show(struct device *dev, struct device_attribute *attr,
 }
 static DEVICE_ATTR_RO(name);
 
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct glink_pkt_device *gpdev = dev_to_gpdev(dev);
+	unsigned long flags;
+	ssize_t len;
+
+	mutex_lock(&gpdev->lock);
+	spin_lock_irqsave(&gpdev->queue_lock, flags);
+	len = scnprintf(buf, PAGE_SIZE,
+			"tx_pkts %llu\ntx_bytes %llu\ntx_avg_us %llu\ntx_max_us %llu\n"
+			"rx_pkts %llu\nrx_bytes %llu\nrx_drops %llu\n"
+			"rx_avg_wait_us %llu\nrx_max_wait_us %llu\nrx_queued %u\nrx_max_queued %u\n",
+			gpdev->stats.tx_pkts, gpdev->stats.tx_bytes,
+			div64_u64(gpdev->stats.tx_ns,
+				  max_t(u64, gpdev->stats.tx_pkts, 1)) /
+				NSEC_PER_USEC,
+			div_u64(gpdev->stats.tx_max_ns, NSEC_PER_USEC),
+			gpdev->stats.rx_pkts, gpdev->stats.rx_bytes,
+			gpdev->stats.rx_drops,
+			div64_u64(gpdev->stats.rx_wait_ns,
+				  max_t(u64, gpdev->stats.rx_pkts, 1)) /
+				NSEC_PER_USEC,
+			div_u64(gpdev->stats.rx_max_wait_ns, NSEC_PER_USEC),
+			skb_queue_len(&gpdev->queue),
+			gpdev->stats.rx_max_queued);
+	spin_unlock_irqrestore(&gpdev->queue_lock, flags);
+	mutex_unlock(&gpdev->lock);
+
+	return len;
+}
+static DEVICE_ATTR_RO(stats);
+
 static struct attribute *glink_pkt_device_attrs[] = {
 	&dev_attr_name.attr,
+	&dev_attr_stats.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(glink_pkt_device);
@@ -732,6 +828,9 @@ static int glink_pkt_create_device(struct device *parent,
 		goto free_gpdev;
 	}
 
+	/* Without it writes fall back to a buffer per packet */
+	gpdev->tx_buf = devm_kmalloc(parent, GLINK_PKT_TX_BUF_SIZE, GFP_KERNEL);
+
 	dev = &gpdev->dev;
 	mutex_init(&gpdev->lock);
 	refcount_set(&gpdev->refcount, 1);
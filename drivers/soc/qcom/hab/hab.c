@@ -594,6 +594,11 @@ long hab_vchan_send(struct uhab_context *ctx,
 
 		schedule();
 	}
+
+	if (!ret) {
+		atomic64_inc(&vchan->stat.tx_cnt);
+		atomic64_add(sizebytes, &vchan->stat.tx_bytes);
+	}
 err:
 	if (vchan)
 		hab_vchan_put(vchan);
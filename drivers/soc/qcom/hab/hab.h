@@ -323,6 +323,27 @@ struct hab_driver {
 	void *hab_vmm_handle;
 };
 
+/* per vchan traffic counters, reported by hab_stat_show_vchan() */
+struct hab_vchan_stat {
+	atomic64_t tx_cnt;
+	atomic64_t tx_bytes;
+	atomic64_t rx_cnt;
+	atomic64_t rx_bytes;
+	atomic64_t rx_drop;
+	atomic64_t exp_cnt;
+	atomic64_t exp_ack_us; /* total time waiting for export acks */
+	atomic64_t exp_ack_max_us;
+	int rx_qlen; /* protected by rx_lock */
+	int rx_qlen_max;
+};
+
+static inline void hab_stat_update_max(atomic64_t *max, s64 val)
+{
+	/* racing updaters may lose a sample, good enough for reporting */
+	if (val > atomic64_read(max))
+		atomic64_set(max, val);
+}
+
 struct virtual_channel {
 	struct list_head node; /* for ctx */
 	struct list_head pnode; /* for pchan */
@@ -349,6 +370,8 @@ struct virtual_channel {
 	 */
 	int closed;
 	int forked; /* if fork is detected and assume only once */
+
+	struct hab_vchan_stat stat;
 };
 
 /*
@@ -196,6 +196,8 @@ static int habmem_export_vchan(struct uhab_context *ctx,
 	uint32_t sizebytes = sizeof(*exp) + payload_size;
 	struct hab_export_ack expected_ack = {0};
 	struct hab_header header = HAB_HEADER_INITIALIZER;
+	ktime_t start;
+	s64 wait_us;
 
 	exp = idr_find(&vchan->pchan->expid_idr, export_id);
 	if (!exp) {
@@ -208,6 +210,7 @@ static int habmem_export_vchan(struct uhab_context *ctx,
 	HAB_HEADER_SET_TYPE(header, HAB_PAYLOAD_TYPE_EXPORT);
 	HAB_HEADER_SET_ID(header, vchan->otherend_id);
 	HAB_HEADER_SET_SESSION_ID(header, vchan->session_id);
+	start = ktime_get();
 	ret = physical_channel_send(vchan->pchan, &header, exp);
 
 	if (ret != 0) {
@@ -225,6 +228,11 @@ static int habmem_export_vchan(struct uhab_context *ctx,
 		return ret;
 	}
 
+	wait_us = ktime_us_delta(ktime_get(), start);
+	atomic64_inc(&vchan->stat.exp_cnt);
+	atomic64_add(wait_us, &vchan->stat.exp_ack_us);
+	hab_stat_update_max(&vchan->stat.exp_ack_max_us, wait_us);
+
 	return ret;
 }
 
@@ -87,6 +87,7 @@ hab_msg_dequeue(struct virtual_channel *vchan, struct hab_message **msg,
 			if (*rsize >= message->sizebytes) {
 				/* msg can be safely retrieved in full */
 				list_del(&message->node);
+				vchan->stat.rx_qlen--;
 				ret = 0;
 				*rsize = message->sizebytes;
 			} else {
@@ -115,8 +116,13 @@ static void hab_msg_queue(struct virtual_channel *vchan,
 
 	hab_spin_lock(&vchan->rx_lock, irqs_disabled);
 	list_add_tail(&message->node, &vchan->rx_list);
+	if (++vchan->stat.rx_qlen > vchan->stat.rx_qlen_max)
+		vchan->stat.rx_qlen_max = vchan->stat.rx_qlen;
 	hab_spin_unlock(&vchan->rx_lock, irqs_disabled);
 
+	atomic64_inc(&vchan->stat.rx_cnt);
+	atomic64_add(message->sizebytes, &vchan->stat.rx_bytes);
+
 	wake_up(&vchan->rx_queue);
 }
 
@@ -249,6 +255,7 @@ int hab_msg_recv(struct physical_channel *pchan,
 			}
 			return -EINVAL;
 		} else if (vchan->otherend_closed) {
+			atomic64_inc(&vchan->stat.rx_drop);
 			hab_vchan_put(vchan);
 			pr_info("vchan remote is closed payload type %d, vchan id %x, sizebytes %zx, session %d\n",
 				payload_type, vchan_id,
@@ -283,8 +290,10 @@ int hab_msg_recv(struct physical_channel *pchan,
 	case HAB_PAYLOAD_TYPE_SCHE_RESULT_REQ:
 	case HAB_PAYLOAD_TYPE_SCHE_RESULT_RSP:
 		message = hab_msg_alloc(pchan, sizebytes);
-		if (!message)
+		if (!message) {
+			atomic64_inc(&vchan->stat.rx_drop);
 			break;
+		}
 
 		hab_msg_queue(vchan, message);
 		break;
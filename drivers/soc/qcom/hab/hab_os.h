@@ -42,6 +42,7 @@
 #include <linux/dma-direction.h>
 #include <linux/dma-mapping.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/reboot.h>
 #include <linux/kobject.h>
 #include <linux/sysfs.h>
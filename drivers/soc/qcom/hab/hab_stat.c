@@ -74,6 +74,24 @@ int hab_stat_show_vchan(struct hab_driver *driver,
 					vc->otherend_closed);
 			}
 			ret = hab_stat_buffer_print(buf, size, "\n");
+
+			list_for_each_entry(vc, &pchan->vchannels, pnode) {
+				struct hab_vchan_stat *st = &vc->stat;
+
+				ret = hab_stat_buffer_print(buf, size,
+					" %08X tx %lld/%lld rx %lld/%lld drop %lld q %d/%d\n",
+					vc->id, atomic64_read(&st->tx_cnt),
+					atomic64_read(&st->tx_bytes),
+					atomic64_read(&st->rx_cnt),
+					atomic64_read(&st->rx_bytes),
+					atomic64_read(&st->rx_drop),
+					st->rx_qlen, st->rx_qlen_max);
+				ret = hab_stat_buffer_print(buf, size,
+					" %08X exp %lld ack %lld/%lld us\n",
+					vc->id, atomic64_read(&st->exp_cnt),
+					atomic64_read(&st->exp_ack_us),
+					atomic64_read(&st->exp_ack_max_us));
+			}
 			read_unlock(&pchan->vchans_lock);
 		}
 		spin_unlock_bh(&dev->pchan_lock);
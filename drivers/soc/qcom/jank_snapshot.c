@@ -0,0 +1,197 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Jank snapshots
+ *
+ * When the compositor misses a frame it asks for a snapshot through
+ * JANK_SNAPSHOT_TRIGGER. The registered sources (scheduler, PSI, GPU,
+ * block) print their current state, one after the other, into the next
+ * of a few preallocated text buffers. Reading /dev/jank_snapshot returns
+ * the retained snapshots, so the field jank reports no longer need
+ * always-on tracing.
+ */
+
+#include <linux/fs.h>
+#include <linux/jank_snapshot.h>
+#include <linux/ktime.h>
+#include <linux/miscdevice.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <uapi/linux/jank_snapshot.h>
+
+#define JANK_NR_SNAPSHOTS	4
+
+struct jank_snap {
+	u64 seq;
+	u64 tag;
+	u64 time;
+	u64 duration;
+	size_t len;
+	bool truncated;
+	char *buf;
+};
+
+static unsigned int buf_kb = 32;
+module_param(buf_kb, uint, 0444);
+MODULE_PARM_DESC(buf_kb, "Size of each snapshot buffer in kB");
+
+static unsigned int min_interval_ms = 100;
+module_param(min_interval_ms, uint, 0644);
+MODULE_PARM_DESC(min_interval_ms, "Minimum time between two snapshots");
+
+static LIST_HEAD(jank_sources);
+/* protects the sources and the snapshots */
+static DEFINE_MUTEX(jank_lock);
+static struct jank_snap jank_snaps[JANK_NR_SNAPSHOTS];
+static u64 jank_seq;
+
+void jank_snapshot_register(struct jank_snapshot_source *src)
+{
+	mutex_lock(&jank_lock);
+	list_add_tail(&src->node, &jank_sources);
+	mutex_unlock(&jank_lock);
+}
+EXPORT_SYMBOL(jank_snapshot_register);
+
+void jank_snapshot_unregister(struct jank_snapshot_source *src)
+{
+	mutex_lock(&jank_lock);
+	list_del(&src->node);
+	mutex_unlock(&jank_lock);
+}
+EXPORT_SYMBOL(jank_snapshot_unregister);
+
+static long jank_snapshot_take(u64 tag, u64 *seq)
+{
+	struct jank_snapshot_source *src;
+	struct jank_snap *snap, *prev;
+	struct seq_file m = { };
+	u64 now;
+
+	mutex_lock(&jank_lock);
+	now = ktime_get_ns();
+	if (jank_seq) {
+		prev = &jank_snaps[(jank_seq - 1) % JANK_NR_SNAPSHOTS];
+		if (now - prev->time < (u64)min_interval_ms * NSEC_PER_MSEC) {
+			mutex_unlock(&jank_lock);
+			return -EBUSY;
+		}
+	}
+
+	snap = &jank_snaps[jank_seq % JANK_NR_SNAPSHOTS];
+	m.buf = snap->buf;
+	m.size = (size_t)buf_kb << 10;
+
+	list_for_each_entry(src, &jank_sources, node) {
+		seq_printf(&m, "[%s]\n", src->name);
+		src->show(&m, src->priv);
+	}
+
+	snap->truncated = seq_has_overflowed(&m);
+	snap->len = min(m.count, m.size);
+	snap->duration = ktime_get_ns() - now;
+	snap->time = now;
+	snap->tag = tag;
+	snap->seq = *seq = ++jank_seq;
+	mutex_unlock(&jank_lock);
+
+	return 0;
+}
+
+static long jank_snapshot_ioctl(struct file *file, unsigned int cmd,
+				unsigned long arg)
+{
+	struct jank_snapshot_trigger __user *uarg = (void __user *)arg;
+	struct jank_snapshot_trigger trig;
+	long ret;
+
+	if (cmd != JANK_SNAPSHOT_TRIGGER)
+		return -ENOTTY;
+
+	if (copy_from_user(&trig, uarg, sizeof(trig)))
+		return -EFAULT;
+
+	ret = jank_snapshot_take(trig.tag, &trig.seq);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(uarg, &trig, sizeof(trig)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int jank_snapshot_show(struct seq_file *m, void *v)
+{
+	struct jank_snap *snap;
+	u64 seq;
+
+	mutex_lock(&jank_lock);
+	seq = jank_seq > JANK_NR_SNAPSHOTS ? jank_seq - JANK_NR_SNAPSHOTS : 0;
+	for (; seq < jank_seq; seq++) {
+		snap = &jank_snaps[seq % JANK_NR_SNAPSHOTS];
+		seq_printf(m, "snapshot %llu tag %llu time %llu duration_ns %llu%s\n",
+			   snap->seq, snap->tag, snap->time, snap->duration,
+			   snap->truncated ? " truncated" : "");
+		seq_write(m, snap->buf, snap->len);
+		seq_putc(m, '\n');
+	}
+	mutex_unlock(&jank_lock);
+
+	return 0;
+}
+
+static int jank_snapshot_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, jank_snapshot_show, NULL,
+				JANK_NR_SNAPSHOTS * (((size_t)buf_kb << 10) +
+						     PAGE_SIZE));
+}
+
+static const struct file_operations jank_snapshot_fops = {
+	.owner		= THIS_MODULE,
+	.open		= jank_snapshot_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+	.unlocked_ioctl	= jank_snapshot_ioctl,
+	.compat_ioctl	= jank_snapshot_ioctl,
+};
+
+static struct miscdevice jank_snapshot_dev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "jank_snapshot",
+	.fops	= &jank_snapshot_fops,
+};
+
+static int __init jank_snapshot_init(void)
+{
+	int i;
+
+	buf_kb = clamp(buf_kb, 4U, 1024U);
+	for (i = 0; i < JANK_NR_SNAPSHOTS; i++) {
+		jank_snaps[i].buf = vmalloc((size_t)buf_kb << 10);
+		if (!jank_snaps[i].buf)
+			goto err;
+	}
+
+	return misc_register(&jank_snapshot_dev);
+err:
+	while (i--)
+		vfree(jank_snaps[i].buf);
+	return -ENOMEM;
+}
+module_init(jank_snapshot_init);
@@ -25,6 +25,7 @@
 #include <linux/err.h>
 #include <linux/mfd/syscon.h>
 #include <linux/regmap.h>
+#include <linux/workqueue.h>
 #include <linux/soc/qcom/llcc-qcom.h>
 
 #define ACTIVATE                      0x1
@@ -56,12 +57,54 @@
 #define LLCC_TRP_PCB_ACT 0x21F04
 #define LLCC_TRP_SCID_DIS_CAP_ALLOC 0x21F00
 
+#define LLCC_MAX_BANKS			16
+#define LLCC_SCID_CUR_CAP_MASK		GENMASK(29, 16)
+#define LLCC_SCID_CUR_CAP_SHIFT		16
+
+/*
+ * The dynamic policy samples the occupancy of each active, non fixed size
+ * slice every LLCC_GOV_PERIOD_MS. A slice filling LLCC_GOV_GROW_PCT of its
+ * capacity grows by a quarter of its table capacity, up to twice the table
+ * value, and shrinks back by the same step once it drops below
+ * LLCC_GOV_SHRINK_PCT.
+ */
+#define LLCC_GOV_PERIOD_MS		1000
+#define LLCC_GOV_GROW_PCT		90
+#define LLCC_GOV_SHRINK_PCT		50
+#define LLCC_GOV_STEP_DIV		4
+#define LLCC_GOV_MAX_SCALE		2
+#define LLCC_BOOST_PRIORITY		0
+
+enum llcc_policy {
+	LLCC_POLICY_STATIC,
+	LLCC_POLICY_DYNAMIC,
+	LLCC_POLICY_BOOST,
+};
+
+/**
+ * struct llcc_slice_state - runtime attributes of a slice
+ * @max_cap: capacity currently programmed, in KB
+ * @priority: priority currently programmed
+ * @occupancy: percentage of @max_cap in use at the last sample
+ */
+struct llcc_slice_state {
+	u32 max_cap;
+	u32 priority;
+	u32 occupancy;
+};
+
 /**
  * Driver data for llcc
  * @llcc_virt_base: base address for llcc controller
  * @slice_data: pointer to llcc slice config data
  * @sz: Size of the config data table
  * @llcc_slice_map: Bit map to track the active slice ids
+ * @bank_off: offsets of the llcc banks, for reading slice occupancy
+ * @has_bank_off: whether @bank_off was found in the device tree
+ * @state: runtime attributes of each entry of @slice_data
+ * @policy: current slice sizing policy
+ * @boost_idx: entry of @slice_data favoured by LLCC_POLICY_BOOST
+ * @gov_work: periodic work of LLCC_POLICY_DYNAMIC
  */
 struct llcc_drv_data {
 	struct regmap *llcc_map;
@@ -73,6 +116,12 @@ struct llcc_drv_data {
 	u32 no_banks;
 	unsigned long *llcc_slice_map;
 	bool cap_based_alloc_and_pwr_collapse;
+	u32 bank_off[LLCC_MAX_BANKS];
+	bool has_bank_off;
+	struct llcc_slice_state *state;
+	enum llcc_policy policy;
+	int boost_idx;
+	struct delayed_work gov_work;
 };
 
 /* Get the slice entry by index */
@@ -315,16 +364,266 @@ size_t llcc_get_slice_size(struct llcc_slice_desc *desc)
 }
 EXPORT_SYMBOL(llcc_get_slice_size);
 
+static void llcc_slice_program_attr1(struct llcc_drv_data *drv,
+				     const struct llcc_slice_config *cfg,
+				     u32 max_cap, u32 priority)
+{
+	u32 attr1_cfg = drv->b_off + LLCC_TRP_ATTR1_CFGn(cfg->slice_id);
+	u32 attr1_val;
+	u32 max_cap_cacheline;
+
+	attr1_val = cfg->cache_mode;
+	attr1_val |= (cfg->probe_target_ways << ATTR1_PROBE_TARGET_WAYS_SHIFT);
+	attr1_val |= (cfg->fixed_size << ATTR1_FIXED_SIZE_SHIFT);
+	attr1_val |= (priority << ATTR1_PRIORITY_SHIFT);
+
+	max_cap_cacheline = MAX_CAP_TO_BYTES(max_cap);
+
+	/* LLCC instances can vary for each target.
+	 * The SW writes to broadcast register which gets propagated
+	 * to each llcc instace (llcc0,.. llccN).
+	 * Since the size of the memory is divided equally amongst the
+	 * llcc instances, we need to configure the max cap accordingly.
+	 */
+	max_cap_cacheline = (max_cap_cacheline / drv->no_banks);
+	max_cap_cacheline >>= CACHE_LINE_SIZE_SHIFT;
+	attr1_val |= (max_cap_cacheline << ATTR1_MAX_CAP_SHIFT);
+
+	regmap_write(drv->llcc_map, attr1_cfg, attr1_val);
+}
+
+/* Percentage of the programmed capacity of slice entry @i in use */
+static u32 llcc_slice_occupancy(struct llcc_drv_data *drv, int i)
+{
+	const struct llcc_slice_config *cfg = &drv->slice_data[i];
+	u32 lines = 0, max_lines, val;
+	int j;
+
+	if (!drv->has_bank_off)
+		return 0;
+
+	for (j = 0; j < drv->no_banks; j++) {
+		regmap_read(drv->llcc_map,
+			    drv->bank_off[j] + LLCC_TRP_STATUSn(cfg->slice_id),
+			    &val);
+		lines += (val & LLCC_SCID_CUR_CAP_MASK) >>
+				LLCC_SCID_CUR_CAP_SHIFT;
+	}
+
+	max_lines = MAX_CAP_TO_BYTES(drv->state[i].max_cap) >>
+			CACHE_LINE_SIZE_SHIFT;
+	if (!max_lines)
+		return 0;
+
+	return min_t(u32, lines * 100 / max_lines, 100);
+}
+
+/*
+ * Reprograms slice entry @i, called with slice_mutex held. The TRP picks
+ * up new attributes when a slice is activated, so an active slice is
+ * cycled through deactivation.
+ */
+static void llcc_slice_apply(struct llcc_drv_data *drv, int i, u32 max_cap,
+			     u32 priority)
+{
+	const struct llcc_slice_config *cfg = &drv->slice_data[i];
+	struct llcc_slice_state *state = &drv->state[i];
+	u32 act_ctrl_val;
+
+	if (state->max_cap == max_cap && state->priority == priority)
+		return;
+
+	state->max_cap = max_cap;
+	state->priority = priority;
+	llcc_slice_program_attr1(drv, cfg, max_cap, priority);
+
+	/* Make sure that the SCT is programmed before activating */
+	mb();
+
+	if (!test_bit(cfg->slice_id, drv->llcc_slice_map))
+		return;
+
+	act_ctrl_val = ACT_CTRL_OPCODE_DEACTIVATE << ACT_CTRL_OPCODE_SHIFT;
+	act_ctrl_val |= ACT_CTRL_ACT_TRIG;
+	if (llcc_update_act_ctrl(drv, cfg->slice_id, act_ctrl_val, ACTIVATE))
+		pr_err("deactivate slice id: %d timed out\n", cfg->slice_id);
+
+	act_ctrl_val = ACT_CTRL_OPCODE_ACTIVATE << ACT_CTRL_OPCODE_SHIFT;
+	act_ctrl_val |= ACT_CTRL_ACT_TRIG;
+	if (llcc_update_act_ctrl(drv, cfg->slice_id, act_ctrl_val, DEACTIVATE))
+		pr_err("activate slice id: %d timed out\n", cfg->slice_id);
+}
+
+static void llcc_gov_work(struct work_struct *work)
+{
+	struct llcc_drv_data *drv = container_of(to_delayed_work(work),
+					struct llcc_drv_data, gov_work);
+	const struct llcc_slice_config *cfg;
+	struct llcc_slice_state *state;
+	u32 max_cap, step;
+	int i;
+
+	mutex_lock(&drv->slice_mutex);
+	if (drv->policy != LLCC_POLICY_DYNAMIC) {
+		mutex_unlock(&drv->slice_mutex);
+		return;
+	}
+
+	for (i = 0; i < drv->llcc_config_data_sz; i++) {
+		cfg = &drv->slice_data[i];
+		state = &drv->state[i];
+
+		if (cfg->fixed_size ||
+		    !test_bit(cfg->slice_id, drv->llcc_slice_map))
+			continue;
+
+		state->occupancy = llcc_slice_occupancy(drv, i);
+		step = max_t(u32, cfg->max_cap / LLCC_GOV_STEP_DIV, 1);
+		max_cap = state->max_cap;
+
+		if (state->occupancy >= LLCC_GOV_GROW_PCT)
+			max_cap = min(max_cap + step,
+				      cfg->max_cap * LLCC_GOV_MAX_SCALE);
+		else if (state->occupancy < LLCC_GOV_SHRINK_PCT)
+			max_cap = max_cap > cfg->max_cap + step ?
+					max_cap - step : cfg->max_cap;
+
+		llcc_slice_apply(drv, i, max_cap, cfg->priority);
+	}
+	mutex_unlock(&drv->slice_mutex);
+
+	queue_delayed_work(system_power_efficient_wq, &drv->gov_work,
+			   msecs_to_jiffies(LLCC_GOV_PERIOD_MS));
+}
+
+static int llcc_set_policy(struct llcc_drv_data *drv, enum llcc_policy policy,
+			   int boost_idx)
+{
+	const struct llcc_slice_config *cfg;
+	int i;
+
+	if (policy == LLCC_POLICY_DYNAMIC && !drv->has_bank_off)
+		return -ENODEV;
+
+	mutex_lock(&drv->slice_mutex);
+	for (i = 0; i < drv->llcc_config_data_sz; i++) {
+		cfg = &drv->slice_data[i];
+		if (policy == LLCC_POLICY_BOOST && i == boost_idx)
+			llcc_slice_apply(drv, i,
+					 cfg->max_cap * LLCC_GOV_MAX_SCALE,
+					 LLCC_BOOST_PRIORITY);
+		else
+			llcc_slice_apply(drv, i, cfg->max_cap, cfg->priority);
+	}
+	drv->policy = policy;
+	drv->boost_idx = boost_idx;
+	mutex_unlock(&drv->slice_mutex);
+
+	if (policy == LLCC_POLICY_DYNAMIC)
+		mod_delayed_work(system_power_efficient_wq, &drv->gov_work, 0);
+	else
+		cancel_delayed_work_sync(&drv->gov_work);
+
+	return 0;
+}
+
+static ssize_t slice_policy_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct llcc_drv_data *drv = dev_get_drvdata(dev);
+
+	switch (drv->policy) {
+	case LLCC_POLICY_DYNAMIC:
+		return scnprintf(buf, PAGE_SIZE, "dynamic\n");
+	case LLCC_POLICY_BOOST:
+		return scnprintf(buf, PAGE_SIZE, "%s\n",
+				 drv->slice_data[drv->boost_idx].name);
+	default:
+		return scnprintf(buf, PAGE_SIZE, "static\n");
+	}
+}
+
+/*
+ * "static" programs the table values, "dynamic" starts the occupancy
+ * governor and the name of a slice gives that slice twice its table
+ * capacity at the highest priority.
+ */
+static ssize_t slice_policy_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct llcc_drv_data *drv = dev_get_drvdata(dev);
+	int i, ret;
+
+	if (sysfs_streq(buf, "static")) {
+		ret = llcc_set_policy(drv, LLCC_POLICY_STATIC, 0);
+	} else if (sysfs_streq(buf, "dynamic")) {
+		ret = llcc_set_policy(drv, LLCC_POLICY_DYNAMIC, 0);
+	} else {
+		for (i = 0; i < drv->llcc_config_data_sz; i++)
+			if (sysfs_streq(buf, drv->slice_data[i].name))
+				break;
+
+		if (i == drv->llcc_config_data_sz)
+			return -EINVAL;
+
+		ret = llcc_set_policy(drv, LLCC_POLICY_BOOST, i);
+	}
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(slice_policy);
+
+static ssize_t slice_status_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct llcc_drv_data *drv = dev_get_drvdata(dev);
+	const struct llcc_slice_config *cfg;
+	struct llcc_slice_state *state;
+	ssize_t cnt;
+	int i;
+
+	cnt = scnprintf(buf, PAGE_SIZE, "%-12s %4s %6s %8s %8s %4s %5s\n",
+			"name", "scid", "active", "tbl_kb", "cur_kb", "prio",
+			"occ%");
+
+	mutex_lock(&drv->slice_mutex);
+	for (i = 0; i < drv->llcc_config_data_sz; i++) {
+		cfg = &drv->slice_data[i];
+		state = &drv->state[i];
+		if (test_bit(cfg->slice_id, drv->llcc_slice_map))
+			state->occupancy = llcc_slice_occupancy(drv, i);
+
+		cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt,
+				 "%-12s %4d %6d %8u %8u %4u %5u\n",
+				 cfg->name, cfg->slice_id,
+				 test_bit(cfg->slice_id, drv->llcc_slice_map),
+				 cfg->max_cap, state->max_cap,
+				 state->priority, state->occupancy);
+	}
+	mutex_unlock(&drv->slice_mutex);
+
+	return cnt;
+}
+static DEVICE_ATTR_RO(slice_status);
+
+static struct attribute *llcc_slice_attrs[] = {
+	&dev_attr_slice_policy.attr,
+	&dev_attr_slice_status.attr,
+	NULL,
+};
+
+static const struct attribute_group llcc_slice_attr_group = {
+	.attrs = llcc_slice_attrs,
+};
+
 static void qcom_llcc_cfg_program(struct platform_device *pdev)
 {
 	int i;
-	u32 attr1_cfg;
 	u32 attr0_cfg;
-	u32 attr1_val;
 	u32 attr0_val;
 	u32 cad_off;
 	u32 pcb_off;
-	u32 max_cap_cacheline;
 	u32 sz;
 	u32 pcb = 0;
 	u32 cad = 0;
@@ -339,32 +638,16 @@ static void qcom_llcc_cfg_program(struct platform_device *pdev)
 	llcc_table = drv->slice_data;
 
 	for (i = 0; i < sz; i++) {
-		attr1_cfg = b_off + LLCC_TRP_ATTR1_CFGn(llcc_table[i].slice_id);
 		attr0_cfg = b_off + LLCC_TRP_ATTR0_CFGn(llcc_table[i].slice_id);
 
-		attr1_val = llcc_table[i].cache_mode;
-		attr1_val |= (llcc_table[i].probe_target_ways <<
-				ATTR1_PROBE_TARGET_WAYS_SHIFT);
-		attr1_val |= (llcc_table[i].fixed_size <<
-				ATTR1_FIXED_SIZE_SHIFT);
-		attr1_val |= (llcc_table[i].priority << ATTR1_PRIORITY_SHIFT);
-
-		max_cap_cacheline = MAX_CAP_TO_BYTES(llcc_table[i].max_cap);
-
-		/* LLCC instances can vary for each target.
-		 * The SW writes to broadcast register which gets propagated
-		 * to each llcc instace (llcc0,.. llccN).
-		 * Since the size of the memory is divided equally amongst the
-		 * llcc instances, we need to configure the max cap accordingly.
-		 */
-		max_cap_cacheline = (max_cap_cacheline / drv->no_banks);
-		max_cap_cacheline >>= CACHE_LINE_SIZE_SHIFT;
-		attr1_val |= (max_cap_cacheline << ATTR1_MAX_CAP_SHIFT);
-
 		attr0_val = llcc_table[i].res_ways & ATTR0_RES_WAYS_MASK;
 		attr0_val |= llcc_table[i].bonus_ways << ATR0_BONUS_WAYS_SHIFT;
 
-		regmap_write(drv->llcc_map, attr1_cfg, attr1_val);
+		drv->state[i].max_cap = llcc_table[i].max_cap;
+		drv->state[i].priority = llcc_table[i].priority;
+		llcc_slice_program_attr1(drv, &llcc_table[i],
+					 llcc_table[i].max_cap,
+					 llcc_table[i].priority);
 		regmap_write(drv->llcc_map, attr0_cfg, attr0_val);
 
 		if (cap_based_alloc_and_pwr_collapse) {
@@ -444,14 +727,33 @@ int qcom_llcc_probe(struct platform_device *pdev,
 		return PTR_ERR(drv_data->llcc_slice_map);
 	}
 
+	drv_data->state = devm_kcalloc(dev, sz, sizeof(*drv_data->state),
+				       GFP_KERNEL);
+	if (!drv_data->state) {
+		kfree(drv_data->llcc_slice_map);
+		devm_kfree(&pdev->dev, drv_data);
+		return -ENOMEM;
+	}
+
+	/* Bank offsets are only needed to report slice occupancy */
+	if (num_banks <= LLCC_MAX_BANKS &&
+	    of_property_read_variable_u32_array(pdev->dev.parent->of_node,
+			"qcom,llcc-banks-off", drv_data->bank_off,
+			num_banks, num_banks) > 0)
+		drv_data->has_bank_off = true;
+
 	bitmap_zero(drv_data->llcc_slice_map, drv_data->max_slices);
 	drv_data->slice_data = llcc_cfg;
 	drv_data->llcc_config_data_sz = sz;
 	mutex_init(&drv_data->slice_mutex);
+	INIT_DELAYED_WORK(&drv_data->gov_work, llcc_gov_work);
 	platform_set_drvdata(pdev, drv_data);
 
 	qcom_llcc_cfg_program(pdev);
 
+	if (sysfs_create_group(&dev->kobj, &llcc_slice_attr_group))
+		dev_err(dev, "failed to create slice policy sysfs nodes\n");
+
 	return rc;
 }
 EXPORT_SYMBOL(qcom_llcc_probe);
@@ -462,6 +764,8 @@ int qcom_llcc_remove(struct platform_device *pdev)
 
 	drv_data = platform_get_drvdata(pdev);
 
+	sysfs_remove_group(&pdev->dev.kobj, &llcc_slice_attr_group);
+	cancel_delayed_work_sync(&drv_data->gov_work);
 	mutex_destroy(&drv_data->slice_mutex);
 	kfree(drv_data->llcc_slice_map);
 	devm_kfree(&pdev->dev, drv_data);
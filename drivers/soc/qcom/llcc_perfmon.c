@@ -17,6 +17,7 @@
 #include <linux/mutex.h>
 #include <linux/bitops.h>
 #include <linux/io.h>
+#include <linux/slab.h>
 #include <linux/hrtimer.h>
 #include <linux/mfd/syscon.h>
 #include <linux/regmap.h>
@@ -26,6 +27,9 @@
 #include "llcc_events.h"
 #include "llcc_perfmon.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/llcc_perfmon.h>
+
 #define LLCC_PERFMON_NAME		"llcc_perfmon"
 #define LLCC_PERFMON_COUNTER_MAX	16
 #define MAX_NUMBER_OF_PORTS		8
@@ -79,6 +83,8 @@ struct event_port_ops {
  * @clk:		clock node to enable qdss
  * @num_mc:		number of MCS
  * @version:		Version information of llcc block
+ * @filter_scid:	SCID matched by the filtered ports, -1 if none
+ * @sample_scids:	SCIDs the filter rotates through on each dump
  */
 struct llcc_perfmon_private {
 	struct regmap *llcc_map;
@@ -97,6 +103,8 @@ struct llcc_perfmon_private {
 	struct clk *clock;
 	unsigned int num_mc;
 	unsigned int version;
+	int filter_scid;
+	unsigned long sample_scids;
 };
 
 static inline void llcc_bcast_write(struct llcc_perfmon_private *llcc_priv,
@@ -124,11 +132,45 @@ static void llcc_bcast_modify(struct llcc_perfmon_private *llcc_priv,
 	llcc_bcast_write(llcc_priv, offset, readval);
 }
 
+/* Moves the SCID filter to the next slice of the sampling set */
+static void perfmon_sample_next_scid(struct llcc_perfmon_private *llcc_priv)
+{
+	struct event_port_ops *port_ops;
+	unsigned long next;
+	unsigned int port;
+
+	if (!llcc_priv->sample_scids || llcc_priv->filter_scid < 0)
+		return;
+
+	next = find_next_bit(&llcc_priv->sample_scids, SCID_MAX,
+			     llcc_priv->filter_scid + 1);
+	if (next >= SCID_MAX)
+		next = find_first_bit(&llcc_priv->sample_scids, SCID_MAX);
+
+	if (next == llcc_priv->filter_scid)
+		return;
+
+	for (port = 0; port < MAX_NUMBER_OF_PORTS; port++) {
+		if (!(llcc_priv->filtered_ports & (1 << port)))
+			continue;
+
+		port_ops = llcc_priv->port_ops[port];
+		if (port_ops && port_ops->event_filter_config)
+			port_ops->event_filter_config(llcc_priv, SCID, next,
+					true);
+	}
+
+	llcc_priv->filter_scid = next;
+}
+
 static void perfmon_counter_dump(struct llcc_perfmon_private *llcc_priv)
 {
+	struct llcc_perfmon_counter_map *counter_map;
+	unsigned long long totals[LLCC_PERFMON_COUNTER_MAX];
 	uint32_t val;
 	unsigned int i, j;
 	unsigned long long total;
+	int scid;
 
 	if (!llcc_priv->configured_counters)
 		return;
@@ -142,8 +184,26 @@ static void perfmon_counter_dump(struct llcc_perfmon_private *llcc_priv)
 			total += val;
 		}
 
+		totals[i] = total;
 		llcc_priv->configured[i].counter_dump += total;
 	}
+
+	/*
+	 * Counters clear on dump, so each dump is one sample. The last
+	 * counter counts cycles.
+	 */
+	for (i = 0; i < llcc_priv->configured_counters - 1; i++) {
+		counter_map = &llcc_priv->configured[i];
+		scid = -1;
+		if (llcc_priv->filtered_ports & (1 << counter_map->port_sel))
+			scid = llcc_priv->filter_scid;
+
+		trace_llcc_perfmon_sample(counter_map->port_sel,
+				counter_map->event_sel, scid, totals[i],
+				totals[llcc_priv->configured_counters - 1]);
+	}
+
+	perfmon_sample_next_scid(llcc_priv);
 }
 
 static ssize_t perfmon_counter_dump_show(struct device *dev,
@@ -490,6 +550,9 @@ static ssize_t perfmon_filter_config_store(struct device *dev,
 					true);
 	}
 
+	if (filter == SCID)
+		llcc_priv->filter_scid = val;
+
 	mutex_unlock(&llcc_priv->mutex);
 	return count;
 
@@ -548,6 +611,11 @@ static ssize_t perfmon_filter_remove_store(struct device *dev,
 					false);
 	}
 
+	if (filter == SCID) {
+		llcc_priv->filter_scid = -1;
+		llcc_priv->sample_scids = 0;
+	}
+
 	mutex_unlock(&llcc_priv->mutex);
 	return count;
 
@@ -637,6 +705,51 @@ static ssize_t perfmon_ns_periodic_dump_store(struct device *dev,
 	return count;
 }
 
+/*
+ * Takes a list of SCIDs for the SCID filter to rotate through, moving on
+ * at every counter dump so that periodic dumps sample each slice in turn.
+ * An empty list stops the rotation.
+ */
+static ssize_t perfmon_sample_scids_store(struct device *dev,
+		struct device_attribute *attr, const char *buf,
+		size_t count)
+{
+	struct llcc_perfmon_private *llcc_priv = dev_get_drvdata(dev);
+	unsigned long scid, scids = 0;
+	char *token, *delim = DELIM_CHAR;
+	char *str, *pos;
+
+	str = kstrndup(buf, count, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+
+	pos = strim(str);
+	while ((token = strsep(&pos, delim)) != NULL) {
+		if (!*token)
+			continue;
+
+		if (kstrtoul(token, 0, &scid) || scid >= SCID_MAX) {
+			pr_err("invalid SCID %s\n", token);
+			kfree(str);
+			return -EINVAL;
+		}
+
+		scids |= BIT(scid);
+	}
+	kfree(str);
+
+	mutex_lock(&llcc_priv->mutex);
+	if (scids && llcc_priv->filter_scid < 0) {
+		pr_err("configure a SCID filter first\n");
+		mutex_unlock(&llcc_priv->mutex);
+		return -EINVAL;
+	}
+
+	llcc_priv->sample_scids = scids;
+	mutex_unlock(&llcc_priv->mutex);
+	return count;
+}
+
 static ssize_t perfmon_scid_status_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -684,6 +797,7 @@ static DEVICE_ATTR_WO(perfmon_filter_remove);
 static DEVICE_ATTR_WO(perfmon_start);
 static DEVICE_ATTR_RO(perfmon_scid_status);
 static DEVICE_ATTR_WO(perfmon_ns_periodic_dump);
+static DEVICE_ATTR_WO(perfmon_sample_scids);
 
 static struct attribute *llcc_perfmon_attrs[] = {
 	&dev_attr_perfmon_counter_dump.attr,
@@ -694,6 +808,7 @@ static struct attribute *llcc_perfmon_attrs[] = {
 	&dev_attr_perfmon_start.attr,
 	&dev_attr_perfmon_scid_status.attr,
 	&dev_attr_perfmon_ns_periodic_dump.attr,
+	&dev_attr_perfmon_sample_scids.attr,
 	NULL,
 };
 
@@ -1253,6 +1368,8 @@ static int llcc_perfmon_probe(struct platform_device *pdev)
 	if (llcc_priv == NULL)
 		return -ENOMEM;
 
+	llcc_priv->filter_scid = -1;
+
 	llcc_priv->llcc_map = syscon_node_to_regmap(dev->parent->of_node);
 	if (IS_ERR(llcc_priv->llcc_map))
 		return PTR_ERR(llcc_priv->llcc_map);
@@ -45,6 +45,8 @@ struct level_stats {
 	int64_t max_time[CONFIG_MSM_IDLE_STATS_BUCKET_COUNT];
 	int success_count;
 	int failed_count;
+	int mispredict_deep;
+	int mispredict_shallow;
 	uint64_t total_time;
 	uint64_t enter_time;
 };
@@ -123,6 +125,14 @@ static void level_stats_print(struct seq_file *m, struct level_stats *stats)
 		seq_puts(m, seqs);
 	}
 
+	if (stats->mispredict_deep || stats->mispredict_shallow) {
+		snprintf(seqs, MAX_STR_LEN,
+			"  mispredict too deep: %7d\n"
+			"  mispredict too shallow: %7d\n",
+			stats->mispredict_deep, stats->mispredict_shallow);
+		seq_puts(m, seqs);
+	}
+
 	bucket_time = stats->first_bucket_time;
 	for (i = 0;
 		i < CONFIG_MSM_IDLE_STATS_BUCKET_COUNT - 1;
@@ -189,6 +199,8 @@ static void level_stats_reset(struct level_stats *stats)
 	memset(stats->max_time, 0, sizeof(stats->max_time));
 	stats->success_count = 0;
 	stats->failed_count = 0;
+	stats->mispredict_deep = 0;
+	stats->mispredict_shallow = 0;
 	stats->total_time = 0;
 }
 
@@ -812,6 +824,40 @@ void lpm_stats_cluster_exit(struct lpm_stats *stats, uint32_t index,
 }
 EXPORT_SYMBOL(lpm_stats_cluster_exit);
 
+static void update_mispredict_stats(struct lpm_stats *stats, uint32_t index,
+					bool too_deep)
+{
+	struct level_stats *level;
+
+	if (!stats->time_stats || index >= stats->num_levels)
+		return;
+
+	level = &stats->time_stats[index];
+	if (too_deep)
+		level->mispredict_deep++;
+	else
+		level->mispredict_shallow++;
+}
+
+/**
+ * lpm_stats_cluster_mispredict() - API to account a badly chosen cluster
+ * lpm level.
+ *
+ * @stats:	Pointer to the cluster's lpm_stats object.
+ * @index:	Index of the cluster lpm level.
+ * @too_deep:	The level was left before its minimum residency. Otherwise
+ *		the cluster stayed long enough for a deeper level.
+ */
+void lpm_stats_cluster_mispredict(struct lpm_stats *stats, uint32_t index,
+				bool too_deep)
+{
+	if (IS_ERR_OR_NULL(stats))
+		return;
+
+	update_mispredict_stats(stats, index, too_deep);
+}
+EXPORT_SYMBOL(lpm_stats_cluster_mispredict);
+
 /**
  * lpm_stats_cpu_enter() - API to communicate the lpm level a cpu
  * is prepared to enter.
@@ -854,6 +900,18 @@ void lpm_stats_cpu_exit(uint32_t index, uint64_t time, bool success)
 }
 EXPORT_SYMBOL(lpm_stats_cpu_exit);
 
+/**
+ * lpm_stats_cpu_mispredict() - API to account a badly chosen cpu lpm level.
+ * @index:	Index of the cpu lpm level.
+ * @too_deep:	The level was left before its minimum residency. Otherwise
+ *		the cpu stayed long enough for a deeper level.
+ */
+void lpm_stats_cpu_mispredict(uint32_t index, bool too_deep)
+{
+	update_mispredict_stats(this_cpu_ptr(&cpu_stats), index, too_deep);
+}
+EXPORT_SYMBOL(lpm_stats_cpu_mispredict);
+
 /**
  * lpm_stats_suspend_enter() - API to communicate system entering suspend.
  *
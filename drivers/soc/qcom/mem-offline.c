@@ -25,6 +25,9 @@
 #include <linux/bootmem.h>
 #include <linux/mailbox_client.h>
 #include <linux/mailbox/qmp.h>
+#include <linux/msm_drm_notify.h>
+#include <linux/vmstat.h>
+#include <linux/workqueue.h>
 #include <soc/qcom/rpm-smd.h>
 #include <asm/tlbflush.h>
 #include <asm/cacheflush.h>
@@ -75,6 +78,28 @@ struct memory_refresh_request {
 
 static struct section_stat *mem_info;
 
+/*
+ * Automatic policy: once the primary display has been off for
+ * auto_offline_delay_ms, offline movable blocks from the top of DDR down
+ * while at least auto_offline_min_free_mb stays free, so AOP can stop
+ * self-refresh of their ranks. While the display stays off this repeats
+ * every auto_offline_delay_ms, and a block comes back if free memory has
+ * dropped below the threshold. The blocks offlined here are onlined again
+ * as soon as the display starts to unblank. Blocks offlined by userspace
+ * are left alone.
+ */
+static bool auto_offline;
+static unsigned int auto_offline_delay_ms = 600000;
+static unsigned int auto_offline_min_free_mb = 1024;
+static unsigned int total_blocks;
+static unsigned long *auto_offlined;
+static bool screen_off;
+static DEFINE_MUTEX(auto_offline_lock);
+static void mem_auto_offline_fn(struct work_struct *work);
+static void mem_auto_online_fn(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(mem_auto_offline_work, mem_auto_offline_fn);
+static DECLARE_WORK(mem_auto_online_work, mem_auto_online_fn);
+
 static void clear_pgtable_mapping(phys_addr_t start, phys_addr_t end)
 {
 	unsigned long size = end - start;
@@ -461,6 +486,172 @@ static int mem_online_remaining_blocks(void)
 	return fail;
 }
 
+static int mem_block_set_online(unsigned int blk, bool online)
+{
+	unsigned long sec_nr = start_section_nr + blk * sections_per_block;
+	struct memory_block *mem;
+	int ret;
+
+	mem = find_memory_block(__nr_to_section(sec_nr));
+	if (!mem)
+		return -ENODEV;
+
+	lock_device_hotplug();
+	ret = online ? device_online(&mem->dev) : device_offline(&mem->dev);
+	unlock_device_hotplug();
+	put_device(&mem->dev);
+
+	return ret < 0 ? ret : 0;
+}
+
+static void mem_auto_offline_fn(struct work_struct *work)
+{
+	unsigned long blk_pages = sections_per_block * PAGES_PER_SECTION;
+	unsigned long min_free = (unsigned long)auto_offline_min_free_mb <<
+				 (20 - PAGE_SHIFT);
+	int blk;
+
+	mutex_lock(&auto_offline_lock);
+	if (!READ_ONCE(screen_off) || !auto_offline)
+		goto out;
+
+	if (global_zone_page_state(NR_FREE_PAGES) < min_free) {
+		/* demand rose while the display is off, give a block back */
+		blk = find_first_bit(auto_offlined, total_blocks);
+		if (blk < total_blocks && !mem_block_set_online(blk, true))
+			clear_bit(blk, auto_offlined);
+		goto rearm;
+	}
+
+	for (blk = total_blocks - 1; blk >= 0; blk--) {
+		if (mem_sec_state[blk] == MEMORY_OFFLINE)
+			continue;
+		if (global_zone_page_state(NR_FREE_PAGES) < min_free + blk_pages)
+			break;
+		/* unmovable pages, try again next round */
+		if (mem_block_set_online(blk, false))
+			break;
+		set_bit(blk, auto_offlined);
+	}
+
+rearm:
+	queue_delayed_work(system_power_efficient_wq, &mem_auto_offline_work,
+			   msecs_to_jiffies(auto_offline_delay_ms));
+out:
+	mutex_unlock(&auto_offline_lock);
+}
+
+static void mem_auto_online_fn(struct work_struct *work)
+{
+	unsigned int blk;
+
+	mutex_lock(&auto_offline_lock);
+	for_each_set_bit(blk, auto_offlined, total_blocks)
+		if (!mem_block_set_online(blk, true))
+			clear_bit(blk, auto_offlined);
+	mutex_unlock(&auto_offline_lock);
+}
+
+#ifdef CONFIG_MSM_DRM_NOTIFY
+static int mem_auto_drm_notifier(struct notifier_block *nb,
+				 unsigned long event, void *data)
+{
+	struct msm_drm_notifier *evdata = data;
+	int blank;
+
+	if (!evdata || evdata->id != MSM_DRM_PRIMARY_DISPLAY || !evdata->data)
+		return NOTIFY_DONE;
+
+	blank = *(int *)evdata->data;
+	if (event == MSM_DRM_EARLY_EVENT_BLANK &&
+	    blank == MSM_DRM_BLANK_UNBLANK) {
+		WRITE_ONCE(screen_off, false);
+		cancel_delayed_work(&mem_auto_offline_work);
+		if (!bitmap_empty(auto_offlined, total_blocks))
+			queue_work(system_highpri_wq, &mem_auto_online_work);
+	} else if (event == MSM_DRM_EVENT_BLANK &&
+		   blank == MSM_DRM_BLANK_POWERDOWN) {
+		WRITE_ONCE(screen_off, true);
+		if (READ_ONCE(auto_offline))
+			mod_delayed_work(system_power_efficient_wq,
+					 &mem_auto_offline_work,
+					 msecs_to_jiffies(auto_offline_delay_ms));
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block mem_auto_drm_nb = {
+	.notifier_call = mem_auto_drm_notifier,
+};
+#endif
+
+static ssize_t show_auto_offline(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, BUF_LEN, "%d\n", auto_offline);
+}
+
+static ssize_t store_auto_offline(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	mutex_lock(&auto_offline_lock);
+	auto_offline = val;
+	mutex_unlock(&auto_offline_lock);
+
+	if (!val)
+		queue_work(system_highpri_wq, &mem_auto_online_work);
+	else if (READ_ONCE(screen_off))
+		mod_delayed_work(system_power_efficient_wq,
+				 &mem_auto_offline_work,
+				 msecs_to_jiffies(auto_offline_delay_ms));
+	return count;
+}
+
+static ssize_t show_auto_offline_delay_ms(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, BUF_LEN, "%u\n", auto_offline_delay_ms);
+}
+
+static ssize_t store_auto_offline_delay_ms(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val) || val < 1000)
+		return -EINVAL;
+
+	auto_offline_delay_ms = val;
+	return count;
+}
+
+static ssize_t show_auto_offline_min_free_mb(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, BUF_LEN, "%u\n", auto_offline_min_free_mb);
+}
+
+static ssize_t store_auto_offline_min_free_mb(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+
+	auto_offline_min_free_mb = val;
+	return count;
+}
+
 static ssize_t show_mem_offline_granule(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
 {
@@ -531,9 +722,25 @@ static struct kobj_attribute perf_stats_attr =
 static struct kobj_attribute offline_granule_attr =
 		__ATTR(offline_granule, 0444, show_mem_offline_granule, NULL);
 
+static struct kobj_attribute auto_offline_attr =
+		__ATTR(auto_offline, 0644, show_auto_offline,
+		       store_auto_offline);
+
+static struct kobj_attribute auto_offline_delay_ms_attr =
+		__ATTR(auto_offline_delay_ms, 0644, show_auto_offline_delay_ms,
+		       store_auto_offline_delay_ms);
+
+static struct kobj_attribute auto_offline_min_free_mb_attr =
+		__ATTR(auto_offline_min_free_mb, 0644,
+		       show_auto_offline_min_free_mb,
+		       store_auto_offline_min_free_mb);
+
 static struct attribute *mem_root_attrs[] = {
 		&perf_stats_attr.attr,
 		&offline_granule_attr.attr,
+		&auto_offline_attr.attr,
+		&auto_offline_delay_ms_attr.attr,
+		&auto_offline_min_free_mb_attr.attr,
 		NULL,
 };
 
@@ -635,6 +842,14 @@ static int mem_offline_driver_probe(struct platform_device *pdev)
 	for (i = 0; i < total_blks; i++)
 		mem_sec_state[i] = MEMORY_ONLINE;
 
+	auto_offlined = kcalloc(BITS_TO_LONGS(total_blks), sizeof(long),
+				GFP_KERNEL);
+	if (!auto_offlined) {
+		ret = -ENOMEM;
+		goto err_free_mem_sec_state;
+	}
+	total_blocks = total_blks;
+
 	if (mem_sysfs_init()) {
 		ret = -ENODEV;
 		goto err_free_mem_sec_state;
@@ -648,12 +863,18 @@ static int mem_offline_driver_probe(struct platform_device *pdev)
 	pr_info("mem-offline: Added memory blocks ranging from mem%lu - mem%lu\n",
 			start_section_nr, end_section_nr);
 
+#ifdef CONFIG_MSM_DRM_NOTIFY
+	if (msm_drm_register_client(&mem_auto_drm_nb))
+		pr_warn("mem-offline: no display notifier, automatic offlining disabled\n");
+#endif
+
 	return 0;
 
 err_sysfs_remove_group:
 	sysfs_remove_group(kobj, &mem_attr_group);
 	kobject_put(kobj);
 err_free_mem_sec_state:
+	kfree(auto_offlined);
 	kfree(mem_sec_state);
 err_free_mem_info:
 	kfree(mem_info);
@@ -18,6 +18,11 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/notifier.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/soc/qcom/qmi.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
@@ -57,6 +62,31 @@ static struct memshare_child *memsh_child;
 static struct mem_blocks memblock[MAX_CLIENTS];
 static uint32_t num_clients;
 
+/*
+ * Blocks the modem frees are kept, still assigned to it, for retain_ms.
+ * Clients give back and ask again for the same size across RAT changes,
+ * and such a request is then answered without allocating and without
+ * hyp_assign. Retained blocks are released when they expire or when the
+ * shrinker asks for memory. 0 frees blocks at once.
+ */
+static unsigned int retain_ms = 30000;
+module_param(retain_ms, uint, 0644);
+
+static struct {
+	u64 alloc_reqs;
+	u64 alloc_reused;
+	u64 alloc_failed;
+	u64 alloc_ns;
+	u64 alloc_max_ns;
+	u64 free_reqs;
+	u64 released_expired;
+	u64 released_shrinker;
+} memsh_stats;
+
+static void memshare_release_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(memshare_release_work, memshare_release_fn);
+static struct dentry *memshare_debugfs;
+
 /*
  *  This API creates ramdump dev handlers
  *  for each of the memshare clients.
@@ -412,6 +442,113 @@ static struct notifier_block nb = {
 	.notifier_call = modem_notifier_cb,
 };
 
+/* Give a block back to HLOS and free it, called with mem_free held */
+static void memshare_release_block(int client_id)
+{
+	u32 source_vmlist[1] = {VMID_MSS_MSA};
+	int dest_vmids[1] = {VMID_HLOS};
+	int dest_perms[1] = {PERM_READ|PERM_WRITE|PERM_EXEC};
+	int ret, size = memblock[client_id].size;
+
+	dev_dbg(memsh_child->dev,
+		"memshare_free: hypervisor unmapping for client_id:%d - size: %d\n",
+		client_id, memblock[client_id].size);
+	ret = hyp_assign_phys(memblock[client_id].phy_addr,
+			memblock[client_id].size, source_vmlist, 1,
+			dest_vmids, dest_perms, 1);
+	if (ret && memblock[client_id].hyp_mapping == 1) {
+	/*
+	 * This is an error case as hyp mapping was successful
+	 * earlier but during unmap it lead to failure.
+	 */
+		dev_err(memsh_child->dev,
+			"memshare_free: failed to unmap the region for client id:%d\n",
+			client_id);
+	} else {
+		memblock[client_id].hyp_mapping = 0;
+	}
+	if (memblock[client_id].guard_band) {
+	/*
+	 *	Check if the client required guard band support so
+	 *	the memory region of client's size + guard
+	 *	bytes of 4K can be freed
+	 */
+		size += MEMSHARE_GUARD_BYTES;
+	}
+	dma_free_attrs(memsh_drv->dev, size,
+		memblock[client_id].virtual_addr,
+		memblock[client_id].phy_addr,
+		attrs);
+	memblock[client_id].retained = 0;
+	free_client(client_id);
+}
+
+/* Release retained blocks older than @age jiffies, returns pages freed */
+static unsigned long memshare_release_retained(unsigned long age)
+{
+	unsigned long freed = 0;
+	bool pending = false;
+	int i;
+
+	for (i = 0; i < MAX_CLIENTS; i++) {
+		if (!memblock[i].retained)
+			continue;
+		if (time_before(jiffies, memblock[i].retained_at + age)) {
+			pending = true;
+			continue;
+		}
+		freed += PAGE_ALIGN(memblock[i].size) >> PAGE_SHIFT;
+		memshare_release_block(i);
+	}
+	if (pending)
+		mod_delayed_work(system_wq, &memshare_release_work,
+				 msecs_to_jiffies(retain_ms));
+	return freed;
+}
+
+static void memshare_release_fn(struct work_struct *work)
+{
+	unsigned long freed;
+
+	mutex_lock(&memsh_drv->mem_free);
+	freed = memshare_release_retained(msecs_to_jiffies(retain_ms));
+	memsh_stats.released_expired += freed;
+	mutex_unlock(&memsh_drv->mem_free);
+}
+
+static unsigned long memshare_shrink_count(struct shrinker *shrink,
+					   struct shrink_control *sc)
+{
+	unsigned long pages = 0;
+	int i;
+
+	for (i = 0; i < MAX_CLIENTS; i++)
+		if (memblock[i].retained)
+			pages += PAGE_ALIGN(memblock[i].size) >> PAGE_SHIFT;
+	return pages;
+}
+
+static unsigned long memshare_shrink_scan(struct shrinker *shrink,
+					  struct shrink_control *sc)
+{
+	unsigned long freed;
+
+	/* hyp_assign_phys() allocates with mem_free held */
+	if (!mutex_trylock(&memsh_drv->mem_free))
+		return SHRINK_STOP;
+	freed = memshare_release_retained(0);
+	memsh_stats.released_shrinker += freed;
+	mutex_unlock(&memsh_drv->mem_free);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker memshare_shrinker = {
+	.count_objects = memshare_shrink_count,
+	.scan_objects = memshare_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
 static void shared_hyp_mapping(int client_id)
 {
 	int ret;
@@ -446,6 +583,8 @@ static void handle_alloc_generic_req(struct qmi_handle *handle,
 	int rc, resp = 0;
 	int client_id;
 	uint32_t size = 0;
+	bool reused = false;
+	u64 start = ktime_get_ns(), delta;
 
 	mutex_lock(&memsh_drv->mem_share);
 	alloc_req = (struct mem_alloc_generic_req_msg_v01 *)decoded_msg;
@@ -478,7 +617,17 @@ static void handle_alloc_generic_req(struct qmi_handle *handle,
 			size = alloc_req->num_bytes + MEMSHARE_GUARD_BYTES;
 		else
 			size = alloc_req->num_bytes;
-		rc = memshare_alloc(memsh_drv->dev, size,
+		mutex_lock(&memsh_drv->mem_free);
+		if (memblock[client_id].retained) {
+			if (memblock[client_id].size == alloc_req->num_bytes) {
+				memblock[client_id].retained = 0;
+				reused = true;
+			} else {
+				memshare_release_block(client_id);
+			}
+		}
+		mutex_unlock(&memsh_drv->mem_free);
+		rc = reused ? 0 : memshare_alloc(memsh_drv->dev, size,
 					&memblock[client_id]);
 		if (rc) {
 			dev_err(memsh_child->dev,
@@ -524,6 +673,14 @@ static void handle_alloc_generic_req(struct qmi_handle *handle,
 		"memshare_alloc: Error sending the alloc response: %d\n",
 		rc);
 
+	delta = ktime_get_ns() - start;
+	memsh_stats.alloc_reqs++;
+	memsh_stats.alloc_reused += reused;
+	memsh_stats.alloc_failed += resp;
+	memsh_stats.alloc_ns += delta;
+	if (delta > memsh_stats.alloc_max_ns)
+		memsh_stats.alloc_max_ns = delta;
+
 	kfree(alloc_resp);
 	alloc_resp = NULL;
 	return;
@@ -534,13 +691,11 @@ static void handle_free_generic_req(struct qmi_handle *handle,
 {
 	struct mem_free_generic_req_msg_v01 *free_req;
 	struct mem_free_generic_resp_msg_v01 free_resp;
-	int rc, flag = 0, ret = 0, size = 0;
+	int rc, flag = 0;
 	uint32_t client_id;
-	u32 source_vmlist[1] = {VMID_MSS_MSA};
-	int dest_vmids[1] = {VMID_HLOS};
-	int dest_perms[1] = {PERM_READ|PERM_WRITE|PERM_EXEC};
 
 	mutex_lock(&memsh_drv->mem_free);
+	memsh_stats.free_reqs++;
 	free_req = (struct mem_free_generic_req_msg_v01 *)decoded_msg;
 	memset(&free_resp, 0, sizeof(free_resp));
 	free_resp.resp.error = QMI_ERR_INTERNAL_V01;
@@ -555,35 +710,15 @@ static void handle_free_generic_req(struct qmi_handle *handle,
 	} else if (!memblock[client_id].guarantee &&
 				!memblock[client_id].client_request &&
 				memblock[client_id].allotted) {
-		dev_dbg(memsh_child->dev,
-			"memshare_free: hypervisor unmapping for client_id:%d - size: %d\n",
-			client_id, memblock[client_id].size);
-		ret = hyp_assign_phys(memblock[client_id].phy_addr,
-				memblock[client_id].size, source_vmlist, 1,
-				dest_vmids, dest_perms, 1);
-		if (ret && memblock[client_id].hyp_mapping == 1) {
-		/*
-		 * This is an error case as hyp mapping was successful
-		 * earlier but during unmap it lead to failure.
-		 */
-			dev_err(memsh_child->dev,
-				"memshare_free: failed to unmap the region for client id:%d\n",
-				client_id);
-		}
-		size = memblock[client_id].size;
-		if (memblock[client_id].guard_band) {
-		/*
-		 *	Check if the client required guard band support so
-		 *	the memory region of client's size + guard
-		 *	bytes of 4K can be freed
-		 */
-			size += MEMSHARE_GUARD_BYTES;
+		if (retain_ms && memblock[client_id].hyp_mapping) {
+			memblock[client_id].allotted = 0;
+			memblock[client_id].retained = 1;
+			memblock[client_id].retained_at = jiffies;
+			mod_delayed_work(system_wq, &memshare_release_work,
+					 msecs_to_jiffies(retain_ms));
+		} else {
+			memshare_release_block(client_id);
 		}
-		dma_free_attrs(memsh_drv->dev, size,
-			memblock[client_id].virtual_addr,
-			memblock[client_id].phy_addr,
-			attrs);
-		free_client(client_id);
 	} else {
 		dev_err(memsh_child->dev,
 			"memshare_free: cannot free the memory for a guaranteed client (client_id: %d)\n",
@@ -869,6 +1004,33 @@ static int memshare_child_probe(struct platform_device *pdev)
 	return 0;
 }
 
+static int memshare_stats_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "alloc_reqs %llu\nalloc_reused %llu\nalloc_failed %llu\n",
+		   memsh_stats.alloc_reqs, memsh_stats.alloc_reused,
+		   memsh_stats.alloc_failed);
+	seq_printf(s, "alloc_avg_us %llu\nalloc_max_us %llu\n",
+		   memsh_stats.alloc_reqs ? div64_u64(memsh_stats.alloc_ns,
+			memsh_stats.alloc_reqs * NSEC_PER_USEC) : 0,
+		   div_u64(memsh_stats.alloc_max_ns, NSEC_PER_USEC));
+	seq_printf(s, "free_reqs %llu\nreleased_expired_pages %llu\nreleased_shrinker_pages %llu\n",
+		   memsh_stats.free_reqs, memsh_stats.released_expired,
+		   memsh_stats.released_shrinker);
+	return 0;
+}
+
+static int memshare_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, memshare_stats_show, NULL);
+}
+
+static const struct file_operations memshare_stats_fops = {
+	.open		= memshare_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int memshare_probe(struct platform_device *pdev)
 {
 	int rc;
@@ -903,6 +1065,10 @@ static int memshare_probe(struct platform_device *pdev)
 	}
 
 	subsys_notif_register_notifier("modem", &nb);
+	register_shrinker(&memshare_shrinker);
+	memshare_debugfs = debugfs_create_dir(MEMSHARE_DEV_NAME, NULL);
+	debugfs_create_file("stats", 0400, memshare_debugfs, NULL,
+			    &memshare_stats_fops);
 	dev_dbg(memsh_child->dev, "memshare: Memshare inited\n");
 
 	return 0;
@@ -913,6 +1079,9 @@ static int memshare_remove(struct platform_device *pdev)
 	if (!memsh_drv)
 		return 0;
 
+	debugfs_remove_recursive(memshare_debugfs);
+	unregister_shrinker(&memshare_shrinker);
+	cancel_delayed_work_sync(&memshare_release_work);
 	flush_workqueue(mem_share_svc_workqueue);
 	qmi_handle_release(mem_share_svc_handle);
 	kfree(mem_share_svc_handle);
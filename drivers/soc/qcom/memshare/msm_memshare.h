@@ -62,6 +62,10 @@ struct mem_blocks {
 	uint8_t hyp_mapping;
 	/* Status flag which checks if ramdump file is created*/
 	int file_created;
+	/* Freed by the client but kept assigned for reuse */
+	uint8_t retained;
+	/* jiffies when the block was retained */
+	unsigned long retained_at;
 
 };
 
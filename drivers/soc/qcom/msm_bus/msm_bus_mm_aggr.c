@@ -0,0 +1,317 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "msm_bus_mm: " fmt
+
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/msm-bus.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+/*
+ * Multimedia cores vote the same paths to DDR independently, each sized
+ * for its own worst case. Clients sharing a path here have their votes
+ * folded into one: average bandwidth adds up, instantaneous bandwidth is
+ * the largest single request, raised to the summed average when more than
+ * one client is active since they then share the path. Increases are voted
+ * right away, decreases only once they have held for decay_ms and moved by
+ * more than hyst_pct, so a burst of small changes costs a single vote.
+ */
+static uint hyst_pct = 10;
+module_param(hyst_pct, uint, 0644);
+
+static uint decay_ms = 100;
+module_param(decay_ms, uint, 0644);
+
+struct msm_bus_mm_path {
+	struct list_head list;
+	struct list_head clients;
+	uint32_t mas;
+	uint32_t slv;
+	char name[32];
+	struct msm_bus_client_handle *handle;
+	struct mutex lock;
+	u64 cur_ab;
+	u64 cur_ib;
+	unsigned long votes;
+	unsigned long held;
+	struct delayed_work decay_work;
+};
+
+struct msm_bus_mm_client {
+	struct list_head list;
+	struct msm_bus_mm_path *path;
+	const char *name;
+	u64 ab;
+	u64 ib;
+};
+
+static LIST_HEAD(mm_paths);
+static DEFINE_MUTEX(mm_paths_lock);
+
+static void msm_bus_mm_aggregate(struct msm_bus_mm_path *path,
+		u64 *ab, u64 *ib)
+{
+	struct msm_bus_mm_client *cl;
+	int active = 0;
+
+	*ab = 0;
+	*ib = 0;
+	list_for_each_entry(cl, &path->clients, list) {
+		if (!cl->ab && !cl->ib)
+			continue;
+		*ab += cl->ab;
+		*ib = max(*ib, cl->ib);
+		active++;
+	}
+
+	if (active > 1)
+		*ib = max(*ib, *ab);
+}
+
+static int msm_bus_mm_vote(struct msm_bus_mm_path *path, u64 ab, u64 ib)
+{
+	int ret;
+
+	if (ab == path->cur_ab && ib == path->cur_ib)
+		return 0;
+
+	ret = msm_bus_scale_update_bw(path->handle, ab, ib);
+	if (ret) {
+		pr_err("%s: vote ab %llu ib %llu failed %d\n", path->name,
+			ab, ib, ret);
+		return ret;
+	}
+
+	path->cur_ab = ab;
+	path->cur_ib = ib;
+	path->votes++;
+
+	return 0;
+}
+
+static bool msm_bus_mm_within_hyst(u64 req, u64 cur)
+{
+	return req >= cur - div_u64(cur * hyst_pct, 100);
+}
+
+static int msm_bus_mm_update(struct msm_bus_mm_path *path)
+{
+	u64 ab, ib;
+
+	msm_bus_mm_aggregate(path, &ab, &ib);
+
+	/* The last client going idle releases the path at once */
+	if (!ab && !ib) {
+		cancel_delayed_work(&path->decay_work);
+		return msm_bus_mm_vote(path, 0, 0);
+	}
+
+	if (ab >= path->cur_ab && ib >= path->cur_ib) {
+		cancel_delayed_work(&path->decay_work);
+		return msm_bus_mm_vote(path, ab, ib);
+	}
+
+	/* Never go below what is asked for, keep the rest until decay */
+	if (ab < path->cur_ab && msm_bus_mm_within_hyst(ab, path->cur_ab))
+		ab = path->cur_ab;
+	if (ib < path->cur_ib && msm_bus_mm_within_hyst(ib, path->cur_ib))
+		ib = path->cur_ib;
+
+	if (ab < path->cur_ab || ib < path->cur_ib) {
+		path->held++;
+		mod_delayed_work(system_power_efficient_wq, &path->decay_work,
+			msecs_to_jiffies(decay_ms));
+		ab = max(ab, path->cur_ab);
+		ib = max(ib, path->cur_ib);
+	}
+
+	return msm_bus_mm_vote(path, ab, ib);
+}
+
+static void msm_bus_mm_decay_work(struct work_struct *work)
+{
+	struct msm_bus_mm_path *path = container_of(to_delayed_work(work),
+			struct msm_bus_mm_path, decay_work);
+	u64 ab, ib;
+
+	mutex_lock(&path->lock);
+	msm_bus_mm_aggregate(path, &ab, &ib);
+	msm_bus_mm_vote(path, ab, ib);
+	mutex_unlock(&path->lock);
+}
+
+static struct msm_bus_mm_path *msm_bus_mm_get_path(uint32_t mas,
+		uint32_t slv)
+{
+	struct msm_bus_mm_path *path;
+
+	list_for_each_entry(path, &mm_paths, list)
+		if (path->mas == mas && path->slv == slv)
+			return path;
+
+	path = kzalloc(sizeof(*path), GFP_KERNEL);
+	if (!path)
+		return ERR_PTR(-ENOMEM);
+
+	snprintf(path->name, sizeof(path->name), "mm-aggr-%u-%u", mas, slv);
+	path->handle = msm_bus_scale_register(mas, slv, path->name, false);
+	if (!path->handle) {
+		kfree(path);
+		return ERR_PTR(-EINVAL);
+	}
+
+	path->mas = mas;
+	path->slv = slv;
+	INIT_LIST_HEAD(&path->clients);
+	mutex_init(&path->lock);
+	INIT_DELAYED_WORK(&path->decay_work, msm_bus_mm_decay_work);
+	list_add_tail(&path->list, &mm_paths);
+
+	return path;
+}
+
+/**
+ * msm_bus_mm_register() - Register a client of a shared multimedia path
+ * @mas: Master of the path
+ * @slv: Slave of the path
+ * @name: Client name, must outlive the client
+ *
+ * Clients registered on the same master and slave share a single bus
+ * vote. Returns the client handle or an ERR_PTR.
+ */
+struct msm_bus_mm_client *msm_bus_mm_register(uint32_t mas, uint32_t slv,
+		const char *name)
+{
+	struct msm_bus_mm_client *cl;
+	struct msm_bus_mm_path *path;
+
+	cl = kzalloc(sizeof(*cl), GFP_KERNEL);
+	if (!cl)
+		return ERR_PTR(-ENOMEM);
+
+	mutex_lock(&mm_paths_lock);
+	path = msm_bus_mm_get_path(mas, slv);
+	if (IS_ERR(path)) {
+		mutex_unlock(&mm_paths_lock);
+		kfree(cl);
+		return ERR_CAST(path);
+	}
+
+	cl->path = path;
+	cl->name = name;
+	mutex_lock(&path->lock);
+	list_add_tail(&cl->list, &path->clients);
+	mutex_unlock(&path->lock);
+	mutex_unlock(&mm_paths_lock);
+
+	return cl;
+}
+EXPORT_SYMBOL(msm_bus_mm_register);
+
+/**
+ * msm_bus_mm_unregister() - Remove a client and its vote from its path
+ * @cl: Client handle from msm_bus_mm_register()
+ *
+ * The path itself stays registered with the bus driver for later clients.
+ */
+void msm_bus_mm_unregister(struct msm_bus_mm_client *cl)
+{
+	struct msm_bus_mm_path *path;
+
+	if (IS_ERR_OR_NULL(cl))
+		return;
+
+	path = cl->path;
+	mutex_lock(&mm_paths_lock);
+	mutex_lock(&path->lock);
+	list_del(&cl->list);
+	msm_bus_mm_update(path);
+	mutex_unlock(&path->lock);
+	mutex_unlock(&mm_paths_lock);
+
+	kfree(cl);
+}
+EXPORT_SYMBOL(msm_bus_mm_unregister);
+
+/**
+ * msm_bus_mm_update_bw() - Update the bandwidth a client needs
+ * @cl: Client handle from msm_bus_mm_register()
+ * @ab: Average bandwidth in bytes per second
+ * @ib: Instantaneous bandwidth in bytes per second
+ *
+ * May sleep. Returns 0 or the error of the consolidated vote.
+ */
+int msm_bus_mm_update_bw(struct msm_bus_mm_client *cl, u64 ab, u64 ib)
+{
+	struct msm_bus_mm_path *path;
+	int ret;
+
+	if (IS_ERR_OR_NULL(cl))
+		return -EINVAL;
+
+	path = cl->path;
+	mutex_lock(&path->lock);
+	cl->ab = ab;
+	cl->ib = ib;
+	ret = msm_bus_mm_update(path);
+	mutex_unlock(&path->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(msm_bus_mm_update_bw);
+
+static int msm_bus_mm_show(struct seq_file *s, void *unused)
+{
+	struct msm_bus_mm_client *cl;
+	struct msm_bus_mm_path *path;
+
+	mutex_lock(&mm_paths_lock);
+	list_for_each_entry(path, &mm_paths, list) {
+		mutex_lock(&path->lock);
+		seq_printf(s, "%s: ab %llu ib %llu votes %lu held %lu\n",
+			path->name, path->cur_ab, path->cur_ib, path->votes,
+			path->held);
+		list_for_each_entry(cl, &path->clients, list)
+			seq_printf(s, "  %s: ab %llu ib %llu\n", cl->name,
+				cl->ab, cl->ib);
+		mutex_unlock(&path->lock);
+	}
+	mutex_unlock(&mm_paths_lock);
+
+	return 0;
+}
+
+static int msm_bus_mm_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_bus_mm_show, NULL);
+}
+
+static const struct file_operations msm_bus_mm_fops = {
+	.open = msm_bus_mm_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_bus_mm_debugfs_init(void)
+{
+	debugfs_create_file("msm_bus_mm", 0444, NULL, NULL, &msm_bus_mm_fops);
+
+	return 0;
+}
+late_initcall(msm_bus_mm_debugfs_init);
@@ -14,6 +14,10 @@
 #include <linux/msm_drm_notify.h>
 
 static BLOCKING_NOTIFIER_HEAD(msm_drm_notifier_list);
+/* vsync timing is published from interrupt context */
+static ATOMIC_NOTIFIER_HEAD(msm_drm_vsync_list);
+/* refresh period of each display, as of its last vsync */
+static u32 msm_drm_period_ns[MSM_DRM_DISPLAY_MAX];
 
 /**
  * msm_drm_register_client - register a client notifier
@@ -56,3 +60,78 @@ int msm_drm_notifier_call_chain(unsigned long val, void *v)
 					    v);
 }
 EXPORT_SYMBOL(msm_drm_notifier_call_chain);
+
+/**
+ * msm_drm_register_vsync_client - register a vsync timing notifier
+ * @nb: notifier block to callback on events
+ *
+ * The callback receives MSM_DRM_EVENT_VSYNC and MSM_DRM_EVENT_COMMIT
+ * with a struct msm_drm_vsync, in atomic context, so that frequency
+ * governors can raise their votes ahead of the next composition.
+ */
+int msm_drm_register_vsync_client(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&msm_drm_vsync_list, nb);
+}
+EXPORT_SYMBOL(msm_drm_register_vsync_client);
+
+/**
+ * msm_drm_unregister_vsync_client - unregister a vsync timing notifier
+ * @nb: notifier block to remove
+ */
+int msm_drm_unregister_vsync_client(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&msm_drm_vsync_list, nb);
+}
+EXPORT_SYMBOL(msm_drm_unregister_vsync_client);
+
+/**
+ * msm_drm_notify_vsync - publish a vsync of a display
+ * @id: display that reached vsync
+ * @timestamp: time of the vsync, typically the vsync interrupt time
+ * @period_ns: refresh period of the current mode
+ *
+ * Called by the display driver from its vsync interrupt handler.
+ */
+void msm_drm_notify_vsync(enum msm_drm_display_id id, ktime_t timestamp,
+			  u32 period_ns)
+{
+	struct msm_drm_vsync vsync = {
+		.id = id,
+		.timestamp = timestamp,
+		.period_ns = period_ns,
+		.deadline = ktime_add_ns(timestamp, period_ns),
+	};
+
+	if (id >= MSM_DRM_DISPLAY_MAX)
+		return;
+
+	WRITE_ONCE(msm_drm_period_ns[id], period_ns);
+	atomic_notifier_call_chain(&msm_drm_vsync_list, MSM_DRM_EVENT_VSYNC,
+				   &vsync);
+}
+EXPORT_SYMBOL(msm_drm_notify_vsync);
+
+/**
+ * msm_drm_notify_commit - publish a commit queued for a coming vsync
+ * @id: display the commit is for
+ * @deadline: time of the vsync the commit targets
+ *
+ * Called by the display driver when it queues a commit, in any context.
+ */
+void msm_drm_notify_commit(enum msm_drm_display_id id, ktime_t deadline)
+{
+	struct msm_drm_vsync vsync = {
+		.id = id,
+		.timestamp = ktime_get(),
+		.deadline = deadline,
+	};
+
+	if (id >= MSM_DRM_DISPLAY_MAX)
+		return;
+
+	vsync.period_ns = READ_ONCE(msm_drm_period_ns[id]);
+	atomic_notifier_call_chain(&msm_drm_vsync_list, MSM_DRM_EVENT_COMMIT,
+				   &vsync);
+}
+EXPORT_SYMBOL(msm_drm_notify_commit);
@@ -26,6 +26,8 @@
 #include <linux/err.h>
 #include <linux/list.h>
 #include <linux/list_sort.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
 #include <linux/idr.h>
 #include <linux/interrupt.h>
 #include <linux/of_irq.h>
@@ -129,6 +131,8 @@ struct pil_mdt {
  * @filesz: size of segment on disk
  * @num: segment number
  * @relocated: true if segment is relocated, false otherwise
+ * @read_ns: time spent reading the segment into memory and zeroing its tail
+ * @verify_ns: time spent verifying the segment
  *
  * Loosely based on an elf program header. Contains all necessary information
  * to load and initialize a segment of the image in memory.
@@ -140,6 +144,8 @@ struct pil_seg {
 	int num;
 	struct list_head list;
 	bool relocated;
+	u64 read_ns;
+	u64 verify_ns;
 };
 
 /**
@@ -1055,6 +1061,7 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 		.dev = desc->dev,
 	};
 	void *map_data = desc->map_data ? desc->map_data : &map_fw_info;
+	ktime_t start = ktime_get();
 
 	if (seg->filesz) {
 		snprintf(fw_name, ARRAY_SIZE(fw_name), "%s.b%02d",
@@ -1106,13 +1113,23 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 		count -= size;
 		paddr += size;
 	}
+	seg->read_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 
+	/*
+	 * Segments are loaded in parallel, so hashing this one overlaps with
+	 * reading the others.
+	 */
+	start = ktime_get();
 	if (desc->ops->verify_blob) {
 		ret = desc->ops->verify_blob(desc, seg->paddr, seg->sz);
 		if (ret)
 			pil_err(desc, "Blob%u failed verification(rc:%d)\n",
 								num, ret);
 	}
+	seg->verify_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	trace_pil_seg_load(desc, num, seg->filesz, seg->read_ns,
+			   seg->verify_ns);
 
 	return ret;
 }
@@ -1186,12 +1203,48 @@ static void pil_load_seg_work_fn(struct work_struct *work)
 	pil_seg_data->retval = pil_load_seg(desc, seg);
 }
 
+static int pil_cmp_seg_data(const void *a, const void *b)
+{
+	const struct pil_seg_data *da = *(const struct pil_seg_data **)a;
+	const struct pil_seg_data *db = *(const struct pil_seg_data **)b;
+
+	if (da->seg->filesz == db->seg->filesz)
+		return 0;
+
+	return da->seg->filesz < db->seg->filesz ? 1 : -1;
+}
+
+static void pil_log_seg_times(struct pil_desc *desc, ktime_t start)
+{
+	struct pil_seg *seg, *slowest = NULL;
+	unsigned long bytes = 0;
+	u64 ns;
+
+	list_for_each_entry(seg, &desc->priv->segs, list) {
+		bytes += seg->filesz;
+		if (!slowest || seg->read_ns + seg->verify_ns >
+				slowest->read_ns + slowest->verify_ns)
+			slowest = seg;
+	}
+
+	if (!slowest)
+		return;
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	pil_ipc("[%s]: loaded %d segs, %lu KB in %llu us, slowest b%02d %llu+%llu us\n",
+		desc->name, desc->priv->num_segs, bytes / SZ_1K,
+		div_u64(ns, NSEC_PER_USEC), slowest->num,
+		div_u64(slowest->read_ns, NSEC_PER_USEC),
+		div_u64(slowest->verify_ns, NSEC_PER_USEC));
+}
+
 static int pil_load_segs(struct pil_desc *desc)
 {
 	int ret = 0;
 	int seg_id = 0;
 	struct pil_priv *priv = desc->priv;
 	struct pil_seg_data *pil_seg_data;
+	struct pil_seg_data **order;
 	struct pil_seg *seg;
 	unsigned long *err_map;
 
@@ -1202,23 +1255,34 @@ static int pil_load_segs(struct pil_desc *desc)
 
 	pil_seg_data = kcalloc(priv->num_segs, sizeof(*pil_seg_data),
 				GFP_KERNEL);
-	if (!pil_seg_data) {
+	order = kcalloc(priv->num_segs, sizeof(*order), GFP_KERNEL);
+	if (!pil_seg_data || !order) {
+		kfree(pil_seg_data);
+		kfree(order);
 		ret = -ENOMEM;
 		goto out;
 	}
 
-	/* Initialize and spawn a thread for each segment */
 	list_for_each_entry(seg, &desc->priv->segs, list) {
 		pil_seg_data[seg_id].desc = desc;
 		pil_seg_data[seg_id].seg = seg;
-
 		INIT_WORK(&pil_seg_data[seg_id].load_seg_work,
 				pil_load_seg_work_fn);
-		queue_work(pil_wq, &pil_seg_data[seg_id].load_seg_work);
+		order[seg_id] = &pil_seg_data[seg_id];
 
 		seg_id++;
 	}
 
+	/*
+	 * Spawn a thread for each segment, largest first, so that the biggest
+	 * read is not left to start last when workers are busy with other
+	 * subsystems.
+	 */
+	sort(order, priv->num_segs, sizeof(*order), pil_cmp_seg_data, NULL);
+	for (seg_id = 0; seg_id < priv->num_segs; seg_id++)
+		queue_work(pil_wq, &order[seg_id]->load_seg_work);
+	kfree(order);
+
 	bitmap_zero(err_map, priv->num_segs);
 
 	/* Wait for the parallel loads to finish */
@@ -1267,6 +1331,7 @@ int pil_boot(struct pil_desc *desc)
 	struct pil_priv *priv = desc->priv;
 	bool mem_protect = false;
 	bool hyp_assign = false;
+	ktime_t load_start;
 
 	ret = pil_notify_aop(desc, "on");
 	if (ret < 0) {
@@ -1370,6 +1435,7 @@ int pil_boot(struct pil_desc *desc)
 	}
 
 	pil_log("before_load_seg", desc);
+	load_start = ktime_get();
 
 	/**
 	 * Fallback to serial loading of blobs if the
@@ -1386,6 +1452,7 @@ int pil_boot(struct pil_desc *desc)
 				goto err_deinit_image;
 		}
 	}
+	pil_log_seg_times(desc, load_start);
 
 	if (desc->subsys_vmid > 0) {
 		pil_log("before_reclaim_mem", desc);
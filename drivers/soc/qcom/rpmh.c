@@ -12,7 +12,9 @@
  */
 
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
@@ -56,12 +58,16 @@ struct rpmh_req {
 	u32 addr;
 	u32 sleep_val;
 	u32 wake_val;
+	/* Last active value sent, valid only while nothing is in flight */
+	u32 active_val;
+	int in_flight;
 	struct list_head list;
 };
 
 struct rpmh_msg {
 	struct tcs_mbox_msg msg;
 	struct tcs_cmd cmd[MAX_RPMH_PAYLOAD];
+	struct rpmh_req *req[MAX_RPMH_PAYLOAD];
 	struct completion *completion;
 	atomic_t *wait_count;
 	struct rpmh_client *rc;
@@ -69,6 +75,14 @@ struct rpmh_msg {
 	int err; /* relay error from mbox for sync calls */
 };
 
+/* An async active vote held back to be merged with later votes */
+struct rpmh_coalesce_req {
+	struct rpmh_client *rc;
+	enum rpmh_state state;
+	int n;
+	struct tcs_cmd cmd[MAX_RPMH_PAYLOAD];
+};
+
 struct rpmh_mbox {
 	struct device_node *mbox_dn;
 	struct list_head resources;
@@ -79,6 +93,11 @@ struct rpmh_mbox {
 	bool in_solver_mode;
 	/* Cache sleep and wake requests sent as passthru */
 	struct rpmh_msg *passthru_cache[2 * RPMH_MAX_REQ_IN_BATCH];
+	/* Async active votes waiting for the coalescing window to close */
+	spinlock_t coalesce_lock;
+	struct hrtimer coalesce_timer;
+	int num_coalesce;
+	struct rpmh_coalesce_req coalesce[RPMH_MAX_REQ_IN_BATCH];
 };
 
 struct rpmh_client {
@@ -92,6 +111,17 @@ static struct rpmh_mbox mbox_ctrlr[RPMH_MAX_MBOXES];
 DEFINE_MUTEX(rpmh_mbox_mutex);
 bool rpmh_standalone;
 
+/*
+ * Active votes that match what the accelerator already has are completed
+ * without a round trip, and async active votes may be held back for
+ * rpmh_coalesce_us so that a burst of votes to the same addresses goes out
+ * as one write.
+ */
+static bool rpmh_elide = true;
+static u32 rpmh_coalesce_us;
+static atomic_t rpmh_elided = ATOMIC_INIT(0);
+static atomic_t rpmh_coalesced = ATOMIC_INIT(0);
+
 static struct rpmh_msg *get_msg_from_pool(struct rpmh_client *rc)
 {
 	struct rpmh_mbox *rpm = rc->rpmh;
@@ -139,6 +169,25 @@ static void rpmh_rx_cb(struct mbox_client *cl, void *msg)
 	atomic_dec(rpm_msg->wait_count);
 }
 
+/*
+ * The value sent is only known to be in effect once no other write to the
+ * address is outstanding, and not at all if the write failed.
+ */
+static void rpmh_active_done(struct rpmh_msg *rpm_msg, int r)
+{
+	struct rpmh_mbox *rpm = rpm_msg->rc->rpmh;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&rpm->lock, flags);
+	for (i = 0; i < rpm_msg->msg.num_payload; i++) {
+		rpm_msg->req[i]->in_flight--;
+		if (r)
+			rpm_msg->req[i]->active_val = UINT_MAX;
+	}
+	spin_unlock_irqrestore(&rpm->lock, flags);
+}
+
 static void rpmh_tx_done(struct mbox_client *cl, void *msg, int r)
 {
 	struct rpmh_msg *rpm_msg = container_of(msg, struct rpmh_msg, msg);
@@ -147,6 +196,9 @@ static void rpmh_tx_done(struct mbox_client *cl, void *msg, int r)
 
 	rpm_msg->err = r;
 
+	if (rpm_msg->req[0])
+		rpmh_active_done(rpm_msg, r);
+
 	if (r) {
 		dev_err(rpm_msg->rc->dev,
 			"RPMH TX fail in msg addr 0x%x, err=%d\n",
@@ -249,7 +301,7 @@ static struct rpmh_req *cache_rpm_request(struct rpmh_client *rc,
 	}
 
 	req->addr = cmd->addr;
-	req->sleep_val = req->wake_val = UINT_MAX;
+	req->sleep_val = req->wake_val = req->active_val = UINT_MAX;
 	INIT_LIST_HEAD(&req->list);
 	list_add_tail(&req->list, &rpm->resources);
 
@@ -300,6 +352,71 @@ static int check_ctrlr_state(struct rpmh_client *rc, enum rpmh_state state)
 	return ret;
 }
 
+static inline int is_req_valid(struct rpmh_req *req)
+{
+	return (req->sleep_val != UINT_MAX && req->wake_val != UINT_MAX
+			&& req->sleep_val != req->wake_val);
+}
+
+/* Forget the active values of the addresses written outside our cache */
+static void rpmh_forget_active(struct rpmh_client *rc, struct tcs_cmd *cmd,
+			int n)
+{
+	struct rpmh_mbox *rpm = rc->rpmh;
+	struct rpmh_req *p;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&rpm->lock, flags);
+	list_for_each_entry(p, &rpm->resources, list) {
+		if (!cmd) {
+			p->active_val = UINT_MAX;
+			continue;
+		}
+		for (i = 0; i < n; i++)
+			if (p->addr == cmd[i].addr)
+				p->active_val = UINT_MAX;
+	}
+	spin_unlock_irqrestore(&rpm->lock, flags);
+}
+
+/*
+ * Claim the payload of an active request for sending, or return true if
+ * every address already holds the requested value and nothing to them is
+ * outstanding. Passthru sleep/wake sets are not tracked per address, so
+ * nothing is elided while any are cached.
+ */
+static bool rpmh_claim_active(struct rpmh_client *rc,
+			struct rpmh_msg *rpm_msg)
+{
+	struct rpmh_mbox *rpm = rc->rpmh;
+	struct tcs_cmd *cmd = rpm_msg->msg.payload;
+	int n = rpm_msg->msg.num_payload;
+	struct rpmh_req *req;
+	unsigned long flags;
+	bool elide;
+	int i;
+
+	spin_lock_irqsave(&rpm->lock, flags);
+	elide = rpmh_elide && !rpm->passthru_cache[0];
+	for (i = 0; i < n && elide; i++) {
+		req = rpm_msg->req[i];
+		/* A flushed wake value is what is left after sleep */
+		elide = !req->in_flight && req->active_val == cmd[i].data &&
+			(!is_req_valid(req) || req->wake_val == cmd[i].data);
+	}
+
+	if (!elide) {
+		for (i = 0; i < n; i++) {
+			rpm_msg->req[i]->active_val = cmd[i].data;
+			rpm_msg->req[i]->in_flight++;
+		}
+	}
+	spin_unlock_irqrestore(&rpm->lock, flags);
+
+	return elide;
+}
+
 /**
  * __rpmh_write: Cache and send the RPMH request
  *
@@ -323,16 +440,26 @@ int __rpmh_write(struct rpmh_client *rc, enum rpmh_state state,
 		req = cache_rpm_request(rc, state, &rpm_msg->msg.payload[i]);
 		if (IS_ERR(req))
 			return PTR_ERR(req);
+		rpm_msg->req[i] = req;
 	}
 
 	rpm_msg->msg.state = state;
 
 	/* Send to mailbox only if active or awake */
 	if (state == RPMH_ACTIVE_ONLY_STATE || state == RPMH_AWAKE_STATE) {
+		if (rpmh_claim_active(rc, rpm_msg)) {
+			atomic_inc(&rpmh_elided);
+			rpm_msg->req[0] = NULL;
+			rpmh_tx_done(&rc->client, &rpm_msg->msg, 0);
+			return 0;
+		}
 		ret = mbox_send_message(rc->chan, &rpm_msg->msg);
 		if (ret > 0)
 			ret = 0;
+		else if (ret < 0)
+			rpmh_active_done(rpm_msg, ret);
 	} else {
+		rpm_msg->req[0] = NULL;
 		/* Clean up our call by spoofing tx_done */
 		rpmh_tx_done(&rc->client, &rpm_msg->msg, ret);
 	}
@@ -340,6 +467,152 @@ int __rpmh_write(struct rpmh_client *rc, enum rpmh_state state,
 	return ret;
 }
 
+struct rpmh_msg *__get_rpmh_msg_async(struct rpmh_client *rc,
+		enum rpmh_state state, struct tcs_cmd *cmd, int n)
+{
+	struct rpmh_msg *rpm_msg;
+
+	if (IS_ERR_OR_NULL(rc) || !cmd || n <= 0 || n > MAX_RPMH_PAYLOAD)
+		return ERR_PTR(-EINVAL);
+
+	rpm_msg = get_msg_from_pool(rc);
+	if (!rpm_msg)
+		return ERR_PTR(-ENOMEM);
+
+	memcpy(rpm_msg->cmd, cmd, n * sizeof(*cmd));
+
+	rpm_msg->msg.state = state;
+	rpm_msg->msg.payload = rpm_msg->cmd;
+	rpm_msg->msg.num_payload = n;
+
+	return rpm_msg;
+}
+
+static bool rpmh_coalesce_match(struct rpmh_coalesce_req *c,
+		struct rpmh_client *rc, enum rpmh_state state,
+		struct tcs_cmd *cmd, int n)
+{
+	int i;
+
+	if (c->rc != rc || c->state != state || c->n != n)
+		return false;
+
+	for (i = 0; i < n; i++)
+		if (c->cmd[i].addr != cmd[i].addr)
+			return false;
+
+	return true;
+}
+
+/*
+ * Send the held back votes in the order they were first made. The
+ * coalesce_lock is kept across the sends so a newer vote cannot overtake
+ * an older one to the same addresses.
+ */
+static void rpmh_coalesce_flush(struct rpmh_mbox *rpm)
+{
+	struct rpmh_coalesce_req *c;
+	struct rpmh_msg *rpm_msg;
+	unsigned long flags;
+	int ret, i;
+
+	spin_lock_irqsave(&rpm->coalesce_lock, flags);
+	for (i = 0; i < rpm->num_coalesce; i++) {
+		c = &rpm->coalesce[i];
+		ret = check_ctrlr_state(c->rc, c->state);
+		if (ret)
+			continue;
+		rpm_msg = __get_rpmh_msg_async(c->rc, c->state, c->cmd, c->n);
+		if (IS_ERR(rpm_msg))
+			ret = PTR_ERR(rpm_msg);
+		else
+			ret = __rpmh_write(c->rc, c->state, rpm_msg);
+		if (ret)
+			dev_err(c->rc->dev,
+				"RPMH coalesced write fail addr=0x%x, err=%d\n",
+				c->cmd[0].addr, ret);
+	}
+	rpm->num_coalesce = 0;
+	spin_unlock_irqrestore(&rpm->coalesce_lock, flags);
+}
+
+static enum hrtimer_restart rpmh_coalesce_timer_fn(struct hrtimer *timer)
+{
+	struct rpmh_mbox *rpm = container_of(timer, struct rpmh_mbox,
+						coalesce_timer);
+
+	rpmh_coalesce_flush(rpm);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Hold back an async active vote. A vote to the same set of addresses as
+ * one still held back replaces its data. Returns false if the vote could
+ * not be held back and has to be sent now.
+ */
+static bool rpmh_coalesce(struct rpmh_client *rc, enum rpmh_state state,
+			struct tcs_cmd *cmd, int n)
+{
+	struct rpmh_mbox *rpm;
+	struct rpmh_coalesce_req *c;
+	u32 window = READ_ONCE(rpmh_coalesce_us);
+	unsigned long flags;
+	bool queued = false;
+	int i;
+
+	if (!window || IS_ERR_OR_NULL(rc) || !cmd ||
+	    n <= 0 || n > MAX_RPMH_PAYLOAD)
+		return false;
+
+	rpm = rc->rpmh;
+	spin_lock_irqsave(&rpm->coalesce_lock, flags);
+	for (i = 0; i < rpm->num_coalesce; i++) {
+		c = &rpm->coalesce[i];
+		if (rpmh_coalesce_match(c, rc, state, cmd, n)) {
+			memcpy(c->cmd, cmd, n * sizeof(*cmd));
+			atomic_inc(&rpmh_coalesced);
+			queued = true;
+			goto unlock;
+		}
+	}
+
+	if (rpm->num_coalesce == RPMH_MAX_REQ_IN_BATCH)
+		goto unlock;
+
+	c = &rpm->coalesce[rpm->num_coalesce++];
+	c->rc = rc;
+	c->state = state;
+	c->n = n;
+	memcpy(c->cmd, cmd, n * sizeof(*cmd));
+	queued = true;
+
+	if (rpm->num_coalesce == 1)
+		hrtimer_start(&rpm->coalesce_timer,
+			ns_to_ktime((u64)window * NSEC_PER_USEC),
+			HRTIMER_MODE_REL);
+unlock:
+	spin_unlock_irqrestore(&rpm->coalesce_lock, flags);
+
+	return queued;
+}
+
+/* Votes made from here on must not be overtaken by held back ones */
+static void rpmh_coalesce_sync(struct rpmh_client *rc)
+{
+	struct rpmh_mbox *rpm;
+
+	if (IS_ERR_OR_NULL(rc))
+		return;
+
+	rpm = rc->rpmh;
+	if (!READ_ONCE(rpm->num_coalesce))
+		return;
+
+	hrtimer_cancel(&rpm->coalesce_timer);
+	rpmh_coalesce_flush(rpm);
+}
+
 /**
  * rpmh_write_single_async: Write a single RPMH command
  *
@@ -354,6 +627,7 @@ int __rpmh_write(struct rpmh_client *rc, enum rpmh_state state,
 int rpmh_write_single_async(struct rpmh_client *rc, enum rpmh_state state,
 			u32 addr, u32 data)
 {
+	struct tcs_cmd cmd = { 0 };
 	struct rpmh_msg *rpm_msg;
 	int ret;
 
@@ -367,6 +641,14 @@ int rpmh_write_single_async(struct rpmh_client *rc, enum rpmh_state state,
 	if (ret)
 		return ret;
 
+	cmd.addr = addr;
+	cmd.data = data;
+	if ((state == RPMH_ACTIVE_ONLY_STATE || state == RPMH_AWAKE_STATE) &&
+	    rpmh_coalesce(rc, state, &cmd, 1))
+		return 0;
+
+	rpmh_coalesce_sync(rc);
+
 	rpm_msg = get_msg_from_pool(rc);
 	if (!rpm_msg)
 		return -ENOMEM;
@@ -415,6 +697,8 @@ int rpmh_write_single(struct rpmh_client *rc, enum rpmh_state state,
 	if (ret)
 		return ret;
 
+	rpmh_coalesce_sync(rc);
+
 	rpm_msg.cmd[0].addr = addr;
 	rpm_msg.cmd[0].data = data;
 	rpm_msg.msg.num_payload = 1;
@@ -429,27 +713,6 @@ int rpmh_write_single(struct rpmh_client *rc, enum rpmh_state state,
 }
 EXPORT_SYMBOL(rpmh_write_single);
 
-struct rpmh_msg *__get_rpmh_msg_async(struct rpmh_client *rc,
-		enum rpmh_state state, struct tcs_cmd *cmd, int n)
-{
-	struct rpmh_msg *rpm_msg;
-
-	if (IS_ERR_OR_NULL(rc) || !cmd || n <= 0 || n > MAX_RPMH_PAYLOAD)
-		return ERR_PTR(-EINVAL);
-
-	rpm_msg = get_msg_from_pool(rc);
-	if (!rpm_msg)
-		return ERR_PTR(-ENOMEM);
-
-	memcpy(rpm_msg->cmd, cmd, n * sizeof(*cmd));
-
-	rpm_msg->msg.state = state;
-	rpm_msg->msg.payload = rpm_msg->cmd;
-	rpm_msg->msg.num_payload = n;
-
-	return rpm_msg;
-}
-
 /**
  * rpmh_write_async: Write a batch of RPMH commands
  *
@@ -476,6 +739,12 @@ int rpmh_write_async(struct rpmh_client *rc, enum rpmh_state state,
 	if (ret)
 		return ret;
 
+	if ((state == RPMH_ACTIVE_ONLY_STATE || state == RPMH_AWAKE_STATE) &&
+	    rpmh_coalesce(rc, state, cmd, n))
+		return 0;
+
+	rpmh_coalesce_sync(rc);
+
 	rpm_msg = __get_rpmh_msg_async(rc, state, cmd, n);
 	if (IS_ERR(rpm_msg))
 		return PTR_ERR(rpm_msg);
@@ -520,6 +789,8 @@ int rpmh_write(struct rpmh_client *rc, enum rpmh_state state,
 	if (ret)
 		return ret;
 
+	rpmh_coalesce_sync(rc);
+
 	memcpy(rpm_msg.cmd, cmd, n * sizeof(*cmd));
 	rpm_msg.msg.num_payload = n;
 
@@ -620,6 +891,7 @@ int rpmh_write_batch(struct rpmh_client *rc, enum rpmh_state state,
 	struct rpmh_msg *rpm_msg[RPMH_MAX_REQ_IN_BATCH] = { NULL };
 	DECLARE_COMPLETION_ONSTACK(compl);
 	atomic_t wait_count = ATOMIC_INIT(0); /* overwritten */
+	struct tcs_cmd *first = cmd;
 	int count = 0;
 	int ret, i, j, k;
 	bool complete_set;
@@ -641,6 +913,8 @@ int rpmh_write_batch(struct rpmh_client *rc, enum rpmh_state state,
 	if (!count || count > RPMH_MAX_REQ_IN_BATCH)
 		return -EINVAL;
 
+	rpmh_coalesce_sync(rc);
+
 	if (state == RPMH_ACTIVE_ONLY_STATE || state == RPMH_AWAKE_STATE) {
 		/*
 		 * Ensure the 'complete' bit is set for atleast one command in
@@ -693,6 +967,7 @@ int rpmh_write_batch(struct rpmh_client *rc, enum rpmh_state state,
 		for (j = i; j < count; j++)
 			rpmh_tx_done(&rc->client, &rpm_msg[j]->msg, ret);
 		wait_for_tx_done(rc, &compl, addr, data);
+		rpmh_forget_active(rc, first, cmd - first);
 	} else {
 		/*
 		 * Cache sleep/wake data in store.
@@ -738,6 +1013,9 @@ int rpmh_mode_solver_set(struct rpmh_client *rc, bool enable)
 		udelay(10);
 	} while (1);
 
+	/* The solver drives the resources while we are away */
+	rpmh_forget_active(rc, NULL, 0);
+
 	return 0;
 }
 EXPORT_SYMBOL(rpmh_mode_solver_set);
@@ -875,12 +1153,6 @@ int rpmh_ctrlr_idle(struct rpmh_client *rc)
 }
 EXPORT_SYMBOL(rpmh_ctrlr_idle);
 
-static inline int is_req_valid(struct rpmh_req *req)
-{
-	return (req->sleep_val != UINT_MAX && req->wake_val != UINT_MAX
-			&& req->sleep_val != req->wake_val);
-}
-
 int send_single(struct rpmh_client *rc, enum rpmh_state state, u32 addr,
 				u32 data)
 {
@@ -920,7 +1192,7 @@ int rpmh_flush(struct rpmh_client *rc)
 	if (rpmh_standalone)
 		return 0;
 
-	if (!mbox_controller_is_idle(rc->chan))
+	if (!mbox_controller_is_idle(rc->chan) || READ_ONCE(rpm->num_coalesce))
 		return -EBUSY;
 
 	spin_lock_irqsave(&rpm->lock, flags);
@@ -1034,6 +1306,9 @@ static struct rpmh_mbox *get_mbox(struct platform_device *pdev,
 	rpmh->mbox_dn = spec.np;
 	INIT_LIST_HEAD(&rpmh->resources);
 	spin_lock_init(&rpmh->lock);
+	spin_lock_init(&rpmh->coalesce_lock);
+	hrtimer_init(&rpmh->coalesce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rpmh->coalesce_timer.function = rpmh_coalesce_timer_fn;
 
 found:
 	of_node_put(spec.np);
@@ -1133,9 +1408,28 @@ EXPORT_SYMBOL(rpmh_get_byindex);
  */
 void rpmh_release(struct rpmh_client *rc)
 {
-	if (rc && !IS_ERR_OR_NULL(rc->chan))
+	if (rc && !IS_ERR_OR_NULL(rc->chan)) {
+		rpmh_coalesce_sync(rc);
 		mbox_free_channel(rc->chan);
+	}
 
 	kfree(rc);
 }
 EXPORT_SYMBOL(rpmh_release);
+
+static int __init rpmh_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("rpmh", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return 0;
+
+	debugfs_create_bool("elide", 0644, dir, &rpmh_elide);
+	debugfs_create_u32("coalesce_us", 0644, dir, &rpmh_coalesce_us);
+	debugfs_create_atomic_t("elided", 0444, dir, &rpmh_elided);
+	debugfs_create_atomic_t("coalesced", 0444, dir, &rpmh_coalesced);
+
+	return 0;
+}
+late_initcall(rpmh_debugfs_init);
@@ -29,6 +29,9 @@
 #include <linux/dma-buf.h>
 #include <linux/kref.h>
 #include <linux/signal.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #include <soc/qcom/scm.h>
 #include <asm/cacheflush.h>
@@ -142,7 +145,7 @@
 static DEFINE_MUTEX(g_smcinvoke_lock);
 #define NO_LOCK 0
 #define TAKE_LOCK 1
-#define MUTEX_LOCK(x) { if (x) mutex_lock(&g_smcinvoke_lock); }
+#define MUTEX_LOCK(x) { if (x) smcinvoke_lock(); }
 #define MUTEX_UNLOCK(x) { if (x) mutex_unlock(&g_smcinvoke_lock); }
 static DEFINE_HASHTABLE(g_cb_servers, 8);
 static LIST_HEAD(g_mem_objs);
@@ -151,6 +154,84 @@ static uint16_t g_last_mem_rgn_id, g_last_mem_map_obj_id;
 static size_t g_max_cb_buf_size = SMCINVOKE_TZ_MIN_BUF_SIZE;
 static unsigned int cb_reqs_inflight;
 
+/* g_smcinvoke_lock contention, updated with the lock held */
+static struct {
+	u64 acquired;
+	u64 contended;
+	u64 wait_ns;
+	u64 max_wait_ns;
+} g_lock_stats;
+
+/*
+ * Invoke and release messages are whole pages. Freed ones of the common
+ * orders are kept for the next call instead of going back to the page
+ * allocator, which may have to compact for them.
+ */
+#define SMCINVOKE_BUF_CACHE_ORDERS	3
+#define SMCINVOKE_BUF_CACHE_DEPTH	8
+static DEFINE_SPINLOCK(g_buf_cache_lock);
+static void *g_buf_cache[SMCINVOKE_BUF_CACHE_ORDERS][SMCINVOKE_BUF_CACHE_DEPTH];
+static unsigned int g_buf_cache_nr[SMCINVOKE_BUF_CACHE_ORDERS];
+static u64 g_buf_cache_hits, g_buf_cache_misses;
+static struct dentry *g_smcinvoke_debugfs;
+
+static void smcinvoke_lock(void)
+{
+	u64 start, wait;
+
+	if (!mutex_trylock(&g_smcinvoke_lock)) {
+		start = ktime_get_ns();
+		mutex_lock(&g_smcinvoke_lock);
+		wait = ktime_get_ns() - start;
+		g_lock_stats.contended++;
+		g_lock_stats.wait_ns += wait;
+		if (wait > g_lock_stats.max_wait_ns)
+			g_lock_stats.max_wait_ns = wait;
+	}
+	g_lock_stats.acquired++;
+}
+
+/* Returns a zeroed message buffer of @size bytes, a multiple of pages */
+static void *smcinvoke_alloc_msg(size_t size)
+{
+	unsigned int order = get_order(size);
+	void *buf = NULL;
+
+	if (order < SMCINVOKE_BUF_CACHE_ORDERS) {
+		spin_lock(&g_buf_cache_lock);
+		if (g_buf_cache_nr[order]) {
+			buf = g_buf_cache[order][--g_buf_cache_nr[order]];
+			g_buf_cache_hits++;
+		} else {
+			g_buf_cache_misses++;
+		}
+		spin_unlock(&g_buf_cache_lock);
+	}
+	if (!buf)
+		buf = (void *)__get_free_pages(GFP_KERNEL | __GFP_COMP, order);
+	if (buf)
+		memset(buf, 0, size);
+	return buf;
+}
+
+static void smcinvoke_free_msg(void *buf, size_t size)
+{
+	unsigned int order = get_order(size);
+
+	if (!buf)
+		return;
+	if (order < SMCINVOKE_BUF_CACHE_ORDERS) {
+		spin_lock(&g_buf_cache_lock);
+		if (g_buf_cache_nr[order] < SMCINVOKE_BUF_CACHE_DEPTH) {
+			g_buf_cache[order][g_buf_cache_nr[order]++] = buf;
+			buf = NULL;
+		}
+		spin_unlock(&g_buf_cache_lock);
+	}
+	if (buf)
+		free_pages((unsigned long)buf, order);
+}
+
 static long smcinvoke_ioctl(struct file *, unsigned int, unsigned long);
 static int smcinvoke_open(struct inode *, struct file *);
 static int smcinvoke_release(struct inode *, struct file *);
@@ -512,7 +593,7 @@ static void release_tzhandles(const int32_t *tzhandles, size_t len)
 {
 	size_t i;
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	for (i = 0; i < len; i++)
 		release_tzhandle_locked(tzhandles[i]);
 	mutex_unlock(&g_smcinvoke_lock);
@@ -649,7 +730,7 @@ static int create_mem_obj(struct dma_buf *dma_buf, int32_t *mem_obj)
 
 	kref_init(&t_mem_obj->mem_regn_ref_cnt);
 	t_mem_obj->dma_buf = dma_buf;
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	t_mem_obj->mem_region_id = next_mem_region_obj_id_locked();
 	list_add_tail(&t_mem_obj->list, &g_mem_objs);
 	mutex_unlock(&g_smcinvoke_lock);
@@ -678,7 +759,7 @@ static int get_tzhandle_from_uhandle(int32_t uhandle, int32_t server_fd,
 		if (server_id < CBOBJ_SERVER_ID_START)
 			goto out;
 
-		mutex_lock(&g_smcinvoke_lock);
+		smcinvoke_lock();
 		ret = get_pending_cbobj_locked(server_id,
 					UHANDLE_GET_CB_OBJ(uhandle));
 		mutex_unlock(&g_smcinvoke_lock);
@@ -828,7 +909,7 @@ static int32_t smcinvoke_map_mem_region(void *buf, size_t buf_len)
 	ob = buf + msg->args[0].b.offset;
 	oo =  &msg->args[2].handle;
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	mem_obj = find_mem_obj_locked(TZHANDLE_GET_OBJID(msg->args[1].handle),
 						SMCINVOKE_MEM_RGN_OBJ);
 	if (!mem_obj) {
@@ -906,7 +987,7 @@ static void process_mem_obj(void *buf, size_t buf_len)
 {
 	struct smcinvoke_tzcb_req *cb_req = buf;
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	cb_req->result = (cb_req->hdr.op == OBJECT_OP_RELEASE) ?
 			smcinvoke_release_mem_obj_locked(buf, buf_len) :
 			OBJECT_ERROR_INVALID;
@@ -973,7 +1054,7 @@ static void process_tzcb_req(void *buf, size_t buf_len, struct file **arr_filp)
 	cb_txn->filp_to_release = arr_filp;
 	kref_init(&cb_txn->ref_cnt);
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	++cb_reqs_inflight;
 	srvr_info = get_cb_server_locked(
 				TZHANDLE_GET_SERVER(cb_req->hdr.tzhandle));
@@ -1002,7 +1083,7 @@ out:
 	 * b. Server was killed                c. Invoke thread is killed
 	 * sometime invoke thread and server are part of same process.
 	 */
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	hash_del(&cb_txn->hash);
 	if (cb_txn->state == SMCINVOKE_REQ_PROCESSED) {
 		/*
@@ -1122,7 +1203,7 @@ static int prepare_send_scm_msg(const uint8_t *in_buf, size_t in_buf_len,
 	 *     b) Final response to invoke has been marshalled out
 	 */
 	while (1) {
-		mutex_lock(&g_smcinvoke_lock);
+		smcinvoke_lock();
 		ret = scm_call2(cmd, &desc);
 		req->result = (int32_t)desc.ret[1];
 		if (!ret && !is_inbound_req(desc.ret[0])) {
@@ -1471,7 +1552,7 @@ static long process_ack_local_obj(struct file *filp, unsigned int cmd,
 	if (ret)
 		return -EFAULT;
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	if (UHANDLE_IS_CB_OBJ(local_obj))
 		ret = put_pending_cbobj_locked(filp_data->server_id,
 					UHANDLE_GET_CB_OBJ(local_obj));
@@ -1510,13 +1591,13 @@ static long process_server_req(struct file *filp, unsigned int cmd,
 	hash_init(server_info->responses_table);
 	INIT_LIST_HEAD(&server_info->pending_cbobjs);
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 
 	server_info->server_id = next_cb_server_id_locked();
 	hash_add(g_cb_servers, &server_info->hash,
 					server_info->server_id);
 	if (g_max_cb_buf_size < server_req.cb_buf_size)
-		g_max_cb_buf_size = server_req.cb_buf_size;
+		WRITE_ONCE(g_max_cb_buf_size, server_req.cb_buf_size);
 
 	mutex_unlock(&g_smcinvoke_lock);
 	ret = get_fd_for_obj(SMCINVOKE_OBJ_TYPE_SERVER,
@@ -1559,7 +1640,7 @@ static long process_accept_req(struct file *filp, unsigned int cmd,
 		return -EPERM;
 	}
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	server_info = get_cb_server_locked(server_obj->server_id);
 
 	if (!server_info) {
@@ -1576,7 +1657,7 @@ static long process_accept_req(struct file *filp, unsigned int cmd,
 
 	/* First check if it has response otherwise wait for req */
 	if (user_args.has_resp) {
-		mutex_lock(&g_smcinvoke_lock);
+		smcinvoke_lock();
 		cb_txn = find_cbtxn_locked(server_info, user_args.txn_id,
 					SMCINVOKE_REQ_PROCESSING);
 		mutex_unlock(&g_smcinvoke_lock);
@@ -1630,13 +1711,13 @@ static long process_accept_req(struct file *filp, unsigned int cmd,
 			 * server_info invalid. Other accept/invoke threads are
 			 * using server_info and would crash. So dont do that.
 			 */
-			mutex_lock(&g_smcinvoke_lock);
+			smcinvoke_lock();
 			server_info->state = SMCINVOKE_SERVER_STATE_DEFUNCT;
 			mutex_unlock(&g_smcinvoke_lock);
 			wake_up_interruptible(&server_info->rsp_wait_q);
 			goto out;
 		}
-		mutex_lock(&g_smcinvoke_lock);
+		smcinvoke_lock();
 		cb_txn = find_cbtxn_locked(server_info,
 						SMCINVOKE_NEXT_AVAILABLE_TXN,
 						SMCINVOKE_REQ_PLACED);
@@ -1653,7 +1734,7 @@ static long process_accept_req(struct file *filp, unsigned int cmd,
 				wake_up_interruptible(&server_info->rsp_wait_q);
 				continue;
 			}
-			mutex_lock(&g_smcinvoke_lock);
+			smcinvoke_lock();
 			hash_add(server_info->responses_table, &cb_txn->hash,
 							cb_txn->txn_id);
 			kref_put(&cb_txn->ref_cnt, delete_cb_txn);
@@ -1732,26 +1813,21 @@ static long process_invoke_req(struct file *filp, unsigned int cmd,
 	}
 
 	inmsg_size = compute_in_msg_size(&req, args_buf);
-	in_msg = (void *)__get_free_pages(GFP_KERNEL|__GFP_COMP,
-						get_order(inmsg_size));
+	in_msg = smcinvoke_alloc_msg(inmsg_size);
 	if (!in_msg) {
 		ret = -ENOMEM;
 		pr_err("memory alloc failed for in msg in invoke req\n");
 		goto out;
 	}
-	memset(in_msg, 0, inmsg_size);
 
-	mutex_lock(&g_smcinvoke_lock);
-	outmsg_size = PAGE_ALIGN(g_max_cb_buf_size);
-	mutex_unlock(&g_smcinvoke_lock);
-	out_msg = (void *)__get_free_pages(GFP_KERNEL | __GFP_COMP,
-						get_order(outmsg_size));
+	/* only ever grows, a stale value just means a smaller buffer */
+	outmsg_size = PAGE_ALIGN(READ_ONCE(g_max_cb_buf_size));
+	out_msg = smcinvoke_alloc_msg(outmsg_size);
 	if (!out_msg) {
 		ret = -ENOMEM;
 		pr_err("memory alloc failed for out msg in invoke req\n");
 		goto out;
 	}
-	memset(out_msg, 0, outmsg_size);
 
 	ret = marshal_in_invoke_req(&req, args_buf, tzobj->tzhandle, in_msg,
 			inmsg_size, filp_to_release, tzhandles_to_release);
@@ -1798,8 +1874,8 @@ out:
 	release_filp(filp_to_release, OBJECT_COUNTS_MAX_OO);
 	if (ret)
 		release_tzhandles(tzhandles_to_release, OBJECT_COUNTS_MAX_OO);
-	free_pages((long)out_msg, get_order(outmsg_size));
-	free_pages((long)in_msg, get_order(inmsg_size));
+	smcinvoke_free_msg(out_msg, outmsg_size);
+	smcinvoke_free_msg(in_msg, inmsg_size);
 	kfree(args_buf);
 
 	if (ret)
@@ -1852,7 +1928,7 @@ static int release_cb_server(uint16_t server_id)
 {
 	struct smcinvoke_server_info *server = NULL;
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	server = find_cb_server_locked(server_id);
 	if (server)
 		kref_put(&server->ref_cnt, destroy_cb_server);
@@ -1881,16 +1957,14 @@ static int smcinvoke_release(struct inode *nodp, struct file *filp)
 	if (!tzhandle || tzhandle == SMCINVOKE_TZ_ROOT_OBJ)
 		goto out;
 
-	in_buf = (uint8_t *)__get_free_page(GFP_KERNEL | __GFP_COMP);
-	out_buf = (uint8_t *)__get_free_page(GFP_KERNEL | __GFP_COMP);
+	in_buf = smcinvoke_alloc_msg(SMCINVOKE_TZ_MIN_BUF_SIZE);
+	out_buf = smcinvoke_alloc_msg(SMCINVOKE_TZ_MIN_BUF_SIZE);
 	if (!in_buf || !out_buf) {
 		ret = -ENOMEM;
 		pr_err("Failed to allocate memory\n");
 		goto out;
 	}
 
-	memset(in_buf, 0, PAGE_SIZE);
-	memset(out_buf, 0, PAGE_SIZE);
 	hdr.tzhandle = tzhandle;
 	hdr.op = OBJECT_OP_RELEASE;
 	hdr.counts = 0;
@@ -1902,12 +1976,40 @@ static int smcinvoke_release(struct inode *nodp, struct file *filp)
 	process_piggyback_data(out_buf, SMCINVOKE_TZ_MIN_BUF_SIZE);
 out:
 	kfree(filp->private_data);
-	free_page((long)in_buf);
-	free_page((long)out_buf);
+	smcinvoke_free_msg(in_buf, SMCINVOKE_TZ_MIN_BUF_SIZE);
+	smcinvoke_free_msg(out_buf, SMCINVOKE_TZ_MIN_BUF_SIZE);
 
 	return ret;
 }
 
+static int smcinvoke_stats_show(struct seq_file *s, void *unused)
+{
+	smcinvoke_lock();
+	seq_printf(s, "lock_acquired %llu\nlock_contended %llu\nlock_wait_ns %llu\nlock_max_wait_ns %llu\n",
+		g_lock_stats.acquired, g_lock_stats.contended,
+		g_lock_stats.wait_ns, g_lock_stats.max_wait_ns);
+	mutex_unlock(&g_smcinvoke_lock);
+
+	spin_lock(&g_buf_cache_lock);
+	seq_printf(s, "buf_cache_hits %llu\nbuf_cache_misses %llu\n",
+		g_buf_cache_hits, g_buf_cache_misses);
+	spin_unlock(&g_buf_cache_lock);
+
+	return 0;
+}
+
+static int smcinvoke_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, smcinvoke_stats_show, NULL);
+}
+
+static const struct file_operations smcinvoke_stats_fops = {
+	.open		= smcinvoke_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int smcinvoke_probe(struct platform_device *pdev)
 {
 	unsigned int baseminor = 0;
@@ -1945,6 +2047,10 @@ static int smcinvoke_probe(struct platform_device *pdev)
 	}
 	smcinvoke_pdev = pdev;
 
+	g_smcinvoke_debugfs = debugfs_create_dir(SMCINVOKE_DEV, NULL);
+	debugfs_create_file("stats", 0400, g_smcinvoke_debugfs, NULL,
+			&smcinvoke_stats_fops);
+
 	return  0;
 
 exit_destroy_device:
@@ -1959,7 +2065,14 @@ exit_unreg_chrdev_region:
 static int smcinvoke_remove(struct platform_device *pdev)
 {
 	int count = 1;
-
+	unsigned int order;
+
+	debugfs_remove_recursive(g_smcinvoke_debugfs);
+	for (order = 0; order < SMCINVOKE_BUF_CACHE_ORDERS; order++)
+		while (g_buf_cache_nr[order])
+			free_pages((unsigned long)
+				g_buf_cache[order][--g_buf_cache_nr[order]],
+				order);
 	cdev_del(&smcinvoke_cdev);
 	device_destroy(driver_class, smcinvoke_device_no);
 	class_destroy(driver_class);
@@ -1972,7 +2085,7 @@ static int __maybe_unused smcinvoke_suspend(struct platform_device *pdev,
 {
 	int ret = 0;
 
-	mutex_lock(&g_smcinvoke_lock);
+	smcinvoke_lock();
 	if (cb_reqs_inflight) {
 		pr_err("Failed to suspend smcinvoke driver\n");
 		ret = -EIO;
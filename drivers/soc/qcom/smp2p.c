@@ -27,6 +27,9 @@
 #include <linux/soc/qcom/smem_state.h>
 #include <linux/spinlock.h>
 #include <linux/pm_wakeup.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/ipc_logging.h>
 
@@ -101,6 +104,7 @@ struct smp2p_smem_item {
  * @irq_falling:bitmap to mark irq bits for falling detection
  * @state:	smem state handle
  * @lock:	spinlock to protect read-modify-write of the value
+ * @coalesce:	outbound changes may wait for the coalescing window
  */
 struct smp2p_entry {
 	struct list_head node;
@@ -119,6 +123,7 @@ struct smp2p_entry {
 	struct qcom_smem_state *state;
 
 	spinlock_t lock;
+	bool coalesce;
 };
 
 #define SMP2P_INBOUND	0
@@ -139,6 +144,12 @@ struct smp2p_entry {
  * @mbox_chan:	apcs ipc mailbox channel handle
  * @inbound:	list of inbound entries
  * @outbound:	list of outbound entries
+ * @kick_timer:	end of the coalescing window of a deferred kick
+ * @kick_lock:	protects @kick_pending and the counters
+ * @kick_pending: a deferred kick is outstanding
+ * @kicks:	interrupts sent to the remote processor
+ * @kicks_saved: updates that went out with another update's interrupt
+ * @dbgfs:	debugfs file with the counters
  */
 struct qcom_smp2p {
 	struct device *dev;
@@ -168,8 +179,26 @@ struct qcom_smp2p {
 
 	struct list_head inbound;
 	struct list_head outbound;
+
+	struct hrtimer kick_timer;
+	spinlock_t kick_lock;
+	bool kick_pending;
+	unsigned long kicks;
+	unsigned long kicks_saved;
+	struct dentry *dbgfs;
 };
 
+/*
+ * Changes to outbound entries marked qcom,coalesce wait up to this long
+ * for other changes on the same edge, so that they share one interrupt.
+ * Changes to other entries always interrupt the remote at once, carrying
+ * whatever is pending with them. 0 disables coalescing.
+ */
+static uint coalesce_us;
+module_param(coalesce_us, uint, 0644);
+
+static struct dentry *smp2p_dbgfs_dir;
+
 static void *ilc;
 #define SMP2P_LOG_PAGE_CNT 2
 #define SMP2P_INFO(x, ...)	\
@@ -180,6 +209,18 @@ do {	\
 
 static void qcom_smp2p_kick(struct qcom_smp2p *smp2p)
 {
+	unsigned long flags;
+
+	/* This kick carries a deferred one along */
+	spin_lock_irqsave(&smp2p->kick_lock, flags);
+	if (smp2p->kick_pending) {
+		smp2p->kick_pending = false;
+		smp2p->kicks_saved++;
+		hrtimer_try_to_cancel(&smp2p->kick_timer);
+	}
+	smp2p->kicks++;
+	spin_unlock_irqrestore(&smp2p->kick_lock, flags);
+
 	/* Make sure any updated data is written before the kick */
 	wmb();
 
@@ -191,6 +232,40 @@ static void qcom_smp2p_kick(struct qcom_smp2p *smp2p)
 	}
 }
 
+static void qcom_smp2p_kick_deferred(struct qcom_smp2p *smp2p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&smp2p->kick_lock, flags);
+	if (smp2p->kick_pending) {
+		smp2p->kicks_saved++;
+	} else {
+		smp2p->kick_pending = true;
+		hrtimer_start(&smp2p->kick_timer,
+			      ns_to_ktime((u64)coalesce_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+	spin_unlock_irqrestore(&smp2p->kick_lock, flags);
+}
+
+static enum hrtimer_restart qcom_smp2p_kick_timer(struct hrtimer *timer)
+{
+	struct qcom_smp2p *smp2p = container_of(timer, struct qcom_smp2p,
+						kick_timer);
+	unsigned long flags;
+	bool pending;
+
+	spin_lock_irqsave(&smp2p->kick_lock, flags);
+	pending = smp2p->kick_pending;
+	smp2p->kick_pending = false;
+	spin_unlock_irqrestore(&smp2p->kick_lock, flags);
+
+	if (pending)
+		qcom_smp2p_kick(smp2p);
+
+	return HRTIMER_NORESTART;
+}
+
 static bool qcom_smp2p_check_ssr(struct qcom_smp2p *smp2p)
 {
 	struct smp2p_smem_item *in = smp2p->in;
@@ -447,7 +522,12 @@ static int smp2p_update_bits(void *data, u32 mask, u32 value)
 	SMP2P_INFO("%d: %s: orig:0x%0x new:0x%0x\n",
 		   entry->smp2p->remote_pid, entry->name, orig, val);
 
-	if (val != orig)
+	if (val == orig)
+		return 0;
+
+	if (entry->coalesce && READ_ONCE(coalesce_us))
+		qcom_smp2p_kick_deferred(entry->smp2p);
+	else
 		qcom_smp2p_kick(entry->smp2p);
 
 	return 0;
@@ -473,6 +553,8 @@ static int qcom_smp2p_outbound_entry(struct qcom_smp2p *smp2p,
 
 	out->valid_entries++;
 
+	entry->coalesce = of_property_read_bool(node, "qcom,coalesce");
+
 	entry->state = qcom_smem_state_register(node, &smp2p_state_ops, entry);
 	if (IS_ERR(entry->state)) {
 		dev_err(smp2p->dev, "failed to register qcom_smem_state\n");
@@ -604,6 +686,50 @@ static int qcom_smp2p_alloc_item(struct platform_device *pdev,
 	return ret;
 }
 
+static int smp2p_stats_show(struct seq_file *s, void *unused)
+{
+	struct qcom_smp2p *smp2p = s->private;
+	struct smp2p_entry *entry;
+	unsigned long flags;
+
+	spin_lock_irqsave(&smp2p->kick_lock, flags);
+	seq_printf(s, "kicks: %lu\nsaved: %lu\n", smp2p->kicks,
+		   smp2p->kicks_saved);
+	spin_unlock_irqrestore(&smp2p->kick_lock, flags);
+
+	list_for_each_entry(entry, &smp2p->outbound, node)
+		if (entry->coalesce)
+			seq_printf(s, "coalesced: %s\n", entry->name);
+
+	return 0;
+}
+
+static int smp2p_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, smp2p_stats_show, inode->i_private);
+}
+
+static const struct file_operations smp2p_stats_fops = {
+	.open = smp2p_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void qcom_smp2p_debugfs_init(struct qcom_smp2p *smp2p)
+{
+	char name[16];
+
+	if (IS_ERR_OR_NULL(smp2p_dbgfs_dir))
+		smp2p_dbgfs_dir = debugfs_create_dir("smp2p", NULL);
+	if (IS_ERR_OR_NULL(smp2p_dbgfs_dir))
+		return;
+
+	snprintf(name, sizeof(name), "%u", smp2p->remote_pid);
+	smp2p->dbgfs = debugfs_create_file(name, 0444, smp2p_dbgfs_dir, smp2p,
+					   &smp2p_stats_fops);
+}
+
 static int qcom_smp2p_probe(struct platform_device *pdev)
 {
 	struct smp2p_entry *entry;
@@ -621,6 +747,9 @@ static int qcom_smp2p_probe(struct platform_device *pdev)
 	smp2p->dev = &pdev->dev;
 	INIT_LIST_HEAD(&smp2p->inbound);
 	INIT_LIST_HEAD(&smp2p->outbound);
+	spin_lock_init(&smp2p->kick_lock);
+	hrtimer_init(&smp2p->kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	smp2p->kick_timer.function = qcom_smp2p_kick_timer;
 
 	platform_set_drvdata(pdev, smp2p);
 
@@ -684,6 +813,7 @@ static int qcom_smp2p_probe(struct platform_device *pdev)
 		goto unwind_interfaces;
 	}
 	enable_irq_wake(smp2p->irq);
+	qcom_smp2p_debugfs_init(smp2p);
 
 	return 0;
 
@@ -713,6 +843,8 @@ static int qcom_smp2p_remove(struct platform_device *pdev)
 	list_for_each_entry(entry, &smp2p->outbound, node)
 		qcom_smem_state_unregister(entry->state);
 
+	debugfs_remove(smp2p->dbgfs);
+	hrtimer_cancel(&smp2p->kick_timer);
 	mbox_free_channel(smp2p->mbox_chan);
 
 	smp2p->out->valid_entries = 0;
@@ -775,6 +907,8 @@ static int qcom_smp2p_freeze(struct device *dev)
 	struct smp2p_entry *next_entry;
 
 	disable_irq_wake(smp2p->irq);
+	hrtimer_cancel(&smp2p->kick_timer);
+	smp2p->kick_pending = false;
 	/* Walk through the out bound list and release state and entry */
 	list_for_each_entry_safe(entry, next_entry, &smp2p->outbound, node) {
 		qcom_smem_state_unregister(entry->state);
@@ -26,6 +26,7 @@
 #include <linux/stringify.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
 #include <soc/qcom/subsystem_notif.h>
 
 /**
@@ -54,6 +55,10 @@ static LIST_HEAD(subsystem_list);
 static DEFINE_MUTEX(notif_lock);
 static DEFINE_MUTEX(notif_add_lock);
 
+/* Notifier callbacks taking longer than this are reported */
+static uint notif_warn_ms = 100;
+module_param(notif_warn_ms, uint, 0644);
+
 #if defined(SUBSYS_RESTART_DEBUG)
 static void subsys_notif_reg_test_notifier(const char *);
 #endif
@@ -262,6 +267,42 @@ done:
 }
 EXPORT_SYMBOL(subsys_notif_add_subsys);
 
+/*
+ * Same as srcu_notifier_call_chain(), but times every callback so that the
+ * clients holding up a subsystem restart can be found.
+ */
+static int subsys_notif_call_chain(struct subsys_notif_info *subsys,
+				   unsigned long notif_type, void *data)
+{
+	struct srcu_notifier_head *nh = &subsys->subsys_notif_rcvr_list;
+	struct notifier_block *nb, *next;
+	int ret = NOTIFY_DONE;
+	ktime_t start;
+	s64 ms;
+	int idx;
+
+	idx = srcu_read_lock(&nh->srcu);
+	nb = srcu_dereference(nh->head, &nh->srcu);
+	while (nb) {
+		next = srcu_dereference(nb->next, &nh->srcu);
+
+		start = ktime_get();
+		ret = nb->notifier_call(nb, notif_type, data);
+		ms = ktime_ms_delta(ktime_get(), start);
+		if (ms >= notif_warn_ms)
+			pr_warn("%s: notifier %pf took %lld ms for notification %lu\n",
+				subsys->name, nb->notifier_call, ms,
+				notif_type);
+
+		if (ret & NOTIFY_STOP_MASK)
+			break;
+		nb = next;
+	}
+	srcu_read_unlock(&nh->srcu, idx);
+
+	return ret;
+}
+
 int subsys_notif_queue_notification(void *subsys_handle,
 					enum subsys_notif_type notif_type,
 					void *data)
@@ -274,8 +315,7 @@ int subsys_notif_queue_notification(void *subsys_handle,
 	if (notif_type < 0 || notif_type >= SUBSYS_NOTIF_TYPE_COUNT)
 		return -EINVAL;
 
-	return srcu_notifier_call_chain(&subsys->subsys_notif_rcvr_list,
-				       notif_type, data);
+	return subsys_notif_call_chain(subsys, notif_type, data);
 }
 EXPORT_SYMBOL(subsys_notif_queue_notification);
 
@@ -31,6 +31,8 @@
 #include <linux/interrupt.h>
 #include <linux/cdev.h>
 #include <linux/platform_device.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
 #include <soc/qcom/sysmon.h>
@@ -51,6 +53,13 @@ module_param(disable_restart_work, uint, 0644);
 static int enable_debug;
 module_param(enable_debug, int, 0644);
 
+/* Send sysmon events and collect ramdumps for all subsystems at once */
+static bool parallel_ssr = true;
+module_param(parallel_ssr, bool, 0644);
+
+static ASYNC_DOMAIN_EXCLUSIVE(ssr_sysmon_domain);
+static ASYNC_DOMAIN_EXCLUSIVE(ssr_ramdump_domain);
+
 /* The maximum shutdown timeout is the product of MAX_LOOPS and DELAY_MS. */
 #define SHUTDOWN_ACK_MAX_LOOPS	100
 #define SHUTDOWN_ACK_DELAY_MS	100
@@ -556,7 +565,8 @@ static void _setup_timeout(struct subsys_desc *source_ss,
 
 	switch (comm_type) {
 	case SUBSYS_TO_SUBSYS_SYSMON:
-		timeout_data = &source_ss->timeout_data;
+		/* Per destination, events to all of them may be in flight */
+		timeout_data = &dest_ss->timeout_data;
 		timeout_data->dest_name = dest_ss->name;
 		timeout_data->source_name = source_ss->name;
 		break;
@@ -599,7 +609,7 @@ static void send_sysmon_notif(struct subsys_device *dev)
 				      SUBSYS_TO_SUBSYS_SYSMON);
 			sysmon_send_event(dev->desc, subsys->desc,
 						subsys->notif_state);
-			cancel_timeout(subsys->desc);
+			cancel_timeout(dev->desc);
 		}
 	mutex_unlock(&subsys_list_lock);
 }
@@ -638,12 +648,69 @@ static void subsys_notif_uevent(struct subsys_desc *desc,
 	}
 }
 
+struct ssr_sysmon_event {
+	struct subsys_device *source;
+	struct subsys_device *dest;
+	enum subsys_notif_type notif;
+};
+
+static void ssr_send_sysmon_event(struct subsys_device *source,
+		struct subsys_device *dest, enum subsys_notif_type notif)
+{
+	setup_timeout(source->desc, dest->desc, SUBSYS_TO_SUBSYS_SYSMON);
+	sysmon_send_event(dest->desc, source->desc, notif);
+	cancel_timeout(dest->desc);
+}
+
+static void ssr_send_sysmon_event_async(void *data, async_cookie_t cookie)
+{
+	struct ssr_sysmon_event *ev = data;
+
+	ssr_send_sysmon_event(ev->source, ev->dest, ev->notif);
+	kfree(ev);
+}
+
+/*
+ * Tell every other online subsystem about @notif on @dev. Each of them is
+ * a separate QMI transaction that may run into its own timeout, so they
+ * are sent concurrently.
+ */
+static void ssr_send_sysmon_events(struct subsys_device *dev,
+		enum subsys_notif_type notif)
+{
+	struct ssr_sysmon_event *ev;
+	struct subsys_device *subsys;
+	async_cookie_t cookie = 0;
+	bool async = false;
+
+	mutex_lock(&subsys_list_lock);
+	list_for_each_entry(subsys, &subsys_list, list) {
+		if (dev == subsys || subsys->track.state != SUBSYS_ONLINE)
+			continue;
+
+		ev = parallel_ssr ? kmalloc(sizeof(*ev), GFP_KERNEL) : NULL;
+		if (!ev) {
+			ssr_send_sysmon_event(dev, subsys, notif);
+			continue;
+		}
+
+		ev->source = dev;
+		ev->dest = subsys;
+		ev->notif = notif;
+		cookie = async_schedule_domain(ssr_send_sysmon_event_async, ev,
+					       &ssr_sysmon_domain);
+		async = true;
+	}
+	if (async)
+		async_synchronize_cookie_domain(cookie + 1,
+						&ssr_sysmon_domain);
+	mutex_unlock(&subsys_list_lock);
+}
+
 static void notify_each_subsys_device(struct subsys_device **list,
 		unsigned int count,
 		enum subsys_notif_type notif, void *data)
 {
-	struct subsys_device *subsys;
-
 	while (count--) {
 		struct subsys_device *dev = *list++;
 		struct notif_data notif_data;
@@ -656,17 +723,7 @@ static void notify_each_subsys_device(struct subsys_device **list,
 									dev);
 		dev->notif_state = notif;
 
-		mutex_lock(&subsys_list_lock);
-		list_for_each_entry(subsys, &subsys_list, list)
-			if (dev != subsys &&
-				subsys->track.state == SUBSYS_ONLINE) {
-				setup_timeout(dev->desc, subsys->desc,
-					      SUBSYS_TO_SUBSYS_SYSMON);
-				sysmon_send_event(subsys->desc, dev->desc,
-						  notif);
-				cancel_timeout(dev->desc);
-			}
-		mutex_unlock(&subsys_list_lock);
+		ssr_send_sysmon_events(dev, notif);
 
 		if (notif == SUBSYS_AFTER_POWERUP &&
 				dev->track.state == SUBSYS_ONLINE)
@@ -796,6 +853,48 @@ static int subsystem_free_memory(struct subsys_device *dev, void *data)
 	return 0;
 }
 
+static void subsystem_ramdump_async(void *data, async_cookie_t cookie)
+{
+	struct subsys_device *dev = data;
+
+	subsystem_ramdump(dev, NULL);
+	subsystem_free_memory(dev, NULL);
+}
+
+/*
+ * Collect the ram dumps of all subsystems of the restart order at once,
+ * each followed by freeing its memory. Subsystems with ramdumps disabled
+ * do not go through their ramdump callback at all.
+ */
+static void subsystem_ramdump_all(struct subsys_device **list,
+		unsigned int count)
+{
+	async_cookie_t cookie = 0;
+	bool async = false;
+
+	while (count--) {
+		struct subsys_device *dev = *list++;
+
+		if (!dev)
+			continue;
+
+		if (!is_ramdump_enabled(dev)) {
+			dev->do_ramdump_on_put = false;
+			subsystem_free_memory(dev, NULL);
+		} else if (parallel_ssr) {
+			cookie = async_schedule_domain(subsystem_ramdump_async,
+						dev, &ssr_ramdump_domain);
+			async = true;
+		} else {
+			subsystem_ramdump_async(dev, 0);
+		}
+	}
+
+	if (async)
+		async_synchronize_cookie_domain(cookie + 1,
+						&ssr_ramdump_domain);
+}
+
 static int subsystem_powerup(struct subsys_device *dev, void *data)
 {
 	const char *name = dev->desc->name;
@@ -1101,6 +1200,7 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 	struct subsys_tracking *track;
 	unsigned int count;
 	unsigned long flags;
+	ktime_t start, shutdown, ramdump;
 	int ret;
 
 	/*
@@ -1148,11 +1248,13 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 
 	pr_debug("[%s:%d]: Starting restart sequence for %s\n",
 			current->comm, current->pid, desc->name);
+	start = ktime_get();
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_SHUTDOWN, NULL);
 	ret = for_each_subsys_device(list, count, NULL, subsystem_shutdown);
 	if (ret)
 		goto err;
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_SHUTDOWN, NULL);
+	shutdown = ktime_get();
 
 	notify_each_subsys_device(list, count, SUBSYS_RAMDUMP_NOTIFICATION,
 									NULL);
@@ -1161,10 +1263,8 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 	track->p_state = SUBSYS_RESTARTING;
 	spin_unlock_irqrestore(&track->s_lock, flags);
 
-	/* Collect ram dumps for all subsystems in order here */
-	for_each_subsys_device(list, count, NULL, subsystem_ramdump);
-
-	for_each_subsys_device(list, count, NULL, subsystem_free_memory);
+	subsystem_ramdump_all(list, count);
+	ramdump = ktime_get();
 
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_POWERUP, NULL);
 	ret = for_each_subsys_device(list, count, NULL, subsystem_powerup);
@@ -1172,8 +1272,12 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 		goto err;
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_POWERUP, NULL);
 
-	pr_info("[%s:%d]: Restart sequence for %s completed.\n",
-			current->comm, current->pid, desc->name);
+	pr_info("[%s:%d]: Restart sequence for %s completed in %lld ms (shutdown %lld ms, ramdump %lld ms, powerup %lld ms).\n",
+			current->comm, current->pid, desc->name,
+			ktime_ms_delta(ktime_get(), start),
+			ktime_ms_delta(shutdown, start),
+			ktime_ms_delta(ramdump, shutdown),
+			ktime_ms_delta(ktime_get(), ramdump));
 
 err:
 	/* Reset subsys count */
@@ -19,10 +19,13 @@
 #define pr_fmt(fmt) "ashmem: " fmt
 
 #include <linux/init.h>
+#include <linux/cred.h>
+#include <linux/debugfs.h>
 #include <linux/export.h>
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/falloc.h>
+#include <linux/fcntl.h>
 #include <linux/miscdevice.h>
 #include <linux/security.h>
 #include <linux/mm.h>
@@ -31,7 +34,10 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/seq_file.h>
 #include <linux/shmem_fs.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include "ashmem.h"
 
 #define ASHMEM_NAME_PREFIX "dev/ashmem/"
@@ -45,9 +51,12 @@
  * @file:		The shmem-based backing file
  * @size:		The size of the mapping, in bytes
  * @prot_mask:		The allowed protection bits, as vm_flags
+ * @exported:		A sealed fd was handed out by ASHMEM_EXPORT_FD
+ * @lock:		Protects all of the above
+ * @purging:		Ranges of the area the shrinker is punching out
  *
  * The lifecycle of this structure is from our parent file's open() until
- * its release(). It is also protected by 'ashmem_mutex'
+ * its release().
  *
  * Warning: Mappings do NOT pin this structure; It dies on close()
  */
@@ -57,6 +66,9 @@ struct ashmem_area {
 	struct file *file;
 	size_t size;
 	unsigned long prot_mask;
+	bool exported;
+	struct mutex lock;
+	atomic_t purging;
 };
 
 /**
@@ -69,7 +81,8 @@ struct ashmem_area {
  * @purged:	         The purge status (ASHMEM_NOT or ASHMEM_WAS_PURGED)
  *
  * The lifecycle of this structure is from unpin to pin.
- * It is protected by 'ashmem_mutex'
+ * It is protected by its area's lock and by ashmem_lru_lock, the shrinker
+ * only takes the latter.
  */
 struct ashmem_range {
 	struct list_head lru;
@@ -80,22 +93,36 @@ struct ashmem_range {
 	unsigned int purged;
 };
 
-/* LRU list of unpinned pages, protected by ashmem_mutex */
+/* LRU list of unpinned pages, protected by ashmem_lru_lock */
 static LIST_HEAD(ashmem_lru_list);
 
 /*
  * long lru_count - The count of pages on our LRU list.
  *
- * This is protected by ashmem_mutex.
+ * This is protected by ashmem_lru_lock.
  */
 static unsigned long lru_count;
 
 /*
- * ashmem_mutex - protects the list of and each individual ashmem_area
+ * ashmem_lru_lock - protects the LRU list, and the bounds and purge status
+ * of every range on it
  *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * Lock Ordering: asma->lock -> ashmem_lru_lock
+ *		  asma->lock -> i_mutex -> i_alloc_sem
  */
-static DEFINE_MUTEX(ashmem_mutex);
+static DEFINE_SPINLOCK(ashmem_lru_lock);
+
+/* Woken up whenever an area has no more ranges being purged */
+static DECLARE_WAIT_QUEUE_HEAD(ashmem_purge_wait);
+
+/* The shrinker takes up to this many ranges off the LRU at once */
+#define ASHMEM_SHRINK_BATCH	16
+
+static atomic_long_t ashmem_area_contended;
+static atomic_long_t ashmem_lru_contended;
+static atomic_long_t ashmem_shrink_batches;
+static atomic_long_t ashmem_shrink_ranges;
+static atomic_long_t ashmem_shrink_pages;
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -141,6 +168,32 @@ static inline bool range_before_page(struct ashmem_range *range, size_t page)
 
 #define PROT_MASK		(PROT_EXEC | PROT_READ | PROT_WRITE)
 
+static void asma_lock(struct ashmem_area *asma)
+{
+	if (!mutex_trylock(&asma->lock)) {
+		atomic_long_inc(&ashmem_area_contended);
+		mutex_lock(&asma->lock);
+	}
+}
+
+static void asma_unlock(struct ashmem_area *asma)
+{
+	mutex_unlock(&asma->lock);
+}
+
+static void lru_lock(void)
+{
+	if (!spin_trylock(&ashmem_lru_lock)) {
+		atomic_long_inc(&ashmem_lru_contended);
+		spin_lock(&ashmem_lru_lock);
+	}
+}
+
+static void lru_unlock(void)
+{
+	spin_unlock(&ashmem_lru_lock);
+}
+
 /**
  * lru_add() - Adds a range of memory to the LRU list
  * @range:     The memory range being added.
@@ -168,27 +221,24 @@ static inline void lru_del(struct ashmem_range *range)
 }
 
 /**
- * range_alloc() - Allocates and initializes a new ashmem_range structure
+ * range_alloc() - Initializes a new ashmem_range structure
  * @asma:	   The associated ashmem_area
  * @prev_range:	   The previous ashmem_range in the sorted asma->unpinned list
  * @purged:	   Initial purge status (ASMEM_NOT_PURGED or ASHMEM_WAS_PURGED)
  * @start:	   The starting page (inclusive)
  * @end:	   The ending page (inclusive)
+ * @new_range:	   The range preallocated by the caller, consumed here
  *
- * This function is protected by ashmem_mutex.
- *
- * Return: 0 if successful, or -ENOMEM if there is an error
+ * This function is protected by asma->lock and ashmem_lru_lock.
  */
-static int range_alloc(struct ashmem_area *asma,
-		       struct ashmem_range *prev_range, unsigned int purged,
-		       size_t start, size_t end)
+static void range_alloc(struct ashmem_area *asma,
+			struct ashmem_range *prev_range, unsigned int purged,
+			size_t start, size_t end,
+			struct ashmem_range **new_range)
 {
-	struct ashmem_range *range;
-
-	range = kmem_cache_zalloc(ashmem_range_cachep, GFP_KERNEL);
-	if (unlikely(!range))
-		return -ENOMEM;
+	struct ashmem_range *range = *new_range;
 
+	*new_range = NULL;
 	range->asma = asma;
 	range->pgstart = start;
 	range->pgend = end;
@@ -198,8 +248,6 @@ static int range_alloc(struct ashmem_area *asma,
 
 	if (range_on_lru(range))
 		lru_add(range);
-
-	return 0;
 }
 
 /**
@@ -262,6 +310,8 @@ static int ashmem_open(struct inode *inode, struct file *file)
 		return -ENOMEM;
 
 	INIT_LIST_HEAD(&asma->unpinned_list);
+	mutex_init(&asma->lock);
+	atomic_set(&asma->purging, 0);
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
 	file->private_data = asma;
@@ -282,10 +332,15 @@ static int ashmem_release(struct inode *ignored, struct file *file)
 	struct ashmem_area *asma = file->private_data;
 	struct ashmem_range *range, *next;
 
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
+	lru_lock();
 	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
 		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	lru_unlock();
+	asma_unlock(asma);
+
+	/* the shrinker may still be punching out ranges it took */
+	wait_event(ashmem_purge_wait, !atomic_read(&asma->purging));
 
 	if (asma->file)
 		fput(asma->file);
@@ -299,7 +354,7 @@ static ssize_t ashmem_read_iter(struct kiocb *iocb, struct iov_iter *iter)
 	struct ashmem_area *asma = iocb->ki_filp->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0)
@@ -316,13 +371,13 @@ static ssize_t ashmem_read_iter(struct kiocb *iocb, struct iov_iter *iter)
 	 * be destroyed until all references to the file are dropped and
 	 * ashmem_release is called.
 	 */
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
 	ret = vfs_iter_read(asma->file, iter, &iocb->ki_pos, 0);
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
 	if (ret > 0)
 		asma->file->f_pos = iocb->ki_pos;
 out_unlock:
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
 	return ret;
 }
 
@@ -331,19 +386,19 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
 
 	if (asma->size == 0) {
-		mutex_unlock(&ashmem_mutex);
+		asma_unlock(asma);
 		return -EINVAL;
 	}
 
 	if (!asma->file) {
-		mutex_unlock(&ashmem_mutex);
+		asma_unlock(asma);
 		return -EBADF;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
 
 	ret = vfs_llseek(asma->file, offset, origin);
 	if (ret < 0)
@@ -375,13 +430,56 @@ ashmem_vmfile_get_unmapped_area(struct file *file, unsigned long addr,
 	return current->mm->get_unmapped_area(file, addr, len, pgoff, flags);
 }
 
-static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
+/*
+ * Allocate the backing shmem file of @asma if it doesn't have one yet.
+ *
+ * Caller must hold asma->lock.
+ */
+static int ashmem_setup_file(struct ashmem_area *asma, vm_flags_t vm_flags)
 {
 	static struct file_operations vmfile_fops;
+	static DEFINE_MUTEX(vmfile_fops_lock);
+	char *name = ASHMEM_NAME_DEF;
+	struct file *vmfile;
+
+	if (asma->file)
+		return 0;
+
+	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0')
+		name = asma->name;
+
+	/* ... and allocate the backing shmem file */
+	vmfile = shmem_file_setup(name, asma->size, vm_flags);
+	if (IS_ERR(vmfile))
+		return PTR_ERR(vmfile);
+	vmfile->f_mode |= FMODE_LSEEK;
+	asma->file = vmfile;
+	/*
+	 * override mmap operation of the vmfile so that it can't be
+	 * remapped which would lead to creation of a new vma with no
+	 * asma permission checks. Have to override get_unmapped_area
+	 * as well to prevent VM_BUG_ON check for f_ops modification.
+	 * Areas are not serialised against each other, hence the lock.
+	 */
+	mutex_lock(&vmfile_fops_lock);
+	if (!vmfile_fops.mmap) {
+		vmfile_fops = *vmfile->f_op;
+		vmfile_fops.mmap = ashmem_vmfile_mmap;
+		vmfile_fops.get_unmapped_area =
+				ashmem_vmfile_get_unmapped_area;
+	}
+	mutex_unlock(&vmfile_fops_lock);
+	vmfile->f_op = &vmfile_fops;
+
+	return 0;
+}
+
+static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
+{
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -403,35 +501,9 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	}
 	vma->vm_flags &= ~calc_vm_may_flags(~asma->prot_mask);
 
-	if (!asma->file) {
-		char *name = ASHMEM_NAME_DEF;
-		struct file *vmfile;
-
-		if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0')
-			name = asma->name;
-
-		/* ... and allocate the backing shmem file */
-		vmfile = shmem_file_setup(name, asma->size, vma->vm_flags);
-		if (IS_ERR(vmfile)) {
-			ret = PTR_ERR(vmfile);
-			goto out;
-		}
-		vmfile->f_mode |= FMODE_LSEEK;
-		asma->file = vmfile;
-		/*
-		 * override mmap operation of the vmfile so that it can't be
-		 * remapped which would lead to creation of a new vma with no
-		 * asma permission checks. Have to override get_unmapped_area
-		 * as well to prevent VM_BUG_ON check for f_ops modification.
-		 */
-		if (!vmfile_fops.mmap) {
-			vmfile_fops = *vmfile->f_op;
-			vmfile_fops.mmap = ashmem_vmfile_mmap;
-			vmfile_fops.get_unmapped_area =
-					ashmem_vmfile_get_unmapped_area;
-		}
-		vmfile->f_op = &vmfile_fops;
-	}
+	ret = ashmem_setup_file(asma, vma->vm_flags);
+	if (ret)
+		goto out;
 	get_file(asma->file);
 
 	if (vma->vm_flags & VM_SHARED)
@@ -443,10 +515,17 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	}
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
 	return ret;
 }
 
+struct ashmem_purge {
+	struct ashmem_area *asma;
+	struct file *file;
+	loff_t start;
+	loff_t len;
+};
+
 /*
  * ashmem_shrink - our cache shrinker, called from mm/vmscan.c
  *
@@ -458,37 +537,62 @@ out:
  * proceed without risk of deadlock (due to gfp_mask).
  *
  * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
- * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
- * pages freed.
+ * chunks of ashmem regions LRU-wise until we hit 'nr_to_scan' ranges. Up to
+ * ASHMEM_SHRINK_BATCH ranges are taken off the LRU and marked purged under
+ * ashmem_lru_lock at a time, and their pages punched out with no lock held,
+ * so that pin and unpin only wait for the shrinker on the areas it purges.
  */
 static unsigned long
 ashmem_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_purge batch[ASHMEM_SHRINK_BATCH];
+	struct ashmem_range *range;
 	unsigned long freed = 0;
+	int i, n;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
 	if (!(sc->gfp_mask & __GFP_FS))
 		return SHRINK_STOP;
 
-	if (!mutex_trylock(&ashmem_mutex))
-		return -1;
-
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE;
-
-		range->asma->file->f_op->fallocate(range->asma->file,
-				FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
-				start, end - start);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+	while (sc->nr_to_scan) {
+		n = 0;
+		lru_lock();
+		while (n < ASHMEM_SHRINK_BATCH && sc->nr_to_scan &&
+		       !list_empty(&ashmem_lru_list)) {
+			range = list_first_entry(&ashmem_lru_list,
+						 struct ashmem_range, lru);
+			batch[n].asma = range->asma;
+			batch[n].file = get_file(range->asma->file);
+			batch[n].start = range->pgstart * PAGE_SIZE;
+			batch[n].len = range_size(range) * PAGE_SIZE;
+			atomic_inc(&range->asma->purging);
+
+			range->purged = ASHMEM_WAS_PURGED;
+			lru_del(range);
+
+			sc->nr_to_scan--;
+			n++;
+		}
+		lru_unlock();
 
-		freed += range_size(range);
-		if (--sc->nr_to_scan <= 0)
+		if (!n)
 			break;
+
+		for (i = 0; i < n; i++) {
+			/* fails on exported areas sealed against writes */
+			if (!batch[i].file->f_op->fallocate(batch[i].file,
+					FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+					batch[i].start, batch[i].len))
+				freed += batch[i].len >> PAGE_SHIFT;
+			fput(batch[i].file);
+			/* the area may be freed as soon as this drops to 0 */
+			if (atomic_dec_and_test(&batch[i].asma->purging))
+				wake_up_all(&ashmem_purge_wait);
+		}
+		atomic_long_inc(&ashmem_shrink_batches);
+		atomic_long_add(n, &ashmem_shrink_ranges);
 	}
-	mutex_unlock(&ashmem_mutex);
+	atomic_long_add(freed, &ashmem_shrink_pages);
 	return freed;
 }
 
@@ -517,7 +621,13 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
+
+	/* the exported fd is sealed for the current mask */
+	if (unlikely(asma->exported)) {
+		ret = -EINVAL;
+		goto out;
+	}
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -532,7 +642,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
 	return ret;
 }
 
@@ -543,10 +653,10 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	char local_name[ASHMEM_NAME_LEN];
 
 	/*
-	 * Holding the ashmem_mutex while doing a copy_from_user might cause
+	 * Holding the asma lock while doing a copy_from_user might cause
 	 * an data abort which would try to access mmap_sem. If another
 	 * thread has invoked ashmem_mmap then it will be holding the
-	 * semaphore and will be waiting for ashmem_mutex, there by leading to
+	 * semaphore and will be waiting for the asma lock, there by leading to
 	 * deadlock. We'll release the mutex  and take the name to a local
 	 * variable that does not need protection and later copy the local
 	 * variable to the structure member with lock held.
@@ -556,14 +666,14 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 		return len;
 	if (len == ASHMEM_NAME_LEN)
 		local_name[ASHMEM_NAME_LEN - 1] = '\0';
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file))
 		ret = -EINVAL;
 	else
 		strcpy(asma->name + ASHMEM_NAME_PREFIX_LEN, local_name);
 
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
 	return ret;
 }
 
@@ -579,7 +689,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 	 */
 	char local_name[ASHMEM_NAME_LEN];
 
-	mutex_lock(&ashmem_mutex);
+	asma_lock(asma);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 		/*
 		 * Copying only `len', instead of ASHMEM_NAME_LEN, bytes
@@ -591,7 +701,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 		len = sizeof(ASHMEM_NAME_DEF);
 		memcpy(local_name, ASHMEM_NAME_DEF, len);
 	}
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
 
 	/*
 	 * Now we are just copying from the stack variable to userland
@@ -606,9 +716,10 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->lock and ashmem_lru_lock.
  */
-static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
+static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend,
+		      struct ashmem_range **new_range)
 {
 	struct ashmem_range *range, *next;
 	int ret = ASHMEM_NOT_PURGED;
@@ -661,7 +772,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 			 * second half and adjust the first chunk's endpoint.
 			 */
 			range_alloc(asma, range, range->purged,
-				    pgend + 1, range->pgend);
+				    pgend + 1, range->pgend, new_range);
 			range_shrink(range, range->pgstart, pgstart - 1);
 			break;
 		}
@@ -673,9 +784,10 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->lock and ashmem_lru_lock.
  */
-static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
+static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend,
+			struct ashmem_range **new_range)
 {
 	struct ashmem_range *range, *next;
 	unsigned int purged = ASHMEM_NOT_PURGED;
@@ -701,14 +813,15 @@ restart:
 		}
 	}
 
-	return range_alloc(asma, range, purged, pgstart, pgend);
+	range_alloc(asma, range, purged, pgstart, pgend, new_range);
+	return 0;
 }
 
 /*
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->lock and ashmem_lru_lock.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
@@ -731,6 +844,7 @@ static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 			    void __user *p)
 {
+	struct ashmem_range *new_range = NULL;
 	struct ashmem_pin pin;
 	size_t pgstart, pgend;
 	int ret = -EINVAL;
@@ -738,7 +852,16 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	if (unlikely(copy_from_user(&pin, p, sizeof(pin))))
 		return -EFAULT;
 
-	mutex_lock(&ashmem_mutex);
+	/* a pin or an unpin may need one more range, which can't be allocated
+	 * under ashmem_lru_lock
+	 */
+	if (cmd == ASHMEM_PIN || cmd == ASHMEM_UNPIN) {
+		new_range = kmem_cache_zalloc(ashmem_range_cachep, GFP_KERNEL);
+		if (unlikely(!new_range))
+			return -ENOMEM;
+	}
+
+	asma_lock(asma);
 
 	if (unlikely(!asma->file))
 		goto out_unlock;
@@ -759,21 +882,107 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
+	lru_lock();
 	switch (cmd) {
 	case ASHMEM_PIN:
-		ret = ashmem_pin(asma, pgstart, pgend);
+		ret = ashmem_pin(asma, pgstart, pgend, &new_range);
 		break;
 	case ASHMEM_UNPIN:
-		ret = ashmem_unpin(asma, pgstart, pgend);
+		ret = ashmem_unpin(asma, pgstart, pgend, &new_range);
 		break;
 	case ASHMEM_GET_PIN_STATUS:
 		ret = ashmem_get_pin_status(asma, pgstart, pgend);
 		break;
 	}
+	lru_unlock();
 
 out_unlock:
-	mutex_unlock(&ashmem_mutex);
+	asma_unlock(asma);
+
+	/*
+	 * Pages the shrinker already marked purged may still be being punched
+	 * out; they must be gone before the caller writes to them again.
+	 */
+	if (cmd == ASHMEM_PIN)
+		wait_event(ashmem_purge_wait, !atomic_read(&asma->purging));
+
+	if (new_range)
+		kmem_cache_free(ashmem_range_cachep, new_range);
+
+	return ret;
+}
+
+/*
+ * ashmem_export_fd - return a new fd on the backing shmem file, which can
+ * be used like a memfd from then on: mapped, read and shared without going
+ * through ashmem. Size is sealed, and so are writes if the protection mask
+ * doesn't allow them. An exec restriction can't be expressed as a seal, so
+ * areas without PROT_EXEC can't be exported. Pinning and unpinning are
+ * still done on the ashmem fd, and purges act on the exported file too.
+ */
+static int ashmem_export_fd(struct ashmem_area *asma)
+{
+	unsigned int seals = F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW;
+	struct inode *inode;
+	struct file *file;
+	int fd, ret;
 
+	asma_lock(asma);
+
+	ret = -EINVAL;
+	if (unlikely(!asma->size))
+		goto out_unlock;
+
+	ret = -EPERM;
+	if (unlikely((asma->prot_mask & (PROT_READ | PROT_EXEC)) !=
+		     (PROT_READ | PROT_EXEC)))
+		goto out_unlock;
+	if (!(asma->prot_mask & PROT_WRITE))
+		seals |= F_SEAL_FUTURE_WRITE;
+
+	ret = ashmem_setup_file(asma, VM_NORESERVE);
+	if (ret)
+		goto out_unlock;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		ret = fd;
+		goto out_unlock;
+	}
+
+	/* a plain shmem file, unlike asma->file with its vmfile_fops */
+	file = dentry_open(&asma->file->f_path, O_RDWR | O_LARGEFILE,
+			   current_cred());
+	if (IS_ERR(file)) {
+		ret = PTR_ERR(file);
+		goto out_put_fd;
+	}
+
+	/* shmem_file_setup() files start out sealed against sealing */
+	inode = file_inode(file);
+	inode_lock(inode);
+	SHMEM_I(inode)->seals &= ~F_SEAL_SEAL;
+	inode_unlock(inode);
+
+	ret = shmem_add_seals(file, seals);
+	if (ret) {
+		inode_lock(inode);
+		SHMEM_I(inode)->seals |= F_SEAL_SEAL;
+		inode_unlock(inode);
+		fput(file);
+		goto out_put_fd;
+	}
+
+	asma->exported = true;
+	asma_unlock(asma);
+
+	fd_install(fd, file);
+	return fd;
+
+out_put_fd:
+	put_unused_fd(fd);
+out_unlock:
+	asma_unlock(asma);
 	return ret;
 }
 
@@ -791,12 +1000,12 @@ static long ashmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		break;
 	case ASHMEM_SET_SIZE:
 		ret = -EINVAL;
-		mutex_lock(&ashmem_mutex);
+		asma_lock(asma);
 		if (!asma->file) {
 			ret = 0;
 			asma->size = (size_t)arg;
 		}
-		mutex_unlock(&ashmem_mutex);
+		asma_unlock(asma);
 		break;
 	case ASHMEM_GET_SIZE:
 		ret = asma->size;
@@ -823,6 +1032,9 @@ static long ashmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ashmem_shrink_scan(&ashmem_shrinker, &sc);
 		}
 		break;
+	case ASHMEM_EXPORT_FD:
+		ret = ashmem_export_fd(asma);
+		break;
 	}
 
 	return ret;
@@ -858,6 +1070,34 @@ static const struct file_operations ashmem_fops = {
 #endif
 };
 
+static int ashmem_stats_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "lru_pages: %lu\n", READ_ONCE(lru_count));
+	seq_printf(m, "area_contended: %ld\n",
+		   atomic_long_read(&ashmem_area_contended));
+	seq_printf(m, "lru_contended: %ld\n",
+		   atomic_long_read(&ashmem_lru_contended));
+	seq_printf(m, "shrink_batches: %ld\n",
+		   atomic_long_read(&ashmem_shrink_batches));
+	seq_printf(m, "shrink_ranges: %ld\n",
+		   atomic_long_read(&ashmem_shrink_ranges));
+	seq_printf(m, "shrink_pages: %ld\n",
+		   atomic_long_read(&ashmem_shrink_pages));
+	return 0;
+}
+
+static int ashmem_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ashmem_stats_show, NULL);
+}
+
+static const struct file_operations ashmem_stats_fops = {
+	.open		= ashmem_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct miscdevice ashmem_misc = {
 	.minor = MISC_DYNAMIC_MINOR,
 	.name = "ashmem",
@@ -891,6 +1131,7 @@ static int __init ashmem_init(void)
 	}
 
 	register_shrinker(&ashmem_shrinker);
+	debugfs_create_file("ashmem", 0444, NULL, NULL, &ashmem_stats_fops);
 
 	pr_info("initialized\n");
 
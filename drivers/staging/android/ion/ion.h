@@ -26,6 +26,7 @@
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/shrinker.h>
+#include <linux/sizes.h>
 #include <linux/types.h>
 #include <linux/miscdevice.h>
 #include <linux/bitops.h>
@@ -436,6 +437,8 @@ struct ion_heap *ion_secure_carveout_heap_create(
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
  * @cached:		it's cached pool or not
+ * @pcp:		per-cpu front cache, NULL for orders too large to cache
+ * @pcp_high:		number of pages each per-cpu cache may hold
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -453,12 +456,29 @@ struct ion_page_pool {
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	struct ion_page_pool_pcp __percpu *pcp;
+	int pcp_high;
+};
+
+/*
+ * Per-cpu front cache of an ion_page_pool. Pages in it are accounted as
+ * pool pages and are drained back to the pool lists before shrinking.
+ */
+#define ION_POOL_PCP_MAX	16
+#define ION_POOL_PCP_BYTES	SZ_256K
+
+struct ion_page_pool_pcp {
+	spinlock_t lock;
+	int count;
+	struct page *pages[ION_POOL_PCP_MAX];
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 					   bool cached);
 void ion_page_pool_destroy(struct ion_page_pool *pool);
 struct page *ion_page_pool_alloc(struct ion_page_pool *a, bool *from_pool);
+int ion_page_pool_alloc_bulk(struct ion_page_pool *pool, struct page **pages,
+			     int nr);
 void ion_page_pool_free(struct ion_page_pool *pool, struct page *page);
 
 struct ion_heap *get_ion_heap(int heap_id);
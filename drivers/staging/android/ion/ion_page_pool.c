@@ -20,6 +20,7 @@
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/init.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/sched/signal.h>
@@ -46,9 +47,9 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static void ion_page_pool_list_add(struct ion_page_pool *pool,
+				   struct page *page)
 {
-	mutex_lock(&pool->mutex);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -56,10 +57,103 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
+}
 
-	nr_total_pages += 1 << pool->order;
+static void ion_page_pool_account(struct ion_page_pool *pool,
+				  struct page *page, int sign)
+{
+	nr_total_pages += sign * (1 << pool->order);
 	mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
-							1 << pool->order);
+			    sign * (1 << pool->order));
+}
+
+/*
+ * The per-cpu cache is protected by its own lock rather than by disabled
+ * preemption, so the shrinker can drain remote caches. A task migrating
+ * between picking the cache and taking the lock only costs locality.
+ */
+static bool ion_page_pool_pcp_push(struct ion_page_pool *pool,
+				   struct page *page)
+{
+	struct ion_page_pool_pcp *pcp;
+	bool ret = false;
+
+	if (!pool->pcp)
+		return false;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count < pool->pcp_high) {
+		pcp->pages[pcp->count++] = page;
+		ret = true;
+	}
+	spin_unlock(&pcp->lock);
+
+	if (ret)
+		ion_page_pool_account(pool, page, 1);
+	return ret;
+}
+
+static int ion_page_pool_pcp_pop(struct ion_page_pool *pool,
+				 struct page **pages, int nr)
+{
+	struct ion_page_pool_pcp *pcp;
+	int i;
+
+	if (!pool->pcp)
+		return 0;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	for (i = 0; i < nr && pcp->count; i++)
+		pages[i] = pcp->pages[--pcp->count];
+	spin_unlock(&pcp->lock);
+
+	return i;
+}
+
+/* Move the pages of every per-cpu cache to the pool lists */
+static void ion_page_pool_pcp_drain(struct ion_page_pool *pool)
+{
+	int cpu;
+
+	if (!pool->pcp)
+		return;
+
+	mutex_lock(&pool->mutex);
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock(&pcp->lock);
+		while (pcp->count)
+			ion_page_pool_list_add(pool,
+					       pcp->pages[--pcp->count]);
+		spin_unlock(&pcp->lock);
+	}
+	mutex_unlock(&pool->mutex);
+}
+
+static int ion_page_pool_pcp_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	if (!pool->pcp)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		count += READ_ONCE(per_cpu_ptr(pool->pcp, cpu)->count);
+
+	return count;
+}
+
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	if (ion_page_pool_pcp_push(pool, page))
+		return 0;
+
+	mutex_lock(&pool->mutex);
+	ion_page_pool_list_add(pool, page);
+	ion_page_pool_account(pool, page, 1);
 	mutex_unlock(&pool->mutex);
 	return 0;
 }
@@ -79,9 +173,7 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	}
 
 	list_del(&page->lru);
-	nr_total_pages -= 1 << pool->order;
-	mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
-							-(1 << pool->order));
+	ion_page_pool_account(pool, page, -1);
 	return page;
 }
 
@@ -94,6 +186,11 @@ struct page *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 	if (fatal_signal_pending(current))
 		return ERR_PTR(-EINTR);
 
+	if (*from_pool && ion_page_pool_pcp_pop(pool, &page, 1)) {
+		ion_page_pool_account(pool, page, -1);
+		return page;
+	}
+
 	if (*from_pool && mutex_trylock(&pool->mutex)) {
 		if (pool->high_count)
 			page = ion_page_pool_remove(pool, true);
@@ -111,6 +208,38 @@ struct page *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 	return page;
 }
 
+/**
+ * ion_page_pool_alloc_bulk - take up to @nr pages out of the pool
+ *
+ * Pages come from the local per-cpu cache first, then from the pool lists
+ * in a single hold of the pool mutex. Like ion_page_pool_alloc() this does
+ * not wait for a contended pool and never falls back to the page allocator.
+ *
+ * Returns the number of pages stored in @pages, or -EINTR.
+ */
+int ion_page_pool_alloc_bulk(struct ion_page_pool *pool, struct page **pages,
+			     int nr)
+{
+	int i, got;
+
+	if (fatal_signal_pending(current))
+		return -EINTR;
+
+	got = ion_page_pool_pcp_pop(pool, pages, nr);
+	for (i = 0; i < got; i++)
+		ion_page_pool_account(pool, pages[i], -1);
+
+	if (got < nr && mutex_trylock(&pool->mutex)) {
+		while (got < nr && pool->high_count)
+			pages[got++] = ion_page_pool_remove(pool, true);
+		while (got < nr && pool->low_count)
+			pages[got++] = ion_page_pool_remove(pool, false);
+		mutex_unlock(&pool->mutex);
+	}
+
+	return got;
+}
+
 /*
  * Tries to allocate from only the specified Pool and returns NULL otherwise
  */
@@ -121,6 +250,11 @@ struct page *ion_page_pool_alloc_pool_only(struct ion_page_pool *pool)
 	if (!pool)
 		return ERR_PTR(-EINVAL);
 
+	if (ion_page_pool_pcp_pop(pool, &page, 1)) {
+		ion_page_pool_account(pool, page, -1);
+		return page;
+	}
+
 	if (mutex_trylock(&pool->mutex)) {
 		if (pool->high_count)
 			page = ion_page_pool_remove(pool, true);
@@ -150,7 +284,7 @@ void ion_page_pool_free_immediate(struct ion_page_pool *pool, struct page *page)
 
 int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
-	int count = pool->low_count;
+	int count = pool->low_count + ion_page_pool_pcp_count(pool);
 
 	if (high)
 		count += pool->high_count;
@@ -182,6 +316,8 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
+	ion_page_pool_pcp_drain(pool);
+
 	while (freed < nr_to_scan) {
 		struct page *page;
 
@@ -206,6 +342,7 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 					   bool cached)
 {
 	struct ion_page_pool *pool = kmalloc(sizeof(*pool), GFP_KERNEL);
+	int cpu;
 
 	if (!pool)
 		return NULL;
@@ -220,11 +357,27 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 	if (cached)
 		pool->cached = true;
 
+	pool->pcp = NULL;
+	pool->pcp_high = min_t(int, ION_POOL_PCP_MAX,
+			       ION_POOL_PCP_BYTES >> (PAGE_SHIFT + order));
+	if (pool->pcp_high)
+		pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+	if (pool->pcp) {
+		for_each_possible_cpu(cpu) {
+			struct ion_page_pool_pcp *pcp =
+				per_cpu_ptr(pool->pcp, cpu);
+
+			spin_lock_init(&pcp->lock);
+			pcp->count = 0;
+		}
+	}
+
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
 
@@ -19,11 +19,15 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/highmem.h>
+#include <linux/freezer.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <uapi/linux/sched/types.h>
 #include <soc/qcom/secure_buffer.h>
 #include "ion_system_heap.h"
 #include "ion.h"
@@ -56,6 +60,165 @@ struct pages_mem {
 	u32 size;
 };
 
+#ifdef CONFIG_ION_POOL_REFILL
+/*
+ * Per-order pool targets in KB, indexed like orders[]. The refill thread
+ * tops the uncached and cached pools up to these with pre-zeroed pages.
+ */
+static unsigned int uncached_refill_kb[NUM_ORDERS];
+static unsigned int cached_refill_kb[NUM_ORDERS];
+module_param_array(uncached_refill_kb, uint, NULL, 0644);
+module_param_array(cached_refill_kb, uint, NULL, 0644);
+
+/* Don't refill for this long after the shrinker took pages from the pools */
+#define ION_REFILL_BACKOFF	(5 * HZ)
+
+static bool ion_refill_backoff(struct ion_system_heap *heap)
+{
+	return time_before(jiffies,
+			   READ_ONCE(heap->last_shrink) + ION_REFILL_BACKOFF);
+}
+
+/*
+ * Returns false if the page allocator could not provide a page without
+ * reclaim or the thread has to back off, true once the pool is full.
+ */
+static bool ion_refill_pool(struct ion_system_heap *heap,
+			    struct ion_page_pool *pool, unsigned int kb)
+{
+	struct device *dev = heap->heap.priv;
+	int target = kb >> (PAGE_SHIFT - 10);
+	gfp_t gfp = (pool->gfp_mask | __GFP_NORETRY | __GFP_NOWARN) &
+		    ~__GFP_RECLAIM;
+	struct page *page;
+
+	while (ion_page_pool_total(pool, true) < target) {
+		if (ion_refill_backoff(heap))
+			return false;
+
+		page = alloc_pages(gfp, pool->order);
+		if (!page)
+			return false;
+
+		/* Match the state of pages freed back to the pool */
+		ion_pages_sync_for_device(dev, page, PAGE_SIZE << pool->order,
+					  DMA_BIDIRECTIONAL);
+		ion_page_pool_free(pool, page);
+		cond_resched();
+	}
+
+	return true;
+}
+
+static int ion_system_heap_refill(void *data)
+{
+	struct ion_system_heap *heap = data;
+	int i;
+
+	while (true) {
+		wait_event_freezable(heap->refill_wait,
+				     atomic_read(&heap->refill_pending));
+		atomic_set(&heap->refill_pending, 0);
+
+		for (i = 0; i < NUM_ORDERS; i++) {
+			if (!ion_refill_pool(heap, heap->uncached_pools[i],
+					     READ_ONCE(uncached_refill_kb[i])))
+				break;
+			if (!ion_refill_pool(heap, heap->cached_pools[i],
+					     READ_ONCE(cached_refill_kb[i])))
+				break;
+		}
+	}
+
+	return 0;
+}
+
+static void ion_system_heap_refill_kick(struct ion_system_heap *heap)
+{
+	if (!heap->refill_task)
+		return;
+
+	atomic_set(&heap->refill_pending, 1);
+	wake_up(&heap->refill_wait);
+}
+
+static void ion_system_heap_refill_init(struct ion_system_heap *heap)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	init_waitqueue_head(&heap->refill_wait);
+	atomic_set(&heap->refill_pending, 0);
+	heap->last_shrink = jiffies - ION_REFILL_BACKOFF;
+	heap->refill_task = kthread_run(ion_system_heap_refill, heap,
+					"ion_pool_refill");
+	if (IS_ERR(heap->refill_task)) {
+		pr_err("%s: creating thread for pool refill failed\n",
+		       __func__);
+		heap->refill_task = NULL;
+		return;
+	}
+	sched_setscheduler(heap->refill_task, SCHED_IDLE, &param);
+}
+#else
+static inline void ion_system_heap_refill_kick(struct ion_system_heap *heap)
+{
+}
+
+static inline void ion_system_heap_refill_init(struct ion_system_heap *heap)
+{
+}
+#endif
+
+/*
+ * Pool pages of one order taken in bulk by ion_system_heap_allocate() and
+ * handed out one at a time, so a large buffer takes the pool mutex once
+ * per ION_POOL_BATCH pages rather than once per page.
+ */
+#define ION_POOL_BATCH	16
+
+struct pool_batch {
+	struct ion_page_pool *pool;
+	struct page *pages[ION_POOL_BATCH];
+	int nr;
+	bool dry;
+};
+
+static struct page *pool_batch_get(struct pool_batch *batch,
+				   struct ion_page_pool *pool,
+				   unsigned long size, unsigned long order)
+{
+	int want, ret;
+
+	if (!batch->nr && !batch->dry) {
+		want = clamp_t(unsigned long, size >> (PAGE_SHIFT + order),
+			       1, ION_POOL_BATCH);
+		ret = ion_page_pool_alloc_bulk(pool, batch->pages, want);
+		if (ret < 0)
+			return ERR_PTR(ret);
+		batch->pool = pool;
+		batch->nr = ret;
+		/* Don't retry a pool that was empty or contended */
+		batch->dry = ret < want;
+	}
+
+	if (!batch->nr)
+		return NULL;
+
+	return batch->pages[--batch->nr];
+}
+
+/* Return the pages left over in the batches to their pools */
+static void pool_batch_release(struct pool_batch *batches)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		while (batches[i].nr)
+			ion_page_pool_free(batches[i].pool,
+				batches[i].pages[--batches[i].nr]);
+	}
+}
+
 int ion_heap_is_system_heap_type(enum ion_heap_type type)
 {
 	return type == ((enum ion_heap_type)ION_HEAP_TYPE_SYSTEM);
@@ -64,7 +227,9 @@ int ion_heap_is_system_heap_type(enum ion_heap_type type)
 static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 				      struct ion_buffer *buffer,
 				      unsigned long order,
-				      bool *from_pool)
+				      bool *from_pool,
+				      struct pool_batch *batch,
+				      unsigned long size)
 {
 	bool cached = ion_buffer_cached(buffer);
 	struct page *page;
@@ -79,7 +244,17 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 	else
 		pool = heap->cached_pools[order_to_index(order)];
 
-	page = ion_page_pool_alloc(pool, from_pool);
+	page = NULL;
+	if (batch && *from_pool) {
+		page = pool_batch_get(batch, pool, size, order);
+		if (IS_ERR(page))
+			return page;
+		if (!page)
+			*from_pool = false;
+	}
+
+	if (!page)
+		page = ion_page_pool_alloc(pool, from_pool);
 
 	if (IS_ERR(page))
 		return page;
@@ -129,7 +304,8 @@ void free_buffer_page(struct ion_system_heap *heap,
 static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 						 struct ion_buffer *buffer,
 						 unsigned long size,
-						 unsigned int max_order)
+						 unsigned int max_order,
+						 struct pool_batch *batches)
 {
 	struct page *page;
 	struct page_info *info;
@@ -146,7 +322,8 @@ static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 		if (max_order < orders[i])
 			continue;
 		from_pool = !(buffer->flags & ION_FLAG_POOL_FORCE_ALLOC);
-		page = alloc_buffer_page(heap, buffer, orders[i], &from_pool);
+		page = alloc_buffer_page(heap, buffer, orders[i], &from_pool,
+					 batches ? &batches[i] : NULL, size);
 		if (IS_ERR(page))
 			continue;
 
@@ -163,7 +340,8 @@ static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 
 static struct page_info *alloc_from_pool_preferred(
 		struct ion_system_heap *heap, struct ion_buffer *buffer,
-		unsigned long size, unsigned int max_order)
+		unsigned long size, unsigned int max_order,
+		struct pool_batch *batches)
 {
 	struct page *page;
 	struct page_info *info;
@@ -204,7 +382,7 @@ static struct page_info *alloc_from_pool_preferred(
 
 	kfree(info);
 force_alloc:
-	return alloc_largest_available(heap, buffer, size, max_order);
+	return alloc_largest_available(heap, buffer, size, max_order, batches);
 }
 
 static unsigned int process_info(struct page_info *info,
@@ -290,6 +468,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	struct pages_mem data;
 	unsigned int sz;
 	int vmid = get_secure_vmid(buffer->flags);
+	struct pool_batch batches[NUM_ORDERS] = {};
 
 	if (size / PAGE_SIZE > totalram_pages / 2)
 		return -ENOMEM;
@@ -309,11 +488,11 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 		if (is_secure_vmid_valid(vmid))
 			info = alloc_from_pool_preferred(
 					sys_heap, buffer, size_remaining,
-					max_order);
+					max_order, batches);
 		else
 			info = alloc_largest_available(
 					sys_heap, buffer, size_remaining,
-					max_order);
+					max_order, batches);
 
 		if (IS_ERR(info)) {
 			ret = PTR_ERR(info);
@@ -337,6 +516,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 		max_order = info->order;
 		i++;
 	}
+	pool_batch_release(batches);
 
 	ret = ion_heap_alloc_pages_mem(&data);
 
@@ -402,6 +582,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	if (nents_sync)
 		sg_free_table(&table_sync);
 	ion_heap_free_pages_mem(&data);
+	ion_system_heap_refill_kick(sys_heap);
 	return 0;
 
 err_free_sg2:
@@ -425,6 +606,7 @@ err1:
 err_free_data_pages:
 	ion_heap_free_pages_mem(&data);
 err:
+	pool_batch_release(batches);
 	list_for_each_entry_safe(info, tmp_info, &pages, list) {
 		free_buffer_page(sys_heap, buffer, info->page, info->order);
 		kfree(info);
@@ -476,6 +658,10 @@ static int ion_system_heap_shrink(struct ion_heap *heap, gfp_t gfp_mask,
 
 	if (!nr_to_scan)
 		only_scan = 1;
+#ifdef CONFIG_ION_POOL_REFILL
+	else
+		WRITE_ONCE(sys_heap->last_shrink, jiffies);
+#endif
 
 	for (i = 0; i < NUM_ORDERS; i++) {
 		nr_freed = 0;
@@ -677,6 +863,7 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *data)
 		goto destroy_uncached_pools;
 
 	mutex_init(&heap->split_page_mutex);
+	ion_system_heap_refill_init(heap);
 
 	heap->heap.debug_show = ion_system_heap_debug_show;
 	return &heap->heap;
@@ -34,6 +34,12 @@ struct ion_system_heap {
 	struct ion_page_pool *secure_pools[VMID_LAST][MAX_ORDER];
 	/* Prevents unnecessary page splitting */
 	struct mutex split_page_mutex;
+#ifdef CONFIG_ION_POOL_REFILL
+	struct task_struct *refill_task;
+	wait_queue_head_t refill_wait;
+	atomic_t refill_pending;
+	unsigned long last_shrink;
+#endif
 };
 
 struct page_info {
@@ -44,5 +44,7 @@ struct ashmem_pin {
 #define ASHMEM_UNPIN		_IOW(__ASHMEMIOC, 8, struct ashmem_pin)
 #define ASHMEM_GET_PIN_STATUS	_IO(__ASHMEMIOC, 9)
 #define ASHMEM_PURGE_ALL_CACHES	_IO(__ASHMEMIOC, 10)
+/* Returns a sealed shmem fd on the region, see ashmem_export_fd() */
+#define ASHMEM_EXPORT_FD	_IO(__ASHMEMIOC, 11)
 
 #endif	/* _UAPI_LINUX_ASHMEM_H */
@@ -32,11 +32,15 @@
 #include <linux/cpu.h>
 #include <linux/cpu_cooling.h>
 #include <linux/sched.h>
+#include <linux/sched/energy.h>
 #include <linux/of_device.h>
 #include <linux/suspend.h>
+#include <linux/workqueue.h>
 
 #include <trace/events/thermal.h>
 
+#include "thermal_core.h"
+
 /*
  * Cooling state <-> CPUFreq frequency
  *
@@ -98,6 +102,14 @@ struct time_in_idle {
  * @node: list_head to link all cpufreq_cooling_device together.
  * @idle_time: idle time stats
  * @plat_get_static_power: callback to calculate the static power
+ * @predict: whether the sustainable frequency ceiling is being predicted
+ * @predict_state: cooling state of the predicted ceiling
+ * @predict_temp: temperature at the last prediction, in millicelsius
+ * @predict_slope: filtered temperature slope, in millicelsius per second
+ * @predict_ts: time of the last prediction
+ * @predict_idle: idle time stats of the prediction
+ * @sustainable_power: predicted power the cpus can sustain, in mW
+ * @predict_work: periodic prediction
  *
  * This structure is required for keeping information of each registered
  * cpufreq_cooling_device.
@@ -118,6 +130,14 @@ struct cpufreq_cooling_device {
 	struct time_in_idle *idle_time;
 	get_static_t plat_get_static_power;
 	struct cpu_cooling_ops *plat_ops;
+	bool predict;
+	unsigned int predict_state;
+	int predict_temp;
+	int predict_slope;
+	ktime_t predict_ts;
+	struct time_in_idle *predict_idle;
+	u32 sustainable_power;
+	struct delayed_work predict_work;
 };
 
 static atomic_t in_suspend;
@@ -134,6 +154,32 @@ static LIST_HEAD(cpufreq_cdev_list);
 static struct cpumask cpus_in_max_cooling_level;
 static BLOCKING_NOTIFIER_HEAD(cpu_max_cooling_level_notifer);
 
+/*
+ * Predictive mode: close to the first trip of the zone the cpus cool,
+ * the power they can sustain is estimated from the energy model and the
+ * temperature slope, aiming to reach the trip no faster than
+ * predict_horizon_ms. The frequency ceiling follows it one level per
+ * predict_ms so the trip is approached smoothly instead of being hit and
+ * clamped hard.
+ */
+static DEFINE_MUTEX(predict_lock);
+
+static uint predict_ms = 100;
+module_param(predict_ms, uint, 0644);
+
+static uint predict_idle_ms = 1000;
+module_param(predict_idle_ms, uint, 0644);
+
+static uint predict_window_mc = 10000;
+module_param(predict_window_mc, uint, 0644);
+
+static uint predict_horizon_ms = 5000;
+module_param(predict_horizon_ms, uint, 0644);
+
+/* mW of power per degree celsius per second of temperature slope */
+static uint predict_gain = 2000;
+module_param(predict_gain, uint, 0644);
+
 void cpu_cooling_max_level_notifier_register(struct notifier_block *n)
 {
 	blocking_notifier_chain_register(&cpu_max_cooling_level_notifer, n);
@@ -448,12 +494,10 @@ static u32 cpu_power_to_freq(struct cpufreq_cooling_device *cpufreq_cdev,
  * Return: The average load of cpu @cpu in percentage since this
  * function was last called.
  */
-static u32 get_load(struct cpufreq_cooling_device *cpufreq_cdev, int cpu,
-		    int cpu_idx)
+static u32 __get_load(struct time_in_idle *idle_time, int cpu)
 {
 	u32 load;
 	u64 now, now_idle, delta_time, delta_idle;
-	struct time_in_idle *idle_time = &cpufreq_cdev->idle_time[cpu_idx];
 
 	now_idle = get_cpu_idle_time(cpu, &now, 0);
 	delta_idle = now_idle - idle_time->time;
@@ -470,6 +514,12 @@ static u32 get_load(struct cpufreq_cooling_device *cpufreq_cdev, int cpu,
 	return load;
 }
 
+static u32 get_load(struct cpufreq_cooling_device *cpufreq_cdev, int cpu,
+		    int cpu_idx)
+{
+	return __get_load(&cpufreq_cdev->idle_time[cpu_idx], cpu);
+}
+
 /**
  * get_static_power() - calculate the static power consumed by the cpus
  * @cpufreq_cdev:	struct &cpufreq_cooling_device for this cpu cdev
@@ -652,6 +702,32 @@ static int cpufreq_get_cur_state(struct thermal_cooling_device *cdev,
 	return 0;
 }
 
+/*
+ * Clip to the lower of the frequency asked by the thermal governor and the
+ * predicted sustainable one.
+ */
+static void cpufreq_cooling_apply(struct cpufreq_cooling_device *cpufreq_cdev,
+				  int cpu)
+{
+	unsigned int state, clip_freq;
+
+	state = max(cpufreq_cdev->cpufreq_state, cpufreq_cdev->predict_state);
+	clip_freq = cpufreq_cdev->freq_table[state].frequency;
+	cpufreq_cdev->clipped_freq = clip_freq;
+
+	/* Check if the device has a platform mitigation function that
+	 * can handle the CPU freq mitigation, if not, notify cpufreq
+	 * framework.
+	 */
+	if (cpufreq_cdev->plat_ops) {
+		if (cpufreq_cdev->plat_ops->ceil_limit)
+			cpufreq_cdev->plat_ops->ceil_limit(cpu,
+						clip_freq);
+	} else {
+		cpufreq_update_policy(cpu);
+	}
+}
+
 /**
  * cpufreq_set_cur_state - callback function to set the current cooling state.
  * @cdev: thermal cooling device pointer.
@@ -666,7 +742,6 @@ static int cpufreq_set_cur_state(struct thermal_cooling_device *cdev,
 				 unsigned long state)
 {
 	struct cpufreq_cooling_device *cpufreq_cdev = cdev->devdata;
-	unsigned int clip_freq;
 	unsigned long prev_state;
 	struct device *cpu_dev;
 	int ret = 0;
@@ -716,21 +791,8 @@ static int cpufreq_set_cur_state(struct thermal_cooling_device *cdev,
 					     0, (void *)(long)cpu);
 	}
 update_frequency:
-	clip_freq = cpufreq_cdev->freq_table[state].frequency;
 	cpufreq_cdev->cpufreq_state = state;
-	cpufreq_cdev->clipped_freq = clip_freq;
-
-	/* Check if the device has a platform mitigation function that
-	 * can handle the CPU freq mitigation, if not, notify cpufreq
-	 * framework.
-	 */
-	if (cpufreq_cdev->plat_ops) {
-		if (cpufreq_cdev->plat_ops->ceil_limit)
-			cpufreq_cdev->plat_ops->ceil_limit(cpu,
-						clip_freq);
-	} else {
-		cpufreq_update_policy(cpu);
-	}
+	cpufreq_cooling_apply(cpufreq_cdev, cpu);
 
 	return 0;
 }
@@ -901,6 +963,222 @@ static int cpufreq_power2state(struct thermal_cooling_device *cdev,
 	return 0;
 }
 
+static struct thermal_cooling_device_ops cpufreq_power_cooling_ops;
+
+/*
+ * Busy power of one cpu at @freq, from the scheduler energy model if there
+ * is one, else from the power table built from the dynamic coefficient.
+ */
+static u32
+cpufreq_predict_cpu_power(struct cpufreq_cooling_device *cpufreq_cdev,
+			  unsigned int freq)
+{
+	int cpu = cpufreq_cdev->policy->cpu;
+	struct sched_group_energy *sge = sge_array[cpu][SD_LEVEL0];
+	int i;
+
+	if (sge && sge->nr_cap_states) {
+		for (i = 0; i < sge->nr_cap_states - 1; i++)
+			if (sge->cap_states[i].frequency >= freq)
+				break;
+		return sge->cap_states[i].power;
+	}
+
+	if (cpufreq_cdev->cdev->ops == &cpufreq_power_cooling_ops)
+		return cpu_freq_to_power(cpufreq_cdev, freq);
+
+	return 0;
+}
+
+/* The zone and trip temperature of the lowest trip the cpus are bound to */
+static struct thermal_zone_device *
+cpufreq_predict_zone(struct cpufreq_cooling_device *cpufreq_cdev,
+		     int *trip_temp)
+{
+	struct thermal_cooling_device *cdev = cpufreq_cdev->cdev;
+	struct thermal_zone_device *tz = NULL;
+	struct thermal_instance *instance;
+	int temp;
+
+	mutex_lock(&cdev->lock);
+	list_for_each_entry(instance, &cdev->thermal_instances, cdev_node) {
+		if (!instance->tz->ops->get_trip_temp ||
+		    instance->tz->ops->get_trip_temp(instance->tz,
+						     instance->trip, &temp))
+			continue;
+		if (!tz || temp < *trip_temp) {
+			tz = instance->tz;
+			*trip_temp = temp;
+		}
+	}
+	mutex_unlock(&cdev->lock);
+
+	return tz;
+}
+
+static void cpufreq_predict_work(struct work_struct *work)
+{
+	struct cpufreq_cooling_device *cpufreq_cdev = container_of(work,
+			struct cpufreq_cooling_device, predict_work.work);
+	struct cpufreq_policy *policy = cpufreq_cdev->policy;
+	struct freq_table *freq_table = cpufreq_cdev->freq_table;
+	unsigned long delay = msecs_to_jiffies(predict_idle_ms);
+	struct thermal_zone_device *tz;
+	unsigned int target = 0, total_load = 0, online = 0, state;
+	int cpu, i = 0, temp, trip_temp, slope, target_slope;
+	s64 power, power_max, sustainable, dt_ms;
+	ktime_t now = ktime_get();
+
+	tz = cpufreq_predict_zone(cpufreq_cdev, &trip_temp);
+	if (!tz || thermal_zone_get_temp(tz, &temp))
+		goto resched;
+
+	dt_ms = ktime_ms_delta(now, cpufreq_cdev->predict_ts);
+	if (cpufreq_cdev->predict_ts && dt_ms > 0) {
+		slope = div64_s64((s64)(temp - cpufreq_cdev->predict_temp) *
+				  MSEC_PER_SEC, dt_ms);
+		cpufreq_cdev->predict_slope =
+			(3 * cpufreq_cdev->predict_slope + slope) / 4;
+	}
+	cpufreq_cdev->predict_temp = temp;
+	cpufreq_cdev->predict_ts = now;
+
+	for_each_cpu(cpu, policy->related_cpus) {
+		if (cpu_online(cpu)) {
+			total_load += __get_load(&cpufreq_cdev->predict_idle[i],
+						 cpu);
+			online++;
+		}
+		i++;
+	}
+
+	power_max = (s64)cpufreq_predict_cpu_power(cpufreq_cdev,
+				freq_table[0].frequency) * online;
+	if (!power_max || temp < trip_temp - (int)predict_window_mc) {
+		cpufreq_cdev->sustainable_power = power_max;
+		goto update;
+	}
+	delay = msecs_to_jiffies(predict_ms);
+
+	power = div_s64((s64)cpufreq_predict_cpu_power(cpufreq_cdev,
+			cpufreq_quick_get(policy->cpu)) * total_load, 100);
+	target_slope = div_s64((s64)(trip_temp - temp) * MSEC_PER_SEC,
+			       predict_horizon_ms ?: 1);
+	sustainable = power + div_s64((s64)predict_gain *
+			(target_slope - cpufreq_cdev->predict_slope), 1000);
+	sustainable = clamp_t(s64, sustainable, 0, power_max);
+	if (cpufreq_cdev->sustainable_power)
+		sustainable = div_s64(3 * (s64)cpufreq_cdev->sustainable_power +
+				      sustainable, 4);
+	cpufreq_cdev->sustainable_power = sustainable;
+
+	/* Highest frequency the current load can run at within it */
+	if (total_load) {
+		for (; target < cpufreq_cdev->max_level - 1; target++)
+			if (div_s64((s64)cpufreq_predict_cpu_power(cpufreq_cdev,
+				freq_table[target].frequency) * total_load,
+				100) <= sustainable)
+				break;
+	}
+
+update:
+	state = cpufreq_cdev->predict_state;
+	if (target > state)
+		state++;
+	else if (target < state)
+		state--;
+
+	if (state != cpufreq_cdev->predict_state) {
+		cpufreq_cdev->predict_state = state;
+		if (cpufreq_cdev->cpufreq_state != cpufreq_cdev->max_level)
+			cpufreq_cooling_apply(cpufreq_cdev,
+				(cpufreq_cdev->cpu_id == -1) ?
+				policy->cpu : cpufreq_cdev->cpu_id);
+	}
+
+resched:
+	if (READ_ONCE(cpufreq_cdev->predict))
+		queue_delayed_work(system_power_efficient_wq,
+				   &cpufreq_cdev->predict_work, delay);
+}
+
+static ssize_t predict_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct cpufreq_cooling_device *cpufreq_cdev =
+		to_cooling_device(dev)->devdata;
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", cpufreq_cdev->predict);
+}
+
+static ssize_t predict_store(struct device *dev,
+			     struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct cpufreq_cooling_device *cpufreq_cdev =
+		to_cooling_device(dev)->devdata;
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&predict_lock);
+	if (enable == cpufreq_cdev->predict)
+		goto unlock;
+
+	if (enable) {
+		if (!cpufreq_predict_cpu_power(cpufreq_cdev,
+				cpufreq_cdev->freq_table[0].frequency)) {
+			count = -EOPNOTSUPP;
+			goto unlock;
+		}
+		cpufreq_cdev->predict_ts = 0;
+		cpufreq_cdev->predict_slope = 0;
+		cpufreq_cdev->sustainable_power = 0;
+		WRITE_ONCE(cpufreq_cdev->predict, true);
+		queue_delayed_work(system_power_efficient_wq,
+				   &cpufreq_cdev->predict_work, 0);
+	} else {
+		WRITE_ONCE(cpufreq_cdev->predict, false);
+		cancel_delayed_work_sync(&cpufreq_cdev->predict_work);
+		cpufreq_cdev->predict_state = 0;
+		if (cpufreq_cdev->cpufreq_state != cpufreq_cdev->max_level)
+			cpufreq_cooling_apply(cpufreq_cdev,
+				(cpufreq_cdev->cpu_id == -1) ?
+				cpufreq_cdev->policy->cpu :
+				cpufreq_cdev->cpu_id);
+	}
+unlock:
+	mutex_unlock(&predict_lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(predict);
+
+static ssize_t sustainable_power_show(struct device *dev,
+				      struct device_attribute *attr,
+				      char *buf)
+{
+	struct cpufreq_cooling_device *cpufreq_cdev =
+		to_cooling_device(dev)->devdata;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			 cpufreq_cdev->sustainable_power);
+}
+static DEVICE_ATTR_RO(sustainable_power);
+
+static struct attribute *cpufreq_predict_attrs[] = {
+	&dev_attr_predict.attr,
+	&dev_attr_sustainable_power.attr,
+	NULL,
+};
+
+static const struct attribute_group cpufreq_predict_group = {
+	.attrs = cpufreq_predict_attrs,
+};
+
 /* Bind cpufreq callbacks to thermal cooling device ops */
 
 static struct thermal_cooling_device_ops cpufreq_cooling_ops = {
@@ -1001,13 +1279,15 @@ __cpufreq_cooling_register(struct device_node *np,
 
 	cpufreq_cdev->policy = policy;
 	num_cpus = cpumask_weight(policy->related_cpus);
-	cpufreq_cdev->idle_time = kcalloc(num_cpus,
+	cpufreq_cdev->idle_time = kcalloc(2 * num_cpus,
 					 sizeof(*cpufreq_cdev->idle_time),
 					 GFP_KERNEL);
 	if (!cpufreq_cdev->idle_time) {
 		cdev = ERR_PTR(-ENOMEM);
 		goto free_cdev;
 	}
+	cpufreq_cdev->predict_idle = cpufreq_cdev->idle_time + num_cpus;
+	INIT_DELAYED_WORK(&cpufreq_cdev->predict_work, cpufreq_predict_work);
 	cpufreq_cdev->cpu_id = -1;
 	for_each_cpu(cpu_idx, policy->related_cpus) {
 		if (np == of_cpu_device_node_get(cpu_idx)) {
@@ -1081,6 +1361,9 @@ __cpufreq_cooling_register(struct device_node *np,
 	cpufreq_cdev->cpufreq_floor_state = cpufreq_cdev->max_level;
 	cpufreq_cdev->cdev = cdev;
 
+	if (sysfs_create_group(&cdev->device.kobj, &cpufreq_predict_group))
+		dev_warn(&cdev->device, "failed to create predict attrs\n");
+
 	mutex_lock(&cooling_list_lock);
 	/* Register the notifier for first cpufreq cooling device */
 	first = list_empty(&cpufreq_cdev_list);
@@ -1286,6 +1569,12 @@ void cpufreq_cooling_unregister(struct thermal_cooling_device *cdev)
 					CPUFREQ_POLICY_NOTIFIER);
 	}
 
+	mutex_lock(&predict_lock);
+	WRITE_ONCE(cpufreq_cdev->predict, false);
+	mutex_unlock(&predict_lock);
+	cancel_delayed_work_sync(&cpufreq_cdev->predict_work);
+	sysfs_remove_group(&cdev->device.kobj, &cpufreq_predict_group);
+
 	thermal_cooling_device_unregister(cpufreq_cdev->cdev);
 	ida_simple_remove(&cpufreq_ida, cpufreq_cdev->id);
 	kfree(cpufreq_cdev->idle_time);
@@ -19,8 +19,11 @@
 /* #define VERBOSE_DEBUG */
 
 #include <linux/blkdev.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-fence.h>
 #include <linux/pagemap.h>
 #include <linux/export.h>
+#include <linux/reservation.h>
 #include <linux/hid.h>
 #include <linux/module.h>
 #include <linux/sched/signal.h>
@@ -211,6 +214,10 @@ struct ffs_epfile {
 	unsigned char			isoc;	/* P: ffs->eps_lock */
 
 	bool				invalid;
+
+	/* Attached dma-bufs, dropped on last close */
+	struct list_head		dmabufs;	/* P: dmabufs_mutex */
+	struct mutex			dmabufs_mutex;
 };
 
 struct ffs_buffer {
@@ -1319,6 +1326,402 @@ static ssize_t ffs_epfile_read_iter(struct kiocb *kiocb, struct iov_iter *to)
 	return res;
 }
 
+/* dma-buf backed I/O ******************************************************/
+
+/*
+ * A dma-buf attached to an epfile stays mapped for the gadget controller
+ * until it is detached, so that a transfer only has to queue a request on
+ * its pages. Each transfer publishes a fence in the dma-buf reservation
+ * object, signalled when the request completes: shared for an IN endpoint
+ * which only reads the buffer, exclusive for an OUT endpoint.
+ */
+struct ffs_dmabuf_priv {
+	struct list_head		entry;
+	struct kref			ref;
+	struct dma_buf_attachment	*attach;
+	struct sg_table			*sgt;
+	spinlock_t			lock;
+	u64				context;
+	unsigned int			seqno;
+};
+
+struct ffs_dma_fence {
+	struct dma_fence		base;
+	struct ffs_dmabuf_priv		*priv;
+	struct usb_ep			*ep;
+	struct usb_request		*req;
+	/* the UDC maps and unmaps its own copy of the attachment pages */
+	struct sg_table			sgt;
+	struct work_struct		work;
+};
+
+static void ffs_dmabuf_release(struct kref *ref)
+{
+	struct ffs_dmabuf_priv *priv = container_of(ref,
+					struct ffs_dmabuf_priv, ref);
+	struct dma_buf *dmabuf = priv->attach->dmabuf;
+
+	dma_buf_unmap_attachment(priv->attach, priv->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(dmabuf, priv->attach);
+	dma_buf_put(dmabuf);
+	kfree(priv);
+}
+
+static void ffs_dmabuf_put(struct ffs_dmabuf_priv *priv)
+{
+	kref_put(&priv->ref, ffs_dmabuf_release);
+}
+
+static void ffs_dmabuf_detach_all(struct ffs_epfile *epfile)
+{
+	struct ffs_dmabuf_priv *priv, *tmp;
+
+	mutex_lock(&epfile->dmabufs_mutex);
+	list_for_each_entry_safe(priv, tmp, &epfile->dmabufs, entry) {
+		list_del(&priv->entry);
+		ffs_dmabuf_put(priv);
+	}
+	mutex_unlock(&epfile->dmabufs_mutex);
+}
+
+static struct ffs_dmabuf_priv *ffs_dmabuf_find(struct ffs_epfile *epfile,
+					       struct dma_buf *dmabuf)
+{
+	struct ffs_dmabuf_priv *priv;
+
+	list_for_each_entry(priv, &epfile->dmabufs, entry)
+		if (priv->attach->dmabuf == dmabuf)
+			return priv;
+
+	return NULL;
+}
+
+static const char *ffs_dmabuf_get_driver_name(struct dma_fence *fence)
+{
+	return "functionfs";
+}
+
+static const char *ffs_dmabuf_get_timeline_name(struct dma_fence *fence)
+{
+	return "ffs-dmabuf";
+}
+
+static bool ffs_dmabuf_enable_signaling(struct dma_fence *fence)
+{
+	return true;
+}
+
+static const struct dma_fence_ops ffs_dmabuf_fence_ops = {
+	.get_driver_name	= ffs_dmabuf_get_driver_name,
+	.get_timeline_name	= ffs_dmabuf_get_timeline_name,
+	.enable_signaling	= ffs_dmabuf_enable_signaling,
+	.wait			= dma_fence_default_wait,
+};
+
+static void ffs_dmabuf_cleanup(struct work_struct *work)
+{
+	struct ffs_dma_fence *fence = container_of(work,
+					struct ffs_dma_fence, work);
+
+	usb_ep_free_request(fence->ep, fence->req);
+	sg_free_table(&fence->sgt);
+	ffs_dmabuf_put(fence->priv);
+	dma_fence_put(&fence->base);
+}
+
+static void ffs_dmabuf_signal(struct ffs_dma_fence *fence, int status)
+{
+	if (status < 0)
+		dma_fence_set_error(&fence->base, status);
+	dma_fence_signal(&fence->base);
+
+	/* Unmapping the attachment may sleep */
+	INIT_WORK(&fence->work, ffs_dmabuf_cleanup);
+	schedule_work(&fence->work);
+}
+
+static void ffs_dmabuf_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	ffs_dmabuf_signal(req->context, req->status);
+}
+
+/* Describe the first @len bytes of the attachment with the CPU pages */
+static int ffs_dmabuf_sg_copy(struct sg_table *dst, struct sg_table *src,
+			      size_t len)
+{
+	struct scatterlist *s, *d;
+	unsigned int nents = 0, i;
+	size_t left = len;
+	int ret;
+
+	for_each_sg(src->sgl, s, src->orig_nents, i) {
+		nents++;
+		if (s->length >= left)
+			break;
+		left -= s->length;
+	}
+
+	ret = sg_alloc_table(dst, nents, GFP_KERNEL);
+	if (ret)
+		return ret;
+
+	left = len;
+	d = dst->sgl;
+	for_each_sg(src->sgl, s, nents, i) {
+		sg_set_page(d, sg_page(s), min_t(size_t, s->length, left),
+			    s->offset);
+		left -= d->length;
+		d = sg_next(d);
+	}
+
+	return 0;
+}
+
+static int ffs_dmabuf_attach(struct file *file, int fd)
+{
+	struct ffs_epfile *epfile = file->private_data;
+	struct usb_gadget *gadget = epfile->ffs->gadget;
+	struct dma_buf_attachment *attach;
+	struct ffs_dmabuf_priv *priv;
+	struct dma_buf *dmabuf;
+	struct sg_table *sgt;
+	int ret;
+
+	if (!gadget)
+		return -ENODEV;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	attach = dma_buf_attach(dmabuf, gadget->dev.parent);
+	if (IS_ERR(attach)) {
+		ret = PTR_ERR(attach);
+		goto err_dmabuf_put;
+	}
+
+	sgt = dma_buf_map_attachment(attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR(sgt)) {
+		ret = PTR_ERR(sgt);
+		goto err_detach;
+	}
+
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+	if (!priv) {
+		ret = -ENOMEM;
+		goto err_unmap;
+	}
+
+	kref_init(&priv->ref);
+	spin_lock_init(&priv->lock);
+	priv->attach = attach;
+	priv->sgt = sgt;
+	priv->context = dma_fence_context_alloc(1);
+
+	mutex_lock(&epfile->dmabufs_mutex);
+	if (ffs_dmabuf_find(epfile, dmabuf)) {
+		mutex_unlock(&epfile->dmabufs_mutex);
+		kfree(priv);
+		ret = -EEXIST;
+		goto err_unmap;
+	}
+	list_add(&priv->entry, &epfile->dmabufs);
+	mutex_unlock(&epfile->dmabufs_mutex);
+
+	return 0;
+
+err_unmap:
+	dma_buf_unmap_attachment(attach, sgt, DMA_BIDIRECTIONAL);
+err_detach:
+	dma_buf_detach(dmabuf, attach);
+err_dmabuf_put:
+	dma_buf_put(dmabuf);
+
+	return ret;
+}
+
+static int ffs_dmabuf_detach(struct file *file, int fd)
+{
+	struct ffs_epfile *epfile = file->private_data;
+	struct ffs_dmabuf_priv *priv;
+	struct dma_buf *dmabuf;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	mutex_lock(&epfile->dmabufs_mutex);
+	priv = ffs_dmabuf_find(epfile, dmabuf);
+	if (priv)
+		list_del(&priv->entry);
+	mutex_unlock(&epfile->dmabufs_mutex);
+
+	dma_buf_put(dmabuf);
+	if (!priv)
+		return -EINVAL;
+
+	/* Transfers still in flight hold their own reference */
+	ffs_dmabuf_put(priv);
+
+	return 0;
+}
+
+static int ffs_dmabuf_transfer(struct file *file, struct ffs_ep *ep,
+			       const struct usb_ffs_dmabuf_transfer_req *xfer)
+{
+	struct ffs_epfile *epfile = file->private_data;
+	struct ffs_data *ffs = epfile->ffs;
+	struct usb_gadget *gadget = ffs->gadget;
+	struct reservation_object *resv;
+	struct ffs_dmabuf_priv *priv;
+	struct ffs_dma_fence *fence;
+	struct usb_request *req;
+	struct dma_buf *dmabuf;
+	unsigned int seqno;
+	long timeout;
+	bool in;
+	int ret;
+
+	if (xfer->flags)
+		return -EINVAL;
+
+	dmabuf = dma_buf_get(xfer->fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	if (!xfer->length || xfer->length > dmabuf->size) {
+		ret = -EINVAL;
+		goto err_dmabuf_put;
+	}
+
+	mutex_lock(&epfile->dmabufs_mutex);
+	priv = ffs_dmabuf_find(epfile, dmabuf);
+	if (priv)
+		kref_get(&priv->ref);
+	mutex_unlock(&epfile->dmabufs_mutex);
+	if (!priv) {
+		ret = -EINVAL;
+		goto err_dmabuf_put;
+	}
+
+	spin_lock_irq(&ffs->eps_lock);
+	in = epfile->in;
+	ret = epfile->ep != ep ? -ESHUTDOWN : 0;
+	if (!ret && epfile->isoc)
+		ret = -EINVAL;
+	spin_unlock_irq(&ffs->eps_lock);
+	if (ret)
+		goto err_priv_put;
+
+	/*
+	 * Earlier users of the buffer must be done with it: writers only
+	 * when the controller reads it, everyone when it writes it.
+	 */
+	resv = dmabuf->resv;
+	if (file->f_flags & O_NONBLOCK) {
+		if (!reservation_object_test_signaled_rcu(resv, !in)) {
+			ret = -EBUSY;
+			goto err_priv_put;
+		}
+	} else {
+		timeout = reservation_object_wait_timeout_rcu(resv, !in, true,
+						MAX_SCHEDULE_TIMEOUT);
+		if (timeout < 0) {
+			ret = timeout;
+			goto err_priv_put;
+		}
+	}
+
+	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+	if (!fence) {
+		ret = -ENOMEM;
+		goto err_priv_put;
+	}
+
+	ret = ffs_dmabuf_sg_copy(&fence->sgt, priv->sgt, xfer->length);
+	if (ret)
+		goto err_fence_free;
+
+	/* Without SG support the pages have to be contiguous */
+	if (!gadget->sg_supported && fence->sgt.nents > 1) {
+		ret = -EOPNOTSUPP;
+		goto err_sg_free;
+	}
+
+	req = usb_ep_alloc_request(ep->ep, GFP_KERNEL);
+	if (!req) {
+		ret = -ENOMEM;
+		goto err_sg_free;
+	}
+
+	if (gadget->sg_supported) {
+		req->buf = NULL;
+		req->sg = fence->sgt.sgl;
+		req->num_sgs = fence->sgt.nents;
+	} else {
+		req->buf = sg_virt(fence->sgt.sgl);
+	}
+	req->length = xfer->length;
+	req->context = fence;
+	req->complete = ffs_dmabuf_complete;
+
+	fence->priv = priv;
+	fence->ep = ep->ep;
+	fence->req = req;
+
+	spin_lock_irq(&priv->lock);
+	seqno = ++priv->seqno;
+	spin_unlock_irq(&priv->lock);
+	dma_fence_init(&fence->base, &ffs_dmabuf_fence_ops, &priv->lock,
+		       priv->context, seqno);
+
+	ww_mutex_lock(&resv->lock, NULL);
+	if (in) {
+		ret = reservation_object_reserve_shared(resv);
+		if (!ret)
+			reservation_object_add_shared_fence(resv,
+							    &fence->base);
+	} else {
+		reservation_object_add_excl_fence(resv, &fence->base);
+	}
+	ww_mutex_unlock(&resv->lock);
+	if (ret) {
+		usb_ep_free_request(ep->ep, req);
+		sg_free_table(&fence->sgt);
+		ffs_dmabuf_put(priv);
+		dma_fence_put(&fence->base);
+		goto err_dmabuf_put;
+	}
+
+	spin_lock_irq(&ffs->eps_lock);
+	/* In the meantime, endpoint got disabled or changed. */
+	ret = epfile->ep != ep ? -ESHUTDOWN :
+		usb_ep_queue(ep->ep, req, GFP_ATOMIC);
+	spin_unlock_irq(&ffs->eps_lock);
+
+	ffs_log("queued %llu bytes on %s ret %d", xfer->length, epfile->name,
+		ret);
+
+	/* The fence is published, fail it rather than drop it */
+	if (ret)
+		ffs_dmabuf_signal(fence, ret);
+
+	dma_buf_put(dmabuf);
+
+	return ret;
+
+err_sg_free:
+	sg_free_table(&fence->sgt);
+err_fence_free:
+	kfree(fence);
+err_priv_put:
+	ffs_dmabuf_put(priv);
+err_dmabuf_put:
+	dma_buf_put(dmabuf);
+
+	return ret;
+}
+
 static int
 ffs_epfile_release(struct inode *inode, struct file *file)
 {
@@ -1332,8 +1735,10 @@ ffs_epfile_release(struct inode *inode, struct file *file)
 		epfile->name, epfile->ffs->state, epfile->ffs->setup_state,
 		epfile->ffs->flags, atomic_read(&epfile->opened));
 
-	if (atomic_dec_and_test(&epfile->opened))
+	if (atomic_dec_and_test(&epfile->opened)) {
 		epfile->invalid = false;
+		ffs_dmabuf_detach_all(epfile);
+	}
 
 	ffs_data_closed(epfile->ffs);
 
@@ -1357,6 +1762,21 @@ static long ffs_epfile_ioctl(struct file *file, unsigned code,
 	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE))
 		return -ENODEV;
 
+	switch (code) {
+	case FUNCTIONFS_DMABUF_ATTACH:
+	case FUNCTIONFS_DMABUF_DETACH:
+	{
+		int fd;
+
+		if (get_user(fd, (int __user *)value))
+			return -EFAULT;
+
+		return code == FUNCTIONFS_DMABUF_ATTACH ?
+			ffs_dmabuf_attach(file, fd) :
+			ffs_dmabuf_detach(file, fd);
+	}
+	}
+
 	/* Wait for endpoint to be enabled */
 	ep = epfile->ep;
 	if (!ep) {
@@ -1373,6 +1793,15 @@ static long ffs_epfile_ioctl(struct file *file, unsigned code,
 			return -EINTR;
 	}
 
+	if (code == FUNCTIONFS_DMABUF_TRANSFER) {
+		struct usb_ffs_dmabuf_transfer_req xfer;
+
+		if (copy_from_user(&xfer, (void __user *)value, sizeof(xfer)))
+			return -EFAULT;
+
+		return ffs_dmabuf_transfer(file, ep, &xfer);
+	}
+
 	spin_lock_irq(&epfile->ffs->eps_lock);
 
 	/* In the meantime, endpoint got disabled or changed. */
@@ -2014,6 +2443,8 @@ static int ffs_epfiles_create(struct ffs_data *ffs)
 	for (i = 1; i <= count; ++i, ++epfile) {
 		epfile->ffs = ffs;
 		mutex_init(&epfile->mutex);
+		INIT_LIST_HEAD(&epfile->dmabufs);
+		mutex_init(&epfile->dmabufs_mutex);
 		if (ffs->user_flags & FUNCTIONFS_VIRTUAL_ADDR)
 			sprintf(epfile->name, "ep%02x", ffs->eps_addrmap[i]);
 		else
@@ -74,7 +74,10 @@
 
 /* number of tx and rx requests to allocate */
 #define MTP_TX_REQ_MAX 8
-#define RX_REQ_MAX 2
+/* OUT requests kept in flight while the previous ones are written out */
+#define MTP_RX_REQ_MIN 2
+#define MTP_RX_REQ_MAX 16
+#define MTP_RX_REQ_DEFAULT 4
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -102,6 +105,15 @@ module_param(mtp_tx_req_len, uint, 0644);
 unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
 module_param(mtp_tx_reqs, uint, 0644);
 
+unsigned int mtp_rx_reqs = MTP_RX_REQ_DEFAULT;
+module_param(mtp_rx_reqs, uint, 0644);
+
+enum {
+	MTP_STATS_SEND,
+	MTP_STATS_RECEIVE,
+	MTP_STATS_MAX,
+};
+
 static const char mtp_shortname[] = DRIVER_NAME "_usb";
 
 struct mtp_dev {
@@ -125,7 +137,9 @@ struct mtp_dev {
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req[RX_REQ_MAX];
+	struct usb_request *rx_req[MTP_RX_REQ_MAX];
+	int nr_rx_reqs;
+	/* OUT requests completed since it was last cleared */
 	int rx_done;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
@@ -149,6 +163,15 @@ struct mtp_dev {
 	} perf[MAX_ITERATION];
 	unsigned int dbg_read_index;
 	unsigned int dbg_write_index;
+	/* file transfer totals since the stats were last reset */
+	struct {
+		u64 bytes;
+		u64 time_us;
+		u64 vfs_us;
+		u64 usb_us;
+		unsigned int files;
+		unsigned int last_kbps;
+	} xfer_stats[MTP_STATS_MAX];
 	struct mutex  read_mutex;
 };
 
@@ -485,7 +508,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	dev->rx_done++;
 	if (req->status != 0 && dev->state != STATE_OFFLINE)
 		dev->state = STATE_ERROR;
 
@@ -568,7 +591,9 @@ retry_tx_alloc:
 		mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
 
 retry_rx_alloc:
-	for (i = 0; i < RX_REQ_MAX; i++) {
+	dev->nr_rx_reqs = clamp_t(unsigned int, mtp_rx_reqs, MTP_RX_REQ_MIN,
+				  MTP_RX_REQ_MAX);
+	for (i = 0; i < dev->nr_rx_reqs; i++) {
 		req = mtp_request_new(dev->ep_out, mtp_rx_req_len);
 		if (!req) {
 			if (mtp_rx_req_len <= MTP_BULK_BUFFER_SIZE)
@@ -802,7 +827,27 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
-/* read from a local file and write to USB */
+static void mtp_xfer_stats_add(struct mtp_dev *dev, int dir, u64 bytes,
+		ktime_t start, u64 vfs_us, u64 usb_us)
+{
+	u64 time_us = ktime_us_delta(ktime_get(), start);
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	dev->xfer_stats[dir].bytes += bytes;
+	dev->xfer_stats[dir].time_us += time_us;
+	dev->xfer_stats[dir].vfs_us += vfs_us;
+	dev->xfer_stats[dir].usb_us += usb_us;
+	dev->xfer_stats[dir].files++;
+	dev->xfer_stats[dir].last_kbps = time_us ?
+		div64_u64(bytes * USEC_PER_SEC, time_us * 1024) : 0;
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+/*
+ * read from a local file and write to USB, with up to mtp_tx_reqs
+ * requests in flight while the next ones are read
+ */
 static void send_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
@@ -815,7 +860,9 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
-	ktime_t start_time;
+	ktime_t start_time, xfer_start;
+	u64 vfs_us = 0, usb_us = 0, bytes = 0;
+	unsigned long ra_pages;
 
 	/* read our parameters */
 	smp_rmb();
@@ -830,6 +877,14 @@ static void send_file_work(struct work_struct *data)
 
 	mtp_log("(%lld %lld)\n", offset, count);
 
+	/* keep storage reading ahead of the requests being sent */
+	ra_pages = (2 * mtp_tx_req_len) >> PAGE_SHIFT;
+	spin_lock(&filp->f_lock);
+	if (filp->f_ra.ra_pages < ra_pages)
+		filp->f_ra.ra_pages = ra_pages;
+	spin_unlock(&filp->f_lock);
+	xfer_start = ktime_get();
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -850,9 +905,11 @@ static void send_file_work(struct work_struct *data)
 
 		/* get an idle tx request to use */
 		req = 0;
+		start_time = ktime_get();
 		ret = wait_event_interruptible(dev->write_wq,
 			(req = mtp_req_get(dev, &dev->tx_idle))
 			|| dev->state != STATE_BUSY);
+		usb_us += ktime_us_delta(ktime_get(), start_time);
 		if (dev->state == STATE_CANCELED) {
 			r = -ECANCELED;
 			break;
@@ -894,6 +951,7 @@ static void send_file_work(struct work_struct *data)
 		xfer = ret + hdr_size;
 		dev->perf[dev->dbg_read_index].vfs_rtime =
 			ktime_to_us(ktime_sub(ktime_get(), start_time));
+		vfs_us += dev->perf[dev->dbg_read_index].vfs_rtime;
 		dev->perf[dev->dbg_read_index].vfs_rbytes = xfer;
 		dev->dbg_read_index = (dev->dbg_read_index + 1) % MAX_ITERATION;
 		hdr_size = 0;
@@ -909,6 +967,7 @@ static void send_file_work(struct work_struct *data)
 		}
 
 		count -= xfer;
+		bytes += xfer;
 
 		/* zero this so we don't try to free it on error exit */
 		req = 0;
@@ -917,24 +976,33 @@ static void send_file_work(struct work_struct *data)
 	if (req)
 		mtp_req_put(dev, &dev->tx_idle, req);
 
+	if (!r)
+		mtp_xfer_stats_add(dev, MTP_STATS_SEND, bytes, xfer_start,
+				   vfs_us, usb_us);
+
 	mtp_log("returning %d state:%d\n", r, dev->state);
 	/* write the result */
 	dev->xfer_result = r;
 	smp_wmb();
 }
 
-/* read from USB and write to a local file */
+/*
+ * read from USB and write to a local file, with up to nr_rx_reqs reads
+ * in flight while the completed ones are written out
+ */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, to_queue;
+	int ret, head = 0, tail = 0, inflight = 0, max_inflight, done = 0;
 	int r = 0;
-	ktime_t start_time;
+	bool eof = false;
+	ktime_t start_time, xfer_start;
+	u64 vfs_us = 0, usb_us = 0, bytes = 0;
 
 	/* read our parameters */
 	smp_rmb();
@@ -951,92 +1019,112 @@ static void receive_file_work(struct work_struct *data)
 	if (!IS_ALIGNED(count, dev->ep_out->maxpacket))
 		mtp_log("- count(%lld) not multiple of mtu(%d)\n",
 						count, dev->ep_out->maxpacket);
+
+	/*
+	 * if xfer_file_length is 0xFFFFFFFF, then we read until we get a
+	 * short packet, and a read queued past it would take the next
+	 * command: keep a single read in flight
+	 */
+	max_inflight = (count == 0xFFFFFFFF) ? 1 : dev->nr_rx_reqs;
+	to_queue = count;
+
 	mutex_lock(&dev->read_mutex);
 	if (dev->state == STATE_OFFLINE) {
 		r = -EIO;
 		goto fail;
 	}
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	dev->rx_done = 0;
+	xfer_start = ktime_get();
+	while (!eof && (to_queue > 0 || inflight)) {
+		/* keep the reads queued ahead of the writes */
+		while (to_queue > 0 && inflight < max_inflight) {
+			req = dev->rx_req[tail];
 
 			/* some h/w expects size to be aligned to ep's MTU */
-			read_req->length = mtp_rx_req_len;
+			req->length = mtp_rx_req_len;
 
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				if (dev->state != STATE_OFFLINE)
 					dev->state = STATE_ERROR;
-				break;
+				goto cancel;
 			}
+			tail = (tail + 1) % dev->nr_rx_reqs;
+			inflight++;
+			if (count != 0xFFFFFFFF)
+				to_queue -= min_t(int64_t, to_queue,
+						  mtp_rx_req_len);
 		}
 
-		if (write_req) {
-			mtp_log("rx %pK %d\n", write_req, write_req->actual);
-			start_time = ktime_get();
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			mtp_log("vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
+		/* reads complete in the order they were queued */
+		req = dev->rx_req[head];
+		start_time = ktime_get();
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done > done || dev->state != STATE_BUSY);
+		usb_us += ktime_us_delta(ktime_get(), start_time);
+		if (dev->state == STATE_CANCELED
+				|| dev->state == STATE_OFFLINE) {
+			if (dev->state == STATE_OFFLINE)
 				r = -EIO;
-				if (dev->state != STATE_OFFLINE)
-					dev->state = STATE_ERROR;
-				if (read_req && !dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			dev->perf[dev->dbg_write_index].vfs_wtime =
-				ktime_to_us(ktime_sub(ktime_get(), start_time));
-			dev->perf[dev->dbg_write_index].vfs_wbytes = ret;
-			dev->dbg_write_index =
-				(dev->dbg_write_index + 1) % MAX_ITERATION;
-			write_req = NULL;
+			else
+				r = -ECANCELED;
+			goto cancel;
+		}
+		if (dev->rx_done <= done) {
+			r = ret ? ret : -EIO;
+			goto cancel;
+		}
+		done++;
+		inflight--;
+		head = (head + 1) % dev->nr_rx_reqs;
+		if (req->status) {
+			r = req->status;
+			goto cancel;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED
-					|| dev->state == STATE_OFFLINE) {
-				if (dev->state == STATE_OFFLINE)
-					r = -EIO;
-				else
-					r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			if (read_req->status) {
-				r = read_req->status;
-				break;
-			}
-
-			/* Check if we aligned the size due to MTU constraint */
-			if (count < read_req->length)
-				read_req->actual = (read_req->actual > count ?
-						count : read_req->actual);
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+		/* Check if we aligned the size due to MTU constraint */
+		if (count < req->length)
+			req->actual = (req->actual > count ?
+					count : req->actual);
+		if (count != 0xFFFFFFFF)
+			count -= req->actual;
+		if (req->actual < req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				mtp_log("got short packet\n");
-				count = 0;
-			}
+			mtp_log("got short packet\n");
+			count = 0;
+			eof = true;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		mtp_log("rx %pK %d\n", req, req->actual);
+		start_time = ktime_get();
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		mtp_log("vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			if (dev->state != STATE_OFFLINE)
+				dev->state = STATE_ERROR;
+			goto cancel;
 		}
+		dev->perf[dev->dbg_write_index].vfs_wtime =
+			ktime_to_us(ktime_sub(ktime_get(), start_time));
+		dev->perf[dev->dbg_write_index].vfs_wbytes = ret;
+		vfs_us += dev->perf[dev->dbg_write_index].vfs_wtime;
+		dev->dbg_write_index =
+			(dev->dbg_write_index + 1) % MAX_ITERATION;
+		bytes += ret;
+	}
+
+	mtp_xfer_stats_add(dev, MTP_STATS_RECEIVE, bytes, xfer_start,
+			   vfs_us, usb_us);
+cancel:
+	/* give back the reads still in flight */
+	for (; inflight > 0; inflight--) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[head]);
+		head = (head + 1) % dev->nr_rx_reqs;
 	}
 fail:
 	mutex_unlock(&dev->read_mutex);
@@ -1495,7 +1583,7 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	mutex_lock(&dev->read_mutex);
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < dev->nr_rx_reqs; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
@@ -1623,6 +1711,24 @@ static int debug_mtp_read_stats(struct seq_file *s, void *unused)
 
 	seq_printf(s, "vfs_read(time in usec) min:%d\t max:%d\t avg:%d\n",
 				min, max, (iteration ? (sum / iteration) : 0));
+
+	seq_puts(s, "\n=======================\n");
+	seq_puts(s, "MTP Throughput:\n");
+	seq_puts(s, "\n=======================\n");
+	seq_printf(s, "tx reqs:%u x %u\t rx reqs:%d x %u\n",
+			mtp_tx_reqs, mtp_tx_req_len, dev->nr_rx_reqs,
+			mtp_rx_req_len);
+	for (i = 0; i < MTP_STATS_MAX; i++)
+		seq_printf(s, "%s: files:%u bytes:%llu time(ms):%llu vfs(ms):%llu usb wait(ms):%llu avg(KB/s):%llu last(KB/s):%u\n",
+			i == MTP_STATS_SEND ? "send" : "receive",
+			dev->xfer_stats[i].files, dev->xfer_stats[i].bytes,
+			dev->xfer_stats[i].time_us / USEC_PER_MSEC,
+			dev->xfer_stats[i].vfs_us / USEC_PER_MSEC,
+			dev->xfer_stats[i].usb_us / USEC_PER_MSEC,
+			dev->xfer_stats[i].time_us ?
+			div64_u64(dev->xfer_stats[i].bytes * USEC_PER_SEC,
+				  dev->xfer_stats[i].time_us * 1024) : 0,
+			dev->xfer_stats[i].last_kbps);
 	spin_unlock_irqrestore(&dev->lock, flags);
 	return 0;
 }
@@ -1646,6 +1752,7 @@ static ssize_t debug_mtp_reset_stats(struct file *file, const char __user *buf,
 
 	spin_lock_irqsave(&dev->lock, flags);
 	memset(&dev->perf[0], 0, MAX_ITERATION * sizeof(dev->perf[0]));
+	memset(dev->xfer_stats, 0, sizeof(dev->xfer_stats));
 	dev->dbg_read_index = 0;
 	dev->dbg_write_index = 0;
 	spin_unlock_irqrestore(&dev->lock, flags);
@@ -314,6 +314,33 @@ static struct uac2_iso_endpoint_descriptor as_iso_out_desc = {
 	.wLockDelay = 0,
 };
 
+/* STD AS ISO IN Feedback Endpoint, only with c_fback */
+static struct usb_endpoint_descriptor fs_epin_fback_desc = {
+	.bLength = USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType = USB_DT_ENDPOINT,
+
+	.bEndpointAddress = USB_DIR_IN,
+	.bmAttributes = USB_ENDPOINT_XFER_ISOC | USB_ENDPOINT_USAGE_FEEDBACK,
+	.wMaxPacketSize = cpu_to_le16(3),
+	.bInterval = 1,
+};
+
+static struct usb_endpoint_descriptor hs_epin_fback_desc = {
+	.bLength = USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType = USB_DT_ENDPOINT,
+
+	.bmAttributes = USB_ENDPOINT_XFER_ISOC | USB_ENDPOINT_USAGE_FEEDBACK,
+	.wMaxPacketSize = cpu_to_le16(4),
+	.bInterval = 4,
+};
+
+static struct usb_ss_ep_comp_descriptor ss_epin_fback_comp_desc = {
+	 .bLength =		 sizeof(ss_epin_fback_comp_desc),
+	 .bDescriptorType =	 USB_DT_SS_ENDPOINT_COMP,
+
+	 .wBytesPerInterval =	cpu_to_le16(4),
+};
+
 /* Audio Streaming IN Interface - Alt0 */
 static struct usb_interface_descriptor std_as_in_if0_desc = {
 	.bLength = sizeof std_as_in_if0_desc,
@@ -417,6 +444,7 @@ static struct usb_descriptor_header *fs_audio_desc[] = {
 	(struct usb_descriptor_header *)&as_out_fmt1_desc,
 	(struct usb_descriptor_header *)&fs_epout_desc,
 	(struct usb_descriptor_header *)&as_iso_out_desc,
+	(struct usb_descriptor_header *)&fs_epin_fback_desc,
 
 	(struct usb_descriptor_header *)&std_as_in_if0_desc,
 	(struct usb_descriptor_header *)&std_as_in_if1_desc,
@@ -447,6 +475,7 @@ static struct usb_descriptor_header *hs_audio_desc[] = {
 	(struct usb_descriptor_header *)&as_out_fmt1_desc,
 	(struct usb_descriptor_header *)&hs_epout_desc,
 	(struct usb_descriptor_header *)&as_iso_out_desc,
+	(struct usb_descriptor_header *)&hs_epin_fback_desc,
 
 	(struct usb_descriptor_header *)&std_as_in_if0_desc,
 	(struct usb_descriptor_header *)&std_as_in_if1_desc,
@@ -478,6 +507,8 @@ static struct usb_descriptor_header *ss_audio_desc[] = {
 	(struct usb_descriptor_header *)&hs_epout_desc,
 	(struct usb_descriptor_header *)&ss_epout_comp_desc,
 	(struct usb_descriptor_header *)&as_iso_out_desc,
+	(struct usb_descriptor_header *)&hs_epin_fback_desc,
+	(struct usb_descriptor_header *)&ss_epin_fback_comp_desc,
 
 	(struct usb_descriptor_header *)&std_as_in_if0_desc,
 	(struct usb_descriptor_header *)&std_as_in_if1_desc,
@@ -505,7 +536,7 @@ static void set_ep_max_packet_size(const struct f_uac2_opts *uac2_opts,
 	struct usb_endpoint_descriptor *ep_desc,
 	unsigned int factor, bool is_playback)
 {
-	int chmask, srate, ssize;
+	int chmask, srate, ssize, frames;
 	u16 max_packet_size;
 
 	if (is_playback) {
@@ -518,15 +549,37 @@ static void set_ep_max_packet_size(const struct f_uac2_opts *uac2_opts,
 		ssize = uac2_opts->c_ssize;
 	}
 
-	max_packet_size = num_channels(chmask) * ssize *
-		DIV_ROUND_UP(srate, factor / (1 << (ep_desc->bInterval - 1)));
+	frames = DIV_ROUND_UP(srate, factor / (1 << (ep_desc->bInterval - 1)));
+	/* An asynchronous host may run up to a frame ahead */
+	if (!is_playback && uac2_opts->c_fback)
+		frames++;
+
+	max_packet_size = num_channels(chmask) * ssize * frames;
 	ep_desc->wMaxPacketSize = cpu_to_le16(min_t(u16, max_packet_size,
 				le16_to_cpu(ep_desc->wMaxPacketSize)));
 }
 
+/* Copy @src to @dst, leaving the feedback endpoint out unless @fback */
+static void setup_descs(struct usb_descriptor_header **dst,
+	struct usb_descriptor_header **src, bool fback)
+{
+	for (; *src; src++) {
+		if (!fback &&
+		    (*src == (struct usb_descriptor_header *)&fs_epin_fback_desc ||
+		     *src == (struct usb_descriptor_header *)&hs_epin_fback_desc ||
+		     *src == (struct usb_descriptor_header *)&ss_epin_fback_comp_desc))
+			continue;
+		*dst++ = *src;
+	}
+	*dst = NULL;
+}
+
 static int
 afunc_bind(struct usb_configuration *cfg, struct usb_function *fn)
 {
+	struct usb_descriptor_header *fs_descs[ARRAY_SIZE(fs_audio_desc)];
+	struct usb_descriptor_header *hs_descs[ARRAY_SIZE(hs_audio_desc)];
+	struct usb_descriptor_header *ss_descs[ARRAY_SIZE(ss_audio_desc)];
 	struct f_uac2 *uac2 = func_to_uac2(fn);
 	struct g_audio *agdev = func_to_g_audio(fn);
 	struct usb_composite_dev *cdev = cfg->cdev;
@@ -604,6 +657,19 @@ afunc_bind(struct usb_configuration *cfg, struct usb_function *fn)
 	uac2->as_in_intf = ret;
 	uac2->as_in_alt = 0;
 
+	/* Asynchronous capture, rate matched through the feedback endpoint */
+	if (uac2_opts->c_fback) {
+		fs_epout_desc.bmAttributes =
+			USB_ENDPOINT_XFER_ISOC | USB_ENDPOINT_SYNC_ASYNC;
+		hs_epout_desc.bmAttributes = fs_epout_desc.bmAttributes;
+		std_as_out_if1_desc.bNumEndpoints = 2;
+	} else {
+		fs_epout_desc.bmAttributes =
+			USB_ENDPOINT_XFER_ISOC | USB_ENDPOINT_SYNC_SYNC;
+		hs_epout_desc.bmAttributes = fs_epout_desc.bmAttributes;
+		std_as_out_if1_desc.bNumEndpoints = 1;
+	}
+
 	/* Calculate wMaxPacketSize according to audio bandwidth */
 	set_ep_max_packet_size(uac2_opts, &fs_epin_desc, 1000, true);
 	set_ep_max_packet_size(uac2_opts, &fs_epout_desc, 1000, false);
@@ -622,6 +688,18 @@ afunc_bind(struct usb_configuration *cfg, struct usb_function *fn)
 		return -ENODEV;
 	}
 
+	agdev->in_ep_fback = NULL;
+	if (uac2_opts->c_fback) {
+		agdev->in_ep_fback = usb_ep_autoconfig(gadget,
+						       &fs_epin_fback_desc);
+		if (!agdev->in_ep_fback) {
+			dev_err(dev, "%s:%d Error!\n", __func__, __LINE__);
+			return -ENODEV;
+		}
+		hs_epin_fback_desc.bEndpointAddress =
+			fs_epin_fback_desc.bEndpointAddress;
+	}
+
 	agdev->in_ep_maxpsize = max_t(u16,
 				le16_to_cpu(fs_epin_desc.wMaxPacketSize),
 				le16_to_cpu(hs_epin_desc.wMaxPacketSize));
@@ -632,8 +710,11 @@ afunc_bind(struct usb_configuration *cfg, struct usb_function *fn)
 	hs_epout_desc.bEndpointAddress = fs_epout_desc.bEndpointAddress;
 	hs_epin_desc.bEndpointAddress = fs_epin_desc.bEndpointAddress;
 
-	ret = usb_assign_descriptors(fn, fs_audio_desc, hs_audio_desc,
-					ss_audio_desc, NULL);
+	setup_descs(fs_descs, fs_audio_desc, uac2_opts->c_fback);
+	setup_descs(hs_descs, hs_audio_desc, uac2_opts->c_fback);
+	setup_descs(ss_descs, ss_audio_desc, uac2_opts->c_fback);
+
+	ret = usb_assign_descriptors(fn, fs_descs, hs_descs, ss_descs, NULL);
 	if (ret)
 		return ret;
 
@@ -646,6 +727,7 @@ afunc_bind(struct usb_configuration *cfg, struct usb_function *fn)
 	agdev->params.c_srate = uac2_opts->c_srate;
 	agdev->params.c_ssize = uac2_opts->c_ssize;
 	agdev->params.req_number = uac2_opts->req_number;
+	agdev->params.c_fback = uac2_opts->c_fback;
 	ret = g_audio_setup(agdev, "UAC2 PCM", "UAC2_Gadget");
 	if (ret)
 		goto err_free_descs;
@@ -961,6 +1043,7 @@ UAC2_ATTRIBUTE(c_chmask);
 UAC2_ATTRIBUTE(c_srate);
 UAC2_ATTRIBUTE(c_ssize);
 UAC2_ATTRIBUTE(req_number);
+UAC2_ATTRIBUTE(c_fback);
 
 static struct configfs_attribute *f_uac2_attrs[] = {
 	&f_uac2_opts_attr_p_chmask,
@@ -970,6 +1053,7 @@ static struct configfs_attribute *f_uac2_attrs[] = {
 	&f_uac2_opts_attr_c_srate,
 	&f_uac2_opts_attr_c_ssize,
 	&f_uac2_opts_attr_req_number,
+	&f_uac2_opts_attr_c_fback,
 	NULL,
 };
 
@@ -1008,6 +1092,7 @@ static struct usb_function_instance *afunc_alloc_inst(void)
 	opts->c_srate = UAC2_DEF_CSRATE;
 	opts->c_ssize = UAC2_DEF_CSSIZE;
 	opts->req_number = UAC2_DEF_REQ_NUM;
+	opts->c_fback = UAC2_DEF_CFBACK;
 	return &opts->func_inst;
 }
 
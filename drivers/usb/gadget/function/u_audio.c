@@ -22,7 +22,9 @@
  */
 
 #include <linux/module.h>
+#include <asm/unaligned.h>
 #include <sound/core.h>
+#include <sound/control.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
 
@@ -32,9 +34,19 @@
 #define PRD_SIZE_MAX	PAGE_SIZE
 #define MIN_PERIODS	4
 
+/* Capture pitch, in millionths of the nominal rate */
+#define PITCH_NOMINAL		1000000
+#define PITCH_RANGE		5000
+
 struct uac_req {
 	struct uac_rtd_params *pp; /* parent param */
 	struct usb_request *req;
+
+	/* Own buffer, silence or a playback packet wrapping the ring */
+	void *buf;
+	/* Bytes of the playback ring carried, for trigger generation gen */
+	unsigned int ring_bytes;
+	unsigned int gen;
 };
 
 /* Runtime data params for one stream */
@@ -47,11 +59,27 @@ struct uac_rtd_params {
 	/* Ring buffer */
 	ssize_t hw_ptr;
 
+	/*
+	 * Playback requests are queued straight from the ring, ahead of
+	 * hw_ptr which only moves once they complete.
+	 */
+	ssize_t q_ptr;
+	unsigned int queued;
+	unsigned int gen;
+
 	void *rbuf;
 
 	unsigned max_psize;	/* MaxPacketSize of endpoint */
 	struct uac_req *ureq;
 
+	/* Feedback endpoint of asynchronous capture */
+	bool fb_ep_enabled;
+	struct usb_request *req_fback;
+	void *fb_buf;
+	unsigned int pitch;
+
+	unsigned long xruns;
+
 	spinlock_t lock;
 };
 
@@ -89,7 +117,7 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	unsigned pending;
 	unsigned long flags, flags2;
-	unsigned int hw_ptr;
+	unsigned int hw_ptr, q_ptr, sent = 0;
 	int status = req->status;
 	struct uac_req *ur = req->context;
 	struct snd_pcm_substream *substream;
@@ -126,6 +154,13 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 	spin_lock_irqsave(&prm->lock, flags);
 
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		/* The ring data this request carried is now on the bus */
+		if (ur->gen == prm->gen) {
+			sent = ur->ring_bytes;
+			prm->hw_ptr = (prm->hw_ptr + sent) % runtime->dma_bytes;
+			prm->queued -= sent;
+		}
+
 		/*
 		 * For each IN packet, take the quotient of the current data
 		 * rate and the endpoint's interval as the base packet size.
@@ -147,6 +182,34 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 		}
 
 		req->actual = req->length;
+
+		q_ptr = prm->q_ptr;
+		prm->q_ptr = (q_ptr + req->length) % runtime->dma_bytes;
+		prm->queued += req->length;
+		ur->ring_bytes = req->length;
+		ur->gen = prm->gen;
+		hw_ptr = prm->hw_ptr;
+
+		spin_unlock_irqrestore(&prm->lock, flags);
+
+		/* Send from the ring unless the packet wraps around it */
+		pending = runtime->dma_bytes - q_ptr;
+		if (likely(pending >= req->length)) {
+			req->buf = runtime->dma_area + q_ptr;
+		} else {
+			req->buf = ur->buf;
+			memcpy(req->buf, runtime->dma_area + q_ptr, pending);
+			memcpy(req->buf + pending, runtime->dma_area,
+			       req->length - pending);
+		}
+
+		snd_pcm_stream_unlock_irqrestore(substream, flags2);
+
+		if (sent &&
+		    (hw_ptr % snd_pcm_lib_period_bytes(substream)) < sent)
+			snd_pcm_period_elapsed(substream);
+
+		goto queue;
 	}
 
 	hw_ptr = prm->hw_ptr;
@@ -156,24 +219,12 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 	/* Pack USB load in ALSA ring buffer */
 	pending = runtime->dma_bytes - hw_ptr;
 
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
-		if (unlikely(pending < req->actual)) {
-			memcpy(req->buf, runtime->dma_area + hw_ptr, pending);
-			memcpy(req->buf + pending, runtime->dma_area,
-			       req->actual - pending);
-		} else {
-			memcpy(req->buf, runtime->dma_area + hw_ptr,
-			       req->actual);
-		}
+	if (unlikely(pending < req->actual)) {
+		memcpy(runtime->dma_area + hw_ptr, req->buf, pending);
+		memcpy(runtime->dma_area, req->buf + pending,
+		       req->actual - pending);
 	} else {
-		if (unlikely(pending < req->actual)) {
-			memcpy(runtime->dma_area + hw_ptr, req->buf, pending);
-			memcpy(runtime->dma_area, req->buf + pending,
-			       req->actual - pending);
-		} else {
-			memcpy(runtime->dma_area + hw_ptr, req->buf,
-			       req->actual);
-		}
+		memcpy(runtime->dma_area + hw_ptr, req->buf, req->actual);
 	}
 
 	spin_lock_irqsave(&prm->lock, flags);
@@ -186,7 +237,51 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 	if ((hw_ptr % snd_pcm_lib_period_bytes(substream)) < req->actual)
 		snd_pcm_period_elapsed(substream);
 
+	goto queue;
+
 exit:
+	/* Playback is idle, go back to sending silence */
+	req->buf = ur->buf;
+	ur->ring_bytes = 0;
+queue:
+	if (usb_ep_queue(ep, req, GFP_ATOMIC))
+		dev_err(uac->card->dev, "%d Error!\n", __LINE__);
+}
+
+/*
+ * The host paces asynchronous capture by the feedback: samples per frame
+ * in 10.14 at full speed, per microframe in 16.16 otherwise.
+ */
+static void u_audio_set_fback(struct uac_rtd_params *prm,
+			      struct usb_request *req)
+{
+	struct g_audio *audio_dev = prm->uac->audio_dev;
+	u64 rate = (u64)audio_dev->params.c_srate * READ_ONCE(prm->pitch);
+	u32 ff;
+
+	if (audio_dev->gadget->speed == USB_SPEED_FULL) {
+		ff = div_u64(rate << 14, 1000 * PITCH_NOMINAL);
+		req->length = 3;
+	} else {
+		ff = div_u64(rate << 16, 8000 * PITCH_NOMINAL);
+		req->length = 4;
+	}
+
+	put_unaligned_le32(ff, req->buf);
+}
+
+static void u_audio_iso_fback_complete(struct usb_ep *ep,
+				       struct usb_request *req)
+{
+	struct uac_rtd_params *prm = req->context;
+	struct snd_uac_chip *uac = prm->uac;
+
+	/* i/f shutting down */
+	if (!prm->fb_ep_enabled || req->status == -ESHUTDOWN)
+		return;
+
+	u_audio_set_fback(prm, req);
+
 	if (usb_ep_queue(ep, req, GFP_ATOMIC))
 		dev_err(uac->card->dev, "%d Error!\n", __LINE__);
 }
@@ -212,6 +307,9 @@ static int uac_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 
 	/* Reset */
 	prm->hw_ptr = 0;
+	prm->q_ptr = 0;
+	prm->queued = 0;
+	prm->gen++;
 
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
@@ -238,14 +336,18 @@ static int uac_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 static snd_pcm_uframes_t uac_pcm_pointer(struct snd_pcm_substream *substream)
 {
 	struct snd_uac_chip *uac = snd_pcm_substream_chip(substream);
+	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct uac_rtd_params *prm;
 
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		prm = &uac->p_prm;
-	else
+		/* queued to the controller but not sent yet */
+		runtime->delay = bytes_to_frames(runtime, prm->queued);
+	} else {
 		prm = &uac->c_prm;
+	}
 
-	return bytes_to_frames(substream->runtime, prm->hw_ptr);
+	return bytes_to_frames(runtime, prm->hw_ptr);
 }
 
 static int uac_pcm_hw_params(struct snd_pcm_substream *substream,
@@ -332,6 +434,22 @@ static int uac_pcm_null(struct snd_pcm_substream *substream)
 	return 0;
 }
 
+/* Recovering from an xrun always goes through prepare */
+static int uac_pcm_prepare(struct snd_pcm_substream *substream)
+{
+	struct snd_uac_chip *uac = snd_pcm_substream_chip(substream);
+
+	if (substream->runtime->status->state != SNDRV_PCM_STATE_XRUN)
+		return 0;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		uac->p_prm.xruns++;
+	else
+		uac->c_prm.xruns++;
+
+	return 0;
+}
+
 static const struct snd_pcm_ops uac_pcm_ops = {
 	.open = uac_pcm_open,
 	.close = uac_pcm_null,
@@ -340,9 +458,135 @@ static const struct snd_pcm_ops uac_pcm_ops = {
 	.hw_free = uac_pcm_hw_free,
 	.trigger = uac_pcm_trigger,
 	.pointer = uac_pcm_pointer,
-	.prepare = uac_pcm_null,
+	.prepare = uac_pcm_prepare,
 };
 
+enum {
+	UAC_CTL_P_XRUNS,
+	UAC_CTL_C_XRUNS,
+	UAC_CTL_P_LATENCY,
+};
+
+static int u_audio_count_info(struct snd_kcontrol *kcontrol,
+			      struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = INT_MAX;
+	uinfo->value.integer.step = 1;
+
+	return 0;
+}
+
+static int u_audio_count_get(struct snd_kcontrol *kcontrol,
+			     struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_uac_chip *uac = snd_kcontrol_chip(kcontrol);
+	unsigned int bytes_per_sec;
+	unsigned long val = 0;
+
+	switch (kcontrol->private_value) {
+	case UAC_CTL_P_XRUNS:
+		val = uac->p_prm.xruns;
+		break;
+	case UAC_CTL_C_XRUNS:
+		val = uac->c_prm.xruns;
+		break;
+	case UAC_CTL_P_LATENCY:
+		bytes_per_sec = uac->audio_dev->params.p_srate *
+				uac->p_framesize;
+		if (bytes_per_sec)
+			val = div_u64((u64)READ_ONCE(uac->p_prm.queued) *
+				      USEC_PER_SEC, bytes_per_sec);
+		break;
+	}
+
+	ucontrol->value.integer.value[0] = min_t(unsigned long, val, INT_MAX);
+
+	return 0;
+}
+
+static int u_audio_pitch_info(struct snd_kcontrol *kcontrol,
+			      struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = PITCH_NOMINAL - PITCH_RANGE;
+	uinfo->value.integer.max = PITCH_NOMINAL + PITCH_RANGE;
+	uinfo->value.integer.step = 1;
+
+	return 0;
+}
+
+static int u_audio_pitch_get(struct snd_kcontrol *kcontrol,
+			     struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_uac_chip *uac = snd_kcontrol_chip(kcontrol);
+
+	ucontrol->value.integer.value[0] = uac->c_prm.pitch;
+
+	return 0;
+}
+
+static int u_audio_pitch_put(struct snd_kcontrol *kcontrol,
+			     struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_uac_chip *uac = snd_kcontrol_chip(kcontrol);
+	unsigned int val;
+
+	val = clamp_t(long, ucontrol->value.integer.value[0],
+		      PITCH_NOMINAL - PITCH_RANGE,
+		      PITCH_NOMINAL + PITCH_RANGE);
+	if (val == uac->c_prm.pitch)
+		return 0;
+
+	WRITE_ONCE(uac->c_prm.pitch, val);
+
+	return 1;
+}
+
+#define UAC_COUNT_CTL(xname, xval) {					\
+	.iface = SNDRV_CTL_ELEM_IFACE_PCM,				\
+	.name = xname,							\
+	.access = SNDRV_CTL_ELEM_ACCESS_READ |				\
+		  SNDRV_CTL_ELEM_ACCESS_VOLATILE,			\
+	.info = u_audio_count_info,					\
+	.get = u_audio_count_get,					\
+	.private_value = xval,						\
+}
+
+static const struct snd_kcontrol_new u_audio_p_controls[] = {
+	UAC_COUNT_CTL("Playback Xruns", UAC_CTL_P_XRUNS),
+	UAC_COUNT_CTL("Playback Latency us", UAC_CTL_P_LATENCY),
+};
+
+static const struct snd_kcontrol_new u_audio_c_controls[] = {
+	UAC_COUNT_CTL("Capture Xruns", UAC_CTL_C_XRUNS),
+};
+
+static const struct snd_kcontrol_new u_audio_pitch_control = {
+	.iface = SNDRV_CTL_ELEM_IFACE_PCM,
+	.name = "Capture Pitch 1000000",
+	.info = u_audio_pitch_info,
+	.get = u_audio_pitch_get,
+	.put = u_audio_pitch_put,
+};
+
+static int u_audio_add_controls(struct snd_uac_chip *uac,
+				const struct snd_kcontrol_new *ctls, int n)
+{
+	int i, err;
+
+	for (i = 0; i < n; i++) {
+		err = snd_ctl_add(uac->card, snd_ctl_new1(&ctls[i], uac));
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
 static inline void free_ep(struct uac_rtd_params *prm, struct usb_ep *ep)
 {
 	struct snd_uac_chip *uac = prm->uac;
@@ -370,6 +614,26 @@ static inline void free_ep(struct uac_rtd_params *prm, struct usb_ep *ep)
 		dev_err(uac->card->dev, "%s:%d Error!\n", __func__, __LINE__);
 }
 
+static inline void free_ep_fback(struct uac_rtd_params *prm,
+				 struct usb_ep *ep)
+{
+	struct snd_uac_chip *uac = prm->uac;
+
+	if (!prm->fb_ep_enabled)
+		return;
+
+	prm->fb_ep_enabled = false;
+
+	if (prm->req_fback) {
+		usb_ep_dequeue(ep, prm->req_fback);
+		usb_ep_free_request(ep, prm->req_fback);
+		prm->req_fback = NULL;
+	}
+
+	if (usb_ep_disable(ep))
+		dev_err(uac->card->dev, "%s:%d Error!\n", __func__, __LINE__);
+}
+
 
 int u_audio_start_capture(struct g_audio *audio_dev)
 {
@@ -406,13 +670,41 @@ int u_audio_start_capture(struct g_audio *audio_dev)
 			req->context = &prm->ureq[i];
 			req->length = req_len;
 			req->complete = u_audio_iso_complete;
-			req->buf = prm->rbuf + i * prm->max_psize;
+			req->buf = prm->ureq[i].buf;
 		}
 
 		if (usb_ep_queue(ep, prm->ureq[i].req, GFP_ATOMIC))
 			dev_err(dev, "%s:%d Error!\n", __func__, __LINE__);
 	}
 
+	ep = audio_dev->in_ep_fback;
+	if (!ep)
+		return 0;
+
+	ret = config_ep_by_speed(gadget, &audio_dev->func, ep);
+	if (ret)
+		return ret;
+
+	prm->fb_ep_enabled = true;
+	usb_ep_enable(ep);
+
+	if (!prm->req_fback) {
+		req = usb_ep_alloc_request(ep, GFP_ATOMIC);
+		if (req == NULL)
+			return -ENOMEM;
+
+		prm->req_fback = req;
+		req->zero = 0;
+		req->context = prm;
+		req->complete = u_audio_iso_fback_complete;
+		req->buf = prm->fb_buf;
+	}
+
+	u_audio_set_fback(prm, prm->req_fback);
+
+	if (usb_ep_queue(ep, prm->req_fback, GFP_ATOMIC))
+		dev_err(dev, "%s:%d Error!\n", __func__, __LINE__);
+
 	return 0;
 }
 EXPORT_SYMBOL_GPL(u_audio_start_capture);
@@ -421,6 +713,8 @@ void u_audio_stop_capture(struct g_audio *audio_dev)
 {
 	struct snd_uac_chip *uac = audio_dev->uac;
 
+	if (audio_dev->in_ep_fback)
+		free_ep_fback(&uac->c_prm, audio_dev->in_ep_fback);
 	free_ep(&uac->c_prm, audio_dev->out_ep);
 }
 EXPORT_SYMBOL_GPL(u_audio_stop_capture);
@@ -484,7 +778,7 @@ int u_audio_start_playback(struct g_audio *audio_dev)
 			req->context = &prm->ureq[i];
 			req->length = req_len;
 			req->complete = u_audio_iso_complete;
-			req->buf = prm->rbuf + i * prm->max_psize;
+			req->buf = prm->ureq[i].buf;
 		}
 
 		if (usb_ep_queue(ep, prm->ureq[i].req, GFP_ATOMIC))
@@ -511,7 +805,7 @@ int g_audio_setup(struct g_audio *g_audio, const char *pcm_name,
 	struct snd_pcm *pcm;
 	struct uac_params *params;
 	int p_chmask, c_chmask;
-	int err;
+	int err, i;
 
 	if (!g_audio)
 		return -EINVAL;
@@ -546,6 +840,18 @@ int g_audio_setup(struct g_audio *g_audio, const char *pcm_name,
 			err = -ENOMEM;
 			goto fail;
 		}
+
+		for (i = 0; i < params->req_number; i++)
+			prm->ureq[i].buf = prm->rbuf + i * prm->max_psize;
+
+		prm->pitch = PITCH_NOMINAL;
+		if (params->c_fback) {
+			prm->fb_buf = kzalloc(sizeof(u32), GFP_KERNEL);
+			if (!prm->fb_buf) {
+				err = -ENOMEM;
+				goto fail;
+			}
+		}
 	}
 
 	if (p_chmask) {
@@ -568,6 +874,9 @@ int g_audio_setup(struct g_audio *g_audio, const char *pcm_name,
 			err = -ENOMEM;
 			goto fail;
 		}
+
+		for (i = 0; i < params->req_number; i++)
+			prm->ureq[i].buf = prm->rbuf + i * prm->max_psize;
 	}
 
 	/* Choose any slot, with no id */
@@ -598,9 +907,33 @@ int g_audio_setup(struct g_audio *g_audio, const char *pcm_name,
 	strlcpy(card->shortname, card_name, sizeof(card->shortname));
 	sprintf(card->longname, "%s %i", card_name, card->dev->id);
 
+	/*
+	 * Playback requests point into this buffer, which hw_free never
+	 * releases since it is preallocated at the maximum buffer size.
+	 */
 	snd_pcm_lib_preallocate_pages_for_all(pcm, SNDRV_DMA_TYPE_CONTINUOUS,
 		snd_dma_continuous_data(GFP_KERNEL), 0, BUFF_SIZE_MAX);
 
+	if (p_chmask) {
+		err = u_audio_add_controls(uac, u_audio_p_controls,
+					   ARRAY_SIZE(u_audio_p_controls));
+		if (err < 0)
+			goto snd_fail;
+	}
+
+	if (c_chmask) {
+		err = u_audio_add_controls(uac, u_audio_c_controls,
+					   ARRAY_SIZE(u_audio_c_controls));
+		if (err < 0)
+			goto snd_fail;
+	}
+
+	if (c_chmask && params->c_fback) {
+		err = u_audio_add_controls(uac, &u_audio_pitch_control, 1);
+		if (err < 0)
+			goto snd_fail;
+	}
+
 	err = snd_card_register(card);
 
 	if (!err)
@@ -613,6 +946,7 @@ fail:
 	kfree(uac->c_prm.ureq);
 	kfree(uac->p_prm.rbuf);
 	kfree(uac->c_prm.rbuf);
+	kfree(uac->c_prm.fb_buf);
 	kfree(uac);
 
 	return err;
@@ -636,6 +970,7 @@ void g_audio_cleanup(struct g_audio *g_audio)
 	kfree(uac->c_prm.ureq);
 	kfree(uac->p_prm.rbuf);
 	kfree(uac->c_prm.rbuf);
+	kfree(uac->c_prm.fb_buf);
 	kfree(uac);
 }
 EXPORT_SYMBOL_GPL(g_audio_cleanup);
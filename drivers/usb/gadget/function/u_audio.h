@@ -33,6 +33,8 @@ struct uac_params {
 	int c_ssize;	/* sample size */
 
 	int req_number; /* number of preallocated requests */
+
+	bool c_fback;	/* asynchronous capture with feedback endpoint */
 };
 
 struct g_audio {
@@ -41,6 +43,8 @@ struct g_audio {
 
 	struct usb_ep *in_ep;
 	struct usb_ep *out_ep;
+	/* Feedback endpoint of out_ep, if asynchronous */
+	struct usb_ep *in_ep_fback;
 
 	/* Max packet size for all in_ep possible speeds */
 	unsigned int in_ep_maxpsize;
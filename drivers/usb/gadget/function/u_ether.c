@@ -94,6 +94,7 @@ struct eth_dev {
 
 	struct work_struct	work;
 	struct work_struct	rx_work;
+	struct napi_struct	rx_napi;
 
 	unsigned long		todo;
 	unsigned long		flags;
@@ -108,6 +109,8 @@ struct eth_dev {
 	unsigned long		rx_throttle;
 	unsigned int		tx_pkts_rcvd;
 	unsigned long		skb_expand_cnt;
+	unsigned long		tx_more_held;
+	unsigned long		rx_napi_polls;
 	struct dentry		*uether_dent;
 	struct dentry		*uether_dfile;
 };
@@ -149,6 +152,23 @@ static inline int qlen(struct usb_gadget *gadget, unsigned qmult)
 static unsigned int u_ether_rx_pending_thld = U_ETHER_RX_PENDING_TSHOLD;
 module_param(u_ether_rx_pending_thld, uint, 0644);
 
+/*
+ * Received frames are handed to the network stack from NAPI, in softirq
+ * context and through GRO, rather than one netif_rx_ni() at a time from
+ * the uether workqueue.
+ */
+static bool u_ether_rx_napi = true;
+module_param(u_ether_rx_napi, bool, 0644);
+MODULE_PARM_DESC(u_ether_rx_napi, "Process received frames from NAPI");
+
+/*
+ * RX buffers up to PAGE_FRAG_CACHE_MAX_SIZE are carved out of the per-cpu
+ * page fragment cache instead of being kmalloc()ed for every request.
+ */
+static bool u_ether_rx_frag = true;
+module_param(u_ether_rx_frag, bool, 0644);
+MODULE_PARM_DESC(u_ether_rx_frag, "Allocate rx buffers from page fragments");
+
 /* REVISIT there must be a better way than having two sets
  * of debug calls ...
  */
@@ -248,6 +268,34 @@ static void defer_kevent(struct eth_dev *dev, int flag)
 static void rx_complete(struct usb_ep *ep, struct usb_request *req);
 static void tx_complete(struct usb_ep *ep, struct usb_request *req);
 
+static struct sk_buff *rx_alloc_skb(struct eth_dev *dev, size_t size,
+		gfp_t gfp_flags)
+{
+	unsigned int	fragsz;
+	struct sk_buff	*skb;
+	void		*data;
+
+	fragsz = SKB_DATA_ALIGN(NET_SKB_PAD + size) +
+		SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+	if (!u_ether_rx_frag || fragsz > PAGE_FRAG_CACHE_MAX_SIZE)
+		return __netdev_alloc_skb(dev->net, size, gfp_flags);
+
+	data = netdev_alloc_frag(fragsz);
+	if (!data)
+		return NULL;
+
+	skb = build_skb(data, fragsz);
+	if (!skb) {
+		skb_free_frag(data);
+		return NULL;
+	}
+
+	skb_reserve(skb, NET_SKB_PAD);
+	skb->dev = dev->net;
+
+	return skb;
+}
+
 static int
 rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 {
@@ -298,7 +346,7 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	spin_unlock_irqrestore(&dev->lock, flags);
 
 	DBG(dev, "%s: size: %zd\n", __func__, size);
-	skb = __netdev_alloc_skb(dev->net, size + NET_IP_ALIGN, gfp_flags);
+	skb = rx_alloc_skb(dev, size + NET_IP_ALIGN, gfp_flags);
 	if (skb == NULL) {
 		DBG(dev, "no rx skb\n");
 		goto enomem;
@@ -407,8 +455,12 @@ clean:
 		spin_unlock(&dev->req_lock);
 	}
 
-	if (queue)
-		queue_work(uether_wq, &dev->rx_work);
+	if (queue) {
+		if (u_ether_rx_napi)
+			napi_schedule(&dev->rx_napi);
+		else
+			queue_work(uether_wq, &dev->rx_work);
+	}
 }
 
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
@@ -543,6 +595,28 @@ static __be16 ether_ip_type_trans(struct sk_buff *skb,
 	return protocol;
 }
 
+/* Check and account a received frame, false if it was dropped */
+static bool rx_frame(struct eth_dev *dev, struct sk_buff *skb)
+{
+	if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+		dev->net->stats.rx_errors++;
+		dev->net->stats.rx_length_errors++;
+		DBG(dev, "rx length %d\n", skb->len);
+		dev_kfree_skb_any(skb);
+		return false;
+	}
+
+	if (test_bit(RMNET_MODE_LLP_IP, &dev->flags))
+		skb->protocol = ether_ip_type_trans(skb, dev->net);
+	else
+		skb->protocol = eth_type_trans(skb, dev->net);
+
+	dev->net->stats.rx_packets++;
+	dev->net->stats.rx_bytes += skb->len;
+
+	return true;
+}
+
 static void process_rx_w(struct work_struct *work)
 {
 	struct eth_dev	*dev = container_of(work, struct eth_dev, rx_work);
@@ -553,31 +627,44 @@ static void process_rx_w(struct work_struct *work)
 		return;
 
 	while ((skb = skb_dequeue(&dev->rx_frames))) {
-		if (status < 0
-				|| ETH_HLEN > skb->len
-				|| skb->len > ETH_FRAME_LEN) {
+		if (status < 0) {
 			dev->net->stats.rx_errors++;
-			dev->net->stats.rx_length_errors++;
-			DBG(dev, "rx length %d\n", skb->len);
 			dev_kfree_skb_any(skb);
 			continue;
 		}
 
-		if (test_bit(RMNET_MODE_LLP_IP, &dev->flags))
-			skb->protocol = ether_ip_type_trans(skb, dev->net);
-		else
-			skb->protocol = eth_type_trans(skb, dev->net);
-
-		dev->net->stats.rx_packets++;
-		dev->net->stats.rx_bytes += skb->len;
-
-		status = netif_rx_ni(skb);
+		if (rx_frame(dev, skb))
+			status = netif_rx_ni(skb);
 	}
 
 	if (netif_running(dev->net))
 		rx_fill(dev, GFP_KERNEL);
 }
 
+static int eth_rx_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, rx_napi);
+	struct sk_buff	*skb;
+	int		work_done = 0;
+
+	dev->rx_napi_polls++;
+
+	while (work_done < budget && (skb = skb_dequeue(&dev->rx_frames))) {
+		work_done++;
+		if (rx_frame(dev, skb))
+			napi_gro_receive(napi, skb);
+	}
+
+	/* requests left idle by rx throttling */
+	if (netif_running(dev->net) && dev->port_usb)
+		rx_fill(dev, GFP_ATOMIC);
+
+	if (work_done < budget)
+		napi_complete_done(napi, work_done);
+
+	return work_done;
+}
+
 static void eth_work(struct work_struct *work)
 {
 	struct eth_dev	*dev = container_of(work, struct eth_dev, work);
@@ -787,6 +874,8 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	bool			multi_pkt_xfer = false;
 	u32			fixed_in_len = 0;
 	bool			is_fixed = false;
+	bool			more = skb && skb->xmit_more;
+	bool			flush_held = false;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
@@ -821,13 +910,21 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 			if (!(cdc_filter & type)) {
 				dev->net->stats.tx_dropped++;
 				dev_kfree_skb_any(skb);
-				return NETDEV_TX_OK;
+				/*
+				 * The end of a burst may still have frames
+				 * held back for aggregation, flush those.
+				 */
+				if (!multi_pkt_xfer || more)
+					return NETDEV_TX_OK;
+				skb = NULL;
+				flush_held = true;
 			}
 		}
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
-	dev->tx_pkts_rcvd++;
+	if (!flush_held)
+		dev->tx_pkts_rcvd++;
 
 	/* Allocate memory for tx_reqs to support multi packet transfer */
 	spin_lock_irqsave(&dev->req_lock, flags);
@@ -864,6 +961,21 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	}
 	spin_unlock_irqrestore(&dev->req_lock, flags);
 
+	if (flush_held) {
+		if (!req->length)
+			goto multiframe;
+
+		length = req->length;
+		spin_lock_irqsave(&dev->req_lock, flags);
+		dev->no_tx_req_used++;
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+
+		spin_lock_irqsave(&dev->lock, flags);
+		dev->tx_skb_hold_count = 0;
+		spin_unlock_irqrestore(&dev->lock, flags);
+		goto queue;
+	}
+
 	/* no buffer copies needed, unless the network stack did it
 	 * or the hardware can't use skb buffers.
 	 * or there's not enough space for extra headers we need
@@ -918,6 +1030,18 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 				spin_unlock_irqrestore(&dev->req_lock, flags);
 				goto success;
 			}
+
+			/*
+			 * The stack has more frames for us right away, and
+			 * the last of them flushes the request, unless the
+			 * queue was stopped and it will not come.
+			 */
+			if (more && !netif_queue_stopped(net)) {
+				dev->tx_more_held++;
+				list_add(&req->list, &dev->tx_reqs);
+				spin_unlock_irqrestore(&dev->req_lock, flags);
+				goto success;
+			}
 		}
 
 		dev->no_tx_req_used++;
@@ -961,6 +1085,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		req->context = skb;
 	}
 
+queue:
 	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
 	if (is_fixed && length == fixed_in_len &&
 	    (length % in->maxpacket) == 0)
@@ -1042,6 +1167,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->rx_napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -1061,6 +1187,7 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->rx_napi);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -1352,6 +1479,7 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	netif_napi_add(net, &dev->rx_napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 
 	/* network device setup */
 	dev->net = net;
@@ -1420,6 +1548,7 @@ struct net_device *gether_setup_name_default(const char *netname)
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	netif_napi_add(net, &dev->rx_napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 
 	/* network device setup */
 	dev->net = net;
@@ -1825,6 +1954,8 @@ static int uether_stat_show(struct seq_file *s, void *unused)
 		seq_printf(s, "rx_throttle = %lu\n", dev->rx_throttle);
 		seq_printf(s, "skb_expand_cnt = %lu\n",
 					dev->skb_expand_cnt);
+		seq_printf(s, "tx_more_held = %lu\n", dev->tx_more_held);
+		seq_printf(s, "rx_napi_polls = %lu\n", dev->rx_napi_polls);
 	}
 	return ret;
 }
@@ -1846,6 +1977,8 @@ static ssize_t uether_stat_reset(struct file *file,
 	dev->tx_throttle = 0;
 	dev->rx_throttle = 0;
 	dev->skb_expand_cnt = 0;
+	dev->tx_more_held = 0;
+	dev->rx_napi_polls = 0;
 	spin_unlock_irqrestore(&dev->lock, flags);
 	return count;
 }
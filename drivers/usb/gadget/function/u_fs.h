@@ -38,6 +38,23 @@
 
 #define ENTER()    pr_vdebug("%s()\n", __func__)
 
+/*
+ * dma-buf backed endpoint I/O on the epfiles, numbered as in the upstream
+ * FunctionFS uapi so that userspace can use either definition.
+ */
+#ifndef FUNCTIONFS_DMABUF_ATTACH
+struct usb_ffs_dmabuf_transfer_req {
+	int fd;
+	__u32 flags;
+	__u64 length;
+} __attribute__((packed));
+
+#define FUNCTIONFS_DMABUF_ATTACH	_IOW('g', 131, int)
+#define FUNCTIONFS_DMABUF_DETACH	_IOW('g', 132, int)
+#define FUNCTIONFS_DMABUF_TRANSFER	_IOW('g', 133, \
+					     struct usb_ffs_dmabuf_transfer_req)
+#endif
+
 struct f_fs_opts;
 
 struct ffs_dev {
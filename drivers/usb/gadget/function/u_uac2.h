@@ -25,6 +25,7 @@
 #define UAC2_DEF_CSRATE 44100
 #define UAC2_DEF_CSSIZE 2
 #define UAC2_DEF_REQ_NUM 2
+#define UAC2_DEF_CFBACK 0
 
 struct f_uac2_opts {
 	struct usb_function_instance	func_inst;
@@ -35,6 +36,7 @@ struct f_uac2_opts {
 	int				c_srate;
 	int				c_ssize;
 	int				req_number;
+	int				c_fback;
 	bool				bound;
 
 	struct mutex			lock;
@@ -35,6 +35,7 @@
 #include <linux/anon_inodes.h>
 #include <linux/device.h>
 #include <linux/freezer.h>
+#include <linux/hrtimer.h>
 #include <linux/uaccess.h>
 #include <asm/io.h>
 #include <asm/mman.h>
@@ -94,7 +95,8 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE)
+#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE | \
+			 EPOLLDEFER)
 
 #define EPOLLINOUT_BITS (POLLIN | POLLOUT)
 
@@ -231,6 +233,17 @@ struct eventpoll {
 	/* used to track busy poll napi_id */
 	unsigned int napi_id;
 #endif
+
+	/* Batches the wakeups of EPOLLDEFER items */
+	struct hrtimer defer_timer;
+
+	/* A waiter was woken up and hasn't looked at the ready list yet */
+	bool wake_pending;
+
+	/* Wakeup statistics shown in fdinfo, protected by "lock" */
+	unsigned long nr_wakeups;
+	unsigned long nr_coalesced;
+	unsigned long nr_deferred;
 };
 
 /* Wait structure used by the poll hooks */
@@ -269,6 +282,9 @@ struct ep_send_events_data {
 /* Maximum number of epoll watched descriptors, per user */
 static long max_user_watches __read_mostly;
 
+/* Longest delay of the wakeup for an EPOLLDEFER event, 0 disables */
+static unsigned int ep_defer_us __read_mostly = 1000;
+
 /*
  * This mutex is used to serialize ep_free() and eventpoll_release_file().
  */
@@ -315,6 +331,13 @@ struct ctl_table epoll_table[] = {
 		.extra1		= &zero,
 		.extra2		= &long_max,
 	},
+	{
+		.procname	= "defer_us",
+		.data		= &ep_defer_us,
+		.maxlen		= sizeof(ep_defer_us),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
+	},
 	{ }
 };
 #endif /* CONFIG_SYSCTL */
@@ -391,6 +414,53 @@ static inline int ep_events_available(struct eventpoll *ep)
 	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
 }
 
+/*
+ * Wake up one waiter of ep->wq, unless one was already woken up and has not
+ * collected the ready list yet: it will find the new events there as well.
+ * Must be called with "lock" held.
+ */
+static void ep_wake_up_locked(struct eventpoll *ep)
+{
+	if (ep->wake_pending) {
+		ep->nr_coalesced++;
+		return;
+	}
+
+	ep->wake_pending = true;
+	ep->nr_wakeups++;
+	wake_up_locked(&ep->wq);
+}
+
+/* Wake up for an EPOLLDEFER event once the batching window has passed */
+static void ep_defer_wake_up_locked(struct eventpoll *ep)
+{
+	unsigned int us = READ_ONCE(ep_defer_us);
+
+	if (!us || ep->wake_pending) {
+		ep_wake_up_locked(ep);
+		return;
+	}
+
+	ep->nr_deferred++;
+	if (!hrtimer_is_queued(&ep->defer_timer))
+		hrtimer_start(&ep->defer_timer, us * NSEC_PER_USEC,
+			      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart ep_defer_timer_fn(struct hrtimer *timer)
+{
+	struct eventpoll *ep = container_of(timer, struct eventpoll,
+					    defer_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (waitqueue_active(&ep->wq) && ep_events_available(ep))
+		ep_wake_up_locked(ep);
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 #ifdef CONFIG_NET_RX_BUSY_POLL
 static bool ep_busy_loop_end(void *p, unsigned long start_time)
 {
@@ -412,7 +482,8 @@ static void ep_busy_loop(struct eventpoll *ep, int nonblock)
 	unsigned int napi_id = READ_ONCE(ep->napi_id);
 
 	if ((napi_id >= MIN_NAPI_ID) && net_busy_loop_on())
-		napi_busy_loop(napi_id, nonblock ? NULL : ep_busy_loop_end, ep);
+		napi_busy_loop(napi_id, nonblock ? NULL : ep_busy_loop_end, ep,
+			       BUSY_POLL_BUDGET);
 #endif
 }
 
@@ -751,7 +822,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		 * the ->poll() wait list (delayed after we release the lock).
 		 */
 		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+			ep_wake_up_locked(ep);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -865,6 +936,7 @@ static void ep_free(struct eventpoll *ep)
 	mutex_unlock(&ep->mtx);
 
 	mutex_unlock(&epmutex);
+	hrtimer_cancel(&ep->defer_timer);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
@@ -978,6 +1050,11 @@ static void ep_show_fdinfo(struct seq_file *m, struct file *f)
 			break;
 	}
 	mutex_unlock(&ep->mtx);
+
+	spin_lock_irq(&ep->lock);
+	seq_printf(m, "wakeups: %lu coalesced: %lu deferred: %lu\n",
+		   ep->nr_wakeups, ep->nr_coalesced, ep->nr_deferred);
+	spin_unlock_irq(&ep->lock);
 }
 #endif
 
@@ -1044,6 +1121,8 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT_CACHED;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+	hrtimer_init(&ep->defer_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ep->defer_timer.function = ep_defer_timer_fn;
 
 	*pep = ep;
 
@@ -1211,7 +1290,10 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 				break;
 			}
 		}
-		wake_up_locked(&ep->wq);
+		if (epi->event.events & EPOLLDEFER)
+			ep_defer_wake_up_locked(ep);
+		else
+			ep_wake_up_locked(ep);
 	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
@@ -1513,7 +1595,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 
 		/* Notify waiting tasks that events are available */
 		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+			ep_wake_up_locked(ep);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -1621,7 +1703,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 
 			/* Notify waiting tasks that events are available */
 			if (waitqueue_active(&ep->wq))
-				wake_up_locked(&ep->wq);
+				ep_wake_up_locked(ep);
 			if (waitqueue_active(&ep->poll_wait))
 				pwake++;
 		}
@@ -1832,6 +1914,8 @@ fetch_events:
 				timed_out = 1;
 
 			spin_lock_irqsave(&ep->lock, flags);
+			/* Events from now on need another wakeup */
+			ep->wake_pending = false;
 		}
 
 		__remove_wait_queue(&ep->wq, &wait);
@@ -62,6 +62,7 @@
 #include <linux/oom.h>
 #include <linux/compat.h>
 #include <linux/vmalloc.h>
+#include <linux/simple_lmk.h>
 
 #include <linux/uaccess.h>
 #include <asm/mmu_context.h>
@@ -1168,6 +1169,7 @@ static int de_thread(struct task_struct *tsk)
 		write_unlock_irq(&tasklist_lock);
 		cgroup_threadgroup_change_end(tsk);
 
+		simple_lmk_task_replace(leader, tsk);
 		release_task(leader);
 	}
 
@@ -646,6 +646,8 @@ enum {
 #define EXT4_IOC_RESIZE_FS		_IOW('f', 16, __u64)
 #define EXT4_IOC_SWAP_BOOT		_IO('f', 17)
 #define EXT4_IOC_PRECACHE_EXTENTS	_IO('f', 18)
+#define EXT4_IOC_SET_WRITE_ONCE		_IO('f', 50)
+#define EXT4_IOC_FRAG_REPORT		_IOR('f', 51, struct ext4_frag_report)
 #define EXT4_IOC_SET_ENCRYPTION_POLICY	FS_IOC_SET_ENCRYPTION_POLICY
 #define EXT4_IOC_GET_ENCRYPTION_PWSALT	FS_IOC_GET_ENCRYPTION_PWSALT
 #define EXT4_IOC_GET_ENCRYPTION_POLICY	FS_IOC_GET_ENCRYPTION_POLICY
@@ -795,6 +797,17 @@ struct move_extent {
 	__u64 moved_len;	/* moved block length */
 };
 
+/*
+ * Structure for EXT4_IOC_FRAG_REPORT, summing up the regular files of a
+ * directory.
+ */
+struct ext4_frag_report {
+	__u64 files;		/* regular files looked at */
+	__u64 blocks;		/* mapped blocks of those files */
+	__u64 runs;		/* physically contiguous runs of blocks */
+	__u64 fragmented;	/* files with more than one run */
+};
+
 #define EXT4_EPOCH_BITS 2
 #define EXT4_EPOCH_MASK ((1 << EXT4_EPOCH_BITS) - 1)
 #define EXT4_NSEC_MASK  (~0UL << EXT4_EPOCH_BITS)
@@ -1051,6 +1064,7 @@ struct ext4_inode_info {
 	ext4_lblk_t i_es_shrink_lblk;	/* Offset where we start searching for
 					   extents to shrink. Protected by
 					   i_es_lock  */
+	unsigned long i_es_access;	/* jiffies of the last lookup hit */
 
 	/* ialloc */
 	ext4_group_t	i_last_alloc_group;
@@ -1467,6 +1481,7 @@ struct ext4_sb_info {
 	/* tunables */
 	unsigned long s_stripe;
 	unsigned int s_mb_stream_request;
+	unsigned int s_mb_write_once_kb;
 	unsigned int s_mb_max_to_scan;
 	unsigned int s_mb_min_to_scan;
 	unsigned int s_mb_stats;
@@ -1534,6 +1549,7 @@ struct ext4_sb_info {
 	struct shrinker s_es_shrinker;
 	struct list_head s_es_list;	/* List of inodes with reclaimable extents */
 	long s_es_nr_inode;
+	unsigned int s_es_min_age;	/* ms an inode is spared after a hit */
 	struct ext4_es_stats s_es_stats;
 	struct mb_cache *s_ea_block_cache;
 	struct mb_cache *s_ea_inode_cache;
@@ -1606,6 +1622,7 @@ enum {
 	EXT4_STATE_EXT_PRECACHED,	/* extents have been precached */
 	EXT4_STATE_LUSTRE_EA_INODE,	/* Lustre-style ea_inode */
 	EXT4_STATE_VERITY_IN_PROGRESS,	/* building fs-verity Merkle tree */
+	EXT4_STATE_WRITE_ONCE,		/* written once, then only read */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field, offset)				\
@@ -548,6 +548,7 @@ __read_extent_tree_block(const char *function, unsigned int line,
 
 	if (!bh_uptodate_or_lock(bh)) {
 		trace_ext4_ext_load_extent(inode, pblk, _RET_IP_);
+		EXT4_SB(inode->i_sb)->s_es_stats.es_stats_tree_reads++;
 		err = bh_submit_read(bh);
 		if (err < 0)
 			goto errout;
@@ -826,6 +826,9 @@ out:
 		es->es_pblk = es1->es_pblk;
 		if (!ext4_es_is_referenced(es1))
 			ext4_es_set_referenced(es1);
+		/* at most one store per tick on a hot inode */
+		if (EXT4_I(inode)->i_es_access != jiffies)
+			EXT4_I(inode)->i_es_access = jiffies;
 		stats->es_stats_cache_hits++;
 	} else {
 		stats->es_stats_cache_misses++;
@@ -977,12 +980,14 @@ static int __es_shrink(struct ext4_sb_info *sbi, int nr_to_scan,
 	struct ext4_es_stats *es_stats;
 	ktime_t start_time;
 	u64 scan_time;
+	unsigned long min_age;
 	int nr_to_walk;
 	int nr_shrunk = 0;
 	int retried = 0, nr_skipped = 0;
 
 	es_stats = &sbi->s_es_stats;
 	start_time = ktime_get();
+	min_age = msecs_to_jiffies(READ_ONCE(sbi->s_es_min_age));
 
 retry:
 	spin_lock(&sbi->s_es_lock);
@@ -1007,6 +1012,18 @@ retry:
 			continue;
 		}
 
+		/*
+		 * Likewise spare inodes whose extents were looked up
+		 * recently, so that a filesystem of many small files does
+		 * not lose the trees of its hot files along with the cold.
+		 */
+		if (!retried && min_age &&
+		    time_before(jiffies, READ_ONCE(ei->i_es_access) + min_age)) {
+			es_stats->es_stats_young_skipped++;
+			nr_skipped++;
+			continue;
+		}
+
 		if (ei == locked_ei || !write_trylock(&ei->i_es_lock)) {
 			nr_skipped++;
 			continue;
@@ -1117,6 +1134,10 @@ int ext4_seq_es_shrinker_info_show(struct seq_file *seq, void *v)
 	seq_printf(seq, "  %lu/%lu cache hits/misses\n",
 		   es_stats->es_stats_cache_hits,
 		   es_stats->es_stats_cache_misses);
+	seq_printf(seq, "  %lu extent tree block reads\n",
+		   es_stats->es_stats_tree_reads);
+	seq_printf(seq, "  %lu recently used inodes skipped\n",
+		   es_stats->es_stats_young_skipped);
 	if (inode_cnt)
 		seq_printf(seq, "  %d inodes on list\n", inode_cnt);
 
@@ -1145,6 +1166,9 @@ int ext4_es_register_shrinker(struct ext4_sb_info *sbi)
 	sbi->s_es_stats.es_stats_shrunk = 0;
 	sbi->s_es_stats.es_stats_cache_hits = 0;
 	sbi->s_es_stats.es_stats_cache_misses = 0;
+	sbi->s_es_stats.es_stats_tree_reads = 0;
+	sbi->s_es_stats.es_stats_young_skipped = 0;
+	sbi->s_es_min_age = 1000;
 	sbi->s_es_stats.es_stats_scan_time = 0;
 	sbi->s_es_stats.es_stats_max_scan_time = 0;
 	err = percpu_counter_init(&sbi->s_es_stats.es_stats_all_cnt, 0, GFP_KERNEL);
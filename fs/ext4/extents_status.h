@@ -72,6 +72,8 @@ struct ext4_es_stats {
 	unsigned long es_stats_shrunk;
 	unsigned long es_stats_cache_hits;
 	unsigned long es_stats_cache_misses;
+	unsigned long es_stats_tree_reads;
+	unsigned long es_stats_young_skipped;
 	u64 es_stats_scan_time;
 	u64 es_stats_max_scan_time;
 	struct percpu_counter es_stats_all_cnt;
@@ -667,6 +667,107 @@ static int ext4_ioctl_check_project(struct inode *inode, struct fsxattr *fa)
 	return 0;
 }
 
+struct ext4_frag_ctx {
+	struct dir_context ctx;
+	struct super_block *sb;
+	struct ext4_frag_report rep;
+	int err;
+};
+
+/* Count the physically contiguous runs of the mapped blocks of @inode */
+static void ext4_frag_count(struct inode *inode, struct ext4_frag_report *rep)
+{
+	struct ext4_map_blocks map;
+	ext4_lblk_t lblk = 0, end;
+	ext4_fsblk_t next = 0;
+	u64 runs = 0;
+	int ret;
+
+	end = (i_size_read(inode) + inode->i_sb->s_blocksize - 1) >>
+		inode->i_blkbits;
+	while (lblk < end) {
+		map.m_lblk = lblk;
+		map.m_len = end - lblk;
+		map.m_flags = 0;
+		ret = ext4_map_blocks(NULL, inode, &map, 0);
+		if (ret < 0)
+			break;
+		if (ret > 0) {
+			if (map.m_pblk != next)
+				runs++;
+			next = map.m_pblk + map.m_len;
+			rep->blocks += map.m_len;
+		}
+		/* for a hole m_len is the length of the hole */
+		lblk += max(map.m_len, 1U);
+	}
+
+	rep->files++;
+	rep->runs += runs;
+	if (runs > 1)
+		rep->fragmented++;
+}
+
+static int ext4_frag_filldir(struct dir_context *ctx, const char *name,
+			     int namelen, loff_t offset, u64 ino,
+			     unsigned int d_type)
+{
+	struct ext4_frag_ctx *fc = container_of(ctx, struct ext4_frag_ctx, ctx);
+	struct inode *inode;
+
+	if (d_type != DT_REG && d_type != DT_UNKNOWN)
+		return 0;
+	if (fatal_signal_pending(current)) {
+		fc->err = -EINTR;
+		return -EINTR;
+	}
+
+	inode = ext4_iget(fc->sb, ino, EXT4_IGET_NORMAL);
+	if (IS_ERR(inode))
+		return 0;
+	if (S_ISREG(inode->i_mode) && !ext4_has_inline_data(inode))
+		ext4_frag_count(inode, &fc->rep);
+	iput(inode);
+	cond_resched();
+	return 0;
+}
+
+/*
+ * Report how fragmented the regular files directly in a directory are,
+ * e.g. to check an application's install directory.
+ */
+static int ext4_ioctl_frag_report(struct file *filp,
+				  struct ext4_frag_report __user *urep)
+{
+	struct ext4_frag_ctx fc = {
+		.ctx.actor = ext4_frag_filldir,
+		.sb = file_inode(filp)->i_sb,
+	};
+	struct file *dir;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	if (!S_ISDIR(file_inode(filp)->i_mode))
+		return -ENOTDIR;
+
+	/* walk a file of our own so the caller's readdir position is kept */
+	dir = dentry_open(&filp->f_path, O_RDONLY | O_DIRECTORY,
+			  current_cred());
+	if (IS_ERR(dir))
+		return PTR_ERR(dir);
+	err = iterate_dir(dir, &fc.ctx);
+	fput(dir);
+	if (!err)
+		err = fc.err;
+	if (err)
+		return err;
+
+	if (copy_to_user(urep, &fc.rep, sizeof(fc.rep)))
+		return -EFAULT;
+	return 0;
+}
+
 long ext4_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	struct inode *inode = file_inode(filp);
@@ -1167,6 +1268,18 @@ out:
 	case EXT4_IOC_SHUTDOWN:
 		return ext4_shutdown(sb, arg);
 
+	case EXT4_IOC_SET_WRITE_ONCE:
+		/* only kept in memory, so set it right after creating the file */
+		if (!S_ISREG(inode->i_mode))
+			return -EINVAL;
+		if (!inode_owner_or_capable(inode))
+			return -EACCES;
+		ext4_set_inode_state(inode, EXT4_STATE_WRITE_ONCE);
+		return 0;
+
+	case EXT4_IOC_FRAG_REPORT:
+		return ext4_ioctl_frag_report(filp, (void __user *)arg);
+
 	case FS_IOC_ENABLE_VERITY:
 		if (!ext4_has_feature_verity(sb))
 			return -EOPNOTSUPP;
@@ -1250,6 +1363,8 @@ long ext4_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case FS_IOC_GET_ENCRYPTION_KEY_STATUS:
 	case FS_IOC_GET_ENCRYPTION_NONCE:
 	case EXT4_IOC_SHUTDOWN:
+	case EXT4_IOC_SET_WRITE_ONCE:
+	case EXT4_IOC_FRAG_REPORT:
 	case FS_IOC_GETFSMAP:
 	case FS_IOC_ENABLE_VERITY:
 	case FS_IOC_MEASURE_VERITY:
@@ -2667,6 +2667,7 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_min_to_scan = MB_DEFAULT_MIN_TO_SCAN;
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
+	sbi->s_mb_write_once_kb = MB_DEFAULT_WRITE_ONCE_KB;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	/*
 	 * The default group preallocation is 512, which for 4k block
@@ -3150,6 +3151,14 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	size = size << bsbits;
 	if (size < i_size_read(ac->ac_inode))
 		size = i_size_read(ac->ac_inode);
+	/*
+	 * Files marked write-once are usually written in one go right
+	 * after creation, so reserve a larger window up front and let the
+	 * rest of the file land next to its first blocks.
+	 */
+	if (ext4_test_inode_state(ac->ac_inode, EXT4_STATE_WRITE_ONCE))
+		size = max_t(loff_t, size,
+			     (loff_t)sbi->s_mb_write_once_kb << 10);
 	orig_size = size;
 
 	/* max size of free chunks */
@@ -4244,6 +4253,14 @@ static void ext4_mb_group_or_file(struct ext4_allocation_context *ac)
 		return;
 	}
 
+	/*
+	 * Small write-once files get per-inode preallocation too, so files
+	 * written concurrently on one CPU do not interleave in the locality
+	 * group's space.
+	 */
+	if (ext4_test_inode_state(ac->ac_inode, EXT4_STATE_WRITE_ONCE))
+		return;
+
 	/* don't use group allocation for large files */
 	size = max(size, isize);
 	if (size > sbi->s_mb_stream_request) {
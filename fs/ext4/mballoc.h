@@ -67,6 +67,12 @@ do {									\
  */
 #define MB_DEFAULT_STREAM_THRESHOLD	16	/* 64K */
 
+/*
+ * smallest normalized request, in kilobytes, for files marked with
+ * EXT4_IOC_SET_WRITE_ONCE
+ */
+#define MB_DEFAULT_WRITE_ONCE_KB	1024
+
 /*
  * for which requests use 2^N search using buddies
  */
@@ -161,11 +161,118 @@ void f2fs_compress_ctx_add_page(struct compress_ctx *cc, struct page *page)
 	cc->cluster_idx = cluster_idx(cc, page->index);
 }
 
+/*
+ * Compression workspaces are needed for every cluster written back (and
+ * for every zstd cluster read), so keep the last released one of each kind
+ * per cpu instead of going back to vmalloc each time.  Idle workspaces are
+ * given back to the system from the shrinker.
+ */
+enum {
+	F2FS_WS_LZO,
+	F2FS_WS_LZ4,
+	F2FS_WS_ZSTD_C,
+	F2FS_WS_ZSTD_D,
+	NR_F2FS_WS,
+};
+
+struct f2fs_workspace {
+	u64 size;			/* usable size of buf */
+	char buf[];
+};
+
+static bool workspace_cache = true;
+module_param(workspace_cache, bool, 0644);
+MODULE_PARM_DESC(workspace_cache,
+		"Keep per-cpu compression workspaces around for reuse");
+
+static DEFINE_PER_CPU(struct f2fs_workspace *, f2fs_workspaces[NR_F2FS_WS]);
+static atomic_t f2fs_cached_workspaces = ATOMIC_INIT(0);
+
+static void *f2fs_workspace_get(struct f2fs_sb_info *sbi, int type,
+							size_t size)
+{
+	struct f2fs_workspace *ws;
+
+	/* any cpu's slot is fine to take from, xchg keeps it exclusive */
+	ws = xchg(raw_cpu_ptr(&f2fs_workspaces[type]), NULL);
+	if (ws) {
+		atomic_dec(&f2fs_cached_workspaces);
+		if (ws->size >= size)
+			return ws->buf;
+		kvfree(ws);
+	}
+
+	ws = f2fs_kvmalloc(sbi, sizeof(*ws) + size, GFP_NOFS);
+	if (!ws)
+		return NULL;
+	ws->size = size;
+	return ws->buf;
+}
+
+static void f2fs_workspace_put(int type, void *buf)
+{
+	struct f2fs_workspace *ws;
+
+	if (!buf)
+		return;
+
+	ws = container_of(buf, struct f2fs_workspace, buf);
+	if (READ_ONCE(workspace_cache) &&
+	    !cmpxchg(raw_cpu_ptr(&f2fs_workspaces[type]), NULL, ws)) {
+		atomic_inc(&f2fs_cached_workspaces);
+		return;
+	}
+	kvfree(ws);
+}
+
+static unsigned long f2fs_workspace_count(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	return atomic_read(&f2fs_cached_workspaces);
+}
+
+static unsigned long f2fs_workspace_scan(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	struct f2fs_workspace *ws;
+	unsigned long freed = 0;
+	int cpu, type;
+
+	for_each_possible_cpu(cpu) {
+		for (type = 0; type < NR_F2FS_WS; type++) {
+			if (freed >= sc->nr_to_scan)
+				return freed;
+
+			ws = xchg(per_cpu_ptr(&f2fs_workspaces[type], cpu),
+									NULL);
+			if (!ws)
+				continue;
+			atomic_dec(&f2fs_cached_workspaces);
+			kvfree(ws);
+			freed++;
+		}
+	}
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker f2fs_workspace_shrinker = {
+	.count_objects = f2fs_workspace_count,
+	.scan_objects = f2fs_workspace_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static void f2fs_destroy_workspaces(void)
+{
+	struct shrink_control sc = { .nr_to_scan = ULONG_MAX };
+
+	f2fs_workspace_scan(&f2fs_workspace_shrinker, &sc);
+}
+
 #ifdef CONFIG_F2FS_FS_LZO
 static int lzo_init_compress_ctx(struct compress_ctx *cc)
 {
-	cc->private = f2fs_kvmalloc(F2FS_I_SB(cc->inode),
-				LZO1X_MEM_COMPRESS, GFP_NOFS);
+	cc->private = f2fs_workspace_get(F2FS_I_SB(cc->inode), F2FS_WS_LZO,
+						LZO1X_MEM_COMPRESS);
 	if (!cc->private)
 		return -ENOMEM;
 
@@ -175,7 +282,7 @@ static int lzo_init_compress_ctx(struct compress_ctx *cc)
 
 static void lzo_destroy_compress_ctx(struct compress_ctx *cc)
 {
-	kvfree(cc->private);
+	f2fs_workspace_put(F2FS_WS_LZO, cc->private);
 	cc->private = NULL;
 }
 
@@ -227,8 +334,8 @@ static const struct f2fs_compress_ops f2fs_lzo_ops = {
 #ifdef CONFIG_F2FS_FS_LZ4
 static int lz4_init_compress_ctx(struct compress_ctx *cc)
 {
-	cc->private = f2fs_kvmalloc(F2FS_I_SB(cc->inode),
-				LZ4_MEM_COMPRESS, GFP_NOFS);
+	cc->private = f2fs_workspace_get(F2FS_I_SB(cc->inode), F2FS_WS_LZ4,
+						LZ4_MEM_COMPRESS);
 	if (!cc->private)
 		return -ENOMEM;
 
@@ -243,7 +350,7 @@ static int lz4_init_compress_ctx(struct compress_ctx *cc)
 
 static void lz4_destroy_compress_ctx(struct compress_ctx *cc)
 {
-	kvfree(cc->private);
+	f2fs_workspace_put(F2FS_WS_LZ4, cc->private);
 	cc->private = NULL;
 }
 
@@ -304,8 +411,8 @@ static int zstd_init_compress_ctx(struct compress_ctx *cc)
 	params = ZSTD_getParams(F2FS_ZSTD_DEFAULT_CLEVEL, cc->rlen, 0);
 	workspace_size = ZSTD_CStreamWorkspaceBound(params.cParams);
 
-	workspace = f2fs_kvmalloc(F2FS_I_SB(cc->inode),
-					workspace_size, GFP_NOFS);
+	workspace = f2fs_workspace_get(F2FS_I_SB(cc->inode), F2FS_WS_ZSTD_C,
+							workspace_size);
 	if (!workspace)
 		return -ENOMEM;
 
@@ -314,7 +421,7 @@ static int zstd_init_compress_ctx(struct compress_ctx *cc)
 		printk_ratelimited("%sF2FS-fs (%s): %s ZSTD_initCStream failed\n",
 				KERN_ERR, F2FS_I_SB(cc->inode)->sb->s_id,
 				__func__);
-		kvfree(workspace);
+		f2fs_workspace_put(F2FS_WS_ZSTD_C, workspace);
 		return -EIO;
 	}
 
@@ -327,7 +434,7 @@ static int zstd_init_compress_ctx(struct compress_ctx *cc)
 
 static void zstd_destroy_compress_ctx(struct compress_ctx *cc)
 {
-	kvfree(cc->private);
+	f2fs_workspace_put(F2FS_WS_ZSTD_C, cc->private);
 	cc->private = NULL;
 	cc->private2 = NULL;
 }
@@ -384,8 +491,8 @@ static int zstd_init_decompress_ctx(struct decompress_io_ctx *dic)
 
 	workspace_size = ZSTD_DStreamWorkspaceBound(MAX_COMPRESS_WINDOW_SIZE);
 
-	workspace = f2fs_kvmalloc(F2FS_I_SB(dic->inode),
-					workspace_size, GFP_NOFS);
+	workspace = f2fs_workspace_get(F2FS_I_SB(dic->inode), F2FS_WS_ZSTD_D,
+							workspace_size);
 	if (!workspace)
 		return -ENOMEM;
 
@@ -395,7 +502,7 @@ static int zstd_init_decompress_ctx(struct decompress_io_ctx *dic)
 		printk_ratelimited("%sF2FS-fs (%s): %s ZSTD_initDStream failed\n",
 				KERN_ERR, F2FS_I_SB(dic->inode)->sb->s_id,
 				__func__);
-		kvfree(workspace);
+		f2fs_workspace_put(F2FS_WS_ZSTD_D, workspace);
 		return -EIO;
 	}
 
@@ -407,7 +514,7 @@ static int zstd_init_decompress_ctx(struct decompress_io_ctx *dic)
 
 static void zstd_destroy_decompress_ctx(struct decompress_io_ctx *dic)
 {
-	kvfree(dic->private);
+	f2fs_workspace_put(F2FS_WS_ZSTD_D, dic->private);
 	dic->private = NULL;
 	dic->private2 = NULL;
 }
@@ -488,17 +595,65 @@ module_param(num_compress_pages, uint, 0444);
 MODULE_PARM_DESC(num_compress_pages,
 		"Number of intermediate compress pages to preallocate");
 
+/*
+ * Per-cpu scratch space used to decompress the smallest clusters straight
+ * from read completion, where vmap() is not allowed: the compressed pages
+ * are copied into the second half, decompressed into the first half and
+ * copied out to the cluster pages.
+ */
+static DEFINE_PER_CPU(void *, inline_decompress_buf);
+
+static void f2fs_destroy_inline_decompress_buf(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		vfree(per_cpu(inline_decompress_buf, cpu));
+		per_cpu(inline_decompress_buf, cpu) = NULL;
+	}
+}
+
+static int f2fs_init_inline_decompress_buf(void)
+{
+	void *buf;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		buf = vmalloc_node(2 * F2FS_INLINE_DECOMPRESS_PAGES * PAGE_SIZE,
+				   cpu_to_node(cpu));
+		if (!buf) {
+			f2fs_destroy_inline_decompress_buf();
+			return -ENOMEM;
+		}
+		per_cpu(inline_decompress_buf, cpu) = buf;
+	}
+	return 0;
+}
+
 int f2fs_init_compress_mempool(void)
 {
 	compress_page_pool = mempool_create_page_pool(num_compress_pages, 0);
 	if (!compress_page_pool)
 		return -ENOMEM;
 
+	/* without scratch space every cluster goes through the workqueue */
+	if (f2fs_init_inline_decompress_buf())
+		pr_warn("F2FS-fs: inline decompression disabled\n");
+
+	if (register_shrinker(&f2fs_workspace_shrinker)) {
+		f2fs_destroy_inline_decompress_buf();
+		mempool_destroy(compress_page_pool);
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
 void f2fs_destroy_compress_mempool(void)
 {
+	unregister_shrinker(&f2fs_workspace_shrinker);
+	f2fs_destroy_workspaces();
+	f2fs_destroy_inline_decompress_buf();
 	mempool_destroy(compress_page_pool);
 }
 
@@ -630,6 +785,67 @@ out:
 	return ret;
 }
 
+/*
+ * Small clusters of algorithms that need no decompression context can be
+ * decompressed from softirq context, see f2fs_decompress_atomic().
+ */
+bool f2fs_decompress_inline_ok(struct page *page)
+{
+	struct decompress_io_ctx *dic =
+			(struct decompress_io_ctx *)page_private(page);
+	struct f2fs_inode_info *fi = F2FS_I(dic->inode);
+	const struct f2fs_compress_ops *cops =
+			f2fs_cops[fi->i_compress_algorithm];
+
+	return dic->cluster_size <= F2FS_INLINE_DECOMPRESS_PAGES &&
+		!cops->init_decompress_ctx &&
+		this_cpu_read(inline_decompress_buf);
+}
+
+static int f2fs_decompress_atomic(struct decompress_io_ctx *dic,
+				const struct f2fs_compress_ops *cops)
+{
+	void *rbuf = this_cpu_read(inline_decompress_buf);
+	void *cbuf = rbuf + F2FS_INLINE_DECOMPRESS_PAGES * PAGE_SIZE;
+	void *kaddr;
+	int i, ret;
+
+	if (WARN_ON_ONCE(!rbuf ||
+			dic->cluster_size > F2FS_INLINE_DECOMPRESS_PAGES ||
+			dic->nr_cpages > F2FS_INLINE_DECOMPRESS_PAGES))
+		return -EINVAL;
+
+	for (i = 0; i < dic->nr_cpages; i++) {
+		kaddr = kmap_atomic(dic->cpages[i]);
+		memcpy(cbuf + i * PAGE_SIZE, kaddr, PAGE_SIZE);
+		kunmap_atomic(kaddr);
+	}
+
+	dic->rbuf = rbuf;
+	dic->cbuf = cbuf;
+	dic->clen = le32_to_cpu(dic->cbuf->clen);
+	dic->rlen = PAGE_SIZE << dic->log_cluster_size;
+
+	if (dic->clen > PAGE_SIZE * dic->nr_cpages - COMPRESS_HEADER_SIZE) {
+		ret = -EFSCORRUPTED;
+		goto out;
+	}
+
+	ret = cops->decompress_pages(dic);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < dic->cluster_size; i++) {
+		kaddr = kmap_atomic(dic->tpages[i]);
+		memcpy(kaddr, rbuf + i * PAGE_SIZE, PAGE_SIZE);
+		kunmap_atomic(kaddr);
+	}
+out:
+	dic->rbuf = NULL;
+	dic->cbuf = NULL;
+	return ret;
+}
+
 void f2fs_decompress_pages(struct bio *bio, struct page *page, bool verity)
 {
 	struct decompress_io_ctx *dic =
@@ -657,6 +873,13 @@ void f2fs_decompress_pages(struct bio *bio, struct page *page, bool verity)
 		goto out_free_dic;
 	}
 
+	/* called from f2fs_read_end_io() for clusters that passed
+	 * f2fs_decompress_inline_ok() */
+	if (!in_task()) {
+		ret = f2fs_decompress_atomic(dic, cops);
+		goto out_free_dic;
+	}
+
 	if (cops->init_decompress_ctx) {
 		ret = cops->init_decompress_ctx(dic);
 		if (ret)
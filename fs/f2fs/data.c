@@ -18,11 +18,14 @@
 #include <linux/prefetch.h>
 #include <linux/uio.h>
 #include <linux/cleancache.h>
+#include <linux/lat_hist.h>
 #include <linux/sched/signal.h>
+#include <linux/topology.h>
 
 #include "f2fs.h"
 #include "node.h"
 #include "segment.h"
+#include "gc.h"
 #include "trace.h"
 #include <trace/events/f2fs.h>
 #include <trace/events/android_fs.h>
@@ -126,6 +129,8 @@ struct bio_post_read_ctx {
 	struct f2fs_sb_info *sbi;
 	struct work_struct work;
 	unsigned int enabled_steps;
+	ktime_t end_io_time;		/* when the read bio completed */
+	int cpu;			/* cpu which submitted the read */
 };
 
 static void __read_end_io(struct bio *bio, bool compr, bool verity)
@@ -259,6 +264,21 @@ static void f2fs_verity_work(struct work_struct *work)
 	__f2fs_read_end_io(bio, false, false);
 }
 
+static void f2fs_account_decompress(struct bio_post_read_ctx *ctx, int path)
+{
+	struct f2fs_sb_info *sbi = ctx->sbi;
+	u64 delta = ktime_to_ns(ktime_sub(ktime_get(), ctx->end_io_time));
+
+	atomic64_inc(&sbi->decompress_cnt[path]);
+	atomic64_add(delta, &sbi->decompress_ns[path]);
+	/* racy, but only used for stats */
+	if (delta > READ_ONCE(sbi->decompress_max_ns[path]))
+		WRITE_ONCE(sbi->decompress_max_ns[path], delta);
+}
+
+/* from read bio completion to the end of decryption and decompression */
+static DEFINE_LAT_HIST(f2fs_post_read_hist, "f2fs_post_read");
+
 static void f2fs_post_read_work(struct work_struct *work)
 {
 	struct bio_post_read_ctx *ctx =
@@ -267,8 +287,14 @@ static void f2fs_post_read_work(struct work_struct *work)
 	if (ctx->enabled_steps & (1 << STEP_DECRYPT))
 		f2fs_decrypt_work(ctx);
 
-	if (ctx->enabled_steps & (1 << STEP_DECOMPRESS))
+	if (ctx->enabled_steps & (1 << STEP_DECOMPRESS)) {
 		f2fs_decompress_work(ctx);
+		f2fs_account_decompress(ctx, DECOMPRESS_WQ);
+	}
+
+	if (lat_hist_enabled())
+		lat_hist_add(&f2fs_post_read_hist,
+			ktime_to_ns(ktime_sub(ktime_get(), ctx->end_io_time)));
 
 	if (ctx->enabled_steps & (1 << STEP_VERITY)) {
 		INIT_WORK(&ctx->work, f2fs_verity_work);
@@ -286,6 +312,53 @@ static void f2fs_enqueue_post_read_work(struct f2fs_sb_info *sbi,
 	queue_work(sbi->post_read_wq, work);
 }
 
+/*
+ * Run decompression on the cpu which submitted the read, so the
+ * decompressed pages are warm in the cache of the reader; if that cpu
+ * went away, stay in its cluster.
+ */
+static void f2fs_enqueue_decompress_work(struct bio_post_read_ctx *ctx)
+{
+	struct f2fs_sb_info *sbi = ctx->sbi;
+	int cpu = ctx->cpu;
+
+	if (!sbi->decompress_wq)
+		goto unbound;
+
+	if (!cpu_online(cpu)) {
+		cpu = cpumask_any_and(topology_core_cpumask(cpu),
+						cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			goto unbound;
+	}
+	queue_work_on(cpu, sbi->decompress_wq, &ctx->work);
+	return;
+unbound:
+	f2fs_enqueue_post_read_work(sbi, &ctx->work);
+}
+
+/*
+ * Small clusters of simple algorithms are cheap enough to decompress
+ * right from the bio completion instead of paying for a context switch.
+ */
+static bool f2fs_bio_decompress_inline(struct bio_post_read_ctx *ctx)
+{
+	struct bio_vec *bv;
+	int i;
+
+	if (!ctx->sbi->inline_decompress || in_irq())
+		return false;
+
+	bio_for_each_segment_all(bv, ctx->bio, i) {
+		struct page *page = bv->bv_page;
+
+		if (f2fs_is_compressed_page(page) &&
+				!f2fs_decompress_inline_ok(page))
+			return false;
+	}
+	return true;
+}
+
 static void bio_post_read_processing(struct bio_post_read_ctx *ctx)
 {
 	/*
@@ -294,6 +367,20 @@ static void bio_post_read_processing(struct bio_post_read_ctx *ctx)
 	 * we shouldn't recurse to the same workqueue.
 	 */
 
+	if (ctx->enabled_steps & (1 << STEP_DECOMPRESS) &&
+		!(ctx->enabled_steps & (1 << STEP_DECRYPT)) &&
+		!(ctx->enabled_steps & (1 << STEP_VERITY))) {
+		INIT_WORK(&ctx->work, f2fs_post_read_work);
+		if (!f2fs_bio_decompress_inline(ctx)) {
+			f2fs_enqueue_decompress_work(ctx);
+			return;
+		}
+		f2fs_decompress_bio(ctx->bio, false);
+		f2fs_account_decompress(ctx, DECOMPRESS_INLINE);
+		__f2fs_read_end_io(ctx->bio, true, false);
+		return;
+	}
+
 	if (ctx->enabled_steps & (1 << STEP_DECRYPT) ||
 		ctx->enabled_steps & (1 << STEP_DECOMPRESS)) {
 		INIT_WORK(&ctx->work, f2fs_post_read_work);
@@ -328,6 +415,7 @@ static void f2fs_read_end_io(struct bio *bio)
 	if (f2fs_bio_post_read_required(bio)) {
 		struct bio_post_read_ctx *ctx = bio->bi_private;
 
+		ctx->end_io_time = ktime_get();
 		bio_post_read_processing(ctx);
 		return;
 	}
@@ -445,6 +533,21 @@ static bool __same_bdev(struct f2fs_sb_info *sbi,
 	return bio->bi_disk == b->bd_disk && bio->bi_partno == b->bd_partno;
 }
 
+static enum bio_wb_class f2fs_io_type_to_wb_class(enum iostat_type io_type)
+{
+	switch (io_type) {
+	case FS_GC_DATA_IO:
+	case FS_GC_NODE_IO:
+		return BIO_WB_GC;
+	case FS_CP_DATA_IO:
+	case FS_CP_NODE_IO:
+	case FS_CP_META_IO:
+		return BIO_WB_CHECKPOINT;
+	default:
+		return BIO_WB_USER;
+	}
+}
+
 static struct bio *__bio_alloc(struct f2fs_io_info *fio, int npages)
 {
 	struct f2fs_sb_info *sbi = fio->sbi;
@@ -461,6 +564,7 @@ static struct bio *__bio_alloc(struct f2fs_io_info *fio, int npages)
 		bio->bi_private = sbi;
 		bio->bi_write_hint = f2fs_io_type_to_rw_hint(sbi,
 						fio->type, fio->temp);
+		bio_set_wb_class(bio, f2fs_io_type_to_wb_class(fio->io_type));
 	}
 	if (fio->io_wbc)
 		wbc_init_bio(fio->io_wbc, bio);
@@ -787,6 +891,9 @@ static bool io_type_is_mergeable(struct f2fs_bio_info *io,
 {
 	if (io->fio.op != fio->op)
 		return false;
+	if (f2fs_io_type_to_wb_class(io->fio.io_type) !=
+	    f2fs_io_type_to_wb_class(fio->io_type))
+		return false;
 	return io->fio.op_flags == fio->op_flags;
 }
 
@@ -1063,6 +1170,32 @@ static inline bool f2fs_need_verity(const struct inode *inode, pgoff_t idx)
 	       idx < DIV_ROUND_UP(inode->i_size, PAGE_SIZE);
 }
 
+/*
+ * Remember when user data was last read from a segment, for the victim
+ * selection of background GC, and when anyone but GC read at all.
+ */
+static void f2fs_update_read_heat(struct f2fs_sb_info *sbi,
+							block_t blkaddr)
+{
+	struct seg_entry *se;
+	unsigned long long now;
+
+	if (sbi->gc_thread && current == sbi->gc_thread->f2fs_gc_task)
+		return;
+
+	if (READ_ONCE(sbi->last_fg_read) != jiffies)
+		WRITE_ONCE(sbi->last_fg_read, jiffies);
+
+	if (!sbi->gc_read_hot_age || blkaddr < MAIN_BLKADDR(sbi) ||
+			blkaddr >= MAX_BLKADDR(sbi))
+		return;
+
+	se = get_seg_entry(sbi, GET_SEGNO(sbi, blkaddr));
+	now = get_mtime(sbi, false);
+	if (READ_ONCE(se->rtime) != now)
+		WRITE_ONCE(se->rtime, now);
+}
+
 static struct bio *f2fs_grab_read_bio(struct inode *inode, block_t blkaddr,
 				      unsigned nr_pages, unsigned op_flag,
 				      pgoff_t first_idx, bool for_write)
@@ -1090,12 +1223,15 @@ static struct bio *f2fs_grab_read_bio(struct inode *inode, block_t blkaddr,
 	if (f2fs_need_verity(inode, first_idx))
 		post_read_steps |= 1 << STEP_VERITY;
 
+	f2fs_update_read_heat(sbi, blkaddr);
+
 	if (post_read_steps) {
 		/* Due to the mempool, this never fails. */
 		ctx = mempool_alloc(bio_post_read_ctx_pool, GFP_NOFS);
 		ctx->bio = bio;
 		ctx->sbi = sbi;
 		ctx->enabled_steps = post_read_steps;
+		ctx->cpu = raw_smp_processor_id();
 		bio->bi_private = ctx;
 	}
 
@@ -4096,6 +4232,7 @@ int __init f2fs_init_post_read_processing(void)
 					 bio_post_read_ctx_cache);
 	if (!bio_post_read_ctx_pool)
 		goto fail_free_cache;
+	lat_hist_register(&f2fs_post_read_hist);
 	return 0;
 
 fail_free_cache:
@@ -4106,6 +4243,7 @@ fail:
 
 void f2fs_destroy_post_read_processing(void)
 {
+	lat_hist_unregister(&f2fs_post_read_hist);
 	mempool_destroy(bio_post_read_ctx_pool);
 	kmem_cache_destroy(bio_post_read_ctx_cache);
 }
@@ -4122,11 +4260,23 @@ int f2fs_init_post_read_wq(struct f2fs_sb_info *sbi)
 						 num_online_cpus());
 	if (!sbi->post_read_wq)
 		return -ENOMEM;
+
+	if (f2fs_sb_has_compression(sbi)) {
+		sbi->decompress_wq = alloc_workqueue("f2fs_decompress_wq",
+							WQ_HIGHPRI, 0);
+		if (!sbi->decompress_wq) {
+			destroy_workqueue(sbi->post_read_wq);
+			sbi->post_read_wq = NULL;
+			return -ENOMEM;
+		}
+	}
 	return 0;
 }
 
 void f2fs_destroy_post_read_wq(struct f2fs_sb_info *sbi)
 {
+	if (sbi->decompress_wq)
+		destroy_workqueue(sbi->decompress_wq);
 	if (sbi->post_read_wq)
 		destroy_workqueue(sbi->post_read_wq);
 }
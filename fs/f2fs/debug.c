@@ -76,7 +76,9 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->hit_largest = atomic64_read(&sbi->read_hit_largest);
 	si->hit_cached = atomic64_read(&sbi->read_hit_cached);
 	si->hit_rbtree = atomic64_read(&sbi->read_hit_rbtree);
-	si->hit_total = si->hit_largest + si->hit_cached + si->hit_rbtree;
+	si->hit_frozen = atomic64_read(&sbi->read_hit_frozen);
+	si->hit_total = si->hit_largest + si->hit_cached + si->hit_rbtree +
+							si->hit_frozen;
 	si->total_ext = atomic64_read(&sbi->total_hit_ext);
 	si->ext_tree = atomic_read(&sbi->total_ext_tree);
 	si->zombie_tree = atomic_read(&sbi->total_zombie_tree);
@@ -132,6 +134,15 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->inline_dir = atomic_read(&sbi->inline_dir);
 	si->compr_inode = atomic_read(&sbi->compr_inode);
 	si->compr_blocks = atomic_read(&sbi->compr_blocks);
+	for (i = 0; i < NR_DECOMPRESS_PATH; i++) {
+		u64 cnt = atomic64_read(&sbi->decompress_cnt[i]);
+		u64 ns = atomic64_read(&sbi->decompress_ns[i]);
+
+		si->decompress_cnt[i] = cnt;
+		si->decompress_avg_us[i] = cnt ? div64_u64(ns, cnt) / 1000 : 0;
+		si->decompress_max_us[i] =
+			div_u64(READ_ONCE(sbi->decompress_max_ns[i]), 1000);
+	}
 	si->append = sbi->im[APPEND_INO].ino_num;
 	si->update = sbi->im[UPDATE_INO].ino_num;
 	si->orphans = sbi->im[ORPHAN_INO].ino_num;
@@ -154,6 +165,7 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->alloc_nids = NM_I(sbi)->nid_cnt[PREALLOC_NID];
 	si->io_skip_bggc = sbi->io_skip_bggc;
 	si->other_skip_bggc = sbi->other_skip_bggc;
+	si->hot_skip_bggc = sbi->hot_skip_bggc;
 	si->skipped_atomic_files[BG_GC] = sbi->skipped_atomic_files[BG_GC];
 	si->skipped_atomic_files[FG_GC] = sbi->skipped_atomic_files[FG_GC];
 	si->util_free = (int)(free_user_blocks(sbi) >> sbi->log_blocks_per_seg)
@@ -324,6 +336,14 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->inline_dir);
 		seq_printf(s, "  - Compressed Inode: %u, Blocks: %u\n",
 			   si->compr_inode, si->compr_blocks);
+		seq_printf(s, "  - Decompress Inline: %llu, avg: %llu us, max: %llu us\n",
+			   si->decompress_cnt[DECOMPRESS_INLINE],
+			   si->decompress_avg_us[DECOMPRESS_INLINE],
+			   si->decompress_max_us[DECOMPRESS_INLINE]);
+		seq_printf(s, "  - Decompress Worker: %llu, avg: %llu us, max: %llu us\n",
+			   si->decompress_cnt[DECOMPRESS_WQ],
+			   si->decompress_avg_us[DECOMPRESS_WQ],
+			   si->decompress_max_us[DECOMPRESS_WQ]);
 		seq_printf(s, "  - Orphan/Append/Update Inode: %u, %u, %u\n",
 			   si->orphans, si->append, si->update);
 		seq_printf(s, "\nMain area: %d segs, %d secs %d zones\n",
@@ -384,12 +404,13 @@ static int stat_show(struct seq_file *s, void *v)
 				si->skipped_atomic_files[BG_GC] +
 				si->skipped_atomic_files[FG_GC],
 				si->skipped_atomic_files[BG_GC]);
-		seq_printf(s, "BG skip : IO: %u, Other: %u\n",
-				si->io_skip_bggc, si->other_skip_bggc);
+		seq_printf(s, "BG skip : IO: %u, Other: %u, Read hot: %u\n",
+				si->io_skip_bggc, si->other_skip_bggc,
+				si->hot_skip_bggc);
 		seq_puts(s, "\nExtent Cache:\n");
-		seq_printf(s, "  - Hit Count: L1-1:%llu L1-2:%llu L2:%llu\n",
+		seq_printf(s, "  - Hit Count: L1-1:%llu L1-2:%llu L2:%llu Frozen:%llu\n",
 				si->hit_largest, si->hit_cached,
-				si->hit_rbtree);
+				si->hit_rbtree, si->hit_frozen);
 		seq_printf(s, "  - Hit Ratio: %llu%% (%llu / %llu)\n",
 				!si->total_ext ? 0 :
 				div64_u64(si->hit_total * 100, si->total_ext),
@@ -508,6 +529,7 @@ int f2fs_build_stats(struct f2fs_sb_info *sbi)
 	atomic64_set(&sbi->read_hit_rbtree, 0);
 	atomic64_set(&sbi->read_hit_largest, 0);
 	atomic64_set(&sbi->read_hit_cached, 0);
+	atomic64_set(&sbi->read_hit_frozen, 0);
 
 	atomic_set(&sbi->inline_xattr, 0);
 	atomic_set(&sbi->inline_inode, 0);
@@ -314,6 +314,56 @@ static unsigned int __free_extent_tree(struct f2fs_sb_info *sbi,
 	return count - atomic_read(&et->node_cnt);
 }
 
+static void __free_extent_array(struct rcu_head *head)
+{
+	kvfree(container_of(head, struct extent_array, rcu));
+}
+
+/* caller holds et->lock for write */
+static void __drop_frozen_extents(struct extent_tree *et)
+{
+	struct extent_array *ea = rcu_dereference_protected(et->frozen, 1);
+
+	if (!ea)
+		return;
+	RCU_INIT_POINTER(et->frozen, NULL);
+	call_rcu(&ea->rcu, __free_extent_array);
+}
+
+static bool __lookup_frozen_extents(struct extent_tree *et, pgoff_t pgofs,
+							struct extent_info *ei)
+{
+	struct extent_array *ea;
+	unsigned int lo, hi, mid;
+	bool ret = false;
+
+	rcu_read_lock();
+	ea = rcu_dereference(et->frozen);
+	if (!ea)
+		goto out;
+
+	lo = 0;
+	hi = ea->nr;
+	while (lo < hi) {
+		struct extent_info *e;
+
+		mid = lo + (hi - lo) / 2;
+		e = &ea->ei[mid];
+		if (pgofs < e->fofs) {
+			hi = mid;
+		} else if (pgofs >= e->fofs + e->len) {
+			lo = mid + 1;
+		} else {
+			*ei = *e;
+			ret = true;
+			break;
+		}
+	}
+out:
+	rcu_read_unlock();
+	return ret;
+}
+
 static void __drop_largest_extent(struct extent_tree *et,
 					pgoff_t fofs, unsigned int len)
 {
@@ -373,6 +423,62 @@ bool f2fs_init_extent_tree(struct inode *inode, struct f2fs_extent *i_ext)
 	return ret;
 }
 
+/*
+ * Large files which are opened read-only (APKs, dex files, models mapped
+ * by every zygote child) get all their extents loaded once into a sorted
+ * array.  Lookups then binary search it without touching et->lock, and
+ * the rb-tree nodes holding the same information are released.  Any
+ * update to the extent tree drops the array again.
+ */
+void f2fs_freeze_extent_tree(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct extent_tree *et = F2FS_I(inode)->extent_tree;
+	struct extent_array *ea;
+	struct rb_node *node;
+	unsigned int gen, nr, i = 0;
+
+	if (!sbi->frozen_extent_blocks || !et || !f2fs_may_extent_tree(inode))
+		return;
+	if (rcu_access_pointer(et->frozen) ||
+			atomic_read(&inode->i_writecount) > 0 ||
+			DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE) <
+						sbi->frozen_extent_blocks)
+		return;
+
+	gen = READ_ONCE(et->gen);
+	if (f2fs_precache_extents(inode))
+		return;
+
+	nr = atomic_read(&et->node_cnt);
+	if (!nr || nr > MAX_FROZEN_EXTENTS)
+		return;
+
+	/* leave room for nodes added by a racing lookup, checked below */
+	nr = min(nr + 8, (unsigned int)MAX_FROZEN_EXTENTS);
+	ea = f2fs_kvmalloc(sbi, sizeof(*ea) + nr * sizeof(struct extent_info),
+								GFP_NOFS);
+	if (!ea)
+		return;
+
+	write_lock(&et->lock);
+	if (et->gen != gen || rcu_access_pointer(et->frozen) ||
+			atomic_read(&et->node_cnt) > nr ||
+			is_inode_flag_set(inode, FI_NO_EXTENT)) {
+		write_unlock(&et->lock);
+		kvfree(ea);
+		return;
+	}
+
+	for (node = rb_first_cached(&et->root); node; node = rb_next(node))
+		ea->ei[i++] = rb_entry(node, struct extent_node, rb_node)->ei;
+	ea->nr = i;
+
+	rcu_assign_pointer(et->frozen, ea);
+	__free_extent_tree(sbi, et);
+	write_unlock(&et->lock);
+}
+
 static bool f2fs_lookup_extent_tree(struct inode *inode, pgoff_t pgofs,
 							struct extent_info *ei)
 {
@@ -385,6 +491,13 @@ static bool f2fs_lookup_extent_tree(struct inode *inode, pgoff_t pgofs,
 
 	trace_f2fs_lookup_extent_tree_start(inode, pgofs);
 
+	if (__lookup_frozen_extents(et, pgofs, ei)) {
+		stat_inc_frozen_hit(sbi);
+		stat_inc_total_hit(sbi);
+		trace_f2fs_lookup_extent_tree_end(inode, pgofs, ei);
+		return true;
+	}
+
 	read_lock(&et->lock);
 
 	if (et->largest.fofs <= pgofs &&
@@ -514,6 +627,9 @@ static void f2fs_update_extent_tree_range(struct inode *inode,
 
 	write_lock(&et->lock);
 
+	et->gen++;
+	__drop_frozen_extents(et);
+
 	if (is_inode_flag_set(inode, FI_NO_EXTENT)) {
 		write_unlock(&et->lock);
 		return;
@@ -646,8 +762,10 @@ unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink)
 
 	/* 1. remove unreferenced extent tree */
 	list_for_each_entry_safe(et, next, &sbi->zombie_list, list) {
-		if (atomic_read(&et->node_cnt)) {
+		if (atomic_read(&et->node_cnt) ||
+					rcu_access_pointer(et->frozen)) {
 			write_lock(&et->lock);
+			__drop_frozen_extents(et);
 			node_cnt += __free_extent_tree(sbi, et);
 			write_unlock(&et->lock);
 		}
@@ -710,10 +828,12 @@ unsigned int f2fs_destroy_extent_node(struct inode *inode)
 	struct extent_tree *et = F2FS_I(inode)->extent_tree;
 	unsigned int node_cnt = 0;
 
-	if (!et || !atomic_read(&et->node_cnt))
+	if (!et || (!atomic_read(&et->node_cnt) &&
+				!rcu_access_pointer(et->frozen)))
 		return 0;
 
 	write_lock(&et->lock);
+	__drop_frozen_extents(et);
 	node_cnt = __free_extent_tree(sbi, et);
 	write_unlock(&et->lock);
 
@@ -732,6 +852,8 @@ void f2fs_drop_extent_tree(struct inode *inode)
 	set_inode_flag(inode, FI_NO_EXTENT);
 
 	write_lock(&et->lock);
+	et->gen++;
+	__drop_frozen_extents(et);
 	__free_extent_tree(sbi, et);
 	if (et->largest.len) {
 		et->largest.len = 0;
@@ -211,6 +211,8 @@ enum {
 #define DEF_DISABLE_INTERVAL		5	/* 5 secs */
 #define DEF_DISABLE_QUICK_INTERVAL	1	/* 1 secs */
 #define DEF_UMOUNT_DISCARD_TIMEOUT	5	/* 5 secs */
+#define DEF_FSYNC_GROUP_WINDOW		100	/* 100 us */
+#define F2FS_FSYNC_LAT_BUCKETS		20	/* log2 us, up to ~0.5s */
 
 struct cp_control {
 	int reason;
@@ -639,6 +641,16 @@ struct extent_node {
 	struct extent_tree *et;		/* extent tree pointer */
 };
 
+/*
+ * Sorted, immutable copy of all extents of a file which is only being
+ * read, looked up under RCU without taking extent_tree->lock.
+ */
+struct extent_array {
+	struct rcu_head rcu;
+	unsigned int nr;		/* # of entries in ei */
+	struct extent_info ei[];
+};
+
 struct extent_tree {
 	nid_t ino;			/* inode number */
 	struct rb_root_cached root;	/* root of extent info rb-tree */
@@ -648,8 +660,13 @@ struct extent_tree {
 	rwlock_t lock;			/* protect extent info rb-tree */
 	atomic_t node_cnt;		/* # of extent node in rb-tree*/
 	bool largest_updated;		/* largest extent updated */
+	struct extent_array __rcu *frozen;	/* read-only extent map */
+	unsigned int gen;		/* bumped on every extent update */
 };
 
+#define DEF_FROZEN_EXTENT_BLOCKS	256	/* freeze files of 1MB+ */
+#define MAX_FROZEN_EXTENTS		2048	/* max entries of extent_array */
+
 /*
  * This structure is taken from ext4_map_blocks.
  *
@@ -1395,6 +1412,16 @@ struct decompress_io_ctx {
 #define MAX_COMPRESS_LOG_SIZE		8
 #define MAX_COMPRESS_WINDOW_SIZE	((PAGE_SIZE) << MAX_COMPRESS_LOG_SIZE)
 
+/* largest cluster that may be decompressed from read completion context */
+#define F2FS_INLINE_DECOMPRESS_PAGES	(1 << MIN_COMPRESS_LOG_SIZE)
+
+/* where compressed read data gets decompressed */
+enum {
+	DECOMPRESS_INLINE,		/* in f2fs_read_end_io() */
+	DECOMPRESS_WQ,			/* in a post read worker */
+	NR_DECOMPRESS_PATH,
+};
+
 struct f2fs_sb_info {
 	struct super_block *sb;			/* pointer to VFS super block */
 	struct proc_dir_entry *s_proc;		/* proc entry */
@@ -1526,6 +1553,12 @@ struct f2fs_sb_info {
 	unsigned int max_victim_search;
 	/* migration granularity of garbage collection, unit: segment */
 	unsigned int migration_granularity;
+	/* min. # of blocks for a read-only file to get a frozen extent map */
+	unsigned int frozen_extent_blocks;
+	/* background GC leaves sections read within this many seconds */
+	unsigned int gc_read_hot_age;
+	/* jiffies of the last read not issued by GC */
+	unsigned long last_fg_read;
 
 	/*
 	 * for stat information.
@@ -1541,6 +1574,7 @@ struct f2fs_sb_info {
 	atomic64_t read_hit_rbtree;		/* # of hit rbtree extent node */
 	atomic64_t read_hit_largest;		/* # of hit largest extent node */
 	atomic64_t read_hit_cached;		/* # of hit cached extent node */
+	atomic64_t read_hit_frozen;		/* # of hit frozen extent array */
 	atomic_t inline_xattr;			/* # of inline_xattr inodes */
 	atomic_t inline_inode;			/* # of inline_data inodes */
 	atomic_t inline_dir;			/* # of inline_dentry inodes */
@@ -1551,6 +1585,7 @@ struct f2fs_sb_info {
 	atomic_t max_vw_cnt;			/* max # of volatile writes */
 	unsigned int io_skip_bggc;		/* skip background gc for in-flight IO */
 	unsigned int other_skip_bggc;		/* skip background gc for other reasons */
+	unsigned int hot_skip_bggc;		/* victims skipped as read hot */
 	unsigned int ndirty_inode[NR_INODE_TYPE];	/* # of dirty inodes */
 #endif
 	spinlock_t stat_lock;			/* lock for stat operations */
@@ -1571,6 +1606,16 @@ struct f2fs_sb_info {
 	struct kobject s_kobj;
 	struct completion s_kobj_unregister;
 
+	/* for fsync group commit of node pages */
+	spinlock_t fsync_group_lock;
+	wait_queue_head_t fsync_group_wait;
+	u64 fsync_group_seq;			/* group being filled */
+	u64 fsync_group_done;			/* last group submitted */
+	unsigned int fsync_group_joined;	/* # of fsyncs in the group */
+	atomic_t nr_fsync_writers;		/* # of fsyncs writing nodes */
+	unsigned int fsync_group_window;	/* coalescing window in us */
+	atomic64_t fsync_lat[F2FS_FSYNC_LAT_BUCKETS];	/* fsync latency */
+
 	/* For shrinker support */
 	struct list_head s_list;
 	int s_ndevs;				/* number of devices */
@@ -1591,6 +1636,11 @@ struct f2fs_sb_info {
 	__u32 s_chksum_seed;
 
 	struct workqueue_struct *post_read_wq;	/* post read workqueue */
+	struct workqueue_struct *decompress_wq;	/* per-cpu decompress workqueue */
+	unsigned int inline_decompress;		/* decompress small clusters in end_io */
+	atomic64_t decompress_cnt[NR_DECOMPRESS_PATH];	/* # of decompressed bios */
+	atomic64_t decompress_ns[NR_DECOMPRESS_PATH];	/* end_io to done latency */
+	u64 decompress_max_ns[NR_DECOMPRESS_PATH];	/* max of the above */
 
 	struct kmem_cache *inline_xattr_slab;	/* inline xattr entry */
 	unsigned int inline_xattr_slab_size;	/* default inline xattr slab size */
@@ -3507,7 +3557,7 @@ struct f2fs_stat_info {
 	struct f2fs_sb_info *sbi;
 	int all_area_segs, sit_area_segs, nat_area_segs, ssa_area_segs;
 	int main_area_segs, main_area_sections, main_area_zones;
-	unsigned long long hit_largest, hit_cached, hit_rbtree;
+	unsigned long long hit_largest, hit_cached, hit_rbtree, hit_frozen;
 	unsigned long long hit_total, total_ext;
 	int ext_tree, zombie_tree, ext_node;
 	int ndirty_node, ndirty_dent, ndirty_meta, ndirty_imeta;
@@ -3520,13 +3570,16 @@ struct f2fs_stat_info {
 	int bg_gc, nr_wb_cp_data, nr_wb_data;
 	int nr_rd_data, nr_rd_node, nr_rd_meta;
 	int nr_dio_read, nr_dio_write;
-	unsigned int io_skip_bggc, other_skip_bggc;
+	unsigned int io_skip_bggc, other_skip_bggc, hot_skip_bggc;
 	int nr_flushing, nr_flushed, flush_list_empty;
 	int nr_discarding, nr_discarded;
 	int nr_discard_cmd;
 	unsigned int undiscard_blks;
 	int inline_xattr, inline_inode, inline_dir, append, update, orphans;
 	int compr_inode, compr_blocks;
+	unsigned long long decompress_cnt[NR_DECOMPRESS_PATH];
+	unsigned long long decompress_avg_us[NR_DECOMPRESS_PATH];
+	unsigned long long decompress_max_us[NR_DECOMPRESS_PATH];
 	int aw_cnt, max_aw_cnt, vw_cnt, max_vw_cnt;
 	unsigned int valid_count, valid_node_count, valid_inode_count, discard_blks;
 	unsigned int bimodal, avg_vblocks;
@@ -3561,12 +3614,14 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_inc_bggc_count(si)		((si)->bg_gc++)
 #define stat_io_skip_bggc_count(sbi)	((sbi)->io_skip_bggc++)
 #define stat_other_skip_bggc_count(sbi)	((sbi)->other_skip_bggc++)
+#define stat_hot_skip_bggc_count(sbi)	((sbi)->hot_skip_bggc++)
 #define stat_inc_dirty_inode(sbi, type)	((sbi)->ndirty_inode[type]++)
 #define stat_dec_dirty_inode(sbi, type)	((sbi)->ndirty_inode[type]--)
 #define stat_inc_total_hit(sbi)		(atomic64_inc(&(sbi)->total_hit_ext))
 #define stat_inc_rbtree_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_rbtree))
 #define stat_inc_largest_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_largest))
 #define stat_inc_cached_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_cached))
+#define stat_inc_frozen_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_frozen))
 #define stat_inc_inline_xattr(inode)					\
 	do {								\
 		if (f2fs_has_inline_xattr(inode))			\
@@ -3690,12 +3745,14 @@ void f2fs_update_sit_info(struct f2fs_sb_info *sbi);
 #define stat_inc_bggc_count(si)				do { } while (0)
 #define stat_io_skip_bggc_count(sbi)			do { } while (0)
 #define stat_other_skip_bggc_count(sbi)			do { } while (0)
+#define stat_hot_skip_bggc_count(sbi)			do { } while (0)
 #define stat_inc_dirty_inode(sbi, type)			do { } while (0)
 #define stat_dec_dirty_inode(sbi, type)			do { } while (0)
 #define stat_inc_total_hit(sbi)				do { } while (0)
 #define stat_inc_rbtree_node_hit(sbi)			do { } while (0)
 #define stat_inc_largest_node_hit(sbi)			do { } while (0)
 #define stat_inc_cached_node_hit(sbi)			do { } while (0)
+#define stat_inc_frozen_hit(sbi)			do { } while (0)
 #define stat_inc_inline_xattr(inode)			do { } while (0)
 #define stat_dec_inline_xattr(inode)			do { } while (0)
 #define stat_inc_inline_inode(inode)			do { } while (0)
@@ -3799,6 +3856,7 @@ bool f2fs_check_rb_tree_consistence(struct f2fs_sb_info *sbi,
 						struct rb_root_cached *root);
 unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink);
 bool f2fs_init_extent_tree(struct inode *inode, struct f2fs_extent *i_ext);
+void f2fs_freeze_extent_tree(struct inode *inode);
 void f2fs_drop_extent_tree(struct inode *inode);
 unsigned int f2fs_destroy_extent_node(struct inode *inode);
 void f2fs_destroy_extent_tree(struct inode *inode);
@@ -3864,6 +3922,7 @@ bool f2fs_is_compress_backend_ready(struct inode *inode);
 int f2fs_init_compress_mempool(void);
 void f2fs_destroy_compress_mempool(void);
 void f2fs_decompress_pages(struct bio *bio, struct page *page, bool verity);
+bool f2fs_decompress_inline_ok(struct page *page);
 bool f2fs_cluster_is_empty(struct compress_ctx *cc);
 bool f2fs_cluster_can_merge_page(struct compress_ctx *cc, pgoff_t index);
 void f2fs_compress_ctx_add_page(struct compress_ctx *cc, struct page *page);
@@ -3884,6 +3943,7 @@ void f2fs_destroy_compress_ctx(struct compress_ctx *cc);
 void f2fs_init_compress_info(struct f2fs_sb_info *sbi);
 #else
 static inline bool f2fs_is_compressed_page(struct page *page) { return false; }
+static inline bool f2fs_decompress_inline_ok(struct page *page) { return false; }
 static inline bool f2fs_is_compress_backend_ready(struct inode *inode)
 {
 	if (!f2fs_compressed_file(inode))
@@ -239,6 +239,16 @@ static void try_to_fix_pino(struct inode *inode)
 	up_write(&fi->i_sem);
 }
 
+static void f2fs_update_fsync_latency(struct f2fs_sb_info *sbi,
+						ktime_t start_time)
+{
+	u64 us = ktime_to_us(ktime_sub(ktime_get(), start_time));
+	int bucket = us ? min_t(int, ilog2(us) + 1,
+				F2FS_FSYNC_LAT_BUCKETS - 1) : 0;
+
+	atomic64_inc(&sbi->fsync_lat[bucket]);
+}
+
 static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 						int datasync, bool atomic)
 {
@@ -253,6 +263,7 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 		.for_reclaim = 0,
 	};
 	unsigned int seq_id = 0;
+	ktime_t start_time = ktime_get();
 
 	if (unlikely(f2fs_readonly(inode->i_sb) ||
 				is_sbi_flag_set(sbi, SBI_CP_DISABLED)))
@@ -328,7 +339,9 @@ go_write:
 	}
 sync_nodes:
 	atomic_inc(&sbi->wb_sync_req[NODE]);
+	atomic_inc(&sbi->nr_fsync_writers);
 	ret = f2fs_fsync_node_pages(sbi, inode, &wbc, atomic, &seq_id);
+	atomic_dec(&sbi->nr_fsync_writers);
 	atomic_dec(&sbi->wb_sync_req[NODE]);
 	if (ret)
 		goto out;
@@ -372,6 +385,7 @@ flush_out:
 	}
 	f2fs_update_time(sbi, REQ_TIME);
 out:
+	f2fs_update_fsync_latency(sbi, start_time);
 	trace_f2fs_sync_file_exit(inode, cp_reason, datasync, ret);
 	f2fs_trace_ios(NULL, 1);
 	trace_android_fs_fsync_end(inode, start, end - start);
@@ -561,6 +575,9 @@ static int f2fs_file_open(struct inode *inode, struct file *filp)
 
 	filp->f_mode |= FMODE_NOWAIT;
 
+	if (S_ISREG(inode->i_mode) && !(filp->f_mode & FMODE_WRITE))
+		f2fs_freeze_extent_tree(inode);
+
 	return dquot_file_open(inode, filp);
 }
 
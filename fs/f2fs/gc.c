@@ -90,7 +90,7 @@ static int gc_thread_func(void *data)
 			goto next;
 		}
 
-		if (!is_idle(sbi, GC_TIME)) {
+		if (!is_idle(sbi, GC_TIME) || !is_read_idle(sbi, gc_th)) {
 			increase_sleep_time(gc_th, &wait_ms);
 			up_write(&sbi->gc_lock);
 			stat_io_skip_bggc_count(sbi);
@@ -138,6 +138,7 @@ int f2fs_start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->min_sleep_time = DEF_GC_THREAD_MIN_SLEEP_TIME;
 	gc_th->max_sleep_time = DEF_GC_THREAD_MAX_SLEEP_TIME;
 	gc_th->no_gc_sleep_time = DEF_GC_THREAD_NOGC_SLEEP_TIME;
+	gc_th->read_idle_time = DEF_GC_THREAD_READ_IDLE_TIME;
 
 	gc_th->gc_wake= 0;
 
@@ -279,6 +280,30 @@ static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
 	return UINT_MAX - ((100 * (100 - u) * age) / (100 + u));
 }
 
+/*
+ * Moving a section that user space is reading from throws its pages out
+ * of the page cache and competes with those reads, so let background GC
+ * wait until the section cools down.
+ */
+static bool sec_read_hot(struct f2fs_sb_info *sbi, unsigned int secno)
+{
+	unsigned int start = GET_SEG_FROM_SEC(sbi, secno);
+	unsigned long long now, rtime;
+	unsigned int i;
+
+	if (!sbi->gc_read_hot_age)
+		return false;
+
+	now = get_mtime(sbi, false);
+	for (i = 0; i < sbi->segs_per_sec; i++) {
+		rtime = READ_ONCE(get_seg_entry(sbi, start + i)->rtime);
+		if (rtime && rtime <= now &&
+				now - rtime < sbi->gc_read_hot_age)
+			return true;
+	}
+	return false;
+}
+
 static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
 			unsigned int segno, struct victim_sel_policy *p)
 {
@@ -411,6 +436,12 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto next;
 		if (gc_type == BG_GC && test_bit(secno, dirty_i->victim_secmap))
 			goto next;
+		if (gc_type == BG_GC && p.alloc_mode == LFS &&
+				sbi->gc_mode != GC_URGENT &&
+				sec_read_hot(sbi, secno)) {
+			stat_hot_skip_bggc_count(sbi);
+			goto next;
+		}
 
 		cost = get_gc_cost(sbi, segno, &p);
 
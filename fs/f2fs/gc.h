@@ -14,6 +14,8 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_READ_IDLE_TIME	1000	/* ms without user reads */
+#define DEF_GC_READ_HOT_AGE		60	/* seconds */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -32,6 +34,9 @@ struct f2fs_gc_kthread {
 	unsigned int max_sleep_time;
 	unsigned int no_gc_sleep_time;
 
+	/* user reads this recent (ms) hold background gc off */
+	unsigned int read_idle_time;
+
 	/* for changing gc mode */
 	unsigned int gc_wake;
 };
@@ -65,6 +70,16 @@ static inline block_t limit_free_user_blocks(struct f2fs_sb_info *sbi)
 	return (long)(reclaimable_user_blocks * LIMIT_FREE_BLOCK) / 100;
 }
 
+static inline bool is_read_idle(struct f2fs_sb_info *sbi,
+					struct f2fs_gc_kthread *gc_th)
+{
+	if (!gc_th->read_idle_time || sbi->gc_mode == GC_URGENT)
+		return true;
+
+	return time_after(jiffies, READ_ONCE(sbi->last_fg_read) +
+				msecs_to_jiffies(gc_th->read_idle_time));
+}
+
 static inline void increase_sleep_time(struct f2fs_gc_kthread *gc_th,
 							unsigned int *wait)
 {
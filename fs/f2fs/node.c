@@ -1653,6 +1653,68 @@ static int f2fs_write_node_page(struct page *page,
 						FS_NODE_IO, NULL);
 }
 
+/* caller holds fsync_group_lock */
+static void close_fsync_group(struct f2fs_sb_info *sbi)
+{
+	sbi->fsync_group_seq++;
+	sbi->fsync_group_joined = 0;
+}
+
+/*
+ * Concurrent fsyncs append their node pages to the same merged node bio.
+ * Instead of each of them submitting it right after adding its own pages,
+ * the last fsync to arrive, or the first one whose coalescing window runs
+ * out, submits it once for the whole group.
+ */
+static void f2fs_fsync_group_commit(struct f2fs_sb_info *sbi, nid_t ino)
+{
+	bool leader;
+	u64 group;
+
+	if (!sbi->fsync_group_window ||
+			atomic_read(&sbi->nr_fsync_writers) <= 1) {
+		f2fs_submit_merged_write_cond(sbi, NULL, NULL, ino, NODE);
+		return;
+	}
+
+	spin_lock(&sbi->fsync_group_lock);
+	group = sbi->fsync_group_seq;
+	leader = ++sbi->fsync_group_joined >=
+				atomic_read(&sbi->nr_fsync_writers);
+	if (leader)
+		close_fsync_group(sbi);
+	spin_unlock(&sbi->fsync_group_lock);
+
+	if (!leader) {
+		wait_event_hrtimeout(sbi->fsync_group_wait,
+			READ_ONCE(sbi->fsync_group_done) >= group,
+			ns_to_ktime((u64)sbi->fsync_group_window *
+							NSEC_PER_USEC));
+
+		spin_lock(&sbi->fsync_group_lock);
+		if (sbi->fsync_group_seq == group) {
+			leader = true;
+			close_fsync_group(sbi);
+		}
+		spin_unlock(&sbi->fsync_group_lock);
+
+		/* someone else closed the group, it is being submitted */
+		if (!leader) {
+			wait_event(sbi->fsync_group_wait,
+				READ_ONCE(sbi->fsync_group_done) >= group);
+			return;
+		}
+	}
+
+	f2fs_submit_merged_write(sbi, NODE);
+
+	spin_lock(&sbi->fsync_group_lock);
+	if (sbi->fsync_group_done < group)
+		sbi->fsync_group_done = group;
+	spin_unlock(&sbi->fsync_group_lock);
+	wake_up_all(&sbi->fsync_group_wait);
+}
+
 int f2fs_fsync_node_pages(struct f2fs_sb_info *sbi, struct inode *inode,
 			struct writeback_control *wbc, bool atomic,
 			unsigned int *seq_id)
@@ -1767,7 +1829,7 @@ continue_unlock:
 	}
 out:
 	if (nwritten)
-		f2fs_submit_merged_write_cond(sbi, NULL, NULL, ino, NODE);
+		f2fs_fsync_group_commit(sbi, ino);
 	return ret ? -EIO: 0;
 }
 
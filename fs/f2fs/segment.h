@@ -190,6 +190,7 @@ struct seg_entry {
 	unsigned char *ckpt_valid_map;	/* validity bitmap of blocks last cp */
 	unsigned char *discard_map;
 	unsigned long long mtime;	/* modification time of the segment */
+	unsigned long long rtime;	/* last time data was read from it */
 };
 
 struct sec_entry {
@@ -3057,9 +3057,13 @@ static void init_sb_info(struct f2fs_sb_info *sbi)
 	sbi->next_victim_seg[BG_GC] = NULL_SEGNO;
 	sbi->next_victim_seg[FG_GC] = NULL_SEGNO;
 	sbi->max_victim_search = DEF_MAX_VICTIM_SEARCH;
+	sbi->gc_read_hot_age = DEF_GC_READ_HOT_AGE;
+	sbi->last_fg_read = jiffies;
 	sbi->migration_granularity = sbi->segs_per_sec;
 
 	sbi->dir_level = DEF_DIR_LEVEL;
+	sbi->frozen_extent_blocks = DEF_FROZEN_EXTENT_BLOCKS;
+	sbi->inline_decompress = 1;
 	sbi->interval_time[CP_TIME] = DEF_CP_INTERVAL;
 	sbi->interval_time[REQ_TIME] = DEF_IDLE_INTERVAL;
 	sbi->interval_time[DISCARD_TIME] = DEF_IDLE_INTERVAL;
@@ -3083,6 +3087,11 @@ static void init_sb_info(struct f2fs_sb_info *sbi)
 	sbi->dirty_device = 0;
 	spin_lock_init(&sbi->dev_lock);
 
+	spin_lock_init(&sbi->fsync_group_lock);
+	init_waitqueue_head(&sbi->fsync_group_wait);
+	sbi->fsync_group_seq = 1;
+	sbi->fsync_group_window = DEF_FSYNC_GROUP_WINDOW;
+
 	init_rwsem(&sbi->sb_lock);
 	init_rwsem(&sbi->pin_sem);
 }
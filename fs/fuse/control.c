@@ -10,6 +10,7 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/math64.h>
 
 #define FUSE_CTL_SUPER_MAGIC 0x65735543
 
@@ -170,6 +171,52 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+static ssize_t fuse_conn_stats_read(struct file *file, char __user *buf,
+				    size_t len, loff_t *ppos)
+{
+	struct fuse_conn *fc;
+	char tmp[256];
+	size_t size;
+	u64 nr_replies, total_rtt_ns;
+	unsigned num_background, active_background, max_num_background;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	spin_lock(&fc->lock);
+	num_background = fc->num_background;
+	active_background = fc->active_background;
+	max_num_background = fc->max_num_background;
+	spin_unlock(&fc->lock);
+
+	nr_replies = atomic64_read(&fc->rtt.nr_replies);
+	total_rtt_ns = atomic64_read(&fc->rtt.total_rtt_ns);
+
+	size = scnprintf(tmp, sizeof(tmp),
+			 "waiting: %d\n"
+			 "background: %u\n"
+			 "background_queued: %u\n"
+			 "background_max: %u\n"
+			 "max_pages: %u\n"
+			 "replies: %llu\n"
+			 "rtt_avg_us: %llu\n"
+			 "rtt_max_us: %llu\n",
+			 atomic_read(&fc->num_waiting),
+			 active_background,
+			 num_background - active_background,
+			 max_num_background,
+			 fc->max_pages,
+			 nr_replies,
+			 nr_replies ? div64_u64(total_rtt_ns, nr_replies) /
+				      NSEC_PER_USEC : 0,
+			 (u64)atomic64_read(&fc->rtt.max_rtt_ns) /
+				NSEC_PER_USEC);
+	fuse_conn_put(fc);
+
+	return simple_read_from_buffer(buf, len, ppos, tmp, size);
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -182,6 +229,12 @@ static const struct file_operations fuse_ctl_waiting_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_ctl_stats_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_stats_read,
+	.llseek = no_llseek,
+};
+
 static const struct file_operations fuse_conn_max_background_ops = {
 	.open = nonseekable_open,
 	.read = fuse_conn_max_background_read,
@@ -264,7 +317,9 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
 				 S_IFREG | 0600, 1, NULL,
-				 &fuse_conn_congestion_threshold_ops))
+				 &fuse_conn_congestion_threshold_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "stats", S_IFREG | 0400, 1,
+				 NULL, &fuse_ctl_stats_ops))
 		goto err;
 
 	return 0;
@@ -321,11 +321,17 @@ static u64 fuse_get_unique(struct fuse_iqueue *fiq)
 	return ++fiq->reqctr;
 }
 
-static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
+static void __queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
+	req->queue_time = ktime_get_ns();
 	list_add_tail(&req->list, &fiq->pending);
+}
+
+static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
+{
+	__queue_request(fiq, req);
 	wake_up_locked(&fiq->waitq);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 }
@@ -350,20 +356,56 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 	spin_unlock(&fiq->waitq.lock);
 }
 
+/*
+ * Move as many background requests as the limit allows to the pending
+ * queue in one go, so that readahead split into several requests reaches
+ * the daemon as a batch with a single wakeup.
+ */
 static void flush_bg_queue(struct fuse_conn *fc)
 {
+	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_req *req;
+	bool queued = false;
+
+	if (fc->active_background >= fc->max_background ||
+	    list_empty(&fc->bg_queue))
+		return;
+
+	spin_lock(&fiq->waitq.lock);
 	while (fc->active_background < fc->max_background &&
 	       !list_empty(&fc->bg_queue)) {
-		struct fuse_req *req;
-		struct fuse_iqueue *fiq = &fc->iq;
-
 		req = list_entry(fc->bg_queue.next, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
-		spin_lock(&fiq->waitq.lock);
 		req->in.h.unique = fuse_get_unique(fiq);
-		queue_request(fiq, req);
-		spin_unlock(&fiq->waitq.lock);
+		__queue_request(fiq, req);
+		queued = true;
+	}
+	if (queued) {
+		wake_up_locked(&fiq->waitq);
+		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+	}
+	spin_unlock(&fiq->waitq.lock);
+}
+
+static void fuse_account_rtt(struct fuse_conn *fc, struct fuse_req *req)
+{
+	s64 rtt, max;
+
+	if (!req->queue_time)
+		return;
+
+	rtt = ktime_get_ns() - req->queue_time;
+	atomic64_inc(&fc->rtt.nr_replies);
+	atomic64_add(rtt, &fc->rtt.total_rtt_ns);
+
+	max = atomic64_read(&fc->rtt.max_rtt_ns);
+	while (rtt > max) {
+		s64 old = atomic64_cmpxchg(&fc->rtt.max_rtt_ns, max, rtt);
+
+		if (old == max)
+			break;
+		max = old;
 	}
 }
 
@@ -387,6 +429,7 @@ static void request_end(struct fuse_conn *fc, struct fuse_req *req)
 	spin_unlock(&fiq->waitq.lock);
 	WARN_ON(test_bit(FR_PENDING, &req->flags));
 	WARN_ON(test_bit(FR_SENT, &req->flags));
+	fuse_account_rtt(fc, req);
 	if (test_bit(FR_BACKGROUND, &req->flags)) {
 		spin_lock(&fc->lock);
 		clear_bit(FR_BACKGROUND, &req->flags);
@@ -596,6 +639,8 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
 	}
 	__set_bit(FR_ISREPLY, &req->flags);
 	fc->num_background++;
+	if (fc->num_background > fc->max_num_background)
+		fc->max_num_background = fc->num_background;
 	if (fc->num_background == fc->max_background)
 		fc->blocked = 1;
 	if (fc->num_background == fc->congestion_threshold && fc->sb) {
@@ -1689,7 +1734,7 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 		num = file_size - outarg->offset;
 
 	num_pages = (num + offset + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	num_pages = min(num_pages, FUSE_MAX_PAGES_PER_REQ);
+	num_pages = min(num_pages, fc->max_pages);
 
 	req = fuse_get_req(fc, num_pages);
 	if (IS_ERR(req))
@@ -2250,6 +2295,7 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 	int res;
 	int oldfd;
 	struct fuse_dev *fud = NULL;
+	struct fuse_passthrough_out pto;
 
 	if (_IOC_TYPE(cmd) != FUSE_DEV_IOC_MAGIC)
 		return -EINVAL;
@@ -2280,6 +2326,15 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 			}
 		}
 		break;
+	case _IOC_NR(FUSE_DEV_IOC_PASSTHROUGH_OPEN):
+		res = -EFAULT;
+		if (!copy_from_user(&pto, (void __user *)arg, sizeof(pto))) {
+			res = -EINVAL;
+			fud = fuse_get_dev(file);
+			if (fud && !pto.len)
+				res = fuse_passthrough_open(fud, pto.fd);
+		}
+		break;
 	default:
 		res = -ENOTTY;
 		break;
@@ -0,0 +1,237 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  Read/write/mmap passthrough to a file on the lower filesystem.
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/fs_stack.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/uio.h>
+
+#define PASSTHROUGH_IOCB_MASK \
+	(IOCB_APPEND | IOCB_DSYNC | IOCB_HIPRI | IOCB_NOWAIT | IOCB_SYNC)
+
+static void fuse_passthrough_copy_attr(struct inode *inode,
+				       struct inode *lower_inode, bool size)
+{
+	fsstack_copy_attr_times(inode, lower_inode);
+	if (size)
+		fsstack_copy_inode_size(inode, lower_inode);
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough.filp;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = vfs_iter_read(lower, to, &iocb->ki_pos,
+			    iocb_to_rw_flags(iocb->ki_flags,
+					     PASSTHROUGH_IOCB_MASK));
+	revert_creds(old_cred);
+
+	fuse_passthrough_copy_attr(file_inode(file), file_inode(lower), false);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough.filp;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(from))
+		return 0;
+
+	inode_lock(inode);
+
+	old_cred = override_creds(ff->passthrough.cred);
+	file_start_write(lower);
+	ret = vfs_iter_write(lower, from, &iocb->ki_pos,
+			     iocb_to_rw_flags(iocb->ki_flags,
+					      PASSTHROUGH_IOCB_MASK));
+	file_end_write(lower);
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		fuse_passthrough_copy_attr(inode, file_inode(lower), true);
+		fuse_invalidate_attr(inode);
+	}
+
+	inode_unlock(inode);
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough.filp;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	/*
+	 * The mapping is served by the lower file's page cache, so it is
+	 * the lower file that must be pinned by the vma.
+	 */
+	vma->vm_file = get_file(lower);
+
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = call_mmap(lower, vma);
+	revert_creds(old_cred);
+
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+	}
+
+	file_accessed(file);
+
+	return ret;
+}
+
+/*
+ * Called by the daemon through FUSE_DEV_IOC_PASSTHROUGH_OPEN: take a
+ * reference to @lower_fd and return an identifier that can be handed back
+ * in the OPEN/CREATE reply to redirect I/O on the new fuse file to it.
+ */
+int fuse_passthrough_open(struct fuse_dev *fud, u32 lower_fd)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_passthrough *passthrough;
+	struct super_block *lower_sb;
+	struct file *lower;
+	int res;
+
+	if (!fc->passthrough)
+		return -EPERM;
+
+	lower = fget(lower_fd);
+	if (!lower)
+		return -EBADF;
+
+	res = -EINVAL;
+	if (!S_ISREG(file_inode(lower)->i_mode) ||
+	    !lower->f_op->read_iter || !lower->f_op->write_iter)
+		goto out_fput;
+
+	/*
+	 * Stacking onto another passthrough (or otherwise stacked) mount
+	 * could recurse without bound.
+	 */
+	lower_sb = file_inode(lower)->i_sb;
+	if (lower_sb->s_stack_depth >= FILESYSTEM_MAX_STACK_DEPTH)
+		goto out_fput;
+
+	res = -ENOMEM;
+	passthrough = kmalloc(sizeof(*passthrough), GFP_KERNEL);
+	if (!passthrough)
+		goto out_fput;
+
+	passthrough->filp = lower;
+	passthrough->cred = prepare_creds();
+	if (!passthrough->cred)
+		goto out_free;
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->passthrough_req_lock);
+	res = idr_alloc(&fc->passthrough_req, passthrough, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->passthrough_req_lock);
+	idr_preload_end();
+
+	if (res > 0)
+		return res;
+
+	put_cred(passthrough->cred);
+out_free:
+	kfree(passthrough);
+out_fput:
+	fput(lower);
+	return res;
+}
+
+/*
+ * Claim the lower file registered under openarg->passthrough_fh for @ff.
+ * Passthrough is an optimization only: if the identifier is unknown or the
+ * lower file cannot serve @file, I/O keeps going through the daemon.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct file *file, struct fuse_open_out *openarg)
+{
+	struct fuse_passthrough *passthrough;
+	int passthrough_fh = openarg->passthrough_fh;
+
+	if (!fc->passthrough || passthrough_fh <= 0)
+		return;
+
+	spin_lock(&fc->passthrough_req_lock);
+	passthrough = idr_remove(&fc->passthrough_req, passthrough_fh);
+	spin_unlock(&fc->passthrough_req_lock);
+
+	if (!passthrough)
+		return;
+
+	if ((ff->open_flags & FOPEN_DIRECT_IO) ||
+	    ((file->f_mode & FMODE_READ) &&
+	     !(passthrough->filp->f_mode & FMODE_READ)) ||
+	    ((file->f_mode & FMODE_WRITE) &&
+	     !(passthrough->filp->f_mode & FMODE_WRITE))) {
+		fuse_passthrough_release(passthrough);
+		kfree(passthrough);
+		return;
+	}
+
+	ff->passthrough = *passthrough;
+	kfree(passthrough);
+}
+
+void fuse_passthrough_release(struct fuse_passthrough *passthrough)
+{
+	if (passthrough->filp) {
+		fput(passthrough->filp);
+		passthrough->filp = NULL;
+	}
+	if (passthrough->cred) {
+		put_cred(passthrough->cred);
+		passthrough->cred = NULL;
+	}
+}
+
+/* Drop lower files that were registered but never claimed by an open */
+void fuse_passthrough_conn_free(struct fuse_conn *fc)
+{
+	struct fuse_passthrough *passthrough;
+	int id;
+
+	idr_for_each_entry(&fc->passthrough_req, passthrough, id) {
+		fuse_passthrough_release(passthrough);
+		kfree(passthrough);
+	}
+	idr_destroy(&fc->passthrough_req);
+}
@@ -122,6 +122,8 @@ static void data_file_segment_init(struct data_file_segment *segment)
 	init_waitqueue_head(&segment->new_data_arrival_wq);
 	mutex_init(&segment->blockmap_mutex);
 	INIT_LIST_HEAD(&segment->reads_list_head);
+	spin_lock_init(&segment->reads_lock);
+	atomic_set(&segment->nr_pending_reads, 0);
 }
 
 static void data_file_segment_destroy(struct data_file_segment *segment)
@@ -158,6 +160,9 @@ struct data_file *incfs_open_data_file(struct mount_info *mi, struct file *bf)
 	df->df_mount_info = mi;
 	for (i = 0; i < ARRAY_SIZE(df->df_segments); i++)
 		data_file_segment_init(&df->df_segments[i]);
+	spin_lock_init(&df->df_prefetch_lock);
+	df->df_last_read_index = -1;
+	atomic_set(&df->df_prefetch_inflight, 0);
 
 	error = mutex_lock_interruptible(&bfc->bc_mutex);
 	if (error)
@@ -384,7 +389,15 @@ static void log_block_read(struct mount_info *mi, incfs_uuid_t *id,
 	++head->current_record_no;
 
 	spin_unlock(&log->rl_lock);
-	schedule_delayed_work(&log->ml_wakeup_work, msecs_to_jiffies(16));
+
+	/*
+	 * Readers of the log are woken up once for all records written
+	 * within the delay; a plain read keeps the pending bit's cache line
+	 * shared while records keep coming.
+	 */
+	if (!delayed_work_pending(&log->ml_wakeup_work))
+		schedule_delayed_work(&log->ml_wakeup_work,
+				      msecs_to_jiffies(16));
 }
 
 static int validate_hash_tree(struct file *bf, struct file *f, int block_index,
@@ -762,9 +775,13 @@ static struct pending_read *add_pending_read(struct data_file *df,
 	mi->mi_pending_reads_count++;
 
 	list_add(&result->mi_reads_list, &mi->mi_reads_list_head);
-	list_add(&result->segment_reads_list, &segment->reads_list_head);
 	mutex_unlock(&mi->mi_pending_reads_mutex);
 
+	spin_lock(&segment->reads_lock);
+	list_add(&result->segment_reads_list, &segment->reads_list_head);
+	atomic_inc(&segment->nr_pending_reads);
+	spin_unlock(&segment->reads_lock);
+
 	wake_up_all(&mi->mi_pending_reads_notif_wq);
 	return result;
 }
@@ -772,6 +789,7 @@ static struct pending_read *add_pending_read(struct data_file *df,
 /* Notifies a given data file that pending read is completed. */
 static void remove_pending_read(struct data_file *df, struct pending_read *read)
 {
+	struct data_file_segment *segment = NULL;
 	struct mount_info *mi = NULL;
 
 	if (!df || !read) {
@@ -781,36 +799,61 @@ static void remove_pending_read(struct data_file *df, struct pending_read *read)
 	}
 
 	mi = df->df_mount_info;
+	segment = get_file_segment(df, read->block_index);
 
-	mutex_lock(&mi->mi_pending_reads_mutex);
-	list_del(&read->mi_reads_list);
+	spin_lock(&segment->reads_lock);
 	list_del(&read->segment_reads_list);
+	atomic_dec(&segment->nr_pending_reads);
+	spin_unlock(&segment->reads_lock);
 
+	mutex_lock(&mi->mi_pending_reads_mutex);
+	list_del(&read->mi_reads_list);
 	mi->mi_pending_reads_count--;
 	mutex_unlock(&mi->mi_pending_reads_mutex);
 
 	kfree(read);
 }
 
-static void notify_pending_reads(struct mount_info *mi,
-		struct data_file_segment *segment,
-		int index)
+/*
+ * Marks pending reads waiting for this block as done. Returns true if
+ * there were any, so the caller has to wake up the segment's waiters.
+ * Called with segment->blockmap_mutex held.
+ */
+static bool notify_pending_reads(struct data_file_segment *segment, int index)
 {
 	struct pending_read *entry = NULL;
+	bool found = false;
 
-	/* Notify pending reads waiting for this block. */
-	mutex_lock(&mi->mi_pending_reads_mutex);
+	/* The common case when filling ahead of the readers */
+	if (!atomic_read(&segment->nr_pending_reads))
+		return false;
+
+	spin_lock(&segment->reads_lock);
 	list_for_each_entry(entry, &segment->reads_list_head,
 						segment_reads_list) {
-		if (entry->block_index == index)
+		if (entry->block_index == index) {
 			set_read_done(entry);
+			found = true;
+		}
 	}
-	mutex_unlock(&mi->mi_pending_reads_mutex);
-	wake_up_all(&segment->new_data_arrival_wq);
+	spin_unlock(&segment->reads_lock);
+	return found;
+}
+
+/*
+ * Wakes up readers of the segments in wake_mask, as collected by
+ * incfs_process_new_data_block() over a batch of blocks.
+ */
+void incfs_wake_pending_reads(struct data_file *df, unsigned long wake_mask)
+{
+	int i;
+
+	for_each_set_bit(i, &wake_mask, ARRAY_SIZE(df->df_segments))
+		wake_up_all(&df->df_segments[i].new_data_arrival_wq);
 }
 
 static int wait_for_data_block(struct data_file *df, int block_index,
-			       int timeout_ms,
+			       int timeout_ms, bool log_miss,
 			       struct data_file_block *res_block)
 {
 	struct data_file_block block = {};
@@ -854,7 +897,8 @@ static int wait_for_data_block(struct data_file *df, int block_index,
 	mi = df->df_mount_info;
 
 	if (timeout_ms == 0) {
-		log_block_read(mi, &df->df_id, block_index);
+		if (log_miss)
+			log_block_read(mi, &df->df_id, block_index);
 		return -ETIME;
 	}
 
@@ -910,9 +954,9 @@ static int wait_for_data_block(struct data_file *df, int block_index,
 	return error;
 }
 
-ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
-				   int index, int timeout_ms,
-				   struct mem_range tmp)
+static ssize_t read_data_file_block(struct mem_range dst, struct file *f,
+				    int index, int timeout_ms,
+				    struct mem_range tmp, bool prefetch)
 {
 	loff_t pos;
 	ssize_t result;
@@ -931,7 +975,7 @@ ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
 	mi = df->df_mount_info;
 	bf = df->df_backing_file_context->bc_file;
 
-	result = wait_for_data_block(df, index, timeout_ms, &block);
+	result = wait_for_data_block(df, index, timeout_ms, !prefetch, &block);
 	if (result < 0)
 		goto out;
 
@@ -969,15 +1013,39 @@ ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
 			result = err;
 	}
 
-	if (result >= 0)
+	if (result >= 0 && !prefetch)
 		log_block_read(mi, &df->df_id, index);
 
 out:
 	return result;
 }
 
+ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
+				   int index, int timeout_ms,
+				   struct mem_range tmp)
+{
+	return read_data_file_block(dst, f, index, timeout_ms, tmp, false);
+}
+
+/*
+ * Same as incfs_read_data_file_block(), but never waits for a missing
+ * block and doesn't show up in the read log: the block hasn't actually
+ * been read by anyone yet.
+ */
+ssize_t incfs_prefetch_data_file_block(struct mem_range dst, struct file *f,
+				       int index, struct mem_range tmp)
+{
+	return read_data_file_block(dst, f, index, 0, tmp, true);
+}
+
+/*
+ * If wake_mask is given, waiters of the filled block aren't woken up right
+ * away; the block's segment is added to the mask instead, to be passed to
+ * incfs_wake_pending_reads() once the whole batch has been written.
+ */
 int incfs_process_new_data_block(struct data_file *df,
-				 struct incfs_fill_block *block, u8 *data)
+				 struct incfs_fill_block *block, u8 *data,
+				 unsigned long *wake_mask)
 {
 	struct mount_info *mi = NULL;
 	struct backing_file_context *bfc = NULL;
@@ -1020,8 +1088,12 @@ int incfs_process_new_data_block(struct data_file *df,
 			df->df_blockmap_off, flags);
 		mutex_unlock(&bfc->bc_mutex);
 	}
-	if (!error)
-		notify_pending_reads(mi, segment, block->block_index);
+	if (!error && notify_pending_reads(segment, block->block_index)) {
+		if (wake_mask)
+			__set_bit(segment - df->df_segments, wake_mask);
+		else
+			wake_up_all(&segment->new_data_arrival_wq);
+	}
 
 unlock:
 	mutex_unlock(&segment->blockmap_mutex);
@@ -97,6 +97,7 @@ struct read_log {
 struct mount_options {
 	unsigned int read_timeout_ms;
 	unsigned int readahead_pages;
+	unsigned int prefetch_blocks;
 	unsigned int read_log_pages;
 	unsigned int read_log_wakeup_count;
 	bool no_backing_file_cache;
@@ -127,7 +128,6 @@ struct mount_info {
 	 *  - reads_list_head
 	 *  - mi_pending_reads_count
 	 *  - mi_last_pending_read_number
-	 *  - data_file_segment.reads_list_head
 	 */
 	struct mutex mi_pending_reads_mutex;
 
@@ -185,8 +185,17 @@ struct data_file_segment {
 	struct mutex blockmap_mutex;
 
 	/* List of active pending_read objects belonging to this segment */
-	/* Protected by mount_info.pending_reads_mutex */
+	/* Protected by reads_lock */
 	struct list_head reads_list_head;
+
+	spinlock_t reads_lock;
+
+	/*
+	 * Number of entries in reads_list_head. Only incremented under
+	 * blockmap_mutex, so a block writer holding it sees every reader that
+	 * may wait for its block and can skip the list when it's 0.
+	 */
+	atomic_t nr_pending_reads;
 };
 
 /*
@@ -237,6 +246,23 @@ struct data_file {
 	struct mtree *df_hash_tree;
 
 	struct incfs_df_signature *df_signature;
+
+	/*
+	 * Sequential read detection for asynchronous prefetch, protects
+	 * df_last_read_index, df_seq_reads and df_prefetch_next.
+	 */
+	spinlock_t df_prefetch_lock;
+
+	int df_last_read_index;
+
+	/* Number of consecutive sequential block reads */
+	int df_seq_reads;
+
+	/* First block not yet queued for prefetch */
+	int df_prefetch_next;
+
+	/* Number of prefetch works queued and not finished yet */
+	atomic_t df_prefetch_inflight;
 };
 
 struct dir_file {
@@ -280,13 +306,19 @@ ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
 				   int index, int timeout_ms,
 				   struct mem_range tmp);
 
+ssize_t incfs_prefetch_data_file_block(struct mem_range dst, struct file *f,
+				       int index, struct mem_range tmp);
+
 int incfs_get_filled_blocks(struct data_file *df,
 			    struct incfs_get_filled_blocks_args *arg);
 
 int incfs_read_file_signature(struct data_file *df, struct mem_range dst);
 
 int incfs_process_new_data_block(struct data_file *df,
-				 struct incfs_fill_block *block, u8 *data);
+				 struct incfs_fill_block *block, u8 *data,
+				 unsigned long *wake_mask);
+
+void incfs_wake_pending_reads(struct data_file *df, unsigned long wake_mask);
 
 int incfs_process_new_hash_block(struct data_file *df,
 				 struct incfs_fill_block *block, u8 *data);
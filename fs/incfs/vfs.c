@@ -14,6 +14,7 @@
 #include <linux/poll.h>
 #include <linux/seq_file.h>
 #include <linux/syscalls.h>
+#include <linux/workqueue.h>
 #include <linux/xattr.h>
 
 #include <uapi/linux/incrementalfs.h>
@@ -216,6 +217,7 @@ struct inode_search {
 enum parse_parameter {
 	Opt_read_timeout,
 	Opt_readahead_pages,
+	Opt_prefetch_blocks,
 	Opt_no_backing_file_cache,
 	Opt_no_backing_file_readahead,
 	Opt_rlog_pages,
@@ -238,6 +240,7 @@ static struct mem_range log_file_name_range = {
 static const match_table_t option_tokens = {
 	{ Opt_read_timeout, "read_timeout_ms=%u" },
 	{ Opt_readahead_pages, "readahead=%u" },
+	{ Opt_prefetch_blocks, "prefetch=%u" },
 	{ Opt_no_backing_file_cache, "no_bf_cache=%u" },
 	{ Opt_no_backing_file_readahead, "no_bf_readahead=%u" },
 	{ Opt_rlog_pages, "rlog_pages=%u" },
@@ -256,6 +259,7 @@ static int parse_options(struct mount_options *opts, char *str)
 
 	opts->read_timeout_ms = 1000; /* Default: 1s */
 	opts->readahead_pages = 10;
+	opts->prefetch_blocks = 32;
 	opts->read_log_pages = 2;
 	opts->read_log_wakeup_count = 10;
 	opts->no_backing_file_cache = false;
@@ -282,6 +286,11 @@ static int parse_options(struct mount_options *opts, char *str)
 				return -EINVAL;
 			opts->readahead_pages = value;
 			break;
+		case Opt_prefetch_blocks:
+			if (match_int(&args[0], &value))
+				return -EINVAL;
+			opts->prefetch_blocks = value;
+			break;
 		case Opt_no_backing_file_cache:
 			if (match_int(&args[0], &value))
 				return -EINVAL;
@@ -790,7 +799,7 @@ static struct dentry *open_or_create_index_dir(struct dentry *backing_dir)
 	return index_dentry;
 }
 
-static int read_single_page(struct file *f, struct page *page)
+static int read_one_page(struct file *f, struct page *page, bool prefetch)
 {
 	loff_t offset = 0;
 	loff_t size = 0;
@@ -817,9 +826,14 @@ static int read_single_page(struct file *f, struct page *page)
 
 		tmp.data = (u8 *)__get_free_pages(GFP_NOFS, get_order(tmp.len));
 		bytes_to_read = min_t(loff_t, size - offset, PAGE_SIZE);
-		read_result = incfs_read_data_file_block(
-			range(page_start, bytes_to_read), f, block_index,
-			timeout_ms, tmp);
+		if (prefetch)
+			read_result = incfs_prefetch_data_file_block(
+				range(page_start, bytes_to_read), f,
+				block_index, tmp);
+		else
+			read_result = incfs_read_data_file_block(
+				range(page_start, bytes_to_read), f,
+				block_index, timeout_ms, tmp);
 
 		free_pages((unsigned long)tmp.data, get_order(tmp.len));
 	} else {
@@ -834,7 +848,7 @@ static int read_single_page(struct file *f, struct page *page)
 
 	if (result == 0)
 		SetPageUptodate(page);
-	else
+	else if (!prefetch)
 		SetPageError(page);
 
 	flush_dcache_page(page);
@@ -843,6 +857,123 @@ static int read_single_page(struct file *f, struct page *page)
 	return result;
 }
 
+/* Blocks read, decompressed and verified by one prefetch work */
+#define PREFETCH_CHUNK_BLOCKS 4
+
+/* Don't let one file occupy more workers than this */
+#define PREFETCH_MAX_INFLIGHT 8
+
+struct prefetch_work {
+	struct work_struct work;
+	struct file *file;
+	int start_index;
+	int count;
+};
+
+static void prefetch_blocks(struct work_struct *work)
+{
+	struct prefetch_work *pw =
+		container_of(work, struct prefetch_work, work);
+	struct file *f = pw->file;
+	struct data_file *df = get_incfs_data_file(f);
+	int i, err;
+
+	for (i = pw->start_index; i < pw->start_index + pw->count; i++) {
+		struct page *page = grab_cache_page_nowait(f->f_mapping, i);
+
+		/* Being read by someone else already */
+		if (!page)
+			continue;
+
+		err = 0;
+		if (PageUptodate(page))
+			unlock_page(page);
+		else
+			err = read_one_page(f, page, true);
+		put_page(page);
+
+		/* The data hasn't arrived yet, let the reader wait for it */
+		if (err == -ETIME)
+			break;
+	}
+
+	atomic_dec(&df->df_prefetch_inflight);
+	fput(f);
+	kfree(pw);
+}
+
+/*
+ * Verifying the hash tree and decompressing happens in the reader's
+ * context, so a single thread streaming through a big file ends up
+ * CPU-bound. Once a file is read sequentially, keep the next
+ * mi_options.prefetch_blocks blocks in flight on unbound workers, so they
+ * are checked in parallel, and the hash tree pages they need are cached
+ * as verified (PageChecked) by the time the reader gets there.
+ */
+static void maybe_prefetch(struct file *f, int block_index)
+{
+	struct data_file *df = get_incfs_data_file(f);
+	unsigned int window = df->df_mount_info->mi_options.prefetch_blocks;
+	int start, end;
+
+	if (!window)
+		return;
+
+	spin_lock(&df->df_prefetch_lock);
+	if (block_index == df->df_last_read_index + 1) {
+		df->df_seq_reads++;
+	} else if (block_index != df->df_last_read_index) {
+		df->df_seq_reads = 0;
+		df->df_prefetch_next = block_index + 1;
+	}
+	df->df_last_read_index = block_index;
+
+	start = max(df->df_prefetch_next, block_index + 1);
+	end = min_t(int, block_index + 1 + window, df->df_data_block_count);
+
+	/* Top the window up once half of it has been consumed */
+	if (df->df_seq_reads < 2 || start >= end ||
+	    start - block_index > window / 2) {
+		spin_unlock(&df->df_prefetch_lock);
+		return;
+	}
+	df->df_prefetch_next = end;
+	spin_unlock(&df->df_prefetch_lock);
+
+	for (; start < end; start += PREFETCH_CHUNK_BLOCKS) {
+		struct prefetch_work *pw;
+
+		if (atomic_inc_return(&df->df_prefetch_inflight) >
+		    PREFETCH_MAX_INFLIGHT) {
+			atomic_dec(&df->df_prefetch_inflight);
+			break;
+		}
+
+		pw = kzalloc(sizeof(*pw), GFP_NOFS);
+		if (!pw) {
+			atomic_dec(&df->df_prefetch_inflight);
+			break;
+		}
+
+		INIT_WORK(&pw->work, prefetch_blocks);
+		pw->file = get_file(f);
+		pw->start_index = start;
+		pw->count = min(PREFETCH_CHUNK_BLOCKS, end - start);
+		queue_work(system_unbound_wq, &pw->work);
+	}
+}
+
+static int read_single_page(struct file *f, struct page *page)
+{
+	struct data_file *df = get_incfs_data_file(f);
+
+	if (df)
+		maybe_prefetch(f, page_offset(page) /
+				  INCFS_DATA_FILE_BLOCK_SIZE);
+
+	return read_one_page(f, page, false);
+}
+
 static char *file_id_to_str(incfs_uuid_t id)
 {
 	char *result = kmalloc(1 + sizeof(id.bytes) * 2, GFP_NOFS);
@@ -1293,6 +1424,7 @@ static long ioctl_fill_blocks(struct file *f, void __user *arg)
 	struct data_file *df = get_incfs_data_file(f);
 	const ssize_t data_buf_size = 2 * INCFS_DATA_FILE_BLOCK_SIZE;
 	u8 *data_buf = NULL;
+	unsigned long wake_mask = 0;
 	ssize_t error = 0;
 	int i = 0;
 
@@ -1336,12 +1468,15 @@ static long ioctl_fill_blocks(struct file *f, void __user *arg)
 							     data_buf);
 		} else {
 			error = incfs_process_new_data_block(df, &fill_block,
-							     data_buf);
+							     data_buf, &wake_mask);
 		}
 		if (error)
 			break;
 	}
 
+	/* One wakeup per segment for the whole batch */
+	incfs_wake_pending_reads(df, wake_mask);
+
 	if (data_buf)
 		free_pages((unsigned long)data_buf, get_order(data_buf_size));
 
@@ -2293,6 +2428,7 @@ static int show_options(struct seq_file *m, struct dentry *root)
 
 	seq_printf(m, ",read_timeout_ms=%u", mi->mi_options.read_timeout_ms);
 	seq_printf(m, ",readahead=%u", mi->mi_options.readahead_pages);
+	seq_printf(m, ",prefetch=%u", mi->mi_options.prefetch_blocks);
 	if (mi->mi_options.read_log_pages != 0) {
 		seq_printf(m, ",rlog_pages=%u", mi->mi_options.read_log_pages);
 		seq_printf(m, ",rlog_wakeup_cnt=%u",
@@ -328,6 +328,7 @@ struct ovl_copy_up_ctx {
 	struct dentry *workdir;
 	bool tmpfile;
 	bool origin;
+	bool metacopy;
 };
 
 static int ovl_link_up(struct ovl_copy_up_ctx *c)
@@ -445,7 +446,22 @@ static int ovl_copy_up_inode(struct ovl_copy_up_ctx *c, struct dentry *temp)
 {
 	int err;
 
-	if (S_ISREG(c->stat.mode)) {
+	if (S_ISREG(c->stat.mode) && c->metacopy) {
+		struct iattr attr = {
+			.ia_valid = ATTR_SIZE,
+			.ia_size = c->stat.size,
+		};
+
+		/* a sparse file of the right size, so stat needs no lower */
+		err = ovl_do_setxattr(temp, OVL_XATTR_METACOPY, NULL, 0, 0);
+		if (err)
+			return err;
+		inode_lock(temp->d_inode);
+		err = notify_change(temp, &attr, NULL);
+		inode_unlock(temp->d_inode);
+		if (err)
+			return err;
+	} else if (S_ISREG(c->stat.mode)) {
 		struct path upperpath;
 
 		ovl_path_upper(c->dentry, &upperpath);
@@ -508,6 +524,9 @@ static int ovl_copy_up_locked(struct ovl_copy_up_ctx *c)
 	if (err)
 		goto out_cleanup;
 
+	/* opens must not see the upper before they know it has no data */
+	if (c->metacopy)
+		ovl_set_flag(OVL_METACOPY, d_inode(c->dentry));
 	ovl_inode_update(d_inode(c->dentry), newdentry);
 out:
 	dput(temp);
@@ -541,6 +560,14 @@ static int ovl_do_copy_up(struct ovl_copy_up_ctx *c)
 	if (S_ISDIR(c->stat.mode) || c->stat.nlink == 1 || indexed)
 		c->origin = true;
 
+	/*
+	 * Only copy up the metadata of a lower file that is not a hardlink,
+	 * then the lower data is found again by name on lookup.
+	 */
+	if (!S_ISREG(c->stat.mode) || c->stat.nlink != 1 || indexed ||
+	    !c->stat.size)
+		c->metacopy = false;
+
 	if (indexed) {
 		c->destdir = ovl_indexdir(c->dentry->d_sb);
 		err = ovl_get_index_name(c->lowerpath.dentry, &c->destname);
@@ -568,6 +595,13 @@ static int ovl_do_copy_up(struct ovl_copy_up_ctx *c)
 		}
 	}
 
+	if (!err) {
+		if (c->metacopy)
+			atomic64_inc(&ofs->stats.copy_up_meta);
+		else
+			atomic64_inc(&ofs->stats.copy_up);
+	}
+
 	if (indexed) {
 		if (!err)
 			ovl_set_flag(OVL_INDEX, d_inode(c->dentry));
@@ -587,7 +621,7 @@ static int ovl_do_copy_up(struct ovl_copy_up_ctx *c)
 }
 
 static int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
-			   int flags)
+			   int flags, bool meta)
 {
 	int err;
 	DEFINE_DELAYED_CALL(done);
@@ -596,6 +630,7 @@ static int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 		.parent = parent,
 		.dentry = dentry,
 		.workdir = ovl_workdir(dentry),
+		.metacopy = meta,
 	};
 
 	if (WARN_ON(!ctx.workdir))
@@ -644,7 +679,53 @@ static int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	return err;
 }
 
-int ovl_copy_up_flags(struct dentry *dentry, int flags)
+/*
+ * Copy the data of a metacopy upper from the lower file, after which the
+ * upper is an ordinary copy up.
+ */
+static int ovl_copy_up_meta_data(struct dentry *dentry)
+{
+	struct ovl_fs *ofs = dentry->d_sb->s_fs_info;
+	struct inode *inode = d_inode(dentry);
+	struct path lowerpath, upperpath;
+	struct kstat stat;
+	int err;
+
+	err = mutex_lock_interruptible(&OVL_I(inode)->lock);
+	if (err)
+		return err;
+	if (!ovl_test_flag(OVL_METACOPY, inode))
+		goto out;
+
+	ovl_path_lower(dentry, &lowerpath);
+	ovl_path_upper(dentry, &upperpath);
+	err = vfs_getattr(&upperpath, &stat, STATX_BASIC_STATS,
+			  AT_STATX_SYNC_AS_STAT);
+	if (err)
+		goto out;
+
+	err = ovl_copy_up_data(&lowerpath, &upperpath, stat.size);
+	if (err)
+		goto out;
+
+	inode_lock(d_inode(upperpath.dentry));
+	ovl_set_timestamps(upperpath.dentry, &stat);
+	inode_unlock(d_inode(upperpath.dentry));
+
+	err = vfs_removexattr(upperpath.dentry, OVL_XATTR_METACOPY);
+	if (err)
+		goto out;
+
+	/* the data must be in place before opens go to the upper */
+	smp_mb__before_atomic();
+	ovl_clear_flag(OVL_METACOPY, inode);
+	atomic64_inc(&ofs->stats.copy_up_data);
+out:
+	mutex_unlock(&OVL_I(inode)->lock);
+	return err;
+}
+
+static int __ovl_copy_up(struct dentry *dentry, int flags, bool meta)
 {
 	int err = 0;
 	const struct cred *old_cred = ovl_override_creds(dentry->d_sb);
@@ -667,8 +748,11 @@ int ovl_copy_up_flags(struct dentry *dentry, int flags)
 		 *      with rename.
 		 */
 		if (ovl_dentry_upper(dentry) &&
-		    ovl_dentry_has_upper_alias(dentry))
+		    ovl_dentry_has_upper_alias(dentry)) {
+			if (!meta && ovl_is_metacopy(d_inode(dentry)))
+				err = ovl_copy_up_meta_data(dentry);
 			break;
+		}
 
 		next = dget(dentry);
 		/* find the topmost dentry not yet copied up */
@@ -682,7 +766,8 @@ int ovl_copy_up_flags(struct dentry *dentry, int flags)
 			next = parent;
 		}
 
-		err = ovl_copy_up_one(parent, next, flags);
+		err = ovl_copy_up_one(parent, next, flags,
+				      meta && next == dentry);
 
 		dput(parent);
 		dput(next);
@@ -692,7 +777,24 @@ int ovl_copy_up_flags(struct dentry *dentry, int flags)
 	return err;
 }
 
+int ovl_copy_up_flags(struct dentry *dentry, int flags)
+{
+	return __ovl_copy_up(dentry, flags, false);
+}
+
 int ovl_copy_up(struct dentry *dentry)
 {
 	return ovl_copy_up_flags(dentry, 0);
 }
+
+/*
+ * Copy up for a change of attributes or xattrs only. With metacopy=on the
+ * data of a regular file is left in the lower layer until it is opened
+ * for write or truncated.
+ */
+int ovl_copy_up_meta(struct dentry *dentry)
+{
+	struct ovl_fs *ofs = dentry->d_sb->s_fs_info;
+
+	return __ovl_copy_up(dentry, 0, ofs->config.metacopy);
+}
@@ -14,9 +14,106 @@
 #include <linux/ratelimit.h>
 #include <linux/mount.h>
 #include <linux/exportfs.h>
+#include <linux/module.h>
+#include <linux/slab.h>
 #include "overlayfs.h"
 #include "ovl_entry.h"
 
+/*
+ * Lower layers do not change while they are part of an overlay, so a name
+ * that is in none of the lower layers of a directory stays absent. Each
+ * directory remembers a few such names, so that lookups of files that
+ * only exist in the upper layer, or nowhere, skip walking the lower layers.
+ */
+static bool __read_mostly ovl_neg_cache_enabled = true;
+module_param_named(neg_cache, ovl_neg_cache_enabled, bool, 0644);
+MODULE_PARM_DESC(ovl_neg_cache_enabled,
+		 "Remember names absent from the lower layers of a directory");
+
+#define OVL_NEG_CACHE_SIZE	8
+#define OVL_NEG_NAME_LEN	32
+
+struct ovl_neg_cache {
+	spinlock_t lock;
+	unsigned int next;
+	struct {
+		u64 hash_len;
+		char name[OVL_NEG_NAME_LEN];
+	} ent[OVL_NEG_CACHE_SIZE];
+};
+
+static bool ovl_neg_cache_hit(struct ovl_entry *poe, const struct qstr *name)
+{
+	struct ovl_neg_cache *nc = READ_ONCE(poe->negcache);
+	bool hit = false;
+	unsigned int i;
+
+	if (!nc || !ovl_neg_cache_enabled)
+		return false;
+
+	spin_lock(&nc->lock);
+	for (i = 0; i < OVL_NEG_CACHE_SIZE; i++) {
+		if (nc->ent[i].hash_len == name->hash_len &&
+		    !memcmp(nc->ent[i].name, name->name, name->len)) {
+			hit = true;
+			break;
+		}
+	}
+	spin_unlock(&nc->lock);
+
+	return hit;
+}
+
+static void ovl_neg_cache_add(struct ovl_entry *poe, const struct qstr *name)
+{
+	struct ovl_neg_cache *nc = READ_ONCE(poe->negcache);
+	unsigned int i;
+
+	if (!ovl_neg_cache_enabled || name->len >= OVL_NEG_NAME_LEN)
+		return;
+
+	if (!nc) {
+		nc = kzalloc(sizeof(*nc), GFP_KERNEL);
+		if (!nc)
+			return;
+		spin_lock_init(&nc->lock);
+		if (cmpxchg(&poe->negcache, NULL, nc)) {
+			kfree(nc);
+			nc = READ_ONCE(poe->negcache);
+		}
+	}
+
+	spin_lock(&nc->lock);
+	i = nc->next++ % OVL_NEG_CACHE_SIZE;
+	nc->ent[i].hash_len = name->hash_len;
+	memcpy(nc->ent[i].name, name->name, name->len);
+	spin_unlock(&nc->lock);
+}
+
+static void ovl_lookup_account(struct ovl_fs *ofs, u64 start,
+			       unsigned int layers, bool negative)
+{
+	struct ovl_stats *st = &ofs->stats;
+	u64 ns = ktime_get_ns() - start;
+	s64 max = atomic64_read(&st->lookup_max_ns);
+
+	atomic64_inc(&st->lookups);
+	if (negative)
+		atomic64_inc(&st->negative);
+	atomic64_add(layers, &st->layers);
+	atomic64_add(ns, &st->lookup_ns);
+	atomic64_inc(&st->lookup_lat[min_t(unsigned int,
+					   ilog2((ns >> 10) | 1),
+					   OVL_LAT_BUCKETS - 1)]);
+	while (ns > max) {
+		s64 old = atomic64_cmpxchg(&st->lookup_max_ns, max, ns);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
 struct ovl_lookup_data {
 	struct qstr name;
 	bool is_dir;
@@ -601,7 +698,9 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	bool upperopaque = false;
 	char *upperredirect = NULL;
 	struct dentry *this;
-	unsigned int i;
+	unsigned int i, layers = 0;
+	bool metacopy = false, neg_walk = false;
+	u64 start = ktime_get_ns();
 	int err;
 	struct ovl_lookup_data d = {
 		.name = dentry->d_name,
@@ -618,6 +717,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	old_cred = ovl_override_creds(dentry->d_sb);
 	upperdir = ovl_dentry_upper(dentry->d_parent);
 	if (upperdir) {
+		layers++;
 		err = ovl_lookup_layer(upperdir, &d, &upperdentry);
 		if (err)
 			goto out;
@@ -627,7 +727,12 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			err = -EREMOTE;
 			goto out;
 		}
-		if (upperdentry && !d.is_dir) {
+		if (upperdentry && !d.is_dir && ofs->config.metacopy &&
+		    ovl_check_metacopy_xattr(upperdentry)) {
+			/* the data is in the lower file of the same name */
+			metacopy = true;
+			d.stop = false;
+		} else if (upperdentry && !d.is_dir) {
 			BUG_ON(!d.stop || d.redirect);
 			/*
 			 * Lookup copy up origin by decoding origin file handle.
@@ -656,6 +761,15 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 		upperopaque = d.opaque;
 	}
 
+	if (!d.stop && poe->numlower && !d.redirect && !metacopy) {
+		if (ovl_neg_cache_hit(poe, &dentry->d_name)) {
+			atomic64_inc(&ofs->stats.neg_hits);
+			d.stop = true;
+		} else {
+			neg_walk = true;
+		}
+	}
+
 	if (!d.stop && poe->numlower) {
 		err = -ENOMEM;
 		stack = kcalloc(ofs->numlower, sizeof(struct path),
@@ -668,6 +782,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 		struct path lowerpath = poe->lowerstack[i];
 
 		d.last = i == poe->numlower - 1;
+		layers++;
 		err = ovl_lookup_layer(lowerpath.dentry, &d, &this);
 		if (err)
 			goto out_put;
@@ -694,6 +809,16 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 		}
 	}
 
+	if (metacopy && (!ctr || !d_is_reg(stack[0].dentry))) {
+		pr_warn_ratelimited("overlayfs: no lower data for metacopy (%pd2)\n",
+				    upperdentry);
+		err = -EIO;
+		goto out_put;
+	}
+
+	if (neg_walk && !ctr && !d.stop)
+		ovl_neg_cache_add(poe, &dentry->d_name);
+
 	/* Lookup index by lower inode and verify it matches upper inode */
 	if (ctr && !d.is_dir && ovl_indexdir(dentry->d_sb)) {
 		struct dentry *origin = stack[0].dentry;
@@ -736,6 +861,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	kfree(stack);
 	kfree(d.redirect);
 	d_add(dentry, inode);
+	ovl_lookup_account(ofs, start, layers, !inode);
 
 	return NULL;
 
@@ -753,6 +879,7 @@ out_put_upper:
 out:
 	kfree(d.redirect);
 	ovl_revert_creds(old_cred);
+	ovl_lookup_account(ofs, start, layers, false);
 	return ERR_PTR(err);
 }
 
@@ -776,6 +903,9 @@ bool ovl_lower_positive(struct dentry *dentry)
 	if (!ovl_dentry_upper(dentry))
 		return true;
 
+	if (ovl_neg_cache_hit(poe, name))
+		return false;
+
 	/* Positive upper -> have to look up lower to see whether it exists */
 	for (i = 0; !done && !positive && i < poe->numlower; i++) {
 		struct dentry *this;
@@ -16,6 +16,26 @@ struct ovl_config {
 	bool redirect_dir;
 	bool index;
 	bool override_creds;
+	bool metacopy;
+};
+
+/* log2 buckets of lookup latency in microseconds */
+#define OVL_LAT_BUCKETS	16
+
+struct ovl_stats {
+	atomic64_t lookups;
+	atomic64_t negative;
+	/* layers looked up in, upper included */
+	atomic64_t layers;
+	/* lookups that skipped the lower layers thanks to the negative cache */
+	atomic64_t neg_hits;
+	atomic64_t lookup_ns;
+	atomic64_t lookup_max_ns;
+	atomic64_t lookup_lat[OVL_LAT_BUCKETS];
+	atomic64_t copy_up;
+	atomic64_t copy_up_meta;
+	/* metacopy uppers that later needed their data */
+	atomic64_t copy_up_data;
 };
 
 /* private information held for overlayfs's superblock */
@@ -41,6 +61,8 @@ struct ovl_fs {
 	/* Did we take the inuse lock? */
 	bool upperdir_locked;
 	bool workdir_locked;
+	struct ovl_stats stats;
+	struct dentry *debugfs;
 };
 
 /* private information held for every overlayfs dentry */
@@ -52,6 +74,8 @@ struct ovl_entry {
 		};
 		struct rcu_head rcu;
 	};
+	/* names known to be absent from all of lowerstack */
+	struct ovl_neg_cache *negcache;
 	unsigned numlower;
 	struct path lowerstack[];
 };
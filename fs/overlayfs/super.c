@@ -17,6 +17,7 @@
 #include <linux/statfs.h>
 #include <linux/seq_file.h>
 #include <linux/posix_acl_xattr.h>
+#include <linux/debugfs.h>
 #include "overlayfs.h"
 #include "ovl_entry.h"
 
@@ -44,6 +45,13 @@ module_param_named(override_creds, ovl_override_creds_def, bool, 0644);
 MODULE_PARM_DESC(ovl_override_creds_def,
 		 "Use mounter's credentials for accesses");
 
+static bool ovl_metacopy_def;
+module_param_named(metacopy, ovl_metacopy_def, bool, 0644);
+MODULE_PARM_DESC(ovl_metacopy_def,
+		 "Default to on or off for the metadata only copy up feature");
+
+static struct dentry *ovl_debugfs_root;
+
 static void ovl_dentry_release(struct dentry *dentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -53,6 +61,7 @@ static void ovl_dentry_release(struct dentry *dentry)
 
 		for (i = 0; i < oe->numlower; i++)
 			dput(oe->lowerstack[i].dentry);
+		kfree(oe->negcache);
 		kfree_rcu(oe, rcu);
 	}
 }
@@ -96,6 +105,9 @@ static struct dentry *ovl_d_real(struct dentry *dentry,
 	}
 
 	real = ovl_dentry_upper(dentry);
+	/* The data of a metacopy upper is still read from the lower file */
+	if (real && !inode && ovl_is_metacopy(d_inode(dentry)))
+		real = NULL;
 	if (real && (!inode || inode == d_inode(real))) {
 		if (!inode) {
 			err = ovl_check_append_only(d_inode(real), open_flags);
@@ -218,6 +230,7 @@ static void ovl_put_super(struct super_block *sb)
 	struct ovl_fs *ufs = sb->s_fs_info;
 	unsigned i;
 
+	debugfs_remove(ufs->debugfs);
 	dput(ufs->indexdir);
 	dput(ufs->workdir);
 	if (ufs->workdir_locked)
@@ -338,9 +351,49 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 	if (ufs->config.override_creds != ovl_override_creds_def)
 		seq_show_option(m, "override_creds",
 				ufs->config.override_creds ? "on" : "off");
+	if (ufs->config.metacopy != ovl_metacopy_def)
+		seq_printf(m, ",metacopy=%s",
+			   ufs->config.metacopy ? "on" : "off");
 	return 0;
 }
 
+static int ovl_stats_show(struct seq_file *m, void *v)
+{
+	struct ovl_fs *ufs = m->private;
+	struct ovl_stats *st = &ufs->stats;
+	int i;
+
+	seq_printf(m, "lookups: %lld\n", atomic64_read(&st->lookups));
+	seq_printf(m, "negative: %lld\n", atomic64_read(&st->negative));
+	seq_printf(m, "layers: %lld\n", atomic64_read(&st->layers));
+	seq_printf(m, "neg_cache_hits: %lld\n", atomic64_read(&st->neg_hits));
+	seq_printf(m, "lookup_ns: %lld\n", atomic64_read(&st->lookup_ns));
+	seq_printf(m, "lookup_max_ns: %lld\n",
+		   atomic64_read(&st->lookup_max_ns));
+	seq_puts(m, "lookup_us_log2:");
+	for (i = 0; i < OVL_LAT_BUCKETS; i++)
+		seq_printf(m, " %lld", atomic64_read(&st->lookup_lat[i]));
+	seq_putc(m, '\n');
+	seq_printf(m, "copy_up: %lld\n", atomic64_read(&st->copy_up));
+	seq_printf(m, "copy_up_meta: %lld\n",
+		   atomic64_read(&st->copy_up_meta));
+	seq_printf(m, "copy_up_data: %lld\n",
+		   atomic64_read(&st->copy_up_data));
+	return 0;
+}
+
+static int ovl_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ovl_stats_show, inode->i_private);
+}
+
+static const struct file_operations ovl_stats_fops = {
+	.open		= ovl_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int ovl_remount(struct super_block *sb, int *flags, char *data)
 {
 	struct ovl_fs *ufs = sb->s_fs_info;
@@ -373,6 +426,8 @@ enum {
 	OPT_INDEX_OFF,
 	OPT_OVERRIDE_CREDS_ON,
 	OPT_OVERRIDE_CREDS_OFF,
+	OPT_METACOPY_ON,
+	OPT_METACOPY_OFF,
 	OPT_ERR,
 };
 
@@ -387,6 +442,8 @@ static const match_table_t ovl_tokens = {
 	{OPT_INDEX_OFF,			"index=off"},
 	{OPT_OVERRIDE_CREDS_ON,		"override_creds=on"},
 	{OPT_OVERRIDE_CREDS_OFF,	"override_creds=off"},
+	{OPT_METACOPY_ON,		"metacopy=on"},
+	{OPT_METACOPY_OFF,		"metacopy=off"},
 	{OPT_ERR,			NULL}
 };
 
@@ -476,6 +533,14 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 			config->override_creds = false;
 			break;
 
+		case OPT_METACOPY_ON:
+			config->metacopy = true;
+			break;
+
+		case OPT_METACOPY_OFF:
+			config->metacopy = false;
+			break;
+
 		default:
 			pr_err("overlayfs: unrecognized mount option \"%s\" or missing value\n", p);
 			return -EINVAL;
@@ -913,6 +978,7 @@ static int ovl_fill_super(struct super_block *sb, void *data, int silent)
 
 	ufs->config.redirect_dir = ovl_redirect_dir_def;
 	ufs->config.index = ovl_index_def;
+	ufs->config.metacopy = ovl_metacopy_def;
 	err = ovl_parse_opt((char *) data, &ufs->config);
 	if (err)
 		goto out_free_config;
@@ -1157,6 +1223,10 @@ static int ovl_fill_super(struct super_block *sb, void *data, int silent)
 	if (!ufs->indexdir)
 		ufs->config.index = false;
 
+	/* Metacopy uppers are marked with an xattr */
+	if (!ufs->upper_mnt || ufs->noxattr)
+		ufs->config.metacopy = false;
+
 	if (remote)
 		sb->s_d_op = &ovl_reval_dentry_operations;
 	else
@@ -1208,6 +1278,16 @@ static int ovl_fill_super(struct super_block *sb, void *data, int silent)
 		       ovl_dentry_lower(root_dentry));
 
 	sb->s_root = root_dentry;
+
+	if (ovl_debugfs_root) {
+		char name[24];
+
+		snprintf(name, sizeof(name), "%u:%u",
+			 MAJOR(sb->s_dev), MINOR(sb->s_dev));
+		ufs->debugfs = debugfs_create_file(name, 0444,
+						   ovl_debugfs_root, ufs,
+						   &ovl_stats_fops);
+	}
 	return 0;
 
 out_free_oe:
@@ -1282,15 +1362,23 @@ static int __init ovl_init(void)
 		return -ENOMEM;
 
 	err = register_filesystem(&ovl_fs_type);
-	if (err)
+	if (err) {
 		kmem_cache_destroy(ovl_inode_cachep);
+		return err;
+	}
 
-	return err;
+	/* lookup and copy up statistics per mount, named by st_dev */
+	ovl_debugfs_root = debugfs_create_dir("overlayfs", NULL);
+	if (IS_ERR(ovl_debugfs_root))
+		ovl_debugfs_root = NULL;
+
+	return 0;
 }
 
 static void __exit ovl_exit(void)
 {
 	unregister_filesystem(&ovl_fs_type);
+	debugfs_remove(ovl_debugfs_root);
 
 	/*
 	 * Make sure all delayed rcu free inodes are flushed before we
@@ -357,6 +357,27 @@ void ovl_copy_up_end(struct dentry *dentry)
 	mutex_unlock(&OVL_I(d_inode(dentry))->lock);
 }
 
+/* Is @dentry an upper file that only has the metadata of its lower? */
+bool ovl_check_metacopy_xattr(struct dentry *dentry)
+{
+	ssize_t res;
+
+	if (!d_is_reg(dentry))
+		return false;
+
+	res = ovl_vfs_getxattr(dentry, OVL_XATTR_METACOPY, NULL, 0);
+	return res >= 0;
+}
+
+bool ovl_is_metacopy(struct inode *inode)
+{
+	bool ret = ovl_test_flag(OVL_METACOPY, inode);
+
+	/* pairs with smp_mb__before_atomic() in ovl_copy_up_meta_data() */
+	smp_rmb();
+	return ret;
+}
+
 bool ovl_check_dir_xattr(struct dentry *dentry, const char *name)
 {
 	ssize_t res;
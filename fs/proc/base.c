@@ -81,6 +81,8 @@
 #include <linux/poll.h>
 #include <linux/nsproxy.h>
 #include <linux/oom.h>
+#include <linux/reclaim_class.h>
+#include <linux/mm_wss.h>
 #include <linux/elf.h>
 #include <linux/pid_namespace.h>
 #include <linux/user_namespace.h>
@@ -95,6 +97,7 @@
 #include <linux/flex_array.h>
 #include <linux/posix-timers.h>
 #include <linux/cpufreq_times.h>
+#include <linux/simple_lmk.h>
 #ifdef CONFIG_HARDWALL
 #include <asm/hardwall.h>
 #endif
@@ -564,6 +567,37 @@ static const struct limit_names lnames[RLIM_NLIMITS] = {
 	[RLIMIT_RTTIME] = {"Max realtime timeout", "us"},
 };
 
+#ifdef CONFIG_MM_WSS
+static int proc_pid_wss(struct seq_file *m, struct pid_namespace *ns,
+			struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm = get_task_mm(task);
+
+	if (mm) {
+		mm_wss_show(m, mm);
+		mmput(mm);
+	}
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_KSM
+static int proc_pid_ksm_merging_pages(struct seq_file *m,
+				      struct pid_namespace *ns,
+				      struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm = get_task_mm(task);
+
+	if (mm) {
+		seq_printf(m, "%lu\n", READ_ONCE(mm->ksm_merging_pages));
+		mmput(mm);
+	}
+
+	return 0;
+}
+#endif
+
 /* Display limits for a process */
 static int proc_pid_limits(struct seq_file *m, struct pid_namespace *ns,
 			   struct pid *pid, struct task_struct *task)
@@ -1059,6 +1093,7 @@ static int __set_oom_adj(struct file *file, int oom_adj, bool legacy)
 		struct task_struct *p = find_lock_task_mm(task);
 
 		if (p) {
+			reclaim_class_update(p->mm, oom_adj);
 			if (atomic_read(&p->mm->mm_users) > 1) {
 				mm = p->mm;
 				mmgrab(mm);
@@ -1071,6 +1106,7 @@ static int __set_oom_adj(struct file *file, int oom_adj, bool legacy)
 	if (!legacy && has_capability_noaudit(current, CAP_SYS_RESOURCE))
 		task->signal->oom_score_adj_min = (short)oom_adj;
 	trace_oom_score_adj_update(task);
+	simple_lmk_adj_changed(task);
 
 	if (mm) {
 		struct task_struct *p;
@@ -1091,6 +1127,7 @@ static int __set_oom_adj(struct file *file, int oom_adj, bool legacy)
 					p->signal->oom_score_adj_min = (short)oom_adj;
 			}
 			task_unlock(p);
+			simple_lmk_adj_changed(p);
 		}
 		rcu_read_unlock();
 		mmdrop(mm);
@@ -1640,6 +1677,70 @@ static const struct file_operations proc_pid_sched_group_id_operations = {
 	.release	= single_release,
 };
 
+static int sched_group_frame_period_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	seq_printf(m, "%u\n", sched_get_group_frame_period(p));
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+static ssize_t
+sched_group_frame_period_write(struct file *file, const char __user *buf,
+	    size_t count, loff_t *offset)
+{
+	struct inode *inode = file_inode(file);
+	struct task_struct *p;
+	char buffer[PROC_NUMBUF];
+	unsigned int period_us;
+	int err;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count)) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	err = kstrtouint(strstrip(buffer), 0, &period_us);
+	if (err)
+		goto out;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	err = sched_set_group_frame_period(p, period_us);
+
+	put_task_struct(p);
+
+out:
+	return err < 0 ? err : count;
+}
+
+static int sched_group_frame_period_open(struct inode *inode,
+					 struct file *filp)
+{
+	return single_open(filp, sched_group_frame_period_show, inode);
+}
+
+static const struct file_operations proc_pid_sched_group_frame_period_operations = {
+	.open		= sched_group_frame_period_open,
+	.read		= seq_read,
+	.write		= sched_group_frame_period_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 #endif	/* CONFIG_SCHED_WALT */
 
 #ifdef CONFIG_SCHED_AUTOGROUP
@@ -3295,6 +3396,8 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHED_WALT
 	REG("sched_init_task_load", 00644, proc_pid_sched_init_task_load_operations),
 	REG("sched_group_id", 00666, proc_pid_sched_group_id_operations),
+	REG("sched_group_frame_period", 00666,
+	    proc_pid_sched_group_frame_period_operations),
 	REG("sched_boost", 0666,  proc_task_boost_enabled_operations),
 	REG("sched_boost_period_ms", 0666, proc_task_boost_period_operations),
 #endif
@@ -3323,7 +3426,16 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("mountinfo",  S_IRUGO, proc_mountinfo_operations),
 	REG("mountstats", S_IRUSR, proc_mountstats_operations),
 #ifdef CONFIG_PROCESS_RECLAIM
-	REG("reclaim", 0222, proc_reclaim_operations),
+	REG("reclaim", 0622, proc_reclaim_operations),
+#ifdef CONFIG_SWAP
+	REG("prefetch", 0222, proc_prefetch_operations),
+#endif
+#endif
+#ifdef CONFIG_MM_WSS
+	ONE("wss",        S_IRUSR, proc_pid_wss),
+#endif
+#ifdef CONFIG_KSM
+	ONE("ksm_merging_pages", S_IRUSR, proc_pid_ksm_merging_pages),
 #endif
 #ifdef CONFIG_PROC_PAGE_MONITOR
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
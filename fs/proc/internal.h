@@ -200,6 +200,7 @@ extern const struct inode_operations proc_link_inode_operations;
 
 extern const struct inode_operations proc_pid_link_inode_operations;
 extern const struct file_operations proc_reclaim_operations;
+extern const struct file_operations proc_prefetch_operations;
 
 extern void proc_init_inodecache(void);
 void set_proc_pid_nlink(void);
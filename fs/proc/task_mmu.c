@@ -16,6 +16,7 @@
 #include <linux/swapops.h>
 #include <linux/mmu_notifier.h>
 #include <linux/page_idle.h>
+#include <linux/poll.h>
 #include <linux/shmem_fs.h>
 #include <linux/uaccess.h>
 #include <linux/mm_inline.h>
@@ -24,6 +25,7 @@
 #endif
 
 #include <linux/ctype.h>
+#include <linux/sizes.h>
 
 #include <asm/elf.h>
 #include <asm/tlb.h>
@@ -982,6 +984,21 @@ static int show_smap(struct seq_file *m, void *v, int is_pid)
 			   (unsigned long)(mss->pss_locked >> (10 + PSS_SHIFT)));
 
 	if (!rollup_mode) {
+#ifdef CONFIG_FAULT_AROUND_HINT
+		unsigned long hint = (vma->vm_flags & VM_FAULTAROUND_MASK) >>
+			VM_FAULTAROUND_SHIFT;
+
+		if (hint)
+			seq_printf(m, "FaultAround:    %8lu kB\n",
+				   PAGE_SIZE << (hint - 1) >> 10);
+		seq_printf(m,
+			   "ReadFaults:     %8ld\n"
+			   "AroundFaults:   %8ld\n"
+			   "MajorFaults:    %8ld\n",
+			   atomic_long_read(&vma->vm_read_faults),
+			   atomic_long_read(&vma->vm_around_faults),
+			   atomic_long_read(&vma->vm_major_faults));
+#endif
 		arch_show_smap(m, vma);
 		show_smap_vma_flags(m, vma);
 	}
@@ -1732,6 +1749,11 @@ const struct file_operations proc_pagemap_operations = {
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
 #ifdef CONFIG_PROCESS_RECLAIM
+static inline bool reclaim_stopped(struct reclaim_param *rp)
+{
+	return rp->stop && READ_ONCE(*rp->stop);
+}
+
 static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
 				unsigned long end, struct mm_walk *walk)
 {
@@ -1745,7 +1767,8 @@ static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
 	int reclaimed;
 
 	split_huge_pmd(vma, addr, pmd);
-	if (pmd_trans_unstable(pmd) || !rp->nr_to_reclaim)
+	if (pmd_trans_unstable(pmd) || !rp->nr_to_reclaim ||
+			reclaim_stopped(rp))
 		return 0;
 cont:
 	isolated = 0;
@@ -1759,6 +1782,12 @@ cont:
 		if (!page)
 			continue;
 
+		/* Referenced since the request started aging, keep it */
+		if (rp->idle_only && (pte_young(ptent) || !page_is_idle(page))) {
+			rp->nr_skipped++;
+			continue;
+		}
+
 		if (isolate_lru_page(compound_head(page)))
 			continue;
 
@@ -1789,7 +1818,7 @@ cont:
 	if (rp->nr_to_reclaim < 0)
 		rp->nr_to_reclaim = 0;
 
-	if (rp->nr_to_reclaim && (addr != end))
+	if (rp->nr_to_reclaim && (addr != end) && !reclaim_stopped(rp))
 		goto cont;
 
 	cond_resched();
@@ -1803,8 +1832,176 @@ enum reclaim_type {
 	RECLAIM_RANGE,
 };
 
-struct reclaim_param reclaim_task_anon(struct task_struct *task,
-		int nr_to_reclaim)
+/*
+ * Every open file of /proc/PID/reclaim carries one request. A synchronous
+ * request runs in the writer's context as before. An asynchronous one runs
+ * from an unbound worker and can first age the pages: "age=N" takes N scans
+ * interval_ms apart, and only pages whose pte was not young in any of them
+ * are reclaimed. The writer polls the file for completion and reads the
+ * stats back; a new request, "cancel" or closing the file stops the
+ * running one.
+ */
+#define RECLAIM_AGE_INTERVAL_MS	1000
+
+enum reclaim_state {
+	RECLAIM_IDLE,
+	RECLAIM_RUNNING,
+	RECLAIM_DONE,
+	RECLAIM_CANCELLED,
+};
+
+static const char * const reclaim_state_names[] = {
+	[RECLAIM_IDLE]		= "idle",
+	[RECLAIM_RUNNING]	= "running",
+	[RECLAIM_DONE]		= "done",
+	[RECLAIM_CANCELLED]	= "cancelled",
+};
+
+struct reclaim_req {
+	/* serializes requests on the file, never taken by the worker */
+	struct mutex lock;
+	wait_queue_head_t wait;
+	struct delayed_work work;
+	/* pinned with mmgrab(), an exiting task just ends the request */
+	struct mm_struct *mm;
+	enum reclaim_type type;
+	unsigned long start;
+	unsigned long end;
+	int age;
+	int pass;
+	unsigned int interval_ms;
+	bool stop;
+	enum reclaim_state state;
+	struct reclaim_param rp;
+};
+
+/*
+ * One aging scan: a young pte marks its page referenced, and on the first
+ * scan every other page is marked idle. As with idle page tracking the
+ * cleared young bit is handed over to PG_young, so that page reclaim still
+ * sees the reference.
+ */
+static int reclaim_age_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_req *req = walk->private;
+	struct vm_area_struct *vma = req->rp.vma;
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+	struct page *page;
+
+	split_huge_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd) || READ_ONCE(req->stop))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		if (!pte_present(*pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page)
+			continue;
+
+		if (ptep_clear_young_notify(vma, addr, pte)) {
+			set_page_young(compound_head(page));
+			clear_page_idle(page);
+		} else if (!req->pass) {
+			set_page_idle(page);
+		}
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+
+	cond_resched();
+	return 0;
+}
+
+static void reclaim_walk_vmas(struct mm_struct *mm, struct mm_walk *walk,
+		struct reclaim_param *rp, enum reclaim_type type,
+		unsigned long start, unsigned long end)
+{
+	struct vm_area_struct *vma;
+
+	for (vma = find_vma(mm, start); vma && vma->vm_start < end;
+			vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma))
+			continue;
+
+		if (type == RECLAIM_ANON && vma->vm_file)
+			continue;
+
+		if (type == RECLAIM_FILE && !vma->vm_file)
+			continue;
+
+		if (!rp->nr_to_reclaim || reclaim_stopped(rp))
+			break;
+
+		rp->vma = vma;
+		walk_page_range(max(vma->vm_start, start),
+				min(vma->vm_end, end), walk);
+	}
+}
+
+static void reclaim_req_work(struct work_struct *work)
+{
+	struct reclaim_req *req = container_of(to_delayed_work(work),
+					struct reclaim_req, work);
+	struct mm_struct *mm = req->mm;
+	struct mm_walk reclaim_walk = {
+		.mm = mm,
+	};
+	bool aging = req->pass < req->age;
+
+	if (!mmget_not_zero(mm))
+		goto done;
+
+	if (aging) {
+		reclaim_walk.pmd_entry = reclaim_age_pte_range;
+		reclaim_walk.private = req;
+	} else {
+		reclaim_walk.pmd_entry = reclaim_pte_range;
+		reclaim_walk.private = &req->rp;
+		req->rp.idle_only = req->age > 0;
+	}
+
+	down_read(&mm->mmap_sem);
+	reclaim_walk_vmas(mm, &reclaim_walk, &req->rp, req->type,
+			req->start, req->end);
+	flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	if (aging && !READ_ONCE(req->stop)) {
+		req->pass++;
+		queue_delayed_work(system_unbound_wq, &req->work,
+				msecs_to_jiffies(req->interval_ms));
+		return;
+	}
+done:
+	WRITE_ONCE(req->state, READ_ONCE(req->stop) ?
+			RECLAIM_CANCELLED : RECLAIM_DONE);
+	wake_up_interruptible(&req->wait);
+}
+
+static void reclaim_req_cancel(struct reclaim_req *req)
+{
+	WRITE_ONCE(req->stop, true);
+	cancel_delayed_work_sync(&req->work);
+
+	/* Stopped before the worker got to run */
+	if (req->state == RECLAIM_RUNNING) {
+		WRITE_ONCE(req->state, RECLAIM_CANCELLED);
+		wake_up_interruptible(&req->wait);
+	}
+
+	if (req->mm) {
+		mmdrop(req->mm);
+		req->mm = NULL;
+	}
+}
+
+static struct reclaim_param reclaim_task_vmas(struct task_struct *task,
+		int nr_to_reclaim, bool file)
 {
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
@@ -1828,7 +2025,7 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 		if (is_vm_hugetlb_page(vma))
 			continue;
 
-		if (vma->vm_file)
+		if (!vma->vm_file != !file)
 			continue;
 
 		if (!rp.nr_to_reclaim)
@@ -1847,19 +2044,32 @@ out:
 	return rp;
 }
 
+struct reclaim_param reclaim_task_anon(struct task_struct *task,
+		int nr_to_reclaim)
+{
+	return reclaim_task_vmas(task, nr_to_reclaim, false);
+}
+
+struct reclaim_param reclaim_task_file(struct task_struct *task,
+		int nr_to_reclaim)
+{
+	return reclaim_task_vmas(task, nr_to_reclaim, true);
+}
+
 static ssize_t reclaim_write(struct file *file, const char __user *buf,
 				size_t count, loff_t *ppos)
 {
+	struct reclaim_req *req = file->private_data;
 	struct task_struct *task;
 	char buffer[200];
 	struct mm_struct *mm;
-	struct vm_area_struct *vma;
 	enum reclaim_type type;
-	char *type_buf;
-	struct mm_walk reclaim_walk = {};
+	char *type_buf, *token;
 	unsigned long start = 0;
-	unsigned long end = 0;
-	struct reclaim_param rp;
+	unsigned long end = ULONG_MAX;
+	unsigned int interval_ms = RECLAIM_AGE_INTERVAL_MS;
+	int age = 0, budget = INT_MAX;
+	bool async = false;
 
 	memset(buffer, 0, sizeof(buffer));
 	if (count > sizeof(buffer) - 1)
@@ -1869,24 +2079,28 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 		return -EFAULT;
 
 	type_buf = strstrip(buffer);
-	if (!strcmp(type_buf, "file"))
+	token = strsep(&type_buf, " ");
+	if (!strcmp(token, "cancel")) {
+		mutex_lock(&req->lock);
+		reclaim_req_cancel(req);
+		mutex_unlock(&req->lock);
+		return count;
+	}
+
+	if (!strcmp(token, "file"))
 		type = RECLAIM_FILE;
-	else if (!strcmp(type_buf, "anon"))
+	else if (!strcmp(token, "anon"))
 		type = RECLAIM_ANON;
-	else if (!strcmp(type_buf, "all"))
+	else if (!strcmp(token, "all"))
 		type = RECLAIM_ALL;
-	else if (isdigit(*type_buf))
+	else if (isdigit(*token))
 		type = RECLAIM_RANGE;
 	else
 		goto out_err;
 
 	if (type == RECLAIM_RANGE) {
-		char *token;
 		unsigned long long len, len_in, tmp;
 
-		token = strsep(&type_buf, " ");
-		if (!token)
-			goto out_err;
 		tmp = memparse(token, &token);
 		if (tmp & ~PAGE_MASK || tmp > ULONG_MAX)
 			goto out_err;
@@ -1911,6 +2125,28 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 			goto out_err;
 	}
 
+	while ((token = strsep(&type_buf, " ")) != NULL) {
+		if (!*token)
+			continue;
+		if (!strcmp(token, "async"))
+			async = true;
+		else if (!strncmp(token, "age=", 4)) {
+			if (kstrtoint(token + 4, 0, &age) || age < 0)
+				goto out_err;
+		} else if (!strncmp(token, "budget=", 7)) {
+			if (kstrtoint(token + 7, 0, &budget) || budget <= 0)
+				goto out_err;
+		} else if (!strncmp(token, "interval=", 9)) {
+			if (kstrtouint(token + 9, 0, &interval_ms))
+				goto out_err;
+		} else
+			goto out_err;
+	}
+
+	/* Aging needs the idle flag and must not hold up the writer */
+	if (age && (!async || !IS_ENABLED(CONFIG_IDLE_PAGE_TRACKING)))
+		goto out_err;
+
 	task = get_proc_task(file->f_path.dentry->d_inode);
 	if (!task)
 		return -ESRCH;
@@ -1919,60 +2155,332 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 	if (!mm)
 		goto out;
 
-	reclaim_walk.mm = mm;
-	reclaim_walk.pmd_entry = reclaim_pte_range;
+	mutex_lock(&req->lock);
+	reclaim_req_cancel(req);
+
+	mmgrab(mm);
+	req->mm = mm;
+	req->type = type;
+	req->start = start;
+	req->end = end;
+	req->age = age;
+	req->pass = 0;
+	req->interval_ms = interval_ms;
+	req->stop = false;
+	memset(&req->rp, 0, sizeof(req->rp));
+	req->rp.nr_to_reclaim = budget;
+	req->rp.stop = &req->stop;
+	req->state = RECLAIM_RUNNING;
+
+	if (async)
+		queue_delayed_work(system_unbound_wq, &req->work, 0);
+	else
+		reclaim_req_work(&req->work.work);
+	mutex_unlock(&req->lock);
 
-	rp.nr_to_reclaim = INT_MAX;
-	rp.nr_reclaimed = 0;
-	reclaim_walk.private = &rp;
+	mmput(mm);
+out:
+	put_task_struct(task);
+	return count;
 
-	down_read(&mm->mmap_sem);
-	if (type == RECLAIM_RANGE) {
-		vma = find_vma(mm, start);
-		while (vma) {
-			if (vma->vm_start > end)
-				break;
-			if (is_vm_hugetlb_page(vma))
-				continue;
+out_err:
+	return -EINVAL;
+}
 
-			rp.vma = vma;
-			walk_page_range(max(vma->vm_start, start),
-					min(vma->vm_end, end),
-					&reclaim_walk);
-			vma = vma->vm_next;
-		}
-	} else {
-		for (vma = mm->mmap; vma; vma = vma->vm_next) {
-			if (is_vm_hugetlb_page(vma))
-				continue;
+/* Every read returns the stats of the latest request in full */
+static ssize_t reclaim_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct reclaim_req *req = file->private_data;
+	char buffer[128];
+	loff_t pos = 0;
+	int len;
+
+	len = scnprintf(buffer, sizeof(buffer),
+			"state=%s scanned=%d reclaimed=%d skipped=%d\n",
+			reclaim_state_names[READ_ONCE(req->state)],
+			req->rp.nr_scanned, req->rp.nr_reclaimed,
+			req->rp.nr_skipped);
 
-			if (type == RECLAIM_ANON && vma->vm_file)
-				continue;
+	return simple_read_from_buffer(buf, count, &pos, buffer, len);
+}
 
-			if (type == RECLAIM_FILE && !vma->vm_file)
-				continue;
+static unsigned int reclaim_poll(struct file *file, poll_table *wait)
+{
+	struct reclaim_req *req = file->private_data;
+	enum reclaim_state state;
 
-			rp.vma = vma;
-			walk_page_range(vma->vm_start, vma->vm_end,
-				&reclaim_walk);
+	poll_wait(file, &req->wait, wait);
+
+	state = READ_ONCE(req->state);
+	if (state == RECLAIM_DONE || state == RECLAIM_CANCELLED)
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
+static int reclaim_open(struct inode *inode, struct file *file)
+{
+	struct reclaim_req *req;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	mutex_init(&req->lock);
+	init_waitqueue_head(&req->wait);
+	INIT_DELAYED_WORK(&req->work, reclaim_req_work);
+	file->private_data = req;
+
+	return 0;
+}
+
+static int reclaim_release(struct inode *inode, struct file *file)
+{
+	struct reclaim_req *req = file->private_data;
+
+	reclaim_req_cancel(req);
+	kfree(req);
+
+	return 0;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.open		= reclaim_open,
+	.read		= reclaim_read,
+	.write		= reclaim_write,
+	.poll		= reclaim_poll,
+	.release	= reclaim_release,
+	.llseek		= noop_llseek,
+};
+
+#ifdef CONFIG_SWAP
+/*
+ * Swap-in prefetch: the anonymous mappings of a task are split into about
+ * one chunk per online CPU and each chunk is faulted into the swap cache
+ * from an unbound worker, so that the decompression of zram backed swap
+ * runs in parallel instead of one fault at a time on the app's thread.
+ */
+#define PREFETCH_MIN_CHUNK	SZ_2M
+
+struct prefetch_work {
+	struct work_struct work;
+	struct mm_struct *mm;
+	unsigned long start;
+	unsigned long end;
+	atomic_t *budget;
+	atomic_t *nr_prefetched;
+	atomic_t *remaining;
+	struct completion *done;
+};
+
+struct prefetch_walk {
+	struct vm_area_struct *vma;
+	struct prefetch_work *pw;
+};
+
+static int prefetch_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct prefetch_walk *pwk = walk->private;
+	struct vm_area_struct *vma = pwk->vma;
+	pte_t *orig_pte;
+	spinlock_t *ptl;
+
+	if (pmd_none_or_trans_huge_or_clear_bad(pmd))
+		return 0;
+
+	for (; addr != end; addr += PAGE_SIZE) {
+		pte_t pte;
+		swp_entry_t entry;
+		struct page *page;
+
+		orig_pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+		pte = *orig_pte;
+		pte_unmap_unlock(orig_pte, ptl);
+
+		if (pte_present(pte) || pte_none(pte))
+			continue;
+		entry = pte_to_swp_entry(pte);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+
+		if (atomic_dec_return(pwk->pw->budget) < 0)
+			return 1;
+
+		page = read_swap_cache_async(entry, GFP_HIGHUSER_MOVABLE,
+						vma, addr, false);
+		if (page) {
+			atomic_inc(pwk->pw->nr_prefetched);
+			put_page(page);
 		}
 	}
 
-	flush_tlb_mm(mm);
+	cond_resched();
+	return 0;
+}
+
+static void prefetch_work_fn(struct work_struct *work)
+{
+	struct prefetch_work *pw = container_of(work, struct prefetch_work,
+						work);
+	struct mm_struct *mm = pw->mm;
+	struct vm_area_struct *vma;
+	struct prefetch_walk pwk = { .pw = pw };
+	struct mm_walk prefetch_walk = {
+		.mm = mm,
+		.pmd_entry = prefetch_pte_range,
+		.private = &pwk,
+	};
+
+	down_read(&mm->mmap_sem);
+	for (vma = find_vma(mm, pw->start); vma && vma->vm_start < pw->end;
+			vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma) || vma->vm_file)
+			continue;
+
+		if (atomic_read(pw->budget) <= 0)
+			break;
+
+		pwk.vma = vma;
+		walk_page_range(max(vma->vm_start, pw->start),
+				min(vma->vm_end, pw->end), &prefetch_walk);
+	}
 	up_read(&mm->mmap_sem);
+
+	/* Push the new pages onto the LRU now */
+	lru_add_drain();
+
+	if (atomic_dec_and_test(pw->remaining))
+		complete(pw->done);
+}
+
+/*
+ * Bring back up to @nr_pages swapped out anonymous pages of @task.
+ * Returns the number of pages that were read into the swap cache.
+ */
+int prefetch_task_anon(struct task_struct *task, int nr_pages)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	struct prefetch_work *works;
+	unsigned long total = 0, target, acc = 0, chunk_start = 0;
+	unsigned long last_end = 0;
+	atomic_t budget, nr_prefetched, remaining;
+	int max_chunks, nr_chunks = 0, i;
+
+	mm = get_task_mm(task);
+	if (!mm)
+		return 0;
+
+	max_chunks = num_online_cpus() + 1;
+	works = kcalloc(max_chunks, sizeof(*works), GFP_KERNEL);
+	if (!works) {
+		mmput(mm);
+		return 0;
+	}
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma) || vma->vm_file)
+			continue;
+		total += vma->vm_end - vma->vm_start;
+	}
+
+	target = max_t(unsigned long, PREFETCH_MIN_CHUNK,
+			PAGE_ALIGN(DIV_ROUND_UP(total, num_online_cpus())));
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		unsigned long addr = vma->vm_start;
+
+		if (is_vm_hugetlb_page(vma) || vma->vm_file)
+			continue;
+
+		while (addr < vma->vm_end && nr_chunks < max_chunks) {
+			unsigned long len = min(vma->vm_end - addr,
+						target - acc);
+
+			if (!acc)
+				chunk_start = addr;
+			addr += len;
+			acc += len;
+			last_end = addr;
+			if (acc == target) {
+				works[nr_chunks].start = chunk_start;
+				works[nr_chunks++].end = addr;
+				acc = 0;
+			}
+		}
+	}
+	if (acc && nr_chunks < max_chunks) {
+		works[nr_chunks].start = chunk_start;
+		works[nr_chunks++].end = last_end;
+	}
+	/* workers take mmap_sem themselves */
+	up_read(&mm->mmap_sem);
+
+	atomic_set(&budget, nr_pages);
+	atomic_set(&nr_prefetched, 0);
+	atomic_set(&remaining, nr_chunks);
+
+	for (i = 0; i < nr_chunks; i++) {
+		struct prefetch_work *pw = &works[i];
+
+		pw->mm = mm;
+		pw->budget = &budget;
+		pw->nr_prefetched = &nr_prefetched;
+		pw->remaining = &remaining;
+		pw->done = &done;
+		INIT_WORK(&pw->work, prefetch_work_fn);
+		queue_work(system_unbound_wq, &pw->work);
+	}
+
+	if (nr_chunks)
+		wait_for_completion(&done);
+
+	kfree(works);
 	mmput(mm);
-out:
+
+	return atomic_read(&nr_prefetched);
+}
+
+static ssize_t prefetch_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[32];
+	char *str;
+	int nr_pages = INT_MAX;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	str = strstrip(buffer);
+	if (strcmp(str, "anon")) {
+		if (kstrtoint(str, 10, &nr_pages) || nr_pages <= 0)
+			return -EINVAL;
+	}
+
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+
+	prefetch_task_anon(task, nr_pages);
 	put_task_struct(task);
-	return count;
 
-out_err:
-	return -EINVAL;
+	return count;
 }
 
-const struct file_operations proc_reclaim_operations = {
-	.write		= reclaim_write,
+const struct file_operations proc_prefetch_operations = {
+	.write		= prefetch_write,
 	.llseek		= noop_llseek,
 };
+#endif /* CONFIG_SWAP */
 #endif
 
 #ifdef CONFIG_NUMA
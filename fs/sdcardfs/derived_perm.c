@@ -19,6 +19,7 @@
  */
 
 #include "sdcardfs.h"
+#include <linux/hash.h>
 
 /* copy derived state from parent inode */
 static void inherit_derived_state(struct inode *parent, struct inode *child)
@@ -48,6 +49,64 @@ void setup_derived_state(struct inode *inode, perm_t perm, userid_t userid,
 	info->data->under_obb = false;
 }
 
+/*
+ * Resolve the appid of a package directory through the per-superblock
+ * cache, falling back to the package list on a miss. Called with dentry
+ * locks held, so nothing here may sleep.
+ */
+static appid_t get_package_appid(struct sdcardfs_sb_info *sbi,
+				 perm_t parent_perm, const struct qstr *name,
+				 userid_t userid)
+{
+	struct sdcardfs_perm_cache_entry *entry, *old;
+	unsigned int gen, slot;
+	struct qstr q;
+	appid_t appid;
+
+	gen = packagelist_gen();
+	packagelist_qstr_init(&q, name->name);
+	slot = hash_32(q.hash ^ userid ^ parent_perm, SDCARDFS_PERM_CACHE_BITS);
+
+	rcu_read_lock();
+	entry = rcu_dereference(sbi->perm_cache[slot]);
+	if (entry && entry->gen == gen && entry->parent_perm == parent_perm &&
+			entry->userid == userid && qstr_case_eq(&q, &entry->name)) {
+		appid = entry->appid;
+		rcu_read_unlock();
+		atomic_long_inc(&sbi->perm_cache_hits);
+		return appid;
+	}
+	rcu_read_unlock();
+	atomic_long_inc(&sbi->perm_cache_misses);
+
+	appid = get_appid_for_user(&q, userid);
+
+	entry = kmalloc(sizeof(*entry) + q.len + 1, GFP_ATOMIC | __GFP_NOWARN);
+	if (!entry)
+		return appid;
+	entry->gen = gen;
+	entry->parent_perm = parent_perm;
+	entry->userid = userid;
+	entry->appid = appid;
+	memcpy(entry->buf, q.name, q.len + 1);
+	entry->name = (struct qstr)QSTR_INIT(entry->buf, q.len);
+
+	old = xchg(&sbi->perm_cache[slot], entry);
+	if (old)
+		kfree_rcu(old, rcu);
+	return appid;
+}
+
+void sdcardfs_perm_cache_destroy(struct sdcardfs_sb_info *sbi)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sbi->perm_cache); i++) {
+		kfree(sbi->perm_cache[i]);
+		sbi->perm_cache[i] = NULL;
+	}
+}
+
 /* While renaming, there is a point where we want the path from dentry,
  * but the name from newdentry
  */
@@ -130,8 +189,10 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	case PERM_ANDROID_DATA:
 	case PERM_ANDROID_MEDIA:
 		info->data->perm = PERM_ANDROID_PACKAGE;
-		appid = get_appid(name->name);
-		if (appid != 0 && !is_excluded(name->name, parent_data->userid))
+		appid = get_package_appid(SDCARDFS_SB(dentry->d_sb),
+					  parent_data->perm, name,
+					  parent_data->userid);
+		if (appid != 0)
 			info->data->d_uid =
 				multiuser_get_uid(parent_data->userid, appid);
 		break;
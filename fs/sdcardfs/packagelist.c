@@ -45,6 +45,27 @@ static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
 static struct kmem_cache *hashtable_entry_cachep;
 
+/*
+ * Bumped after every change to package_to_appid or package_to_userid so
+ * that cached derived permissions computed from the old lists are ignored.
+ */
+static atomic_t packagelist_generation = ATOMIC_INIT(0);
+
+unsigned int packagelist_gen(void)
+{
+	unsigned int gen = atomic_read(&packagelist_generation);
+
+	/* Pairs with the barrier in packagelist_changed() */
+	smp_rmb();
+	return gen;
+}
+
+static void packagelist_changed(void)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&packagelist_generation);
+}
+
 static unsigned int full_name_case_hash(const void *salt, const unsigned char *name, unsigned int len)
 {
 	unsigned long hash = init_name_hash(salt);
@@ -145,6 +166,21 @@ appid_t is_excluded(const char *key, userid_t user)
 	return __is_excluded(&q, user);
 }
 
+void packagelist_qstr_init(struct qstr *q, const char *name)
+{
+	qstr_init(q, name);
+}
+
+/* appid owning package @key for @userid, 0 if unknown or excluded */
+appid_t get_appid_for_user(const struct qstr *key, userid_t userid)
+{
+	appid_t appid = __get_appid(key);
+
+	if (appid && __is_excluded(key, userid))
+		return 0;
+	return appid;
+}
+
 /* Kernel has already enforced everything we returned through
  * derive_permissions_locked(), so this is used to lock down access
  * even further, such as enforcing that apps hold sdcard_rw.
@@ -322,8 +358,10 @@ static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_packagelist_appid_entry_locked(key, value);
-	if (!err)
+	if (!err) {
+		packagelist_changed();
 		fixup_all_perms_name(key);
+	}
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -346,8 +384,10 @@ static int insert_userid_exclude_entry(const struct qstr *key, userid_t value)
 
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_userid_exclude_entry_locked(key, value);
-	if (!err)
+	if (!err) {
+		packagelist_changed();
 		fixup_all_perms_name_userid(key, value);
+	}
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -388,6 +428,7 @@ static void remove_packagelist_entry(const struct qstr *key)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_packagelist_entry_locked(key);
+	packagelist_changed();
 	fixup_all_perms_name(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
@@ -437,6 +478,7 @@ static void remove_userid_all_entry(userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_all_entry_locked(userid);
+	packagelist_changed();
 	fixup_all_perms_userid(userid);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
@@ -461,6 +503,7 @@ static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_exclude_entry_locked(key, userid);
+	packagelist_changed();
 	fixup_all_perms_name_userid(key, userid);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
@@ -819,6 +862,26 @@ static ssize_t packages_remove_userid_store(struct config_item *item,
 	return count;
 }
 
+static ssize_t packages_perm_cache_stats_show(struct config_item *item,
+					      char *page)
+{
+	struct sdcardfs_sb_info *sbinfo;
+	int count = 0;
+
+	mutex_lock(&sdcardfs_super_list_lock);
+	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
+		count += scnprintf(page + count, PAGE_SIZE - count,
+				   "%u:%u hits %ld misses %ld\n",
+				   MAJOR(sbinfo->sb->s_dev),
+				   MINOR(sbinfo->sb->s_dev),
+				   atomic_long_read(&sbinfo->perm_cache_hits),
+				   atomic_long_read(&sbinfo->perm_cache_misses));
+	}
+	mutex_unlock(&sdcardfs_super_list_lock);
+
+	return count;
+}
+
 static struct configfs_attribute packages_attr_packages_gid_list = {
 	.ca_name	= "packages_gid.list",
 	.ca_mode	= S_IRUGO,
@@ -827,10 +890,12 @@ static struct configfs_attribute packages_attr_packages_gid_list = {
 };
 
 SDCARDFS_CONFIGFS_ATTR_WO(packages_, remove_userid);
+SDCARDFS_CONFIGFS_ATTR_RO(packages_, perm_cache_stats);
 
 static struct configfs_attribute *packages_attrs[] = {
 	&packages_attr_packages_gid_list,
 	&packages_attr_remove_userid,
+	&packages_attr_perm_cache_stats,
 	NULL,
 };
 
@@ -219,6 +219,24 @@ extern int parse_options_remount(struct super_block *sb, char *options, int sile
 		struct sdcardfs_vfsmount_options *vfsopts);
 
 /* sdcardfs super-block data in memory */
+/* Number of slots in the per-superblock derived permission cache */
+#define SDCARDFS_PERM_CACHE_BITS	8
+
+/*
+ * Cached appid of a package directory, as resolved through the package
+ * list for a given parent permission and userid. Only valid while @gen
+ * matches the package list generation.
+ */
+struct sdcardfs_perm_cache_entry {
+	struct rcu_head rcu;
+	unsigned int gen;
+	perm_t parent_perm;
+	userid_t userid;
+	appid_t appid;
+	struct qstr name;
+	char buf[];
+};
+
 struct sdcardfs_sb_info {
 	struct super_block *sb;
 	struct super_block *lower_sb;
@@ -232,6 +250,9 @@ struct sdcardfs_sb_info {
 	void *pkgl_id;
 	struct list_head list;
 	struct notifier_block fscrypt_nb;
+	struct sdcardfs_perm_cache_entry *perm_cache[1 << SDCARDFS_PERM_CACHE_BITS];
+	atomic_long_t perm_cache_hits;
+	atomic_long_t perm_cache_misses;
 };
 
 /*
@@ -528,6 +549,9 @@ extern struct list_head sdcardfs_super_list;
 extern appid_t get_appid(const char *app_name);
 extern appid_t get_ext_gid(const char *app_name);
 extern appid_t is_excluded(const char *app_name, userid_t userid);
+extern void packagelist_qstr_init(struct qstr *q, const char *name);
+extern appid_t get_appid_for_user(const struct qstr *key, userid_t userid);
+extern unsigned int packagelist_gen(void);
 extern int check_caller_access_to_name(struct inode *parent_node, const struct qstr *name);
 extern int add_app_name_to_list(appid_t appid, char *list, int len);
 extern int packagelist_init(void);
@@ -547,6 +571,7 @@ extern void setup_derived_state(struct inode *inode, perm_t perm,
 extern void get_derived_permission(struct dentry *parent, struct dentry *dentry);
 extern void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, const struct qstr *name);
 extern void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit);
+extern void sdcardfs_perm_cache_destroy(struct sdcardfs_sb_info *sbi);
 
 extern void update_derived_permission_lock(struct dentry *dentry);
 void fixup_lower_ownership(struct dentry *dentry, const char *name);
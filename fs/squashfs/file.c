@@ -508,6 +508,89 @@ out:
 }
 
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Add the readahead pages to the page cache a datablock at a time and
+ * queue each block to be read and decompressed straight into them, see
+ * squashfs_readahead_block(). Pages of the fragment and of sparse blocks
+ * are left to squashfs_readpage().
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned int nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	pgoff_t mask = (1 << shift) - 1;
+	pgoff_t page_end = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	gfp_t gfp = readahead_gfp_mask(mapping);
+	struct page **batch, *page;
+	int index, bsize, expected, n;
+	pgoff_t start;
+	u64 block;
+
+	batch = kmalloc_array(mask + 1, sizeof(*batch), GFP_KERNEL);
+	if (batch == NULL)
+		return -ENOMEM;
+
+	/* the list is in page index order */
+	while (!list_empty(pages)) {
+		page = lru_to_page(pages);
+		list_del(&page->lru);
+		if (add_to_page_cache_lru(page, mapping, page->index, gfp)) {
+			put_page(page);
+			continue;
+		}
+
+		index = page->index >> shift;
+		if (page->index > page_end || (index == file_end &&
+		    squashfs_i(inode)->fragment_block != SQUASHFS_INVALID_BLK))
+			goto readpage;
+
+		bsize = read_blocklist(inode, index, &block);
+		if (bsize <= 0)
+			goto readpage;
+
+		expected = index == file_end ?
+			(i_size_read(inode) & (msblk->block_size - 1)) :
+			 msblk->block_size;
+		start = page->index & ~mask;
+		n = min(mask, page_end - start) + 1;
+		memset(batch, 0, n * sizeof(*batch));
+		batch[page->index - start] = page;
+
+		/* take the rest of this block's pages in the window along */
+		while (!list_empty(pages)) {
+			page = lru_to_page(pages);
+			if (page->index >= start + n)
+				break;
+			list_del(&page->lru);
+			if (add_to_page_cache_lru(page, mapping, page->index,
+						  gfp)) {
+				put_page(page);
+				continue;
+			}
+			batch[page->index - start] = page;
+		}
+
+		squashfs_readahead_block(inode, block, bsize, expected, start,
+					 batch, n);
+		continue;
+
+readpage:
+		squashfs_readpage(file, page);
+		put_page(page);
+	}
+
+	kfree(batch);
+	return 0;
+}
+#endif
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -13,6 +13,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -20,61 +21,23 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page, int bytes);
-
-/* Read separately compressed datablock directly into page cache */
-int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
-	int expected)
+static int squashfs_read_cache(struct inode *inode, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page, int bytes);
 
+/*
+ * Fill the @pages locked page cache pages @page covering @block, unlock
+ * and release them. A NULL entry is a page that is already uptodate or
+ * could not be grabbed; then the block goes through the cache. On error
+ * @target_page, if any, is dealt with by the caller.
+ */
+static int squashfs_read_pages(struct inode *inode, struct page *target_page,
+	u64 block, int bsize, int expected, struct page **page, int pages,
+	int missing_pages)
 {
-	struct inode *inode = target_page->mapping->host;
-	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-
-	int file_end = (i_size_read(inode) - 1) >> PAGE_SHIFT;
-	int mask = (1 << (msblk->block_log - PAGE_SHIFT)) - 1;
-	int start_index = target_page->index & ~mask;
-	int end_index = start_index | mask;
-	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
-	struct page **page;
 	struct squashfs_page_actor *actor;
+	int i, bytes, res = -ENOMEM;
 	void *pageaddr;
 
-	if (end_index > file_end)
-		end_index = file_end;
-
-	pages = end_index - start_index + 1;
-
-	page = kmalloc_array(pages, sizeof(void *), GFP_KERNEL);
-	if (page == NULL)
-		return res;
-
-	/*
-	 * Create a "page actor" which will kmap and kunmap the
-	 * page cache pages appropriately within the decompressor
-	 */
-	actor = squashfs_page_actor_init_special(page, pages, 0);
-	if (actor == NULL)
-		goto out;
-
-	/* Try to grab all the pages covered by the Squashfs block */
-	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
-		page[i] = (n == target_page->index) ? target_page :
-			grab_cache_page_nowait(target_page->mapping, n);
-
-		if (page[i] == NULL) {
-			missing_pages++;
-			continue;
-		}
-
-		if (PageUptodate(page[i])) {
-			unlock_page(page[i]);
-			put_page(page[i]);
-			page[i] = NULL;
-			missing_pages++;
-		}
-	}
-
 	if (missing_pages) {
 		/*
 		 * Couldn't get one or more pages, this page has either
@@ -83,16 +46,25 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 		 * squashfs_readpage also trying to grab them.  Fall back to
 		 * using an intermediate buffer.
 		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
-							page, expected);
+		res = squashfs_read_cache(inode, target_page, block, bsize,
+							pages, page, expected);
 		if (res < 0)
 			goto mark_errored;
 
-		goto out;
+		return res;
 	}
 
+	/*
+	 * Create a "page actor" which will kmap and kunmap the
+	 * page cache pages appropriately within the decompressor
+	 */
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		goto mark_errored;
+
 	/* Decompress directly into the page cache buffers */
 	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	kfree(actor);
 	if (res < 0)
 		goto mark_errored;
 
@@ -118,9 +90,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 			put_page(page[i]);
 	}
 
-	kfree(actor);
-	kfree(page);
-
 	return 0;
 
 mark_errored:
@@ -136,18 +105,147 @@ mark_errored:
 		put_page(page[i]);
 	}
 
-out:
-	kfree(actor);
+	return res;
+}
+
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
+	int expected)
+
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+
+	int file_end = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int i, n, pages, missing_pages, res;
+	struct page **page;
+
+	if (end_index > file_end)
+		end_index = file_end;
+
+	pages = end_index - start_index + 1;
+
+	page = kmalloc_array(pages, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return -ENOMEM;
+
+	/* Try to grab all the pages covered by the Squashfs block */
+	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] == NULL) {
+			missing_pages++;
+			continue;
+		}
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			put_page(page[i]);
+			page[i] = NULL;
+			missing_pages++;
+		}
+	}
+
+	res = squashfs_read_pages(inode, target_page, block, bsize, expected,
+				  page, pages, missing_pages);
 	kfree(page);
 	return res;
 }
 
+/*
+ * Readahead of a datablock is queued to an unbound workqueue, so that
+ * the blocks of one readahead window are read from the device and
+ * decompressed on several CPUs at once instead of one after the other
+ * in the reading task.
+ */
+struct squashfs_ra_block {
+	struct work_struct work;
+	struct inode *inode;
+	u64 block;
+	int bsize;
+	int expected;
+	int pages;
+	int missing_pages;
+	struct page *page[0];
+};
+
+static struct workqueue_struct *squashfs_ra_wq;
+
+static void squashfs_ra_work(struct work_struct *work)
+{
+	struct squashfs_ra_block *ra = container_of(work,
+					struct squashfs_ra_block, work);
+
+	squashfs_read_pages(ra->inode, NULL, ra->block, ra->bsize,
+			    ra->expected, ra->page, ra->pages, ra->missing_pages);
+	kfree(ra);
+}
+
+/*
+ * Start reading @block into the @pages page cache pages from @start_index.
+ * @page holds the locked pages readahead added, NULL for the others. The
+ * inode stays around until the pages are unlocked.
+ */
+void squashfs_readahead_block(struct inode *inode, u64 block, int bsize,
+	int expected, pgoff_t start_index, struct page **page, int pages)
+{
+	struct squashfs_ra_block *ra;
+	int i, missing_pages = 0;
+
+	for (i = 0; i < pages; i++) {
+		if (page[i])
+			continue;
+
+		page[i] = grab_cache_page_nowait(inode->i_mapping,
+						 start_index + i);
+		if (page[i] && PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			put_page(page[i]);
+			page[i] = NULL;
+		}
+		if (page[i] == NULL)
+			missing_pages++;
+	}
+
+	ra = squashfs_ra_wq ? kmalloc(sizeof(*ra) + pages * sizeof(*page),
+				      GFP_KERNEL) : NULL;
+	if (ra == NULL) {
+		squashfs_read_pages(inode, NULL, block, bsize, expected,
+				    page, pages, missing_pages);
+		return;
+	}
+
+	INIT_WORK(&ra->work, squashfs_ra_work);
+	ra->inode = inode;
+	ra->block = block;
+	ra->bsize = bsize;
+	ra->expected = expected;
+	ra->pages = pages;
+	ra->missing_pages = missing_pages;
+	memcpy(ra->page, page, pages * sizeof(*page));
+	queue_work(squashfs_ra_wq, &ra->work);
+}
+
+int squashfs_readahead_init(void)
+{
+	squashfs_ra_wq = alloc_workqueue("squashfs_ra",
+					 WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	return squashfs_ra_wq ? 0 : -ENOMEM;
+}
+
+void squashfs_readahead_destroy(void)
+{
+	destroy_workqueue(squashfs_ra_wq);
+}
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page, int bytes)
+static int squashfs_read_cache(struct inode *inode, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page, int bytes)
 {
-	struct inode *i = target_page->mapping->host;
-	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
+	struct squashfs_cache_entry *buffer = squashfs_get_datablock(inode->i_sb,
 						 block, bsize);
 	int res = buffer->error, n, offset = 0;
 
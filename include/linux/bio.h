@@ -286,6 +286,11 @@ static inline void bio_clear_flag(struct bio *bio, unsigned int bit)
 	bio->bi_flags &= ~(1U << bit);
 }
 
+static inline void bio_set_wb_class(struct bio *bio, enum bio_wb_class wb_class)
+{
+	bio->bi_wb_class = wb_class;
+}
+
 static inline void bio_get_first_bvec(struct bio *bio, struct bio_vec *bv)
 {
 	*bv = bio_iovec(bio);
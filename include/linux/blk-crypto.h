@@ -32,6 +32,18 @@ int blk_crypto_start_using_mode(enum blk_crypto_mode_num crypto_mode,
 int blk_crypto_evict_key(struct request_queue *q,
 			 const struct blk_crypto_key *key);
 
+void blk_crypto_prefetch_key(struct request_queue *q,
+			     const struct blk_crypto_key *key);
+
+int blk_crypto_pin_key(struct request_queue *q,
+		       const struct blk_crypto_key *key);
+
+void blk_crypto_unpin_key(struct request_queue *q,
+			  const struct blk_crypto_key *key);
+
+bool blk_crypto_key_supported_by_hw(struct request_queue *q,
+				    const struct blk_crypto_key *key);
+
 #else /* CONFIG_BLK_INLINE_ENCRYPTION */
 
 static inline int blk_crypto_submit_bio(struct bio **bio_ptr)
@@ -49,6 +49,18 @@ struct blk_issue_stat {
 	u64 stat;
 };
 
+/*
+ * Who a write was submitted on behalf of, so that writeback throttling can
+ * apply a policy per class. Untagged bios are regular writeback.
+ */
+enum bio_wb_class {
+	BIO_WB_USER,		/* buffered writeback of user data */
+	BIO_WB_GC,		/* filesystem garbage collection */
+	BIO_WB_CHECKPOINT,	/* filesystem checkpoint */
+	BIO_WB_SWAP,		/* swap out and zram backing device writeback */
+	BIO_WB_NR_CLASSES,
+};
+
 /*
  * main unit of I/O for the block layer and lower layers (ie drivers and
  * stacking drivers)
@@ -65,6 +77,7 @@ struct bio {
 	unsigned short		bi_write_hint;
 	blk_status_t		bi_status;
 	u8			bi_partno;
+	u8			bi_wb_class;	/* enum bio_wb_class */
 
 	/* Number of segments in this BIO after
 	 * physical address coalescing is performed.
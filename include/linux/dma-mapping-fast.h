@@ -18,6 +18,7 @@
 
 struct dma_iommu_mapping;
 struct io_pgtable_ops;
+struct fast_iova_cache;
 
 struct dma_fast_smmu_mapping {
 	struct device		*dev;
@@ -34,6 +35,8 @@ struct dma_fast_smmu_mapping {
 	unsigned long	next_start;
 	unsigned long	upcoming_stale_bit;
 	bool		have_stale_tlbs;
+	unsigned long	tlbi_gen;
+	struct fast_iova_cache __percpu *iova_cache;
 
 	dma_addr_t	pgtbl_dma_handle;
 	struct io_pgtable_ops *pgtbl_ops;
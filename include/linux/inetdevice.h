@@ -22,6 +22,17 @@ struct ipv4_devconf {
 
 #define MC_HASH_SZ_LOG 9
 
+/* Totals of the TCP connections established over a device, added at close */
+struct in_dev_tcp_stats {
+	atomic64_t		conns;
+	atomic64_t		segs_out;
+	atomic64_t		segs_in;
+	atomic64_t		retrans;
+	atomic64_t		bytes_acked;
+	atomic64_t		bytes_received;
+	atomic64_t		srtt_us;	/* sum of the final smoothed RTTs */
+};
+
 struct in_device {
 	struct net_device	*dev;
 	refcount_t		refcnt;
@@ -45,6 +56,7 @@ struct in_device {
 
 	struct neigh_parms	*arp_parms;
 	struct ipv4_devconf	cnf;
+	struct in_dev_tcp_stats	tcp_stats;
 	struct rcu_head		rcu_head;
 };
 
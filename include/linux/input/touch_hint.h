@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _INPUT_TOUCH_HINT_H
+#define _INPUT_TOUCH_HINT_H
+
+#include <linux/ktime.h>
+#include <linux/notifier.h>
+
+/*
+ * Gesture phase hints published by touchscreen drivers, ahead of the
+ * input events reaching userspace, so that frequency governors can size
+ * their response to the gesture. Notifiers are called in atomic context.
+ */
+enum touch_hint_event {
+	TOUCH_HINT_DOWN,
+	TOUCH_HINT_MOVE,
+	TOUCH_HINT_UP,
+};
+
+struct touch_hint {
+	/* speed of the primary contact in pixels per second */
+	unsigned int velocity;
+	unsigned int fingers;
+	ktime_t down_time;
+	ktime_t time;
+};
+
+#ifdef CONFIG_INPUT_TOUCH_HINT
+int touch_hint_register_notifier(struct notifier_block *nb);
+int touch_hint_unregister_notifier(struct notifier_block *nb);
+void touch_hint_report(int x, int y, unsigned int fingers, ktime_t time);
+#else
+static inline int touch_hint_register_notifier(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+
+static inline int touch_hint_unregister_notifier(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+
+static inline void touch_hint_report(int x, int y, unsigned int fingers,
+				     ktime_t time)
+{
+}
+#endif
+
+#endif /* _INPUT_TOUCH_HINT_H */
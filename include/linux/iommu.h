@@ -138,6 +138,11 @@ enum iommu_cap {
  * Some bus implementations may enter a bad state if iommu reports an error
  * on context fault. As context faults are not always fatal, this must be
  * avoided.
+ *
+ * DOMAIN_ATTR_DEFER_TLB_FLUSH
+ * Don't invalidate the TLB as part of each unmap. iommu_unmap() still
+ * invalidates before returning, but iommu_unmap_fast() leaves it to a later
+ * iommu_tlb_sync() so that many unmaps can share one invalidation.
  */
 
 enum iommu_attr {
@@ -169,6 +174,7 @@ enum iommu_attr {
 	DOMAIN_ATTR_QCOM_MMU500_ERRATA_MIN_IOVA_ALIGN,
 	DOMAIN_ATTR_USE_LLC_NWA,
 	DOMAIN_ATTR_NO_CFRE,
+	DOMAIN_ATTR_DEFER_TLB_FLUSH,
 	DOMAIN_ATTR_MAX,
 };
 
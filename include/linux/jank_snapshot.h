@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_JANK_SNAPSHOT_H
+#define _LINUX_JANK_SNAPSHOT_H
+
+#include <linux/list.h>
+
+struct seq_file;
+
+/*
+ * A subsystem whose state is captured when userspace reports a missed
+ * frame. @show prints the current state to the snapshot being taken. It
+ * is called in process context, one source after the other, and should
+ * only take locks that are held briefly.
+ */
+struct jank_snapshot_source {
+	const char *name;
+	void (*show)(struct seq_file *m, void *priv);
+	void *priv;
+	struct list_head node;
+};
+
+#ifdef CONFIG_JANK_SNAPSHOT
+extern void jank_snapshot_register(struct jank_snapshot_source *src);
+extern void jank_snapshot_unregister(struct jank_snapshot_source *src);
+#else
+static inline void jank_snapshot_register(struct jank_snapshot_source *src)
+{
+}
+
+static inline void jank_snapshot_unregister(struct jank_snapshot_source *src)
+{
+}
+#endif
+
+#endif /* _LINUX_JANK_SNAPSHOT_H */
@@ -66,6 +66,17 @@ void keyslot_manager_get_slot(struct keyslot_manager *ksm, unsigned int slot);
 
 void keyslot_manager_put_slot(struct keyslot_manager *ksm, unsigned int slot);
 
+void keyslot_manager_prefetch_key(struct keyslot_manager *ksm,
+				  const struct blk_crypto_key *key);
+
+int keyslot_manager_pin_key(struct keyslot_manager *ksm,
+			    const struct blk_crypto_key *key);
+
+void keyslot_manager_unpin_key(struct keyslot_manager *ksm,
+			       const struct blk_crypto_key *key);
+
+ssize_t keyslot_manager_stats_show(struct keyslot_manager *ksm, char *page);
+
 bool keyslot_manager_crypto_mode_supported(struct keyslot_manager *ksm,
 					   enum blk_crypto_mode_num crypto_mode,
 					   unsigned int dun_bytes,
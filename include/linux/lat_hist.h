@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Per-CPU latency histograms for hot paths
+ *
+ * A struct lat_hist counts latencies in log-linear buckets: each power of
+ * two of nanoseconds is split in LAT_HIST_SUB buckets, so any percentile
+ * read back is within 12.5% of the true value. Recording is a clock read
+ * and two per-CPU increments, and is patched out by a static key until
+ * enabled through debugfs lat_hist/enable. Each registered histogram is
+ * shown in debugfs lat_hist/<name>, writing to that file resets it.
+ */
+#ifndef _LINUX_LAT_HIST_H
+#define _LINUX_LAT_HIST_H
+
+#include <linux/jump_label.h>
+#include <linux/sched/clock.h>
+#include <linux/types.h>
+
+#define LAT_HIST_SUB_SHIFT	3
+#define LAT_HIST_SUB		(1 << LAT_HIST_SUB_SHIFT)
+/* up to 2^36 ns, about a minute, larger values go to the last bucket */
+#define LAT_HIST_BUCKETS	(36 * LAT_HIST_SUB)
+
+struct lat_hist_cpu {
+	u64 sum;
+	u64 max;
+	u32 buckets[LAT_HIST_BUCKETS];
+};
+
+struct lat_hist {
+	const char *name;
+	struct lat_hist_cpu __percpu *cpu;
+	struct dentry *dentry;
+};
+
+#define DEFINE_LAT_HIST(_var, _name)					\
+	struct lat_hist _var = {					\
+		.name = _name,						\
+	}
+
+#ifdef CONFIG_LAT_HIST
+DECLARE_STATIC_KEY_FALSE(lat_hist_key);
+
+int lat_hist_register(struct lat_hist *h);
+void lat_hist_unregister(struct lat_hist *h);
+void lat_hist_record(struct lat_hist *h, u64 ns);
+
+static inline bool lat_hist_enabled(void)
+{
+	return static_branch_unlikely(&lat_hist_key);
+}
+
+/* Start of an interval, 0 if recording is disabled */
+static inline u64 lat_hist_start(void)
+{
+	if (static_branch_unlikely(&lat_hist_key))
+		return local_clock();
+	return 0;
+}
+
+/* Record the interval begun by lat_hist_start() */
+static inline void lat_hist_end(struct lat_hist *h, u64 start)
+{
+	if (static_branch_unlikely(&lat_hist_key) && start)
+		lat_hist_record(h, local_clock() - start);
+}
+
+/*
+ * Record an interval the caller measured with its own clock, callers
+ * check lat_hist_enabled() first to skip the clock read.
+ */
+static inline void lat_hist_add(struct lat_hist *h, s64 ns)
+{
+	if (static_branch_unlikely(&lat_hist_key) && ns >= 0)
+		lat_hist_record(h, ns);
+}
+#else
+static inline int lat_hist_register(struct lat_hist *h)
+{
+	return 0;
+}
+static inline void lat_hist_unregister(struct lat_hist *h) { }
+static inline bool lat_hist_enabled(void)
+{
+	return false;
+}
+static inline u64 lat_hist_start(void)
+{
+	return 0;
+}
+static inline void lat_hist_end(struct lat_hist *h, u64 start) { }
+static inline void lat_hist_add(struct lat_hist *h, s64 ns) { }
+#endif
+
+#endif /* _LINUX_LAT_HIST_H */
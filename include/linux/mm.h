@@ -216,6 +216,12 @@ extern unsigned int kobjsize(const void *objp);
 #define VM_NOHUGEPAGE	0x40000000	/* MADV_NOHUGEPAGE marked this vma */
 #define VM_MERGEABLE	0x80000000	/* KSM may merge identical pages */
 
+#ifdef CONFIG_FAULT_AROUND_HINT
+/* MADV_FAULTAROUND_ORDER() + 1, 0 for the global fault_around_bytes */
+#define VM_FAULTAROUND_SHIFT	37
+#define VM_FAULTAROUND_MASK	(0xfUL << VM_FAULTAROUND_SHIFT)
+#endif
+
 #ifdef CONFIG_ARCH_USES_HIGH_VMA_FLAGS
 #define VM_HIGH_ARCH_BIT_0	32	/* bit only usable on 64-bit architectures */
 #define VM_HIGH_ARCH_BIT_1	33	/* bit only usable on 64-bit architectures */
@@ -1320,6 +1326,11 @@ static inline void INIT_VMA(struct vm_area_struct *vma)
 	seqcount_init(&vma->vm_sequence);
 	atomic_set(&vma->vm_ref_count, 1);
 #endif
+#ifdef CONFIG_FAULT_AROUND_HINT
+	atomic_long_set(&vma->vm_read_faults, 0);
+	atomic_long_set(&vma->vm_around_faults, 0);
+	atomic_long_set(&vma->vm_major_faults, 0);
+#endif
 }
 
 struct page *__vm_normal_page(struct vm_area_struct *vma, unsigned long addr,
@@ -2849,9 +2860,20 @@ struct reclaim_param {
 	int nr_to_reclaim;
 	/* pages reclaimed */
 	int nr_reclaimed;
+	/* pages left alone because they were referenced recently */
+	int nr_skipped;
+	/* only reclaim pages still idle after aging */
+	bool idle_only;
+	/* stop early once set */
+	bool *stop;
 };
 extern struct reclaim_param reclaim_task_anon(struct task_struct *task,
 		int nr_to_reclaim);
+extern struct reclaim_param reclaim_task_file(struct task_struct *task,
+		int nr_to_reclaim);
+#ifdef CONFIG_SWAP
+extern int prefetch_task_anon(struct task_struct *task, int nr_pages);
+#endif
 #endif
 
 #endif /* __KERNEL__ */
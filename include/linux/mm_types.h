@@ -25,6 +25,7 @@
 struct address_space;
 struct mem_cgroup;
 struct hmm;
+struct mm_wss;
 
 /*
  * Each physical page in the system has a struct page associated with
@@ -353,6 +354,11 @@ struct vm_area_struct {
 	seqcount_t vm_sequence;
 	atomic_t vm_ref_count;		/* see vma_get(), vma_put() */
 #endif
+#ifdef CONFIG_FAULT_AROUND_HINT
+	atomic_long_t vm_read_faults;	/* read faults on the mapping */
+	atomic_long_t vm_around_faults;	/* ... resolved by fault-around */
+	atomic_long_t vm_major_faults;	/* ... that had to wait for IO */
+#endif
 } __randomize_layout;
 
 struct core_thread {
@@ -480,6 +486,15 @@ struct mm_struct {
 	struct task_struct __rcu *owner;
 #endif
 	struct user_namespace *user_ns;
+#ifdef CONFIG_RECLAIM_CLASS
+	unsigned char reclaim_class;	/* enum reclaim_class of the owner */
+#endif
+#ifdef CONFIG_MM_WSS
+	struct mm_wss *wss;		/* sampled working set, see mm/wss.c */
+#endif
+#ifdef CONFIG_KSM
+	unsigned long ksm_merging_pages; /* pages of this mm merged by ksmd */
+#endif
 
 	/* store ref to file /proc/<pid>/exe symlink points to */
 	struct file __rcu *exe_file;
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_MM_WSS_H
+#define _LINUX_MM_WSS_H
+
+#include <linux/mm_types.h>
+
+struct seq_file;
+
+/*
+ * Sampled working set of an mm, kept up to date by kwssd and shown in
+ * /proc/PID/wss as the kB last used in each idle time bucket.
+ */
+#ifdef CONFIG_MM_WSS
+static inline void mm_wss_init(struct mm_struct *mm)
+{
+	mm->wss = NULL;
+}
+
+extern void mm_wss_free(struct mm_struct *mm);
+extern void mm_wss_show(struct seq_file *m, struct mm_struct *mm);
+#else
+static inline void mm_wss_init(struct mm_struct *mm)
+{
+}
+
+static inline void mm_wss_free(struct mm_struct *mm)
+{
+}
+#endif
+
+#endif /* _LINUX_MM_WSS_H */
@@ -122,6 +122,12 @@ struct mmc_cmdq_host_ops {
 	int (*halt)(struct mmc_host *host, bool halt);
 	void (*reset)(struct mmc_host *host, bool soft);
 	void (*dumpstate)(struct mmc_host *host);
+	/*
+	 * Busy-wait up to timeout_ns for the task in slot tag to complete and
+	 * run its completion in the caller's context. Returns true if the
+	 * task was completed, false if the interrupt path should handle it.
+	 */
+	bool (*poll)(struct mmc_host *host, unsigned int tag, u64 timeout_ns);
 	/*
 	 * Update the request queue with keyslot manager details. This keyslot
 	 * manager will be used by block crypto to configure the crypto Engine
@@ -170,6 +170,11 @@ enum node_stat_item {
 	WORKINGSET_ACTIVATE,
 	WORKINGSET_RESTORE,
 	WORKINGSET_NODERECLAIM,
+	WORKINGSET_REFAULT_RO,	/* file refaults on read-only filesystems */
+	WORKINGSET_REFAULT_RW,	/* file refaults on writable filesystems */
+	WORKINGSET_REFAULT_SWAP,	/* anon pages read back from swap */
+	WORKINGSET_DISTANCE_RO,	/* summed refault distances, in pages */
+	WORKINGSET_DISTANCE_RW,
 	NR_ANON_MAPPED,	/* Mapped anonymous pages */
 	NR_FILE_MAPPED,	/* pagecache pages mapped into pagetables.
 			   only modified from process context */
@@ -285,6 +290,12 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+#ifdef CONFIG_PCP_AUTOTUNE
+	unsigned long hit;	/* allocations served without a refill */
+	unsigned long refill;	/* refills from the buddy lists */
+	unsigned long drain;	/* frees back to the buddy lists over high */
+	unsigned long prev_trips; /* refill + drain at the last tuning */
+#endif
 };
 
 struct per_cpu_pageset {
@@ -909,6 +920,12 @@ int lowmem_reserve_ratio_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
 int percpu_pagelist_fraction_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
+#ifdef CONFIG_PCP_AUTOTUNE
+extern int percpu_pagelist_autotune;
+extern int percpu_pagelist_scale_max;
+int percpu_pagelist_autotune_sysctl_handler(struct ctl_table *, int,
+					void __user *, size_t *, loff_t *);
+#endif
 int sysctl_min_unmapped_ratio_sysctl_handler(struct ctl_table *, int,
 			void __user *, size_t *, loff_t *);
 int sysctl_min_slab_ratio_sysctl_handler(struct ctl_table *, int,
@@ -102,6 +102,8 @@ struct msm_bus_tcs_handle {
 	struct msm_bus_tcs_usecase *usecases;
 };
 
+struct msm_bus_mm_client;
+
 /* Scaling APIs */
 
 /*
@@ -131,6 +133,12 @@ int msm_bus_scale_query_tcs_cmd(struct msm_bus_tcs_usecase *tcs_usecase,
 int msm_bus_scale_query_tcs_cmd_all(struct msm_bus_tcs_handle *tcs_handle,
 					uint32_t cl);
 
+/* Shared multimedia path APIs */
+struct msm_bus_mm_client *msm_bus_mm_register(uint32_t mas, uint32_t slv,
+					const char *name);
+void msm_bus_mm_unregister(struct msm_bus_mm_client *cl);
+int msm_bus_mm_update_bw(struct msm_bus_mm_client *cl, u64 ab, u64 ib);
+
 /* AXI Port configuration APIs */
 int msm_bus_axi_porthalt(int master_port);
 int msm_bus_axi_portunhalt(int master_port);
@@ -211,6 +219,22 @@ static inline int msm_bus_scale_query_tcs_cmd_all(struct msm_bus_tcs_handle
 	return 0;
 }
 
+static inline struct msm_bus_mm_client *
+msm_bus_mm_register(uint32_t mas, uint32_t slv, const char *name)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline void msm_bus_mm_unregister(struct msm_bus_mm_client *cl)
+{
+}
+
+static inline int
+msm_bus_mm_update_bw(struct msm_bus_mm_client *cl, u64 ab, u64 ib)
+{
+	return 0;
+}
+
 #endif
 
 #if defined(CONFIG_OF) && defined(CONFIG_QCOM_BUS_SCALING)
@@ -13,12 +13,17 @@
 #ifndef _MSM_DRM_NOTIFY_H_
 #define _MSM_DRM_NOTIFY_H_
 
+#include <linux/ktime.h>
 #include <linux/notifier.h>
 
 /* A hardware display blank change occurred */
 #define MSM_DRM_EVENT_BLANK			0x01
 /* A hardware display blank early change occurred */
 #define MSM_DRM_EARLY_EVENT_BLANK		0x02
+/* A vsync occurred, sent on the vsync chain */
+#define MSM_DRM_EVENT_VSYNC			0x03
+/* A commit was queued for a coming vsync, sent on the vsync chain */
+#define MSM_DRM_EVENT_COMMIT			0x04
 
 enum {
 	/* panel: power on */
@@ -40,6 +45,50 @@ struct msm_drm_notifier {
 	void *data;
 };
 
+/**
+ * struct msm_drm_vsync - display timing sent on the vsync chain
+ * @id: display the event is for
+ * @timestamp: time of the vsync, or time the commit was queued
+ * @period_ns: refresh period of the current mode, 0 if not known yet
+ * @deadline: time the next frame is expected to be composed for, the
+ *            next vsync for MSM_DRM_EVENT_VSYNC and the vsync the commit
+ *            targets for MSM_DRM_EVENT_COMMIT
+ */
+struct msm_drm_vsync {
+	enum msm_drm_display_id id;
+	ktime_t timestamp;
+	u32 period_ns;
+	ktime_t deadline;
+};
+
 int msm_drm_register_client(struct notifier_block *nb);
 int msm_drm_unregister_client(struct notifier_block *nb);
+
+#ifdef CONFIG_MSM_DRM_NOTIFY
+int msm_drm_register_vsync_client(struct notifier_block *nb);
+int msm_drm_unregister_vsync_client(struct notifier_block *nb);
+void msm_drm_notify_vsync(enum msm_drm_display_id id, ktime_t timestamp,
+			  u32 period_ns);
+void msm_drm_notify_commit(enum msm_drm_display_id id, ktime_t deadline);
+#else
+static inline int msm_drm_register_vsync_client(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+
+static inline int msm_drm_unregister_vsync_client(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+
+static inline void msm_drm_notify_vsync(enum msm_drm_display_id id,
+					ktime_t timestamp, u32 period_ns)
+{
+}
+
+static inline void msm_drm_notify_commit(enum msm_drm_display_id id,
+					 ktime_t deadline)
+{
+}
+#endif
 #endif
@@ -17,6 +17,8 @@ struct ip_conntrack_stat {
 	unsigned int expect_create;
 	unsigned int expect_delete;
 	unsigned int search_restart;
+	unsigned int flow_cache_hit;
+	unsigned int flow_cache_miss;
 };
 
 /* call to create an explicit dependency on nf_conntrack. */
@@ -38,6 +38,8 @@ const char *get_effective_client_locked(struct votable *votable);
 int vote(struct votable *votable, const char *client_str, bool state, int val);
 int vote_override(struct votable *votable, const char *override_client,
 		  bool state, int val);
+void vote_batch_begin(struct votable *votable);
+int vote_batch_end(struct votable *votable);
 int rerun_election(struct votable *votable);
 struct votable *find_votable(const char *name);
 struct votable *create_votable(const char *name,
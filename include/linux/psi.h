@@ -24,6 +24,10 @@ void psi_memstall_leave(unsigned long *flags);
 
 int psi_show(struct seq_file *s, struct psi_group *group, enum psi_res res);
 
+struct psi_trigger *psi_kernel_trigger_create(enum psi_states state,
+			u32 threshold_us, u32 window_us);
+void psi_kernel_trigger_destroy(struct psi_trigger *t);
+
 #ifdef CONFIG_CGROUPS
 int psi_cgroup_alloc(struct cgroup *cgrp);
 void psi_cgroup_free(struct cgroup *cgrp);
@@ -44,6 +48,13 @@ static inline void psi_init(void) {}
 static inline void psi_memstall_enter(unsigned long *flags) {}
 static inline void psi_memstall_leave(unsigned long *flags) {}
 
+static inline struct psi_trigger *psi_kernel_trigger_create(
+			enum psi_states state, u32 threshold_us, u32 window_us)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+static inline void psi_kernel_trigger_destroy(struct psi_trigger *t) {}
+
 #ifdef CONFIG_CGROUPS
 static inline int psi_cgroup_alloc(struct cgroup *cgrp)
 {
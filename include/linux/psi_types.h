@@ -144,7 +144,7 @@ struct psi_group {
 	u64 total[NR_PSI_AGGREGATORS][NR_PSI_STATES - 1];
 	unsigned long avg[NR_PSI_STATES - 1][3];
 
-	/* Monitor work control */
+	/* Monitor work control, poll_work runs on the shared psimon */
 	atomic_t poll_scheduled;
 	struct kthread_worker __rcu *poll_kworker;
 	struct kthread_delayed_work poll_work;
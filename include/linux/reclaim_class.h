@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_RECLAIM_CLASS_H
+#define _LINUX_RECLAIM_CLASS_H
+
+#include <linux/mm_types.h>
+
+/*
+ * Android app classes derived from oom_score_adj. Each mm carries the class
+ * of its owner so reclaim can bias the aging of the pages it maps, see
+ * page_referenced().
+ */
+enum reclaim_class {
+	RECLAIM_CLASS_VISIBLE,		/* visible or perceptible, no bias */
+	RECLAIM_CLASS_FOREGROUND,	/* mapped file pages are protected */
+	RECLAIM_CLASS_CACHED,		/* anon pages are reclaimed first */
+};
+
+#ifdef CONFIG_RECLAIM_CLASS
+extern int sysctl_reclaim_class_enable;
+extern int sysctl_reclaim_class_foreground_adj;
+extern int sysctl_reclaim_class_cached_adj;
+extern int sysctl_reclaim_class_kswapd_swappiness;
+
+static inline enum reclaim_class reclaim_class_of(short oom_score_adj)
+{
+	if (oom_score_adj <= sysctl_reclaim_class_foreground_adj)
+		return RECLAIM_CLASS_FOREGROUND;
+	if (oom_score_adj >= sysctl_reclaim_class_cached_adj)
+		return RECLAIM_CLASS_CACHED;
+	return RECLAIM_CLASS_VISIBLE;
+}
+
+static inline void reclaim_class_update(struct mm_struct *mm,
+					short oom_score_adj)
+{
+	WRITE_ONCE(mm->reclaim_class, reclaim_class_of(oom_score_adj));
+}
+#else
+static inline void reclaim_class_update(struct mm_struct *mm,
+					short oom_score_adj)
+{
+}
+#endif
+
+#endif /* _LINUX_RECLAIM_CLASS_H */
@@ -566,12 +566,16 @@ extern int register_cpu_cycle_counter_cb(struct cpu_cycle_counter_cb *cb);
 extern void sched_set_io_is_busy(int val);
 extern int sched_set_group_id(struct task_struct *p, unsigned int group_id);
 extern unsigned int sched_get_group_id(struct task_struct *p);
+extern int sched_set_group_frame_period(struct task_struct *p,
+					unsigned int period_us);
+extern unsigned int sched_get_group_frame_period(struct task_struct *p);
 extern int sched_set_init_task_load(struct task_struct *p, int init_load_pct);
 extern u32 sched_get_init_task_load(struct task_struct *p);
 extern void sched_update_cpu_freq_min_max(const cpumask_t *cpus, u32 fmin,
 					  u32 fmax);
 extern int sched_set_boost(int enable);
 extern void free_task_load_ptrs(struct task_struct *p);
+extern u64 sched_lpm_wakeup_hint(int cpu);
 
 #define RAVG_HIST_SIZE_MAX  5
 #define NUM_BUSY_BUCKETS 10
@@ -637,6 +641,10 @@ static inline int sched_set_boost(int enable)
 	return -EINVAL;
 }
 static inline void free_task_load_ptrs(struct task_struct *p) { }
+static inline u64 sched_lpm_wakeup_hint(int cpu)
+{
+	return 0;
+}
 
 static inline void sched_update_cpu_freq_min_max(const cpumask_t *cpus,
 					u32 fmin, u32 fmax) { }
@@ -818,6 +826,14 @@ struct task_struct {
 	struct task_struct		*last_wakee;
 
 	int				wake_cpu;
+
+	/* Last energy aware placement, reused by the next close wakeup */
+	int				wake_cache_cpu;
+	bool				wake_cache_idle;
+	unsigned int			wake_cache_gen;
+	unsigned long			wake_cache_util;
+	unsigned long			wake_cache_cpu_util;
+	u64				wake_cache_ts;
 #endif
 	int				on_rq;
 
@@ -847,6 +863,8 @@ struct task_struct {
 	struct list_head grp_list;
 	u64 cpu_cycles;
 	bool misfit;
+	/* sched_ktime_clock() when it stopped fitting its CPU, or 0 */
+	u64 misfit_start;
 #endif
 
 #ifdef CONFIG_CGROUP_SCHED
@@ -1423,7 +1441,9 @@ struct task_struct {
 	void				*security;
 #endif
 #ifdef CONFIG_ANDROID_SIMPLE_LMK
-	struct task_struct		*simple_lmk_next;
+	/* Node in simple_lmk's oom_score_adj bucket, group leaders only */
+	struct hlist_node		simple_lmk_node;
+	short				simple_lmk_adj;
 #endif
 
 	/*
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_SCHED_BOOST_ARBITER_H
+#define _LINUX_SCHED_BOOST_ARBITER_H
+
+#include <linux/list.h>
+
+/*
+ * Boost knobs handled by the arbiter. The meaning of a request value
+ * depends on the type:
+ *
+ * BOOST_REQ_CPU_MIN_FREQ	policy min frequency floor in kHz
+ * BOOST_REQ_SCHED_BOOST	sched boost type (FULL_THROTTLE_BOOST etc.)
+ * BOOST_REQ_CORE_CTL_MIN_CPUS	minimum active CPUs in the CPU's cluster
+ * BOOST_REQ_SCHEDTUNE		schedtune boost floor in percent
+ *
+ * A value of 0 releases the request.
+ */
+enum boost_req_type {
+	BOOST_REQ_CPU_MIN_FREQ,
+	BOOST_REQ_SCHED_BOOST,
+	BOOST_REQ_CORE_CTL_MIN_CPUS,
+	BOOST_REQ_SCHEDTUNE,
+	BOOST_REQ_NR_TYPES,
+};
+
+struct boost_req {
+	const char *name;
+	enum boost_req_type type;
+	/* Target CPU for per-CPU types, -1 for all CPUs */
+	int cpu;
+	int value;
+	/* Expiry in jiffies, 0 when the request is not time bounded */
+	unsigned long expires;
+	bool active;
+	struct list_head node;
+};
+
+#ifdef CONFIG_SCHED_BOOST_ARBITER
+extern int boost_req_add(struct boost_req *req, const char *name,
+			 enum boost_req_type type, int cpu);
+extern int boost_req_update(struct boost_req *req, int value,
+			    unsigned int timeout_ms);
+extern void boost_req_remove(struct boost_req *req);
+#else
+static inline int boost_req_add(struct boost_req *req, const char *name,
+				enum boost_req_type type, int cpu)
+{
+	return 0;
+}
+static inline int boost_req_update(struct boost_req *req, int value,
+				   unsigned int timeout_ms)
+{
+	return 0;
+}
+static inline void boost_req_remove(struct boost_req *req) { }
+#endif
+
+#endif /* _LINUX_SCHED_BOOST_ARBITER_H */
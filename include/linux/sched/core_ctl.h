@@ -22,6 +22,7 @@ struct core_ctl_notif_data {
 #ifdef CONFIG_SCHED_CORE_CTL
 void core_ctl_check(u64 wallclock);
 int core_ctl_set_boost(bool boost);
+int core_ctl_set_boost_min_cpus(unsigned int cpu, unsigned int min_cpus);
 void core_ctl_notifier_register(struct notifier_block *n);
 void core_ctl_notifier_unregister(struct notifier_block *n);
 #else
@@ -30,6 +31,11 @@ static inline int core_ctl_set_boost(bool boost)
 {
 	return 0;
 }
+static inline int core_ctl_set_boost_min_cpus(unsigned int cpu,
+					      unsigned int min_cpus)
+{
+	return 0;
+}
 static inline void core_ctl_notifier_register(struct notifier_block *n) {}
 static inline void core_ctl_notifier_unregister(struct notifier_block *n) {}
 #endif
@@ -31,4 +31,12 @@ void cpufreq_add_update_util_hook(int cpu, struct update_util_data *data,
 void cpufreq_remove_update_util_hook(int cpu);
 #endif /* CONFIG_CPU_FREQ */
 
+#ifdef CONFIG_CPU_FREQ_GOV_SCHEDUTIL
+void sched_set_cpufreq_floor(int cpu, unsigned int freq,
+			     unsigned int duration_us);
+#else
+static inline void sched_set_cpufreq_floor(int cpu, unsigned int freq,
+					   unsigned int duration_us) { }
+#endif
+
 #endif /* _LINUX_SCHED_CPUFREQ_H */
@@ -77,11 +77,20 @@ struct idle_state {
 	unsigned long power;	 /* power consumption in this idle state */
 };
 
+/*
+ * cap_idx_lut[util >> SGE_LUT_SHIFT] is the first capacity state able to
+ * serve that utilization bucket, built by the energy driver once the
+ * capacities are known.
+ */
+#define SGE_LUT_SHIFT	2
+#define SGE_LUT_SIZE	((SCHED_CAPACITY_SCALE >> SGE_LUT_SHIFT) + 1)
+
 struct sched_group_energy {
 	unsigned int nr_idle_states;	/* number of idle states */
 	struct idle_state *idle_states;	/* ptr to idle state array */
 	unsigned int nr_cap_states;	/* number of capacity states */
 	struct capacity_state *cap_states; /* ptr to capacity state array */
+	unsigned short *cap_idx_lut;	/* util bucket to capacity state */
 };
 
 unsigned long capacity_curr_of(int cpu);
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Receive path latency stamps
+ *
+ * While any socket records SO_RX_LATENCY, the receive path stamps each skb
+ * with the low 32 bits of the monotonic clock at the stages of enum
+ * skb_lat_stage, 0 meaning not stamped. Stamps are copied along with the
+ * other header fields and accounted by recvmsg() into the histograms of the
+ * socket. With no socket recording, stamping is a patched out branch.
+ */
+#ifndef _LINUX_SKB_LATENCY_H
+#define _LINUX_SKB_LATENCY_H
+
+#include <linux/jump_label.h>
+#include <linux/skbuff.h>
+#include <linux/timekeeping.h>
+#include <net/sock.h>
+#include <uapi/linux/skb_latency.h>
+
+#ifdef CONFIG_SKB_LATENCY
+extern struct static_key skb_lat_needed;
+
+static inline void skb_lat_stamp(struct sk_buff *skb, enum skb_lat_stage stage)
+{
+	if (static_key_false(&skb_lat_needed))
+		skb->lat_stamp[stage] = (u32)ktime_get_ns() | 1;
+}
+
+static inline void skb_lat_copy(struct sk_buff *to, const struct sk_buff *from)
+{
+	if (static_key_false(&skb_lat_needed))
+		memcpy(to->lat_stamp, from->lat_stamp, sizeof(to->lat_stamp));
+}
+
+void __sk_lat_recv(struct sock *sk, struct sk_buff *skb);
+
+/* Account @skb, about to be read by the application of @sk */
+static inline void sk_lat_recv(struct sock *sk, struct sk_buff *skb)
+{
+	if (static_key_false(&skb_lat_needed) && sk->sk_rx_latency)
+		__sk_lat_recv(sk, skb);
+}
+
+int sk_rx_latency_set(struct sock *sk, int val);
+int sk_rx_latency_get(struct sock *sk, char __user *optval, int len);
+void sk_rx_latency_clone(struct sock *newsk, const struct sock *sk);
+void sk_rx_latency_free(struct sock *sk);
+#else
+static inline void skb_lat_stamp(struct sk_buff *skb, enum skb_lat_stage stage)
+{
+}
+
+static inline void skb_lat_copy(struct sk_buff *to, const struct sk_buff *from)
+{
+}
+
+static inline void sk_lat_recv(struct sock *sk, struct sk_buff *skb)
+{
+}
+
+static inline void sk_rx_latency_clone(struct sock *newsk,
+				       const struct sock *sk)
+{
+}
+
+static inline void sk_rx_latency_free(struct sock *sk)
+{
+}
+#endif
+
+#endif /* _LINUX_SKB_LATENCY_H */
@@ -649,6 +649,7 @@ typedef unsigned char *sk_buff_data_t;
  *	@transport_header: Transport layer header
  *	@network_header: Network layer header
  *	@mac_header: Link layer header
+ *	@lat_stamp: receive path stage times for SO_RX_LATENCY
  *	@tail: Tail pointer
  *	@end: End pointer
  *	@head: Head of buffer
@@ -657,6 +658,15 @@ typedef unsigned char *sk_buff_data_t;
  *	@users: User count - see {datagram,tcp}.c
  */
 
+/* Receive path stages stamped into skb->lat_stamp, see skb_latency.h */
+enum skb_lat_stage {
+	SKB_LAT_DRIVER,		/* driver RX completion */
+	SKB_LAT_DEAGG,		/* MAP deaggregation */
+	SKB_LAT_NETIF,		/* last __netif_receive_skb() */
+	SKB_LAT_SOCKQ,		/* socket receive queue */
+	SKB_LAT_STAGES,
+};
+
 struct sk_buff {
 	union {
 		struct {
@@ -834,6 +844,10 @@ struct sk_buff {
 	__u16			network_header;
 	__u16			mac_header;
 
+#ifdef CONFIG_SKB_LATENCY
+	__u32			lat_stamp[SKB_LAT_STAGES];
+#endif
+
 	/* private: */
 	__u32			headers_end[0];
 	/* public: */
@@ -36,6 +36,9 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_MAGAZINE,		/* Allocation from cpu magazine */
+	FREE_MAGAZINE,		/* Free to cpu magazine */
+	MAGAZINE_FLUSH,		/* Cpu magazine full, half freed to slabs */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -90,6 +93,10 @@ struct kmem_cache {
 #ifdef CONFIG_SLUB_CPU_PARTIAL
 	/* Number of per cpu partial objects to keep around */
 	unsigned int cpu_partial;
+#endif
+#ifdef CONFIG_SLUB_MAGAZINE
+	struct slub_magazine __percpu *mag;	/* Per cpu freed objects */
+	unsigned int mag_size;
 #endif
 	struct kmem_cache_order_objects oo;
 
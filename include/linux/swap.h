@@ -275,6 +275,10 @@ struct swap_info_struct {
 	struct swap_cluster_list discard_clusters; /* discard clusters list */
 	unsigned int write_pending;
 	unsigned int max_writes;
+	/* swap ratio placement stats */
+	atomic_long_t nr_hot_writes;	/* slots handed out for hot pages */
+	atomic_long_t nr_cold_writes;	/* slots handed out for cold pages */
+	atomic_long_t nr_refaults;	/* pages read back from the device */
 	struct plist_node avail_lists[0]; /*
 					   * entries in swap_avail_heads, one
 					   * entry per node.
@@ -368,6 +372,7 @@ extern unsigned long shrink_all_memory(unsigned long nr_pages);
 extern int vm_swappiness;
 extern int sysctl_swap_ratio;
 extern int sysctl_swap_ratio_enable;
+extern int sysctl_swap_ratio_placement;
 extern int remove_mapping(struct address_space *mapping, struct page *page);
 extern unsigned long vm_total_pages;
 
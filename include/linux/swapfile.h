@@ -15,6 +15,8 @@ extern int try_to_unuse(unsigned int, bool, unsigned long);
 extern int swap_ratio(struct swap_info_struct **si, int node);
 extern void setup_swap_ratio(struct swap_info_struct *p, int prio);
 extern bool is_swap_ratio_group(int prio);
+extern swp_entry_t swap_ratio_place(struct page *page);
+extern swp_entry_t get_swap_page_from(struct swap_info_struct *si);
 extern unsigned long generic_max_swapfile_size(void);
 extern unsigned long max_swapfile_size(void);
 
@@ -16,6 +16,7 @@
 #include <linux/types.h>
 #include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/spinlock.h>
 #include <linux/dma-fence.h>
 #include <linux/dma-fence-array.h>
@@ -27,6 +28,7 @@
  * @wq:			wait queue for fence signaling
  * @fence:		fence with the fences in the sync_file
  * @cb:			fence callback information
+ * @wake_node:		entry in the per-CPU list of pending poll wakeups
  */
 struct sync_file {
 	struct file		*file;
@@ -47,9 +49,11 @@ struct sync_file {
 
 	struct dma_fence	*fence;
 	struct dma_fence_cb cb;
+	struct llist_node	wake_node;
 };
 
 #define POLL_ENABLED 0
+#define POLL_WAKE_QUEUED 1
 
 struct sync_file *sync_file_create(struct dma_fence *fence);
 struct dma_fence *sync_file_get_fence(int fd);
@@ -287,6 +287,16 @@ struct tcp_sock {
 
 	struct hrtimer	pacing_timer;
 
+	/* Tuning of the device the connection was established over, from
+	 * /proc/sys/net/ipv4/conf/<dev>/tcp_*, 0 means the global default.
+	 */
+	int	dev_ifindex;
+	u32	dev_limit_output_bytes;
+	u16	dev_pacing_ss_ratio;
+	u16	dev_pacing_ca_ratio;
+	u16	dev_init_cwnd;
+	u8	dev_no_autocork:1;
+
 	/* from STCP, retrans queue hinting */
 	struct sk_buff* lost_skb_hint;
 	struct sk_buff *retransmit_skb_hint;
@@ -253,6 +253,7 @@ struct sock_common {
   *	@sk_forward_alloc: space allocated forward
   *	@sk_napi_id: id of the last napi context to receive data for sk
   *	@sk_ll_usec: usecs to busypoll when there is no data
+  *	@sk_busy_poll_budget: napi budget per busypoll round, 0 for the default
   *	@sk_allocation: allocation mode
   *	@sk_pacing_rate: Pacing rate (if supported by transport/packet scheduler)
   *	@sk_pacing_status: Pacing status (requested, handled by sch_fq)
@@ -313,6 +314,7 @@ struct sock_common {
   *	@sk_backlog_rcv: callback to process the backlog
   *	@sk_destruct: called at sock freeing time, i.e. when all refcnt == 0
   *	@sk_reuseport_cb: reuseport group container
+  *	@sk_rx_latency: receive latency histograms, see %SO_RX_LATENCY
   *	@sk_rcu: used during RCU grace period
   */
 struct sock {
@@ -376,6 +378,7 @@ struct sock {
 	int			sk_forward_alloc;
 #ifdef CONFIG_NET_RX_BUSY_POLL
 	unsigned int		sk_ll_usec;
+	u16			sk_busy_poll_budget;
 	/* ===== mostly read cache line ===== */
 	unsigned int		sk_napi_id;
 #endif
@@ -481,6 +484,9 @@ struct sock {
 						  struct sk_buff *skb);
 	void                    (*sk_destruct)(struct sock *sk);
 	struct sock_reuseport __rcu	*sk_reuseport_cb;
+#ifdef CONFIG_SKB_LATENCY
+	struct sk_rx_latency_hist	*sk_rx_latency;
+#endif
 	struct rcu_head		sk_rcu;
 };
 
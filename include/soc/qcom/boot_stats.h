@@ -29,8 +29,11 @@ int boot_stats_init(void);
 int boot_stats_exit(void);
 unsigned long long int msm_timer_get_sclk_ticks(void);
 phys_addr_t msm_timer_get_pa(void);
+void boot_stats_add_probe(const char *drv, const char *dev, u64 ns, int ret);
 #else
 static inline int boot_stats_init(void) { return 0; }
+static inline void boot_stats_add_probe(const char *drv, const char *dev,
+					u64 ns, int ret) { }
 static inline unsigned long long int msm_timer_get_sclk_ticks(void)
 {
 	return 0;
@@ -49,6 +49,9 @@ void lpm_stats_cluster_exit(struct lpm_stats *stats, uint32_t index,
 				bool success);
 void lpm_stats_cpu_enter(uint32_t index, uint64_t time);
 void lpm_stats_cpu_exit(uint32_t index, uint64_t time, bool success);
+void lpm_stats_cluster_mispredict(struct lpm_stats *stats, uint32_t index,
+				bool too_deep);
+void lpm_stats_cpu_mispredict(uint32_t index, bool too_deep);
 void lpm_stats_suspend_enter(void);
 void lpm_stats_suspend_exit(void);
 #else
@@ -74,6 +77,13 @@ static inline void lpm_stats_cpu_exit(uint32_t index, bool success,
 							uint64_t time)
 { }
 
+static inline void lpm_stats_cluster_mispredict(struct lpm_stats *stats,
+					uint32_t index, bool too_deep)
+{ }
+
+static inline void lpm_stats_cpu_mispredict(uint32_t index, bool too_deep)
+{ }
+
 static inline void lpm_stats_suspend_enter(void)
 { }
 
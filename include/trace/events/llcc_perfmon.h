@@ -0,0 +1,52 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM llcc_perfmon
+
+#if !defined(_TRACE_LLCC_PERFMON_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LLCC_PERFMON_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(llcc_perfmon_sample,
+
+	TP_PROTO(unsigned int port, unsigned int event, int scid,
+		 unsigned long long count, unsigned long long cycles),
+
+	TP_ARGS(port, event, scid, count, cycles),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, port)
+		__field(unsigned int, event)
+		__field(int, scid)
+		__field(unsigned long long, count)
+		__field(unsigned long long, cycles)
+	),
+
+	TP_fast_assign(
+		__entry->port = port;
+		__entry->event = event;
+		__entry->scid = scid;
+		__entry->count = count;
+		__entry->cycles = cycles;
+	),
+
+	TP_printk("port=%u event=%u scid=%d count=%llu cycles=%llu",
+		  __entry->port, __entry->event, __entry->scid,
+		  __entry->count, __entry->cycles)
+);
+
+#endif /* _TRACE_LLCC_PERFMON_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
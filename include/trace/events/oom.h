@@ -151,6 +151,27 @@ TRACE_EVENT(skip_task_reaping,
 	TP_printk("pid=%d", __entry->pid)
 );
 
+TRACE_EVENT(simple_lmk_reap,
+	TP_PROTO(int pid, unsigned long pages, u64 duration_us),
+
+	TP_ARGS(pid, pages, duration_us),
+
+	TP_STRUCT__entry(
+		__field(int, pid)
+		__field(unsigned long, pages)
+		__field(u64, duration_us)
+	),
+
+	TP_fast_assign(
+		__entry->pid = pid;
+		__entry->pages = pages;
+		__entry->duration_us = duration_us;
+	),
+
+	TP_printk("pid=%d pages=%lu duration_us=%llu",
+		__entry->pid, __entry->pages, __entry->duration_us)
+);
+
 #ifdef CONFIG_COMPACTION
 TRACE_EVENT(compact_retry,
 
@@ -59,6 +59,37 @@ TRACE_EVENT(process_reclaim,
 			__entry->nr_to_reclaim)
 );
 
+TRACE_EVENT(process_reclaim_refault,
+
+	TP_PROTO(pid_t pid, int nr_reclaimed, unsigned long refaults,
+		int refault, int efficiency, int skip),
+
+	TP_ARGS(pid, nr_reclaimed, refaults, refault, efficiency, skip),
+
+	TP_STRUCT__entry(
+		__field(pid_t, pid)
+		__field(int, nr_reclaimed)
+		__field(unsigned long, refaults)
+		__field(int, refault)
+		__field(int, efficiency)
+		__field(int, skip)
+	),
+
+	TP_fast_assign(
+		__entry->pid		= pid;
+		__entry->nr_reclaimed	= nr_reclaimed;
+		__entry->refaults	= refaults;
+		__entry->refault	= refault;
+		__entry->efficiency	= efficiency;
+		__entry->skip		= skip;
+	),
+
+	TP_printk("%d, %d, %lu, %d, %d, %d",
+			__entry->pid, __entry->nr_reclaimed,
+			__entry->refaults, __entry->refault,
+			__entry->efficiency, __entry->skip)
+);
+
 TRACE_EVENT(process_reclaim_eff,
 
 	TP_PROTO(int efficiency, int reclaim_avg_efficiency),
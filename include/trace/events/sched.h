@@ -1070,6 +1070,30 @@ TRACE_EVENT(core_ctl_eval_need,
 		  __entry->old_need, __entry->new_need, __entry->updated)
 );
 
+TRACE_EVENT(core_ctl_energy_need,
+
+	TP_PROTO(unsigned int cpu, unsigned long util, unsigned int old_need,
+		 unsigned int new_need, unsigned long cost),
+	TP_ARGS(cpu, util, old_need, new_need, cost),
+	TP_STRUCT__entry(
+		__field(u32, cpu)
+		__field(unsigned long, util)
+		__field(u32, old_need)
+		__field(u32, new_need)
+		__field(unsigned long, cost)
+	),
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->util = util;
+		__entry->old_need = old_need;
+		__entry->new_need = new_need;
+		__entry->cost = cost;
+	),
+	TP_printk("cpu=%u, util=%lu, old_need=%u, new_need=%u, cost=%lu",
+		  __entry->cpu, __entry->util, __entry->old_need,
+		  __entry->new_need, __entry->cost)
+);
+
 TRACE_EVENT(core_ctl_set_busy,
 
 	TP_PROTO(unsigned int cpu, unsigned int busy,
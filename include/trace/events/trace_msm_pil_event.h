@@ -65,6 +65,37 @@ TRACE_EVENT(pil_notif,
 		__get_str(fw_name))
 );
 
+TRACE_EVENT(pil_seg_load,
+
+	TP_PROTO(struct pil_desc *desc, int num, unsigned long filesz,
+		 u64 read_ns, u64 verify_ns),
+
+	TP_ARGS(desc, num, filesz, read_ns, verify_ns),
+
+	TP_STRUCT__entry(
+		__string(fw_name, desc->fw_name)
+		__field(int, num)
+		__field(unsigned long, filesz)
+		__field(u64, read_ns)
+		__field(u64, verify_ns)
+	),
+
+	TP_fast_assign(
+		__assign_str(fw_name, desc->fw_name);
+		__entry->num = num;
+		__entry->filesz = filesz;
+		__entry->read_ns = read_ns;
+		__entry->verify_ns = verify_ns;
+	),
+
+	TP_printk("fw_name=%s seg=%d filesz=%lu read_us=%llu verify_us=%llu",
+		__get_str(fw_name),
+		__entry->num,
+		__entry->filesz,
+		__entry->read_ns / NSEC_PER_USEC,
+		__entry->verify_ns / NSEC_PER_USEC)
+);
+
 TRACE_EVENT(pil_func,
 
 	TP_PROTO(const char *func_name),
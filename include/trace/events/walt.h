@@ -377,6 +377,51 @@ TRACE_EVENT(sched_set_preferred_cluster,
 			__entry->cluster_first_cpu)
 );
 
+TRACE_EVENT(walt_window_snapshot_retry,
+
+	TP_PROTO(int cpu, unsigned int seq_retries, unsigned int passes),
+
+	TP_ARGS(cpu, seq_retries, passes),
+
+	TP_STRUCT__entry(
+		__field(	int,		cpu			)
+		__field(	unsigned int,	seq_retries		)
+		__field(	unsigned int,	passes			)
+	),
+
+	TP_fast_assign(
+		__entry->cpu			= cpu;
+		__entry->seq_retries		= seq_retries;
+		__entry->passes			= passes;
+	),
+
+	TP_printk("cpu=%d seq_retries=%u window_retries=%u",
+		__entry->cpu, __entry->seq_retries, __entry->passes)
+);
+
+TRACE_EVENT(sched_set_group_frame_period,
+
+	TP_PROTO(struct related_thread_group *grp),
+
+	TP_ARGS(grp),
+
+	TP_STRUCT__entry(
+		__field(	int,	id			)
+		__field(	u64,	frame_period		)
+		__field(	u64,	frame_anchor		)
+	),
+
+	TP_fast_assign(
+		__entry->id			= grp->id;
+		__entry->frame_period		= grp->frame_period;
+		__entry->frame_anchor		= grp->frame_anchor;
+	),
+
+	TP_printk("group_id %d frame_period %llu frame_anchor %llu",
+			__entry->id, __entry->frame_period,
+			__entry->frame_anchor)
+);
+
 TRACE_EVENT(sched_migration_update_sum,
 
 	TP_PROTO(struct task_struct *p, enum migrate_types migrate_type, struct rq *rq),
@@ -442,6 +487,59 @@ TRACE_EVENT(sched_set_boost,
 	TP_printk("type %d", __entry->type)
 );
 
+TRACE_EVENT(boost_arb_request,
+
+	TP_PROTO(const char *name, int type, int cpu, int value,
+		 unsigned int timeout_ms),
+
+	TP_ARGS(name, type, cpu, value, timeout_ms),
+
+	TP_STRUCT__entry(
+		__string(name,		name			)
+		__field(int,		type			)
+		__field(int,		cpu			)
+		__field(int,		value			)
+		__field(unsigned int,	timeout_ms		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->type		= type;
+		__entry->cpu		= cpu;
+		__entry->value		= value;
+		__entry->timeout_ms	= timeout_ms;
+	),
+
+	TP_printk("name %s type %d cpu %d value %d timeout_ms %u",
+		__get_str(name), __entry->type, __entry->cpu,
+		__entry->value, __entry->timeout_ms)
+);
+
+TRACE_EVENT(boost_arb_winner,
+
+	TP_PROTO(int type, int cpu, const char *winner, int value),
+
+	TP_ARGS(type, cpu, winner, value),
+
+	TP_STRUCT__entry(
+		__field(int,		type			)
+		__field(int,		cpu			)
+		__string(winner,	winner			)
+		__field(int,		value			)
+	),
+
+	TP_fast_assign(
+		__entry->type		= type;
+		__entry->cpu		= cpu;
+		__assign_str(winner, winner);
+		__entry->value		= value;
+	),
+
+	TP_printk("type %d cpu %d winner %s value %d",
+		__entry->type, __entry->cpu, __get_str(winner),
+		__entry->value)
+);
+
 TRACE_EVENT(sched_load_balance_skip_tasks,
 
 	TP_PROTO(int scpu, int dcpu, int grp_type, int pid, unsigned long h_load, unsigned long task_util, unsigned long affinity),
@@ -583,6 +681,35 @@ TRACE_EVENT(sched_load_to_gov,
 		__entry->sysctl_sched_little_cluster_coloc_fmin_khz,
 		__entry->coloc_boost_load)
 );
+
+TRACE_EVENT(sched_misfit_duration,
+
+	TP_PROTO(struct task_struct *p, int cpu, u64 duration),
+
+	TP_ARGS(p, cpu, duration),
+
+	TP_STRUCT__entry(
+		__array(char,		comm,	TASK_COMM_LEN	)
+		__field(pid_t,		pid			)
+		__field(int,		cpu			)
+		__field(unsigned long,	capacity		)
+		__field(u64,		demand			)
+		__field(u64,		duration		)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->cpu		= cpu;
+		__entry->capacity	= capacity_orig_of(cpu);
+		__entry->demand		= p->ravg.demand_scaled;
+		__entry->duration	= duration;
+	),
+
+	TP_printk("pid=%d comm=%s cpu=%d capacity=%lu demand=%llu duration_us=%llu",
+		__entry->pid, __entry->comm, __entry->cpu, __entry->capacity,
+		__entry->demand, __entry->duration / NSEC_PER_USEC)
+);
 #else
 #define trace_sched_load_balance_skip_tasks(...)
 #endif
@@ -152,6 +152,60 @@ TRACE_EVENT(wbt_timer,
 		  __entry->status, __entry->step, __entry->inflight)
 );
 
+#define show_wbt_class(class)					\
+	__print_symbolic(class,					\
+		{ BIO_WB_USER,		"user" },		\
+		{ BIO_WB_GC,		"gc" },			\
+		{ BIO_WB_CHECKPOINT,	"checkpoint" },		\
+		{ BIO_WB_SWAP,		"swap" })
+
+#define show_wbt_policy(policy)					\
+	__print_symbolic(policy,				\
+		{ WBT_POLICY_AUTO,	"auto" },		\
+		{ WBT_POLICY_YIELD,	"yield" },		\
+		{ WBT_POLICY_MAX,	"max" })
+
+/**
+ * wbt_throttle - trace throttle decision for a tracked write
+ * @class: writeback class of the write
+ * @policy: throttling policy of that class
+ * @limit: queue limit the write was held to
+ * @inflight: tracked writes inflight
+ * @waited: whether the submitter had to wait for the limit
+ */
+TRACE_EVENT(wbt_throttle,
+
+	TP_PROTO(struct backing_dev_info *bdi, unsigned int wb_class,
+		 unsigned int policy, unsigned int limit,
+		 unsigned int inflight, bool waited),
+
+	TP_ARGS(bdi, wb_class, policy, limit, inflight, waited),
+
+	TP_STRUCT__entry(
+		__array(char, name, 32)
+		__field(unsigned int, wb_class)
+		__field(unsigned int, policy)
+		__field(unsigned int, limit)
+		__field(unsigned int, inflight)
+		__field(bool, waited)
+	),
+
+	TP_fast_assign(
+		strlcpy(__entry->name, dev_name(bdi->dev),
+			ARRAY_SIZE(__entry->name));
+		__entry->wb_class	= wb_class;
+		__entry->policy		= policy;
+		__entry->limit		= limit;
+		__entry->inflight	= inflight;
+		__entry->waited		= waited;
+	),
+
+	TP_printk("%s: class=%s, policy=%s, limit=%u, inflight=%u, waited=%d\n",
+		  __entry->name, show_wbt_class(__entry->wb_class),
+		  show_wbt_policy(__entry->policy), __entry->limit,
+		  __entry->inflight, __entry->waited)
+);
+
 #endif /* _TRACE_WBT_H */
 
 /* This part must be outside protection */
@@ -62,6 +62,11 @@
 #define MADV_WIPEONFORK 18		/* Zero memory on fork, child only */
 #define MADV_KEEPONFORK 19		/* Undo MADV_WIPEONFORK */
 
+/* Map 2^order pages around read faults, order 0 disables fault-around */
+#define MADV_FAULTAROUND_DEFAULT 64	/* use the global fault_around_bytes */
+#define MADV_FAULTAROUND_ORDER(order)	(MADV_FAULTAROUND_DEFAULT + 1 + (order))
+#define MADV_FAULTAROUND_MAX_ORDER 14
+
 /* compatibility flags */
 #define MAP_FILE	0
 
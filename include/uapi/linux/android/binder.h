@@ -172,6 +172,15 @@ struct binder_fd_object {
  * in the offset array pointing to the parent binder_buffer_object,
  * and by setting @parent_offset to the offset in the parent buffer
  * at which the pointer to this buffer is located.
+ *
+ * Setting BINDER_BUFFER_FLAG_ZERO_COPY asks the driver to map the pages
+ * backing a large, page aligned @buffer into the target instead of
+ * copying them. Only pages of shared file mappings (memfd, ashmem, tmpfs)
+ * qualify; anything else is copied. Mapped pages stay shared with the
+ * sender until the target frees the transaction buffer. The sender must
+ * not modify them until then, and such a buffer cannot be the parent of
+ * another object. Reserve an extra PAGE_SIZE of extra_buffers_size per
+ * zero-copy buffer so the driver can page align it in the target.
  */
 struct binder_buffer_object {
 	struct binder_object_header	hdr;
@@ -184,6 +193,7 @@ struct binder_buffer_object {
 
 enum {
 	BINDER_BUFFER_FLAG_HAS_PARENT = 0x01,
+	BINDER_BUFFER_FLAG_ZERO_COPY = 0x02,
 };
 
 /* struct binder_fd_array_object - object describing an array of fds in a buffer
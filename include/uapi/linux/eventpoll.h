@@ -40,6 +40,12 @@
 #define EPOLLMSG	0x00000400
 #define EPOLLRDHUP	0x00002000
 
+/*
+ * Let the wakeup for the target file descriptor be delayed by up to
+ * /proc/sys/fs/epoll/defer_us, so that it is batched with other events
+ */
+#define EPOLLDEFER (1U << 27)
+
 /* Set exclusive wakeup mode for the target file descriptor */
 #define EPOLLEXCLUSIVE (1U << 28)
 
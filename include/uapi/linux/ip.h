@@ -169,6 +169,11 @@ enum
 	IPV4_DEVCONF_DROP_UNICAST_IN_L2_MULTICAST,
 	IPV4_DEVCONF_DROP_GRATUITOUS_ARP,
 	IPV4_DEVCONF_NF_IPV4_DEFRAG_SKIP,
+	IPV4_DEVCONF_TCP_LIMIT_OUTPUT_BYTES,
+	IPV4_DEVCONF_TCP_PACING_SS_RATIO,
+	IPV4_DEVCONF_TCP_PACING_CA_RATIO,
+	IPV4_DEVCONF_TCP_INIT_CWND,
+	IPV4_DEVCONF_TCP_NO_AUTOCORK,
 	__IPV4_DEVCONF_MAX
 };
 
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_JANK_SNAPSHOT_H
+#define _UAPI_LINUX_JANK_SNAPSHOT_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * JANK_SNAPSHOT_TRIGGER on /dev/jank_snapshot captures the scheduler, CPU
+ * and GPU frequency, GPU dispatcher, block and PSI state, tagged with
+ * @tag, e.g. the frame number. On return @seq identifies the snapshot.
+ * It fails with EBUSY when the previous one was taken less than
+ * min_interval_ms ago.
+ *
+ * Reading /dev/jank_snapshot returns the retained snapshots as text,
+ * oldest first.
+ */
+struct jank_snapshot_trigger {
+	__u64 tag;
+	__u64 seq;
+};
+
+#define JANK_SNAPSHOT_TRIGGER	_IOWR('J', 1, struct jank_snapshot_trigger)
+
+#endif /* _UAPI_LINUX_JANK_SNAPSHOT_H */
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Continuous Adreno perfcounter sampling, /dev/kgsl-profile
+ *
+ * KGSL_PROFILE_IOC_CONFIG assigns a set of perfcounters. From then on the
+ * GPU records each of them before and after the IBs of every interval'th
+ * submission of each context. read() returns one struct kgsl_profile_sample
+ * per sampled submission once it has retired, oldest first and never
+ * split across reads. Samples that do not fit the kernel ring while no one
+ * reads are dropped and counted in the next sample.
+ */
+#ifndef _UAPI_LINUX_KGSL_PROFILE_H
+#define _UAPI_LINUX_KGSL_PROFILE_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define KGSL_PROFILE_MAX_COUNTERS	64
+
+/**
+ * struct kgsl_profile_counter - one perfcounter to sample
+ * @groupid: KGSL_PERFCOUNTER_GROUP_*
+ * @countable: countable selected in the group
+ */
+struct kgsl_profile_counter {
+	__u32 groupid;
+	__u32 countable;
+};
+
+/**
+ * struct kgsl_profile_config - argument of KGSL_PROFILE_IOC_CONFIG
+ * @counters: user pointer to @count struct kgsl_profile_counter
+ * @count: number of counters, 0 stops sampling
+ * @interval: sample one in this many submissions of each context, 0 is 1
+ * @assigned: returns the number of counters that could be assigned
+ */
+struct kgsl_profile_config {
+	__u64 counters;
+	__u32 count;
+	__u32 interval;
+	__u32 assigned;
+	__u32 __pad;
+};
+
+/**
+ * struct kgsl_profile_value - a counter over one submission
+ * @groupid: KGSL_PERFCOUNTER_GROUP_*
+ * @countable: countable selected in the group
+ * @delta: counter increase from before to after the submission's IBs
+ */
+struct kgsl_profile_value {
+	__u32 groupid;
+	__u32 countable;
+	__u64 delta;
+};
+
+/**
+ * struct kgsl_profile_sample - counters of one retired submission
+ * @size: bytes of this sample, including @values
+ * @count: entries in @values
+ * @context_id: KGSL context of the submission
+ * @pid: process that owns the context
+ * @tid: thread that created the context
+ * @timestamp: global ringbuffer timestamp of the submission
+ * @type: context type, KGSL_CONTEXT_TYPE_*
+ * @dropped: samples dropped just before this one
+ * @values: one per assigned counter
+ */
+struct kgsl_profile_sample {
+	__u32 size;
+	__u32 count;
+	__u32 context_id;
+	__u32 pid;
+	__u32 tid;
+	__u32 timestamp;
+	__u32 type;
+	__u32 dropped;
+	struct kgsl_profile_value values[];
+};
+
+#define KGSL_PROFILE_IOC_CONFIG	_IOWR('K', 1, struct kgsl_profile_config)
+
+#endif /* _UAPI_LINUX_KGSL_PROFILE_H */
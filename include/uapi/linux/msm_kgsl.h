@@ -113,6 +113,12 @@
 /* Flags for GPU command memory objects */
 #define KGSL_OBJLIST_MEMOBJ  0x00000008U
 #define KGSL_OBJLIST_PROFILE 0x00000010U
+/*
+ * Frame deadline hint rather than a memory object: @offset holds the
+ * CLOCK_MONOTONIC time in ns by which the frame ending with this command
+ * should have retired. Used by the GPU frame deadline DCVS mode.
+ */
+#define KGSL_OBJLIST_DEADLINE 0x00000020U
 
 /* Flags for GPU command sync points */
 #define KGSL_CMD_SYNCPOINT_TYPE_TIMESTAMP 0
@@ -1638,4 +1644,37 @@ struct kgsl_gpu_sparse_command {
 #define IOCTL_KGSL_GPU_SPARSE_COMMAND \
 	_IOWR(KGSL_IOC_TYPE, 0x55, struct kgsl_gpu_sparse_command)
 
+#define KGSL_GPU_COMMAND_BATCH_MAX 64
+
+/**
+ * struct kgsl_gpu_command_batch - Argument for IOCTL_KGSL_GPU_COMMAND_BATCH
+ * @cmdlist: List of kgsl_gpu_command structures to submit
+ * @cmdsize: Size of the kgsl_gpu_command structure
+ * @numcmds: Number of kgsl_gpu_command structures in the list
+ * @synclist: List of kgsl_command_syncpoints shared by the whole batch
+ * @syncsize: Size of the kgsl_command_syncpoint structure
+ * @numsyncs: Number of kgsl_command_syncpoints in the shared list
+ * @flags: Reserved, must be 0
+ * @count: Number of commands queued
+ *
+ * The commands are queued in order, each to the context named in its
+ * context_id, and the timestamp of each is written back to its entry in
+ * cmdlist as it is queued. If queueing stops on an error the entries before
+ * the failing one have been submitted. The shared syncpoints are waited for
+ * once per context before its first command in the batch.
+ */
+struct kgsl_gpu_command_batch {
+	uint64_t __user cmdlist;
+	unsigned int cmdsize;
+	unsigned int numcmds;
+	uint64_t __user synclist;
+	unsigned int syncsize;
+	unsigned int numsyncs;
+	unsigned int flags;
+	unsigned int count;
+};
+
+#define IOCTL_KGSL_GPU_COMMAND_BATCH \
+	_IOWR(KGSL_IOC_TYPE, 0x56, struct kgsl_gpu_command_batch)
+
 #endif /* _UAPI_MSM_KGSL_H */
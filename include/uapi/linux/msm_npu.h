@@ -57,6 +57,10 @@
 #define MSM_NPU_GET_PROP \
 	_IOW(MSM_NPU_IOCTL_MAGIC, 11, struct msm_npu_property)
 
+/* submit exec to the network queue */
+#define MSM_NPU_SUBMIT_EXEC \
+	_IOWR(MSM_NPU_IOCTL_MAGIC, 12, struct msm_npu_submit_exec_ioctl)
+
 #define MSM_NPU_EVENT_TYPE_START 0x10000000
 #define MSM_NPU_EVENT_TYPE_EXEC_DONE (MSM_NPU_EVENT_TYPE_START + 1)
 #define MSM_NPU_EVENT_TYPE_EXEC_V2_DONE (MSM_NPU_EVENT_TYPE_START + 2)
@@ -259,6 +263,23 @@ struct msm_npu_exec_network_ioctl_v2 {
 	uint32_t reserved;
 };
 
+struct msm_npu_submit_exec_ioctl {
+	/* patch buf info for both input and output layers */
+	uint64_t patch_buf_info;
+	/* network handle */
+	uint32_t network_hdl;
+	/* execution flags */
+	uint32_t flags;
+	/* number of layers to be patched */
+	uint32_t patch_buf_info_num;
+	/* sync_file fd to wait on before execution, -1 for none */
+	int32_t in_fence_fd;
+	/* sync_file fd signaled when execution is done, returned */
+	int32_t out_fence_fd;
+	/* reserved */
+	uint32_t reserved;
+};
+
 struct msm_npu_event_execute_done {
 	uint32_t network_hdl;
 	int32_t exec_result;
@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_SCHED_FREQ_TRACE_H
+#define _UAPI_LINUX_SCHED_FREQ_TRACE_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * /dev/sched_freq_trace keeps the last frequency decisions of schedutil
+ * and the WALT load and window events behind them in per-CPU rings.
+ *
+ * SCHED_FREQ_TRACE_SNAPSHOT copies the records newer than since_ns to buf,
+ * one CPU after the other, each CPU oldest first. Records that do not fit
+ * in size bytes are dropped from the newest end of each CPU. On return
+ * count holds the number of records copied and lost the number of records
+ * overwritten before they could be read since the previous snapshot.
+ */
+
+enum sched_freq_event {
+	/* freq: chosen kHz, util and max: final capacity units */
+	SCHED_FREQ_EV_DECISION,
+	/* freq: current kHz, util: window demand, max: windows elapsed */
+	SCHED_FREQ_EV_WINDOW,
+	/* freq: current kHz, util: load, max: top task load, both in ns */
+	SCHED_FREQ_EV_LOAD,
+};
+
+/* Why a decision came out the way it did */
+#define SCHED_FREQ_R_IOWAIT		(1 << 0)
+#define SCHED_FREQ_R_HISPEED		(1 << 1)
+#define SCHED_FREQ_R_LOOKAHEAD		(1 << 2)
+#define SCHED_FREQ_R_NL			(1 << 3)
+#define SCHED_FREQ_R_PL			(1 << 4)
+#define SCHED_FREQ_R_FLOOR		(1 << 5)
+#define SCHED_FREQ_R_DL			(1 << 6)
+#define SCHED_FREQ_R_BUSY		(1 << 7)
+#define SCHED_FREQ_R_RATE_LIMIT		(1 << 8)
+#define SCHED_FREQ_R_UNCHANGED		(1 << 9)
+#define SCHED_FREQ_R_SCHED_BOOST	(1 << 10)
+#define SCHED_FREQ_R_EARLY_DETECT	(1 << 11)
+
+struct sched_freq_rec {
+	__u64 time;	/* sched_clock() ns */
+	__u32 freq;
+	__u32 util;
+	__u32 max;
+	__u16 reason;
+	__u8 event;
+	__u8 cpu;	/* policy CPU for decisions */
+};
+
+struct sched_freq_snapshot {
+	__u64 buf;
+	__u64 since_ns;
+	__u32 size;
+	__u32 count;
+	__u32 lost;
+	__u32 reserved;
+};
+
+#define SCHED_FREQ_TRACE_SNAPSHOT	_IOWR('F', 1, struct sched_freq_snapshot)
+
+#endif /* _UAPI_LINUX_SCHED_FREQ_TRACE_H */
@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Receive latency histograms, getsockopt(SOL_SOCKET, SO_RX_LATENCY)
+ *
+ * setsockopt(SO_RX_LATENCY) with a non zero value starts recording on the
+ * socket and clears the histograms, 0 stops recording. From then on every
+ * packet read by the application adds the time spent between the receive
+ * path stages it was stamped at to the histogram of each interval. A stage
+ * the packet did not pass through is skipped, its interval is then counted
+ * from the previous stamped stage.
+ */
+#ifndef _UAPI_LINUX_SKB_LATENCY_H
+#define _UAPI_LINUX_SKB_LATENCY_H
+
+#include <linux/types.h>
+
+/* Intervals, each ending at the stage it is named after */
+enum {
+	SK_RXLAT_DEAGG,		/* driver RX completion to MAP deaggregation */
+	SK_RXLAT_NETIF,		/* to the last netif_receive_skb() */
+	SK_RXLAT_SOCKQ,		/* to the socket receive queue */
+	SK_RXLAT_APP,		/* to recvmsg() */
+	SK_RXLAT_TOTAL,		/* first stamped stage to recvmsg() */
+	__SK_RXLAT_MAX,
+};
+
+/*
+ * Bucket 0 counts intervals under 1us, bucket n those in [2^(n-1), 2^n) us
+ * and the last one everything longer.
+ */
+#define SK_RXLAT_BUCKETS	20
+
+/**
+ * struct sk_rx_latency - argument of getsockopt(SO_RX_LATENCY)
+ * @packets: packets accounted
+ * @hist: per interval histograms
+ */
+struct sk_rx_latency {
+	__u64 packets;
+	__u32 hist[__SK_RXLAT_MAX][SK_RXLAT_BUCKETS];
+};
+
+#endif /* _UAPI_LINUX_SKB_LATENCY_H */
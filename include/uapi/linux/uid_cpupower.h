@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_UID_CPUPOWER_H
+#define _UAPI_LINUX_UID_CPUPOWER_H
+
+#include <linux/types.h>
+
+/*
+ * /proc/uid_cpupower/times holds the per uid times of uid_time_in_state,
+ * uid_concurrent_active_time and uid_concurrent_policy_time in binary.
+ *
+ * A read from offset 0 returns a struct uid_times_header followed by
+ * records of header.record_size bytes. Each record is a struct
+ * uid_times_record followed by nr_states time in state, nr_cpus concurrent
+ * active and nr_cpus concurrent policy times, as __u64 nanoseconds.
+ *
+ * The first complete read of an open file returns every uid. Each later
+ * one only returns the uids whose times changed after the seq of the
+ * previous header, so a reader can keep the file open and poll it.
+ */
+#define UID_TIMES_VERSION	1
+
+struct uid_times_header {
+	__u32 version;
+	__u32 header_size;
+	__u32 record_size;
+	__u32 nr_states;
+	__u32 nr_cpus;
+	__u32 reserved;
+	/* current sequence number, and the one records are newer than */
+	__u64 seq;
+	__u64 since;
+};
+
+struct uid_times_record {
+	__u32 uid;
+	__u32 reserved;
+	/* sequence number of the last change */
+	__u64 seq;
+};
+
+#endif /* _UAPI_LINUX_UID_CPUPOWER_H */
@@ -150,4 +150,18 @@ struct cam_sync_create2 {
 #define CAM_SYNC_CREATE2                         10
 #define CAM_SYNC_RESET                           11
 
+/**
+ * struct cam_sync_fence_info - Sync object and sync_file fence pairing
+ *
+ * @sync_obj:   Sync object to export, or sync object returned on import
+ * @fence_fd:   sync_file fd returned on export, or fd to import
+ */
+struct cam_sync_fence_info {
+	int32_t sync_obj;
+	int32_t fence_fd;
+};
+
+#define CAM_SYNC_EXPORT_FENCE                    12
+#define CAM_SYNC_IMPORT_FENCE                    13
+
 #endif /* __UAPI_CAM_SYNC_H__ */
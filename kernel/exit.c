@@ -52,6 +52,7 @@
 #include <linux/tracehook.h>
 #include <linux/fs_struct.h>
 #include <linux/init_task.h>
+#include <linux/simple_lmk.h>
 #include <linux/perf_event.h>
 #include <trace/events/sched.h>
 #include <linux/hw_breakpoint.h>
@@ -219,6 +220,7 @@ repeat:
 	}
 
 	write_unlock_irq(&tasklist_lock);
+	simple_lmk_task_release(p);
 	release_thread(p);
 	call_rcu(&p->rcu, delayed_put_task_struct);
 
@@ -83,6 +83,8 @@
 #include <linux/posix-timers.h>
 #include <linux/user-return-notifier.h>
 #include <linux/oom.h>
+#include <linux/reclaim_class.h>
+#include <linux/mm_wss.h>
 #include <linux/khugepaged.h>
 #include <linux/signalfd.h>
 #include <linux/uprobes.h>
@@ -847,6 +849,11 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	mm_init_cpumask(mm);
 	mm_init_aio(mm);
 	mm_init_owner(mm, p);
+	reclaim_class_update(mm, p->signal->oom_score_adj);
+	mm_wss_init(mm);
+#ifdef CONFIG_KSM
+	mm->ksm_merging_pages = 0;
+#endif
 	RCU_INIT_POINTER(mm->exe_file, NULL);
 	mmu_notifier_mm_init(mm);
 	hmm_mm_init(mm);
@@ -937,6 +944,7 @@ void __mmdrop(struct mm_struct *mm)
 	destroy_context(mm);
 	hmm_mm_destroy(mm);
 	mmu_notifier_mm_destroy(mm);
+	mm_wss_free(mm);
 	check_mm(mm);
 	put_user_ns(mm->user_ns);
 	free_mm(mm);
@@ -2100,6 +2108,8 @@ static __latent_entropy struct task_struct *copy_process(
 	syscall_tracepoint_update(p);
 	write_unlock_irq(&tasklist_lock);
 
+	/* The child can't exit before it first runs, so this can't race */
+	simple_lmk_task_add(p);
 	proc_fork_connector(p);
 	sched_post_fork(p);
 	cgroup_post_fork(p);
@@ -27,6 +27,10 @@
 #include <linux/notifier.h>
 #include <linux/suspend.h>
 #include <linux/slab.h>
+#include <linux/cpufreq.h>
+#include <linux/kernel_stat.h>
+#include <linux/mutex.h>
+#include <linux/sched/energy.h>
 
 /*
  * struct wakeup_irq_node - stores data and relationships for IRQs logged as
@@ -62,6 +66,37 @@ static ktime_t curr_monotime; /* monotonic time after last suspend */
 static ktime_t last_stime; /* monotonic boottime offset before last suspend */
 static ktime_t curr_stime; /* monotonic boottime offset after last suspend */
 
+/*
+ * struct resume_cost - what the resumes with one cause cost until the
+ * following suspend.
+ * @node     - on resume_costs
+ * @cause    - "<irq> <name>" of the first wakeup IRQ, or "-1 <reason>"
+ * @resumes  - number of resumes
+ * @awake_ns - boottime spent awake
+ * @max_ns   - longest single awake period
+ * @cpu_ns   - CPU busy time summed over all CPUs
+ * @energy   - CPU energy estimate from the energy model, in uJ
+ */
+struct resume_cost {
+	struct list_head node;
+	char cause[48];
+	u64 resumes;
+	u64 awake_ns;
+	u64 max_ns;
+	u64 cpu_ns;
+	u64 energy;
+};
+
+/* distinct causes beyond this are accounted to "-1 other" */
+#define MAX_RESUME_COSTS 64
+
+static DEFINE_MUTEX(resume_cost_lock);
+static LIST_HEAD(resume_costs);
+static unsigned int nr_resume_costs;
+static struct resume_cost *cur_cost;	/* cause of the current awake period */
+static ktime_t cur_cost_start;
+static DEFINE_PER_CPU(u64, cur_cost_busy);
+
 static void init_node(struct wakeup_irq_node *p, int irq)
 {
 	struct irq_desc *desc;
@@ -306,6 +341,184 @@ static ssize_t last_resume_reason_show(struct kobject *kobj,
 	return buf_offset;
 }
 
+static u64 cpu_busy_ns(int cpu)
+{
+	u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+	return cpustat[CPUTIME_USER] + cpustat[CPUTIME_NICE] +
+		cpustat[CPUTIME_SYSTEM] + cpustat[CPUTIME_IRQ] +
+		cpustat[CPUTIME_SOFTIRQ];
+}
+
+/* Busy power of @cpu at its current frequency, 0 without an energy model */
+static unsigned long cpu_busy_power(int cpu)
+{
+#ifdef CONFIG_GENERIC_ARCH_TOPOLOGY
+	struct sched_group_energy *sge = sge_array[cpu][SD_LEVEL0];
+	unsigned int freq = cpufreq_quick_get(cpu);
+	int i;
+
+	if (!sge || !sge->nr_cap_states)
+		return 0;
+
+	for (i = 0; i < sge->nr_cap_states - 1; i++)
+		if (sge->cap_states[i].frequency >= freq)
+			break;
+
+	return sge->cap_states[i].power;
+#else
+	return 0;
+#endif
+}
+
+static struct resume_cost *lookup_resume_cost(const char *cause)
+{
+	struct resume_cost *cost;
+
+	list_for_each_entry(cost, &resume_costs, node)
+		if (!strcmp(cost->cause, cause))
+			return cost;
+
+	return NULL;
+}
+
+static struct resume_cost *find_resume_cost(const char *cause)
+{
+	struct resume_cost *cost = lookup_resume_cost(cause);
+
+	if (cost)
+		return cost;
+
+	/* keep the last slot for everything else */
+	if (nr_resume_costs >= MAX_RESUME_COSTS - 1) {
+		cause = "-1 other";
+		cost = lookup_resume_cost(cause);
+		if (cost)
+			return cost;
+	}
+
+	cost = kzalloc(sizeof(*cost), GFP_KERNEL);
+	if (!cost)
+		return NULL;
+	strlcpy(cost->cause, cause, sizeof(cost->cause));
+	list_add_tail(&cost->node, &resume_costs);
+	nr_resume_costs++;
+
+	return cost;
+}
+
+/* Start charging the awake time from now to the cause of the last resume */
+static void resume_cost_start(void)
+{
+	struct wakeup_irq_node *n;
+	struct resume_cost *cost;
+	char cause[48];
+	unsigned long flags;
+	bool abort;
+	int cpu;
+
+	spin_lock_irqsave(&wakeup_reason_lock, flags);
+	abort = suspend_abort;
+	if (!list_empty(&leaf_irqs)) {
+		n = list_first_entry(&leaf_irqs, struct wakeup_irq_node,
+				     siblings);
+		snprintf(cause, sizeof(cause), "%d %s", n->irq, n->irq_name);
+	} else if (abnormal_wake) {
+		snprintf(cause, sizeof(cause), "-1 %s", non_irq_wake_reason);
+	} else {
+		strlcpy(cause, "-1 unknown", sizeof(cause));
+	}
+	spin_unlock_irqrestore(&wakeup_reason_lock, flags);
+
+	mutex_lock(&resume_cost_lock);
+	/* an aborted suspend keeps charging the previous cause */
+	if (!abort) {
+		cost = find_resume_cost(cause);
+		if (cost)
+			cost->resumes++;
+		cur_cost = cost;
+	}
+
+	cur_cost_start = ktime_get_boottime();
+	for_each_possible_cpu(cpu)
+		per_cpu(cur_cost_busy, cpu) = cpu_busy_ns(cpu);
+	mutex_unlock(&resume_cost_lock);
+}
+
+static void resume_cost_stop(void)
+{
+	struct resume_cost *cost;
+	u64 awake, busy;
+	int cpu;
+
+	mutex_lock(&resume_cost_lock);
+	cost = cur_cost;
+	if (!cost)
+		goto out;
+
+	awake = ktime_to_ns(ktime_sub(ktime_get_boottime(), cur_cost_start));
+	cost->awake_ns += awake;
+	if (awake > cost->max_ns)
+		cost->max_ns = awake;
+
+	for_each_possible_cpu(cpu) {
+		busy = cpu_busy_ns(cpu) - per_cpu(cur_cost_busy, cpu);
+		cost->cpu_ns += busy;
+		/* ns * mW / 10^6 = uJ */
+		cost->energy += div_u64(busy * cpu_busy_power(cpu),
+					NSEC_PER_MSEC);
+	}
+out:
+	mutex_unlock(&resume_cost_lock);
+}
+
+static ssize_t resume_cost_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	struct resume_cost *cost;
+	ssize_t len;
+
+	len = scnprintf(buf, PAGE_SIZE,
+			"cause resumes awake_ms max_awake_ms cpu_ms energy_uj\n");
+
+	mutex_lock(&resume_cost_lock);
+	list_for_each_entry(cost, &resume_costs, node)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%s %llu %llu %llu %llu %llu\n", cost->cause,
+				 cost->resumes,
+				 div_u64(cost->awake_ns, NSEC_PER_MSEC),
+				 div_u64(cost->max_ns, NSEC_PER_MSEC),
+				 div_u64(cost->cpu_ns, NSEC_PER_MSEC),
+				 cost->energy);
+	mutex_unlock(&resume_cost_lock);
+
+	return len;
+}
+
+/* Writing anything clears the table, the current period is kept */
+static ssize_t resume_cost_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct resume_cost *cost, *tmp;
+
+	mutex_lock(&resume_cost_lock);
+	list_for_each_entry_safe(cost, tmp, &resume_costs, node) {
+		if (cost == cur_cost) {
+			cost->resumes = 0;
+			cost->awake_ns = cost->max_ns = 0;
+			cost->cpu_ns = cost->energy = 0;
+			continue;
+		}
+		list_del(&cost->node);
+		kfree(cost);
+		nr_resume_costs--;
+	}
+	mutex_unlock(&resume_cost_lock);
+
+	return count;
+}
+
 static ssize_t last_suspend_time_show(struct kobject *kobj,
 			struct kobj_attribute *attr, char *buf)
 {
@@ -339,10 +552,12 @@ static ssize_t last_suspend_time_show(struct kobject *kobj,
 
 static struct kobj_attribute resume_reason = __ATTR_RO(last_resume_reason);
 static struct kobj_attribute suspend_time = __ATTR_RO(last_suspend_time);
+static struct kobj_attribute resume_cost = __ATTR_RW(resume_cost);
 
 static struct attribute *attrs[] = {
 	&resume_reason.attr,
 	&suspend_time.attr,
+	&resume_cost.attr,
 	NULL,
 };
 static struct attribute_group attr_group = {
@@ -355,6 +570,7 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 {
 	switch (pm_event) {
 	case PM_SUSPEND_PREPARE:
+		resume_cost_stop();
 		/* monotonic time since boot */
 		last_monotime = ktime_get();
 		/* monotonic time since boot including the time spent in suspend */
@@ -367,6 +583,7 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		/* monotonic time since boot including the time spent in suspend */
 		curr_stime = ktime_get_boottime();
 		print_wakeup_sources();
+		resume_cost_start();
 		break;
 	default:
 		break;
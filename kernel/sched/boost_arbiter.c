@@ -0,0 +1,423 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Boost arbiter
+ *
+ * Boost requests from drivers (cpu-boost, msm_performance, ...) used to
+ * poke sched boost, cpufreq policy limits, core_ctl and schedtune
+ * directly, so one client could cancel or silently override another and
+ * nothing tracked who owned a stale boost. Clients now register a named
+ * request per knob and update it with an optional timeout. The arbiter
+ * aggregates all active requests of a type, applies the winner to the
+ * underlying knob and drops requests once their timeout expires.
+ *
+ * All entry points may sleep.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+#include <linux/sched/boost_arbiter.h>
+#include <linux/sched/core_ctl.h>
+
+#include "sched.h"
+#include "walt.h"
+#include "tune.h"
+#include <trace/events/sched.h>
+
+static const char * const boost_req_type_names[BOOST_REQ_NR_TYPES] = {
+	[BOOST_REQ_CPU_MIN_FREQ]	= "cpu_min_freq",
+	[BOOST_REQ_SCHED_BOOST]		= "sched_boost",
+	[BOOST_REQ_CORE_CTL_MIN_CPUS]	= "core_ctl_min_cpus",
+	[BOOST_REQ_SCHEDTUNE]		= "schedtune",
+};
+
+struct boost_arb_state {
+	struct boost_req *winner;
+	int value;
+};
+
+static LIST_HEAD(boost_req_list);
+static DEFINE_MUTEX(boost_arb_mutex);
+
+/* Per-CPU types keep per-CPU state, global types use the CPU 0 slot */
+static DEFINE_PER_CPU(struct boost_arb_state [BOOST_REQ_NR_TYPES], arb_state);
+
+static void boost_arb_expire(struct work_struct *work);
+static DECLARE_DELAYED_WORK(boost_arb_expire_work, boost_arb_expire);
+
+static inline bool boost_type_per_cpu(enum boost_req_type type)
+{
+	return type == BOOST_REQ_CPU_MIN_FREQ ||
+	       type == BOOST_REQ_CORE_CTL_MIN_CPUS;
+}
+
+/*
+ * Does a request for @value win over the current winner @cur? Sched boost
+ * types are ordered by priority with FULL_THROTTLE_BOOST first, the same
+ * order sched_effective_boost() uses. Everything else is a floor.
+ */
+static inline bool boost_value_wins(enum boost_req_type type, int value,
+				    int cur)
+{
+	if (type == BOOST_REQ_SCHED_BOOST)
+		return value < cur;
+
+	return value > cur;
+}
+
+static bool boost_value_valid(enum boost_req_type type, int value)
+{
+	if (value < 0)
+		return false;
+
+	switch (type) {
+	case BOOST_REQ_SCHED_BOOST:
+		return value <= RESTRAINED_BOOST;
+	case BOOST_REQ_CORE_CTL_MIN_CPUS:
+		return value <= nr_cpu_ids;
+	case BOOST_REQ_SCHEDTUNE:
+		return value <= 100;
+	default:
+		return true;
+	}
+}
+
+static struct boost_req *boost_pick_winner(enum boost_req_type type, int cpu)
+{
+	struct boost_req *req, *winner = NULL;
+
+	list_for_each_entry(req, &boost_req_list, node) {
+		if (!req->active || req->type != type)
+			continue;
+		if (boost_type_per_cpu(type) && req->cpu >= 0 && req->cpu != cpu)
+			continue;
+		if (!winner || boost_value_wins(type, req->value, winner->value))
+			winner = req;
+	}
+
+	return winner;
+}
+
+static void boost_apply_min_freq(const struct cpumask *changed)
+{
+	struct cpufreq_policy *policy;
+	cpumask_var_t pending;
+	int cpu;
+
+	if (!zalloc_cpumask_var(&pending, GFP_KERNEL))
+		return;
+
+	cpumask_copy(pending, changed);
+
+	get_online_cpus();
+	for_each_cpu(cpu, pending) {
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+		cpumask_andnot(pending, pending, policy->related_cpus);
+		cpufreq_cpu_put(policy);
+
+		if (cpu_online(cpu))
+			cpufreq_update_policy(cpu);
+	}
+	put_online_cpus();
+
+	free_cpumask_var(pending);
+}
+
+static void boost_apply_global(enum boost_req_type type, int old, int new)
+{
+	switch (type) {
+	case BOOST_REQ_SCHED_BOOST:
+		/*
+		 * The arbiter holds a single reference on the winning type.
+		 * Take the new one before dropping the old one so that the
+		 * effective sched boost never falls through to NO_BOOST.
+		 */
+		if (new)
+			sched_set_boost(new);
+		if (old)
+			sched_set_boost(-old);
+		break;
+	case BOOST_REQ_SCHEDTUNE:
+		schedtune_set_boost_floor(new);
+		break;
+	default:
+		break;
+	}
+}
+
+static void boost_arb_eval(enum boost_req_type type)
+{
+	struct boost_arb_state *st;
+	struct boost_req *winner;
+	cpumask_t changed;
+	int cpu, old;
+
+	lockdep_assert_held(&boost_arb_mutex);
+
+	if (!boost_type_per_cpu(type)) {
+		st = &per_cpu(arb_state, 0)[type];
+		winner = boost_pick_winner(type, 0);
+		old = st->value;
+		st->winner = winner;
+		st->value = winner ? winner->value : 0;
+		if (old != st->value) {
+			boost_apply_global(type, old, st->value);
+			trace_boost_arb_winner(type, -1,
+					winner ? winner->name : "none",
+					st->value);
+		}
+		return;
+	}
+
+	cpumask_clear(&changed);
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(arb_state, cpu)[type];
+		winner = boost_pick_winner(type, cpu);
+		old = st->value;
+		st->winner = winner;
+		st->value = winner ? winner->value : 0;
+		if (old == st->value)
+			continue;
+
+		cpumask_set_cpu(cpu, &changed);
+		if (type == BOOST_REQ_CORE_CTL_MIN_CPUS)
+			core_ctl_set_boost_min_cpus(cpu, st->value);
+		trace_boost_arb_winner(type, cpu,
+				winner ? winner->name : "none", st->value);
+	}
+
+	if (type == BOOST_REQ_CPU_MIN_FREQ && !cpumask_empty(&changed))
+		boost_apply_min_freq(&changed);
+}
+
+static void boost_arb_rearm(void)
+{
+	struct boost_req *req;
+	unsigned long next = 0;
+
+	lockdep_assert_held(&boost_arb_mutex);
+
+	list_for_each_entry(req, &boost_req_list, node) {
+		if (!req->active || !req->expires)
+			continue;
+		if (!next || time_before(req->expires, next))
+			next = req->expires;
+	}
+
+	if (!next) {
+		cancel_delayed_work(&boost_arb_expire_work);
+		return;
+	}
+
+	mod_delayed_work(system_power_efficient_wq, &boost_arb_expire_work,
+			 time_after(next, jiffies) ? next - jiffies : 0);
+}
+
+static void boost_arb_expire(struct work_struct *work)
+{
+	struct boost_req *req;
+	unsigned long now = jiffies;
+	unsigned int dirty = 0;
+	int type;
+
+	mutex_lock(&boost_arb_mutex);
+	list_for_each_entry(req, &boost_req_list, node) {
+		if (!req->active || !req->expires)
+			continue;
+		if (time_before(now, req->expires))
+			continue;
+
+		req->active = false;
+		req->value = 0;
+		req->expires = 0;
+		dirty |= BIT(req->type);
+		trace_boost_arb_request(req->name, req->type, req->cpu, 0, 0);
+	}
+
+	for (type = 0; type < BOOST_REQ_NR_TYPES; type++)
+		if (dirty & BIT(type))
+			boost_arb_eval(type);
+
+	boost_arb_rearm();
+	mutex_unlock(&boost_arb_mutex);
+}
+
+/**
+ * boost_req_add - register a boost request with the arbiter
+ * @req:	caller owned request, must stay valid until boost_req_remove()
+ * @name:	requester name shown in debugfs and traces
+ * @type:	boost knob this request applies to
+ * @cpu:	target CPU for per-CPU knobs, -1 for all CPUs
+ *
+ * The request starts out inactive.
+ */
+int boost_req_add(struct boost_req *req, const char *name,
+		  enum boost_req_type type, int cpu)
+{
+	if (!req || !name || type >= BOOST_REQ_NR_TYPES)
+		return -EINVAL;
+
+	if (cpu >= 0 && (!boost_type_per_cpu(type) || !cpu_possible(cpu)))
+		return -EINVAL;
+
+	req->name = name;
+	req->type = type;
+	req->cpu = cpu < 0 ? -1 : cpu;
+	req->value = 0;
+	req->expires = 0;
+	req->active = false;
+
+	mutex_lock(&boost_arb_mutex);
+	list_add_tail(&req->node, &boost_req_list);
+	mutex_unlock(&boost_arb_mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(boost_req_add);
+
+/**
+ * boost_req_update - change the value of a registered boost request
+ * @req:	request registered through boost_req_add()
+ * @value:	new value, 0 releases the request
+ * @timeout_ms:	drop the request after this many milliseconds, 0 for never
+ */
+int boost_req_update(struct boost_req *req, int value,
+		     unsigned int timeout_ms)
+{
+	if (!req || !req->name || !boost_value_valid(req->type, value))
+		return -EINVAL;
+
+	mutex_lock(&boost_arb_mutex);
+	req->value = value;
+	req->active = !!value;
+	req->expires = (value && timeout_ms) ?
+			jiffies + msecs_to_jiffies(timeout_ms) : 0;
+	trace_boost_arb_request(req->name, req->type, req->cpu, value,
+				timeout_ms);
+
+	boost_arb_eval(req->type);
+	boost_arb_rearm();
+	mutex_unlock(&boost_arb_mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(boost_req_update);
+
+/**
+ * boost_req_remove - release and unregister a boost request
+ * @req:	request registered through boost_req_add()
+ */
+void boost_req_remove(struct boost_req *req)
+{
+	bool active;
+
+	if (!req || !req->name)
+		return;
+
+	mutex_lock(&boost_arb_mutex);
+	active = req->active;
+	list_del(&req->node);
+	req->active = false;
+	req->value = 0;
+	if (active) {
+		boost_arb_eval(req->type);
+		boost_arb_rearm();
+	}
+	mutex_unlock(&boost_arb_mutex);
+}
+EXPORT_SYMBOL_GPL(boost_req_remove);
+
+static int boost_adjust_notify(struct notifier_block *nb, unsigned long val,
+			       void *data)
+{
+	struct cpufreq_policy *policy = data;
+	struct boost_arb_state *st;
+	unsigned int min_freq = 0;
+	int cpu;
+
+	if (val != CPUFREQ_ADJUST)
+		return NOTIFY_OK;
+
+	for_each_cpu(cpu, policy->related_cpus) {
+		st = &per_cpu(arb_state, cpu)[BOOST_REQ_CPU_MIN_FREQ];
+		min_freq = max_t(unsigned int, min_freq, READ_ONCE(st->value));
+	}
+
+	if (min_freq)
+		cpufreq_verify_within_limits(policy,
+				min(min_freq, policy->max), UINT_MAX);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block boost_adjust_nb = {
+	.notifier_call = boost_adjust_notify,
+};
+
+static int boost_arb_show(struct seq_file *m, void *v)
+{
+	struct boost_arb_state *st;
+	struct boost_req *req;
+	int type, cpu;
+
+	mutex_lock(&boost_arb_mutex);
+
+	seq_puts(m, "effective:\n");
+	for (type = 0; type < BOOST_REQ_NR_TYPES; type++) {
+		for_each_possible_cpu(cpu) {
+			st = &per_cpu(arb_state, cpu)[type];
+			seq_printf(m, "  %-18s ", boost_req_type_names[type]);
+			if (boost_type_per_cpu(type))
+				seq_printf(m, "cpu%-3d", cpu);
+			else
+				seq_puts(m, "all   ");
+			seq_printf(m, " value=%d winner=%s\n", st->value,
+				   st->winner ? st->winner->name : "none");
+			if (!boost_type_per_cpu(type))
+				break;
+		}
+	}
+
+	seq_puts(m, "requests:\n");
+	list_for_each_entry(req, &boost_req_list, node) {
+		seq_printf(m, "  %-24s %-18s cpu=%d value=%d", req->name,
+			   boost_req_type_names[req->type], req->cpu, req->value);
+		if (req->active && req->expires)
+			seq_printf(m, " remaining_ms=%u",
+				   time_after(req->expires, jiffies) ?
+				   jiffies_to_msecs(req->expires - jiffies) : 0);
+		seq_printf(m, " %s\n", req->active ? "active" : "idle");
+	}
+
+	mutex_unlock(&boost_arb_mutex);
+
+	return 0;
+}
+
+static int boost_arb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boost_arb_show, NULL);
+}
+
+static const struct file_operations boost_arb_fops = {
+	.open		= boost_arb_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init boost_arbiter_init(void)
+{
+	cpufreq_register_notifier(&boost_adjust_nb, CPUFREQ_POLICY_NOTIFIER);
+	debugfs_create_file("boost_arbiter", 0444, NULL, NULL,
+			    &boost_arb_fops);
+
+	return 0;
+}
+late_initcall(boost_arbiter_init);
@@ -3003,6 +3003,9 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->se.nr_migrations		= 0;
 	p->se.vruntime			= 0;
 	p->last_sleep_ts		= 0;
+#ifdef CONFIG_SMP
+	p->wake_cache_cpu		= -1;
+#endif
 	p->boost                = 0;
 	p->boost_expires        = 0;
 	p->boost_period         = 0;
@@ -22,6 +22,7 @@
 #include <linux/syscore_ops.h>
 #include <uapi/linux/sched/types.h>
 #include <linux/sched/core_ctl.h>
+#include <linux/sched/energy.h>
 
 #include <trace/events/sched.h>
 #include "sched.h"
@@ -56,6 +57,9 @@ struct cluster_data {
 	struct task_struct *core_ctl_thread;
 	unsigned int first_cpu;
 	unsigned int boost;
+	unsigned int boost_min_cpus;
+	bool energy_aware;
+	unsigned int energy_margin_pct;
 	struct kobject kobj;
 };
 
@@ -67,6 +71,7 @@ struct cpu_data {
 	struct cluster_data *cluster;
 	struct list_head sib;
 	bool isolated_by_us;
+	unsigned int boost_min_cpus;
 };
 
 static DEFINE_PER_CPU(struct cpu_data, cpu_state);
@@ -287,6 +292,52 @@ static ssize_t show_enable(const struct cluster_data *state, char *buf)
 	return scnprintf(buf, PAGE_SIZE, "%u\n", state->enable);
 }
 
+static ssize_t store_energy_aware(struct cluster_data *state,
+				  const char *buf, size_t count)
+{
+	unsigned int val;
+	bool bval;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	bval = !!val;
+	if (bval != state->energy_aware) {
+		state->energy_aware = bval;
+		apply_need(state);
+	}
+
+	return count;
+}
+
+static ssize_t show_energy_aware(const struct cluster_data *state, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", state->energy_aware);
+}
+
+static ssize_t store_energy_margin_pct(struct cluster_data *state,
+				       const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	if (val >= 100)
+		return -EINVAL;
+
+	state->energy_margin_pct = val;
+	apply_need(state);
+
+	return count;
+}
+
+static ssize_t show_energy_margin_pct(const struct cluster_data *state,
+				      char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", state->energy_margin_pct);
+}
+
 static ssize_t show_need_cpus(const struct cluster_data *state, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%u\n", state->need_cpus);
@@ -342,6 +393,9 @@ static ssize_t show_global_state(const struct cluster_data *state, char *buf)
 						cluster->nr_isolated_cpus);
 		count += snprintf(buf + count, PAGE_SIZE - count,
 				"\tBoost: %u\n", (unsigned int) cluster->boost);
+		count += snprintf(buf + count, PAGE_SIZE - count,
+				"\tBoost min CPUs: %u\n",
+						cluster->boost_min_cpus);
 	}
 	spin_unlock_irq(&state_lock);
 
@@ -421,6 +475,8 @@ core_ctl_attr_ro(active_cpus);
 core_ctl_attr_ro(global_state);
 core_ctl_attr_rw(not_preferred);
 core_ctl_attr_rw(enable);
+core_ctl_attr_rw(energy_aware);
+core_ctl_attr_rw(energy_margin_pct);
 
 static struct attribute *default_attrs[] = {
 	&min_cpus.attr,
@@ -431,6 +487,8 @@ static struct attribute *default_attrs[] = {
 	&task_thres.attr,
 	&nr_prev_assist_thresh.attr,
 	&enable.attr,
+	&energy_aware.attr,
+	&energy_margin_pct.attr,
 	&need_cpus.attr,
 	&active_cpus.attr,
 	&global_state.attr,
@@ -699,12 +757,100 @@ static unsigned int apply_task_need(const struct cluster_data *cluster,
 	return new_need;
 }
 
+/* ===================== energy based core count  ===================== */
+
+/*
+ * Modelled energy cost of running @util (in capacity units) spread evenly
+ * over @nr_cpus CPUs of @cluster, with the remaining CPUs isolated in
+ * their deepest idle state. The OPP is the lowest one that covers the
+ * per-CPU utilization with the same margin schedutil applies. Returns
+ * ULONG_MAX when @util does not fit on @nr_cpus CPUs.
+ */
+static unsigned long cluster_energy_cost(const struct cluster_data *cluster,
+					 unsigned long util,
+					 unsigned int nr_cpus)
+{
+	struct sched_group_energy *sge;
+	const struct capacity_state *cs;
+	unsigned long cpu_util, cap_req, busy, idle, deep;
+	int idx;
+
+	sge = sge_array[cluster->first_cpu][SD_LEVEL0];
+	if (!nr_cpus || !sge || !sge->nr_cap_states || !sge->nr_idle_states)
+		return ULONG_MAX;
+
+	cpu_util = DIV_ROUND_UP(util, nr_cpus);
+	cap_req = cpu_util * capacity_margin_freq >> SCHED_CAPACITY_SHIFT;
+	if (cap_req > sge->cap_states[sge->nr_cap_states - 1].cap)
+		return ULONG_MAX;
+
+	for (idx = 0; idx < sge->nr_cap_states - 1; idx++)
+		if (sge->cap_states[idx].cap >= cap_req)
+			break;
+	cs = &sge->cap_states[idx];
+
+	busy = cs->power * cpu_util / cs->cap;
+	idle = sge->idle_states[0].power * (cs->cap - cpu_util) / cs->cap;
+	deep = sge->idle_states[sge->nr_idle_states - 1].power;
+
+	return nr_cpus * (busy + idle) + (cluster->num_cpus - nr_cpus) * deep;
+}
+
+/*
+ * Refine the heuristic CPU need of @cluster with the energy model. CPUs
+ * are taken away one at a time while packing the current demand on one
+ * CPU less is modelled to be cheaper by more than energy_margin_pct, and
+ * added while spreading it over one more CPU is. The margin provides the
+ * hysteresis that keeps the decision from flip-flopping between windows.
+ */
+static unsigned int apply_energy_need(const struct cluster_data *cluster,
+				      unsigned int need)
+{
+	unsigned long util = 0, cost, alt;
+	unsigned int new_need = need;
+	unsigned int margin = 100 - cluster->energy_margin_pct;
+	int cpu;
+
+	for_each_cpu(cpu, &cluster->cpu_mask)
+		util += per_cpu(cpu_state, cpu).busy *
+			capacity_orig_of(cpu) / 100;
+
+	cost = cluster_energy_cost(cluster, util, new_need);
+	if (cost == ULONG_MAX)
+		goto out;
+
+	while (new_need > 1) {
+		alt = cluster_energy_cost(cluster, util, new_need - 1);
+		if (alt == ULONG_MAX || alt * 100 >= cost * margin)
+			break;
+		new_need--;
+		cost = alt;
+	}
+
+	if (new_need == need) {
+		while (new_need < cluster->num_cpus) {
+			alt = cluster_energy_cost(cluster, util, new_need + 1);
+			if (alt * 100 >= cost * margin)
+				break;
+			new_need++;
+			cost = alt;
+		}
+	}
+
+out:
+	trace_core_ctl_energy_need(cluster->first_cpu, util, need, new_need,
+				   cost == ULONG_MAX ? 0 : cost);
+	return new_need;
+}
+
 /* ======================= load based core count  ====================== */
 
 static unsigned int apply_limits(const struct cluster_data *cluster,
 				 unsigned int need_cpus)
 {
-	return min(max(cluster->min_cpus, need_cpus), cluster->max_cpus);
+	unsigned int min_cpus = max(cluster->min_cpus, cluster->boost_min_cpus);
+
+	return min(max(min_cpus, need_cpus), cluster->max_cpus);
 }
 
 static unsigned int get_active_cpu_count(const struct cluster_data *cluster)
@@ -759,6 +905,8 @@ static bool eval_need(struct cluster_data *cluster)
 			need_cpus += c->is_busy;
 		}
 		need_cpus = apply_task_need(cluster, need_cpus);
+		if (cluster->energy_aware)
+			need_cpus = apply_energy_need(cluster, need_cpus);
 	}
 	new_need = apply_limits(cluster, need_cpus);
 	need_flag = adjustment_possible(cluster, new_need);
@@ -857,6 +1005,42 @@ int core_ctl_set_boost(bool boost)
 }
 EXPORT_SYMBOL(core_ctl_set_boost);
 
+/*
+ * Raise the minimum number of active CPUs in @cpu's cluster to @min_cpus
+ * on behalf of @cpu. The cluster honours the largest floor set by any of
+ * its CPUs; the user space max_cpus limit still takes precedence.
+ */
+int core_ctl_set_boost_min_cpus(unsigned int cpu, unsigned int min_cpus)
+{
+	struct cpu_data *state;
+	struct cluster_data *cluster;
+	unsigned long flags;
+	unsigned int old, new = 0;
+	int i;
+
+	if (unlikely(!initialized))
+		return 0;
+
+	state = &per_cpu(cpu_state, cpu);
+	cluster = state->cluster;
+	if (!cluster || !cluster->inited)
+		return -ENODEV;
+
+	spin_lock_irqsave(&state_lock, flags);
+	state->boost_min_cpus = min(min_cpus, cluster->num_cpus);
+	for_each_cpu(i, &cluster->cpu_mask)
+		new = max(new, per_cpu(cpu_state, i).boost_min_cpus);
+	old = cluster->boost_min_cpus;
+	cluster->boost_min_cpus = new;
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	if (old != new)
+		wake_up_core_ctl_thread(cluster);
+
+	return 0;
+}
+EXPORT_SYMBOL(core_ctl_set_boost_min_cpus);
+
 void core_ctl_notifier_register(struct notifier_block *n)
 {
 	atomic_notifier_chain_register(&core_ctl_notifier, n);
@@ -896,6 +1080,10 @@ void core_ctl_check(u64 window_start)
 	struct cluster_data *cluster;
 	unsigned int index = 0;
 	unsigned long flags;
+#ifdef CONFIG_SCHED_WALT
+	u64 loads[MAX_CPUS_PER_CLUSTER];
+	int i;
+#endif
 
 	if (unlikely(!initialized))
 		return;
@@ -906,18 +1094,37 @@ void core_ctl_check(u64 window_start)
 	core_ctl_check_timestamp = window_start;
 
 	spin_lock_irqsave(&state_lock, flags);
-	for_each_possible_cpu(cpu) {
-
-		c = &per_cpu(cpu_state, cpu);
-		cluster = c->cluster;
+	for_each_cluster(cluster, index) {
+		if (!cluster->inited)
+			continue;
 
-		if (!cluster || !cluster->inited)
+		/*
+		 * Read the whole cluster from the published window snapshots
+		 * so that the busy values belong to the same window and no
+		 * rq lock has to be taken here.
+		 */
+#ifdef CONFIG_SCHED_WALT
+		if (!walt_disabled && sysctl_sched_use_walt_cpu_util) {
+			walt_get_cluster_prev_load(&cluster->cpu_mask, loads);
+			i = 0;
+			for_each_cpu(cpu, &cluster->cpu_mask) {
+				c = &per_cpu(cpu_state, cpu);
+				c->busy = sched_walt_load_to_util_pct(cpu,
+								loads[i++]);
+			}
 			continue;
+		}
+#endif
 
-		c->busy = sched_get_cpu_util(cpu);
+		for_each_cpu(cpu, &cluster->cpu_mask) {
+			c = &per_cpu(cpu_state, cpu);
+			c->busy = sched_get_cpu_util(cpu);
+		}
 	}
 	spin_unlock_irqrestore(&state_lock, flags);
 
+	index = 0;
+
 	update_running_avg();
 
 	for_each_cluster(cluster, index) {
@@ -1253,6 +1460,7 @@ static int cluster_init(const struct cpumask *mask)
 	cluster->offline_delay_ms = 100;
 	cluster->task_thres = UINT_MAX;
 	cluster->nr_prev_assist_thresh = UINT_MAX;
+	cluster->energy_margin_pct = 10;
 	cluster->nrrun = cluster->num_cpus;
 	cluster->enable = true;
 	cluster->nr_not_preferred_cpus = 0;
@@ -28,6 +28,7 @@ struct sugov_tunables {
 	unsigned int hispeed_load;
 	unsigned int hispeed_freq;
 	bool pl;
+	unsigned int lookahead_pct;
 };
 
 struct sugov_policy {
@@ -60,6 +61,11 @@ struct sugov_policy {
 	bool work_in_progress;
 
 	bool need_freq_update;
+
+	/* inputs of the decision in progress, for sched_freq_trace() */
+	unsigned long trace_util;
+	unsigned long trace_max;
+	u16 trace_reason;
 };
 
 struct sugov_cpu {
@@ -87,6 +93,17 @@ struct sugov_cpu {
 
 static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
 static unsigned int stale_ns;
+
+/*
+ * Short-lived frequency floor requested from atomic context, e.g. by the
+ * input boost handler, without waiting for a policy update.
+ */
+struct sugov_floor {
+	unsigned int freq;
+	u64 expires;
+};
+
+static DEFINE_PER_CPU(struct sugov_floor, sugov_floor);
 static DEFINE_PER_CPU(struct sugov_tunables *, cached_tunables);
 
 /************************ Governor internals ***********************/
@@ -226,21 +243,43 @@ static void sugov_calc_avg_cap(struct sugov_policy *sg_policy, u64 curr_ws,
 	sg_policy->last_ws = curr_ws;
 }
 
+static void sugov_trace_decision(struct sugov_policy *sg_policy,
+				 unsigned int next_freq, u16 reason)
+{
+	reason |= sg_policy->trace_reason;
+	if (sched_boost() != NO_BOOST)
+		reason |= SCHED_FREQ_R_SCHED_BOOST;
+
+	sched_freq_trace(SCHED_FREQ_EV_DECISION, sg_policy->policy->cpu,
+			 next_freq, sg_policy->trace_util,
+			 sg_policy->trace_max, reason);
+	sg_policy->trace_reason = 0;
+	sg_policy->trace_util = 0;
+	sg_policy->trace_max = 0;
+}
+
 static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
 				unsigned int next_freq)
 {
 	struct cpufreq_policy *policy = sg_policy->policy;
 	unsigned int cpu;
 
-	if (sg_policy->next_freq == next_freq)
+	if (sg_policy->next_freq == next_freq) {
+		sugov_trace_decision(sg_policy, next_freq,
+				     SCHED_FREQ_R_UNCHANGED);
 		return;
+	}
 
 	if (sugov_up_down_rate_limit(sg_policy, time, next_freq)) {
 		/* Don't cache a raw freq that didn't become next_freq */
 		sg_policy->cached_raw_freq = 0;
+		sugov_trace_decision(sg_policy, next_freq,
+				     SCHED_FREQ_R_RATE_LIMIT);
 		return;
 	}
 
+	sugov_trace_decision(sg_policy, next_freq, 0);
+
 	sg_policy->next_freq = next_freq;
 	sg_policy->last_freq_update_time = time;
 
@@ -284,15 +323,66 @@ static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
  * next_freq (as calculated above) is returned, subject to policy min/max and
  * cpufreq driver limitations.
  */
+/**
+ * sched_set_cpufreq_floor - request a minimum frequency for a CPU
+ * @cpu: CPU whose policy should run at least at @freq
+ * @freq: frequency floor in kHz, 0 to drop the request
+ * @duration_us: lifetime of the request
+ *
+ * Safe to call from any context. The floor is applied by schedutil at
+ * the next utilization update of the policy @cpu belongs to, and is
+ * still clamped to the policy limits.
+ */
+void sched_set_cpufreq_floor(int cpu, unsigned int freq,
+			     unsigned int duration_us)
+{
+	struct sugov_floor *floor = &per_cpu(sugov_floor, cpu);
+
+	WRITE_ONCE(floor->expires,
+		   ktime_get_ns() + (u64)duration_us * NSEC_PER_USEC);
+	WRITE_ONCE(floor->freq, freq);
+}
+
+static unsigned int sugov_floor_freq(struct sugov_policy *sg_policy)
+{
+	unsigned int floor = 0, freq;
+	u64 now = 0;
+	int cpu;
+
+	for_each_cpu(cpu, sg_policy->policy->cpus) {
+		struct sugov_floor *f = &per_cpu(sugov_floor, cpu);
+
+		freq = READ_ONCE(f->freq);
+		if (!freq)
+			continue;
+
+		if (!now)
+			now = ktime_get_ns();
+		if (now < READ_ONCE(f->expires))
+			floor = max(floor, freq);
+	}
+
+	return floor;
+}
+
 static unsigned int get_next_freq(struct sugov_policy *sg_policy,
 				  unsigned long util, unsigned long max)
 {
 	struct cpufreq_policy *policy = sg_policy->policy;
 	unsigned int freq = arch_scale_freq_invariant() ?
 				policy->cpuinfo.max_freq : policy->cur;
+	unsigned int floor;
 
 	freq = (freq + (freq >> 2)) * util / max;
 	trace_sugov_next_freq(policy->cpu, util, max, freq);
+	sg_policy->trace_util = util;
+	sg_policy->trace_max = max;
+
+	floor = sugov_floor_freq(sg_policy);
+	if (floor > freq) {
+		freq = floor;
+		sg_policy->trace_reason |= SCHED_FREQ_R_FLOOR;
+	}
 
 	if (freq == sg_policy->cached_raw_freq && sg_policy->next_freq != UINT_MAX)
 		return sg_policy->next_freq;
@@ -375,6 +465,7 @@ static void sugov_iowait_boost(struct sugov_cpu *sg_cpu, unsigned long *util,
 	if (*util * boost_max < *max * boost_util) {
 		*util = boost_util;
 		*max = boost_max;
+		sg_cpu->sg_policy->trace_reason |= SCHED_FREQ_R_IOWAIT;
 	}
 }
 
@@ -402,6 +493,8 @@ static void sugov_walt_adjust(struct sugov_cpu *sg_cpu, unsigned long *util,
 	unsigned long cpu_util = sg_cpu->util;
 	bool is_hiload;
 	unsigned long pl = sg_cpu->walt_load.pl;
+	unsigned int lookahead_pct = sg_policy->tunables->lookahead_pct;
+	unsigned long la_util;
 
 	if (unlikely(!sysctl_sched_use_walt_cpu_util))
 		return;
@@ -410,16 +503,34 @@ static void sugov_walt_adjust(struct sugov_cpu *sg_cpu, unsigned long *util,
 					   sg_policy->tunables->hispeed_load,
 					   100));
 
-	if (is_hiload && !is_migration)
-		*util = max(*util, sg_policy->hispeed_util);
+	/*
+	 * With lookahead enabled the predicted load distribution of the
+	 * runnable tasks replaces the blind jump to hispeed_freq.
+	 */
+	if (lookahead_pct) {
+		la_util = walt_pred_lookahead(sg_cpu->cpu, lookahead_pct);
+		if (la_util > *util) {
+			*util = la_util;
+			sg_policy->trace_reason |= SCHED_FREQ_R_LOOKAHEAD;
+		}
+	} else if (is_hiload && !is_migration &&
+		   sg_policy->hispeed_util > *util) {
+		*util = sg_policy->hispeed_util;
+		sg_policy->trace_reason |= SCHED_FREQ_R_HISPEED;
+	}
 
-	if (is_hiload && nl >= mult_frac(cpu_util, NL_RATIO, 100))
+	if (is_hiload && nl >= mult_frac(cpu_util, NL_RATIO, 100)) {
 		*util = *max;
+		sg_policy->trace_reason |= SCHED_FREQ_R_NL;
+	}
 
 	if (sg_policy->tunables->pl) {
 		if (conservative_pl())
 			pl = mult_frac(pl, TARGET_LOAD, 100);
-		*util = max(*util, pl);
+		if (pl > *util) {
+			*util = pl;
+			sg_policy->trace_reason |= SCHED_FREQ_R_PL;
+		}
 	}
 }
 
@@ -451,6 +562,7 @@ static void sugov_update_single(struct update_util_data *hook, u64 time,
 		/* clear cache when it's bypassed */
 		sg_policy->cached_raw_freq = 0;
 		next_f = policy->cpuinfo.max_freq;
+		sg_policy->trace_reason |= SCHED_FREQ_R_DL;
 	} else {
 		sugov_get_util(&util, &max, sg_cpu->cpu, time);
 		if (sg_policy->max != max) {
@@ -481,6 +593,7 @@ static void sugov_update_single(struct update_util_data *hook, u64 time,
 		if (busy && next_f < sg_policy->next_freq &&
 		    sg_policy->next_freq != UINT_MAX) {
 			next_f = sg_policy->next_freq;
+			sg_policy->trace_reason |= SCHED_FREQ_R_BUSY;
 
 			/* Reset cached freq as next_freq has changed */
 			sg_policy->cached_raw_freq = 0;
@@ -518,6 +631,7 @@ static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time)
 		if (j_sg_cpu->flags & SCHED_CPUFREQ_DL) {
 			/* clear cache when it's bypassed */
 			sg_policy->cached_raw_freq = 0;
+			sg_policy->trace_reason |= SCHED_FREQ_R_DL;
 			return policy->cpuinfo.max_freq;
 		}
 
@@ -587,6 +701,7 @@ static void sugov_update_shared(struct update_util_data *hook, u64 time,
 			next_f = sg_policy->policy->cpuinfo.max_freq;
 			/* clear cache when it's bypassed */
 			sg_policy->cached_raw_freq = 0;
+			sg_policy->trace_reason |= SCHED_FREQ_R_DL;
 		} else {
 			next_f = sugov_next_freq_shared(sg_cpu, time);
 		}
@@ -781,11 +896,32 @@ static ssize_t pl_store(struct gov_attr_set *attr_set, const char *buf,
 	return count;
 }
 
+static ssize_t lookahead_pct_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", tunables->lookahead_pct);
+}
+
+static ssize_t lookahead_pct_store(struct gov_attr_set *attr_set,
+				   const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	if (kstrtouint(buf, 10, &tunables->lookahead_pct))
+		return -EINVAL;
+
+	tunables->lookahead_pct = min(100U, tunables->lookahead_pct);
+
+	return count;
+}
+
 static struct governor_attr up_rate_limit_us = __ATTR_RW(up_rate_limit_us);
 static struct governor_attr down_rate_limit_us = __ATTR_RW(down_rate_limit_us);
 static struct governor_attr hispeed_load = __ATTR_RW(hispeed_load);
 static struct governor_attr hispeed_freq = __ATTR_RW(hispeed_freq);
 static struct governor_attr pl = __ATTR_RW(pl);
+static struct governor_attr lookahead_pct = __ATTR_RW(lookahead_pct);
 
 static struct attribute *sugov_attributes[] = {
 	&up_rate_limit_us.attr,
@@ -793,6 +929,7 @@ static struct attribute *sugov_attributes[] = {
 	&hispeed_load.attr,
 	&hispeed_freq.attr,
 	&pl.attr,
+	&lookahead_pct.attr,
 	NULL
 };
 
@@ -908,6 +1045,7 @@ static void sugov_tunables_save(struct cpufreq_policy *policy,
 	}
 
 	cached->pl = tunables->pl;
+	cached->lookahead_pct = tunables->lookahead_pct;
 	cached->hispeed_load = tunables->hispeed_load;
 	cached->hispeed_freq = tunables->hispeed_freq;
 	cached->up_rate_limit_us = tunables->up_rate_limit_us;
@@ -932,6 +1070,7 @@ static void sugov_tunables_restore(struct cpufreq_policy *policy)
 		return;
 
 	tunables->pl = cached->pl;
+	tunables->lookahead_pct = cached->lookahead_pct;
 	tunables->hispeed_load = cached->hispeed_load;
 	tunables->hispeed_freq = cached->hispeed_freq;
 	tunables->up_rate_limit_us = cached->up_rate_limit_us;
@@ -782,8 +782,15 @@ do {									\
 		P(sched_goidle);
 		P(ttwu_count);
 		P(ttwu_local);
+		P(eas_count);
+		P(eas_fastpath);
 	}
 #undef P
+#define P64(n) SEQ_printf(m, "  .%-30s: %Ld\n", #n, \
+			  (long long)schedstat_val(rq->n));
+	if (schedstat_enabled())
+		P64(eas_time);
+#undef P64
 
 	spin_lock_irqsave(&sched_debug_lock, flags);
 	print_cfs_stats(m, cpu);
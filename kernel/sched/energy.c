@@ -45,6 +45,7 @@ static void free_resources(void)
 			if (sge) {
 				kfree(sge->cap_states);
 				kfree(sge->idle_states);
+				kfree(sge->cap_idx_lut);
 				kfree(sge);
 			}
 		}
@@ -52,6 +53,37 @@ static void free_resources(void)
 }
 static bool sge_ready;
 
+/*
+ * Map utilization buckets to the first capacity state that can serve them,
+ * so that wakeup energy estimation does not scan the capacity states. The
+ * capacities are only updated at probe, when the OPP table is known.
+ */
+static void sched_energy_build_lut(struct sched_group_energy *sge)
+{
+	unsigned short *lut, *old;
+	unsigned long util;
+	int i, idx = 0;
+
+	lut = kcalloc(SGE_LUT_SIZE, sizeof(*lut), GFP_KERNEL);
+	if (!lut)
+		return;
+
+	for (i = 0; i < SGE_LUT_SIZE; i++) {
+		util = (unsigned long)i << SGE_LUT_SHIFT;
+		while (idx < sge->nr_cap_states - 1 &&
+		       sge->cap_states[idx].cap < util)
+			idx++;
+		lut[i] = idx;
+	}
+
+	old = sge->cap_idx_lut;
+	smp_store_release(&sge->cap_idx_lut, lut);
+	if (old) {
+		synchronize_rcu();
+		kfree(old);
+	}
+}
+
 void check_max_cap_vs_cpu_scale(int cpu, struct sched_group_energy *sge)
 {
 	unsigned long max_cap, cpu_scale;
@@ -237,7 +269,7 @@ static int sched_energy_probe(struct platform_device *pdev)
 		 */
 		sge_l0 = sge_array[cpu][SD_LEVEL0];
 		if (sge_l0 && sge_l0->nr_cap_states > 0) {
-			int i;
+			int i, level;
 			int ncapstates = sge_l0->nr_cap_states;
 
 			for (i = 0; i < ncapstates; i++) {
@@ -278,6 +310,13 @@ static int sched_energy_probe(struct platform_device *pdev)
 				sge_l0->cap_states[ncapstates - 1].cap,
 				sge_l0->cap_states[ncapstates - 1].power
 				);
+
+			for_each_possible_sd_level(level) {
+				sge = sge_array[cpu][level];
+				if (!sge)
+					break;
+				sched_energy_build_lut(sge);
+			}
 		}
 
 
@@ -96,6 +96,14 @@ unsigned int normalized_sysctl_sched_latency		= 6000000ULL;
  * Enable/disable honoring sync flag in energy-aware wakeups.
  */
 unsigned int sysctl_sched_sync_hint_enable = 1;
+/*
+ * Reuse the last energy aware placement of a task woken again within
+ * sysctl_sched_wake_cache_ns, as long as its utilization and the one of
+ * the chosen CPU moved by less than sysctl_sched_wake_cache_util.
+ * 0 ns disables the cache.
+ */
+unsigned int sysctl_sched_wake_cache_ns = 2000000;
+unsigned int sysctl_sched_wake_cache_util = 32;
 /*
  * Enable/disable using cstate knowledge in idle sibling selection
  */
@@ -5345,6 +5353,14 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 #ifdef CONFIG_SCHED_WALT
 	p->misfit = !task_fits_max(p, rq->cpu);
+	if (p->misfit) {
+		if (!p->misfit_start)
+			p->misfit_start = sched_ktime_clock();
+	} else if (p->misfit_start) {
+		trace_sched_misfit_duration(p, rq->cpu,
+				sched_ktime_clock() - p->misfit_start);
+		p->misfit_start = 0;
+	}
 #endif
 	/*
 	 * The code below (indirectly) updates schedutil which looks at
@@ -6026,6 +6042,10 @@ struct energy_env {
 	struct eenv_cpu *cpu;
 	int eenv_cpu_count;
 
+	/* cpu_util_without() of each CPU, computed once per estimation */
+	unsigned long *util;
+	cpumask_t util_valid;
+
 #ifdef DEBUG_EENV_DECISIONS
 	/* pointer to the memory block reserved
 	 * for debug on this CPU - there will be
@@ -6155,6 +6175,19 @@ static unsigned long cpu_util_without(int cpu, struct task_struct *p)
 	return min_t(unsigned long, util, capacity_orig_of(cpu));
 }
 
+static unsigned long eenv_cpu_util(struct energy_env *eenv, int cpu)
+{
+	if (unlikely(!eenv->util))
+		return cpu_util_without(cpu, eenv->p);
+
+	if (!cpumask_test_cpu(cpu, &eenv->util_valid)) {
+		eenv->util[cpu] = cpu_util_without(cpu, eenv->p);
+		cpumask_set_cpu(cpu, &eenv->util_valid);
+	}
+
+	return eenv->util[cpu];
+}
+
 static unsigned long group_max_util(struct energy_env *eenv, int cpu_idx)
 {
 	unsigned long max_util = 0;
@@ -6162,7 +6195,7 @@ static unsigned long group_max_util(struct energy_env *eenv, int cpu_idx)
 	int cpu;
 
 	for_each_cpu(cpu, sched_group_span(eenv->sg_cap)) {
-		util = cpu_util_without(cpu, eenv->p);
+		util = eenv_cpu_util(eenv, cpu);
 
 		/*
 		 * If we are looking at the target CPU specified by the eenv,
@@ -6195,7 +6228,7 @@ long group_norm_util(struct energy_env *eenv, int cpu_idx)
 	int cpu;
 
 	for_each_cpu(cpu, sched_group_span(eenv->sg)) {
-		util = cpu_util_without(cpu, eenv->p);
+		util = eenv_cpu_util(eenv, cpu);
 
 		/*
 		 * If we are looking at the target CPU specified by the eenv,
@@ -6217,14 +6250,24 @@ static int find_new_capacity(struct energy_env *eenv, int cpu_idx)
 {
 	const struct sched_group_energy *sge = eenv->sg_cap->sge;
 	unsigned long util = group_max_util(eenv, cpu_idx);
+	unsigned short *lut = smp_load_acquire(&sge->cap_idx_lut);
 	int idx, cap_idx;
 
 	cap_idx = sge->nr_cap_states - 1;
 
-	for (idx = 0; idx < sge->nr_cap_states; idx++) {
-		if (sge->cap_states[idx].cap >= util) {
-			cap_idx = idx;
-			break;
+	if (lut) {
+		/* Start from the bucket, capacities may fall inside it */
+		idx = lut[min_t(unsigned long, util, SCHED_CAPACITY_SCALE) >>
+			  SGE_LUT_SHIFT];
+		while (idx < cap_idx && sge->cap_states[idx].cap < util)
+			idx++;
+		cap_idx = idx;
+	} else {
+		for (idx = 0; idx < sge->nr_cap_states; idx++) {
+			if (sge->cap_states[idx].cap >= util) {
+				cap_idx = idx;
+				break;
+			}
 		}
 	}
 	/* Keep track of SG's capacity */
@@ -6555,6 +6598,40 @@ static void dump_eenv_debug(struct energy_env *eenv)
 #else
 #define dump_eenv_debug(a) {}
 #endif /* DEBUG_EENV_DECISIONS */
+/*
+ * All the candidates share the frequency domain of prev_cpu, and the domain
+ * would run at the same OPP wherever the task is placed. Busy energy is then
+ * the same for every candidate and only the idle state estimates, which are
+ * normally well within the migration margin, could tell them apart.
+ */
+static bool eenv_same_opp(struct energy_env *eenv)
+{
+	int prev_cpu = eenv->cpu[EAS_CPU_PRV].cpu_id;
+	struct sched_domain *sd;
+	int cpu_idx, cap_idx = -1;
+
+	sd = rcu_dereference(per_cpu(sd_scs, prev_cpu));
+	if (!sd || !cpumask_subset(&eenv->cpus_mask, sched_domain_span(sd)))
+		return false;
+
+	eenv->sg_cap = sd->parent ? sd->parent->groups : sd->groups;
+	if (!eenv->sg_cap->sge ||
+	    !cpumask_subset(&eenv->cpus_mask, sched_group_span(eenv->sg_cap)))
+		return false;
+
+	for (cpu_idx = EAS_CPU_PRV; cpu_idx < eenv->max_cpu_count; ++cpu_idx) {
+		if (eenv->cpu[cpu_idx].cpu_id < 0)
+			continue;
+
+		if (cap_idx < 0)
+			cap_idx = find_new_capacity(eenv, cpu_idx);
+		else if (find_new_capacity(eenv, cpu_idx) != cap_idx)
+			return false;
+	}
+
+	return true;
+}
+
 /*
  * select_energy_cpu_idx(): estimate the energy impact of changing the
  * utilization distribution.
@@ -6582,7 +6659,7 @@ static void dump_eenv_debug(struct energy_env *eenv)
  * A value greater than zero means that the most energy efficient CPU is the
  * one represented by eenv->cpu[eenv->next_idx].cpu_id.
  */
-static inline int select_energy_cpu_idx(struct energy_env *eenv)
+static inline int __select_energy_cpu_idx(struct energy_env *eenv)
 {
 	int last_cpu_idx = eenv->max_cpu_count - 1;
 	struct sched_domain *sd;
@@ -6605,6 +6682,12 @@ static inline int select_energy_cpu_idx(struct energy_env *eenv)
 		cpumask_set_cpu(cpu, &eenv->cpus_mask);
 	}
 
+	if (sched_feat(EAS_SAME_OPP_FASTPATH) && eenv_same_opp(eenv)) {
+		schedstat_inc(this_rq()->eas_fastpath);
+		eenv->next_idx = EAS_CPU_PRV;
+		return EAS_CPU_PRV;
+	}
+
 	sg = sd->groups;
 	do {
 		/* Skip SGs which do not contains a candidate CPU */
@@ -6670,6 +6753,22 @@ static inline int select_energy_cpu_idx(struct energy_env *eenv)
 	return eenv->next_idx;
 }
 
+static inline int select_energy_cpu_idx(struct energy_env *eenv)
+{
+	u64 start = 0;
+	int ret;
+
+	if (schedstat_enabled())
+		start = sched_clock();
+
+	ret = __select_energy_cpu_idx(eenv);
+
+	schedstat_inc(this_rq()->eas_count);
+	schedstat_add(this_rq()->eas_time, sched_clock() - start);
+
+	return ret;
+}
+
 /*
  * Detect M:N waker/wakee relationships via a switching-frequency heuristic.
  *
@@ -8160,6 +8259,8 @@ static inline void alloc_eenv(void)
 		struct energy_env *eenv = &per_cpu(eenv_cache, cpu);
 		eenv->cpu = kmalloc(sizeof(struct eenv_cpu) * cpu_count, GFP_KERNEL);
 		eenv->eenv_cpu_count = cpu_count;
+		eenv->util = kcalloc(nr_cpu_ids, sizeof(*eenv->util),
+				     GFP_KERNEL);
 #ifdef DEBUG_EENV_DECISIONS
 		eenv->debug = (struct _eenv_debug *)kmalloc(eenv_debug_size(), GFP_KERNEL);
 #endif
@@ -8170,6 +8271,7 @@ static inline void reset_eenv(struct energy_env *eenv)
 {
 	int cpu_count;
 	struct eenv_cpu *cpu;
+	unsigned long *util;
 #ifdef DEBUG_EENV_DECISIONS
 	struct _eenv_debug *debug;
 	int cpu_idx;
@@ -8178,8 +8280,10 @@ static inline void reset_eenv(struct energy_env *eenv)
 
 	cpu_count = eenv->eenv_cpu_count;
 	cpu = eenv->cpu;
+	util = eenv->util;
 	memset(eenv, 0, sizeof(struct energy_env));
 	eenv->cpu = cpu;
+	eenv->util = util;
 	memset(eenv->cpu, 0, sizeof(struct eenv_cpu)*cpu_count);
 	eenv->eenv_cpu_count = cpu_count;
 
@@ -8245,6 +8349,19 @@ static inline bool is_task_util_above_min_thresh(struct task_struct *p)
 	return task_util(p) > threshold;
 }
 
+/* @p is being woken up by a task of its own related thread group */
+static inline bool rtg_wakeup_within(struct task_struct *p,
+				     struct related_thread_group *grp)
+{
+	return p->state == TASK_WAKING &&
+		task_related_thread_group(current) == grp;
+}
+
+/*
+ * Small tasks are normally free to go anywhere, but when woken by their own
+ * group they follow it to its cluster, so that the group keeps sharing the
+ * cluster cache rather than being split by short bursts.
+ */
 static inline struct cpumask *find_rtg_target(struct task_struct *p)
 {
 	struct related_thread_group *grp;
@@ -8253,7 +8370,8 @@ static inline struct cpumask *find_rtg_target(struct task_struct *p)
 	rcu_read_lock();
 
 	grp = task_related_thread_group(p);
-	if (grp && grp->preferred_cluster && is_task_util_above_min_thresh(p)) {
+	if (grp && grp->preferred_cluster &&
+	    (is_task_util_above_min_thresh(p) || rtg_wakeup_within(p, grp))) {
 		rtg_target = &grp->preferred_cluster->cpus;
 		if (!task_fits_max(p, cpumask_first(rtg_target)))
 			rtg_target = NULL;
@@ -8271,6 +8389,23 @@ static inline bool is_many_wakeup(int sibling_count_hint)
 	return sibling_count_hint >= sysctl_sched_many_wakeup_threshold;
 }
 
+/* Count wakeups within a group that land on another cluster than the waker */
+static inline void rtg_account_wakeup(struct task_struct *p, int cpu)
+{
+	struct related_thread_group *grp;
+
+	rcu_read_lock();
+
+	grp = task_related_thread_group(p);
+	if (grp && rtg_wakeup_within(p, grp)) {
+		atomic_long_inc(&grp->nr_wakeups);
+		if (cpu_rq(cpu)->cluster != this_rq()->cluster)
+			atomic_long_inc(&grp->nr_cross_cluster_wakeups);
+	}
+
+	rcu_read_unlock();
+}
+
 #else
 static inline struct cpumask *find_rtg_target(struct task_struct *p)
 {
@@ -8281,6 +8416,10 @@ static inline bool is_many_wakeup(int sibling_count_hint)
 {
 	return false;
 }
+
+static inline void rtg_account_wakeup(struct task_struct *p, int cpu)
+{
+}
 #endif
 
 /*
@@ -8500,6 +8639,57 @@ static inline int wake_energy(struct task_struct *p, int prev_cpu,
 	return true;
 }
 
+/*
+ * Bumped whenever a CPU capacity changes, dropping every cached placement.
+ */
+static unsigned int wake_cache_gen;
+
+static void wake_cache_invalidate(void)
+{
+	WRITE_ONCE(wake_cache_gen, wake_cache_gen + 1);
+}
+
+static inline bool wake_cache_close(unsigned long a, unsigned long b)
+{
+	return abs((long)a - (long)b) <= sysctl_sched_wake_cache_util;
+}
+
+/*
+ * Frequent waker/wakee pairs such as binder and audio threads wake up
+ * with nearly the same utilization over and over. Their previous energy
+ * aware target is still the answer as long as nothing it depended on has
+ * moved: the task and target utilization, the target idle state, its
+ * availability and the CPU capacities.
+ */
+static int wake_cache_lookup(struct task_struct *p, u64 now)
+{
+	int cpu = p->wake_cache_cpu;
+
+	if (!sysctl_sched_wake_cache_ns || cpu < 0)
+		return -1;
+
+	if (now - p->wake_cache_ts > sysctl_sched_wake_cache_ns ||
+	    p->wake_cache_gen != READ_ONCE(wake_cache_gen) ||
+	    !cpu_online(cpu) || cpu_isolated(cpu) ||
+	    !cpumask_test_cpu(cpu, &p->cpus_allowed) ||
+	    idle_cpu(cpu) != p->wake_cache_idle ||
+	    !wake_cache_close(task_util_est(p), p->wake_cache_util) ||
+	    !wake_cache_close(cpu_util(cpu), p->wake_cache_cpu_util))
+		return -1;
+
+	return cpu;
+}
+
+static void wake_cache_update(struct task_struct *p, int cpu, u64 now)
+{
+	p->wake_cache_cpu = cpu;
+	p->wake_cache_ts = now;
+	p->wake_cache_gen = READ_ONCE(wake_cache_gen);
+	p->wake_cache_idle = idle_cpu(cpu);
+	p->wake_cache_util = task_util_est(p);
+	p->wake_cache_cpu_util = cpu_util(cpu);
+}
+
 /*
  * select_task_rq_fair: Select target runqueue for the waking task in domains
  * that have the 'sd_flag' flag set. In practice, this is SD_BALANCE_WAKE,
@@ -8616,9 +8806,19 @@ pick_cpu:
 			     cpu_rq(cpu)->rd->mid_cap_orig_cpu :
 			     cpu_rq(cpu)->rd->max_cap_orig_cpu;
 			bool sync_boost = sync && cpu >= high_cap_cpu;
+			u64 now = sched_clock_cpu(cpu);
 
-			new_cpu = find_energy_efficient_cpu(energy_sd, p, cpu,
-					prev_cpu, sync, sibling_count_hint, sync_boost);
+			new_cpu = wake_cache_lookup(p, now);
+			if (new_cpu >= 0) {
+				schedstat_inc(this_rq()->wake_cache_hit);
+			} else {
+				schedstat_inc(this_rq()->wake_cache_miss);
+				new_cpu = find_energy_efficient_cpu(energy_sd,
+						p, cpu, prev_cpu, sync,
+						sibling_count_hint, sync_boost);
+				if (new_cpu >= 0 && sysctl_sched_wake_cache_ns)
+					wake_cache_update(p, new_cpu, now);
+			}
 		}
 
 		/* if we did an energy-aware placement and had no choices available
@@ -8630,6 +8830,9 @@ pick_cpu:
 
 	rcu_read_unlock();
 
+	if (sd_flag & SD_BALANCE_WAKE)
+		rtg_account_wakeup(p, new_cpu);
+
 #ifdef CONFIG_NO_HZ_COMMON
 	if (nohz_kick_needed(cpu_rq(new_cpu), true))
 		nohz_balancer_kick(true);
@@ -9905,6 +10108,8 @@ static void update_cpu_capacity(struct sched_domain *sd, int cpu)
 	capacity >>= SCHED_CAPACITY_SHIFT;
 
 	capacity = min(capacity, thermal_cap(cpu));
+	if (cpu_rq(cpu)->cpu_capacity_orig != capacity)
+		wake_cache_invalidate();
 	cpu_rq(cpu)->cpu_capacity_orig = capacity;
 
 	capacity *= scale_rt_capacity(cpu);
@@ -12935,9 +13140,19 @@ void show_numa_stats(struct task_struct *p, struct seq_file *m)
 #endif /* CONFIG_NUMA_BALANCING */
 #endif /* CONFIG_SCHED_DEBUG */
 
+#ifdef CONFIG_SCHED_WALT
+static void misfit_fastpath_work(struct irq_work *work);
+#endif
+
 __init void init_sched_fair_class(void)
 {
 #ifdef CONFIG_SMP
+#ifdef CONFIG_SCHED_WALT
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		init_irq_work(&cpu_rq(cpu)->misfit_work, misfit_fastpath_work);
+#endif
 	open_softirq(SCHED_SOFTIRQ, run_rebalance_domains);
 
 #ifdef CONFIG_NO_HZ_COMMON
@@ -13307,4 +13522,47 @@ void check_for_migration(struct rq *rq, struct task_struct *p)
 	}
 }
 
+/*
+ * A top-app task whose demand grew past what its CPU can serve is only
+ * noticed as misfit at the next tick, and then moved by the next
+ * check_for_migration(). Catch it as soon as WALT rolls its window over
+ * and run the active migration from irq_work, once the rq lock is
+ * released.
+ */
+void check_misfit_fastpath(struct rq *rq, struct task_struct *p,
+			   u64 wallclock)
+{
+	if (p->sched_class != &fair_sched_class || p->nr_cpus_allowed == 1 ||
+	    rq != this_rq())
+		return;
+
+	if (schedtune_task_boost(p) <= 0 && schedtune_prefer_idle(p) <= 0)
+		return;
+
+	if (task_fits_max(p, cpu_of(rq)))
+		return;
+
+	p->misfit = true;
+	if (!p->misfit_start)
+		p->misfit_start = wallclock;
+
+	irq_work_queue(&rq->misfit_work);
+}
+
+static void misfit_fastpath_work(struct irq_work *work)
+{
+	struct rq *rq = container_of(work, struct rq, misfit_work);
+	struct task_struct *p;
+
+	raw_spin_lock(&rq->lock);
+	p = rq->curr;
+	if (p->sched_class == &fair_sched_class)
+		update_misfit_status(p, rq);
+	raw_spin_unlock(&rq->lock);
+
+	/* p stays current until this interrupt returns */
+	if (p->sched_class == &fair_sched_class)
+		check_for_migration(rq, p);
+}
+
 #endif /* CONFIG_SCHED_WALT */
@@ -125,6 +125,13 @@ SCHED_FEAT(EAS_PREFER_IDLE, true)
 SCHED_FEAT(FIND_BEST_TARGET, true)
 SCHED_FEAT(FBT_STRICT_ORDER, false)
 
+/*
+ * EAS_SAME_OPP_FASTPATH
+ *   Skip the energy comparison and keep prev_cpu when all candidates
+ *   share its frequency domain and would not change its OPP.
+ */
+SCHED_FEAT(EAS_SAME_OPP_FASTPATH, true)
+
 /*
  * Apply schedtune boost hold to tasks of all sched classes.
  * If enabled, schedtune will hold the boost applied to a CPU
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Frequency decision trace
+ *
+ * The schedutil and WALT tracepoints are too expensive to leave enabled on
+ * field devices, so after a jank there is no record of why the CPUs ran at
+ * the frequencies they did. Instead, every schedutil decision and the WALT
+ * window rollovers and load reports behind it are appended to a per-CPU
+ * ring of fixed size binary records. That costs a clock read and a few
+ * stores. Userspace snapshots all rings with a single ioctl on
+ * /dev/sched_freq_trace, see include/uapi/linux/sched_freq_trace.h.
+ *
+ * Writers never wait for readers. A snapshot copies a ring and then drops
+ * the records that may have been overwritten while it was copied.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "sched.h"
+
+DEFINE_PER_CPU(struct sched_freq_ring, sched_freq_ring);
+unsigned long sched_freq_ring_mask;
+
+/* 1 << ring_order records per CPU */
+static unsigned int ring_order = 10;
+module_param(ring_order, uint, 0444);
+
+static DEFINE_MUTEX(freq_trace_mutex);
+/* one CPU's ring worth of records, copied under freq_trace_mutex */
+static struct sched_freq_rec *freq_trace_bounce;
+
+/*
+ * Copy the records of @cpu newer than @since to @ubuf, at most @max of
+ * them. Returns the number copied, adds overwritten records to @lost.
+ */
+static long freq_trace_copy_cpu(int cpu, struct sched_freq_rec __user *ubuf,
+				unsigned long max, u64 since, u32 *lost)
+{
+	struct sched_freq_ring *ring = &per_cpu(sched_freq_ring, cpu);
+	unsigned long n = sched_freq_ring_mask + 1;
+	unsigned long h1, h2, first, last, i, idx, chunk;
+	long copied = 0;
+
+	if (!ring->recs)
+		return 0;
+
+	h1 = smp_load_acquire(&ring->head);
+	memcpy(freq_trace_bounce, ring->recs, n * sizeof(*freq_trace_bounce));
+	smp_rmb();
+	h2 = READ_ONCE(ring->head);
+
+	/* slots written since h1, and the one being written, are unusable */
+	first = h1 > n ? h1 - n : 0;
+	if (h2 + 1 > n)
+		first = max(first, h2 + 1 - n);
+	first = min(first, h1);
+
+	if (first > ring->read)
+		*lost += first - ring->read;
+	ring->read = h1;
+
+	/* records of one CPU are in time order */
+	while (first < h1 &&
+	       freq_trace_bounce[first & sched_freq_ring_mask].time < since)
+		first++;
+	last = min(h1, first + max);
+
+	for (i = first; i < last; i += chunk) {
+		idx = i & sched_freq_ring_mask;
+		chunk = min(last - i, n - idx);
+		if (copy_to_user(ubuf + copied, &freq_trace_bounce[idx],
+				 chunk * sizeof(*ubuf)))
+			return -EFAULT;
+		copied += chunk;
+	}
+
+	return copied;
+}
+
+static long freq_trace_snapshot(struct sched_freq_snapshot __user *uarg)
+{
+	struct sched_freq_snapshot snap;
+	struct sched_freq_rec __user *ubuf;
+	unsigned long room;
+	long ret = 0;
+	int cpu;
+
+	if (copy_from_user(&snap, uarg, sizeof(snap)))
+		return -EFAULT;
+
+	ubuf = u64_to_user_ptr(snap.buf);
+	room = snap.size / sizeof(*ubuf);
+	snap.count = 0;
+	snap.lost = 0;
+
+	mutex_lock(&freq_trace_mutex);
+	for_each_possible_cpu(cpu) {
+		ret = freq_trace_copy_cpu(cpu, ubuf + snap.count, room,
+					  snap.since_ns, &snap.lost);
+		if (ret < 0)
+			break;
+		snap.count += ret;
+		room -= ret;
+	}
+	mutex_unlock(&freq_trace_mutex);
+
+	if (ret < 0)
+		return ret;
+
+	if (copy_to_user(uarg, &snap, sizeof(snap)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long freq_trace_ioctl(struct file *file, unsigned int cmd,
+			     unsigned long arg)
+{
+	switch (cmd) {
+	case SCHED_FREQ_TRACE_SNAPSHOT:
+		return freq_trace_snapshot((void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static const struct file_operations freq_trace_fops = {
+	.owner		= THIS_MODULE,
+	.unlocked_ioctl	= freq_trace_ioctl,
+	.compat_ioctl	= freq_trace_ioctl,
+	.llseek		= noop_llseek,
+};
+
+static struct miscdevice freq_trace_dev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "sched_freq_trace",
+	.fops	= &freq_trace_fops,
+};
+
+static int __init freq_trace_init(void)
+{
+	unsigned long n;
+	int cpu;
+
+	ring_order = clamp(ring_order, 4U, 16U);
+	n = 1UL << ring_order;
+
+	freq_trace_bounce = vmalloc(n * sizeof(*freq_trace_bounce));
+	if (!freq_trace_bounce)
+		return -ENOMEM;
+
+	sched_freq_ring_mask = n - 1;
+	for_each_possible_cpu(cpu) {
+		struct sched_freq_rec *recs;
+
+		/* a CPU without a ring just does not record */
+		recs = kcalloc_node(n, sizeof(*recs), GFP_KERNEL,
+				    cpu_to_node(cpu));
+		smp_store_release(&per_cpu(sched_freq_ring, cpu).recs, recs);
+	}
+
+	return misc_register(&freq_trace_dev);
+}
+late_initcall(freq_trace_init);
@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IRQ placement
+ *
+ * High rate device interrupts left on their default affinity all land on
+ * the first CPU of the mask, and get moved around by core_ctl every time
+ * that CPU is isolated or unisolated. This service periodically measures
+ * how much time each interrupt costs, from the WALT irqload of the CPU it
+ * runs on split by interrupt count, and spreads the expensive ones over the
+ * online, unisolated min capacity CPUs, preferring CPUs that are not
+ * running boosted (top-app) tasks.
+ *
+ * Only interrupts on the default affinity, or ones placed here earlier,
+ * are touched. Writing a multi-CPU mask to /proc/irq/N/smp_affinity takes
+ * an interrupt back.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/kernel_stat.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
+
+#include "sched.h"
+#include "walt.h"
+#include "tune.h"
+
+#define IRQB_MAX_IRQS	32
+
+struct irqb_state {
+	unsigned int count;
+	int cpu;		/* CPU placed on, -1 if not placed here */
+};
+
+struct irqb_candidate {
+	unsigned int irq;
+	int cpu;
+	u64 time;
+};
+
+static bool irqb_enable;
+static u32 irqb_period_ms = 1000;
+/* interrupts per second below which an interrupt is left alone */
+static u32 irqb_min_rate = 500;
+/* ns of irqload a CPU must be better by before an interrupt moves */
+static u32 irqb_hyst_ns = NSEC_PER_MSEC;
+
+static struct irqb_state *irqb_states;
+static unsigned int irqb_nr_states;
+static unsigned int irqb_cpu_count[NR_CPUS];
+static u64 irqb_cpu_cost[NR_CPUS];
+static struct irqb_candidate irqb_placed[IRQB_MAX_IRQS];
+static int irqb_nr_placed;
+static unsigned long irqb_moves;
+static DEFINE_MUTEX(irqb_mutex);
+
+static void irqb_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irqb_work, irqb_work_fn);
+
+static bool irqb_cpu_busy_boosted(int cpu)
+{
+	struct task_struct *curr;
+	bool boosted;
+
+	rcu_read_lock();
+	curr = READ_ONCE(cpu_rq(cpu)->curr);
+	boosted = !is_idle_task(curr) && schedtune_task_boost(curr) > 0;
+	rcu_read_unlock();
+
+	return boosted;
+}
+
+/* May this service move @irq, and where is it now? */
+static bool irqb_manageable(unsigned int irq, struct irq_desc *desc, int *cpu)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+	const struct cpumask *mask = irq_data_get_affinity_mask(data);
+
+	if (!desc->action || irqd_is_per_cpu(data) ||
+	    irqd_affinity_is_managed(data) || irq_balancing_disabled(irq) ||
+	    !irq_can_set_affinity(irq))
+		return false;
+
+	if (!cpumask_equal(mask, irq_default_affinity) &&
+	    (irqb_states[irq].cpu < 0 || cpumask_weight(mask) != 1)) {
+		irqb_states[irq].cpu = -1;
+		return false;
+	}
+
+	*cpu = cpumask_first(irq_data_get_effective_affinity_mask(data));
+	if (*cpu >= nr_cpu_ids)
+		*cpu = cpumask_first(mask);
+
+	return *cpu < nr_cpu_ids;
+}
+
+static int irqb_cmp_time(const void *a, const void *b)
+{
+	const struct irqb_candidate *ca = a, *cb = b;
+
+	if (ca->time == cb->time)
+		return 0;
+
+	return ca->time < cb->time ? 1 : -1;
+}
+
+/*
+ * Collect the most expensive movable interrupts since the last pass,
+ * costed by the share of their CPU's irqload their count accounts for.
+ */
+static int irqb_collect(struct irqb_candidate *cand, u64 *load,
+			unsigned int *delta_cpu)
+{
+	unsigned int irq, count, delta, min_delta;
+	struct irq_desc *desc;
+	int cpu, n = 0, i;
+	u64 time;
+
+	min_delta = div_u64((u64)irqb_min_rate * irqb_period_ms, MSEC_PER_SEC);
+
+	irq_lock_sparse();
+	for (irq = 0; irq < irqb_nr_states; irq++) {
+		desc = irq_to_desc(irq);
+		if (!desc)
+			continue;
+
+		count = kstat_irqs(irq);
+		delta = count - irqb_states[irq].count;
+		irqb_states[irq].count = count;
+
+		if (delta < max(min_delta, 1U) ||
+		    !irqb_manageable(irq, desc, &cpu) || !delta_cpu[cpu])
+			continue;
+
+		time = div_u64(load[cpu] * min(delta, delta_cpu[cpu]),
+			       delta_cpu[cpu]);
+
+		/* Keep the IRQB_MAX_IRQS most expensive ones */
+		if (n == IRQB_MAX_IRQS) {
+			for (i = 0; i < n; i++)
+				if (cand[i].time < time)
+					break;
+			if (i == n)
+				continue;
+			cand[i] = cand[--n];
+		}
+		cand[n].irq = irq;
+		cand[n].cpu = cpu;
+		cand[n].time = time;
+		n++;
+	}
+	irq_unlock_sparse();
+
+	sort(cand, n, sizeof(*cand), irqb_cmp_time, NULL);
+
+	return n;
+}
+
+static void irqb_balance(void)
+{
+	struct irqb_candidate cand[IRQB_MAX_IRQS];
+	unsigned int delta_cpu[NR_CPUS] = { 0 };
+	u64 load[NR_CPUS] = { 0 };
+	cpumask_t targets;
+	int cpu, best, n, i;
+	unsigned int count;
+
+	for_each_possible_cpu(cpu) {
+		count = kstat_cpu_irqs_sum(cpu);
+		delta_cpu[cpu] = count - irqb_cpu_count[cpu];
+		irqb_cpu_count[cpu] = count;
+		load[cpu] = cpu_online(cpu) ? sched_irqload(cpu) : 0;
+	}
+
+	n = irqb_collect(cand, load, delta_cpu);
+
+	cpumask_andnot(&targets, cpu_online_mask, cpu_isolated_mask);
+	for_each_cpu(cpu, &targets)
+		if (!is_min_capacity_cpu(cpu))
+			cpumask_clear_cpu(cpu, &targets);
+	if (cpumask_empty(&targets))
+		return;
+
+	/* What each target costs before any candidate lands on it */
+	for_each_cpu(cpu, &targets) {
+		irqb_cpu_cost[cpu] = load[cpu];
+		if (irqb_cpu_busy_boosted(cpu))
+			irqb_cpu_cost[cpu] += sysctl_sched_cpu_high_irqload;
+	}
+	for (i = 0; i < n; i++)
+		if (cpumask_test_cpu(cand[i].cpu, &targets))
+			irqb_cpu_cost[cand[i].cpu] -= min(cand[i].time,
+				irqb_cpu_cost[cand[i].cpu]);
+
+	/* Largest first onto the cheapest target, unless staying is close */
+	for (i = 0; i < n; i++) {
+		best = -1;
+		for_each_cpu(cpu, &targets)
+			if (best < 0 || irqb_cpu_cost[cpu] < irqb_cpu_cost[best])
+				best = cpu;
+
+		cpu = cand[i].cpu;
+		if (cpumask_test_cpu(cpu, &targets) &&
+		    irqb_cpu_cost[cpu] <= irqb_cpu_cost[best] + irqb_hyst_ns)
+			best = cpu;
+
+		irqb_cpu_cost[best] += cand[i].time;
+		if (best != cpu &&
+		    irq_set_affinity(cand[i].irq, cpumask_of(best)))
+			continue;
+
+		if (best != cpu)
+			irqb_moves++;
+		irqb_states[cand[i].irq].cpu = best;
+		cand[i].cpu = best;
+	}
+
+	memcpy(irqb_placed, cand, n * sizeof(*cand));
+	irqb_nr_placed = n;
+}
+
+static void irqb_work_fn(struct work_struct *work)
+{
+	mutex_lock(&irqb_mutex);
+	if (!irqb_enable) {
+		mutex_unlock(&irqb_mutex);
+		return;
+	}
+
+	irqb_balance();
+	mutex_unlock(&irqb_mutex);
+
+	queue_delayed_work(system_power_efficient_wq, &irqb_work,
+			   msecs_to_jiffies(irqb_period_ms ?: 1));
+}
+
+static int irqb_enable_get(void *data, u64 *val)
+{
+	*val = irqb_enable;
+
+	return 0;
+}
+
+static int irqb_enable_set(void *data, u64 val)
+{
+	mutex_lock(&irqb_mutex);
+	irqb_enable = !!val;
+	mutex_unlock(&irqb_mutex);
+
+	if (val)
+		mod_delayed_work(system_power_efficient_wq, &irqb_work, 0);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(irqb_enable_fops, irqb_enable_get, irqb_enable_set,
+			"%llu\n");
+
+static int irqb_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc;
+	int i;
+
+	mutex_lock(&irqb_mutex);
+	seq_printf(m, "enabled=%d moves=%lu\n", irqb_enable, irqb_moves);
+	for (i = 0; i < irqb_nr_placed; i++) {
+		desc = irq_to_desc(irqb_placed[i].irq);
+		seq_printf(m, "  irq=%-4u cpu=%d time_ns=%llu %s\n",
+			   irqb_placed[i].irq, irqb_placed[i].cpu,
+			   irqb_placed[i].time,
+			   desc && desc->action && desc->action->name ?
+			   desc->action->name : "");
+	}
+	mutex_unlock(&irqb_mutex);
+
+	return 0;
+}
+
+static int irqb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irqb_show, NULL);
+}
+
+static const struct file_operations irqb_fops = {
+	.open		= irqb_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init irq_balance_init(void)
+{
+	struct dentry *dir;
+	unsigned int irq;
+
+	irqb_nr_states = nr_irqs;
+	irqb_states = kcalloc(irqb_nr_states, sizeof(*irqb_states),
+			      GFP_KERNEL);
+	if (!irqb_states)
+		return -ENOMEM;
+	for (irq = 0; irq < irqb_nr_states; irq++)
+		irqb_states[irq].cpu = -1;
+
+	dir = debugfs_create_dir("irq_balance", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return 0;
+
+	debugfs_create_file("enable", 0644, dir, NULL, &irqb_enable_fops);
+	debugfs_create_u32("period_ms", 0644, dir, &irqb_period_ms);
+	debugfs_create_u32("min_rate", 0644, dir, &irqb_min_rate);
+	debugfs_create_u32("hyst_ns", 0644, dir, &irqb_hyst_ns);
+	debugfs_create_file("placement", 0444, dir, NULL, &irqb_fops);
+
+	return 0;
+}
+late_initcall(irq_balance_init);
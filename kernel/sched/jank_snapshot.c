@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Scheduler state for jank snapshots: the run queue, current task and
+ * frequency of every CPU, read in one pass without taking the rq locks.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/jank_snapshot.h>
+#include <linux/seq_file.h>
+
+#include "sched.h"
+
+static void sched_jank_show(struct seq_file *m, void *priv)
+{
+	struct task_struct *curr;
+	struct rq *rq;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rq = cpu_rq(cpu);
+
+		seq_printf(m, "cpu%d%s%s nr=%u cfs=%u rt=%u freq=%u util=%lu",
+			   cpu, cpu_online(cpu) ? "" : " offline",
+			   cpu_isolated(cpu) ? " isolated" : "",
+			   READ_ONCE(rq->nr_running),
+			   READ_ONCE(rq->cfs.h_nr_running),
+			   READ_ONCE(rq->rt.rt_nr_running),
+			   cpufreq_quick_get(cpu), cpu_util(cpu));
+#ifdef CONFIG_SCHED_WALT
+		seq_printf(m, " demand=%llu",
+			   READ_ONCE(rq->walt_stats.cumulative_runnable_avg_scaled));
+#endif
+
+		/* task_structs are freed after a grace period */
+		rcu_read_lock();
+		curr = READ_ONCE(rq->curr);
+		seq_printf(m, " curr=%s/%d prio=%d\n", curr->comm,
+			   task_pid_nr(curr), curr->prio);
+		rcu_read_unlock();
+	}
+}
+
+static struct jank_snapshot_source sched_jank_src = {
+	.name = "sched",
+	.show = sched_jank_show,
+};
+
+static int __init sched_jank_init(void)
+{
+	jank_snapshot_register(&sched_jank_src);
+
+	return 0;
+}
+late_initcall(sched_jank_init);
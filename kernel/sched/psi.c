@@ -141,6 +141,7 @@
 #include <linux/file.h>
 #include <linux/poll.h>
 #include <linux/psi.h>
+#include <linux/jank_snapshot.h>
 #include "sched.h"
 
 static int psi_bug __read_mostly;
@@ -172,6 +173,18 @@ __setup("psi=", setup_psi);
 /* Sampling frequency in nanoseconds */
 static u64 psi_period __read_mostly;
 
+/*
+ * One psimon worker polls the triggers of all groups, system and cgroups
+ * alike. It exists while any group has triggers.
+ */
+static struct kthread_worker *psi_poll_worker;
+static unsigned int psi_poll_users;
+static DEFINE_MUTEX(psi_poll_lock);
+
+/* Periodic trigger updates are aligned to this, to batch groups */
+static unsigned int psi_poll_align_ms = 10;
+module_param_named(poll_align_ms, psi_poll_align_ms, uint, 0644);
+
 /* System-level pressure and stall tracking */
 static DEFINE_PER_CPU(struct psi_group_cpu, system_group_pcpu);
 static struct psi_group psi_system = {
@@ -179,6 +192,7 @@ static struct psi_group psi_system = {
 };
 
 static void psi_avgs_work(struct work_struct *work);
+static void psi_poll_work(struct kthread_work *work);
 
 static void group_init(struct psi_group *group)
 {
@@ -200,6 +214,7 @@ static void group_init(struct psi_group *group)
 	memset(group->polling_total, 0, sizeof(group->polling_total));
 	group->polling_next_update = ULLONG_MAX;
 	group->polling_until = 0;
+	kthread_init_delayed_work(&group->poll_work, psi_poll_work);
 	rcu_assign_pointer(group->poll_kworker, NULL);
 }
 
@@ -577,6 +592,21 @@ static void psi_schedule_poll_work(struct psi_group *group, unsigned long delay)
 	rcu_read_unlock();
 }
 
+/*
+ * Round the expiry of a periodic update up to a multiple of poll_align_ms
+ * so that the groups polled by psimon at the same time are updated in a
+ * single wakeup instead of each on its own timer.
+ */
+static unsigned long psi_poll_delay(unsigned long delay)
+{
+	unsigned long align = msecs_to_jiffies(READ_ONCE(psi_poll_align_ms));
+
+	if (align <= 1)
+		return delay;
+
+	return roundup(jiffies + delay, align) - jiffies;
+}
+
 static void psi_poll_work(struct kthread_work *work)
 {
 	struct kthread_delayed_work *dwork;
@@ -617,8 +647,8 @@ static void psi_poll_work(struct kthread_work *work)
 	if (now >= group->polling_next_update)
 		group->polling_next_update = update_triggers(group, now);
 
-	psi_schedule_poll_work(group,
-		nsecs_to_jiffies(group->polling_next_update - now) + 1);
+	psi_schedule_poll_work(group, psi_poll_delay(
+		nsecs_to_jiffies(group->polling_next_update - now) + 1));
 
 out:
 	mutex_unlock(&group->trigger_lock);
@@ -1005,23 +1035,50 @@ static int psi_cpu_open(struct inode *inode, struct file *file)
 	return single_open(file, psi_cpu_show, NULL);
 }
 
-struct psi_trigger *psi_trigger_create(struct psi_group *group,
-			char *buf, size_t nbytes, enum psi_res res)
+static struct kthread_worker *psi_poll_worker_get(void)
 {
-	struct psi_trigger *t;
-	enum psi_states state;
-	u32 threshold_us;
-	u32 window_us;
+	struct sched_param param = {
+		.sched_priority = 1,
+	};
+	struct kthread_worker *kworker;
 
-	if (static_branch_likely(&psi_disabled))
-		return ERR_PTR(-EOPNOTSUPP);
+	mutex_lock(&psi_poll_lock);
+	if (!psi_poll_worker) {
+		kworker = kthread_create_worker(0, "psimon");
+		if (IS_ERR(kworker)) {
+			mutex_unlock(&psi_poll_lock);
+			return kworker;
+		}
+		sched_setscheduler_nocheck(kworker->task, SCHED_FIFO, &param);
+		psi_poll_worker = kworker;
+	}
+	psi_poll_users++;
+	kworker = psi_poll_worker;
+	mutex_unlock(&psi_poll_lock);
 
-	if (sscanf(buf, "some %u %u", &threshold_us, &window_us) == 2)
-		state = PSI_IO_SOME + res * 2;
-	else if (sscanf(buf, "full %u %u", &threshold_us, &window_us) == 2)
-		state = PSI_IO_FULL + res * 2;
-	else
-		return ERR_PTR(-EINVAL);
+	return kworker;
+}
+
+/* The caller has cancelled its group's poll_work */
+static void psi_poll_worker_put(void)
+{
+	struct kthread_worker *kworker = NULL;
+
+	mutex_lock(&psi_poll_lock);
+	if (!--psi_poll_users) {
+		kworker = psi_poll_worker;
+		psi_poll_worker = NULL;
+	}
+	mutex_unlock(&psi_poll_lock);
+
+	if (kworker)
+		kthread_destroy_worker(kworker);
+}
+
+static struct psi_trigger *__psi_trigger_create(struct psi_group *group,
+			enum psi_states state, u32 threshold_us, u32 window_us)
+{
+	struct psi_trigger *t;
 
 	if (state >= PSI_NONIDLE)
 		return ERR_PTR(-EINVAL);
@@ -1052,20 +1109,14 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 	mutex_lock(&group->trigger_lock);
 
 	if (!rcu_access_pointer(group->poll_kworker)) {
-		struct sched_param param = {
-			.sched_priority = 1,
-		};
 		struct kthread_worker *kworker;
 
-		kworker = kthread_create_worker(0, "psimon");
+		kworker = psi_poll_worker_get();
 		if (IS_ERR(kworker)) {
 			kfree(t);
 			mutex_unlock(&group->trigger_lock);
 			return ERR_CAST(kworker);
 		}
-		sched_setscheduler_nocheck(kworker->task, SCHED_FIFO, &param);
-		kthread_init_delayed_work(&group->poll_work,
-				psi_poll_work);
 		rcu_assign_pointer(group->poll_kworker, kworker);
 	}
 
@@ -1080,11 +1131,31 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 	return t;
 }
 
+struct psi_trigger *psi_trigger_create(struct psi_group *group,
+			char *buf, size_t nbytes, enum psi_res res)
+{
+	enum psi_states state;
+	u32 threshold_us;
+	u32 window_us;
+
+	if (static_branch_likely(&psi_disabled))
+		return ERR_PTR(-EOPNOTSUPP);
+
+	if (sscanf(buf, "some %u %u", &threshold_us, &window_us) == 2)
+		state = PSI_IO_SOME + res * 2;
+	else if (sscanf(buf, "full %u %u", &threshold_us, &window_us) == 2)
+		state = PSI_IO_FULL + res * 2;
+	else
+		return ERR_PTR(-EINVAL);
+
+	return __psi_trigger_create(group, state, threshold_us, window_us);
+}
+
 static void psi_trigger_destroy(struct kref *ref)
 {
 	struct psi_trigger *t = container_of(ref, struct psi_trigger, refcount);
 	struct psi_group *group = t->group;
-	struct kthread_worker *kworker_to_destroy = NULL;
+	bool put_worker = false;
 
 	if (static_branch_likely(&psi_disabled))
 		return;
@@ -1110,13 +1181,11 @@ static void psi_trigger_destroy(struct kref *ref)
 			period = min(period, div_u64(tmp->win.size,
 					UPDATES_PER_WINDOW));
 		group->poll_min_period = period;
-		/* Destroy poll_kworker when the last trigger is destroyed */
+		/* Detach from psimon when the last trigger is destroyed */
 		if (group->poll_states == 0) {
 			group->polling_until = 0;
-			kworker_to_destroy = rcu_dereference_protected(
-					group->poll_kworker,
-					lockdep_is_held(&group->trigger_lock));
 			rcu_assign_pointer(group->poll_kworker, NULL);
+			put_worker = true;
 		}
 	}
 
@@ -1125,28 +1194,56 @@ static void psi_trigger_destroy(struct kref *ref)
 	/*
 	 * Wait for both *trigger_ptr from psi_trigger_replace and
 	 * poll_kworker RCUs to complete their read-side critical sections
-	 * before destroying the trigger and optionally the poll_kworker
+	 * before destroying the trigger and optionally dropping psimon
 	 */
 	synchronize_rcu();
 	/*
-	 * Destroy the kworker after releasing trigger_lock to prevent a
+	 * Cancel the work after releasing trigger_lock to prevent a
 	 * deadlock while waiting for psi_poll_work to acquire trigger_lock
 	 */
-	if (kworker_to_destroy) {
+	if (put_worker) {
 		/*
 		 * After the RCU grace period has expired, the worker
 		 * can no longer be found through group->poll_kworker.
 		 * But it might have been already scheduled before
-		 * that - deschedule it cleanly before destroying it.
+		 * that - deschedule it cleanly before dropping psimon.
 		 */
 		kthread_cancel_delayed_work_sync(&group->poll_work);
 		atomic_set(&group->poll_scheduled, 0);
 
-		kthread_destroy_worker(kworker_to_destroy);
+		psi_poll_worker_put();
 	}
 	kfree(t);
 }
 
+/**
+ * psi_kernel_trigger_create - create a system wide trigger for kernel users
+ * @state:		PSI state to monitor, e.g. PSI_MEM_FULL
+ * @threshold_us:	stall time within @window_us that fires the trigger
+ * @window_us:		tracking window size
+ *
+ * Events are signalled by setting t->event and waking t->event_wait, the
+ * same as for user space triggers. Callers hook a custom wait queue entry
+ * into t->event_wait and clear t->event once they have consumed it.
+ */
+struct psi_trigger *psi_kernel_trigger_create(enum psi_states state,
+			u32 threshold_us, u32 window_us)
+{
+	if (static_branch_likely(&psi_disabled))
+		return ERR_PTR(-EOPNOTSUPP);
+
+	return __psi_trigger_create(&psi_system, state, threshold_us,
+				    window_us);
+}
+
+void psi_kernel_trigger_destroy(struct psi_trigger *t)
+{
+	if (static_branch_likely(&psi_disabled) || IS_ERR_OR_NULL(t))
+		return;
+
+	kref_put(&t->refcount, psi_trigger_destroy);
+}
+
 void psi_trigger_replace(void **trigger_ptr, struct psi_trigger *new)
 {
 	struct psi_trigger *old = *trigger_ptr;
@@ -1282,12 +1379,33 @@ static const struct file_operations psi_cpu_fops = {
 	.release        = psi_fop_release,
 };
 
+static void psi_jank_show(struct seq_file *m, void *priv)
+{
+	static const char * const names[NR_PSI_RESOURCES] = {
+		[PSI_IO] = "io",
+		[PSI_MEM] = "memory",
+		[PSI_CPU] = "cpu",
+	};
+	int res;
+
+	for (res = 0; res < NR_PSI_RESOURCES; res++) {
+		seq_printf(m, "%s:\n", names[res]);
+		psi_show(m, &psi_system, res);
+	}
+}
+
+static struct jank_snapshot_source psi_jank_src = {
+	.name = "psi",
+	.show = psi_jank_show,
+};
+
 static int __init psi_proc_init(void)
 {
 	proc_mkdir("pressure", NULL);
 	proc_create("pressure/io", 0, NULL, &psi_io_fops);
 	proc_create("pressure/memory", 0, NULL, &psi_memory_fops);
 	proc_create("pressure/cpu", 0, NULL, &psi_cpu_fops);
+	jank_snapshot_register(&psi_jank_src);
 	return 0;
 }
 module_init(psi_proc_init);
@@ -86,8 +86,21 @@ struct load_subtractions {
 	u64 new_subs;
 };
 
+/*
+ * Copy of the previous window busy time of a CPU, published under
+ * rq->lock and readable without it.
+ */
+struct walt_window_snapshot {
+	seqcount_t seq;
+	u64 window_start;
+	u64 prev_runnable_sum;
+	u64 nt_prev_runnable_sum;
+	u64 grp_prev_runnable_sum;
+};
+
 #define NUM_TRACKED_WINDOWS 2
 #define NUM_LOAD_INDICES 1000
+#define NUM_PRED_QUANTILES 10
 
 struct sched_cluster {
 	raw_spinlock_t load_lock;
@@ -965,12 +978,16 @@ struct rq {
 	u64 cum_window_demand_scaled;
 	struct group_cpu_time grp_time;
 	struct load_subtractions load_subs[NUM_TRACKED_WINDOWS];
+	struct walt_window_snapshot wsnap;
 	DECLARE_BITMAP_ARRAY(top_tasks_bitmap,
 			NUM_TRACKED_WINDOWS, NUM_LOAD_INDICES);
 	u8 *top_tasks[NUM_TRACKED_WINDOWS];
 	u8 curr_table;
 	int prev_top;
 	int curr_top;
+	u32 pred_quantile_scaled[NUM_PRED_QUANTILES];
+	u64 lpm_wakeup_hint;
+	struct irq_work misfit_work;
 	bool notif_pending;
 	u64 last_cc_update;
 	u64 cycles;
@@ -1014,6 +1031,15 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* EAS wakeup energy estimation stats */
+	unsigned int eas_count;
+	unsigned int eas_fastpath;
+	u64 eas_time;
+
+	/* EAS wakeup placement cache stats */
+	unsigned int wake_cache_hit;
+	unsigned int wake_cache_miss;
 #endif
 
 #ifdef CONFIG_SMP
@@ -2170,6 +2196,9 @@ static inline unsigned long cpu_util_cum(int cpu, int delta)
 
 #ifdef CONFIG_SCHED_WALT
 u64 freq_policy_load(struct rq *rq);
+extern u64 walt_get_cpu_prev_load(int cpu);
+extern int walt_get_cluster_prev_load(const struct cpumask *cpus, u64 *loads);
+extern unsigned int sched_walt_load_to_util_pct(int cpu, u64 load);
 
 extern u64 walt_load_reported_window;
 
@@ -2218,6 +2247,24 @@ cpu_util_freq(int cpu, struct sched_walt_cpu_load *walt_load)
 	return cpu_util_freq_walt(cpu, walt_load);
 }
 
+/*
+ * Predicted load of @cpu for the next window at percentile @pct of the
+ * runnable tasks' busy bucket distributions. Quantiles are published at
+ * each window rollover in steps of 100 / NUM_PRED_QUANTILES percent and
+ * @pct is rounded up to the next published quantile.
+ */
+static inline unsigned long walt_pred_lookahead(int cpu, unsigned int pct)
+{
+	int idx;
+
+	if (!pct)
+		return 0;
+
+	idx = DIV_ROUND_UP(min(pct, 100U) * NUM_PRED_QUANTILES, 100) - 1;
+
+	return READ_ONCE(cpu_rq(cpu)->pred_quantile_scaled[idx]);
+}
+
 #else
 
 static inline unsigned long cpu_util_rt(int cpu)
@@ -2238,6 +2285,11 @@ cpu_util_freq(int cpu, struct sched_walt_cpu_load *walt_load)
 	return min(cpu_util(cpu), capacity_orig_of(cpu));
 }
 
+static inline unsigned long walt_pred_lookahead(int cpu, unsigned int pct)
+{
+	return 0;
+}
+
 
 #define sched_ravg_window TICK_NSEC
 #define sysctl_sched_use_walt_cpu_util 0
@@ -2761,6 +2813,15 @@ struct related_thread_group {
 	struct sched_cluster *preferred_cluster;
 	struct rcu_head rcu;
 	u64 last_update;
+	u64 frame_period;
+	u64 frame_anchor;
+	/* Cluster the group is about to move to, see coloc_settle_cluster() */
+	struct sched_cluster *candidate_cluster;
+	u64 candidate_since;
+	/* Wakeups by a task of the same group, shown in schedtune */
+	atomic_long_t nr_wakeups;
+	atomic_long_t nr_cross_cluster_wakeups;
+	unsigned long nr_cluster_switches;
 };
 
 extern struct list_head cluster_head;
@@ -3054,6 +3115,7 @@ extern void clear_top_tasks_bitmap(unsigned long *bitmap);
 #if defined(CONFIG_SCHED_TUNE)
 extern bool task_sched_boost(struct task_struct *p);
 extern int sync_cgroup_colocation(struct task_struct *p, bool insert);
+extern void sched_coloc_stats_show(struct seq_file *m);
 extern bool schedtune_task_colocated(struct task_struct *p);
 extern void update_cgroup_boost_settings(void);
 extern void restore_cgroup_boost_settings(void);
@@ -3078,6 +3140,8 @@ extern int alloc_related_thread_groups(void);
 extern unsigned long all_cluster_ids[];
 
 extern void check_for_migration(struct rq *rq, struct task_struct *p);
+extern void check_misfit_fastpath(struct rq *rq, struct task_struct *p,
+				  u64 wallclock);
 
 static inline int is_reserved(int cpu)
 {
@@ -3302,3 +3366,49 @@ struct sched_avg_stats {
 	int nr_max;
 };
 extern void sched_get_nr_running_avg(struct sched_avg_stats *stats);
+
+#include <uapi/linux/sched_freq_trace.h>
+
+#ifdef CONFIG_SCHED_FREQ_TRACE
+struct sched_freq_ring {
+	struct sched_freq_rec *recs;
+	unsigned long head;
+	/* head at the previous snapshot, for lost record accounting */
+	unsigned long read;
+};
+
+DECLARE_PER_CPU(struct sched_freq_ring, sched_freq_ring);
+extern unsigned long sched_freq_ring_mask;
+
+/*
+ * Append a record to the ring of this CPU. Called with interrupts
+ * disabled, from the frequency update and WALT paths.
+ */
+static inline void sched_freq_trace(u8 event, int cpu, unsigned int freq,
+				    unsigned long util, unsigned long max,
+				    u16 reason)
+{
+	struct sched_freq_ring *ring = this_cpu_ptr(&sched_freq_ring);
+	struct sched_freq_rec *rec;
+	unsigned long head;
+
+	if (!ring->recs)
+		return;
+
+	head = ring->head;
+	rec = &ring->recs[head & sched_freq_ring_mask];
+	rec->time = sched_clock();
+	rec->freq = freq;
+	rec->util = util;
+	rec->max = max;
+	rec->reason = reason;
+	rec->event = event;
+	rec->cpu = cpu;
+	/* the snapshot trusts every record below head */
+	smp_store_release(&ring->head, head + 1);
+}
+#else
+static inline void sched_freq_trace(u8 event, int cpu, unsigned int freq,
+				    unsigned long util, unsigned long max,
+				    u16 reason) { }
+#endif
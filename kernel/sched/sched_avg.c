@@ -169,27 +169,36 @@ unsigned int sched_get_cpu_util(int cpu)
 	struct rq *rq = cpu_rq(cpu);
 	u64 util;
 	unsigned long capacity, flags;
-	unsigned int busy;
 
-	raw_spin_lock_irqsave(&rq->lock, flags);
-
-	util = rq->cfs.avg.util_avg;
 	capacity = capacity_orig_of(cpu);
 
 #ifdef CONFIG_SCHED_WALT
-	if (!walt_disabled && sysctl_sched_use_walt_cpu_util) {
-		util = rq->prev_runnable_sum + rq->grp_time.prev_runnable_sum;
-		util = div64_u64(util,
-				 sched_ravg_window >> SCHED_CAPACITY_SHIFT);
-	}
+	if (!walt_disabled && sysctl_sched_use_walt_cpu_util)
+		return sched_walt_load_to_util_pct(cpu,
+						   walt_get_cpu_prev_load(cpu));
 #endif
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	util = rq->cfs.avg.util_avg;
 	raw_spin_unlock_irqrestore(&rq->lock, flags);
 
 	util = (util >= capacity) ? capacity : util;
-	busy = div64_ul((util * 100), capacity);
-	return busy;
+	return div64_ul((util * 100), capacity);
 }
 
+#ifdef CONFIG_SCHED_WALT
+/* Convert a WALT window busy time of @cpu to a utilization percentage */
+unsigned int sched_walt_load_to_util_pct(int cpu, u64 load)
+{
+	unsigned long capacity = capacity_orig_of(cpu);
+	u64 util;
+
+	util = div64_u64(load, sched_ravg_window >> SCHED_CAPACITY_SHIFT);
+	util = (util >= capacity) ? capacity : util;
+
+	return div64_ul((util * 100), capacity);
+}
+#endif
+
 u64 sched_get_cpu_last_busy_time(int cpu)
 {
 	return atomic64_read(&per_cpu(last_busy_time, cpu));
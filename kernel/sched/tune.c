@@ -4,6 +4,7 @@
 #include <linux/percpu.h>
 #include <linux/printk.h>
 #include <linux/rcupdate.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 
 #include <trace/events/sched.h>
@@ -481,6 +482,13 @@ static int sched_colocate_write(struct cgroup_subsys_state *css,
 	return 0;
 }
 
+static int sched_colocate_stats_show(struct seq_file *m, void *v)
+{
+	sched_coloc_stats_show(m);
+
+	return 0;
+}
+
 bool schedtune_task_colocated(struct task_struct *p)
 {
 	struct schedtune *st;
@@ -542,6 +550,24 @@ void schedtune_dequeue_task(struct task_struct *p, int cpu)
 	raw_spin_unlock_irqrestore(&bg->lock, irq_flags);
 }
 
+/*
+ * System wide boost floor requested through the boost arbiter. It is
+ * applied on top of the cgroup boost values and only ever raises them.
+ */
+static int schedtune_boost_floor;
+
+void schedtune_set_boost_floor(int boost)
+{
+	WRITE_ONCE(schedtune_boost_floor, clamp(boost, 0, 100));
+}
+
+static inline int schedtune_apply_floor(int boost)
+{
+	int floor = READ_ONCE(schedtune_boost_floor);
+
+	return floor > boost ? floor : boost;
+}
+
 int schedtune_cpu_boost(int cpu)
 {
 	struct boost_groups *bg;
@@ -554,7 +580,7 @@ int schedtune_cpu_boost(int cpu)
 	if (schedtune_boost_timeout(now, bg->boost_ts))
 		schedtune_cpu_update(cpu, now);
 
-	return bg->boost_max;
+	return schedtune_apply_floor(bg->boost_max);
 }
 
 int schedtune_task_boost(struct task_struct *p)
@@ -571,7 +597,7 @@ int schedtune_task_boost(struct task_struct *p)
 	task_boost = st->boost;
 	rcu_read_unlock();
 
-	return task_boost;
+	return schedtune_apply_floor(task_boost);
 }
 
 int schedtune_prefer_idle(struct task_struct *p)
@@ -703,6 +729,10 @@ static struct cftype files[] = {
 		.read_u64 = sched_colocate_read,
 		.write_u64 = sched_colocate_write,
 	},
+	{
+		.name = "colocate_stats",
+		.seq_show = sched_colocate_stats_show,
+	},
 #endif
 	{
 		.name = "boost",
@@ -21,6 +21,8 @@ int schedtune_prefer_high_cap(struct task_struct *tsk);
 void schedtune_enqueue_task(struct task_struct *p, int cpu);
 void schedtune_dequeue_task(struct task_struct *p, int cpu);
 
+void schedtune_set_boost_floor(int boost);
+
 #else /* CONFIG_SCHED_TUNE */
 
 #define schedtune_cpu_boost(cpu)  0
@@ -32,4 +34,6 @@ void schedtune_dequeue_task(struct task_struct *p, int cpu);
 #define schedtune_enqueue_task(task, cpu) do { } while (0)
 #define schedtune_dequeue_task(task, cpu) do { } while (0)
 
+#define schedtune_set_boost_floor(boost) do { } while (0)
+
 #endif /* CONFIG_SCHED_TUNE */
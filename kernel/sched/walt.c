@@ -22,6 +22,7 @@
 #include <linux/syscore_ops.h>
 #include <linux/cpufreq.h>
 #include <linux/list_sort.h>
+#include <linux/seq_file.h>
 #include <linux/jiffies.h>
 #include <linux/sched/core_ctl.h>
 #include <linux/sched/stat.h>
@@ -111,6 +112,93 @@ static void release_rq_locks_irqrestore(const cpumask_t *cpus,
 	local_irq_restore(*flags);
 }
 
+/*
+ * Publish the previous window busy time of @rq for lockless readers. Must
+ * be called with rq->lock held whenever the previous window counters of
+ * @rq change in a way that matters to cluster-wide load evaluation.
+ */
+static inline void walt_publish_window_snapshot(struct rq *rq)
+{
+	struct walt_window_snapshot *snap = &rq->wsnap;
+
+	lockdep_assert_held(&rq->lock);
+
+	write_seqcount_begin(&snap->seq);
+	snap->window_start = rq->window_start;
+	snap->prev_runnable_sum = rq->prev_runnable_sum;
+	snap->nt_prev_runnable_sum = rq->nt_prev_runnable_sum;
+	snap->grp_prev_runnable_sum = rq->grp_time.prev_runnable_sum;
+	write_seqcount_end(&snap->seq);
+}
+
+static unsigned int walt_read_window_snapshot(int cpu, u64 *window_start,
+					      u64 *load)
+{
+	struct walt_window_snapshot *snap = &cpu_rq(cpu)->wsnap;
+	unsigned int seq, retries = 0;
+
+	for (;;) {
+		seq = read_seqcount_begin(&snap->seq);
+		*window_start = snap->window_start;
+		*load = snap->prev_runnable_sum + snap->grp_prev_runnable_sum;
+		if (!read_seqcount_retry(&snap->seq, seq))
+			break;
+		retries++;
+	}
+
+	return retries;
+}
+
+/* Previous window busy time of @cpu, read without its rq lock */
+u64 walt_get_cpu_prev_load(int cpu)
+{
+	u64 ws, load;
+	unsigned int retries;
+
+	retries = walt_read_window_snapshot(cpu, &ws, &load);
+	if (unlikely(retries))
+		trace_walt_window_snapshot_retry(cpu, retries, 0);
+
+	return load;
+}
+
+#define WALT_SNAPSHOT_MAX_PASSES	3
+
+/*
+ * Read the previous window busy time of all CPUs in @cpus into @loads, in
+ * cpumask order, without taking any rq lock. The view is consistent when
+ * all CPUs published the same window; if a window rollover races with the
+ * read, the whole cluster is read again, up to WALT_SNAPSHOT_MAX_PASSES
+ * times. Returns the number of CPUs read.
+ */
+int walt_get_cluster_prev_load(const struct cpumask *cpus, u64 *loads)
+{
+	unsigned int seq_retries = 0, passes = 0;
+	u64 ws, first_ws = 0;
+	bool consistent;
+	int cpu, i;
+
+	do {
+		consistent = true;
+		i = 0;
+		for_each_cpu(cpu, cpus) {
+			seq_retries += walt_read_window_snapshot(cpu, &ws,
+								 &loads[i]);
+			if (!i)
+				first_ws = ws;
+			else if (ws != first_ws)
+				consistent = false;
+			i++;
+		}
+	} while (!consistent && ++passes < WALT_SNAPSHOT_MAX_PASSES);
+
+	if (unlikely(seq_retries || passes))
+		trace_walt_window_snapshot_retry(cpumask_first(cpus),
+						 seq_retries, passes);
+
+	return i;
+}
+
 #ifdef CONFIG_HZ_300
 /*
  * Tick interval becomes to 3333333 due to
@@ -329,6 +417,10 @@ update_window_start(struct rq *rq, u64 wallclock, int event)
 	rq->cum_window_demand_scaled =
 			rq->walt_stats.cumulative_runnable_avg_scaled;
 
+	sched_freq_trace(SCHED_FREQ_EV_WINDOW, cpu_of(rq),
+			 rq->cluster->cur_freq, rq->cum_window_demand_scaled,
+			 nr_windows, 0);
+
 	return old_window_start;
 }
 
@@ -515,9 +607,11 @@ u64 freq_policy_load(struct rq *rq)
 	u64 aggr_grp_load = cluster->aggr_grp_load;
 	u64 load, tt_load = 0;
 	u64 coloc_boost_load = cluster->coloc_boost_load;
+	u16 reason = 0;
 
 	if (rq->ed_task != NULL) {
 		load = sched_ravg_window;
+		reason = SCHED_FREQ_R_EARLY_DETECT;
 		goto done;
 	}
 
@@ -548,6 +642,8 @@ done:
 				load, reporting_policy, walt_rotation_enabled,
 				sysctl_sched_little_cluster_coloc_fmin_khz,
 				coloc_boost_load);
+	sched_freq_trace(SCHED_FREQ_EV_LOAD, cpu_of(rq), cluster->cur_freq,
+			 load, tt_load, reason);
 	return load;
 }
 
@@ -877,6 +973,9 @@ void fixup_busy_time(struct task_struct *p, int new_cpu)
 
 	migrate_top_tasks(p, src_rq, dest_rq);
 
+	walt_publish_window_snapshot(src_rq);
+	walt_publish_window_snapshot(dest_rq);
+
 	if (!same_freq_domain(new_cpu, task_cpu(p))) {
 		src_rq->notif_pending = true;
 		dest_rq->notif_pending = true;
@@ -930,6 +1029,8 @@ unsigned int min_possible_efficiency = UINT_MAX;
 
 unsigned int sysctl_sched_conservative_pl;
 unsigned int sysctl_sched_many_wakeup_threshold = 1000;
+/* Upmigrate misfit top-app tasks as soon as their window rolls over */
+unsigned int sysctl_sched_misfit_fastpath = 1;
 
 #define INC_STEP 8
 #define DEC_STEP 2
@@ -1384,6 +1485,8 @@ static void rollover_cpu_window(struct rq *rq, bool full_window)
 	rq->nt_curr_runnable_sum = 0;
 	rq->grp_time.curr_runnable_sum = 0;
 	rq->grp_time.nt_curr_runnable_sum = 0;
+
+	walt_publish_window_snapshot(rq);
 }
 
 /*
@@ -1785,6 +1888,74 @@ static u64 add_to_task_demand(struct rq *rq, struct task_struct *p, u64 delta)
 	return delta;
 }
 
+/*
+ * Frame-aligned demand accounting.
+ *
+ * A related thread group may carry a frame period supplied by userspace
+ * (typically the display vsync period). Tasks of such a group sample their
+ * busy time at frame boundaries instead of window boundaries, so that a
+ * frame straddling two windows is not split and under-reported. Each frame
+ * sample is normalized to the window size before it is pushed into the
+ * demand history, which keeps demand, pred_demand and the busy buckets in
+ * the same units as the rest of WALT.
+ *
+ * Frame boundaries are derived from the group's anchor (the last time
+ * userspace programmed the period) so no shared state is written here.
+ */
+#define MIN_SCHED_FRAME_PERIOD	(4 * NSEC_PER_MSEC)
+
+static inline u32 frame_to_window(u64 runtime, u64 period)
+{
+	return min_t(u64, div64_u64(runtime * sched_ravg_window, period),
+		     sched_ravg_window);
+}
+
+static u64 update_task_frame_demand(struct task_struct *p, struct rq *rq,
+				    struct related_thread_group *grp,
+				    int event, u64 wallclock)
+{
+	u64 mark_start = p->ravg.mark_start;
+	u64 period = READ_ONCE(grp->frame_period);
+	u64 frame_start = READ_ONCE(grp->frame_anchor);
+	u64 delta, runtime;
+	int new_frame, nr_full_frames;
+
+	if (wallclock > frame_start)
+		frame_start += div64_u64(wallclock - frame_start, period) *
+				period;
+
+	new_frame = mark_start < frame_start;
+	if (!account_busy_for_task_demand(rq, p, event)) {
+		if (new_frame)
+			update_history(rq, p,
+				       frame_to_window(p->ravg.sum, period),
+				       1, event);
+		return 0;
+	}
+
+	if (!new_frame)
+		return add_to_task_demand(rq, p, wallclock - mark_start);
+
+	delta = frame_start - mark_start;
+	nr_full_frames = div64_u64(delta, period);
+	frame_start -= (u64)nr_full_frames * period;
+
+	runtime = add_to_task_demand(rq, p, frame_start - mark_start);
+	update_history(rq, p, frame_to_window(p->ravg.sum, period), 1, event);
+	if (nr_full_frames) {
+		u64 scaled_frame = scale_exec_time(period, rq);
+
+		update_history(rq, p, frame_to_window(scaled_frame, period),
+			       nr_full_frames, event);
+		runtime += nr_full_frames * scaled_frame;
+	}
+
+	frame_start += (u64)nr_full_frames * period;
+	runtime += add_to_task_demand(rq, p, wallclock - frame_start);
+
+	return runtime;
+}
+
 /*
  * Account cpu demand of task and/or update task's cpu demand history
  *
@@ -1844,6 +2015,10 @@ static u64 update_task_demand(struct task_struct *p, struct rq *rq,
 	u32 window_size = sched_ravg_window;
 	u64 runtime;
 
+	if (p->grp && READ_ONCE(p->grp->frame_period))
+		return update_task_frame_demand(p, rq, p->grp, event,
+						wallclock);
+
 	new_window = mark_start < window_start;
 	if (!account_busy_for_task_demand(rq, p, event)) {
 		if (new_window)
@@ -1966,10 +2141,51 @@ static inline void run_walt_irq_work(u64 old_window_start, struct rq *rq)
 }
 
 /* Reflect task activity on its demand and cpu's busy time statistics */
+/*
+ * A task of a frame paced group that goes to sleep is expected back at
+ * the next frame boundary. Remember the earliest such boundary for the
+ * idle governor; stale hints are simply in the past.
+ */
+static void update_lpm_wakeup_hint(struct task_struct *p, struct rq *rq,
+				   int event, u64 wallclock)
+{
+	struct related_thread_group *grp = p->grp;
+	u64 period, next, hint;
+
+	if (event != PUT_PREV_TASK || p->on_rq || !grp)
+		return;
+
+	period = READ_ONCE(grp->frame_period);
+	if (!period)
+		return;
+
+	next = READ_ONCE(grp->frame_anchor);
+	if (wallclock >= next)
+		next += (div64_u64(wallclock - next, period) + 1) * period;
+
+	hint = rq->lpm_wakeup_hint;
+	if (hint > wallclock && hint < next)
+		return;
+
+	WRITE_ONCE(rq->lpm_wakeup_hint, next);
+}
+
+/*
+ * Expected wakeup time of @cpu in ns (ktime_get() clock) as seen by the
+ * scheduler, or 0 when there is no hint.
+ */
+u64 sched_lpm_wakeup_hint(int cpu)
+{
+	u64 hint = READ_ONCE(cpu_rq(cpu)->lpm_wakeup_hint);
+
+	return hint > sched_ktime_clock() ? hint : 0;
+}
+
 void update_task_ravg(struct task_struct *p, struct rq *rq, int event,
 						u64 wallclock, u64 irqtime)
 {
 	u64 old_window_start;
+	bool new_window;
 
 	if (!rq->window_start || sched_disable_window_stats ||
 	    p->ravg.mark_start == wallclock)
@@ -1984,10 +2200,16 @@ void update_task_ravg(struct task_struct *p, struct rq *rq, int event,
 		goto done;
 	}
 
+	new_window = p->ravg.mark_start < rq->window_start;
 	update_task_rq_cpu_cycles(p, rq, event, wallclock, irqtime);
 	update_task_demand(p, rq, event, wallclock);
 	update_cpu_busy_time(p, rq, event, wallclock, irqtime);
 	update_task_pred_demand(rq, p, event);
+	update_lpm_wakeup_hint(p, rq, event, wallclock);
+
+	/* The demand of p was just rolled over, it may not fit any more */
+	if (new_window && p == rq->curr && sysctl_sched_misfit_fastpath)
+		check_misfit_fastpath(rq, p, wallclock);
 
 	if (exiting_task(p))
 		goto done;
@@ -2030,6 +2252,7 @@ void init_new_task_load(struct task_struct *p)
 	INIT_LIST_HEAD(&p->grp_list);
 	memset(&p->ravg, 0, sizeof(struct ravg));
 	p->cpu_cycles = 0;
+	p->misfit_start = 0;
 
 	p->ravg.curr_window_cpu = kcalloc(nr_cpu_ids, sizeof(u32),
 					  GFP_KERNEL | __GFP_NOFAIL);
@@ -2534,6 +2757,9 @@ unsigned int __read_mostly sysctl_sched_group_upmigrate_pct = 100;
 unsigned int __read_mostly sched_group_downmigrate = 19000000;
 unsigned int __read_mostly sysctl_sched_group_downmigrate_pct = 95;
 
+/* How long a colocated group must want another cluster before it moves */
+unsigned int __read_mostly sysctl_sched_coloc_migration_cost_ns = 4000000;
+
 static int
 group_will_fit(struct sched_cluster *cluster, struct related_thread_group *grp,
 						u64 demand, bool group_boost)
@@ -2584,6 +2810,41 @@ static struct sched_cluster *best_cluster(struct related_thread_group *grp,
 	return last_best_cluster;
 }
 
+/*
+ * Moving a colocated group to another cluster throws away the cache it has
+ * built up on the old one, and while its tasks follow the new preference
+ * one wakeup at a time the group is split across both. Only move once the
+ * other cluster has stayed the best choice for
+ * sysctl_sched_coloc_migration_cost_ns, so a short burst doesn't bounce the
+ * group between clusters. Boosted groups move right away.
+ */
+static struct sched_cluster *
+coloc_settle_cluster(struct related_thread_group *grp,
+		     struct sched_cluster *best, bool group_boost, u64 now)
+{
+	struct sched_cluster *prev = grp->preferred_cluster;
+
+	if (!prev || best == prev || group_boost ||
+	    !sysctl_sched_coloc_migration_cost_ns)
+		goto move;
+
+	if (best != grp->candidate_cluster) {
+		grp->candidate_cluster = best;
+		grp->candidate_since = now;
+		return prev;
+	}
+
+	if (now - grp->candidate_since < sysctl_sched_coloc_migration_cost_ns)
+		return prev;
+
+move:
+	grp->candidate_cluster = NULL;
+	if (prev && best != prev)
+		grp->nr_cluster_switches++;
+
+	return best;
+}
+
 int preferred_cluster(struct sched_cluster *cluster, struct task_struct *p)
 {
 	struct related_thread_group *grp;
@@ -2633,8 +2894,9 @@ static void _set_preferred_cluster(struct related_thread_group *grp)
 		combined_demand += p->ravg.coloc_demand;
 	}
 
-	grp->preferred_cluster = best_cluster(grp,
-			combined_demand, group_boost);
+	grp->preferred_cluster = coloc_settle_cluster(grp,
+			best_cluster(grp, combined_demand, group_boost),
+			group_boost, wallclock);
 	grp->last_update = sched_ktime_clock();
 	trace_sched_set_preferred_cluster(grp, combined_demand);
 }
@@ -2737,6 +2999,9 @@ static void remove_task_from_group(struct task_struct *p)
 	if (!list_empty(&grp->tasks)) {
 		empty_group = 0;
 		_set_preferred_cluster(grp);
+	} else {
+		/* Do not leak the frame period to the next user of this id */
+		WRITE_ONCE(grp->frame_period, 0);
 	}
 
 	raw_spin_unlock(&grp->lock);
@@ -2868,6 +3133,60 @@ unsigned int sched_get_group_id(struct task_struct *p)
 	return group_id;
 }
 
+/*
+ * Program the frame period (in usec) of the group @p belongs to. Writing
+ * a period also re-anchors the frame boundaries to the current time, so
+ * userspace can keep the boundaries in phase with vsync by rewriting the
+ * period at a vsync edge. A period of 0 reverts the group to window based
+ * accounting.
+ */
+int sched_set_group_frame_period(struct task_struct *p, unsigned int period_us)
+{
+	struct related_thread_group *grp;
+	u64 period = (u64)period_us * NSEC_PER_USEC;
+	unsigned long flags;
+	int rc = 0;
+
+	if (period && (period < MIN_SCHED_FRAME_PERIOD ||
+		       period > sched_ravg_window))
+		return -EINVAL;
+
+	raw_spin_lock_irqsave(&p->pi_lock, flags);
+	read_lock(&related_thread_group_lock);
+
+	grp = p->grp;
+	if (!grp) {
+		rc = -EINVAL;
+		goto done;
+	}
+
+	raw_spin_lock(&grp->lock);
+	WRITE_ONCE(grp->frame_anchor, sched_ktime_clock());
+	WRITE_ONCE(grp->frame_period, period);
+	raw_spin_unlock(&grp->lock);
+
+	trace_sched_set_group_frame_period(grp);
+done:
+	read_unlock(&related_thread_group_lock);
+	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+
+	return rc;
+}
+
+unsigned int sched_get_group_frame_period(struct task_struct *p)
+{
+	unsigned int period_us;
+	struct related_thread_group *grp;
+
+	rcu_read_lock();
+	grp = task_related_thread_group(p);
+	period_us = grp ? div64_u64(READ_ONCE(grp->frame_period),
+				    NSEC_PER_USEC) : 0;
+	rcu_read_unlock();
+
+	return period_us;
+}
+
 #if defined(CONFIG_SCHED_TUNE)
 /*
  * We create a default colocation group at boot. There is no need to
@@ -2901,6 +3220,23 @@ int sync_cgroup_colocation(struct task_struct *p, bool insert)
 
 	return __sched_set_group_id(p, grp_id);
 }
+
+void sched_coloc_stats_show(struct seq_file *m)
+{
+	struct related_thread_group *grp;
+	struct sched_cluster *cluster;
+
+	grp = lookup_related_thread_group(DEFAULT_CGROUP_COLOC_ID);
+	cluster = READ_ONCE(grp->preferred_cluster);
+
+	seq_printf(m, "preferred_cpu %d\n",
+		   cluster ? cluster_first_cpu(cluster) : -1);
+	seq_printf(m, "wakeups %ld\n", atomic_long_read(&grp->nr_wakeups));
+	seq_printf(m, "cross_cluster_wakeups %ld\n",
+		   atomic_long_read(&grp->nr_cross_cluster_wakeups));
+	seq_printf(m, "cluster_switches %lu\n",
+		   READ_ONCE(grp->nr_cluster_switches));
+}
 #endif
 
 void update_cpu_cluster_capacity(const cpumask_t *cpus)
@@ -3096,6 +3432,7 @@ static void transfer_busy_time(struct rq *rq, struct related_thread_group *grp,
 	p->ravg.prev_window_cpu[cpu] = p->ravg.prev_window;
 
 	trace_sched_migration_update_sum(p, migrate_type, rq);
+	walt_publish_window_snapshot(rq);
 
 	BUG_ON((s64)*src_curr_runnable_sum < 0);
 	BUG_ON((s64)*src_prev_runnable_sum < 0);
@@ -3172,6 +3509,65 @@ done:
  * Runs in hard-irq context. This should ideally run just after the latest
  * window roll-over.
  */
+/*
+ * Predicted busy time of @p at each decile of its busy bucket distribution.
+ * Each quantile is the upper edge of the first bucket at which the
+ * cumulative bucket count reaches the quantile. Tasks without history
+ * predict their current pred_demand at every quantile.
+ */
+static void task_pred_quantiles(struct task_struct *p, u32 *quantiles)
+{
+	u8 *buckets = p->ravg.busy_buckets;
+	u32 total = 0, cum = 0;
+	int i, j = 0;
+
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++)
+		total += buckets[i];
+
+	if (!total || is_new_task(p)) {
+		for (j = 0; j < NUM_PRED_QUANTILES; j++)
+			quantiles[j] = p->ravg.pred_demand_scaled;
+		return;
+	}
+
+	for (i = 0; i < NUM_BUSY_BUCKETS && j < NUM_PRED_QUANTILES; i++) {
+		u32 edge;
+
+		cum += buckets[i];
+		edge = scale_demand(mult_frac(i + 1, max_task_load(),
+					      NUM_BUSY_BUCKETS));
+		while (j < NUM_PRED_QUANTILES &&
+		       cum * NUM_PRED_QUANTILES >= total * (j + 1))
+			quantiles[j++] = edge;
+	}
+}
+
+/*
+ * Publish the predicted load distribution of the runnable CFS tasks on
+ * @rq for the window that is just starting. The per-task quantiles are
+ * summed, which assumes the tasks peak together and errs on the side of
+ * performance. Called with the rq lock held at window rollover.
+ */
+static void walt_update_pred_quantiles(struct rq *rq)
+{
+	u32 sum[NUM_PRED_QUANTILES] = { 0 };
+	u32 quantiles[NUM_PRED_QUANTILES];
+	struct task_struct *p;
+	int i;
+
+	if (!sched_predl)
+		return;
+
+	list_for_each_entry(p, &rq->cfs_tasks, se.group_node) {
+		task_pred_quantiles(p, quantiles);
+		for (i = 0; i < NUM_PRED_QUANTILES; i++)
+			sum[i] += quantiles[i];
+	}
+
+	for (i = 0; i < NUM_PRED_QUANTILES; i++)
+		WRITE_ONCE(rq->pred_quantile_scaled[i], sum[i]);
+}
+
 void walt_irq_work(struct irq_work *irq_work)
 {
 	struct sched_cluster *cluster;
@@ -3209,6 +3605,9 @@ void walt_irq_work(struct irq_work *irq_work)
 				account_load_subtractions(rq);
 				aggr_grp_load += rq->grp_time.prev_runnable_sum;
 			}
+			walt_publish_window_snapshot(rq);
+			if (!is_migration)
+				walt_update_pred_quantiles(rq);
 		}
 
 		cluster->aggr_grp_load = aggr_grp_load;
@@ -3402,6 +3801,7 @@ void walt_sched_init_rq(struct rq *rq)
 	rq->curr_table = 0;
 	rq->prev_top = 0;
 	rq->curr_top = 0;
+	seqcount_init(&rq->wsnap.seq);
 	rq->last_cc_update = 0;
 	rq->cycles = 0;
 	for (j = 0; j < NUM_TRACKED_WINDOWS; j++) {
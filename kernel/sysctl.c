@@ -58,6 +58,7 @@
 #include <linux/kprobes.h>
 #include <linux/pipe_fs_i.h>
 #include <linux/oom.h>
+#include <linux/reclaim_class.h>
 #include <linux/kmod.h>
 #include <linux/capability.h>
 #include <linux/binfmts.h>
@@ -121,6 +122,7 @@ static int sixty = 60;
 
 static int __maybe_unused neg_one = -1;
 static int __maybe_unused neg_three = -3;
+static int __maybe_unused neg_one_thousand = -1000;
 
 static int zero;
 static int __maybe_unused one = 1;
@@ -142,6 +144,9 @@ static int ten_thousand = 10000;
 static int six_hundred_forty_kb = 640 * 1024;
 #endif
 static int two_hundred_fifty_five = 255;
+#ifdef CONFIG_PCP_AUTOTUNE
+static int sixty_four = 64;
+#endif
 
 /* this is needed for the proc_doulongvec_minmax of vm_dirty_bytes */
 static unsigned long dirty_bytes_min = 2 * PAGE_SIZE;
@@ -384,6 +389,14 @@ static struct ctl_table kern_table[] = {
 		.extra1		= &zero,
 		.extra2		= &sysctl_sched_group_upmigrate_pct,
 	},
+	{
+		.procname	= "sched_coloc_migration_cost_ns",
+		.data		= &sysctl_sched_coloc_migration_cost_ns,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 	{
 		.procname	= "sched_boost",
 		.data		= &sysctl_sched_boost,
@@ -411,6 +424,15 @@ static struct ctl_table kern_table[] = {
 		.extra1		= &two,
 		.extra2		= &one_thousand,
 	},
+	{
+		.procname	= "sched_misfit_fastpath",
+		.data		= &sysctl_sched_misfit_fastpath,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 	{
 		.procname	= "sched_walt_rotate_big_tasks",
 		.data		= &sysctl_sched_walt_rotate_big_tasks,
@@ -511,6 +533,23 @@ static struct ctl_table kern_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec,
 	},
+	{
+		.procname	= "sched_wake_cache_ns",
+		.data		= &sysctl_sched_wake_cache_ns,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "sched_wake_cache_util",
+		.data		= &sysctl_sched_wake_cache_util,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one_thousand,
+	},
 	{
 		.procname	= "sched_cstate_aware",
 		.data		= &sysctl_sched_cstate_aware,
@@ -1607,6 +1646,44 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &zero,
 		.extra2		= &one_hundred,
 	},
+#ifdef CONFIG_RECLAIM_CLASS
+	{
+		.procname	= "reclaim_class_enable",
+		.data		= &sysctl_reclaim_class_enable,
+		.maxlen		= sizeof(sysctl_reclaim_class_enable),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+	{
+		.procname	= "reclaim_class_foreground_adj",
+		.data		= &sysctl_reclaim_class_foreground_adj,
+		.maxlen		= sizeof(sysctl_reclaim_class_foreground_adj),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &neg_one_thousand,
+		.extra2		= &one_thousand,
+	},
+	{
+		.procname	= "reclaim_class_cached_adj",
+		.data		= &sysctl_reclaim_class_cached_adj,
+		.maxlen		= sizeof(sysctl_reclaim_class_cached_adj),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &neg_one_thousand,
+		.extra2		= &one_thousand,
+	},
+	{
+		.procname	= "reclaim_class_kswapd_swappiness",
+		.data		= &sysctl_reclaim_class_kswapd_swappiness,
+		.maxlen		= sizeof(sysctl_reclaim_class_kswapd_swappiness),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &neg_one,
+		.extra2		= &one_hundred,
+	},
+#endif
 	{
 		.procname       = "want_old_faultaround_pte",
 		.data           = &want_old_faultaround_pte,
@@ -1732,6 +1809,26 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_fraction_sysctl_handler,
 		.extra1		= &zero,
 	},
+#ifdef CONFIG_PCP_AUTOTUNE
+	{
+		.procname	= "percpu_pagelist_autotune",
+		.data		= &percpu_pagelist_autotune,
+		.maxlen		= sizeof(percpu_pagelist_autotune),
+		.mode		= 0644,
+		.proc_handler	= percpu_pagelist_autotune_sysctl_handler,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+	{
+		.procname	= "percpu_pagelist_scale_max",
+		.data		= &percpu_pagelist_scale_max,
+		.maxlen		= sizeof(percpu_pagelist_scale_max),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &sixty_four,
+	},
+#endif
 #ifdef CONFIG_MMU
 	{
 		.procname	= "max_map_count",
@@ -1944,6 +2041,15 @@ static struct ctl_table vm_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec_minmax,
 	},
+	{
+		.procname	= "swap_ratio_placement",
+		.data		= &sysctl_swap_ratio_placement,
+		.maxlen		= sizeof(sysctl_swap_ratio_placement),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 #endif
 	{ }
 };
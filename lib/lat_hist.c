@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per-CPU latency histograms for hot paths, see include/linux/lat_hist.h
+ */
+
+#include <linux/debugfs.h>
+#include <linux/export.h>
+#include <linux/lat_hist.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+DEFINE_STATIC_KEY_FALSE(lat_hist_key);
+EXPORT_SYMBOL_GPL(lat_hist_key);
+
+static DEFINE_MUTEX(lat_hist_mutex);
+static struct dentry *lat_hist_dir;
+
+static unsigned int lat_hist_bucket(u64 ns)
+{
+	unsigned int shift;
+
+	if (ns < LAT_HIST_SUB)
+		return ns;
+
+	shift = fls64(ns) - 1 - LAT_HIST_SUB_SHIFT;
+	return min_t(unsigned int, (shift + 1) * LAT_HIST_SUB +
+		     ((ns >> shift) & (LAT_HIST_SUB - 1)), LAT_HIST_BUCKETS - 1);
+}
+
+/* Lower bound of the values counted in bucket @b */
+static u64 lat_hist_bucket_ns(unsigned int b)
+{
+	unsigned int shift;
+
+	if (b < LAT_HIST_SUB)
+		return b;
+
+	shift = b / LAT_HIST_SUB - 1;
+	return (u64)(LAT_HIST_SUB + b % LAT_HIST_SUB) << shift;
+}
+
+void lat_hist_record(struct lat_hist *h, u64 ns)
+{
+	struct lat_hist_cpu __percpu *pc = READ_ONCE(h->cpu);
+
+	if (!pc)
+		return;
+
+	this_cpu_inc(pc->buckets[lat_hist_bucket(ns)]);
+	this_cpu_add(pc->sum, ns);
+	/* racy against preemption, a lost update only lowers max */
+	if (ns > this_cpu_read(pc->max))
+		this_cpu_write(pc->max, ns);
+}
+EXPORT_SYMBOL_GPL(lat_hist_record);
+
+static int lat_hist_show(struct seq_file *s, void *unused)
+{
+	static const unsigned int pct[] = { 500, 900, 990, 999 };
+	struct lat_hist *h = s->private;
+	u64 total = 0, seen = 0, sum = 0, max = 0, val[ARRAY_SIZE(pct)] = { 0 };
+	unsigned int b, p = 0;
+	u64 *hist;
+	int cpu;
+
+	hist = kcalloc(LAT_HIST_BUCKETS, sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct lat_hist_cpu *c = per_cpu_ptr(h->cpu, cpu);
+
+		for (b = 0; b < LAT_HIST_BUCKETS; b++)
+			hist[b] += READ_ONCE(c->buckets[b]);
+		sum += READ_ONCE(c->sum);
+		max = max(max, READ_ONCE(c->max));
+	}
+
+	for (b = 0; b < LAT_HIST_BUCKETS; b++)
+		total += hist[b];
+
+	for (b = 0; b < LAT_HIST_BUCKETS && total; b++) {
+		seen += hist[b];
+		while (p < ARRAY_SIZE(pct) && seen * 1000 >= total * pct[p])
+			val[p++] = lat_hist_bucket_ns(b);
+	}
+
+	seq_printf(s, "count: %llu\nmean_ns: %llu\n", total,
+		   total ? div64_u64(sum, total) : 0);
+	seq_printf(s, "p50_ns: %llu\np90_ns: %llu\np99_ns: %llu\np99.9_ns: %llu\n",
+		   val[0], val[1], val[2], val[3]);
+	seq_printf(s, "max_ns: %llu\n", max);
+
+	/* lower bound of each non-empty bucket and its count */
+	for (b = 0; b < LAT_HIST_BUCKETS; b++)
+		if (hist[b])
+			seq_printf(s, "%llu %llu\n", lat_hist_bucket_ns(b),
+				   hist[b]);
+
+	kfree(hist);
+	return 0;
+}
+
+static int lat_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lat_hist_show, inode->i_private);
+}
+
+static ssize_t lat_hist_reset(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct lat_hist *h = ((struct seq_file *)file->private_data)->private;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(h->cpu, cpu), 0, sizeof(struct lat_hist_cpu));
+
+	return count;
+}
+
+static const struct file_operations lat_hist_fops = {
+	.open		= lat_hist_open,
+	.read		= seq_read,
+	.write		= lat_hist_reset,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int lat_hist_enable_get(void *data, u64 *val)
+{
+	*val = static_key_enabled(&lat_hist_key);
+	return 0;
+}
+
+static int lat_hist_enable_set(void *data, u64 val)
+{
+	if (val)
+		static_branch_enable(&lat_hist_key);
+	else
+		static_branch_disable(&lat_hist_key);
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(lat_hist_enable_fops, lat_hist_enable_get,
+			lat_hist_enable_set, "%llu\n");
+
+/**
+ * lat_hist_register() - Allocate a histogram and show it in debugfs
+ * @h: histogram from DEFINE_LAT_HIST()
+ *
+ * Until this succeeds, recording to @h is a no-op. Registering @h again
+ * does nothing.
+ */
+int lat_hist_register(struct lat_hist *h)
+{
+	struct lat_hist_cpu __percpu *pc;
+
+	pc = alloc_percpu(struct lat_hist_cpu);
+	if (!pc)
+		return -ENOMEM;
+
+	mutex_lock(&lat_hist_mutex);
+	if (h->cpu) {
+		mutex_unlock(&lat_hist_mutex);
+		free_percpu(pc);
+		return 0;
+	}
+	if (!lat_hist_dir) {
+		lat_hist_dir = debugfs_create_dir("lat_hist", NULL);
+		if (!IS_ERR_OR_NULL(lat_hist_dir))
+			debugfs_create_file("enable", 0600, lat_hist_dir, NULL,
+					    &lat_hist_enable_fops);
+	}
+	if (!IS_ERR_OR_NULL(lat_hist_dir))
+		h->dentry = debugfs_create_file(h->name, 0600, lat_hist_dir,
+						h, &lat_hist_fops);
+	smp_store_release(&h->cpu, pc);
+	mutex_unlock(&lat_hist_mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lat_hist_register);
+
+/**
+ * lat_hist_unregister() - Remove a histogram and free its counters
+ * @h: histogram passed to lat_hist_register()
+ *
+ * The caller must make sure nothing records to @h any more.
+ */
+void lat_hist_unregister(struct lat_hist *h)
+{
+	struct lat_hist_cpu __percpu *pc;
+
+	mutex_lock(&lat_hist_mutex);
+	pc = h->cpu;
+	if (!pc) {
+		mutex_unlock(&lat_hist_mutex);
+		return;
+	}
+	debugfs_remove(h->dentry);
+	h->dentry = NULL;
+	WRITE_ONCE(h->cpu, NULL);
+	mutex_unlock(&lat_hist_mutex);
+
+	free_percpu(pc);
+}
+EXPORT_SYMBOL_GPL(lat_hist_unregister);
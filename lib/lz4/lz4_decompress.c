@@ -40,6 +40,21 @@
 #include <linux/kernel.h>
 #include <asm/unaligned.h>
 
+#if defined(CONFIG_LZ4_DECOMPRESS_NEON) && !defined(STATIC)
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/*
+ * Blocks smaller than neon_min_size do not win back the cost of saving
+ * the FP/SIMD state. Contexts that may not use NEON take the generic path.
+ */
+static bool lz4_neon = true;
+module_param_named(neon, lz4_neon, bool, 0644);
+
+static unsigned int lz4_neon_min_size = 1024;
+module_param_named(neon_min_size, lz4_neon_min_size, uint, 0644);
+#endif
+
 /*-*****************************
  *	Decompression functions
  *******************************/
@@ -458,7 +473,7 @@ _output_error:
 	return (int) (-(((const char *)ip) - src)) - 1;
 }
 
-int LZ4_decompress_safe(const char *source, char *dest,
+int LZ4_decompress_safe_generic(const char *source, char *dest,
 	int compressedSize, int maxDecompressedSize)
 {
 	return LZ4_decompress_generic(source, dest,
@@ -467,6 +482,26 @@ int LZ4_decompress_safe(const char *source, char *dest,
 				      noDict, (BYTE *)dest, NULL, 0);
 }
 
+int LZ4_decompress_safe(const char *source, char *dest,
+	int compressedSize, int maxDecompressedSize)
+{
+#if defined(CONFIG_LZ4_DECOMPRESS_NEON) && !defined(STATIC)
+	int ret;
+
+	if (READ_ONCE(lz4_neon) &&
+	    maxDecompressedSize >= READ_ONCE(lz4_neon_min_size) &&
+	    may_use_simd()) {
+		kernel_neon_begin();
+		ret = LZ4_decompress_safe_neon(source, dest, compressedSize,
+					       maxDecompressedSize);
+		kernel_neon_end();
+		return ret;
+	}
+#endif
+	return LZ4_decompress_safe_generic(source, dest, compressedSize,
+					   maxDecompressedSize);
+}
+
 #if 0
 static int LZ4_decompress_safe_partial(const char *src, char *dst,
 	int compressedSize, int targetOutputSize, int dstCapacity)
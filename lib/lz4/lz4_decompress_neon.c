@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * LZ4 block decompression with NEON
+ *
+ * Decodes the same format with the same bounds checks as the safe, full
+ * block instance of LZ4_decompress_generic(), which is what zram, f2fs and
+ * the crypto API use. Literals and matches are copied 16 bytes at a time.
+ * Matches closer than 16 bytes, which the generic code widens 4 bytes at a
+ * time, have their pattern replicated across a vector with a table lookup
+ * and are stored 16 bytes at a time as well. Where a wide copy could run
+ * past the end of either buffer, exact copies are used instead.
+ *
+ * Like the NEON RAID6 code, this file is built with the FP/SIMD registers
+ * enabled and must not include kernel headers. The caller holds
+ * kernel_neon_begin().
+ */
+
+#include <arm_neon.h>
+#include <stddef.h>
+
+#define MINMATCH	4
+#define LASTLITERALS	5
+#define MFLIMIT		12
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_MASK	((1U << (8 - ML_BITS)) - 1)
+
+/* Lane i of a match @offset bytes back holds the byte at i % offset */
+static const uint8_t lz4_neon_pattern[16][16] = {
+	{ 0 },	/* offset 0 is invalid */
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+	{ 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+	{ 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0 },
+	{ 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 0, 1, 2, 3, 4, 5, 6, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 2, 3, 4, 5, 6 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 1, 2, 3, 4 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0, 1, 2 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0 },
+};
+
+/*
+ * The largest multiple of the offset that fits a vector: storing the same
+ * pattern vector this far apart keeps the output periodic.
+ */
+static const uint8_t lz4_neon_step[16] = {
+	0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15,
+};
+
+int LZ4_decompress_safe_neon(const char *source, char *dest,
+			     int compressedSize, int maxDecompressedSize)
+{
+	const uint8_t *ip = (const uint8_t *)source;
+	const uint8_t *const iend = ip + compressedSize;
+	uint8_t *op = (uint8_t *)dest;
+	uint8_t *const oend = op + maxDecompressedSize;
+
+	if (maxDecompressedSize == 0)
+		return (compressedSize == 1 && *ip == 0) ? 0 : -1;
+	if (compressedSize == 0)
+		return -1;
+
+	for (;;) {
+		unsigned int token = *ip++;
+		size_t length = token >> ML_BITS;
+		const uint8_t *match;
+		size_t offset;
+		uint8_t *cpy;
+
+		/* literal length */
+		if (length == RUN_MASK) {
+			unsigned int s;
+
+			if (ip >= iend - RUN_MASK)
+				goto out_error;
+			do {
+				s = *ip++;
+				length += s;
+			} while (ip < iend - RUN_MASK && s == 255);
+
+			if ((uintptr_t)op + length < (uintptr_t)op ||
+			    (uintptr_t)ip + length < (uintptr_t)ip)
+				goto out_error;
+		}
+
+		/* literals */
+		cpy = op + length;
+		if (cpy > oend - MFLIMIT ||
+		    ip + length > iend - (2 + 1 + LASTLITERALS)) {
+			/* the last literals must end both buffers */
+			if (ip + length != iend || cpy > oend)
+				goto out_error;
+			__builtin_memmove(op, ip, length);
+			op += length;
+			break;
+		}
+
+		if (cpy <= oend - 16 && ip + length <= iend - 16) {
+			const uint8_t *s = ip;
+			uint8_t *d = op;
+
+			do {
+				vst1q_u8(d, vld1q_u8(s));
+				d += 16;
+				s += 16;
+			} while (d < cpy);
+		} else {
+			__builtin_memcpy(op, ip, length);
+		}
+		ip += length;
+		op = cpy;
+
+		/* offset, which must stay within the output */
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - (uint8_t *)dest))
+			goto out_error;
+		match = op - offset;
+
+		/* match length */
+		length = token & ML_MASK;
+		if (length == ML_MASK) {
+			unsigned int s;
+
+			do {
+				s = *ip++;
+				if (ip > iend - LASTLITERALS)
+					goto out_error;
+				length += s;
+			} while (s == 255);
+
+			if ((uintptr_t)op + length < (uintptr_t)op)
+				goto out_error;
+		}
+		length += MINMATCH;
+		cpy = op + length;
+
+		/* too close to the end for a wide store, copy exactly */
+		if (cpy > oend - 16) {
+			/* the last LASTLITERALS bytes must be literals */
+			if (cpy > oend - LASTLITERALS)
+				goto out_error;
+			while (op < cpy)
+				*op++ = *match++;
+			continue;
+		}
+
+		if (offset >= 16) {
+			do {
+				vst1q_u8(op, vld1q_u8(match));
+				op += 16;
+				match += 16;
+			} while (op < cpy);
+		} else {
+			/* bytes past op that are loaded here are never used */
+			uint8x16_t v = vqtbl1q_u8(vld1q_u8(match),
+					vld1q_u8(lz4_neon_pattern[offset]));
+			size_t step = lz4_neon_step[offset];
+
+			do {
+				vst1q_u8(op, v);
+				op += step;
+			} while (op < cpy);
+		}
+		op = cpy;
+	}
+
+	return (int)(op - (uint8_t *)dest);
+
+out_error:
+	return (int)(-(((const char *)ip) - source)) - 1;
+}
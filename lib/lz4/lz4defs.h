@@ -242,4 +242,14 @@ typedef enum { decode_full_block = 0, partial_decode = 1 } earlyEnd_directive;
 
 #define LZ4_STATIC_ASSERT(c)	BUILD_BUG_ON(!(c))
 
+/* LZ4_decompress_safe() without the NEON dispatch */
+int LZ4_decompress_safe_generic(const char *source, char *dest,
+	int compressedSize, int maxDecompressedSize);
+
+#ifdef CONFIG_LZ4_DECOMPRESS_NEON
+/* Same as LZ4_decompress_safe(), the caller holds kernel_neon_begin() */
+int LZ4_decompress_safe_neon(const char *source, char *dest,
+	int compressedSize, int maxDecompressedSize);
+#endif
+
 #endif
@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * LZ4 decompression self test and benchmark
+ *
+ * Compresses 4K and 16K blocks of text-like, periodic, zero and random
+ * data. Every decompression path must return the input exactly. It must
+ * also reject truncated input, and an output buffer one byte too small,
+ * without writing past that buffer. Each path is then timed on the same
+ * blocks.
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lz4.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#ifdef CONFIG_LZ4_DECOMPRESS_NEON
+#include <asm/neon.h>
+#endif
+
+#include "lz4defs.h"
+
+#define LZ4TEST_LOOPS	1000
+#define LZ4TEST_GUARD	64
+
+enum {
+	LZ4TEST_TEXT,
+	LZ4TEST_PERIOD,
+	LZ4TEST_ZERO,
+	LZ4TEST_RANDOM,
+	LZ4TEST_NR,
+};
+
+static const char * const lz4test_kinds[LZ4TEST_NR] = {
+	"text", "period", "zero", "random",
+};
+
+static const int lz4test_sizes[] = { SZ_4K, SZ_16K };
+
+#ifdef CONFIG_LZ4_DECOMPRESS_NEON
+static int lz4test_neon(const char *src, char *dst, int slen, int dlen)
+{
+	int ret;
+
+	kernel_neon_begin();
+	ret = LZ4_decompress_safe_neon(src, dst, slen, dlen);
+	kernel_neon_end();
+
+	return ret;
+}
+#endif
+
+static const struct {
+	const char *name;
+	int (*decompress)(const char *src, char *dst, int slen, int dlen);
+} lz4test_paths[] = {
+	{ "default", LZ4_decompress_safe },
+	{ "generic", LZ4_decompress_safe_generic },
+#ifdef CONFIG_LZ4_DECOMPRESS_NEON
+	{ "neon", lz4test_neon },
+#endif
+};
+
+static void __init lz4test_fill(u8 *buf, int len, int kind,
+				struct rnd_state *rnd)
+{
+	static const char * const words[] = {
+		"the ", "page ", "cache ", "of ", "zram ", "swap ", "and ",
+		"f2fs ", "compressed ", "block ", "\n",
+	};
+	const char *w;
+	int i = 0, j, n, period;
+
+	switch (kind) {
+	case LZ4TEST_TEXT:
+		while (i < len) {
+			w = words[prandom_u32_state(rnd) % ARRAY_SIZE(words)];
+			n = min_t(int, strlen(w), len - i);
+			memcpy(buf + i, w, n);
+			i += n;
+		}
+		break;
+	case LZ4TEST_PERIOD:
+		/* runs repeating every 1 to 19 bytes, for overlapping matches */
+		while (i < len) {
+			period = 1 + prandom_u32_state(rnd) % 19;
+			n = min_t(int, 16 + prandom_u32_state(rnd) % 200, len - i);
+			prandom_bytes_state(rnd, buf + i, min(period, n));
+			for (j = period; j < n; j++)
+				buf[i + j] = buf[i + j - period];
+			i += n;
+		}
+		break;
+	case LZ4TEST_ZERO:
+		memset(buf, 0, len);
+		break;
+	default:
+		prandom_bytes_state(rnd, buf, len);
+		break;
+	}
+}
+
+static bool __init lz4test_guard_ok(const char *buf, int from, int to)
+{
+	for (; from < to; from++)
+		if ((u8)buf[from] != 0xa5)
+			return false;
+
+	return true;
+}
+
+static int __init lz4test_check(int p, const char *src, int len,
+				const char *cbuf, int clen, char *dst)
+{
+	int ret, errors = 0;
+
+	memset(dst, 0xa5, len + LZ4TEST_GUARD);
+	ret = lz4test_paths[p].decompress(cbuf, dst, clen, len);
+	if (ret != len || memcmp(dst, src, len) ||
+	    !lz4test_guard_ok(dst, len, len + LZ4TEST_GUARD))
+		errors++;
+
+	memset(dst, 0xa5, len + LZ4TEST_GUARD);
+	ret = lz4test_paths[p].decompress(cbuf, dst, clen, len - 1);
+	if (ret >= 0 || !lz4test_guard_ok(dst, len - 1, len + LZ4TEST_GUARD))
+		errors++;
+
+	ret = lz4test_paths[p].decompress(cbuf, dst, clen - 1, len);
+	if (ret >= 0)
+		errors++;
+
+	return errors;
+}
+
+static u64 __init lz4test_bench(int p, const char *cbuf, int clen, char *dst,
+				int len)
+{
+	u64 nsec;
+	int i;
+
+	nsec = ktime_get_ns();
+	for (i = 0; i < LZ4TEST_LOOPS; i++)
+		lz4test_paths[p].decompress(cbuf, dst, clen, len);
+	nsec = ktime_get_ns() - nsec;
+
+	/* MB/s */
+	return div64_u64((u64)len * LZ4TEST_LOOPS * NSEC_PER_SEC,
+			 max_t(u64, nsec, 1) * SZ_1M);
+}
+
+static int __init lz4test_init(void)
+{
+	struct rnd_state rnd;
+	char *src, *cbuf, *dst;
+	int kind, s, p, len, clen;
+	int errors = 0;
+	void *wrkmem;
+
+	src = kmalloc(SZ_16K, GFP_KERNEL);
+	cbuf = kmalloc(LZ4_COMPRESSBOUND(SZ_16K), GFP_KERNEL);
+	dst = kmalloc(SZ_16K + LZ4TEST_GUARD, GFP_KERNEL);
+	wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	if (!src || !cbuf || !dst || !wrkmem)
+		goto out;
+
+	prandom_seed_state(&rnd, 0x4c5a34);
+
+	for (kind = 0; kind < LZ4TEST_NR; kind++) {
+		for (s = 0; s < ARRAY_SIZE(lz4test_sizes); s++) {
+			len = lz4test_sizes[s];
+			lz4test_fill((u8 *)src, len, kind, &rnd);
+			clen = LZ4_compress_default(src, cbuf, len,
+					LZ4_COMPRESSBOUND(len), wrkmem);
+			if (clen <= 0) {
+				errors++;
+				continue;
+			}
+
+			for (p = 0; p < ARRAY_SIZE(lz4test_paths); p++) {
+				if (lz4test_check(p, src, len, cbuf, clen, dst)) {
+					pr_warn("lz4: %s failed on %s %d\n",
+						lz4test_paths[p].name,
+						lz4test_kinds[kind], len);
+					errors++;
+					continue;
+				}
+
+				pr_info("lz4: %-7s %-6s %5d -> %5d: %llu MB/s\n",
+					lz4test_paths[p].name,
+					lz4test_kinds[kind], len, clen,
+					lz4test_bench(p, cbuf, clen, dst, len));
+				cond_resched();
+			}
+		}
+	}
+
+	if (errors)
+		pr_warn("lz4: %d self tests failed\n", errors);
+	else
+		pr_info("lz4: self tests passed\n");
+out:
+	vfree(wrkmem);
+	kfree(dst);
+	kfree(cbuf);
+	kfree(src);
+
+	return 0;
+}
+late_initcall(lz4test_init);
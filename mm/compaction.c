@@ -23,6 +23,11 @@
 #include <linux/freezer.h>
 #include <linux/page_owner.h>
 #include <linux/psi.h>
+#include <linux/debugfs.h>
+#include <linux/moduleparam.h>
+#include <linux/power_supply.h>
+#include <linux/sched/stat.h>
+#include <linux/seq_file.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -1322,6 +1327,20 @@ static inline bool is_via_compact_memory(int order)
 	return order == -1;
 }
 
+#ifdef CONFIG_COMPACTION_PROACTIVE
+/* Number of free blocks of @order the zone could hand out right now */
+static unsigned long zone_free_blocks(struct zone *zone, unsigned int order)
+{
+	unsigned long blocks = 0;
+	unsigned int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		blocks += READ_ONCE(zone->free_area[o].nr_free) << (o - order);
+
+	return blocks;
+}
+#endif
+
 static enum compact_result __compact_finished(struct zone *zone,
 						struct compact_control *cc)
 {
@@ -1351,6 +1370,12 @@ static enum compact_result __compact_finished(struct zone *zone,
 			return COMPACT_PARTIAL_SKIPPED;
 	}
 
+#ifdef CONFIG_COMPACTION_PROACTIVE
+	if (cc->proactive_order &&
+	    zone_free_blocks(zone, cc->proactive_order) >= cc->proactive_blocks)
+		return COMPACT_SUCCESS;
+#endif
+
 	if (is_via_compact_memory(cc->order))
 		return COMPACT_CONTINUE;
 
@@ -1929,6 +1954,229 @@ static inline bool kcompactd_work_requested(pg_data_t *pgdat)
 	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
 }
 
+#ifdef CONFIG_COMPACTION_PROACTIVE
+/*
+ * Proactive compaction
+ *
+ * ION and KGSL pools are refilled with order-4 and order-8 pages, which
+ * are rarely available after some uptime since kcompactd only runs once
+ * an allocation has already failed. Every period_ms, while the device is
+ * charging or close to idle, kcompactd checks each order in the orders
+ * mask and compacts a zone that has fewer than blocks free blocks of that
+ * order and whose free memory is fragmented beyond frag_target, using the
+ * fragmentation index scale of /sys/kernel/debug/extfrag. The pass runs
+ * async at the lowest priority, so it backs off as soon as anything else
+ * wants the CPU, and stops once the target number of blocks is free.
+ * Orders that fail to reach it are retried after an increasing number of
+ * periods.
+ */
+#define PROACTIVE_MAX_DEFER	6
+
+static unsigned int proactive_period_ms = 10000;
+module_param_named(proactive_period_ms, proactive_period_ms, uint, 0644);
+
+static unsigned int proactive_orders = (1 << 4) | (1 << 8);
+module_param_named(proactive_orders, proactive_orders, uint, 0644);
+
+static unsigned int proactive_blocks = 16;
+module_param_named(proactive_blocks, proactive_blocks, uint, 0644);
+
+static int proactive_frag_target = 500;
+module_param_named(proactive_frag_target, proactive_frag_target, int, 0644);
+
+/* runnable tasks, kcompactd included, at or below which the system is idle */
+static unsigned int proactive_idle_running = 2;
+module_param_named(proactive_idle_running, proactive_idle_running, uint, 0644);
+
+struct proactive_stats {
+	int index;
+	unsigned long blocks;
+	unsigned long runs;
+	unsigned long success;
+	unsigned long fail;
+	unsigned int defer;
+	unsigned int defer_shift;
+};
+
+static struct proactive_stats proactive_stats[MAX_ORDER];
+static DEFINE_MUTEX(proactive_lock);
+
+/*
+ * Fragmentation index of the zone's free memory for @order, as in
+ * __fragmentation_index(), but computed even if some blocks are free.
+ */
+static int proactive_frag_index(struct zone *zone, unsigned int order)
+{
+	unsigned long free_pages = 0, free_blocks = 0, nr;
+	unsigned int o;
+
+	for (o = 0; o < MAX_ORDER; o++) {
+		nr = READ_ONCE(zone->free_area[o].nr_free);
+		free_blocks += nr;
+		free_pages += nr << o;
+	}
+
+	if (!free_blocks)
+		return 0;
+
+	return 1000 - div_u64(1000 + div_u64(free_pages * 1000ULL, 1UL << order),
+			      free_blocks);
+}
+
+static bool proactive_allowed(void)
+{
+	if (power_supply_is_system_supplied() > 0)
+		return true;
+
+	return nr_running() <= proactive_idle_running;
+}
+
+static void proactive_compact_zone(struct zone *zone, unsigned int order,
+				   struct proactive_stats *st)
+{
+	struct compact_control cc = {
+		.order = -1,
+		.mode = MIGRATE_ASYNC,
+		.gfp_mask = GFP_KERNEL,
+		.proactive_order = order,
+		.proactive_blocks = proactive_blocks,
+	};
+	enum compact_result ret;
+
+	cc.zone = zone;
+	ret = compact_zone(zone, &cc);
+
+	count_compact_events(KCOMPACTD_MIGRATE_SCANNED,
+			     cc.total_migrate_scanned);
+	count_compact_events(KCOMPACTD_FREE_SCANNED, cc.total_free_scanned);
+
+	VM_BUG_ON(!list_empty(&cc.freepages));
+	VM_BUG_ON(!list_empty(&cc.migratepages));
+
+	st->runs++;
+	if (ret == COMPACT_SUCCESS) {
+		st->success++;
+		st->defer_shift = 0;
+	} else if (ret != COMPACT_CONTENDED) {
+		st->fail++;
+		st->defer = 1U << st->defer_shift;
+		if (st->defer_shift < PROACTIVE_MAX_DEFER)
+			st->defer_shift++;
+	}
+}
+
+static void kcompactd_do_proactive(pg_data_t *pgdat)
+{
+	struct proactive_stats *st;
+	unsigned long watermark;
+	struct zone *zone;
+	unsigned int order;
+	int zoneid, nice;
+
+	if (!proactive_allowed())
+		return;
+
+	nice = task_nice(current);
+	set_user_nice(current, MAX_NICE);
+	mutex_lock(&proactive_lock);
+
+	for (order = 1; order < MAX_ORDER; order++) {
+		if (!(proactive_orders & (1U << order)))
+			continue;
+
+		st = &proactive_stats[order];
+		if (st->defer) {
+			st->defer--;
+			continue;
+		}
+
+		for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+			zone = &pgdat->node_zones[zoneid];
+			if (!populated_zone(zone))
+				continue;
+
+			st->blocks = zone_free_blocks(zone, order);
+			st->index = proactive_frag_index(zone, order);
+			if (st->blocks >= proactive_blocks ||
+			    st->index <= proactive_frag_target)
+				continue;
+
+			/* Compaction needs order-0 pages to migrate into */
+			watermark = high_wmark_pages(zone) + compact_gap(order);
+			if (!zone_watermark_ok(zone, 0, watermark, 0, ALLOC_CMA))
+				continue;
+
+			if (kthread_should_stop() || kcompactd_work_requested(pgdat))
+				goto out;
+
+			proactive_compact_zone(zone, order, st);
+			st->blocks = zone_free_blocks(zone, order);
+			st->index = proactive_frag_index(zone, order);
+		}
+	}
+out:
+	mutex_unlock(&proactive_lock);
+	set_user_nice(current, nice);
+}
+
+static long kcompactd_proactive_timeout(void)
+{
+	unsigned int period = READ_ONCE(proactive_period_ms);
+
+	return period ? msecs_to_jiffies(period) : MAX_SCHEDULE_TIMEOUT;
+}
+
+static int proactive_show(struct seq_file *m, void *v)
+{
+	struct proactive_stats *st;
+	unsigned int order;
+
+	mutex_lock(&proactive_lock);
+	for (order = 1; order < MAX_ORDER; order++) {
+		if (!(proactive_orders & (1U << order)))
+			continue;
+
+		st = &proactive_stats[order];
+		seq_printf(m, "order=%u index=%d blocks=%lu runs=%lu success=%lu fail=%lu defer=%u\n",
+			   order, st->index, st->blocks, st->runs, st->success,
+			   st->fail, st->defer);
+	}
+	mutex_unlock(&proactive_lock);
+
+	return 0;
+}
+
+static int proactive_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proactive_show, NULL);
+}
+
+static const struct file_operations proactive_fops = {
+	.open		= proactive_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init proactive_debugfs_init(void)
+{
+	debugfs_create_file("compaction_proactive", 0444, NULL, NULL,
+			    &proactive_fops);
+
+	return 0;
+}
+late_initcall(proactive_debugfs_init);
+#else
+static inline void kcompactd_do_proactive(pg_data_t *pgdat)
+{
+}
+
+static inline long kcompactd_proactive_timeout(void)
+{
+	return MAX_SCHEDULE_TIMEOUT;
+}
+#endif
+
 static bool kcompactd_node_suitable(pg_data_t *pgdat)
 {
 	int zoneid;
@@ -2068,8 +2316,12 @@ static int kcompactd(void *p)
 		unsigned long pflags;
 
 		trace_mm_compaction_kcompactd_sleep(pgdat->node_id);
-		wait_event_freezable(pgdat->kcompactd_wait,
-				kcompactd_work_requested(pgdat));
+		if (!wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat),
+				kcompactd_proactive_timeout())) {
+			kcompactd_do_proactive(pgdat);
+			continue;
+		}
 
 		psi_memstall_enter(&pflags);
 		kcompactd_do_work(pgdat);
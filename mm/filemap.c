@@ -2506,6 +2506,8 @@ int filemap_fault(struct vm_fault *vmf)
 	 * Do we have something in the page cache already?
 	 */
 	page = find_get_page(mapping, offset);
+	if (!(vmf->flags & FAULT_FLAG_TRIED))
+		ra_profile_fault(file, offset, page != NULL);
 	if (likely(page) && !(vmf->flags & FAULT_FLAG_TRIED)) {
 		/*
 		 * We found the page, so try async readahead before
@@ -77,6 +77,15 @@ extern int __do_page_cache_readahead(struct address_space *mapping,
 		struct file *filp, pgoff_t offset, unsigned long nr_to_read,
 		unsigned long lookahead_size);
 
+#ifdef CONFIG_RA_PROFILE
+extern void ra_profile_fault(struct file *file, pgoff_t offset, bool cached);
+#else
+static inline void ra_profile_fault(struct file *file, pgoff_t offset,
+				    bool cached)
+{
+}
+#endif
+
 /*
  * Submit IO for the read-ahead request in file_ra_state.
  */
@@ -224,6 +233,8 @@ struct compact_control {
 	bool whole_zone;		/* Whole zone should/has been scanned */
 	bool contended;			/* Signal lock or sched contention */
 	bool finishing_block;		/* Finishing current pageblock */
+	int proactive_order;		/* Proactive: order of blocks to form */
+	unsigned long proactive_blocks;	/* Proactive: free blocks wanted */
 };
 
 unsigned long
@@ -100,12 +100,16 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @background: entered by the background mode rather than by madvise
+ * @paused: background mm whose owner is no longer in the background
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	bool background;
+	bool paused;
 };
 
 /**
@@ -256,6 +260,18 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Share of one CPU ksmd may use, stretching its sleeps; 0 for no limit */
+static unsigned int ksm_cpu_budget_pct;
+
+/*
+ * Background mode: processes with an oom_score_adj of at least this are
+ * merged without having to madvise(MADV_MERGEABLE), most cached first.
+ * OOM_SCORE_ADJ_MAX + 1 disables it.
+ */
+static int ksm_background_adj = OOM_SCORE_ADJ_MAX + 1;
+#define KSM_BG_INTERVAL_MS	5000
+#define KSM_BG_BATCH		32
+
 /* Checksum of an empty (zeroed) page */
 static unsigned int zero_checksum __read_mostly;
 
@@ -764,6 +780,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		VM_BUG_ON(stable_node->rmap_hlist_len <= 0);
 		stable_node->rmap_hlist_len--;
 
@@ -1986,6 +2003,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -2246,6 +2264,29 @@ next_mm:
 	}
 
 	mm = slot->mm;
+	if (READ_ONCE(slot->paused) && !ksm_test_exit(mm)) {
+		/*
+		 * Keep what is merged, but leave no rmap_item on a stale
+		 * unstable tree while the mm sits out full scans.
+		 */
+		for (rmap_item = slot->rmap_list; rmap_item;
+		     rmap_item = rmap_item->rmap_list)
+			if (rmap_item->address & UNSTABLE_FLAG)
+				remove_rmap_item_from_tree(rmap_item);
+
+		spin_lock(&ksm_mmlist_lock);
+		ksm_scan.mm_slot = list_entry(slot->mm_list.next,
+					      struct mm_slot, mm_list);
+		spin_unlock(&ksm_mmlist_lock);
+
+		slot = ksm_scan.mm_slot;
+		if (slot != &ksm_mm_head)
+			goto next_mm;
+
+		ksm_scan.seqnr++;
+		return NULL;
+	}
+
 	down_read(&mm->mmap_sem);
 	if (ksm_test_exit(mm))
 		vma = NULL;
@@ -2360,28 +2401,166 @@ static void ksm_do_scan(unsigned int scan_npages)
 	}
 }
 
+static bool ksm_background_enabled(void)
+{
+	return READ_ONCE(ksm_background_adj) <= OOM_SCORE_ADJ_MAX;
+}
+
 static int ksmd_should_run(void)
 {
-	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
+	return (ksm_run & KSM_RUN_MERGE) &&
+		(!list_empty(&ksm_mm_head.mm_list) || ksm_background_enabled());
+}
+
+struct ksm_bg_candidate {
+	struct mm_struct *mm;
+	short adj;
+};
+
+static bool ksm_bg_vma_eligible(struct vm_area_struct *vma)
+{
+	if (!vma_is_anonymous(vma))
+		return false;
+
+	return !(vma->vm_flags & (VM_MERGEABLE | VM_SHARED | VM_MAYSHARE |
+				  VM_PFNMAP | VM_IO | VM_DONTEXPAND |
+				  VM_HUGETLB | VM_MIXEDMAP));
+}
+
+static void ksm_bg_enter(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	struct mm_slot *slot;
+
+	/* Never hold up the owner on its own mmap_sem */
+	if (!down_write_trylock(&mm->mmap_sem))
+		return;
+
+	if (ksm_test_exit(mm))
+		goto out;
+
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+		if (__ksm_enter(mm))
+			goto out;
+		spin_lock(&ksm_mmlist_lock);
+		slot = get_mm_slot(mm);
+		if (slot)
+			slot->background = true;
+		spin_unlock(&ksm_mmlist_lock);
+	}
+
+	/* Anon mappings created since the last pass too */
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (!ksm_bg_vma_eligible(vma))
+			continue;
+		vm_write_begin(vma);
+		WRITE_ONCE(vma->vm_flags, vma->vm_flags | VM_MERGEABLE);
+		vm_write_end(vma);
+	}
+out:
+	up_write(&mm->mmap_sem);
+}
+
+/*
+ * Enter the KSM_BG_BATCH most cached processes at or above the background
+ * adj, highest adj first so that it is scanned first, and pause the
+ * background mms whose owner came back above it.
+ */
+static void ksm_background_scan(void)
+{
+	struct ksm_bg_candidate cand[KSM_BG_BATCH];
+	int min_adj = READ_ONCE(ksm_background_adj);
+	struct task_struct *p, *t;
+	struct mm_struct *mm;
+	struct mm_slot *slot;
+	int n = 0, i;
+	short adj;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (p->flags & PF_KTHREAD)
+			continue;
+
+		t = find_lock_task_mm(p);
+		if (!t)
+			continue;
+		mm = t->mm;
+		adj = t->signal->oom_score_adj;
+
+		if (test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+			spin_lock(&ksm_mmlist_lock);
+			slot = get_mm_slot(mm);
+			if (slot && slot->background)
+				WRITE_ONCE(slot->paused, adj < min_adj);
+			spin_unlock(&ksm_mmlist_lock);
+		}
+
+		if (adj < min_adj || ksm_test_exit(mm)) {
+			task_unlock(t);
+			continue;
+		}
+
+		/* Keep the candidates sorted by decreasing adj */
+		if (n == KSM_BG_BATCH) {
+			if (adj <= cand[n - 1].adj) {
+				task_unlock(t);
+				continue;
+			}
+			mmput_async(cand[--n].mm);
+		}
+		for (i = n; i > 0 && cand[i - 1].adj < adj; i--)
+			cand[i] = cand[i - 1];
+		mmget(mm);
+		cand[i].mm = mm;
+		cand[i].adj = adj;
+		n++;
+		task_unlock(t);
+	}
+	rcu_read_unlock();
+
+	for (i = 0; i < n; i++) {
+		ksm_bg_enter(cand[i].mm);
+		mmput(cand[i].mm);
+	}
 }
 
 static int ksm_scan_thread(void *nothing)
 {
+	unsigned long bg_next = jiffies;
+	unsigned int sleep_ms;
+	u64 start, run;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
+		start = ktime_get_ns();
 		mutex_lock(&ksm_thread_mutex);
 		wait_while_offlining();
+		if ((ksm_run & KSM_RUN_MERGE) && ksm_background_enabled() &&
+		    time_after_eq(jiffies, bg_next)) {
+			ksm_background_scan();
+			bg_next = jiffies +
+				msecs_to_jiffies(KSM_BG_INTERVAL_MS);
+		}
 		if (ksmd_should_run())
 			ksm_do_scan(ksm_thread_pages_to_scan);
 		mutex_unlock(&ksm_thread_mutex);
+		run = ktime_get_ns() - start;
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
+			sleep_ms = ksm_thread_sleep_millisecs;
+			/* Only waiting for background candidates */
+			if (list_empty(&ksm_mm_head.mm_list))
+				sleep_ms = KSM_BG_INTERVAL_MS;
+			else if (ksm_cpu_budget_pct)
+				sleep_ms = max_t(u64, sleep_ms,
+					div_u64(run * (100 - ksm_cpu_budget_pct),
+						ksm_cpu_budget_pct * NSEC_PER_MSEC));
 			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				msecs_to_jiffies(sleep_ms));
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -2799,6 +2978,54 @@ static ssize_t sleep_millisecs_store(struct kobject *kobj,
 }
 KSM_ATTR(sleep_millisecs);
 
+static ssize_t cpu_budget_pct_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_cpu_budget_pct);
+}
+
+static ssize_t cpu_budget_pct_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned int pct;
+	int err;
+
+	err = kstrtouint(buf, 10, &pct);
+	if (err || pct > 100)
+		return -EINVAL;
+
+	ksm_cpu_budget_pct = pct < 100 ? pct : 0;
+
+	return count;
+}
+KSM_ATTR(cpu_budget_pct);
+
+static ssize_t background_adj_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ksm_background_adj);
+}
+
+static ssize_t background_adj_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	int adj;
+	int err;
+
+	err = kstrtoint(buf, 10, &adj);
+	if (err || adj < OOM_SCORE_ADJ_MIN || adj > OOM_SCORE_ADJ_MAX + 1)
+		return -EINVAL;
+
+	WRITE_ONCE(ksm_background_adj, adj);
+	if (ksm_background_enabled())
+		wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(background_adj);
+
 static ssize_t pages_to_scan_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
 {
@@ -3078,6 +3305,8 @@ KSM_ATTR_RO(full_scans);
 
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
+	&cpu_budget_pct_attr.attr,
+	&background_adj_attr.attr,
 	&pages_to_scan_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
@@ -128,6 +128,14 @@ static long madvise_behavior(struct vm_area_struct *vma,
 			goto out;
 		}
 		break;
+#ifdef CONFIG_FAULT_AROUND_HINT
+	case MADV_FAULTAROUND_DEFAULT ...
+	     MADV_FAULTAROUND_ORDER(MADV_FAULTAROUND_MAX_ORDER):
+		new_flags &= ~VM_FAULTAROUND_MASK;
+		new_flags |= (unsigned long)(behavior - MADV_FAULTAROUND_DEFAULT) <<
+			VM_FAULTAROUND_SHIFT;
+		break;
+#endif
 	}
 
 	if (new_flags == vma->vm_flags) {
@@ -720,6 +728,10 @@ madvise_behavior_valid(int behavior)
 	case MADV_DODUMP:
 	case MADV_WIPEONFORK:
 	case MADV_KEEPONFORK:
+#ifdef CONFIG_FAULT_AROUND_HINT
+	case MADV_FAULTAROUND_DEFAULT ...
+	     MADV_FAULTAROUND_ORDER(MADV_FAULTAROUND_MAX_ORDER):
+#endif
 #ifdef CONFIG_MEMORY_FAILURE
 	case MADV_SOFT_OFFLINE:
 	case MADV_HWPOISON:
@@ -775,6 +787,10 @@ madvise_behavior_valid(int behavior)
  *  MADV_NOHUGEPAGE - mark the given range as not worth being backed by
  *		transparent huge pages so the existing pages will not be
  *		coalesced into THP and new pages will not be allocated as THP.
+ *  MADV_FAULTAROUND_ORDER(order) - map up to 2^order pages around read
+ *		faults in the given range instead of fault_around_bytes,
+ *		0 disables fault-around there.
+ *  MADV_FAULTAROUND_DEFAULT - go back to fault_around_bytes.
  *  MADV_DONTDUMP - the application wants to prevent pages in the given range
  *		from being included in its core dump.
  *  MADV_DODUMP - cancel MADV_DONTDUMP: no longer exclude from core dump.
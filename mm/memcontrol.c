@@ -3250,6 +3250,27 @@ static const char *const memcg1_event_names[] = {
 	"pgmajfault",
 };
 
+/* Refault counters cgroup1 shows, as counts rather than bytes */
+static const unsigned int memcg1_workingset[] = {
+	WORKINGSET_REFAULT,
+	WORKINGSET_ACTIVATE,
+	WORKINGSET_REFAULT_RO,
+	WORKINGSET_REFAULT_RW,
+	WORKINGSET_REFAULT_SWAP,
+	WORKINGSET_DISTANCE_RO,
+	WORKINGSET_DISTANCE_RW,
+};
+
+static const char *const memcg1_workingset_names[] = {
+	"workingset_refault",
+	"workingset_activate",
+	"workingset_refault_ro",
+	"workingset_refault_rw",
+	"workingset_refault_swap",
+	"workingset_distance_ro",
+	"workingset_distance_rw",
+};
+
 static int memcg_stat_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
@@ -3259,6 +3280,8 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 	BUILD_BUG_ON(ARRAY_SIZE(mem_cgroup_lru_names) != NR_LRU_LISTS);
+	BUILD_BUG_ON(ARRAY_SIZE(memcg1_workingset_names) !=
+		     ARRAY_SIZE(memcg1_workingset));
 
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		if (memcg1_stats[i] == MEMCG_SWAP && !do_memsw_account())
@@ -3272,6 +3295,10 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 		seq_printf(m, "%s %lu\n", memcg1_event_names[i],
 			   memcg_sum_events(memcg, memcg1_events[i]));
 
+	for (i = 0; i < ARRAY_SIZE(memcg1_workingset); i++)
+		seq_printf(m, "%s %lu\n", memcg1_workingset_names[i],
+			   memcg_page_state(memcg, memcg1_workingset[i]));
+
 	for (i = 0; i < NR_LRU_LISTS; i++)
 		seq_printf(m, "%s %lu\n", mem_cgroup_lru_names[i],
 			   mem_cgroup_nr_lru_pages(memcg, BIT(i)) * PAGE_SIZE);
@@ -3307,6 +3334,15 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 		seq_printf(m, "total_%s %llu\n", memcg1_event_names[i], val);
 	}
 
+	for (i = 0; i < ARRAY_SIZE(memcg1_workingset); i++) {
+		unsigned long long val = 0;
+
+		for_each_mem_cgroup_tree(mi, memcg)
+			val += memcg_page_state(mi, memcg1_workingset[i]);
+		seq_printf(m, "total_%s %llu\n", memcg1_workingset_names[i],
+			   val);
+	}
+
 	for (i = 0; i < NR_LRU_LISTS; i++) {
 		unsigned long long val = 0;
 
@@ -5449,6 +5485,16 @@ static int memory_stat_show(struct seq_file *m, void *v)
 		   stat[WORKINGSET_ACTIVATE]);
 	seq_printf(m, "workingset_nodereclaim %lu\n",
 		   stat[WORKINGSET_NODERECLAIM]);
+	seq_printf(m, "workingset_refault_ro %lu\n",
+		   stat[WORKINGSET_REFAULT_RO]);
+	seq_printf(m, "workingset_refault_rw %lu\n",
+		   stat[WORKINGSET_REFAULT_RW]);
+	seq_printf(m, "workingset_refault_swap %lu\n",
+		   stat[WORKINGSET_REFAULT_SWAP]);
+	seq_printf(m, "workingset_distance_ro %lu\n",
+		   stat[WORKINGSET_DISTANCE_RO]);
+	seq_printf(m, "workingset_distance_rw %lu\n",
+		   stat[WORKINGSET_DISTANCE_RW]);
 
 	return 0;
 }
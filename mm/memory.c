@@ -3253,6 +3253,8 @@ int do_swap_page(struct vm_fault *vmf)
 		mem_cgroup_commit_charge(page, memcg, true, false);
 		activate_page(page);
 	}
+	if (ret & VM_FAULT_MAJOR)
+		inc_lruvec_page_state(page, WORKINGSET_REFAULT_SWAP);
 
 	swap_free(entry);
 	if (mem_cgroup_swap_full(page) ||
@@ -3812,14 +3814,13 @@ late_initcall(fault_around_debugfs);
  * fault_around_pages() value (and therefore to page order).  This way it's
  * easier to guarantee that we don't cross page table boundaries.
  */
-static int do_fault_around(struct vm_fault *vmf)
+static int do_fault_around(struct vm_fault *vmf, unsigned long nr_pages)
 {
-	unsigned long address = vmf->address, nr_pages, mask;
+	unsigned long address = vmf->address, mask;
 	pgoff_t start_pgoff = vmf->pgoff;
 	pgoff_t end_pgoff;
 	int off, ret = 0;
 
-	nr_pages = READ_ONCE(fault_around_bytes) >> PAGE_SHIFT;
 	mask = ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK;
 
 	vmf->address = max(address & mask, vmf->vma->vm_start);
@@ -3867,23 +3868,51 @@ out:
 	return ret;
 }
 
+/*
+ * Pages to map around a fault, from the MADV_FAULTAROUND_ORDER() hint of
+ * the VMA if it has one.
+ */
+static unsigned long fault_around_pages(struct vm_fault *vmf)
+{
+#ifdef CONFIG_FAULT_AROUND_HINT
+	unsigned long hint = (vmf->vma_flags & VM_FAULTAROUND_MASK) >>
+		VM_FAULTAROUND_SHIFT;
+
+	if (hint)
+		return min_t(unsigned long, 1UL << (hint - 1), PTRS_PER_PTE);
+#endif
+	return READ_ONCE(fault_around_bytes) >> PAGE_SHIFT;
+}
+
 static int do_read_fault(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
+	unsigned long nr_pages = fault_around_pages(vmf);
 	int ret = 0;
 
+#ifdef CONFIG_FAULT_AROUND_HINT
+	atomic_long_inc(&vma->vm_read_faults);
+#endif
 	/*
 	 * Let's call ->map_pages() first and use ->fault() as fallback
 	 * if page by the offset is not ready to be mapped (cold cache or
 	 * something).
 	 */
-	if (vma->vm_ops->map_pages && fault_around_bytes >> PAGE_SHIFT > 1) {
-		ret = do_fault_around(vmf);
-		if (ret)
+	if (vma->vm_ops->map_pages && nr_pages > 1) {
+		ret = do_fault_around(vmf, nr_pages);
+		if (ret) {
+#ifdef CONFIG_FAULT_AROUND_HINT
+			atomic_long_inc(&vma->vm_around_faults);
+#endif
 			return ret;
+		}
 	}
 
 	ret = __do_fault(vmf);
+#ifdef CONFIG_FAULT_AROUND_HINT
+	if (ret & VM_FAULT_MAJOR)
+		atomic_long_inc(&vma->vm_major_faults);
+#endif
 	if (unlikely(ret & (VM_FAULT_ERROR | VM_FAULT_NOPAGE | VM_FAULT_RETRY)))
 		return ret;
 
@@ -69,6 +69,7 @@
 #include <linux/lockdep.h>
 #include <linux/nmi.h>
 #include <linux/psi.h>
+#include <linux/arch_topology.h>
 
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
@@ -2478,6 +2479,9 @@ static struct list_head *get_populated_pcp_list(struct zone *zone,
 	struct list_head *list = &pcp->lists[migratetype];
 
 	if (list_empty(list)) {
+#ifdef CONFIG_PCP_AUTOTUNE
+		pcp->refill++;
+#endif
 		pcp->count += rmqueue_bulk(zone, order,
 				pcp->batch, list,
 				migratetype, cold);
@@ -2758,6 +2762,9 @@ void free_hot_cold_page(struct page *page, bool cold)
 	pcp->count++;
 	if (pcp->count >= pcp->high) {
 		unsigned long batch = READ_ONCE(pcp->batch);
+#ifdef CONFIG_PCP_AUTOTUNE
+		pcp->drain++;
+#endif
 		free_pcppages_bulk(zone, batch, pcp);
 		pcp->count -= batch;
 	}
@@ -2922,12 +2929,22 @@ static struct page *rmqueue_pcplist(struct zone *preferred_zone,
 	bool cold = ((gfp_flags & __GFP_COLD) != 0);
 	struct page *page;
 	unsigned long flags;
+#ifdef CONFIG_PCP_AUTOTUNE
+	unsigned long refill;
+#endif
 
 	local_irq_save(flags);
 	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+#ifdef CONFIG_PCP_AUTOTUNE
+	refill = pcp->refill;
+#endif
 	page = __rmqueue_pcplist(zone,  migratetype, cold, pcp,
 				 gfp_flags);
 	if (page) {
+#ifdef CONFIG_PCP_AUTOTUNE
+		if (pcp->refill == refill)
+			pcp->hit++;
+#endif
 		__count_zid_vm_events(PGALLOC, page_zonenum(page), 1 << order);
 		zone_statistics(preferred_zone, zone);
 	}
@@ -7440,6 +7457,120 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_PCP_AUTOTUNE
+/*
+ * Every CPU starts from the zone_batchsize() pcp sizing. Once a second,
+ * a CPU that went to zone->lock for refills and drains more than
+ * PCP_TUNE_GROW times has its batch and high doubled, and one that went
+ * less than PCP_TUNE_SHRINK times has them halved back. The largest
+ * CPUs go up to percpu_pagelist_scale_max times the base sizing, smaller
+ * ones in proportion to their capacity. A percpu_pagelist_fraction set
+ * by the admin takes precedence.
+ */
+#define PCP_TUNE_MS		1000
+#define PCP_TUNE_GROW		100
+#define PCP_TUNE_SHRINK		10
+
+int percpu_pagelist_autotune = 1;
+int percpu_pagelist_scale_max = 8;
+
+static void pcp_tune_fn(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(pcp_tune_work, pcp_tune_fn);
+
+static unsigned long pcp_scale_max(int cpu)
+{
+	unsigned long cap = SCHED_CAPACITY_SCALE;
+
+#ifdef CONFIG_GENERIC_ARCH_TOPOLOGY
+	cap = topology_get_cpu_scale(NULL, cpu);
+#endif
+	return max(1UL, (percpu_pagelist_scale_max * cap) >>
+		   SCHED_CAPACITY_SHIFT);
+}
+
+static void pcp_tune_fn(struct work_struct *work)
+{
+	unsigned long base, scale, new, trips, delta;
+	struct per_cpu_pages *pcp;
+	struct zone *zone;
+	int cpu;
+
+	mutex_lock(&pcp_batch_high_lock);
+	if (!percpu_pagelist_autotune)
+		goto out;
+
+	if (percpu_pagelist_fraction)
+		goto requeue;
+
+	for_each_populated_zone(zone) {
+		base = zone_batchsize(zone);
+		if (!base)
+			continue;
+
+		for_each_online_cpu(cpu) {
+			pcp = &per_cpu_ptr(zone->pageset, cpu)->pcp;
+			trips = READ_ONCE(pcp->refill) + READ_ONCE(pcp->drain);
+			delta = trips - pcp->prev_trips;
+			pcp->prev_trips = trips;
+
+			scale = max(1UL, (unsigned long)pcp->batch / base);
+			if (delta > PCP_TUNE_GROW)
+				new = scale * 2;
+			else if (delta < PCP_TUNE_SHRINK)
+				new = max(1UL, scale / 2);
+			else
+				new = scale;
+			new = min(new, pcp_scale_max(cpu));
+
+			if (new != scale)
+				pageset_update(pcp, 6 * base * new, base * new);
+		}
+	}
+requeue:
+	queue_delayed_work(system_power_efficient_wq, &pcp_tune_work,
+			   msecs_to_jiffies(PCP_TUNE_MS));
+out:
+	mutex_unlock(&pcp_batch_high_lock);
+}
+
+int percpu_pagelist_autotune_sysctl_handler(struct ctl_table *table, int write,
+	void __user *buffer, size_t *length, loff_t *ppos)
+{
+	struct zone *zone;
+	unsigned int cpu;
+	int ret;
+
+	mutex_lock(&pcp_batch_high_lock);
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || ret < 0)
+		goto out;
+
+	if (percpu_pagelist_autotune) {
+		mod_delayed_work(system_power_efficient_wq, &pcp_tune_work, 0);
+		goto out;
+	}
+
+	/* Back to the static sizing */
+	for_each_populated_zone(zone)
+		for_each_possible_cpu(cpu)
+			pageset_set_high_and_batch(zone,
+					per_cpu_ptr(zone->pageset, cpu));
+out:
+	mutex_unlock(&pcp_batch_high_lock);
+	return ret;
+}
+
+static int __init pcp_tune_init(void)
+{
+	if (percpu_pagelist_autotune)
+		queue_delayed_work(system_power_efficient_wq, &pcp_tune_work,
+				   msecs_to_jiffies(PCP_TUNE_MS));
+
+	return 0;
+}
+late_initcall(pcp_tune_init);
+#endif
+
 #ifdef CONFIG_NUMA
 int hashdist = HASHDIST_DEFAULT;
 
@@ -342,6 +342,7 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 		goto out;
 	}
 	bio->bi_opf = REQ_OP_WRITE | wbc_to_write_flags(wbc);
+	bio_set_wb_class(bio, BIO_WB_SWAP);
 	count_swpout_vm_event(page);
 	set_page_writeback(page);
 	unlock_page(page);
@@ -363,6 +364,8 @@ int swap_readpage(struct page *page, bool synchronous)
 	VM_BUG_ON_PAGE(!PageLocked(page), page);
 	VM_BUG_ON_PAGE(PageUptodate(page), page);
 
+	atomic_long_inc(&sis->nr_refaults);
+
 	/*
 	 * Count submission time as memory stall. When the device is congested,
 	 * or the submitting cgroup IO-throttled, submission can be a
@@ -17,6 +17,8 @@
 #include <linux/sort.h>
 #include <linux/oom.h>
 #include <linux/sched.h>
+#include <linux/sched/signal.h>
+#include <linux/jiffies.h>
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
 #include <linux/vmpressure.h>
@@ -37,6 +39,10 @@ module_param_named(enable_process_reclaim, enable_process_reclaim, int, 0644);
 int per_swap_size = SWAP_CLUSTER_MAX * 32;
 module_param_named(per_swap_size, per_swap_size, int, 0644);
 
+/* The max number of mapped file pages reclaimed in a single run */
+static int per_file_size;
+module_param_named(per_file_size, per_file_size, int, 0644);
+
 int reclaim_avg_efficiency;
 module_param_named(reclaim_avg_efficiency, reclaim_avg_efficiency, int, 0444);
 
@@ -68,10 +74,52 @@ static atomic_t skip_reclaim = ATOMIC_INIT(0);
 /* Not atomic since only a single instance of swap_fn run at a time */
 static int monitor_eff;
 
+/*
+ * Per-task reclaim history. After a task is reclaimed, the major faults
+ * it takes in the following refault_win_ms are counted against the pages
+ * reclaimed from it. Tasks whose pages come back faster than refault_max
+ * percent are left alone for refault_skip rounds, and the reclaim target
+ * of the others is scaled by how cold their pages stayed.
+ */
+static int refault_win_ms = 2000;
+module_param_named(refault_win_ms, refault_win_ms, int, 0644);
+
+static int refault_max = 50;
+module_param_named(refault_max, refault_max, int, 0644);
+
+static int refault_skip = 4;
+module_param_named(refault_skip, refault_skip, int, 0644);
+
+#define RECLAIM_HIST_SIZE 64
+
+struct reclaim_hist {
+	pid_t tgid;
+	u64 start_time;
+	/* major faults of the group right after the last reclaim */
+	unsigned long maj_flt;
+	unsigned long reclaim_time;
+	/* pages reclaimed in the last round, 0 once refaults are counted */
+	int nr_reclaimed;
+	/* running averages, in percent */
+	int efficiency;
+	int refault;
+	/* rounds left before the task is considered again */
+	int skip;
+	unsigned long last_round;
+};
+
+static struct reclaim_hist reclaim_hist[RECLAIM_HIST_SIZE];
+static unsigned long reclaim_round;
+
 struct selected_task {
 	struct task_struct *p;
 	int tasksize;
+	int filesize;
+	/* tasksize scaled by the coldness of the task's reclaimed pages */
+	int weight;
 	short oom_score_adj;
+	pid_t tgid;
+	u64 start_time;
 };
 
 int selected_cmp(const void *a, const void *b)
@@ -80,11 +128,88 @@ int selected_cmp(const void *a, const void *b)
 	const struct selected_task *y = b;
 	int ret;
 
-	ret = x->tasksize < y->tasksize ? -1 : 1;
+	ret = x->weight < y->weight ? -1 : 1;
 
 	return ret;
 }
 
+static struct reclaim_hist *reclaim_hist_find(pid_t tgid, u64 start_time,
+					bool create)
+{
+	struct reclaim_hist *hist, *oldest = &reclaim_hist[0];
+	int i;
+
+	for (i = 0; i < RECLAIM_HIST_SIZE; i++) {
+		hist = &reclaim_hist[i];
+		if (hist->tgid == tgid && hist->start_time == start_time) {
+			hist->last_round = reclaim_round;
+			return hist;
+		}
+		if (hist->last_round < oldest->last_round)
+			oldest = hist;
+	}
+
+	if (!create)
+		return NULL;
+
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->tgid = tgid;
+	oldest->start_time = start_time;
+	oldest->efficiency = 100;
+	oldest->last_round = reclaim_round;
+
+	return oldest;
+}
+
+/* Caller holds rcu_read_lock */
+static unsigned long task_maj_flt(struct task_struct *p)
+{
+	struct task_struct *t;
+	unsigned long maj_flt = p->signal->maj_flt;
+
+	for_each_thread(p, t)
+		maj_flt += t->maj_flt;
+
+	return maj_flt;
+}
+
+/*
+ * Fold the refaults seen since the last reclaim into the history.
+ * Returns false if the task should not be reclaimed this round.
+ */
+static bool reclaim_hist_check(struct reclaim_hist *hist,
+				struct task_struct *p)
+{
+	unsigned long refaults;
+	int refault;
+
+	if (hist->skip) {
+		hist->skip--;
+		return false;
+	}
+
+	if (!hist->nr_reclaimed)
+		return true;
+
+	/* Don't reclaim again before we know how the last round went */
+	if (time_before(jiffies, hist->reclaim_time +
+			msecs_to_jiffies(refault_win_ms)))
+		return false;
+
+	refaults = task_maj_flt(p) - hist->maj_flt;
+	refault = min_t(unsigned long, 100,
+			refaults * 100 / hist->nr_reclaimed);
+	hist->refault = (hist->refault + refault) / 2;
+	if (hist->refault > refault_max)
+		hist->skip = refault_skip;
+
+	trace_process_reclaim_refault(hist->tgid, hist->nr_reclaimed,
+			refaults, hist->refault, hist->efficiency, hist->skip);
+	hist->nr_reclaimed = 0;
+
+	return !hist->skip;
+}
+
 static int test_task_flag(struct task_struct *p, int flag)
 {
 	struct task_struct *t = p;
@@ -107,19 +232,24 @@ static int test_task_flag(struct task_struct *p, int flag)
 static void swap_fn(struct work_struct *work)
 {
 	struct task_struct *tsk;
-	struct reclaim_param rp;
+	struct reclaim_param rp, frp;
+	struct reclaim_hist *hist;
 
-	/* Pick the best MAX_SWAP_TASKS tasks in terms of anon size */
-	struct selected_task selected[MAX_SWAP_TASKS] = {{0, 0, 0},};
+	/* Pick the best MAX_SWAP_TASKS tasks in terms of cold anon size */
+	struct selected_task selected[MAX_SWAP_TASKS] = {{0},};
 	int si = 0;
 	int i;
-	int tasksize;
+	int tasksize, filesize, weight;
 	int total_sz = 0;
+	int total_weight = 0;
+	int total_file = 0;
 	int total_scan = 0;
 	int total_reclaimed = 0;
-	int nr_to_reclaim;
+	int nr_to_reclaim, nr_file;
 	int efficiency;
 
+	reclaim_round++;
+
 	rcu_read_lock();
 	for_each_process(tsk) {
 		struct task_struct *p;
@@ -142,30 +272,47 @@ static void swap_fn(struct work_struct *work)
 		}
 
 		tasksize = get_mm_counter(p->mm, MM_ANONPAGES);
+		filesize = get_mm_counter(p->mm, MM_FILEPAGES);
 		task_unlock(p);
 
 		if (tasksize <= 0)
 			continue;
 
+		weight = tasksize;
+		hist = reclaim_hist_find(tsk->pid, tsk->start_time, false);
+		if (hist) {
+			if (!reclaim_hist_check(hist, tsk))
+				continue;
+			weight = tasksize * (100 - hist->refault) / 100;
+			weight = weight * hist->efficiency / 100;
+			if (weight <= 0)
+				continue;
+		}
+
 		if (si == MAX_SWAP_TASKS) {
 			sort(&selected[0], MAX_SWAP_TASKS,
 					sizeof(struct selected_task),
 					&selected_cmp, NULL);
-			if (tasksize < selected[0].tasksize)
+			if (weight < selected[0].weight)
 				continue;
-			selected[0].p = p;
-			selected[0].oom_score_adj = oom_score_adj;
-			selected[0].tasksize = tasksize;
+			i = 0;
 		} else {
-			selected[si].p = p;
-			selected[si].oom_score_adj = oom_score_adj;
-			selected[si].tasksize = tasksize;
-			si++;
+			i = si++;
 		}
+		selected[i].p = p;
+		selected[i].oom_score_adj = oom_score_adj;
+		selected[i].tasksize = tasksize;
+		selected[i].filesize = filesize;
+		selected[i].weight = weight;
+		selected[i].tgid = tsk->pid;
+		selected[i].start_time = tsk->start_time;
 	}
 
-	for (i = 0; i < si; i++)
+	for (i = 0; i < si; i++) {
 		total_sz += selected[i].tasksize;
+		total_weight += selected[i].weight;
+		total_file += selected[i].filesize;
+	}
 
 	/* Skip reclaim if total size is too less */
 	if (total_sz < SWAP_CLUSTER_MAX) {
@@ -180,13 +327,35 @@ static void swap_fn(struct work_struct *work)
 
 	while (si--) {
 		nr_to_reclaim =
-			(selected[si].tasksize * per_swap_size) / total_sz;
+			(selected[si].weight * per_swap_size) / total_weight;
 		/* scan atleast a page */
 		if (!nr_to_reclaim)
 			nr_to_reclaim = 1;
 
 		rp = reclaim_task_anon(selected[si].p, nr_to_reclaim);
 
+		nr_file = 0;
+		if (per_file_size && total_file)
+			nr_file = (selected[si].filesize * per_file_size) /
+					total_file;
+		if (nr_file) {
+			frp = reclaim_task_file(selected[si].p, nr_file);
+			rp.nr_scanned += frp.nr_scanned;
+			rp.nr_reclaimed += frp.nr_reclaimed;
+		}
+
+		hist = reclaim_hist_find(selected[si].tgid,
+				selected[si].start_time, true);
+		if (rp.nr_scanned) {
+			efficiency = (rp.nr_reclaimed * 100) / rp.nr_scanned;
+			hist->efficiency = (hist->efficiency + efficiency) / 2;
+		}
+		hist->nr_reclaimed = rp.nr_reclaimed;
+		hist->reclaim_time = jiffies;
+		rcu_read_lock();
+		hist->maj_flt = task_maj_flt(selected[si].p);
+		rcu_read_unlock();
+
 		trace_process_reclaim(selected[si].tasksize,
 				selected[si].oom_score_adj, rp.nr_scanned,
 				rp.nr_reclaimed, per_swap_size, total_sz,
@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Launch readahead profiles
+ *
+ * App cold start faults the same pages of the same APK, odex and library
+ * files in about the same order every launch, mostly one page at a time,
+ * and the ondemand heuristics never ramp up on such a pattern. During the
+ * first launch_ms of a process, every filemap fault is recorded per
+ * (file, process name). The next launch replays the profile of a file in
+ * recorded order, contiguous runs batched into one readahead each, from a
+ * worker as soon as the file is first faulted.
+ *
+ * At the end of a launch the profile is rebuilt from the pages that are
+ * still mapped, which covers the pages found through fault-around, plus
+ * the new faults. Pages that were replayed but not used drop out and are
+ * accounted as wasted.
+ */
+
+#include <linux/blkdev.h>
+#include <linux/debugfs.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/hashtable.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/pagemap.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/stringhash.h>
+#include <linux/workqueue.h>
+
+#include "internal.h"
+
+struct ra_profile {
+	struct hlist_node node;
+	struct list_head lru;
+	dev_t dev;
+	unsigned long ino;
+	loff_t size;
+	char comm[TASK_COMM_LEN];
+	/* pages of the last launch in fault order, replayed by the next */
+	u32 *order;
+	unsigned int nr;
+	/* faults of the launch in progress */
+	u32 *rec;
+	unsigned int nr_rec;
+	unsigned int max_rec;
+	/* launch in progress, file is held until its profile is rebuilt */
+	pid_t tgid;
+	u64 launch_start;
+	struct file *file;
+	bool replay_pending;
+	struct delayed_work work;
+	unsigned long launches;
+	unsigned long replayed;
+	unsigned long used;
+	unsigned long wasted;
+	unsigned long misses;
+};
+
+static bool ra_profile_enable = true;
+module_param_named(enable, ra_profile_enable, bool, 0644);
+
+static unsigned int ra_profile_launch_ms = 5000;
+module_param_named(launch_ms, ra_profile_launch_ms, uint, 0644);
+
+static unsigned int ra_profile_max_pages = 1024;
+module_param_named(max_pages, ra_profile_max_pages, uint, 0644);
+
+static unsigned int ra_profile_max_profiles = 512;
+module_param_named(max_profiles, ra_profile_max_profiles, uint, 0644);
+
+static DEFINE_HASHTABLE(ra_profiles, 8);
+static LIST_HEAD(ra_profile_lru);
+static unsigned int ra_nr_profiles;
+static DEFINE_SPINLOCK(ra_lock);
+
+static u32 ra_profile_hash(struct inode *inode, const char *comm)
+{
+	return full_name_hash(NULL, comm, strlen(comm)) ^
+		hash_long(inode->i_ino ^ inode->i_sb->s_dev, 32);
+}
+
+static struct ra_profile *ra_profile_lookup(struct inode *inode,
+					    const char *comm, u32 hash)
+{
+	struct ra_profile *p;
+
+	hash_for_each_possible(ra_profiles, p, node, hash)
+		if (p->ino == inode->i_ino && p->dev == inode->i_sb->s_dev &&
+		    !strcmp(p->comm, comm))
+			return p;
+
+	return NULL;
+}
+
+static void ra_profile_free(struct ra_profile *p)
+{
+	kfree(p->order);
+	kfree(p->rec);
+	kfree(p);
+}
+
+/* Drop the least recently launched idle profile once over the limit */
+static struct ra_profile *ra_profile_evict(void)
+{
+	struct ra_profile *p;
+
+	if (ra_nr_profiles < ra_profile_max_profiles)
+		return NULL;
+
+	list_for_each_entry_reverse(p, &ra_profile_lru, lru) {
+		if (p->file)
+			continue;
+		hash_del(&p->node);
+		list_del(&p->lru);
+		ra_nr_profiles--;
+		return p;
+	}
+
+	return NULL;
+}
+
+static void ra_profile_replay(struct ra_profile *p)
+{
+	struct address_space *mapping = p->file->f_mapping;
+	struct blk_plug plug;
+	unsigned int i, j;
+	int ret;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < p->nr; i = j) {
+		for (j = i + 1; j < p->nr && p->order[j] == p->order[j - 1] + 1;
+		     j++)
+			;
+		ret = __do_page_cache_readahead(mapping, p->file, p->order[i],
+						j - i, 0);
+		if (ret > 0)
+			p->replayed += ret;
+	}
+	blk_finish_plug(&plug);
+}
+
+static int ra_cmp_u32(const void *a, const void *b)
+{
+	u32 la = *(const u32 *)a, lb = *(const u32 *)b;
+
+	if (la == lb)
+		return 0;
+
+	return la < lb ? -1 : 1;
+}
+
+static bool ra_page_used(struct address_space *mapping, pgoff_t index)
+{
+	struct page *page = find_get_page(mapping, index);
+	bool used;
+
+	if (!page)
+		return false;
+
+	used = page_mapped(page) || PageReferenced(page);
+	put_page(page);
+
+	return used;
+}
+
+/*
+ * The next profile is the pages of this one still in use, in their old
+ * order, followed by the pages first faulted during this launch.
+ */
+static void ra_profile_rebuild(struct ra_profile *p)
+{
+	struct file *file = p->file;
+	struct address_space *mapping = file->f_mapping;
+	unsigned int max = ra_profile_max_pages;
+	unsigned int i, n = 0, nr_used;
+	u32 *order, *sorted, *old;
+
+	order = kmalloc_array(max, sizeof(*order), GFP_KERNEL);
+	sorted = kmalloc_array(max, sizeof(*sorted), GFP_KERNEL);
+	if (!order || !sorted)
+		goto out;
+
+	for (i = 0; i < p->nr && n < max; i++)
+		if (ra_page_used(mapping, p->order[i]))
+			order[n++] = p->order[i];
+	nr_used = n;
+
+	memcpy(sorted, order, n * sizeof(*sorted));
+	sort(sorted, nr_used, sizeof(*sorted), ra_cmp_u32, NULL);
+
+	spin_lock(&ra_lock);
+	for (i = 0; i < p->nr_rec && n < max; i++)
+		if (!bsearch(&p->rec[i], sorted, nr_used, sizeof(*sorted),
+			     ra_cmp_u32))
+			order[n++] = p->rec[i];
+
+	p->used += nr_used;
+	p->wasted += p->nr - nr_used;
+	old = p->order;
+	p->order = order;
+	p->nr = n;
+	order = old;
+	spin_unlock(&ra_lock);
+out:
+	kfree(order);
+	kfree(sorted);
+}
+
+static void ra_profile_work(struct work_struct *work)
+{
+	struct ra_profile *p = container_of(to_delayed_work(work),
+					    struct ra_profile, work);
+	u64 end, now;
+
+	if (p->replay_pending) {
+		p->replay_pending = false;
+		ra_profile_replay(p);
+
+		end = p->launch_start + (u64)ra_profile_launch_ms * NSEC_PER_MSEC;
+		now = ktime_get_ns();
+		queue_delayed_work(system_unbound_wq, &p->work, end > now ?
+				   nsecs_to_jiffies(end - now) : 0);
+		return;
+	}
+
+	ra_profile_rebuild(p);
+	fput(p->file);
+
+	/* p may be evicted as soon as file is cleared */
+	spin_lock(&ra_lock);
+	p->file = NULL;
+	spin_unlock(&ra_lock);
+}
+
+static struct ra_profile *ra_profile_alloc(struct inode *inode,
+					   const char *comm)
+{
+	struct ra_profile *p;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return NULL;
+
+	p->max_rec = READ_ONCE(ra_profile_max_pages);
+	p->rec = kmalloc_array(p->max_rec, sizeof(*p->rec), GFP_KERNEL);
+	if (!p->rec) {
+		kfree(p);
+		return NULL;
+	}
+
+	p->dev = inode->i_sb->s_dev;
+	p->ino = inode->i_ino;
+	p->size = i_size_read(inode);
+	strlcpy(p->comm, comm, sizeof(p->comm));
+	INIT_DELAYED_WORK(&p->work, ra_profile_work);
+
+	return p;
+}
+
+static void ra_profile_record(struct ra_profile *p, pgoff_t offset)
+{
+	unsigned int i;
+
+	/* Refaults of the same page are usually close together */
+	for (i = p->nr_rec; i > 0 && i + 8 > p->nr_rec; i--)
+		if (p->rec[i - 1] == offset)
+			return;
+
+	if (p->nr_rec < p->max_rec)
+		p->rec[p->nr_rec++] = offset;
+}
+
+/*
+ * Called by filemap_fault() with the page cache lookup result. Starts the
+ * launch of the faulting process on @file if needed and records @offset.
+ */
+void ra_profile_fault(struct file *file, pgoff_t offset, bool cached)
+{
+	struct task_struct *leader = current->group_leader;
+	struct inode *inode = file_inode(file);
+	struct ra_profile *p, *new = NULL, *old = NULL;
+	char comm[TASK_COMM_LEN];
+	u32 hash;
+
+	if (!READ_ONCE(ra_profile_enable) || (current->flags & PF_KTHREAD) ||
+	    offset > U32_MAX)
+		return;
+
+	if (ktime_get_ns() - leader->start_time >
+	    (u64)ra_profile_launch_ms * NSEC_PER_MSEC)
+		return;
+
+	get_task_comm(comm, leader);
+	hash = ra_profile_hash(inode, comm);
+
+	spin_lock(&ra_lock);
+	p = ra_profile_lookup(inode, comm, hash);
+	if (!p) {
+		spin_unlock(&ra_lock);
+		new = ra_profile_alloc(inode, comm);
+		if (!new)
+			return;
+
+		spin_lock(&ra_lock);
+		p = ra_profile_lookup(inode, comm, hash);
+		if (!p) {
+			old = ra_profile_evict();
+			p = new;
+			new = NULL;
+			hash_add(ra_profiles, &p->node, hash);
+			list_add(&p->lru, &ra_profile_lru);
+			ra_nr_profiles++;
+		}
+	}
+
+	if (p->tgid != current->tgid || p->launch_start != leader->start_time) {
+		/* The previous launch is still being rebuilt */
+		if (p->file)
+			goto unlock;
+
+		/* The file was replaced */
+		if (p->size != i_size_read(inode)) {
+			p->size = i_size_read(inode);
+			p->nr = 0;
+		}
+
+		p->tgid = current->tgid;
+		p->launch_start = leader->start_time;
+		p->nr_rec = 0;
+		p->launches++;
+		p->file = get_file(file);
+		p->replay_pending = true;
+		list_move(&p->lru, &ra_profile_lru);
+		queue_delayed_work(system_unbound_wq, &p->work, 0);
+	} else if (!p->file) {
+		/* This launch is over */
+		goto unlock;
+	}
+
+	if (!cached)
+		p->misses++;
+	ra_profile_record(p, offset);
+unlock:
+	spin_unlock(&ra_lock);
+
+	if (new)
+		ra_profile_free(new);
+	if (old)
+		ra_profile_free(old);
+}
+
+static int ra_profile_show(struct seq_file *m, void *v)
+{
+	struct ra_profile *p;
+
+	spin_lock(&ra_lock);
+	list_for_each_entry(p, &ra_profile_lru, lru)
+		seq_printf(m, "%-16s %u:%u %lu pages=%u launches=%lu replayed=%lu used=%lu wasted=%lu misses=%lu\n",
+			   p->comm, MAJOR(p->dev), MINOR(p->dev), p->ino,
+			   p->nr, p->launches, p->replayed, p->used,
+			   p->wasted, p->misses);
+	spin_unlock(&ra_lock);
+
+	return 0;
+}
+
+static int ra_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ra_profile_show, NULL);
+}
+
+static const struct file_operations ra_profile_fops = {
+	.open		= ra_profile_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ra_profile_init(void)
+{
+	debugfs_create_file("ra_profile", 0444, NULL, NULL, &ra_profile_fops);
+
+	return 0;
+}
+late_initcall(ra_profile_init);
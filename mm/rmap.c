@@ -58,6 +58,7 @@
 #include <linux/rcupdate.h>
 #include <linux/export.h>
 #include <linux/memcontrol.h>
+#include <linux/reclaim_class.h>
 #include <linux/mmu_notifier.h>
 #include <linux/migrate.h>
 #include <linux/hugetlb.h>
@@ -746,6 +747,8 @@ struct page_referenced_arg {
 	int referenced;
 	unsigned long vm_flags;
 	struct mem_cgroup *memcg;
+	/* BIT() of the reclaim classes of the mms mapping the page */
+	unsigned int classes;
 };
 /*
  * arg: page_referenced_arg will be passed
@@ -806,12 +809,44 @@ static bool page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		pra->vm_flags |= vma->vm_flags;
 	}
 
+#ifdef CONFIG_RECLAIM_CLASS
+	pra->classes |= BIT(READ_ONCE(vma->vm_mm->reclaim_class));
+#endif
+
 	if (!pra->mapcount)
 		return false; /* To break the loop */
 
 	return true;
 }
 
+#ifdef CONFIG_RECLAIM_CLASS
+/*
+ * Apply the app class reclaim profile: a file page mapped by a foreground
+ * app counts as referenced so it is kept, an anon page mapped only by
+ * cached apps counts as unreferenced so it goes to swap first.
+ */
+static int reclaim_class_referenced(struct page *page, int referenced,
+				    unsigned int classes)
+{
+	if (!sysctl_reclaim_class_enable || !classes)
+		return referenced;
+
+	if (!PageAnon(page) && (classes & BIT(RECLAIM_CLASS_FOREGROUND)))
+		return max(referenced, 1);
+
+	if (PageAnon(page) && classes == BIT(RECLAIM_CLASS_CACHED))
+		return 0;
+
+	return referenced;
+}
+#else
+static inline int reclaim_class_referenced(struct page *page, int referenced,
+					   unsigned int classes)
+{
+	return referenced;
+}
+#endif
+
 static bool invalid_page_referenced_vma(struct vm_area_struct *vma, void *arg)
 {
 	struct page_referenced_arg *pra = arg;
@@ -877,7 +912,7 @@ int page_referenced(struct page *page,
 	if (we_locked)
 		unlock_page(page);
 
-	return pra.referenced;
+	return reclaim_class_referenced(page, pra.referenced, pra.classes);
 }
 
 static bool page_mkclean_one(struct page *page, struct vm_area_struct *vma,
@@ -2379,6 +2379,175 @@ static void put_cpu_partial(struct kmem_cache *s, struct page *page, int drain)
 #endif
 }
 
+#ifdef CONFIG_SLUB_MAGAZINE
+/*
+ * Per cpu magazines
+ *
+ * Under heavy churn, most frees of skbuffs, binder transactions and small
+ * kmallocs are for objects that are not in the current cpu slab, and go
+ * through __slab_free() with a cmpxchg_double on the page and often the
+ * node list_lock. Caches named on the command line with
+ *
+ *	slub_magazine=<size>,<cache>[,<cache>...]
+ *
+ * get a per cpu array of up to size freed objects in front of the slabs.
+ * Frees push to it and allocations pop from it, with interrupts disabled
+ * instead of any atomics, so recently freed, cache hot objects are reused
+ * first. A full magazine frees its older half to the slabs. Debug caches
+ * and node specific allocations bypass the magazine.
+ */
+#define SLUB_MAGAZINE_MAX	64
+
+struct slub_magazine {
+	unsigned int nr;
+	void *objs[];
+};
+
+static unsigned int slub_magazine_size;
+static char *slub_magazine_caches;
+
+static int __init setup_slub_magazine(char *str)
+{
+	get_option(&str, &slub_magazine_size);
+	slub_magazine_size = min(slub_magazine_size, SLUB_MAGAZINE_MAX);
+	slub_magazine_caches = str;
+
+	return 1;
+}
+__setup("slub_magazine=", setup_slub_magazine);
+
+static bool slub_magazine_wanted(const char *name)
+{
+	const char *p = slub_magazine_caches;
+	size_t len = strlen(name);
+
+	while (p && *p) {
+		if (!strncmp(p, name, len) && (p[len] == ',' || !p[len]))
+			return true;
+		p = strchr(p, ',');
+		if (p)
+			p++;
+	}
+
+	return false;
+}
+
+static void alloc_kmem_cache_magazine(struct kmem_cache *s)
+{
+	if (slub_magazine_size < 2 || !s->name || kmem_cache_debug(s) ||
+	    !slub_magazine_wanted(s->name))
+		return;
+
+	s->mag = __alloc_percpu(sizeof(struct slub_magazine) +
+				slub_magazine_size * sizeof(void *),
+				sizeof(void *));
+	if (s->mag)
+		s->mag_size = slub_magazine_size;
+}
+
+static __always_inline void *magazine_alloc(struct kmem_cache *s)
+{
+	struct slub_magazine *mag;
+	unsigned long flags;
+	void *object = NULL;
+
+	local_irq_save(flags);
+	mag = this_cpu_ptr(s->mag);
+	if (mag->nr)
+		object = mag->objs[--mag->nr];
+	local_irq_restore(flags);
+
+	if (object)
+		stat(s, ALLOC_MAGAZINE);
+
+	return object;
+}
+
+static __always_inline void do_slab_free(struct kmem_cache *s,
+				struct page *page, void *head, void *tail,
+				int cnt, unsigned long addr);
+
+/* Free the older half of a full magazine to make room for @object */
+static noinline void magazine_flush(struct kmem_cache *s, void *object,
+				    unsigned long addr)
+{
+	void *objs[SLUB_MAGAZINE_MAX / 2];
+	struct slub_magazine *mag;
+	unsigned long flags;
+	unsigned int i, nr;
+
+	local_irq_save(flags);
+	mag = this_cpu_ptr(s->mag);
+	nr = mag->nr / 2;
+	memcpy(objs, mag->objs, nr * sizeof(void *));
+	memmove(mag->objs, mag->objs + nr, (mag->nr - nr) * sizeof(void *));
+	mag->nr -= nr;
+	mag->objs[mag->nr++] = object;
+	local_irq_restore(flags);
+
+	stat(s, MAGAZINE_FLUSH);
+	for (i = 0; i < nr; i++)
+		do_slab_free(s, virt_to_head_page(objs[i]), objs[i], NULL, 1,
+			     addr);
+}
+
+static __always_inline void magazine_free(struct kmem_cache *s, void *object,
+					  unsigned long addr)
+{
+	struct slub_magazine *mag;
+	unsigned long flags;
+	bool done = false;
+
+	local_irq_save(flags);
+	mag = this_cpu_ptr(s->mag);
+	if (mag->nr < s->mag_size) {
+		mag->objs[mag->nr++] = object;
+		done = true;
+	}
+	local_irq_restore(flags);
+
+	if (done)
+		stat(s, FREE_MAGAZINE);
+	else
+		magazine_flush(s, object, addr);
+}
+
+/* Called with interrupts disabled */
+static void magazine_drain(struct kmem_cache *s, int cpu)
+{
+	struct slub_magazine *mag;
+	void *object;
+
+	if (!s->mag)
+		return;
+
+	mag = per_cpu_ptr(s->mag, cpu);
+	while (mag->nr) {
+		object = mag->objs[--mag->nr];
+		do_slab_free(s, virt_to_head_page(object), object, NULL, 1,
+			     _RET_IP_);
+	}
+}
+
+static bool magazine_empty(struct kmem_cache *s, int cpu)
+{
+	return !s->mag || !per_cpu_ptr(s->mag, cpu)->nr;
+}
+#else
+static inline void alloc_kmem_cache_magazine(struct kmem_cache *s)
+{
+}
+
+static inline void magazine_drain(struct kmem_cache *s, int cpu)
+{
+}
+
+static inline bool magazine_empty(struct kmem_cache *s, int cpu)
+{
+	return true;
+}
+#endif
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	stat(s, CPUSLAB_FLUSH);
@@ -2396,6 +2565,8 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	magazine_drain(s, cpu);
+
 	if (likely(c)) {
 		if (c->page)
 			flush_slab(s, c);
@@ -2416,7 +2587,7 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->page || slub_percpu_partial(c);
+	return c->page || slub_percpu_partial(c) || !magazine_empty(s, cpu);
 }
 
 static void flush_all(struct kmem_cache *s)
@@ -2772,6 +2943,14 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	s = slab_pre_alloc_hook(s, gfpflags);
 	if (!s)
 		return NULL;
+
+#ifdef CONFIG_SLUB_MAGAZINE
+	if (s->mag && node == NUMA_NO_NODE) {
+		object = magazine_alloc(s);
+		if (object)
+			goto out;
+	}
+#endif
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2840,6 +3019,9 @@ redo:
 		stat(s, ALLOC_FASTPATH);
 	}
 
+#ifdef CONFIG_SLUB_MAGAZINE
+out:
+#endif
 	maybe_wipe_obj_freeptr(s, object);
 
 	if (unlikely(slab_want_init_on_alloc(gfpflags, s)) && object)
@@ -3094,8 +3276,16 @@ static __always_inline void slab_free(struct kmem_cache *s, struct page *page,
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
 	 */
-	if (slab_free_freelist_hook(s, &head, &tail))
-		do_slab_free(s, page, head, tail, cnt, addr);
+	if (!slab_free_freelist_hook(s, &head, &tail))
+		return;
+
+#ifdef CONFIG_SLUB_MAGAZINE
+	if (s->mag && !tail) {
+		magazine_free(s, head, addr);
+		return;
+	}
+#endif
+	do_slab_free(s, page, head, tail, cnt, addr);
 }
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -3514,6 +3704,9 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+#ifdef CONFIG_SLUB_MAGAZINE
+	free_percpu(s->mag);
+#endif
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -3761,8 +3954,10 @@ static int kmem_cache_open(struct kmem_cache *s, unsigned long flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (alloc_kmem_cache_cpus(s)) {
+		alloc_kmem_cache_magazine(s);
 		return 0;
+	}
 
 	free_kmem_cache_nodes(s);
 error:
@@ -5232,6 +5427,14 @@ static ssize_t reserved_show(struct kmem_cache *s, char *buf)
 }
 SLAB_ATTR_RO(reserved);
 
+#ifdef CONFIG_SLUB_MAGAZINE
+static ssize_t magazine_size_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%u\n", s->mag_size);
+}
+SLAB_ATTR_RO(magazine_size);
+#endif
+
 #ifdef CONFIG_SLUB_DEBUG
 static ssize_t slabs_show(struct kmem_cache *s, char *buf)
 {
@@ -5526,6 +5729,9 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_MAGAZINE, alloc_magazine);
+STAT_ATTR(FREE_MAGAZINE, free_magazine);
+STAT_ATTR(MAGAZINE_FLUSH, magazine_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -5547,6 +5753,9 @@ static struct attribute *slab_attrs[] = {
 	&destroy_by_rcu_attr.attr,
 	&shrink_attr.attr,
 	&reserved_attr.attr,
+#ifdef CONFIG_SLUB_MAGAZINE
+	&magazine_size_attr.attr,
+#endif
 	&slabs_cpu_partial_attr.attr,
 #ifdef CONFIG_SLUB_DEBUG
 	&total_objects_attr.attr,
@@ -5593,6 +5802,9 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_magazine_attr.attr,
+	&free_magazine_attr.attr,
+	&magazine_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
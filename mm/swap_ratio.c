@@ -14,6 +14,9 @@
 #include <linux/mm_types.h>
 #include <linux/swapfile.h>
 #include <linux/swap.h>
+#include <linux/page-flags.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define SWAP_RATIO_GROUP_START (SWAP_FLAG_PRIO_MASK - 9) /* 32758 */
 #define SWAP_RATIO_GROUP_END (SWAP_FLAG_PRIO_MASK) /* 32767 */
@@ -31,6 +34,12 @@ int sysctl_swap_ratio = 100;
 /* Enable the swap ratio feature */
 int sysctl_swap_ratio_enable;
 
+/*
+ * Place pages on the fast or slow device of the swap ratio group by
+ * their predicted reuse instead of by the static ratio.
+ */
+int sysctl_swap_ratio_placement;
+
 static bool is_same_group(struct swap_info_struct *a,
 		struct swap_info_struct *b)
 {
@@ -188,6 +197,98 @@ void setup_swap_ratio(struct swap_info_struct *p, int prio)
 	}
 }
 
+/*
+ * Pick the device of the swap ratio group for @page. PG_workingset is set
+ * on pages that were deactivated from the active list or were swapped in
+ * before, i.e. pages that have shown reuse, so those go to the fast
+ * (synchronous) device. Pages that never made it to the active list are
+ * expected to stay cold and go to the slow device. Returns an empty entry
+ * if there is no such group, so the caller falls back to the normal path.
+ */
+swp_entry_t swap_ratio_place(struct page *page)
+{
+	struct swap_info_struct *si, *fast = NULL, *slow = NULL;
+	struct swap_info_struct *first, *second;
+	bool hot = PageWorkingset(page);
+	swp_entry_t entry = {0};
+	int node = numa_node_id();
+
+	spin_lock(&swap_avail_lock);
+	plist_for_each_entry(si, &swap_avail_heads[node], avail_lists[node]) {
+		if (!is_swap_ratio_group(si->prio))
+			continue;
+		if (si->flags & SWP_SYNCHRONOUS_IO) {
+			if (!fast)
+				fast = si;
+		} else if (!slow) {
+			slow = si;
+		}
+	}
+	spin_unlock(&swap_avail_lock);
+
+	if (!fast || !slow || fast->prio != slow->prio)
+		return entry;
+
+	first = hot ? fast : slow;
+	second = hot ? slow : fast;
+
+	entry = get_swap_page_from(first);
+	if (!entry.val)
+		entry = get_swap_page_from(second);
+	if (!entry.val)
+		return entry;
+
+	si = swap_info[swp_type(entry)];
+	if (hot)
+		atomic_long_inc(&si->nr_hot_writes);
+	else
+		atomic_long_inc(&si->nr_cold_writes);
+
+	return entry;
+}
+
+static int swap_ratio_stats_show(struct seq_file *m, void *v)
+{
+	struct swap_info_struct *si;
+	int type;
+
+	seq_puts(m, "type prio sync hot_writes cold_writes refaults\n");
+	spin_lock(&swap_lock);
+	for (type = 0; type < MAX_SWAPFILES; type++) {
+		si = swap_info[type];
+		if (!si || !(si->flags & SWP_WRITEOK))
+			continue;
+		seq_printf(m, "%4d %4d %4d %10ld %11ld %8ld\n", type, si->prio,
+			   !!(si->flags & SWP_SYNCHRONOUS_IO),
+			   atomic_long_read(&si->nr_hot_writes),
+			   atomic_long_read(&si->nr_cold_writes),
+			   atomic_long_read(&si->nr_refaults));
+	}
+	spin_unlock(&swap_lock);
+
+	return 0;
+}
+
+static int swap_ratio_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, swap_ratio_stats_show, NULL);
+}
+
+static const struct file_operations swap_ratio_stats_fops = {
+	.open		= swap_ratio_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init swap_ratio_debugfs_init(void)
+{
+	debugfs_create_file("swap_ratio_stats", 0444, NULL, NULL,
+			    &swap_ratio_stats_fops);
+	return 0;
+}
+late_initcall(swap_ratio_debugfs_init);
+
 int swap_ratio(struct swap_info_struct **si, int node)
 {
 	if (!sysctl_swap_ratio_enable)
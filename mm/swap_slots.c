@@ -33,6 +33,7 @@
 #include <linux/vmalloc.h>
 #include <linux/mutex.h>
 #include <linux/mm.h>
+#include <linux/swapfile.h>
 
 #ifdef CONFIG_SWAP
 
@@ -318,6 +319,12 @@ swp_entry_t get_swap_page(struct page *page)
 		return entry;
 	}
 
+	if (sysctl_swap_ratio_enable && sysctl_swap_ratio_placement) {
+		entry = swap_ratio_place(page);
+		if (entry.val)
+			return entry;
+	}
+
 	/*
 	 * Preemption is allowed here, because we may sleep
 	 * in refill_swap_slots_cache().  But it is safe, because
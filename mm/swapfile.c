@@ -1032,6 +1032,28 @@ noswap:
 	return n_ret;
 }
 
+/*
+ * Allocate one swap cache entry from @si. Used by the swap ratio
+ * placement policy, which picks the device for each page itself.
+ */
+swp_entry_t get_swap_page_from(struct swap_info_struct *si)
+{
+	swp_entry_t entry = {0};
+	int n = 0;
+
+	if (atomic_long_dec_return(&nr_swap_pages) < 0)
+		goto out;
+
+	spin_lock(&si->lock);
+	if ((si->flags & SWP_WRITEOK) && si->highest_bit)
+		n = scan_swap_map_slots(si, SWAP_HAS_CACHE, 1, &entry);
+	spin_unlock(&si->lock);
+out:
+	if (!n)
+		atomic_long_inc(&nr_swap_pages);
+	return entry;
+}
+
 /* The only caller of this function is now suspend routine */
 swp_entry_t get_swap_page_of_type(int type)
 {
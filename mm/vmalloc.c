@@ -9,6 +9,7 @@
  */
 
 #include <linux/vmalloc.h>
+#include <linux/debugfs.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/highmem.h>
@@ -34,6 +35,7 @@
 #include <linux/overflow.h>
 
 #include <linux/uaccess.h>
+#include <linux/workqueue.h>
 #include <asm/tlbflush.h>
 #include <asm/shmparam.h>
 
@@ -711,8 +713,36 @@ static unsigned long lazy_max_pages(void)
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
 }
 
+/*
+ * Crossing lazy_max_pages used to purge, with a global TLB flush, in the
+ * context of whichever task freed the area that crossed it, often in the
+ * middle of a frame. Instead a deferrable work item purges once
+ * purge_delay_ms have passed and the CPU is awake anyway, batching
+ * whatever else was freed meanwhile. The freeing task only purges itself
+ * past lazy_hard_max_pages(), or when purge_delay_ms is 0.
+ */
+static unsigned int purge_delay_ms = 20;
+module_param(purge_delay_ms, uint, 0644);
+
+static unsigned long lazy_hard_max_pages(void)
+{
+	return 2 * lazy_max_pages();
+}
+
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
+/* Protected by vmap_purge_lock */
+static struct {
+	unsigned long purges;
+	unsigned long deferred;
+	unsigned long pages;
+	u64 flush_ns;
+	u64 flush_max_ns;
+} vmap_purge_stats;
+
+static void vmap_purge_work_fn(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(vmap_purge_work, vmap_purge_work_fn);
+
 /*
  * Serialize vmap purging.  There is no actual criticial section protected
  * by this look, but we want to avoid concurrent calls for performance
@@ -729,7 +759,7 @@ static void purge_fragmented_blocks_allcpus(void);
  */
 void set_iounmap_nonlazy(void)
 {
-	atomic_set(&vmap_lazy_nr, lazy_max_pages()+1);
+	atomic_set(&vmap_lazy_nr, lazy_hard_max_pages()+1);
 }
 
 /*
@@ -741,6 +771,7 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	struct vmap_area *va;
 	struct vmap_area *n_va;
 	bool do_free = false;
+	u64 t;
 
 	lockdep_assert_held(&vmap_purge_lock);
 
@@ -756,7 +787,14 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	if (!do_free)
 		return false;
 
+	t = ktime_get_ns();
 	flush_tlb_kernel_range(start, end);
+	t = ktime_get_ns() - t;
+
+	vmap_purge_stats.purges++;
+	vmap_purge_stats.flush_ns += t;
+	if (t > vmap_purge_stats.flush_max_ns)
+		vmap_purge_stats.flush_max_ns = t;
 
 	spin_lock(&vmap_area_lock);
 	llist_for_each_entry_safe(va, n_va, valist, purge_list) {
@@ -764,6 +802,7 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 
 		__free_vmap_area(va);
 		atomic_sub(nr, &vmap_lazy_nr);
+		vmap_purge_stats.pages += nr;
 		cond_resched_lock(&vmap_area_lock);
 	}
 	spin_unlock(&vmap_area_lock);
@@ -793,6 +832,52 @@ static void purge_vmap_area_lazy(void)
 	mutex_unlock(&vmap_purge_lock);
 }
 
+static void vmap_purge_work_fn(struct work_struct *work)
+{
+	mutex_lock(&vmap_purge_lock);
+	/* a synchronous purge may have beaten us to it */
+	if (atomic_read(&vmap_lazy_nr) > lazy_max_pages() &&
+	    __purge_vmap_area_lazy(ULONG_MAX, 0))
+		vmap_purge_stats.deferred++;
+	mutex_unlock(&vmap_purge_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int vmap_purge_show(struct seq_file *m, void *v)
+{
+	mutex_lock(&vmap_purge_lock);
+	seq_printf(m, "purges: %lu\n", vmap_purge_stats.purges);
+	seq_printf(m, "deferred: %lu\n", vmap_purge_stats.deferred);
+	seq_printf(m, "pages: %lu\n", vmap_purge_stats.pages);
+	seq_printf(m, "flush_ns: %llu\n", vmap_purge_stats.flush_ns);
+	seq_printf(m, "flush_max_ns: %llu\n", vmap_purge_stats.flush_max_ns);
+	seq_printf(m, "lazy_pages: %d\n", atomic_read(&vmap_lazy_nr));
+	mutex_unlock(&vmap_purge_lock);
+
+	return 0;
+}
+
+static int vmap_purge_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vmap_purge_show, NULL);
+}
+
+static const struct file_operations vmap_purge_fops = {
+	.open		= vmap_purge_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init vmap_purge_debugfs_init(void)
+{
+	debugfs_create_file("vmap_purge", 0444, NULL, NULL, &vmap_purge_fops);
+
+	return 0;
+}
+late_initcall(vmap_purge_debugfs_init);
+#endif
+
 /*
  * Free a vmap area, caller ensuring that the area has been unmapped
  * and flush_cache_vunmap had been called for the correct range
@@ -808,8 +893,13 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 	/* After this point, we may free va at any time */
 	llist_add(&va->purge_list, &vmap_purge_list);
 
-	if (unlikely(nr_lazy > lazy_max_pages()))
-		try_purge_vmap_area_lazy();
+	if (unlikely(nr_lazy > lazy_max_pages())) {
+		if (!purge_delay_ms || nr_lazy > lazy_hard_max_pages())
+			try_purge_vmap_area_lazy();
+		else
+			queue_delayed_work(system_unbound_wq, &vmap_purge_work,
+					   msecs_to_jiffies(purge_delay_ms));
+	}
 }
 
 /*
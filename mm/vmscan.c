@@ -43,6 +43,7 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/memcontrol.h>
+#include <linux/reclaim_class.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
 #include <linux/oom.h>
@@ -158,6 +159,16 @@ struct scan_control {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 100;
+
+#ifdef CONFIG_RECLAIM_CLASS
+/* App class reclaim profiles, see include/linux/reclaim_class.h */
+int sysctl_reclaim_class_enable;
+int sysctl_reclaim_class_foreground_adj;
+int sysctl_reclaim_class_cached_adj = 900;
+/* swappiness used by kswapd while profiles are enabled, -1 for the global */
+int sysctl_reclaim_class_kswapd_swappiness = -1;
+#endif
+
 /*
  * The total number of pages which are beyond the high watermark within all
  * zones.
@@ -962,6 +973,82 @@ struct reclaim_stat {
 	unsigned nr_unmap_fail;
 };
 
+#ifdef CONFIG_SWAP_WRITE_BATCH
+/*
+ * Anon pages that shrink_page_list() has added to swap and unmapped are
+ * collected here instead of being written one by one, so that the rmap
+ * walks of a whole batch run back to back, the TLB is flushed once for
+ * all of them, and the writes to the swap device, usually zram and
+ * synchronous, are issued together under one plug. Pages that were
+ * written synchronously are freed right away, like shrink_page_list()
+ * does. Returns the number of pages freed.
+ */
+static unsigned long shrink_swap_batch(struct list_head *batch,
+				       struct pglist_data *pgdat,
+				       struct scan_control *sc,
+				       struct list_head *free_pages,
+				       struct list_head *ret_pages,
+				       int *pgactivate)
+{
+	unsigned long nr_reclaimed = 0;
+	struct address_space *mapping;
+	struct blk_plug plug;
+	struct page *page;
+
+	try_to_unmap_flush_dirty();
+	blk_start_plug(&plug);
+	while (!list_empty(batch)) {
+		page = lru_to_page(batch);
+		list_del(&page->lru);
+		mapping = page_mapping(page);
+
+		switch (pageout(page, mapping, sc)) {
+		case PAGE_KEEP:
+			goto keep_locked;
+		case PAGE_ACTIVATE:
+			goto activate_locked;
+		case PAGE_SUCCESS:
+			if (PageWriteback(page) || PageDirty(page))
+				goto keep;
+			if (!trylock_page(page))
+				goto keep;
+			if (PageDirty(page) || PageWriteback(page))
+				goto keep_locked;
+			mapping = page_mapping(page);
+		case PAGE_CLEAN:
+			; /* try to free the page below */
+		}
+
+		if (page_has_private(page) || !mapping ||
+		    !__remove_mapping(mapping, page, true))
+			goto keep_locked;
+
+		__ClearPageLocked(page);
+		nr_reclaimed++;
+		list_add(&page->lru, free_pages);
+		if (!pgdat)
+			dec_node_page_state(page, NR_ISOLATED_ANON);
+		continue;
+
+activate_locked:
+		if (mem_cgroup_swap_full(page) || PageMlocked(page))
+			try_to_free_swap(page);
+		if (!PageMlocked(page)) {
+			SetPageActive(page);
+			(*pgactivate)++;
+			count_memcg_page_event(page, PGACTIVATE);
+		}
+keep_locked:
+		unlock_page(page);
+keep:
+		list_add(&page->lru, ret_pages);
+	}
+	blk_finish_plug(&plug);
+
+	return nr_reclaimed;
+}
+#endif
+
 /*
  * shrink_page_list() returns the number of reclaimed pages
  */
@@ -974,6 +1061,10 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 {
 	LIST_HEAD(ret_pages);
 	LIST_HEAD(free_pages);
+#ifdef CONFIG_SWAP_WRITE_BATCH
+	LIST_HEAD(swap_batch);
+	unsigned int nr_batch = 0;
+#endif
 	int pgactivate = 0;
 	unsigned nr_unqueued_dirty = 0;
 	unsigned nr_dirty = 0;
@@ -1236,6 +1327,20 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			if (!sc->may_writepage)
 				goto keep_locked;
 
+#ifdef CONFIG_SWAP_WRITE_BATCH
+			if (PageAnon(page) && PageSwapCache(page) &&
+			    !PageTransHuge(page)) {
+				list_add_tail(&page->lru, &swap_batch);
+				if (++nr_batch < SWAP_CLUSTER_MAX)
+					continue;
+				nr_reclaimed += shrink_swap_batch(&swap_batch,
+						pgdat, sc, &free_pages,
+						&ret_pages, &pgactivate);
+				nr_batch = 0;
+				continue;
+			}
+#endif
+
 			/*
 			 * Page is dirty. Flush the TLB if a writable entry
 			 * potentially exists to avoid CPU writes after IO
@@ -1369,6 +1474,12 @@ keep:
 		VM_BUG_ON_PAGE(PageLRU(page) || PageUnevictable(page), page);
 	}
 
+#ifdef CONFIG_SWAP_WRITE_BATCH
+	if (nr_batch)
+		nr_reclaimed += shrink_swap_batch(&swap_batch, pgdat, sc,
+				&free_pages, &ret_pages, &pgactivate);
+#endif
+
 	mem_cgroup_uncharge_list(&free_pages);
 	try_to_unmap_flush();
 	free_hot_cold_page_list(&free_pages, true);
@@ -2258,6 +2369,24 @@ enum scan_balance {
 	SCAN_FILE,
 };
 
+#ifdef CONFIG_RECLAIM_CLASS
+static int reclaim_swappiness(struct mem_cgroup *memcg)
+{
+	int swappiness = READ_ONCE(sysctl_reclaim_class_kswapd_swappiness);
+
+	if (sysctl_reclaim_class_enable && swappiness >= 0 &&
+	    current_is_kswapd())
+		return swappiness;
+
+	return mem_cgroup_swappiness(memcg);
+}
+#else
+static inline int reclaim_swappiness(struct mem_cgroup *memcg)
+{
+	return mem_cgroup_swappiness(memcg);
+}
+#endif
+
 /*
  * Determine how aggressively the anon and file LRU lists should be
  * scanned.  The relative value of each set of LRU lists is determined
@@ -2271,7 +2400,7 @@ static void get_scan_count(struct lruvec *lruvec, struct mem_cgroup *memcg,
 			   struct scan_control *sc, unsigned long *nr,
 			   unsigned long *lru_pages)
 {
-	int swappiness = mem_cgroup_swappiness(memcg);
+	int swappiness = reclaim_swappiness(memcg);
 	struct zone_reclaim_stat *reclaim_stat = &lruvec->reclaim_stat;
 	u64 fraction[2];
 	u64 denominator = 0;	/* gcc */
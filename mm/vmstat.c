@@ -1079,6 +1079,11 @@ const char * const vmstat_text[] = {
 	"workingset_activate",
 	"workingset_restore",
 	"workingset_nodereclaim",
+	"workingset_refault_ro",
+	"workingset_refault_rw",
+	"workingset_refault_swap",
+	"workingset_distance_ro",
+	"workingset_distance_rw",
 	"nr_anon_pages",
 	"nr_mapped",
 	"nr_file_pages",
@@ -1568,6 +1573,15 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
 			   pageset->pcp.batch);
+#ifdef CONFIG_PCP_AUTOTUNE
+		seq_printf(m,
+			   "\n              hit:   %lu"
+			   "\n              refill: %lu"
+			   "\n              drain: %lu",
+			   pageset->pcp.hit,
+			   pageset->pcp.refill,
+			   pageset->pcp.drain);
+#endif
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
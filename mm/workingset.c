@@ -306,6 +306,20 @@ void workingset_refault(struct page *page, void *shadow)
 
 	inc_lruvec_state(lruvec, WORKINGSET_REFAULT);
 
+	/*
+	 * Split by backing store: read-only filesystems hold the system
+	 * images, APKs and libraries, writable ones the data files.
+	 */
+	if (sb_rdonly(page->mapping->host->i_sb)) {
+		inc_lruvec_state(lruvec, WORKINGSET_REFAULT_RO);
+		mod_lruvec_state(lruvec, WORKINGSET_DISTANCE_RO,
+				 min(refault_distance, (unsigned long)INT_MAX));
+	} else {
+		inc_lruvec_state(lruvec, WORKINGSET_REFAULT_RW);
+		mod_lruvec_state(lruvec, WORKINGSET_DISTANCE_RW,
+				 min(refault_distance, (unsigned long)INT_MAX));
+	}
+
 	/*
 	 * Compare the distance to the existing workingset size. We
 	 * don't act on pages that couldn't stay resident even if all
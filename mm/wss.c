@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per process working set estimation
+ *
+ * Scanning all of memory through /sys/kernel/mm/page_idle takes seconds on
+ * large devices. Instead, kwssd keeps a small set of sampled virtual pages
+ * per mm and tests their accessed bits once per period. A resident sample
+ * ages by one period every scan it is found idle, and the share of samples
+ * in each age bucket, applied to the RSS, estimates how much of the process
+ * was last used that long ago. Non resident samples are replaced by new
+ * random addresses on every scan.
+ *
+ * As with idle page tracking, cleared accessed bits are carried over to
+ * PG_young so that page reclaim still sees the references.
+ */
+
+#include <linux/freezer.h>
+#include <linux/kthread.h>
+#include <linux/mm.h>
+#include <linux/mm_wss.h>
+#include <linux/mmu_notifier.h>
+#include <linux/module.h>
+#include <linux/oom.h>
+#include <linux/page_idle.h>
+#include <linux/pid_namespace.h>
+#include <linux/random.h>
+#include <linux/rmap.h>
+#include <linux/sched/mm.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+
+#define WSS_NR_SAMPLES	256
+/* idle for 0, 1, 2-3, 4-7, 8-15 and 16 or more periods */
+#define WSS_NR_BUCKETS	6
+/* mms pinned at once by the process walk */
+#define WSS_BATCH	32
+
+struct mm_wss {
+	spinlock_t lock;
+	unsigned long kb[WSS_NR_BUCKETS];
+	unsigned long scans;
+	unsigned long addr[WSS_NR_SAMPLES];
+	u8 age[WSS_NR_SAMPLES];
+};
+
+enum wss_state {
+	WSS_ABSENT,
+	WSS_IDLE,
+	WSS_YOUNG,
+};
+
+struct wss_walk {
+	struct vm_area_struct *vma;
+	enum wss_state state;
+};
+
+static bool wss_enable = true;
+module_param_named(enable, wss_enable, bool, 0644);
+
+static unsigned int wss_period_ms = 2000;
+module_param_named(period_ms, wss_period_ms, uint, 0644);
+
+/* Only used by kwssd */
+static unsigned int wss_refill_idx[WSS_NR_SAMPLES];
+static unsigned long wss_refill_off[WSS_NR_SAMPLES];
+
+static bool wss_vma_eligible(struct vm_area_struct *vma)
+{
+	if (is_vm_hugetlb_page(vma) || (vma->vm_flags & (VM_IO | VM_PFNMAP)))
+		return false;
+
+	/* Skip reserved and guard regions, they are never resident */
+	return vma->vm_flags & (VM_READ | VM_WRITE | VM_EXEC);
+}
+
+static int wss_pmd_entry(pmd_t *pmd, unsigned long addr, unsigned long end,
+			 struct mm_walk *walk)
+{
+	struct wss_walk *ww = walk->private;
+	struct vm_area_struct *vma = ww->vma;
+	struct page *page = NULL;
+	bool young = false;
+	spinlock_t *ptl;
+	pte_t *pte;
+
+	ptl = pmd_trans_huge_lock(pmd, vma);
+	if (ptl) {
+		if (pmd_present(*pmd)) {
+			page = pmd_page(*pmd);
+			young = pmdp_clear_young_notify(vma, addr, pmd);
+			if (young)
+				set_page_young(page);
+		}
+		spin_unlock(ptl);
+		goto out;
+	}
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	if (pte_present(*pte)) {
+		page = vm_normal_page(vma, addr, *pte);
+		if (page) {
+			young = ptep_clear_young_notify(vma, addr, pte);
+			if (young)
+				set_page_young(compound_head(page));
+		}
+	}
+	pte_unmap_unlock(pte, ptl);
+out:
+	if (page)
+		ww->state = young ? WSS_YOUNG : WSS_IDLE;
+	return 0;
+}
+
+static enum wss_state wss_test_young(struct mm_struct *mm, unsigned long addr)
+{
+	struct wss_walk ww = {
+		.state = WSS_ABSENT,
+	};
+	struct mm_walk walk = {
+		.mm = mm,
+		.pmd_entry = wss_pmd_entry,
+		.private = &ww,
+	};
+
+	ww.vma = find_vma(mm, addr);
+	if (!ww.vma || addr < ww.vma->vm_start || !wss_vma_eligible(ww.vma))
+		return WSS_ABSENT;
+
+	walk_page_range(addr, addr + PAGE_SIZE, &walk);
+
+	return ww.state;
+}
+
+static int wss_cmp_ulong(const void *a, const void *b)
+{
+	unsigned long la = *(const unsigned long *)a;
+	unsigned long lb = *(const unsigned long *)b;
+
+	if (la == lb)
+		return 0;
+
+	return la < lb ? -1 : 1;
+}
+
+/*
+ * Give the samples in wss_refill_idx new addresses, uniformly over the
+ * eligible mappings. The random page offsets are sorted so that a single
+ * pass over the VMAs places all of them.
+ */
+static void wss_refill(struct mm_struct *mm, struct mm_wss *wss, int nr)
+{
+	struct vm_area_struct *vma;
+	unsigned long total = 0, base = 0, pages;
+	int i = 0;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next)
+		if (wss_vma_eligible(vma))
+			total += vma_pages(vma);
+
+	total = min_t(unsigned long, total, U32_MAX);
+	if (!total) {
+		while (i < nr)
+			wss->addr[wss_refill_idx[i++]] = 0;
+		return;
+	}
+
+	for (i = 0; i < nr; i++)
+		wss_refill_off[i] = prandom_u32_max(total);
+	sort(wss_refill_off, nr, sizeof(*wss_refill_off), wss_cmp_ulong, NULL);
+
+	i = 0;
+	for (vma = mm->mmap; vma && i < nr; vma = vma->vm_next) {
+		if (!wss_vma_eligible(vma))
+			continue;
+
+		pages = vma_pages(vma);
+		for (; i < nr && wss_refill_off[i] < base + pages; i++) {
+			wss->addr[wss_refill_idx[i]] = vma->vm_start +
+				((wss_refill_off[i] - base) << PAGE_SHIFT);
+			wss->age[wss_refill_idx[i]] = 0;
+		}
+		base += pages;
+	}
+}
+
+static int wss_bucket(u8 age)
+{
+	return min(fls(age), WSS_NR_BUCKETS - 1);
+}
+
+static void wss_scan_mm(struct mm_struct *mm)
+{
+	unsigned int count[WSS_NR_BUCKETS] = { 0 };
+	unsigned int nr_resident = 0;
+	struct mm_wss *wss = mm->wss;
+	enum wss_state state;
+	unsigned long rss;
+	int i, nr_refill = 0;
+
+	if (!wss) {
+		wss = kzalloc(sizeof(*wss), GFP_KERNEL);
+		if (!wss)
+			return;
+		spin_lock_init(&wss->lock);
+		/* Only kwssd sets it, readers hold the mm */
+		smp_store_release(&mm->wss, wss);
+	}
+
+	down_read(&mm->mmap_sem);
+	for (i = 0; i < WSS_NR_SAMPLES; i++) {
+		state = wss->addr[i] ? wss_test_young(mm, wss->addr[i]) :
+			WSS_ABSENT;
+		if (state == WSS_ABSENT) {
+			wss_refill_idx[nr_refill++] = i;
+			continue;
+		}
+
+		if (state == WSS_YOUNG)
+			wss->age[i] = 0;
+		else if (wss->age[i] < U8_MAX)
+			wss->age[i]++;
+
+		count[wss_bucket(wss->age[i])]++;
+		nr_resident++;
+	}
+	if (nr_refill)
+		wss_refill(mm, wss, nr_refill);
+	flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+
+	rss = get_mm_rss(mm) << (PAGE_SHIFT - 10);
+
+	spin_lock(&wss->lock);
+	for (i = 0; i < WSS_NR_BUCKETS; i++)
+		wss->kb[i] = nr_resident ?
+			div_u64((u64)rss * count[i], nr_resident) : 0;
+	wss->scans++;
+	spin_unlock(&wss->lock);
+}
+
+/* Walk the processes in tgid order, a batch of pinned mms at a time */
+static void wss_scan_all(void)
+{
+	struct mm_struct *mms[WSS_BATCH];
+	struct task_struct *task, *p;
+	struct pid *pid;
+	int nr = 1, n, i;
+
+	do {
+		n = 0;
+		rcu_read_lock();
+		while (n < WSS_BATCH &&
+		       (pid = find_ge_pid(nr, &init_pid_ns)) != NULL) {
+			nr = pid_nr(pid) + 1;
+			task = pid_task(pid, PIDTYPE_PID);
+			if (!task || !thread_group_leader(task) ||
+			    (task->flags & PF_KTHREAD))
+				continue;
+
+			p = find_lock_task_mm(task);
+			if (!p)
+				continue;
+			mmget(p->mm);
+			mms[n++] = p->mm;
+			task_unlock(p);
+		}
+		rcu_read_unlock();
+
+		for (i = 0; i < n; i++) {
+			wss_scan_mm(mms[i]);
+			mmput(mms[i]);
+			cond_resched();
+		}
+	} while (n == WSS_BATCH && !kthread_should_stop());
+}
+
+static int kwssd(void *unused)
+{
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		if (READ_ONCE(wss_enable))
+			wss_scan_all();
+
+		freezable_schedule_timeout_interruptible(
+				msecs_to_jiffies(wss_period_ms ?: 1));
+	}
+
+	return 0;
+}
+
+void mm_wss_free(struct mm_struct *mm)
+{
+	kfree(mm->wss);
+}
+
+/* Estimated kB of the process by how long it has been idle */
+void mm_wss_show(struct seq_file *m, struct mm_struct *mm)
+{
+	unsigned long kb[WSS_NR_BUCKETS] = { 0 };
+	struct mm_wss *wss = smp_load_acquire(&mm->wss);
+	unsigned long scans = 0;
+	int i;
+
+	if (wss) {
+		spin_lock(&wss->lock);
+		memcpy(kb, wss->kb, sizeof(kb));
+		scans = wss->scans;
+		spin_unlock(&wss->lock);
+	}
+
+	seq_printf(m, "period_ms: %u\nscans: %lu\n", wss_period_ms, scans);
+	for (i = 0; i < WSS_NR_BUCKETS; i++)
+		seq_printf(m, "idle_%u: %lu kB\n",
+			   i ? (1U << (i - 1)) * wss_period_ms : 0, kb[i]);
+}
+
+static int __init kwssd_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(kwssd, NULL, "kwssd");
+	if (IS_ERR(tsk)) {
+		pr_err("mm_wss: failed to start kwssd\n");
+		return PTR_ERR(tsk);
+	}
+
+	return 0;
+}
+late_initcall(kwssd_init);
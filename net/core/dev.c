@@ -148,6 +148,7 @@
 #include <net/udp_tunnel.h>
 #include <linux/tcp.h>
 #include <net/tcp.h>
+#include <linux/skb_latency.h>
 
 #include "net-sysfs.h"
 
@@ -4369,6 +4370,8 @@ static int __netif_receive_skb_core(struct sk_buff *skb, bool pfmemalloc)
 	int (*fast_recv)(struct sk_buff *skb, struct packet_type *pt_temp);
 
 	net_timestamp_check(!netdev_tstamp_prequeue, skb);
+	/* stacked devices pass here again, the last pass is kept */
+	skb_lat_stamp(skb, SKB_LAT_NETIF);
 
 	trace_netif_receive_skb(skb);
 
@@ -5413,9 +5416,25 @@ static struct napi_struct *napi_by_id(unsigned int napi_id)
 
 #if defined(CONFIG_NET_RX_BUSY_POLL)
 
-#define BUSY_POLL_BUDGET 8
+/* Busy polling runs outside of net_rx_action(), yet drivers feeding GRO
+ * from ->poll() may look up the napi they run in.
+ */
+static int busy_poll_napi(struct napi_struct *napi, int budget)
+{
+	struct softnet_data *sd = this_cpu_ptr(&softnet_data);
+	struct napi_struct *prev = sd->current_napi;
+	int work;
+
+	sd->current_napi = napi;
+	work = napi->poll(napi, budget);
+	trace_napi_poll(napi, work, budget);
+	sd->current_napi = prev;
 
-static void busy_poll_stop(struct napi_struct *napi, void *have_poll_lock)
+	return work;
+}
+
+static void busy_poll_stop(struct napi_struct *napi, void *have_poll_lock,
+			   int budget)
 {
 	int rc;
 
@@ -5436,25 +5455,25 @@ static void busy_poll_stop(struct napi_struct *napi, void *have_poll_lock)
 	/* All we really want here is to re-enable device interrupts.
 	 * Ideally, a new ndo_busy_poll_stop() could avoid another round.
 	 */
-	rc = napi->poll(napi, BUSY_POLL_BUDGET);
-	trace_napi_poll(napi, rc, BUSY_POLL_BUDGET);
+	rc = busy_poll_napi(napi, budget);
 	netpoll_poll_unlock(have_poll_lock);
-	if (rc == BUSY_POLL_BUDGET)
+	if (rc == budget)
 		__napi_schedule(napi);
 	local_bh_enable();
 }
 
 void napi_busy_loop(unsigned int napi_id,
 		    bool (*loop_end)(void *, unsigned long),
-		    void *loop_end_arg)
+		    void *loop_end_arg, u16 budget)
 {
 	unsigned long start_time = loop_end ? busy_loop_current_time() : 0;
-	int (*napi_poll)(struct napi_struct *napi, int budget);
 	void *have_poll_lock = NULL;
 	struct napi_struct *napi;
+	bool owned;
+	int weight;
 
 restart:
-	napi_poll = NULL;
+	owned = false;
 
 	rcu_read_lock();
 
@@ -5462,12 +5481,15 @@ restart:
 	if (!napi)
 		goto out;
 
+	/* drivers size their rings and batches for at most their weight */
+	weight = min_t(int, budget, napi->weight);
+
 	preempt_disable();
 	for (;;) {
 		int work = 0;
 
 		local_bh_disable();
-		if (!napi_poll) {
+		if (!owned) {
 			unsigned long val = READ_ONCE(napi->state);
 
 			/* If multiple threads are competing for this napi,
@@ -5481,10 +5503,9 @@ restart:
 					  NAPIF_STATE_SCHED) != val)
 				goto count;
 			have_poll_lock = netpoll_poll_lock(napi);
-			napi_poll = napi->poll;
+			owned = true;
 		}
-		work = napi_poll(napi, BUSY_POLL_BUDGET);
-		trace_napi_poll(napi, work, BUSY_POLL_BUDGET);
+		work = busy_poll_napi(napi, weight);
 count:
 		if (work > 0)
 			__NET_ADD_STATS(dev_net(napi->dev),
@@ -5495,8 +5516,8 @@ count:
 			break;
 
 		if (unlikely(need_resched())) {
-			if (napi_poll)
-				busy_poll_stop(napi, have_poll_lock);
+			if (owned)
+				busy_poll_stop(napi, have_poll_lock, weight);
 			preempt_enable();
 			rcu_read_unlock();
 			cond_resched();
@@ -5506,8 +5527,8 @@ count:
 		}
 		cpu_relax();
 	}
-	if (napi_poll)
-		busy_poll_stop(napi, have_poll_lock);
+	if (owned)
+		busy_poll_stop(napi, have_poll_lock, weight);
 	preempt_enable();
 out:
 	rcu_read_unlock();
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per-socket receive latency histograms, see include/uapi/linux/skb_latency.h
+ *
+ * Stamps are 32 bit nanoseconds, so intervals longer than about 4 seconds
+ * wrap. They are accounted without the socket lock, which datagram
+ * recvmsg() does not hold, so concurrent readers of one socket may lose
+ * counts.
+ */
+
+#include <linux/skb_latency.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+struct sk_rx_latency_hist {
+	bool enabled;
+	struct sk_rx_latency lat;
+};
+
+struct static_key skb_lat_needed __read_mostly;
+EXPORT_SYMBOL(skb_lat_needed);
+
+/*
+ * Sockets start and stop recording from atomic context too (clones of
+ * listeners, RCU freeing), so the key is flipped from a work item like
+ * netstamp_needed.
+ */
+#ifdef HAVE_JUMP_LABEL
+static atomic_t skb_lat_deferred;
+static atomic_t skb_lat_wanted;
+static void skb_lat_update(struct work_struct *work)
+{
+	int deferred = atomic_xchg(&skb_lat_deferred, 0);
+	int wanted;
+
+	wanted = atomic_add_return(deferred, &skb_lat_wanted);
+	if (wanted > 0)
+		static_key_enable(&skb_lat_needed);
+	else
+		static_key_disable(&skb_lat_needed);
+}
+static DECLARE_WORK(skb_lat_work, skb_lat_update);
+#endif
+
+static void skb_lat_enable(void)
+{
+#ifdef HAVE_JUMP_LABEL
+	int wanted;
+
+	while (1) {
+		wanted = atomic_read(&skb_lat_wanted);
+		if (wanted <= 0)
+			break;
+		if (atomic_cmpxchg(&skb_lat_wanted, wanted, wanted + 1) == wanted)
+			return;
+	}
+	atomic_inc(&skb_lat_deferred);
+	schedule_work(&skb_lat_work);
+#else
+	static_key_slow_inc(&skb_lat_needed);
+#endif
+}
+
+static void skb_lat_disable(void)
+{
+#ifdef HAVE_JUMP_LABEL
+	int wanted;
+
+	while (1) {
+		wanted = atomic_read(&skb_lat_wanted);
+		if (wanted <= 1)
+			break;
+		if (atomic_cmpxchg(&skb_lat_wanted, wanted, wanted - 1) == wanted)
+			return;
+	}
+	atomic_dec(&skb_lat_deferred);
+	schedule_work(&skb_lat_work);
+#else
+	static_key_slow_dec(&skb_lat_needed);
+#endif
+}
+
+static void sk_lat_add(struct sk_rx_latency_hist *h, int interval, u32 ns)
+{
+	u32 us = (s32)ns > 0 ? ns / NSEC_PER_USEC : 0;
+
+	h->lat.hist[interval][min_t(u32, fls(us), SK_RXLAT_BUCKETS - 1)]++;
+}
+
+void __sk_lat_recv(struct sock *sk, struct sk_buff *skb)
+{
+	struct sk_rx_latency_hist *h = sk->sk_rx_latency;
+	u32 now, ts, first = 0, prev = 0;
+	int i;
+
+	BUILD_BUG_ON(SK_RXLAT_APP != SKB_LAT_STAGES - 1);
+
+	if (!READ_ONCE(h->enabled))
+		return;
+
+	for (i = 0; i < SKB_LAT_STAGES; i++) {
+		ts = skb->lat_stamp[i];
+		if (!ts)
+			continue;
+		if (first)
+			sk_lat_add(h, i - 1, ts - prev);
+		else
+			first = ts;
+		prev = ts;
+	}
+	if (!first)
+		return;
+
+	now = (u32)ktime_get_ns() | 1;
+	sk_lat_add(h, SK_RXLAT_APP, now - prev);
+	sk_lat_add(h, SK_RXLAT_TOTAL, now - first);
+	h->lat.packets++;
+
+	/* a peeked or partially read skb is accounted once */
+	memset(skb->lat_stamp, 0, sizeof(skb->lat_stamp));
+}
+EXPORT_SYMBOL(__sk_lat_recv);
+
+/* setsockopt(SO_RX_LATENCY), called with the socket locked */
+int sk_rx_latency_set(struct sock *sk, int val)
+{
+	struct sk_rx_latency_hist *h = sk->sk_rx_latency;
+
+	if (!h) {
+		if (!val)
+			return 0;
+		h = kzalloc(sizeof(*h), GFP_KERNEL);
+		if (!h)
+			return -ENOMEM;
+		smp_store_release(&sk->sk_rx_latency, h);
+	} else if (val) {
+		memset(&h->lat, 0, sizeof(h->lat));
+	}
+
+	if (!!val != h->enabled) {
+		if (val)
+			skb_lat_enable();
+		else
+			skb_lat_disable();
+		WRITE_ONCE(h->enabled, !!val);
+	}
+
+	return 0;
+}
+
+/* getsockopt(SO_RX_LATENCY), returns the length copied to @optval */
+int sk_rx_latency_get(struct sock *sk, char __user *optval, int len)
+{
+	struct sk_rx_latency_hist *h = smp_load_acquire(&sk->sk_rx_latency);
+
+	len = min_t(unsigned int, len, sizeof(struct sk_rx_latency));
+	if (h ? copy_to_user(optval, &h->lat, len) : clear_user(optval, len))
+		return -EFAULT;
+
+	return len;
+}
+
+/* Sockets accepted from a recording listener record too */
+void sk_rx_latency_clone(struct sock *newsk, const struct sock *sk)
+{
+	struct sk_rx_latency_hist *h = NULL;
+
+	if (sk->sk_rx_latency && READ_ONCE(sk->sk_rx_latency->enabled)) {
+		h = kzalloc(sizeof(*h), GFP_ATOMIC);
+		if (h) {
+			h->enabled = true;
+			skb_lat_enable();
+		}
+	}
+	newsk->sk_rx_latency = h;
+}
+
+void sk_rx_latency_free(struct sock *sk)
+{
+	struct sk_rx_latency_hist *h = sk->sk_rx_latency;
+
+	if (!h)
+		return;
+	if (h->enabled)
+		skb_lat_disable();
+	kfree(h);
+	sk->sk_rx_latency = NULL;
+}
@@ -141,6 +141,7 @@
 
 #include <net/tcp.h>
 #include <net/busy_poll.h>
+#include <linux/skb_latency.h>
 
 static DEFINE_MUTEX(proto_list_mutex);
 static LIST_HEAD(proto_list);
@@ -460,6 +461,7 @@ int __sock_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	 * a norefcounted dst
 	 */
 	skb_dst_force(skb);
+	skb_lat_stamp(skb, SKB_LAT_SOCKQ);
 
 	spin_lock_irqsave(&list->lock, flags);
 	sock_skb_set_dropcount(sk, skb);
@@ -1026,6 +1028,22 @@ set_rcvbuf:
 				sk->sk_ll_usec = val;
 		}
 		break;
+
+	case SO_BUSY_POLL_BUDGET:
+		/* allow unprivileged users to decrease the value */
+		if ((val > sk->sk_busy_poll_budget) && !capable(CAP_NET_ADMIN))
+			ret = -EPERM;
+		else if (val < 0 || val > U16_MAX)
+			ret = -EINVAL;
+		else
+			WRITE_ONCE(sk->sk_busy_poll_budget, val);
+		break;
+#endif
+
+#ifdef CONFIG_SKB_LATENCY
+	case SO_RX_LATENCY:
+		ret = sk_rx_latency_set(sk, val);
+		break;
 #endif
 
 	case SO_MAX_PACING_RATE:
@@ -1344,6 +1362,18 @@ int sock_getsockopt(struct socket *sock, int level, int optname,
 	case SO_BUSY_POLL:
 		v.val = sk->sk_ll_usec;
 		break;
+
+	case SO_BUSY_POLL_BUDGET:
+		v.val = sk->sk_busy_poll_budget;
+		break;
+#endif
+
+#ifdef CONFIG_SKB_LATENCY
+	case SO_RX_LATENCY:
+		len = sk_rx_latency_get(sk, optval, len);
+		if (len < 0)
+			return len;
+		goto lenout;
 #endif
 
 	case SO_MAX_PACING_RATE:
@@ -1564,6 +1594,7 @@ static void __sk_destruct(struct rcu_head *head)
 	}
 
 	sock_disable_timestamp(sk, SK_FLAGS_TIMESTAMP);
+	sk_rx_latency_free(sk);
 
 	if (atomic_read(&sk->sk_omem_alloc))
 		pr_debug("%s: optmem leakage (%d bytes) detected\n",
@@ -1657,6 +1688,7 @@ struct sock *sk_clone_lock(const struct sock *sk, const gfp_t priority)
 		sock_copy(newsk, sk);
 
 		newsk->sk_prot_creator = sk->sk_prot;
+		sk_rx_latency_clone(newsk, sk);
 
 		/* SANITY */
 		if (likely(newsk->sk_net_refcnt))
@@ -2746,6 +2778,7 @@ void sock_init_data(struct socket *sock, struct sock *sk)
 #ifdef CONFIG_NET_RX_BUSY_POLL
 	sk->sk_napi_id		=	0;
 	sk->sk_ll_usec		=	sysctl_net_busy_read;
+	sk->sk_busy_poll_budget	=	0;
 #endif
 
 	sk->sk_max_pacing_rate = ~0U;
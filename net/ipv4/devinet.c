@@ -2291,6 +2291,14 @@ static struct devinet_sysctl_table {
 					      "drop_unicast_in_l2_multicast"),
 		DEVINET_SYSCTL_RW_ENTRY(NF_IPV4_DEFRAG_SKIP,
 					"nf_ipv4_defrag_skip"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_LIMIT_OUTPUT_BYTES,
+					"tcp_limit_output_bytes"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_PACING_SS_RATIO,
+					"tcp_pacing_ss_ratio"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_PACING_CA_RATIO,
+					"tcp_pacing_ca_ratio"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_INIT_CWND, "tcp_init_cwnd"),
+		DEVINET_SYSCTL_RW_ENTRY(TCP_NO_AUTOCORK, "tcp_no_autocork"),
 	},
 };
 
@@ -281,6 +281,7 @@
 #include <linux/uaccess.h>
 #include <asm/ioctls.h>
 #include <net/busy_poll.h>
+#include <linux/skb_latency.h>
 
 int sysctl_tcp_min_tso_segs __read_mostly = 2;
 
@@ -681,7 +682,7 @@ static bool tcp_should_autocork(struct sock *sk, struct sk_buff *skb,
 				int size_goal)
 {
 	return skb->len < size_goal &&
-	       sysctl_tcp_autocorking &&
+	       sysctl_tcp_autocorking && !tcp_sk(sk)->dev_no_autocork &&
 	       skb != tcp_write_queue_head(sk) &&
 	       refcount_read(&sk->sk_wmem_alloc) > skb->truesize;
 }
@@ -1942,6 +1943,8 @@ int tcp_recvmsg(struct sock *sk, struct msghdr *msg, size_t len, int nonblock,
 		continue;
 
 	found_ok_skb:
+		sk_lat_recv(sk, skb);
+
 		/* Ok so how much can we use? */
 		used = skb->len - offset;
 		if (len < used)
@@ -1911,6 +1911,8 @@ void tcp_v4_destroy_sock(struct sock *sk)
 
 	tcp_clear_xmit_timers(sk);
 
+	tcp_dev_stats_account(sk);
+
 	tcp_cleanup_congestion_control(sk);
 
 	tcp_cleanup_ulp(sk);
@@ -10,6 +10,9 @@
 #include <linux/hash.h>
 #include <linux/tcp_metrics.h>
 #include <linux/vmalloc.h>
+#include <linux/inetdevice.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file_net.h>
 
 #include <net/inet_connection_sock.h>
 #include <net/net_namespace.h>
@@ -439,6 +442,62 @@ out_unlock:
 
 /* Initialize metrics on socket. */
 
+/*
+ * Pick up the TCP tuning of the device the connection is routed over, so
+ * that e.g. cellular links can use other TSQ and pacing settings than
+ * Wi-Fi. Applies to IPv6 connections too.
+ */
+static void tcp_init_dev_profile(struct sock *sk, const struct dst_entry *dst)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct in_device *in_dev;
+
+	rcu_read_lock();
+	in_dev = __in_dev_get_rcu(dst->dev);
+	if (in_dev) {
+		tp->dev_ifindex = dst->dev->ifindex;
+		tp->dev_limit_output_bytes =
+			max(IN_DEV_CONF_GET(in_dev, TCP_LIMIT_OUTPUT_BYTES), 0);
+		tp->dev_pacing_ss_ratio = clamp(IN_DEV_CONF_GET(in_dev,
+					TCP_PACING_SS_RATIO), 0, 1000);
+		tp->dev_pacing_ca_ratio = clamp(IN_DEV_CONF_GET(in_dev,
+					TCP_PACING_CA_RATIO), 0, 1000);
+		tp->dev_init_cwnd = clamp_t(int, IN_DEV_CONF_GET(in_dev,
+					TCP_INIT_CWND), 0, U16_MAX);
+		tp->dev_no_autocork = !!IN_DEV_CONF_GET(in_dev,
+					TCP_NO_AUTOCORK);
+	}
+	rcu_read_unlock();
+}
+
+/* Add the totals of a connection to the device it was established over */
+void tcp_dev_stats_account(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct in_dev_tcp_stats *st;
+	struct net_device *dev;
+	struct in_device *in_dev;
+
+	if (!tp->dev_ifindex)
+		return;
+
+	rcu_read_lock();
+	dev = dev_get_by_index_rcu(sock_net(sk), tp->dev_ifindex);
+	in_dev = dev ? __in_dev_get_rcu(dev) : NULL;
+	if (in_dev) {
+		st = &in_dev->tcp_stats;
+		atomic64_inc(&st->conns);
+		atomic64_add(tp->segs_out, &st->segs_out);
+		atomic64_add(tp->segs_in, &st->segs_in);
+		atomic64_add(tp->total_retrans, &st->retrans);
+		atomic64_add(tp->bytes_acked, &st->bytes_acked);
+		atomic64_add(tp->bytes_received, &st->bytes_received);
+		atomic64_add(tp->srtt_us >> 3, &st->srtt_us);
+	}
+	rcu_read_unlock();
+	tp->dev_ifindex = 0;
+}
+
 void tcp_init_metrics(struct sock *sk)
 {
 	struct dst_entry *dst = __sk_dst_get(sk);
@@ -450,6 +509,8 @@ void tcp_init_metrics(struct sock *sk)
 	if (!dst)
 		goto reset;
 
+	tcp_init_dev_profile(sk, dst);
+
 	rcu_read_lock();
 	tm = tcp_get_metrics(sk, dst, true);
 	if (!tm) {
@@ -1029,6 +1090,70 @@ static __net_initdata struct pernet_operations tcp_net_metrics_ops = {
 	.exit	=	tcp_net_metrics_exit,
 };
 
+#ifdef CONFIG_PROC_FS
+static int tcp_dev_stat_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq->private;
+	struct net_device *dev;
+
+	seq_puts(seq, "Iface Conns SegsOut SegsIn RetransSegs BytesAcked BytesReceived AvgSrttUs\n");
+
+	rcu_read_lock();
+	for_each_netdev_rcu(net, dev) {
+		struct in_device *in_dev = __in_dev_get_rcu(dev);
+		struct in_dev_tcp_stats *st;
+		u64 conns;
+
+		if (!in_dev)
+			continue;
+		st = &in_dev->tcp_stats;
+		conns = atomic64_read(&st->conns);
+		if (!conns)
+			continue;
+		seq_printf(seq, "%s %llu %lld %lld %lld %lld %lld %llu\n",
+			   dev->name, conns,
+			   atomic64_read(&st->segs_out),
+			   atomic64_read(&st->segs_in),
+			   atomic64_read(&st->retrans),
+			   atomic64_read(&st->bytes_acked),
+			   atomic64_read(&st->bytes_received),
+			   div64_u64(atomic64_read(&st->srtt_us), conns));
+	}
+	rcu_read_unlock();
+	return 0;
+}
+
+static int tcp_dev_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open_net(inode, file, tcp_dev_stat_show);
+}
+
+static const struct file_operations tcp_dev_stat_fops = {
+	.open		= tcp_dev_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release_net,
+};
+
+static int __net_init tcp_dev_stat_net_init(struct net *net)
+{
+	if (!proc_create("tcp_dev_stat", 0444, net->proc_net,
+			 &tcp_dev_stat_fops))
+		return -ENOMEM;
+	return 0;
+}
+
+static void __net_exit tcp_dev_stat_net_exit(struct net *net)
+{
+	remove_proc_entry("tcp_dev_stat", net->proc_net);
+}
+
+static struct pernet_operations tcp_dev_stat_ops = {
+	.init	=	tcp_dev_stat_net_init,
+	.exit	=	tcp_dev_stat_net_exit,
+};
+#endif
+
 void __init tcp_metrics_init(void)
 {
 	int ret;
@@ -1037,6 +1162,11 @@ void __init tcp_metrics_init(void)
 	if (ret < 0)
 		panic("Could not allocate the tcp_metrics hash table\n");
 
+#ifdef CONFIG_PROC_FS
+	if (register_pernet_subsys(&tcp_dev_stat_ops))
+		pr_err("Could not create /proc/net/tcp_dev_stat\n");
+#endif
+
 	ret = genl_register_family(&tcp_metrics_nl_family);
 	if (ret < 0)
 		panic("Could not register tcp_metrics generic netlink\n");
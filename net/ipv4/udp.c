@@ -116,6 +116,7 @@
 #include <net/sock_reuseport.h>
 #include <net/addrconf.h>
 #include <net/udp_tunnel.h>
+#include <linux/skb_latency.h>
 
 struct udp_table udp_table __read_mostly;
 EXPORT_SYMBOL(udp_table);
@@ -1424,6 +1425,7 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 	 * forward allocated memory on dequeue
 	 */
 	sock_skb_set_dropcount(sk, skb);
+	skb_lat_stamp(skb, SKB_LAT_SOCKQ);
 
 	__skb_queue_tail(list, skb);
 	spin_unlock(&list->lock);
@@ -1673,6 +1675,8 @@ try_again:
 	if (!skb)
 		return err;
 
+	sk_lat_recv(sk, skb);
+
 	ulen = udp_skb_len(skb);
 	copied = len;
 	if (copied > ulen - off)
@@ -53,6 +53,7 @@
 
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/skb_latency.h>
 #include <trace/events/skb.h>
 #include "udp_impl.h"
 
@@ -372,6 +373,8 @@ try_again:
 	if (!skb)
 		return err;
 
+	sk_lat_recv(sk, skb);
+
 	ulen = udp6_skb_len(skb);
 	copied = len;
 	if (copied > ulen - off)
@@ -1407,6 +1407,100 @@ init_conntrack(struct net *net, struct nf_conn *tmpl,
 }
 
 /* On success, returns 0, sets skb->_nfct | ctinfo */
+/*
+ * Per-CPU cache of established TCP and UDP conntracks, indexed by the
+ * skb's L4 hash when the driver or RPS provided one, so that the packets
+ * of a busy flow (rmnet downlink, for one) skip the tuple hash and the
+ * bucket walk. Each entry holds a reference; a hit is only used after
+ * the same key, zone and netns checks as a hash table lookup, and if the
+ * conntrack is neither dying nor expired. The lock is per-CPU and only
+ * contended by nf_ct_flow_cache_flush().
+ */
+#define NF_CT_FLOW_CACHE_SIZE	64
+
+struct nf_ct_flow_cache {
+	spinlock_t lock;
+	struct nf_conntrack_tuple_hash *h[NF_CT_FLOW_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct nf_ct_flow_cache, nf_ct_flow_cache);
+static bool nf_ct_flow_cache_enable __read_mostly = true;
+module_param_named(flow_cache, nf_ct_flow_cache_enable, bool, 0644);
+
+static struct nf_conntrack_tuple_hash *
+nf_ct_flow_cache_get(struct net *net, const struct nf_conntrack_zone *zone,
+		     const struct nf_conntrack_tuple *tuple, u32 key)
+{
+	struct nf_conntrack_tuple_hash *h;
+	struct nf_ct_flow_cache *fc;
+	struct nf_conn *ct;
+
+	local_bh_disable();
+	fc = this_cpu_ptr(&nf_ct_flow_cache);
+	spin_lock(&fc->lock);
+	h = fc->h[key % NF_CT_FLOW_CACHE_SIZE];
+	if (h) {
+		ct = nf_ct_tuplehash_to_ctrack(h);
+		if (nf_ct_key_equal(h, tuple, zone, net) &&
+		    !nf_ct_is_dying(ct) && !nf_ct_is_expired(ct))
+			nf_conntrack_get(&ct->ct_general);
+		else
+			h = NULL;
+	}
+	spin_unlock(&fc->lock);
+	local_bh_enable();
+
+	if (h)
+		NF_CT_STAT_INC_ATOMIC(net, flow_cache_hit);
+	else
+		NF_CT_STAT_INC_ATOMIC(net, flow_cache_miss);
+	return h;
+}
+
+static void nf_ct_flow_cache_add(struct nf_conntrack_tuple_hash *h, u32 key)
+{
+	struct nf_conn *ct = nf_ct_tuplehash_to_ctrack(h);
+	struct nf_conntrack_tuple_hash *old;
+	struct nf_ct_flow_cache *fc;
+
+	local_bh_disable();
+	fc = this_cpu_ptr(&nf_ct_flow_cache);
+	spin_lock(&fc->lock);
+	/* dying is set before nf_ct_iterate_cleanup() flushes */
+	if (nf_ct_is_dying(ct)) {
+		old = NULL;
+	} else {
+		nf_conntrack_get(&ct->ct_general);
+		old = fc->h[key % NF_CT_FLOW_CACHE_SIZE];
+		fc->h[key % NF_CT_FLOW_CACHE_SIZE] = h;
+	}
+	spin_unlock(&fc->lock);
+	local_bh_enable();
+
+	if (old)
+		nf_ct_put(nf_ct_tuplehash_to_ctrack(old));
+}
+
+/* Drop all cached conntracks, so killed ones are freed now */
+static void nf_ct_flow_cache_flush(void)
+{
+	struct nf_conntrack_tuple_hash *h;
+	struct nf_ct_flow_cache *fc;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		fc = per_cpu_ptr(&nf_ct_flow_cache, cpu);
+		for (i = 0; i < NF_CT_FLOW_CACHE_SIZE; i++) {
+			spin_lock_bh(&fc->lock);
+			h = fc->h[i];
+			fc->h[i] = NULL;
+			spin_unlock_bh(&fc->lock);
+			if (h)
+				nf_ct_put(nf_ct_tuplehash_to_ctrack(h));
+		}
+	}
+}
+
 static int
 resolve_normal_ct(struct net *net, struct nf_conn *tmpl,
 		  struct sk_buff *skb,
@@ -1422,7 +1516,8 @@ resolve_normal_ct(struct net *net, struct nf_conn *tmpl,
 	enum ip_conntrack_info ctinfo;
 	struct nf_conntrack_zone tmp;
 	struct nf_conn *ct;
-	u32 hash;
+	bool cacheable;
+	u32 hash, key = 0;
 
 	if (!nf_ct_get_tuple(skb, skb_network_offset(skb),
 			     dataoff, l3num, protonum, net, &tuple, l3proto,
@@ -1433,6 +1528,15 @@ resolve_normal_ct(struct net *net, struct nf_conn *tmpl,
 
 	/* look for tuple match */
 	zone = nf_ct_zone_tmpl(tmpl, skb, &tmp);
+	cacheable = READ_ONCE(nf_ct_flow_cache_enable) && skb->l4_hash &&
+		    (protonum == IPPROTO_TCP || protonum == IPPROTO_UDP);
+	if (cacheable) {
+		key = skb_get_hash_raw(skb);
+		h = nf_ct_flow_cache_get(net, zone, &tuple, key);
+		if (h)
+			goto found;
+	}
+
 	hash = hash_conntrack_raw(&tuple, net);
 	h = __nf_conntrack_find_get(net, zone, &tuple, hash);
 	if (!h) {
@@ -1442,7 +1546,12 @@ resolve_normal_ct(struct net *net, struct nf_conn *tmpl,
 			return 0;
 		if (IS_ERR(h))
 			return PTR_ERR(h);
+	} else if (cacheable &&
+		   test_bit(IPS_SEEN_REPLY_BIT,
+			    &nf_ct_tuplehash_to_ctrack(h)->status)) {
+		nf_ct_flow_cache_add(h, key);
 	}
+found:
 	ct = nf_ct_tuplehash_to_ctrack(h);
 
 	/* It exists; we have (non-exclusive) reference. */
@@ -1800,6 +1909,8 @@ static void nf_ct_iterate_cleanup(int (*iter)(struct nf_conn *i, void *data),
 			break;
 		bucket = 0;
 	}
+
+	nf_ct_flow_cache_flush();
 }
 
 struct iter_data {
@@ -2150,7 +2261,7 @@ int nf_conntrack_init_start(void)
 {
 	int max_factor = 8;
 	int ret = -ENOMEM;
-	int i;
+	int i, cpu;
 
 	/* struct nf_ct_ext uses u8 to store offsets/size */
 	BUILD_BUG_ON(total_extension_size() > 255u);
@@ -2160,6 +2271,9 @@ int nf_conntrack_init_start(void)
 	for (i = 0; i < CONNTRACK_LOCKS; i++)
 		spin_lock_init(&nf_conntrack_locks[i]);
 
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(nf_ct_flow_cache, cpu).lock);
+
 	if (!nf_conntrack_htable_size) {
 		/* Idea from tcp.c: use 1/16384 of memory.
 		 * On i386: 32MB machine has 512 buckets.
@@ -13,6 +13,7 @@
  */
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
 #include <linux/skbuff.h>
 #include <linux/spinlock.h>
@@ -44,12 +45,31 @@ typedef struct ulog_packet_msg {
 } ulog_packet_msg_t;
 #endif
 
+/*
+ * Byte countdown quotas, the ones the Android bandwidth controller puts on
+ * all cellular traffic, are not charged under @lock for every packet. Each
+ * CPU borrows a reservation of up to quota_batch bytes from @quota and
+ * charges packets against it locally, going back to @lock only when it
+ * runs out. Bumping @gen hands all reservations back: their remainders are
+ * added to @quota and the CPUs notice the new generation on their next
+ * packet. A CPU charging a packet while its reservation is taken back may
+ * let that one packet through for free.
+ */
+struct xt_quota_pcpu {
+	u_int64_t left;
+	unsigned int gen;
+};
+
 /**
+ * @quota:	remaining or grown quota, without the per-CPU reservations
  * @lock:	lock to protect quota writers from each other
+ * @gen:	generation of the valid per-CPU reservations
  */
 struct xt_quota_counter {
 	u_int64_t quota;
 	spinlock_t lock;
+	unsigned int gen;
+	struct xt_quota_pcpu __percpu *pcpu;
 	struct list_head list;
 	atomic_t ref;
 	char name[sizeof(((struct xt_quota_mtinfo2 *)NULL)->name)];
@@ -74,6 +94,9 @@ static unsigned int quota_list_perms = S_IRUGO | S_IWUSR;
 static kuid_t quota_list_uid = KUIDT_INIT(0);
 static kgid_t quota_list_gid = KGIDT_INIT(0);
 module_param_named(perms, quota_list_perms, uint, S_IRUGO | S_IWUSR);
+/* most bytes a CPU borrows from a countdown quota at once, 0 disables */
+static unsigned int quota_batch = 65536;
+module_param_named(batch, quota_batch, uint, S_IRUGO | S_IWUSR);
 
 #ifdef CONFIG_NETFILTER_XT_MATCH_QUOTA2_LOG
 static void quota2_log(unsigned int hooknum,
@@ -138,6 +161,28 @@ static void quota2_log(unsigned int hooknum,
 }
 #endif  /* if+else CONFIG_NETFILTER_XT_MATCH_QUOTA2_LOG */
 
+/* Bytes the CPUs still hold of @e, called with @e->lock */
+static u_int64_t q2_reserved(struct xt_quota_counter *e)
+{
+	struct xt_quota_pcpu *pc;
+	u_int64_t sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(e->pcpu, cpu);
+		if (READ_ONCE(pc->gen) == e->gen)
+			sum += READ_ONCE(pc->left);
+	}
+	return sum;
+}
+
+/* Hand all per-CPU reservations back to @e->quota, called with @e->lock */
+static void q2_reclaim(struct xt_quota_counter *e)
+{
+	e->quota += q2_reserved(e);
+	WRITE_ONCE(e->gen, e->gen + 1);
+}
+
 static ssize_t quota_proc_read(struct file *file, char __user *buf,
 			   size_t size, loff_t *ppos)
 {
@@ -146,7 +191,8 @@ static ssize_t quota_proc_read(struct file *file, char __user *buf,
 	size_t tmp_size;
 
 	spin_lock_bh(&e->lock);
-	tmp_size = scnprintf(tmp, sizeof(tmp), "%llu\n", e->quota);
+	tmp_size = scnprintf(tmp, sizeof(tmp), "%llu\n",
+			     e->quota + q2_reserved(e));
 	spin_unlock_bh(&e->lock);
 	return simple_read_from_buffer(buf, size, ppos, tmp, tmp_size);
 }
@@ -164,6 +210,7 @@ static ssize_t quota_proc_write(struct file *file, const char __user *input,
 	buf[sizeof(buf)-1] = '\0';
 
 	spin_lock_bh(&e->lock);
+	WRITE_ONCE(e->gen, e->gen + 1);
 	e->quota = simple_strtoull(buf, NULL, 0);
 	spin_unlock_bh(&e->lock);
 	return size;
@@ -187,8 +234,15 @@ q2_new_counter(const struct xt_quota_mtinfo2 *q, bool anon)
 	if (e == NULL)
 		return NULL;
 
+	e->pcpu = alloc_percpu(struct xt_quota_pcpu);
+	if (e->pcpu == NULL) {
+		kfree(e);
+		return NULL;
+	}
+
 	e->quota = q->quota;
 	spin_lock_init(&e->lock);
+	e->gen = 1;
 	if (!anon) {
 		INIT_LIST_HEAD(&e->list);
 		atomic_set(&e->ref, 1);
@@ -197,6 +251,14 @@ q2_new_counter(const struct xt_quota_mtinfo2 *q, bool anon)
 	return e;
 }
 
+static void q2_free_counter(struct xt_quota_counter *e)
+{
+	if (e == NULL)
+		return;
+	free_percpu(e->pcpu);
+	kfree(e);
+}
+
 /**
  * q2_get_counter - get ref to counter or create new
  * @name:	name of counter
@@ -221,7 +283,7 @@ q2_get_counter(const struct xt_quota_mtinfo2 *q)
 		if (strcmp(e->name, q->name) == 0) {
 			atomic_inc(&e->ref);
 			spin_unlock_bh(&counter_list_lock);
-			kfree(new_e);
+			q2_free_counter(new_e);
 			pr_debug("xt_quota2: old counter name=%s", e->name);
 			return e;
 		}
@@ -251,7 +313,7 @@ q2_get_counter(const struct xt_quota_mtinfo2 *q)
 	return e;
 
  out:
-	kfree(e);
+	q2_free_counter(e);
 	return NULL;
 }
 
@@ -285,7 +347,7 @@ static void quota_mt2_destroy(const struct xt_mtdtor_param *par)
 	struct xt_quota_counter *e = q->master;
 
 	if (*q->name == '\0') {
-		kfree(e);
+		q2_free_counter(e);
 		return;
 	}
 
@@ -298,7 +360,66 @@ static void quota_mt2_destroy(const struct xt_mtdtor_param *par)
 	list_del(&e->list);
 	spin_unlock_bh(&counter_list_lock);
 	remove_proc_entry(e->name, proc_xt_quota);
-	kfree(e);
+	q2_free_counter(e);
+}
+
+/*
+ * Charge @len bytes to the countdown quota @e from this CPU's reservation,
+ * borrowing a new one when it is used up. Returns false when the quota,
+ * including what the other CPUs hold, cannot cover the packet.
+ */
+static bool quota_mt2_charge(struct xt_quota_counter *e, unsigned int len,
+			     const struct sk_buff *skb, struct xt_action_param *par,
+			     const char *name)
+{
+	struct xt_quota_pcpu *pc;
+	u_int64_t grant;
+	bool ret = true;
+
+	local_bh_disable();
+	pc = this_cpu_ptr(e->pcpu);
+	if (likely(pc->gen == READ_ONCE(e->gen) && pc->left >= len)) {
+		WRITE_ONCE(pc->left, pc->left - len);
+		local_bh_enable();
+		return true;
+	}
+
+	spin_lock(&e->lock);
+	/* give back what is left of a still valid reservation */
+	if (pc->gen == e->gen)
+		e->quota += pc->left;
+	WRITE_ONCE(pc->left, 0);
+	WRITE_ONCE(pc->gen, e->gen);
+
+	if (e->quota < len)
+		q2_reclaim(e);
+
+	if (e->quota >= len) {
+		/*
+		 * Borrow at most a quarter of an even share per online CPU,
+		 * so a nearly used up quota is not parked on idle CPUs.
+		 */
+		grant = min_t(u_int64_t, quota_batch,
+			      div_u64(e->quota, 4 * num_online_cpus()));
+		grant = max_t(u_int64_t, grant, len);
+		e->quota -= grant;
+		WRITE_ONCE(pc->left, grant - len);
+	} else {
+		/* We are transitioning, log that fact. */
+		if (e->quota) {
+			quota2_log(xt_hooknum(par),
+				   skb,
+				   xt_in(par),
+				   xt_out(par),
+				   name);
+		}
+		/* we do not allow even small packets from now on */
+		e->quota = 0;
+		ret = false;
+	}
+	spin_unlock(&e->lock);
+	local_bh_enable();
+	return ret;
 }
 
 static bool
@@ -308,6 +429,13 @@ quota_mt2(const struct sk_buff *skb, struct xt_action_param *par)
 	struct xt_quota_counter *e = q->master;
 	bool ret = q->flags & XT_QUOTA_INVERT;
 
+	if (!(q->flags & (XT_QUOTA_GROW | XT_QUOTA_PACKET | XT_QUOTA_NO_CHANGE)) &&
+	    quota_batch) {
+		if (quota_mt2_charge(e, skb->len, skb, par, q->name))
+			ret = !ret;
+		return ret;
+	}
+
 	spin_lock_bh(&e->lock);
 	if (q->flags & XT_QUOTA_GROW) {
 		/*
@@ -319,6 +447,9 @@ quota_mt2(const struct sk_buff *skb, struct xt_action_param *par)
 		}
 		ret = true;
 	} else {
+		/* other rules on this counter may hold per-CPU reservations */
+		if (e->quota < skb->len)
+			q2_reclaim(e);
 		if (e->quota >= skb->len) {
 			if (!(q->flags & XT_QUOTA_NO_CHANGE))
 				e->quota -= (q->flags & XT_QUOTA_PACKET) ? 1 : skb->len;
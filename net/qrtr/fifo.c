@@ -185,7 +185,7 @@ static void xprt_read_data(struct qrtr_fifo_xprt *xprtp)
 {
 	int rc;
 	u32 hdr[8];
-	void *data;
+	struct sk_buff *skb;
 	size_t pkt_len;
 	size_t rx_avail;
 	size_t hdr_len = sizeof(hdr);
@@ -199,10 +199,6 @@ static void xprt_read_data(struct qrtr_fifo_xprt *xprtp)
 			break;
 		}
 
-		data = kzalloc(pkt_len, GFP_ATOMIC);
-		if (!data)
-			break;
-
 		rx_avail = fifo_rx_avail(&xprtp->rx_pipe);
 		if (rx_avail < pkt_len) {
 			pr_err("%s Not FULL pkt in FIFO %zu %zu\n",
@@ -210,14 +206,18 @@ static void xprt_read_data(struct qrtr_fifo_xprt *xprtp)
 			break;
 		}
 
-		fifo_rx_peak(&xprtp->rx_pipe, data, 0, pkt_len);
+		/* Read straight into an skb so the router can keep it */
+		skb = alloc_skb(pkt_len, GFP_ATOMIC);
+		if (!skb)
+			break;
+
+		fifo_rx_peak(&xprtp->rx_pipe, skb_put(skb, pkt_len), 0,
+			     pkt_len);
 		fifo_rx_advance(&xprtp->rx_pipe, pkt_len);
 
-		rc = qrtr_endpoint_post(&xprtp->ep, data, pkt_len);
+		rc = qrtr_endpoint_post_skb(&xprtp->ep, skb);
 		if (rc == -EINVAL)
 			pr_err("%s invalid ipcrouter packet\n", __func__);
-		kfree(data);
-		data = NULL;
 	}
 }
 
@@ -27,6 +27,9 @@
 
 #include "qrtr.h"
 
+#define CREATE_TRACE_POINTS
+#include "qrtr_trace.h"
+
 #define QRTR_LOG_PAGE_CNT 4
 #define QRTR_INFO(ctx, x, ...)				\
 	do {						\
@@ -135,7 +138,9 @@ static unsigned int qrtr_local_nid = CONFIG_QRTR_NODE_ID;
 static RADIX_TREE(qrtr_nodes, GFP_KERNEL);
 /* broadcast list */
 static LIST_HEAD(qrtr_all_epts);
-/* lock for qrtr_nodes, qrtr_all_epts and node reference */
+/* lock for qrtr_nodes updates, qrtr_all_epts and node reference;
+ * qrtr_node_lookup() walks qrtr_nodes under RCU instead
+ */
 static DECLARE_RWSEM(qrtr_node_lock);
 
 /* local port allocation management */
@@ -147,10 +152,32 @@ static DEFINE_MUTEX(qrtr_port_lock);
 #define QRTR_BACKUP_HI_SIZE	SZ_16K
 #define QRTR_BACKUP_LO_NUM	20
 #define QRTR_BACKUP_LO_SIZE	SZ_1K
+#define QRTR_RX_POOL_NUM	8
+#define QRTR_RX_POOL_SIZE	SZ_1K
 static struct sk_buff_head qrtr_backup_lo;
 static struct sk_buff_head qrtr_backup_hi;
 static struct work_struct qrtr_backup_work;
 
+/**
+ * struct qrtr_node_stats - per endpoint receive statistics
+ * @rx_pkts: packets accepted from the endpoint
+ * @rx_bytes: payload bytes accepted from the endpoint
+ * @rx_zero_copy: packets handed over in an skb owned by the transport
+ * @rx_pool_hit: packets copied into a preallocated pool skb
+ * @rx_backup: packets copied into a global backup skb
+ * @rx_alloc_fail: packets dropped because no skb could be found
+ * @rx_invalid: packets dropped because of a malformed header
+ */
+struct qrtr_node_stats {
+	unsigned long rx_pkts;
+	unsigned long rx_bytes;
+	unsigned long rx_zero_copy;
+	unsigned long rx_pool_hit;
+	unsigned long rx_backup;
+	unsigned long rx_alloc_fail;
+	unsigned long rx_invalid;
+};
+
 /**
  * struct qrtr_node - endpoint node
  * @ep_lock: lock for endpoint management and callbacks
@@ -170,6 +197,10 @@ static struct work_struct qrtr_backup_work;
  * @say_hello: scheduled work for initiating hello
  * @ws: wakeupsource avoid system suspend
  * @ilc: ipc logging context reference
+ * @rx_pool: preallocated skbs for small incoming packets
+ * @rx_pool_fill: scheduled work for refilling @rx_pool
+ * @stats: receive path counters
+ * @rcu: defers freeing until lockless lookups are done with the node
  */
 struct qrtr_node {
 	struct mutex ep_lock;
@@ -195,6 +226,12 @@ struct qrtr_node {
 	struct wakeup_source *ws;
 
 	void *ilc;
+
+	struct sk_buff_head rx_pool;
+	struct kthread_work rx_pool_fill;
+	struct qrtr_node_stats stats;
+
+	struct rcu_head rcu;
 };
 
 struct qrtr_tx_flow_waiter {
@@ -388,7 +425,8 @@ static void __qrtr_node_release(struct kref *kref)
 	kthread_stop(node->task);
 
 	skb_queue_purge(&node->rx_queue);
-	kfree(node);
+	skb_queue_purge(&node->rx_pool);
+	kfree_rcu(node, rcu);
 }
 
 /* Increment reference to node. */
@@ -619,11 +657,22 @@ static int qrtr_node_enqueue(struct qrtr_node *node, struct sk_buff *skb,
 static struct qrtr_node *qrtr_node_lookup(unsigned int nid)
 {
 	struct qrtr_node *node;
+	u64 start = 0;
 
-	down_read(&qrtr_node_lock);
+	if (trace_qrtr_node_lookup_enabled())
+		start = ktime_get_ns();
+
+	/* A node whose last reference is being dropped can still be found
+	 * until __qrtr_node_release() takes it out of the tree; skip it.
+	 */
+	rcu_read_lock();
 	node = radix_tree_lookup(&qrtr_nodes, nid);
-	node = qrtr_node_acquire(node);
-	up_read(&qrtr_node_lock);
+	if (node && !kref_get_unless_zero(&node->ref))
+		node = NULL;
+	rcu_read_unlock();
+
+	if (start)
+		trace_qrtr_node_lookup(nid, !!node, ktime_get_ns() - start);
 
 	return node;
 }
@@ -637,24 +686,28 @@ static void qrtr_node_assign(struct qrtr_node *node, unsigned int nid)
 {
 	struct qrtr_node *tnode = NULL;
 	char name[32] = {0,};
+	u64 start, hold_ns;
 
 	if (nid == QRTR_EP_NID_AUTO)
 		return;
 	if (nid == node->nid)
 		return;
 
-	down_read(&qrtr_node_lock);
+	rcu_read_lock();
 	tnode = radix_tree_lookup(&qrtr_nodes, nid);
-	up_read(&qrtr_node_lock);
+	rcu_read_unlock();
 	if (tnode)
 		return;
 
 	down_write(&qrtr_node_lock);
+	start = ktime_get_ns();
 	radix_tree_insert(&qrtr_nodes, nid, node);
 
 	if (node->nid == QRTR_EP_NID_AUTO)
 		node->nid = nid;
+	hold_ns = ktime_get_ns() - start;
 	up_write(&qrtr_node_lock);
+	trace_qrtr_node_update(nid, true, hold_ns);
 
 	snprintf(name, sizeof(name), "qrtr_%d", nid);
 	if (!node->ilc) {
@@ -763,48 +816,76 @@ static void qrtr_backup_deinit(void)
 	skb_queue_purge(&qrtr_backup_hi);
 }
 
+/* Number of small receive skbs kept ready per endpoint */
+static unsigned int qrtr_rx_pool_num = QRTR_RX_POOL_NUM;
+module_param_named(rx_pool_num, qrtr_rx_pool_num, uint, 0644);
+MODULE_PARM_DESC(rx_pool_num, "Preallocated receive skbs per endpoint");
+
+static void qrtr_rx_pool_fill_work(struct kthread_work *work)
+{
+	struct qrtr_node *node = container_of(work, struct qrtr_node,
+					      rx_pool_fill);
+	struct sk_buff *skb;
+	int errcode;
+
+	while (skb_queue_len(&node->rx_pool) < READ_ONCE(qrtr_rx_pool_num)) {
+		skb = alloc_skb_with_frags(sizeof(struct qrtr_hdr_v1),
+					   QRTR_RX_POOL_SIZE, 0, &errcode,
+					   GFP_KERNEL);
+		if (!skb)
+			break;
+		skb_queue_tail(&node->rx_pool, skb);
+	}
+}
+
+/* Take a preallocated skb for a packet of @len bytes, saving the atomic
+ * allocation on the transport's receive path. The pool is topped up from the
+ * node worker once it drops below half of its target size.
+ */
+static struct sk_buff *qrtr_rx_pool_get(struct qrtr_node *node, size_t len)
+{
+	struct sk_buff *skb;
+
+	if (len > QRTR_RX_POOL_SIZE)
+		return NULL;
+
+	skb = skb_dequeue(&node->rx_pool);
+	if (skb_queue_len(&node->rx_pool) < READ_ONCE(qrtr_rx_pool_num) / 2)
+		kthread_queue_work(&node->kworker, &node->rx_pool_fill);
+
+	return skb;
+}
+
 /**
- * qrtr_endpoint_post() - post incoming data
- * @ep: endpoint handle
- * @data: data pointer
- * @len: size of data in bytes
+ * qrtr_parse_hdr() - decode an incoming packet header
+ * @cb: control block to fill in
+ * @data: start of the packet, header included
+ * @len: size of the packet in bytes
+ * @hdrlen: returns the size of the header
+ * @size: returns the size of the payload
  *
- * Return: 0 on success; negative error code on failure
+ * Return: 0 on success; -EINVAL if the header is malformed or does not
+ * match @len
  */
-int qrtr_endpoint_post(struct qrtr_endpoint *ep, const void *data, size_t len)
+static int qrtr_parse_hdr(struct qrtr_cb *cb, const void *data, size_t len,
+			  size_t *hdrlen, unsigned int *size)
 {
-	struct qrtr_node *node = ep->node;
 	const struct qrtr_hdr_v1 *v1;
 	const struct qrtr_hdr_v2 *v2;
-	struct sk_buff *skb;
-	struct qrtr_cb *cb;
-	unsigned int size;
-	int errcode;
 	unsigned int ver;
-	size_t hdrlen;
 
 	if (len & 3)
 		return -EINVAL;
 
-	skb = alloc_skb_with_frags(sizeof(*v1), len, 0, &errcode, GFP_ATOMIC);
-	if (!skb) {
-		skb = qrtr_get_backup(len);
-		if (!skb) {
-			pr_err("qrtr: Unable to get skb with len:%lu\n", len);
-			return -ENOMEM;
-		}
-	}
-
-	skb_reserve(skb, sizeof(*v1));
-	cb = (struct qrtr_cb *)skb->cb;
-
 	/* Version field in v1 is little endian, so this works for both cases */
 	ver = *(u8 *)data;
 
 	switch (ver) {
 	case QRTR_PROTO_VER_1:
+		if (len < sizeof(*v1))
+			return -EINVAL;
 		v1 = data;
-		hdrlen = sizeof(*v1);
+		*hdrlen = sizeof(*v1);
 
 		cb->type = le32_to_cpu(v1->type);
 		cb->src_node = le32_to_cpu(v1->src_node_id);
@@ -813,11 +894,13 @@ int qrtr_endpoint_post(struct qrtr_endpoint *ep, const void *data, size_t len)
 		cb->dst_node = le32_to_cpu(v1->dst_node_id);
 		cb->dst_port = le32_to_cpu(v1->dst_port_id);
 
-		size = le32_to_cpu(v1->size);
+		*size = le32_to_cpu(v1->size);
 		break;
 	case QRTR_PROTO_VER_2:
+		if (len < sizeof(*v2))
+			return -EINVAL;
 		v2 = data;
-		hdrlen = sizeof(*v2) + v2->optlen;
+		*hdrlen = sizeof(*v2) + v2->optlen;
 
 		cb->type = v2->type;
 		cb->confirm_rx = !!(v2->flags & QRTR_FLAGS_CONFIRM_RX);
@@ -831,21 +914,82 @@ int qrtr_endpoint_post(struct qrtr_endpoint *ep, const void *data, size_t len)
 		if (cb->dst_port == (u16)QRTR_PORT_CTRL)
 			cb->dst_port = QRTR_PORT_CTRL;
 
-		size = le32_to_cpu(v2->size);
+		*size = le32_to_cpu(v2->size);
 		break;
 	default:
 		pr_err("qrtr: Invalid version %d\n", ver);
-		goto err;
+		return -EINVAL;
 	}
 
 	if (cb->dst_port == QRTR_PORT_CTRL_LEGACY)
 		cb->dst_port = QRTR_PORT_CTRL;
 
-	if (len != ALIGN(size, 4) + hdrlen)
-		goto err;
+	if (len != ALIGN(*size, 4) + *hdrlen)
+		return -EINVAL;
 
 	if (cb->dst_port != QRTR_PORT_CTRL && cb->type != QRTR_TYPE_DATA &&
 	    cb->type != QRTR_TYPE_RESUME_TX)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void qrtr_endpoint_rx(struct qrtr_node *node, struct sk_buff *skb)
+{
+	node->stats.rx_pkts++;
+	node->stats.rx_bytes += skb->len;
+
+	qrtr_log_rx_msg(node, skb);
+
+	skb_queue_tail(&node->rx_queue, skb);
+	kthread_queue_work(&node->kworker, &node->read_data);
+}
+
+/**
+ * qrtr_endpoint_post() - post incoming data
+ * @ep: endpoint handle
+ * @data: data pointer
+ * @len: size of data in bytes
+ *
+ * The data is copied, so @data may be reused as soon as this returns.
+ *
+ * Return: 0 on success; negative error code on failure
+ */
+int qrtr_endpoint_post(struct qrtr_endpoint *ep, const void *data, size_t len)
+{
+	struct qrtr_node *node = ep->node;
+	struct sk_buff *skb;
+	struct qrtr_cb *cb;
+	unsigned int size;
+	size_t hdrlen;
+	int errcode;
+
+	if (len & 3) {
+		node->stats.rx_invalid++;
+		return -EINVAL;
+	}
+
+	skb = qrtr_rx_pool_get(node, len);
+	if (skb) {
+		node->stats.rx_pool_hit++;
+	} else {
+		skb = alloc_skb_with_frags(sizeof(struct qrtr_hdr_v1), len, 0,
+					   &errcode, GFP_ATOMIC);
+	}
+	if (!skb) {
+		skb = qrtr_get_backup(len);
+		if (!skb) {
+			node->stats.rx_alloc_fail++;
+			pr_err("qrtr: Unable to get skb with len:%lu\n", len);
+			return -ENOMEM;
+		}
+		node->stats.rx_backup++;
+	}
+
+	skb_reserve(skb, sizeof(struct qrtr_hdr_v1));
+	cb = (struct qrtr_cb *)skb->cb;
+
+	if (qrtr_parse_hdr(cb, data, len, &hdrlen, &size))
 		goto err;
 
 	__pm_wakeup_event(node->ws, 0);
@@ -853,20 +997,94 @@ int qrtr_endpoint_post(struct qrtr_endpoint *ep, const void *data, size_t len)
 	skb->data_len = size;
 	skb->len = size;
 	skb_store_bits(skb, 0, data + hdrlen, size);
-	qrtr_log_rx_msg(node, skb);
-
-	skb_queue_tail(&node->rx_queue, skb);
-	kthread_queue_work(&node->kworker, &node->read_data);
+	qrtr_endpoint_rx(node, skb);
 
 	return 0;
 
 err:
+	node->stats.rx_invalid++;
 	kfree_skb(skb);
 	return -EINVAL;
 
 }
 EXPORT_SYMBOL_GPL(qrtr_endpoint_post);
 
+/**
+ * qrtr_endpoint_post_skb() - post incoming data already held in an skb
+ * @ep: endpoint handle
+ * @skb: packet, header included, starting at skb->data
+ *
+ * For transports that receive into memory they can give away: the header is
+ * pulled off and @skb is queued as is, without copying the payload. @skb is
+ * consumed in all cases.
+ *
+ * Return: 0 on success; negative error code on failure
+ */
+int qrtr_endpoint_post_skb(struct qrtr_endpoint *ep, struct sk_buff *skb)
+{
+	struct qrtr_node *node = ep->node;
+	struct qrtr_cb *cb = (struct qrtr_cb *)skb->cb;
+	unsigned int size;
+	size_t hdrlen;
+
+	if (!pskb_may_pull(skb, min_t(unsigned int, skb->len,
+				      sizeof(struct qrtr_hdr_v1))))
+		goto err;
+
+	if (qrtr_parse_hdr(cb, skb->data, skb->len, &hdrlen, &size))
+		goto err;
+
+	if (!pskb_may_pull(skb, hdrlen))
+		goto err;
+	__skb_pull(skb, hdrlen);
+	if (pskb_trim(skb, size))
+		goto err;
+
+	/* Forwarding pushes a v1 header in front of the payload again */
+	if (skb_cow_head(skb, sizeof(struct qrtr_hdr_v1)))
+		goto err;
+
+	__pm_wakeup_event(node->ws, 0);
+
+	node->stats.rx_zero_copy++;
+	qrtr_endpoint_rx(node, skb);
+
+	return 0;
+
+err:
+	node->stats.rx_invalid++;
+	kfree_skb(skb);
+	return -EINVAL;
+}
+EXPORT_SYMBOL_GPL(qrtr_endpoint_post_skb);
+
+static int qrtr_node_stats_get(char *buf, const struct kernel_param *kp)
+{
+	struct qrtr_node *node;
+	int len = 0;
+
+	down_read(&qrtr_node_lock);
+	list_for_each_entry(node, &qrtr_all_epts, item) {
+		struct qrtr_node_stats *st = &node->stats;
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "node %d: rx %lu bytes %lu zero_copy %lu pool %lu backup %lu alloc_fail %lu invalid %lu\n",
+				 (int)node->nid, st->rx_pkts, st->rx_bytes,
+				 st->rx_zero_copy, st->rx_pool_hit,
+				 st->rx_backup, st->rx_alloc_fail,
+				 st->rx_invalid);
+	}
+	up_read(&qrtr_node_lock);
+
+	return len;
+}
+
+static const struct kernel_param_ops qrtr_node_stats_ops = {
+	.get = qrtr_node_stats_get,
+};
+module_param_cb(node_stats, &qrtr_node_stats_ops, NULL, 0444);
+MODULE_PARM_DESC(node_stats, "Per endpoint receive statistics");
+
 /**
  * qrtr_alloc_ctrl_packet() - allocate control packet skb
  * @pkt: reference to qrtr_ctrl_pkt pointer
@@ -1129,6 +1347,7 @@ int qrtr_endpoint_register(struct qrtr_endpoint *ep, unsigned int net_id,
 	kref_init(&node->ref);
 	mutex_init(&node->ep_lock);
 	skb_queue_head_init(&node->rx_queue);
+	skb_queue_head_init(&node->rx_pool);
 	node->nid = QRTR_EP_NID_AUTO;
 	node->ep = ep;
 	atomic_set(&node->hello_sent, 0);
@@ -1136,6 +1355,7 @@ int qrtr_endpoint_register(struct qrtr_endpoint *ep, unsigned int net_id,
 
 	kthread_init_work(&node->read_data, qrtr_node_rx_work);
 	kthread_init_work(&node->say_hello, qrtr_hello_work);
+	kthread_init_work(&node->rx_pool_fill, qrtr_rx_pool_fill_work);
 	kthread_init_worker(&node->kworker);
 	node->task = kthread_run(kthread_worker_fn, &node->kworker, "qrtr_rx");
 	if (IS_ERR(node->task)) {
@@ -1157,6 +1377,7 @@ int qrtr_endpoint_register(struct qrtr_endpoint *ep, unsigned int net_id,
 	up_write(&qrtr_node_lock);
 	ep->node = node;
 
+	kthread_queue_work(&node->kworker, &node->rx_pool_fill);
 	kthread_queue_work(&node->kworker, &node->say_hello);
 	return 0;
 }
@@ -1267,15 +1488,26 @@ EXPORT_SYMBOL_GPL(qrtr_endpoint_unregister);
 static struct qrtr_sock *qrtr_port_lookup(int port)
 {
 	struct qrtr_sock *ipc;
+	u64 start = 0;
 
 	if (port == QRTR_PORT_CTRL)
 		port = 0;
 
-	mutex_lock(&qrtr_port_lock);
+	if (trace_qrtr_port_lookup_enabled())
+		start = ktime_get_ns();
+
+	/* qrtr_port_remove() waits for a grace period after unpublishing the
+	 * port, so the socket is still referenced by the IDR while we are
+	 * in here.
+	 */
+	rcu_read_lock();
 	ipc = idr_find(&qrtr_ports, port);
 	if (ipc)
 		sock_hold(&ipc->sk);
-	mutex_unlock(&qrtr_port_lock);
+	rcu_read_unlock();
+
+	if (start)
+		trace_qrtr_port_lookup(port, !!ipc, ktime_get_ns() - start);
 
 	return ipc;
 }
@@ -1337,16 +1569,24 @@ exit:
 static void qrtr_port_remove(struct qrtr_sock *ipc)
 {
 	int port = ipc->us.sq_port;
+	u64 start, hold_ns;
 
 	qrtr_send_del_client(ipc);
 	if (port == QRTR_PORT_CTRL)
 		port = 0;
 
-	__sock_put(&ipc->sk);
-
 	mutex_lock(&qrtr_port_lock);
+	start = ktime_get_ns();
 	idr_remove(&qrtr_ports, port);
+	hold_ns = ktime_get_ns() - start;
 	mutex_unlock(&qrtr_port_lock);
+	trace_qrtr_port_update(port, false, hold_ns);
+
+	/* Let any qrtr_port_lookup() that found the port take its reference
+	 * before the IDR's reference is dropped.
+	 */
+	synchronize_rcu();
+	__sock_put(&ipc->sk);
 }
 
 /* Assign port number to socket.
@@ -1420,6 +1660,7 @@ static int __qrtr_bind(struct socket *sock,
 {
 	struct qrtr_sock *ipc = qrtr_sk(sock->sk);
 	struct sock *sk = sock->sk;
+	u64 start, hold_ns;
 	int port;
 	int rc;
 
@@ -1428,6 +1669,7 @@ static int __qrtr_bind(struct socket *sock,
 		return 0;
 
 	mutex_lock(&qrtr_port_lock);
+	start = ktime_get_ns();
 	port = addr->sq_port;
 	rc = qrtr_port_assign(ipc, &port);
 	if (rc) {
@@ -1437,7 +1679,9 @@ static int __qrtr_bind(struct socket *sock,
 	/* Notify all open ports about the new controller */
 	if (port == QRTR_PORT_CTRL)
 		qrtr_reset_ports();
+	hold_ns = ktime_get_ns() - start;
 	mutex_unlock(&qrtr_port_lock);
+	trace_qrtr_port_update(port, true, hold_ns);
 
 	if (port == QRTR_PORT_CTRL) {
 		struct qrtr_node *node;
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM qrtr
+#define TRACE_INCLUDE_FILE qrtr_trace
+
+#if !defined(_QRTR_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _QRTR_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS
+	(qrtr_lock_template,
+
+	 TP_PROTO(unsigned int id, bool found, u64 hold_ns),
+
+	 TP_ARGS(id, found, hold_ns),
+
+	 TP_STRUCT__entry(
+		__field(unsigned int, id)
+		__field(bool, found)
+		__field(u64, hold_ns)
+	 ),
+
+	 TP_fast_assign(
+		__entry->id = id;
+		__entry->found = found;
+		__entry->hold_ns = hold_ns;
+	 ),
+
+	 TP_printk("id=0x%x found=%d hold_ns=%llu",
+		   __entry->id, __entry->found, __entry->hold_ns)
+)
+
+/* Read side: time spent in the RCU section of a lookup */
+DEFINE_EVENT
+	(qrtr_lock_template, qrtr_node_lookup,
+
+	 TP_PROTO(unsigned int id, bool found, u64 hold_ns),
+
+	 TP_ARGS(id, found, hold_ns)
+);
+
+DEFINE_EVENT
+	(qrtr_lock_template, qrtr_port_lookup,
+
+	 TP_PROTO(unsigned int id, bool found, u64 hold_ns),
+
+	 TP_ARGS(id, found, hold_ns)
+);
+
+/* Update side: time qrtr_node_lock or qrtr_port_lock is held for writing */
+DEFINE_EVENT
+	(qrtr_lock_template, qrtr_node_update,
+
+	 TP_PROTO(unsigned int id, bool found, u64 hold_ns),
+
+	 TP_ARGS(id, found, hold_ns)
+);
+
+DEFINE_EVENT
+	(qrtr_lock_template, qrtr_port_update,
+
+	 TP_PROTO(unsigned int id, bool found, u64 hold_ns),
+
+	 TP_ARGS(id, found, hold_ns)
+);
+
+#endif /* _QRTR_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#include <trace/define_trace.h>
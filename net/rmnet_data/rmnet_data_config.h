@@ -17,6 +17,7 @@
 #include <linux/spinlock.h>
 #include <net/rmnet_config.h>
 #include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #ifndef _RMNET_DATA_CONFIG_H_
 #define _RMNET_DATA_CONFIG_H_
@@ -33,6 +34,8 @@
  * @mux_id: Virtual channel ID used by MAP protocol
  * @egress_dev: Next device to deliver the packet to. Exact usage of this
  *            parmeter depends on the rmnet_mode
+ * @gro_batch_bytes: Bytes handed to GRO from the aggregate being
+ *            deaggregated, not yet accounted by the GRO flush logic
  */
 struct rmnet_logical_ep_conf_s {
 	u8 refcount;
@@ -40,6 +43,7 @@ struct rmnet_logical_ep_conf_s {
 	u8 mux_id;
 	struct timespec flush_time;
 	unsigned int flush_byte_count;
+	unsigned int gro_batch_bytes;
 	struct net_device *egress_dev;
 };
 
@@ -62,6 +66,8 @@ struct rmnet_logical_ep_conf_s {
  * @tail_spacing: Guaranteed padding (bytes) when de-aggregating ingress frames
  * @agg_time: Wall clock time when aggregated frame was created
  * @agg_last: Last time the aggregation routing was invoked
+ * @hrtimer: Bounds how long packets sit in the aggregation buffer
+ * @agg_tasklet: Ships the aggregation buffer once @hrtimer expires
  */
 struct rmnet_phys_ep_config {
 	struct net_device *dev;
@@ -85,6 +91,7 @@ struct rmnet_phys_ep_config {
 	struct timespec agg_time;
 	struct timespec agg_last;
 	struct hrtimer hrtimer;
+	struct tasklet_struct agg_tasklet;
 };
 
 int rmnet_config_init(void);
@@ -319,17 +319,36 @@ static void rmnet_optional_gro_flush(struct napi_struct *napi,
 	}
 }
 
+/* rmnet_gro_batch_flush() - Run the deferred GRO flush check for an ep
+ * @ep: Logical endpoint which received packets of the current aggregate
+ *
+ * While an aggregated frame is deaggregated, the GRO flush decision is
+ * taken once for all packets of the same endpoint instead of per packet.
+ */
+static void rmnet_gro_batch_flush(struct rmnet_logical_ep_conf_s *ep)
+{
+	unsigned int bytes;
+
+	if (!ep || !ep->gro_batch_bytes)
+		return;
+
+	bytes = ep->gro_batch_bytes;
+	ep->gro_batch_bytes = 0;
+	rmnet_optional_gro_flush(get_current_napi_context(), ep, bytes);
+}
+
 /* __rmnet_deliver_skb() - Deliver skb
  *
  * Determines where to deliver skb. Options are: consume by network stack,
- * pass to bridge handler, or pass to virtual network device
+ * pass to bridge handler, or pass to virtual network device. When @batch is
+ * set the GRO flush check is left to rmnet_gro_batch_flush().
  *
  * Return:
  *      - RX_HANDLER_CONSUMED if packet forwarded or dropped
  *      - RX_HANDLER_PASS if packet is to be consumed by network stack as-is
  */
 static rx_handler_result_t __rmnet_deliver_skb
-	(struct sk_buff *skb, struct rmnet_logical_ep_conf_s *ep)
+	(struct sk_buff *skb, struct rmnet_logical_ep_conf_s *ep, bool batch)
 {
 	struct napi_struct *napi = NULL;
 	gro_result_t gro_res;
@@ -352,7 +371,10 @@ static rx_handler_result_t __rmnet_deliver_skb
 			skb_size = skb->len;
 			gro_res = napi_gro_receive(napi, skb);
 			trace_rmnet_gro_downlink(gro_res);
-			rmnet_optional_gro_flush(napi, ep, skb_size);
+			if (batch)
+				ep->gro_batch_bytes += skb_size;
+			else
+				rmnet_optional_gro_flush(napi, ep, skb_size);
 		} else{
 			netif_receive_skb(skb);
 		}
@@ -398,7 +420,7 @@ static rx_handler_result_t rmnet_ingress_deliver_packet
 
 	skb->dev = config->local_ep.egress_dev;
 
-	return __rmnet_deliver_skb(skb, &config->local_ep);
+	return __rmnet_deliver_skb(skb, &config->local_ep, false);
 }
 
 /* MAP handler */
@@ -407,6 +429,9 @@ static rx_handler_result_t rmnet_ingress_deliver_packet
  * @skb:        Packet being received
  * @config:     Physical endpoint configuration for the ingress device
  *
+ * @batch_ep:   Endpoint of the GRO batch of the current aggregate, or NULL
+ *              if packets are not part of an aggregate
+ *
  * Most MAP ingress functions are processed here. Packets are processed
  * individually; aggregated packets should use rmnet_map_ingress_handler()
  *
@@ -415,7 +440,8 @@ static rx_handler_result_t rmnet_ingress_deliver_packet
  *      - result of __rmnet_deliver_skb() for all other cases
  */
 static rx_handler_result_t _rmnet_map_ingress_handler
-	(struct sk_buff *skb, struct rmnet_phys_ep_config *config)
+	(struct sk_buff *skb, struct rmnet_phys_ep_config *config,
+	 struct rmnet_logical_ep_conf_s **batch_ep)
 {
 	struct rmnet_logical_ep_conf_s *ep;
 	u8 mux_id;
@@ -480,9 +506,15 @@ static rx_handler_result_t _rmnet_map_ingress_handler
 
 	/* Subtract MAP header */
 	skb_pull(skb, sizeof(struct rmnet_map_header_s));
-	skb_trim(skb, len);
+	pskb_trim(skb, len);
 	__rmnet_data_set_skb_proto(skb);
-	return __rmnet_deliver_skb(skb, ep);
+
+	if (batch_ep && *batch_ep != ep) {
+		rmnet_gro_batch_flush(*batch_ep);
+		*batch_ep = ep;
+	}
+
+	return __rmnet_deliver_skb(skb, ep, !!batch_ep);
 }
 
 /* rmnet_map_ingress_handler() - MAP ingress handler
@@ -501,18 +533,20 @@ static rx_handler_result_t _rmnet_map_ingress_handler
 static rx_handler_result_t rmnet_map_ingress_handler
 	(struct sk_buff *skb, struct rmnet_phys_ep_config *config)
 {
+	struct rmnet_logical_ep_conf_s *batch_ep = NULL;
 	struct sk_buff *skbn;
 	int rc;
 
 	if (config->ingress_data_format & RMNET_INGRESS_FORMAT_DEAGGREGATION) {
 		trace_rmnet_start_deaggregation(skb);
 		while ((skbn = rmnet_data_map_deaggregate(skb, config)) != 0)
-			_rmnet_map_ingress_handler(skbn, config);
+			_rmnet_map_ingress_handler(skbn, config, &batch_ep);
 
+		rmnet_gro_batch_flush(batch_ep);
 		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_MAPINGRESS_AGGBUF);
 		rc = RX_HANDLER_CONSUMED;
 	} else {
-		rc = _rmnet_map_ingress_handler(skb, config);
+		rc = _rmnet_map_ingress_handler(skb, config, NULL);
 	}
 
 	return rc;
@@ -606,7 +640,9 @@ static int rmnet_map_egress_handler(struct sk_buff *skb,
 			if (unlikely(__skb_linearize(skb)))
 				return RMNET_MAP_SUCCESS;
 
-		rmnet_map_aggregate(skb, config);
+		rmnet_map_aggregate(skb, config,
+				    rmnet_ul_flow_class(skb, required_headroom) ==
+				    RMNET_MAP_UL_CLASS_INTERACTIVE);
 		return RMNET_MAP_CONSUMED;
 	}
 
@@ -123,6 +123,11 @@ enum rmnet_map_agg_state_e {
 	RMNET_MAP_TXFER_SCHEDULED
 };
 
+enum rmnet_map_ul_class_e {
+	RMNET_MAP_UL_CLASS_BULK,
+	RMNET_MAP_UL_CLASS_INTERACTIVE
+};
+
 #define RMNET_MAP_COMMAND_REQUEST     0
 #define RMNET_MAP_COMMAND_ACK         1
 #define RMNET_MAP_COMMAND_UNSUPPORTED 2
@@ -142,12 +147,15 @@ rx_handler_result_t
 rmnet_data_map_command(struct sk_buff *skb,
 		       struct rmnet_phys_ep_config *config);
 void rmnet_map_aggregate(struct sk_buff *skb,
-			 struct rmnet_phys_ep_config *config);
+			 struct rmnet_phys_ep_config *config,
+			 bool flush_now);
 
 int rmnet_map_data_checksum_downlink_packet(struct sk_buff *skb);
 int rmnet_map_data_checksum_uplink_packet(struct sk_buff *skb,
 					  struct net_device *orig_dev,
 					  u32 egress_data_format);
 int rmnet_ul_aggregation_skip(struct sk_buff *skb, int offset);
+int rmnet_ul_flow_class(struct sk_buff *skb, int offset);
 enum hrtimer_restart rmnet_map_flush_packet_queue(struct hrtimer *t);
+void rmnet_map_flush_packet_tasklet(unsigned long data);
 #endif /* _RMNET_MAP_H_ */
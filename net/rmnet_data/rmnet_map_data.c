@@ -15,6 +15,7 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/skbuff.h>
+#include <linux/skb_latency.h>
 #include <linux/netdevice.h>
 #include <linux/rmnet_data.h>
 #include <linux/spinlock.h>
@@ -48,13 +49,25 @@ long agg_bypass_time __read_mostly = 10000000L;
 module_param(agg_bypass_time, long, 0644);
 MODULE_PARM_DESC(agg_bypass_time, "Skip agg when apart spaced more than this");
 
-struct agg_work {
-	struct work_struct work;
-	struct rmnet_phys_ep_config *config;
-};
+long agg_flush_timeout __read_mostly = 3000000L;
+module_param(agg_flush_timeout, long, 0644);
+MODULE_PARM_DESC(agg_flush_timeout, "Flush the agg buf this long after start");
+
+unsigned int agg_interactive_size __read_mostly = 128;
+module_param(agg_interactive_size, uint, 0644);
+MODULE_PARM_DESC(agg_interactive_size, "Send IP packets up to this size now");
+
+bool deaggr_frag_share __read_mostly = true;
+module_param(deaggr_frag_share, bool, 0644);
+MODULE_PARM_DESC(deaggr_frag_share, "Share page backed agg buf on deagg");
 
 #define RMNET_MAP_DEAGGR_SPACING  64
 #define RMNET_MAP_DEAGGR_HEADROOM (RMNET_MAP_DEAGGR_SPACING / 2)
+/* Bytes copied into the linear area when sharing the aggregation buffer.
+ * Covers the MAP header plus the largest IPv4/IPv6 and TCP/UDP headers
+ * up to the transport checksum field.
+ */
+#define RMNET_MAP_DEAGGR_COPYBREAK 128
 
 /* rmnet_data_map_add_map_header() - Adds MAP header to front of skb->data
  * @skb:        Socket buffer ("packet") to modify
@@ -110,11 +123,52 @@ done:
 	return map_header;
 }
 
+/* rmnet_map_deaggr_share() - Builds a frame skb on the aggregation buffer
+ * @skb:        Page backed source buffer, positioned at the MAP frame
+ * @packet_len: Length of the MAP frame, including any checksum trailer
+ *
+ * Only the first RMNET_MAP_DEAGGR_COPYBREAK bytes are copied so the MAP,
+ * IP and transport headers stay linear; the remainder is attached as a
+ * fragment holding a reference on the page of the source head.
+ *
+ * Return:
+ *     - Pointer to new skb
+ *     - 0 (null) on allocation failure
+ */
+static struct sk_buff *rmnet_map_deaggr_share(struct sk_buff *skb,
+					      u32 packet_len)
+{
+	struct sk_buff *skbn;
+	struct page *page;
+	u32 offset;
+
+	skbn = alloc_skb(RMNET_MAP_DEAGGR_COPYBREAK + RMNET_MAP_DEAGGR_SPACING,
+			 GFP_ATOMIC);
+	if (!skbn)
+		return 0;
+
+	skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
+	memcpy(skb_put(skbn, RMNET_MAP_DEAGGR_COPYBREAK), skb->data,
+	       RMNET_MAP_DEAGGR_COPYBREAK);
+
+	page = virt_to_head_page(skb->head);
+	offset = skb->data + RMNET_MAP_DEAGGR_COPYBREAK -
+		 (unsigned char *)page_address(page);
+	get_page(page);
+	skb_add_rx_frag(skbn, 0, page, offset,
+			packet_len - RMNET_MAP_DEAGGR_COPYBREAK,
+			packet_len - RMNET_MAP_DEAGGR_COPYBREAK);
+
+	return skbn;
+}
+
 /* rmnet_data_map_deaggregate() - Deaggregates a single packet
  * @skb:        Source socket buffer containing multiple MAP frames
  * @config:     Physical endpoint configuration of the ingress device
  *
  * A whole new buffer is allocated for each portion of an aggregated frame.
+ * If the source buffer is page backed, data frames only get their headers
+ * copied and reference the rest of the frame in the source page instead.
  * Caller should keep calling deaggregate() on the source skb until 0 is
  * returned, indicating that there are no more packets to deaggregate. Caller
  * is responsible for freeing the original skb.
@@ -145,14 +199,28 @@ struct sk_buff *rmnet_data_map_deaggregate(struct sk_buff *skb,
 		return 0;
 	}
 
+	if (deaggr_frag_share && skb->head_frag && !skb_is_nonlinear(skb) &&
+	    !maph->cd_bit && packet_len > RMNET_MAP_DEAGGR_COPYBREAK) {
+		skbn = rmnet_map_deaggr_share(skb, packet_len);
+		if (skbn)
+			goto out;
+	}
+
 	skbn = alloc_skb(packet_len + RMNET_MAP_DEAGGR_SPACING, GFP_ATOMIC);
 	if (!skbn)
 		return 0;
 
-	skbn->dev = skb->dev;
 	skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
 	skb_put(skbn, packet_len);
 	memcpy(skbn->data, skb->data, packet_len);
+out:
+	skbn->dev = skb->dev;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* keep the frames busy pollable through the ingress device's NAPI */
+	skbn->napi_id = skb->napi_id;
+#endif
+	skb_lat_copy(skbn, skb);
+	skb_lat_stamp(skbn, SKB_LAT_DEAGG);
 	skb_pull(skb, packet_len);
 
 	/* Some hardware can send us empty frames. Catch them */
@@ -165,16 +233,20 @@ struct sk_buff *rmnet_data_map_deaggregate(struct sk_buff *skb,
 	return skbn;
 }
 
-static void rmnet_map_flush_packet_work(struct work_struct *work)
+/* rmnet_map_flush_packet_tasklet() - Transmits the aggregated frame
+ * @data: Physical endpoint configuration owning the aggregation buffer
+ *
+ * Scheduled by the aggregation hrtimer so the buffer is sent from softirq
+ * context as soon as the time bound expires.
+ */
+void rmnet_map_flush_packet_tasklet(unsigned long data)
 {
 	struct rmnet_phys_ep_config *config;
-	struct agg_work *real_work;
 	int rc, agg_count = 0;
 	unsigned long flags;
 	struct sk_buff *skb;
 
-	real_work = (struct agg_work *)work;
-	config = real_work->config;
+	config = (struct rmnet_phys_ep_config *)data;
 	skb = NULL;
 
 	LOGD("%s", "Entering flush thread");
@@ -200,40 +272,29 @@ static void rmnet_map_flush_packet_work(struct work_struct *work)
 		rc = dev_queue_xmit(skb);
 		rmnet_stats_queue_xmit(rc, RMNET_STATS_QUEUE_XMIT_AGG_TIMEOUT);
 	}
-
-	kfree(work);
 }
 
 /* rmnet_map_flush_packet_queue() - Transmits aggregeted frame on timeout
  *
- * This function is scheduled to run in a specified number of ns after
- * the last frame transmitted by the network stack. When run, the buffer
- * containing aggregated packets is finally transmitted on the underlying link.
+ * This function is scheduled to run agg_flush_timeout ns after the first
+ * frame was put in the aggregation buffer. When run, the buffer containing
+ * aggregated packets is finally transmitted on the underlying link.
  *
  */
 enum hrtimer_restart rmnet_map_flush_packet_queue(struct hrtimer *t)
 {
 	struct rmnet_phys_ep_config *config;
-	struct agg_work *work;
 
 	config = container_of(t, struct rmnet_phys_ep_config, hrtimer);
-
-	work = kmalloc(sizeof(*work), GFP_ATOMIC);
-	if (!work) {
-		config->agg_state = RMNET_MAP_AGG_IDLE;
-
-		return HRTIMER_NORESTART;
-	}
-
-	INIT_WORK(&work->work, rmnet_map_flush_packet_work);
-	work->config = config;
-	schedule_work((struct work_struct *)work);
+	tasklet_schedule(&config->agg_tasklet);
 	return HRTIMER_NORESTART;
 }
 
 /* rmnet_map_aggregate() - Software aggregates multiple packets.
  * @skb:        current packet being transmitted
  * @config:     Physical endpoint configuration of the ingress device
+ * @flush_now:  Latency sensitive packet; send it and anything aggregated
+ *              before it right away
  *
  * Aggregates multiple SKBs into a single large SKB for transmission. MAP
  * protocol is used to separate the packets in the buffer. This function
@@ -241,7 +302,8 @@ enum hrtimer_restart rmnet_map_flush_packet_queue(struct hrtimer *t)
  * function.
  */
 void rmnet_map_aggregate(struct sk_buff *skb,
-			 struct rmnet_phys_ep_config *config)
+			 struct rmnet_phys_ep_config *config,
+			 bool flush_now)
 {
 	u8 *dest_buff;
 	unsigned long flags;
@@ -263,15 +325,17 @@ new_packet:
 		 */
 		diff = timespec_sub(config->agg_last, last);
 
-		if ((diff.tv_sec > 0) || (diff.tv_nsec > agg_bypass_time)) {
+		if (flush_now || (diff.tv_sec > 0) ||
+		    (diff.tv_nsec > agg_bypass_time)) {
 			spin_unlock_irqrestore(&config->agg_lock, flags);
 			LOGL("delta t: %ld.%09lu\tcount: bypass", diff.tv_sec,
 			     diff.tv_nsec);
 			rmnet_stats_agg_pkts(1);
 			trace_rmnet_map_aggregate(skb, 0);
 			rc = dev_queue_xmit(skb);
-			rmnet_stats_queue_xmit(rc,
-					       RMNET_STATS_QUEUE_XMIT_AGG_SKIP);
+			rmnet_stats_queue_xmit(rc, flush_now ?
+				RMNET_STATS_QUEUE_XMIT_AGG_INTERACTIVE :
+				RMNET_STATS_QUEUE_XMIT_AGG_SKIP);
 			return;
 		}
 
@@ -324,10 +388,31 @@ new_packet:
 	config->agg_count++;
 	rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_INTO_BUFF);
 
+	/* Ship the buffer with the latency sensitive packet at its tail so
+	 * it is not reordered ahead of what was aggregated before it.
+	 */
+	if (flush_now) {
+		rmnet_stats_agg_pkts(config->agg_count);
+		agg_skb = config->agg_skb;
+		agg_count = config->agg_count;
+		config->agg_skb = 0;
+		config->agg_count = 0;
+		memset(&config->agg_time, 0, sizeof(struct timespec));
+		config->agg_state = RMNET_MAP_AGG_IDLE;
+		spin_unlock_irqrestore(&config->agg_lock, flags);
+		hrtimer_cancel(&config->hrtimer);
+		trace_rmnet_map_aggregate(agg_skb, agg_count);
+		rc = dev_queue_xmit(agg_skb);
+		rmnet_stats_queue_xmit(rc,
+				       RMNET_STATS_QUEUE_XMIT_AGG_INTERACTIVE);
+		return;
+	}
+
 schedule:
 	if (config->agg_state != RMNET_MAP_TXFER_SCHEDULED) {
 		config->agg_state = RMNET_MAP_TXFER_SCHEDULED;
-		hrtimer_start(&config->hrtimer, ns_to_ktime(3000000),
+		hrtimer_start(&config->hrtimer,
+			      ns_to_ktime(agg_flush_timeout),
 			      HRTIMER_MODE_REL);
 	}
 	spin_unlock_irqrestore(&config->agg_lock, flags);
@@ -581,7 +666,7 @@ static int rmnet_map_validate_ipv6_packet_checksum
  */
 int rmnet_map_data_checksum_downlink_packet(struct sk_buff *skb)
 {
-	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer;
+	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer, trailer;
 	unsigned int data_len;
 	unsigned char *map_payload;
 	unsigned char ip_version;
@@ -592,9 +677,12 @@ int rmnet_map_data_checksum_downlink_packet(struct sk_buff *skb)
 	    sizeof(struct rmnet_map_dl_checksum_trailer_s))))
 		return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
 
-	cksum_trailer = (struct rmnet_map_dl_checksum_trailer_s *)
-			(skb->data + data_len
-			+ sizeof(struct rmnet_map_header_s));
+	/* the trailer is in a fragment when deaggregation shared the page */
+	cksum_trailer = skb_header_pointer(skb,
+			data_len + sizeof(struct rmnet_map_header_s),
+			sizeof(trailer), &trailer);
+	if (unlikely(!cksum_trailer))
+		return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
 
 	if (unlikely(!ntohs(cksum_trailer->valid)))
 		return RMNET_MAP_CHECKSUM_VALID_FLAG_NOT_SET;
@@ -752,6 +840,57 @@ done:
 	return ret;
 }
 
+/* rmnet_ul_flow_class() - Classifies an uplink packet for aggregation
+ * @skb:    MAP packet being transmitted
+ * @offset: Offset of the IP header from skb->data
+ *
+ * Small packets, such as interactive or game traffic, and pure TCP ACKs
+ * gain nothing from waiting for a larger aggregate but their flow's
+ * latency; everything else is treated as bulk and aggregated.
+ *
+ * Return:
+ *      - RMNET_MAP_UL_CLASS_INTERACTIVE if the packet should go out now
+ *      - RMNET_MAP_UL_CLASS_BULK otherwise
+ */
+int rmnet_ul_flow_class(struct sk_buff *skb, int offset)
+{
+	unsigned char *packet_start = skb->data + offset;
+	unsigned int len = skb->len - offset;
+	unsigned int hdrlen, payload;
+	struct tcphdr *th;
+
+	if (len <= agg_interactive_size)
+		return RMNET_MAP_UL_CLASS_INTERACTIVE;
+
+	if (packet_start[0] >> 4 == 0x04) {
+		struct iphdr *ip4h = (struct iphdr *)packet_start;
+
+		if (ip4h->protocol != IPPROTO_TCP)
+			return RMNET_MAP_UL_CLASS_BULK;
+		hdrlen = ip4h->ihl * 4;
+		payload = ntohs(ip4h->tot_len);
+	} else if (packet_start[0] >> 4 == 0x06) {
+		struct ipv6hdr *ip6h = (struct ipv6hdr *)packet_start;
+
+		if (ip6h->nexthdr != IPPROTO_TCP)
+			return RMNET_MAP_UL_CLASS_BULK;
+		hdrlen = sizeof(struct ipv6hdr);
+		payload = hdrlen + ntohs(ip6h->payload_len);
+	} else {
+		return RMNET_MAP_UL_CLASS_BULK;
+	}
+
+	if (len < hdrlen + sizeof(struct tcphdr))
+		return RMNET_MAP_UL_CLASS_BULK;
+
+	th = (struct tcphdr *)(packet_start + hdrlen);
+	if (payload == hdrlen + th->doff * 4 && th->ack &&
+	    !th->syn && !th->fin && !th->rst)
+		return RMNET_MAP_UL_CLASS_INTERACTIVE;
+
+	return RMNET_MAP_UL_CLASS_BULK;
+}
+
 int rmnet_ul_aggregation_skip(struct sk_buff *skb, int offset)
 {
 	unsigned char *packet_start = skb->data + offset;
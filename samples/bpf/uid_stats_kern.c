@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Per-uid traffic accounting without iptables
+ *
+ * Attached to a cgroup v2 as BPF_CGROUP_INET_INGRESS and _EGRESS, these
+ * programs count every packet of the sockets in the cgroup against the
+ * socket's uid, tag and interface, the way the quota2 and owner rule
+ * chains do, but as one hash lookup per packet into a per-CPU map.
+ *
+ * A socket is tagged by adding its SO_COOKIE to cookie_tag_map, with the
+ * uid to charge. Tagged traffic is counted both under its tag and under
+ * tag 0 of that uid, so tag 0 always holds the uid's total.
+ */
+#include <uapi/linux/bpf.h>
+#include "bpf_helpers.h"
+
+#define DIR_INGRESS	0
+#define DIR_EGRESS	1
+
+struct uid_tag {
+	u32 uid;
+	u32 tag;
+};
+
+struct stats_key {
+	u32 uid;
+	u32 tag;
+	u32 ifindex;
+	u32 dir;
+};
+
+struct stats_value {
+	u64 packets;
+	u64 bytes;
+};
+
+struct bpf_map_def SEC("maps") cookie_tag_map = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(u64),
+	.value_size = sizeof(struct uid_tag),
+	.max_entries = 10000,
+};
+
+struct bpf_map_def SEC("maps") uid_stats_map = {
+	.type = BPF_MAP_TYPE_PERCPU_HASH,
+	.key_size = sizeof(struct stats_key),
+	.value_size = sizeof(struct stats_value),
+	.max_entries = 4096,
+};
+
+static __always_inline void count(struct stats_key *key, u32 len)
+{
+	struct stats_value *val, init = { 1, len };
+
+	/* per-CPU values need no atomics */
+	val = bpf_map_lookup_elem(&uid_stats_map, key);
+	if (val) {
+		val->packets++;
+		val->bytes += len;
+	} else {
+		bpf_map_update_elem(&uid_stats_map, key, &init, BPF_NOEXIST);
+	}
+}
+
+static __always_inline int account(struct __sk_buff *skb, u32 dir)
+{
+	struct stats_key key = {};
+	struct uid_tag *ut;
+	u64 cookie;
+
+	cookie = bpf_get_socket_cookie(skb);
+	ut = bpf_map_lookup_elem(&cookie_tag_map, &cookie);
+	key.uid = ut ? ut->uid : bpf_get_socket_uid(skb);
+	key.ifindex = skb->ifindex;
+	key.dir = dir;
+	count(&key, skb->len);
+
+	if (ut && ut->tag) {
+		key.tag = ut->tag;
+		count(&key, skb->len);
+	}
+
+	/* accounting only, let every packet through */
+	return 1;
+}
+
+SEC("cgroup/skb/ingress")
+int uid_stats_ingress(struct __sk_buff *skb)
+{
+	return account(skb, DIR_INGRESS);
+}
+
+SEC("cgroup/skb/egress")
+int uid_stats_egress(struct __sk_buff *skb)
+{
+	return account(skb, DIR_EGRESS);
+}
+
+char _license[] SEC("license") = "GPL";
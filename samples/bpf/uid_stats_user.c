@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Loads uid_stats_kern.o, attaches it to a cgroup v2 for both directions
+ * and prints the per-uid counters every few seconds. Attach it to the root
+ * of the cgroup v2 hierarchy to see all traffic of the system.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <linux/bpf.h>
+
+#include "libbpf.h"
+#include "bpf_load.h"
+#include "bpf_util.h"
+
+struct stats_key {
+	uint32_t uid;
+	uint32_t tag;
+	uint32_t ifindex;
+	uint32_t dir;
+};
+
+struct stats_value {
+	uint64_t packets;
+	uint64_t bytes;
+};
+
+static int usage(const char *argv0)
+{
+	printf("Usage: %s cg-path [interval]\n", argv0);
+	return EXIT_FAILURE;
+}
+
+static void print_stats(int fd)
+{
+	unsigned int nr_cpus = bpf_num_possible_cpus();
+	struct stats_key key = {}, next_key;
+	struct stats_value values[nr_cpus];
+	char ifname[IF_NAMESIZE];
+	uint64_t packets, bytes;
+	unsigned int i;
+
+	printf("%10s %10s %-16s %4s %12s %16s\n",
+	       "uid", "tag", "iface", "dir", "packets", "bytes");
+	while (bpf_map_get_next_key(fd, &key, &next_key) == 0) {
+		key = next_key;
+		if (bpf_map_lookup_elem(fd, &key, values))
+			continue;
+
+		packets = bytes = 0;
+		for (i = 0; i < nr_cpus; i++) {
+			packets += values[i].packets;
+			bytes += values[i].bytes;
+		}
+		if (!if_indextoname(key.ifindex, ifname))
+			snprintf(ifname, sizeof(ifname), "%u", key.ifindex);
+
+		printf("%10u %#10x %-16s %4s %12llu %16llu\n",
+		       key.uid, key.tag, ifname, key.dir ? "tx" : "rx",
+		       (unsigned long long)packets, (unsigned long long)bytes);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	char filename[256];
+	int cg_fd, interval = 5;
+
+	if (argc < 2)
+		return usage(argv[0]);
+	if (argc > 2)
+		interval = atoi(argv[2]);
+
+	cg_fd = open(argv[1], O_DIRECTORY | O_RDONLY);
+	if (cg_fd < 0) {
+		printf("Failed to open cgroup path: '%s'\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	snprintf(filename, sizeof(filename), "%s_kern.o", argv[0]);
+	if (load_bpf_file(filename)) {
+		printf("%s", bpf_log_buf);
+		return EXIT_FAILURE;
+	}
+
+	/*
+	 * Programs are in section order: ingress, then egress. ALLOW_MULTI
+	 * keeps counting when a sub-cgroup attaches programs of its own.
+	 */
+	if (bpf_prog_attach(prog_fd[0], cg_fd, BPF_CGROUP_INET_INGRESS,
+			    BPF_F_ALLOW_MULTI) ||
+	    bpf_prog_attach(prog_fd[1], cg_fd, BPF_CGROUP_INET_EGRESS,
+			    BPF_F_ALLOW_MULTI)) {
+		printf("Failed to attach prog to cgroup: '%s'\n",
+		       strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	for (;;) {
+		sleep(interval);
+		/* map_fd[1] is uid_stats_map, after cookie_tag_map */
+		print_stats(map_fd[1]);
+	}
+
+	return EXIT_SUCCESS;
+}
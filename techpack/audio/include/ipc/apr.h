@@ -121,6 +121,19 @@ struct apr_client_data {
 
 typedef int32_t (*apr_fn)(struct apr_client_data *data, void *priv);
 
+/* Command buffers kept per service for apr_pkt_alloc() */
+#define APR_PKT_POOL_NR		8
+#define APR_PKT_POOL_BUF	512
+
+/* Commands per service whose response round trip is being timed */
+#define APR_MAX_INFLIGHT	8
+
+struct apr_inflight {
+	uint32_t opcode;
+	uint32_t token;
+	u64 sent_ns;
+};
+
 struct apr_svc {
 	uint16_t id;
 	uint16_t dest_id;
@@ -137,6 +150,10 @@ struct apr_svc {
 	struct mutex m_lock;
 	spinlock_t w_lock;
 	uint8_t pkt_owner;
+	void *pool;
+	unsigned long pool_free;
+	struct apr_inflight inflight[APR_MAX_INFLIGHT];
+	uint8_t inflight_next;
 };
 
 struct apr_client {
@@ -171,6 +188,9 @@ inline int apr_fill_hdr(void *handle, uint32_t *buf, uint16_t src_port,
 			uint32_t token, uint32_t opcode, uint16_t len);
 
 int apr_send_pkt(void *handle, uint32_t *buf);
+int apr_send_pkts(void *handle, uint32_t **bufs, int count);
+void *apr_pkt_alloc(void *handle, size_t size);
+void apr_pkt_free(void *handle, void *pkt);
 int apr_deregister(void *handle);
 void subsys_notif_register(char *client_name, int domain,
 			   struct notifier_block *nb);
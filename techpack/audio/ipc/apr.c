@@ -29,6 +29,8 @@
 #include <linux/slab.h>
 #include <linux/ipc_logging.h>
 #include <linux/of_platform.h>
+#include <linux/seq_file.h>
+#include <linux/hash.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/scm.h>
 #include <soc/snd_event.h>
@@ -69,6 +71,81 @@ struct apr_private {
 static struct apr_private *apr_priv;
 static bool apr_cf_debug;
 
+/* Command to response round trip times, by command opcode */
+#define APR_LAT_BITS	6
+
+struct apr_lat_stat {
+	uint32_t opcode;
+	uint32_t count;
+	uint32_t max_us;
+	u64 total_us;
+};
+
+static struct apr_lat_stat apr_lat[1 << APR_LAT_BITS];
+static unsigned long apr_lat_dropped;
+static DEFINE_SPINLOCK(apr_lat_lock);
+
+static void apr_lat_add(uint32_t opcode, u64 ns)
+{
+	uint32_t us = min_t(u64, div_u64(ns, NSEC_PER_USEC), U32_MAX);
+	struct apr_lat_stat *st;
+	unsigned long flags;
+	int i, idx;
+
+	spin_lock_irqsave(&apr_lat_lock, flags);
+	idx = hash_32(opcode, APR_LAT_BITS);
+	for (i = 0; i < ARRAY_SIZE(apr_lat); i++) {
+		st = &apr_lat[(idx + i) & (ARRAY_SIZE(apr_lat) - 1)];
+		if (st->count && st->opcode != opcode)
+			continue;
+
+		st->opcode = opcode;
+		st->count++;
+		st->total_us += us;
+		st->max_us = max(st->max_us, us);
+		goto unlock;
+	}
+	apr_lat_dropped++;
+unlock:
+	spin_unlock_irqrestore(&apr_lat_lock, flags);
+}
+
+/* Called with svc->w_lock held once @hdr went out */
+static void apr_inflight_add(struct apr_svc *svc, struct apr_hdr *hdr)
+{
+	struct apr_inflight *inf = &svc->inflight[svc->inflight_next];
+
+	svc->inflight_next = (svc->inflight_next + 1) % APR_MAX_INFLIGHT;
+	inf->opcode = hdr->opcode;
+	inf->token = hdr->token;
+	inf->sent_ns = ktime_get_ns();
+}
+
+/* Match a basic response to the command it acknowledges */
+static void apr_inflight_done(struct apr_svc *svc, uint32_t opcode,
+			      uint32_t token)
+{
+	struct apr_inflight *inf;
+	unsigned long flags;
+	u64 sent_ns = 0;
+	int i;
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	for (i = 0; i < APR_MAX_INFLIGHT; i++) {
+		inf = &svc->inflight[i];
+		if (inf->sent_ns && inf->opcode == opcode &&
+		    inf->token == token) {
+			sent_ns = inf->sent_ns;
+			inf->sent_ns = 0;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&svc->w_lock, flags);
+
+	if (sent_ns)
+		apr_lat_add(opcode, ktime_get_ns() - sent_ns);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static struct dentry *debugfs_apr_debug;
 static ssize_t apr_debug_write(struct file *filp, const char __user *ubuf,
@@ -87,6 +164,57 @@ static ssize_t apr_debug_write(struct file *filp, const char __user *ubuf,
 static const struct file_operations apr_debug_ops = {
 	.write = apr_debug_write,
 };
+
+static struct dentry *debugfs_apr_latency;
+
+static int apr_latency_show(struct seq_file *m, void *v)
+{
+	struct apr_lat_stat *st;
+	unsigned long flags;
+	int i;
+
+	seq_puts(m, "opcode     count      avg_us     max_us\n");
+	spin_lock_irqsave(&apr_lat_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(apr_lat); i++) {
+		st = &apr_lat[i];
+		if (!st->count)
+			continue;
+		seq_printf(m, "0x%08x %-10u %-10llu %u\n", st->opcode,
+			   st->count, div_u64(st->total_us, st->count),
+			   st->max_us);
+	}
+	seq_printf(m, "dropped %lu\n", apr_lat_dropped);
+	spin_unlock_irqrestore(&apr_lat_lock, flags);
+
+	return 0;
+}
+
+static int apr_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, apr_latency_show, NULL);
+}
+
+/* Any write clears the statistics */
+static ssize_t apr_latency_write(struct file *filp, const char __user *ubuf,
+				 size_t cnt, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&apr_lat_lock, flags);
+	memset(apr_lat, 0, sizeof(apr_lat));
+	apr_lat_dropped = 0;
+	spin_unlock_irqrestore(&apr_lat_lock, flags);
+
+	return cnt;
+}
+
+static const struct file_operations apr_latency_ops = {
+	.open = apr_latency_open,
+	.read = seq_read,
+	.write = apr_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 #endif
 
 #define APR_PKT_INFO(x...) \
@@ -350,30 +478,8 @@ struct apr_client *apr_get_client(int dest_id, int client_id)
 	return &client[dest_id][client_id];
 }
 
-/**
- * apr_send_pkt - Clients call to send packet
- * to destination processor.
- *
- * @handle: APR service handle
- * @buf: payload to send to destination processor.
- *
- * Returns Bytes(>0)pkt_size on success or error on failure.
- */
-int apr_send_pkt(void *handle, uint32_t *buf)
+static int apr_send_check(struct apr_svc *svc)
 {
-	struct apr_svc *svc = handle;
-	struct apr_client *clnt;
-	struct apr_hdr *hdr;
-	uint16_t dest_id;
-	uint16_t client_id;
-	uint16_t w_len;
-	int rc;
-	unsigned long flags;
-
-	if (!handle || !buf) {
-		pr_err("APR: Wrong parameters\n");
-		return -EINVAL;
-	}
 	if (svc->need_reset) {
 		pr_err_ratelimited("apr: send_pkt service need reset\n");
 		return -ENETRESET;
@@ -389,14 +495,25 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 		return -ENETRESET;
 	}
 
-	spin_lock_irqsave(&svc->w_lock, flags);
+	return 0;
+}
+
+/* Called with svc->w_lock held */
+static int __apr_send_pkt(struct apr_svc *svc, uint32_t *buf)
+{
+	struct apr_client *clnt;
+	struct apr_hdr *hdr;
+	uint16_t dest_id;
+	uint16_t client_id;
+	uint16_t w_len;
+	int rc;
+
 	dest_id = svc->dest_id;
 	client_id = svc->client_id;
 	clnt = &client[dest_id][client_id];
 
 	if (!client[dest_id][client_id].handle) {
 		pr_err_ratelimited("APR: Still service is not yet opened\n");
-		spin_unlock_irqrestore(&svc->w_lock, flags);
 		return -EINVAL;
 	}
 	hdr = (struct apr_hdr *)buf;
@@ -423,6 +540,8 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 			pr_err("%s: Unable to write whole APR pkt successfully: %d\n",
 			       __func__, rc);
 			rc = -EINVAL;
+		} else {
+			apr_inflight_add(svc, hdr);
 		}
 	} else {
 		pr_err_ratelimited("%s: Write APR pkt failed with error %d\n",
@@ -434,12 +553,167 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 			rc = -ENETRESET;
 		}
 	}
+
+	return rc;
+}
+
+/**
+ * apr_send_pkt - Clients call to send packet
+ * to destination processor.
+ *
+ * @handle: APR service handle
+ * @buf: payload to send to destination processor.
+ *
+ * Returns Bytes(>0)pkt_size on success or error on failure.
+ */
+int apr_send_pkt(void *handle, uint32_t *buf)
+{
+	struct apr_svc *svc = handle;
+	unsigned long flags;
+	int rc;
+
+	if (!handle || !buf) {
+		pr_err("APR: Wrong parameters\n");
+		return -EINVAL;
+	}
+
+	rc = apr_send_check(svc);
+	if (rc)
+		return rc;
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	rc = __apr_send_pkt(svc, buf);
 	spin_unlock_irqrestore(&svc->w_lock, flags);
 
 	return rc;
 }
 EXPORT_SYMBOL(apr_send_pkt);
 
+/**
+ * apr_send_pkts - Send several packets back to back
+ * to destination processor.
+ *
+ * @handle: APR service handle
+ * @bufs: payloads to send, in order
+ * @count: number of payloads
+ *
+ * The packets are queued to the transport under a single lock, without
+ * waiting for the responses in between, so a command sequence costs one
+ * round trip instead of @count. Stops at the first failure.
+ *
+ * Returns the number of packets sent, or error if none was sent.
+ */
+int apr_send_pkts(void *handle, uint32_t **bufs, int count)
+{
+	struct apr_svc *svc = handle;
+	unsigned long flags;
+	int rc, i;
+
+	if (!handle || !bufs || count <= 0) {
+		pr_err("APR: Wrong parameters\n");
+		return -EINVAL;
+	}
+
+	rc = apr_send_check(svc);
+	if (rc)
+		return rc;
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	for (i = 0; i < count; i++) {
+		rc = __apr_send_pkt(svc, bufs[i]);
+		if (rc < 0)
+			break;
+	}
+	spin_unlock_irqrestore(&svc->w_lock, flags);
+
+	return i ? i : rc;
+}
+EXPORT_SYMBOL(apr_send_pkts);
+
+/**
+ * apr_pkt_alloc - Allocate a zeroed command buffer
+ *
+ * @handle: APR service handle
+ * @size: size of the packet
+ *
+ * Buffers up to APR_PKT_POOL_BUF bytes come from a pool preallocated for
+ * the service, larger ones or ones beyond the pool from the heap. May
+ * sleep. Free with apr_pkt_free() on the same service.
+ *
+ * Returns the buffer or NULL.
+ */
+void *apr_pkt_alloc(void *handle, size_t size)
+{
+	struct apr_svc *svc = handle;
+	unsigned long flags;
+	void *pkt = NULL;
+	int i;
+
+	if (!svc)
+		return NULL;
+
+	if (size > APR_PKT_POOL_BUF)
+		return kzalloc(size, GFP_KERNEL);
+
+	if (!READ_ONCE(svc->pool)) {
+		mutex_lock(&svc->m_lock);
+		if (!svc->pool) {
+			pkt = kcalloc(APR_PKT_POOL_NR, APR_PKT_POOL_BUF,
+				      GFP_KERNEL);
+			spin_lock_irqsave(&svc->w_lock, flags);
+			svc->pool_free = pkt ? GENMASK(APR_PKT_POOL_NR - 1, 0)
+					     : 0;
+			svc->pool = pkt;
+			spin_unlock_irqrestore(&svc->w_lock, flags);
+			pkt = NULL;
+		}
+		mutex_unlock(&svc->m_lock);
+	}
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	if (svc->pool_free) {
+		i = __ffs(svc->pool_free);
+		__clear_bit(i, &svc->pool_free);
+		pkt = svc->pool + i * APR_PKT_POOL_BUF;
+	}
+	spin_unlock_irqrestore(&svc->w_lock, flags);
+
+	if (!pkt)
+		return kzalloc(size, GFP_KERNEL);
+
+	memset(pkt, 0, size);
+	return pkt;
+}
+EXPORT_SYMBOL(apr_pkt_alloc);
+
+/**
+ * apr_pkt_free - Free a buffer from apr_pkt_alloc()
+ *
+ * @handle: APR service handle
+ * @pkt: buffer to free
+ */
+void apr_pkt_free(void *handle, void *pkt)
+{
+	struct apr_svc *svc = handle;
+	unsigned long flags;
+	ptrdiff_t off;
+
+	if (!svc || !pkt)
+		return;
+
+	if (svc->pool && pkt >= svc->pool &&
+	    pkt < svc->pool + APR_PKT_POOL_NR * APR_PKT_POOL_BUF) {
+		off = pkt - svc->pool;
+		spin_lock_irqsave(&svc->w_lock, flags);
+		__set_bit(off / APR_PKT_POOL_BUF, &svc->pool_free);
+		spin_unlock_irqrestore(&svc->w_lock, flags);
+		return;
+	}
+
+	kfree(pkt);
+}
+EXPORT_SYMBOL(apr_pkt_free);
+
 int apr_pkt_config(void *handle, struct apr_pkt_cfg *cfg)
 {
 	struct apr_svc *svc = (struct apr_svc *)handle;
@@ -731,6 +1005,11 @@ void apr_cb_func(void *buf, int len, void *priv)
 	if (data.payload_size > 0)
 		data.payload = (char *)hdr + hdr_size;
 
+	if (hdr->opcode == APR_BASIC_RSP_RESULT &&
+	    data.payload_size >= sizeof(uint32_t))
+		apr_inflight_done(c_svc, *(uint32_t *)data.payload,
+				  hdr->token);
+
 	if (unlikely(apr_cf_debug)) {
 		if (hdr->opcode == APR_BASIC_RSP_RESULT && data.payload) {
 			uint32_t *ptr = data.payload;
@@ -1120,6 +1399,9 @@ static int __init apr_debug_init(void)
 	debugfs_apr_debug = debugfs_create_file("msm_apr_debug",
 						 S_IFREG | 0444, NULL, NULL,
 						 &apr_debug_ops);
+	debugfs_apr_latency = debugfs_create_file("msm_apr_latency",
+						  S_IFREG | 0644, NULL, NULL,
+						  &apr_latency_ops);
 	return 0;
 }
 #else
@@ -1143,12 +1425,16 @@ static void apr_cleanup(void)
 	for (i = 0; i < APR_DEST_MAX; i++) {
 		for (j = 0; j < APR_CLIENT_MAX; j++) {
 			mutex_destroy(&client[i][j].m_lock);
-			for (k = 0; k < APR_SVC_MAX; k++)
+			for (k = 0; k < APR_SVC_MAX; k++) {
 				mutex_destroy(&client[i][j].svc[k].m_lock);
+				kfree(client[i][j].svc[k].pool);
+				client[i][j].svc[k].pool = NULL;
+			}
 		}
 	}
 #ifdef CONFIG_DEBUG_FS
 	debugfs_remove(debugfs_apr_debug);
+	debugfs_remove(debugfs_apr_latency);
 #endif
 }
 
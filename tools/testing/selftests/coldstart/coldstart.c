@@ -0,0 +1,806 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * App cold start benchmark
+ *
+ * Runs the kernel paths an Android app launch goes through, one phase
+ * at a time or all at once with -p, and prints the latency percentiles
+ * of each step:
+ *
+ *   fork        zygote style fork of a process with a large file mapping
+ *               and a dirty heap, then the child's read faults on the
+ *               mapping and COW faults on the heap
+ *   file_fault  first touch of each page of an uncached file mapping
+ *   readahead   128KiB read()s of an uncached file
+ *   f2fs_compr  the same on a file with FS_COMPR_FL, skipped when the
+ *               work directory is not on f2fs with compression
+ *   binder      round trips to a context manager on a private binderfs
+ *               device, needs root and CONFIG_ANDROID_BINDERFS
+ *   ion         ION system heap allocations and frees
+ *   kgsl        KGSL GPU object allocations and frees
+ *   wakeup      pipe wakeups between CPUs of the first and last cluster
+ *
+ * Phases whose device or filesystem feature is missing are reported as
+ * skipped. Every reported line has the form
+ *
+ *   <phase>/<step> n=<samples> p50_us=.. p90_us=.. p99_us=.. max_us=..
+ *
+ * so runs before and after a kernel change can be compared with diff.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+
+#include <linux/android/binder.h>
+#include <linux/android/binderfs.h>
+#include <linux/fs.h>
+#include <linux/msm_kgsl.h>
+#include "ion.h"
+
+#define F2FS_SUPER_MAGIC	0xF2F52010
+
+/* ION_SYSTEM_HEAP_ID in drivers/staging/android/uapi/msm_ion.h */
+#define ION_SYSTEM_HEAP_MASK	(1U << 25)
+
+#define READ_CHUNK		(128 << 10)
+#define BINDER_MAP_SIZE		(1 << 20)
+#define BINDER_PAYLOAD		256
+
+static const char *work_dir = ".";
+static unsigned int iters = 200;
+static size_t file_size = 32 << 20;
+static long page_size;
+
+struct lat {
+	const char *name;
+	uint64_t *ns;
+	size_t n, cap;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void lat_add(struct lat *l, uint64_t ns)
+{
+	if (l->n == l->cap) {
+		l->cap = l->cap ? l->cap * 2 : 1024;
+		l->ns = realloc(l->ns, l->cap * sizeof(*l->ns));
+		if (!l->ns) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	l->ns[l->n++] = ns;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double pct_us(struct lat *l, unsigned int permille)
+{
+	size_t i = l->n * permille / 1000;
+
+	return l->ns[i < l->n ? i : l->n - 1] / 1000.0;
+}
+
+/* One write() per line, so parallel phases do not interleave */
+static void report(const char *phase, struct lat *l)
+{
+	char line[256];
+	int len;
+
+	if (!l->n) {
+		len = snprintf(line, sizeof(line), "%s/%s n=0\n",
+			       phase, l->name);
+	} else {
+		qsort(l->ns, l->n, sizeof(*l->ns), cmp_u64);
+		len = snprintf(line, sizeof(line),
+			       "%s/%s n=%zu p50_us=%.1f p90_us=%.1f p99_us=%.1f max_us=%.1f\n",
+			       phase, l->name, l->n, pct_us(l, 500),
+			       pct_us(l, 900), pct_us(l, 990),
+			       l->ns[l->n - 1] / 1000.0);
+	}
+	if (write(STDOUT_FILENO, line, len) < 0)
+		perror("write");
+
+	free(l->ns);
+	l->ns = NULL;
+	l->n = l->cap = 0;
+}
+
+static void skip(const char *phase, const char *why)
+{
+	char line[256];
+	int len;
+
+	len = snprintf(line, sizeof(line), "%s skipped: %s\n", phase, why);
+	if (write(STDOUT_FILENO, line, len) < 0)
+		perror("write");
+}
+
+/*
+ * Create @name in the work directory, compressible like app code and
+ * resources, synced so it can be dropped from the page cache.
+ */
+static int make_file(const char *name, int compress, char *path, size_t len)
+{
+	unsigned int flags = FS_COMPR_FL;
+	size_t off, i;
+	char *buf;
+	int fd;
+
+	snprintf(path, len, "%s/%s", work_dir, name);
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		return -1;
+
+	/* the flag can only be set on an empty file */
+	if (compress && ioctl(fd, FS_IOC_SETFLAGS, &flags)) {
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+
+	buf = malloc(READ_CHUNK);
+	if (!buf) {
+		close(fd);
+		return -1;
+	}
+	for (off = 0; off < file_size; off += READ_CHUNK) {
+		for (i = 0; i < READ_CHUNK; i++)
+			buf[i] = (i % 61 == 0) ? (char)(off >> 12) + i : 'a' + i % 13;
+		if (write(fd, buf, READ_CHUNK) != READ_CHUNK) {
+			free(buf);
+			close(fd);
+			return -1;
+		}
+	}
+	free(buf);
+	fsync(fd);
+
+	return fd;
+}
+
+static void drop_cache(int fd)
+{
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+static void phase_fork(void)
+{
+	struct lat fork_lat = { .name = "fork" };
+	struct lat fault_lat = { .name = "child_faults" };
+	size_t heap_size = file_size / 2, off;
+	volatile char *map;
+	char path[256], *heap;
+	unsigned int i, n = iters / 4 ? iters / 4 : 1;
+	int fd, pfd[2];
+
+	fd = make_file("coldstart.fork", 0, path, sizeof(path));
+	if (fd < 0) {
+		skip("fork", "cannot create the mapped file");
+		return;
+	}
+	map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	heap = mmap(NULL, heap_size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED || heap == MAP_FAILED || pipe(pfd)) {
+		skip("fork", "cannot map");
+		goto out;
+	}
+
+	/* the zygote has its boot image and heap resident */
+	for (off = 0; off < file_size; off += page_size)
+		(void)map[off];
+	memset(heap, 1, heap_size);
+
+	for (i = 0; i < n; i++) {
+		uint64_t start = now_ns(), ns;
+		pid_t pid = fork();
+
+		if (pid < 0)
+			break;
+		if (!pid) {
+			start = now_ns();
+			for (off = 0; off < file_size; off += page_size)
+				(void)map[off];
+			for (off = 0; off < heap_size; off += 4 * page_size)
+				heap[off]++;
+			ns = now_ns() - start;
+			if (write(pfd[1], &ns, sizeof(ns)) < 0)
+				_exit(1);
+			_exit(0);
+		}
+
+		lat_add(&fork_lat, now_ns() - start);
+		if (read(pfd[0], &ns, sizeof(ns)) == sizeof(ns))
+			lat_add(&fault_lat, ns);
+		waitpid(pid, NULL, 0);
+	}
+
+	report("fork", &fork_lat);
+	report("fork", &fault_lat);
+	close(pfd[0]);
+	close(pfd[1]);
+out:
+	if (map != MAP_FAILED)
+		munmap((void *)map, file_size);
+	if (heap != MAP_FAILED)
+		munmap(heap, heap_size);
+	close(fd);
+	unlink(path);
+}
+
+static void phase_file_fault(void)
+{
+	struct lat l = { .name = "page" };
+	unsigned int i, n = iters / 50 ? iters / 50 : 1;
+	volatile char *map;
+	char path[256];
+	size_t off;
+	int fd;
+
+	fd = make_file("coldstart.fault", 0, path, sizeof(path));
+	if (fd < 0) {
+		skip("file_fault", "cannot create the file");
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		drop_cache(fd);
+		map = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED)
+			break;
+		for (off = 0; off < file_size; off += page_size) {
+			uint64_t start = now_ns();
+
+			(void)map[off];
+			lat_add(&l, now_ns() - start);
+		}
+		munmap((void *)map, file_size);
+	}
+
+	report("file_fault", &l);
+	close(fd);
+	unlink(path);
+}
+
+static void read_cold(const char *phase, int fd)
+{
+	struct lat l = { .name = "read" };
+	unsigned int i, n = iters / 50 ? iters / 50 : 1;
+	char *buf;
+	off_t off;
+
+	buf = malloc(READ_CHUNK);
+	if (!buf)
+		return;
+
+	for (i = 0; i < n; i++) {
+		drop_cache(fd);
+		for (off = 0; off < (off_t)file_size; off += READ_CHUNK) {
+			uint64_t start = now_ns();
+
+			if (pread(fd, buf, READ_CHUNK, off) <= 0)
+				break;
+			lat_add(&l, now_ns() - start);
+		}
+	}
+
+	report(phase, &l);
+	free(buf);
+}
+
+static void phase_readahead(void)
+{
+	char path[256];
+	int fd;
+
+	fd = make_file("coldstart.read", 0, path, sizeof(path));
+	if (fd < 0) {
+		skip("readahead", "cannot create the file");
+		return;
+	}
+	read_cold("readahead", fd);
+	close(fd);
+	unlink(path);
+}
+
+static void phase_f2fs_compr(void)
+{
+	struct statfs sfs;
+	char path[256];
+	int fd;
+
+	/* other filesystems may accept the flag and ignore it */
+	if (statfs(work_dir, &sfs) || sfs.f_type != F2FS_SUPER_MAGIC) {
+		skip("f2fs_compr", "work directory is not on f2fs");
+		return;
+	}
+	fd = make_file("coldstart.compr", 1, path, sizeof(path));
+	if (fd < 0) {
+		skip("f2fs_compr", "FS_COMPR_FL not supported here");
+		return;
+	}
+	read_cold("f2fs_compr", fd);
+	close(fd);
+	unlink(path);
+}
+
+static int binder_open_dev(const char *path, void **map)
+{
+	int fd = open(path, O_RDWR | O_CLOEXEC);
+
+	if (fd < 0)
+		return -1;
+	*map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (*map == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int binder_write_read(int fd, void *wbuf, size_t wlen,
+			     void *rbuf, size_t rlen, size_t *consumed)
+{
+	struct binder_write_read bwr = {
+		.write_size = wlen,
+		.write_buffer = (uintptr_t)wbuf,
+		.read_size = rlen,
+		.read_buffer = (uintptr_t)rbuf,
+	};
+	int ret;
+
+	do {
+		ret = ioctl(fd, BINDER_WRITE_READ, &bwr);
+	} while (ret < 0 && errno == EINTR);
+	if (consumed)
+		*consumed = bwr.read_consumed;
+	return ret;
+}
+
+/* Context manager: reply to every transaction until killed */
+static void binder_server(const char *dev, int ready_fd)
+{
+	struct {
+		uint32_t free_cmd;
+		binder_uintptr_t buffer;
+		uint32_t reply_cmd;
+		struct binder_transaction_data tr;
+	} __attribute__((packed)) reply = {
+		.free_cmd = BC_FREE_BUFFER,
+		.reply_cmd = BC_REPLY,
+	};
+	char data[BINDER_PAYLOAD] = { 0 };
+	uint32_t looper = BC_ENTER_LOOPER;
+	uint32_t rbuf[128];
+	void *map;
+	int fd;
+
+	fd = binder_open_dev(dev, &map);
+	if (fd < 0 || ioctl(fd, BINDER_SET_CONTEXT_MGR, 0) ||
+	    binder_write_read(fd, &looper, sizeof(looper), NULL, 0, NULL))
+		_exit(1);
+	if (write(ready_fd, "", 1) != 1)
+		_exit(1);
+
+	reply.tr.data_size = sizeof(data);
+	reply.tr.data.ptr.buffer = (uintptr_t)data;
+
+	for (;;) {
+		size_t len, pos = 0;
+
+		if (binder_write_read(fd, NULL, 0, rbuf, sizeof(rbuf), &len))
+			_exit(1);
+		while (pos + sizeof(uint32_t) <= len) {
+			uint32_t cmd = *(uint32_t *)((char *)rbuf + pos);
+			struct binder_transaction_data *tr;
+
+			pos += sizeof(cmd);
+			if (cmd == BR_TRANSACTION) {
+				tr = (void *)((char *)rbuf + pos);
+				reply.buffer = tr->data.ptr.buffer;
+				binder_write_read(fd, &reply, sizeof(reply),
+						  NULL, 0, NULL);
+			}
+			pos += _IOC_SIZE(cmd);
+		}
+	}
+}
+
+/* Send one transaction to handle 0 and wait for the reply */
+static int binder_call(int fd, binder_uintptr_t *reply_buf)
+{
+	struct {
+		uint32_t free_cmd;
+		binder_uintptr_t buffer;
+		uint32_t cmd;
+		struct binder_transaction_data tr;
+	} __attribute__((packed)) req = {
+		.free_cmd = BC_FREE_BUFFER,
+		.buffer = *reply_buf,
+		.cmd = BC_TRANSACTION,
+	};
+	char data[BINDER_PAYLOAD] = { 0 };
+	uint32_t rbuf[128];
+	void *wbuf = &req;
+	size_t wlen = sizeof(req);
+
+	req.tr.target.handle = 0;
+	req.tr.data_size = sizeof(data);
+	req.tr.data.ptr.buffer = (uintptr_t)data;
+
+	/* nothing to free before the first call */
+	if (!*reply_buf) {
+		wbuf = &req.cmd;
+		wlen -= offsetof(typeof(req), cmd);
+	}
+
+	for (;;) {
+		size_t len, pos = 0;
+
+		if (binder_write_read(fd, wbuf, wlen, rbuf, sizeof(rbuf), &len))
+			return -1;
+		wlen = 0;
+		while (pos + sizeof(uint32_t) <= len) {
+			uint32_t cmd = *(uint32_t *)((char *)rbuf + pos);
+			struct binder_transaction_data *tr;
+
+			pos += sizeof(cmd);
+			switch (cmd) {
+			case BR_REPLY:
+				tr = (void *)((char *)rbuf + pos);
+				*reply_buf = tr->data.ptr.buffer;
+				return 0;
+			case BR_DEAD_REPLY:
+			case BR_FAILED_REPLY:
+				return -1;
+			}
+			pos += _IOC_SIZE(cmd);
+		}
+	}
+}
+
+static void phase_binder(void)
+{
+	struct lat l = { .name = "round_trip" };
+	struct binderfs_device device = { .name = "coldstart" };
+	char mnt[256], ctl[300], dev[300];
+	binder_uintptr_t reply_buf = 0;
+	unsigned int i;
+	int fd, pfd[2];
+	void *map;
+	pid_t pid;
+	char c;
+
+	snprintf(mnt, sizeof(mnt), "%s/coldstart.binderfs", work_dir);
+	snprintf(ctl, sizeof(ctl), "%s/binder-control", mnt);
+	snprintf(dev, sizeof(dev), "%s/%s", mnt, device.name);
+	mkdir(mnt, 0700);
+	if (mount("binder", mnt, "binder", 0, NULL)) {
+		skip("binder", "cannot mount binderfs");
+		rmdir(mnt);
+		return;
+	}
+
+	fd = open(ctl, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || ioctl(fd, BINDER_CTL_ADD, &device) || pipe(pfd)) {
+		skip("binder", "cannot create a binder device");
+		if (fd >= 0)
+			close(fd);
+		goto out;
+	}
+	close(fd);
+
+	pid = fork();
+	if (!pid)
+		binder_server(dev, pfd[1]);
+	if (pid < 0 || read(pfd[0], &c, 1) != 1) {
+		skip("binder", "context manager failed");
+		goto out_kill;
+	}
+
+	fd = binder_open_dev(dev, &map);
+	if (fd < 0) {
+		skip("binder", "cannot open the device");
+		goto out_kill;
+	}
+	for (i = 0; i < iters * 10; i++) {
+		uint64_t start = now_ns();
+
+		if (binder_call(fd, &reply_buf))
+			break;
+		lat_add(&l, now_ns() - start);
+	}
+	report("binder", &l);
+	munmap(map, BINDER_MAP_SIZE);
+	close(fd);
+
+out_kill:
+	if (pid > 0) {
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+	}
+	close(pfd[0]);
+	close(pfd[1]);
+out:
+	umount2(mnt, MNT_DETACH);
+	rmdir(mnt);
+}
+
+/* Buffer sizes of a typical first frame: icons, textures, surfaces */
+static const size_t alloc_sizes[] = { 64 << 10, 256 << 10, 1 << 20, 8 << 20 };
+
+static void phase_ion(void)
+{
+	struct lat alloc_lat = { .name = "alloc" };
+	struct lat free_lat = { .name = "free" };
+	unsigned int i;
+	int fd;
+
+	fd = open("/dev/ion", O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		skip("ion", "no /dev/ion");
+		return;
+	}
+
+	for (i = 0; i < iters; i++) {
+		struct ion_allocation_data data = {
+			.len = alloc_sizes[i % 4],
+			.heap_id_mask = ION_SYSTEM_HEAP_MASK,
+		};
+		uint64_t start = now_ns();
+
+		if (ioctl(fd, ION_IOC_ALLOC, &data))
+			break;
+		lat_add(&alloc_lat, now_ns() - start);
+
+		start = now_ns();
+		close(data.fd);
+		lat_add(&free_lat, now_ns() - start);
+	}
+
+	report("ion", &alloc_lat);
+	report("ion", &free_lat);
+	close(fd);
+}
+
+static void phase_kgsl(void)
+{
+	struct lat alloc_lat = { .name = "alloc" };
+	struct lat free_lat = { .name = "free" };
+	unsigned int i;
+	int fd;
+
+	fd = open("/dev/kgsl-3d0", O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		skip("kgsl", "no /dev/kgsl-3d0");
+		return;
+	}
+
+	for (i = 0; i < iters; i++) {
+		struct kgsl_gpuobj_alloc obj = { .size = alloc_sizes[i % 4] };
+		struct kgsl_gpuobj_free f = { 0 };
+		uint64_t start = now_ns();
+
+		if (ioctl(fd, IOCTL_KGSL_GPUOBJ_ALLOC, &obj))
+			break;
+		lat_add(&alloc_lat, now_ns() - start);
+
+		f.id = obj.id;
+		start = now_ns();
+		ioctl(fd, IOCTL_KGSL_GPUOBJ_FREE, &f);
+		lat_add(&free_lat, now_ns() - start);
+	}
+
+	report("kgsl", &alloc_lat);
+	report("kgsl", &free_lat);
+	close(fd);
+}
+
+struct waker {
+	int cpu;
+	int rfd, wfd;
+	unsigned int n;
+	struct lat lat;
+};
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+/* Wait for a timestamp from the other side, then send one back */
+static void *waker_fn(void *arg)
+{
+	struct waker *w = arg;
+	unsigned int i;
+	uint64_t t;
+
+	pin(w->cpu);
+	for (i = 0; i < w->n; i++) {
+		if (read(w->rfd, &t, sizeof(t)) != sizeof(t))
+			break;
+		lat_add(&w->lat, now_ns() - t);
+		/* let this CPU go idle, as it would between frames */
+		usleep(200);
+		t = now_ns();
+		if (write(w->wfd, &t, sizeof(t)) != sizeof(t))
+			break;
+	}
+	return NULL;
+}
+
+static int cpu_cluster(int cpu)
+{
+	char path[128];
+	int id = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+		 cpu);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &id) != 1)
+		id = -1;
+	fclose(f);
+	return id;
+}
+
+static void phase_wakeup(void)
+{
+	struct waker little = { .lat.name = "to_first_cluster" };
+	struct waker big = { .lat.name = "to_last_cluster" };
+	int ab[2], ba[2], last = sysconf(_SC_NPROCESSORS_CONF) - 1;
+	pthread_t a, b;
+	uint64_t t;
+
+	if (last < 1 || cpu_cluster(0) == cpu_cluster(last)) {
+		skip("wakeup", "single cluster");
+		return;
+	}
+	if (pipe(ab) || pipe(ba)) {
+		skip("wakeup", "pipe failed");
+		return;
+	}
+
+	little.cpu = 0;
+	little.rfd = ba[0];
+	little.wfd = ab[1];
+	little.n = iters * 5;
+	big.cpu = last;
+	big.rfd = ab[0];
+	big.wfd = ba[1];
+	big.n = iters * 5;
+
+	pthread_create(&a, NULL, waker_fn, &little);
+	pthread_create(&b, NULL, waker_fn, &big);
+	t = now_ns();
+	if (write(ba[1], &t, sizeof(t)) != sizeof(t))
+		perror("write");
+	pthread_join(a, NULL);
+	pthread_join(b, NULL);
+
+	report("wakeup", &little.lat);
+	report("wakeup", &big.lat);
+	close(ab[0]);
+	close(ab[1]);
+	close(ba[0]);
+	close(ba[1]);
+}
+
+static const struct {
+	const char *name;
+	void (*fn)(void);
+} phases[] = {
+	{ "fork", phase_fork },
+	{ "file_fault", phase_file_fault },
+	{ "readahead", phase_readahead },
+	{ "f2fs_compr", phase_f2fs_compr },
+	{ "binder", phase_binder },
+	{ "ion", phase_ion },
+	{ "kgsl", phase_kgsl },
+	{ "wakeup", phase_wakeup },
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-p] [-d dir] [-n iterations] [-s file_mb] [phase...]\n"
+		"  -p  run the phases in parallel instead of one after another\n"
+		"  -d  work directory for the test files, default .\n"
+		"  -n  iterations, scaled per phase, default 200\n"
+		"  -s  size of the test files in MiB, default 32\n",
+		prog);
+	exit(2);
+}
+
+static int selected(int argc, char **argv, const char *name)
+{
+	int i;
+
+	if (optind == argc)
+		return 1;
+	for (i = optind; i < argc; i++)
+		if (!strcmp(argv[i], name))
+			return 1;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int parallel = 0, opt;
+	unsigned int i;
+
+	while ((opt = getopt(argc, argv, "pd:n:s:")) != -1) {
+		switch (opt) {
+		case 'p':
+			parallel = 1;
+			break;
+		case 'd':
+			work_dir = optarg;
+			break;
+		case 'n':
+			iters = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			file_size = strtoul(optarg, NULL, 0) << 20;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	page_size = sysconf(_SC_PAGESIZE);
+	if (!iters || file_size < READ_CHUNK)
+		usage(argv[0]);
+	file_size -= file_size % READ_CHUNK;
+
+	for (i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+		if (!selected(argc, argv, phases[i].name))
+			continue;
+		if (!parallel) {
+			phases[i].fn();
+			continue;
+		}
+		if (!fork()) {
+			phases[i].fn();
+			_exit(0);
+		}
+	}
+
+	while (wait(NULL) > 0)
+		;
+
+	return 0;
+}